@@ -6,8 +6,15 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <errno.h>
-#include <sys/inotify.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
 #include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#else
+#include <sys/event.h>
+#endif
 #include <openssl/sha.h>
 #include <math.h>
 
@@ -27,6 +34,9 @@ const concurrent_vm_pool_config_t DEFAULT_VM_POOL_CONFIG = {
 // Cache hash table size (prime number for better distribution)
 #define CACHE_TABLE_SIZE 1009
 
+// Reader/writer locks guarding the cache buckets
+#define CACHE_LOCK_STRIPES 64
+
 // Global pool instance for mod_ember integration
 static concurrent_vm_pool_t* g_global_vm_pool = NULL;
 static pthread_mutex_t g_global_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -158,6 +168,63 @@ static void cleanup_vm_instance(vm_pool_entry_t* entry) {
 // BYTECODE CACHE IMPLEMENTATION
 // ============================================================================
 
+// Buckets are guarded by CACHE_LOCK_STRIPES rwlocks (bucket % stripes), so
+// lookups of different scripts never contend on one lock. When the cache is
+// full a CLOCK hand sweeps the buckets: entries read since the last sweep
+// get a second chance, the first unreferenced one is evicted. The hand takes
+// one stripe at a time and never while an inserter holds its own stripe.
+
+static pthread_rwlock_t* cache_stripe(concurrent_vm_pool_t* pool, uint32_t bucket) {
+    return &pool->cache_locks[bucket % CACHE_LOCK_STRIPES];
+}
+
+static void free_cache_entry(bytecode_cache_entry_t* entry) {
+    free(entry->script_path);
+    free(entry->source_hash);
+    free(entry->bytecode);
+    free(entry);
+}
+
+// Source file identity used to detect stale entries; both 0 when the script
+// is not a file, which disables validation for that entry
+static void script_file_stamp(const char* script_path, time_t* mtime, off_t* size) {
+    struct stat info;
+    if (stat(script_path, &info) == 0) {
+        *mtime = info.st_mtime;
+        *size = info.st_size;
+    } else {
+        *mtime = 0;
+        *size = 0;
+    }
+}
+
+static int evict_one_entry(concurrent_vm_pool_t* pool) {
+    pthread_mutex_lock(&pool->cache_clock_mutex);
+    int evicted = 0;
+    // Two sweeps: the first may only clear reference bits
+    for (size_t step = 0; !evicted && step < 2 * CACHE_TABLE_SIZE; step++) {
+        uint32_t bucket = (uint32_t)(pool->cache_clock_hand++ % CACHE_TABLE_SIZE);
+        pthread_rwlock_t* lock = cache_stripe(pool, bucket);
+        pthread_rwlock_wrlock(lock);
+        bytecode_cache_entry_t** current = &pool->bytecode_cache[bucket];
+        while (*current) {
+            bytecode_cache_entry_t* entry = *current;
+            if (__sync_lock_test_and_set(&entry->referenced, 0)) {
+                current = &entry->next;
+                continue;
+            }
+            *current = entry->next;
+            free_cache_entry(entry);
+            __sync_fetch_and_sub(&pool->cached_scripts, 1);
+            evicted = 1;
+            break;
+        }
+        pthread_rwlock_unlock(lock);
+    }
+    pthread_mutex_unlock(&pool->cache_clock_mutex);
+    return evicted;
+}
+
 int concurrent_vm_pool_cache_bytecode(concurrent_vm_pool_t* pool,
                                      const char* script_path,
                                      const char* source_hash,
@@ -171,22 +238,26 @@ int concurrent_vm_pool_cache_bytecode(concurrent_vm_pool_t* pool,
         return 0;  // Caching disabled
     }
     
-    pthread_rwlock_wrlock(&pool->cache_rwlock);
-    
-    // Check if we're at capacity
-    if (pool->cached_scripts >= pool->config.max_script_cache_size) {
-        // TODO: Implement LRU eviction
-        pthread_rwlock_unlock(&pool->cache_rwlock);
-        return -1;
+    // Make room before taking our own stripe
+    while (__atomic_load_n(&pool->cached_scripts, __ATOMIC_RELAXED) >= pool->config.max_script_cache_size) {
+        if (!evict_one_entry(pool)) {
+            return -1;
+        }
     }
     
+    time_t file_mtime;
+    off_t file_size;
+    script_file_stamp(script_path, &file_mtime, &file_size);
+    
     uint32_t hash = cache_hash_function(script_path);
+    pthread_rwlock_t* lock = cache_stripe(pool, hash);
+    pthread_rwlock_wrlock(lock);
     
     // Check if entry already exists
     bytecode_cache_entry_t* existing = pool->bytecode_cache[hash];
     while (existing) {
         if (strcmp(existing->script_path, script_path) == 0) {
-            // Update existing entry with atomic operations to prevent race conditions
+            // Swap in the new bytecode while holding the stripe exclusively
             char* new_hash = source_hash ? strdup(source_hash) : NULL;
             uint8_t* new_bytecode = malloc(bytecode_size);
             if (new_bytecode) {
@@ -196,13 +267,15 @@ int concurrent_vm_pool_cache_bytecode(concurrent_vm_pool_t* pool,
                 char* old_hash = existing->source_hash;
                 uint8_t* old_bytecode = existing->bytecode;
                 
-                // Atomic update
                 existing->source_hash = new_hash;
                 existing->bytecode = new_bytecode;
                 existing->bytecode_size = bytecode_size;
                 existing->compile_time = time(NULL);
+                existing->file_mtime = file_mtime;
+                existing->file_size = file_size;
                 existing->access_count = 0;
                 existing->last_access = get_timestamp_ns();
+                existing->referenced = 1;
                 
                 // Free old data after update
                 free(old_hash);
@@ -211,8 +284,8 @@ int concurrent_vm_pool_cache_bytecode(concurrent_vm_pool_t* pool,
                 free(new_hash);
             }
             
-            pthread_rwlock_unlock(&pool->cache_rwlock);
-            return 0;
+            pthread_rwlock_unlock(lock);
+            return new_bytecode ? 0 : -1;
         }
         existing = existing->next;
     }
@@ -220,7 +293,7 @@ int concurrent_vm_pool_cache_bytecode(concurrent_vm_pool_t* pool,
     // Create new entry
     bytecode_cache_entry_t* entry = malloc(sizeof(bytecode_cache_entry_t));
     if (!entry) {
-        pthread_rwlock_unlock(&pool->cache_rwlock);
+        pthread_rwlock_unlock(lock);
         return -1;
     }
     
@@ -229,16 +302,15 @@ int concurrent_vm_pool_cache_bytecode(concurrent_vm_pool_t* pool,
     entry->bytecode = malloc(bytecode_size);
     entry->bytecode_size = bytecode_size;
     entry->compile_time = time(NULL);
-    entry->file_mtime = 0;  // TODO: Get actual file mtime
+    entry->file_mtime = file_mtime;
+    entry->file_size = file_size;
     entry->access_count = 0;
     entry->last_access = get_timestamp_ns();
+    entry->referenced = 1;
     
     if (!entry->script_path || !entry->bytecode) {
-        free(entry->script_path);
-        free(entry->source_hash);
-        free(entry->bytecode);
-        free(entry);
-        pthread_rwlock_unlock(&pool->cache_rwlock);
+        free_cache_entry(entry);
+        pthread_rwlock_unlock(lock);
         return -1;
     }
     
@@ -247,9 +319,9 @@ int concurrent_vm_pool_cache_bytecode(concurrent_vm_pool_t* pool,
     // Add to hash table
     entry->next = pool->bytecode_cache[hash];
     pool->bytecode_cache[hash] = entry;
-    pool->cached_scripts++;
+    __sync_fetch_and_add(&pool->cached_scripts, 1);
     
-    pthread_rwlock_unlock(&pool->cache_rwlock);
+    pthread_rwlock_unlock(lock);
     return 0;
 }
 
@@ -259,84 +331,91 @@ bytecode_cache_entry_t* concurrent_vm_pool_lookup_bytecode(concurrent_vm_pool_t*
         return NULL;
     }
     
-    pthread_rwlock_rdlock(&pool->cache_rwlock);
+    // stat outside the lock; a changed file makes the entry stale
+    time_t file_mtime;
+    off_t file_size;
+    script_file_stamp(script_path, &file_mtime, &file_size);
     
     uint32_t hash = cache_hash_function(script_path);
-    bytecode_cache_entry_t* entry = pool->bytecode_cache[hash];
+    pthread_rwlock_t* lock = cache_stripe(pool, hash);
+    pthread_rwlock_rdlock(lock);
     
+    bytecode_cache_entry_t* entry = pool->bytecode_cache[hash];
     while (entry) {
         if (strcmp(entry->script_path, script_path) == 0) {
-            // Update access statistics
-            entry->access_count++;
-            entry->last_access = get_timestamp_ns();
-            pool->script_cache_hits++;
-            
-            pthread_rwlock_unlock(&pool->cache_rwlock);
-            return entry;
+            break;
         }
         entry = entry->next;
     }
     
-    pool->script_cache_misses++;
-    pthread_rwlock_unlock(&pool->cache_rwlock);
-    return NULL;
+    if (entry && (entry->file_mtime != 0 || entry->file_size != 0) &&
+        (entry->file_mtime != file_mtime || entry->file_size != file_size)) {
+        pthread_rwlock_unlock(lock);
+        concurrent_vm_pool_invalidate_cache(pool, script_path);
+        __sync_fetch_and_add(&pool->script_cache_misses, 1);
+        return NULL;
+    }
+    
+    if (entry) {
+        // Readers share the stripe, so statistics are updated atomically
+        __sync_fetch_and_add(&entry->access_count, 1);
+        __atomic_store_n(&entry->last_access, get_timestamp_ns(), __ATOMIC_RELAXED);
+        if (!__atomic_load_n(&entry->referenced, __ATOMIC_RELAXED)) {
+            __sync_lock_test_and_set(&entry->referenced, 1);
+        }
+        __sync_fetch_and_add(&pool->script_cache_hits, 1);
+    } else {
+        __sync_fetch_and_add(&pool->script_cache_misses, 1);
+    }
+    pthread_rwlock_unlock(lock);
+    return entry;
 }
 
 void concurrent_vm_pool_invalidate_cache(concurrent_vm_pool_t* pool,
                                         const char* script_path) {
-    if (!pool || !script_path) {
+    if (!pool || !script_path || !pool->bytecode_cache) {
         return;
     }
     
-    pthread_rwlock_wrlock(&pool->cache_rwlock);
-    
     uint32_t hash = cache_hash_function(script_path);
+    pthread_rwlock_t* lock = cache_stripe(pool, hash);
+    pthread_rwlock_wrlock(lock);
+    
     bytecode_cache_entry_t** current = &pool->bytecode_cache[hash];
     
     while (*current) {
         if (strcmp((*current)->script_path, script_path) == 0) {
             bytecode_cache_entry_t* to_remove = *current;
             *current = (*current)->next;
-            
-            free(to_remove->script_path);
-            free(to_remove->source_hash);
-            free(to_remove->bytecode);
-            free(to_remove);
-            
-            pool->cached_scripts--;
+            free_cache_entry(to_remove);
+            __sync_fetch_and_sub(&pool->cached_scripts, 1);
             break;
         } else {
             current = &(*current)->next;
         }
     }
     
-    pthread_rwlock_unlock(&pool->cache_rwlock);
+    pthread_rwlock_unlock(lock);
 }
 
 void concurrent_vm_pool_clear_cache(concurrent_vm_pool_t* pool) {
-    if (!pool) {
+    if (!pool || !pool->bytecode_cache) {
         return;
     }
     
-    pthread_rwlock_wrlock(&pool->cache_rwlock);
-    
     for (size_t i = 0; i < CACHE_TABLE_SIZE; i++) {
+        pthread_rwlock_t* lock = cache_stripe(pool, (uint32_t)i);
+        pthread_rwlock_wrlock(lock);
         bytecode_cache_entry_t* entry = pool->bytecode_cache[i];
         while (entry) {
             bytecode_cache_entry_t* next = entry->next;
-            
-            free(entry->script_path);
-            free(entry->source_hash);
-            free(entry->bytecode);
-            free(entry);
-            
+            free_cache_entry(entry);
+            __sync_fetch_and_sub(&pool->cached_scripts, 1);
             entry = next;
         }
         pool->bytecode_cache[i] = NULL;
+        pthread_rwlock_unlock(lock);
     }
-    
-    pool->cached_scripts = 0;
-    pthread_rwlock_unlock(&pool->cache_rwlock);
 }
 
 // ============================================================================
@@ -448,10 +527,18 @@ concurrent_vm_pool_t* concurrent_vm_pool_create(const concurrent_vm_pool_config_
     // Initialize synchronization objects
     if (pthread_mutex_init(&pool->vm_pool_mutex, NULL) != 0 ||
         pthread_cond_init(&pool->pool_condition, NULL) != 0 ||
-        pthread_rwlock_init(&pool->cache_rwlock, NULL) != 0) {
+        pthread_mutex_init(&pool->cache_clock_mutex, NULL) != 0) {
+        free(pool);
+        return NULL;
+    }
+    pool->cache_locks = malloc(CACHE_LOCK_STRIPES * sizeof(pthread_rwlock_t));
+    if (!pool->cache_locks) {
         free(pool);
         return NULL;
     }
+    for (size_t i = 0; i < CACHE_LOCK_STRIPES; i++) {
+        pthread_rwlock_init(&pool->cache_locks[i], NULL);
+    }
     
     // Create work stealing thread pool
     pool->thread_pool = work_stealing_pool_create(thread_config);
@@ -514,7 +601,11 @@ void concurrent_vm_pool_destroy(concurrent_vm_pool_t* pool) {
     // Cleanup synchronization objects
     pthread_mutex_destroy(&pool->vm_pool_mutex);
     pthread_cond_destroy(&pool->pool_condition);
-    pthread_rwlock_destroy(&pool->cache_rwlock);
+    pthread_mutex_destroy(&pool->cache_clock_mutex);
+    for (size_t i = 0; i < CACHE_LOCK_STRIPES; i++) {
+        pthread_rwlock_destroy(&pool->cache_locks[i]);
+    }
+    free(pool->cache_locks);
     
     free(pool);
 }
@@ -730,34 +821,65 @@ int concurrent_vm_pool_submit_script_execution(concurrent_vm_pool_t* pool,
 // HOT RELOAD IMPLEMENTATION
 // ============================================================================
 
+// The monitor thread sleeps in poll()/kevent() until the kernel reports a
+// change under the watched directory, so idle pools cost nothing and a save
+// is picked up immediately. A pipe wakes the thread for shutdown.
+
+static bool is_script_name(const char* name) {
+    size_t length = strlen(name);
+    return (length > 6 && strcmp(name + length - 6, ".ember") == 0) ||
+           (length > 7 && strcmp(name + length - 7, ".emberc") == 0);
+}
+
+#ifdef __linux__
+
+#define HOT_RELOAD_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM)
+
 static void* hot_reload_monitor_thread(void* arg) {
     concurrent_vm_pool_t* pool = (concurrent_vm_pool_t*)arg;
     if (!pool) {
         return NULL;
     }
     
-    char buffer[4096];
-    struct inotify_event* event;
+    // inotify_event needs its alignment
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd fds[2] = {
+        {.fd = pool->inotify_fd, .events = POLLIN},
+        {.fd = pool->hot_reload_wake[0], .events = POLLIN},
+    };
     
     while (!pool->is_shutting_down) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents) {
+            break;  // Shutdown requested
+        }
+        
         ssize_t length = read(pool->inotify_fd, buffer, sizeof(buffer));
         if (length < 0) {
-            if (errno == EINTR) {
+            if (errno == EINTR || errno == EAGAIN) {
                 continue;
             }
             break;
         }
         
         for (char* ptr = buffer; ptr < buffer + length; ) {
-            event = (struct inotify_event*)ptr;
+            struct inotify_event* event = (struct inotify_event*)ptr;
             
-            if (event->mask & (IN_MODIFY | IN_MOVED_TO | IN_CREATE)) {
-                if (event->len > 0) {
-                    char* filename = event->name;
-                    if (strstr(filename, ".ember")) {
-                        // Invalidate cache for this script
-                        invalidate_script_cache(pool, filename);
-                    }
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were dropped: nothing in the cache can be trusted
+                concurrent_vm_pool_clear_cache(pool);
+                fprintf(stderr, "[Hot Reload] Event queue overflow, cleared script cache\n");
+            } else if ((event->mask & HOT_RELOAD_EVENTS) && event->len > 0 && is_script_name(event->name)) {
+                char script_path[PATH_MAX];
+                int written = snprintf(script_path, sizeof(script_path), "%s/%s",
+                                       pool->hot_reload_dir, event->name);
+                if (written > 0 && (size_t)written < sizeof(script_path)) {
+                    invalidate_script_cache(pool, script_path);
                 }
             }
             
@@ -768,14 +890,129 @@ static void* hot_reload_monitor_thread(void* arg) {
     return NULL;
 }
 
+static int start_watch(concurrent_vm_pool_t* pool) {
+    pool->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (pool->inotify_fd == -1) {
+        return -1;
+    }
+    pool->inotify_wd = inotify_add_watch(pool->inotify_fd, pool->hot_reload_dir, HOT_RELOAD_EVENTS);
+    if (pool->inotify_wd == -1) {
+        close(pool->inotify_fd);
+        pool->inotify_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+static void stop_watch(concurrent_vm_pool_t* pool) {
+    if (pool->inotify_wd != -1) {
+        inotify_rm_watch(pool->inotify_fd, pool->inotify_wd);
+        pool->inotify_wd = -1;
+    }
+    if (pool->inotify_fd != -1) {
+        close(pool->inotify_fd);
+        pool->inotify_fd = -1;
+    }
+}
+
+#else // kqueue (BSD, macOS)
+
+// A directory vnode only reports that its entries changed, not which file,
+// so every cached script under the directory whose mtime or size moved is
+// dropped. File contents rewritten in place are still caught by the stat
+// check in concurrent_vm_pool_lookup_bytecode.
+static void invalidate_changed_scripts(concurrent_vm_pool_t* pool) {
+    size_t dir_length = strlen(pool->hot_reload_dir);
+    for (size_t i = 0; i < CACHE_TABLE_SIZE; i++) {
+        pthread_rwlock_t* lock = cache_stripe(pool, (uint32_t)i);
+        pthread_rwlock_wrlock(lock);
+        bytecode_cache_entry_t** current = &pool->bytecode_cache[i];
+        while (*current) {
+            bytecode_cache_entry_t* entry = *current;
+            time_t file_mtime;
+            off_t file_size;
+            if (strncmp(entry->script_path, pool->hot_reload_dir, dir_length) == 0 &&
+                entry->script_path[dir_length] == '/') {
+                script_file_stamp(entry->script_path, &file_mtime, &file_size);
+                if (file_mtime != entry->file_mtime || file_size != entry->file_size) {
+                    fprintf(stderr, "[Hot Reload] Invalidated cache for: %s\n", entry->script_path);
+                    *current = entry->next;
+                    free_cache_entry(entry);
+                    __sync_fetch_and_sub(&pool->cached_scripts, 1);
+                    continue;
+                }
+            }
+            current = &entry->next;
+        }
+        pthread_rwlock_unlock(lock);
+    }
+}
+
+static void* hot_reload_monitor_thread(void* arg) {
+    concurrent_vm_pool_t* pool = (concurrent_vm_pool_t*)arg;
+    if (!pool) {
+        return NULL;
+    }
+    
+    while (!pool->is_shutting_down) {
+        struct kevent event;
+        int count = kevent(pool->kqueue_fd, NULL, 0, &event, 1, NULL);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (count == 0) {
+            continue;
+        }
+        if ((int)event.ident == pool->hot_reload_wake[0]) {
+            break;  // Shutdown requested
+        }
+        if (pool->bytecode_cache) {
+            invalidate_changed_scripts(pool);
+        }
+    }
+    
+    return NULL;
+}
+
+static int start_watch(concurrent_vm_pool_t* pool) {
+    pool->watch_dir_fd = open(pool->hot_reload_dir, O_RDONLY);
+    if (pool->watch_dir_fd == -1) {
+        return -1;
+    }
+    pool->kqueue_fd = kqueue();
+    if (pool->kqueue_fd == -1) {
+        close(pool->watch_dir_fd);
+        return -1;
+    }
+    
+    struct kevent changes[2];
+    EV_SET(&changes[0], pool->watch_dir_fd, EVFILT_VNODE, EV_ADD | EV_CLEAR,
+           NOTE_WRITE | NOTE_EXTEND | NOTE_ATTRIB | NOTE_RENAME | NOTE_DELETE, 0, NULL);
+    EV_SET(&changes[1], pool->hot_reload_wake[0], EVFILT_READ, EV_ADD, 0, 0, NULL);
+    if (kevent(pool->kqueue_fd, changes, 2, NULL, 0, NULL) == -1) {
+        close(pool->kqueue_fd);
+        close(pool->watch_dir_fd);
+        return -1;
+    }
+    return 0;
+}
+
+static void stop_watch(concurrent_vm_pool_t* pool) {
+    close(pool->kqueue_fd);
+    close(pool->watch_dir_fd);
+}
+
+#endif
+
 static void invalidate_script_cache(concurrent_vm_pool_t* pool, const char* script_path) {
-    if (!pool || !script_path) {
+    if (!pool || !script_path || !pool->bytecode_cache) {
         return;
     }
     
     concurrent_vm_pool_invalidate_cache(pool, script_path);
-    
-    // Could also log the invalidation
     fprintf(stderr, "[Hot Reload] Invalidated cache for: %s\n", script_path);
 }
 
@@ -785,21 +1022,36 @@ int concurrent_vm_pool_enable_hot_reload(concurrent_vm_pool_t* pool,
         return -1;
     }
     
-    pool->inotify_fd = inotify_init1(IN_NONBLOCK);
-    if (pool->inotify_fd == -1) {
+    // Cache keys are full script paths; events only carry file names
+    size_t dir_length = strlen(watch_directory);
+    while (dir_length > 1 && watch_directory[dir_length - 1] == '/') {
+        dir_length--;
+    }
+    pool->hot_reload_dir = strndup(watch_directory, dir_length);
+    if (!pool->hot_reload_dir) {
         return -1;
     }
     
-    pool->inotify_wd = inotify_add_watch(pool->inotify_fd, watch_directory,
-                                        IN_MODIFY | IN_MOVED_TO | IN_CREATE);
-    if (pool->inotify_wd == -1) {
-        close(pool->inotify_fd);
+    if (pipe(pool->hot_reload_wake) != 0) {
+        free(pool->hot_reload_dir);
+        pool->hot_reload_dir = NULL;
+        return -1;
+    }
+    
+    if (start_watch(pool) != 0) {
+        close(pool->hot_reload_wake[0]);
+        close(pool->hot_reload_wake[1]);
+        free(pool->hot_reload_dir);
+        pool->hot_reload_dir = NULL;
         return -1;
     }
     
     if (pthread_create(&pool->hot_reload_thread, NULL, hot_reload_monitor_thread, pool) != 0) {
-        inotify_rm_watch(pool->inotify_fd, pool->inotify_wd);
-        close(pool->inotify_fd);
+        stop_watch(pool);
+        close(pool->hot_reload_wake[0]);
+        close(pool->hot_reload_wake[1]);
+        free(pool->hot_reload_dir);
+        pool->hot_reload_dir = NULL;
         return -1;
     }
     
@@ -814,18 +1066,17 @@ void concurrent_vm_pool_disable_hot_reload(concurrent_vm_pool_t* pool) {
     
     pool->hot_reload_enabled = false;
     
-    if (pool->inotify_wd != -1) {
-        inotify_rm_watch(pool->inotify_fd, pool->inotify_wd);
-        pool->inotify_wd = -1;
-    }
-    
-    if (pool->inotify_fd != -1) {
-        close(pool->inotify_fd);
-        pool->inotify_fd = -1;
-    }
-    
-    // Wait for hot reload thread to finish
+    // Wake the monitor thread and wait for it before closing its descriptors
+    char wake = 1;
+    ssize_t written = write(pool->hot_reload_wake[1], &wake, 1);
+    (void)written;
     pthread_join(pool->hot_reload_thread, NULL);
+    
+    stop_watch(pool);
+    close(pool->hot_reload_wake[0]);
+    close(pool->hot_reload_wake[1]);
+    free(pool->hot_reload_dir);
+    pool->hot_reload_dir = NULL;
 }
 
 // ============================================================================
@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <signal.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -17,13 +19,18 @@ extern "C" {
 
 // Maximum stack size for the VM
 #define EMBER_STACK_MAX 256
-#define EMBER_CONST_POOL_MAX 256
+#define EMBER_CONST_POOL_MAX 65536  // Indices past 255 are encoded with OP_WIDE
 #define EMBER_MAX_LOCALS 256
-#define EMBER_MAX_MODULES 64
+#define EMBER_LOCALS_MAX 1024       // Local slots across all active frames
+#define EMBER_MAX_FRAMES 1024       // Nested Ember function calls
+#define EMBER_INITIAL_FRAMES 16     // Frames allocated by a VM's first call
+#define EMBER_WIDE_OPERAND_MAX 0xFFFF
 #define EMBER_MAX_PATH_LEN 512
 #define EMBER_MAX_MOUNTS 32
 #define EMBER_MAX_ARGS 64
 #define EMBER_MAX_GLOBALS 1024
+#define EMBER_SLAB_CLASSES 16       // Object slab size classes, 16 bytes apart
+#define EMBER_POOLED_TYPES 4        // Iterators, bound methods, promises, arrays
 
 // Error handling constants
 #define EMBER_MAX_CALL_STACK 64
@@ -84,7 +91,17 @@ typedef enum {
     EMBER_VAL_SET,
     EMBER_VAL_MAP,
     EMBER_VAL_REGEX,
-    EMBER_VAL_ITERATOR
+    EMBER_VAL_ITERATOR,
+    EMBER_VAL_STRING_BUILDER,
+    EMBER_VAL_HASHER,
+    EMBER_VAL_FILE,
+    EMBER_VAL_WALKER,
+    EMBER_VAL_TYPED_ARRAY,
+    EMBER_VAL_CACHE,
+    EMBER_VAL_DEQUE,
+    EMBER_VAL_PRIORITY_QUEUE,
+    EMBER_VAL_WEAK_REF,
+    EMBER_VAL_WEAK_MAP
 } ember_val_type;
 
 // Opcodes for the bytecode VM
@@ -104,6 +121,7 @@ typedef enum {
     OP_GREATER_EQUAL, // Greater than or equal comparison
     OP_JUMP,          // Unconditional jump
     OP_JUMP_IF_FALSE, // Conditional jump if top is false
+    OP_JUMP_IF_TRUE,  // Conditional jump if top is true
     OP_LOOP,          // Loop back to earlier instruction
     OP_CALL,          // Call function
     OP_RETURN,        // Return from function
@@ -123,17 +141,18 @@ typedef enum {
     OP_HASH_MAP_SET,  // Set hash map element
     OP_HASH_MAP_LEN,  // Get hash map length
     OP_STRING_INTERPOLATE, // String interpolation operation
+    OP_CONCAT_N,      // Concatenate the top N values (1-byte count) into one string
     OP_BREAK,         // Break out of loop
     OP_CONTINUE,      // Continue to next loop iteration
-    OP_TRY_BEGIN,     // Begin try block
-    OP_TRY_END,       // End try block
+    OP_TRY_BEGIN,     // Begin try block (not emitted; try blocks live in chunk->handlers)
+    OP_TRY_END,       // End try block (not emitted)
     OP_CATCH_BEGIN,   // Begin catch block
     OP_CATCH_END,     // End catch block
     OP_FINALLY_BEGIN, // Begin finally block
     OP_FINALLY_END,   // End finally block
     OP_THROW,         // Throw exception
     OP_RETHROW,       // Rethrow current exception
-    OP_POP_HANDLER,   // Pop exception handler
+    OP_POP_HANDLER,   // Pop exception handler (not emitted)
     OP_CATCH_TYPE,    // Begin typed catch block (with exception type checking)
     OP_EXCEPTION_MATCH, // Check if current exception matches specified type
     OP_CLASS_DEF,     // Define a class
@@ -179,6 +198,30 @@ typedef enum {
     OP_MODULE_IMPORT, // Import from module
     OP_MODULE_IMPORT_ALL, // Import all exports
     OP_MODULE_REQUIRE, // Require module (CommonJS style)
+    // Superinstructions selected by the optimizer; operands are 16-bit big-endian
+    OP_ADD_LOCAL_CONST, // locals[slot] += constant (slot, constant); pushes nothing
+    OP_SUB_LOCAL_CONST, // locals[slot] -= constant (slot, constant); pushes nothing
+    OP_LOCAL_LESS_CONST_JUMP_IF_FALSE,          // Jump unless locals[slot] < constant (slot, constant, offset)
+    OP_LOCAL_LESS_EQUAL_CONST_JUMP_IF_FALSE,    // Jump unless locals[slot] <= constant
+    OP_LOCAL_GREATER_CONST_JUMP_IF_FALSE,       // Jump unless locals[slot] > constant
+    OP_LOCAL_GREATER_EQUAL_CONST_JUMP_IF_FALSE, // Jump unless locals[slot] >= constant
+    OP_TAIL_CALL,     // Call in tail position, reusing the running function's frame
+    OP_SWITCH_TABLE,  // Pop the subject, jump through chunk->switch_tables[operand]
+    OP_CALL_GUARD,    // Inlined call: pop the callee if it is constant's function, else jump to the real OP_CALL (argc, constant, offset)
+    // Quickened forms, written over the generic opcode at run time once type
+    // feedback shows stable operand types (vm_quicken.c); never emitted or saved
+    OP_ADD_NUMBER,    // OP_ADD on two numbers
+    OP_SUB_NUMBER,    // OP_SUB on two numbers
+    OP_MUL_NUMBER,    // OP_MUL on two numbers
+    OP_DIV_NUMBER,    // OP_DIV on two numbers
+    OP_MOD_NUMBER,    // OP_MOD on two numbers
+    OP_LESS_NUMBER,   // OP_LESS on two numbers
+    OP_LESS_EQUAL_NUMBER,    // OP_LESS_EQUAL on two numbers
+    OP_GREATER_NUMBER,       // OP_GREATER on two numbers
+    OP_GREATER_EQUAL_NUMBER, // OP_GREATER_EQUAL on two numbers
+    OP_ARRAY_GET_NUMBER_INDEX, // OP_ARRAY_GET on an array with a number index
+    OP_BREAKPOINT,    // Written over an opcode by a debugger (vm_debug.c); never emitted or saved
+    OP_WIDE,          // Prefix: the next instruction's operand is 2 bytes (big-endian)
     OP_HALT           // Stop execution
 } ember_opcode;
 
@@ -245,6 +288,7 @@ typedef enum {
     TOKEN_THIS,
     TOKEN_SUPER,
     TOKEN_DOT,
+    TOKEN_DOT_DOT,        // .. (range loops)
     TOKEN_ASYNC,
     TOKEN_AWAIT,
     TOKEN_YIELD,
@@ -266,6 +310,7 @@ typedef struct {
     const char* start;
     int length;
     int line;
+    int column;    // 1-based byte offset into the line
     double number; // For number tokens
 } ember_token;
 
@@ -291,21 +336,68 @@ typedef enum {
     OBJ_SET,
     OBJ_MAP,
     OBJ_REGEX,
-    OBJ_ITERATOR
+    OBJ_ITERATOR,
+    OBJ_STRING_BUILDER,
+    OBJ_HASHER,
+    OBJ_FILE,
+    OBJ_WALKER,
+    OBJ_TYPED_ARRAY,
+    OBJ_CACHE,
+    OBJ_DEQUE,
+    OBJ_PRIORITY_QUEUE,
+    OBJ_WEAK_REF,
+    OBJ_WEAK_MAP,
+    OBJ_FUNCTION
 } ember_object_type;
 
+#define EMBER_GC_OBJECT_TYPES (OBJ_FUNCTION + 1)
+
 // Base object structure for GC
 struct ember_object {
     ember_object_type type;
-    int is_marked;
+    uint8_t is_marked;      // EMBER_OBJECT_FROZEN for the frozen heap
+    uint8_t is_old;         // Survived a collection (generational GC)
+    uint8_t is_remembered;  // Old object in the remembered set
+    uint8_t in_slab;        // Header lives in a VM slab (EMBER_SLAB_OBJECTS)
     struct ember_object* next;
 };
 
+// Mark of objects in the process-wide frozen heap (frozen_heap.c). They are
+// in no VM's object list and stay marked, so no collector traces, moves or
+// frees them, and the mutators leave them unchanged
+#define EMBER_OBJECT_FROZEN 2
+
+static inline int ember_object_is_frozen(const void* object) {
+    return object && ((const ember_object*)object)->is_marked == EMBER_OBJECT_FROZEN;
+}
+
+// Strings up to this many bytes are stored inline, in the same allocation as the header
+#define EMBER_STRING_INLINE_MAX 31
+
+// Concatenations and substrings producing at least this many bytes build a
+// lazy rope node or slice; anything shorter is always flat
+#define EMBER_ROPE_MIN_LENGTH 64
+
 // String object structure
-typedef struct {
+//
+// A rope node (chars == NULL) records its two operands and is flattened into a
+// single buffer the first time its bytes are observed; read chars through
+// AS_CSTRING / ember_string_flatten unless the string is known to be flat.
+// A slice (chars == NULL, right == NULL) is length bytes of its flat parent
+// starting at slice_start, copied out only when flattened.
+typedef struct ember_string {
     ember_object obj;
-    char* chars;
+    char* chars;        // NUL-terminated once flat; points at inline_chars for short strings
     int length;
+    uint32_t hash;      // FNV-1a of chars, computed when the bytes are materialized
+    struct ember_string* left;   // Rope operands or a slice's parent, cleared by flattening
+    struct ember_string* right;
+    uint8_t is_interned; // Owned by vm->string_intern_table; equal contents imply equal pointers
+    uint8_t is_inline;   // chars lives in inline_chars and must not be freed separately
+    uint8_t is_mapped;   // chars is a read-only file mapping (ember_string_map_file), unmapped on free
+    uint8_t is_external; // chars belongs to the host (ember_make_string_external), released on free
+    int slice_start;     // A slice's offset into left (sits in what was tail padding)
+    char inline_chars[];
 } ember_string;
 
 // Array object structure
@@ -322,6 +414,13 @@ struct ember_value {
     union {
         int bool_val;
         double number_val;
+        // number_val again, with its int32 form when it has one (see
+        // IS_SMALL_INT); the bytes after it are otherwise unused by numbers
+        struct {
+            double value;
+            int32_t small;
+            int32_t is_small;
+        } number;
         char* string_val; // Legacy string support
         ember_object* obj_val;
         struct {
@@ -332,19 +431,89 @@ struct ember_value {
     } as;
 };
 
+// Compact 8-byte value encoding (NaN-boxing)
+//
+// Opt-in with -DEMBER_NAN_BOXING (make NAN_BOXING=1). Numbers are stored as
+// raw IEEE-754 doubles; every other value lives in the payload of a quiet NaN
+// that real arithmetic never produces:
+//
+//   number  any double (NaNs are canonicalized to EMBER_NANBOX_CANONICAL_NAN)
+//   nil     QNAN | 1
+//   false   QNAN | 2
+//   true    QNAN | 3
+//   object  SIGN | QNAN | 48-bit pointer
+//
+// Script function and native values are a chunk and name, or a C function
+// pointer, not a GC object, so they have no packed form; a caller that must
+// store one boxes it with allocate_function and packs the OBJ_FUNCTION. The
+// VM still keeps the tagged struct in its stack, globals and constants: this
+// is a codec for compact side storage. Use the EMBER_PACKED_* macros instead
+// of touching the bits directly.
+#ifdef EMBER_NAN_BOXING
+typedef uint64_t ember_packed_value;
+
+#define EMBER_NANBOX_SIGN          ((uint64_t)0x8000000000000000ULL)
+#define EMBER_NANBOX_QNAN          ((uint64_t)0x7ffc000000000000ULL)
+#define EMBER_NANBOX_CANONICAL_NAN ((uint64_t)0x7ff8000000000000ULL)
+#define EMBER_NANBOX_TAG_NIL       1
+#define EMBER_NANBOX_TAG_FALSE     2
+#define EMBER_NANBOX_TAG_TRUE      3
+
+#define EMBER_PACKED_NIL   ((ember_packed_value)(EMBER_NANBOX_QNAN | EMBER_NANBOX_TAG_NIL))
+#define EMBER_PACKED_FALSE ((ember_packed_value)(EMBER_NANBOX_QNAN | EMBER_NANBOX_TAG_FALSE))
+#define EMBER_PACKED_TRUE  ((ember_packed_value)(EMBER_NANBOX_QNAN | EMBER_NANBOX_TAG_TRUE))
+
+#define EMBER_PACKED_IS_NUMBER(v) (((v) & EMBER_NANBOX_QNAN) != EMBER_NANBOX_QNAN)
+#define EMBER_PACKED_IS_NIL(v)    ((v) == EMBER_PACKED_NIL)
+#define EMBER_PACKED_IS_BOOL(v)   (((v) | 1) == EMBER_PACKED_TRUE)
+#define EMBER_PACKED_IS_OBJ(v)    (((v) & (EMBER_NANBOX_QNAN | EMBER_NANBOX_SIGN)) == \
+                                   (EMBER_NANBOX_QNAN | EMBER_NANBOX_SIGN))
+
+#define EMBER_PACKED_AS_BOOL(v)   ((v) == EMBER_PACKED_TRUE)
+#define EMBER_PACKED_AS_OBJ(v)    ((ember_object*)(uintptr_t)((v) & ~(EMBER_NANBOX_SIGN | EMBER_NANBOX_QNAN)))
+#define EMBER_PACKED_AS_NUMBER(v) ember_packed_to_double(v)
+
+#define EMBER_PACKED_BOOL(b)      ((b) ? EMBER_PACKED_TRUE : EMBER_PACKED_FALSE)
+#define EMBER_PACKED_OBJ(o)       ((ember_packed_value)(EMBER_NANBOX_SIGN | EMBER_NANBOX_QNAN | \
+                                                        (uint64_t)(uintptr_t)(o)))
+#define EMBER_PACKED_NUMBER(d)    ember_double_to_packed(d)
+
+static inline double ember_packed_to_double(ember_packed_value v) {
+    union { uint64_t bits; double num; } u;
+    u.bits = v;
+    return u.num;
+}
+
+static inline ember_packed_value ember_double_to_packed(double d) {
+    union { uint64_t bits; double num; } u;
+    if (d != d) return EMBER_NANBOX_CANONICAL_NAN;
+    u.num = d;
+    return u.bits;
+}
+#endif
+
 // Hash map entry structure
 typedef struct {
     ember_value key;
     ember_value value;
+    uint32_t hash;      // Cached hash_value(key), valid while occupied
     int is_occupied;
 } ember_hash_entry;
 
 // Hash map object structure
+//
+// Open-addressing "Swiss table": one control byte per slot (empty, deleted or
+// the low 7 hash bits of a full slot) is probed a group at a time with SSE2 or
+// NEON, and capacity is always a power of two. `entries` stays a dense slot
+// array so callers may iterate 0..capacity checking is_occupied. Deletes leave
+// tombstones that are purged by an in-place rehash, and sparse tables shrink.
 typedef struct {
     ember_object obj;
     ember_hash_entry* entries;
+    uint8_t* ctrl;  // Control bytes, one per slot (padded to a full probe group)
     int length;     // Number of occupied entries
-    int capacity;   // Total capacity
+    int capacity;   // Total capacity (power of two)
+    int tombstones; // Deleted slots still marking probe chains
 } ember_hash_map;
 
 // Exception types for built-in exceptions
@@ -374,6 +543,12 @@ typedef struct {
     ember_value locals;       // Local variables at the time of exception (for debugging)
 } ember_stack_frame;
 
+// Raw stack trace entry, captured at throw time and symbolized on demand
+typedef struct {
+    ember_chunk* chunk;       // Chunk that was running (owned by the program, not the exception)
+    int offset;               // Bytecode offset within chunk
+} ember_trace_entry;
+
 // Enhanced exception object structure
 typedef struct {
     ember_object obj;
@@ -385,6 +560,8 @@ typedef struct {
     int column_number;                    // Column number where exception occurred
     ember_stack_frame* stack_frames;      // Stack trace frames
     int stack_frame_count;                // Number of stack frames
+    ember_trace_entry* trace;             // Innermost first; turned into stack_frames when read
+    int trace_count;                      // Number of trace entries not yet symbolized
     ember_value cause;                    // Cause of this exception (nested exceptions)
     ember_value data;                     // Additional data attached to exception
     uint64_t timestamp;                   // When the exception was created
@@ -398,13 +575,22 @@ typedef struct {
     ember_string* name;                    // Class name
     ember_hash_map* methods;               // Method table
     struct ember_class* superclass;       // Parent class (NULL for root classes)
+    ember_hash_map* method_cache;          // Methods with inherited ones flattened in (src/core/vm_methods.c)
+    uint64_t method_cache_epoch;           // vm->method_epoch method_cache was built at
+    struct ember_shape* shape_root;        // Field layouts of its instances (src/core/object_shape.h)
+    int instance_slots_hint;               // Most fields an instance has reached; sizes new instances
 } ember_class;
 
-// Instance object structure  
+// Instance object structure (fields through ember_instance_get_field/set_field)
 typedef struct {
     ember_object obj;
     ember_class* klass;                    // Class definition
-    ember_hash_map* fields;                // Instance fields
+    struct ember_shape* shape;             // Field layout; NULL in dictionary mode
+    ember_value* slots;                    // Field values in shape order: inline_slots until outgrown
+    int slot_capacity;
+    int inline_capacity;
+    ember_hash_map* fields;                // Dictionary mode only
+    ember_value inline_slots[];
 } ember_instance;
 
 // Method object structure (bound method)
@@ -414,6 +600,14 @@ typedef struct {
     ember_value method;                    // The function value
 } ember_bound_method;
 
+// Function object structure (boxed function/native value, see EMBER_NAN_BOXING)
+typedef struct {
+    ember_object obj;
+    ember_chunk* chunk;                    // Bytecode for script functions (NULL for natives)
+    char* name;                            // Function name (owned)
+    ember_value (*native)(ember_vm* vm, int argc, ember_value* argv); // Native entry point (NULL for script functions)
+} ember_function;
+
 // Promise states
 typedef enum {
     PROMISE_PENDING,
@@ -435,20 +629,24 @@ typedef struct {
 typedef enum {
     GENERATOR_CREATED,
     GENERATOR_SUSPENDED,
+    GENERATOR_RUNNING,
     GENERATOR_COMPLETED
 } ember_generator_state;
 
-// Generator object structure
+// Generator object structure: a suspended call whose frame lives on the
+// heap between resumes (src/core/vm_generators.c)
 typedef struct {
     ember_object obj;
     ember_generator_state state;
     ember_chunk* chunk;                    // Function bytecode
-    uint8_t* ip;                          // Current instruction pointer
-    ember_value* locals;                   // Local variable state
+    uint8_t* ip;                          // Resume point, just past the last OP_YIELD
+    ember_value* frame;                    // Locals, then the saved stack segment; allocated once
+    int frame_capacity;
     int local_count;                       // Number of locals
-    ember_value* stack;                    // Generator stack state
-    int stack_top;                         // Stack pointer
+    int stack_top;                         // Saved stack values above the locals
     ember_value yielded_value;             // Last yielded value
+    ember_vm* vm;                          // Owning VM, so iterators can resume it
+    int depth;                             // Entry frame index while running
 } ember_generator;
 
 // Set object structure
@@ -458,10 +656,17 @@ typedef struct {
     int size;                              // Number of elements in set
 } ember_set;
 
-// Map object structure
+// Map object structure: an insertion-ordered compact dictionary, laid out
+// as CPython's dict. entries is dense and in insertion order, a deleted
+// pair leaving a hole (is_occupied 0) until the next rebuild; index is a
+// sparse open-addressed table of positions into entries
 typedef struct {
     ember_object obj;
-    ember_hash_map* entries;               // Internal hash map for key-value storage
+    ember_hash_entry* entries;             // capacity slots, the first count used
+    int32_t* index;                        // index_capacity slots: a position, or empty / deleted
+    int count;                             // Entries used, holes included
+    int capacity;
+    int index_capacity;                    // Power of two, kept at most 2/3 full
     int size;                              // Number of key-value pairs in map
 } ember_map;
 
@@ -471,7 +676,8 @@ typedef enum {
     REGEX_CASE_INSENSITIVE = 1,
     REGEX_MULTILINE = 2,
     REGEX_GLOBAL = 4,
-    REGEX_DOTALL = 8
+    REGEX_DOTALL = 8,
+    REGEX_LINEAR = 16          // Linear-time engine (regex_linear.c); all patterns with EMBER_LINEAR_REGEX
 } ember_regex_flags;
 
 // Regex match result
@@ -484,9 +690,9 @@ typedef struct {
 // Regex object structure
 typedef struct {
     ember_object obj;
-    char* pattern;                         // Original regex pattern
+    char* pattern;                         // Original regex pattern, owned by the program
     ember_regex_flags flags;               // Regex flags
-    void* compiled_regex;                  // Compiled regex (implementation specific)
+    void* compiled_regex;                  // Shared compiled program (regex_program, vm_regex.c)
     ember_array* groups;                   // Array of capture groups from last match
     int last_index;                        // Last match position (for global matching)
 } ember_regex;
@@ -497,9 +703,24 @@ typedef enum {
     ITERATOR_SET,
     ITERATOR_MAP_KEYS,
     ITERATOR_MAP_VALUES,
-    ITERATOR_MAP_ENTRIES
+    ITERATOR_MAP_ENTRIES,
+    ITERATOR_GENERATOR,                    // Resumes the generator for each value
+    ITERATOR_REGEX,                        // Finds the next match of regex in the string
+    ITERATOR_FILE_LINES,                   // Reads the next line of the file
+    ITERATOR_WALK,                         // Takes the next path the walker found
+    // Lazy pipeline stages (iter_pipeline.c): collection is the source
+    // iterator, pulled one value at a time
+    ITERATOR_PIPE_MAP,                     // step(value, index) for each value
+    ITERATOR_PIPE_FILTER,                  // Values for which step(value, index) is truthy
+    ITERATOR_PIPE_TAKE,                    // The first length values
+    ITERATOR_PIPE_SKIP,                    // All but the first length values
+    ITERATOR_PIPE_ZIP,                     // [a, b] pairs from collection and step
+    ITERATOR_PIPE_CHUNK                    // Arrays of up to length values
 } ember_iterator_type;
 
+#define ITERATOR_PIPE_PENDING 1            // pending holds a value iterator_done pulled ahead
+#define ITERATOR_PIPE_FAILED  2            // A callback failed; the pipeline has ended
+
 // Iterator result structure
 typedef struct {
     ember_value value;                     // Current value
@@ -514,8 +735,189 @@ typedef struct {
     int index;                             // Current position
     int capacity;                          // Collection capacity (for optimization)
     int length;                            // Collection length
+    ember_value regex;                     // ITERATOR_REGEX: the pattern; index is a byte offset
+    struct ember_vm* vm;                   // ITERATOR_REGEX, _FILE_LINES, _WALK, _PIPE_*: allocates the values
+    ember_value step;                      // ITERATOR_PIPE_*: the callback, or ZIP's second source
+    ember_value pending;
+    int pipe_flags;                        // ITERATOR_PIPE_PENDING, ITERATOR_PIPE_FAILED
 } ember_iterator;
 
+// String builder: bytes appended in place with doubling growth, handed to
+// an ember_string without a copy when the output is done
+typedef struct {
+    ember_object obj;
+    char* chars;                           // NULL until the first append
+    size_t length;
+    size_t capacity;
+} ember_string_builder;
+
+// Streaming SHA-2 digest or HMAC, fed chunk by chunk (crypto_simple.c)
+typedef struct {
+    ember_object obj;
+    void* state;                           // libcrypto context; NULL once digested
+    bool keyed;                            // HMAC rather than a plain digest
+    bool finished;
+    uint64_t length;                       // Bytes fed so far
+} ember_hasher;
+
+// How a writer makes its bytes durable
+typedef enum {
+    FILE_SYNC_NONE,                        // Left to the page cache
+    FILE_SYNC_DATA,                        // fdatasync after every flush
+    FILE_SYNC_DIRECT                       // O_DIRECT: whole blocks bypass the page cache
+} ember_file_sync;
+
+// File read a line or chunk at a time, or written, through one reusable
+// buffer (file_handle.c)
+typedef struct {
+    ember_object obj;
+    int fd;                                // -1 once closed
+    char* buffer;                          // Unread bytes are [start, end); a writer's pending ones [0, end)
+    size_t start;
+    size_t end;
+    size_t capacity;                       // Grows only for lines longer than it
+    bool eof;
+    bool writing;
+    bool failed;                           // A write failed; the writer refuses more
+    ember_file_sync sync;
+} ember_file;
+
+// Directory walk run by background threads (fs_walk.c)
+typedef struct {
+    ember_object obj;
+    void* state;                           // Threads, queues and glob; NULL once released
+} ember_walker;
+
+// Element types of a typed array
+typedef enum {
+    EMBER_TYPED_FLOAT64,
+    EMBER_TYPED_INT32,
+    EMBER_TYPED_UINT8
+} ember_typed_kind;
+
+// Fixed-length array of unboxed numbers in one contiguous buffer
+// (typed_array.c). Stores convert like JavaScript's typed arrays: int32 and
+// uint8 truncate toward zero and wrap, and NaN and infinities become 0
+typedef struct {
+    ember_object obj;
+    void* data;                            // length elements of kind, zeroed when created
+    int length;
+    ember_typed_kind kind;
+} ember_typed_array;
+
+// Element index of array as a number; index must be in range
+static inline double ember_typed_array_load(const ember_typed_array* array, int index) {
+    switch (array->kind) {
+        case EMBER_TYPED_INT32: return ((const int32_t*)array->data)[index];
+        case EMBER_TYPED_UINT8: return ((const uint8_t*)array->data)[index];
+        default:                return ((const double*)array->data)[index];
+    }
+}
+
+// value wrapped into the int32 range, for values outside it
+int32_t ember_typed_wrap_int32(double value);
+
+static inline void ember_typed_array_store(ember_typed_array* array, int index, double value) {
+    if (array->kind == EMBER_TYPED_FLOAT64) {
+        ((double*)array->data)[index] = value;
+        return;
+    }
+    int32_t integer = value > -2147483649.0 && value < 2147483648.0 ? (int32_t)value
+                                                                    : ember_typed_wrap_int32(value);
+    if (array->kind == EMBER_TYPED_INT32) {
+        ((int32_t*)array->data)[index] = integer;
+    } else {
+        ((uint8_t*)array->data)[index] = (uint8_t)integer;
+    }
+}
+
+// Entry of an LRU cache, on its bucket's chain and on the recency list
+typedef struct ember_cache_entry {
+    ember_value key;
+    ember_value value;
+    struct ember_cache_entry* chain;       // Next in the same bucket
+    struct ember_cache_entry* newer;       // Toward the most recently used
+    struct ember_cache_entry* older;       // Toward the least recently used
+    int64_t expires_ms;                    // Monotonic clock; 0 for never
+    size_t bytes;                          // Estimated when stored, counted against max_bytes
+    uint32_t hash;
+} ember_cache_entry;
+
+// Key-value cache bounded by entries, bytes or both, evicting the least
+// recently used entry (lru_cache.c). A chained hash index finds entries,
+// which are also on a doubly linked list from newest to oldest use, so get,
+// put and eviction are O(1). Entries may carry a TTL
+typedef struct {
+    ember_object obj;
+    ember_cache_entry** buckets;           // bucket_count chains
+    int bucket_count;                      // Power of two, grown to keep size within it
+    int size;
+    ember_cache_entry* newest;
+    ember_cache_entry* oldest;             // Evicted first
+    ember_cache_entry* spare;              // Last entry freed, reused by the next put
+    int max_entries;                       // 0 for no bound
+    size_t max_bytes;                      // 0 for no bound
+    size_t bytes;
+    uint64_t hits;
+    uint64_t misses;                       // Expired entries included
+    uint64_t evictions;                    // Pushed out by the bounds
+    uint64_t expirations;                  // Dropped past their TTL
+} ember_cache;
+
+// Double-ended queue in a ring buffer (queue.c): pushes and pops at either
+// end are amortized O(1), and elements are indexable from either end
+typedef struct {
+    ember_object obj;
+    ember_value* items;                    // capacity slots; the elements wrap around from head
+    int head;
+    int length;
+    int capacity;                          // Power of two, or 0 before the first push
+} ember_deque;
+
+// Element of a priority queue
+typedef struct {
+    ember_value value;
+    ember_value priority;                  // A number, unless the queue has a comparator
+    uint64_t sequence;                     // Push order, so equal priorities pop first in, first out
+} ember_heap_item;
+
+// Priority queue on a 4-ary min-heap (queue.c). Priorities are numbers
+// compared in line, or anything a comparator orders
+typedef struct {
+    ember_object obj;
+    ember_heap_item* items;                // Heap order: the children of i are 4i + 1 .. 4i + 4
+    int length;
+    int capacity;
+    ember_value compare;                   // cmp(a, b) on priorities, negative when a goes first; nil for numbers
+    uint64_t next_sequence;
+    bool busy;                             // Inside compare, when the queue must not change
+} ember_priority_queue;
+
+// Weak reference (weak_ref.c): holds its target without keeping it alive,
+// and reads nil once the collector has found nothing else that does
+typedef struct {
+    ember_object obj;
+    ember_value target;                    // nil once collected
+    int weak_index;                        // Slot in vm->gc_weak
+} ember_weak_ref;
+
+typedef struct {
+    ember_value key;                       // nil for an empty slot
+    ember_value value;
+} ember_weak_entry;
+
+// Map from objects, by identity, to values (weak_ref.c). Entries are
+// ephemerons: the key is held weakly and the value only while the key is
+// alive, so a value that refers back to its own key keeps nothing alive.
+// Open addressing with linear probing and backward-shift deletion
+typedef struct {
+    ember_object obj;
+    ember_weak_entry* entries;
+    int capacity;                          // Power of two, or 0 before the first set
+    int count;
+    int weak_index;                        // Slot in vm->gc_weak
+} ember_weak_map;
+
 // Exception handler structure for try/catch/finally
 typedef struct {
     uint8_t* try_start;         // Start of try block
@@ -605,6 +1007,78 @@ typedef struct ember_error {
 typedef ember_value (*ember_native_func)(ember_vm* vm, int argc, ember_value* argv);
 
 // Bytecode chunk structure
+// Inline cache entry for an OP_GET_GLOBAL/OP_SET_GLOBAL name constant
+typedef struct {
+    uint32_t epoch;  // vm->globals_epoch the slot was resolved against; 0 = empty
+    int slot;        // Index into vm->globals
+} ember_global_cache;
+
+// Type feedback for one profiled instruction (src/core/vm_feedback.c)
+#define EMBER_FEEDBACK_TARGETS 4
+
+typedef enum {
+    EMBER_FEEDBACK_UNINITIALIZED,
+    EMBER_FEEDBACK_MONOMORPHIC,   // One target seen
+    EMBER_FEEDBACK_POLYMORPHIC,   // Up to EMBER_FEEDBACK_TARGETS
+    EMBER_FEEDBACK_MEGAMORPHIC    // More; targets are no longer recorded
+} ember_feedback_state;
+
+typedef struct {
+    int offset;                   // Code offset of the instruction
+    uint8_t opcode;
+    uint8_t state;                // ember_feedback_state
+    uint8_t target_count;
+    uint32_t hits;
+    uint32_t left_types;          // 1 << ember_val_type for each left operand, receiver or callee seen
+    uint32_t right_types;         // Right operands of arithmetic and comparisons
+    // Call: callee chunk or native. OP_INVOKE: receiver class. Property:
+    // receiver shape id. Arithmetic and comparisons: operand type pair
+    uint64_t targets[EMBER_FEEDBACK_TARGETS];
+} ember_feedback_slot;
+
+// Exception table entry (src/core/vm_exceptions.c): a throw from an
+// instruction in [start, end) resumes at handler
+typedef enum {
+    EMBER_HANDLER_CATCH,    // handler is the OP_CATCH_BEGIN of the try
+    EMBER_HANDLER_FINALLY   // handler is an OP_FINALLY_BEGIN that rethrows afterwards
+} ember_handler_kind;
+
+// Line table run: code from offset start up to the next run's start was
+// compiled from the statement starting at line and column (0 if unknown)
+typedef struct {
+    int start;
+    int line;
+    int column;
+} ember_line_run;
+
+typedef struct {
+    int start;        // Code offsets
+    int end;
+    int handler;
+    int stack_depth;  // Values the enclosing statements keep above the frame's stack base
+    int kind;         // ember_handler_kind
+} ember_handler_entry;
+
+// Switch jump table (src/core/vm_switch.c): case i matches constant keys[i],
+// a number or string, and its body starts at code offset targets[i]; other
+// subjects resume at default_target (the default clause or the end of the
+// switch). The index over the keys is built from them, never stored
+typedef struct {
+    int* keys;                  // Constant indices
+    int* targets;
+    int count;
+    int default_target;
+    int* slots;                 // Case index + 1, 0 = empty
+    int slot_count;             // Dense: max - min + 1; hashed: power of two
+    uint32_t* displacements;    // Perfect hash seed per bucket, NULL if dense or probed
+    int bucket_count;
+    double dense_min;           // Dense: integer subject n is at slot n - dense_min
+    uint8_t dense;              // Integer keys filling most of their range
+} ember_switch_table;
+
+// Source of a function body not compiled yet (src/frontend/parser/statements.c)
+typedef struct ember_lazy_body ember_lazy_body;
+
 struct ember_chunk {
     uint8_t* code;
     int capacity;
@@ -612,19 +1086,63 @@ struct ember_chunk {
     ember_value* constants;
     int const_capacity;
     int const_count;
+    int* const_index;                  // Open-addressed constant + 1 (0 = empty), see ember_chunk_find_constant
+    int const_index_capacity;          // Power of two
+    int const_indexed;                 // Constants entered in const_index so far
+    ember_global_cache* global_cache;  // One entry per constant, allocated on first global access
+    int global_cache_count;
+    struct ember_property_cache* property_cache;  // Per name constant, allocated on first property access
+    int property_cache_count;
+    ember_handler_entry* handlers;     // Exception table, innermost try blocks first
+    int handler_count;
+    int handler_capacity;
+    ember_switch_table* switch_tables; // OP_SWITCH_TABLE operands
+    int switch_table_count;
+    int switch_table_capacity;
+    int code_borrowed;                 // code belongs to a shared module image; never freed or grown
+    int is_generator;                  // fn* body: calling it makes a generator instead of running it
+    uint32_t jit_counter;              // Calls and loop iterations counted toward compilation
+    struct ember_jit_code* jit_code;   // Baseline JIT native code, or NULL
+    int jit_blacklisted;               // Compilation failed or its guards kept failing
+    ember_feedback_slot* feedback;     // Type feedback, one slot per profiled instruction
+    int feedback_count;
+    int feedback_capacity;
+    uint16_t* feedback_index;          // Parallel to code: slot + 1 at an instruction's offset, 0 = none
+    int feedback_index_length;
+    uint32_t osr_profile_budget;       // Back edges left to profile after a loop got hot, 0 = not profiling
+    int osr_profiled;                  // A hot loop already profiled this chunk
+    int warm_checked;                  // Looked up in vm->warm_profile already
+    uint8_t* line_table;               // Source positions by code offset, delta-encoded runs (line_table.c)
+    int line_table_length;
+    int line_table_capacity;
+    int line_count;                    // Runs in line_table, one per statement
+    int line_last_at;                  // Byte offset of the last run, which the compiler may rewrite
+    ember_line_run line_last;
+    ember_line_run* lines;             // All runs decoded, built by the first lookup
+    char* name;                        // Function name for profilers and perf, NULL if anonymous
+    ember_lazy_body* lazy_body;        // Body compiled on first call, or NULL once it has code
 };
 
+// One exported binding; named imports resolve to its index once
+typedef struct {
+    char* key;
+    ember_value value;
+    uint32_t hash;                // hash_string_chars(key)
+} ember_module_export_slot;
+
 // Module structure for library loading
 struct ember_module {
     char* name;
     char* path;
     ember_chunk* chunk;
     int is_loaded;
-    struct {
-        char* key;
-        ember_value value;
-    } exports[EMBER_MAX_LOCALS];
+    uint32_t hash;                     // hash_string_chars(name)
+    ember_module_export_slot* exports; // Grown on demand
     int export_count;
+    int export_capacity;
+    int* export_index;                 // Open-addressed key -> slot + 1 (0 = empty)
+    int export_index_capacity;         // Power of two
+    struct ember_module_image* image;  // Shared compiled image chunk runs from, or NULL
 };
 
 // Virtual filesystem mount point structure
@@ -632,6 +1150,7 @@ struct ember_mount_point {
     char* virtual_path;      // Virtual path in Ember (e.g., "/app")
     char* host_path;         // Real filesystem path (e.g., "/home/user/project")
     int flags;               // EMBER_MOUNT_RW or EMBER_MOUNT_RO
+    int dir_fd;              // Host directory held open for ember_vfs_open, or -1
 };
 
 // Runtime loop context for proper break/continue handling
@@ -640,32 +1159,126 @@ typedef struct {
     uint8_t* loop_end;       // End of loop (for break) - set when loop completes
     int stack_depth;         // Stack depth when loop started (for cleanup)
     int local_count;         // Local variable count when loop started
+    uint32_t back_edges;     // OP_LOOP jumps taken since the loop started (on-stack replacement)
 } ember_runtime_loop_context;
 
+// Caller state saved by OP_CALL; restored by OP_RETURN
+typedef struct {
+    ember_chunk* chunk;      // Caller's chunk
+    uint8_t* return_ip;      // Where the caller resumes
+    int local_base;          // Caller's slot 0 in vm->locals
+    int local_count;         // Locals in use below the callee's slots
+    int stack_base;          // vm->stack_top below the callee's arguments
+    int entry;               // Pushed by ember_call: returning hands control back to C
+} ember_frame;
+
 // Ember VM structure
 struct ember_vm {
     ember_chunk* chunk;
     uint8_t* ip; // Instruction pointer
     ember_value stack[EMBER_STACK_MAX];
     int stack_top;
-    ember_value locals[EMBER_MAX_LOCALS];
+    ember_value locals[EMBER_LOCALS_MAX];
     int local_count;
-    struct {
+    int local_base;     // locals[] index of slot 0 in the running function's frame
+    ember_frame* frames;   // Allocated by the first call, grown up to EMBER_MAX_FRAMES
+    int frame_count;    // Active Ember calls; 0 while running top-level code
+    int frame_capacity;
+    // Global variables: slots are append-only, so an index stays valid for the VM's lifetime
+    struct ember_global {
         char* key;
         ember_value value;
-    } globals[EMBER_MAX_LOCALS];
+        uint32_t hash;              // hash_string_chars(key)
+    }* globals;
     int global_count;
+    int global_capacity;
+    int* global_index;              // Open-addressed name -> slot + 1 (0 = empty)
+    int global_index_capacity;      // Power of two
+    uint32_t globals_epoch;         // Identifies this table to chunk inline caches; 0 = not initialized
     
     // Module system
-    ember_module modules[EMBER_MAX_MODULES];
+    ember_module** modules;         // Registry, in load order; entries never move
     int module_count;
+    int module_capacity;
+    int* module_index;              // Open-addressed name -> module + 1 (0 = empty)
+    int module_index_capacity;      // Power of two
     char* module_paths[8];
     int module_path_count;
+    struct ember_module_prefetch* module_prefetch;  // Units compiled ahead by ember_prefetch_imports
+    int defer_imports;              // Parse import statements without loading (prefetch workers)
     
     // Garbage collection
     ember_object* objects;
-    int bytes_allocated;
-    int next_gc;
+    int64_t bytes_allocated;
+    int64_t next_gc;                 // Set by the trigger policy (src/core/gc_policy.c)
+    
+    // Generational collection (gc_configure): young objects are the prefix of
+    // objects allocated since the last collection
+    int gc_generational;
+    int64_t gc_nursery_bytes;        // Bytes allocated since the last collection
+    int64_t gc_nursery_limit;        // Minor collection threshold
+    int gc_minor_requested;          // Nursery full; collect at the next safe point
+    ember_object** gc_remembered;    // Old objects that were given young references
+    int gc_remembered_count;
+    int gc_remembered_capacity;
+    ember_object** gc_weak;          // Every weak reference and weak map, cleared after marking
+    int gc_weak_count;
+    int gc_weak_capacity;
+    uint64_t gc_minor_collections;
+    uint64_t gc_objects_promoted;
+    int gc_request_heap;             // Pool release drops what the request allocated
+    ember_object** gc_gray;          // Marked objects whose children are not traced yet
+    int gc_gray_count;
+    int gc_gray_capacity;
+    
+    // Incremental collection (gc_configure): a full cycle is spread over
+    // steps of at most gc_step_budget_us, run at safe points
+    int gc_incremental;
+    int gc_phase;                    // GC_PHASE_* in src/core/gc_trace.h
+    int gc_step_budget_us;
+    int64_t gc_step_bytes;           // Allocated since the last step
+    int gc_step_requested;
+    ember_object* gc_sweep_list;     // Objects of the cycle not swept yet
+    ember_object* gc_sweep_survivors;
+    ember_object** gc_sweep_tail;    // Last next link of gc_sweep_survivors
+    uint64_t gc_incremental_steps;
+    uint64_t gc_max_step_us;
+    int gc_mark_threads;             // Markers for unbudgeted marking; <= 1 is serial
+    int gc_lazy_sweep;               // Triggered collections leave sweeping to allocation
+    
+    // Full collection trigger (ember_gc_configure_policy)
+    double gc_heap_growth;           // next_gc over the bytes a full collection kept
+    int64_t gc_min_heap;             // next_gc never drops below this
+    int gc_min_interval_ms;          // Pace full collections at the allocation rate; 0 = off
+    int gc_max_pause_us;             // Pause target; 0 = none
+    int64_t gc_live_bytes;           // Kept by the last full collection
+    double gc_alloc_rate;            // Bytes per millisecond, smoothed over collections
+    uint64_t gc_last_full_us;
+    uint64_t gc_last_pause_us;
+    int64_t gc_cycle_bytes;          // bytes_allocated when the incremental cycle started
+    uint64_t gc_cycle_pause_us;      // Longest step of the incremental cycle
+    int64_t gc_cycle_freed;          // Bytes the incremental cycle has swept so far
+
+    // Telemetry (src/core/gc_stats.c)
+    struct ember_gc_telemetry* gc_telemetry;        // Created by the first collection
+    uint64_t gc_survivors[EMBER_GC_OBJECT_TYPES];   // Kept so far by the collection under way
+    int gc_alloc_sample_every;       // ember_gc_sample_allocations
+    int gc_alloc_sample_countdown;   // Allocations until the next sample; 0 = not sampling
+
+    uint64_t method_epoch;           // Bumped by every method definition and inherit
+    
+    // Small object headers (src/core/object_slab.c), one list per size class
+    struct ember_slab* slab_partial[EMBER_SLAB_CLASSES];
+    int slab_count;
+    int huge_pages;                  // Slabs come from 2 MB regions (ember_vm_set_huge_pages)
+    struct ember_slab_region* slab_regions;     // Regions with slabs left to hand out
+    int slab_region_count;
+    
+    // Object pooling (gc_configure): recycled headers per pooled type
+    int gc_object_pooling;
+    ember_object* gc_pool_free[EMBER_POOLED_TYPES];
+    int gc_pool_count[EMBER_POOLED_TYPES];
+    uint64_t gc_pool_hits;
     
     // Function chunk tracking
     ember_chunk* function_chunks[EMBER_MAX_LOCALS];
@@ -675,6 +1288,7 @@ struct ember_vm {
     struct ember_mount_point* mounts;
     int mount_count;
     int mount_capacity;
+    struct ember_vfs_index* vfs_index;     // Mount trie and resolved-path cache (vfs.c)
     
     // Exception handling
     ember_exception_handler exception_handlers[EMBER_MAX_EXCEPTION_HANDLERS];
@@ -702,8 +1316,8 @@ struct ember_vm {
     int loop_depth;                                // Current loop nesting depth
     
     // Debugging support
-    void* debug_hooks;              // Debug hooks structure (ember_debug_hooks*)
-    int debug_enabled;              // Whether debugging is enabled
+    void* debug_hooks;              // Attached debugger and its patched sites (vm_debug.c), or NULL
+    int debug_enabled;              // A debugger is attached
     
     // Memory management context
     void* memory_context;           // VM memory management context (vm_memory_context*)
@@ -713,24 +1327,59 @@ struct ember_vm {
     ember_value* async_stack;        // Stack for async operation context
     int async_stack_top;             // Async stack pointer
     int is_async_context;            // Whether we're in an async function context
+    struct ember_event_loop* event_loop; // Microtasks, suspended frames, timers; allocated on first use
+    struct ember_http_client* http_client; // curl multi state for http.fetch; freed with the event loop
     
     // Generator support
     ember_generator* current_generator; // Currently executing generator (if any)
     
+    // Baseline JIT (src/core/jit): off unless enabled with ember_jit_configure
+    void* jit_integration;              // Unused (always NULL)
+    bool jit_enabled;                   // Compile hot chunks to native code
+    uint32_t jit_threshold;             // Calls + loop iterations before compiling (0 = default)
+    uint64_t jit_deopts;                // Native runs that fell back on a failed guard
+    bool type_feedback;                 // Record operand types and targets per instruction
+    bool osr_disabled;                  // Hot loops never switch to optimized code mid-run
+    uint32_t osr_threshold;             // Back edges of one loop before it is optimized (0 = default)
+    int64_t fuel;                       // Charges left before vm_fuel_exhausted runs (vm_fuel.c)
+    int64_t fuel_slice;                 // What the tank holds (ember_vm_set_fuel), 0 for no budget
+    int fuel_mode;                      // ember_fuel_mode
+    void (*fuel_hook)(struct ember_vm* vm, void* userdata);   // Run when a slice is used up in yield mode
+    void* fuel_hook_data;
+    uint64_t fuel_exhausted;            // Slices used up so far
+    uint64_t osr_entries;               // Loops that got hot and were optimized in place
+    struct ember_warm_profile* warm_profile;  // Loaded functions not yet matched to a chunk (warm_profile.c)
+    bool profiling;                     // Record every instruction into profile
+    struct ember_profile* profile;      // Results of ember_vm_set_profiling, or NULL
+    volatile sig_atomic_t sample_pending; // SIGPROF ticks not yet sampled (vm_sampler.c)
+    struct ember_sampler* sampler;      // Stacks from ember_vm_start_sampling, or NULL
+    char* json_buffer;                  // json_stringify and serialize output, kept between calls
+    size_t json_buffer_capacity;
+    struct ember_regex_cache* regex_cache;  // Compiled patterns for ember_make_regex (vm_regex.c)
+    struct ember_template_cache* template_cache;  // Compiled templates (template_engine.c)
+    struct ember_datetime_cache* datetime_cache;  // Compiled format patterns (datetime.c)
+    struct ember_output* output;        // print's buffer, or NULL until the first print (output.c)
+    uint32_t stdlib_pending;            // Stdlib modules whose init_* waits for first use (interface_registry.c)
+    struct ember_eval_cache* eval_cache;  // Compiled scripts for ember_compile/ember_eval_memoized (eval_cache.c)
+    struct ember_executor* executor;    // Workers for parallel_map/filter/reduce, or NULL (parallel_array.c)
+    struct ember_native_table* native_table;  // ember_register_native metadata, or NULL (vm_natives.c)
+    bool lazy_functions;                // Function definitions defer compiling their bodies (statements.c)
+
     // Performance optimization support (EXPERIMENTAL - not yet functional)
     // These fields exist for future integration but are currently unused:
-    void* jit_integration;              // JIT compiler integration (always NULL)
-    bool jit_enabled;                   // Whether JIT compilation is enabled (always false)
     void* arena_allocator;              // Arena allocator for memory optimization (always NULL)
     bool memory_optimized;              // Whether memory optimization is enabled (always false)
     void* vm_pool_context;              // VM pool context for concurrent execution (minimal functionality)
     bool vm_pool_enabled;               // Whether VM pool is enabled (basic support only)
+    int stack_high;                     // Highest stack_top and local_count seen since the
+    int locals_high;                    // pool last scrubbed this VM (vm_note_high_water)
     
     // Performance statistics
     uint64_t instructions_executed;     // Total instructions executed
     uint64_t function_calls;            // Total function calls made
     uint64_t jit_compilations;          // Number of JIT compilations triggered
     uint64_t memory_allocations;        // Number of memory allocations
+    uint64_t memory_allocated_bytes;    // Their total size; collections never lower it
     uint64_t gc_collections;            // Number of garbage collections
 };
 
@@ -740,10 +1389,65 @@ void ember_free_vm(ember_vm* vm);
 void ember_register_func(ember_vm* vm, const char* name, ember_native_func func);
 int ember_eval(ember_vm* vm, const char* source);
 int ember_call(ember_vm* vm, const char* func_name, int argc, ember_value* argv);
+
+// Function handles: resolve a global function once, then call it repeatedly
+// with the return value handed back directly (nothing is left on the stack).
+// ember_function_args returns a buffer of argc slots owned by the handle and
+// reused across calls. Release handles before freeing their VM.
+typedef struct ember_function_handle ember_function_handle;
+ember_function_handle* ember_function_resolve(ember_vm* vm, const char* func_name);
+ember_value* ember_function_args(ember_function_handle* handle, int argc);
+int ember_function_call(ember_function_handle* handle, int argc, ember_value* argv, ember_value* result);
+void ember_function_release(ember_function_handle* handle);
+
+// Call handle once per row of an n x argc argument matrix, writing results[i];
+// returns the number of rows completed (stops at the first error) or -1
+int ember_call_batch(ember_vm* vm, ember_function_handle* handle, int n, int argc,
+                     ember_value* argv_matrix, ember_value* results);
+
+// Described natives (src/core/vm_natives.c). ember_register_native binds name
+// like ember_register_func and tells the VM what it may assume. Calls with
+// the wrong argument count, or an argument outside its type mask, return nil
+// without entering the function, as the builtins answer bad arguments. The
+// flags are promises the VM trusts: NO_GC natives are called without a GC
+// safe point, ROPES natives get their string arguments unflattened (they
+// use ember_string_bytes/ember_string_flatten themselves), and PURE and
+// NO_THROW are kept for the optimizer and the JIT to rely on.
+#define EMBER_NATIVE_PURE      (1u << 0)  // No side effects; the result depends only on the arguments
+#define EMBER_NATIVE_NO_GC     (1u << 1)  // Allocates nothing on the VM's heap
+#define EMBER_NATIVE_NO_THROW  (1u << 2)  // Never raises or sets an error
+#define EMBER_NATIVE_ROPES     (1u << 3)  // Takes string arguments as they are
+#define EMBER_NATIVE_VARIADIC  (-1)       // max_args without an upper bound
+#define EMBER_NATIVE_TYPED_ARGS 4         // Leading arguments with a type mask
+#define EMBER_TYPE_MASK(type) (1u << (type))
+
+typedef struct {
+    ember_native_func func;
+    int min_args;
+    int max_args;                                 // Or EMBER_NATIVE_VARIADIC
+    uint32_t arg_types[EMBER_NATIVE_TYPED_ARGS];  // EMBER_TYPE_MASKs per argument; 0 = any
+    uint32_t flags;                               // EMBER_NATIVE_*
+} ember_native_info;
+
+int ember_register_native(ember_vm* vm, const char* name, const ember_native_info* info);
+// What the VM knows about func, or NULL if it was registered plainly
+const ember_native_info* ember_native_describe(ember_vm* vm, ember_native_func func);
+
 ember_value ember_make_number(double num);
 ember_value ember_make_bool(int b);
 ember_value ember_make_string(const char* str);
 ember_value ember_make_string_gc(ember_vm* vm, const char* str);
+// Binary-safe strings from host bytes, which may contain NULs. _len copies
+// length bytes. _external references the host's buffer instead: chars[length]
+// must be a readable NUL byte, as every flat Ember string is NUL-terminated,
+// and the bytes must stay unchanged until release(chars, length, userdata)
+// runs when the string is collected or its VM freed. release must not call
+// into the VM. Short strings, and buffers without the NUL, are copied and
+// released at once. Both return nil on failure, after release has run.
+typedef void (*ember_string_release)(const char* chars, size_t length, void* userdata);
+ember_value ember_make_string_len(ember_vm* vm, const char* chars, size_t length);
+ember_value ember_make_string_external(ember_vm* vm, const char* chars, size_t length,
+                                       ember_string_release release, void* userdata);
 ember_value ember_make_array(ember_vm* vm, int capacity);
 ember_value ember_make_hash_map(ember_vm* vm, int capacity);
 ember_value ember_make_exception(ember_vm* vm, const char* type, const char* message);
@@ -774,6 +1478,8 @@ const char* ember_exception_type_to_string(ember_exception_type type);
 
 // Exception stack trace utilities
 void ember_capture_stack_trace(ember_vm* vm, ember_exception* exc);
+// Builds exc->stack_frames from the captured trace (no-op once done)
+void ember_exception_symbolize(ember_vm* vm, ember_exception* exc);
 void ember_print_exception_details(ember_vm* vm, ember_exception* exc);
 int ember_exception_matches_type(ember_exception* exc, ember_exception_type type);
 
@@ -782,13 +1488,52 @@ ember_value ember_wrap_exception(ember_vm* vm, ember_value original, const char*
 ember_value ember_get_root_cause(ember_value exception);
 ember_value ember_make_class(ember_vm* vm, const char* name);
 ember_value ember_make_instance(ember_vm* vm, ember_class* klass);
+// Instance fields; get returns 1 and fills out if name is a field, set
+// returns 0 if out of memory
+int ember_instance_get_field(ember_instance* instance, ember_value name, ember_value* out);
+int ember_instance_set_field(ember_vm* vm, ember_instance* instance, ember_value name, ember_value value);
+int ember_instance_field_count(ember_instance* instance);
+// Method tables; define methods and superclasses through these so flattened
+// lookups stay valid. find returns nil if klass has no such method.
+ember_value ember_class_find_method(ember_vm* vm, ember_class* klass, ember_value name);
+int ember_class_define_method(ember_vm* vm, ember_class* klass, ember_value name, ember_value method);
+int ember_class_inherit(ember_vm* vm, ember_class* klass, ember_class* superclass);
 ember_value ember_make_bound_method(ember_vm* vm, ember_value receiver, ember_value method);
 ember_value ember_make_promise(ember_vm* vm);
 ember_value ember_make_generator(ember_vm* vm, ember_chunk* chunk);
 ember_value ember_make_set(ember_vm* vm);
 ember_value ember_make_map(ember_vm* vm);
 ember_value ember_make_regex(ember_vm* vm, const char* pattern, ember_regex_flags flags);
+ember_value ember_make_string_builder(ember_vm* vm, size_t capacity);
+// A zero-filled typed array of length elements, or nil
+ember_value ember_make_typed_array(ember_vm* vm, ember_typed_kind kind, int length);
 ember_value ember_make_nil(void);
+// A callable value, not a heap object: the native when native is set, else
+// chunk with a malloc'd copy of name
+ember_value ember_make_function_value(ember_chunk* chunk, const char* name, ember_native_func native);
+
+// Rope strings: materialize the bytes of a (possibly lazy) string, and flatten
+// every string argument before handing argv to a native function
+const char* ember_string_flatten(ember_string* string);
+// length bytes of parent from start, sharing parent's bytes when the result
+// is long enough to be lazy; parent must be reachable while this allocates.
+// NULL if the range is out of bounds or memory runs out
+ember_string* ember_string_slice(ember_vm* vm, ember_string* parent, int start, int length);
+// The bytes of a flat string or slice without materializing it (not
+// NUL-terminated for a slice); NULL for a rope
+const char* ember_string_bytes(const ember_string* string);
+void ember_flatten_string_args(int argc, ember_value* argv);
+
+#ifdef EMBER_NAN_BOXING
+// Compact value codec: to_packed stores the packed form of nil, a boolean,
+// a number or a GC object (a bound method included) in *packed and returns
+// 1; it returns 0 for a script function or native value, which has none, and
+// allocates nothing. Legacy ember_make_string values must be converted with
+// ember_make_string_gc first. from_packed is the inverse; an OBJ_FUNCTION
+// comes back as the function or native value it boxes
+int ember_value_to_packed(ember_value value, ember_packed_value* packed);
+ember_value ember_value_from_packed(ember_packed_value packed);
+#endif
 
 // Utility functions
 const char* value_type_to_string(ember_val_type type);
@@ -805,6 +1550,9 @@ ember_value set_union(ember_vm* vm, ember_set* set1, ember_set* set2);
 ember_value set_intersection(ember_vm* vm, ember_set* set1, ember_set* set2);
 ember_value set_difference(ember_vm* vm, ember_set* set1, ember_set* set2);
 int set_is_subset(ember_set* subset, ember_set* superset);
+int set_union_with(ember_vm* vm, ember_set* target, ember_set* source);
+int set_retain_all(ember_vm* vm, ember_set* target, ember_set* other);
+ember_value set_from_array(ember_vm* vm, ember_array* array);
 
 // Map operations  
 int map_set(ember_map* map, ember_value key, ember_value value);
@@ -818,12 +1566,250 @@ ember_value map_keys(ember_vm* vm, ember_map* map);
 ember_value map_values(ember_vm* vm, ember_map* map);
 ember_value map_entries(ember_vm* vm, ember_map* map);
 
+// LRU cache operations (src/runtime/lru_cache.c)
+// An empty cache; 0 leaves a bound off. Nil if out of memory
+ember_value ember_make_cache(ember_vm* vm, int max_entries, size_t max_bytes);
+// Sets *value and makes the entry the most recently used: 1, a hit, or 0,
+// a miss, if key is absent or has expired
+int lru_cache_get(ember_cache* cache, ember_value key, ember_value* value);
+// Whether key is present, without counting it or changing its recency
+int lru_cache_has(ember_cache* cache, ember_value key);
+// Stores value under key as the most recently used entry, expiring ttl_ms
+// from now (0 for never), then evicts the least recently used past the
+// bounds. 0 if frozen, out of memory, or the entry alone exceeds max_bytes
+int lru_cache_put(ember_vm* vm, ember_cache* cache, ember_value key, ember_value value, int64_t ttl_ms);
+int lru_cache_delete(ember_cache* cache, ember_value key);
+void lru_cache_clear(ember_cache* cache);
+// Drops every expired entry, returning how many there were
+int lru_cache_prune(ember_cache* cache);
+
+// Deque and priority queue operations (src/runtime/queue.c)
+// An empty deque with room for capacity elements, or nil
+ember_value ember_make_deque(ember_vm* vm, int capacity);
+// 0 if frozen or out of memory
+int deque_push_back(ember_vm* vm, ember_deque* deque, ember_value value);
+int deque_push_front(ember_vm* vm, ember_deque* deque, ember_value value);
+// 0 if empty or frozen
+int deque_pop_back(ember_deque* deque, ember_value* value);
+int deque_pop_front(ember_deque* deque, ember_value* value);
+// Element index from the front, which must be in range
+static inline ember_value deque_at(const ember_deque* deque, int index) {
+    return deque->items[(deque->head + index) & (deque->capacity - 1)];
+}
+// An empty priority queue ordered by compare, or by number priorities if it is nil
+ember_value ember_make_priority_queue(ember_vm* vm, ember_value compare);
+// Adds value at priority: 1, or 0 if frozen, out of memory or priority is
+// no number (NaN included) in a queue without compare. -1 if compare
+// failed: value is queued, though maybe out of order
+int priority_queue_push(ember_vm* vm, ember_priority_queue* queue, ember_value value, ember_value priority);
+// Takes the value first in priority order: 1, or 0 if empty or frozen.
+// -1 with the value if compare failed while reordering the rest
+int priority_queue_pop(ember_vm* vm, ember_priority_queue* queue, ember_value* value);
+
+// Weak reference and weak map operations (src/runtime/weak_ref.c). Only
+// heap objects can be targets and keys; strings are not keys, since two
+// equal strings are not always one object
+// A weak reference to target, already cleared if target is nil, or nil
+// if target is any other value that is no heap object
+ember_value ember_make_weak_ref(ember_vm* vm, ember_value target);
+ember_value ember_make_weak_map(ember_vm* vm);
+// 1 with the value stored under key, 0 if there is none
+int weak_map_get(const ember_weak_map* map, ember_value key, ember_value* value);
+// 0 if key cannot be one, the map is frozen, or out of memory
+int weak_map_set(ember_vm* vm, ember_weak_map* map, ember_value key, ember_value value);
+int weak_map_delete(ember_weak_map* map, ember_value key);
+// Empties slot, moving later entries of its probe run back into it; for
+// the collector, which clears the entries of dead keys
+void weak_map_remove_slot(ember_weak_map* map, int slot);
+
+// String builder operations (src/runtime/string_builder.c). A builder on
+// the C stack works too: zero it, append, then take or reset it
+// Room for extra more bytes, so the appends that follow do not reallocate
+bool string_builder_reserve(ember_string_builder* builder, size_t extra);
+bool string_builder_append(ember_string_builder* builder, const char* chars, size_t length);
+bool string_builder_appendf(ember_string_builder* builder, const char* format, ...);
+// The bytes so far as a string, leaving the builder empty; NULL if out of memory
+ember_string* string_builder_take(ember_vm* vm, ember_string_builder* builder);
+// Empties the builder and releases its buffer
+void string_builder_reset(ember_string_builder* builder);
+// Frees a hasher's libcrypto context; called by the GC
+void ember_hasher_release(ember_hasher* hasher);
+// Flushes a writer, closes the file and frees its buffer; called by
+// file_close and the GC. False if pending bytes could not be written
+bool ember_file_release(ember_file* file);
+// The next line of the file without its line ending, or nil at the end
+ember_value ember_file_read_line(ember_vm* vm, ember_file* file);
+// True once no bytes are left, reading ahead to find out
+bool ember_file_at_end(ember_file* file);
+// Stops a walk's threads and frees it; called by the GC
+void ember_walker_release(ember_walker* walker);
+// The next path the walk found, waiting for one, or nil once it is over
+ember_value ember_walker_next(ember_vm* vm, ember_walker* walker);
+// True once the walk is over and every path has been taken
+bool ember_walker_done(ember_walker* walker);
+// Fills out with bytes from the OS CSPRNG, buffered per thread; false if
+// the OS source fails
+bool ember_secure_random_bytes(void* out, size_t length);
+
 // Regex operations
 int regex_test(ember_regex* regex, const char* text);
 ember_array* regex_match(ember_vm* vm, ember_regex* regex, const char* text);
 ember_value regex_replace(ember_vm* vm, ember_regex* regex, const char* text, const char* replacement);
 ember_array* regex_split(ember_vm* vm, ember_regex* regex, const char* text);
 
+// VM string operation handlers
+vm_operation_result vm_handle_concat_n(ember_vm* vm, int count);
+
+// Global variable table
+int ember_global_find(ember_vm* vm, const char* name, int length);
+int ember_global_define(ember_vm* vm, const char* name, ember_value value);
+void ember_globals_free(ember_vm* vm);
+// Module registry (vm_modules.c). find returns NULL for an unknown name,
+// add returns the existing entry if there is one
+ember_module* ember_module_find(ember_vm* vm, const char* name);
+ember_module* ember_module_add(ember_vm* vm, const char* name);
+// Export slot of key[0..length) in module, or -1; define returns the slot
+int ember_module_export_find(ember_module* module, const char* key, int length);
+int ember_module_export_define(ember_module* module, const char* key, ember_value value);
+void ember_modules_free(ember_vm* vm);
+// Releases every inline cache of chunk (globals and properties), its type
+// feedback, its line table, its uncompiled body and its name
+void ember_chunk_free_global_cache(ember_chunk* chunk);
+// Type feedback (src/core/vm_feedback.c), recorded while enabled with
+// ember_vm_set_type_feedback. feedback_at returns the slot of the
+// instruction at offset or NULL; print lists every slot on stdout
+void ember_vm_set_type_feedback(ember_vm* vm, int enable);
+const ember_feedback_slot* ember_chunk_feedback_at(const ember_chunk* chunk, int offset);
+void ember_chunk_print_feedback(const ember_chunk* chunk);
+void ember_chunk_free_feedback(ember_chunk* chunk);
+// Warm-start profiles (src/core/warm_profile.c). save writes the type
+// feedback and call counts of every function vm has compiled to path, keyed
+// by the main script's source and this build; load reads such a file and
+// hands each function's part to the chunk with the same name and code, at
+// once for those compiled already and for the rest on their first call, so
+// a new process quickens, skips OSR profiling and JIT-compiles where the
+// last one left off. A profile of another source or build loads nothing and
+// fails with EMBER_ERROR_OPERATION_FAILED, as a missing or damaged one does
+int ember_vm_save_warm_profile(ember_vm* vm, const char* source, const char* path);
+int ember_vm_load_warm_profile(ember_vm* vm, const char* source, const char* path);
+// Line tables (src/core/line_table.c). The compiler marks the position of
+// each statement as it starts emitting it (mark_line: column unknown);
+// position_at returns the line of the code at offset, or 0, and its column
+// in *column. run_at is the index of the run containing offset, or -1, in
+// line_runs, which are all line_count runs (NULL if none); lookups decode
+// the table on first use. set_line_table installs the line_table bytes of a
+// chunk with the same code after checking them, 0 if malformed
+void ember_chunk_mark_position(ember_chunk* chunk, int line, int column);
+void ember_chunk_mark_line(ember_chunk* chunk, int line);
+int ember_chunk_position_at(const ember_chunk* chunk, int offset, int* column);
+int ember_chunk_line_at(const ember_chunk* chunk, int offset);
+int ember_chunk_line_run_at(const ember_chunk* chunk, int offset);
+const ember_line_run* ember_chunk_line_runs(const ember_chunk* chunk);
+int ember_chunk_set_line_table(ember_chunk* chunk, const uint8_t* data, int length);
+void ember_chunk_free_lines(ember_chunk* chunk);
+// Name the function chunk compiles (copied); the first name sticks, so a
+// function later stored under another name keeps its own
+void ember_chunk_set_name(ember_chunk* chunk, const char* name);
+// Lazy function bodies (src/frontend/parser/statements.c). While enabled,
+// top-level function definitions only scan their body and keep its source
+// in chunk->lazy_body; calls compile it first with compile_lazy
+// (EMBER_SUCCESS at once if the chunk has code). A syntax error sets the VM
+// error and returns EMBER_ERROR_OPERATION_FAILED, leaving the body to fail
+// again on the next call. compile_lazy_functions compiles every pending
+// body of vm. The body is freed with the chunk's caches
+void ember_vm_set_lazy_functions(ember_vm* vm, int enable);
+int ember_chunk_compile_lazy(ember_vm* vm, ember_chunk* chunk);
+int ember_vm_compile_lazy_functions(ember_vm* vm);
+void ember_chunk_free_lazy_body(ember_chunk* chunk);
+// Constant pool index (src/core/constant_pool.c): find returns the slot of
+// an equal nil, boolean, number or string (-1 if none is pooled yet), add
+// reuses that slot or appends; free by free_chunk
+int ember_chunk_find_constant(ember_chunk* chunk, ember_value value);
+int ember_chunk_add_constant(ember_chunk* chunk, ember_value value);
+void ember_chunk_free_constant_index(ember_chunk* chunk);
+// Exception tables; add returns the entry's index or -1, find the innermost
+// entry covering a code offset or NULL
+int ember_chunk_add_handler(ember_chunk* chunk, const ember_handler_entry* entry);
+const ember_handler_entry* ember_chunk_find_handler(const ember_chunk* chunk, int offset);
+void ember_chunk_free_handlers(ember_chunk* chunk);
+// Switch tables; add reserves an empty one (so OP_SWITCH_TABLE can name it
+// before the case bodies are compiled) and returns its index or -1, set
+// copies the cases in and builds the index (0 on failure), target returns
+// the code offset subject resumes at
+int ember_chunk_add_switch_table(ember_chunk* chunk);
+int ember_chunk_set_switch_table(ember_chunk* chunk, int index, const int* keys, const int* targets,
+                                 int count, int default_target);
+int ember_switch_table_target(const ember_chunk* chunk, const ember_switch_table* table, ember_value subject);
+void ember_chunk_free_switch_tables(ember_chunk* chunk);
+// VM operation handler for OP_SWITCH_TABLE: pops the subject, *target is
+// where to resume
+vm_operation_result vm_handle_switch_table(ember_vm* vm, ember_chunk* chunk, int table, int* target);
+// VM operation handler for OP_BREAKPOINT: stops in the debugger if the site
+// asks to, then *original is the opcode to execute in the breakpoint's place
+// (with ip still at the instruction's operands)
+vm_operation_result vm_handle_breakpoint(ember_vm* vm, ember_chunk* chunk, uint8_t* instruction, uint8_t* original);
+
+// VM global variable operation handlers
+vm_operation_result vm_handle_get_global(ember_vm* vm, ember_chunk* chunk, int constant);
+vm_operation_result vm_handle_set_global(ember_vm* vm, ember_chunk* chunk, int constant);
+
+// VM superinstruction handlers (number fast paths; VM_RESULT_CONTINUE asks the
+// dispatch loop to run the unfused sequence instead)
+vm_operation_result vm_handle_arith_local_const(ember_vm* vm, ember_chunk* chunk, uint8_t op, int slot, int constant);
+vm_operation_result vm_handle_compare_local_const(ember_vm* vm, ember_chunk* chunk, uint8_t op, int slot, int constant, int* result);
+
+// Quickened opcode handler (fast path for the operand types the site was
+// specialized for; VM_RESULT_CONTINUE asks the dispatch loop to run
+// opcode_generic of the instruction instead). instruction points at the
+// opcode, which a type miss rewrites back to the generic form
+vm_operation_result vm_handle_quickened(ember_vm* vm, ember_chunk* chunk, uint8_t* instruction);
+
+// Type feedback recording (dispatch loop, through vm_dispatch_feedback):
+// whether op is profiled, and record the operands of the instruction at
+// offset before it runs. operand is the argument count of calls and
+// OP_INVOKE, ignored otherwise
+int vm_feedback_profiled(uint8_t op);
+void vm_feedback_record(ember_vm* vm, ember_chunk* chunk, int offset, uint8_t op, int operand);
+// Merge a slot another process recorded (warm_profile.c) into the slot of
+// the same instruction and quicken it if it qualifies; 0 if the code there
+// is not saved->opcode
+int vm_feedback_restore(ember_chunk* chunk, const ember_feedback_slot* saved);
+// Rewrite the instruction a monomorphic feedback slot describes into its
+// quickened form, if it has one
+void vm_quicken(ember_chunk* chunk, const ember_feedback_slot* slot);
+
+// VM call frame handlers. Calls switch vm->chunk/vm->ip in place instead of
+// recursing into ember_run; vm_handle_return returns VM_RESULT_CONTINUE when
+// ember_run should return (top-level code or an ember_call entry frame)
+vm_operation_result vm_handle_call(ember_vm* vm, int argc);
+vm_operation_result vm_handle_tail_call(ember_vm* vm, int argc);
+// OP_CALL_GUARD: *inlined is 1 (callee popped) when the callee on the stack
+// is the function chunk->constants[constant], 0 (stack untouched) otherwise
+vm_operation_result vm_handle_call_guard(ember_vm* vm, ember_chunk* chunk, int constant, int* inlined);
+// OP_INVOKE fast path; VM_RESULT_CONTINUE means run the bound-method path
+vm_operation_result vm_handle_invoke(ember_vm* vm, int argc);
+
+// VM property handlers with per-site inline caches (src/core/vm_properties.c).
+// vm_handle_get_property returns VM_RESULT_CONTINUE for anything but an
+// instance field (methods, builtin properties), leaving the stack untouched
+vm_operation_result vm_handle_get_property(ember_vm* vm, ember_chunk* chunk, int constant);
+vm_operation_result vm_handle_set_property(ember_vm* vm, ember_chunk* chunk, int constant);
+vm_operation_result vm_handle_return(ember_vm* vm);
+int vm_push_entry_frame(ember_vm* vm, ember_chunk* chunk, int argc, ember_value* argv);
+void vm_unwind_frames(ember_vm* vm, int frame_count);
+// Releases vm->frames (ember_free_vm)
+void vm_frames_free(ember_vm* vm);
+vm_operation_result vm_handle_throw(ember_vm* vm);
+// Generators (src/core/vm_generators.c). OP_YIELD suspends the running
+// generator, returning the yielded value from its resume like
+// vm_handle_return; OP_GENERATOR_NEXT replaces a generator on the stack
+// with its next value and a done flag
+vm_operation_result vm_handle_yield(ember_vm* vm);
+vm_operation_result vm_handle_generator_next(ember_vm* vm);
+// OP_AWAIT (src/core/event_loop.c): a pending promise suspends the running
+// function, which returns its result promise like vm_handle_return
+vm_operation_result vm_handle_await(ember_vm* vm);
+
 // VM collection operation handlers
 vm_operation_result vm_handle_set_new(ember_vm* vm);
 vm_operation_result vm_handle_set_add(ember_vm* vm);
@@ -838,6 +1824,10 @@ vm_operation_result vm_handle_map_has(ember_vm* vm);
 vm_operation_result vm_handle_map_delete(ember_vm* vm);
 vm_operation_result vm_handle_map_size(ember_vm* vm);
 vm_operation_result vm_handle_map_clear(ember_vm* vm);
+// OP_ARRAY_GET and OP_ARRAY_SET on a typed array, read and written unboxed;
+// VM_RESULT_CONTINUE for any other receiver, leaving the stack untouched
+vm_operation_result vm_handle_typed_array_get(ember_vm* vm);
+vm_operation_result vm_handle_typed_array_set(ember_vm* vm);
 
 // VM regex operation handlers
 vm_operation_result vm_handle_regex_new(ember_vm* vm);
@@ -852,6 +1842,10 @@ int values_equal(ember_value a, ember_value b);
 
 // Array operation functions needed by stdlib
 void array_push(ember_array* array, ember_value value);
+int array_reserve(ember_array* array, int min_capacity);
+int array_extend(ember_vm* vm, ember_array* array, ember_array* source);
+int array_splice(ember_vm* vm, ember_array* array, int start, int delete_count, const ember_value* items,
+                 int item_count, ember_value* removed);
 
 // Enhanced Array methods for functional programming
 void array_foreach(ember_vm* vm, ember_array* array, ember_value callback);
@@ -873,12 +1867,18 @@ ember_value set_iterator(ember_vm* vm, ember_set* set);
 ember_value map_keys_iterator(ember_vm* vm, ember_map* map);
 ember_value map_values_iterator(ember_vm* vm, ember_map* map);
 ember_value map_entries_iterator(ember_vm* vm, ember_map* map);
+// Pipeline stages (iter_pipeline.c), called by iterator_next and iterator_done
+ember_iterator_result iterator_pipe_next(ember_iterator* iterator);
+int iterator_pipe_done(ember_iterator* iterator);
 
 // Hash map operation functions needed by stdlib
 ember_hash_map* allocate_hash_map(ember_vm* vm, int capacity);
 void hash_map_set(ember_hash_map* map, ember_value key, ember_value value);
 void hash_map_set_with_vm(ember_vm* vm, ember_hash_map* map, ember_value key, ember_value value);
 ember_value hash_map_get(ember_hash_map* map, ember_value key);
+int hash_map_delete(ember_hash_map* map, ember_value key);
+int hash_map_reserve(ember_hash_map* map, int count);
+void hash_map_clear(ember_hash_map* map);
 
 // Performance optimization API
 void vm_set_optimization_level(int level); // 0=none, 1=basic, 2=advanced, 3=max
@@ -889,29 +1889,197 @@ void ember_gc_configure(ember_vm* vm, int enable_generational, int enable_increm
                         int enable_write_barriers, int enable_object_pooling);
 void ember_gc_print_statistics(ember_vm* vm);
 void ember_gc_collect(ember_vm* vm);
-
-// Startup optimization and performance profiling API
+// Work budget of one incremental collection step, in microseconds
+void ember_gc_set_step_budget(ember_vm* vm, int microseconds);
+// Mark full collections with this many threads (0: one per online CPU)
+void ember_gc_set_mark_threads(ember_vm* vm, int threads);
+// Return from triggered full collections once marking is done and sweep a
+// little on every allocation afterwards; see src/core/gc_incremental.c
+void ember_gc_set_lazy_sweep(ember_vm* vm, int enable);
+// When full collections start; see src/core/gc_policy.c
+typedef struct {
+    double heap_growth;         // Collect once the heap is this multiple of what survived (> 1, default 2)
+    int64_t min_heap_bytes;     // Never collect a smaller heap (default 1 MB)
+    int min_interval_ms;        // Keep full collections this far apart at the allocation rate; 0 = off
+    int max_pause_us;           // Pause target: the step budget, and overruns switch to incremental; 0 = off
+} ember_gc_policy;
+void ember_gc_configure_policy(ember_vm* vm, const ember_gc_policy* policy);
+void ember_gc_get_policy(ember_vm* vm, ember_gc_policy* policy);
+
+// GC telemetry; see src/core/gc_stats.c
+#define EMBER_GC_PAUSE_BUCKETS 24   // pauses[0]: under 1 us, pauses[i]: [2^(i-1), 2^i) us, the last: longer
+#define EMBER_GC_HISTORY 32
+typedef enum {
+    EMBER_GC_MINOR,
+    EMBER_GC_FULL,              // Stop the world
+    EMBER_GC_INCREMENTAL        // Incremental, parallel or lazily swept, ember_gc_collect included
+} ember_gc_kind;
 typedef struct {
-    double vm_creation_time;      // Time to create VM structure
+    ember_gc_kind kind;
+    uint64_t pause_us;          // The whole collection; the longest step of an incremental one
+    int64_t bytes_allocated;    // Since the previous collection
+    int64_t bytes_freed;
+    int64_t bytes_live;         // Heap size after it
+    uint64_t survivors;         // Objects kept (promoted, for a minor collection)
+} ember_gc_collection;
+typedef struct {
+    uint64_t collections;
+    uint64_t pauses[EMBER_GC_PAUSE_BUCKETS];   // Collections and incremental steps
+    uint64_t pause_count;
+    uint64_t total_pause_us;
+    uint64_t max_pause_us;
+    int64_t total_allocated;
+    int64_t total_freed;
+    ember_gc_kind survivors_kind;               // Of the last collection:
+    uint64_t survivors_by_type[EMBER_GC_OBJECT_TYPES];
+    int history_count;
+    ember_gc_collection history[EMBER_GC_HISTORY];   // The last collections, oldest first
+} ember_gc_stats;
+typedef struct {
+    ember_chunk* chunk;         // Identifies the code only, it may be gone; NULL outside Ember code
+    int offset;                 // Bytecode offset of the allocating instruction (a native's call site)
+    int line;                   // 0 if unknown
+    ember_object_type type;
+    uint64_t samples;           // Each stands for `every` allocations
+    int64_t bytes;              // Of the sampled objects
+} ember_gc_alloc_site;
+int ember_gc_get_stats(ember_vm* vm, ember_gc_stats* stats);
+// Clears the statistics and allocation sites collected so far
+void ember_gc_reset_stats(ember_vm* vm);
+const char* ember_gc_object_type_name(ember_object_type type);
+// Record the allocation site of every nth object; 0 stops
+int ember_gc_sample_allocations(ember_vm* vm, int every);
+// Fills up to max sites, most bytes first; returns how many there are
+int ember_gc_get_allocation_sites(ember_vm* vm, ember_gc_alloc_site* sites, int max);
+
+// Heap inspection; see src/core/heap_snapshot.c. Each finishes the collection
+// under way first. Bytes include the buffers an object owns
+typedef struct {
+    uint64_t count[EMBER_GC_OBJECT_TYPES];
+    uint64_t bytes[EMBER_GC_OBJECT_TYPES];
+    uint64_t total_count;
+    uint64_t total_bytes;
+} ember_heap_histogram;
+int ember_vm_heap_histogram(ember_vm* vm, ember_heap_histogram* histogram);
+// The histogram as a table, most bytes first; NULL or "-" writes to stderr
+int ember_vm_write_heap_histogram(ember_vm* vm, const char* path);
+// Every object and the references between them, in the .heapsnapshot format
+// of V8 (Chrome DevTools, Memory panel); NULL or "-" writes to stdout
+int ember_vm_write_heap_snapshot(ember_vm* vm, const char* path);
+
+// Startup optimization and performance profiling API.
+// The startup profile is process-wide and always on: each phase adds up over
+// every VM created and module imported since ember_startup_profile_begin (or
+// since the first of them). Times are in milliseconds
+#define EMBER_STARTUP_MODULES 32
+typedef struct {
+    char name[64];                // As imported
+    double resolve_time;          // Finding the file
+    double compile_time;          // Compiling, or loading prefetched or shared bytecode
+    double execute_time;          // Top-level code, less the modules it imports first
+} ember_startup_module;
+typedef struct {
+    double vm_creation_time;      // First VM: ember_new_vm until its builtins are registered
     double stdlib_init_time;      // Time to initialize standard library
     double parser_init_time;      // Time to initialize parser
     double vfs_init_time;         // Time to initialize VFS
     double gc_init_time;          // Time to initialize GC
-    double total_startup_time;    // Total startup time
+    double total_startup_time;    // Until ember_startup_profile_end, or so far
+    double module_resolve_time;   // All imports
+    double module_compile_time;
+    double module_execute_time;
+    int module_count;             // Imported; the first EMBER_STARTUP_MODULES are listed
+    ember_startup_module modules[EMBER_STARTUP_MODULES];
 } ember_startup_profile;
 
 ember_vm* ember_new_vm_optimized(int lazy_stdlib);  // VM with optional lazy stdlib loading
+// Clears the profile and starts the startup clock; call before ember_new_vm
+void ember_startup_profile_begin(void);
+// Startup is over (the host starts serving): fixes total_startup_time
+void ember_startup_profile_end(void);
 void ember_get_startup_profile(ember_startup_profile* profile);
 void ember_print_startup_profile(void);
 void ember_enable_lazy_loading(ember_vm* vm, int enable);
 
-// Bytecode caching API (placeholders)
+// Ahead-of-time compiled bytecode (.emberc files, see src/core/bytecode_format.h).
+// Both return 0 on success, like ember_eval
+int ember_compile_file(ember_vm* vm, const char* source_path, const char* output_path);
+int ember_run_bytecode_file(ember_vm* vm, const char* path);
+
+// Persistent bytecode cache. Once a directory is set (NULL disables it),
+// ember_eval_cached loads a unit compiled by an earlier run of the same source
+// instead of parsing it, and otherwise compiles, stores and runs it. It
+// behaves like ember_eval when no cache is configured. Module imports use it.
 void ember_set_bytecode_cache_dir(const char* cache_dir);
+int ember_eval_cached(ember_vm* vm, const char* source);
+
+// Compiled scripts: compile a source once, then run it any number of times
+// without lexing or parsing it again. ember_compile returns NULL on a compile
+// error; compiling the same text again returns the same script. Each run
+// binds the functions the source defines, like ember_eval, and returns 0 on
+// success. ember_eval_memoized evaluates through the same per-VM cache, which
+// keeps the most recently used 1024 sources. Release scripts before freeing
+// their VM; a script only runs on the VM that compiled it.
+typedef struct ember_script ember_script;
+ember_script* ember_compile(ember_vm* vm, const char* source);
+int ember_run_script(ember_script* script);
+void ember_script_release(ember_script* script);
+int ember_eval_memoized(ember_vm* vm, const char* source);
+void ember_eval_cache_stats(ember_vm* vm, uint64_t* hits, uint64_t* misses);
+
+// Structured clone: copies a value graph from one VM into another through a
+// compact binary message. Numbers, booleans, nil, strings, arrays, hash maps,
+// sets, maps, typed arrays and instances of named classes clone; shared
+// objects stay shared and cycles are kept. An instance is rebuilt with the
+// receiving VM's global class of the same name. Functions, natives and other
+// values fail. Encoded messages belong to no VM; free them with free().
+// Each call returns 0 on success, -1 on failure.
+int ember_clone_encode(ember_value value, uint8_t** data, size_t* size);
+int ember_clone_decode(ember_vm* vm, const uint8_t* data, size_t size, ember_value* out);
+int ember_clone_value(ember_value value, ember_vm* to, ember_value* out);
+
+// Channels carry cloned values between threads, each with its own VM,
+// through a bounded lock-free queue (any number of senders and receivers).
+// Neither call blocks. ember_channel_send returns 0 when queued, 1 when the
+// channel is full and -1 when it is closed or the value does not clone.
+// ember_channel_receive returns 0 with a value, 1 when nothing is queued
+// yet and -1 once the channel is closed and drained or a message is bad.
+// Capacity is rounded up to a power of two.
+typedef struct ember_channel ember_channel;
+ember_channel* ember_channel_create(int capacity);
+ember_channel* ember_channel_retain(ember_channel* channel);
+void ember_channel_release(ember_channel* channel);
+void ember_channel_close(ember_channel* channel);
+int ember_channel_send(ember_channel* channel, ember_value value);
+int ember_channel_receive(ember_channel* channel, ember_vm* vm, ember_value* out);
+
+// Frozen heap: ember_freeze copies a value graph, as ember_clone_value does,
+// into one immutable heap shared by the whole process. Any VM on any thread
+// may hold and read the copy directly; no collector traces it and it is
+// never freed, so it suits large read-only data loaded once. Returns 0 with
+// the frozen copy (a frozen value is its own copy), -1 when the graph does
+// not clone or has instances, whose classes belong to one VM.
+int ember_freeze(ember_value value, ember_value* out);
+int ember_value_is_frozen(ember_value value);
+void ember_frozen_heap_stats(size_t* objects, size_t* bytes);
 
 // Module/Library API functions
 int ember_import_module(ember_vm* vm, const char* module_name);
+// Compiles every module source imports, directly or not, on up to threads
+// worker threads (0 = one per CPU) before the script runs. ember_import_module
+// then links each precompiled unit, its own imports first, instead of
+// compiling it when reached. Returns the number of units compiled, -1 on error.
+int ember_prefetch_imports(ember_vm* vm, const char* source, int threads);
 int ember_install_library(const char* library_name, const char* source_path);
 char* ember_resolve_module_path(const char* module_name, const char* current_file);
+// Resolution results, misses included, are cached per process by specifier
+// and base directory. Call after adding, moving or deleting module files
+// (hot reload); ember_install_library does so itself.
+void ember_clear_module_resolution_cache(void);
+// Imported modules are compiled once per process into shared images that
+// every VM runs from (src/runtime/module_image.c). Images are recompiled
+// when their file changes; this drops them all, e.g. on hot reload.
+void ember_clear_module_images(void);
 void ember_add_module_path(ember_vm* vm, const char* path);
 
 // Virtual filesystem API functions
@@ -919,6 +2087,7 @@ int ember_vfs_mount(ember_vm* vm, const char* virtual_path, const char* host_pat
 int ember_vfs_unmount(ember_vm* vm, const char* virtual_path);
 char* ember_vfs_resolve(ember_vm* vm, const char* virtual_path);
 int ember_vfs_check_access(ember_vm* vm, const char* virtual_path, int write_access);
+int ember_vfs_open(ember_vm* vm, const char* virtual_path, int flags, int mode);
 void ember_vfs_init(ember_vm* vm);
 void ember_vfs_cleanup(ember_vm* vm);
 
@@ -953,6 +2122,28 @@ ember_value ember_native_ceil(ember_vm* vm, int argc, ember_value* argv);
 ember_value ember_native_round(ember_vm* vm, int argc, ember_value* argv);
 ember_value ember_native_pow(ember_vm* vm, int argc, ember_value* argv);
 ember_value ember_native_not(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_array_foreach(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_array_map(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_array_filter(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_array_reduce(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_array_find(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_array_some(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_array_every(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_array_reserve(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_array_extend(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_array_insert(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_array_splice(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_array_sort(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_array_sort_by(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_set_from_array(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_set_union(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_set_intersection(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_set_difference(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_set_union_with(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_set_retain_all(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_parallel_map(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_parallel_filter(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_parallel_reduce(ember_vm* vm, int argc, ember_value* argv);
 
 // Exception functions
 ember_value ember_native_is_exception(ember_vm* vm, int argc, ember_value* argv);
@@ -965,6 +2156,128 @@ ember_value ember_native_split(ember_vm* vm, int argc, ember_value* argv);
 ember_value ember_native_join(ember_vm* vm, int argc, ember_value* argv);
 ember_value ember_native_starts_with(ember_vm* vm, int argc, ember_value* argv);
 ember_value ember_native_ends_with(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_replace_all(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_string_builder(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_builder_append(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_builder_appendf(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_builder_length(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_builder_clear(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_builder_to_string(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_regex_match_all(ember_vm* vm, int argc, ember_value* argv);
+
+// MessagePack serialization (msgpack.c)
+ember_value ember_native_serialize(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_deserialize(ember_vm* vm, int argc, ember_value* argv);
+
+// Streaming hash functions
+ember_value ember_native_hasher(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_hasher_update(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_hasher_digest(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_file_open(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_file_read_line(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_file_read_chunk(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_file_lines(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_file_writer(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_file_write(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_file_flush(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_file_close(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_fs_walk(ember_vm* vm, int argc, ember_value* argv);
+
+// Typed arrays
+ember_value ember_native_float64_array(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_int32_array(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_uint8_array(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_typed_fill(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_typed_copy(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_typed_slice(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_typed_to_array(ember_vm* vm, int argc, ember_value* argv);
+
+// LRU caches
+ember_value ember_native_cache_new(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_cache_get(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_cache_has(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_cache_put(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_cache_delete(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_cache_size(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_cache_clear(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_cache_prune(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_cache_stats(ember_vm* vm, int argc, ember_value* argv);
+
+// Deques and priority queues
+ember_value ember_native_deque(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_deque_push_back(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_deque_push_front(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_deque_pop_back(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_deque_pop_front(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_deque_peek_back(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_deque_peek_front(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_deque_get(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_deque_clear(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_deque_to_array(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_priority_queue(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_pqueue_push(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_pqueue_pop(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_pqueue_peek(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_pqueue_clear(ember_vm* vm, int argc, ember_value* argv);
+
+// Weak references and weak maps
+ember_value ember_native_weak_ref(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_weak_ref_get(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_weak_map(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_weak_map_get(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_weak_map_set(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_weak_map_has(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_weak_map_delete(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_weak_map_size(ember_vm* vm, int argc, ember_value* argv);
+
+// Vector math over typed arrays
+ember_value ember_native_vmath_sum(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_vmath_dot(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_vmath_min(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_vmath_max(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_vmath_scale(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_vmath_add(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_vmath_mul(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_vmath_clamp(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_vmath_prefix_sum(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_vmath_sqrt(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_vmath_exp(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_vmath_log(ember_vm* vm, int argc, ember_value* argv);
+// Lazy iterator pipelines (iter_pipeline.c)
+ember_value ember_native_iter(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_iter_map(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_iter_filter(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_iter_take(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_iter_skip(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_iter_zip(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_iter_chunk(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_iter_collect(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_iter_reduce(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_iter_count(ember_vm* vm, int argc, ember_value* argv);
+// Dates and times with cached zones and format patterns (datetime.c)
+ember_value ember_native_datetime_now(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_datetime_timestamp(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_datetime_parse(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_datetime_format(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_datetime_add(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_datetime_diff(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_datetime_to_utc(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_datetime_from_utc(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_datetime_year(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_datetime_month(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_datetime_day(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_datetime_hour(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_datetime_minute(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_datetime_second(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_datetime_weekday(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_datetime_yearday(ember_vm* vm, int argc, ember_value* argv);
+// Buffered print and the structured logger (output.c, logger.c)
+ember_value ember_native_flush_output(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_log(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_log_flush(ember_vm* vm, int argc, ember_value* argv);
+
+ember_value ember_native_uuid_v4(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_uuid_v7(ember_vm* vm, int argc, ember_value* argv);
 
 // File I/O functions
 ember_value ember_native_read_file(ember_vm* vm, int argc, ember_value* argv);
@@ -978,6 +2291,54 @@ ember_value ember_native_num(ember_vm* vm, int argc, ember_value* argv);
 ember_value ember_native_int(ember_vm* vm, int argc, ember_value* argv);
 ember_value ember_native_bool(ember_vm* vm, int argc, ember_value* argv);
 
+// Event loop functions
+ember_value ember_native_delay(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_set_timeout(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_set_interval(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_clear_timeout(ember_vm* vm, int argc, ember_value* argv);
+// http.fetch, http.stream, http.download (src/runtime/http_fetch.c, built with libcurl)
+ember_value ember_native_http_fetch(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_http_stream(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_http_stream_json(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_http_download_async(ember_vm* vm, int argc, ember_value* argv);
+// db.connect, db.query, ... over pooled SQLite connections (src/runtime/database.c, built with SQLite)
+ember_value ember_native_db_connect(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_db_disconnect(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_db_query(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_db_batch(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_db_begin(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_db_commit(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_db_rollback(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_db_error(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_db_pool_stats(ember_vm* vm, int argc, ember_value* argv);
+// HTTP/1.1 server and the request/response and WebSocket natives its handlers call (src/runtime/http_server.c)
+ember_value ember_native_http_listen_and_serve(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_http_stop_server(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_request_get_method(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_request_get_path(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_request_get_query(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_request_get_header(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_request_get_body(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_response_set_status(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_response_set_header(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_response_write(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_response_end(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_response_send_file(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_websocket_upgrade(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_websocket_send(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_websocket_broadcast(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_websocket_close(ember_vm* vm, int argc, ember_value* argv);
+// Sessions shared by every VM in the process (src/runtime/session.c)
+ember_value ember_native_session_set(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_session_get(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_session_touch(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_session_delete(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_session_count(ember_vm* vm, int argc, ember_value* argv);
+void ember_register_session_native(ember_vm* vm);
+// gzip, br and zstd compression, each where the build has its library (src/runtime/compress.c)
+ember_value ember_native_compress(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_decompress(ember_vm* vm, int argc, ember_value* argv);
+
 // Secure VM Pool API
 // Error codes for VM pool operations
 #define EMBER_SUCCESS 0
@@ -1000,22 +2361,376 @@ typedef struct {
     uint32_t max_vms_per_thread;    // Max VMs per thread (validated range: 1-100)
     uint32_t rate_limit_window_ms;  // Rate limit window in ms (validated range: 100-86400000)
     uint32_t rate_limit_max_allocs; // Max allocations per window (validated range: 1-10000)
+    uint32_t rate_limit_global_allocs; // Max allocations per window across all threads (0 = no limit, else up to 1000000)
 } vm_pool_config_t;
 
-// Secure VM pool API functions
+// Counts since ember_pool_init, summed over every thread
+typedef struct {
+    uint64_t acquired;              // VMs handed out
+    uint64_t cache_hits;            // ...taken from the thread's cache
+    uint64_t shared_hits;           // ...taken from the shared idle stack
+    uint64_t created;               // ...built new, or cloned from the snapshot
+    uint64_t released;
+    uint64_t rate_limited;          // Gets refused by a rate limit
+    uint64_t exhausted;             // Gets refused by max_vms_per_thread
+} vm_pool_stats_t;
+
+// Secure VM pool API functions (src/core/vm_pool.c). get and release are
+// lock-free and may be called from any thread; max_vms_per_thread and
+// rate_limit_max_allocs apply to each calling thread (the rate as a token
+// bucket), rate_limit_global_allocs to the pool as a whole. init, cleanup
+// and set_snapshot must not overlap with gets or releases.
 int ember_pool_init(const vm_pool_config_t* config);
 void ember_pool_cleanup(void);
 ember_vm* ember_pool_get_vm(void);
 void ember_pool_release_vm(ember_vm* vm);
+void ember_pool_stats(vm_pool_stats_t* stats);
+// Request heap mode for pooled VMs: objects allocated between
+// ember_pool_get_vm and ember_pool_release_vm are freed on release unless
+// globals (or defined functions) still reach them, which promotes them
+void ember_vm_set_request_heap(ember_vm* vm, int enable);
+
+// print's output (src/runtime/output.c). Each VM buffers what it prints
+// and writes it to stdout once byte_limit bytes (0: at every print) or
+// line_limit lines (0: no limit) are waiting; the defaults are 8 KB and 64
+// lines, or every line when stdout is a terminal. Buffers are flushed when
+// the VM is freed or reset by the pool and at process exit.
+int ember_vm_set_output_buffering(ember_vm* vm, size_t byte_limit, int line_limit);
+int ember_vm_flush_output(ember_vm* vm);
+
+// Structured logger (src/runtime/logger.c), for the whole process. The
+// log native queues JSON lines for a background thread that writes them
+// to fd (stderr by default) in batches; records below level (info by
+// default) are skipped, and records arriving while the queue is full are
+// dropped and counted. flush waits for everything queued so far.
+typedef enum {
+    EMBER_LOG_DEBUG,
+    EMBER_LOG_INFO,
+    EMBER_LOG_WARN,
+    EMBER_LOG_ERROR,
+} ember_log_level;
+
+int ember_log_configure(int fd, ember_log_level level);
+int ember_log_flush(void);
+uint64_t ember_log_dropped(void);
+
+// Database connection pools (src/runtime/database.c), for the whole
+// process: at most max_connections open per database file (16 by default;
+// db.connect waits for one past that) and statement_cache prepared
+// statements kept per connection (64; 0 prepares every query afresh). Fails
+// with EMBER_ERROR_OPERATION_FAILED when built without SQLite
+int ember_db_configure(int max_connections, int statement_cache);
+
+// Session store (src/runtime/session.c): configure sets the lifetime of a
+// session stored without a ttl (1800 s by default); clear drops every
+// session, for tests and hosts reloading their state
+int ember_session_configure(double ttl_seconds);
+void ember_session_clear(void);
+
+// Baseline JIT (src/core/jit). Available on x86-64 and ARM64 builds with
+// ENABLE_JIT=1. Once enabled, a chunk is compiled after threshold calls
+// and loop iterations (0 = 1000); numeric locals, arithmetic, comparisons
+// and jumps run natively and everything else falls back to the
+// interpreter. Enabling fails with EMBER_ERROR_INVALID_PARAMETER when the
+// JIT is not built in.
+int ember_jit_available(void);
+int ember_jit_configure(ember_vm* vm, int enabled, int threshold);
+// Linux perf support (src/core/jit/jit_perf.c), for the whole process.
+// With EMBER_PERF_MAP every chunk the JIT compiles is listed by function
+// name in /tmp/perf-<pid>.map; with EMBER_PERF_JITDUMP its code and source
+// lines go to /tmp/jit-<pid>.dump for `perf inject --jit` (record with
+// `perf record -k mono`). 0 closes both. Without the JIT only 0 succeeds
+#define EMBER_PERF_MAP 1
+#define EMBER_PERF_JITDUMP 2
+int ember_jit_perf_enable(int flags);
+// On-stack replacement (src/core/vm_osr.c). A loop that takes threshold
+// back edges (0 = 500) without its function returning is optimized while it
+// runs: its chunk is profiled for a few iterations so its sites quicken, and
+// with the JIT enabled the next back edge enters native code at the loop
+// header. On by default; top-level loops benefit as much as functions
+int ember_vm_configure_osr(ember_vm* vm, int enabled, int threshold);
+// Instruction fuel (src/core/vm_fuel.c). Each OP_LOOP back edge and each
+// call into Ember code costs one unit of a tank holding slice units (0
+// removes the budget). When the tank runs dry, EMBER_FUEL_TIMEOUT throws a
+// TimeoutError and keeps the tank empty, so catch blocks can clean up but
+// not carry on looping; EMBER_FUEL_YIELD calls the yield hook, if any, at
+// that safe point and refills. Setting the fuel fills the tank; refuel
+// fills it again, between tasks. While a budget is set, JIT code is not
+// entered, because native loops have no back-edge check
+typedef enum {
+    EMBER_FUEL_TIMEOUT,
+    EMBER_FUEL_YIELD
+} ember_fuel_mode;
+typedef void (*ember_fuel_hook)(ember_vm* vm, void* userdata);
+int ember_vm_set_fuel(ember_vm* vm, int64_t slice, ember_fuel_mode mode);
+void ember_vm_refuel(ember_vm* vm);
+// The hook may run further code on vm (ember_eval, ember_function_call),
+// which gets slices of its own
+void ember_vm_set_fuel_hook(ember_vm* vm, ember_fuel_hook hook, void* userdata);
+// Huge pages (src/core/huge_pages.c). Object slabs taken from then on are
+// carved from 2 MB regions, reserved hugetlbfs pages when the system has
+// any and transparent huge pages otherwise, and array element buffers of
+// 2 MB or more are advised for transparent huge pages. Returns 1 if huge
+// pages are in use, 0 when disabled or unsupported, in which case slabs and
+// arrays are allocated as before. Call it before the heap grows
+int ember_vm_set_huge_pages(ember_vm* vm, int enable);
+
+// Execution profiler (src/core/vm_profiler.c). While enabled, every
+// instruction is counted and timed by opcode, calls are counted and timed
+// per function, and statements are counted per source line. Times are in
+// cycles of the CPU's timestamp counter (nanoseconds where there is none);
+// ns_per_cycle converts them. Disabling keeps the results until the VM is
+// freed or profiling is enabled again
+typedef struct {
+    uint64_t count;
+    uint64_t cycles;
+} ember_opcode_profile;
+
+typedef struct {
+    const ember_chunk* chunk;
+    char* name;                  // "<script>" for top-level code
+    uint64_t calls;
+    uint64_t inclusive_cycles;   // In the function and everything it called
+    uint64_t exclusive_cycles;   // In the function's own instructions
+    int active;                  // Activations on the stack (recursion)
+    uint64_t entered;            // When the outermost activation started
+} ember_function_profile;
+
+typedef struct {
+    const ember_chunk* chunk;
+    int function;                // Index into functions
+    int line;
+    uint64_t hits;               // Statements starting on the line that ran
+} ember_line_profile;
+
+typedef struct ember_profile {
+    ember_opcode_profile opcodes[256];  // By opcode
+    ember_function_profile* functions;
+    int function_count;
+    ember_line_profile* lines;
+    int line_count;
+    uint64_t instructions;
+    double ns_per_cycle;                // Measured over the profiled run
+    struct ember_profile_state* state;  // Recording state
+} ember_profile;
+
+int ember_vm_set_profiling(ember_vm* vm, int enable);
+const ember_profile* ember_vm_get_profile(ember_vm* vm);
+// Report the profile as text to path ("-" or NULL: stderr)
+int ember_vm_write_profile(ember_vm* vm, const char* path);
+
+// Sampling profiler (src/core/vm_sampler.c). Cheap enough for a live
+// process: hz times per second of CPU time (0 = 99) the running Ember call
+// stack is recorded. One VM per process samples at a time; starting while
+// another does fails with EMBER_ERROR_OPERATION_FAILED. Stopping keeps the
+// stacks until the VM is freed or sampling starts again. write_samples
+// prints them in collapsed-stack format ("outer;inner count" per line) for
+// flamegraph tools, to path ("-" or NULL: stderr)
+int ember_vm_start_sampling(ember_vm* vm, int hz);
+int ember_vm_stop_sampling(ember_vm* vm);
+uint64_t ember_vm_sample_count(ember_vm* vm);
+int ember_vm_write_samples(ember_vm* vm, const char* path);
+
+// Debugger (src/core/vm_debug.c). Breakpoints are patched into the code, so
+// a VM pays nothing for them until one is hit, and nothing at all without
+// a debugger attached. At a stop, callback gets the chunk and offset of the
+// instruction about to run and says how to go on. A step stops at the next
+// statement (in: also on entering any function; over: in this function or
+// its caller; out: once this function returned). Breakpoints are set at an
+// instruction offset, or at the first statement on line (or the next line
+// with one), which returns its offset. Sites live in the chunk's code: clear
+// a chunk's before freeing it while attached. opcode_at reads the opcode a
+// breakpoint covers (for disassemblers). Borrowed code can't be patched
+typedef enum {
+    EMBER_DEBUG_CONTINUE,
+    EMBER_DEBUG_STEP_IN,
+    EMBER_DEBUG_STEP_OVER,
+    EMBER_DEBUG_STEP_OUT
+} ember_debug_action;
+typedef ember_debug_action (*ember_debug_callback)(ember_vm* vm, ember_chunk* chunk, int offset, void* userdata);
+int ember_debug_attach(ember_vm* vm, ember_debug_callback callback, void* userdata);
+void ember_debug_detach(ember_vm* vm);
+int ember_debug_set_breakpoint(ember_vm* vm, ember_chunk* chunk, int offset);
+int ember_debug_set_line_breakpoint(ember_vm* vm, ember_chunk* chunk, int line);
+int ember_debug_clear_breakpoint(ember_vm* vm, ember_chunk* chunk, int offset);
+void ember_debug_clear_chunk(ember_vm* vm, ember_chunk* chunk);
+int ember_debug_opcode_at(ember_vm* vm, const ember_chunk* chunk, int offset);
+
+// VM snapshots (src/core/vm_snapshot.c). create freezes an initialized VM
+// (globals, loaded modules, the objects they reach) as a template: the VM
+// must not be used or freed afterwards, and stays the caller's if create
+// fails (it holds a value that can't be copied, such as a promise). Each
+// clone is a fresh, isolated VM that shares the template's bytecode and
+// copies the rest; clone may run on several threads at once. Free every
+// clone before the snapshot.
+typedef struct ember_vm_snapshot ember_vm_snapshot;
+ember_vm_snapshot* ember_vm_snapshot_create(ember_vm* vm);
+ember_vm* ember_vm_snapshot_clone(ember_vm_snapshot* snapshot);
+void ember_vm_snapshot_free(ember_vm_snapshot* snapshot);
+// Pool VMs become fresh clones of snapshot, and a released VM is freed
+// instead of reset; NULL goes back to reusing VMs
+void ember_pool_set_snapshot(ember_vm_snapshot* snapshot);
+
+// Script executor (src/core/executor.c): worker threads that each hold one
+// VM (from ember_pool_get_vm, or a new one) for their whole life, running
+// submitted tasks with work stealing. create runs prelude, if any, on every
+// worker's VM before returning (NULL if any worker fails to set up); workers
+// <= 0 means one per CPU. A call task runs a global function with argc
+// arguments that must be nil, booleans, numbers or strings. callback runs on
+// the worker thread with the worker's VM and may submit further tasks.
+// On a multi-node NUMA machine workers are pinned to nodes round-robin and
+// build their VMs on their node. destroy runs the tasks already submitted,
+// then releases the VMs.
+typedef struct ember_executor ember_executor;
+typedef void (*ember_task_callback)(ember_vm* vm, int status, ember_value result, void* userdata);
+ember_executor* ember_executor_create(int workers, const char* prelude);
+int ember_executor_submit_script(ember_executor* executor, const char* source,
+                                 ember_task_callback callback, void* userdata);
+int ember_executor_submit_call(ember_executor* executor, const char* func_name,
+                               int argc, const ember_value* argv,
+                               ember_task_callback callback, void* userdata);
+void ember_executor_wait(ember_executor* executor);
+void ember_executor_destroy(ember_executor* executor);
+// Give every task slice units of instruction fuel (see ember_vm_set_fuel);
+// 0, the default, lets tasks run unbounded. With EMBER_FUEL_TIMEOUT a task
+// that uses up its slice fails with a TimeoutError. With EMBER_FUEL_YIELD
+// it is preempted at a loop or call: the worker runs the tasks queued
+// behind it on the same VM, each with its own slices, then resumes it.
+// Tasks that can be preempted must not rely on globals staying put while
+// they run
+int ember_executor_set_fuel(ember_executor* executor, int64_t slice, ember_fuel_mode mode);
+// parallel_map, parallel_filter and parallel_reduce on vm split large arrays
+// across executor's workers (src/core/parallel_array.c). Their callback must
+// be a global function that executor's prelude defines too; NULL (the
+// default) runs them sequentially. The executor must outlive its use by vm
+void ember_vm_set_executor(ember_vm* vm, ember_executor* executor);
+
+// HTTP/1.1 server (src/runtime/http_server.c): worker threads that each
+// run an epoll loop over their own SO_REUSEPORT socket on host:port (NULL
+// host: every address; port 0: any free port) and hold one VM (from
+// ember_pool_get_vm, or a new one) for their whole life. start runs prelude
+// on every worker's VM and resolves the global function handler there,
+// called as handler(method, path) for each request (NULL if any worker
+// fails to set up); workers <= 0 means one per CPU. Linux only; elsewhere
+// start returns NULL. wait blocks until a handler calls http_stop_server;
+// stop closes the connections, joins the workers and frees the server.
+typedef struct ember_http_server ember_http_server;
+ember_http_server* ember_http_server_start(const char* host, int port, int workers, const char* prelude,
+                                           const char* handler);
+int ember_http_server_port(const ember_http_server* server);
+void ember_http_server_wait(ember_http_server* server);
+void ember_http_server_stop(ember_http_server* server);
+
+// Event loop (src/core/event_loop.c). Settling a promise queues its
+// reactions (resuming the async calls awaiting it, then its then/catch/
+// finally callbacks) as microtasks on the VM. run_microtasks drains them;
+// run_once also waits up to timeout_ms (-1: no limit) for one round of
+// watched descriptors and expired timers; run repeats until no microtasks,
+// timers or watches are left. Watches are one-shot: callback runs once the
+// descriptor is ready, and must watch it again for more. On Linux a watch
+// is an io_uring poll request where the kernel has it (epoll otherwise), so
+// a descriptor that can't be polled wakes its callback as ready instead of
+// failing watch_fd. resolve/reject
+// return -1 for a promise that already settled. delay returns a promise
+// resolved with nil after ms milliseconds. pending counts queued
+// microtasks, suspended async calls, timers and watches. add_timer calls
+// callback once after ms milliseconds and returns an id for cancel_timer
+// (or a negative error). on_close callbacks run, newest first, when the
+// loop is freed with its VM or reset by the VM pool.
+typedef struct ember_event_loop ember_event_loop;
+#define EMBER_LOOP_READ  1
+#define EMBER_LOOP_WRITE 2
+typedef void (*ember_io_callback)(ember_vm* vm, int fd, int events, void* userdata);
+typedef void (*ember_timer_callback)(ember_vm* vm, void* userdata);
+typedef void (*ember_loop_close_callback)(ember_vm* vm, void* userdata);
+int ember_promise_resolve(ember_vm* vm, ember_value promise, ember_value value);
+int ember_promise_reject(ember_vm* vm, ember_value promise, ember_value reason);
+int ember_loop_run_microtasks(ember_vm* vm);
+int ember_loop_run_once(ember_vm* vm, int timeout_ms);
+int ember_loop_run(ember_vm* vm);
+int ember_loop_pending(ember_vm* vm);
+int ember_loop_watch_fd(ember_vm* vm, int fd, int events, ember_io_callback callback, void* userdata);
+int ember_loop_unwatch_fd(ember_vm* vm, int fd);
+ember_value ember_loop_delay(ember_vm* vm, double ms);
+int ember_loop_add_timer(ember_vm* vm, double ms, ember_timer_callback callback, void* userdata);
+int ember_loop_cancel_timer(ember_vm* vm, int id);
+int ember_loop_on_close(ember_vm* vm, ember_loop_close_callback callback, void* userdata);
 
 // Object helper macros
 #define IS_NUMBER(value) ((value).type == EMBER_VAL_NUMBER)
 #define AS_NUMBER(value) ((value).as.number_val)
+// Small integers. A number whose value is an int32 (other than -0) may
+// carry that int beside the double, so indexing, hashing and integer
+// arithmetic skip the float round trip. It is still EMBER_VAL_NUMBER and
+// number_val is always its value: the flag only promises that small agrees
+// with it. ember_make_number sets it for integral values; code that rewrites
+// number_val in place must clear it or keep small in step.
+#define IS_SMALL_INT(value) ((value).type == EMBER_VAL_NUMBER && (value).as.number.is_small)
+#define AS_SMALL_INT(value) ((value).as.number.small)
+
+static inline ember_value ember_make_int(int32_t num) {
+    ember_value value;
+    value.type = EMBER_VAL_NUMBER;
+    value.as.number.value = num;
+    value.as.number.small = num;
+    value.as.number.is_small = 1;
+    return value;
+}
+
+// a op b on small ints, into *result, for OP_ADD, OP_SUB, OP_MUL, OP_MOD,
+// their quickened forms and OP_ADD/SUB_LOCAL_CONST. 0 for other opcodes and
+// when the result is no small int (it overflows, it is -0 or the divisor is
+// 0): the double path must compute it
+static inline int ember_small_int_arith(uint8_t op, int32_t a, int32_t b, int32_t* result) {
+    int64_t r;
+    switch (op) {
+        case OP_ADD:
+        case OP_ADD_NUMBER:
+        case OP_ADD_LOCAL_CONST:
+            r = (int64_t)a + b;
+            break;
+        case OP_SUB:
+        case OP_SUB_NUMBER:
+        case OP_SUB_LOCAL_CONST:
+            r = (int64_t)a - b;
+            break;
+        case OP_MUL:
+        case OP_MUL_NUMBER:
+            r = (int64_t)a * b;
+            // -3 * 0 is -0
+            if (r == 0 && (a < 0 || b < 0)) return 0;
+            break;
+        case OP_MOD:
+        case OP_MOD_NUMBER:
+            if (b == 0) return 0;
+            r = (int64_t)a % b;
+            // Like fmod, the sign is the dividend's: -4 % 2 is -0
+            if (r == 0 && a < 0) return 0;
+            break;
+        default:
+            return 0;
+    }
+    if (r < INT32_MIN || r > INT32_MAX) return 0;
+    *result = (int32_t)r;
+    return 1;
+}
+
+// The index in [0, length) that a number value names, or -1 if it is out of
+// range or fractional
+static inline int ember_number_index(const ember_value* value, int length) {
+    if (value->as.number.is_small) {
+        int32_t small = value->as.number.small;
+        return small >= 0 && small < length ? small : -1;
+    }
+    double number = value->as.number_val;
+    int index = number >= 0 && number < (double)length ? (int)number : -1;
+    return index >= 0 && (double)index == number ? index : -1;
+}
 #define IS_BOOL(value) ((value).type == EMBER_VAL_BOOL)
 #define AS_BOOL(value) ((value).as.bool_val)
 #define IS_STRING(value) ((value).type == EMBER_VAL_STRING)
 #define AS_STRING(value) ((ember_string*)((value).as.obj_val))
-#define AS_CSTRING(value) (((ember_string*)((value).as.obj_val))->chars)
+#define AS_CSTRING(value) (ember_string_flatten((ember_string*)((value).as.obj_val)))
 #define IS_ARRAY(value) ((value).type == EMBER_VAL_ARRAY)
 #define AS_ARRAY(value) ((ember_array*)((value).as.obj_val))
 #define IS_HASH_MAP(value) ((value).type == EMBER_VAL_HASH_MAP)
@@ -1040,6 +2755,26 @@ void ember_pool_release_vm(ember_vm* vm);
 #define AS_REGEX(value) ((ember_regex*)((value).as.obj_val))
 // Iterator access macros
 #define AS_ITERATOR(value) ((ember_iterator*)((value).as.obj_val))
+#define IS_STRING_BUILDER(value) ((value).type == EMBER_VAL_STRING_BUILDER)
+#define AS_STRING_BUILDER(value) ((ember_string_builder*)((value).as.obj_val))
+#define IS_HASHER(value) ((value).type == EMBER_VAL_HASHER)
+#define AS_HASHER(value) ((ember_hasher*)((value).as.obj_val))
+#define IS_FILE(value) ((value).type == EMBER_VAL_FILE)
+#define AS_FILE(value) ((ember_file*)((value).as.obj_val))
+#define IS_WALKER(value) ((value).type == EMBER_VAL_WALKER)
+#define AS_WALKER(value) ((ember_walker*)((value).as.obj_val))
+#define IS_TYPED_ARRAY(value) ((value).type == EMBER_VAL_TYPED_ARRAY)
+#define AS_TYPED_ARRAY(value) ((ember_typed_array*)((value).as.obj_val))
+#define IS_CACHE(value) ((value).type == EMBER_VAL_CACHE)
+#define AS_CACHE(value) ((ember_cache*)((value).as.obj_val))
+#define IS_DEQUE(value) ((value).type == EMBER_VAL_DEQUE)
+#define AS_DEQUE(value) ((ember_deque*)((value).as.obj_val))
+#define IS_PRIORITY_QUEUE(value) ((value).type == EMBER_VAL_PRIORITY_QUEUE)
+#define AS_PRIORITY_QUEUE(value) ((ember_priority_queue*)((value).as.obj_val))
+#define IS_WEAK_REF(value) ((value).type == EMBER_VAL_WEAK_REF)
+#define AS_WEAK_REF(value) ((ember_weak_ref*)((value).as.obj_val))
+#define IS_WEAK_MAP(value) ((value).type == EMBER_VAL_WEAK_MAP)
+#define AS_WEAK_MAP(value) ((ember_weak_map*)((value).as.obj_val))
 
 #ifdef __cplusplus
 }
@@ -70,8 +70,34 @@ typedef struct ember_core_interface {
     void (*deallocate)(void* ptr);
     void (*gc_collect)(ember_vm* vm);
     
+    // Binary-safe strings (see ember_make_string_len and
+    // ember_make_string_external in ember.h). get_string_bytes returns the
+    // bytes and their length in one call, reading slices in place
+    ember_value (*make_string_len)(ember_vm* vm, const char* chars, size_t length);
+    ember_value (*make_string_external)(ember_vm* vm, const char* chars, size_t length,
+                                        void (*release)(const char* chars, size_t length, void* userdata),
+                                        void* userdata);
+    const char* (*get_string_bytes)(ember_value value, size_t* length);
+    
 } ember_core_interface_t;
 
+// Stdlib modules with an init_* entry, in the interface's order
+typedef enum {
+    EMBER_STDLIB_CRYPTO,
+    EMBER_STDLIB_DATETIME,
+    EMBER_STDLIB_HTTP,
+    EMBER_STDLIB_IO,
+    EMBER_STDLIB_JSON,
+    EMBER_STDLIB_MATH,
+    EMBER_STDLIB_REGEX,
+    EMBER_STDLIB_STRING,
+    EMBER_STDLIB_TEMPLATE,
+    EMBER_STDLIB_DATABASE,
+    EMBER_STDLIB_SESSION,
+    EMBER_STDLIB_WEBSOCKET,
+    EMBER_STDLIB_MODULE_COUNT
+} ember_stdlib_module_t;
+
 // Standard library interface - provided by ember-stdlib
 typedef struct ember_stdlib_interface {
     // Version information
@@ -98,6 +124,11 @@ typedef struct ember_stdlib_interface {
     // Configuration
     int (*configure)(const void* config);
     
+    // Optional, for lazy initialization: the globals init_<module> defines,
+    // NULL terminated. Without it a global lookup that misses initializes
+    // every module still pending
+    const char* const* (*module_globals)(ember_stdlib_module_t module);
+    
 } ember_stdlib_interface_t;
 
 // Web server interface - provided by emberweb
@@ -141,6 +172,18 @@ const ember_core_interface_t* ember_core(void);
 const ember_stdlib_interface_t* ember_stdlib(void);
 const emberweb_interface_t* emberweb(void);
 
+// Lazy stdlib initialization, instead of init_all: no module's init_* runs
+// until the VM imports the module (ember_stdlib_require, by module name) or
+// a global lookup misses on a name the module defines
+// (ember_stdlib_resolve_global), so a VM that only uses JSON never starts
+// libcurl or a database driver. Each init runs at most once per VM.
+// require returns 0 once the module is initialized, -1 if it is not a
+// pending module or its init failed; resolve_global returns 1 if it ran an
+// init that may have defined name
+int ember_stdlib_init_lazy(ember_vm* vm);
+int ember_stdlib_require(ember_vm* vm, const char* module_name);
+int ember_stdlib_resolve_global(ember_vm* vm, const char* name, int length);
+
 // Initialization order control
 int ember_init_platform(void);
 void ember_cleanup_platform(void);
@@ -6,6 +6,9 @@
 #include "frontend/lexer/lexer.h"
 #include "runtime/runtime.h"
 #include "runtime/package/package.h"
+#include "runtime/module_prefetch.h"
+#include "runtime/module_resolve_cache.h"
+#include "runtime/module_image.h"
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
@@ -21,299 +24,8 @@
 
 // Clean public API - only embedding interface functions remain
 
-// ============================================================================
-// SECURE VM POOL API IMPLEMENTATION
-// ============================================================================
-
-// Global state for secure VM pool (simplified for security testing)
-static ember_vm** secure_vm_pool = NULL;
-static size_t secure_pool_size = 0;
-static size_t secure_pool_capacity = 0;
-static vm_pool_config_t secure_pool_config = {0};
-static bool secure_pool_initialized = false;
-static uint64_t allocation_count = 0;
-static uint64_t last_rate_limit_reset = 0;
-
-// Security validation constants
-#define MIN_POOL_SIZE 1
-#define MAX_POOL_SIZE 1000
-#define MIN_CHUNK_SIZE 1
-#define MAX_CHUNK_SIZE 100
-#define MIN_THREAD_CACHE 1
-#define MAX_THREAD_CACHE 100
-#define MIN_VMS_PER_THREAD 1
-#define MAX_VMS_PER_THREAD 100
-#define MIN_RATE_LIMIT_WINDOW 100
-#define MAX_RATE_LIMIT_WINDOW 86400000
-#define MIN_RATE_LIMIT_ALLOCS 1
-#define MAX_RATE_LIMIT_ALLOCS 10000
-
-// Default secure configuration
-static const vm_pool_config_t DEFAULT_SECURE_CONFIG = {
-    .initial_size = 16,
-    .chunk_size = 8,
-    .thread_cache_size = 4,
-    .max_vms_per_thread = 10,
-    .rate_limit_window_ms = 1000,
-    .rate_limit_max_allocs = 50
-};
-
-// Get current timestamp in milliseconds
-static uint64_t get_current_time_ms(void) {
-    struct timespec ts;
-    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
-        return 0;  // Return 0 on error (security: don't leak system details)
-    }
-    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
-}
-
-// Secure configuration validation
-static int validate_pool_config(const vm_pool_config_t* config) {
-    if (!config) {
-        return EMBER_ERROR_INVALID_PARAMETER;
-    }
-    
-    // Check all parameters are within safe bounds
-    if (config->initial_size < MIN_POOL_SIZE || config->initial_size > MAX_POOL_SIZE) {
-        return EMBER_ERROR_INVALID_PARAMETER;
-    }
-    
-    if (config->chunk_size < MIN_CHUNK_SIZE || config->chunk_size > MAX_CHUNK_SIZE) {
-        return EMBER_ERROR_INVALID_PARAMETER;
-    }
-    
-    if (config->thread_cache_size < MIN_THREAD_CACHE || config->thread_cache_size > MAX_THREAD_CACHE) {
-        return EMBER_ERROR_INVALID_PARAMETER;
-    }
-    
-    if (config->max_vms_per_thread < MIN_VMS_PER_THREAD || config->max_vms_per_thread > MAX_VMS_PER_THREAD) {
-        return EMBER_ERROR_INVALID_PARAMETER;
-    }
-    
-    if (config->rate_limit_window_ms < MIN_RATE_LIMIT_WINDOW || config->rate_limit_window_ms > MAX_RATE_LIMIT_WINDOW) {
-        return EMBER_ERROR_INVALID_PARAMETER;
-    }
-    
-    if (config->rate_limit_max_allocs < MIN_RATE_LIMIT_ALLOCS || config->rate_limit_max_allocs > MAX_RATE_LIMIT_ALLOCS) {
-        return EMBER_ERROR_INVALID_PARAMETER;
-    }
-    
-    // Check for integer overflow potential
-    if (config->initial_size > UINT32_MAX / sizeof(ember_vm*)) {
-        return EMBER_ERROR_SECURITY_VIOLATION;
-    }
-    
-    return EMBER_SUCCESS;
-}
-
-// Apply secure defaults only for zero values (preserving invalid values for validation)
-static void apply_secure_defaults(vm_pool_config_t* config) {
-    if (!config) return;
-    
-    // Apply defaults only for zero values - let validation catch invalid ones
-    if (config->initial_size == 0) {
-        config->initial_size = DEFAULT_SECURE_CONFIG.initial_size;
-    }
-    
-    if (config->chunk_size == 0) {
-        config->chunk_size = DEFAULT_SECURE_CONFIG.chunk_size;
-    }
-    
-    if (config->thread_cache_size == 0) {
-        config->thread_cache_size = DEFAULT_SECURE_CONFIG.thread_cache_size;
-    }
-    
-    if (config->max_vms_per_thread == 0) {
-        config->max_vms_per_thread = DEFAULT_SECURE_CONFIG.max_vms_per_thread;
-    }
-    
-    if (config->rate_limit_window_ms == 0) {
-        config->rate_limit_window_ms = DEFAULT_SECURE_CONFIG.rate_limit_window_ms;
-    }
-    
-    if (config->rate_limit_max_allocs == 0) {
-        config->rate_limit_max_allocs = DEFAULT_SECURE_CONFIG.rate_limit_max_allocs;
-    }
-}
-
-// Rate limiting check
-static int check_rate_limit(void) {
-    uint64_t current_time = get_current_time_ms();
-    
-    // Reset allocation count if window has passed
-    if (current_time - last_rate_limit_reset >= secure_pool_config.rate_limit_window_ms) {
-        allocation_count = 0;
-        last_rate_limit_reset = current_time;
-    }
-    
-    // Check if rate limit exceeded
-    if (allocation_count >= secure_pool_config.rate_limit_max_allocs) {
-        return EMBER_ERROR_RESOURCE_EXHAUSTED;
-    }
-    
-    allocation_count++;
-    return EMBER_SUCCESS;
-}
-
-// Secure VM pool initialization
-int ember_pool_init(const vm_pool_config_t* config) {
-    // NULL config is allowed - use secure defaults
-    vm_pool_config_t effective_config;
-    
-    if (config == NULL) {
-        // Use default secure configuration
-        effective_config = DEFAULT_SECURE_CONFIG;
-    } else {
-        // Copy and validate provided configuration
-        effective_config = *config;
-        apply_secure_defaults(&effective_config);
-        
-        int validation_result = validate_pool_config(&effective_config);
-        if (validation_result != EMBER_SUCCESS) {
-            return validation_result;
-        }
-    }
-    
-    // Clean up existing pool if already initialized
-    if (secure_pool_initialized) {
-        ember_pool_cleanup();
-    }
-    
-    // Allocate pool array with size validation
-    size_t pool_size = effective_config.initial_size;
-    
-    // Check for potential integer overflow
-    if (pool_size > SIZE_MAX / sizeof(ember_vm*)) {
-        return EMBER_ERROR_SECURITY_VIOLATION;
-    }
-    
-    secure_vm_pool = malloc(pool_size * sizeof(ember_vm*));
-    if (!secure_vm_pool) {
-        return EMBER_ERROR_MEMORY_ALLOCATION;
-    }
-    
-    // Initialize all VMs to NULL for safe cleanup
-    for (size_t i = 0; i < pool_size; i++) {
-        secure_vm_pool[i] = NULL;
-    }
-    
-    // Set pool state
-    secure_pool_capacity = pool_size;
-    secure_pool_size = 0;
-    secure_pool_config = effective_config;
-    secure_pool_initialized = true;
-    allocation_count = 0;
-    last_rate_limit_reset = get_current_time_ms();
-    
-    return EMBER_SUCCESS;
-}
-
-// Secure VM pool cleanup
-void ember_pool_cleanup(void) {
-    if (!secure_pool_initialized || !secure_vm_pool) {
-        return;  // Safe to call multiple times
-    }
-    
-    // Clean up all VMs in the pool
-    for (size_t i = 0; i < secure_pool_capacity; i++) {
-        if (secure_vm_pool[i] != NULL) {
-            ember_free_vm(secure_vm_pool[i]);
-            secure_vm_pool[i] = NULL;
-        }
-    }
-    
-    // Free the pool array
-    free(secure_vm_pool);
-    secure_vm_pool = NULL;
-    secure_pool_capacity = 0;
-    secure_pool_size = 0;
-    secure_pool_initialized = false;
-    allocation_count = 0;
-    last_rate_limit_reset = 0;
-}
-
-// Secure VM acquisition with rate limiting
-ember_vm* ember_pool_get_vm(void) {
-    // Check if pool is initialized
-    if (!secure_pool_initialized) {
-        return NULL;  // Graceful failure - no error leakage
-    }
-    
-    // Apply rate limiting
-    int rate_check = check_rate_limit();
-    if (rate_check != EMBER_SUCCESS) {
-        return NULL;  // Rate limited - no error details leaked
-    }
-    
-    // Try to get VM from pool first
-    for (size_t i = 0; i < secure_pool_capacity; i++) {
-        if (secure_vm_pool[i] != NULL) {
-            ember_vm* vm = secure_vm_pool[i];
-            secure_vm_pool[i] = NULL;
-            secure_pool_size--;
-            
-            // Reset VM state for security
-            if (vm) {
-                vm->ip = 0;
-                vm->stack_top = 0;
-                vm->exception_pending = 0;
-                // Clear current exception for security
-                vm->current_exception = ember_make_nil();
-            }
-            
-            return vm;
-        }
-    }
-    
-    // No available VM in pool - create new one if under limits
-    if (secure_pool_size < secure_pool_config.max_vms_per_thread) {
-        ember_vm* new_vm = ember_new_vm();
-        if (new_vm) {
-            secure_pool_size++;
-        }
-        return new_vm;
-    }
-    
-    return NULL;  // Pool exhausted
-}
-
-// Secure VM release with validation
-void ember_pool_release_vm(ember_vm* vm) {
-    // NULL VM is safe to release - no error
-    if (!vm) {
-        return;
-    }
-    
-    // Check if pool is initialized
-    if (!secure_pool_initialized || !secure_vm_pool) {
-        // Pool not initialized - just free the VM
-        ember_free_vm(vm);
-        return;
-    }
-    
-    // Reset VM state for security before returning to pool
-    vm->ip = 0;
-    vm->stack_top = 0;
-    vm->exception_pending = 0;
-    vm->current_exception = ember_make_nil();
-    
-    // Try to return VM to pool
-    for (size_t i = 0; i < secure_pool_capacity; i++) {
-        if (secure_vm_pool[i] == NULL) {
-            secure_vm_pool[i] = vm;
-            return;
-        }
-    }
-    
-    // Pool is full - free the VM
-    ember_free_vm(vm);
-    if (secure_pool_size > 0) {
-        secure_pool_size--;
-    }
-}
-
 // Internal helper function for VM-aware module path resolution
-static char* ember_resolve_module_path_vm(ember_vm* vm, const char* module_name) {
+char* ember_resolve_module_path_vm(ember_vm* vm, const char* module_name) {
     if (!module_name || strlen(module_name) == 0) {
         return NULL;
     }
@@ -338,14 +50,24 @@ static char* ember_resolve_module_path_vm(ember_vm* vm, const char* module_name)
     // 5. System packages directory
     // 6. Standard library directory
     
-    // 1. VM-specific module paths
+    // 1. VM-specific module paths, each cached as its own base directory
     if (vm && vm->module_path_count > 0) {
         for (int i = 0; i < vm->module_path_count; i++) {
             if (vm->module_paths[i]) {
+                char* cached;
+                if (ember_resolve_cache_lookup(module_name, vm->module_paths[i], &cached)) {
+                    if (cached) {
+                        free(resolved_path);
+                        return cached;
+                    }
+                    continue;
+                }
+                
                 // Try direct .ember file
                 snprintf(resolved_path, EMBER_MAX_PATH_LEN, "%s/%s.ember", vm->module_paths[i], module_name);
                 if (access(resolved_path, R_OK) == 0) {
                     printf("[RESOLVE] Found module in custom path: %s\n", resolved_path);
+                    ember_resolve_cache_store(module_name, vm->module_paths[i], resolved_path);
                     return resolved_path;
                 }
                 
@@ -353,8 +75,10 @@ static char* ember_resolve_module_path_vm(ember_vm* vm, const char* module_name)
                 snprintf(resolved_path, EMBER_MAX_PATH_LEN, "%s/%s/package.ember", vm->module_paths[i], module_name);
                 if (access(resolved_path, R_OK) == 0) {
                     printf("[RESOLVE] Found module package in custom path: %s\n", resolved_path);
+                    ember_resolve_cache_store(module_name, vm->module_paths[i], resolved_path);
                     return resolved_path;
                 }
+                ember_resolve_cache_store(module_name, vm->module_paths[i], NULL);
             }
         }
     }
@@ -364,6 +88,18 @@ static char* ember_resolve_module_path_vm(ember_vm* vm, const char* module_name)
     return ember_resolve_module_path(module_name, NULL);
 }
 
+static int finish_module_load(ember_module* module, const char* module_name, int result) {
+    if (result == 0) {
+        module->is_loaded = 1;
+        printf("[MODULE] Successfully loaded module: %s\n", module_name);
+        return 0;
+    } else {
+        module->is_loaded = 0; // Reset to not loaded on failure
+        fprintf(stderr, "[MODULE] Failed to execute module: %s\n", module_name);
+        return -1;
+    }
+}
+
 // Module system implementation
 int ember_import_module(ember_vm* vm, const char* module_name) {
     if (!vm || !module_name) {
@@ -372,65 +108,34 @@ int ember_import_module(ember_vm* vm, const char* module_name) {
     
     // Check for circular dependency by looking for modules currently being loaded
     // We use the is_loaded flag - 0 means not started, 1 means loaded, -1 means currently loading
-    for (int i = 0; i < vm->module_count; i++) {
-        if (strcmp(vm->modules[i].name, module_name) == 0) {
-            if (vm->modules[i].is_loaded == -1) {
-                fprintf(stderr, "[MODULE] Circular dependency detected: %s\n", module_name);
-                return -1;
-            } else if (vm->modules[i].is_loaded == 1) {
-                return 0; // Already loaded successfully
-            }
-            break; // Found but not loaded, continue to load
+    ember_module* module = ember_module_find(vm, module_name);
+    if (module) {
+        if (module->is_loaded == -1) {
+            fprintf(stderr, "[MODULE] Circular dependency detected: %s\n", module_name);
+            return -1;
+        } else if (module->is_loaded == 1) {
+            return 0; // Already loaded successfully
         }
+        // Found but not loaded, continue to load
     }
     
-    // Note: Circular dependency check is performed above
-    
     // Resolve module path using VM-specific search paths
+    double start = startup_clock();
     char* module_path = ember_resolve_module_path_vm(vm, module_name);
+    startup_profile_module(module_name, STARTUP_MODULE_RESOLVE, start);
     if (!module_path) {
         fprintf(stderr, "[MODULE] Failed to resolve path for module: %s\n", module_name);
         return -1;
     }
     
-    // Check if we have space for a new module
-    if (vm->module_count >= EMBER_MAX_MODULES) {
-        fprintf(stderr, "[MODULE] Maximum module limit reached (%d)\n", EMBER_MAX_MODULES);
-        free(module_path);
-        return -1;
-    }
-    
-    // Find or create module entry
-    ember_module* module = NULL;
-    int module_index = -1;
-    
-    // Look for existing module entry
-    for (int i = 0; i < vm->module_count; i++) {
-        if (strcmp(vm->modules[i].name, module_name) == 0) {
-            module = &vm->modules[i];
-            module_index = i;
-            break;
-        }
-    }
-    
-    // Create new module entry if not found
+    // Create module entry if not found
     if (!module) {
-        module_index = vm->module_count++;
-        module = &vm->modules[module_index];
-        
-        // Initialize module structure
-        module->name = malloc(strlen(module_name) + 1);
-        if (!module->name) {
-            vm->module_count--;
+        module = ember_module_add(vm, module_name);
+        if (!module) {
             free(module_path);
             return -1;
         }
-        strcpy(module->name, module_name);
-        
         module->path = module_path;
-        module->chunk = NULL;
-        module->is_loaded = 0;
-        module->export_count = 0;
     } else {
         // Update path if different
         if (module->path && strcmp(module->path, module_path) != 0) {
@@ -446,6 +151,22 @@ int ember_import_module(ember_vm* vm, const char* module_name) {
     // Mark module as currently loading to detect circular dependencies
     module->is_loaded = -1;
     
+    // Compiled ahead by ember_prefetch_imports: link instead of compiling
+    ember_module_unit* unit = ember_prefetch_find(vm, module->path);
+    if (unit) {
+        return finish_module_load(module, module_name, ember_prefetch_link(vm, unit));
+    }
+    
+    // Compiled once per process; every other VM runs the same image
+    start = startup_clock();
+    ember_module_image* image = ember_module_image_acquire(module->path);
+    startup_profile_module(module_name, STARTUP_MODULE_COMPILE, start);
+    if (image && image->data) {
+        return finish_module_load(module, module_name, ember_module_image_link(vm, module, image));
+    }
+    // Unreadable, or it failed to compile: the path below reports why
+    ember_module_image_release(image);
+    
     // Check if file exists and is readable
     if (access(module->path, R_OK) != 0) {
         module->is_loaded = 0; // Reset loading state on error
@@ -498,7 +219,9 @@ int ember_import_module(ember_vm* vm, const char* module_name) {
     vm->chunk = module->chunk;
     vm->local_count = 0;
     
-    int result = ember_eval(vm, source);
+    start = startup_clock();
+    int result = ember_eval_cached(vm, source);
+    startup_profile_module(module_name, STARTUP_MODULE_EXECUTE, start);
     
     // Restore VM state
     vm->chunk = saved_chunk;
@@ -506,15 +229,7 @@ int ember_import_module(ember_vm* vm, const char* module_name) {
     
     free(source);
     
-    if (result == 0) {
-        module->is_loaded = 1;
-        printf("[MODULE] Successfully loaded module: %s\n", module_name);
-        return 0;
-    } else {
-        module->is_loaded = 0; // Reset to not loaded on failure
-        fprintf(stderr, "[MODULE] Failed to execute module: %s\n", module_name);
-        return -1;
-    }
+    return finish_module_load(module, module_name, result);
 }
 
 int ember_install_library(const char* library_name, const char* source_path) {
@@ -687,22 +402,14 @@ int ember_install_library(const char* library_name, const char* source_path) {
         printf("[LIBRARY] Registered package in global registry\n");
     }
     
+    // Earlier lookups may have cached the library as missing
+    ember_clear_module_resolution_cache();
     printf("[LIBRARY] Successfully installed library: %s\n", library_name);
     return 0;
 }
 
-char* ember_resolve_module_path(const char* module_name, const char* current_file) {
-    (void)current_file; // Parameter unused in basic implementation
-    if (!module_name || strlen(module_name) == 0) {
-        return NULL;
-    }
-    
-    // Validate module name for security
-    if (ember_package_validate_name(module_name) != 0) {
-        fprintf(stderr, "[RESOLVE] Invalid module name: %s\n", module_name);
-        return NULL;
-    }
-    
+// Probes every standard location for a validated module name
+static char* resolve_module_path_uncached(const char* module_name) {
     char* resolved_path = malloc(EMBER_MAX_PATH_LEN);
     if (!resolved_path) {
         fprintf(stderr, "[RESOLVE] Failed to allocate memory for path resolution\n");
@@ -731,7 +438,7 @@ char* ember_resolve_module_path(const char* module_name, const char* current_fil
     }
     
     // 3. User packages directory
-    const char* home = getenv("HOME");
+    const char* home = ember_resolve_home();
     if (home) {
         snprintf(resolved_path, EMBER_MAX_PATH_LEN, "%s/.ember/packages/%s/package.ember", home, module_name);
         if (access(resolved_path, R_OK) == 0) {
@@ -810,6 +517,31 @@ char* ember_resolve_module_path(const char* module_name, const char* current_fil
     return NULL;
 }
 
+char* ember_resolve_module_path(const char* module_name, const char* current_file) {
+    (void)current_file; // Parameter unused in basic implementation
+    if (!module_name || strlen(module_name) == 0) {
+        return NULL;
+    }
+    
+    // Validate module name for security
+    if (ember_package_validate_name(module_name) != 0) {
+        fprintf(stderr, "[RESOLVE] Invalid module name: %s\n", module_name);
+        return NULL;
+    }
+    
+    // Every VM resolves the same standard locations; probe them once
+    char* resolved_path;
+    if (ember_resolve_cache_lookup(module_name, "", &resolved_path)) {
+        if (!resolved_path) {
+            fprintf(stderr, "[RESOLVE] Module not found: %s\n", module_name);
+        }
+        return resolved_path;
+    }
+    resolved_path = resolve_module_path_uncached(module_name);
+    ember_resolve_cache_store(module_name, "", resolved_path);
+    return resolved_path;
+}
+
 void ember_add_module_path(ember_vm* vm, const char* path) {
     if (!vm || !path || strlen(path) == 0) {
         fprintf(stderr, "[MODULE_PATH] Invalid parameters for adding module path\n");
@@ -877,6 +609,89 @@ void ember_add_module_path(ember_vm* vm, const char* path) {
     }
 }
 
+// Whether func_val can be called with argc arguments
+static int check_callable(ember_value func_val, const char* func_name, int argc) {
+    if (func_val.type == EMBER_VAL_NATIVE) {
+        return 1;
+    }
+    if (func_val.type != EMBER_VAL_FUNCTION) {
+        fprintf(stderr, "[CALL] '%s' is not a function\n", func_name);
+        return 0;
+    }
+    if (!func_val.as.func_val.chunk) {
+        fprintf(stderr, "[CALL] Function '%s' has no bytecode chunk\n", func_name);
+        return 0;
+    }
+    
+    // Security check: prevent stack-based buffer overflow
+    if (argc > EMBER_MAX_ARGS) {
+        fprintf(stderr, "[CALL] Too many arguments: %d (max: %d)\n", argc, EMBER_MAX_ARGS);
+        return 0;
+    }
+    return 1;
+}
+
+// Call a checked function value; the return value goes to *result
+// instead of the stack
+static int run_function(ember_vm* vm, ember_value func_val, int argc, ember_value* argv, ember_value* result) {
+    *result = ember_make_nil();
+    
+    if (func_val.type == EMBER_VAL_NATIVE) {
+        // Call native function directly; natives read argument chars directly
+        ember_flatten_string_args(argc, argv);
+        *result = func_val.as.native_val(vm, argc, argv);
+        return 0;
+    }
+    if (func_val.as.func_val.chunk->is_generator) {
+        *result = vm_generator_call(vm, func_val.as.func_val.chunk, argc, argv);
+        return result->type == EMBER_VAL_GENERATOR ? 0 : -1;
+    }
+    
+    // Bind the arguments in a new frame; the function's OP_RETURN pops it
+    // and makes ember_run return with the result on the stack
+    int stack_base = vm->stack_top;
+    int depth = vm_push_entry_frame(vm, func_val.as.func_val.chunk, argc, argv);
+    if (depth < 0) {
+        return -1;
+    }
+    
+    int func_result = ember_run(vm);
+    
+    // A runtime error leaves the function's frames active
+    vm_unwind_frames(vm, depth);
+    
+    if (func_result == 0 && vm->stack_top > stack_base) {
+        *result = vm->stack[--vm->stack_top];
+    }
+    vm->stack_top = stack_base;
+    return func_result;
+}
+
+static int invoke_function(ember_vm* vm, ember_value func_val, const char* func_name,
+                           int argc, ember_value* argv, ember_value* result) {
+    if (!check_callable(func_val, func_name, argc)) {
+        *result = ember_make_nil();
+        return -1;
+    }
+    return run_function(vm, func_val, argc, argv, result);
+}
+
+// Call a function value from C (promise callbacks); the return value goes
+// to *result
+int vm_call_value(ember_vm* vm, ember_value func_val, int argc, ember_value* argv, ember_value* result) {
+    return invoke_function(vm, func_val, "<callback>", argc, argv, result);
+}
+
+int vm_callable(ember_value func_val, int argc) {
+    return check_callable(func_val, "<callback>", argc);
+}
+
+// For a function value vm_callable accepted: the checks are not repeated
+// on each call of a loop over elements
+int vm_call_prepared(ember_vm* vm, ember_value func_val, int argc, ember_value* argv, ember_value* result) {
+    return run_function(vm, func_val, argc, argv, result);
+}
+
 int ember_call(ember_vm* vm, const char* func_name, int argc, ember_value* argv) {
     // Validate input parameters
     if (!vm) {
@@ -900,56 +715,18 @@ int ember_call(ember_vm* vm, const char* func_name, int argc, ember_value* argv)
     }
     
     // Find function in globals
-    for (int i = 0; i < vm->global_count; i++) {
-        if (strcmp(vm->globals[i].key, func_name) == 0) {
-            ember_value func_val = vm->globals[i].value;
-            
-            if (func_val.type == EMBER_VAL_NATIVE) {
-                // Call native function directly
-                ember_value result = func_val.as.native_val(vm, argc, argv);
-                // Push result onto stack for consistency
+    int slot = ember_global_find(vm, func_name, (int)strlen(func_name));
+    if (slot >= 0) {
+        ember_value func_val = vm->globals[slot].value;
+        
+        if (func_val.type == EMBER_VAL_NATIVE || func_val.type == EMBER_VAL_FUNCTION) {
+            ember_value result;
+            int func_result = invoke_function(vm, func_val, func_name, argc, argv, &result);
+            // The result is left on the stack for the caller
+            if (func_result == 0) {
                 push(vm, result);
-                return 0;
-            } else if (func_val.type == EMBER_VAL_FUNCTION) {
-                // Call user-defined function
-                if (!func_val.as.func_val.chunk) {
-                    fprintf(stderr, "[CALL] Function '%s' has no bytecode chunk\n", func_name);
-                    return -1;
-                }
-                
-                // Security check: prevent stack-based buffer overflow
-                if (argc > EMBER_MAX_ARGS) {
-                    fprintf(stderr, "[CALL] Too many arguments: %d (max: %d)\n", argc, EMBER_MAX_ARGS);
-                    return -1;
-                }
-                
-                // Save current VM state (like in VM OP_CALL)
-                ember_chunk* saved_chunk = vm->chunk;
-                uint8_t* saved_ip = vm->ip;
-                int saved_local_count = vm->local_count;
-                
-                // Set up parameters as local variables (like in VM OP_CALL)
-                // Arguments are added to the current local scope
-                for (int i = 0; i < argc && vm->local_count < EMBER_MAX_LOCALS; i++) {
-                    vm->locals[vm->local_count++] = argv[i];
-                }
-                
-                // Switch to function chunk
-                vm->chunk = func_val.as.func_val.chunk;
-                vm->ip = func_val.as.func_val.chunk->code;
-                
-                // Run function
-                int func_result = ember_run(vm);
-                
-                // Restore VM state (like in VM OP_CALL)
-                vm->chunk = saved_chunk;
-                vm->ip = saved_ip;
-                vm->local_count = saved_local_count;
-                
-                // Return value should already be on stack from OP_RETURN
-                
-                return func_result;
             }
+            return func_result;
         }
     }
     // Function not found
@@ -957,6 +734,132 @@ int ember_call(ember_vm* vm, const char* func_name, int argc, ember_value* argv)
     return -1;
 }
 
+// Resolved function for repeated calls from host code: the name lookup is
+// done once, and global slots are never reused, so the slot stays valid
+// (a redefinition of the function is picked up on the next call)
+struct ember_function_handle {
+    ember_vm* vm;
+    int slot;               // Index into vm->globals
+    char* name;             // For error messages
+    ember_value* args;      // Argument buffer handed out by ember_function_args
+    int arg_capacity;
+};
+
+ember_function_handle* ember_function_resolve(ember_vm* vm, const char* func_name) {
+    if (!vm || !func_name || func_name[0] == '\0') {
+        fprintf(stderr, "[CALL] Invalid VM or function name\n");
+        return NULL;
+    }
+    
+    size_t name_length = strlen(func_name);
+    int slot = ember_global_find(vm, func_name, (int)name_length);
+    if (slot < 0) {
+        fprintf(stderr, "[CALL] Function '%s' not found in global scope\n", func_name);
+        return NULL;
+    }
+    ember_val_type type = vm->globals[slot].value.type;
+    if (type != EMBER_VAL_FUNCTION && type != EMBER_VAL_NATIVE) {
+        fprintf(stderr, "[CALL] '%s' is not a function\n", func_name);
+        return NULL;
+    }
+    
+    ember_function_handle* handle = malloc(sizeof(ember_function_handle));
+    char* name = malloc(name_length + 1);
+    if (!handle || !name) {
+        fprintf(stderr, "[CALL] Failed to allocate function handle for '%s'\n", func_name);
+        free(handle);
+        free(name);
+        return NULL;
+    }
+    memcpy(name, func_name, name_length + 1);
+    handle->vm = vm;
+    handle->slot = slot;
+    handle->name = name;
+    handle->args = NULL;
+    handle->arg_capacity = 0;
+    return handle;
+}
+
+ember_value* ember_function_args(ember_function_handle* handle, int argc) {
+    if (!handle || argc < 0 || argc > EMBER_MAX_ARGS) {
+        fprintf(stderr, "[CALL] Invalid argument buffer request: %d (max: %d)\n", argc, EMBER_MAX_ARGS);
+        return NULL;
+    }
+    if (argc > handle->arg_capacity || !handle->args) {
+        int capacity = argc > 0 ? argc : 1;
+        ember_value* args = realloc(handle->args, sizeof(ember_value) * capacity);
+        if (!args) {
+            fprintf(stderr, "[CALL] Failed to allocate argument buffer\n");
+            return NULL;
+        }
+        handle->args = args;
+        handle->arg_capacity = capacity;
+    }
+    return handle->args;
+}
+
+int ember_function_call(ember_function_handle* handle, int argc, ember_value* argv, ember_value* result) {
+    if (!handle) {
+        fprintf(stderr, "[CALL] Function handle is null\n");
+        return -1;
+    }
+    if (argc < 0 || (argc > 0 && !argv)) {
+        fprintf(stderr, "[CALL] Invalid arguments for '%s'\n", handle->name);
+        return -1;
+    }
+    
+    ember_value discarded;
+    ember_value* out = result ? result : &discarded;
+    ember_vm* vm = handle->vm;
+    return invoke_function(vm, vm->globals[handle->slot].value, handle->name, argc, argv, out);
+}
+
+// Row i of argv_matrix is argv_matrix[i * argc ... i * argc + argc - 1].
+// The function and arguments are checked once for the whole batch, and
+// collection is held off until the batch ends so earlier results stay
+// alive. Stops at the first failing row; returns the number of rows
+// completed, or -1 if the arguments are invalid.
+int ember_call_batch(ember_vm* vm, ember_function_handle* handle, int n, int argc,
+                     ember_value* argv_matrix, ember_value* results) {
+    if (!vm || !handle || handle->vm != vm) {
+        fprintf(stderr, "[CALL] Function handle does not belong to this VM\n");
+        return -1;
+    }
+    if (n < 0 || argc < 0 || (n > 0 && argc > 0 && !argv_matrix) || (n > 0 && !results)) {
+        fprintf(stderr, "[CALL] Invalid batch for '%s'\n", handle->name);
+        return -1;
+    }
+    
+    ember_value func_val = vm->globals[handle->slot].value;
+    if (!check_callable(func_val, handle->name, argc)) {
+        return -1;
+    }
+    
+    int64_t saved_next_gc = vm->next_gc;
+    vm->next_gc = INT64_MAX;
+    
+    int completed = 0;
+    while (completed < n) {
+        ember_value* row = argc > 0 ? &argv_matrix[(size_t)completed * argc] : NULL;
+        if (run_function(vm, func_val, argc, row, &results[completed]) != 0) {
+            fprintf(stderr, "[CALL] '%s' failed on batch row %d\n", handle->name, completed);
+            break;
+        }
+        completed++;
+    }
+    
+    // The next allocation collects if the batch pushed the heap past the threshold
+    vm->next_gc = saved_next_gc;
+    return completed;
+}
+
+void ember_function_release(ember_function_handle* handle) {
+    if (!handle) return;
+    free(handle->args);
+    free(handle->name);
+    free(handle);
+}
+
 void ember_print_value(ember_value value) {
     print_value(value);
 }
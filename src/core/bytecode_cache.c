@@ -0,0 +1,99 @@
+#define _GNU_SOURCE
+#include "bytecode_format.h"
+#include "../vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+// Persistent cache of compiled units. A warm entry is mapped and loaded
+// instead of lexing and parsing the source again; a missing, damaged or
+// unwritable entry only costs a normal compile.
+
+static char bytecode_cache_dir[PATH_MAX];
+
+void ember_set_bytecode_cache_dir(const char* cache_dir) {
+    if (!cache_dir || !cache_dir[0]) {
+        bytecode_cache_dir[0] = '\0';
+        return;
+    }
+    size_t length = strlen(cache_dir);
+    if (length >= sizeof(bytecode_cache_dir)) {
+        fprintf(stderr, "[BYTECODE] Cache directory path too long: %s\n", cache_dir);
+        bytecode_cache_dir[0] = '\0';
+        return;
+    }
+    memcpy(bytecode_cache_dir, cache_dir, length + 1);
+}
+
+// 64-bit FNV-1a, continued from hash
+static uint64_t cache_hash(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t ember_bytecode_source_key(const char* source) {
+    uint64_t hash = 14695981039346656037ull;
+    uint8_t build[4] = {EMBER_BYTECODE_VERSION & 0xFF, EMBER_BYTECODE_VERSION >> 8,
+                        (OP_HALT + 1) & 0xFF, (OP_HALT + 1) >> 8};
+    hash = cache_hash(hash, EMBER_VERSION, strlen(EMBER_VERSION));
+    hash = cache_hash(hash, build, sizeof(build));
+    return cache_hash(hash, source, strlen(source));
+}
+
+int ember_bytecode_cache_path(const char* source, char* path, size_t path_size) {
+    if (!source || !bytecode_cache_dir[0]) return -1;
+
+    int written = snprintf(path, path_size, "%s/%016llx-%zx.emberc", bytecode_cache_dir,
+                           (unsigned long long)ember_bytecode_source_key(source), strlen(source));
+    return written > 0 && (size_t)written < path_size ? 0 : -1;
+}
+
+static int ensure_cache_dir(void) {
+    if (mkdir(bytecode_cache_dir, 0755) == 0 || errno == EEXIST) return 1;
+    fprintf(stderr, "[BYTECODE] Cannot create cache directory %s\n", bytecode_cache_dir);
+    return 0;
+}
+
+int ember_eval_cached(ember_vm* vm, const char* source) {
+    if (!vm || !source) return -1;
+    char path[PATH_MAX];
+    if (ember_bytecode_cache_path(source, path, sizeof(path)) != 0) {
+        return ember_eval(vm, source);
+    }
+
+    struct stat info;
+    if (stat(path, &info) == 0) {
+        ember_chunk* cached = ember_bytecode_load_file(vm, path);
+        if (cached) {
+            int result = ember_bytecode_run(vm, cached);
+            ember_bytecode_free_chunk(cached);
+            return result;
+        }
+        // Damaged entry: recompile below and replace it
+    }
+
+    ember_chunk* main = malloc(sizeof(ember_chunk));
+    if (!main) return -1;
+    init_chunk(main);
+    uint8_t* data = NULL;
+    size_t size = 0;
+    if (!ember_bytecode_compile_chunk(vm, source, main, &data, &size)) {
+        ember_bytecode_free_chunk(main);
+        return -1;
+    }
+    if (ensure_cache_dir()) {
+        ember_bytecode_write_file(path, data, size);
+    }
+    free(data);
+
+    int result = ember_bytecode_run(vm, main);
+    ember_bytecode_free_chunk(main);
+    return result;
+}
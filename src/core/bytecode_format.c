@@ -0,0 +1,801 @@
+#define _GNU_SOURCE
+#include "bytecode_format.h"
+#include "../vm.h"
+#include "../runtime/value/value.h"
+#include "../frontend/parser/parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define BYTECODE_CHUNK_ENTRY_SIZE 16
+#define BYTECODE_NULL_STRING 0xFFFFFFFFu
+
+uint32_t ember_bytecode_checksum(const uint8_t* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// ============================================================================
+// WRITER
+// ============================================================================
+
+typedef struct {
+    uint8_t* data;
+    size_t count;
+    size_t capacity;
+    int failed;
+} bytecode_buffer;
+
+static uint8_t* buffer_reserve(bytecode_buffer* buffer, size_t size) {
+    if (buffer->failed) return NULL;
+    if (size > UINT32_MAX - buffer->count) {
+        fprintf(stderr, "[BYTECODE] Compiled unit exceeds the 4 GiB format limit\n");
+        buffer->failed = 1;
+        return NULL;
+    }
+    if (buffer->count + size > buffer->capacity) {
+        size_t capacity = buffer->capacity < 256 ? 256 : buffer->capacity;
+        while (capacity < buffer->count + size) capacity *= 2;
+        uint8_t* data = realloc(buffer->data, capacity);
+        if (!data) {
+            fprintf(stderr, "[BYTECODE] Failed to allocate %zu bytes for bytecode\n", capacity);
+            buffer->failed = 1;
+            return NULL;
+        }
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+    uint8_t* out = buffer->data + buffer->count;
+    buffer->count += size;
+    return out;
+}
+
+static void store_u32(uint8_t* out, uint32_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    out[2] = (uint8_t)(value >> 16);
+    out[3] = (uint8_t)(value >> 24);
+}
+
+static void put_u8(bytecode_buffer* buffer, uint8_t value) {
+    uint8_t* out = buffer_reserve(buffer, 1);
+    if (out) out[0] = value;
+}
+
+static void put_u32(bytecode_buffer* buffer, uint32_t value) {
+    uint8_t* out = buffer_reserve(buffer, 4);
+    if (out) store_u32(out, value);
+}
+
+static void put_u32_at(bytecode_buffer* buffer, size_t offset, uint32_t value) {
+    if (!buffer->failed) store_u32(buffer->data + offset, value);
+}
+
+static void put_number(bytecode_buffer* buffer, double number) {
+    uint64_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+    put_u32(buffer, (uint32_t)bits);
+    put_u32(buffer, (uint32_t)(bits >> 32));
+}
+
+static void put_bytes(bytecode_buffer* buffer, const void* bytes, size_t size) {
+    uint8_t* out = buffer_reserve(buffer, size);
+    if (out && size > 0) memcpy(out, bytes, size);
+}
+
+// Chunk code with quickened opcodes written back in their generic form: the
+// specialization reflects one run's types and must not outlive it
+static void put_code(bytecode_buffer* buffer, const ember_chunk* chunk) {
+    size_t start = buffer->count;
+    put_bytes(buffer, chunk->code, (size_t)chunk->count);
+    if (buffer->failed) return;
+    int offset = 0;
+    while (offset < chunk->count) {
+        uint8_t op = chunk->code[offset];
+        int length = 1;
+        if (op == OP_WIDE || opcode_has_operand(op)) {
+            read_chunk_operand(chunk, offset, NULL, &length);
+        } else if (opcode_fused_size(op) > 0) {
+            length = opcode_fused_size(op);
+        } else {
+            buffer->data[start + (size_t)offset] = opcode_generic(op);
+        }
+        offset += length;
+    }
+}
+
+static void put_string(bytecode_buffer* buffer, const char* chars, size_t length) {
+    if (!chars) {
+        put_u32(buffer, BYTECODE_NULL_STRING);
+        return;
+    }
+    put_u32(buffer, (uint32_t)length);
+    put_bytes(buffer, chars, length);
+}
+
+static void put_align(bytecode_buffer* buffer) {
+    while (!buffer->failed && buffer->count % 8 != 0) put_u8(buffer, 0);
+}
+
+// Every chunk of the unit, in file order; index 0 is the top-level chunk
+typedef struct {
+    ember_chunk** items;
+    int count;
+    int capacity;
+} chunk_list;
+
+static int chunk_list_index(chunk_list* list, ember_chunk* chunk) {
+    for (int i = 0; i < list->count; i++) {
+        if (list->items[i] == chunk) return i;
+    }
+    if (list->count == list->capacity) {
+        int capacity = list->capacity < 8 ? 8 : list->capacity * 2;
+        ember_chunk** items = realloc(list->items, sizeof(ember_chunk*) * capacity);
+        if (!items) return -1;
+        list->items = items;
+        list->capacity = capacity;
+    }
+    list->items[list->count] = chunk;
+    return list->count++;
+}
+
+static int is_script_function(ember_value value) {
+    return value.type == EMBER_VAL_FUNCTION && value.as.func_val.chunk != NULL;
+}
+
+static int put_constant(bytecode_buffer* buffer, chunk_list* chunks, ember_value value) {
+    put_u8(buffer, (uint8_t)value.type);
+    switch (value.type) {
+        case EMBER_VAL_NIL:
+            return 1;
+        case EMBER_VAL_BOOL:
+            put_u8(buffer, value.as.bool_val ? 1 : 0);
+            return 1;
+        case EMBER_VAL_NUMBER:
+            put_number(buffer, value.as.number_val);
+            return 1;
+        case EMBER_VAL_STRING: {
+            if (!value.as.obj_val) break;
+            ember_string* string = AS_STRING(value);
+            ember_string_flatten(string);
+            put_string(buffer, string->chars, (size_t)string->length);
+            return 1;
+        }
+        case EMBER_VAL_FUNCTION: {
+            if (!is_script_function(value)) break;
+            int index = chunk_list_index(chunks, value.as.func_val.chunk);
+            if (index < 0) return 0;
+            const char* name = value.as.func_val.name;
+            put_u32(buffer, (uint32_t)index);
+            put_string(buffer, name, name ? strlen(name) : 0);
+            return 1;
+        }
+        default:
+            break;
+    }
+    fprintf(stderr, "[BYTECODE] Constant of type %s cannot be serialized\n", value_type_to_string(value.type));
+    return 0;
+}
+
+// Serialize main, the chunks it references and the script functions bound
+// to the given global slots
+static int bytecode_serialize(ember_vm* vm, ember_chunk* main, const int* slots, int slot_count,
+                              uint8_t** data, size_t* size) {
+    chunk_list chunks = {NULL, 0, 0};
+    bytecode_buffer buffer = {NULL, 0, 0, 0};
+    int ok = chunk_list_index(&chunks, main) == 0;
+    for (int i = 0; ok && i < slot_count; i++) {
+        ok = chunk_list_index(&chunks, vm->globals[slots[i]].value.as.func_val.chunk) >= 0;
+    }
+
+    buffer_reserve(&buffer, EMBER_BYTECODE_HEADER_SIZE);
+
+    // Function table; the chunk table follows once the chunk count is final
+    size_t functions_offset = buffer.count;
+    for (int i = 0; ok && i < slot_count; i++) {
+        const struct ember_global* global = &vm->globals[slots[i]];
+        const char* name = global->value.as.func_val.name;
+        put_u32(&buffer, (uint32_t)chunk_list_index(&chunks, global->value.as.func_val.chunk));
+        put_string(&buffer, global->key, strlen(global->key));
+        put_string(&buffer, name, name ? strlen(name) : 0);
+    }
+
+    // Constants can pull in further chunks, so the table grows as we go;
+    // entries are written to a side array and copied in at the end
+    uint32_t* table = NULL;
+    int table_capacity = 0;
+    for (int c = 0; ok && c < chunks.count; c++) {
+        if (c >= table_capacity) {
+            table_capacity = chunks.capacity;
+            uint32_t* grown = realloc(table, sizeof(uint32_t) * 4 * table_capacity);
+            if (!grown) {
+                ok = 0;
+                break;
+            }
+            table = grown;
+        }
+        ember_chunk* chunk = chunks.items[c];
+        put_align(&buffer);
+        table[c * 4] = (uint32_t)buffer.count;
+        table[c * 4 + 1] = (uint32_t)chunk->count;
+        put_code(&buffer, chunk);
+        put_align(&buffer);
+        table[c * 4 + 2] = (uint32_t)buffer.count;
+        table[c * 4 + 3] = (uint32_t)chunk->const_count;
+        for (int k = 0; ok && k < chunk->const_count; k++) {
+            ok = put_constant(&buffer, &chunks, chunk->constants[k]);
+        }
+        put_u32(&buffer, (uint32_t)chunk->handler_count);
+        for (int h = 0; h < chunk->handler_count; h++) {
+            const ember_handler_entry* entry = &chunk->handlers[h];
+            put_u32(&buffer, (uint32_t)entry->start);
+            put_u32(&buffer, (uint32_t)entry->end);
+            put_u32(&buffer, (uint32_t)entry->handler);
+            put_u32(&buffer, (uint32_t)entry->stack_depth);
+            put_u32(&buffer, (uint32_t)entry->kind);
+        }
+        put_u32(&buffer, (uint32_t)chunk->switch_table_count);
+        for (int t = 0; t < chunk->switch_table_count; t++) {
+            const ember_switch_table* switch_table = &chunk->switch_tables[t];
+            put_u32(&buffer, (uint32_t)switch_table->count);
+            put_u32(&buffer, (uint32_t)switch_table->default_target);
+            for (int i = 0; i < switch_table->count; i++) {
+                put_u32(&buffer, (uint32_t)switch_table->keys[i]);
+                put_u32(&buffer, (uint32_t)switch_table->targets[i]);
+            }
+        }
+        put_string(&buffer, chunk->line_table ? (const char*)chunk->line_table : "",
+                   (size_t)chunk->line_table_length);
+    }
+
+    // Move the data behind the header and function table to make room for
+    // the chunk table
+    size_t table_size = (size_t)chunks.count * BYTECODE_CHUNK_ENTRY_SIZE;
+    size_t tail = buffer.count - functions_offset;
+    if (ok && buffer_reserve(&buffer, table_size)) {
+        memmove(buffer.data + functions_offset + table_size, buffer.data + functions_offset, tail);
+        for (int c = 0; c < chunks.count; c++) {
+            for (int f = 0; f < 4; f++) {
+                uint32_t value = table[c * 4 + f];
+                // Code and constant offsets point past the table now
+                if (f == 0 || f == 2) value += (uint32_t)table_size;
+                put_u32_at(&buffer, functions_offset + (size_t)c * BYTECODE_CHUNK_ENTRY_SIZE + f * 4, value);
+            }
+        }
+    }
+    // Entries are 16 bytes, so the shifted sections stay 8-byte aligned
+    ok = ok && !buffer.failed;
+
+    if (ok) {
+        uint8_t* header = buffer.data;
+        memcpy(header + EMBER_BYTECODE_OFF_MAGIC, EMBER_BYTECODE_MAGIC, 4);
+        header[EMBER_BYTECODE_OFF_VERSION] = EMBER_BYTECODE_VERSION & 0xFF;
+        header[EMBER_BYTECODE_OFF_VERSION + 1] = EMBER_BYTECODE_VERSION >> 8;
+        header[EMBER_BYTECODE_OFF_OPCODES] = (OP_HALT + 1) & 0xFF;
+        header[EMBER_BYTECODE_OFF_OPCODES + 1] = (OP_HALT + 1) >> 8;
+        store_u32(header + EMBER_BYTECODE_OFF_CHUNKS, (uint32_t)chunks.count);
+        store_u32(header + EMBER_BYTECODE_OFF_FUNCTIONS, (uint32_t)slot_count);
+        store_u32(header + EMBER_BYTECODE_OFF_MAIN, 0);
+        store_u32(header + EMBER_BYTECODE_OFF_SIZE, (uint32_t)buffer.count);
+        store_u32(header + EMBER_BYTECODE_OFF_CHECKSUM,
+                  ember_bytecode_checksum(header + EMBER_BYTECODE_HEADER_SIZE,
+                                          buffer.count - EMBER_BYTECODE_HEADER_SIZE));
+        store_u32(header + EMBER_BYTECODE_OFF_RESERVED, 0);
+        *data = buffer.data;
+        *size = buffer.count;
+    } else {
+        free(buffer.data);
+    }
+    free(table);
+    free(chunks.items);
+    return ok;
+}
+
+int ember_bytecode_compile_chunk(ember_vm* vm, const char* source, ember_chunk* main,
+                                 uint8_t** data, size_t* size) {
+    if (!vm || !source || !main || !data || !size) return 0;
+
+    // Functions are bound while compiling; remember what was there before
+    // so only this unit's definitions are written out
+    int before = vm->global_count;
+    ember_chunk** previous = before > 0 ? malloc(sizeof(ember_chunk*) * before) : NULL;
+    if (before > 0 && !previous) return 0;
+    for (int i = 0; i < before; i++) {
+        ember_value value = vm->globals[i].value;
+        previous[i] = is_script_function(value) ? value.as.func_val.chunk : NULL;
+    }
+
+    // Everything written out needs its code
+    bool lazy_functions = vm->lazy_functions;
+    vm->lazy_functions = false;
+    int ok = compile(vm, source, main);
+    vm->lazy_functions = lazy_functions;
+    int* slots = ok ? malloc(sizeof(int) * (vm->global_count > 0 ? vm->global_count : 1)) : NULL;
+    ok = ok && slots;
+    int slot_count = 0;
+    for (int i = 0; ok && i < vm->global_count; i++) {
+        ember_value value = vm->globals[i].value;
+        if (is_script_function(value) && (i >= before || previous[i] != value.as.func_val.chunk)) {
+            slots[slot_count++] = i;
+        }
+    }
+    ok = ok && bytecode_serialize(vm, main, slots, slot_count, data, size);
+
+    free(slots);
+    free(previous);
+    return ok;
+}
+
+int ember_bytecode_compile(ember_vm* vm, const char* source, uint8_t** data, size_t* size) {
+    ember_chunk* main = malloc(sizeof(ember_chunk));
+    if (!main) return 0;
+    init_chunk(main);
+    int ok = ember_bytecode_compile_chunk(vm, source, main, data, size);
+    ember_bytecode_free_chunk(main);
+    return ok;
+}
+
+// ============================================================================
+// READER
+// ============================================================================
+
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+    int failed;
+} bytecode_cursor;
+
+static const uint8_t* cursor_take(bytecode_cursor* cursor, size_t size) {
+    if (cursor->failed || size > cursor->size - cursor->pos) {
+        cursor->failed = 1;
+        return NULL;
+    }
+    const uint8_t* bytes = cursor->data + cursor->pos;
+    cursor->pos += size;
+    return bytes;
+}
+
+static uint32_t load_u32(const uint8_t* bytes) {
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) |
+           ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static uint8_t get_u8(bytecode_cursor* cursor) {
+    const uint8_t* bytes = cursor_take(cursor, 1);
+    return bytes ? bytes[0] : 0;
+}
+
+static uint32_t get_u32(bytecode_cursor* cursor) {
+    const uint8_t* bytes = cursor_take(cursor, 4);
+    return bytes ? load_u32(bytes) : 0;
+}
+
+static double get_number(bytecode_cursor* cursor) {
+    uint64_t low = get_u32(cursor);
+    uint64_t high = get_u32(cursor);
+    uint64_t bits = low | (high << 32);
+    double number;
+    memcpy(&number, &bits, sizeof(number));
+    return number;
+}
+
+// Returns the string bytes (not NUL-terminated), or NULL for a NULL string
+static const char* get_string(bytecode_cursor* cursor, uint32_t* length) {
+    *length = get_u32(cursor);
+    if (*length == BYTECODE_NULL_STRING) return NULL;
+    return (const char*)cursor_take(cursor, *length);
+}
+
+static char* copy_name(const char* chars, uint32_t length) {
+    if (!chars) return NULL;
+    char* name = malloc((size_t)length + 1);
+    if (!name) return NULL;
+    memcpy(name, chars, length);
+    name[length] = '\0';
+    return name;
+}
+
+static void free_chunks(ember_chunk** chunks, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        ember_bytecode_free_chunk(chunks[i]);
+    }
+    free(chunks);
+}
+
+static int read_constant(ember_vm* vm, bytecode_cursor* cursor, ember_chunk** chunks,
+                         uint32_t chunk_count, ember_value* value) {
+    uint8_t tag = get_u8(cursor);
+    switch (tag) {
+        case EMBER_VAL_NIL:
+            *value = ember_make_nil();
+            break;
+        case EMBER_VAL_BOOL:
+            *value = ember_make_bool(get_u8(cursor));
+            break;
+        case EMBER_VAL_NUMBER:
+            *value = ember_make_number(get_number(cursor));
+            break;
+        case EMBER_VAL_STRING: {
+            uint32_t length;
+            const char* chars = get_string(cursor, &length);
+            if (!chars || length > INT_MAX) return 0;
+            ember_string* string = intern_string(vm, chars, (int)length);
+            if (!string) return 0;
+            value->type = EMBER_VAL_STRING;
+            value->as.obj_val = (ember_object*)string;
+            break;
+        }
+        case EMBER_VAL_FUNCTION: {
+            uint32_t index = get_u32(cursor);
+            uint32_t length;
+            const char* name = get_string(cursor, &length);
+            if (cursor->failed || index >= chunk_count) return 0;
+            value->type = EMBER_VAL_FUNCTION;
+            value->as.func_val.chunk = chunks[index];
+            value->as.func_val.name = copy_name(name, length);
+            ember_chunk_set_name(chunks[index], value->as.func_val.name);
+            break;
+        }
+        default:
+            return 0;
+    }
+    return !cursor->failed;
+}
+
+static int read_header(const uint8_t* data, size_t size) {
+    if (size < EMBER_BYTECODE_HEADER_SIZE || memcmp(data, EMBER_BYTECODE_MAGIC, 4) != 0) {
+        fprintf(stderr, "[BYTECODE] Not an Ember bytecode file\n");
+        return 0;
+    }
+    int version = data[EMBER_BYTECODE_OFF_VERSION] | (data[EMBER_BYTECODE_OFF_VERSION + 1] << 8);
+    int opcodes = data[EMBER_BYTECODE_OFF_OPCODES] | (data[EMBER_BYTECODE_OFF_OPCODES + 1] << 8);
+    if (version != EMBER_BYTECODE_VERSION || opcodes != OP_HALT + 1) {
+        fprintf(stderr, "[BYTECODE] Bytecode was written by an incompatible Ember build (format %d)\n", version);
+        return 0;
+    }
+    if (load_u32(data + EMBER_BYTECODE_OFF_SIZE) != size) {
+        fprintf(stderr, "[BYTECODE] Bytecode file is truncated\n");
+        return 0;
+    }
+    uint32_t checksum = ember_bytecode_checksum(data + EMBER_BYTECODE_HEADER_SIZE, size - EMBER_BYTECODE_HEADER_SIZE);
+    if (load_u32(data + EMBER_BYTECODE_OFF_CHECKSUM) != checksum) {
+        fprintf(stderr, "[BYTECODE] Bytecode checksum mismatch\n");
+        return 0;
+    }
+    return 1;
+}
+
+static ember_chunk* bytecode_load(ember_vm* vm, const uint8_t* data, size_t size, int borrow_code) {
+    if (!vm || !data || !read_header(data, size)) return NULL;
+
+    uint32_t chunk_count = load_u32(data + EMBER_BYTECODE_OFF_CHUNKS);
+    uint32_t function_count = load_u32(data + EMBER_BYTECODE_OFF_FUNCTIONS);
+    uint32_t main_index = load_u32(data + EMBER_BYTECODE_OFF_MAIN);
+    if (chunk_count == 0 || main_index >= chunk_count ||
+        chunk_count > (size - EMBER_BYTECODE_HEADER_SIZE) / BYTECODE_CHUNK_ENTRY_SIZE) {
+        fprintf(stderr, "[BYTECODE] Malformed chunk table\n");
+        return NULL;
+    }
+
+    ember_chunk** chunks = calloc(chunk_count, sizeof(ember_chunk*));
+    if (!chunks) return NULL;
+    for (uint32_t i = 0; i < chunk_count; i++) {
+        chunks[i] = malloc(sizeof(ember_chunk));
+        if (!chunks[i]) {
+            free_chunks(chunks, chunk_count);
+            return NULL;
+        }
+        init_chunk(chunks[i]);
+    }
+
+    // Interned constant strings are only reachable through the chunks being
+    // built, so collection waits until they are attached
+    int64_t saved_next_gc = vm->next_gc;
+    vm->next_gc = INT64_MAX;
+
+    int ok = 1;
+    const uint8_t* table = data + EMBER_BYTECODE_HEADER_SIZE;
+    for (uint32_t i = 0; ok && i < chunk_count; i++) {
+        const uint8_t* entry = table + (size_t)i * BYTECODE_CHUNK_ENTRY_SIZE;
+        uint32_t code_offset = load_u32(entry);
+        uint32_t code_size = load_u32(entry + 4);
+        uint32_t constants_offset = load_u32(entry + 8);
+        uint32_t const_count = load_u32(entry + 12);
+        if (code_offset > size || code_size > size - code_offset || constants_offset > size ||
+            code_size > INT_MAX || const_count > EMBER_CONST_POOL_MAX) {
+            ok = 0;
+            break;
+        }
+
+        ember_chunk* chunk = chunks[i];
+        if (code_size > 0 && borrow_code) {
+            // Never written after compilation, so every VM can run the same bytes
+            chunk->code = (uint8_t*)(data + code_offset);
+            chunk->count = (int)code_size;
+            chunk->capacity = (int)code_size;
+            chunk->code_borrowed = 1;
+        } else if (code_size > 0) {
+            chunk->code = malloc(code_size);
+            if (!chunk->code) {
+                ok = 0;
+                break;
+            }
+            memcpy(chunk->code, data + code_offset, code_size);
+            chunk->count = (int)code_size;
+            chunk->capacity = (int)code_size;
+        }
+
+        bytecode_cursor cursor = {data, size, constants_offset, 0};
+        for (uint32_t k = 0; ok && k < const_count; k++) {
+            ember_value value;
+            // A file add_constant wrote has no duplicates to be merged out of place
+            ok = read_constant(vm, &cursor, chunks, chunk_count, &value) && add_constant(chunk, value) == (int)k;
+        }
+
+        // Handler offsets must stay inside the chunk's code
+        uint32_t handler_count = ok ? get_u32(&cursor) : 0;
+        if (handler_count > code_size + 1) ok = 0;
+        for (uint32_t h = 0; ok && h < handler_count; h++) {
+            uint32_t start = get_u32(&cursor);
+            uint32_t end = get_u32(&cursor);
+            uint32_t handler = get_u32(&cursor);
+            uint32_t stack_depth = get_u32(&cursor);
+            uint32_t kind = get_u32(&cursor);
+            if (cursor.failed || start > end || end > code_size || handler >= code_size ||
+                stack_depth > EMBER_STACK_MAX || kind > EMBER_HANDLER_FINALLY) {
+                ok = 0;
+                break;
+            }
+            ember_handler_entry entry = {(int)start, (int)end, (int)handler, (int)stack_depth, (int)kind};
+            ok = ember_chunk_add_handler(chunk, &entry) >= 0;
+        }
+
+        // Switch tables likewise; set checks the keys against the constants
+        uint32_t switch_table_count = ok ? get_u32(&cursor) : 0;
+        if (switch_table_count > code_size) ok = 0;
+        for (uint32_t t = 0; ok && t < switch_table_count; t++) {
+            uint32_t cases = get_u32(&cursor);
+            uint32_t default_target = get_u32(&cursor);
+            if (cursor.failed || cases > code_size || default_target > code_size) {
+                ok = 0;
+                break;
+            }
+            int* keys = cases > 0 ? malloc(sizeof(int) * cases) : NULL;
+            int* targets = cases > 0 ? malloc(sizeof(int) * cases) : NULL;
+            ok = cases == 0 || (keys && targets);
+            for (uint32_t i = 0; ok && i < cases; i++) {
+                uint32_t key = get_u32(&cursor);
+                uint32_t target = get_u32(&cursor);
+                if (cursor.failed || key >= const_count || target >= code_size) ok = 0;
+                keys[i] = (int)key;
+                targets[i] = (int)target;
+            }
+            int index = ok ? ember_chunk_add_switch_table(chunk) : -1;
+            ok = index >= 0 &&
+                 ember_chunk_set_switch_table(chunk, index, keys, targets, (int)cases, (int)default_target);
+            free(keys);
+            free(targets);
+        }
+
+        // The line table is checked against the code as it is installed
+        uint32_t line_table_length = 0;
+        const char* line_table = ok ? get_string(&cursor, &line_table_length) : NULL;
+        ok = ok && line_table && line_table_length <= INT_MAX &&
+             ember_chunk_set_line_table(chunk, (const uint8_t*)line_table, (int)line_table_length);
+        ok = ok && !cursor.failed;
+    }
+
+    // Function table sits right after the chunk table
+    typedef struct {
+        uint32_t chunk;
+        char* key;
+        char* name;
+    } pending_function;
+    pending_function* functions = function_count > 0 ? calloc(function_count, sizeof(pending_function)) : NULL;
+    if (function_count > 0 && !functions) ok = 0;
+    bytecode_cursor cursor = {data, size, EMBER_BYTECODE_HEADER_SIZE + (size_t)chunk_count * BYTECODE_CHUNK_ENTRY_SIZE, 0};
+    for (uint32_t i = 0; ok && i < function_count; i++) {
+        uint32_t key_length;
+        uint32_t name_length;
+        functions[i].chunk = get_u32(&cursor);
+        const char* key = get_string(&cursor, &key_length);
+        const char* name = get_string(&cursor, &name_length);
+        if (cursor.failed || !key || functions[i].chunk >= chunk_count || functions[i].chunk == main_index) {
+            ok = 0;
+            break;
+        }
+        functions[i].key = copy_name(key, key_length);
+        functions[i].name = copy_name(name, name_length);
+        ok = functions[i].key && (functions[i].name || !name);
+    }
+
+    ember_chunk* main = NULL;
+    if (ok) {
+        // Everything validated: hand the chunks to the VM and bind the functions
+        for (uint32_t i = 0; i < chunk_count; i++) {
+            if (i != main_index) track_function_chunk(vm, chunks[i]);
+        }
+        for (uint32_t i = 0; i < function_count; i++) {
+            ember_value func_val;
+            func_val.type = EMBER_VAL_FUNCTION;
+            func_val.as.func_val.chunk = chunks[functions[i].chunk];
+            func_val.as.func_val.name = functions[i].name;
+            ember_chunk_set_name(func_val.as.func_val.chunk, functions[i].name);
+            ember_global_define(vm, functions[i].key, func_val);
+            free(functions[i].key);
+        }
+        main = chunks[main_index];
+        free(chunks);
+    } else {
+        fprintf(stderr, "[BYTECODE] Malformed bytecode data\n");
+        for (uint32_t i = 0; functions && i < function_count; i++) {
+            free(functions[i].key);
+            free(functions[i].name);
+        }
+        free_chunks(chunks, chunk_count);
+    }
+    free(functions);
+    vm->next_gc = saved_next_gc;
+    return main;
+}
+
+ember_chunk* ember_bytecode_load(ember_vm* vm, const uint8_t* data, size_t size) {
+    return bytecode_load(vm, data, size, 0);
+}
+
+ember_chunk* ember_bytecode_load_shared(ember_vm* vm, const uint8_t* data, size_t size) {
+    return bytecode_load(vm, data, size, 1);
+}
+
+void ember_bytecode_free_chunk(ember_chunk* chunk) {
+    if (!chunk) return;
+    ember_chunk_free_handlers(chunk);
+    ember_chunk_free_switch_tables(chunk);
+    ember_chunk_free_constant_index(chunk);
+    if (chunk->code_borrowed) {
+        chunk->code = NULL;
+        chunk->count = 0;
+        chunk->capacity = 0;
+    }
+    free_chunk(chunk);
+    free(chunk);
+}
+
+int ember_bytecode_run(ember_vm* vm, ember_chunk* chunk) {
+    ember_chunk* saved_chunk = vm->chunk;
+    uint8_t* saved_ip = vm->ip;
+    vm->chunk = chunk;
+    vm->ip = chunk->code;
+    int result = ember_run(vm);
+    vm->chunk = saved_chunk;
+    vm->ip = saved_ip;
+    return result;
+}
+
+// ============================================================================
+// FILES
+// ============================================================================
+
+int ember_bytecode_write_file(const char* path, const uint8_t* data, size_t size) {
+    if (!path || !data) return 0;
+
+    // Readers never see a partial file: write beside it, then rename over it
+    char temp_path[PATH_MAX];
+    int written = snprintf(temp_path, sizeof(temp_path), "%s.tmp.%ld", path, (long)getpid());
+    if (written < 0 || (size_t)written >= sizeof(temp_path)) {
+        fprintf(stderr, "[BYTECODE] Output path too long: %s\n", path);
+        return 0;
+    }
+
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "[BYTECODE] Cannot create %s\n", temp_path);
+        return 0;
+    }
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = write(fd, data + done, size - done);
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+    int ok = done == size && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    if (ok && rename(temp_path, path) != 0) ok = 0;
+    if (!ok) {
+        fprintf(stderr, "[BYTECODE] Failed to write %s\n", path);
+        unlink(temp_path);
+    }
+    return ok;
+}
+
+ember_chunk* ember_bytecode_load_file(ember_vm* vm, const char* path) {
+    if (!vm || !path) return NULL;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < EMBER_BYTECODE_HEADER_SIZE || (uint64_t)info.st_size > UINT32_MAX) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = (size_t)info.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "[BYTECODE] Cannot map %s\n", path);
+        return NULL;
+    }
+    ember_chunk* chunk = ember_bytecode_load(vm, (const uint8_t*)mapping, size);
+    munmap(mapping, size);
+    return chunk;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+static char* read_source_file(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "[BYTECODE] Cannot open %s\n", path);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* source = length >= 0 ? malloc((size_t)length + 1) : NULL;
+    if (!source || fread(source, 1, (size_t)length, file) != (size_t)length) {
+        fprintf(stderr, "[BYTECODE] Failed to read %s\n", path);
+        free(source);
+        fclose(file);
+        return NULL;
+    }
+    source[length] = '\0';
+    fclose(file);
+    return source;
+}
+
+int ember_compile_file(ember_vm* vm, const char* source_path, const char* output_path) {
+    if (!vm || !source_path || !output_path) return -1;
+    char* source = read_source_file(source_path);
+    if (!source) return -1;
+
+    // A leading shebang line is not Ember source
+    const char* body = source;
+    if (source[0] == '#' && source[1] == '!') {
+        const char* newline = strchr(source, '\n');
+        body = newline ? newline + 1 : source + strlen(source);
+    }
+
+    uint8_t* data = NULL;
+    size_t size = 0;
+    int ok = ember_bytecode_compile(vm, body, &data, &size) &&
+             ember_bytecode_write_file(output_path, data, size);
+    free(data);
+    free(source);
+    return ok ? 0 : -1;
+}
+
+int ember_run_bytecode_file(ember_vm* vm, const char* path) {
+    if (!vm || !path) return -1;
+    ember_chunk* chunk = ember_bytecode_load_file(vm, path);
+    if (!chunk) {
+        fprintf(stderr, "[BYTECODE] Cannot load bytecode from %s\n", path);
+        return -1;
+    }
+
+    int result = ember_bytecode_run(vm, chunk);
+    ember_bytecode_free_chunk(chunk);
+    return result;
+}
@@ -0,0 +1,78 @@
+#ifndef EMBER_BYTECODE_FORMAT_H
+#define EMBER_BYTECODE_FORMAT_H
+
+#include "../../include/ember.h"
+#include <stddef.h>
+
+// On-disk compiled bytecode (.emberc). Every field is little-endian and
+// fixed-width, sections start 8-byte aligned, and all references are file
+// offsets, so a mapped file is read in place without any parsing.
+//
+//   header   32 bytes, see below
+//   chunks   chunk_count x {u32 code_offset, u32 code_size,
+//                           u32 constants_offset, u32 const_count}
+//   globals  function_count x {u32 chunk, string global, string name}:
+//            functions the unit defines, bound before the main chunk runs
+//   data     per chunk: code bytes, then its constants, then its exception
+//            table: u32 count and count x {u32 start, u32 end, u32 handler,
+//            u32 stack_depth, u32 kind}, then its switch tables: u32 count
+//            and count x {u32 cases, u32 default, cases x {u32 constant,
+//            u32 target}}, then its line table as a string (the encoded
+//            runs of ember_chunk_set_line_table)
+//
+// A constant is a u8 EMBER_VAL_* tag followed by nothing (nil), a u8 (bool),
+// an IEEE-754 double (number), a string, or {u32 chunk, string name}
+// (function). A string is a u32 length and the bytes; length 0xFFFFFFFF
+// stands for a NULL name.
+
+#define EMBER_BYTECODE_MAGIC "EMBC"
+#define EMBER_BYTECODE_VERSION 4
+#define EMBER_BYTECODE_HEADER_SIZE 32
+
+// Header layout (byte offsets)
+#define EMBER_BYTECODE_OFF_MAGIC      0   // 4 bytes
+#define EMBER_BYTECODE_OFF_VERSION    4   // u16 format version
+#define EMBER_BYTECODE_OFF_OPCODES    6   // u16 OP_HALT + 1 of the writing build
+#define EMBER_BYTECODE_OFF_CHUNKS     8   // u32 chunk count
+#define EMBER_BYTECODE_OFF_FUNCTIONS  12  // u32 global function count
+#define EMBER_BYTECODE_OFF_MAIN       16  // u32 index of the top-level chunk
+#define EMBER_BYTECODE_OFF_SIZE       20  // u32 total file size
+#define EMBER_BYTECODE_OFF_CHECKSUM   24  // u32 FNV-1a of everything after the header
+#define EMBER_BYTECODE_OFF_RESERVED   28  // u32, zero
+
+// Compile source and serialize the result into a malloc'd buffer; the
+// functions it defines are also bound in vm as usual. Returns 1 on success.
+int ember_bytecode_compile(ember_vm* vm, const char* source, uint8_t** data, size_t* size);
+// Same, compiling into the caller's initialized chunk, which stays runnable
+int ember_bytecode_compile_chunk(ember_vm* vm, const char* source, ember_chunk* main,
+                                 uint8_t** data, size_t* size);
+
+// Validate data and rebuild its chunks: function chunks are tracked by vm
+// and bound as globals, the returned top-level chunk is owned by the caller
+// (release it with ember_bytecode_free_chunk). NULL if data is not valid.
+ember_chunk* ember_bytecode_load(ember_vm* vm, const uint8_t* data, size_t size);
+// Same, but the chunks run the code in data instead of a copy (code_borrowed),
+// so data must outlive them; used for shared module images
+ember_chunk* ember_bytecode_load_shared(ember_vm* vm, const uint8_t* data, size_t size);
+void ember_bytecode_free_chunk(ember_chunk* chunk);
+
+// Run a top-level chunk with ember_run, restoring vm->chunk/ip afterwards
+int ember_bytecode_run(ember_vm* vm, ember_chunk* chunk);
+
+// File helpers: writes go to a temporary file renamed into place, loads
+// map the file read-only
+int ember_bytecode_write_file(const char* path, const uint8_t* data, size_t size);
+ember_chunk* ember_bytecode_load_file(ember_vm* vm, const char* path);
+
+// FNV-1a over a byte range (the header checksum)
+uint32_t ember_bytecode_checksum(const uint8_t* data, size_t size);
+
+// Bytecode cache (ember_set_bytecode_cache_dir). Units are stored as
+// <dir>/<key>.emberc, the key hashing the source text with the Ember version
+// and bytecode format (ember_bytecode_source_key, which warm-start profiles
+// are keyed by too), so an upgraded build never reads stale entries.
+// Returns 0 and writes the path on success, -1 when no cache is configured.
+uint64_t ember_bytecode_source_key(const char* source);
+int ember_bytecode_cache_path(const char* source, char* path, size_t path_size);
+
+#endif // EMBER_BYTECODE_FORMAT_H
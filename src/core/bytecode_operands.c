@@ -0,0 +1,297 @@
+#include "../../include/ember.h"
+#include "../vm.h"
+#include <stdio.h>
+
+// Single-operand instructions are encoded as `op operand` while the operand
+// fits in a byte and as `OP_WIDE op hi lo` (16-bit, big-endian) beyond that
+
+static void write_wide_operand(ember_chunk* chunk, uint8_t op, int operand) {
+    write_chunk(chunk, OP_WIDE);
+    write_chunk(chunk, op);
+    write_chunk(chunk, (uint8_t)((operand >> 8) & 0xFF));
+    write_chunk(chunk, (uint8_t)(operand & 0xFF));
+}
+
+// Emit op with a constant index, local slot or known jump offset; returns 0 if
+// the operand cannot be encoded
+int write_chunk_op(ember_chunk* chunk, uint8_t op, int operand) {
+    if (operand < 0 || operand > EMBER_WIDE_OPERAND_MAX) {
+        fprintf(stderr, "[SECURITY] Operand %d out of range for opcode %d\n", operand, op);
+        return 0;
+    }
+
+    if (operand <= 0xFF) {
+        write_chunk(chunk, op);
+        write_chunk(chunk, (uint8_t)operand);
+    } else {
+        write_wide_operand(chunk, op, operand);
+    }
+    return 1;
+}
+
+// Emit a jump whose offset is patched later. Its distance is unknown here,
+// so the wide form is reserved; returns the position of the operand
+int write_chunk_jump(ember_chunk* chunk, uint8_t op) {
+    write_wide_operand(chunk, op, EMBER_WIDE_OPERAND_MAX);
+    return chunk->count - 2;
+}
+
+// Fill in the operand of a jump emitted by write_chunk_jump; returns 0 if the
+// offset does not fit
+int patch_chunk_jump(ember_chunk* chunk, int operand_pos, int offset) {
+    if (offset < 0 || offset > EMBER_WIDE_OPERAND_MAX ||
+        operand_pos < 2 || operand_pos + 1 >= chunk->count) {
+        return 0;
+    }
+    chunk->code[operand_pos] = (uint8_t)((offset >> 8) & 0xFF);
+    chunk->code[operand_pos + 1] = (uint8_t)(offset & 0xFF);
+    return 1;
+}
+
+// Decode the single-operand instruction starting at offset (which may be an
+// OP_WIDE prefix): stores its opcode and total size, returns the operand
+int read_chunk_operand(const ember_chunk* chunk, int offset, uint8_t* op, int* length) {
+    if (chunk->code[offset] == OP_WIDE && offset + 3 < chunk->count) {
+        if (op) *op = chunk->code[offset + 1];
+        if (length) *length = 4;
+        return (chunk->code[offset + 2] << 8) | chunk->code[offset + 3];
+    }
+    if (op) *op = chunk->code[offset];
+    if (length) *length = 2;
+    return offset + 1 < chunk->count ? chunk->code[offset + 1] : 0;
+}
+
+// Whether op carries an operand (and so may follow OP_WIDE); every other
+// opcode is a single byte
+int opcode_has_operand(uint8_t op) {
+    switch (op) {
+        case OP_PUSH_CONST:
+        case OP_JUMP:
+        case OP_JUMP_IF_FALSE:
+        case OP_JUMP_IF_TRUE:
+        case OP_LOOP:
+        case OP_CALL:
+        case OP_TAIL_CALL:
+        case OP_SET_LOCAL:
+        case OP_GET_LOCAL:
+        case OP_SET_GLOBAL:
+        case OP_GET_GLOBAL:
+        case OP_ARRAY_NEW:
+        case OP_HASH_MAP_NEW:
+        case OP_CONCAT_N:
+        case OP_BREAK:
+        case OP_CONTINUE:
+        case OP_TRY_BEGIN:
+        case OP_CATCH_BEGIN:
+        case OP_CLASS_DEF:
+        case OP_GET_PROPERTY:
+        case OP_SET_PROPERTY:
+        case OP_INVOKE:
+        case OP_INHERIT:
+        case OP_GET_SUPER:
+        case OP_CASE:
+        case OP_SWITCH_TABLE:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Size of a superinstruction including its fixed 16-bit operands, or 0 if
+// op is not one
+int opcode_fused_size(uint8_t op) {
+    switch (op) {
+        case OP_ADD_LOCAL_CONST:
+        case OP_SUB_LOCAL_CONST:
+            return 5;
+        case OP_LOCAL_LESS_CONST_JUMP_IF_FALSE:
+        case OP_LOCAL_LESS_EQUAL_CONST_JUMP_IF_FALSE:
+        case OP_LOCAL_GREATER_CONST_JUMP_IF_FALSE:
+        case OP_LOCAL_GREATER_EQUAL_CONST_JUMP_IF_FALSE:
+        case OP_CALL_GUARD:
+            return 7;
+        default:
+            return 0;
+    }
+}
+
+// The arithmetic or comparison opcode a superinstruction applies, so its
+// unfused fallback (and disassembly) can be expressed in plain opcodes
+uint8_t opcode_fused_operation(uint8_t op) {
+    switch (op) {
+        case OP_ADD_LOCAL_CONST:                         return OP_ADD;
+        case OP_SUB_LOCAL_CONST:                         return OP_SUB;
+        case OP_LOCAL_LESS_CONST_JUMP_IF_FALSE:          return OP_LESS;
+        case OP_LOCAL_LESS_EQUAL_CONST_JUMP_IF_FALSE:    return OP_LESS_EQUAL;
+        case OP_LOCAL_GREATER_CONST_JUMP_IF_FALSE:       return OP_GREATER;
+        case OP_LOCAL_GREATER_EQUAL_CONST_JUMP_IF_FALSE: return OP_GREATER_EQUAL;
+        default:                                         return op;
+    }
+}
+
+// The generic opcode behind a quickened one; other opcodes map to themselves
+uint8_t opcode_generic(uint8_t op) {
+    switch (op) {
+        case OP_ADD_NUMBER:             return OP_ADD;
+        case OP_SUB_NUMBER:             return OP_SUB;
+        case OP_MUL_NUMBER:             return OP_MUL;
+        case OP_DIV_NUMBER:             return OP_DIV;
+        case OP_MOD_NUMBER:             return OP_MOD;
+        case OP_LESS_NUMBER:            return OP_LESS;
+        case OP_LESS_EQUAL_NUMBER:      return OP_LESS_EQUAL;
+        case OP_GREATER_NUMBER:         return OP_GREATER;
+        case OP_GREATER_EQUAL_NUMBER:   return OP_GREATER_EQUAL;
+        case OP_ARRAY_GET_NUMBER_INDEX: return OP_ARRAY_GET;
+        default:                        return op;
+    }
+}
+
+// Mnemonic of op for reports and disassembly, or NULL for an unused value
+const char* opcode_name(uint8_t op) {
+    static const char* const names[256] = {
+        [OP_PUSH_CONST] = "PUSH_CONST",
+        [OP_POP] = "POP",
+        [OP_ADD] = "ADD",
+        [OP_SUB] = "SUB",
+        [OP_MUL] = "MUL",
+        [OP_DIV] = "DIV",
+        [OP_MOD] = "MOD",
+        [OP_EQUAL] = "EQUAL",
+        [OP_NOT_EQUAL] = "NOT_EQUAL",
+        [OP_LESS] = "LESS",
+        [OP_LESS_EQUAL] = "LESS_EQUAL",
+        [OP_GREATER] = "GREATER",
+        [OP_GREATER_EQUAL] = "GREATER_EQUAL",
+        [OP_JUMP] = "JUMP",
+        [OP_JUMP_IF_FALSE] = "JUMP_IF_FALSE",
+        [OP_JUMP_IF_TRUE] = "JUMP_IF_TRUE",
+        [OP_LOOP] = "LOOP",
+        [OP_CALL] = "CALL",
+        [OP_RETURN] = "RETURN",
+        [OP_SET_LOCAL] = "SET_LOCAL",
+        [OP_GET_LOCAL] = "GET_LOCAL",
+        [OP_SET_GLOBAL] = "SET_GLOBAL",
+        [OP_GET_GLOBAL] = "GET_GLOBAL",
+        [OP_AND] = "AND",
+        [OP_OR] = "OR",
+        [OP_NOT] = "NOT",
+        [OP_ARRAY_NEW] = "ARRAY_NEW",
+        [OP_ARRAY_GET] = "ARRAY_GET",
+        [OP_ARRAY_SET] = "ARRAY_SET",
+        [OP_ARRAY_LEN] = "ARRAY_LEN",
+        [OP_HASH_MAP_NEW] = "HASH_MAP_NEW",
+        [OP_HASH_MAP_GET] = "HASH_MAP_GET",
+        [OP_HASH_MAP_SET] = "HASH_MAP_SET",
+        [OP_HASH_MAP_LEN] = "HASH_MAP_LEN",
+        [OP_STRING_INTERPOLATE] = "STRING_INTERPOLATE",
+        [OP_CONCAT_N] = "CONCAT_N",
+        [OP_BREAK] = "BREAK",
+        [OP_CONTINUE] = "CONTINUE",
+        [OP_TRY_BEGIN] = "TRY_BEGIN",
+        [OP_TRY_END] = "TRY_END",
+        [OP_CATCH_BEGIN] = "CATCH_BEGIN",
+        [OP_CATCH_END] = "CATCH_END",
+        [OP_FINALLY_BEGIN] = "FINALLY_BEGIN",
+        [OP_FINALLY_END] = "FINALLY_END",
+        [OP_THROW] = "THROW",
+        [OP_RETHROW] = "RETHROW",
+        [OP_POP_HANDLER] = "POP_HANDLER",
+        [OP_CATCH_TYPE] = "CATCH_TYPE",
+        [OP_EXCEPTION_MATCH] = "EXCEPTION_MATCH",
+        [OP_CLASS_DEF] = "CLASS_DEF",
+        [OP_METHOD_DEF] = "METHOD_DEF",
+        [OP_INSTANCE_NEW] = "INSTANCE_NEW",
+        [OP_GET_PROPERTY] = "GET_PROPERTY",
+        [OP_SET_PROPERTY] = "SET_PROPERTY",
+        [OP_INVOKE] = "INVOKE",
+        [OP_INHERIT] = "INHERIT",
+        [OP_GET_SUPER] = "GET_SUPER",
+        [OP_PROMISE_NEW] = "PROMISE_NEW",
+        [OP_PROMISE_RESOLVE] = "PROMISE_RESOLVE",
+        [OP_PROMISE_REJECT] = "PROMISE_REJECT",
+        [OP_AWAIT] = "AWAIT",
+        [OP_YIELD] = "YIELD",
+        [OP_GENERATOR_NEW] = "GENERATOR_NEW",
+        [OP_GENERATOR_NEXT] = "GENERATOR_NEXT",
+        [OP_SET_NEW] = "SET_NEW",
+        [OP_SET_ADD] = "SET_ADD",
+        [OP_SET_HAS] = "SET_HAS",
+        [OP_SET_DELETE] = "SET_DELETE",
+        [OP_SET_SIZE] = "SET_SIZE",
+        [OP_SET_CLEAR] = "SET_CLEAR",
+        [OP_MAP_NEW] = "MAP_NEW",
+        [OP_MAP_SET] = "MAP_SET",
+        [OP_MAP_GET] = "MAP_GET",
+        [OP_MAP_HAS] = "MAP_HAS",
+        [OP_MAP_DELETE] = "MAP_DELETE",
+        [OP_MAP_SIZE] = "MAP_SIZE",
+        [OP_MAP_CLEAR] = "MAP_CLEAR",
+        [OP_REGEX_NEW] = "REGEX_NEW",
+        [OP_REGEX_TEST] = "REGEX_TEST",
+        [OP_REGEX_MATCH] = "REGEX_MATCH",
+        [OP_REGEX_REPLACE] = "REGEX_REPLACE",
+        [OP_REGEX_SPLIT] = "REGEX_SPLIT",
+        [OP_SWITCH] = "SWITCH",
+        [OP_CASE] = "CASE",
+        [OP_DEFAULT] = "DEFAULT",
+        [OP_MODULE_INIT] = "MODULE_INIT",
+        [OP_MODULE_EXPORT] = "MODULE_EXPORT",
+        [OP_MODULE_EXPORT_DEFAULT] = "MODULE_EXPORT_DEFAULT",
+        [OP_MODULE_IMPORT] = "MODULE_IMPORT",
+        [OP_MODULE_IMPORT_ALL] = "MODULE_IMPORT_ALL",
+        [OP_MODULE_REQUIRE] = "MODULE_REQUIRE",
+        [OP_ADD_LOCAL_CONST] = "ADD_LOCAL_CONST",
+        [OP_SUB_LOCAL_CONST] = "SUB_LOCAL_CONST",
+        [OP_LOCAL_LESS_CONST_JUMP_IF_FALSE] = "LOCAL_LESS_CONST_JUMP_IF_FALSE",
+        [OP_LOCAL_LESS_EQUAL_CONST_JUMP_IF_FALSE] = "LOCAL_LESS_EQUAL_CONST_JUMP_IF_FALSE",
+        [OP_LOCAL_GREATER_CONST_JUMP_IF_FALSE] = "LOCAL_GREATER_CONST_JUMP_IF_FALSE",
+        [OP_LOCAL_GREATER_EQUAL_CONST_JUMP_IF_FALSE] = "LOCAL_GREATER_EQUAL_CONST_JUMP_IF_FALSE",
+        [OP_TAIL_CALL] = "TAIL_CALL",
+        [OP_SWITCH_TABLE] = "SWITCH_TABLE",
+        [OP_CALL_GUARD] = "CALL_GUARD",
+        [OP_BREAKPOINT] = "BREAKPOINT",
+        [OP_ADD_NUMBER] = "ADD_NUMBER",
+        [OP_SUB_NUMBER] = "SUB_NUMBER",
+        [OP_MUL_NUMBER] = "MUL_NUMBER",
+        [OP_DIV_NUMBER] = "DIV_NUMBER",
+        [OP_MOD_NUMBER] = "MOD_NUMBER",
+        [OP_LESS_NUMBER] = "LESS_NUMBER",
+        [OP_LESS_EQUAL_NUMBER] = "LESS_EQUAL_NUMBER",
+        [OP_GREATER_NUMBER] = "GREATER_NUMBER",
+        [OP_GREATER_EQUAL_NUMBER] = "GREATER_EQUAL_NUMBER",
+        [OP_ARRAY_GET_NUMBER_INDEX] = "ARRAY_GET_NUMBER_INDEX",
+        [OP_WIDE] = "WIDE",
+        [OP_HALT] = "HALT",
+    };
+    return names[op];
+}
+
+static void write_u16(ember_chunk* chunk, int value) {
+    write_chunk(chunk, (uint8_t)((value >> 8) & 0xFF));
+    write_chunk(chunk, (uint8_t)(value & 0xFF));
+}
+
+// Emit a superinstruction. Compare-and-branch forms get a placeholder offset
+// and return its position for patch_chunk_jump; others return 0. Returns -1
+// if an operand does not fit
+int write_chunk_fused(ember_chunk* chunk, uint8_t op, int slot, int constant) {
+    int size = opcode_fused_size(op);
+    if (size == 0 || slot < 0 || slot > EMBER_WIDE_OPERAND_MAX ||
+        constant < 0 || constant > EMBER_WIDE_OPERAND_MAX) {
+        fprintf(stderr, "[SECURITY] Invalid superinstruction operands for opcode %d\n", op);
+        return -1;
+    }
+    write_chunk(chunk, op);
+    write_u16(chunk, slot);
+    write_u16(chunk, constant);
+    if (size == 7) {
+        write_u16(chunk, EMBER_WIDE_OPERAND_MAX);
+        return chunk->count - 2;
+    }
+    return 0;
+}
+
+int read_chunk_u16(const ember_chunk* chunk, int offset) {
+    if (offset < 0 || offset + 1 >= chunk->count) return 0;
+    return (chunk->code[offset] << 8) | chunk->code[offset + 1];
+}
@@ -0,0 +1,123 @@
+#include "../../include/ember.h"
+#include "../runtime/value/value.h"
+#include "../vm.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Constant pool index. The compiler adds through ember_chunk_add_constant,
+// which asks ember_chunk_find_constant for an equal constant before
+// appending, so a name or literal used twenty times in a function takes one
+// slot instead of twenty. add_constant itself always appends: the loader and
+// snapshot cloning need every constant back in its own slot. Nil, booleans, numbers
+// and strings are shared; numbers only with the same bits, so 0 and -0
+// stay apart and NaN finds itself. Functions and other objects are never
+// merged. Small pools are scanned; past CONSTANT_INDEX_MIN the chunk keeps
+// an open-addressed table from value to slot, which catches up with
+// constants appended since the last lookup, so chunks filled without it
+// (loaded, cloned) are indexed on first use.
+
+#define CONSTANT_INDEX_MIN 8
+
+static int constant_shareable(ember_value value) {
+    switch (value.type) {
+        case EMBER_VAL_NIL:
+        case EMBER_VAL_BOOL:
+        case EMBER_VAL_NUMBER:
+            return 1;
+        case EMBER_VAL_STRING:
+            return value.as.obj_val != NULL;
+        default:
+            return 0;
+    }
+}
+
+static int constants_same(ember_value a, ember_value b) {
+    if (a.type != b.type) return 0;
+    switch (a.type) {
+        case EMBER_VAL_NIL:
+            return 1;
+        case EMBER_VAL_BOOL:
+            return (a.as.bool_val != 0) == (b.as.bool_val != 0);
+        case EMBER_VAL_NUMBER:
+            return memcmp(&a.as.number_val, &b.as.number_val, sizeof(double)) == 0;
+        case EMBER_VAL_STRING:
+            return b.as.obj_val != NULL && values_equal_fast(a, b);
+        default:
+            return 0;
+    }
+}
+
+static uint32_t constant_hash(ember_value value) {
+    switch (value.type) {
+        case EMBER_VAL_BOOL:
+            return value.as.bool_val ? 0x9E3779B9u : 0x85EBCA6Bu;
+        case EMBER_VAL_NUMBER:
+        case EMBER_VAL_STRING:
+            return hash_value_fast(value);
+        default:
+            return 0;
+    }
+}
+
+static int index_grow(ember_chunk* chunk, int capacity) {
+    int* slots = calloc((size_t)capacity, sizeof(int));
+    if (!slots) return 0;
+    free(chunk->const_index);
+    chunk->const_index = slots;
+    chunk->const_index_capacity = capacity;
+    chunk->const_indexed = 0;
+    return 1;
+}
+
+// Enter constants [const_indexed, const_count); a later duplicate keeps the
+// first slot
+static int index_catch_up(ember_chunk* chunk) {
+    if (chunk->const_count * 2 > chunk->const_index_capacity) {
+        int capacity = chunk->const_index_capacity < 32 ? 32 : chunk->const_index_capacity;
+        while (capacity < chunk->const_count * 2) capacity *= 2;
+        if (!index_grow(chunk, capacity)) return 0;
+    }
+    uint32_t mask = (uint32_t)chunk->const_index_capacity - 1;
+    for (int i = chunk->const_indexed; i < chunk->const_count; i++) {
+        ember_value value = chunk->constants[i];
+        if (!constant_shareable(value)) continue;
+        uint32_t index = constant_hash(value) & mask;
+        while (chunk->const_index[index] &&
+               !constants_same(chunk->constants[chunk->const_index[index] - 1], value)) {
+            index = (index + 1) & mask;
+        }
+        if (!chunk->const_index[index]) chunk->const_index[index] = i + 1;
+    }
+    chunk->const_indexed = chunk->const_count;
+    return 1;
+}
+
+int ember_chunk_find_constant(ember_chunk* chunk, ember_value value) {
+    if (!chunk || !constant_shareable(value)) return -1;
+    if (chunk->const_count <= CONSTANT_INDEX_MIN || !index_catch_up(chunk)) {
+        for (int i = 0; i < chunk->const_count; i++) {
+            if (constants_same(chunk->constants[i], value)) return i;
+        }
+        return -1;
+    }
+    uint32_t mask = (uint32_t)chunk->const_index_capacity - 1;
+    for (uint32_t index = constant_hash(value) & mask; chunk->const_index[index]; index = (index + 1) & mask) {
+        int slot = chunk->const_index[index] - 1;
+        if (constants_same(chunk->constants[slot], value)) return slot;
+    }
+    return -1;
+}
+
+int ember_chunk_add_constant(ember_chunk* chunk, ember_value value) {
+    int existing = ember_chunk_find_constant(chunk, value);
+    if (existing >= 0) return existing;
+    return add_constant(chunk, value);
+}
+
+void ember_chunk_free_constant_index(ember_chunk* chunk) {
+    if (!chunk) return;
+    free(chunk->const_index);
+    chunk->const_index = NULL;
+    chunk->const_index_capacity = 0;
+    chunk->const_indexed = 0;
+}
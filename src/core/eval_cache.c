@@ -0,0 +1,286 @@
+#define _GNU_SOURCE
+#include "bytecode_format.h"
+#include "gc_trace.h"
+#include "../vm.h"
+#include "../frontend/parser/parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Compiled scripts and the eval cache (vm->eval_cache). A script is the
+// top-level chunk of one source plus the functions its compile bound, so
+// running it again is ember_eval without lexing and parsing. Scripts stay
+// with the VM that compiled them: chunks collect inline caches, type
+// feedback and JIT code for that VM as they run, so they are never shared.
+
+#define EVAL_CACHE_SIZE 1024                    // Sources kept per VM
+#define EVAL_CACHE_INDEX (EVAL_CACHE_SIZE * 2)  // Power of two, at most half full
+
+typedef struct {
+    char* key;
+    int slot;
+    ember_value value;
+} script_function;
+
+struct ember_script {
+    ember_vm* vm;
+    ember_chunk* chunk;            // Top-level code
+    char* source;
+    size_t length;
+    uint64_t hash;
+    script_function* functions;    // Bound again before every run, as ember_eval would
+    int function_count;
+    uint32_t globals_epoch;        // Table the function slots belong to
+    int refs;                      // Handles and runs, plus one while cached
+    bool cached;
+    uint64_t last_used;            // Cache clock at the last lookup
+    ember_script* prev;            // Every script of the VM, for the collector
+    ember_script* next;
+};
+
+typedef struct ember_eval_cache {
+    ember_script* entries[EVAL_CACHE_SIZE];
+    int count;
+    int index[EVAL_CACHE_INDEX];   // Open-addressed hash -> entry + 1 (0 = empty)
+    uint64_t clock;
+    ember_script* live;
+    uint64_t hits;
+    uint64_t misses;
+} ember_eval_cache;
+
+// 64-bit FNV-1a
+static uint64_t source_hash(const char* source, size_t length) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)source[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static bool is_script_function(ember_value value) {
+    return value.type == EMBER_VAL_FUNCTION && value.as.func_val.chunk != NULL;
+}
+
+static ember_eval_cache* eval_cache_for(ember_vm* vm) {
+    if (!vm->eval_cache) {
+        vm->eval_cache = calloc(1, sizeof(ember_eval_cache));
+    }
+    return vm->eval_cache;
+}
+
+static void script_free(ember_script* script) {
+    ember_eval_cache* cache = script->vm->eval_cache;
+    if (script->prev) {
+        script->prev->next = script->next;
+    } else if (cache) {
+        cache->live = script->next;
+    }
+    if (script->next) script->next->prev = script->prev;
+
+    ember_bytecode_free_chunk(script->chunk);
+    for (int i = 0; i < script->function_count; i++) {
+        free(script->functions[i].key);
+    }
+    free(script->functions);
+    free(script->source);
+    free(script);
+}
+
+static void script_unref(ember_script* script) {
+    if (--script->refs == 0) script_free(script);
+}
+
+// Compile source into a new script without references; NULL on a compile
+// error (already reported) or when out of memory
+static ember_script* script_compile(ember_vm* vm, ember_eval_cache* cache, const char* source,
+                                   size_t length, uint64_t hash) {
+    ember_script* script = calloc(1, sizeof(ember_script));
+    ember_chunk* chunk = malloc(sizeof(ember_chunk));
+    char* copy = malloc(length + 1);
+    // Functions are bound while compiling; remember what was there before
+    // so the script knows which ones are its own
+    int before = vm->global_count;
+    ember_chunk** previous = before > 0 ? malloc(sizeof(ember_chunk*) * before) : NULL;
+    if (!script || !chunk || !copy || (before > 0 && !previous)) {
+        free(script);
+        free(chunk);
+        free(copy);
+        free(previous);
+        return NULL;
+    }
+    for (int i = 0; i < before; i++) {
+        ember_value value = vm->globals[i].value;
+        previous[i] = is_script_function(value) ? value.as.func_val.chunk : NULL;
+    }
+
+    init_chunk(chunk);
+    int ok = compile(vm, source, chunk);
+    int count = 0;
+    for (int i = 0; ok && i < vm->global_count; i++) {
+        ember_value value = vm->globals[i].value;
+        if (is_script_function(value) && (i >= before || previous[i] != value.as.func_val.chunk)) count++;
+    }
+    script->functions = count > 0 ? calloc(count, sizeof(script_function)) : NULL;
+    ok = ok && (count == 0 || script->functions);
+    for (int i = 0; ok && i < vm->global_count; i++) {
+        ember_value value = vm->globals[i].value;
+        if (!is_script_function(value) || (i < before && previous[i] == value.as.func_val.chunk)) continue;
+        script_function* function = &script->functions[script->function_count];
+        function->key = strdup(vm->globals[i].key);
+        if (!function->key) {
+            ok = 0;
+            break;
+        }
+        function->slot = i;
+        function->value = value;
+        script->function_count++;
+    }
+    free(previous);
+
+    memcpy(copy, source, length);
+    copy[length] = '\0';
+    script->vm = vm;
+    script->chunk = chunk;
+    script->source = copy;
+    script->length = length;
+    script->hash = hash;
+    script->globals_epoch = vm->globals_epoch;
+    script->next = cache->live;
+    if (cache->live) cache->live->prev = script;
+    cache->live = script;
+    if (!ok) {
+        script_free(script);
+        return NULL;
+    }
+    return script;
+}
+
+static void eval_cache_index_insert(ember_eval_cache* cache, uint64_t hash, int entry) {
+    int mask = EVAL_CACHE_INDEX - 1;
+    int index = (int)(hash & (uint64_t)mask);
+    while (cache->index[index] != 0) {
+        index = (index + 1) & mask;
+    }
+    cache->index[index] = entry + 1;
+}
+
+// Adds script to the cache, evicting the least recently used source. An
+// evicted script lives on while handles or runs still hold it
+static void eval_cache_insert(ember_eval_cache* cache, ember_script* script) {
+    script->refs++;
+    script->cached = true;
+    script->last_used = cache->clock;
+    if (cache->count < EVAL_CACHE_SIZE) {
+        cache->entries[cache->count] = script;
+        eval_cache_index_insert(cache, script->hash, cache->count);
+        cache->count++;
+        return;
+    }
+
+    int slot = 0;
+    for (int i = 1; i < cache->count; i++) {
+        if (cache->entries[i]->last_used < cache->entries[slot]->last_used) slot = i;
+    }
+    ember_script* evicted = cache->entries[slot];
+    evicted->cached = false;
+    script_unref(evicted);
+    cache->entries[slot] = script;
+    // Open addressing has no cheap delete; evictions are rare enough to rebuild
+    memset(cache->index, 0, sizeof(cache->index));
+    for (int i = 0; i < cache->count; i++) {
+        eval_cache_index_insert(cache, cache->entries[i]->hash, i);
+    }
+}
+
+// The script for source, from the cache or compiled into it. The cache
+// keeps the only reference
+static ember_script* script_for_source(ember_vm* vm, const char* source) {
+    ember_eval_cache* cache = eval_cache_for(vm);
+    if (!cache) return NULL;
+    size_t length = strlen(source);
+    uint64_t hash = source_hash(source, length);
+    cache->clock++;
+
+    int mask = EVAL_CACHE_INDEX - 1;
+    for (int index = (int)(hash & (uint64_t)mask); cache->index[index] != 0; index = (index + 1) & mask) {
+        ember_script* script = cache->entries[cache->index[index] - 1];
+        if (script->hash == hash && script->length == length && memcmp(script->source, source, length) == 0) {
+            script->last_used = cache->clock;
+            cache->hits++;
+            return script;
+        }
+    }
+
+    cache->misses++;
+    ember_script* script = script_compile(vm, cache, source, length, hash);
+    if (script) eval_cache_insert(cache, script);
+    return script;
+}
+
+ember_script* ember_compile(ember_vm* vm, const char* source) {
+    if (!vm || !source) return NULL;
+    ember_script* script = script_for_source(vm, source);
+    if (script) script->refs++;
+    return script;
+}
+
+int ember_run_script(ember_script* script) {
+    if (!script) return -1;
+    ember_vm* vm = script->vm;
+
+    // Rebind the script's functions: by slot while the global table is the
+    // one they were found in, by name after it was rebuilt
+    bool same_table = script->globals_epoch == vm->globals_epoch && vm->globals_epoch != 0;
+    for (int i = 0; i < script->function_count; i++) {
+        script_function* function = &script->functions[i];
+        if (same_table) {
+            vm->globals[function->slot].value = function->value;
+        } else {
+            function->slot = ember_global_define(vm, function->key, function->value);
+        }
+    }
+    script->globals_epoch = vm->globals_epoch;
+
+    // A nested eval may evict the script while it runs
+    script->refs++;
+    int result = ember_bytecode_run(vm, script->chunk);
+    script_unref(script);
+    return result;
+}
+
+void ember_script_release(ember_script* script) {
+    if (script) script_unref(script);
+}
+
+int ember_eval_memoized(ember_vm* vm, const char* source) {
+    if (!vm || !source) return -1;
+    ember_script* script = script_for_source(vm, source);
+    return script ? ember_run_script(script) : -1;
+}
+
+void ember_eval_cache_stats(ember_vm* vm, uint64_t* hits, uint64_t* misses) {
+    ember_eval_cache* cache = vm ? vm->eval_cache : NULL;
+    if (hits) *hits = cache ? cache->hits : 0;
+    if (misses) *misses = cache ? cache->misses : 0;
+}
+
+void eval_cache_gray_roots(ember_vm* vm) {
+    ember_eval_cache* cache = vm->eval_cache;
+    if (!cache) return;
+    for (ember_script* script = cache->live; script; script = script->next) {
+        for (int i = 0; i < script->chunk->const_count; i++) {
+            gc_gray_value(vm, script->chunk->constants[i]);
+        }
+    }
+}
+
+void eval_cache_free(ember_vm* vm) {
+    ember_eval_cache* cache = vm->eval_cache;
+    if (!cache) return;
+    while (cache->live) {
+        script_free(cache->live);
+    }
+    free(cache);
+    vm->eval_cache = NULL;
+}
@@ -0,0 +1,1287 @@
+#define _GNU_SOURCE
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "../runtime/value/value.h"
+#include "gc_trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/epoll.h>
+#include "io_ring.h"
+#define LOOP_EPOLL 1
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+#include <sys/event.h>
+#define LOOP_KQUEUE 1
+#else
+#include <poll.h>
+#define LOOP_POLL 1
+#endif
+
+// Per-VM event loop for promises and async functions.
+//
+// Settling a promise queues its reactions as microtasks: resuming every
+// async call suspended on it, and its then/catch/finally callbacks.
+// ember_loop_run drains the microtasks, then waits for the next macrotask
+// (a watched file descriptor becoming ready, or a timer expiring) on
+// io_uring or epoll, kqueue, or poll elsewhere, and repeats until nothing
+// is left. Timers sit on a timer wheel, and the wait lasts until its next
+// tick.
+//
+// `await p` on a pending promise suspends the running function: its chunk,
+// ip, locals window and value stack window are copied into an
+// ember_async_frame, and the function returns a promise for its eventual
+// result to its caller, which carries on. When p settles, the frame is put
+// back above whatever is running as an entry frame (like ember_call) with
+// p's value pushed, or p's reason thrown, and runs until it returns, which
+// settles its result promise, or awaits again. A function that never waits
+// on a pending promise returns its value directly; awaiting a value that
+// is not a promise yields the value itself.
+
+#define LOOP_MICROTASKS_INITIAL 64
+#define LOOP_WAITER_BUCKETS_INITIAL 64
+#define LOOP_EVENTS_MAX 64
+#define LOOP_RING_ENTRIES 256
+#define LOOP_WHEEL_BITS 8
+#define LOOP_WHEEL_SLOTS (1 << LOOP_WHEEL_BITS)
+#define LOOP_WHEEL_MASK (LOOP_WHEEL_SLOTS - 1)
+#define LOOP_WHEEL_LEVELS 4                // 2^32 ms, ~49 days; longer timers wait at the top
+
+typedef struct ember_async_frame {
+    ember_chunk* chunk;
+    uint8_t* ip;                       // Just past the OP_AWAIT
+    ember_value* locals;
+    int local_count;
+    ember_value* stack;                // Frame's stack window, minus the awaited value
+    int stack_count;
+    ember_value promise;               // Settled with the function's result
+} ember_async_frame;
+
+typedef enum {
+    WAIT_RESUME,                       // Resume frame with the outcome
+    WAIT_ADOPT                         // Settle target the same way
+} loop_wait_kind;
+
+typedef struct loop_waiter {
+    ember_promise* promise;            // Waited on
+    loop_wait_kind kind;
+    ember_async_frame* frame;
+    ember_value target;
+    struct loop_waiter* next;          // Same bucket
+} loop_waiter;
+
+typedef enum {
+    MICRO_RESUME,
+    MICRO_CALLBACK
+} loop_micro_kind;
+
+typedef struct {
+    loop_micro_kind kind;
+    ember_async_frame* frame;          // RESUME
+    ember_value callback;              // CALLBACK
+    ember_value value;                 // Promise value or rejection reason
+    int rejected;
+} loop_microtask;
+
+typedef struct {
+    int head;                          // Timer index + 1, 0 = none
+    int tail;
+} loop_timer_list;
+
+typedef struct {
+    uint64_t deadline_ms;
+    uint32_t interval_ms;              // setInterval's period; 0 fires once
+    int id;                            // 0 while the slot is free
+    ember_value promise;               // Resolved with nil on expiry, or
+    ember_value function;              // called (setTimeout/setInterval), or
+    ember_timer_callback callback;     // called instead if set
+    void* userdata;
+    int next;                          // Index + 1 in its list, or the free list
+    int prev;
+    loop_timer_list* list;             // Wheel slot or due list holding it
+} loop_timer;
+
+typedef struct {
+    ember_loop_close_callback callback;
+    void* userdata;
+} loop_close_hook;
+
+typedef struct {
+    int fd;
+    int events;                        // EMBER_LOOP_READ | EMBER_LOOP_WRITE
+    ember_io_callback callback;
+    void* userdata;
+    unsigned serial;                   // Tags its io_uring poll request
+} loop_watcher;
+
+struct ember_event_loop {
+    loop_microtask* microtasks;        // Ring buffer
+    int micro_head;
+    int micro_count;
+    int micro_capacity;                // Power of two
+
+    loop_waiter** waiters;             // Chained by promise address
+    int waiter_count;
+    int waiter_buckets;                // Power of two
+    int suspended;                     // Frames waiting on a promise
+
+    // Timers live in a slab, linked into a hierarchical timer wheel: 4
+    // levels of 256 slots, at 1 ms, 256 ms, ~65 s and ~4.7 h per slot.
+    // Adding or cancelling one is O(1); as the wheel turns, slots of the
+    // upper levels cascade into the ones below, and level-0 slots that come
+    // due move to the due list, which runs in order
+    loop_timer* timers;
+    int timer_capacity;
+    int timer_count;                   // In the wheel or due
+    int timer_free;                    // Free slab slots, index + 1
+    int* timer_ids;                    // id -> index + 1, linear probing
+    int timer_id_capacity;             // Power of two
+    int next_timer_id;
+    uint64_t wheel_tick;               // Millisecond the wheel has reached
+    int wheel_count;                   // Timers in the wheel, not yet due
+    int due_count;
+    loop_timer_list due;
+    loop_timer_list wheel[LOOP_WHEEL_LEVELS][LOOP_WHEEL_SLOTS];
+    uint64_t wheel_used[LOOP_WHEEL_LEVELS][LOOP_WHEEL_SLOTS / 64];  // Non-empty slots
+
+    loop_close_hook* close_hooks;
+    int close_hook_count;
+
+    loop_watcher* watchers;
+    int watcher_count;
+    int watcher_capacity;
+    int backend_fd;                    // epoll/kqueue descriptor, -1 until first watch
+#if defined(LOOP_EPOLL)
+    io_ring* ring;                     // Used instead of epoll where the kernel has it
+#endif
+    unsigned watch_serial;
+
+    ember_async_frame* resuming;       // Frame being resumed, or NULL
+    int resume_depth;                  // Its entry frame's index in vm->frames
+    int resumed_suspended;             // It awaited again instead of returning
+};
+
+static uint64_t loop_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+// The millisecond by which delay_ms will have fully passed: rounded up, so
+// a timer never fires early
+static uint64_t loop_deadline_ms(uint64_t delay_ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ((uint64_t)ts.tv_nsec + 999999) / 1000000 + delay_ms;
+}
+
+static ember_event_loop* loop_get(ember_vm* vm) {
+    if (vm->event_loop) return vm->event_loop;
+    ember_event_loop* loop = calloc(1, sizeof(ember_event_loop));
+    if (!loop) {
+        fprintf(stderr, "[LOOP] Memory allocation failed for event loop\n");
+        return NULL;
+    }
+    loop->backend_fd = -1;
+    vm->event_loop = loop;
+    return loop;
+}
+
+static void free_frame(ember_async_frame* frame) {
+    if (!frame) return;
+    free(frame->locals);
+    free(frame->stack);
+    free(frame);
+}
+
+// ============================================================================
+// MICROTASKS
+// ============================================================================
+
+static int micro_push(ember_event_loop* loop, const loop_microtask* task) {
+    if (loop->micro_count == loop->micro_capacity) {
+        int capacity = loop->micro_capacity ? loop->micro_capacity * 2 : LOOP_MICROTASKS_INITIAL;
+        loop_microtask* tasks = malloc(sizeof(loop_microtask) * (size_t)capacity);
+        if (!tasks) {
+            fprintf(stderr, "[LOOP] Memory allocation failed for microtask queue\n");
+            return -1;
+        }
+        for (int i = 0; i < loop->micro_count; i++) {
+            tasks[i] = loop->microtasks[(loop->micro_head + i) & (loop->micro_capacity - 1)];
+        }
+        free(loop->microtasks);
+        loop->microtasks = tasks;
+        loop->micro_head = 0;
+        loop->micro_capacity = capacity;
+    }
+    loop->microtasks[(loop->micro_head + loop->micro_count) & (loop->micro_capacity - 1)] = *task;
+    loop->micro_count++;
+    return 0;
+}
+
+static int micro_pop(ember_event_loop* loop, loop_microtask* task) {
+    if (loop->micro_count == 0) return 0;
+    *task = loop->microtasks[loop->micro_head];
+    loop->micro_head = (loop->micro_head + 1) & (loop->micro_capacity - 1);
+    loop->micro_count--;
+    return 1;
+}
+
+// ============================================================================
+// WAITERS
+// ============================================================================
+
+static uint32_t waiter_hash(const ember_promise* promise) {
+    uintptr_t bits = (uintptr_t)promise;
+    return (uint32_t)((bits >> 4) ^ (bits >> 20));
+}
+
+static int add_waiter(ember_event_loop* loop, loop_waiter* waiter) {
+    if (loop->waiter_count >= loop->waiter_buckets * 2) {
+        int buckets = loop->waiter_buckets ? loop->waiter_buckets * 2 : LOOP_WAITER_BUCKETS_INITIAL;
+        loop_waiter** table = calloc((size_t)buckets, sizeof(loop_waiter*));
+        if (!table) {
+            fprintf(stderr, "[LOOP] Memory allocation failed for promise waiters\n");
+            return -1;
+        }
+        for (int i = 0; i < loop->waiter_buckets; i++) {
+            loop_waiter* entry = loop->waiters[i];
+            while (entry) {
+                loop_waiter* next = entry->next;
+                uint32_t index = waiter_hash(entry->promise) & (uint32_t)(buckets - 1);
+                entry->next = table[index];
+                table[index] = entry;
+                entry = next;
+            }
+        }
+        free(loop->waiters);
+        loop->waiters = table;
+        loop->waiter_buckets = buckets;
+    }
+    uint32_t index = waiter_hash(waiter->promise) & (uint32_t)(loop->waiter_buckets - 1);
+    // Appended, so waiters resume in the order they started waiting
+    loop_waiter** link = &loop->waiters[index];
+    while (*link) link = &(*link)->next;
+    waiter->next = NULL;
+    *link = waiter;
+    loop->waiter_count++;
+    return 0;
+}
+
+static int wait_on(ember_event_loop* loop, ember_promise* promise, loop_wait_kind kind,
+                   ember_async_frame* frame, ember_value target) {
+    loop_waiter* waiter = malloc(sizeof(loop_waiter));
+    if (!waiter) {
+        fprintf(stderr, "[LOOP] Memory allocation failed for promise waiter\n");
+        return -1;
+    }
+    waiter->promise = promise;
+    waiter->kind = kind;
+    waiter->frame = frame;
+    waiter->target = target;
+    if (add_waiter(loop, waiter) != 0) {
+        free(waiter);
+        return -1;
+    }
+    return 0;
+}
+
+// ============================================================================
+// SETTLING
+// ============================================================================
+
+static void queue_callbacks(ember_event_loop* loop, ember_array* callbacks, ember_value value, int rejected) {
+    if (!callbacks) return;
+    for (int i = 0; i < callbacks->length; i++) {
+        loop_microtask task = {MICRO_CALLBACK, NULL, callbacks->elements[i], value, rejected};
+        micro_push(loop, &task);
+    }
+    callbacks->length = 0;
+}
+
+static int settle(ember_vm* vm, ember_value promise_value, ember_value value, int rejected) {
+    if (promise_value.type != EMBER_VAL_PROMISE) return -1;
+    ember_promise* promise = AS_PROMISE(promise_value);
+    if (promise->state != PROMISE_PENDING) return -1;
+
+    // Resolving with a promise follows it instead
+    if (!rejected && value.type == EMBER_VAL_PROMISE) {
+        ember_promise* inner = AS_PROMISE(value);
+        if (inner == promise) {
+            return settle(vm, promise_value,
+                          ember_make_exception(vm, "TypeError", "Promise resolved with itself"), 1);
+        }
+        if (inner->state == PROMISE_PENDING) {
+            ember_event_loop* loop = loop_get(vm);
+            return loop ? wait_on(loop, inner, WAIT_ADOPT, NULL, promise_value) : -1;
+        }
+        rejected = inner->state == PROMISE_REJECTED;
+        value = inner->value;
+    }
+
+    promise->state = rejected ? PROMISE_REJECTED : PROMISE_RESOLVED;
+    gc_write_barrier_helper(vm, (ember_object*)promise, promise->value, value);
+    promise->value = value;
+
+    ember_event_loop* loop = vm->event_loop;
+    if (!loop) {
+        loop = loop_get(vm);
+        if (!loop) return -1;
+    }
+    if (loop->waiter_buckets > 0) {
+        uint32_t index = waiter_hash(promise) & (uint32_t)(loop->waiter_buckets - 1);
+        loop_waiter** link = &loop->waiters[index];
+        while (*link) {
+            loop_waiter* waiter = *link;
+            if (waiter->promise != promise) {
+                link = &waiter->next;
+                continue;
+            }
+            *link = waiter->next;
+            loop->waiter_count--;
+            if (waiter->kind == WAIT_RESUME) {
+                loop_microtask task = {MICRO_RESUME, waiter->frame, ember_make_nil(), value, rejected};
+                micro_push(loop, &task);
+            } else {
+                settle(vm, waiter->target, value, rejected);
+            }
+            free(waiter);
+        }
+    }
+    queue_callbacks(loop, rejected ? promise->catch_callbacks : promise->then_callbacks, value, rejected);
+    queue_callbacks(loop, promise->finally_callbacks, value, rejected);
+    return 0;
+}
+
+int ember_promise_resolve(ember_vm* vm, ember_value promise, ember_value value) {
+    if (!vm) return -1;
+    return settle(vm, promise, value, 0);
+}
+
+int ember_promise_reject(ember_vm* vm, ember_value promise, ember_value reason) {
+    if (!vm) return -1;
+    return settle(vm, promise, reason, 1);
+}
+
+// ============================================================================
+// AWAIT
+// ============================================================================
+
+static vm_operation_result await_error(ember_vm* vm, const char* message) {
+    ember_error* error = ember_error_runtime(vm, message);
+    ember_vm_set_error(vm, error);
+    return VM_RESULT_ERROR;
+}
+
+// VM operation handler for OP_AWAIT: the stack holds the awaited value.
+// A settled promise (or any other value) is replaced by its outcome in
+// place. A pending promise suspends the running function, which returns
+// its result promise like OP_RETURN would, so the dispatch loop must
+// reload ip/chunk afterwards and treat VM_RESULT_CONTINUE as for a return.
+vm_operation_result vm_handle_await(ember_vm* vm) {
+    if (vm->stack_top < 1) {
+        return await_error(vm, "Nothing to await");
+    }
+    ember_value awaited = vm->stack[vm->stack_top - 1];
+    if (awaited.type != EMBER_VAL_PROMISE) {
+        return VM_RESULT_OK;
+    }
+    ember_promise* promise = AS_PROMISE(awaited);
+    if (promise->state == PROMISE_RESOLVED) {
+        vm->stack[vm->stack_top - 1] = promise->value;
+        return VM_RESULT_OK;
+    }
+    if (promise->state == PROMISE_REJECTED) {
+        vm->stack_top--;
+        vm->current_exception = promise->value;
+        return vm_handle_throw(vm);
+    }
+    if (vm->frame_count == 0) {
+        return await_error(vm, "await on a pending promise outside a function");
+    }
+
+    ember_event_loop* loop = loop_get(vm);
+    ember_async_frame* frame = loop ? calloc(1, sizeof(ember_async_frame)) : NULL;
+    if (!frame) {
+        return await_error(vm, "Out of memory suspending async function");
+    }
+    const ember_frame* call = &vm->frames[vm->frame_count - 1];
+    frame->chunk = vm->chunk;
+    frame->ip = vm->ip;
+    frame->local_count = vm->local_count - vm->local_base;
+    frame->stack_count = vm->stack_top - 1 - call->stack_base;
+    if (frame->local_count > 0) {
+        frame->locals = malloc(sizeof(ember_value) * (size_t)frame->local_count);
+    }
+    if (frame->stack_count > 0) {
+        frame->stack = malloc(sizeof(ember_value) * (size_t)frame->stack_count);
+    }
+    if ((frame->local_count > 0 && !frame->locals) || (frame->stack_count > 0 && !frame->stack)) {
+        free_frame(frame);
+        return await_error(vm, "Out of memory suspending async function");
+    }
+    memcpy(frame->locals, &vm->locals[vm->local_base], sizeof(ember_value) * (size_t)frame->local_count);
+    memcpy(frame->stack, &vm->stack[call->stack_base], sizeof(ember_value) * (size_t)frame->stack_count);
+
+    // A resumed call that awaits again keeps the promise its caller already has
+    if (loop->resuming && vm->frame_count - 1 == loop->resume_depth) {
+        frame->promise = loop->resuming->promise;
+        loop->resumed_suspended = 1;
+    } else {
+        frame->promise = ember_make_promise(vm);
+    }
+    if (wait_on(loop, promise, WAIT_RESUME, frame, ember_make_nil()) != 0) {
+        free_frame(frame);
+        return await_error(vm, "Out of memory suspending async function");
+    }
+    loop->suspended++;
+
+    vm->stack[vm->stack_top - 1] = frame->promise;
+    return vm_handle_return(vm);
+}
+
+// Puts frame back on the VM and runs it until it returns or awaits again
+static void resume_frame(ember_vm* vm, ember_event_loop* loop, ember_async_frame* frame,
+                         ember_value value, int rejected) {
+    loop->suspended--;
+    int stack_base = vm->stack_top;
+    if (vm->local_count + frame->local_count > EMBER_LOCALS_MAX ||
+        stack_base + frame->stack_count + 1 > EMBER_STACK_MAX) {
+        ember_value error = ember_make_exception(vm, "RuntimeError", "No room to resume async function");
+        settle(vm, frame->promise, error, 1);
+        free_frame(frame);
+        return;
+    }
+    int depth = vm_push_entry_frame(vm, frame->chunk, 0, NULL);
+    if (depth < 0) {
+        ember_value error = ember_make_exception(vm, "RuntimeError", "Call stack overflow resuming async function");
+        settle(vm, frame->promise, error, 1);
+        free_frame(frame);
+        return;
+    }
+    memcpy(&vm->locals[vm->local_base], frame->locals, sizeof(ember_value) * (size_t)frame->local_count);
+    vm->local_count = vm->local_base + frame->local_count;
+    memcpy(&vm->stack[vm->stack_top], frame->stack, sizeof(ember_value) * (size_t)frame->stack_count);
+    vm->stack_top += frame->stack_count;
+    vm->ip = frame->ip;
+    vm_note_high_water(vm);
+
+    ember_async_frame* saved_resuming = loop->resuming;
+    int saved_depth = loop->resume_depth;
+    int saved_suspended = loop->resumed_suspended;
+    loop->resuming = frame;
+    loop->resume_depth = depth;
+    loop->resumed_suspended = 0;
+
+    int status;
+    if (rejected) {
+        vm->current_exception = value;
+        status = vm_handle_throw(vm) == VM_RESULT_ERROR ? -1 : ember_run(vm);
+    } else {
+        vm->stack[vm->stack_top++] = value;
+        status = ember_run(vm);
+    }
+
+    int suspended_again = loop->resumed_suspended;
+    loop->resuming = saved_resuming;
+    loop->resume_depth = saved_depth;
+    loop->resumed_suspended = saved_suspended;
+
+    if (status == 0) {
+        ember_value result = vm->stack_top > stack_base ? vm->stack[vm->stack_top - 1] : ember_make_nil();
+        if (!suspended_again) {
+            settle(vm, frame->promise, result, 0);
+        }
+    } else {
+        // Uncaught in the async function: its promise rejects instead
+        ember_value reason = vm->current_exception;
+        vm->current_exception = ember_make_nil();
+        vm->exception_pending = 0;
+        vm_unwind_frames(vm, depth);
+        settle(vm, frame->promise, reason, 1);
+    }
+    vm->stack_top = stack_base;
+    free_frame(frame);
+}
+
+int ember_loop_run_microtasks(ember_vm* vm) {
+    if (!vm || !vm->event_loop) return 0;
+    ember_event_loop* loop = vm->event_loop;
+    int ran = 0;
+    loop_microtask task;
+    while (micro_pop(loop, &task)) {
+        ran++;
+        if (task.kind == MICRO_RESUME) {
+            resume_frame(vm, loop, task.frame, task.value, task.rejected);
+            continue;
+        }
+        ember_value ignored;
+        if (vm_call_value(vm, task.callback, 1, &task.value, &ignored) != 0) {
+            fprintf(stderr, "[LOOP] Promise callback failed\n");
+            vm->exception_pending = 0;
+            vm->current_exception = ember_make_nil();
+        }
+    }
+    return ran;
+}
+
+// ============================================================================
+// MACROTASKS
+// ============================================================================
+
+// Timer lists: doubly linked through slab indices, so the slab can grow
+
+static void list_append(ember_event_loop* loop, loop_timer_list* list, int index) {
+    loop_timer* timer = &loop->timers[index];
+    timer->list = list;
+    timer->next = 0;
+    timer->prev = list->tail;
+    if (list->tail) {
+        loop->timers[list->tail - 1].next = index + 1;
+    } else {
+        list->head = index + 1;
+    }
+    list->tail = index + 1;
+}
+
+static void wheel_mark(ember_event_loop* loop, const loop_timer_list* list, int used) {
+    int position = (int)(list - &loop->wheel[0][0]);
+    uint64_t* word = &loop->wheel_used[position / LOOP_WHEEL_SLOTS][(position % LOOP_WHEEL_SLOTS) / 64];
+    uint64_t bit = (uint64_t)1 << (position % 64);
+    *word = used ? *word | bit : *word & ~bit;
+}
+
+static void timer_unlink(ember_event_loop* loop, int index) {
+    loop_timer* timer = &loop->timers[index];
+    loop_timer_list* list = timer->list;
+    if (!list) return;
+    if (timer->prev) {
+        loop->timers[timer->prev - 1].next = timer->next;
+    } else {
+        list->head = timer->next;
+    }
+    if (timer->next) {
+        loop->timers[timer->next - 1].prev = timer->prev;
+    } else {
+        list->tail = timer->prev;
+    }
+    timer->list = NULL;
+    if (list == &loop->due) {
+        loop->due_count--;
+    } else {
+        loop->wheel_count--;
+        if (!list->head) wheel_mark(loop, list, 0);
+    }
+}
+
+// Files a timer under the wheel slot its deadline falls in, relative to the
+// wheel's tick, or on the due list if that has passed
+static void timer_file(ember_event_loop* loop, int index) {
+    uint64_t due = loop->timers[index].deadline_ms;
+    if (due <= loop->wheel_tick) {
+        list_append(loop, &loop->due, index);
+        loop->due_count++;
+        return;
+    }
+    uint64_t delta = due - loop->wheel_tick;
+    int level = 0;
+    while (level < LOOP_WHEEL_LEVELS - 1 && delta >= (uint64_t)1 << (LOOP_WHEEL_BITS * (level + 1))) {
+        level++;
+    }
+    uint64_t span = (uint64_t)1 << (LOOP_WHEEL_BITS * LOOP_WHEEL_LEVELS);
+    if (delta >= span) due = loop->wheel_tick + span - 1;  // Refiled when the top level comes round
+    loop_timer_list* list = &loop->wheel[level][(due >> (LOOP_WHEEL_BITS * level)) & LOOP_WHEEL_MASK];
+    if (!list->head) wheel_mark(loop, list, 1);
+    list_append(loop, list, index);
+    loop->wheel_count++;
+}
+
+// Empties a wheel slot, refiling its timers against the current tick
+static void wheel_refile(ember_event_loop* loop, loop_timer_list* list) {
+    while (list->head) {
+        int index = list->head - 1;
+        timer_unlink(loop, index);
+        timer_file(loop, index);
+    }
+}
+
+// First non-empty slot of level at or after from, or -1
+static int wheel_next_slot(const ember_event_loop* loop, int level, int from) {
+    for (int word = from / 64; word < LOOP_WHEEL_SLOTS / 64; word++) {
+        uint64_t bits = loop->wheel_used[level][word];
+        if (word == from / 64) bits &= ~(uint64_t)0 << (from % 64);
+        if (bits) return word * 64 + __builtin_ctzll(bits);
+    }
+    return -1;
+}
+
+// Turns the wheel up to now, moving what comes due to the due list. Jumps
+// straight to the next non-empty level-0 slot or cascade point, so idle
+// milliseconds cost nothing
+static void wheel_advance(ember_event_loop* loop, uint64_t now) {
+    while (loop->wheel_tick < now) {
+        if (loop->wheel_count == 0) {
+            loop->wheel_tick = now;
+            return;
+        }
+        uint64_t tick = loop->wheel_tick;
+        uint64_t boundary = (tick | LOOP_WHEEL_MASK) + 1;
+        uint64_t limit = now < boundary - 1 ? now : boundary - 1;
+        int slot = (tick & LOOP_WHEEL_MASK) == LOOP_WHEEL_MASK ? -1 :
+                   wheel_next_slot(loop, 0, (int)(tick & LOOP_WHEEL_MASK) + 1);
+        if (slot >= 0 && (tick & ~(uint64_t)LOOP_WHEEL_MASK) + (uint64_t)slot <= limit) {
+            loop->wheel_tick = (tick & ~(uint64_t)LOOP_WHEEL_MASK) + (uint64_t)slot;
+            wheel_refile(loop, &loop->wheel[0][slot]);
+            continue;
+        }
+        if (limit == now) {
+            loop->wheel_tick = now;
+            return;
+        }
+        // Where a level's lower bits roll over, its slot cascades into the
+        // levels below; highest first, so what it drops lands in place
+        loop->wheel_tick = boundary;
+        for (int level = LOOP_WHEEL_LEVELS - 1; level > 0; level--) {
+            if ((boundary & (((uint64_t)1 << (LOOP_WHEEL_BITS * level)) - 1)) != 0) continue;
+            wheel_refile(loop, &loop->wheel[level][(boundary >> (LOOP_WHEEL_BITS * level)) & LOOP_WHEEL_MASK]);
+        }
+        wheel_refile(loop, &loop->wheel[0][boundary & LOOP_WHEEL_MASK]);
+    }
+}
+
+// The millisecond the wheel next has work at: a level-0 slot coming due or
+// an upper slot cascading; UINT64_MAX with no timers
+static uint64_t wheel_next_tick(const ember_event_loop* loop) {
+    if (loop->due_count > 0) return loop->wheel_tick;
+    if (loop->wheel_count == 0) return UINT64_MAX;
+    uint64_t next = UINT64_MAX;
+    for (int level = 0; level < LOOP_WHEEL_LEVELS; level++) {
+        int shift = LOOP_WHEEL_BITS * level;
+        uint64_t position = loop->wheel_tick >> shift;
+        int from = (int)((position + 1) & LOOP_WHEEL_MASK);
+        // Searched from the slot after the current one, round to the current one
+        int slot = wheel_next_slot(loop, level, from);
+        if (slot < 0) slot = wheel_next_slot(loop, level, 0);
+        if (slot < 0) continue;
+        uint64_t distance = (uint64_t)((slot - from) & LOOP_WHEEL_MASK) + 1;
+        uint64_t tick = (position + distance) << shift;
+        if (tick < next) next = tick;
+    }
+    return next;
+}
+
+// id -> slab index, for cancel
+
+static int timer_id_slot(const ember_event_loop* loop, int id) {
+    return (int)(((uint32_t)id * 2654435769u) & (uint32_t)(loop->timer_id_capacity - 1));
+}
+
+static int timer_find(const ember_event_loop* loop, int id) {
+    if (id <= 0 || loop->timer_id_capacity == 0) return -1;
+    for (int i = timer_id_slot(loop, id);; i = (i + 1) & (loop->timer_id_capacity - 1)) {
+        int entry = loop->timer_ids[i];
+        if (!entry) return -1;
+        if (loop->timers[entry - 1].id == id) return entry - 1;
+    }
+}
+
+static void timer_id_insert(ember_event_loop* loop, int index) {
+    int i = timer_id_slot(loop, loop->timers[index].id);
+    while (loop->timer_ids[i]) i = (i + 1) & (loop->timer_id_capacity - 1);
+    loop->timer_ids[i] = index + 1;
+}
+
+static void timer_id_remove(ember_event_loop* loop, int id) {
+    int mask = loop->timer_id_capacity - 1;
+    int i = timer_id_slot(loop, id);
+    while (loop->timers[loop->timer_ids[i] - 1].id != id) i = (i + 1) & mask;
+    // Backward shift: later entries of the probe run move up into the hole
+    for (int j = (i + 1) & mask; loop->timer_ids[j]; j = (j + 1) & mask) {
+        int home = timer_id_slot(loop, loop->timers[loop->timer_ids[j] - 1].id);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            loop->timer_ids[i] = loop->timer_ids[j];
+            i = j;
+        }
+    }
+    loop->timer_ids[i] = 0;
+}
+
+static int timer_reserve(ember_event_loop* loop) {
+    if (!loop->timer_free) {
+        int capacity = loop->timer_capacity ? loop->timer_capacity * 2 : 16;
+        loop_timer* timers = realloc(loop->timers, sizeof(loop_timer) * (size_t)capacity);
+        if (!timers) return -1;
+        loop->timers = timers;
+        for (int i = capacity - 1; i >= loop->timer_capacity; i--) {
+            timers[i].id = 0;
+            timers[i].next = loop->timer_free;
+            loop->timer_free = i + 1;
+        }
+        loop->timer_capacity = capacity;
+    }
+    if (loop->timer_count + 1 > loop->timer_id_capacity / 2) {
+        int capacity = loop->timer_id_capacity ? loop->timer_id_capacity * 2 : 32;
+        int* ids = calloc((size_t)capacity, sizeof(int));
+        if (!ids) return -1;
+        free(loop->timer_ids);
+        loop->timer_ids = ids;
+        loop->timer_id_capacity = capacity;
+        for (int i = 0; i < loop->timer_capacity; i++) {
+            if (loop->timers[i].id) timer_id_insert(loop, i);
+        }
+    }
+    return 0;
+}
+
+// Returns the new timer's id, or -1
+static int timer_push(ember_event_loop* loop, uint64_t delay_ms, uint32_t interval_ms, ember_value promise,
+                      ember_value function, ember_timer_callback callback, void* userdata) {
+    if (timer_reserve(loop) != 0) return -1;
+    if (loop->timer_count == 0) loop->wheel_tick = loop_now_ms();
+    int index = loop->timer_free - 1;
+    loop_timer* timer = &loop->timers[index];
+    loop->timer_free = timer->next;
+    // Ids count up; past INT_MAX they start over, skipping any still live
+    do {
+        if (++loop->next_timer_id <= 0) loop->next_timer_id = 1;
+    } while (timer_find(loop, loop->next_timer_id) >= 0);
+    timer->deadline_ms = loop_deadline_ms(delay_ms);
+    timer->interval_ms = interval_ms;
+    timer->id = loop->next_timer_id;
+    timer->promise = promise;
+    timer->function = function;
+    timer->callback = callback;
+    timer->userdata = userdata;
+    timer->list = NULL;
+    timer_id_insert(loop, index);
+    loop->timer_count++;
+    timer_file(loop, index);
+    return timer->id;
+}
+
+static void timer_release(ember_event_loop* loop, int index) {
+    loop_timer* timer = &loop->timers[index];
+    timer_unlink(loop, index);
+    timer_id_remove(loop, timer->id);
+    timer->id = 0;
+    timer->promise = ember_make_nil();
+    timer->function = ember_make_nil();
+    timer->next = loop->timer_free;
+    loop->timer_free = index + 1;
+    loop->timer_count--;
+}
+
+static uint64_t timer_delay(double ms) {
+    if (!(ms > 0)) return 0;
+    return ms >= 1e15 ? (uint64_t)1e15 : (uint64_t)ms;
+}
+
+ember_value ember_loop_delay(ember_vm* vm, double ms) {
+    ember_event_loop* loop = vm ? loop_get(vm) : NULL;
+    if (!loop) return ember_make_nil();
+    ember_value promise = ember_make_promise(vm);
+    if (timer_push(loop, timer_delay(ms), 0, promise, ember_make_nil(), NULL, NULL) < 0) {
+        fprintf(stderr, "[LOOP] Memory allocation failed for timer\n");
+        return ember_make_nil();
+    }
+    return promise;
+}
+
+int ember_loop_add_timer(ember_vm* vm, double ms, ember_timer_callback callback, void* userdata) {
+    if (!vm || !callback) return EMBER_ERROR_INVALID_PARAMETER;
+    ember_event_loop* loop = loop_get(vm);
+    if (!loop) return EMBER_ERROR_MEMORY_ALLOCATION;
+    int id = timer_push(loop, timer_delay(ms), 0, ember_make_nil(), ember_make_nil(), callback, userdata);
+    return id < 0 ? EMBER_ERROR_MEMORY_ALLOCATION : id;
+}
+
+int ember_loop_cancel_timer(ember_vm* vm, int id) {
+    if (!vm || !vm->event_loop) return EMBER_ERROR_INVALID_PARAMETER;
+    ember_event_loop* loop = vm->event_loop;
+    int index = timer_find(loop, id);
+    if (index < 0) return EMBER_ERROR_INVALID_PARAMETER;
+    timer_release(loop, index);
+    return EMBER_SUCCESS;
+}
+
+int ember_loop_on_close(ember_vm* vm, ember_loop_close_callback callback, void* userdata) {
+    if (!vm || !callback) return EMBER_ERROR_INVALID_PARAMETER;
+    ember_event_loop* loop = loop_get(vm);
+    if (!loop) return EMBER_ERROR_MEMORY_ALLOCATION;
+    loop_close_hook* hooks = realloc(loop->close_hooks, sizeof(loop_close_hook) * (size_t)(loop->close_hook_count + 1));
+    if (!hooks) return EMBER_ERROR_MEMORY_ALLOCATION;
+    hooks[loop->close_hook_count].callback = callback;
+    hooks[loop->close_hook_count].userdata = userdata;
+    loop->close_hooks = hooks;
+    loop->close_hook_count++;
+    return EMBER_SUCCESS;
+}
+
+// delay(ms): a promise resolved with nil once ms milliseconds have passed
+ember_value ember_native_delay(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 1 || argv[0].type != EMBER_VAL_NUMBER) {
+        return ember_make_nil();
+    }
+    return ember_loop_delay(vm, argv[0].as.number_val);
+}
+
+static ember_value schedule(ember_vm* vm, int argc, ember_value* argv, int repeat) {
+    if (argc != 2 || (argv[0].type != EMBER_VAL_FUNCTION && argv[0].type != EMBER_VAL_NATIVE) ||
+        argv[1].type != EMBER_VAL_NUMBER) {
+        return ember_make_nil();
+    }
+    ember_event_loop* loop = loop_get(vm);
+    if (!loop) return ember_make_nil();
+    uint64_t delay = timer_delay(argv[1].as.number_val);
+    // An interval fires at most once a millisecond
+    uint32_t interval = 0;
+    if (repeat) interval = delay == 0 ? 1 : delay > UINT32_MAX ? UINT32_MAX : (uint32_t)delay;
+    int id = timer_push(loop, delay, interval, ember_make_nil(), argv[0], NULL, NULL);
+    return id < 0 ? ember_make_nil() : ember_make_number(id);
+}
+
+// setTimeout(fn, ms): calls fn once after ms milliseconds; an id for clearTimeout
+ember_value ember_native_set_timeout(ember_vm* vm, int argc, ember_value* argv) {
+    return schedule(vm, argc, argv, 0);
+}
+
+// setInterval(fn, ms): calls fn every ms milliseconds until cleared
+ember_value ember_native_set_interval(ember_vm* vm, int argc, ember_value* argv) {
+    return schedule(vm, argc, argv, 1);
+}
+
+// clearTimeout(id) / clearInterval(id): true if the timer was still pending
+ember_value ember_native_clear_timeout(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 1 || argv[0].type != EMBER_VAL_NUMBER) return ember_make_nil();
+    double id = argv[0].as.number_val;
+    if (!(id >= 1 && id <= INT32_MAX) || id != (double)(int)id) return ember_make_bool(false);
+    return ember_make_bool(ember_loop_cancel_timer(vm, (int)id) == EMBER_SUCCESS);
+}
+
+static int find_watcher(ember_event_loop* loop, int fd) {
+    for (int i = 0; i < loop->watcher_count; i++) {
+        if (loop->watchers[i].fd == fd) return i;
+    }
+    return -1;
+}
+
+static void remove_watcher(ember_event_loop* loop, int index) {
+    loop->watchers[index] = loop->watchers[--loop->watcher_count];
+}
+
+#if defined(LOOP_EPOLL)
+
+// On io_uring a watch is a one-shot poll request. Arming and removing one
+// is an entry sent along with the next wait, where epoll takes an
+// epoll_ctl call each time. Its user_data is the watch's serial over its
+// fd, so the completion of a poll that was removed (or of an earlier watch
+// on the same fd) is recognised and dropped
+static int ring_add(ember_event_loop* loop, int fd, int events) {
+    struct io_uring_sqe* sqe = io_ring_sqe(loop->ring);
+    if (!sqe) return -1;
+    uint32_t mask = 0;
+    if (events & EMBER_LOOP_READ) mask |= POLLIN;
+    if (events & EMBER_LOOP_WRITE) mask |= POLLOUT;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    mask = mask << 16 | mask >> 16;
+#endif
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = mask;
+    sqe->user_data = (uint64_t)++loop->watch_serial << 32 | (uint32_t)fd;
+    return 0;
+}
+
+static void ring_remove(ember_event_loop* loop, int fd) {
+    int index = find_watcher(loop, fd);
+    struct io_uring_sqe* sqe = index >= 0 ? io_ring_sqe(loop->ring) : NULL;
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t)loop->watchers[index].serial << 32 | (uint32_t)fd;
+    sqe->user_data = 0;
+    // The poll holds the file open; with nothing left to wait for there may
+    // be no next wait to send the removal along with
+    if (loop->watcher_count == 1 && loop->timer_count == 0) {
+        io_ring_submit(loop->ring, 0, 0);
+    }
+}
+
+static int ring_wait(ember_event_loop* loop, int timeout_ms, int* fds, int* events, int max) {
+    int result = io_ring_submit(loop->ring, 1, timeout_ms);
+    if (result < 0 && result != -ETIME && result != -EINTR && result != -EBUSY) {
+        errno = -result;
+        return -1;
+    }
+    int count = 0;
+    struct io_uring_cqe* cqe;
+    while (count < max && (cqe = io_ring_peek(loop->ring))) {
+        uint64_t tag = cqe->user_data;
+        int ready = cqe->res;
+        io_ring_seen(loop->ring);
+        int index = tag ? find_watcher(loop, (int)(uint32_t)tag) : -1;
+        if (index < 0 || loop->watchers[index].serial != (unsigned)(tag >> 32)) continue;
+        fds[count] = loop->watchers[index].fd;
+        events[count] = 0;
+        // A failed poll (a bad descriptor) wakes the watch to find out
+        if (ready < 0 || ready & (POLLIN | POLLHUP | POLLERR)) events[count] |= EMBER_LOOP_READ;
+        if (ready < 0 || ready & (POLLOUT | POLLERR)) events[count] |= EMBER_LOOP_WRITE;
+        count++;
+    }
+    return count;
+}
+
+static int backend_add(ember_event_loop* loop, int fd, int events) {
+    if (!loop->ring && loop->backend_fd < 0) {
+        io_ring* ring = malloc(sizeof(io_ring));
+        if (ring && io_ring_init(ring, LOOP_RING_ENTRIES) == 0) {
+            loop->ring = ring;
+        } else {
+            free(ring);
+        }
+    }
+    if (loop->ring) return ring_add(loop, fd, events);
+    if (loop->backend_fd < 0) {
+        loop->backend_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (loop->backend_fd < 0) return -1;
+    }
+    struct epoll_event event = {0};
+    event.events = EPOLLONESHOT;
+    if (events & EMBER_LOOP_READ) event.events |= EPOLLIN;
+    if (events & EMBER_LOOP_WRITE) event.events |= EPOLLOUT;
+    event.data.fd = fd;
+    if (epoll_ctl(loop->backend_fd, EPOLL_CTL_ADD, fd, &event) == 0) return 0;
+    // Still registered (disarmed) from an earlier one-shot watch
+    return errno == EEXIST ? epoll_ctl(loop->backend_fd, EPOLL_CTL_MOD, fd, &event) : -1;
+}
+
+static void backend_remove(ember_event_loop* loop, int fd, int events) {
+    (void)events;
+    if (loop->ring) {
+        ring_remove(loop, fd);
+    } else if (loop->backend_fd >= 0) {
+        epoll_ctl(loop->backend_fd, EPOLL_CTL_DEL, fd, NULL);
+    }
+}
+
+// Collects up to max ready (fd, events) pairs
+static int backend_wait(ember_event_loop* loop, int timeout_ms, int* fds, int* events, int max) {
+    if (loop->ring) return ring_wait(loop, timeout_ms, fds, events, max);
+    if (loop->backend_fd < 0) {
+        if (timeout_ms > 0) {
+            struct timespec ts = {timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000};
+            nanosleep(&ts, NULL);
+        }
+        return 0;
+    }
+    struct epoll_event ready[LOOP_EVENTS_MAX];
+    int count = epoll_wait(loop->backend_fd, ready, max < LOOP_EVENTS_MAX ? max : LOOP_EVENTS_MAX, timeout_ms);
+    if (count < 0) return errno == EINTR ? 0 : -1;
+    for (int i = 0; i < count; i++) {
+        fds[i] = ready[i].data.fd;
+        events[i] = 0;
+        if (ready[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) events[i] |= EMBER_LOOP_READ;
+        if (ready[i].events & (EPOLLOUT | EPOLLERR)) events[i] |= EMBER_LOOP_WRITE;
+    }
+    return count;
+}
+
+#elif defined(LOOP_KQUEUE)
+
+static int backend_add(ember_event_loop* loop, int fd, int events) {
+    if (loop->backend_fd < 0) {
+        loop->backend_fd = kqueue();
+        if (loop->backend_fd < 0) return -1;
+    }
+    struct kevent changes[2];
+    int count = 0;
+    if (events & EMBER_LOOP_READ) {
+        EV_SET(&changes[count++], fd, EVFILT_READ, EV_ADD | EV_ONESHOT, 0, 0, NULL);
+    }
+    if (events & EMBER_LOOP_WRITE) {
+        EV_SET(&changes[count++], fd, EVFILT_WRITE, EV_ADD | EV_ONESHOT, 0, 0, NULL);
+    }
+    return kevent(loop->backend_fd, changes, count, NULL, 0, NULL) < 0 ? -1 : 0;
+}
+
+static void backend_remove(ember_event_loop* loop, int fd, int events) {
+    if (loop->backend_fd < 0) return;
+    struct kevent changes[2];
+    int count = 0;
+    if (events & EMBER_LOOP_READ) {
+        EV_SET(&changes[count++], fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+    }
+    if (events & EMBER_LOOP_WRITE) {
+        EV_SET(&changes[count++], fd, EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+    }
+    // A filter that already fired is gone; ENOENT is expected
+    kevent(loop->backend_fd, changes, count, NULL, 0, NULL);
+}
+
+static int backend_wait(ember_event_loop* loop, int timeout_ms, int* fds, int* events, int max) {
+    if (loop->backend_fd < 0) {
+        if (timeout_ms > 0) {
+            struct timespec ts = {timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000};
+            nanosleep(&ts, NULL);
+        }
+        return 0;
+    }
+    struct kevent ready[LOOP_EVENTS_MAX];
+    struct timespec ts = {timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000};
+    int count = kevent(loop->backend_fd, NULL, 0, ready, max < LOOP_EVENTS_MAX ? max : LOOP_EVENTS_MAX,
+                       timeout_ms < 0 ? NULL : &ts);
+    if (count < 0) return errno == EINTR ? 0 : -1;
+    for (int i = 0; i < count; i++) {
+        fds[i] = (int)ready[i].ident;
+        events[i] = ready[i].filter == EVFILT_READ ? EMBER_LOOP_READ : EMBER_LOOP_WRITE;
+    }
+    return count;
+}
+
+#else
+
+static int backend_add(ember_event_loop* loop, int fd, int events) {
+    (void)loop; (void)fd; (void)events;
+    return 0;
+}
+
+static void backend_remove(ember_event_loop* loop, int fd, int events) {
+    (void)loop; (void)fd; (void)events;
+}
+
+static int backend_wait(ember_event_loop* loop, int timeout_ms, int* fds, int* events, int max) {
+    int count = loop->watcher_count < LOOP_EVENTS_MAX ? loop->watcher_count : LOOP_EVENTS_MAX;
+    struct pollfd polled[LOOP_EVENTS_MAX];
+    for (int i = 0; i < count; i++) {
+        polled[i].fd = loop->watchers[i].fd;
+        polled[i].events = 0;
+        if (loop->watchers[i].events & EMBER_LOOP_READ) polled[i].events |= POLLIN;
+        if (loop->watchers[i].events & EMBER_LOOP_WRITE) polled[i].events |= POLLOUT;
+        polled[i].revents = 0;
+    }
+    int result = poll(polled, (nfds_t)count, timeout_ms);
+    if (result < 0) return errno == EINTR ? 0 : -1;
+    int ready = 0;
+    for (int i = 0; i < count && ready < max; i++) {
+        if (!polled[i].revents) continue;
+        fds[ready] = polled[i].fd;
+        events[ready] = 0;
+        if (polled[i].revents & (POLLIN | POLLHUP | POLLERR)) events[ready] |= EMBER_LOOP_READ;
+        if (polled[i].revents & (POLLOUT | POLLERR)) events[ready] |= EMBER_LOOP_WRITE;
+        ready++;
+    }
+    return ready;
+}
+
+#endif
+
+int ember_loop_watch_fd(ember_vm* vm, int fd, int events, ember_io_callback callback, void* userdata) {
+    if (!vm || fd < 0 || !callback || !(events & (EMBER_LOOP_READ | EMBER_LOOP_WRITE))) {
+        return EMBER_ERROR_INVALID_PARAMETER;
+    }
+    ember_event_loop* loop = loop_get(vm);
+    if (!loop) return EMBER_ERROR_MEMORY_ALLOCATION;
+    if (find_watcher(loop, fd) >= 0) {
+        return EMBER_ERROR_INVALID_PARAMETER;  // One watch per descriptor
+    }
+    if (loop->watcher_count == loop->watcher_capacity) {
+        int capacity = loop->watcher_capacity ? loop->watcher_capacity * 2 : 16;
+        loop_watcher* watchers = realloc(loop->watchers, sizeof(loop_watcher) * (size_t)capacity);
+        if (!watchers) return EMBER_ERROR_MEMORY_ALLOCATION;
+        loop->watchers = watchers;
+        loop->watcher_capacity = capacity;
+    }
+    if (backend_add(loop, fd, events) != 0) {
+        return EMBER_ERROR_OPERATION_FAILED;
+    }
+    loop_watcher* watcher = &loop->watchers[loop->watcher_count++];
+    watcher->fd = fd;
+    watcher->events = events;
+    watcher->callback = callback;
+    watcher->userdata = userdata;
+    watcher->serial = loop->watch_serial;
+    return EMBER_SUCCESS;
+}
+
+int ember_loop_unwatch_fd(ember_vm* vm, int fd) {
+    if (!vm || !vm->event_loop) return EMBER_ERROR_INVALID_PARAMETER;
+    ember_event_loop* loop = vm->event_loop;
+    int index = find_watcher(loop, fd);
+    if (index < 0) return EMBER_ERROR_INVALID_PARAMETER;
+    backend_remove(loop, fd, loop->watchers[index].events);
+    remove_watcher(loop, index);
+    return EMBER_SUCCESS;
+}
+
+int ember_loop_run_once(ember_vm* vm, int timeout_ms) {
+    if (!vm) return -1;
+    ember_loop_run_microtasks(vm);
+    ember_event_loop* loop = vm->event_loop;
+    if (!loop || (loop->timer_count == 0 && loop->watcher_count == 0)) {
+        return 0;
+    }
+
+    if (loop->timer_count > 0) {
+        uint64_t now = loop_now_ms();
+        uint64_t next = wheel_next_tick(loop);
+        uint64_t until = next > now ? next - now : 0;
+        if (until > INT32_MAX) until = INT32_MAX;
+        if (timeout_ms < 0 || (int)until < timeout_ms) timeout_ms = (int)until;
+    }
+
+    int fds[LOOP_EVENTS_MAX];
+    int events[LOOP_EVENTS_MAX];
+    int ready = backend_wait(loop, timeout_ms, fds, events, LOOP_EVENTS_MAX);
+    if (ready < 0) {
+        fprintf(stderr, "[LOOP] Waiting for events failed: %s\n", strerror(errno));
+        return -1;
+    }
+
+    // Each ready descriptor and each expired timer is one macrotask
+    for (int i = 0; i < ready; i++) {
+        int index = find_watcher(loop, fds[i]);
+        if (index < 0) continue;
+        loop_watcher watcher = loop->watchers[index];
+        remove_watcher(loop, index);
+        watcher.callback(vm, watcher.fd, events[i], watcher.userdata);
+        ember_loop_run_microtasks(vm);
+    }
+    uint64_t now = loop_now_ms();
+    wheel_advance(loop, now);
+    // Only what is due now: timers these add wait for the next round
+    for (int expired = loop->due_count; expired > 0 && loop->due.head; expired--) {
+        int index = loop->due.head - 1;
+        loop_timer timer = loop->timers[index];
+        if (timer.interval_ms) {
+            // Rearmed first, so the callback can clear it
+            timer_unlink(loop, index);
+            loop->timers[index].deadline_ms = loop_deadline_ms(timer.interval_ms);
+            timer_file(loop, index);
+        } else {
+            timer_release(loop, index);
+        }
+        if (timer.callback) {
+            timer.callback(vm, timer.userdata);
+        } else if (timer.function.type != EMBER_VAL_NIL) {
+            ember_value ignored;
+            int rooted = vm->stack_top < EMBER_STACK_MAX;
+            if (rooted) vm->stack[vm->stack_top++] = timer.function;
+            if (vm_call_value(vm, timer.function, 0, NULL, &ignored) != 0) {
+                fprintf(stderr, "[LOOP] Timer callback failed\n");
+                vm->exception_pending = 0;
+                vm->current_exception = ember_make_nil();
+            }
+            if (rooted) vm->stack_top--;
+        } else {
+            settle(vm, timer.promise, ember_make_nil(), 0);
+        }
+        ember_loop_run_microtasks(vm);
+    }
+    return ready;
+}
+
+int ember_loop_run(ember_vm* vm) {
+    if (!vm) return -1;
+    for (;;) {
+        ember_loop_run_microtasks(vm);
+        ember_event_loop* loop = vm->event_loop;
+        if (!loop || (loop->timer_count == 0 && loop->watcher_count == 0)) {
+            return 0;
+        }
+        if (ember_loop_run_once(vm, -1) < 0) {
+            return -1;
+        }
+    }
+}
+
+int ember_loop_pending(ember_vm* vm) {
+    if (!vm || !vm->event_loop) return 0;
+    ember_event_loop* loop = vm->event_loop;
+    return loop->micro_count + loop->suspended + loop->timer_count + loop->watcher_count;
+}
+
+// ============================================================================
+// GC AND LIFETIME
+// ============================================================================
+
+static void gray_values(ember_vm* vm, const ember_value* values, int count) {
+    for (int i = 0; i < count; i++) {
+        gc_gray_value(vm, values[i]);
+    }
+}
+
+static void gray_frame(ember_vm* vm, const ember_async_frame* frame) {
+    gray_values(vm, frame->locals, frame->local_count);
+    gray_values(vm, frame->stack, frame->stack_count);
+    gc_gray_value(vm, frame->promise);
+}
+
+void event_loop_gray_roots(ember_vm* vm) {
+    ember_event_loop* loop = vm->event_loop;
+    if (!loop) return;
+    for (int i = 0; i < loop->micro_count; i++) {
+        const loop_microtask* task = &loop->microtasks[(loop->micro_head + i) & (loop->micro_capacity - 1)];
+        gc_gray_value(vm, task->callback);
+        gc_gray_value(vm, task->value);
+        if (task->frame) gray_frame(vm, task->frame);
+    }
+    for (int i = 0; i < loop->waiter_buckets; i++) {
+        for (loop_waiter* waiter = loop->waiters[i]; waiter; waiter = waiter->next) {
+            // The awaited promise is only referenced from here
+            gc_gray_object(vm, (ember_object*)waiter->promise);
+            gc_gray_value(vm, waiter->target);
+            if (waiter->frame) gray_frame(vm, waiter->frame);
+        }
+    }
+    for (int i = 0; i < loop->timer_capacity; i++) {
+        if (!loop->timers[i].id) continue;
+        gc_gray_value(vm, loop->timers[i].promise);
+        gc_gray_value(vm, loop->timers[i].function);
+    }
+}
+
+void event_loop_free(ember_vm* vm) {
+    if (!vm || !vm->event_loop) return;
+    ember_event_loop* loop = vm->event_loop;
+    // Hooks still see a working loop (they may unwatch their descriptors)
+    for (int i = loop->close_hook_count - 1; i >= 0; i--) {
+        loop->close_hooks[i].callback(vm, loop->close_hooks[i].userdata);
+    }
+    free(loop->close_hooks);
+    while (loop->micro_count > 0) {
+        loop_microtask task;
+        micro_pop(loop, &task);
+        free_frame(task.frame);
+    }
+    free(loop->microtasks);
+    for (int i = 0; i < loop->waiter_buckets; i++) {
+        loop_waiter* waiter = loop->waiters[i];
+        while (waiter) {
+            loop_waiter* next = waiter->next;
+            free_frame(waiter->frame);
+            free(waiter);
+            waiter = next;
+        }
+    }
+    free(loop->waiters);
+    free(loop->timers);
+    free(loop->timer_ids);
+    free(loop->watchers);
+    if (loop->backend_fd >= 0) {
+        close(loop->backend_fd);
+    }
+#if defined(LOOP_EPOLL)
+    if (loop->ring) {
+        io_ring_free(loop->ring);
+        free(loop->ring);
+    }
+#endif
+    free(loop);
+    vm->event_loop = NULL;
+}
@@ -0,0 +1,690 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "../runtime/value/value.h"
+#include "numa_topology.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// Script executor (ember_executor_*). A fixed set of worker threads, each
+// holding one VM for its whole life, so globals, resolved function handles
+// and inline caches stay warm across the tasks it runs.
+//
+// Tasks submitted from outside go to a shared injection queue. A worker
+// moves a batch of them to its own work-stealing deque (Chase-Lev, as in
+// gc_parallel.c) and runs them from the bottom; idle workers steal from the
+// top of the others' deques. Tasks submitted from a completion callback go
+// straight to the running worker's deque. Workers with nothing to run or
+// steal sleep on a condition variable.
+//
+// On a machine with several NUMA nodes the workers are dealt out to the
+// nodes round-robin and pinned to their node's CPUs. A pinned worker builds
+// its own VM (vm_pool_get_fresh) after pinning, so the VM and the heap it
+// allocates are first touched, and so placed, on that node. Thieves try the
+// workers of their own node before crossing to another.
+//
+// With a fuel budget (ember_executor_set_fuel) a task that uses up its slice
+// in yield mode is preempted where it stands, at a loop back edge or call:
+// the worker runs the next tasks on its own deque and the injection queue
+// on the same VM, each under entry frames above the preempted one, then
+// returns into it. Preempted tasks nest up to EXECUTOR_YIELD_DEPTH deep;
+// past that a task just gets another slice.
+//
+// Values cross VMs only as nil, booleans, numbers and strings; strings are
+// copied at submit and rebuilt in the worker's VM. Native work
+// (executor_submit_work, for parallel_array.c) marshals its own values.
+
+#define EXECUTOR_WORKERS_MAX 256
+#define EXECUTOR_DEQUE_INITIAL 256
+#define EXECUTOR_INJECT_BATCH 16
+#define EXECUTOR_HANDLE_CACHE 16
+#define EXECUTOR_YIELD_TASKS 16     // Run by one preemption
+#define EXECUTOR_YIELD_DEPTH 4      // Preempted tasks on one worker's C stack
+
+typedef struct executor_task {
+    char* source;                   // Script, or NULL for a call
+    executor_work work;             // Native work instead of a script or call, or NULL
+    char* function;                 // Global function name for a call
+    int argc;
+    ember_value* argv;
+    char** strings;                 // argc copies of string arguments, NULL for other types
+    ember_task_callback callback;
+    void* userdata;
+    struct executor_task* next;     // Injection queue link
+} executor_task;
+
+typedef struct executor_buffer {
+    int64_t capacity;                  // Power of two
+    struct executor_buffer* retired;   // Older, smaller buffers, freed with the worker
+    executor_task* slots[];
+} executor_buffer;
+
+typedef struct {
+    char* name;
+    ember_function_handle* handle;
+} executor_handle_entry;
+
+typedef struct executor_worker {
+    int64_t top;                     // Stolen from by other workers
+    int64_t bottom;                  // Pushed and popped by the owner only
+    executor_buffer* buffer;
+    ember_executor* executor;
+    ember_vm* vm;
+    int pooled;                      // vm came from the VM pool
+    int node;                        // NUMA node the worker is pinned to, or -1
+    int* victims;                    // Steal order: same node first
+    executor_handle_entry handles[EXECUTOR_HANDLE_CACHE];
+    int handle_count;
+    int yield_depth;                 // Tasks preempted under the running one
+    pthread_t thread;
+    char padding[64];                // Keep neighbouring deques off one cache line
+} executor_worker;
+
+struct ember_executor {
+    executor_worker* workers;
+    int worker_count;
+    const char* prelude;             // Only read while workers start
+    ember_numa_topology* topology;   // NULL on a single-node machine
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;        // Workers sleep here
+    pthread_cond_t idle_cond;        // ember_executor_wait and startup sleep here
+    executor_task* injected_head;
+    executor_task* injected_tail;
+    int sleepers;
+    int stopping;
+    int started;                     // Workers that finished VM setup
+    int failed;                      // Workers whose setup failed
+    int64_t pending;                 // Submitted and not yet completed
+    int64_t fuel_slice;              // Per task, 0 for no budget
+    int fuel_mode;                   // ember_fuel_mode
+};
+
+static __thread executor_worker* executor_self = NULL;
+
+// ============================================================================
+// WORK-STEALING DEQUE
+// ============================================================================
+
+static executor_buffer* new_buffer(int64_t capacity) {
+    executor_buffer* buffer = malloc(sizeof(executor_buffer) + sizeof(executor_task*) * capacity);
+    if (!buffer) {
+        // The task is already counted as pending and would be lost
+        fprintf(stderr, "[EXECUTOR] Out of memory growing a worker deque\n");
+        abort();
+    }
+    buffer->capacity = capacity;
+    buffer->retired = NULL;
+    return buffer;
+}
+
+// Thieves may still read the old buffer, so it is only retired
+static executor_buffer* grow_buffer(executor_buffer* old, int64_t top, int64_t bottom) {
+    executor_buffer* buffer = new_buffer(old->capacity * 2);
+    for (int64_t i = top; i < bottom; i++) {
+        executor_task* task = __atomic_load_n(&old->slots[i & (old->capacity - 1)], __ATOMIC_RELAXED);
+        __atomic_store_n(&buffer->slots[i & (buffer->capacity - 1)], task, __ATOMIC_RELAXED);
+    }
+    buffer->retired = old;
+    return buffer;
+}
+
+static void deque_push(executor_worker* worker, executor_task* task) {
+    int64_t bottom = __atomic_load_n(&worker->bottom, __ATOMIC_RELAXED);
+    int64_t top = __atomic_load_n(&worker->top, __ATOMIC_ACQUIRE);
+    executor_buffer* buffer = __atomic_load_n(&worker->buffer, __ATOMIC_RELAXED);
+    if (bottom - top > buffer->capacity - 1) {
+        buffer = grow_buffer(buffer, top, bottom);
+        __atomic_store_n(&worker->buffer, buffer, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&buffer->slots[bottom & (buffer->capacity - 1)], task, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+}
+
+static executor_task* deque_pop(executor_worker* worker) {
+    int64_t bottom = __atomic_load_n(&worker->bottom, __ATOMIC_RELAXED) - 1;
+    executor_buffer* buffer = __atomic_load_n(&worker->buffer, __ATOMIC_RELAXED);
+    __atomic_store_n(&worker->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&worker->top, __ATOMIC_RELAXED);
+
+    executor_task* task = NULL;
+    if (top <= bottom) {
+        task = __atomic_load_n(&buffer->slots[bottom & (buffer->capacity - 1)], __ATOMIC_RELAXED);
+        if (top == bottom) {
+            // Last entry: race the thieves for it
+            if (!__atomic_compare_exchange_n(&worker->top, &top, top + 1, 0,
+                                             __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                task = NULL;
+            }
+            __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+        }
+    } else {
+        __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+    return task;
+}
+
+static executor_task* deque_steal(executor_worker* victim) {
+    int64_t top = __atomic_load_n(&victim->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t bottom = __atomic_load_n(&victim->bottom, __ATOMIC_ACQUIRE);
+    if (top >= bottom) return NULL;
+
+    executor_buffer* buffer = __atomic_load_n(&victim->buffer, __ATOMIC_ACQUIRE);
+    executor_task* task = __atomic_load_n(&buffer->slots[top & (buffer->capacity - 1)], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&victim->top, &top, top + 1, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return NULL;
+    }
+    return task;
+}
+
+static int deque_is_empty(executor_worker* worker) {
+    return __atomic_load_n(&worker->top, __ATOMIC_ACQUIRE) >=
+           __atomic_load_n(&worker->bottom, __ATOMIC_ACQUIRE);
+}
+
+// ============================================================================
+// TASKS
+// ============================================================================
+
+static void free_task(executor_task* task) {
+    if (task->strings) {
+        for (int i = 0; i < task->argc; i++) {
+            free(task->strings[i]);
+        }
+        free(task->strings);
+    }
+    free(task->argv);
+    free(task->function);
+    free(task->source);
+    free(task);
+}
+
+static ember_function_handle* worker_handle(executor_worker* worker, const char* name, int* cached) {
+    for (int i = 0; i < worker->handle_count; i++) {
+        if (strcmp(worker->handles[i].name, name) == 0) {
+            *cached = 1;
+            return worker->handles[i].handle;
+        }
+    }
+    *cached = 0;
+    ember_function_handle* handle = ember_function_resolve(worker->vm, name);
+    if (!handle || worker->handle_count == EXECUTOR_HANDLE_CACHE) {
+        return handle;
+    }
+    char* copy = strdup(name);
+    if (!copy) {
+        return handle;
+    }
+    worker->handles[worker->handle_count].name = copy;
+    worker->handles[worker->handle_count].handle = handle;
+    worker->handle_count++;
+    *cached = 1;
+    return handle;
+}
+
+static void run_task(executor_worker* worker, executor_task* task) {
+    ember_vm* vm = worker->vm;
+    ember_value result = ember_make_nil();
+    int status;
+
+    ember_executor* owner = worker->executor;
+    ember_vm_set_fuel(vm, __atomic_load_n(&owner->fuel_slice, __ATOMIC_RELAXED),
+                      (ember_fuel_mode)__atomic_load_n(&owner->fuel_mode, __ATOMIC_RELAXED));
+
+    if (task->work) {
+        task->work(vm, task->userdata);
+        status = 0;
+    } else if (task->source) {
+        status = ember_eval(vm, task->source);
+    } else {
+        int cached;
+        ember_function_handle* handle = worker_handle(worker, task->function, &cached);
+        if (!handle) {
+            status = -1;
+        } else {
+            for (int i = 0; i < task->argc; i++) {
+                if (task->strings && task->strings[i]) {
+                    task->argv[i] = ember_make_string_gc(vm, task->strings[i]);
+                }
+            }
+            status = ember_function_call(handle, task->argc, task->argv, &result);
+            if (!cached) {
+                ember_function_release(handle);
+            }
+        }
+    }
+
+    if (task->callback) {
+        task->callback(vm, status, result, task->userdata);
+    }
+    free_task(task);
+
+    ember_executor* executor = worker->executor;
+    if (__atomic_sub_fetch(&executor->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+        pthread_mutex_lock(&executor->lock);
+        pthread_cond_broadcast(&executor->idle_cond);
+        pthread_mutex_unlock(&executor->lock);
+    }
+}
+
+// Runs the first injected task; the rest of the batch goes on the worker's deque
+static executor_task* take_injected(executor_worker* worker) {
+    ember_executor* executor = worker->executor;
+    if (!__atomic_load_n(&executor->injected_head, __ATOMIC_RELAXED)) {
+        return NULL;
+    }
+    pthread_mutex_lock(&executor->lock);
+    executor_task* first = executor->injected_head;
+    if (first) {
+        executor_task* task = first->next;
+        for (int i = 1; task && i < EXECUTOR_INJECT_BATCH; i++) {
+            executor_task* next = task->next;
+            deque_push(worker, task);
+            task = next;
+        }
+        __atomic_store_n(&executor->injected_head, task, __ATOMIC_RELAXED);
+        if (!task) {
+            executor->injected_tail = NULL;
+        }
+    }
+    pthread_mutex_unlock(&executor->lock);
+    return first;
+}
+
+static executor_task* steal_work(executor_worker* self) {
+    ember_executor* executor = self->executor;
+    for (int i = 0; i < executor->worker_count - 1; i++) {
+        executor_task* task = deque_steal(&executor->workers[self->victims[i]]);
+        if (task) return task;
+    }
+    return NULL;
+}
+
+// Fuel hook of a worker's VM: the running task is preempted, and what is
+// queued behind it runs first
+static void yield_to_queue(ember_vm* vm, void* userdata) {
+    (void)vm;
+    executor_worker* worker = userdata;
+    if (worker->yield_depth >= EXECUTOR_YIELD_DEPTH) {
+        return;
+    }
+    worker->yield_depth++;
+    for (int i = 0; i < EXECUTOR_YIELD_TASKS; i++) {
+        executor_task* task = deque_pop(worker);
+        if (!task) task = take_injected(worker);
+        if (!task) break;
+        run_task(worker, task);
+    }
+    worker->yield_depth--;
+}
+
+// Caller holds the lock
+static int any_work_left(ember_executor* executor) {
+    if (executor->injected_head) return 1;
+    for (int i = 0; i < executor->worker_count; i++) {
+        if (!deque_is_empty(&executor->workers[i])) return 1;
+    }
+    return 0;
+}
+
+static void wake_sleeper(ember_executor* executor) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&executor->sleepers, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&executor->lock);
+        pthread_cond_signal(&executor->work_cond);
+        pthread_mutex_unlock(&executor->lock);
+    }
+}
+
+// ============================================================================
+// WORKERS
+// ============================================================================
+
+static int worker_setup(executor_worker* worker) {
+    ember_executor* executor = worker->executor;
+    if (worker->node >= 0 && numa_pin_thread(executor->topology, worker->node) == 0) {
+        worker->vm = vm_pool_get_fresh();
+    } else {
+        worker->vm = ember_pool_get_vm();
+    }
+    worker->pooled = worker->vm != NULL;
+    if (!worker->vm) {
+        worker->vm = ember_new_vm();
+    }
+    if (!worker->vm) {
+        return -1;
+    }
+    if (executor->prelude && ember_eval(worker->vm, executor->prelude) != 0) {
+        return -1;
+    }
+    ember_vm_set_fuel_hook(worker->vm, yield_to_queue, worker);
+    return 0;
+}
+
+static void worker_teardown(executor_worker* worker) {
+    for (int i = 0; i < worker->handle_count; i++) {
+        ember_function_release(worker->handles[i].handle);
+        free(worker->handles[i].name);
+    }
+    worker->handle_count = 0;
+    if (worker->vm) {
+        if (worker->pooled) {
+            ember_pool_release_vm(worker->vm);
+        } else {
+            ember_free_vm(worker->vm);
+        }
+        worker->vm = NULL;
+    }
+}
+
+static void* worker_thread(void* arg) {
+    executor_worker* self = arg;
+    ember_executor* executor = self->executor;
+    executor_self = self;
+
+    int setup = worker_setup(self);
+    pthread_mutex_lock(&executor->lock);
+    executor->started++;
+    if (setup != 0) {
+        executor->failed++;
+    }
+    pthread_cond_broadcast(&executor->idle_cond);
+    // A failed setup tears the executor down; wait for that
+    while (setup == 0 && !executor->stopping && executor->started < executor->worker_count) {
+        pthread_cond_wait(&executor->work_cond, &executor->lock);
+    }
+    pthread_mutex_unlock(&executor->lock);
+
+    for (;;) {
+        executor_task* task = deque_pop(self);
+        if (!task) task = take_injected(self);
+        if (!task) task = steal_work(self);
+        if (task) {
+            run_task(self, task);
+            continue;
+        }
+
+        pthread_mutex_lock(&executor->lock);
+        __atomic_add_fetch(&executor->sleepers, 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);  // Pairs with wake_sleeper
+        if (any_work_left(executor)) {
+            __atomic_sub_fetch(&executor->sleepers, 1, __ATOMIC_SEQ_CST);
+            pthread_mutex_unlock(&executor->lock);
+            continue;
+        }
+        if (executor->stopping) {
+            __atomic_sub_fetch(&executor->sleepers, 1, __ATOMIC_SEQ_CST);
+            pthread_mutex_unlock(&executor->lock);
+            break;
+        }
+        pthread_cond_wait(&executor->work_cond, &executor->lock);
+        __atomic_sub_fetch(&executor->sleepers, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&executor->lock);
+    }
+
+    worker_teardown(self);
+    executor_self = NULL;
+    return NULL;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+static void executor_free(ember_executor* executor, int started) {
+    pthread_mutex_lock(&executor->lock);
+    executor->stopping = 1;
+    pthread_cond_broadcast(&executor->work_cond);
+    pthread_mutex_unlock(&executor->lock);
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(executor->workers[i].thread, NULL);
+    }
+    for (int i = 0; i < executor->worker_count; i++) {
+        executor_buffer* buffer = executor->workers[i].buffer;
+        while (buffer) {
+            executor_buffer* retired = buffer->retired;
+            free(buffer);
+            buffer = retired;
+        }
+        free(executor->workers[i].victims);
+    }
+    free(executor->topology);
+    pthread_cond_destroy(&executor->idle_cond);
+    pthread_cond_destroy(&executor->work_cond);
+    pthread_mutex_destroy(&executor->lock);
+    free(executor->workers);
+    free(executor);
+}
+
+// Each worker's victims: the rest of its node, then every other worker, both
+// starting just after itself so thieves spread out
+static int build_steal_orders(ember_executor* executor) {
+    int count = executor->worker_count;
+    for (int i = 0; i < count; i++) {
+        executor_worker* worker = &executor->workers[i];
+        worker->victims = malloc(sizeof(int) * (count > 1 ? count - 1 : 1));
+        if (!worker->victims) {
+            return -1;
+        }
+        int n = 0;
+        for (int pass = 0; pass < 2; pass++) {
+            for (int step = 1; step < count; step++) {
+                int victim = (i + step) % count;
+                int same_node = executor->workers[victim].node == worker->node;
+                if (same_node == (pass == 0)) {
+                    worker->victims[n++] = victim;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+ember_executor* ember_executor_create(int workers, const char* prelude) {
+    if (workers <= 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = online > 0 ? (int)online : 1;
+    }
+    if (workers > EXECUTOR_WORKERS_MAX) {
+        workers = EXECUTOR_WORKERS_MAX;
+    }
+
+    ember_executor* executor = calloc(1, sizeof(ember_executor));
+    if (!executor) {
+        return NULL;
+    }
+    executor->workers = calloc((size_t)workers, sizeof(executor_worker));
+    if (!executor->workers) {
+        free(executor);
+        return NULL;
+    }
+    executor->worker_count = workers;
+    executor->prelude = prelude;
+    pthread_mutex_init(&executor->lock, NULL);
+    pthread_cond_init(&executor->work_cond, NULL);
+    pthread_cond_init(&executor->idle_cond, NULL);
+
+    executor->topology = malloc(sizeof(ember_numa_topology));
+    if (executor->topology && numa_topology_detect(executor->topology) < 2) {
+        free(executor->topology);
+        executor->topology = NULL;
+    }
+    for (int i = 0; i < workers; i++) {
+        executor->workers[i].buffer = new_buffer(EXECUTOR_DEQUE_INITIAL);
+        executor->workers[i].executor = executor;
+        executor->workers[i].node = executor->topology ? i % executor->topology->node_count : -1;
+    }
+    if (build_steal_orders(executor) != 0) {
+        executor_free(executor, 0);
+        return NULL;
+    }
+
+    int started = 0;
+    for (; started < workers; started++) {
+        if (pthread_create(&executor->workers[started].thread, NULL, worker_thread,
+                           &executor->workers[started]) != 0) {
+            fprintf(stderr, "[EXECUTOR] Could not start worker thread %d\n", started);
+            break;
+        }
+    }
+
+    // Every worker holds its VM (and has run the prelude) before tasks arrive
+    pthread_mutex_lock(&executor->lock);
+    while (executor->started < started) {
+        pthread_cond_wait(&executor->idle_cond, &executor->lock);
+    }
+    int failed = executor->failed;
+    pthread_cond_broadcast(&executor->work_cond);
+    pthread_mutex_unlock(&executor->lock);
+
+    if (started < workers || failed > 0) {
+        if (failed > 0) {
+            fprintf(stderr, "[EXECUTOR] %d worker(s) could not set up a VM\n", failed);
+        }
+        executor_free(executor, started);
+        return NULL;
+    }
+    executor->prelude = NULL;
+    return executor;
+}
+
+static int submit(ember_executor* executor, executor_task* task) {
+    __atomic_add_fetch(&executor->pending, 1, __ATOMIC_ACQ_REL);
+    executor_worker* self = executor_self;
+    if (self && self->executor == executor) {
+        // Submitted from a callback: keep it local, other workers may steal it
+        deque_push(self, task);
+        wake_sleeper(executor);
+        return 0;
+    }
+
+    pthread_mutex_lock(&executor->lock);
+    if (executor->injected_tail) {
+        executor->injected_tail->next = task;
+    } else {
+        __atomic_store_n(&executor->injected_head, task, __ATOMIC_RELAXED);
+    }
+    executor->injected_tail = task;
+    if (executor->sleepers > 0) {
+        pthread_cond_signal(&executor->work_cond);
+    }
+    pthread_mutex_unlock(&executor->lock);
+    return 0;
+}
+
+int ember_executor_submit_script(ember_executor* executor, const char* source,
+                                 ember_task_callback callback, void* userdata) {
+    if (!executor || !source) {
+        return EMBER_ERROR_INVALID_PARAMETER;
+    }
+    executor_task* task = calloc(1, sizeof(executor_task));
+    if (!task || !(task->source = strdup(source))) {
+        free(task);
+        return EMBER_ERROR_MEMORY_ALLOCATION;
+    }
+    task->callback = callback;
+    task->userdata = userdata;
+    return submit(executor, task);
+}
+
+int ember_executor_submit_call(ember_executor* executor, const char* func_name,
+                               int argc, const ember_value* argv,
+                               ember_task_callback callback, void* userdata) {
+    if (!executor || !func_name || func_name[0] == '\0' ||
+        argc < 0 || argc > EMBER_MAX_ARGS || (argc > 0 && !argv)) {
+        return EMBER_ERROR_INVALID_PARAMETER;
+    }
+    for (int i = 0; i < argc; i++) {
+        ember_val_type type = argv[i].type;
+        if (type != EMBER_VAL_NIL && type != EMBER_VAL_BOOL &&
+            type != EMBER_VAL_NUMBER && type != EMBER_VAL_STRING) {
+            return EMBER_ERROR_INVALID_PARAMETER;  // Objects belong to the caller's VM
+        }
+    }
+
+    executor_task* task = calloc(1, sizeof(executor_task));
+    if (!task) {
+        return EMBER_ERROR_MEMORY_ALLOCATION;
+    }
+    task->function = strdup(func_name);
+    task->argc = argc;
+    task->argv = argc > 0 ? malloc(sizeof(ember_value) * argc) : NULL;
+    if (!task->function || (argc > 0 && !task->argv)) {
+        free_task(task);
+        return EMBER_ERROR_MEMORY_ALLOCATION;
+    }
+    for (int i = 0; i < argc; i++) {
+        task->argv[i] = argv[i];
+        if (argv[i].type != EMBER_VAL_STRING) {
+            continue;
+        }
+        if (!task->strings && !(task->strings = calloc((size_t)argc, sizeof(char*)))) {
+            free_task(task);
+            return EMBER_ERROR_MEMORY_ALLOCATION;
+        }
+        if (!(task->strings[i] = strdup(AS_CSTRING(argv[i])))) {
+            free_task(task);
+            return EMBER_ERROR_MEMORY_ALLOCATION;
+        }
+    }
+    task->callback = callback;
+    task->userdata = userdata;
+    return submit(executor, task);
+}
+
+int executor_submit_work(ember_executor* executor, executor_work work, void* userdata) {
+    if (!executor || !work) {
+        return EMBER_ERROR_INVALID_PARAMETER;
+    }
+    executor_task* task = calloc(1, sizeof(executor_task));
+    if (!task) {
+        return EMBER_ERROR_MEMORY_ALLOCATION;
+    }
+    task->work = work;
+    task->userdata = userdata;
+    return submit(executor, task);
+}
+
+int executor_worker_count(const ember_executor* executor) {
+    return executor ? executor->worker_count : 0;
+}
+
+int executor_on_worker(const ember_executor* executor) {
+    return executor_self && executor_self->executor == executor;
+}
+
+int ember_executor_set_fuel(ember_executor* executor, int64_t slice, ember_fuel_mode mode) {
+    if (!executor || slice < 0 || (mode != EMBER_FUEL_TIMEOUT && mode != EMBER_FUEL_YIELD)) {
+        return EMBER_ERROR_INVALID_PARAMETER;
+    }
+    // Tasks already running keep the budget they started with
+    __atomic_store_n(&executor->fuel_mode, (int)mode, __ATOMIC_RELAXED);
+    __atomic_store_n(&executor->fuel_slice, slice, __ATOMIC_RELAXED);
+    return EMBER_SUCCESS;
+}
+
+void ember_executor_wait(ember_executor* executor) {
+    if (!executor) return;
+    pthread_mutex_lock(&executor->lock);
+    while (__atomic_load_n(&executor->pending, __ATOMIC_ACQUIRE) > 0) {
+        pthread_cond_wait(&executor->idle_cond, &executor->lock);
+    }
+    pthread_mutex_unlock(&executor->lock);
+}
+
+void ember_executor_destroy(ember_executor* executor) {
+    if (!executor) return;
+    // Tasks already submitted still run
+    executor_free(executor, executor->worker_count);
+}
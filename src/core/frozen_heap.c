@@ -0,0 +1,104 @@
+#define _GNU_SOURCE
+#include "../../include/ember.h"
+#include "../vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// The frozen heap: value graphs copied once into memory every VM may
+// reference. Copies are decoded into a private host VM, which never runs
+// code or collects, and then taken out of its object list and marked
+// EMBER_OBJECT_FROZEN. From then on no VM owns them: graying stops at them,
+// the write barrier sees old objects, and the mutators refuse to change
+// them, so any number of threads can read them without locks.
+
+static pthread_mutex_t frozen_lock = PTHREAD_MUTEX_INITIALIZER;
+static ember_vm* frozen_host = NULL;
+static size_t frozen_objects = 0;
+static size_t frozen_bytes = 0;
+
+static ember_vm* frozen_host_vm(void) {
+    if (!frozen_host) {
+        frozen_host = ember_new_vm();
+        if (frozen_host) frozen_host->next_gc = INT64_MAX;
+    }
+    return frozen_host;
+}
+
+int ember_value_is_frozen(ember_value value) {
+    switch (value.type) {
+        case EMBER_VAL_NIL:
+        case EMBER_VAL_BOOL:
+        case EMBER_VAL_NUMBER:
+            return 1;
+        case EMBER_VAL_STRING:
+        case EMBER_VAL_ARRAY:
+        case EMBER_VAL_HASH_MAP:
+        case EMBER_VAL_SET:
+        case EMBER_VAL_MAP:
+        case EMBER_VAL_TYPED_ARRAY:
+            return ember_object_is_frozen(value.as.obj_val);
+        default:
+            return 0;
+    }
+}
+
+int ember_freeze(ember_value value, ember_value* out) {
+    if (!out) return -1;
+    if (ember_value_is_frozen(value)) {
+        *out = value;
+        return 0;
+    }
+    uint8_t* data;
+    size_t size;
+    if (ember_clone_encode(value, &data, &size) != 0) return -1;
+
+    pthread_mutex_lock(&frozen_lock);
+    ember_vm* host = frozen_host_vm();
+    if (!host) {
+        pthread_mutex_unlock(&frozen_lock);
+        free(data);
+        return -1;
+    }
+    ember_object* before = host->objects;
+    int64_t bytes_before = host->bytes_allocated;
+    ember_value copy;
+    int result = ember_clone_decode(host, data, size, &copy);
+    free(data);
+    if (result != 0) {
+        // What a failed decode built is unreachable; collecting it leaves
+        // the host as it was
+        ember_gc_collect(host);
+        host->next_gc = INT64_MAX;
+        pthread_mutex_unlock(&frozen_lock);
+        return -1;
+    }
+
+    // Everything the decode allocated is the front of the host's list
+    size_t count = 0;
+    ember_object* object = host->objects;
+    while (object && object != before) {
+        ember_object* next = object->next;
+        object->is_marked = EMBER_OBJECT_FROZEN;
+        object->is_old = 1;
+        object->is_remembered = 0;
+        object->next = NULL;
+        object = next;
+        count++;
+    }
+    host->objects = before;
+    frozen_objects += count;
+    frozen_bytes += (size_t)(host->bytes_allocated - bytes_before);
+    pthread_mutex_unlock(&frozen_lock);
+
+    *out = copy;
+    return 0;
+}
+
+void ember_frozen_heap_stats(size_t* objects, size_t* bytes) {
+    pthread_mutex_lock(&frozen_lock);
+    if (objects) *objects = frozen_objects;
+    if (bytes) *bytes = frozen_bytes;
+    pthread_mutex_unlock(&frozen_lock);
+}
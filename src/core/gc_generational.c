@@ -0,0 +1,764 @@
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "../runtime/value/value.h"
+#include "gc_trace.h"
+#include "probes.h"
+#include "object_slab.h"
+#include "object_shape.h"
+#include "vm_regex.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Generational collection, enabled with gc_configure(vm, 1, ...).
+//
+// Objects never move: allocate_object prepends to vm->objects, so everything
+// allocated since the last collection is a prefix of the list with is_old
+// clear. A minor collection marks from the roots without entering old
+// objects, also traces the old objects the write barrier remembered, frees
+// the unmarked young prefix and promotes the survivors. Full collections
+// still go through collect_garbage and promote everything they keep.
+//
+// Minor collections are only requested by the allocator and run at safe
+// points (calls and returns in vm_frames.c), where every live value is on
+// the VM stack, in locals, globals or chunk constants rather than in a C
+// local of a half-built object.
+
+#define GC_NURSERY_DEFAULT (512 * 1024)
+
+ember_object* gc_value_object(ember_value value) {
+    switch (value.type) {
+        case EMBER_VAL_STRING:
+        case EMBER_VAL_ARRAY:
+        case EMBER_VAL_HASH_MAP:
+        case EMBER_VAL_EXCEPTION:
+        case EMBER_VAL_CLASS:
+        case EMBER_VAL_INSTANCE:
+        case EMBER_VAL_PROMISE:
+        case EMBER_VAL_GENERATOR:
+        case EMBER_VAL_SET:
+        case EMBER_VAL_MAP:
+        case EMBER_VAL_REGEX:
+        case EMBER_VAL_ITERATOR:
+        case EMBER_VAL_STRING_BUILDER:
+        case EMBER_VAL_HASHER:
+        case EMBER_VAL_FILE:
+        case EMBER_VAL_WALKER:
+        case EMBER_VAL_TYPED_ARRAY:
+        case EMBER_VAL_CACHE:
+        case EMBER_VAL_DEQUE:
+        case EMBER_VAL_PRIORITY_QUEUE:
+        case EMBER_VAL_WEAK_REF:
+        case EMBER_VAL_WEAK_MAP:
+            return value.as.obj_val;
+        case EMBER_VAL_FUNCTION:
+            // Bound methods are heap objects; plain functions point at a chunk
+            return value.as.obj_val && value.as.obj_val->type == OBJ_METHOD ? value.as.obj_val : NULL;
+        default:
+            return NULL;
+    }
+}
+
+void gc_gray_object(ember_vm* vm, ember_object* object) {
+    // Frozen objects belong to no VM and are never written by a collector
+    if (!object || object->is_marked == EMBER_OBJECT_FROZEN) return;
+    if (gc_edge_visitor_self) {
+        gc_edge_visitor_self->visit(gc_edge_visitor_self, object);
+        return;
+    }
+    if (gc_mark_worker_self) {
+        gc_parallel_gray(gc_mark_worker_self, object);
+        return;
+    }
+    if (object->is_marked) return;
+    if (object->is_old && vm->gc_phase == GC_PHASE_IDLE) return;
+    object->is_marked = 1;
+    if (vm->gc_generational && vm->gc_phase == GC_PHASE_MARK) {
+        // Survivors of an incremental cycle are promoted as they are found
+        object->is_old = 1;
+    }
+    if (vm->gc_gray_count >= vm->gc_gray_capacity) {
+        int capacity = vm->gc_gray_capacity < 64 ? 64 : vm->gc_gray_capacity * 2;
+        ember_object** items = realloc(vm->gc_gray, sizeof(ember_object*) * capacity);
+        if (!items) {
+            // Abandoning the trace would free live objects
+            fprintf(stderr, "[GC] Out of memory while marking\n");
+            abort();
+        }
+        vm->gc_gray = items;
+        vm->gc_gray_capacity = capacity;
+    }
+    vm->gc_gray[vm->gc_gray_count++] = object;
+}
+
+void gc_gray_value(ember_vm* vm, ember_value value) {
+    gc_gray_object(vm, gc_value_object(value));
+}
+
+static void gray_values(ember_vm* vm, const ember_value* values, int count) {
+    for (int i = 0; values && i < count; i++) {
+        gc_gray_value(vm, values[i]);
+    }
+}
+
+static void gray_chunk_constants(ember_vm* vm, const ember_chunk* chunk) {
+    if (chunk) {
+        gray_values(vm, chunk->constants, chunk->const_count);
+    }
+}
+
+void gc_trace_object(ember_vm* vm, ember_object* object) {
+    switch (object->type) {
+        case OBJ_STRING: {
+            ember_string* string = (ember_string*)object;
+            gc_gray_object(vm, (ember_object*)string->left);
+            gc_gray_object(vm, (ember_object*)string->right);
+            break;
+        }
+        case OBJ_ARRAY: {
+            ember_array* array = (ember_array*)object;
+            gray_values(vm, array->elements, array->length);
+            break;
+        }
+        case OBJ_HASH_MAP: {
+            ember_hash_map* map = (ember_hash_map*)object;
+            for (int i = 0; map->entries && i < map->capacity; i++) {
+                if (map->entries[i].is_occupied) {
+                    gc_gray_value(vm, map->entries[i].key);
+                    gc_gray_value(vm, map->entries[i].value);
+                }
+            }
+            break;
+        }
+        case OBJ_EXCEPTION: {
+            ember_exception* exception = (ember_exception*)object;
+            gc_gray_value(vm, exception->cause);
+            gc_gray_value(vm, exception->data);
+            gray_values(vm, exception->suppressed_exceptions, exception->suppressed_count);
+            for (int i = 0; exception->stack_frames && i < exception->stack_frame_count; i++) {
+                gc_gray_value(vm, exception->stack_frames[i].locals);
+            }
+            break;
+        }
+        case OBJ_CLASS: {
+            ember_class* klass = (ember_class*)object;
+            gc_gray_object(vm, (ember_object*)klass->name);
+            gc_gray_object(vm, (ember_object*)klass->methods);
+            gc_gray_object(vm, (ember_object*)klass->superclass);
+            gc_gray_object(vm, (ember_object*)klass->method_cache);
+            break;
+        }
+        case OBJ_INSTANCE: {
+            ember_instance* instance = (ember_instance*)object;
+            gc_gray_object(vm, (ember_object*)instance->klass);
+            gc_gray_object(vm, (ember_object*)instance->fields);
+            int field_count = instance->shape ? instance->shape->field_count : 0;
+            for (int i = 0; i < field_count; i++) {
+                gc_gray_value(vm, instance->slots[i]);
+            }
+            break;
+        }
+        case OBJ_METHOD: {
+            ember_bound_method* bound = (ember_bound_method*)object;
+            gc_gray_value(vm, bound->receiver);
+            gc_gray_value(vm, bound->method);
+            break;
+        }
+        case OBJ_PROMISE: {
+            ember_promise* promise = (ember_promise*)object;
+            gc_gray_value(vm, promise->value);
+            gc_gray_object(vm, (ember_object*)promise->then_callbacks);
+            gc_gray_object(vm, (ember_object*)promise->catch_callbacks);
+            gc_gray_object(vm, (ember_object*)promise->finally_callbacks);
+            break;
+        }
+        case OBJ_GENERATOR: {
+            ember_generator* generator = (ember_generator*)object;
+            gray_values(vm, generator->frame, generator->local_count + generator->stack_top);
+            gc_gray_value(vm, generator->yielded_value);
+            break;
+        }
+        case OBJ_SET:
+            gc_gray_object(vm, (ember_object*)((ember_set*)object)->elements);
+            break;
+        case OBJ_MAP: {
+            ember_map* map = (ember_map*)object;
+            for (int i = 0; i < map->count; i++) {
+                if (map->entries[i].is_occupied) {
+                    gc_gray_value(vm, map->entries[i].key);
+                    gc_gray_value(vm, map->entries[i].value);
+                }
+            }
+            break;
+        }
+        case OBJ_REGEX:
+            gc_gray_object(vm, (ember_object*)((ember_regex*)object)->groups);
+            break;
+        case OBJ_ITERATOR:
+            gc_gray_value(vm, ((ember_iterator*)object)->collection);
+            gc_gray_value(vm, ((ember_iterator*)object)->regex);
+            gc_gray_value(vm, ((ember_iterator*)object)->step);
+            gc_gray_value(vm, ((ember_iterator*)object)->pending);
+            break;
+        case OBJ_STRING_BUILDER:
+        case OBJ_HASHER:
+        case OBJ_FILE:
+        case OBJ_WALKER:
+        case OBJ_TYPED_ARRAY:
+            // Bytes only
+            break;
+        case OBJ_CACHE:
+            for (ember_cache_entry* entry = ((ember_cache*)object)->newest; entry; entry = entry->older) {
+                gc_gray_value(vm, entry->key);
+                gc_gray_value(vm, entry->value);
+            }
+            break;
+        case OBJ_DEQUE: {
+            ember_deque* deque = (ember_deque*)object;
+            for (int i = 0; i < deque->length; i++) {
+                gc_gray_value(vm, deque_at(deque, i));
+            }
+            break;
+        }
+        case OBJ_PRIORITY_QUEUE: {
+            ember_priority_queue* queue = (ember_priority_queue*)object;
+            gc_gray_value(vm, queue->compare);
+            for (int i = 0; i < queue->length; i++) {
+                gc_gray_value(vm, queue->items[i].value);
+                gc_gray_value(vm, queue->items[i].priority);
+            }
+            break;
+        }
+        case OBJ_WEAK_REF:
+        case OBJ_WEAK_MAP:
+            // Nothing is held strongly; gc_sweep_weak marks what survives
+            break;
+        case OBJ_FUNCTION:
+            gray_chunk_constants(vm, ((ember_function*)object)->chunk);
+            break;
+    }
+}
+
+void gc_gray_roots(ember_vm* vm) {
+    gray_values(vm, vm->stack, vm->stack_top);
+    gray_values(vm, vm->locals, vm->local_count);
+    for (int i = 0; i < vm->global_count; i++) {
+        gc_gray_value(vm, vm->globals[i].value);
+    }
+    gray_chunk_constants(vm, vm->chunk);
+    for (int i = 0; i < vm->frame_count; i++) {
+        gray_chunk_constants(vm, vm->frames[i].chunk);
+    }
+    for (int i = 0; i < vm->function_chunk_count; i++) {
+        gray_chunk_constants(vm, vm->function_chunks[i]);
+    }
+    for (int i = 0; i < vm->module_count; i++) {
+        ember_module* module = vm->modules[i];
+        gray_chunk_constants(vm, module->chunk);
+        for (int j = 0; j < module->export_count; j++) {
+            gc_gray_value(vm, module->exports[j].value);
+        }
+    }
+    gc_gray_value(vm, vm->current_exception);
+    gc_gray_object(vm, (ember_object*)vm->pending_promises);
+    gray_values(vm, vm->async_stack, vm->async_stack_top);
+    gc_gray_object(vm, (ember_object*)vm->current_generator);
+    event_loop_gray_roots(vm);
+    eval_cache_gray_roots(vm);
+
+    // Old objects holding young references act as roots of a minor collection
+    if (gc_edge_visitor_self) return;
+    for (int i = 0; vm->gc_phase == GC_PHASE_IDLE && i < vm->gc_remembered_count; i++) {
+        gc_trace_object(vm, vm->gc_remembered[i]);
+    }
+}
+
+// ============================================================================
+// WEAK REFERENCES
+// ============================================================================
+
+static void set_weak_index(ember_object* object, int index) {
+    if (object->type == OBJ_WEAK_REF) {
+        ((ember_weak_ref*)object)->weak_index = index;
+    } else {
+        ((ember_weak_map*)object)->weak_index = index;
+    }
+}
+
+int gc_register_weak(ember_vm* vm, ember_object* object) {
+    set_weak_index(object, -1);
+    if (vm->gc_weak_count >= vm->gc_weak_capacity) {
+        int capacity = vm->gc_weak_capacity < 16 ? 16 : vm->gc_weak_capacity * 2;
+        ember_object** weak = realloc(vm->gc_weak, sizeof(ember_object*) * capacity);
+        if (!weak) return 0;
+        vm->gc_weak = weak;
+        vm->gc_weak_capacity = capacity;
+    }
+    set_weak_index(object, vm->gc_weak_count);
+    vm->gc_weak[vm->gc_weak_count++] = object;
+    return 1;
+}
+
+// The last registration moves into the freed slot
+static void gc_forget_weak(ember_vm* vm, ember_object* object, int index) {
+    if (index < 0 || index >= vm->gc_weak_count || vm->gc_weak[index] != object) return;
+    ember_object* last = vm->gc_weak[--vm->gc_weak_count];
+    vm->gc_weak[index] = last;
+    set_weak_index(last, index);
+}
+
+// Whether the collection that just marked keeps object: a minor one never
+// marks old objects, and frozen ones count as marked
+static inline int weak_alive(const ember_object* object, int young_only) {
+    return object->is_marked || (young_only && object->is_old);
+}
+
+void gc_sweep_weak(ember_vm* vm, int young_only) {
+    if (!vm || vm->gc_weak_count == 0) return;
+
+    // collect_garbage marks outside an incremental cycle, where graying
+    // stops at old objects; values found here have to be entered all the same
+    int phase = vm->gc_phase;
+    if (!young_only) vm->gc_phase = GC_PHASE_MARK;
+
+    // A value marked here can make another map's key live, so repeat until
+    // a pass finds nothing new
+    int grayed;
+    do {
+        for (int i = 0; i < vm->gc_weak_count; i++) {
+            ember_object* object = vm->gc_weak[i];
+            if (object->type != OBJ_WEAK_MAP || !weak_alive(object, young_only)) continue;
+            ember_weak_map* map = (ember_weak_map*)object;
+            for (int j = 0; j < map->capacity; j++) {
+                ember_weak_entry* entry = &map->entries[j];
+                if (entry->key.type != EMBER_VAL_NIL && weak_alive(entry->key.as.obj_val, young_only)) {
+                    gc_gray_value(vm, entry->value);
+                }
+            }
+        }
+        grayed = vm->gc_gray_count > 0;
+        while (vm->gc_gray_count > 0) {
+            gc_trace_object(vm, vm->gc_gray[--vm->gc_gray_count]);
+        }
+    } while (grayed);
+    vm->gc_phase = phase;
+
+    // Dead references and maps are being swept and need no clearing
+    for (int i = 0; i < vm->gc_weak_count; i++) {
+        ember_object* object = vm->gc_weak[i];
+        if (!weak_alive(object, young_only)) continue;
+        if (object->type == OBJ_WEAK_REF) {
+            ember_weak_ref* ref = (ember_weak_ref*)object;
+            ember_object* target = gc_value_object(ref->target);
+            if (target && !weak_alive(target, young_only)) {
+                ref->target = ember_make_nil();
+            }
+            continue;
+        }
+        ember_weak_map* map = (ember_weak_map*)object;
+        for (int j = 0; j < map->capacity; j++) {
+            // Removal shifts a later entry into j, which is then checked too
+            while (map->entries[j].key.type != EMBER_VAL_NIL &&
+                   !weak_alive(map->entries[j].key.as.obj_val, young_only)) {
+                weak_map_remove_slot(map, j);
+            }
+        }
+    }
+}
+
+size_t gc_free_object(ember_vm* vm, ember_object* object) {
+    size_t size = 0;
+    switch (object->type) {
+        case OBJ_STRING: {
+            ember_string* string = (ember_string*)object;
+            size = string->is_external ? EMBER_STRING_EXTERNAL_SIZE :
+                   sizeof(ember_string) + (string->is_inline ? (size_t)string->length + 1 : 0);
+            free_string_object(string);
+            return size;
+        }
+        case OBJ_ARRAY:
+            free(((ember_array*)object)->elements);
+            size = sizeof(ember_array);
+            break;
+        case OBJ_HASH_MAP:
+            free(((ember_hash_map*)object)->entries);
+            free(((ember_hash_map*)object)->ctrl);
+            size = sizeof(ember_hash_map);
+            break;
+        case OBJ_EXCEPTION: {
+            ember_exception* exception = (ember_exception*)object;
+            free(exception->message);
+            free(exception->type_name);
+            free(exception->file_name);
+            for (int i = 0; exception->stack_frames && i < exception->stack_frame_count; i++) {
+                free(exception->stack_frames[i].function_name);
+                free(exception->stack_frames[i].file_name);
+            }
+            free(exception->stack_frames);
+            free(exception->trace);
+            free(exception->suppressed_exceptions);
+            size = sizeof(ember_exception);
+            break;
+        }
+        case OBJ_GENERATOR:
+            free(((ember_generator*)object)->frame);
+            size = sizeof(ember_generator);
+            break;
+        case OBJ_STRING_BUILDER:
+            free(((ember_string_builder*)object)->chars);
+            size = sizeof(ember_string_builder);
+            break;
+        case OBJ_HASHER:
+            ember_hasher_release((ember_hasher*)object);
+            size = sizeof(ember_hasher);
+            break;
+        case OBJ_FILE:
+            ember_file_release((ember_file*)object);
+            size = sizeof(ember_file);
+            break;
+        case OBJ_WALKER:
+            ember_walker_release((ember_walker*)object);
+            size = sizeof(ember_walker);
+            break;
+        case OBJ_TYPED_ARRAY:
+            free(((ember_typed_array*)object)->data);
+            size = sizeof(ember_typed_array);
+            break;
+        case OBJ_CACHE: {
+            ember_cache* cache = (ember_cache*)object;
+            lru_cache_clear(cache);
+            free(cache->spare);
+            free(cache->buckets);
+            size = sizeof(ember_cache);
+            break;
+        }
+        case OBJ_DEQUE:
+            free(((ember_deque*)object)->items);
+            size = sizeof(ember_deque);
+            break;
+        case OBJ_PRIORITY_QUEUE:
+            free(((ember_priority_queue*)object)->items);
+            size = sizeof(ember_priority_queue);
+            break;
+        case OBJ_WEAK_REF:
+            gc_forget_weak(vm, object, ((ember_weak_ref*)object)->weak_index);
+            size = sizeof(ember_weak_ref);
+            break;
+        case OBJ_WEAK_MAP:
+            gc_forget_weak(vm, object, ((ember_weak_map*)object)->weak_index);
+            free(((ember_weak_map*)object)->entries);
+            size = sizeof(ember_weak_map);
+            break;
+        case OBJ_REGEX: {
+            // Regexes are linked without being counted in bytes_allocated
+            // The pattern belongs to the shared compiled program
+            regex_program_release(((ember_regex*)object)->compiled_regex);
+            break;
+        }
+        case OBJ_FUNCTION:
+            free(((ember_function*)object)->name);
+            size = sizeof(ember_function);
+            break;
+        case OBJ_CLASS:
+            shape_free_tree(((ember_class*)object)->shape_root);
+            size = sizeof(ember_class);
+            break;
+        case OBJ_INSTANCE: {
+            ember_instance* instance = (ember_instance*)object;
+            if (instance->slots != instance->inline_slots) {
+                free(instance->slots);
+            }
+            size = instance_object_size(instance->inline_capacity);
+            break;
+        }
+        case OBJ_METHOD: size = sizeof(ember_bound_method); break;
+        case OBJ_PROMISE: size = sizeof(ember_promise); break;
+        case OBJ_SET: size = sizeof(ember_set); break;
+        case OBJ_MAP:
+            free(((ember_map*)object)->entries);
+            free(((ember_map*)object)->index);
+            size = sizeof(ember_map);
+            break;
+        case OBJ_ITERATOR: size = sizeof(ember_iterator); break;
+    }
+    if (!gc_pool_recycle(vm, object)) {
+        free_object_storage(object);
+    }
+    return size;
+}
+
+void gc_clear_remembered_set(ember_vm* vm) {
+    for (int i = 0; i < vm->gc_remembered_count; i++) {
+        vm->gc_remembered[i]->is_remembered = 0;
+    }
+    vm->gc_remembered_count = 0;
+}
+
+void gc_collect_minor(ember_vm* vm) {
+    // An incremental cycle owns the mark bits until it finishes; the request
+    // stays pending until then
+    if (!vm || !vm->gc_generational || vm->gc_phase != GC_PHASE_IDLE) return;
+    vm->gc_minor_requested = 0;
+    int64_t bytes_before = vm->bytes_allocated;
+    uint64_t start = gc_now_us();
+    EMBER_PROBE1(gc__start, "minor");
+
+    gc_gray_roots(vm);
+    while (vm->gc_gray_count > 0) {
+        gc_trace_object(vm, vm->gc_gray[--vm->gc_gray_count]);
+    }
+
+    // Weak references and interned strings let go of the dying young
+    // objects before they are freed
+    gc_sweep_weak(vm, 1);
+    sweep_young_string_intern_table(vm);
+
+    // The nursery is the young prefix of vm->objects
+    ember_object** link = &vm->objects;
+    while (*link && !(*link)->is_old) {
+        ember_object* object = *link;
+        if (object->is_marked) {
+            object->is_marked = 0;
+            object->is_old = 1;
+            vm->gc_objects_promoted++;
+            vm->gc_survivors[object->type]++;
+            link = &object->next;
+        } else {
+            *link = object->next;
+            size_t size = gc_free_object(vm, object);
+            vm->bytes_allocated -= (int64_t)size;
+        }
+    }
+
+    gc_clear_remembered_set(vm);
+    vm->gc_nursery_bytes = 0;
+    vm->gc_minor_collections++;
+    vm->gc_collections++;
+    EMBER_PROBE2(gc__done, "minor", bytes_before - vm->bytes_allocated);
+    uint64_t pause = gc_now_us() - start;
+    gc_stats_pause(vm, pause);
+    gc_stats_collected(vm, EMBER_GC_MINOR, pause, bytes_before, bytes_before - vm->bytes_allocated);
+}
+
+// collect_garbage keeps only reachable objects, all of which are now old
+void gc_promote_survivors(ember_vm* vm) {
+    if (!vm || !vm->gc_generational) return;
+    for (ember_object* object = vm->objects; object && !object->is_old; object = object->next) {
+        object->is_old = 1;
+        vm->gc_objects_promoted++;
+    }
+    gc_clear_remembered_set(vm);
+    vm->gc_nursery_bytes = 0;
+    vm->gc_minor_requested = 0;
+}
+
+void gc_write_barrier_helper(ember_vm* vm, ember_object* obj, ember_value old_val, ember_value new_val) {
+    (void)old_val;
+    ember_object* target = gc_value_object(new_val);
+    if (!vm || !obj || !target) return;
+
+    // Insertion barrier: a traced object must never point at an untraced one
+    if (vm->gc_phase == GC_PHASE_MARK && obj->is_marked) {
+        gc_gray_object(vm, target);
+    }
+
+    if (!vm->gc_generational || !obj->is_old || obj->is_remembered || target->is_old) {
+        return;
+    }
+    if (vm->gc_remembered_count >= vm->gc_remembered_capacity) {
+        int capacity = vm->gc_remembered_capacity < 64 ? 64 : vm->gc_remembered_capacity * 2;
+        ember_object** remembered = realloc(vm->gc_remembered, sizeof(ember_object*) * capacity);
+        if (!remembered) {
+            // Without the entry the young value could be freed; a full
+            // collection does not depend on the remembered set
+            fprintf(stderr, "[GC] Remembered set allocation failed, running full collection\n");
+            ember_gc_collect(vm);
+            return;
+        }
+        vm->gc_remembered = remembered;
+        vm->gc_remembered_capacity = capacity;
+    }
+    obj->is_remembered = 1;
+    vm->gc_remembered[vm->gc_remembered_count++] = obj;
+}
+
+// The request heap is the nursery: everything older than the request is
+// promoted when the VM is handed out, so releasing it is a minor collection
+// over just the request's objects, with the globals as the only roots
+void ember_vm_set_request_heap(ember_vm* vm, int enable) {
+    if (!vm) return;
+    if (enable && !vm->gc_generational) {
+        gc_configure(vm, 1, vm->gc_incremental, 1, vm->gc_object_pooling);
+    }
+    vm->gc_request_heap = enable ? 1 : 0;
+}
+
+void gc_request_begin(ember_vm* vm) {
+    if (!vm || !vm->gc_request_heap) return;
+    gc_promote_survivors(vm);
+}
+
+void gc_request_end(ember_vm* vm) {
+    if (!vm || !vm->gc_request_heap) return;
+    // Nothing the handler left on the stack or in locals outlives it
+    vm->stack_top = 0;
+    vm->local_count = 0;
+    vm->async_stack_top = 0;
+    vm->current_generator = NULL;
+    vm->current_exception = ember_make_nil();
+    if (vm->gc_phase != GC_PHASE_IDLE) {
+        gc_incremental_finish(vm);
+    }
+    gc_collect_minor(vm);
+}
+
+void gc_init(ember_vm* vm) {
+    if (!vm) return;
+    double start = startup_clock();
+    vm->gc_generational = 0;
+    vm->gc_nursery_bytes = 0;
+    vm->gc_nursery_limit = GC_NURSERY_DEFAULT;
+    vm->gc_minor_requested = 0;
+    vm->gc_remembered = NULL;
+    vm->gc_remembered_count = 0;
+    vm->gc_remembered_capacity = 0;
+    vm->gc_weak = NULL;
+    vm->gc_weak_count = 0;
+    vm->gc_weak_capacity = 0;
+    vm->gc_minor_collections = 0;
+    vm->gc_objects_promoted = 0;
+    vm->gc_request_heap = 0;
+    vm->gc_object_pooling = 0;
+    for (int i = 0; i < EMBER_POOLED_TYPES; i++) {
+        vm->gc_pool_free[i] = NULL;
+        vm->gc_pool_count[i] = 0;
+    }
+    vm->gc_pool_hits = 0;
+    vm->gc_gray = NULL;
+    vm->gc_gray_count = 0;
+    vm->gc_gray_capacity = 0;
+    vm->gc_telemetry = NULL;
+    for (int i = 0; i < EMBER_GC_OBJECT_TYPES; i++) {
+        vm->gc_survivors[i] = 0;
+    }
+    vm->gc_alloc_sample_every = 0;
+    vm->gc_alloc_sample_countdown = 0;
+    gc_incremental_init(vm);
+    gc_policy_init(vm);
+    startup_profile_phase(STARTUP_GC, start);
+}
+
+void gc_cleanup(ember_vm* vm) {
+    if (!vm) return;
+    gc_incremental_abort(vm);
+    free(vm->gc_remembered);
+    vm->gc_remembered = NULL;
+    vm->gc_remembered_count = 0;
+    vm->gc_remembered_capacity = 0;
+    free(vm->gc_weak);
+    vm->gc_weak = NULL;
+    vm->gc_weak_count = 0;
+    vm->gc_weak_capacity = 0;
+    free(vm->gc_gray);
+    vm->gc_gray = NULL;
+    vm->gc_gray_count = 0;
+    vm->gc_gray_capacity = 0;
+    gc_pool_drain(vm);
+    gc_stats_free(vm);
+}
+
+// Write barriers are always on while generational or incremental collection
+// is, since neither is sound without them
+void gc_configure(ember_vm* vm, int enable_generational, int enable_incremental,
+                  int enable_write_barriers, int enable_object_pooling) {
+    (void)enable_write_barriers;
+    if (!vm) return;
+
+    // Switching modes mid-cycle would leave the mark bits inconsistent
+    if (vm->gc_phase != GC_PHASE_IDLE) {
+        gc_incremental_finish(vm);
+    }
+
+    if (enable_generational && !vm->gc_generational) {
+        // Everything allocated so far counts as old
+        for (ember_object* object = vm->objects; object; object = object->next) {
+            object->is_old = 1;
+        }
+        if (vm->gc_nursery_limit <= 0) {
+            vm->gc_nursery_limit = GC_NURSERY_DEFAULT;
+        }
+        vm->gc_nursery_bytes = 0;
+        vm->gc_generational = 1;
+    } else if (!enable_generational && vm->gc_generational) {
+        gc_clear_remembered_set(vm);
+        vm->gc_minor_requested = 0;
+        vm->gc_generational = 0;
+        // Request heaps are reclaimed by minor collections
+        vm->gc_request_heap = 0;
+    }
+    gc_incremental_configure(vm, enable_incremental);
+
+    if (!enable_object_pooling && vm->gc_object_pooling) {
+        gc_pool_drain(vm);
+    }
+    vm->gc_object_pooling = enable_object_pooling ? 1 : 0;
+}
+
+void gc_print_statistics(ember_vm* vm) {
+    if (!vm) return;
+    printf("[GC] Collections: %llu (minor: %llu)\n",
+           (unsigned long long)vm->gc_collections, (unsigned long long)vm->gc_minor_collections);
+    printf("[GC] Bytes allocated: %lld, next full collection at %lld\n",
+           (long long)vm->bytes_allocated, (long long)vm->next_gc);
+    printf("[GC] Last full collection kept %lld bytes in %llu us, allocating %.0f bytes/ms\n",
+           (long long)vm->gc_live_bytes, (unsigned long long)vm->gc_last_pause_us, vm->gc_alloc_rate);
+    if (vm->gc_generational) {
+        printf("[GC] Nursery: %lld / %lld bytes, remembered objects: %d, promoted: %llu\n",
+               (long long)vm->gc_nursery_bytes, (long long)vm->gc_nursery_limit, vm->gc_remembered_count,
+               (unsigned long long)vm->gc_objects_promoted);
+    }
+    if (vm->gc_incremental) {
+        printf("[GC] Incremental steps: %llu, budget %d us, longest step %llu us\n",
+               (unsigned long long)vm->gc_incremental_steps, vm->gc_step_budget_us,
+               (unsigned long long)vm->gc_max_step_us);
+    }
+    if (vm->gc_mark_threads > 1) {
+        printf("[GC] Parallel marking with %d threads\n", vm->gc_mark_threads);
+    }
+    if (vm->gc_object_pooling) {
+        printf("[GC] Object pool: %d iterators, %d bound methods, %d promises, %d arrays, %llu reused\n",
+               vm->gc_pool_count[0], vm->gc_pool_count[1], vm->gc_pool_count[2], vm->gc_pool_count[3],
+               (unsigned long long)vm->gc_pool_hits);
+    }
+    if (vm->slab_count > 0) {
+        printf("[GC] Object slabs: %d (%d KB), %d huge page regions\n", vm->slab_count,
+               vm->slab_count * (EMBER_SLAB_SIZE / 1024), vm->slab_region_count);
+    }
+    ember_gc_stats stats;
+    if (ember_gc_get_stats(vm, &stats) == EMBER_SUCCESS && stats.pause_count > 0) {
+        printf("[GC] Pauses: %llu, total %llu us, longest %llu us; allocated %lld bytes, freed %lld\n",
+               (unsigned long long)stats.pause_count, (unsigned long long)stats.total_pause_us,
+               (unsigned long long)stats.max_pause_us, (long long)stats.total_allocated,
+               (long long)stats.total_freed);
+    }
+}
+
+void ember_gc_configure(ember_vm* vm, int enable_generational, int enable_incremental,
+                        int enable_write_barriers, int enable_object_pooling) {
+    gc_configure(vm, enable_generational, enable_incremental, enable_write_barriers, enable_object_pooling);
+}
+
+void ember_gc_print_statistics(ember_vm* vm) {
+    gc_print_statistics(vm);
+}
+
+void ember_gc_collect(ember_vm* vm) {
+    if (!vm) return;
+    if (vm->gc_incremental || vm->gc_mark_threads > 1 || vm->gc_lazy_sweep) {
+        // An explicit collection runs a whole cycle without a budget, and
+        // sweeps lazily only when triggered
+        gc_collect_full(vm, NULL);
+        return;
+    }
+    gc_collect_triggered(vm, NULL);
+}
@@ -0,0 +1,306 @@
+#define _GNU_SOURCE
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "../runtime/value/value.h"
+#include "gc_trace.h"
+#include "object_slab.h"
+#include "probes.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Incremental collection, enabled with gc_configure(vm, ..., 1, ...).
+//
+// A full cycle is split into steps of at most gc_step_budget_us:
+//   start  gray the roots (allocate_object, once bytes_allocated > next_gc)
+//   mark   trace gray objects until the budget runs out
+//   finish re-gray the roots, which have no barrier, drain the gray stack,
+//          clear weak references, drop dead interned strings and detach
+//          vm->objects for sweeping
+//   sweep  free unmarked objects of the detached list until the budget runs
+//          out, then splice the survivors back behind the new allocations
+//
+// Objects allocated while marking start black, and gc_write_barrier_helper
+// grays whatever is stored into a traced object, so a traced object never
+// points at an untraced one. Heap stores must therefore go through the
+// barriered helpers (array_push_with_vm, hash_map_set_with_vm). Steps run at
+// the same safe points as minor collections, which wait for the cycle.
+//
+// Lazy sweeping (ember_gc_set_lazy_sweep) runs the same cycle for triggered
+// collections of a VM that is not incremental: marking in one pause, after
+// which the mutator resumes with the cycle in the sweep phase and every
+// allocation sweeps GC_LAZY_SWEEP_OBJECTS of the detached list. Nothing
+// unmarked is reachable, and weak references and the intern table were
+// cleared before the list was detached, so the mutator cannot tell which
+// dead objects are still there. Sweeping stays on the mutator thread: freeing
+// goes through the object pool and the slab lists, neither of which is
+// locked. Once the list is done, each slab page with free slots rebuilds its
+// free list in address order.
+
+#define GC_STEP_BUDGET_DEFAULT_US 500
+#define GC_STEP_BYTES (64 * 1024)   // Allocation between requested steps
+#define GC_STEP_CHECK_INTERVAL 64   // Objects handled between clock reads
+#define GC_LAZY_SWEEP_OBJECTS 32    // Swept per allocation by a lazy cycle
+
+void gc_incremental_init(ember_vm* vm) {
+    if (!vm) return;
+    vm->gc_incremental = 0;
+    vm->gc_phase = GC_PHASE_IDLE;
+    vm->gc_step_budget_us = GC_STEP_BUDGET_DEFAULT_US;
+    vm->gc_step_bytes = 0;
+    vm->gc_step_requested = 0;
+    vm->gc_sweep_list = NULL;
+    vm->gc_sweep_survivors = NULL;
+    vm->gc_sweep_tail = &vm->gc_sweep_survivors;
+    vm->gc_incremental_steps = 0;
+    vm->gc_max_step_us = 0;
+    vm->gc_mark_threads = 1;
+    vm->gc_lazy_sweep = 0;
+}
+
+void gc_incremental_configure(ember_vm* vm, int enable) {
+    if (!vm) return;
+    if (vm->gc_step_budget_us <= 0) {
+        vm->gc_step_budget_us = GC_STEP_BUDGET_DEFAULT_US;
+    }
+    vm->gc_incremental = enable ? 1 : 0;
+    vm->gc_step_requested = 0;
+}
+
+void ember_gc_set_step_budget(ember_vm* vm, int microseconds) {
+    if (!vm) return;
+    if (microseconds <= 0) {
+        fprintf(stderr, "[GC] Invalid incremental step budget: %d us\n", microseconds);
+        return;
+    }
+    vm->gc_step_budget_us = microseconds;
+}
+
+void ember_gc_set_lazy_sweep(ember_vm* vm, int enable) {
+    if (!vm) return;
+    // A cycle already being swept lazily still finishes on allocation
+    vm->gc_lazy_sweep = enable ? 1 : 0;
+}
+
+void gc_incremental_start(ember_vm* vm) {
+    if (!vm || vm->gc_phase != GC_PHASE_IDLE) return;
+    vm->gc_phase = GC_PHASE_MARK;
+    vm->gc_step_bytes = 0;
+    vm->gc_step_requested = 1;
+    vm->gc_cycle_bytes = vm->bytes_allocated;
+    vm->gc_cycle_pause_us = 0;
+    vm->gc_cycle_freed = 0;
+    EMBER_PROBE1(gc__start, "incremental");
+    gc_gray_roots(vm);
+}
+
+void gc_incremental_allocated(ember_vm* vm, ember_object* object, size_t size) {
+    if (vm->gc_phase == GC_PHASE_IDLE) {
+        if (vm->bytes_allocated > vm->next_gc) {
+            gc_incremental_start(vm);
+        }
+        return;
+    }
+    if (vm->gc_phase == GC_PHASE_MARK) {
+        // Allocated black: nothing traced so far can have referenced it
+        object->is_marked = 1;
+        object->is_old = vm->gc_generational ? 1 : 0;
+    }
+    vm->gc_step_bytes += (int64_t)size;
+    if (vm->gc_step_bytes >= GC_STEP_BYTES) {
+        vm->gc_step_requested = 1;
+    }
+}
+
+// Trace everything left gray in one go
+static void drain_gray(ember_vm* vm) {
+    if (vm->gc_mark_threads > 1) {
+        gc_mark_parallel(vm);
+        return;
+    }
+    while (vm->gc_gray_count > 0) {
+        gc_trace_object(vm, vm->gc_gray[--vm->gc_gray_count]);
+    }
+}
+
+// Stores into the stack, locals and globals are not barriered, so marking
+// ends with one more pass over the roots
+static void finish_marking(ember_vm* vm) {
+    gc_gray_roots(vm);
+    drain_gray(vm);
+    gc_sweep_weak(vm, 0);
+    sweep_string_intern_table(vm);
+
+    // Every old object that survives is marked, and so is every young one
+    gc_clear_remembered_set(vm);
+    vm->gc_nursery_bytes = 0;
+    vm->gc_minor_requested = 0;
+
+    vm->gc_sweep_list = vm->objects;
+    vm->gc_sweep_survivors = NULL;
+    vm->gc_sweep_tail = &vm->gc_sweep_survivors;
+    vm->objects = NULL;
+    vm->gc_phase = GC_PHASE_SWEEP;
+}
+
+static void sweep_one(ember_vm* vm) {
+    ember_object* object = vm->gc_sweep_list;
+    vm->gc_sweep_list = object->next;
+    if (object->is_marked) {
+        object->is_marked = 0;
+        vm->gc_survivors[object->type]++;
+        object->next = NULL;
+        *vm->gc_sweep_tail = object;
+        vm->gc_sweep_tail = &object->next;
+    } else {
+        int64_t size = (int64_t)gc_free_object(vm, object);
+        vm->bytes_allocated -= size;
+        vm->gc_cycle_freed += size;
+    }
+}
+
+// Objects allocated while sweeping stay at the front, young
+static void splice_survivors(ember_vm* vm) {
+    ember_object** link = &vm->objects;
+    while (*link) {
+        link = &(*link)->next;
+    }
+    *link = vm->gc_sweep_survivors;
+    vm->gc_sweep_list = NULL;
+    vm->gc_sweep_survivors = NULL;
+    vm->gc_sweep_tail = &vm->gc_sweep_survivors;
+}
+
+static void finish_sweeping(ember_vm* vm) {
+    splice_survivors(vm);
+    object_slab_rebuild_free_lists(vm);
+    vm->gc_phase = GC_PHASE_IDLE;
+    vm->gc_step_requested = 0;
+    vm->gc_collections++;
+    EMBER_PROBE2(gc__done, "incremental", vm->gc_cycle_freed);
+}
+
+static void report_cycle(ember_vm* vm) {
+    gc_policy_collected(vm, vm->gc_cycle_bytes, vm->gc_cycle_pause_us);
+    gc_stats_collected(vm, EMBER_GC_INCREMENTAL, vm->gc_cycle_pause_us,
+                       vm->gc_cycle_bytes, vm->gc_cycle_freed);
+}
+
+// Run the cycle for up to budget_us, or to completion when budget_us is 0;
+// with mark_only, stop once it reaches the sweep phase
+static void run_cycle(ember_vm* vm, uint64_t budget_us, int mark_only) {
+    uint64_t start = gc_now_us();
+    int handled = 0;
+    int finished = 0;
+
+    while (vm->gc_phase != GC_PHASE_IDLE && !(mark_only && vm->gc_phase == GC_PHASE_SWEEP)) {
+        if (budget_us && ++handled % GC_STEP_CHECK_INTERVAL == 0 &&
+            gc_now_us() - start >= budget_us) {
+            break;
+        }
+        if (vm->gc_phase == GC_PHASE_MARK) {
+            if (!budget_us) {
+                drain_gray(vm);
+            }
+            if (vm->gc_gray_count > 0) {
+                gc_trace_object(vm, vm->gc_gray[--vm->gc_gray_count]);
+            } else {
+                finish_marking(vm);
+            }
+        } else if (vm->gc_sweep_list) {
+            sweep_one(vm);
+        } else {
+            finish_sweeping(vm);
+            finished = 1;
+        }
+    }
+
+    uint64_t elapsed = gc_now_us() - start;
+    if (elapsed > vm->gc_max_step_us) {
+        vm->gc_max_step_us = elapsed;
+    }
+    if (elapsed > vm->gc_cycle_pause_us) {
+        vm->gc_cycle_pause_us = elapsed;
+    }
+    if (budget_us) {
+        vm->gc_incremental_steps++;
+    }
+    gc_stats_pause(vm, elapsed);
+    if (finished) {
+        report_cycle(vm);
+    }
+}
+
+void gc_incremental_step(ember_vm* vm) {
+    if (!vm) return;
+    vm->gc_step_requested = 0;
+    vm->gc_step_bytes = 0;
+    if (vm->gc_phase == GC_PHASE_IDLE) return;
+
+    // A mutator that outruns the collector gets no budget: the heap would
+    // otherwise keep growing for as long as the cycle lasts
+    uint64_t budget = vm->bytes_allocated / 2 > vm->next_gc
+        ? 0 : (uint64_t)vm->gc_step_budget_us;
+    run_cycle(vm, budget, 0);
+}
+
+void gc_incremental_finish(ember_vm* vm) {
+    if (!vm || vm->gc_phase == GC_PHASE_IDLE) return;
+    run_cycle(vm, 0, 0);
+}
+
+static void start_unbudgeted(ember_vm* vm, ember_object* keep) {
+    // A cycle already under way started from older roots
+    gc_incremental_finish(vm);
+    gc_incremental_start(vm);
+    if (keep) {
+        // Black, not gray: its fields are not initialized yet
+        keep->is_marked = 1;
+        keep->is_old = vm->gc_generational ? 1 : 0;
+    }
+}
+
+void gc_collect_full(ember_vm* vm, ember_object* keep) {
+    if (!vm) return;
+    start_unbudgeted(vm, keep);
+    gc_incremental_finish(vm);
+}
+
+void gc_collect_lazy(ember_vm* vm, ember_object* keep) {
+    if (!vm) return;
+    start_unbudgeted(vm, keep);
+    run_cycle(vm, 0, 1);
+    // Allocation does the rest, not safe point steps
+    vm->gc_step_requested = 0;
+}
+
+void gc_sweep_allocated(ember_vm* vm) {
+    if (!vm || vm->gc_phase != GC_PHASE_SWEEP) return;
+    // As with steps, a mutator that outruns the sweep pays for all of it
+    int unbounded = vm->bytes_allocated / 2 > vm->next_gc;
+    int batch = GC_LAZY_SWEEP_OBJECTS;
+    while (vm->gc_sweep_list && (unbounded || batch-- > 0)) {
+        sweep_one(vm);
+    }
+    if (!vm->gc_sweep_list) {
+        finish_sweeping(vm);
+        report_cycle(vm);
+    }
+}
+
+void gc_incremental_abort(ember_vm* vm) {
+    if (!vm || vm->gc_phase == GC_PHASE_IDLE) return;
+    if (vm->gc_phase == GC_PHASE_SWEEP) {
+        *vm->gc_sweep_tail = vm->gc_sweep_list;
+        splice_survivors(vm);
+    }
+    for (ember_object* object = vm->objects; object; object = object->next) {
+        object->is_marked = 0;
+    }
+    vm->gc_gray_count = 0;
+    for (int i = 0; i < EMBER_GC_OBJECT_TYPES; i++) {
+        vm->gc_survivors[i] = 0;
+    }
+    vm->gc_phase = GC_PHASE_IDLE;
+    vm->gc_step_requested = 0;
+    EMBER_PROBE2(gc__done, "incremental", vm->gc_cycle_freed);
+}
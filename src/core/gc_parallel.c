@@ -0,0 +1,255 @@
+#define _GNU_SOURCE
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "gc_trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+// Parallel marking for full collections (ember_gc_set_mark_threads).
+//
+// The gray objects are dealt out to one work-stealing deque per marker.
+// Each marker traces from the bottom of its own deque and, once that runs
+// dry, steals from the top of the others (Chase-Lev, with the C11 orderings
+// of Le et al.). Mark bits are claimed with an atomic exchange, so every
+// object is traced exactly once. Objects are only read while marking, and
+// the mutator is stopped for the whole parallel section.
+
+#define GC_MARK_THREADS_MAX 64
+#define GC_MARK_DEQUE_INITIAL 1024
+
+typedef struct gc_mark_buffer {
+    int64_t capacity;                // Power of two
+    struct gc_mark_buffer* retired;  // Older, smaller buffers, freed after marking
+    ember_object* slots[];
+} gc_mark_buffer;
+
+struct gc_mark_worker {
+    int64_t top;                     // Stolen from by other markers
+    int64_t bottom;                  // Pushed and popped by the owner only
+    gc_mark_buffer* buffer;
+    ember_vm* vm;
+    struct gc_mark_worker* workers;
+    int worker_count;
+    int* idle_count;
+    pthread_t thread;
+    char padding[64];                // Keep neighbouring deques off one cache line
+};
+
+__thread gc_mark_worker* gc_mark_worker_self = NULL;
+
+static gc_mark_buffer* new_buffer(int64_t capacity) {
+    gc_mark_buffer* buffer = malloc(sizeof(gc_mark_buffer) + sizeof(ember_object*) * capacity);
+    if (!buffer) {
+        // Abandoning the trace would free live objects
+        fprintf(stderr, "[GC] Out of memory while marking in parallel\n");
+        abort();
+    }
+    buffer->capacity = capacity;
+    buffer->retired = NULL;
+    return buffer;
+}
+
+// Thieves may still read the old buffer, so it is only retired
+static gc_mark_buffer* grow_buffer(gc_mark_buffer* old, int64_t top, int64_t bottom) {
+    gc_mark_buffer* buffer = new_buffer(old->capacity * 2);
+    for (int64_t i = top; i < bottom; i++) {
+        ember_object* object = __atomic_load_n(&old->slots[i & (old->capacity - 1)], __ATOMIC_RELAXED);
+        __atomic_store_n(&buffer->slots[i & (buffer->capacity - 1)], object, __ATOMIC_RELAXED);
+    }
+    buffer->retired = old;
+    return buffer;
+}
+
+static void deque_push(gc_mark_worker* worker, ember_object* object) {
+    int64_t bottom = __atomic_load_n(&worker->bottom, __ATOMIC_RELAXED);
+    int64_t top = __atomic_load_n(&worker->top, __ATOMIC_ACQUIRE);
+    gc_mark_buffer* buffer = __atomic_load_n(&worker->buffer, __ATOMIC_RELAXED);
+    if (bottom - top > buffer->capacity - 1) {
+        buffer = grow_buffer(buffer, top, bottom);
+        __atomic_store_n(&worker->buffer, buffer, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&buffer->slots[bottom & (buffer->capacity - 1)], object, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+}
+
+static ember_object* deque_pop(gc_mark_worker* worker) {
+    int64_t bottom = __atomic_load_n(&worker->bottom, __ATOMIC_RELAXED) - 1;
+    gc_mark_buffer* buffer = __atomic_load_n(&worker->buffer, __ATOMIC_RELAXED);
+    __atomic_store_n(&worker->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&worker->top, __ATOMIC_RELAXED);
+
+    ember_object* object = NULL;
+    if (top <= bottom) {
+        object = __atomic_load_n(&buffer->slots[bottom & (buffer->capacity - 1)], __ATOMIC_RELAXED);
+        if (top == bottom) {
+            // Last entry: race the thieves for it
+            if (!__atomic_compare_exchange_n(&worker->top, &top, top + 1, 0,
+                                             __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                object = NULL;
+            }
+            __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+        }
+    } else {
+        __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+    return object;
+}
+
+static ember_object* deque_steal(gc_mark_worker* victim) {
+    int64_t top = __atomic_load_n(&victim->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t bottom = __atomic_load_n(&victim->bottom, __ATOMIC_ACQUIRE);
+    if (top >= bottom) return NULL;
+
+    gc_mark_buffer* buffer = __atomic_load_n(&victim->buffer, __ATOMIC_ACQUIRE);
+    ember_object* object = __atomic_load_n(&buffer->slots[top & (buffer->capacity - 1)], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&victim->top, &top, top + 1, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return NULL;
+    }
+    return object;
+}
+
+static int deque_is_empty(gc_mark_worker* worker) {
+    return __atomic_load_n(&worker->top, __ATOMIC_ACQUIRE) >=
+           __atomic_load_n(&worker->bottom, __ATOMIC_ACQUIRE);
+}
+
+void gc_parallel_gray(gc_mark_worker* worker, ember_object* object) {
+    if (__atomic_exchange_n(&object->is_marked, 1, __ATOMIC_RELAXED)) return;
+    if (worker->vm->gc_generational) {
+        object->is_old = 1;
+    }
+    deque_push(worker, object);
+}
+
+static ember_object* steal_work(gc_mark_worker* self) {
+    int count = self->worker_count;
+    int start = (int)(self - self->workers);
+    for (int i = 1; i < count; i++) {
+        ember_object* object = deque_steal(&self->workers[(start + i) % count]);
+        if (object) return object;
+    }
+    return NULL;
+}
+
+static int any_work_left(gc_mark_worker* self) {
+    for (int i = 0; i < self->worker_count; i++) {
+        if (!deque_is_empty(&self->workers[i])) return 1;
+    }
+    return 0;
+}
+
+// Finished once every marker is idle: an idle marker's own deque is empty
+// and only its owner ever pushes to it
+static void mark_until_done(gc_mark_worker* self) {
+    gc_mark_worker_self = self;
+    for (;;) {
+        ember_object* object = deque_pop(self);
+        if (!object) object = steal_work(self);
+        if (object) {
+            gc_trace_object(self->vm, object);
+            continue;
+        }
+
+        __atomic_add_fetch(self->idle_count, 1, __ATOMIC_SEQ_CST);
+        for (;;) {
+            if (__atomic_load_n(self->idle_count, __ATOMIC_SEQ_CST) == self->worker_count) {
+                gc_mark_worker_self = NULL;
+                return;
+            }
+            if (any_work_left(self)) {
+                __atomic_sub_fetch(self->idle_count, 1, __ATOMIC_SEQ_CST);
+                break;
+            }
+            sched_yield();
+        }
+    }
+}
+
+static void* marker_thread(void* arg) {
+    mark_until_done(arg);
+    return NULL;
+}
+
+void ember_gc_set_mark_threads(ember_vm* vm, int threads) {
+    if (!vm) return;
+    if (threads <= 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (int)online : 1;
+    }
+    if (threads > GC_MARK_THREADS_MAX) {
+        threads = GC_MARK_THREADS_MAX;
+    }
+    vm->gc_mark_threads = threads;
+}
+
+void gc_mark_parallel(ember_vm* vm) {
+    int count = vm->gc_mark_threads;
+    if (count > vm->gc_gray_count) count = vm->gc_gray_count;
+    if (count > GC_MARK_THREADS_MAX) count = GC_MARK_THREADS_MAX;
+    gc_mark_worker* workers = count > 1 ? calloc((size_t)count, sizeof(gc_mark_worker)) : NULL;
+    if (!workers) {
+        while (vm->gc_gray_count > 0) {
+            gc_trace_object(vm, vm->gc_gray[--vm->gc_gray_count]);
+        }
+        return;
+    }
+
+    int idle_count = 0;
+    for (int i = 0; i < count; i++) {
+        workers[i].buffer = new_buffer(GC_MARK_DEQUE_INITIAL);
+        workers[i].vm = vm;
+        workers[i].workers = workers;
+        workers[i].worker_count = count;
+        workers[i].idle_count = &idle_count;
+    }
+    // The gray objects are already marked; deal them out round-robin
+    for (int i = 0; i < vm->gc_gray_count; i++) {
+        deque_push(&workers[i % count], vm->gc_gray[i]);
+    }
+    vm->gc_gray_count = 0;
+
+    int started = 1;
+    for (; started < count; started++) {
+        if (pthread_create(&workers[started].thread, NULL, marker_thread, &workers[started]) != 0) {
+            fprintf(stderr, "[GC] Could not start marker thread, marking with %d\n", started);
+            break;
+        }
+    }
+    if (started < count) {
+        // Markers that never started still count toward the idle total
+        __atomic_add_fetch(&idle_count, count - started, __ATOMIC_SEQ_CST);
+    }
+    mark_until_done(&workers[0]);
+    for (int i = 1; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    // Work pushed to a deque whose marker never started
+    for (int i = started; i < count; i++) {
+        ember_object* object;
+        while ((object = deque_pop(&workers[i])) != NULL) {
+            gc_trace_object(vm, object);
+            while (vm->gc_gray_count > 0) {
+                gc_trace_object(vm, vm->gc_gray[--vm->gc_gray_count]);
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        gc_mark_buffer* buffer = workers[i].buffer;
+        while (buffer) {
+            gc_mark_buffer* retired = buffer->retired;
+            free(buffer);
+            buffer = retired;
+        }
+    }
+    free(workers);
+}
@@ -0,0 +1,143 @@
+#define _GNU_SOURCE
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "gc_trace.h"
+#include "probes.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+// When the next full collection starts (ember_gc_configure_policy).
+//
+// After every full collection next_gc is recomputed from what survived:
+//   growth    live bytes * gc_heap_growth, so the work per allocated byte
+//             stays constant however large the heap gets
+//   rate      with gc_min_interval_ms, at least that long at the smoothed
+//             allocation rate, so a fast allocator does not collect back to
+//             back while most of a large heap is live
+//   floor     never below gc_min_heap
+// A pause target (gc_max_pause_us) becomes the incremental step budget, and
+// a stop-the-world collection that overruns it switches the VM to
+// incremental collection.
+
+#define GC_HEAP_GROWTH_DEFAULT 2.0
+#define GC_MIN_HEAP_DEFAULT (1024 * 1024)
+#define GC_NEXT_GC_MAX (INT64_MAX / 2)
+
+uint64_t gc_now_us(void) {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        return 0;
+    }
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+void gc_policy_init(ember_vm* vm) {
+    if (!vm) return;
+    vm->gc_heap_growth = GC_HEAP_GROWTH_DEFAULT;
+    vm->gc_min_heap = GC_MIN_HEAP_DEFAULT;
+    vm->gc_min_interval_ms = 0;
+    vm->gc_max_pause_us = 0;
+    vm->gc_live_bytes = 0;
+    vm->gc_alloc_rate = 0.0;
+    vm->gc_last_full_us = 0;
+    vm->gc_last_pause_us = 0;
+    vm->gc_cycle_bytes = 0;
+    vm->gc_cycle_pause_us = 0;
+    vm->gc_cycle_freed = 0;
+}
+
+static int64_t next_threshold(ember_vm* vm, int64_t live_bytes) {
+    double growth = vm->gc_heap_growth > 1.0 ? vm->gc_heap_growth : GC_HEAP_GROWTH_DEFAULT;
+    double live = (double)live_bytes;
+    double target = live * growth;
+    if (vm->gc_min_interval_ms > 0 && vm->gc_alloc_rate > 0.0) {
+        double paced = live + vm->gc_alloc_rate * vm->gc_min_interval_ms;
+        if (paced > target) target = paced;
+    }
+    if (target < (double)vm->gc_min_heap) {
+        target = (double)vm->gc_min_heap;
+    }
+    if (target > (double)GC_NEXT_GC_MAX) {
+        return GC_NEXT_GC_MAX;
+    }
+    return (int64_t)target;
+}
+
+void gc_policy_collected(ember_vm* vm, int64_t bytes_before, uint64_t pause_us) {
+    if (!vm) return;
+    uint64_t now = gc_now_us();
+    int64_t allocated = bytes_before - vm->gc_live_bytes;
+    if (vm->gc_last_full_us && now > vm->gc_last_full_us && allocated > 0) {
+        // Bytes per millisecond since the previous full collection
+        double rate = (double)allocated * 1000.0 / (double)(now - vm->gc_last_full_us);
+        vm->gc_alloc_rate = vm->gc_alloc_rate > 0.0 ? (vm->gc_alloc_rate + rate) / 2.0 : rate;
+    }
+    vm->gc_last_full_us = now;
+    vm->gc_live_bytes = vm->bytes_allocated;
+    vm->gc_last_pause_us = pause_us;
+    vm->next_gc = next_threshold(vm, vm->bytes_allocated);
+
+    if (vm->gc_max_pause_us > 0 && !vm->gc_incremental && pause_us > (uint64_t)vm->gc_max_pause_us) {
+        // The collections of a heap this size no longer fit in one pause
+        gc_incremental_configure(vm, 1);
+        vm->gc_step_budget_us = vm->gc_max_pause_us;
+    }
+}
+
+void gc_collect_triggered(ember_vm* vm, ember_object* keep) {
+    if (!vm) return;
+    if (vm->gc_lazy_sweep) {
+        // Only marking pauses (with vm->gc_mark_threads); allocation sweeps,
+        // and the cycle reports once the last object is swept
+        gc_collect_lazy(vm, keep);
+        return;
+    }
+    if (vm->gc_mark_threads > 1) {
+        // Cycles report to the policy themselves
+        gc_collect_full(vm, keep);
+        return;
+    }
+    int64_t bytes_before = vm->bytes_allocated;
+    uint64_t start = gc_now_us();
+    EMBER_PROBE1(gc__start, "full");
+    collect_garbage(vm);
+    gc_promote_survivors(vm);
+    EMBER_PROBE2(gc__done, "full", bytes_before - vm->bytes_allocated);
+    uint64_t pause = gc_now_us() - start;
+    gc_policy_collected(vm, bytes_before, pause);
+    // collect_garbage sweeps on its own; count what it kept afterwards
+    gc_stats_census(vm);
+    gc_stats_pause(vm, pause);
+    gc_stats_collected(vm, EMBER_GC_FULL, pause, bytes_before, bytes_before - vm->bytes_allocated);
+}
+
+void ember_gc_configure_policy(ember_vm* vm, const ember_gc_policy* policy) {
+    if (!vm || !policy) return;
+    if (policy->heap_growth <= 1.0 || policy->min_heap_bytes < 0 ||
+        policy->min_interval_ms < 0 || policy->max_pause_us < 0) {
+        fprintf(stderr, "[GC] Invalid collection policy (growth %.2f, min heap %lld, interval %d ms, pause %d us)\n",
+                policy->heap_growth, (long long)policy->min_heap_bytes,
+                policy->min_interval_ms, policy->max_pause_us);
+        return;
+    }
+    vm->gc_heap_growth = policy->heap_growth;
+    vm->gc_min_heap = policy->min_heap_bytes;
+    vm->gc_min_interval_ms = policy->min_interval_ms;
+    vm->gc_max_pause_us = policy->max_pause_us;
+    if (vm->gc_max_pause_us > 0) {
+        vm->gc_step_budget_us = vm->gc_max_pause_us;
+    }
+    if (vm->gc_phase == GC_PHASE_IDLE && vm->gc_last_full_us) {
+        // Apply the new policy to what the last collection left
+        vm->next_gc = next_threshold(vm, vm->gc_live_bytes);
+    }
+}
+
+void ember_gc_get_policy(ember_vm* vm, ember_gc_policy* policy) {
+    if (!vm || !policy) return;
+    policy->heap_growth = vm->gc_heap_growth > 1.0 ? vm->gc_heap_growth : GC_HEAP_GROWTH_DEFAULT;
+    policy->min_heap_bytes = vm->gc_min_heap;
+    policy->min_interval_ms = vm->gc_min_interval_ms;
+    policy->max_pause_us = vm->gc_max_pause_us;
+}
@@ -0,0 +1,60 @@
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "../runtime/value/value.h"
+#include <stdlib.h>
+
+// Object pooling, enabled with gc_configure(vm, ..., enable_object_pooling).
+// Fixed-size headers of the types created on every iteration or method
+// call are kept on per-type free lists when a collection frees them, and
+// allocate_object hands them out again before calling malloc. Each list is
+// capped so a burst of garbage does not stay reserved forever.
+
+#define GC_POOL_MAX_OBJECTS 256
+
+static int pool_index(ember_object_type type, size_t* size) {
+    switch (type) {
+        case OBJ_ITERATOR: *size = sizeof(ember_iterator); return 0;
+        case OBJ_METHOD:   *size = sizeof(ember_bound_method); return 1;
+        case OBJ_PROMISE:  *size = sizeof(ember_promise); return 2;
+        case OBJ_ARRAY:    *size = sizeof(ember_array); return 3;
+        default:           return -1;
+    }
+}
+
+ember_object* gc_pool_take(ember_vm* vm, ember_object_type type, size_t size) {
+    size_t pooled_size;
+    int index = pool_index(type, &pooled_size);
+    if (index < 0 || size != pooled_size) return NULL;
+
+    ember_object* object = vm->gc_pool_free[index];
+    if (!object) return NULL;
+    vm->gc_pool_free[index] = object->next;
+    vm->gc_pool_count[index]--;
+    vm->gc_pool_hits++;
+    return object;
+}
+
+int gc_pool_recycle(ember_vm* vm, ember_object* object) {
+    size_t pooled_size;
+    int index = pool_index(object->type, &pooled_size);
+    if (!vm->gc_object_pooling || index < 0 || vm->gc_pool_count[index] >= GC_POOL_MAX_OBJECTS) {
+        return 0;
+    }
+    object->next = vm->gc_pool_free[index];
+    vm->gc_pool_free[index] = object;
+    vm->gc_pool_count[index]++;
+    return 1;
+}
+
+void gc_pool_drain(ember_vm* vm) {
+    for (int i = 0; i < EMBER_POOLED_TYPES; i++) {
+        ember_object* object = vm->gc_pool_free[i];
+        while (object) {
+            ember_object* next = object->next;
+            free_object_storage(object);
+            object = next;
+        }
+        vm->gc_pool_free[i] = NULL;
+        vm->gc_pool_count[i] = 0;
+    }
+}
@@ -0,0 +1,273 @@
+#include "../../include/ember.h"
+#include "../vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// GC telemetry (ember_gc_get_stats). The collectors report here:
+//   pauses      every stop-the-world collection, minor collection and
+//               incremental step, into a log2 histogram of microseconds
+//   collections bytes allocated since the previous one, bytes freed and
+//               kept, and how many objects survived, into a ring of the
+//               last EMBER_GC_HISTORY
+//   survivors   counted by type in vm->gc_survivors while sweeping, and
+//               kept for the last collection
+// With ember_gc_sample_allocations(vm, n), allocate_object also records
+// the instruction that made every nth object, so heap growth can be traced
+// back to the code behind it.
+
+#define ALLOC_SITES_INITIAL 64
+
+typedef struct {
+    ember_chunk* chunk;
+    int offset;
+    int line;                    // Looked up when first sampled: the chunk may go
+    ember_object_type type;
+    uint64_t samples;
+    int64_t bytes;
+} alloc_site;
+
+typedef struct ember_gc_telemetry {
+    ember_gc_stats stats;
+    int history_next;            // Ring slot the next collection goes to
+    int64_t bytes_mark;          // bytes_allocated after the previous collection
+    alloc_site* sites;           // Open addressing on (chunk, offset, type)
+    int site_count;
+    int site_capacity;
+} ember_gc_telemetry;
+
+static ember_gc_telemetry* telemetry(ember_vm* vm) {
+    if (!vm->gc_telemetry) {
+        vm->gc_telemetry = calloc(1, sizeof(ember_gc_telemetry));
+        if (vm->gc_telemetry) vm->gc_telemetry->bytes_mark = vm->bytes_allocated;
+    }
+    return vm->gc_telemetry;
+}
+
+void gc_stats_free(ember_vm* vm) {
+    if (!vm || !vm->gc_telemetry) return;
+    free(vm->gc_telemetry->sites);
+    free(vm->gc_telemetry);
+    vm->gc_telemetry = NULL;
+    vm->gc_alloc_sample_every = 0;
+    vm->gc_alloc_sample_countdown = 0;
+}
+
+// ============================================================================
+// PAUSES AND COLLECTIONS
+// ============================================================================
+
+static int pause_bucket(uint64_t pause_us) {
+    int bucket = 0;
+    while (pause_us && bucket < EMBER_GC_PAUSE_BUCKETS - 1) {
+        pause_us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void gc_stats_pause(ember_vm* vm, uint64_t pause_us) {
+    ember_gc_telemetry* t = telemetry(vm);
+    if (!t) return;
+    t->stats.pauses[pause_bucket(pause_us)]++;
+    t->stats.pause_count++;
+    t->stats.total_pause_us += pause_us;
+    if (pause_us > t->stats.max_pause_us) {
+        t->stats.max_pause_us = pause_us;
+    }
+}
+
+void gc_stats_collected(ember_vm* vm, ember_gc_kind kind, uint64_t pause_us,
+                        int64_t bytes_before, int64_t bytes_freed) {
+    ember_gc_telemetry* t = telemetry(vm);
+    if (!t) {
+        memset(vm->gc_survivors, 0, sizeof(vm->gc_survivors));
+        return;
+    }
+    ember_gc_collection* record = &t->stats.history[t->history_next];
+    record->kind = kind;
+    record->pause_us = pause_us;
+    record->bytes_allocated = bytes_before > t->bytes_mark ? bytes_before - t->bytes_mark : 0;
+    record->bytes_freed = bytes_freed;
+    record->bytes_live = vm->bytes_allocated;
+    record->survivors = 0;
+    for (int i = 0; i < EMBER_GC_OBJECT_TYPES; i++) {
+        record->survivors += vm->gc_survivors[i];
+    }
+    t->history_next = (t->history_next + 1) % EMBER_GC_HISTORY;
+    if (t->stats.history_count < EMBER_GC_HISTORY) {
+        t->stats.history_count++;
+    }
+
+    t->stats.collections++;
+    t->stats.total_allocated += record->bytes_allocated;
+    t->stats.total_freed += bytes_freed;
+    t->stats.survivors_kind = kind;
+    memcpy(t->stats.survivors_by_type, vm->gc_survivors, sizeof(vm->gc_survivors));
+    memset(vm->gc_survivors, 0, sizeof(vm->gc_survivors));
+    t->bytes_mark = vm->bytes_allocated;
+}
+
+void gc_stats_census(ember_vm* vm) {
+    for (ember_object* object = vm->objects; object; object = object->next) {
+        vm->gc_survivors[object->type]++;
+    }
+}
+
+int ember_gc_get_stats(ember_vm* vm, ember_gc_stats* stats) {
+    if (!vm || !stats) return EMBER_ERROR_INVALID_PARAMETER;
+    memset(stats, 0, sizeof(*stats));
+    ember_gc_telemetry* t = vm->gc_telemetry;
+    if (!t) return EMBER_SUCCESS;
+    *stats = t->stats;
+    // Oldest first
+    int first = t->stats.history_count < EMBER_GC_HISTORY ? 0 : t->history_next;
+    for (int i = 0; i < t->stats.history_count; i++) {
+        stats->history[i] = t->stats.history[(first + i) % EMBER_GC_HISTORY];
+    }
+    return EMBER_SUCCESS;
+}
+
+void ember_gc_reset_stats(ember_vm* vm) {
+    if (!vm || !vm->gc_telemetry) return;
+    ember_gc_telemetry* t = vm->gc_telemetry;
+    memset(&t->stats, 0, sizeof(t->stats));
+    t->history_next = 0;
+    t->bytes_mark = vm->bytes_allocated;
+    if (t->sites) memset(t->sites, 0, (size_t)t->site_capacity * sizeof(alloc_site));
+    t->site_count = 0;
+}
+
+const char* ember_gc_object_type_name(ember_object_type type) {
+    switch (type) {
+        case OBJ_STRING:    return "string";
+        case OBJ_ARRAY:     return "array";
+        case OBJ_HASH_MAP:  return "hash_map";
+        case OBJ_EXCEPTION: return "exception";
+        case OBJ_CLASS:     return "class";
+        case OBJ_INSTANCE:  return "instance";
+        case OBJ_METHOD:    return "bound_method";
+        case OBJ_PROMISE:   return "promise";
+        case OBJ_GENERATOR: return "generator";
+        case OBJ_SET:       return "set";
+        case OBJ_MAP:       return "map";
+        case OBJ_REGEX:     return "regex";
+        case OBJ_ITERATOR:  return "iterator";
+        case OBJ_STRING_BUILDER: return "string_builder";
+        case OBJ_HASHER:    return "hasher";
+        case OBJ_FILE:      return "file";
+        case OBJ_WALKER:    return "walker";
+        case OBJ_TYPED_ARRAY: return "typed_array";
+        case OBJ_CACHE:     return "cache";
+        case OBJ_DEQUE:     return "deque";
+        case OBJ_PRIORITY_QUEUE: return "priority_queue";
+        case OBJ_WEAK_REF:  return "weak_ref";
+        case OBJ_WEAK_MAP:  return "weak_map";
+        case OBJ_FUNCTION:  return "function";
+    }
+    return "unknown";
+}
+
+// ============================================================================
+// ALLOCATION SITES
+// ============================================================================
+
+static uint32_t site_hash(const ember_chunk* chunk, int offset, ember_object_type type) {
+    uint64_t key = (uint64_t)(uintptr_t)chunk ^ ((uint64_t)(uint32_t)offset << 4) ^ (uint64_t)type;
+    key *= 0x9e3779b97f4a7c15ULL;
+    return (uint32_t)(key >> 32);
+}
+
+static alloc_site* find_site(ember_gc_telemetry* t, ember_chunk* chunk, int offset, ember_object_type type) {
+    uint32_t mask = (uint32_t)t->site_capacity - 1;
+    uint32_t index = site_hash(chunk, offset, type) & mask;
+    for (;;) {
+        alloc_site* site = &t->sites[index];
+        if (!site->samples || (site->chunk == chunk && site->offset == offset && site->type == type)) {
+            return site;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+static int grow_sites(ember_gc_telemetry* t) {
+    int capacity = t->site_capacity ? t->site_capacity * 2 : ALLOC_SITES_INITIAL;
+    alloc_site* old = t->sites;
+    int old_capacity = t->site_capacity;
+    t->sites = calloc((size_t)capacity, sizeof(alloc_site));
+    if (!t->sites) {
+        t->sites = old;
+        return 0;
+    }
+    t->site_capacity = capacity;
+    for (int i = 0; i < old_capacity; i++) {
+        if (old[i].samples) {
+            *find_site(t, old[i].chunk, old[i].offset, old[i].type) = old[i];
+        }
+    }
+    free(old);
+    return 1;
+}
+
+void gc_stats_sample_allocation(ember_vm* vm, ember_object_type type, size_t size) {
+    vm->gc_alloc_sample_countdown = vm->gc_alloc_sample_every;
+    ember_gc_telemetry* t = telemetry(vm);
+    if (!t) return;
+    // Keep the table at most half full
+    if (t->site_count * 2 >= t->site_capacity && !grow_sites(t)) return;
+
+    // ip is past the instruction being run; natives see their call site
+    ember_chunk* chunk = vm->chunk;
+    int offset = chunk && vm->ip > chunk->code ? (int)(vm->ip - chunk->code) - 1 : 0;
+    alloc_site* site = find_site(t, chunk, offset, type);
+    if (!site->samples) {
+        site->chunk = chunk;
+        site->offset = offset;
+        site->line = chunk ? ember_chunk_line_at(chunk, offset) : 0;
+        site->type = type;
+        t->site_count++;
+    }
+    site->samples++;
+    site->bytes += (int64_t)size;
+}
+
+int ember_gc_sample_allocations(ember_vm* vm, int every) {
+    if (!vm || every < 0) return EMBER_ERROR_INVALID_PARAMETER;
+    vm->gc_alloc_sample_every = every;
+    vm->gc_alloc_sample_countdown = every;
+    return EMBER_SUCCESS;
+}
+
+static int compare_sites(const void* a, const void* b) {
+    const ember_gc_alloc_site* left = a;
+    const ember_gc_alloc_site* right = b;
+    if (left->bytes != right->bytes) return left->bytes < right->bytes ? 1 : -1;
+    return left->samples < right->samples ? 1 : left->samples > right->samples ? -1 : 0;
+}
+
+int ember_gc_get_allocation_sites(ember_vm* vm, ember_gc_alloc_site* sites, int max) {
+    if (!vm || max < 0 || (max > 0 && !sites)) return EMBER_ERROR_INVALID_PARAMETER;
+    ember_gc_telemetry* t = vm->gc_telemetry;
+    if (!t || !t->site_count) return 0;
+
+    ember_gc_alloc_site* all = malloc((size_t)t->site_count * sizeof(ember_gc_alloc_site));
+    if (!all) return EMBER_ERROR_MEMORY_ALLOCATION;
+    int count = 0;
+    for (int i = 0; i < t->site_capacity; i++) {
+        const alloc_site* site = &t->sites[i];
+        if (!site->samples) continue;
+        all[count].chunk = site->chunk;
+        all[count].offset = site->offset;
+        all[count].line = site->line;
+        all[count].type = site->type;
+        all[count].samples = site->samples;
+        all[count].bytes = site->bytes;
+        count++;
+    }
+    qsort(all, (size_t)count, sizeof(ember_gc_alloc_site), compare_sites);
+    if (max > 0) {
+        memcpy(sites, all, (size_t)(count < max ? count : max) * sizeof(ember_gc_alloc_site));
+    }
+    free(all);
+    return count;
+}
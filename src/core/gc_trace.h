@@ -0,0 +1,48 @@
+#ifndef EMBER_GC_TRACE_H
+#define EMBER_GC_TRACE_H
+
+#include "../../include/ember.h"
+#include <stddef.h>
+
+// Marking shared by minor collections (gc_generational.c) and incremental
+// cycles (gc_incremental.c). Both keep their gray objects on vm->gc_gray;
+// outside an incremental cycle graying stops at old objects.
+
+#define GC_PHASE_IDLE  0   // No incremental cycle in progress
+#define GC_PHASE_MARK  1   // Tracing from the roots a step at a time
+#define GC_PHASE_SWEEP 2   // Freeing the unmarked objects of the cycle
+
+// The heap object a value refers to, or NULL for immediates and functions
+ember_object* gc_value_object(ember_value value);
+void gc_gray_object(ember_vm* vm, ember_object* object);
+void gc_gray_value(ember_vm* vm, ember_value value);
+void gc_gray_roots(ember_vm* vm);
+// Gray everything object references directly
+void gc_trace_object(ember_vm* vm, ember_object* object);
+// Release an unlinked object (its header may go to the object pool),
+// returning the bytes it counted against the heap
+size_t gc_free_object(ember_vm* vm, ember_object* object);
+void gc_clear_remembered_set(ember_vm* vm);
+
+// Parallel marking (gc_parallel.c). While a marker thread traces,
+// gc_gray_object claims mark bits atomically and pushes to its deque
+typedef struct gc_mark_worker gc_mark_worker;
+extern __thread gc_mark_worker* gc_mark_worker_self;
+void gc_parallel_gray(gc_mark_worker* worker, ember_object* object);
+// Drain vm->gc_gray using vm->gc_mark_threads markers
+void gc_mark_parallel(ember_vm* vm);
+
+// Heap snapshots (heap_snapshot.c). While a visitor is set, gc_gray_object
+// reports each reference to it and marks nothing, and gc_gray_roots leaves
+// out the remembered set
+typedef struct gc_edge_visitor {
+    void (*visit)(struct gc_edge_visitor* visitor, ember_object* object);
+} gc_edge_visitor;
+extern __thread gc_edge_visitor* gc_edge_visitor_self;
+
+void gc_incremental_init(ember_vm* vm);
+void gc_incremental_configure(ember_vm* vm, int enable);
+// Give the objects of an unfinished cycle back to vm->objects without freeing
+void gc_incremental_abort(ember_vm* vm);
+
+#endif // EMBER_GC_TRACE_H
@@ -0,0 +1,432 @@
+#define _GNU_SOURCE
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "../runtime/value/value.h"
+#include "gc_trace.h"
+#include "object_shape.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// What fills a VM's heap (ember_vm_heap_histogram) and who holds it
+// (ember_vm_write_heap_snapshot).
+//
+// The histogram walks vm->objects. A snapshot also finds every reference
+// the collector would follow by running the tracer itself: while
+// gc_edge_visitor_self is set, gc_gray_object hands each object to the
+// visitor instead of marking it, so the edges are exactly what keeps an
+// object alive. It is written in the .heapsnapshot format of V8, which the
+// Memory panel of Chrome DevTools and other heap analysis tools read.
+// Node ids are derived from addresses; objects never move, so comparing
+// two snapshots of one VM shows which objects are new.
+//
+// Both finish a collection cycle that is under way first: until then the
+// objects being swept are not on vm->objects.
+
+#define SNAPSHOT_NODE_FIELDS 6
+#define SNAPSHOT_EDGE_FIELDS 3
+#define SNAPSHOT_NAME_MAX 256       // Bytes of a string's contents that name its node
+
+// Node types, indices into the first entry of meta.node_types
+enum { NODE_STRING = 2, NODE_OBJECT = 3, NODE_CLOSURE = 5, NODE_REGEXP = 6, NODE_SYNTHETIC = 9,
+       NODE_CONCATENATED = 10, NODE_SLICED = 11 };
+#define EDGE_ELEMENT 1
+
+__thread gc_edge_visitor* gc_edge_visitor_self = NULL;
+
+// Bytes an object keeps in use: its header as bytes_allocated counts it,
+// and the buffers only it points to
+static size_t object_size(const ember_object* object) {
+    switch (object->type) {
+        case OBJ_STRING: {
+            const ember_string* string = (const ember_string*)object;
+            if (string->is_external) return EMBER_STRING_EXTERNAL_SIZE;
+            // Slices share their parent's bytes and mapped files belong to
+            // the page cache
+            int owns_chars = string->chars && !string->is_mapped;
+            return sizeof(ember_string) + (owns_chars ? (size_t)string->length + 1 : 0);
+        }
+        case OBJ_ARRAY:
+            return sizeof(ember_array) + (size_t)((const ember_array*)object)->capacity * sizeof(ember_value);
+        case OBJ_HASH_MAP: {
+            const ember_hash_map* map = (const ember_hash_map*)object;
+            return sizeof(ember_hash_map) +
+                   (map->entries ? (size_t)map->capacity * (sizeof(ember_hash_entry) + 1) : 0);
+        }
+        case OBJ_MAP: {
+            const ember_map* map = (const ember_map*)object;
+            return sizeof(ember_map) + (size_t)map->capacity * sizeof(ember_hash_entry) +
+                   (size_t)map->index_capacity * sizeof(int32_t);
+        }
+        case OBJ_INSTANCE: {
+            const ember_instance* instance = (const ember_instance*)object;
+            size_t size = instance_object_size(instance->inline_capacity);
+            if (instance->slots != instance->inline_slots) {
+                size += (size_t)instance->slot_capacity * sizeof(ember_value);
+            }
+            return size;
+        }
+        case OBJ_GENERATOR: {
+            const ember_generator* generator = (const ember_generator*)object;
+            return sizeof(ember_generator) + (size_t)generator->frame_capacity * sizeof(ember_value);
+        }
+        case OBJ_STRING_BUILDER:
+            return sizeof(ember_string_builder) + ((const ember_string_builder*)object)->capacity;
+        case OBJ_TYPED_ARRAY: {
+            const ember_typed_array* array = (const ember_typed_array*)object;
+            size_t element = array->kind == EMBER_TYPED_FLOAT64 ? 8 : array->kind == EMBER_TYPED_INT32 ? 4 : 1;
+            return sizeof(ember_typed_array) + (size_t)array->length * element;
+        }
+        case OBJ_CACHE: {
+            const ember_cache* cache = (const ember_cache*)object;
+            return sizeof(ember_cache) + (size_t)cache->bucket_count * sizeof(ember_cache_entry*) +
+                   (size_t)cache->size * sizeof(ember_cache_entry);
+        }
+        case OBJ_DEQUE:
+            return sizeof(ember_deque) + (size_t)((const ember_deque*)object)->capacity * sizeof(ember_value);
+        case OBJ_PRIORITY_QUEUE:
+            return sizeof(ember_priority_queue) +
+                   (size_t)((const ember_priority_queue*)object)->capacity * sizeof(ember_heap_item);
+        case OBJ_WEAK_MAP:
+            return sizeof(ember_weak_map) +
+                   (size_t)((const ember_weak_map*)object)->capacity * sizeof(ember_weak_entry);
+        case OBJ_WEAK_REF: return sizeof(ember_weak_ref);
+        case OBJ_EXCEPTION: return sizeof(ember_exception);
+        case OBJ_CLASS: return sizeof(ember_class);
+        case OBJ_METHOD: return sizeof(ember_bound_method);
+        case OBJ_PROMISE: return sizeof(ember_promise);
+        case OBJ_SET: return sizeof(ember_set);
+        case OBJ_REGEX: return sizeof(ember_regex);
+        case OBJ_ITERATOR: return sizeof(ember_iterator);
+        case OBJ_HASHER: return sizeof(ember_hasher);
+        case OBJ_FILE: return sizeof(ember_file);
+        case OBJ_WALKER: return sizeof(ember_walker);
+        case OBJ_FUNCTION: return sizeof(ember_function);
+    }
+    return sizeof(ember_object);
+}
+
+int ember_vm_heap_histogram(ember_vm* vm, ember_heap_histogram* histogram) {
+    if (!vm || !histogram) return EMBER_ERROR_INVALID_PARAMETER;
+    memset(histogram, 0, sizeof(*histogram));
+    gc_incremental_finish(vm);
+    for (ember_object* object = vm->objects; object; object = object->next) {
+        size_t size = object_size(object);
+        histogram->count[object->type]++;
+        histogram->bytes[object->type] += size;
+        histogram->total_count++;
+        histogram->total_bytes += size;
+    }
+    return EMBER_SUCCESS;
+}
+
+static FILE* open_output(const char* path, FILE* fallback) {
+    if (!path || strcmp(path, "-") == 0) return fallback;
+    FILE* out = fopen(path, "w");
+    if (!out) fprintf(stderr, "[HEAP] Cannot write %s\n", path);
+    return out;
+}
+
+static int close_output(FILE* out, FILE* fallback) {
+    if (out == fallback) return fflush(out) == 0 && !ferror(out);
+    int failed = ferror(out);
+    return fclose(out) == 0 && !failed;
+}
+
+int ember_vm_write_heap_histogram(ember_vm* vm, const char* path) {
+    ember_heap_histogram histogram;
+    if (ember_vm_heap_histogram(vm, &histogram) != EMBER_SUCCESS) return EMBER_ERROR_INVALID_PARAMETER;
+    FILE* out = open_output(path, stderr);
+    if (!out) return EMBER_ERROR_OPERATION_FAILED;
+
+    // Largest share first
+    int order[EMBER_GC_OBJECT_TYPES];
+    int used = 0;
+    for (int type = 0; type < EMBER_GC_OBJECT_TYPES; type++) {
+        if (!histogram.count[type]) continue;
+        int at = used++;
+        while (at > 0 && histogram.bytes[order[at - 1]] < histogram.bytes[type]) {
+            order[at] = order[at - 1];
+            at--;
+        }
+        order[at] = type;
+    }
+    fprintf(out, "Ember heap: %llu objects, %llu bytes\n\n",
+            (unsigned long long)histogram.total_count, (unsigned long long)histogram.total_bytes);
+    fprintf(out, "%-16s %12s %14s %7s %10s\n", "type", "objects", "bytes", "%", "bytes/obj");
+    for (int i = 0; i < used; i++) {
+        int type = order[i];
+        fprintf(out, "%-16s %12llu %14llu %6.1f%% %10.1f\n", ember_gc_object_type_name((ember_object_type)type),
+                (unsigned long long)histogram.count[type], (unsigned long long)histogram.bytes[type],
+                100.0 * (double)histogram.bytes[type] / (double)histogram.total_bytes,
+                (double)histogram.bytes[type] / (double)histogram.count[type]);
+    }
+    return close_output(out, stderr) ? EMBER_SUCCESS : EMBER_ERROR_OPERATION_FAILED;
+}
+
+// ============================================================================
+// SNAPSHOTS
+// ============================================================================
+
+// Object -> value, sized once for a known number of keys
+typedef struct {
+    ember_object** keys;
+    uint32_t* values;
+    uint32_t mask;
+} object_table;
+
+static inline uint32_t object_hash(const ember_object* object) {
+    uint64_t h = (uint64_t)(uintptr_t)object;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (uint32_t)h;
+}
+
+static int table_init(object_table* table, size_t count) {
+    size_t capacity = 16;
+    while (capacity < count * 2) capacity *= 2;
+    table->keys = calloc(capacity, sizeof(ember_object*));
+    table->values = malloc(capacity * sizeof(uint32_t));
+    table->mask = (uint32_t)(capacity - 1);
+    return table->keys && table->values;
+}
+
+static void table_free(object_table* table) {
+    free(table->keys);
+    free(table->values);
+}
+
+static uint32_t* table_slot(object_table* table, ember_object* key, int insert) {
+    for (uint32_t slot = object_hash(key) & table->mask;; slot = (slot + 1) & table->mask) {
+        if (table->keys[slot] == key) return &table->values[slot];
+        if (!table->keys[slot]) {
+            if (!insert) return NULL;
+            table->keys[slot] = key;
+            return &table->values[slot];
+        }
+    }
+}
+
+typedef struct {
+    const char* chars;
+    size_t length;
+} snapshot_string;
+
+typedef struct {
+    gc_edge_visitor visitor;       // First, so the callback gets the snapshot
+    FILE* out;
+    object_table nodes;            // Object -> node index
+    object_table class_names;      // Class -> string index
+    uint32_t* edge_counts;         // Per node
+    uint32_t edges;                // Of the node being traced
+    uint64_t edge_total;
+    int writing;                   // Second trace: write the edges
+    int first_edge;
+    snapshot_string* strings;
+    uint32_t string_count;
+    uint32_t string_capacity;
+    int failed;
+} heap_snapshot;
+
+static uint32_t add_string(heap_snapshot* snapshot, const char* chars, size_t length) {
+    if (snapshot->string_count == snapshot->string_capacity) {
+        uint32_t capacity = snapshot->string_capacity ? snapshot->string_capacity * 2 : 256;
+        snapshot_string* strings = realloc(snapshot->strings, capacity * sizeof(snapshot_string));
+        if (!strings) {
+            snapshot->failed = 1;
+            return 0;
+        }
+        snapshot->strings = strings;
+        snapshot->string_capacity = capacity;
+    }
+    snapshot->strings[snapshot->string_count].chars = chars;
+    snapshot->strings[snapshot->string_count].length = length;
+    return snapshot->string_count++;
+}
+
+static void visit_edge(gc_edge_visitor* visitor, ember_object* object) {
+    heap_snapshot* snapshot = (heap_snapshot*)visitor;
+    // Only objects on vm->objects are nodes
+    uint32_t* node = table_slot(&snapshot->nodes, object, 0);
+    if (!node) return;
+    if (snapshot->writing) {
+        fprintf(snapshot->out, "%s%d,%u,%u", snapshot->first_edge ? "" : ",\n", EDGE_ELEMENT,
+                snapshot->edges, *node * SNAPSHOT_NODE_FIELDS);
+        snapshot->first_edge = 0;
+    }
+    snapshot->edges++;
+}
+
+// Trace the roots for node 0 and each object for the node after it
+static void trace_edges(ember_vm* vm, heap_snapshot* snapshot) {
+    gc_edge_visitor_self = &snapshot->visitor;
+    snapshot->edges = 0;
+    gc_gray_roots(vm);
+    snapshot->edge_counts[0] = snapshot->edges;
+    uint32_t index = 1;
+    for (ember_object* object = vm->objects; object; object = object->next, index++) {
+        snapshot->edges = 0;
+        gc_trace_object(vm, object);
+        snapshot->edge_counts[index] = snapshot->edges;
+    }
+    gc_edge_visitor_self = NULL;
+}
+
+static uint32_t class_name(heap_snapshot* snapshot, ember_class* klass) {
+    uint32_t* name = table_slot(&snapshot->class_names, (ember_object*)klass, 1);
+    if (name && *name) return *name;
+    const char* chars = klass->name ? ember_string_bytes(klass->name) : NULL;
+    uint32_t index = chars ? add_string(snapshot, chars, (size_t)klass->name->length)
+                           : add_string(snapshot, "(anonymous class)", 17);
+    if (name) *name = index;
+    return index;
+}
+
+// The V8 type and name of an object's node
+static uint32_t node_name(heap_snapshot* snapshot, ember_object* object, int* type) {
+    *type = NODE_OBJECT;
+    switch (object->type) {
+        case OBJ_STRING: {
+            ember_string* string = (ember_string*)object;
+            *type = string->chars ? NODE_STRING : string->right ? NODE_CONCATENATED : NODE_SLICED;
+            const char* bytes = ember_string_bytes(string);
+            if (!bytes) return 0;
+            size_t length = (size_t)string->length;
+            if (length > SNAPSHOT_NAME_MAX) {
+                // Cut before a UTF-8 continuation byte
+                length = SNAPSHOT_NAME_MAX;
+                while (length > 0 && ((unsigned char)bytes[length] & 0xC0) == 0x80) length--;
+            }
+            return add_string(snapshot, bytes, length);
+        }
+        case OBJ_INSTANCE: {
+            ember_class* klass = ((ember_instance*)object)->klass;
+            if (klass) return class_name(snapshot, klass);
+            break;
+        }
+        case OBJ_CLASS:
+            return class_name(snapshot, (ember_class*)object);
+        case OBJ_FUNCTION: {
+            *type = NODE_CLOSURE;
+            const char* name = ((ember_function*)object)->name;
+            if (name) return add_string(snapshot, name, strlen(name));
+            break;
+        }
+        case OBJ_REGEX: {
+            *type = NODE_REGEXP;
+            const char* pattern = ((ember_regex*)object)->pattern;
+            if (pattern) return add_string(snapshot, pattern, strlen(pattern));
+            break;
+        }
+        default:
+            break;
+    }
+    const char* name = ember_gc_object_type_name(object->type);
+    return add_string(snapshot, name, strlen(name));
+}
+
+static void write_json_string(FILE* out, const char* chars, size_t length) {
+    fputc('"', out);
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)chars[i];
+        if (c == '"' || c == '\\') {
+            fputc('\\', out);
+            fputc(c, out);
+        } else if (c == '\n') {
+            fputs("\\n", out);
+        } else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void write_snapshot(ember_vm* vm, heap_snapshot* snapshot, uint32_t node_count) {
+    FILE* out = snapshot->out;
+    fputs("{\"snapshot\":{\"meta\":{"
+          "\"node_fields\":[\"type\",\"name\",\"id\",\"self_size\",\"edge_count\",\"trace_node_id\"],"
+          "\"node_types\":[[\"hidden\",\"array\",\"string\",\"object\",\"code\",\"closure\",\"regexp\","
+          "\"number\",\"native\",\"synthetic\",\"concatenated string\",\"sliced string\"],"
+          "\"string\",\"number\",\"number\",\"number\",\"number\"],"
+          "\"edge_fields\":[\"type\",\"name_or_index\",\"to_node\"],"
+          "\"edge_types\":[[\"context\",\"element\",\"property\",\"internal\",\"hidden\",\"shortcut\",\"weak\"],"
+          "\"string_or_number\",\"node\"],"
+          "\"trace_function_info_fields\":[],\"trace_node_fields\":[],\"sample_fields\":[],\"location_fields\":[]},",
+          out);
+    fprintf(out, "\"node_count\":%u,\"edge_count\":%llu,\"trace_function_count\":0},\n\"nodes\":[",
+            node_count, (unsigned long long)snapshot->edge_total);
+
+    // The synthetic root, then every object
+    uint32_t root_name = add_string(snapshot, "(GC roots)", 10);
+    fprintf(out, "%d,%u,1,0,%u,0", NODE_SYNTHETIC, root_name, snapshot->edge_counts[0]);
+    uint32_t index = 1;
+    for (ember_object* object = vm->objects; object; object = object->next, index++) {
+        int type;
+        uint32_t name = node_name(snapshot, object, &type);
+        fprintf(out, ",\n%d,%u,%llu,%zu,%u,0", type, name,
+                (unsigned long long)(((uint64_t)(uintptr_t)object >> 3) | 1), object_size(object),
+                snapshot->edge_counts[index]);
+    }
+
+    fputs("],\n\"edges\":[", out);
+    snapshot->writing = 1;
+    snapshot->first_edge = 1;
+    trace_edges(vm, snapshot);
+
+    fputs("],\n\"trace_function_infos\":[],\"trace_tree\":[],\"samples\":[],\"locations\":[],\n\"strings\":[", out);
+    for (uint32_t i = 0; i < snapshot->string_count; i++) {
+        if (i) fputs(",\n", out);
+        write_json_string(out, snapshot->strings[i].chars, snapshot->strings[i].length);
+    }
+    fputs("]}\n", out);
+}
+
+int ember_vm_write_heap_snapshot(ember_vm* vm, const char* path) {
+    if (!vm) return EMBER_ERROR_INVALID_PARAMETER;
+    gc_incremental_finish(vm);
+
+    size_t object_count = 0;
+    size_t class_count = 0;
+    for (ember_object* object = vm->objects; object; object = object->next) {
+        object_count++;
+        if (object->type == OBJ_CLASS) class_count++;
+    }
+    if (object_count >= UINT32_MAX / SNAPSHOT_NODE_FIELDS) return EMBER_ERROR_OPERATION_FAILED;
+
+    heap_snapshot snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+    snapshot.visitor.visit = visit_edge;
+    snapshot.edge_counts = malloc((object_count + 1) * sizeof(uint32_t));
+    int ready = table_init(&snapshot.nodes, object_count) && table_init(&snapshot.class_names, class_count) &&
+                snapshot.edge_counts;
+    uint32_t index = 1;
+    for (ember_object* object = vm->objects; ready && object; object = object->next) {
+        *table_slot(&snapshot.nodes, object, 1) = index++;
+    }
+    // String 0 is the empty name
+    if (ready) add_string(&snapshot, "", 0);
+
+    int result = EMBER_ERROR_OPERATION_FAILED;
+    if (ready && !snapshot.failed) {
+        // Edge counts come first in the file, so the tracer runs twice
+        trace_edges(vm, &snapshot);
+        for (uint32_t i = 0; i < index; i++) snapshot.edge_total += snapshot.edge_counts[i];
+        snapshot.out = open_output(path, stdout);
+        if (snapshot.out) {
+            write_snapshot(vm, &snapshot, index);
+            int written = close_output(snapshot.out, stdout);
+            if (written && !snapshot.failed) result = EMBER_SUCCESS;
+        }
+    } else {
+        fprintf(stderr, "[HEAP] Out of memory for a snapshot of %zu objects\n", object_count);
+    }
+    table_free(&snapshot.nodes);
+    table_free(&snapshot.class_names);
+    free(snapshot.edge_counts);
+    free(snapshot.strings);
+    return result;
+}
@@ -0,0 +1,84 @@
+#define _GNU_SOURCE
+#include "huge_pages.h"
+#include "../../include/ember.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+static pthread_once_t probe_once = PTHREAD_ONCE_INIT;
+static int transparent_available;   // THP not switched off
+static int reserved_available;      // Pages set aside for hugetlbfs
+
+static int read_first_line(const char* path, char* buffer, size_t size) {
+    FILE* file = fopen(path, "r");
+    if (!file) return 0;
+    int read = fgets(buffer, (int)size, file) != NULL;
+    fclose(file);
+    return read;
+}
+
+static void probe(void) {
+    char line[128];
+    // "always [madvise] never": the bracketed mode is in effect
+    transparent_available = read_first_line("/sys/kernel/mm/transparent_hugepage/enabled", line, sizeof(line)) &&
+                            !strstr(line, "[never]");
+    reserved_available = read_first_line("/proc/sys/vm/nr_hugepages", line, sizeof(line)) && atol(line) > 0;
+}
+
+int huge_pages_supported(void) {
+    pthread_once(&probe_once, probe);
+    return transparent_available || reserved_available;
+}
+
+void* huge_region_map(void) {
+    pthread_once(&probe_once, probe);
+#ifdef MAP_HUGETLB
+    if (reserved_available) {
+        // Fails once the reserved pages are used up
+        void* region = mmap(NULL, EMBER_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (region != MAP_FAILED) return region;
+    }
+#endif
+    // Map twice the size and keep the aligned middle
+    size_t span = 2 * (size_t)EMBER_HUGE_PAGE_SIZE;
+    char* mapping = mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) return NULL;
+    char* region = (char*)(((uintptr_t)mapping + EMBER_HUGE_PAGE_SIZE - 1) &
+                           ~(uintptr_t)(EMBER_HUGE_PAGE_SIZE - 1));
+    char* end = region + EMBER_HUGE_PAGE_SIZE;
+    if (region > mapping) munmap(mapping, (size_t)(region - mapping));
+    if (end < mapping + span) munmap(end, (size_t)(mapping + span - end));
+#ifdef MADV_HUGEPAGE
+    madvise(region, EMBER_HUGE_PAGE_SIZE, MADV_HUGEPAGE);
+#endif
+    return region;
+}
+
+void huge_region_unmap(void* region) {
+    if (region) munmap(region, EMBER_HUGE_PAGE_SIZE);
+}
+
+void huge_pages_advise(void* memory, size_t size) {
+#ifdef MADV_HUGEPAGE
+    if (!memory || size < EMBER_HUGE_PAGE_SIZE) return;
+    uintptr_t mask = (uintptr_t)(EMBER_HUGE_PAGE_SIZE - 1);
+    uintptr_t start = ((uintptr_t)memory + mask) & ~mask;
+    uintptr_t end = ((uintptr_t)memory + size) & ~mask;
+    // A chunk this large is usually a mapping of its own; one on the malloc
+    // heap keeps the advice after it is freed, which does no harm
+    if (end > start) madvise((void*)start, end - start, MADV_HUGEPAGE);
+#else
+    (void)memory;
+    (void)size;
+#endif
+}
+
+int ember_vm_set_huge_pages(ember_vm* vm, int enable) {
+    if (!vm) return 0;
+    vm->huge_pages = enable && huge_pages_supported();
+    return vm->huge_pages;
+}
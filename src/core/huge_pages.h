@@ -0,0 +1,22 @@
+#ifndef EMBER_HUGE_PAGES_H
+#define EMBER_HUGE_PAGES_H
+
+#include <stddef.h>
+
+// 2 MB pages for VM memory (ember_vm_set_huge_pages). A region is taken
+// from the huge pages the system has reserved (MAP_HUGETLB) when there are
+// any, otherwise mapped normally and advised with MADV_HUGEPAGE so the
+// kernel backs it with transparent huge pages.
+
+#define EMBER_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// Whether either kind of huge page can be had
+int huge_pages_supported(void);
+// EMBER_HUGE_PAGE_SIZE bytes aligned to their size, or NULL
+void* huge_region_map(void);
+void huge_region_unmap(void* region);
+// Advise the whole huge pages inside [memory, memory + size) of a buffer
+// that came from malloc; smaller buffers are left alone
+void huge_pages_advise(void* memory, size_t size);
+
+#endif // EMBER_HUGE_PAGES_H
@@ -0,0 +1,223 @@
+#define _GNU_SOURCE
+#include "io_ring.h"
+
+#if defined(__linux__)
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// All of these are in 5.10. Fast poll is what lets socket reads and
+// accepts wait for readiness inside the kernel instead of on a thread
+#define IO_RING_REQUIRED                                                                      \
+    (IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_SUBMIT_STABLE |              \
+     IORING_FEAT_FAST_POLL | IORING_FEAT_POLL_32BITS)
+
+static int ring_enter(io_ring* ring, unsigned submit, unsigned wait, unsigned flags, void* arg, size_t arg_size) {
+    return (int)syscall(__NR_io_uring_enter, ring->fd, submit, wait, flags, arg, arg_size);
+}
+
+int io_ring_init(io_ring* ring, unsigned entries) {
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+    const char* setting = getenv("EMBER_IO_URING");
+    if (setting && strcmp(setting, "0") == 0) return -1;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) return -1;  // ENOSYS, or EPERM under seccomp / kernel.io_uring_disabled
+    ring->fd = fd;
+    ring->features = params.features;
+    if ((params.features & IO_RING_REQUIRED) != IO_RING_REQUIRED) {
+        io_ring_free(ring);
+        return -1;
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->rings_size = sq_size > cq_size ? sq_size : cq_size;
+    ring->rings = mmap(NULL, ring->rings_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                       IORING_OFF_SQ_RING);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                      IORING_OFF_SQES);
+    if (ring->rings == MAP_FAILED) ring->rings = NULL;
+    if (ring->sqes == MAP_FAILED) ring->sqes = NULL;
+    if (!ring->rings || !ring->sqes) {
+        io_ring_free(ring);
+        return -1;
+    }
+
+    char* base = ring->rings;
+    ring->sq_head = (unsigned*)(base + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(base + params.sq_off.tail);
+    ring->sq_mask = *(unsigned*)(base + params.sq_off.ring_mask);
+    ring->sq_entries = params.sq_entries;
+    ring->sq_local_tail = *ring->sq_tail;
+    // Entries are used in ring order, so slot i of the index array always
+    // names entry i
+    unsigned* array = (unsigned*)(base + params.sq_off.array);
+    for (unsigned i = 0; i < params.sq_entries; i++) {
+        array[i] = i;
+    }
+    ring->cq_head = (unsigned*)(base + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(base + params.cq_off.tail);
+    ring->cq_mask = *(unsigned*)(base + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(base + params.cq_off.cqes);
+    return 0;
+}
+
+void io_ring_free(io_ring* ring) {
+    if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+    if (ring->rings) munmap(ring->rings, ring->rings_size);
+    if (ring->fd >= 0) close(ring->fd);
+    ring->sqes = NULL;
+    ring->rings = NULL;
+    ring->fd = -1;
+}
+
+struct io_uring_sqe* io_ring_sqe(io_ring* ring) {
+    if (ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+        if (io_ring_submit(ring, 0, 0) != 0 ||
+            ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+            return NULL;
+        }
+    }
+    struct io_uring_sqe* sqe = &ring->sqes[ring->sq_local_tail & ring->sq_mask];
+    ring->sq_local_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int io_ring_submit(io_ring* ring, int wait, int timeout_ms) {
+    unsigned flags = 0;
+    struct io_uring_getevents_arg getevents;
+    void* arg = NULL;
+    size_t arg_size = 0;
+    if (wait && io_ring_peek(ring)) {
+        wait = 0;  // Something to reap already
+    }
+    if (wait) {
+        flags |= IORING_ENTER_GETEVENTS;
+        if (timeout_ms >= 0) {
+            ring->timeout.tv_sec = timeout_ms / 1000;
+            ring->timeout.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+            if (ring->features & IORING_FEAT_EXT_ARG) {
+                memset(&getevents, 0, sizeof(getevents));
+                getevents.sigmask_sz = _NSIG / 8;
+                getevents.ts = (uint64_t)(uintptr_t)&ring->timeout;
+                flags |= IORING_ENTER_EXT_ARG;
+                arg = &getevents;
+                arg_size = sizeof(getevents);
+            } else {
+                // Before 5.11 a wait is bounded by a timeout request, which
+                // also ends as soon as anything else completes
+                struct io_uring_sqe* sqe = io_ring_sqe(ring);
+                if (!sqe) return -EBUSY;
+                sqe->opcode = IORING_OP_TIMEOUT;
+                sqe->fd = -1;
+                sqe->addr = (uint64_t)(uintptr_t)&ring->timeout;
+                sqe->len = 1;
+                sqe->off = 1;
+                sqe->user_data = IO_RING_TIMEOUT;
+            }
+        }
+    }
+
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    // Entries the kernel didn't take last time (a full completion queue)
+    // are still ahead of its head and go again
+    unsigned pending = ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (pending == 0 && !wait) return 0;
+    int result = ring_enter(ring, pending, wait ? 1 : 0, flags, arg, arg_size);
+    if (result >= 0) return 0;
+    int error = errno == EAGAIN ? EBUSY : errno;
+    if (error != EINTR && error != EBUSY && error != ETIME) {
+        // Nothing was taken: drop the batch rather than send it later,
+        // when what its entries point at may be gone
+        ring->sq_local_tail = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    }
+    return -error;
+}
+
+struct io_uring_cqe* io_ring_peek(io_ring* ring) {
+    for (;;) {
+        unsigned head = *ring->cq_head;
+        if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) return NULL;
+        struct io_uring_cqe* cqe = &ring->cqes[head & ring->cq_mask];
+        if (cqe->user_data != IO_RING_TIMEOUT) return cqe;
+        __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+    }
+}
+
+void io_ring_seen(io_ring* ring) {
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+int io_ring_register_buffers(io_ring* ring, const struct iovec* buffers, unsigned count) {
+    return syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, buffers, count) == 0 ? 0 : -1;
+}
+
+int io_ring_register_files(io_ring* ring, unsigned count) {
+    int* fds = malloc(sizeof(int) * count);
+    if (!fds) return -1;
+    for (unsigned i = 0; i < count; i++) {
+        fds[i] = -1;
+    }
+    long result = syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_FILES, fds, count);
+    free(fds);
+    return result == 0 ? 0 : -1;
+}
+
+int io_ring_set_file(io_ring* ring, unsigned slot, int fd) {
+    struct io_uring_files_update update;
+    memset(&update, 0, sizeof(update));
+    update.offset = slot;
+    update.fds = (uint64_t)(uintptr_t)&fd;
+    return syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_FILES_UPDATE, &update, 1) == 1 ? 0 : -1;
+}
+
+// ============================================================================
+// PER-THREAD RING
+// ============================================================================
+
+static pthread_key_t thread_ring_key;
+static pthread_once_t thread_ring_once = PTHREAD_ONCE_INIT;
+static __thread io_ring* thread_ring = NULL;
+static __thread int thread_ring_tried = 0;
+
+static void thread_ring_free(void* ring) {
+    io_ring_free(ring);
+    free(ring);
+}
+
+static void thread_ring_key_create(void) {
+    pthread_key_create(&thread_ring_key, thread_ring_free);
+}
+
+io_ring* io_ring_thread(void) {
+    if (thread_ring || thread_ring_tried) return thread_ring;
+    thread_ring_tried = 1;
+    pthread_once(&thread_ring_once, thread_ring_key_create);
+    io_ring* ring = malloc(sizeof(io_ring));
+    if (!ring) return NULL;
+    if (io_ring_init(ring, 8) != 0) {
+        free(ring);
+        return NULL;
+    }
+    if (pthread_setspecific(thread_ring_key, ring) != 0) {
+        thread_ring_free(ring);
+        return NULL;
+    }
+    thread_ring = ring;
+    return ring;
+}
+
+#endif
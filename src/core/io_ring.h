@@ -0,0 +1,75 @@
+#ifndef EMBER_IO_RING_H
+#define EMBER_IO_RING_H
+
+// io_uring without liburing: the submission and completion rings mapped
+// from the kernel and driven with the raw io_uring_setup / io_uring_enter /
+// io_uring_register system calls. Entries prepared with io_ring_sqe are
+// handed over together by the next io_ring_submit, which can also wait for
+// completions, so a batch of reads, writes, accepts and opens costs one
+// system call. Linux only; elsewhere, and on kernels without the 5.10
+// feature set, io_ring_init fails and callers stay on epoll or plain calls.
+
+#if defined(__linux__)
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+// user_data of the timeouts io_ring_submit queues itself; never returned
+#define IO_RING_TIMEOUT UINT64_MAX
+
+typedef struct {
+    int fd;
+    unsigned features;                 // IORING_FEAT_* the kernel reported
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned sq_local_tail;            // Prepared, not yet published to the kernel
+    struct io_uring_sqe* sqes;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe* cqes;
+    void* rings;                       // One mapping for both rings (IORING_FEAT_SINGLE_MMAP)
+    size_t rings_size;
+    size_t sqes_size;
+    struct __kernel_timespec timeout;  // Read by the kernel while submitting
+} io_ring;
+
+// Sets ring up with room for entries (a power of two) submissions: 0, or -1
+// when io_uring is missing, older than 5.10, blocked by policy, or turned
+// off with EMBER_IO_URING=0
+int io_ring_init(io_ring* ring, unsigned entries);
+void io_ring_free(io_ring* ring);
+
+// A zeroed submission entry to fill in. When the queue is full what is in
+// it is submitted first; NULL if that fails
+struct io_uring_sqe* io_ring_sqe(io_ring* ring);
+
+// Hands every prepared entry to the kernel and, with wait, blocks until a
+// completion is ready or timeout_ms passes (-1: no limit), in one system
+// call. 0, or -errno: -ETIME once the timeout passed, -EINTR, -EBUSY while
+// completions must be reaped first. Any other error drops the batch
+int io_ring_submit(io_ring* ring, int wait, int timeout_ms);
+
+// The oldest unconsumed completion, or NULL; io_ring_seen consumes it
+struct io_uring_cqe* io_ring_peek(io_ring* ring);
+void io_ring_seen(io_ring* ring);
+
+// Pins count buffers for IORING_OP_READ_FIXED / WRITE_FIXED (buf_index is
+// their position)
+int io_ring_register_buffers(io_ring* ring, const struct iovec* buffers, unsigned count);
+// A table of count empty fixed-file slots. IORING_OP_FILES_UPDATE or
+// io_ring_set_file fill them; IOSQE_FIXED_FILE entries name a slot as fd
+int io_ring_register_files(io_ring* ring, unsigned count);
+int io_ring_set_file(io_ring* ring, unsigned slot, int fd);
+
+// The calling thread's own ring, made on first use and freed when the
+// thread exits; NULL when io_uring is unavailable
+io_ring* io_ring_thread(void);
+
+#endif
+
+#endif
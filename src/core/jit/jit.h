@@ -0,0 +1,107 @@
+#ifndef EMBER_JIT_H
+#define EMBER_JIT_H
+
+#include "../../../include/ember.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Baseline JIT: shared between the front end (jit_compiler.c) and the
+// per-architecture template backends (jit_x86_64.c, jit_arm64.c).
+//
+// The front end decodes a chunk into jit_insn, one per bytecode
+// instruction, and checks the stack depth at every instruction. A backend
+// turns each one into a fixed machine code template working directly on
+// vm->locals and vm->stack, with the type checks the interpreter would do
+// as guards. Anything a template cannot finish (a failed guard, an opcode
+// without a template) leaves the native code with vm->ip at that
+// instruction and vm->stack_top written back, so the interpreter carries
+// on as if it had run everything before it. Templates never allocate, call
+// out or raise errors.
+
+// Templates assume the 24-byte struct ember_value, not the NaN-boxed one
+#if defined(ENABLE_JIT_COMPILER) && !defined(EMBER_NAN_BOXING) && (defined(__x86_64__) || defined(__aarch64__))
+#define EMBER_JIT_AVAILABLE 1
+#else
+#define EMBER_JIT_AVAILABLE 0
+#endif
+
+typedef enum {
+    JIT_EXIT,               // No template: back to the interpreter here
+    JIT_PUSH_VALUE,         // constant
+    JIT_POP,
+    JIT_GET_LOCAL,          // slot; exits if the slot is not live yet
+    JIT_SET_LOCAL,          // slot
+    JIT_ARITH,              // opcode OP_ADD/SUB/MUL/DIV on two numbers
+    JIT_COMPARE,            // opcode OP_EQUAL ... OP_GREATER_EQUAL on two numbers
+    JIT_NOT,                // bool only
+    JIT_JUMP,               // target
+    JIT_JUMP_IF,            // opcode OP_JUMP_IF_FALSE/TRUE on a bool, pops it
+    JIT_LOCAL_ARITH_CONST,  // opcode OP_ADD/SUB_LOCAL_CONST, slot, number constant
+    JIT_LOCAL_COMPARE_JUMP  // opcode OP_LOCAL_<cmp>_CONST_JUMP_IF_FALSE, slot, constant, target
+} jit_op;
+
+typedef struct {
+    jit_op op;
+    uint8_t opcode;         // Bytecode opcode (after any OP_WIDE prefix)
+    int slot;
+    ember_value constant;
+    int target;             // Instruction index of a jump target
+    int offset;             // Bytecode offset, where an exit resumes
+    int depth;              // Stack values above the entry depth before it runs
+    int is_entry;           // Loop header: native code can be entered here
+} jit_insn;
+
+// Native code for one chunk: fn(vm, entry) runs from the entry address
+// until it leaves through an exit, and returns why
+typedef enum {
+    JIT_STATUS_EXIT = 0,    // Instruction without a template
+    JIT_STATUS_DEOPT = 1    // A guard failed
+} jit_status;
+
+typedef int (*jit_native_fn)(ember_vm* vm, const void* entry);
+
+typedef struct {
+    int offset;             // Bytecode offset
+    int depth;              // Stack depth there, relative to the entry at 0
+    uint32_t native;        // Offset into the code
+} jit_entry;
+
+// What a backend needs besides the instructions
+typedef struct {
+    const jit_insn* insns;
+    int count;
+    const uint8_t* bytecode;  // Exits store bytecode + offset into vm->ip
+    uint32_t* native_offsets; // Out: native offset of each instruction
+} jit_program;
+
+// Machine code buffer. Backends append through jit_buffer_put; a write past
+// capacity sets overflow and the compiler retries with more room
+typedef struct {
+    uint8_t* code;
+    size_t size;
+    size_t capacity;
+    int overflow;
+} jit_buffer;
+
+static inline void jit_buffer_put(jit_buffer* buffer, const void* bytes, size_t length) {
+    if (buffer->size + length > buffer->capacity) {
+        buffer->overflow = 1;
+        return;
+    }
+    for (size_t i = 0; i < length; i++) {
+        buffer->code[buffer->size + i] = ((const uint8_t*)bytes)[i];
+    }
+    buffer->size += length;
+}
+
+// Emit program into buffer; the function starts at offset 0. Returns 0 on
+// overflow or an instruction the backend cannot encode
+int jit_backend_emit(jit_buffer* buffer, const jit_program* program);
+// Bytes of code per instruction to reserve on the first attempt
+size_t jit_backend_size_hint(void);
+
+// Announce size bytes of sealed code for chunk to perf, if ember_jit_perf_enable
+// asked for it (jit_perf.c); program's native offsets give the line table
+void jit_perf_code_load(const ember_chunk* chunk, const uint8_t* code, size_t size, const jit_program* program);
+
+#endif // EMBER_JIT_H
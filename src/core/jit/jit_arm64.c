@@ -0,0 +1,425 @@
+#include "jit.h"
+#include "../../vm.h"
+#include <stdlib.h>
+#include <string.h>
+
+// ARM64 templates for the baseline JIT (AAPCS64).
+//
+// Register assignment while native code runs:
+//   x19  vm
+//   x20  &vm->locals[vm->local_base]   (slot 0)
+//   x21  &vm->stack[vm->stack_top]     (next free value)
+//   x22  vm->local_base
+// x0-x1, x9-x11 and d0-d1 are scratch. ember_vm fields are past the reach
+// of scaled immediates, so they are addressed as [x19, x9] with the offset
+// in x9. Guards branch forward to a per-instruction stub that stores
+// vm->ip and leaves through the shared exit, which writes x21 back to
+// vm->stack_top.
+
+#if EMBER_JIT_AVAILABLE && defined(__aarch64__)
+
+#include <stddef.h>
+
+// Templates address values as 24-byte {type, payload, second payload word};
+// a number's second word is its small int and flag, which arithmetic clears
+typedef char jit_value_layout_check[(sizeof(ember_value) == 24 && offsetof(ember_value, type) == 0 &&
+                                     offsetof(ember_value, as) == 8 &&
+                                     offsetof(ember_value, as.number.is_small) == 20) ? 1 : -1];
+
+#define VALUE_SIZE 24
+#define TOP_TYPE (-24)
+#define TOP_PAYLOAD (-16)
+#define SECOND_TYPE (-48)
+#define SECOND_PAYLOAD (-40)
+
+#define VM  19
+#define LOC 20
+#define SP_ 21
+#define LB  22
+
+// Condition codes
+#define COND_EQ 0x0
+#define COND_NE 0x1
+#define COND_HI 0x8
+#define COND_LS 0x9
+#define COND_GE 0xA
+#define COND_LT 0xB
+#define COND_GT 0xC
+#define COND_LE 0xD
+#define COND_MI 0x4
+#define COND_PL 0x5
+#define COND_VS 0x6
+
+typedef enum {
+    PATCH_INSN,
+    PATCH_DEOPT,
+    PATCH_COMMON
+} patch_kind;
+
+typedef enum {
+    BRANCH_B,               // imm26
+    BRANCH_COND,            // b.cond / cbz / cbnz: imm19 at bit 5
+} branch_form;
+
+typedef struct {
+    size_t at;
+    patch_kind kind;
+    branch_form form;
+    int index;
+} patch;
+
+typedef struct {
+    jit_buffer* buffer;
+    patch* patches;
+    int patch_count;
+    int patch_capacity;
+    int* needs_deopt;
+} emitter;
+
+static void put(emitter* e, uint32_t word) {
+    uint8_t bytes[4] = { (uint8_t)word, (uint8_t)(word >> 8), (uint8_t)(word >> 16), (uint8_t)(word >> 24) };
+    jit_buffer_put(e->buffer, bytes, 4);
+}
+
+static int branch_to(emitter* e, uint32_t word, branch_form form, patch_kind kind, int index) {
+    if (e->patch_count == e->patch_capacity) {
+        int capacity = e->patch_capacity ? e->patch_capacity * 2 : 64;
+        patch* patches = realloc(e->patches, sizeof(patch) * (size_t)capacity);
+        if (!patches) return 0;
+        e->patches = patches;
+        e->patch_capacity = capacity;
+    }
+    patch* fix = &e->patches[e->patch_count++];
+    fix->at = e->buffer->size;
+    fix->kind = kind;
+    fix->form = form;
+    fix->index = index;
+    put(e, word);
+    return 1;
+}
+
+static int b_cond(emitter* e, int cond, patch_kind kind, int index) {
+    return branch_to(e, 0x54000000u | (uint32_t)cond, BRANCH_COND, kind, index);
+}
+
+static int deopt_if(emitter* e, int cond, int index) {
+    e->needs_deopt[index] = 1;
+    return b_cond(e, cond, PATCH_DEOPT, index);
+}
+
+// movz/movk: rd = value
+static void mov_imm(emitter* e, int rd, uint64_t value) {
+    put(e, 0xD2800000u | (uint32_t)(value & 0xFFFF) << 5 | (uint32_t)rd);
+    for (int hw = 1; hw < 4; hw++) {
+        uint32_t part = (uint32_t)(value >> (hw * 16)) & 0xFFFF;
+        if (part) put(e, 0xF2800000u | (uint32_t)hw << 21 | part << 5 | (uint32_t)rd);
+    }
+}
+
+static uint32_t simm9(int offset) {
+    return ((uint32_t)offset & 0x1FF) << 12;
+}
+
+static void ldur_w(emitter* e, int rt, int rn, int offset) { put(e, 0xB8400000u | simm9(offset) | (uint32_t)rn << 5 | (uint32_t)rt); }
+static void ldur_x(emitter* e, int rt, int rn, int offset) { put(e, 0xF8400000u | simm9(offset) | (uint32_t)rn << 5 | (uint32_t)rt); }
+static void stur_w(emitter* e, int rt, int rn, int offset) { put(e, 0xB8000000u | simm9(offset) | (uint32_t)rn << 5 | (uint32_t)rt); }
+static void stur_x(emitter* e, int rt, int rn, int offset) { put(e, 0xF8000000u | simm9(offset) | (uint32_t)rn << 5 | (uint32_t)rt); }
+static void ldur_d(emitter* e, int rt, int rn, int offset) { put(e, 0xFC400000u | simm9(offset) | (uint32_t)rn << 5 | (uint32_t)rt); }
+static void stur_d(emitter* e, int rt, int rn, int offset) { put(e, 0xFC000000u | simm9(offset) | (uint32_t)rn << 5 | (uint32_t)rt); }
+static void ldur_q(emitter* e, int rt, int rn, int offset) { put(e, 0x3CC00000u | simm9(offset) | (uint32_t)rn << 5 | (uint32_t)rt); }
+static void stur_q(emitter* e, int rt, int rn, int offset) { put(e, 0x3C800000u | simm9(offset) | (uint32_t)rn << 5 | (uint32_t)rt); }
+
+// Register-offset forms: [rn, rm]
+static void ldr_w_reg(emitter* e, int rt, int rn, int rm)  { put(e, 0xB8606800u | (uint32_t)rm << 16 | (uint32_t)rn << 5 | (uint32_t)rt); }
+static void str_w_reg(emitter* e, int rt, int rn, int rm)  { put(e, 0xB8206800u | (uint32_t)rm << 16 | (uint32_t)rn << 5 | (uint32_t)rt); }
+static void str_x_reg(emitter* e, int rt, int rn, int rm)  { put(e, 0xF8206800u | (uint32_t)rm << 16 | (uint32_t)rn << 5 | (uint32_t)rt); }
+static void ldrsw_reg(emitter* e, int rt, int rn, int rm)  { put(e, 0xB8A06800u | (uint32_t)rm << 16 | (uint32_t)rn << 5 | (uint32_t)rt); }
+
+static void add_reg(emitter* e, int rd, int rn, int rm) {
+    put(e, 0x8B000000u | (uint32_t)rm << 16 | (uint32_t)rn << 5 | (uint32_t)rd);
+}
+
+// rd = ra + rn * rm
+static void madd(emitter* e, int rd, int rn, int rm, int ra) {
+    put(e, 0x9B000000u | (uint32_t)rm << 16 | (uint32_t)ra << 10 | (uint32_t)rn << 5 | (uint32_t)rd);
+}
+
+static void add_imm(emitter* e, int rd, int rn, int imm) { put(e, 0x91000000u | (uint32_t)imm << 10 | (uint32_t)rn << 5 | (uint32_t)rd); }
+static void sub_imm(emitter* e, int rd, int rn, int imm) { put(e, 0xD1000000u | (uint32_t)imm << 10 | (uint32_t)rn << 5 | (uint32_t)rd); }
+static void cmp_w_imm(emitter* e, int rn, int imm)       { put(e, 0x7100001Fu | (uint32_t)imm << 10 | (uint32_t)rn << 5); }
+static void cmp_w(emitter* e, int rn, int rm)            { put(e, 0x6B00001Fu | (uint32_t)rm << 16 | (uint32_t)rn << 5); }
+static void cset_w(emitter* e, int rd, int cond)         { put(e, 0x1A9F07E0u | (uint32_t)(cond ^ 1) << 12 | (uint32_t)rd); }
+static void fcmp_d(emitter* e, int rn, int rm)           { put(e, 0x1E602000u | (uint32_t)rm << 16 | (uint32_t)rn << 5); }
+
+// Load a vm field address offset into x9
+static void vm_field(emitter* e, size_t offset) {
+    mov_imm(e, 9, (uint64_t)offset);
+}
+
+static int guard_stack_type(emitter* e, int offset, int type, int index) {
+    ldur_w(e, 9, SP_, offset);
+    cmp_w_imm(e, 9, type);
+    return deopt_if(e, COND_NE, index);
+}
+
+// x11 = &locals[slot]
+static void local_address(emitter* e, int32_t local) {
+    mov_imm(e, 9, (uint64_t)local);
+    add_reg(e, 11, LOC, 9);
+}
+
+// x11 = &locals[slot], guarded to hold a number
+static int guard_local_number(emitter* e, int32_t local, int index) {
+    local_address(e, local);
+    ldur_w(e, 10, 11, 0);
+    cmp_w_imm(e, 10, EMBER_VAL_NUMBER);
+    return deopt_if(e, COND_NE, index);
+}
+
+// Word 0 is the number, bool or pointer; word 1 only matters for functions
+static uint64_t payload_bits(const ember_value* value, int word) {
+    uint64_t bits;
+    memcpy(&bits, (const uint8_t*)&value->as + word * 8, sizeof(bits));
+    return bits;
+}
+
+// Condition that holds after fcmp d0, d1 when the comparison is true;
+// every one of them is false for unordered operands except NE
+static int compare_cond(uint8_t opcode) {
+    switch (opcode) {
+        case OP_LESS:          return COND_MI;
+        case OP_LESS_EQUAL:    return COND_LS;
+        case OP_GREATER:       return COND_GT;
+        case OP_GREATER_EQUAL: return COND_GE;
+        case OP_EQUAL:         return COND_EQ;
+        default:               return COND_NE;
+    }
+}
+
+static void emit_prologue(emitter* e) {
+    put(e, 0xA9BD7BFDu);                                        // stp x29, x30, [sp, #-48]!
+    put(e, 0x910003FDu);                                        // mov x29, sp
+    put(e, 0xA90153F3u);                                        // stp x19, x20, [sp, #16]
+    put(e, 0xA9025BF5u);                                        // stp x21, x22, [sp, #32]
+    put(e, 0xAA0003E0u | VM);                                   // mov x19, x0
+    vm_field(e, offsetof(ember_vm, local_base));
+    ldrsw_reg(e, LB, VM, 9);
+    mov_imm(e, 11, VALUE_SIZE);
+    vm_field(e, offsetof(ember_vm, locals));
+    add_reg(e, LOC, VM, 9);
+    madd(e, LOC, LB, 11, LOC);                                  // + local_base * 24
+    vm_field(e, offsetof(ember_vm, stack_top));
+    ldrsw_reg(e, 10, VM, 9);
+    vm_field(e, offsetof(ember_vm, stack));
+    add_reg(e, SP_, VM, 9);
+    madd(e, SP_, 10, 11, SP_);                                  // + stack_top * 24
+    put(e, 0xD61F0020u);                                        // br x1
+}
+
+static int emit_exit(emitter* e, const jit_program* program, int offset, int status) {
+    mov_imm(e, 10, (uint64_t)(uintptr_t)(program->bytecode + offset));
+    vm_field(e, offsetof(ember_vm, ip));
+    str_x_reg(e, 10, VM, 9);
+    put(e, 0x52800000u | (uint32_t)status << 5);                // mov w0, #status
+    return branch_to(e, 0x14000000u, BRANCH_B, PATCH_COMMON, 0);
+}
+
+static void emit_common_exit(emitter* e) {
+    vm_field(e, offsetof(ember_vm, stack));
+    add_reg(e, 10, VM, 9);
+    put(e, 0xCB000000u | 10u << 16 | (uint32_t)SP_ << 5 | 10);  // sub x10, x21, x10
+    mov_imm(e, 11, VALUE_SIZE);
+    put(e, 0x9AC00800u | 11u << 16 | 10u << 5 | 10);            // udiv x10, x10, x11
+    vm_field(e, offsetof(ember_vm, stack_top));
+    str_w_reg(e, 10, VM, 9);
+    put(e, 0xA9425BF5u);                                        // ldp x21, x22, [sp, #32]
+    put(e, 0xA94153F3u);                                        // ldp x19, x20, [sp, #16]
+    put(e, 0xA8C37BFDu);                                        // ldp x29, x30, [sp], #48
+    put(e, 0xD65F03C0u);                                        // ret
+}
+
+// Stack slots 2nd-from-top and top into d0 and d1
+static int load_number_pair(emitter* e, int index) {
+    if (!guard_stack_type(e, SECOND_TYPE, EMBER_VAL_NUMBER, index) ||
+        !guard_stack_type(e, TOP_TYPE, EMBER_VAL_NUMBER, index)) {
+        return 0;
+    }
+    ldur_d(e, 0, SP_, SECOND_PAYLOAD);
+    ldur_d(e, 1, SP_, TOP_PAYLOAD);
+    return 1;
+}
+
+static int emit_insn(emitter* e, const jit_program* program, int i) {
+    const jit_insn* insn = &program->insns[i];
+    int32_t local = insn->slot * VALUE_SIZE;
+    switch (insn->op) {
+        case JIT_PUSH_VALUE:
+            mov_imm(e, 9, (uint64_t)insn->constant.type);
+            stur_w(e, 9, SP_, 0);
+            mov_imm(e, 9, payload_bits(&insn->constant, 0));
+            stur_x(e, 9, SP_, 8);
+            mov_imm(e, 9, payload_bits(&insn->constant, 1));
+            stur_x(e, 9, SP_, 16);
+            add_imm(e, SP_, SP_, VALUE_SIZE);
+            return 1;
+
+        case JIT_POP:
+            sub_imm(e, SP_, SP_, VALUE_SIZE);
+            return 1;
+
+        case JIT_GET_LOCAL:
+            // The slot must be live: local_base + slot < local_count
+            mov_imm(e, 10, (uint64_t)insn->slot);
+            put(e, 0x0B000000u | 10u << 16 | (uint32_t)LB << 5 | 10);  // add w10, w22, w10
+            vm_field(e, offsetof(ember_vm, local_count));
+            ldr_w_reg(e, 11, VM, 9);
+            cmp_w(e, 10, 11);
+            if (!deopt_if(e, COND_GE, i)) return 0;
+            local_address(e, local);
+            ldur_q(e, 0, 11, 0);
+            ldur_x(e, 10, 11, 16);
+            stur_q(e, 0, SP_, 0);
+            stur_x(e, 10, SP_, 16);
+            add_imm(e, SP_, SP_, VALUE_SIZE);
+            return 1;
+
+        case JIT_SET_LOCAL:
+            ldur_q(e, 0, SP_, TOP_TYPE);
+            ldur_x(e, 10, SP_, TOP_TYPE + 16);
+            local_address(e, local);
+            stur_q(e, 0, 11, 0);
+            stur_x(e, 10, 11, 16);
+            // local_count = max(local_count, local_base + slot + 1)
+            mov_imm(e, 10, (uint64_t)(insn->slot + 1));
+            put(e, 0x0B000000u | 10u << 16 | (uint32_t)LB << 5 | 10);  // add w10, w22, w10
+            vm_field(e, offsetof(ember_vm, local_count));
+            ldr_w_reg(e, 11, VM, 9);
+            cmp_w(e, 10, 11);
+            put(e, 0x54000040u | COND_LE);                      // b.le +8
+            str_w_reg(e, 10, VM, 9);
+            return 1;
+
+        case JIT_ARITH:
+            if (!load_number_pair(e, i)) return 0;
+            switch (insn->opcode) {
+                case OP_ADD: put(e, 0x1E612800u); break;        // fadd d0, d0, d1
+                case OP_SUB: put(e, 0x1E613800u); break;        // fsub d0, d0, d1
+                case OP_MUL: put(e, 0x1E610800u); break;        // fmul d0, d0, d1
+                default:
+                    // Division by zero (or NaN) is the interpreter's to report
+                    put(e, 0x1E602028u);                        // fcmp d1, #0.0
+                    if (!deopt_if(e, COND_EQ, i) || !deopt_if(e, COND_VS, i)) return 0;
+                    put(e, 0x1E611800u);                        // fdiv d0, d0, d1
+                    break;
+            }
+            stur_d(e, 0, SP_, SECOND_PAYLOAD);
+            stur_w(e, 31, SP_, SECOND_PAYLOAD + 12);            // Not a small int (wzr)
+            sub_imm(e, SP_, SP_, VALUE_SIZE);
+            return 1;
+
+        case JIT_COMPARE:
+            if (!load_number_pair(e, i)) return 0;
+            fcmp_d(e, 0, 1);
+            cset_w(e, 9, compare_cond(insn->opcode));
+            mov_imm(e, 10, EMBER_VAL_BOOL);
+            stur_w(e, 10, SP_, SECOND_TYPE);
+            stur_x(e, 9, SP_, SECOND_PAYLOAD);
+            sub_imm(e, SP_, SP_, VALUE_SIZE);
+            return 1;
+
+        case JIT_NOT:
+            if (!guard_stack_type(e, TOP_TYPE, EMBER_VAL_BOOL, i)) return 0;
+            ldur_w(e, 9, SP_, TOP_PAYLOAD);
+            cmp_w_imm(e, 9, 0);
+            cset_w(e, 9, COND_EQ);
+            stur_x(e, 9, SP_, TOP_PAYLOAD);
+            return 1;
+
+        case JIT_JUMP:
+            return branch_to(e, 0x14000000u, BRANCH_B, PATCH_INSN, insn->target);
+
+        case JIT_JUMP_IF:
+            if (!guard_stack_type(e, TOP_TYPE, EMBER_VAL_BOOL, i)) return 0;
+            ldur_w(e, 9, SP_, TOP_PAYLOAD);
+            sub_imm(e, SP_, SP_, VALUE_SIZE);
+            // cbz / cbnz w9
+            return branch_to(e, (insn->opcode == OP_JUMP_IF_FALSE ? 0x34000000u : 0x35000000u) | 9,
+                             BRANCH_COND, PATCH_INSN, insn->target);
+
+        case JIT_LOCAL_ARITH_CONST:
+            if (!guard_local_number(e, local, i)) return 0;
+            put(e, 0xFD400560u);                                // ldr d0, [x11, #8]
+            mov_imm(e, 10, payload_bits(&insn->constant, 0));
+            put(e, 0x9E670141u);                                // fmov d1, x10
+            put(e, insn->opcode == OP_ADD_LOCAL_CONST ? 0x1E612800u : 0x1E613800u);
+            put(e, 0xFD000560u);                                // str d0, [x11, #8]
+            put(e, 0xB900157Fu);                                // str wzr, [x11, #20]: not a small int
+            return 1;
+
+        case JIT_LOCAL_COMPARE_JUMP:
+            if (!guard_local_number(e, local, i)) return 0;
+            put(e, 0xFD400560u);                                // ldr d0, [x11, #8]
+            mov_imm(e, 10, payload_bits(&insn->constant, 0));
+            put(e, 0x9E670141u);                                // fmov d1, x10
+            fcmp_d(e, 0, 1);
+            // Jump when the comparison is false, unordered included
+            return b_cond(e, compare_cond(opcode_fused_operation(insn->opcode)) ^ 1, PATCH_INSN, insn->target);
+
+        case JIT_EXIT:
+        default:
+            return emit_exit(e, program, insn->offset, JIT_STATUS_EXIT);
+    }
+}
+
+size_t jit_backend_size_hint(void) {
+    return 128;
+}
+
+int jit_backend_emit(jit_buffer* buffer, const jit_program* program) {
+    emitter e = { buffer, NULL, 0, 0, NULL };
+    size_t* deopt_at = malloc(sizeof(size_t) * (size_t)program->count);
+    e.needs_deopt = calloc((size_t)program->count, sizeof(int));
+    int ok = deopt_at && e.needs_deopt;
+
+    if (ok) emit_prologue(&e);
+    for (int i = 0; ok && i < program->count; i++) {
+        program->native_offsets[i] = (uint32_t)buffer->size;
+        ok = emit_insn(&e, program, i);
+    }
+    for (int i = 0; ok && i < program->count; i++) {
+        if (!e.needs_deopt[i]) continue;
+        deopt_at[i] = buffer->size;
+        ok = emit_exit(&e, program, program->insns[i].offset, JIT_STATUS_DEOPT);
+    }
+    size_t common_at = buffer->size;
+    if (ok) emit_common_exit(&e);
+
+    for (int p = 0; ok && !buffer->overflow && p < e.patch_count; p++) {
+        const patch* fix = &e.patches[p];
+        size_t target;
+        switch (fix->kind) {
+            case PATCH_INSN:  target = program->native_offsets[fix->index]; break;
+            case PATCH_DEOPT: target = deopt_at[fix->index]; break;
+            default:          target = common_at; break;
+        }
+        int64_t words = ((int64_t)target - (int64_t)fix->at) / 4;
+        uint32_t word;
+        memcpy(&word, buffer->code + fix->at, sizeof(word));
+        if (fix->form == BRANCH_B) {
+            word |= (uint32_t)words & 0x3FFFFFF;
+        } else {
+            if (words < -(1 << 18) || words >= (1 << 18)) {
+                ok = 0;
+                break;
+            }
+            word |= ((uint32_t)words & 0x7FFFF) << 5;
+        }
+        memcpy(buffer->code + fix->at, &word, sizeof(word));
+    }
+    free(e.patches);
+    free(e.needs_deopt);
+    free(deopt_at);
+    return ok && !buffer->overflow;
+}
+
+#endif
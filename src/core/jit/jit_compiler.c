@@ -0,0 +1,498 @@
+#define _GNU_SOURCE
+#include "jit.h"
+#include "../../vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Baseline JIT front end: hotness counting, decoding, code memory and the
+// call/loop hooks that run native code.
+//
+// Every Ember call (vm_handle_call, OP_INVOKE, tail calls) and every
+// backward jump (OP_LOOP, through vm_osr_back_edge and vm_jit_on_loop)
+// counts against the chunk, and a loop that gets hot on its own makes the
+// chunk due at once (vm_osr.c). Once the count reaches vm->jit_threshold the chunk is compiled
+// whole, and from then on those hooks jump into its native code at the
+// function start or at the loop header just jumped to. Native code runs
+// until the first instruction it has no template for or whose guard
+// fails, and the interpreter resumes from there. A chunk whose guards keep
+// failing (numbers turned out to be strings, say) loses its code and is
+// not compiled again.
+
+#if EMBER_JIT_AVAILABLE
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define JIT_DEFAULT_THRESHOLD 1000
+// Deopts tolerated before the rate is considered at all
+#define JIT_DEOPT_LIMIT 64
+// Code is dropped once more than 1 in JIT_DEOPT_RATIO entries deopt
+#define JIT_DEOPT_RATIO 8
+
+struct ember_jit_code {
+    uint8_t* memory;                  // Executable mapping
+    size_t mapped;
+    size_t size;                      // Bytes of it holding code
+    jit_native_fn fn;
+    const uint8_t* bytecode;          // chunk->code and count it was compiled from
+    int bytecode_length;
+    jit_entry* entries;               // Function start, then loop headers by offset
+    int entry_count;
+    int max_depth;                    // Stack values above the entry depth, at most
+    int max_slot;                     // Highest local slot touched, -1 if none
+    uint64_t runs;
+    uint64_t deopts;
+};
+
+// ============================================================================
+// DECODING
+// ============================================================================
+
+static void set_exit(jit_insn* insn) {
+    insn->op = JIT_EXIT;
+}
+
+// One jit_insn per instruction plus a final exit at the end of the chunk,
+// which jumps past the last instruction land on. Returns the count, or -1
+static int decode(const ember_chunk* chunk, jit_insn** out) {
+    int* index_at = malloc(sizeof(int) * ((size_t)chunk->count + 1));
+    jit_insn* insns = calloc((size_t)chunk->count + 1, sizeof(jit_insn));
+    int* ends = malloc(sizeof(int) * ((size_t)chunk->count + 1));
+    if (!index_at || !insns || !ends) {
+        free(index_at);
+        free(insns);
+        free(ends);
+        return -1;
+    }
+    for (int i = 0; i <= chunk->count; i++) index_at[i] = -1;
+
+    // Pass 1: boundaries, opcodes and operands
+    int count = 0;
+    int offset = 0;
+    while (offset < chunk->count) {
+        jit_insn* insn = &insns[count];
+        uint8_t op = chunk->code[offset];
+        int length = 1;
+        int operand = 0;
+        if (op == OP_WIDE || opcode_has_operand(op)) {
+            operand = read_chunk_operand(chunk, offset, &op, &length);
+        } else if (opcode_fused_size(op) > 0) {
+            length = opcode_fused_size(op);
+            insn->slot = read_chunk_u16(chunk, offset + 1);
+            operand = read_chunk_u16(chunk, offset + 3);
+        }
+        // Quickened opcodes compile like the generic ones; the templates carry
+        // their own type guards
+        op = opcode_generic(op);
+        if (offset + length > chunk->count) {
+            // Truncated instruction: nothing after it can be trusted
+            length = chunk->count - offset;
+            op = OP_HALT;
+        }
+        insn->opcode = op;
+        insn->offset = offset;
+        insn->target = -1;
+        index_at[offset] = count;
+        ends[count] = offset + length;
+
+        switch (op) {
+            case OP_PUSH_CONST:
+                if (operand < chunk->const_count) {
+                    insn->op = JIT_PUSH_VALUE;
+                    insn->constant = chunk->constants[operand];
+                } else {
+                    set_exit(insn);
+                }
+                break;
+            case OP_POP:
+                insn->op = JIT_POP;
+                break;
+            case OP_GET_LOCAL:
+                insn->op = JIT_GET_LOCAL;
+                insn->slot = operand;
+                break;
+            case OP_SET_LOCAL:
+                insn->op = JIT_SET_LOCAL;
+                insn->slot = operand;
+                break;
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+                insn->op = JIT_ARITH;
+                break;
+            case OP_EQUAL:
+            case OP_NOT_EQUAL:
+            case OP_LESS:
+            case OP_LESS_EQUAL:
+            case OP_GREATER:
+            case OP_GREATER_EQUAL:
+                insn->op = JIT_COMPARE;
+                break;
+            case OP_NOT:
+                insn->op = JIT_NOT;
+                break;
+            case OP_JUMP:
+                insn->op = JIT_JUMP;
+                insn->target = ends[count] + operand;
+                break;
+            case OP_LOOP:
+                insn->op = JIT_JUMP;
+                insn->target = ends[count] + 1 - operand;
+                break;
+            case OP_JUMP_IF_FALSE:
+            case OP_JUMP_IF_TRUE:
+                insn->op = JIT_JUMP_IF;
+                insn->target = ends[count] + operand;
+                break;
+            case OP_ADD_LOCAL_CONST:
+            case OP_SUB_LOCAL_CONST:
+            case OP_LOCAL_LESS_CONST_JUMP_IF_FALSE:
+            case OP_LOCAL_LESS_EQUAL_CONST_JUMP_IF_FALSE:
+            case OP_LOCAL_GREATER_CONST_JUMP_IF_FALSE:
+            case OP_LOCAL_GREATER_EQUAL_CONST_JUMP_IF_FALSE:
+                // Only number constants have a template; the interpreter
+                // handles the rest through the unfused opcodes
+                if (operand >= chunk->const_count || chunk->constants[operand].type != EMBER_VAL_NUMBER) {
+                    set_exit(insn);
+                    break;
+                }
+                insn->constant = chunk->constants[operand];
+                if (op == OP_ADD_LOCAL_CONST || op == OP_SUB_LOCAL_CONST) {
+                    insn->op = JIT_LOCAL_ARITH_CONST;
+                } else {
+                    insn->op = JIT_LOCAL_COMPARE_JUMP;
+                    insn->target = ends[count] + read_chunk_u16(chunk, offset + 5);
+                }
+                break;
+            default:
+                set_exit(insn);
+                break;
+        }
+        offset += length;
+        count++;
+    }
+    insns[count].op = JIT_EXIT;
+    insns[count].opcode = OP_HALT;
+    insns[count].offset = chunk->count;
+    insns[count].target = -1;
+    index_at[chunk->count] = count;
+
+    // Pass 2: jump targets from byte offsets to instruction indices
+    for (int i = 0; i < count; i++) {
+        if (insns[i].target < 0) continue;
+        int target = insns[i].target;
+        if (target > chunk->count || index_at[target] < 0) {
+            // Into the middle of an instruction: leave it to the interpreter
+            set_exit(&insns[i]);
+            insns[i].target = -1;
+            continue;
+        }
+        insns[i].target = index_at[target];
+    }
+    free(index_at);
+    free(ends);
+    *out = insns;
+    return count + 1;
+}
+
+// ============================================================================
+// STACK DEPTH
+// ============================================================================
+
+// Values an instruction pops, and what it leaves in their place
+static void stack_effect(const jit_insn* insn, int* pops, int* pushes) {
+    *pops = 0;
+    *pushes = 0;
+    switch (insn->op) {
+        case JIT_PUSH_VALUE:
+        case JIT_GET_LOCAL:    *pushes = 1; break;
+        case JIT_POP:          *pops = 1; break;
+        case JIT_SET_LOCAL:
+        case JIT_NOT:          *pops = 1; *pushes = 1; break;
+        case JIT_ARITH:
+        case JIT_COMPARE:      *pops = 2; *pushes = 1; break;
+        case JIT_JUMP_IF:      *pops = 1; break;
+        default: break;
+    }
+}
+
+static int falls_through(const jit_insn* insn) {
+    return insn->op != JIT_EXIT && insn->op != JIT_JUMP;
+}
+
+// Depth of every reachable instruction relative to the function start. An
+// instruction that would pop below it becomes an exit. Returns the maximum
+// depth, or -1 if two paths reach an instruction at different depths
+static int compute_depths(jit_insn* insns, int count) {
+    int* worklist = malloc(sizeof(int) * (size_t)count);
+    char* reached = calloc((size_t)count, 1);
+    if (!worklist || !reached) {
+        free(worklist);
+        free(reached);
+        return -1;
+    }
+    int max_depth = 0;
+    int pending = 0;
+    worklist[pending++] = 0;
+    reached[0] = 1;
+    insns[0].depth = 0;
+    int consistent = 1;
+
+    while (pending > 0 && consistent) {
+        int i = worklist[--pending];
+        jit_insn* insn = &insns[i];
+        int pops, pushes;
+        stack_effect(insn, &pops, &pushes);
+        if (insn->depth < pops) {
+            set_exit(insn);
+            insn->target = -1;
+            continue;
+        }
+        int after = insn->depth - pops + pushes;
+        if (after > max_depth) max_depth = after;
+
+        int successors[2];
+        int successor_count = 0;
+        if (falls_through(insn) && i + 1 < count) successors[successor_count++] = i + 1;
+        if (insn->op != JIT_EXIT && insn->target >= 0) successors[successor_count++] = insn->target;
+        for (int s = 0; s < successor_count; s++) {
+            int next = successors[s];
+            if (!reached[next]) {
+                reached[next] = 1;
+                insns[next].depth = after;
+                worklist[pending++] = next;
+            } else if (insns[next].depth != after) {
+                consistent = 0;
+            }
+        }
+    }
+    // Backward jumps to reached instructions are the loop headers
+    for (int i = 0; i < count; i++) {
+        if (!reached[i]) continue;
+        if (insns[i].op == JIT_JUMP && insns[i].target >= 0 && insns[i].target <= i) {
+            insns[insns[i].target].is_entry = 1;
+        }
+    }
+    insns[0].is_entry = 1;
+    free(worklist);
+    free(reached);
+    return consistent ? max_depth : -1;
+}
+
+// ============================================================================
+// CODE MEMORY
+// ============================================================================
+
+static void* code_map(size_t size) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_JIT
+    flags |= MAP_JIT;
+#endif
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    return memory == MAP_FAILED ? NULL : memory;
+}
+
+// Writable until here, executable from here on: never both
+static int code_seal(void* memory, size_t size) {
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) return 0;
+    __builtin___clear_cache((char*)memory, (char*)memory + size);
+    return 1;
+}
+
+static void code_free(struct ember_jit_code* code) {
+    if (!code) return;
+    if (code->memory) munmap(code->memory, code->mapped);
+    free(code->entries);
+    free(code);
+}
+
+// ============================================================================
+// COMPILATION
+// ============================================================================
+
+static struct ember_jit_code* compile(const ember_chunk* chunk) {
+    if (!chunk->code || chunk->count <= 0) return NULL;
+    jit_insn* insns = NULL;
+    int count = decode(chunk, &insns);
+    if (count <= 0) return NULL;
+    int max_depth = compute_depths(insns, count);
+    uint32_t* native_offsets = malloc(sizeof(uint32_t) * (size_t)count);
+    struct ember_jit_code* code = calloc(1, sizeof(struct ember_jit_code));
+    if (max_depth < 0 || !native_offsets || !code) {
+        free(insns);
+        free(native_offsets);
+        free(code);
+        return NULL;
+    }
+
+    code->max_depth = max_depth;
+    code->max_slot = -1;
+    for (int i = 0; i < count; i++) {
+        if (insns[i].is_entry) code->entry_count++;
+        if (insns[i].op == JIT_GET_LOCAL || insns[i].op == JIT_SET_LOCAL ||
+            insns[i].op == JIT_LOCAL_ARITH_CONST || insns[i].op == JIT_LOCAL_COMPARE_JUMP) {
+            if (insns[i].slot > code->max_slot) code->max_slot = insns[i].slot;
+        }
+    }
+
+    jit_program program = { insns, count, chunk->code, native_offsets };
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t capacity = (size_t)count * jit_backend_size_hint() + 256;
+    int emitted = 0;
+    for (int attempt = 0; attempt < 3 && !emitted; attempt++) {
+        capacity = (capacity + page - 1) / page * page;
+        uint8_t* memory = code_map(capacity);
+        if (!memory) break;
+        jit_buffer buffer = { memory, 0, capacity, 0 };
+        if (jit_backend_emit(&buffer, &program) && !buffer.overflow) {
+            code->memory = memory;
+            code->mapped = capacity;
+            code->size = buffer.size;
+            emitted = 1;
+        } else {
+            munmap(memory, capacity);
+            if (!buffer.overflow) break;
+            capacity *= 2;
+        }
+    }
+
+    code->entries = emitted ? malloc(sizeof(jit_entry) * (size_t)code->entry_count) : NULL;
+    if (!emitted || !code->entries || !code_seal(code->memory, code->mapped)) {
+        free(insns);
+        free(native_offsets);
+        code_free(code);
+        return NULL;
+    }
+    int entry = 0;
+    for (int i = 0; i < count; i++) {
+        if (!insns[i].is_entry) continue;
+        code->entries[entry].offset = insns[i].offset;
+        code->entries[entry].depth = insns[i].depth;
+        code->entries[entry].native = native_offsets[i];
+        entry++;
+    }
+    code->fn = (jit_native_fn)(uintptr_t)code->memory;
+    code->bytecode = chunk->code;
+    code->bytecode_length = chunk->count;
+    jit_perf_code_load(chunk, code->memory, code->size, &program);
+    free(insns);
+    free(native_offsets);
+    return code;
+}
+
+// ============================================================================
+// ENTRY
+// ============================================================================
+
+static const jit_entry* find_entry(const struct ember_jit_code* code, int offset) {
+    int low = 0;
+    int high = code->entry_count - 1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (code->entries[mid].offset == offset) return &code->entries[mid];
+        if (code->entries[mid].offset < offset) low = mid + 1;
+        else high = mid - 1;
+    }
+    return NULL;
+}
+
+static void discard(ember_chunk* chunk) {
+    code_free(chunk->jit_code);
+    chunk->jit_code = NULL;
+    chunk->jit_blacklisted = 1;
+}
+
+// Counts one call or iteration of vm->chunk and runs its native code from
+// vm->ip if it has some (compiling it first once it is hot)
+static void jit_enter(ember_vm* vm) {
+    ember_chunk* chunk = vm->chunk;
+    if (!chunk || chunk->jit_blacklisted) return;
+    struct ember_jit_code* code = chunk->jit_code;
+    if (code && (code->bytecode != chunk->code || code->bytecode_length != chunk->count)) {
+        // The chunk grew (or its code moved) since it was compiled
+        code_free(code);
+        chunk->jit_code = code = NULL;
+        chunk->jit_counter = 0;
+    }
+    if (!code) {
+        uint32_t threshold = vm->jit_threshold ? vm->jit_threshold : JIT_DEFAULT_THRESHOLD;
+        if (++chunk->jit_counter < threshold) return;
+        code = compile(chunk);
+        if (!code) {
+            chunk->jit_blacklisted = 1;
+            return;
+        }
+        chunk->jit_code = code;
+        vm->jit_compilations++;
+    }
+
+    const jit_entry* entry = find_entry(code, (int)(vm->ip - chunk->code));
+    if (!entry) return;
+    // Room for the deepest point of the code and every slot it touches
+    if (vm->stack_top < entry->depth ||
+        vm->stack_top - entry->depth + code->max_depth > EMBER_STACK_MAX ||
+        vm->local_base + code->max_slot >= EMBER_LOCALS_MAX) {
+        return;
+    }
+    code->runs++;
+    if (code->fn(vm, code->memory + entry->native) == JIT_STATUS_DEOPT) {
+        code->deopts++;
+        vm->jit_deopts++;
+        if (code->deopts > JIT_DEOPT_LIMIT && code->deopts * JIT_DEOPT_RATIO > code->runs) {
+            discard(chunk);
+        }
+    }
+}
+
+// Native loops spend no fuel (vm_fuel.c), so a VM with a budget stays in
+// the interpreter
+void vm_jit_on_call(ember_vm* vm) {
+    if (vm->jit_enabled && !vm->fuel_slice) jit_enter(vm);
+}
+
+void vm_jit_on_loop(ember_vm* vm) {
+    if (vm->jit_enabled && !vm->fuel_slice) jit_enter(vm);
+}
+
+void vm_jit_free_chunk(ember_chunk* chunk) {
+    if (!chunk) return;
+    code_free(chunk->jit_code);
+    chunk->jit_code = NULL;
+}
+
+int ember_jit_available(void) {
+    return 1;
+}
+
+#else
+
+// Built without ENABLE_JIT_COMPILER or for another architecture: the hooks
+// do nothing and chunks never carry code
+
+void vm_jit_on_call(ember_vm* vm) {
+    (void)vm;
+}
+
+void vm_jit_on_loop(ember_vm* vm) {
+    (void)vm;
+}
+
+void vm_jit_free_chunk(ember_chunk* chunk) {
+    (void)chunk;
+}
+
+int ember_jit_available(void) {
+    return 0;
+}
+
+#endif
+
+int ember_jit_configure(ember_vm* vm, int enabled, int threshold) {
+    if (!vm || threshold < 0) return EMBER_ERROR_INVALID_PARAMETER;
+    if (enabled && !ember_jit_available()) return EMBER_ERROR_INVALID_PARAMETER;
+    vm->jit_enabled = enabled ? true : false;
+    vm->jit_threshold = (uint32_t)threshold;
+    return EMBER_SUCCESS;
+}
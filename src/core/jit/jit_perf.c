@@ -0,0 +1,253 @@
+#define _GNU_SOURCE
+#include "jit.h"
+#include "../../vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Linux perf support for JIT code. perf cannot symbolize anonymous
+// executable mappings, so native frames of compiled chunks show up as raw
+// addresses. While enabled, every chunk the JIT compiles is announced as
+// it is sealed:
+//
+//   - EMBER_PERF_MAP appends "start size ember:name" to /tmp/perf-<pid>.map,
+//     which `perf report` reads on its own.
+//   - EMBER_PERF_JITDUMP appends a code load record, with the machine code
+//     and a line table, to /tmp/jit-<pid>.dump. The file stays mapped
+//     executable so `perf record -k mono` notes where it is; `perf inject
+//     --jit` then turns it into per-function ELF images, and `perf annotate`
+//     can show Ember source lines.
+//
+// Both are process-wide: every VM's compilations go to the same files.
+// Interpreted code has no native frames of its own and stays in ember_run.
+
+#if EMBER_JIT_AVAILABLE && defined(__linux__)
+
+#include <elf.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// tools/perf/Documentation/jitdump-specification.txt
+#define JITDUMP_MAGIC 0x4A695444
+#define JITDUMP_VERSION 1
+#define JIT_CODE_LOAD 0
+#define JIT_CODE_DEBUG_INFO 2
+#define JIT_CODE_CLOSE 3
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t total_size;
+    uint32_t elf_mach;
+    uint32_t pad1;
+    uint32_t pid;
+    uint64_t timestamp;
+    uint64_t flags;
+} jitdump_header;
+
+typedef struct {
+    uint32_t id;
+    uint32_t total_size;       // Including this header and what follows
+    uint64_t timestamp;
+} jitdump_record;
+
+// Followed by the name and the code bytes
+typedef struct {
+    jitdump_record record;
+    uint32_t pid;
+    uint32_t tid;
+    uint64_t vma;
+    uint64_t code_addr;
+    uint64_t code_size;
+    uint64_t code_index;
+} jitdump_code_load;
+
+// Followed by nr_entry jitdump_debug_entry, each followed by a file name
+typedef struct {
+    jitdump_record record;
+    uint64_t code_addr;
+    uint64_t nr_entry;
+} jitdump_debug_info;
+
+typedef struct {
+    uint64_t code_addr;
+    uint32_t line;
+    uint32_t discrim;
+} jitdump_debug_entry;
+
+static pthread_mutex_t perf_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE* perf_map;
+static FILE* perf_dump;
+static void* perf_dump_marker;     // Mapping perf finds the dump by
+static size_t perf_dump_marker_size;
+static uint64_t perf_code_index;
+
+// The clock perf record -k mono stamps samples with
+static uint64_t perf_timestamp(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static FILE* open_perf_file(const char* pattern, const char* mode) {
+    char path[64];
+    snprintf(path, sizeof(path), pattern, (int)getpid());
+    FILE* file = fopen(path, mode);
+    if (!file) fprintf(stderr, "[JIT] Cannot write %s\n", path);
+    return file;
+}
+
+static int open_dump(void) {
+    // Readable too: mmap needs it
+    perf_dump = open_perf_file("/tmp/jit-%d.dump", "w+");
+    if (!perf_dump) return 0;
+    jitdump_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = JITDUMP_MAGIC;
+    header.version = JITDUMP_VERSION;
+    header.total_size = sizeof(header);
+#if defined(__x86_64__)
+    header.elf_mach = EM_X86_64;
+#else
+    header.elf_mach = EM_AARCH64;
+#endif
+    header.pid = (uint32_t)getpid();
+    header.timestamp = perf_timestamp();
+    fwrite(&header, sizeof(header), 1, perf_dump);
+    fflush(perf_dump);
+
+    perf_dump_marker_size = (size_t)sysconf(_SC_PAGESIZE);
+    perf_dump_marker = mmap(NULL, perf_dump_marker_size, PROT_READ | PROT_EXEC, MAP_PRIVATE, fileno(perf_dump), 0);
+    if (perf_dump_marker == MAP_FAILED) {
+        perf_dump_marker = NULL;
+        fclose(perf_dump);
+        perf_dump = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+static void close_dump(void) {
+    jitdump_record close_record = { JIT_CODE_CLOSE, sizeof(jitdump_record), perf_timestamp() };
+    fwrite(&close_record, sizeof(close_record), 1, perf_dump);
+    if (perf_dump_marker) munmap(perf_dump_marker, perf_dump_marker_size);
+    perf_dump_marker = NULL;
+    fclose(perf_dump);
+    perf_dump = NULL;
+}
+
+int ember_jit_perf_enable(int flags) {
+    if (flags & ~(EMBER_PERF_MAP | EMBER_PERF_JITDUMP)) return EMBER_ERROR_INVALID_PARAMETER;
+    int result = EMBER_SUCCESS;
+    pthread_mutex_lock(&perf_lock);
+    if ((flags & EMBER_PERF_MAP) && !perf_map) {
+        perf_map = open_perf_file("/tmp/perf-%d.map", "w");
+        if (!perf_map) result = EMBER_ERROR_OPERATION_FAILED;
+    } else if (!(flags & EMBER_PERF_MAP) && perf_map) {
+        fclose(perf_map);
+        perf_map = NULL;
+    }
+    if ((flags & EMBER_PERF_JITDUMP) && !perf_dump) {
+        if (!open_dump()) result = EMBER_ERROR_OPERATION_FAILED;
+    } else if (!(flags & EMBER_PERF_JITDUMP) && perf_dump) {
+        close_dump();
+    }
+    pthread_mutex_unlock(&perf_lock);
+    return result;
+}
+
+// Symbol for a chunk: its function name, else where it starts
+static void chunk_symbol(const ember_chunk* chunk, char* symbol, size_t size) {
+    int line = ember_chunk_line_at(chunk, 0);
+    if (chunk->name) {
+        snprintf(symbol, size, "ember:%s", chunk->name);
+    } else if (line > 0) {
+        snprintf(symbol, size, "ember:<anonymous:%d>", line);
+    } else {
+        snprintf(symbol, size, "ember:<anonymous>");
+    }
+}
+
+// One entry per change of source line, at the first instruction on it
+static void write_debug_info(const ember_chunk* chunk, const uint8_t* code, const jit_program* program,
+                             const char* file, uint64_t timestamp) {
+    size_t file_size = strlen(file) + 1;
+    uint64_t entries = 0;
+    int last_line = 0;
+    for (int i = 0; i < program->count; i++) {
+        int line = ember_chunk_line_at(chunk, program->insns[i].offset);
+        if (line > 0 && line != last_line) entries++;
+        if (line > 0) last_line = line;
+    }
+    if (!entries) return;
+
+    jitdump_debug_info info;
+    info.record.id = JIT_CODE_DEBUG_INFO;
+    info.record.total_size = (uint32_t)(sizeof(info) + entries * (sizeof(jitdump_debug_entry) + file_size));
+    info.record.timestamp = timestamp;
+    info.code_addr = (uint64_t)(uintptr_t)code;
+    info.nr_entry = entries;
+    fwrite(&info, sizeof(info), 1, perf_dump);
+    last_line = 0;
+    for (int i = 0; i < program->count; i++) {
+        int line = ember_chunk_line_at(chunk, program->insns[i].offset);
+        if (line <= 0 || line == last_line) continue;
+        jitdump_debug_entry entry = { (uint64_t)(uintptr_t)(code + program->native_offsets[i]), (uint32_t)line, 0 };
+        fwrite(&entry, sizeof(entry), 1, perf_dump);
+        fwrite(file, file_size, 1, perf_dump);
+        last_line = line;
+    }
+}
+
+void jit_perf_code_load(const ember_chunk* chunk, const uint8_t* code, size_t size, const jit_program* program) {
+    char symbol[256];
+    chunk_symbol(chunk, symbol, sizeof(symbol));
+
+    // Compilations are rare enough to take the lock even with perf off
+    pthread_mutex_lock(&perf_lock);
+    if (perf_map) {
+        fprintf(perf_map, "%lx %zx %s\n", (unsigned long)(uintptr_t)code, size, symbol);
+        fflush(perf_map);
+    }
+    if (perf_dump) {
+        uint64_t timestamp = perf_timestamp();
+        // Lines are reported against the symbol, there being no file name
+        write_debug_info(chunk, code, program, symbol, timestamp);
+        size_t name_size = strlen(symbol) + 1;
+        jitdump_code_load load;
+        load.record.id = JIT_CODE_LOAD;
+        load.record.total_size = (uint32_t)(sizeof(load) + name_size + size);
+        load.record.timestamp = timestamp;
+        load.pid = (uint32_t)getpid();
+        load.tid = (uint32_t)syscall(SYS_gettid);
+        load.vma = (uint64_t)(uintptr_t)code;
+        load.code_addr = (uint64_t)(uintptr_t)code;
+        load.code_size = size;
+        load.code_index = perf_code_index++;
+        fwrite(&load, sizeof(load), 1, perf_dump);
+        fwrite(symbol, name_size, 1, perf_dump);
+        fwrite(code, size, 1, perf_dump);
+        fflush(perf_dump);
+    }
+    pthread_mutex_unlock(&perf_lock);
+}
+
+#else
+
+// No JIT, or not Linux: there is nothing for perf to symbolize
+
+int ember_jit_perf_enable(int flags) {
+    return flags ? EMBER_ERROR_INVALID_PARAMETER : EMBER_SUCCESS;
+}
+
+void jit_perf_code_load(const ember_chunk* chunk, const uint8_t* code, size_t size, const jit_program* program) {
+    (void)chunk;
+    (void)code;
+    (void)size;
+    (void)program;
+}
+
+#endif
@@ -0,0 +1,388 @@
+#include "jit.h"
+#include "../../vm.h"
+#include <stdlib.h>
+#include <string.h>
+
+// x86-64 templates for the baseline JIT (System V calling convention).
+//
+// Register assignment while native code runs:
+//   rbx  vm
+//   r12  &vm->locals[vm->local_base]   (slot 0)
+//   r13  &vm->stack[vm->stack_top]     (next free value)
+//   r14  vm->local_base
+// rax, rcx, rdx and xmm0-xmm2 are scratch. Every template keeps the hot path
+// straight-line; guards branch forward to a per-instruction stub that
+// stores vm->ip and leaves through the shared exit, which writes r13 back
+// to vm->stack_top.
+
+#if EMBER_JIT_AVAILABLE && defined(__x86_64__)
+
+#include <stddef.h>
+
+// Templates address values as 24-byte {type, payload, second payload word};
+// a number's second word is its small int and flag, which arithmetic clears
+typedef char jit_value_layout_check[(sizeof(ember_value) == 24 && offsetof(ember_value, type) == 0 &&
+                                     offsetof(ember_value, as) == 8 &&
+                                     offsetof(ember_value, as.number.is_small) == 20) ? 1 : -1];
+
+#define VALUE_SIZE 24
+#define TOP_TYPE (-24)
+#define TOP_PAYLOAD (-16)
+#define SECOND_TYPE (-48)
+#define SECOND_PAYLOAD (-40)
+
+typedef enum {
+    PATCH_INSN,             // Start of an instruction
+    PATCH_DEOPT,            // Deopt stub of an instruction
+    PATCH_COMMON            // Shared exit
+} patch_kind;
+
+typedef struct {
+    size_t at;              // rel32 field
+    patch_kind kind;
+    int index;
+} patch;
+
+typedef struct {
+    jit_buffer* buffer;
+    patch* patches;
+    int patch_count;
+    int patch_capacity;
+    int* needs_deopt;
+} emitter;
+
+static void put8(emitter* e, uint8_t byte) {
+    jit_buffer_put(e->buffer, &byte, 1);
+}
+
+static void put_bytes(emitter* e, const uint8_t* bytes, size_t length) {
+    jit_buffer_put(e->buffer, bytes, length);
+}
+
+static void put32(emitter* e, uint32_t value) {
+    uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+    put_bytes(e, bytes, 4);
+}
+
+static void put64(emitter* e, uint64_t value) {
+    put32(e, (uint32_t)value);
+    put32(e, (uint32_t)(value >> 32));
+}
+
+#define EMIT(e, ...) do { \
+        static const uint8_t bytes_[] = { __VA_ARGS__ }; \
+        put_bytes((e), bytes_, sizeof(bytes_)); \
+    } while (0)
+
+static int add_patch(emitter* e, patch_kind kind, int index) {
+    if (e->patch_count == e->patch_capacity) {
+        int capacity = e->patch_capacity ? e->patch_capacity * 2 : 64;
+        patch* patches = realloc(e->patches, sizeof(patch) * (size_t)capacity);
+        if (!patches) return 0;
+        e->patches = patches;
+        e->patch_capacity = capacity;
+    }
+    e->patches[e->patch_count].at = e->buffer->size;
+    e->patches[e->patch_count].kind = kind;
+    e->patches[e->patch_count].index = index;
+    e->patch_count++;
+    put32(e, 0);
+    return 1;
+}
+
+// jcc rel32 (cc is the second opcode byte, 0x80 | condition) or jmp rel32
+static int jump_to(emitter* e, uint8_t cc, patch_kind kind, int index) {
+    if (cc) {
+        put8(e, 0x0F);
+        put8(e, cc);
+    } else {
+        put8(e, 0xE9);
+    }
+    return add_patch(e, kind, index);
+}
+
+#define CC_JE  0x84
+#define CC_JNE 0x85
+#define CC_JGE 0x8D
+
+static int deopt_if(emitter* e, uint8_t cc, int index) {
+    e->needs_deopt[index] = 1;
+    return jump_to(e, cc, PATCH_DEOPT, index);
+}
+
+// cmp dword [r13+disp8], type; jne deopt
+static int guard_stack_type(emitter* e, int8_t disp, int type, int index) {
+    EMIT(e, 0x41, 0x83, 0x7D);
+    put8(e, (uint8_t)disp);
+    put8(e, (uint8_t)type);
+    return deopt_if(e, CC_JNE, index);
+}
+
+// cmp dword [r12+disp32], type; jne deopt
+static int guard_local_type(emitter* e, int32_t disp, int type, int index) {
+    EMIT(e, 0x41, 0x83, 0xBC, 0x24);
+    put32(e, (uint32_t)disp);
+    put8(e, (uint8_t)type);
+    return deopt_if(e, CC_JNE, index);
+}
+
+// Word 0 is the number, bool or pointer; word 1 only matters for functions
+static uint64_t payload_bits(const ember_value* value, int word) {
+    uint64_t bits;
+    memcpy(&bits, (const uint8_t*)&value->as + word * 8, sizeof(bits));
+    return bits;
+}
+
+// al = compare(xmm0, xmm1) for a plain comparison opcode
+static void emit_setcc(emitter* e, uint8_t opcode) {
+    switch (opcode) {
+        case OP_LESS:          EMIT(e, 0x66, 0x0F, 0x2E, 0xC8, 0x0F, 0x97, 0xC0); break;  // ucomisd xmm1,xmm0; seta
+        case OP_LESS_EQUAL:    EMIT(e, 0x66, 0x0F, 0x2E, 0xC8, 0x0F, 0x93, 0xC0); break;  // ucomisd xmm1,xmm0; setae
+        case OP_GREATER:       EMIT(e, 0x66, 0x0F, 0x2E, 0xC1, 0x0F, 0x97, 0xC0); break;  // ucomisd xmm0,xmm1; seta
+        case OP_GREATER_EQUAL: EMIT(e, 0x66, 0x0F, 0x2E, 0xC1, 0x0F, 0x93, 0xC0); break;  // ucomisd xmm0,xmm1; setae
+        case OP_EQUAL:
+            // Unordered (NaN) is not equal: sete al; setnp cl; and al, cl
+            EMIT(e, 0x66, 0x0F, 0x2E, 0xC1, 0x0F, 0x94, 0xC0, 0x0F, 0x9B, 0xC1, 0x20, 0xC8);
+            break;
+        default:
+            // OP_NOT_EQUAL: setne al; setp cl; or al, cl
+            EMIT(e, 0x66, 0x0F, 0x2E, 0xC1, 0x0F, 0x95, 0xC0, 0x0F, 0x9A, 0xC1, 0x08, 0xC8);
+            break;
+    }
+}
+
+// mov rax, imm64; movq xmm1, rax
+static void load_constant_xmm1(emitter* e, const ember_value* constant) {
+    EMIT(e, 0x48, 0xB8);
+    put64(e, payload_bits(constant, 0));
+    EMIT(e, 0x66, 0x48, 0x0F, 0x6E, 0xC8);
+}
+
+// movsd xmm0, [r12 + slot payload]
+static void load_local_xmm0(emitter* e, int32_t disp) {
+    EMIT(e, 0xF2, 0x41, 0x0F, 0x10, 0x84, 0x24);
+    put32(e, (uint32_t)(disp + 8));
+}
+
+static void emit_prologue(emitter* e) {
+    EMIT(e, 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56);        // push rbx, r12, r13, r14
+    EMIT(e, 0x48, 0x89, 0xFB);                                  // mov rbx, rdi
+    EMIT(e, 0x4C, 0x63, 0xB3);                                  // movsxd r14, [rbx+local_base]
+    put32(e, (uint32_t)offsetof(ember_vm, local_base));
+    EMIT(e, 0x49, 0x6B, 0xC6, VALUE_SIZE);                      // imul rax, r14, 24
+    EMIT(e, 0x4C, 0x8D, 0xA4, 0x03);                            // lea r12, [rbx+rax+locals]
+    put32(e, (uint32_t)offsetof(ember_vm, locals));
+    EMIT(e, 0x48, 0x63, 0x83);                                  // movsxd rax, [rbx+stack_top]
+    put32(e, (uint32_t)offsetof(ember_vm, stack_top));
+    EMIT(e, 0x48, 0x6B, 0xC0, VALUE_SIZE);                      // imul rax, rax, 24
+    EMIT(e, 0x4C, 0x8D, 0xAC, 0x03);                            // lea r13, [rbx+rax+stack]
+    put32(e, (uint32_t)offsetof(ember_vm, stack));
+    EMIT(e, 0xFF, 0xE6);                                        // jmp rsi
+}
+
+// vm->ip = bytecode + offset; eax = status; jmp common exit
+static int emit_exit(emitter* e, const jit_program* program, int offset, int status) {
+    EMIT(e, 0x48, 0xB9);                                        // mov rcx, imm64
+    put64(e, (uint64_t)(uintptr_t)(program->bytecode + offset));
+    EMIT(e, 0x48, 0x89, 0x8B);                                  // mov [rbx+ip], rcx
+    put32(e, (uint32_t)offsetof(ember_vm, ip));
+    put8(e, 0xB8);                                              // mov eax, status
+    put32(e, (uint32_t)status);
+    return jump_to(e, 0, PATCH_COMMON, 0);
+}
+
+static void emit_common_exit(emitter* e) {
+    EMIT(e, 0x48, 0x8D, 0x8B);                                  // lea rcx, [rbx+stack]
+    put32(e, (uint32_t)offsetof(ember_vm, stack));
+    EMIT(e, 0x4C, 0x89, 0xEA, 0x48, 0x29, 0xCA);                // mov rdx, r13; sub rdx, rcx
+    // Exact division by 24: shift out the 8, multiply by the inverse of 3
+    EMIT(e, 0x48, 0xC1, 0xEA, 0x03);                            // shr rdx, 3
+    EMIT(e, 0x48, 0xB9);                                        // mov rcx, 0xAAAAAAAAAAAAAAAB
+    put64(e, 0xAAAAAAAAAAAAAAABull);
+    EMIT(e, 0x48, 0x0F, 0xAF, 0xD1);                            // imul rdx, rcx
+    EMIT(e, 0x89, 0x93);                                        // mov [rbx+stack_top], edx
+    put32(e, (uint32_t)offsetof(ember_vm, stack_top));
+    EMIT(e, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3);    // pop r14, r13, r12, rbx; ret
+}
+
+static int emit_insn(emitter* e, const jit_program* program, int i) {
+    const jit_insn* insn = &program->insns[i];
+    int32_t local = insn->slot * VALUE_SIZE;
+    switch (insn->op) {
+        case JIT_PUSH_VALUE:
+            EMIT(e, 0x41, 0xC7, 0x45, 0x00);                    // mov dword [r13], type
+            put32(e, (uint32_t)insn->constant.type);
+            EMIT(e, 0x48, 0xB8);                                // mov rax, payload
+            put64(e, payload_bits(&insn->constant, 0));
+            EMIT(e, 0x49, 0x89, 0x45, 0x08);                    // mov [r13+8], rax
+            EMIT(e, 0x48, 0xB8);                                // mov rax, payload word 1
+            put64(e, payload_bits(&insn->constant, 1));
+            EMIT(e, 0x49, 0x89, 0x45, 0x10);                    // mov [r13+16], rax
+            EMIT(e, 0x49, 0x83, 0xC5, VALUE_SIZE);              // add r13, 24
+            return 1;
+
+        case JIT_POP:
+            EMIT(e, 0x49, 0x83, 0xED, VALUE_SIZE);              // sub r13, 24
+            return 1;
+
+        case JIT_GET_LOCAL:
+            // The slot must be live: local_base + slot < local_count
+            EMIT(e, 0x41, 0x8D, 0x86);                          // lea eax, [r14+slot]
+            put32(e, (uint32_t)insn->slot);
+            EMIT(e, 0x3B, 0x83);                                // cmp eax, [rbx+local_count]
+            put32(e, (uint32_t)offsetof(ember_vm, local_count));
+            if (!deopt_if(e, CC_JGE, i)) return 0;
+            EMIT(e, 0xF3, 0x41, 0x0F, 0x6F, 0x84, 0x24);        // movdqu xmm0, [r12+slot]
+            put32(e, (uint32_t)local);
+            EMIT(e, 0x49, 0x8B, 0x84, 0x24);                    // mov rax, [r12+slot+16]
+            put32(e, (uint32_t)(local + 16));
+            EMIT(e, 0xF3, 0x41, 0x0F, 0x7F, 0x45, 0x00);        // movdqu [r13], xmm0
+            EMIT(e, 0x49, 0x89, 0x45, 0x10);                    // mov [r13+16], rax
+            EMIT(e, 0x49, 0x83, 0xC5, VALUE_SIZE);              // add r13, 24
+            return 1;
+
+        case JIT_SET_LOCAL:
+            EMIT(e, 0xF3, 0x41, 0x0F, 0x6F, 0x45, 0xE8);        // movdqu xmm0, [r13-24]
+            EMIT(e, 0x49, 0x8B, 0x45, 0xF8);                    // mov rax, [r13-8]
+            EMIT(e, 0xF3, 0x41, 0x0F, 0x7F, 0x84, 0x24);        // movdqu [r12+slot], xmm0
+            put32(e, (uint32_t)local);
+            EMIT(e, 0x49, 0x89, 0x84, 0x24);                    // mov [r12+slot+16], rax
+            put32(e, (uint32_t)(local + 16));
+            // local_count = max(local_count, local_base + slot + 1)
+            EMIT(e, 0x41, 0x8D, 0x86);                          // lea eax, [r14+slot+1]
+            put32(e, (uint32_t)(insn->slot + 1));
+            EMIT(e, 0x3B, 0x83);                                // cmp eax, [rbx+local_count]
+            put32(e, (uint32_t)offsetof(ember_vm, local_count));
+            EMIT(e, 0x7E, 0x06);                                // jle +6
+            EMIT(e, 0x89, 0x83);                                // mov [rbx+local_count], eax
+            put32(e, (uint32_t)offsetof(ember_vm, local_count));
+            return 1;
+
+        case JIT_ARITH:
+            if (!guard_stack_type(e, SECOND_TYPE, EMBER_VAL_NUMBER, i) ||
+                !guard_stack_type(e, TOP_TYPE, EMBER_VAL_NUMBER, i)) {
+                return 0;
+            }
+            EMIT(e, 0xF2, 0x41, 0x0F, 0x10, 0x45, 0xD8);        // movsd xmm0, [r13-40]
+            switch (insn->opcode) {
+                case OP_ADD: EMIT(e, 0xF2, 0x41, 0x0F, 0x58, 0x45, 0xF0); break;  // addsd xmm0, [r13-16]
+                case OP_SUB: EMIT(e, 0xF2, 0x41, 0x0F, 0x5C, 0x45, 0xF0); break;  // subsd
+                case OP_MUL: EMIT(e, 0xF2, 0x41, 0x0F, 0x59, 0x45, 0xF0); break;  // mulsd
+                default:
+                    // Division by zero (or NaN) is the interpreter's to report
+                    EMIT(e, 0xF2, 0x41, 0x0F, 0x10, 0x4D, 0xF0);  // movsd xmm1, [r13-16]
+                    EMIT(e, 0x66, 0x0F, 0x57, 0xD2);              // xorpd xmm2, xmm2
+                    EMIT(e, 0x66, 0x0F, 0x2E, 0xCA);              // ucomisd xmm1, xmm2
+                    if (!deopt_if(e, CC_JE, i)) return 0;
+                    EMIT(e, 0xF2, 0x0F, 0x5E, 0xC1);              // divsd xmm0, xmm1
+                    break;
+            }
+            EMIT(e, 0xF2, 0x41, 0x0F, 0x11, 0x45, 0xD8);        // movsd [r13-40], xmm0
+            EMIT(e, 0x41, 0xC7, 0x45, 0xE4, 0, 0, 0, 0);        // mov dword [r13-28], 0 (not a small int)
+            EMIT(e, 0x49, 0x83, 0xED, VALUE_SIZE);              // sub r13, 24
+            return 1;
+
+        case JIT_COMPARE:
+            if (!guard_stack_type(e, SECOND_TYPE, EMBER_VAL_NUMBER, i) ||
+                !guard_stack_type(e, TOP_TYPE, EMBER_VAL_NUMBER, i)) {
+                return 0;
+            }
+            EMIT(e, 0xF2, 0x41, 0x0F, 0x10, 0x45, 0xD8);        // movsd xmm0, [r13-40]
+            EMIT(e, 0xF2, 0x41, 0x0F, 0x10, 0x4D, 0xF0);        // movsd xmm1, [r13-16]
+            emit_setcc(e, insn->opcode);
+            EMIT(e, 0x0F, 0xB6, 0xC0);                          // movzx eax, al
+            EMIT(e, 0x41, 0xC7, 0x45, 0xD0);                    // mov dword [r13-48], BOOL
+            put32(e, (uint32_t)EMBER_VAL_BOOL);
+            EMIT(e, 0x49, 0x89, 0x45, 0xD8);                    // mov [r13-40], rax
+            EMIT(e, 0x49, 0x83, 0xED, VALUE_SIZE);              // sub r13, 24
+            return 1;
+
+        case JIT_NOT:
+            if (!guard_stack_type(e, TOP_TYPE, EMBER_VAL_BOOL, i)) return 0;
+            EMIT(e, 0x41, 0x83, 0x7D, 0xF0, 0x00);              // cmp dword [r13-16], 0
+            EMIT(e, 0x0F, 0x94, 0xC0, 0x0F, 0xB6, 0xC0);        // sete al; movzx eax, al
+            EMIT(e, 0x49, 0x89, 0x45, 0xF0);                    // mov [r13-16], rax
+            return 1;
+
+        case JIT_JUMP:
+            return jump_to(e, 0, PATCH_INSN, insn->target);
+
+        case JIT_JUMP_IF:
+            if (!guard_stack_type(e, TOP_TYPE, EMBER_VAL_BOOL, i)) return 0;
+            EMIT(e, 0x41, 0x8B, 0x45, 0xF0);                    // mov eax, [r13-16]
+            EMIT(e, 0x49, 0x83, 0xED, VALUE_SIZE);              // sub r13, 24
+            EMIT(e, 0x85, 0xC0);                                // test eax, eax
+            return jump_to(e, insn->opcode == OP_JUMP_IF_FALSE ? CC_JE : CC_JNE, PATCH_INSN, insn->target);
+
+        case JIT_LOCAL_ARITH_CONST:
+            if (!guard_local_type(e, local, EMBER_VAL_NUMBER, i)) return 0;
+            load_local_xmm0(e, local);
+            load_constant_xmm1(e, &insn->constant);
+            if (insn->opcode == OP_ADD_LOCAL_CONST) {
+                EMIT(e, 0xF2, 0x0F, 0x58, 0xC1);                // addsd xmm0, xmm1
+            } else {
+                EMIT(e, 0xF2, 0x0F, 0x5C, 0xC1);                // subsd xmm0, xmm1
+            }
+            EMIT(e, 0xF2, 0x41, 0x0F, 0x11, 0x84, 0x24);        // movsd [r12+slot payload], xmm0
+            put32(e, (uint32_t)(local + 8));
+            EMIT(e, 0x41, 0xC7, 0x84, 0x24);                    // mov dword [r12+slot+20], 0 (not a small int)
+            put32(e, (uint32_t)(local + 20));
+            put32(e, 0);
+            return 1;
+
+        case JIT_LOCAL_COMPARE_JUMP:
+            if (!guard_local_type(e, local, EMBER_VAL_NUMBER, i)) return 0;
+            load_local_xmm0(e, local);
+            load_constant_xmm1(e, &insn->constant);
+            emit_setcc(e, opcode_fused_operation(insn->opcode));
+            EMIT(e, 0x84, 0xC0);                                // test al, al
+            return jump_to(e, CC_JE, PATCH_INSN, insn->target);
+
+        case JIT_EXIT:
+        default:
+            return emit_exit(e, program, insn->offset, JIT_STATUS_EXIT);
+    }
+}
+
+size_t jit_backend_size_hint(void) {
+    return 128;
+}
+
+int jit_backend_emit(jit_buffer* buffer, const jit_program* program) {
+    emitter e = { buffer, NULL, 0, 0, NULL };
+    size_t* deopt_at = malloc(sizeof(size_t) * (size_t)program->count);
+    e.needs_deopt = calloc((size_t)program->count, sizeof(int));
+    int ok = deopt_at && e.needs_deopt;
+
+    if (ok) emit_prologue(&e);
+    for (int i = 0; ok && i < program->count; i++) {
+        program->native_offsets[i] = (uint32_t)buffer->size;
+        ok = emit_insn(&e, program, i);
+    }
+    // Deopt stubs out of line, then the shared exit
+    for (int i = 0; ok && i < program->count; i++) {
+        if (!e.needs_deopt[i]) continue;
+        deopt_at[i] = buffer->size;
+        ok = emit_exit(&e, program, program->insns[i].offset, JIT_STATUS_DEOPT);
+    }
+    size_t common_at = buffer->size;
+    if (ok) emit_common_exit(&e);
+
+    for (int p = 0; ok && !buffer->overflow && p < e.patch_count; p++) {
+        const patch* fix = &e.patches[p];
+        size_t target;
+        switch (fix->kind) {
+            case PATCH_INSN:  target = program->native_offsets[fix->index]; break;
+            case PATCH_DEOPT: target = deopt_at[fix->index]; break;
+            default:          target = common_at; break;
+        }
+        int32_t rel = (int32_t)((int64_t)target - (int64_t)(fix->at + 4));
+        memcpy(buffer->code + fix->at, &rel, sizeof(rel));
+    }
+    free(e.patches);
+    free(e.needs_deopt);
+    free(deopt_at);
+    return ok && !buffer->overflow;
+}
+
+#endif
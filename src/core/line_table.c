@@ -0,0 +1,211 @@
+#include "../../include/ember.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Line tables. The compiler marks where each statement's code starts, with
+// the statement's line and column; nothing is recorded per instruction and
+// the dispatch loop never reads the table. Runs are kept as a byte stream:
+// the LEB128 distance from the previous run's start, the zigzag LEB128
+// change of line and the LEB128 column (0 = unknown), so a statement
+// usually costs three bytes. The first lookup (a stack trace, the
+// profiler, a perf map, an allocation site) decodes the stream into
+// chunk->lines for binary search; most chunks are never asked.
+
+#define LINE_RUN_MAX_BYTES 15  // Three 5-byte varints
+
+static uint32_t zigzag(int value) {
+    return value < 0 ? ((uint32_t)(-(value + 1)) << 1) | 1u : (uint32_t)value << 1;
+}
+
+static int unzigzag(uint32_t value) {
+    return (value & 1u) ? -(int)(value >> 1) - 1 : (int)(value >> 1);
+}
+
+static int put_varint(uint8_t* out, uint32_t value) {
+    int length = 0;
+    while (value >= 0x80) {
+        out[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (uint8_t)value;
+    return length;
+}
+
+// 0 if the stream ends inside the varint or it runs past 32 bits
+static int get_varint(const uint8_t* data, int length, int* at, uint32_t* value) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35 && *at < length; shift += 7) {
+        uint8_t byte = data[(*at)++];
+        if (shift == 28 && byte > 0x0F) return 0;
+        result |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Decode the run at *at into run, which holds the previous run (or zeros)
+static int next_run(const uint8_t* data, int length, int* at, ember_line_run* run) {
+    uint32_t start;
+    uint32_t line;
+    uint32_t column;
+    if (!get_varint(data, length, at, &start) || !get_varint(data, length, at, &line) ||
+        !get_varint(data, length, at, &column) || start > (uint32_t)(INT32_MAX - run->start) ||
+        column > INT32_MAX) {
+        return 0;
+    }
+    run->start += (int)start;
+    run->line += unzigzag(line);
+    run->column = (int)column;
+    return run->line > 0;
+}
+
+static void drop_decoded(ember_chunk* chunk) {
+    free(chunk->lines);
+    chunk->lines = NULL;
+}
+
+static int append_run(ember_chunk* chunk, ember_line_run previous, ember_line_run run) {
+    if (chunk->line_table_length + LINE_RUN_MAX_BYTES > chunk->line_table_capacity) {
+        int capacity = chunk->line_table_capacity ? chunk->line_table_capacity * 2 : 32;
+        uint8_t* table = realloc(chunk->line_table, (size_t)capacity);
+        if (!table) return 0;
+        chunk->line_table = table;
+        chunk->line_table_capacity = capacity;
+    }
+    uint8_t* out = chunk->line_table + chunk->line_table_length;
+    int length = put_varint(out, (uint32_t)(run.start - previous.start));
+    length += put_varint(out + length, zigzag(run.line - previous.line));
+    length += put_varint(out + length, (uint32_t)run.column);
+    chunk->line_last_at = chunk->line_table_length;
+    chunk->line_table_length += length;
+    chunk->line_last = run;
+    chunk->line_count++;
+    return 1;
+}
+
+void ember_chunk_mark_position(ember_chunk* chunk, int line, int column) {
+    if (!chunk || line <= 0) return;
+    if (column < 0) column = 0;
+    ember_line_run run = {chunk->count, line, column};
+    ember_line_run previous = {0, 0, 0};
+    if (chunk->line_count > 0) {
+        ember_line_run* last = &chunk->line_last;
+        if (last->line == line && (column == 0 || last->column == column)) return;
+        previous = *last;
+        if (last->start == chunk->count) {
+            // Nothing was emitted for the previous statement: re-encode its
+            // run for this one, against the run before it
+            int at = chunk->line_last_at;
+            uint32_t start_delta = 0;
+            uint32_t line_delta = 0;
+            get_varint(chunk->line_table, chunk->line_table_length, &at, &start_delta);
+            get_varint(chunk->line_table, chunk->line_table_length, &at, &line_delta);
+            previous.start -= (int)start_delta;
+            previous.line -= unzigzag(line_delta);
+            chunk->line_table_length = chunk->line_last_at;
+            chunk->line_count--;
+        }
+    }
+    drop_decoded(chunk);
+    append_run(chunk, previous, run);
+}
+
+void ember_chunk_mark_line(ember_chunk* chunk, int line) {
+    ember_chunk_mark_position(chunk, line, 0);
+}
+
+int ember_chunk_set_line_table(ember_chunk* chunk, const uint8_t* data, int length) {
+    if (!chunk || length < 0 || (length > 0 && !data)) return 0;
+    ember_line_run run = {0, 0, 0};
+    int count = 0;
+    int last_at = 0;
+    for (int at = 0; at < length; count++) {
+        last_at = at;
+        int start = run.start;
+        if (!next_run(data, length, &at, &run) || (count > 0 && run.start <= start) || run.start > chunk->count) {
+            return 0;
+        }
+    }
+    ember_chunk_free_lines(chunk);
+    if (length == 0) return 1;
+    chunk->line_table = malloc((size_t)length);
+    if (!chunk->line_table) return 0;
+    memcpy(chunk->line_table, data, (size_t)length);
+    chunk->line_table_length = length;
+    chunk->line_table_capacity = length;
+    chunk->line_count = count;
+    chunk->line_last_at = last_at;
+    chunk->line_last = run;
+    return 1;
+}
+
+// The decoded runs are a cache: building it does not change what the chunk
+// says, so const lookups may fill it
+static const ember_line_run* decoded_runs(const ember_chunk* chunk) {
+    if (chunk->lines || chunk->line_count == 0) return chunk->lines;
+    ember_line_run* runs = malloc(sizeof(ember_line_run) * (size_t)chunk->line_count);
+    if (!runs) return NULL;
+    ember_line_run run = {0, 0, 0};
+    int at = 0;
+    for (int i = 0; i < chunk->line_count; i++) {
+        if (!next_run(chunk->line_table, chunk->line_table_length, &at, &run)) {
+            free(runs);
+            return NULL;
+        }
+        runs[i] = run;
+    }
+    ((ember_chunk*)chunk)->lines = runs;
+    return runs;
+}
+
+const ember_line_run* ember_chunk_line_runs(const ember_chunk* chunk) {
+    return chunk ? decoded_runs(chunk) : NULL;
+}
+
+int ember_chunk_line_run_at(const ember_chunk* chunk, int offset) {
+    if (!chunk) return -1;
+    const ember_line_run* runs = decoded_runs(chunk);
+    if (!runs) return -1;
+    int low = 0;
+    int high = chunk->line_count - 1;
+    int found = -1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (runs[mid].start <= offset) {
+            found = mid;
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return found;
+}
+
+int ember_chunk_position_at(const ember_chunk* chunk, int offset, int* column) {
+    if (column) *column = 0;
+    if (!chunk || offset < 0 || offset >= chunk->count) return 0;
+    int run = ember_chunk_line_run_at(chunk, offset);
+    if (run < 0) return 0;
+    if (column) *column = chunk->lines[run].column;
+    return chunk->lines[run].line;
+}
+
+int ember_chunk_line_at(const ember_chunk* chunk, int offset) {
+    return ember_chunk_position_at(chunk, offset, NULL);
+}
+
+void ember_chunk_free_lines(ember_chunk* chunk) {
+    if (!chunk) return;
+    drop_decoded(chunk);
+    free(chunk->line_table);
+    chunk->line_table = NULL;
+    chunk->line_table_length = 0;
+    chunk->line_table_capacity = 0;
+    chunk->line_count = 0;
+    chunk->line_last_at = 0;
+    memset(&chunk->line_last, 0, sizeof(chunk->line_last));
+}
@@ -0,0 +1,64 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "numa_topology.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// Parses a sysfs CPU list such as "0-15,32-47" into cpus
+static int parse_cpulist(const char* list, cpu_set_t* cpus) {
+    CPU_ZERO(cpus);
+    const char* p = list;
+    while (*p && *p != '\n') {
+        char* end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0) return -1;
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first) return -1;
+            p = end;
+        }
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET((int)cpu, cpus);
+        }
+        if (*p == ',') p++;
+    }
+    return CPU_COUNT(cpus) > 0 ? 0 : -1;
+}
+
+int numa_topology_detect(ember_numa_topology* topology) {
+    topology->node_count = 0;
+    char path[64];
+    char list[4096];
+    // Node ids can have gaps (offline or memory-only nodes), so scan them all
+    for (int node = 0; node < EMBER_NUMA_NODES_MAX * 4 &&
+                       topology->node_count < EMBER_NUMA_NODES_MAX; node++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE* file = fopen(path, "r");
+        if (!file) continue;
+        int ok = fgets(list, sizeof(list), file) != NULL;
+        fclose(file);
+        if (ok && parse_cpulist(list, &topology->cpus[topology->node_count]) == 0) {
+            topology->node_count++;
+        }
+    }
+
+    if (topology->node_count == 0) {
+        topology->node_count = 1;
+        if (sched_getaffinity(0, sizeof(cpu_set_t), &topology->cpus[0]) != 0) {
+            CPU_ZERO(&topology->cpus[0]);
+        }
+    }
+    return topology->node_count;
+}
+
+int numa_pin_thread(const ember_numa_topology* topology, int node) {
+    if (node < 0 || node >= topology->node_count) {
+        return -1;
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &topology->cpus[node]) == 0 ? 0 : -1;
+}
@@ -0,0 +1,23 @@
+#ifndef EMBER_NUMA_TOPOLOGY_H
+#define EMBER_NUMA_TOPOLOGY_H
+
+#include <sched.h>  // cpu_set_t; includers define _GNU_SOURCE
+
+// NUMA nodes and their CPUs, read from /sys/devices/system/node (no libnuma).
+// A machine without that directory, or with a single node, reports one node
+// holding every CPU.
+
+#define EMBER_NUMA_NODES_MAX 64
+
+typedef struct {
+    int node_count;
+    cpu_set_t cpus[EMBER_NUMA_NODES_MAX];   // Online CPUs of each node
+} ember_numa_topology;
+
+// Fills topology and returns its node count (at least 1)
+int numa_topology_detect(ember_numa_topology* topology);
+// Restricts the calling thread to node's CPUs. Memory the thread touches
+// first is then placed on node by the kernel's default local policy.
+int numa_pin_thread(const ember_numa_topology* topology, int node);
+
+#endif
@@ -0,0 +1,197 @@
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "../runtime/value/value.h"
+#include "object_shape.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Shape ids are handed out process-wide, like globals epochs, so a chunk
+// shared between VMs never matches another VM's shape
+static uint64_t next_shape_id = 0;
+
+static ember_shape* new_shape(ember_shape* parent, const char* name, int length, uint32_t hash) {
+    ember_shape* shape = calloc(1, sizeof(ember_shape));
+    if (!shape) {
+        fprintf(stderr, "[SECURITY] Memory allocation failed for instance shape\n");
+        return NULL;
+    }
+    if (name) {
+        shape->name = malloc((size_t)length + 1);
+        if (!shape->name) {
+            fprintf(stderr, "[SECURITY] Memory allocation failed for instance shape\n");
+            free(shape);
+            return NULL;
+        }
+        memcpy(shape->name, name, (size_t)length);
+        shape->name[length] = '\0';
+    }
+    shape->parent = parent;
+    shape->name_length = length;
+    shape->name_hash = hash;
+    shape->field_count = parent ? parent->field_count + 1 : 0;
+    shape->id = __sync_add_and_fetch(&next_shape_id, 1);
+    return shape;
+}
+
+ember_shape* shape_root(ember_class* klass) {
+    if (!klass) return NULL;
+    if (!klass->shape_root) {
+        klass->shape_root = new_shape(NULL, NULL, 0, 0);
+    }
+    return klass->shape_root;
+}
+
+static int shape_names(const ember_shape* shape, const ember_string* name) {
+    return shape->name_hash == name->hash && shape->name_length == name->length &&
+           memcmp(shape->name, name->chars, (size_t)name->length) == 0;
+}
+
+int shape_find_field(const ember_shape* shape, ember_string* name) {
+    if (!shape || !name) return -1;
+    ember_string_flatten(name);
+    for (; shape && shape->name; shape = shape->parent) {
+        if (shape_names(shape, name)) {
+            return shape->field_count - 1;
+        }
+    }
+    return -1;
+}
+
+ember_shape* shape_add_field(ember_shape* shape, ember_string* name) {
+    if (!shape || !name) return NULL;
+    ember_string_flatten(name);
+    for (int i = 0; i < shape->transition_count; i++) {
+        if (shape_names(shape->transitions[i], name)) {
+            return shape->transitions[i];
+        }
+    }
+
+    if (shape->transition_count == shape->transition_capacity) {
+        int capacity = shape->transition_capacity ? shape->transition_capacity * 2 : 2;
+        ember_shape** transitions = realloc(shape->transitions, sizeof(ember_shape*) * (size_t)capacity);
+        if (!transitions) {
+            fprintf(stderr, "[SECURITY] Memory allocation failed for instance shape\n");
+            return NULL;
+        }
+        shape->transitions = transitions;
+        shape->transition_capacity = capacity;
+    }
+    ember_shape* child = new_shape(shape, name->chars, name->length, name->hash);
+    if (!child) return NULL;
+    shape->transitions[shape->transition_count++] = child;
+    return child;
+}
+
+void shape_free_tree(ember_shape* root) {
+    if (!root) return;
+    for (int i = 0; i < root->transition_count; i++) {
+        shape_free_tree(root->transitions[i]);
+    }
+    free(root->transitions);
+    free(root->name);
+    free(root);
+}
+
+size_t instance_object_size(int inline_capacity) {
+    return sizeof(ember_instance) + sizeof(ember_value) * (size_t)inline_capacity;
+}
+
+int instance_reserve_slots(ember_instance* instance, int count) {
+    if (count <= instance->slot_capacity) return 1;
+    int capacity = instance->slot_capacity * 2;
+    if (capacity < count) capacity = count;
+    if (capacity > EMBER_SHAPE_MAX_FIELDS) capacity = EMBER_SHAPE_MAX_FIELDS;
+
+    ember_value* slots;
+    if (instance->slots == instance->inline_slots) {
+        slots = malloc(sizeof(ember_value) * (size_t)capacity);
+        if (slots && instance->shape) {
+            memcpy(slots, instance->inline_slots, sizeof(ember_value) * (size_t)instance->shape->field_count);
+        }
+    } else {
+        slots = realloc(instance->slots, sizeof(ember_value) * (size_t)capacity);
+    }
+    if (!slots) {
+        fprintf(stderr, "[SECURITY] Memory allocation failed for instance fields\n");
+        return 0;
+    }
+    instance->slots = slots;
+    instance->slot_capacity = capacity;
+    return 1;
+}
+
+// Too many fields for a shape: move them into a hash map. Every allocation
+// here may collect, so the shape and slots stay valid until the map is full.
+static int instance_to_dictionary(ember_vm* vm, ember_instance* instance) {
+    ember_hash_map* fields = allocate_hash_map(vm, EMBER_SHAPE_MAX_FIELDS * 2);
+    if (!fields) return 0;
+    ember_value table;
+    table.type = EMBER_VAL_HASH_MAP;
+    table.as.obj_val = (ember_object*)fields;
+    gc_write_barrier_helper(vm, (ember_object*)instance, ember_make_nil(), table);
+    instance->fields = fields;
+    for (ember_shape* shape = instance->shape; shape && shape->name; shape = shape->parent) {
+        ember_string* name = copy_string(vm, shape->name, shape->name_length);
+        if (!name) return 0;
+        ember_value key;
+        key.type = EMBER_VAL_STRING;
+        key.as.obj_val = (ember_object*)name;
+        hash_map_set_with_vm(vm, fields, key, instance->slots[shape->field_count - 1]);
+    }
+    if (instance->slots != instance->inline_slots) {
+        free(instance->slots);
+    }
+    instance->shape = NULL;
+    instance->slots = instance->inline_slots;
+    instance->slot_capacity = instance->inline_capacity;
+    return 1;
+}
+
+int ember_instance_get_field(ember_instance* instance, ember_value name, ember_value* out) {
+    if (!instance || name.type != EMBER_VAL_STRING || !name.as.obj_val) return 0;
+    if (instance->shape) {
+        int slot = shape_find_field(instance->shape, AS_STRING(name));
+        if (slot < 0) return 0;
+        if (out) *out = instance->slots[slot];
+        return 1;
+    }
+    if (!instance->fields || !hash_map_has_key(instance->fields, name)) return 0;
+    if (out) *out = hash_map_get(instance->fields, name);
+    return 1;
+}
+
+int ember_instance_set_field(ember_vm* vm, ember_instance* instance, ember_value name, ember_value value) {
+    if (!vm || !instance || name.type != EMBER_VAL_STRING || !name.as.obj_val) return 0;
+    ember_shape* shape = instance->shape;
+    if (shape) {
+        int slot = shape_find_field(shape, AS_STRING(name));
+        if (slot >= 0) {
+            gc_write_barrier_helper(vm, (ember_object*)instance, instance->slots[slot], value);
+            instance->slots[slot] = value;
+            return 1;
+        }
+        if (shape->field_count < EMBER_SHAPE_MAX_FIELDS) {
+            ember_shape* next = shape_add_field(shape, AS_STRING(name));
+            if (!next || !instance_reserve_slots(instance, next->field_count)) return 0;
+            gc_write_barrier_helper(vm, (ember_object*)instance, ember_make_nil(), value);
+            instance->slots[next->field_count - 1] = value;
+            instance->shape = next;
+            ember_class* klass = instance->klass;
+            if (klass && next->field_count > klass->instance_slots_hint) {
+                klass->instance_slots_hint = next->field_count;
+            }
+            return 1;
+        }
+        if (!instance_to_dictionary(vm, instance)) return 0;
+    }
+    if (!instance->fields) return 0;
+    hash_map_set_with_vm(vm, instance->fields, name, value);
+    return 1;
+}
+
+int ember_instance_field_count(ember_instance* instance) {
+    if (!instance) return 0;
+    if (instance->shape) return instance->shape->field_count;
+    return instance->fields ? instance->fields->length : 0;
+}
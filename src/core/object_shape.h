@@ -0,0 +1,58 @@
+#ifndef EMBER_OBJECT_SHAPE_H
+#define EMBER_OBJECT_SHAPE_H
+
+#include "../../include/ember.h"
+#include <stdint.h>
+
+// Hidden classes for instance fields.
+//
+// Every ember_class owns a tree of shapes. The root has no fields, and each
+// child adds one field name to its parent's layout, so instances that gain
+// the same fields in the same order share a shape and keep their values in
+// a plain array indexed by slot. Past EMBER_SHAPE_MAX_FIELDS an instance
+// switches to dictionary mode (instance->fields, instance->shape == NULL).
+
+#define EMBER_SHAPE_MAX_FIELDS 64       // More fields than this use a hash map
+#define EMBER_INSTANCE_INLINE_MIN 4     // Inline slots of a class's first instances
+#define EMBER_INSTANCE_INLINE_MAX 16    // Inline slots an instance is ever allocated with
+#define EMBER_PROPERTY_CACHE_WAYS 4     // Shapes one property site remembers
+
+typedef struct ember_shape {
+    struct ember_shape* parent;
+    struct ember_shape** transitions;   // Children, one per field added next
+    int transition_count;
+    int transition_capacity;
+    char* name;                         // Field this shape adds; NULL for the root
+    int name_length;
+    uint32_t name_hash;
+    int field_count;                    // name lives in slot field_count - 1
+    uint64_t id;                        // Unique per process, never reused
+} ember_shape;
+
+// One property site (OP_GET_PROPERTY/OP_SET_PROPERTY name constant). Entries
+// match on shape id, so an entry left behind by a freed class never hits.
+typedef struct {
+    uint64_t shape_id;                  // 0 = empty
+    ember_shape* target;                // Stores: the shape after the store
+    int slot;
+} ember_property_cache_entry;
+
+struct ember_property_cache {
+    ember_property_cache_entry get[EMBER_PROPERTY_CACHE_WAYS];
+    ember_property_cache_entry set[EMBER_PROPERTY_CACHE_WAYS];
+};
+
+// The class's empty layout, created on first use; NULL if out of memory
+ember_shape* shape_root(ember_class* klass);
+// Slot of name in shape, or -1
+int shape_find_field(const ember_shape* shape, ember_string* name);
+// The shape with name added after shape's fields (shared between instances)
+ember_shape* shape_add_field(ember_shape* shape, ember_string* name);
+void shape_free_tree(ember_shape* root);
+
+// Room for count field values in instance->slots
+int instance_reserve_slots(ember_instance* instance, int count);
+// Object size of an instance allocated with inline_capacity slots
+size_t instance_object_size(int inline_capacity);
+
+#endif // EMBER_OBJECT_SHAPE_H
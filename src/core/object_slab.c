@@ -0,0 +1,250 @@
+#define _GNU_SOURCE
+#include "object_slab.h"
+#include "huge_pages.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define SLAB_MIN_SLOTS (EMBER_SLAB_SIZE / EMBER_SLAB_GRANULE)
+#define SLAB_BITMAP_WORDS ((SLAB_MIN_SLOTS + 63) / 64)
+#define SLABS_PER_REGION (EMBER_HUGE_PAGE_SIZE / EMBER_SLAB_SIZE)
+
+// A huge page cut into slabs, for VMs with huge pages
+typedef struct ember_slab_region {
+    struct ember_slab_region* next;  // vm->slab_regions, while it has room
+    struct ember_slab_region* prev;
+    char* base;
+    void* free_slabs;                // Returned slabs, linked through their first word
+    int bump;                        // Slabs from here on were never handed out
+    int used;
+    int in_list;
+} ember_slab_region;
+
+typedef struct ember_slab {
+    struct ember_slab* next;         // Partial list of its size class
+    struct ember_slab* prev;
+    ember_vm* vm;
+    ember_slab_region* region;       // NULL when allocated on its own
+    void* free_slots;                // Freed slots, linked through their first word
+    uint32_t slot_size;
+    uint32_t slot_count;
+    uint32_t used;
+    uint32_t bump;                   // Slots from here on were never handed out
+    int size_class;
+    int in_partial;
+    uint64_t allocated[SLAB_BITMAP_WORDS];
+} ember_slab;
+
+#define SLAB_HEADER_SIZE \
+    ((sizeof(ember_slab) + EMBER_SLAB_GRANULE - 1) / EMBER_SLAB_GRANULE * EMBER_SLAB_GRANULE)
+
+static char* slab_slots(ember_slab* slab) {
+    return (char*)slab + SLAB_HEADER_SIZE;
+}
+
+static void link_partial(ember_slab* slab) {
+    ember_slab** head = &slab->vm->slab_partial[slab->size_class];
+    slab->prev = NULL;
+    slab->next = *head;
+    if (*head) (*head)->prev = slab;
+    *head = slab;
+    slab->in_partial = 1;
+}
+
+static void unlink_partial(ember_slab* slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        slab->vm->slab_partial[slab->size_class] = slab->next;
+    }
+    if (slab->next) slab->next->prev = slab->prev;
+    slab->next = slab->prev = NULL;
+    slab->in_partial = 0;
+}
+
+static void link_region(ember_slab_region* region, ember_vm* vm) {
+    region->prev = NULL;
+    region->next = vm->slab_regions;
+    if (vm->slab_regions) vm->slab_regions->prev = region;
+    vm->slab_regions = region;
+    region->in_list = 1;
+}
+
+static void unlink_region(ember_slab_region* region, ember_vm* vm) {
+    if (region->prev) {
+        region->prev->next = region->next;
+    } else {
+        vm->slab_regions = region->next;
+    }
+    if (region->next) region->next->prev = region->prev;
+    region->next = region->prev = NULL;
+    region->in_list = 0;
+}
+
+// A slab-sized block of a huge page region, mapping a new region when none
+// has room; NULL if that fails
+static void* region_take_slab(ember_vm* vm, ember_slab_region** owner) {
+    ember_slab_region* region = vm->slab_regions;
+    if (!region) {
+        region = malloc(sizeof(ember_slab_region));
+        if (!region) return NULL;
+        region->base = huge_region_map();
+        if (!region->base) {
+            free(region);
+            return NULL;
+        }
+        region->free_slabs = NULL;
+        region->bump = 0;
+        region->used = 0;
+        link_region(region, vm);
+        vm->slab_region_count++;
+    }
+
+    void* memory;
+    if (region->bump < SLABS_PER_REGION) {
+        memory = region->base + (size_t)region->bump * EMBER_SLAB_SIZE;
+        region->bump++;
+    } else {
+        memory = region->free_slabs;
+        region->free_slabs = *(void**)memory;
+    }
+    if (++region->used == SLABS_PER_REGION) {
+        unlink_region(region, vm);
+    }
+    *owner = region;
+    return memory;
+}
+
+static void release_slab(ember_slab* slab) {
+    ember_slab_region* region = slab->region;
+    ember_vm* vm = slab->vm;
+    if (!region) {
+        free(slab);
+        return;
+    }
+    if (--region->used == 0) {
+        if (region->in_list) unlink_region(region, vm);
+        huge_region_unmap(region->base);
+        free(region);
+        vm->slab_region_count--;
+        return;
+    }
+    *(void**)slab = region->free_slabs;
+    region->free_slabs = slab;
+    if (!region->in_list) {
+        link_region(region, vm);
+    }
+}
+
+static ember_slab* new_slab(ember_vm* vm, int size_class) {
+    void* memory = NULL;
+    ember_slab_region* region = NULL;
+    if (vm->huge_pages) {
+        // Without a region the slab is allocated on its own
+        memory = region_take_slab(vm, &region);
+    }
+    if (!memory && posix_memalign(&memory, EMBER_SLAB_SIZE, EMBER_SLAB_SIZE) != 0) {
+        return NULL;
+    }
+    ember_slab* slab = memory;
+    slab->vm = vm;
+    slab->region = region;
+    slab->free_slots = NULL;
+    slab->slot_size = (uint32_t)((size_class + 1) * EMBER_SLAB_GRANULE);
+    slab->slot_count = (uint32_t)((EMBER_SLAB_SIZE - SLAB_HEADER_SIZE) / slab->slot_size);
+    slab->used = 0;
+    slab->bump = 0;
+    slab->size_class = size_class;
+    for (int i = 0; i < SLAB_BITMAP_WORDS; i++) {
+        slab->allocated[i] = 0;
+    }
+    link_partial(slab);
+    vm->slab_count++;
+    return slab;
+}
+
+void* object_slab_alloc(ember_vm* vm, size_t size) {
+    if (!vm || size == 0 || size > EMBER_SLAB_MAX_OBJECT) return NULL;
+    int size_class = (int)((size + EMBER_SLAB_GRANULE - 1) / EMBER_SLAB_GRANULE) - 1;
+
+    ember_slab* slab = vm->slab_partial[size_class];
+    if (!slab) {
+        slab = new_slab(vm, size_class);
+        if (!slab) return NULL;
+    }
+
+    char* slot;
+    if (slab->bump < slab->slot_count) {
+        slot = slab_slots(slab) + (size_t)slab->bump * slab->slot_size;
+        slab->bump++;
+    } else {
+        slot = slab->free_slots;
+        slab->free_slots = *(void**)slot;
+    }
+    uint32_t index = (uint32_t)((slot - slab_slots(slab)) / slab->slot_size);
+    slab->allocated[index / 64] |= 1ull << (index % 64);
+    if (++slab->used == slab->slot_count) {
+        unlink_partial(slab);
+    }
+    return slot;
+}
+
+void object_slab_free(ember_object* object) {
+    ember_slab* slab = (ember_slab*)((uintptr_t)object & ~(uintptr_t)(EMBER_SLAB_SIZE - 1));
+    uint32_t index = (uint32_t)(((char*)object - slab_slots(slab)) / slab->slot_size);
+    uint64_t bit = 1ull << (index % 64);
+    if (!(slab->allocated[index / 64] & bit)) {
+        fprintf(stderr, "[SECURITY] Double free of slab object %p\n", (void*)object);
+        abort();
+    }
+    slab->allocated[index / 64] &= ~bit;
+
+    if (--slab->used == 0) {
+        if (slab->in_partial) unlink_partial(slab);
+        slab->vm->slab_count--;
+        release_slab(slab);
+        return;
+    }
+    *(void**)object = slab->free_slots;
+    slab->free_slots = object;
+    if (!slab->in_partial) {
+        link_partial(slab);
+    }
+}
+
+static void rebuild_free_list(ember_slab* slab) {
+    // Slots past the last one in use are handed out by bumping again
+    uint32_t bump = 0;
+    for (int word = SLAB_BITMAP_WORDS - 1; word >= 0; word--) {
+        if (slab->allocated[word]) {
+            bump = (uint32_t)(word * 64 + 64 - __builtin_clzll(slab->allocated[word]));
+            break;
+        }
+    }
+
+    void** link = &slab->free_slots;
+    for (uint32_t word = 0; word * 64 < bump; word++) {
+        uint64_t free_bits = ~slab->allocated[word];
+        if ((word + 1) * 64 > bump) {
+            free_bits &= (1ull << (bump % 64)) - 1;
+        }
+        while (free_bits) {
+            uint32_t index = word * 64 + (uint32_t)__builtin_ctzll(free_bits);
+            free_bits &= free_bits - 1;
+            void* slot = slab_slots(slab) + (size_t)index * slab->slot_size;
+            *link = slot;
+            link = (void**)slot;
+        }
+    }
+    *link = NULL;
+    slab->bump = bump;
+}
+
+void object_slab_rebuild_free_lists(ember_vm* vm) {
+    if (!vm) return;
+    for (int size_class = 0; size_class < EMBER_SLAB_CLASSES; size_class++) {
+        for (ember_slab* slab = vm->slab_partial[size_class]; slab; slab = slab->next) {
+            rebuild_free_list(slab);
+        }
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef EMBER_OBJECT_SLAB_H
+#define EMBER_OBJECT_SLAB_H
+
+#include "../../include/ember.h"
+#include <stddef.h>
+
+// Per-VM slabs for small object headers (built with EMBER_SLAB_OBJECTS).
+// A slab is an EMBER_SLAB_SIZE block aligned to its size, so the slab that
+// owns an object is found by masking its address. Slots are handed out
+// bump-first, then from a free list, so objects allocated together sit
+// next to each other and a sweep of vm->objects walks memory mostly in
+// order. A slab whose last slot is freed goes back to the system, or with
+// ember_vm_set_huge_pages to the 2 MB region it was cut from, which goes
+// back once all of its slabs have.
+
+#define EMBER_SLAB_SIZE (64 * 1024)
+#define EMBER_SLAB_GRANULE 16
+#define EMBER_SLAB_MAX_OBJECT (EMBER_SLAB_CLASSES * EMBER_SLAB_GRANULE)
+
+// NULL when size is too large for a slab or no memory is left
+void* object_slab_alloc(ember_vm* vm, size_t size);
+// object must have in_slab set
+void object_slab_free(ember_object* object);
+// After a sweep: relink the free slots of every partial slab in address
+// order and give the free tail of each back to its bump pointer, undoing the
+// scatter of frees made in list order
+void object_slab_rebuild_free_lists(ember_vm* vm);
+
+#endif // EMBER_OBJECT_SLAB_H
@@ -0,0 +1,1494 @@
+#include "optimizer.h"
+#include "../vm.h"
+#include "../runtime/value/value.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Level 1 only uses opcodes every VM build dispatches; fusion (level 2+)
+// introduces OP_JUMP_IF_TRUE
+static int optimization_level = 1;
+
+void vm_set_optimization_level(int level) {
+    if (level < 0) level = 0;
+    if (level > 3) level = 3;
+    optimization_level = level;
+}
+
+int vm_get_optimization_level(void) {
+    return optimization_level;
+}
+
+void ember_init_optimization_stats(ember_optimization_stats* stats) {
+    if (!stats) return;
+    memset(stats, 0, sizeof(*stats));
+}
+
+int ember_match_pattern(const uint8_t* code, int offset, int count, const ember_instruction_pattern* pattern) {
+    if (!code || !pattern || !pattern->instructions || pattern->length <= 0 ||
+        offset < 0 || offset + pattern->length > count) {
+        return 0;
+    }
+    for (int i = 0; i < pattern->length; i++) {
+        uint8_t expected = pattern->instructions[i];
+        if (expected != OPT_PATTERN_WILDCARD && code[offset + i] != expected) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Decoded form of a chunk. Jump targets are instruction indices (count means
+// the end of the chunk), so passes never deal with byte offsets. Removed
+// instructions stay in place until the chunk is re-encoded; a jump aimed at
+// one lands on the next instruction that is kept.
+typedef struct {
+    uint8_t op;
+    int operand;     // -1 for opcodes without one; the local slot of a superinstruction
+    int constant;    // Constant index of a superinstruction, -1 otherwise
+    int target;      // Jump target index, -1 for non-jumps
+    int jump_in;     // Kept jumps landing here
+    bool wide;       // Encoded with OP_WIDE
+    bool removed;
+} opt_instruction;
+
+typedef struct {
+    ember_chunk* chunk;
+    opt_instruction* code;
+    int count;
+    int* handler_points;  // Instruction index of each exception table offset (start, end, handler)
+    int* switch_points;   // Instruction index of each switch table target, its default last
+    ember_line_run* line_runs;  // The line table, starting at instruction indices
+    int line_run_count;
+} opt_program;
+
+typedef enum {
+    OPT_JUMP_NONE,
+    OPT_JUMP_FORWARD,   // target = end + offset
+    OPT_JUMP_CONTINUE,  // target = end - offset
+    OPT_JUMP_LOOP       // target = end + 1 - offset
+} opt_jump_kind;
+
+static opt_jump_kind jump_kind(uint8_t op) {
+    switch (op) {
+        case OP_JUMP:
+        case OP_JUMP_IF_FALSE:
+        case OP_JUMP_IF_TRUE:
+        case OP_BREAK:
+        case OP_CASE:
+        case OP_LOCAL_LESS_CONST_JUMP_IF_FALSE:
+        case OP_LOCAL_LESS_EQUAL_CONST_JUMP_IF_FALSE:
+        case OP_LOCAL_GREATER_CONST_JUMP_IF_FALSE:
+        case OP_LOCAL_GREATER_EQUAL_CONST_JUMP_IF_FALSE:
+        case OP_CALL_GUARD:
+            return OPT_JUMP_FORWARD;
+        case OP_CONTINUE:
+            return OPT_JUMP_CONTINUE;
+        case OP_LOOP:
+            return OPT_JUMP_LOOP;
+        default:
+            return OPT_JUMP_NONE;
+    }
+}
+
+static bool is_conditional_jump(uint8_t op) {
+    return op == OP_JUMP_IF_FALSE || op == OP_JUMP_IF_TRUE;
+}
+
+static int resolve(const opt_program* prog, int index) {
+    while (index < prog->count && prog->code[index].removed) index++;
+    return index;
+}
+
+static int next_kept(const opt_program* prog, int index) {
+    return resolve(prog, index + 1);
+}
+
+static int previous_kept(const opt_program* prog, int index) {
+    for (int i = index - 1; i >= 0; i--) {
+        if (!prog->code[i].removed) return i;
+    }
+    return -1;
+}
+
+static bool is_jump_target(const opt_program* prog, int index) {
+    return index < prog->count && prog->code[index].jump_in > 0;
+}
+
+static void program_free(opt_program* prog) {
+    free(prog->code);
+    free(prog->handler_points);
+    free(prog->switch_points);
+    free(prog->line_runs);
+    prog->code = NULL;
+    prog->handler_points = NULL;
+    prog->switch_points = NULL;
+    prog->line_runs = NULL;
+    prog->line_run_count = 0;
+    prog->count = 0;
+}
+
+static int* handler_offset(ember_handler_entry* entry, int point) {
+    switch (point) {
+        case 0: return &entry->start;
+        case 1: return &entry->end;
+        default: return &entry->handler;
+    }
+}
+
+static bool program_decode(opt_program* prog, ember_chunk* chunk) {
+    prog->chunk = chunk;
+    prog->code = NULL;
+    prog->count = 0;
+    prog->handler_points = NULL;
+    prog->switch_points = NULL;
+    prog->line_runs = NULL;
+    prog->line_run_count = 0;
+    if (chunk->count == 0) return true;
+
+    int* index_at = malloc(sizeof(int) * (chunk->count + 1));
+    int* ends = malloc(sizeof(int) * chunk->count);
+    int* offsets = malloc(sizeof(int) * chunk->count);
+    prog->code = malloc(sizeof(opt_instruction) * chunk->count);
+    if (!index_at || !ends || !offsets || !prog->code) {
+        free(index_at);
+        free(ends);
+        free(offsets);
+        program_free(prog);
+        return false;
+    }
+    for (int i = 0; i <= chunk->count; i++) index_at[i] = -1;
+
+    bool valid = true;
+    int offset = 0;
+    while (offset < chunk->count) {
+        opt_instruction ins = {chunk->code[offset], -1, -1, -1, 0, false, false};
+        int size = opcode_fused_size(ins.op);
+        if (size > 0) {
+            if (offset + size > chunk->count) {
+                valid = false;
+                break;
+            }
+            ins.operand = read_chunk_u16(chunk, offset + 1);
+            ins.constant = read_chunk_u16(chunk, offset + 3);
+            offsets[prog->count] = size == 7 ? read_chunk_u16(chunk, offset + 5) : 0;
+        } else if (ins.op == OP_WIDE) {
+            if (offset + 3 >= chunk->count || !opcode_has_operand(chunk->code[offset + 1])) {
+                valid = false;
+                break;
+            }
+            ins.op = chunk->code[offset + 1];
+            ins.operand = (chunk->code[offset + 2] << 8) | chunk->code[offset + 3];
+            ins.wide = true;
+            offsets[prog->count] = ins.operand;
+            size = 4;
+        } else if (opcode_has_operand(ins.op)) {
+            if (offset + 1 >= chunk->count) {
+                valid = false;
+                break;
+            }
+            ins.operand = chunk->code[offset + 1];
+            offsets[prog->count] = ins.operand;
+            size = 2;
+        } else {
+            size = 1;
+        }
+        index_at[offset] = prog->count;
+        ends[prog->count] = offset + size;
+        prog->code[prog->count++] = ins;
+        offset += size;
+    }
+    index_at[chunk->count] = prog->count;
+
+    // Every jump must land on an instruction boundary inside the chunk
+    for (int i = 0; valid && i < prog->count; i++) {
+        opt_instruction* ins = &prog->code[i];
+        int target;
+        switch (jump_kind(ins->op)) {
+            case OPT_JUMP_FORWARD:  target = ends[i] + offsets[i]; break;
+            case OPT_JUMP_CONTINUE: target = ends[i] - offsets[i]; break;
+            case OPT_JUMP_LOOP:     target = ends[i] + 1 - offsets[i]; break;
+            default: continue;
+        }
+        if (target < 0 || target > chunk->count || index_at[target] < 0) {
+            valid = false;
+            break;
+        }
+        ins->target = index_at[target];
+        if (ins->target < prog->count) prog->code[ins->target].jump_in++;
+    }
+
+    // Exception table offsets are labels too: passes must not merge
+    // instructions across a try block's edges or remove its handler
+    if (valid && chunk->handler_count > 0) {
+        prog->handler_points = malloc(sizeof(int) * 3 * (size_t)chunk->handler_count);
+        valid = prog->handler_points != NULL;
+    }
+    for (int h = 0; valid && h < chunk->handler_count; h++) {
+        for (int point = 0; point < 3; point++) {
+            int target = *handler_offset(&chunk->handlers[h], point);
+            if (target < 0 || target > chunk->count || index_at[target] < 0) {
+                valid = false;
+                break;
+            }
+            int index = index_at[target];
+            prog->handler_points[h * 3 + point] = index;
+            if (index < prog->count) prog->code[index].jump_in++;
+        }
+    }
+
+    // So are switch table targets
+    int switch_points = 0;
+    for (int t = 0; t < chunk->switch_table_count; t++) {
+        switch_points += chunk->switch_tables[t].count + 1;
+    }
+    if (valid && switch_points > 0) {
+        prog->switch_points = malloc(sizeof(int) * (size_t)switch_points);
+        valid = prog->switch_points != NULL;
+    }
+    for (int t = 0, point = 0; valid && t < chunk->switch_table_count; t++) {
+        ember_switch_table* table = &chunk->switch_tables[t];
+        for (int i = 0; valid && i <= table->count; i++) {
+            int target = i < table->count ? table->targets[i] : table->default_target;
+            if (target < 0 || target > chunk->count || index_at[target] < 0) {
+                valid = false;
+                break;
+            }
+            int index = index_at[target];
+            prog->switch_points[point++] = index;
+            if (index < prog->count) prog->code[index].jump_in++;
+        }
+    }
+
+    // Line runs follow their first instruction but are not labels: code of
+    // neighbouring statements may still be merged
+    const ember_line_run* runs = ember_chunk_line_runs(chunk);
+    if (valid && runs) {
+        prog->line_runs = malloc(sizeof(ember_line_run) * (size_t)chunk->line_count);
+        valid = prog->line_runs != NULL;
+    }
+    for (int r = 0; valid && runs && r < chunk->line_count; r++) {
+        if (runs[r].start > chunk->count || index_at[runs[r].start] < 0) continue;
+        ember_line_run* run = &prog->line_runs[prog->line_run_count++];
+        *run = runs[r];
+        run->start = index_at[runs[r].start];
+    }
+
+    free(index_at);
+    free(ends);
+    free(offsets);
+    if (!valid) program_free(prog);
+    return valid;
+}
+
+static int instruction_size(const opt_instruction* ins) {
+    if (ins->removed) return 0;
+    int fused = opcode_fused_size(ins->op);
+    if (fused > 0) return fused;
+    if (ins->operand < 0) return 1;
+    return ins->wide ? 4 : 2;
+}
+
+static int jump_offset(const opt_instruction* ins, int end, int target) {
+    switch (jump_kind(ins->op)) {
+        case OPT_JUMP_FORWARD:  return target - end;
+        case OPT_JUMP_CONTINUE: return end - target;
+        case OPT_JUMP_LOOP:     return end + 1 - target;
+        default:                return ins->operand;
+    }
+}
+
+static int put_u16(uint8_t* code, int offset, int value) {
+    code[offset] = (uint8_t)((value >> 8) & 0xFF);
+    code[offset + 1] = (uint8_t)(value & 0xFF);
+    return offset + 2;
+}
+
+// Lay the instructions out again. Jumps start compact and are widened until
+// every offset fits, so the parser's reserved wide jumps shrink where they can
+static bool program_encode(opt_program* prog) {
+    ember_chunk* chunk = prog->chunk;
+    int* positions = malloc(sizeof(int) * (prog->count + 1));
+    if (!positions) return false;
+
+    for (int i = 0; i < prog->count; i++) {
+        opt_instruction* ins = &prog->code[i];
+        if (ins->removed || ins->operand < 0 || opcode_fused_size(ins->op) > 0) continue;
+        ins->wide = jump_kind(ins->op) == OPT_JUMP_NONE && ins->operand > 0xFF;
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        int offset = 0;
+        for (int i = 0; i < prog->count; i++) {
+            positions[i] = offset;
+            offset += instruction_size(&prog->code[i]);
+        }
+        positions[prog->count] = offset;
+
+        for (int i = 0; i < prog->count; i++) {
+            opt_instruction* ins = &prog->code[i];
+            if (ins->removed || jump_kind(ins->op) == OPT_JUMP_NONE) continue;
+            int end = positions[i] + instruction_size(ins);
+            int offset_value = jump_offset(ins, end, positions[resolve(prog, ins->target)]);
+            if (offset_value < 0 || offset_value > EMBER_WIDE_OPERAND_MAX) {
+                free(positions);
+                return false;
+            }
+            if (offset_value > 0xFF && !ins->wide && opcode_fused_size(ins->op) == 0) {
+                ins->wide = true;
+                changed = true;
+            }
+        }
+    }
+
+    int size = positions[prog->count];
+    uint8_t* code = malloc(size > 0 ? size : 1);
+    if (!code) {
+        free(positions);
+        return false;
+    }
+    int offset = 0;
+    for (int i = 0; i < prog->count; i++) {
+        opt_instruction* ins = &prog->code[i];
+        if (ins->removed) continue;
+        int operand = ins->operand;
+        int jump = 0;
+        if (jump_kind(ins->op) != OPT_JUMP_NONE) {
+            jump = jump_offset(ins, positions[i] + instruction_size(ins),
+                               positions[resolve(prog, ins->target)]);
+            operand = jump;
+        }
+        if (opcode_fused_size(ins->op) > 0) {
+            code[offset++] = ins->op;
+            offset = put_u16(code, offset, ins->operand);
+            offset = put_u16(code, offset, ins->constant);
+            if (jump_kind(ins->op) != OPT_JUMP_NONE) offset = put_u16(code, offset, jump);
+        } else if (operand < 0) {
+            code[offset++] = ins->op;
+        } else if (ins->wide) {
+            code[offset++] = OP_WIDE;
+            code[offset++] = ins->op;
+            code[offset++] = (uint8_t)((operand >> 8) & 0xFF);
+            code[offset++] = (uint8_t)(operand & 0xFF);
+        } else {
+            code[offset++] = ins->op;
+            code[offset++] = (uint8_t)operand;
+        }
+    }
+
+    // Rewrite through write_chunk so the chunk keeps managing its own buffer,
+    // marking each line run again where its first instruction now starts
+    chunk->count = 0;
+    if (prog->line_runs) ember_chunk_free_lines(chunk);
+    int run = 0;
+    for (int i = 0; i <= size; i++) {
+        while (run < prog->line_run_count && positions[resolve(prog, prog->line_runs[run].start)] <= i) {
+            ember_chunk_mark_position(chunk, prog->line_runs[run].line, prog->line_runs[run].column);
+            run++;
+        }
+        if (i < size) write_chunk(chunk, code[i]);
+    }
+    for (int h = 0; prog->handler_points && h < chunk->handler_count; h++) {
+        for (int point = 0; point < 3; point++) {
+            *handler_offset(&chunk->handlers[h], point) = positions[resolve(prog, prog->handler_points[h * 3 + point])];
+        }
+    }
+    for (int t = 0, point = 0; prog->switch_points && t < chunk->switch_table_count; t++) {
+        ember_switch_table* table = &chunk->switch_tables[t];
+        for (int i = 0; i < table->count; i++) {
+            table->targets[i] = positions[resolve(prog, prog->switch_points[point++])];
+        }
+        table->default_target = positions[resolve(prog, prog->switch_points[point++])];
+    }
+    free(code);
+    free(positions);
+    return true;
+}
+
+static void remove_instruction(opt_program* prog, int index, ember_optimization_stats* stats) {
+    opt_instruction* ins = &prog->code[index];
+    if (jump_kind(ins->op) != OPT_JUMP_NONE) {
+        int target = resolve(prog, ins->target);
+        if (target < prog->count) prog->code[target].jump_in--;
+    }
+    ins->removed = true;
+    if (ins->jump_in > 0) {
+        int next = resolve(prog, index + 1);
+        if (next < prog->count) prog->code[next].jump_in += ins->jump_in;
+        ins->jump_in = 0;
+    }
+    stats->removed_instructions++;
+}
+
+static void set_jump_target(opt_program* prog, int index, int target) {
+    opt_instruction* ins = &prog->code[index];
+    int old_target = resolve(prog, ins->target);
+    if (old_target < prog->count) prog->code[old_target].jump_in--;
+    ins->target = target;
+    if (target < prog->count) prog->code[target].jump_in++;
+}
+
+// Turn a jump into a plain instruction without an operand
+static void replace_jump(opt_program* prog, int index, uint8_t op) {
+    opt_instruction* ins = &prog->code[index];
+    int target = resolve(prog, ins->target);
+    if (target < prog->count) prog->code[target].jump_in--;
+    ins->op = op;
+    ins->operand = -1;
+    ins->target = -1;
+}
+
+static bool constant_at(const opt_program* prog, int index, ember_value* value) {
+    if (index >= prog->count) return false;
+    const opt_instruction* ins = &prog->code[index];
+    if (ins->op != OP_PUSH_CONST || ins->operand >= prog->chunk->const_count) return false;
+    *value = prog->chunk->constants[ins->operand];
+    return true;
+}
+
+// Only nil and booleans are given a truthiness here; other values are left
+// to the VM
+static bool known_truthiness(ember_value value, bool* truthy) {
+    if (value.type == EMBER_VAL_NIL) {
+        *truthy = false;
+        return true;
+    }
+    if (value.type == EMBER_VAL_BOOL) {
+        *truthy = value.as.bool_val != 0;
+        return true;
+    }
+    return false;
+}
+
+// Reuse an identical constant so repeated folding does not grow the pool
+static int find_or_add_constant(ember_chunk* chunk, ember_value value) {
+    int existing = ember_chunk_find_constant(chunk, value);
+    if (existing >= 0) return existing;
+    if (chunk->const_count >= EMBER_CONST_POOL_MAX) return -1;
+    return add_constant(chunk, value);
+}
+
+static bool fold_binary(uint8_t op, ember_value a, ember_value b, ember_value* result) {
+    if (a.type == EMBER_VAL_NUMBER && b.type == EMBER_VAL_NUMBER) {
+        double x = a.as.number_val;
+        double y = b.as.number_val;
+        switch (op) {
+            case OP_ADD: *result = ember_make_number(x + y); return true;
+            case OP_SUB: *result = ember_make_number(x - y); return true;
+            case OP_MUL: *result = ember_make_number(x * y); return true;
+            case OP_DIV:
+                // Division by zero is a runtime error
+                if (y == 0.0) return false;
+                *result = ember_make_number(x / y);
+                return true;
+            case OP_EQUAL:         *result = ember_make_bool(x == y); return true;
+            case OP_NOT_EQUAL:     *result = ember_make_bool(x != y); return true;
+            case OP_LESS:          *result = ember_make_bool(x < y); return true;
+            case OP_LESS_EQUAL:    *result = ember_make_bool(x <= y); return true;
+            case OP_GREATER:       *result = ember_make_bool(x > y); return true;
+            case OP_GREATER_EQUAL: *result = ember_make_bool(x >= y); return true;
+            default: return false;
+        }
+    }
+
+    if ((op == OP_EQUAL || op == OP_NOT_EQUAL) && a.type == b.type &&
+        (a.type == EMBER_VAL_BOOL || a.type == EMBER_VAL_NIL)) {
+        bool equal = a.type == EMBER_VAL_NIL || (a.as.bool_val != 0) == (b.as.bool_val != 0);
+        *result = ember_make_bool(op == OP_EQUAL ? equal : !equal);
+        return true;
+    }
+    return false;
+}
+
+// PUSH_CONST a, PUSH_CONST b, <op>  =>  PUSH_CONST (a op b)
+// PUSH_CONST a, NOT                 =>  PUSH_CONST !a
+static int pass_constant_folding(opt_program* prog, ember_optimization_stats* stats) {
+    int folded = 0;
+    int i = resolve(prog, 0);
+    while (i < prog->count) {
+        ember_value a, b, result;
+        int second = next_kept(prog, i);
+        bool changed = false;
+
+        if (constant_at(prog, i, &a) && second < prog->count && !is_jump_target(prog, second)) {
+            if (prog->code[second].op == OP_NOT) {
+                bool truthy;
+                if (known_truthiness(a, &truthy)) {
+                    int constant = find_or_add_constant(prog->chunk, ember_make_bool(!truthy));
+                    if (constant >= 0) {
+                        prog->code[i].operand = constant;
+                        remove_instruction(prog, second, stats);
+                        changed = true;
+                    }
+                }
+            } else if (constant_at(prog, second, &b)) {
+                int third = next_kept(prog, second);
+                if (third < prog->count && !is_jump_target(prog, third) &&
+                    fold_binary(prog->code[third].op, a, b, &result)) {
+                    int constant = find_or_add_constant(prog->chunk, result);
+                    if (constant >= 0) {
+                        prog->code[i].operand = constant;
+                        remove_instruction(prog, second, stats);
+                        remove_instruction(prog, third, stats);
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        if (changed) {
+            folded++;
+            stats->constant_folded++;
+            // The result may be the right operand of a fold that starts earlier
+            int previous = previous_kept(prog, i);
+            if (previous >= 0) i = previous;
+            continue;
+        }
+        i = second;
+    }
+    return folded;
+}
+
+// PUSH_CONST/GET_LOCAL x, POP            =>  (nothing)
+// SET_LOCAL n, POP, GET_LOCAL n          =>  SET_LOCAL n (likewise globals)
+static int pass_redundant_pushpop(opt_program* prog, ember_optimization_stats* stats) {
+    int removed = 0;
+    for (int i = resolve(prog, 0); i < prog->count; i = next_kept(prog, i)) {
+        opt_instruction* ins = &prog->code[i];
+        int second = next_kept(prog, i);
+        if (second >= prog->count || prog->code[second].op != OP_POP || is_jump_target(prog, second)) {
+            continue;
+        }
+
+        if (ins->op == OP_PUSH_CONST || ins->op == OP_GET_LOCAL) {
+            remove_instruction(prog, second, stats);
+            remove_instruction(prog, i, stats);
+            stats->redundant_push_pop++;
+            removed++;
+            continue;
+        }
+
+        uint8_t reload = ins->op == OP_SET_LOCAL ? OP_GET_LOCAL :
+                         ins->op == OP_SET_GLOBAL ? OP_GET_GLOBAL : 0;
+        int third = next_kept(prog, second);
+        if (reload && third < prog->count && !is_jump_target(prog, third) &&
+            prog->code[third].op == reload && prog->code[third].operand == ins->operand) {
+            // The store leaves the value on the stack already
+            remove_instruction(prog, second, stats);
+            remove_instruction(prog, third, stats);
+            stats->load_store_optimized++;
+            removed++;
+        }
+    }
+    return removed;
+}
+
+// Follow unconditional jumps from target; returns the final destination
+static int thread_target(const opt_program* prog, int from, int target) {
+    for (int hops = 0; hops < 16; hops++) {
+        if (target >= prog->count || target == from) break;
+        const opt_instruction* ins = &prog->code[target];
+        if (ins->op != OP_JUMP && ins->op != OP_LOOP) break;
+        int next = resolve(prog, ins->target);
+        if (next == target) break;
+        target = next;
+    }
+    return target;
+}
+
+// Jumps to the next instruction, jump-to-jump chains and branches on a
+// constant condition
+static int pass_jump_optimization(opt_program* prog, ember_optimization_stats* stats) {
+    int optimized = 0;
+    for (int i = resolve(prog, 0); i < prog->count; i = next_kept(prog, i)) {
+        opt_instruction* ins = &prog->code[i];
+        uint8_t op = ins->op;
+        if (op != OP_JUMP && op != OP_LOOP && !is_conditional_jump(op)) continue;
+
+        int target = resolve(prog, ins->target);
+        int threaded = thread_target(prog, i, target);
+        if (threaded != target && threaded != i && (threaded > i || !is_conditional_jump(op))) {
+            set_jump_target(prog, i, threaded);
+            if (!is_conditional_jump(op)) ins->op = threaded > i ? OP_JUMP : OP_LOOP;
+            target = threaded;
+            stats->eliminated_jumps++;
+            optimized++;
+        }
+
+        if (target == next_kept(prog, i)) {
+            if (is_conditional_jump(op)) {
+                // The condition still has to come off the stack
+                replace_jump(prog, i, OP_POP);
+                stats->removed_instructions++;
+            } else {
+                remove_instruction(prog, i, stats);
+            }
+            stats->eliminated_jumps++;
+            optimized++;
+            continue;
+        }
+
+        ember_value condition;
+        bool truthy;
+        int previous = previous_kept(prog, i);
+        if (is_conditional_jump(op) && previous >= 0 && !is_jump_target(prog, i) &&
+            constant_at(prog, previous, &condition) && known_truthiness(condition, &truthy)) {
+            bool taken = (op == OP_JUMP_IF_TRUE) == truthy;
+            remove_instruction(prog, previous, stats);
+            if (taken) {
+                ins->op = OP_JUMP;
+            } else {
+                remove_instruction(prog, i, stats);
+            }
+            stats->eliminated_jumps++;
+            optimized++;
+        }
+    }
+    return optimized;
+}
+
+// x / 2^k  =>  x * 2^-k, which is exact for every number x
+static int pass_strength_reduction(opt_program* prog, ember_optimization_stats* stats) {
+    int reduced = 0;
+    for (int i = resolve(prog, 0); i < prog->count; i = next_kept(prog, i)) {
+        ember_value divisor;
+        int second = next_kept(prog, i);
+        if (!constant_at(prog, i, &divisor) || divisor.type != EMBER_VAL_NUMBER ||
+            second >= prog->count || prog->code[second].op != OP_DIV || is_jump_target(prog, second)) {
+            continue;
+        }
+
+        int exponent;
+        double mantissa = frexp(divisor.as.number_val, &exponent);
+        double reciprocal = 1.0 / divisor.as.number_val;
+        if (fabs(mantissa) != 0.5 || !isnormal(reciprocal)) continue;
+
+        int constant = find_or_add_constant(prog->chunk, ember_make_number(reciprocal));
+        if (constant < 0) continue;
+        prog->code[i].operand = constant;
+        prog->code[second].op = OP_MUL;
+        stats->strength_reduced++;
+        reduced++;
+    }
+    return reduced;
+}
+
+static uint8_t fused_compare_op(uint8_t op) {
+    switch (op) {
+        case OP_LESS:          return OP_LOCAL_LESS_CONST_JUMP_IF_FALSE;
+        case OP_LESS_EQUAL:    return OP_LOCAL_LESS_EQUAL_CONST_JUMP_IF_FALSE;
+        case OP_GREATER:       return OP_LOCAL_GREATER_CONST_JUMP_IF_FALSE;
+        case OP_GREATER_EQUAL: return OP_LOCAL_GREATER_EQUAL_CONST_JUMP_IF_FALSE;
+        default:               return 0;
+    }
+}
+
+// GET_LOCAL n, PUSH_CONST k, ADD/SUB, SET_LOCAL n, POP  =>  ADD/SUB_LOCAL_CONST n k
+// GET_LOCAL n, PUSH_CONST k, ADD/SUB, SET_LOCAL n       =>  ADD/SUB_LOCAL_CONST n k, GET_LOCAL n
+// GET_LOCAL n, PUSH_CONST k, <cmp>, JUMP_IF_FALSE L     =>  LOCAL_<cmp>_CONST_JUMP_IF_FALSE n k L
+static bool fuse_local_const(opt_program* prog, int index, ember_optimization_stats* stats) {
+    opt_instruction* get = &prog->code[index];
+    if (get->op != OP_GET_LOCAL) return false;
+
+    ember_value value;
+    int push = next_kept(prog, index);
+    if (push >= prog->count || is_jump_target(prog, push) ||
+        !constant_at(prog, push, &value) || value.type != EMBER_VAL_NUMBER) {
+        return false;
+    }
+    int operation = next_kept(prog, push);
+    int last = operation < prog->count ? next_kept(prog, operation) : prog->count;
+    if (last >= prog->count || is_jump_target(prog, operation) || is_jump_target(prog, last)) {
+        return false;
+    }
+
+    uint8_t op = prog->code[operation].op;
+    opt_instruction* tail = &prog->code[last];
+    int constant = prog->code[push].operand;
+
+    if ((op == OP_ADD || op == OP_SUB) && tail->op == OP_SET_LOCAL && tail->operand == get->operand) {
+        int pop = next_kept(prog, last);
+        bool discarded = pop < prog->count && prog->code[pop].op == OP_POP && !is_jump_target(prog, pop);
+        get->op = op == OP_ADD ? OP_ADD_LOCAL_CONST : OP_SUB_LOCAL_CONST;
+        get->constant = constant;
+        remove_instruction(prog, push, stats);
+        remove_instruction(prog, operation, stats);
+        if (discarded) {
+            remove_instruction(prog, last, stats);
+            remove_instruction(prog, pop, stats);
+        } else {
+            // The assigned value is still used
+            tail->op = OP_GET_LOCAL;
+        }
+        return true;
+    }
+
+    uint8_t compare = fused_compare_op(op);
+    if (compare && tail->op == OP_JUMP_IF_FALSE) {
+        int target = resolve(prog, tail->target);
+        remove_instruction(prog, push, stats);
+        remove_instruction(prog, operation, stats);
+        remove_instruction(prog, last, stats);
+        get->op = compare;
+        get->constant = constant;
+        get->target = target;
+        if (target < prog->count) prog->code[target].jump_in++;
+        return true;
+    }
+    return false;
+}
+
+// Superinstructions for local/constant arithmetic and loop tests, and
+// NOT, JUMP_IF_FALSE  =>  JUMP_IF_TRUE (and the reverse)
+static int pass_instruction_fusion(opt_program* prog, ember_optimization_stats* stats) {
+    int fused = 0;
+    for (int i = resolve(prog, 0); i < prog->count; i = next_kept(prog, i)) {
+        if (fuse_local_const(prog, i, stats)) {
+            stats->instruction_fused++;
+            fused++;
+            continue;
+        }
+
+        int second = next_kept(prog, i);
+        if (prog->code[i].op != OP_NOT || second >= prog->count ||
+            !is_conditional_jump(prog->code[second].op) || is_jump_target(prog, second)) {
+            continue;
+        }
+        opt_instruction* jump = &prog->code[second];
+        jump->op = jump->op == OP_JUMP_IF_FALSE ? OP_JUMP_IF_TRUE : OP_JUMP_IF_FALSE;
+        remove_instruction(prog, i, stats);
+        stats->instruction_fused++;
+        fused++;
+    }
+    return fused;
+}
+
+// Back edges into a loop header whose condition is a constant that keeps
+// the loop running skip straight to the body
+static int pass_loop_optimization(opt_program* prog, ember_optimization_stats* stats) {
+    int optimized = 0;
+    for (int i = resolve(prog, 0); i < prog->count; i = next_kept(prog, i)) {
+        opt_instruction* ins = &prog->code[i];
+        if (ins->op != OP_LOOP && ins->op != OP_JUMP) continue;
+
+        ember_value condition;
+        bool truthy;
+        int header = resolve(prog, ins->target);
+        if (!constant_at(prog, header, &condition) || !known_truthiness(condition, &truthy)) continue;
+
+        int test = next_kept(prog, header);
+        if (test >= prog->count || !is_conditional_jump(prog->code[test].op)) continue;
+        bool exits = (prog->code[test].op == OP_JUMP_IF_TRUE) == truthy;
+        if (exits) continue;
+
+        set_jump_target(prog, i, next_kept(prog, test));
+        stats->loop_optimized++;
+        optimized++;
+    }
+    return optimized;
+}
+
+// Handlers, catch blocks and switch cases are entered by the VM scanning
+// the bytecode or through a table, not through jumps, so reachability
+// cannot be judged there
+static bool has_implicit_entries(const opt_program* prog) {
+    if (prog->chunk->handler_count > 0) return true;
+    for (int i = 0; i < prog->count; i++) {
+        switch (prog->code[i].op) {
+            case OP_TRY_BEGIN:
+            case OP_CATCH_BEGIN:
+            case OP_CATCH_TYPE:
+            case OP_FINALLY_BEGIN:
+            case OP_SWITCH:
+            case OP_CASE:
+            case OP_DEFAULT:
+            case OP_SWITCH_TABLE:
+                return true;
+            default:
+                break;
+        }
+    }
+    return false;
+}
+
+static bool falls_through(uint8_t op) {
+    switch (op) {
+        case OP_JUMP:
+        case OP_LOOP:
+        case OP_BREAK:
+        case OP_CONTINUE:
+        case OP_RETURN:
+        case OP_HALT:
+        case OP_THROW:
+        case OP_RETHROW:
+        case OP_SWITCH_TABLE:
+            return false;
+        default:
+            return true;
+    }
+}
+
+// Remove code no path from the entry reaches (after RETURN, JUMP, ...)
+static int pass_control_flow(opt_program* prog, ember_optimization_stats* stats) {
+    if (prog->count <= 0 || has_implicit_entries(prog)) return 0;
+
+    bool* reachable = calloc((size_t)prog->count, sizeof(bool));
+    int* worklist = malloc(sizeof(int) * (size_t)prog->count);
+    if (!reachable || !worklist) {
+        free(reachable);
+        free(worklist);
+        return 0;
+    }
+
+    int pending = 0;
+    int entry = resolve(prog, 0);
+    if (entry < prog->count) {
+        reachable[entry] = true;
+        worklist[pending++] = entry;
+    }
+    while (pending > 0) {
+        int i = worklist[--pending];
+        const opt_instruction* ins = &prog->code[i];
+        int successors[2];
+        int successor_count = 0;
+        if (falls_through(ins->op)) successors[successor_count++] = next_kept(prog, i);
+        if (jump_kind(ins->op) != OPT_JUMP_NONE) successors[successor_count++] = resolve(prog, ins->target);
+
+        for (int s = 0; s < successor_count; s++) {
+            int next = successors[s];
+            if (next < prog->count && !reachable[next]) {
+                reachable[next] = true;
+                worklist[pending++] = next;
+            }
+        }
+    }
+
+    int removed = 0;
+    for (int i = 0; i < prog->count; i++) {
+        if (!prog->code[i].removed && !reachable[i]) {
+            remove_instruction(prog, i, stats);
+            stats->control_flow_optimized++;
+            removed++;
+        }
+    }
+    free(reachable);
+    free(worklist);
+    return removed;
+}
+
+// CALL, RETURN  =>  TAIL_CALL, RETURN. The RETURN stays for callees that
+// cannot reuse the frame (natives). Not applied where the frame must
+// outlive the call: exception handlers and generator/async bodies.
+static int pass_tail_calls(opt_program* prog, ember_optimization_stats* stats) {
+    if (prog->chunk->handler_count > 0) return 0;
+    for (int i = 0; i < prog->count; i++) {
+        switch (prog->code[i].op) {
+            case OP_TRY_BEGIN:
+            case OP_FINALLY_BEGIN:
+            case OP_YIELD:
+            case OP_AWAIT:
+                return 0;
+            default:
+                break;
+        }
+    }
+
+    int converted = 0;
+    for (int i = resolve(prog, 0); i < prog->count; i = next_kept(prog, i)) {
+        int next = next_kept(prog, i);
+        if (prog->code[i].op != OP_CALL || next >= prog->count || prog->code[next].op != OP_RETURN) continue;
+        prog->code[i].op = OP_TAIL_CALL;
+        stats->tail_calls++;
+        converted++;
+    }
+    return converted;
+}
+
+static int stack_effect(const opt_instruction* ins) {
+    switch (ins->op) {
+        case OP_PUSH_CONST:
+        case OP_GET_LOCAL:
+        case OP_GET_GLOBAL:
+            return 1;
+        case OP_POP:
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_MOD:
+        case OP_EQUAL:
+        case OP_NOT_EQUAL:
+        case OP_LESS:
+        case OP_LESS_EQUAL:
+        case OP_GREATER:
+        case OP_GREATER_EQUAL:
+        case OP_AND:
+        case OP_OR:
+        case OP_JUMP_IF_FALSE:
+        case OP_JUMP_IF_TRUE:
+        case OP_RETURN:
+        case OP_ARRAY_GET:
+        case OP_HASH_MAP_GET:
+        case OP_SET_PROPERTY:
+        case OP_SWITCH_TABLE:
+        case OP_CALL_GUARD:
+            return -1;
+        case OP_CALL:
+        case OP_TAIL_CALL:
+        case OP_INVOKE:
+            return -ins->operand;
+        case OP_ARRAY_NEW:
+        case OP_CONCAT_N:
+            return 1 - ins->operand;
+        case OP_HASH_MAP_NEW:
+            return 1 - 2 * ins->operand;
+        default:
+            return 0;
+    }
+}
+
+static int max_stack_depth(const opt_program* prog) {
+    int depth = 0;
+    int max_depth = 0;
+    for (int i = 0; i < prog->count; i++) {
+        if (prog->code[i].removed) continue;
+        depth += stack_effect(&prog->code[i]);
+        if (depth < 0) depth = 0;
+        if (depth > max_depth) max_depth = depth;
+    }
+    return max_depth;
+}
+
+int ember_optimize_register_allocation(ember_chunk* chunk, ember_optimization_stats* stats) {
+    if (!chunk || !stats) return 0;
+    opt_program prog;
+    if (!program_decode(&prog, chunk)) return 0;
+    int depth = max_stack_depth(&prog);
+    program_free(&prog);
+
+    stats->register_allocated = depth;
+    return depth > 0 && depth <= EMBER_STACK_MAX;
+}
+
+typedef int (*opt_pass)(opt_program* prog, ember_optimization_stats* stats);
+
+static int run_pass(ember_chunk* chunk, ember_optimization_stats* stats, opt_pass pass) {
+    if (!chunk || !stats) return 0;
+    opt_program prog;
+    if (!program_decode(&prog, chunk)) return 0;
+
+    int changes = pass(&prog, stats);
+    if (changes > 0 && !program_encode(&prog)) changes = 0;
+    stats->optimized_instructions += changes;
+    program_free(&prog);
+    return changes;
+}
+
+int ember_optimize_constant_folding(ember_chunk* chunk, ember_optimization_stats* stats) {
+    return run_pass(chunk, stats, pass_constant_folding);
+}
+
+int ember_optimize_redundant_pushpop(ember_chunk* chunk, ember_optimization_stats* stats) {
+    return run_pass(chunk, stats, pass_redundant_pushpop);
+}
+
+int ember_optimize_jump_optimization(ember_chunk* chunk, ember_optimization_stats* stats) {
+    return run_pass(chunk, stats, pass_jump_optimization);
+}
+
+int ember_optimize_strength_reduction(ember_chunk* chunk, ember_optimization_stats* stats) {
+    return run_pass(chunk, stats, pass_strength_reduction);
+}
+
+int ember_optimize_instruction_fusion(ember_chunk* chunk, ember_optimization_stats* stats) {
+    return run_pass(chunk, stats, pass_instruction_fusion);
+}
+
+int ember_optimize_loop_optimization(ember_chunk* chunk, ember_optimization_stats* stats) {
+    return run_pass(chunk, stats, pass_loop_optimization);
+}
+
+int ember_optimize_control_flow(ember_chunk* chunk, ember_optimization_stats* stats) {
+    return run_pass(chunk, stats, pass_control_flow);
+}
+
+int ember_optimize_tail_calls(ember_chunk* chunk, ember_optimization_stats* stats) {
+    return run_pass(chunk, stats, pass_tail_calls);
+}
+
+// Inlining. A call to a global function whose body is a few instructions
+// with no calls, loops, handlers or switch tables (forward branches are
+// fine) is replaced by a copy of the body working in locals past the
+// caller's own:
+//
+//   <args> GET_GLOBAL f, CALL_GUARD f slow, SET_LOCAL b+n-1, POP, ... SET_LOCAL b, POP,
+//   <body, each RETURN a JUMP done>, slow: CALL n, done:
+//
+// The guard checks the callee is still the function the body was copied
+// from; when the global was reassigned the callee stays on the stack and
+// the real call runs. Needs the VM to look the globals up, so it is not one
+// of the ember_optimize_chunk passes; the compiler runs it on each function
+// at level 2 and above before the peephole passes.
+
+#define INLINE_MAX_CALLEE_BYTES 40   // Callee code size, in bytes
+#define INLINE_MAX_GROWTH 320        // Callee code copied into one caller
+#define INLINE_MAX_SLOTS 64          // Callee locals, tracked as a bitmask
+
+typedef struct {
+    opt_program body;
+    int* depths;    // Stack depth before each callee instruction, -1 if unreached
+    int slots;      // Local slots the callee uses
+    int constant;   // Caller constant holding the callee, for the guard
+} inline_callee;
+
+static bool inline_reads_slot(uint8_t op) {
+    return op == OP_GET_LOCAL || opcode_fused_size(op) > 0;
+}
+
+// Values the instruction pops and pushes; false if it cannot be inlined
+static bool inline_stack_effect(uint8_t op, int* pops, int* pushes) {
+    *pops = 0;
+    *pushes = 0;
+    switch (op) {
+        case OP_PUSH_CONST:
+        case OP_GET_LOCAL:
+        case OP_GET_GLOBAL:
+            *pushes = 1;
+            return true;
+        case OP_SET_LOCAL:
+        case OP_SET_GLOBAL:
+        case OP_NOT:
+            *pops = 1;
+            *pushes = 1;
+            return true;
+        case OP_POP:
+        case OP_JUMP_IF_FALSE:
+        case OP_JUMP_IF_TRUE:
+        case OP_RETURN:
+            *pops = op == OP_RETURN ? 0 : 1;
+            return true;
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_MOD:
+        case OP_EQUAL:
+        case OP_NOT_EQUAL:
+        case OP_LESS:
+        case OP_LESS_EQUAL:
+        case OP_GREATER:
+        case OP_GREATER_EQUAL:
+        case OP_ARRAY_GET:
+            *pops = 2;
+            *pushes = 1;
+            return true;
+        case OP_JUMP:
+        case OP_ADD_LOCAL_CONST:
+        case OP_SUB_LOCAL_CONST:
+        case OP_LOCAL_LESS_CONST_JUMP_IF_FALSE:
+        case OP_LOCAL_LESS_EQUAL_CONST_JUMP_IF_FALSE:
+        case OP_LOCAL_GREATER_CONST_JUMP_IF_FALSE:
+        case OP_LOCAL_GREATER_EQUAL_CONST_JUMP_IF_FALSE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool inline_constant_allowed(const ember_chunk* chunk, int constant) {
+    if (constant < 0 || constant >= chunk->const_count) return false;
+    switch (chunk->constants[constant].type) {
+        case EMBER_VAL_NIL:
+        case EMBER_VAL_BOOL:
+        case EMBER_VAL_NUMBER:
+            return true;
+        case EMBER_VAL_STRING:
+            return chunk->constants[constant].as.obj_val != NULL;
+        default:
+            return false;
+    }
+}
+
+// Walk the callee in order (its jumps only go forward, so every path into an
+// instruction has been seen before it) tracking the stack depth and which
+// slots are assigned on every path. A slot past the arguments read before
+// that would see the previous call's value once inlined.
+static bool inline_analyze(inline_callee* callee, int argc) {
+    opt_program* body = &callee->body;
+    int count = body->count;
+    uint64_t* assigned = calloc((size_t)count + 1, sizeof(uint64_t));
+    callee->depths = malloc(sizeof(int) * ((size_t)count + 1));
+    if (!assigned || !callee->depths) {
+        free(assigned);
+        return false;
+    }
+    for (int i = 0; i <= count; i++) callee->depths[i] = -1;
+    callee->depths[0] = 0;
+    assigned[0] = argc >= 64 ? ~0ull : (1ull << argc) - 1;
+    callee->slots = argc;
+
+    bool ok = true;
+    for (int i = 0; ok && i < count; i++) {
+        int depth = callee->depths[i];
+        if (depth < 0) continue;
+        opt_instruction* ins = &body->code[i];
+        ins->op = opcode_generic(ins->op);
+        int pops;
+        int pushes;
+        if (!inline_stack_effect(ins->op, &pops, &pushes) || depth < pops ||
+            (ins->op == OP_RETURN && depth > 1)) {
+            ok = false;
+            break;
+        }
+
+        uint64_t state = assigned[i];
+        bool local = ins->op == OP_GET_LOCAL || ins->op == OP_SET_LOCAL || opcode_fused_size(ins->op) > 0;
+        if (local) {
+            if (ins->operand < 0 || ins->operand >= INLINE_MAX_SLOTS ||
+                (inline_reads_slot(ins->op) && !(state & (1ull << ins->operand)))) {
+                ok = false;
+                break;
+            }
+            state |= 1ull << ins->operand;
+            if (ins->operand + 1 > callee->slots) callee->slots = ins->operand + 1;
+        }
+        int constant = opcode_fused_size(ins->op) > 0 ? ins->constant :
+                       ins->op == OP_PUSH_CONST || ins->op == OP_GET_GLOBAL || ins->op == OP_SET_GLOBAL ? ins->operand : -1;
+        if (constant >= 0 && !inline_constant_allowed(body->chunk, constant)) {
+            ok = false;
+            break;
+        }
+        if (ins->op == OP_RETURN) continue;
+
+        int successors[2];
+        int successor_count = 0;
+        if (ins->op != OP_JUMP) successors[successor_count++] = i + 1;
+        if (jump_kind(ins->op) == OPT_JUMP_FORWARD) successors[successor_count++] = ins->target;
+        for (int s = 0; s < successor_count; s++) {
+            int next = successors[s];
+            // Running off the end (no RETURN) is left to a real call
+            if (next >= count) {
+                ok = false;
+                break;
+            }
+            if (callee->depths[next] < 0) {
+                callee->depths[next] = depth - pops + pushes;
+                assigned[next] = state;
+            } else if (callee->depths[next] != depth - pops + pushes) {
+                ok = false;
+                break;
+            } else {
+                assigned[next] &= state;
+            }
+        }
+    }
+    free(assigned);
+    return ok;
+}
+
+// The global function GET_GLOBAL names, if its body can be inlined
+static ember_chunk* inline_candidate(ember_vm* vm, const opt_program* prog, int get, int argc) {
+    ember_chunk* chunk = prog->chunk;
+    int constant = prog->code[get].operand;
+    if (argc < 0 || argc > INLINE_MAX_SLOTS || constant < 0 || constant >= chunk->const_count ||
+        chunk->constants[constant].type != EMBER_VAL_STRING || !chunk->constants[constant].as.obj_val) {
+        return NULL;
+    }
+    ember_string* name = AS_STRING(chunk->constants[constant]);
+    int slot = ember_global_find(vm, ember_string_flatten(name), (int)name->length);
+    if (slot < 0) return NULL;
+    ember_value value = vm->globals[slot].value;
+    if (value.type != EMBER_VAL_FUNCTION) return NULL;
+    ember_chunk* callee = value.as.func_val.chunk;
+    if (!callee || callee == chunk || callee->lazy_body || callee->is_generator || callee->count == 0 ||
+        callee->count > INLINE_MAX_CALLEE_BYTES || callee->handler_count > 0 || callee->switch_table_count > 0) {
+        return NULL;
+    }
+    return callee;
+}
+
+// A caller constant holding the callee (unnamed, so no name is shared)
+static int inline_function_constant(ember_chunk* chunk, ember_chunk* callee) {
+    for (int i = 0; i < chunk->const_count; i++) {
+        ember_value value = chunk->constants[i];
+        if (value.type == EMBER_VAL_FUNCTION && value.as.func_val.chunk == callee && !value.as.func_val.name) {
+            return i;
+        }
+    }
+    if (chunk->const_count >= EMBER_CONST_POOL_MAX) return -1;
+    ember_value value;
+    value.type = EMBER_VAL_FUNCTION;
+    value.as.func_val.chunk = callee;
+    value.as.func_val.name = NULL;
+    return add_constant(chunk, value);
+}
+
+// Move the callee's constants into the caller; false if the pool is full
+static bool inline_remap_constants(inline_callee* callee, ember_chunk* chunk) {
+    opt_program* body = &callee->body;
+    for (int i = 0; i < body->count; i++) {
+        opt_instruction* ins = &body->code[i];
+        if (callee->depths[i] < 0) continue;
+        int* constant = opcode_fused_size(ins->op) > 0 ? &ins->constant :
+                        ins->op == OP_PUSH_CONST || ins->op == OP_GET_GLOBAL || ins->op == OP_SET_GLOBAL ? &ins->operand : NULL;
+        if (!constant) continue;
+        *constant = find_or_add_constant(chunk, body->chunk->constants[*constant]);
+        if (*constant < 0) return false;
+    }
+    return true;
+}
+
+static opt_instruction inline_instruction(uint8_t op, int operand, int constant, int target) {
+    opt_instruction ins = {op, operand, constant, target, 0, false, false};
+    return ins;
+}
+
+// Lay out the caller again with the call after each sites[s] expanded
+static bool inline_expand(opt_program* prog, const int* sites, inline_callee* callees, int site_count,
+                          int base, int nil) {
+    int capacity = prog->count;
+    for (int s = 0; s < site_count; s++) {
+        capacity += 1 + 2 * prog->code[sites[s] + 1].operand + 2 * callees[s].body.count;
+    }
+    opt_instruction* code = malloc(sizeof(opt_instruction) * (size_t)capacity);
+    bool* placed = malloc(sizeof(bool) * (size_t)capacity);
+    int* new_index = malloc(sizeof(int) * ((size_t)prog->count + 1));
+    int body_index[INLINE_MAX_CALLEE_BYTES + 1];
+    if (!code || !placed || !new_index) {
+        free(code);
+        free(placed);
+        free(new_index);
+        return false;
+    }
+
+    // Caller jumps keep their old targets until new_index is complete;
+    // placed marks the new instructions, whose targets are final
+    int count = 0;
+    for (int i = 0, s = 0; i < prog->count; i++) {
+        new_index[i] = count;
+        placed[count] = false;
+        code[count++] = prog->code[i];
+        if (s >= site_count || sites[s] != i) continue;
+
+        inline_callee* callee = &callees[s++];
+        opt_program* body = &callee->body;
+        int argc = prog->code[i + 1].operand;
+        int prologue = 1 + 2 * argc;
+        int at = count + prologue;
+        for (int b = 0; b < body->count; b++) {
+            body_index[b] = at;
+            if (callee->depths[b] < 0) continue;
+            at += body->code[b].op == OP_RETURN && callee->depths[b] == 0 ? 2 : 1;
+        }
+        int slow = at;
+
+        code[count] = inline_instruction(OP_CALL_GUARD, argc, callee->constant, slow);
+        placed[count++] = true;
+        for (int a = argc - 1; a >= 0; a--) {
+            code[count] = inline_instruction(OP_SET_LOCAL, base + a, -1, -1);
+            placed[count++] = true;
+            code[count] = inline_instruction(OP_POP, -1, -1, -1);
+            placed[count++] = true;
+        }
+        for (int b = 0; b < body->count; b++) {
+            if (callee->depths[b] < 0) continue;
+            opt_instruction ins = body->code[b];
+            ins.jump_in = 0;
+            ins.wide = false;
+            if (ins.op == OP_GET_LOCAL || ins.op == OP_SET_LOCAL || opcode_fused_size(ins.op) > 0) {
+                ins.operand += base;
+            }
+            if (jump_kind(ins.op) != OPT_JUMP_NONE) ins.target = body_index[ins.target];
+            if (ins.op == OP_RETURN) {
+                if (callee->depths[b] == 0) {
+                    code[count] = inline_instruction(OP_PUSH_CONST, nil, -1, -1);
+                    placed[count++] = true;
+                }
+                // To the caller instruction after the real call
+                ins = inline_instruction(OP_JUMP, 0, -1, slow + 1);
+            }
+            code[count] = ins;
+            placed[count++] = true;
+        }
+
+        new_index[++i] = count;
+        code[count] = prog->code[i];
+        placed[count++] = true;
+    }
+    new_index[prog->count] = count;
+
+    for (int c = 0; c < count; c++) {
+        if (!placed[c] && code[c].target >= 0) code[c].target = new_index[code[c].target];
+    }
+    int handler_points = prog->handler_points ? prog->chunk->handler_count * 3 : 0;
+    int switch_points = 0;
+    for (int t = 0; prog->switch_points && t < prog->chunk->switch_table_count; t++) {
+        switch_points += prog->chunk->switch_tables[t].count + 1;
+    }
+    for (int h = 0; h < handler_points; h++) prog->handler_points[h] = new_index[prog->handler_points[h]];
+    for (int p = 0; p < switch_points; p++) prog->switch_points[p] = new_index[prog->switch_points[p]];
+    // Inlined code belongs to the line of its call
+    for (int r = 0; r < prog->line_run_count; r++) {
+        prog->line_runs[r].start = new_index[prog->line_runs[r].start];
+    }
+
+    free(prog->code);
+    prog->code = code;
+    prog->count = count;
+    for (int c = 0; c < count; c++) {
+        code[c].jump_in = 0;
+    }
+    for (int c = 0; c < count; c++) {
+        if (code[c].target >= 0 && code[c].target < count) code[c].jump_in++;
+    }
+    for (int h = 0; h < handler_points; h++) {
+        if (prog->handler_points[h] < count) code[prog->handler_points[h]].jump_in++;
+    }
+    for (int p = 0; p < switch_points; p++) {
+        if (prog->switch_points[p] < count) code[prog->switch_points[p]].jump_in++;
+    }
+    free(placed);
+    free(new_index);
+    return true;
+}
+
+static int caller_slots(const opt_program* prog) {
+    int slots = 0;
+    for (int i = 0; i < prog->count; i++) {
+        const opt_instruction* ins = &prog->code[i];
+        if ((ins->op == OP_GET_LOCAL || ins->op == OP_SET_LOCAL || opcode_fused_size(ins->op) > 0) &&
+            ins->operand + 1 > slots) {
+            slots = ins->operand + 1;
+        }
+    }
+    return slots;
+}
+
+int ember_optimize_inline_calls(ember_vm* vm, ember_chunk* chunk, ember_optimization_stats* stats) {
+    ember_optimization_stats local_stats;
+    if (!stats) {
+        ember_init_optimization_stats(&local_stats);
+        stats = &local_stats;
+    }
+    if (!vm || !chunk || vm->debug_hooks) return 0;
+
+    opt_program prog;
+    if (!program_decode(&prog, chunk)) return 0;
+    int* sites = malloc(sizeof(int) * ((size_t)prog.count + 1));
+    inline_callee* callees = malloc(sizeof(inline_callee) * ((size_t)prog.count + 1));
+    int base = caller_slots(&prog);
+    if (!sites || !callees) {
+        free(sites);
+        free(callees);
+        program_free(&prog);
+        return 0;
+    }
+
+    int site_count = 0;
+    int growth = 0;
+    for (int i = 0; i + 1 < prog.count; i++) {
+        opt_instruction* call = &prog.code[i + 1];
+        if (prog.code[i].op != OP_GET_GLOBAL || call->op != OP_CALL || is_jump_target(&prog, i + 1)) continue;
+        ember_chunk* target = inline_candidate(vm, &prog, i, call->operand);
+        if (!target || growth + target->count > INLINE_MAX_GROWTH) continue;
+
+        inline_callee* callee = &callees[site_count];
+        callee->depths = NULL;
+        if (!program_decode(&callee->body, target)) continue;
+        bool ok = inline_analyze(callee, call->operand) && base + callee->slots <= EMBER_LOCALS_MAX;
+        if (ok) {
+            callee->constant = inline_function_constant(chunk, target);
+            ok = callee->constant >= 0 && inline_remap_constants(callee, chunk);
+        }
+        if (!ok) {
+            program_free(&callee->body);
+            free(callee->depths);
+            continue;
+        }
+        growth += target->count;
+        sites[site_count++] = i;
+        i++;
+    }
+
+    int inlined = 0;
+    int nil = site_count > 0 ? find_or_add_constant(chunk, ember_make_nil()) : -1;
+    if (nil >= 0 && inline_expand(&prog, sites, callees, site_count, base, nil) && program_encode(&prog)) {
+        inlined = site_count;
+        stats->inlined_calls += inlined;
+        stats->optimized_instructions += inlined;
+    }
+    for (int s = 0; s < site_count; s++) {
+        program_free(&callees[s].body);
+        free(callees[s].depths);
+    }
+    free(sites);
+    free(callees);
+    program_free(&prog);
+    return inlined;
+}
+
+int ember_optimize_chunk(ember_chunk* chunk, int flags, ember_optimization_stats* stats) {
+    ember_optimization_stats local_stats;
+    if (!stats) {
+        ember_init_optimization_stats(&local_stats);
+        stats = &local_stats;
+    }
+    if (!chunk) return 0;
+
+    opt_program prog;
+    if (!program_decode(&prog, chunk)) return 0;
+    stats->total_instructions += prog.count;
+
+    // Folding first so the jump passes see constant conditions; the loop pass
+    // must run before the jump pass removes the loop's constant test
+    static const struct {
+        int flag;
+        opt_pass pass;
+    } passes[] = {
+        {OPT_CONSTANT_FOLDING, pass_constant_folding},
+        {OPT_STRENGTH_REDUCTION, pass_strength_reduction},
+        {OPT_REDUNDANT_PUSHPOP, pass_redundant_pushpop},
+        {OPT_INSTRUCTION_FUSION, pass_instruction_fusion},
+        {OPT_LOOP_OPTIMIZATION, pass_loop_optimization},
+        {OPT_JUMP_OPTIMIZATION, pass_jump_optimization},
+        {OPT_CONTROL_FLOW, pass_control_flow},
+        {OPT_TAIL_CALLS, pass_tail_calls},
+    };
+
+    int total = 0;
+    for (int round = 0; round < OPT_MAX_PASSES; round++) {
+        int changes = 0;
+        stats->optimization_passes++;
+        for (size_t p = 0; p < sizeof(passes) / sizeof(passes[0]); p++) {
+            if (flags & passes[p].flag) changes += passes[p].pass(&prog, stats);
+        }
+        total += changes;
+        if (changes == 0) break;
+    }
+
+    if (total > 0 && !program_encode(&prog)) {
+        fprintf(stderr, "Optimizer: jump offsets out of range, chunk left unoptimized\n");
+        total = 0;
+    }
+    if (flags & OPT_REGISTER_ALLOCATION) {
+        stats->register_allocated = max_stack_depth(&prog);
+    }
+    stats->optimized_instructions += total;
+    program_free(&prog);
+    return total;
+}
+
+int ember_optimize_for_level(ember_chunk* chunk) {
+    int flags;
+    switch (optimization_level) {
+        case 0: return 0;
+        case 1: flags = OPT_LEVEL_BASIC; break;
+        case 2: flags = OPT_LEVEL_ADVANCED; break;
+        default: flags = OPT_ALL; break;
+    }
+    return ember_optimize_chunk(chunk, flags, NULL);
+}
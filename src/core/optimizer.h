@@ -0,0 +1,100 @@
+#ifndef EMBER_OPTIMIZER_H
+#define EMBER_OPTIMIZER_H
+
+#include "../../include/ember.h"
+
+// Bytecode peephole optimizer. Each pass decodes the chunk into instructions,
+// rewrites them in place and re-encodes the chunk with jump offsets (and
+// their compact/OP_WIDE form) recomputed. A chunk that does not decode
+// cleanly is left untouched.
+
+// Optimization pass selection for ember_optimize_chunk
+#define OPT_CONSTANT_FOLDING     (1 << 0)
+#define OPT_REDUNDANT_PUSHPOP    (1 << 1)
+#define OPT_JUMP_OPTIMIZATION    (1 << 2)
+#define OPT_STRENGTH_REDUCTION   (1 << 3)
+#define OPT_INSTRUCTION_FUSION   (1 << 4)
+#define OPT_LOOP_OPTIMIZATION    (1 << 5)
+#define OPT_CONTROL_FLOW         (1 << 6)
+#define OPT_REGISTER_ALLOCATION  (1 << 7)
+#define OPT_TAIL_CALLS           (1 << 8)
+
+// Passes run at each vm_set_optimization_level level
+#define OPT_LEVEL_BASIC    (OPT_CONSTANT_FOLDING | OPT_REDUNDANT_PUSHPOP | \
+                            OPT_JUMP_OPTIMIZATION | OPT_CONTROL_FLOW | \
+                            OPT_TAIL_CALLS)
+#define OPT_LEVEL_ADVANCED (OPT_LEVEL_BASIC | OPT_STRENGTH_REDUCTION | \
+                            OPT_INSTRUCTION_FUSION | OPT_LOOP_OPTIMIZATION)
+#define OPT_ALL            (OPT_LEVEL_ADVANCED | OPT_REGISTER_ALLOCATION)
+
+// Passes repeat until nothing changes, up to this many times
+#define OPT_MAX_PASSES 8
+
+// Defines ember_optimization_stats_t from ember.h
+struct ember_optimization_stats {
+    int total_instructions;      // Instructions before optimization
+    int optimized_instructions;  // Rewrites applied across all passes
+    int removed_instructions;
+    int constant_folded;
+    int redundant_push_pop;
+    int combined_arithmetic;
+    int eliminated_jumps;
+    int load_store_optimized;
+    int instruction_fused;
+    int strength_reduced;
+    int loop_optimized;
+    int control_flow_optimized;
+    int tail_calls;
+    int inlined_calls;
+    int register_allocated;      // Stack slots the chunk needs
+    int optimization_passes;
+
+    // Run time counters of a VM, filled by ember_get_optimization_stats
+    uint64_t instructions_executed;
+    uint64_t function_calls;
+    uint64_t jit_compilations;
+    uint64_t jit_deopts;
+    uint64_t osr_entries;
+    const ember_profile* profile;  // NULL unless ember_vm_set_profiling is on
+};
+typedef struct ember_optimization_stats ember_optimization_stats;
+
+// Byte pattern over raw bytecode; 0xFF matches any byte
+typedef struct {
+    uint8_t* instructions;
+    int length;
+    int parameter_count;
+} ember_instruction_pattern;
+
+#define OPT_PATTERN_WILDCARD 0xFF
+
+void ember_init_optimization_stats(ember_optimization_stats* stats);
+int ember_match_pattern(const uint8_t* code, int offset, int count, const ember_instruction_pattern* pattern);
+
+// Run the passes selected by flags; returns the number of rewrites
+int ember_optimize_chunk(ember_chunk* chunk, int flags, ember_optimization_stats* stats);
+
+// Optimize a freshly compiled chunk at the level set by vm_set_optimization_level
+int ember_optimize_for_level(ember_chunk* chunk);
+int vm_get_optimization_level(void);
+
+// Individual passes; each returns the number of rewrites it made
+int ember_optimize_constant_folding(ember_chunk* chunk, ember_optimization_stats* stats);
+int ember_optimize_redundant_pushpop(ember_chunk* chunk, ember_optimization_stats* stats);
+int ember_optimize_jump_optimization(ember_chunk* chunk, ember_optimization_stats* stats);
+int ember_optimize_strength_reduction(ember_chunk* chunk, ember_optimization_stats* stats);
+int ember_optimize_instruction_fusion(ember_chunk* chunk, ember_optimization_stats* stats);
+int ember_optimize_loop_optimization(ember_chunk* chunk, ember_optimization_stats* stats);
+int ember_optimize_control_flow(ember_chunk* chunk, ember_optimization_stats* stats);
+int ember_optimize_tail_calls(ember_chunk* chunk, ember_optimization_stats* stats);
+
+// Inline calls to small global functions into chunk (level 2 and above,
+// before the other passes); returns the number of call sites inlined. Not
+// run while a debugger is attached.
+int ember_optimize_inline_calls(ember_vm* vm, ember_chunk* chunk, ember_optimization_stats* stats);
+
+// Analysis only: records the chunk's maximum stack depth in
+// stats->register_allocated; returns 1 if it fits in EMBER_STACK_MAX
+int ember_optimize_register_allocation(ember_chunk* chunk, ember_optimization_stats* stats);
+
+#endif // EMBER_OPTIMIZER_H
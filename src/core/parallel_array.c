@@ -0,0 +1,531 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "../runtime/value/value.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// Parallel array functions (parallel_map, parallel_filter, parallel_reduce).
+// The array is cut into ranges that run as native work on the workers of the
+// executor set with ember_vm_set_executor. The callback crosses by name: it
+// must be a global function that the executor's prelude also defines, and it
+// is called on a worker as fn(element, index, nil) or fn(acc, element,
+// index, nil); a worker only holds its own range, so there is no array.
+//
+// Values are cloned between VMs through a flat encoding: nil, booleans,
+// numbers, strings, and arrays and hash maps of those, nested up to
+// PARALLEL_DEPTH_MAX. Each range is encoded before any is submitted, and
+// the results are decoded and stitched back in order on the caller's VM.
+//
+// Small arrays, callbacks that are not named functions, elements that cannot
+// be cloned, a VM without an executor, and calls from the executor's own
+// workers (which could wait on work queued behind themselves) run
+// sequentially through array_map, array_filter and array_reduce instead.
+
+#define PARALLEL_MIN_LENGTH 4096
+#define PARALLEL_CHUNK_MIN 1024
+#define PARALLEL_CHUNKS_PER_WORKER 4
+#define PARALLEL_DEPTH_MAX 32
+
+enum {
+    CLONE_NIL,
+    CLONE_FALSE,
+    CLONE_TRUE,
+    CLONE_NUMBER,
+    CLONE_STRING,      // u32 length, bytes, NUL
+    CLONE_ARRAY,       // u32 count, elements
+    CLONE_HASH_MAP     // u32 count, key/value pairs
+};
+
+typedef struct {
+    uint8_t* data;
+    size_t length;
+    size_t capacity;
+} clone_buffer;
+
+typedef struct {
+    const uint8_t* data;
+    size_t length;
+    size_t offset;
+} clone_reader;
+
+typedef enum {
+    PARALLEL_MAP,
+    PARALLEL_FILTER,
+    PARALLEL_REDUCE
+} parallel_op;
+
+typedef struct parallel_job parallel_job;
+
+typedef struct {
+    parallel_job* job;
+    int start;              // Index of the range's first element
+    int count;
+    clone_buffer input;     // count encoded elements
+    clone_buffer output;    // Map: count results; filter: int32 offsets kept; reduce: the accumulator
+    int done;               // Under job->lock
+} parallel_chunk;
+
+struct parallel_job {
+    parallel_op op;
+    char* function;
+    clone_buffer initial;   // Reduce: each range's starting accumulator, empty for none
+    parallel_chunk* chunks;
+    int chunk_count;
+    pthread_mutex_t lock;
+    pthread_cond_t done_cond;
+    int remaining;          // Submitted ranges not yet finished
+    int failed;
+};
+
+static int clone_reserve(clone_buffer* buffer, size_t extra) {
+    if (buffer->length + extra <= buffer->capacity) return 1;
+    size_t capacity = buffer->capacity ? buffer->capacity : 256;
+    while (capacity < buffer->length + extra) capacity *= 2;
+    uint8_t* data = realloc(buffer->data, capacity);
+    if (!data) return 0;
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return 1;
+}
+
+static int clone_write(clone_buffer* buffer, const void* bytes, size_t length) {
+    if (!clone_reserve(buffer, length)) return 0;
+    memcpy(buffer->data + buffer->length, bytes, length);
+    buffer->length += length;
+    return 1;
+}
+
+static int clone_write_tag(clone_buffer* buffer, uint8_t tag, uint32_t count) {
+    return clone_write(buffer, &tag, 1) && clone_write(buffer, &count, sizeof(count));
+}
+
+// 0 for a value that cannot leave its VM
+static int clone_encode(clone_buffer* buffer, ember_value value, int depth) {
+    uint8_t tag;
+    switch (value.type) {
+        case EMBER_VAL_NIL:
+            tag = CLONE_NIL;
+            return clone_write(buffer, &tag, 1);
+        case EMBER_VAL_BOOL:
+            tag = value.as.bool_val ? CLONE_TRUE : CLONE_FALSE;
+            return clone_write(buffer, &tag, 1);
+        case EMBER_VAL_NUMBER:
+            tag = CLONE_NUMBER;
+            return clone_write(buffer, &tag, 1) &&
+                   clone_write(buffer, &value.as.number_val, sizeof(double));
+        case EMBER_VAL_STRING: {
+            const char* chars = AS_CSTRING(value);
+            uint32_t length = (uint32_t)AS_STRING(value)->length;
+            return chars && clone_write_tag(buffer, CLONE_STRING, length) &&
+                   clone_write(buffer, chars, length) && clone_write(buffer, "", 1);
+        }
+        case EMBER_VAL_ARRAY: {
+            if (depth >= PARALLEL_DEPTH_MAX) return 0;
+            ember_array* array = AS_ARRAY(value);
+            if (!clone_write_tag(buffer, CLONE_ARRAY, (uint32_t)array->length)) return 0;
+            for (int i = 0; i < array->length; i++) {
+                if (!clone_encode(buffer, array->elements[i], depth + 1)) return 0;
+            }
+            return 1;
+        }
+        case EMBER_VAL_HASH_MAP: {
+            if (depth >= PARALLEL_DEPTH_MAX) return 0;
+            ember_hash_map* map = AS_HASH_MAP(value);
+            if (!clone_write_tag(buffer, CLONE_HASH_MAP, (uint32_t)map->length)) return 0;
+            for (int i = 0; i < map->capacity; i++) {
+                if (!map->entries[i].is_occupied) continue;
+                if (!clone_encode(buffer, map->entries[i].key, depth + 1) ||
+                    !clone_encode(buffer, map->entries[i].value, depth + 1)) {
+                    return 0;
+                }
+            }
+            return 1;
+        }
+        default:
+            return 0;
+    }
+}
+
+static int clone_read(clone_reader* reader, void* bytes, size_t length) {
+    if (reader->length - reader->offset < length) return 0;
+    memcpy(bytes, reader->data + reader->offset, length);
+    reader->offset += length;
+    return 1;
+}
+
+// Builds the next encoded value in vm. Arrays and maps are rooted on the
+// stack while they fill, each part rooted above them as it is added
+static int clone_decode(ember_vm* vm, clone_reader* reader, ember_value* out) {
+    uint8_t tag;
+    uint32_t count = 0;
+    if (!clone_read(reader, &tag, 1)) return 0;
+    if (tag >= CLONE_STRING && !clone_read(reader, &count, sizeof(count))) return 0;
+
+    switch (tag) {
+        case CLONE_NIL: *out = ember_make_nil(); return 1;
+        case CLONE_FALSE: *out = ember_make_bool(0); return 1;
+        case CLONE_TRUE: *out = ember_make_bool(1); return 1;
+        case CLONE_NUMBER: {
+            double number;
+            if (!clone_read(reader, &number, sizeof(number))) return 0;
+            *out = ember_make_number(number);
+            return 1;
+        }
+        case CLONE_STRING: {
+            if (reader->length - reader->offset < (size_t)count + 1) return 0;
+            *out = ember_make_string_gc(vm, (const char*)reader->data + reader->offset);
+            reader->offset += (size_t)count + 1;
+            return out->type == EMBER_VAL_STRING;
+        }
+        case CLONE_ARRAY:
+        case CLONE_HASH_MAP: {
+            if (vm->stack_top + 3 > EMBER_STACK_MAX) return 0;
+            int base = vm->stack_top;
+            ember_value container = tag == CLONE_ARRAY ? ember_make_array(vm, count > 0 ? (int)count : 1)
+                                                       : ember_make_hash_map(vm, (int)count);
+            if (container.type == EMBER_VAL_NIL) return 0;
+            vm->stack[vm->stack_top++] = container;
+            int ok = 1;
+            for (uint32_t i = 0; ok && i < count; i++) {
+                ember_value* key = &vm->stack[vm->stack_top];
+                *key = ember_make_nil();
+                vm->stack_top++;
+                ok = clone_decode(vm, reader, key);
+                if (ok && tag == CLONE_ARRAY) {
+                    array_push_with_vm(vm, AS_ARRAY(container), *key);
+                } else if (ok) {
+                    ember_value* item = &vm->stack[vm->stack_top];
+                    *item = ember_make_nil();
+                    vm->stack_top++;
+                    ok = clone_decode(vm, reader, item);
+                    if (ok) hash_map_set_with_vm(vm, AS_HASH_MAP(container), *key, *item);
+                }
+                vm->stack_top = base + 1;
+            }
+            vm->stack_top = base;
+            *out = container;
+            return ok;
+        }
+        default:
+            return 0;
+    }
+}
+
+static void clone_free(clone_buffer* buffer) {
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->length = buffer->capacity = 0;
+}
+
+// Nil, false and 0 are false, as for the not builtin
+static int parallel_truthy(ember_value value) {
+    switch (value.type) {
+        case EMBER_VAL_NIL: return 0;
+        case EMBER_VAL_BOOL: return value.as.bool_val;
+        case EMBER_VAL_NUMBER: return value.as.number_val != 0.0;
+        default: return 1;
+    }
+}
+
+// Runs one range on a worker's VM, leaving its stack as it was
+static int parallel_chunk_run(ember_vm* vm, parallel_job* job, parallel_chunk* chunk) {
+    int slot = ember_global_find(vm, job->function, (int)strlen(job->function));
+    if (slot < 0 || !vm_callable(vm->globals[slot].value, 4)) {
+        fprintf(stderr, "[PARALLEL] '%s' is not a function on the executor's workers\n", job->function);
+        return 0;
+    }
+    if (vm->stack_top + 4 > EMBER_STACK_MAX) return 0;
+    ember_value function = vm->globals[slot].value;
+    int base = vm->stack_top;
+    ember_value* args = &vm->stack[base];
+    for (int i = 0; i < 4; i++) {
+        args[i] = ember_make_nil();
+    }
+    vm->stack_top += 4;
+
+    clone_reader input = {chunk->input.data, chunk->input.length, 0};
+    int ok = 1;
+    if (job->op == PARALLEL_REDUCE) {
+        // (acc, element, index, nil); without an initial value the range's
+        // first element starts the accumulator
+        int first = 0;
+        if (job->initial.length > 0) {
+            clone_reader initial = {job->initial.data, job->initial.length, 0};
+            ok = clone_decode(vm, &initial, &args[0]);
+        } else {
+            ok = clone_decode(vm, &input, &args[0]);
+            first = 1;
+        }
+        for (int i = first; ok && i < chunk->count; i++) {
+            ember_value accumulator;
+            ok = clone_decode(vm, &input, &args[1]);
+            args[2] = ember_make_number(chunk->start + i);
+            ok = ok && vm_call_prepared(vm, function, 4, args, &accumulator) == 0;
+            if (ok) args[0] = accumulator;
+        }
+        ok = ok && clone_encode(&chunk->output, args[0], 0);
+    } else {
+        // (element, index, nil)
+        for (int i = 0; ok && i < chunk->count; i++) {
+            ember_value result;
+            ok = clone_decode(vm, &input, &args[0]);
+            args[1] = ember_make_number(chunk->start + i);
+            ok = ok && vm_call_prepared(vm, function, 3, args, &result) == 0;
+            if (!ok) break;
+            if (job->op == PARALLEL_MAP) {
+                ok = clone_encode(&chunk->output, result, 0);
+            } else if (parallel_truthy(result)) {
+                int32_t offset = i;
+                ok = clone_write(&chunk->output, &offset, sizeof(offset));
+            }
+        }
+    }
+
+    if (vm->exception_pending) {
+        vm->exception_pending = 0;
+        vm->current_exception = ember_make_nil();
+    }
+    vm->stack_top = base;
+    return ok;
+}
+
+static void parallel_chunk_work(ember_vm* vm, void* userdata) {
+    parallel_chunk* chunk = userdata;
+    parallel_job* job = chunk->job;
+    int ok = !__atomic_load_n(&job->failed, __ATOMIC_ACQUIRE) && parallel_chunk_run(vm, job, chunk);
+
+    pthread_mutex_lock(&job->lock);
+    if (!ok) __atomic_store_n(&job->failed, 1, __ATOMIC_RELEASE);
+    chunk->done = 1;
+    job->remaining--;
+    pthread_cond_broadcast(&job->done_cond);
+    pthread_mutex_unlock(&job->lock);
+}
+
+// The name fn is bound to as a global, or NULL for a native, a method or a
+// function that no global holds
+static const char* parallel_function_name(ember_vm* vm, ember_value fn) {
+    if (fn.type != EMBER_VAL_FUNCTION || !fn.as.func_val.chunk || !fn.as.func_val.name) return NULL;
+    const char* name = fn.as.func_val.name;
+    int slot = ember_global_find(vm, name, (int)strlen(name));
+    if (slot < 0) return NULL;
+    ember_value global = vm->globals[slot].value;
+    return global.type == EMBER_VAL_FUNCTION && global.as.func_val.chunk == fn.as.func_val.chunk ? name : NULL;
+}
+
+static void parallel_job_free(parallel_job* job) {
+    for (int i = 0; i < job->chunk_count; i++) {
+        clone_free(&job->chunks[i].input);
+        clone_free(&job->chunks[i].output);
+    }
+    clone_free(&job->initial);
+    pthread_mutex_destroy(&job->lock);
+    pthread_cond_destroy(&job->done_cond);
+    free(job->chunks);
+    free(job->function);
+    free(job);
+}
+
+// Encodes the ranges of array; NULL (nothing submitted) when some element
+// cannot be cloned, so the caller runs sequentially instead
+static parallel_job* parallel_job_create(ember_vm* vm, parallel_op op, const char* function,
+                                         ember_array* array, ember_value initial) {
+    int workers = executor_worker_count(vm->executor);
+    int chunk_size = array->length / (workers * PARALLEL_CHUNKS_PER_WORKER);
+    if (chunk_size < PARALLEL_CHUNK_MIN) chunk_size = PARALLEL_CHUNK_MIN;
+
+    parallel_job* job = calloc(1, sizeof(parallel_job));
+    if (!job) return NULL;
+    job->op = op;
+    job->function = strdup(function);
+    job->chunk_count = (array->length + chunk_size - 1) / chunk_size;
+    job->chunks = calloc(job->chunk_count, sizeof(parallel_chunk));
+    pthread_mutex_init(&job->lock, NULL);
+    pthread_cond_init(&job->done_cond, NULL);
+    int ok = job->function && job->chunks;
+    if (ok && initial.type != EMBER_VAL_NIL) {
+        ok = clone_encode(&job->initial, initial, 0);
+    }
+    for (int c = 0; ok && c < job->chunk_count; c++) {
+        parallel_chunk* chunk = &job->chunks[c];
+        chunk->job = job;
+        chunk->start = c * chunk_size;
+        chunk->count = array->length - chunk->start < chunk_size ? array->length - chunk->start : chunk_size;
+        for (int i = 0; ok && i < chunk->count; i++) {
+            ok = clone_encode(&chunk->input, array->elements[chunk->start + i], 0);
+        }
+    }
+    if (!ok) {
+        if (!job->chunks) job->chunk_count = 0;
+        parallel_job_free(job);
+        return NULL;
+    }
+    return job;
+}
+
+static void parallel_wait(parallel_job* job, parallel_chunk* chunk) {
+    pthread_mutex_lock(&job->lock);
+    while (chunk ? !chunk->done : job->remaining > 0) {
+        pthread_cond_wait(&job->done_cond, &job->lock);
+    }
+    pthread_mutex_unlock(&job->lock);
+}
+
+// Folds the ranges' accumulators with combine(acc, partial, index, array),
+// index being the range's first element. result is a rooted slot
+static int parallel_combine(ember_vm* vm, parallel_job* job, ember_array* array, ember_value combine,
+                            ember_value* result) {
+    if (vm->stack_top + 4 > EMBER_STACK_MAX) return 0;
+    ember_value* args = &vm->stack[vm->stack_top];
+    for (int i = 0; i < 4; i++) {
+        args[i] = ember_make_nil();
+    }
+    args[3].type = EMBER_VAL_ARRAY;
+    args[3].as.obj_val = (ember_object*)array;
+    vm->stack_top += 4;
+
+    int ok = 1;
+    for (int c = 0; ok && c < job->chunk_count; c++) {
+        parallel_chunk* chunk = &job->chunks[c];
+        parallel_wait(job, chunk);
+        if (__atomic_load_n(&job->failed, __ATOMIC_ACQUIRE)) break;
+        clone_reader output = {chunk->output.data, chunk->output.length, 0};
+        if (c == 0) {
+            ok = clone_decode(vm, &output, result);
+            continue;
+        }
+        args[0] = *result;
+        ok = clone_decode(vm, &output, &args[1]);
+        args[2] = ember_make_number(chunk->start);
+        ok = ok && vm_call_prepared(vm, combine, 4, args, result) == 0;
+    }
+    vm->stack_top -= 4;
+    return ok;
+}
+
+// Appends each range's results to result, a rooted array, in order
+static int parallel_stitch(ember_vm* vm, parallel_job* job, ember_array* array, ember_value result) {
+    if (vm->stack_top + 1 > EMBER_STACK_MAX) return 0;
+    ember_value* item = &vm->stack[vm->stack_top++];
+    *item = ember_make_nil();
+    int ok = 1;
+    for (int c = 0; ok && c < job->chunk_count; c++) {
+        parallel_chunk* chunk = &job->chunks[c];
+        parallel_wait(job, chunk);
+        if (__atomic_load_n(&job->failed, __ATOMIC_ACQUIRE)) break;
+        clone_reader output = {chunk->output.data, chunk->output.length, 0};
+        if (job->op == PARALLEL_MAP) {
+            for (int i = 0; ok && i < chunk->count; i++) {
+                ok = clone_decode(vm, &output, item);
+                if (ok) array_push_with_vm(vm, AS_ARRAY(result), *item);
+            }
+        } else {
+            int32_t offset;
+            while (clone_read(&output, &offset, sizeof(offset))) {
+                array_push_with_vm(vm, AS_ARRAY(result), array->elements[chunk->start + offset]);
+            }
+        }
+    }
+    vm->stack_top--;
+    return ok;
+}
+
+static ember_value parallel_sequential(ember_vm* vm, parallel_op op, ember_array* array, ember_value fn,
+                                       ember_value initial) {
+    switch (op) {
+        case PARALLEL_MAP: return array_map(vm, array, fn);
+        case PARALLEL_FILTER: return array_filter(vm, array, fn);
+        default: return array_reduce(vm, array, fn, initial);
+    }
+}
+
+static ember_value parallel_run(ember_vm* vm, parallel_op op, ember_array* array, ember_value fn,
+                                ember_value initial, ember_value combine) {
+    const char* function = parallel_function_name(vm, fn);
+    if (!vm->executor || !function || array->length < PARALLEL_MIN_LENGTH ||
+        executor_on_worker(vm->executor) || !vm_callable(combine, 4)) {
+        return parallel_sequential(vm, op, array, fn, initial);
+    }
+    parallel_job* job = parallel_job_create(vm, op, function, array, initial);
+    if (!job) {
+        return parallel_sequential(vm, op, array, fn, initial);
+    }
+    if (vm->stack_top + 1 > EMBER_STACK_MAX) {
+        parallel_job_free(job);
+        return parallel_sequential(vm, op, array, fn, initial);
+    }
+
+    job->remaining = job->chunk_count;
+    for (int c = 0; c < job->chunk_count; c++) {
+        if (executor_submit_work(vm->executor, parallel_chunk_work, &job->chunks[c]) != 0) {
+            // Ranges never submitted count as failed and finished
+            pthread_mutex_lock(&job->lock);
+            __atomic_store_n(&job->failed, 1, __ATOMIC_RELEASE);
+            job->remaining -= job->chunk_count - c;
+            for (int i = c; i < job->chunk_count; i++) {
+                job->chunks[i].done = 1;
+            }
+            pthread_mutex_unlock(&job->lock);
+            break;
+        }
+    }
+
+    int base = vm->stack_top;
+    ember_value* result = &vm->stack[vm->stack_top++];
+    *result = ember_make_nil();
+    int ok;
+    if (op == PARALLEL_REDUCE) {
+        ok = parallel_combine(vm, job, array, combine, result);
+    } else {
+        *result = ember_make_array(vm, op == PARALLEL_MAP ? array->length : 1);
+        ok = result->type == EMBER_VAL_ARRAY && parallel_stitch(vm, job, array, *result);
+    }
+    // Workers still hold the job until every range has finished
+    parallel_wait(job, NULL);
+    ok = ok && !job->failed;
+    if (!ok && !vm->exception_pending) {
+        fprintf(stderr, "[PARALLEL] '%s' failed on a worker\n", function);
+    }
+    parallel_job_free(job);
+    ember_value value = ok ? *result : ember_make_nil();
+    vm->stack_top = base;
+    return value;
+}
+
+static int parallel_args(int argc, ember_value* argv, int min_args, int max_args) {
+    return argc >= min_args && argc <= max_args && argv[0].type == EMBER_VAL_ARRAY &&
+           (argv[1].type == EMBER_VAL_FUNCTION || argv[1].type == EMBER_VAL_NATIVE);
+}
+
+// parallel_map(array, fn)
+ember_value ember_native_parallel_map(ember_vm* vm, int argc, ember_value* argv) {
+    if (!parallel_args(argc, argv, 2, 2)) return ember_make_nil();
+    return parallel_run(vm, PARALLEL_MAP, AS_ARRAY(argv[0]), argv[1], ember_make_nil(), argv[1]);
+}
+
+// parallel_filter(array, fn)
+ember_value ember_native_parallel_filter(ember_vm* vm, int argc, ember_value* argv) {
+    if (!parallel_args(argc, argv, 2, 2)) return ember_make_nil();
+    return parallel_run(vm, PARALLEL_FILTER, AS_ARRAY(argv[0]), argv[1], ember_make_nil(), argv[1]);
+}
+
+// parallel_reduce(array, fn[, initial[, combine]]): every range folds from
+// initial, so it should be an identity for combine (0 for a sum); combine
+// defaults to fn
+ember_value ember_native_parallel_reduce(ember_vm* vm, int argc, ember_value* argv) {
+    if (!parallel_args(argc, argv, 2, 4)) return ember_make_nil();
+    ember_value initial = argc >= 3 ? argv[2] : ember_make_nil();
+    ember_value combine = argc == 4 ? argv[3] : argv[1];
+    if (combine.type != EMBER_VAL_FUNCTION && combine.type != EMBER_VAL_NATIVE) return ember_make_nil();
+    return parallel_run(vm, PARALLEL_REDUCE, AS_ARRAY(argv[0]), argv[1], initial, combine);
+}
+
+void ember_vm_set_executor(ember_vm* vm, ember_executor* executor) {
+    if (vm) vm->executor = executor;
+}
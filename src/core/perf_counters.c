@@ -0,0 +1,103 @@
+#define _GNU_SOURCE
+#include "perf_counters.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+static const char* const counter_names[PERF_COUNTER_COUNT] = {
+    "cycles", "instructions", "cache-misses", "branch-misses"
+};
+
+const char* perf_counter_name(perf_counter counter) {
+    return counter >= 0 && counter < PERF_COUNTER_COUNT ? counter_names[counter] : "unknown";
+}
+
+#if defined(__linux__)
+
+static const uint64_t counter_configs[PERF_COUNTER_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+
+int perf_counters_open(perf_counters* counters) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) counters->fds[i] = -1;
+    const char* setting = getenv("EMBER_PERF_COUNTERS");
+    if (setting && strcmp(setting, "0") == 0) return 0;
+
+    int opened = 0;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = counter_configs[i];
+        attr.exclude_kernel = 1;   // Allowed at perf_event_paranoid 2
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        // This thread on any CPU; ENOENT/EOPNOTSUPP when the PMU lacks it,
+        // EACCES/EPERM under policy, ENOSYS under seccomp
+        int fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        if (fd < 0) continue;
+        counters->fds[i] = fd;
+        opened++;
+    }
+    return opened;
+}
+
+void perf_counters_close(perf_counters* counters) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (counters->fds[i] >= 0) close(counters->fds[i]);
+        counters->fds[i] = -1;
+    }
+}
+
+void perf_counters_read(const perf_counters* counters, perf_sample* sample) {
+    memset(sample, 0, sizeof(*sample));
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (counters->fds[i] < 0) continue;
+        uint64_t data[3];  // value, time enabled, time running
+        if (read(counters->fds[i], data, sizeof(data)) != (ssize_t)sizeof(data)) continue;
+        uint64_t value = data[0];
+        if (data[2] == 0) continue;  // Never scheduled onto the PMU
+        if (data[2] < data[1]) {
+            value = (uint64_t)((double)value * ((double)data[1] / (double)data[2]));
+        }
+        sample->values[i] = value;
+        sample->available |= 1u << i;
+    }
+}
+
+#else
+
+int perf_counters_open(perf_counters* counters) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) counters->fds[i] = -1;
+    return 0;
+}
+
+void perf_counters_close(perf_counters* counters) {
+    (void)counters;
+}
+
+void perf_counters_read(const perf_counters* counters, perf_sample* sample) {
+    (void)counters;
+    memset(sample, 0, sizeof(*sample));
+}
+
+#endif
+
+void perf_sample_delta(const perf_sample* start, const perf_sample* end, perf_sample* delta) {
+    memset(delta, 0, sizeof(*delta));
+    delta->available = start->available & end->available;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if ((delta->available & (1u << i)) && end->values[i] >= start->values[i]) {
+            delta->values[i] = end->values[i] - start->values[i];
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef EMBER_PERF_COUNTERS_H
+#define EMBER_PERF_COUNTERS_H
+
+// Hardware counters of the calling thread through perf_event_open, for
+// benchmarks: cycles, retired instructions, cache misses and branch misses,
+// user space only. Each counter opens on its own, so a PMU that lacks one
+// still reports the others. Linux only; elsewhere, or where
+// perf_event_paranoid or a container's seccomp profile forbids it,
+// perf_counters_open finds nothing and callers go on with wall-clock time.
+
+#include <stdint.h>
+
+typedef enum {
+    PERF_COUNTER_CYCLES,
+    PERF_COUNTER_INSTRUCTIONS,
+    PERF_COUNTER_CACHE_MISSES,
+    PERF_COUNTER_BRANCH_MISSES,
+    PERF_COUNTER_COUNT
+} perf_counter;
+
+typedef struct {
+    int fds[PERF_COUNTER_COUNT];       // -1 where the counter is unavailable
+} perf_counters;
+
+typedef struct {
+    uint64_t values[PERF_COUNTER_COUNT];
+    unsigned available;                // Bit per perf_counter that was read
+} perf_sample;
+
+// Opens and starts the counters: how many are available (0 for none).
+// EMBER_PERF_COUNTERS=0 turns them off
+int perf_counters_open(perf_counters* counters);
+void perf_counters_close(perf_counters* counters);
+
+// Current totals, scaled up when the kernel multiplexed a counter
+void perf_counters_read(const perf_counters* counters, perf_sample* sample);
+
+// end - start for the counters both samples have
+void perf_sample_delta(const perf_sample* start, const perf_sample* end, perf_sample* delta);
+
+const char* perf_counter_name(perf_counter counter);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef EMBER_PROBES_H
+#define EMBER_PROBES_H
+
+// Static tracepoints (USDT) for bpftrace, SystemTap and DTrace. Built in
+// with EMBER_USDT, which the Makefile sets wherever <sys/sdt.h> is
+// installed (USDT=0 leaves them out). An idle probe is a single nop plus
+// an ELF note, so they stay in production builds; the arguments are still
+// computed, so probes only pass values already at hand. Provider "ember":
+//
+//   function__entry(name, depth)           Ember function entered; name NULL if anonymous
+//   function__return(name, depth)          Left by return, tail call or unwinding
+//   gc__start(kind)                        "minor", "full" or "incremental" (any cycle
+//                                          of the incremental marker, gc_collect_full too)
+//   gc__done(kind, bytes_freed)
+//   module__load__start(name)
+//   module__load__done(name, loaded)       loaded 0 if the import failed
+//   exception__throw(type_name, message)   Exception objects, on every throw and rethrow
+//   pool__acquire(vm)
+//   pool__release(vm)
+//   http__request__start(request, method, url)
+//   http__request__done(request, status, bytes, error)   error NULL on success
+//
+// For example, function latency in microseconds:
+//
+//   bpftrace -e 'usdt:./libember.so:ember:function__entry { @start[tid, arg1] = nsecs; }
+//                usdt:./libember.so:ember:function__return /@start[tid, arg1]/ {
+//                    @us[str(arg0)] = hist((nsecs - @start[tid, arg1]) / 1000);
+//                    delete(@start[tid, arg1]); }'
+
+#ifdef EMBER_USDT
+
+#include <sys/sdt.h>
+
+#define EMBER_PROBE1(name, a) DTRACE_PROBE1(ember, name, a)
+#define EMBER_PROBE2(name, a, b) DTRACE_PROBE2(ember, name, a, b)
+#define EMBER_PROBE3(name, a, b, c) DTRACE_PROBE3(ember, name, a, b, c)
+#define EMBER_PROBE4(name, a, b, c, d) DTRACE_PROBE4(ember, name, a, b, c, d)
+
+#else
+
+// Arguments are not evaluated, but locals kept for a probe still count as used
+#define EMBER_PROBE1(name, a) ((void)sizeof(a))
+#define EMBER_PROBE2(name, a, b) ((void)sizeof(a), (void)sizeof(b))
+#define EMBER_PROBE3(name, a, b, c) ((void)sizeof(a), (void)sizeof(b), (void)sizeof(c))
+#define EMBER_PROBE4(name, a, b, c, d) ((void)sizeof(a), (void)sizeof(b), (void)sizeof(c), (void)sizeof(d))
+
+#endif
+
+#endif // EMBER_PROBES_H
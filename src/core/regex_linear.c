@@ -0,0 +1,895 @@
+#include "regex_linear.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define RL_MAX_INSTS 20000          // Program size, after {m,n} expansion
+#define RL_MAX_DEPTH 200            // Group nesting
+#define RL_MAX_GROUPS 32
+#define RL_DFA_BUDGET (256 * 1024)  // State cache bytes before a flush
+#define RL_DFA_BUCKETS 256
+
+// ============================================================================
+// PROGRAM
+// ============================================================================
+
+typedef enum {
+    RL_CLASS,       // Consume one byte in classes[x]
+    RL_SPLIT,       // Continue at x, then (lower priority) at y
+    RL_JMP,         // Continue at x
+    RL_SAVE,        // Record the position in capture slot x
+    RL_BOL,         // Assert the start of the text (or a line)
+    RL_EOL,         // Assert the end of the text (or a line)
+    RL_MATCH
+} rl_op;
+
+typedef struct {
+    uint8_t op;
+    int x;
+    int y;
+} rl_inst;
+
+typedef struct {
+    uint32_t bits[8];
+} rl_class;
+
+static inline bool class_has(const rl_class* cls, unsigned char byte) {
+    return (cls->bits[byte >> 5] >> (byte & 31)) & 1;
+}
+
+static inline void class_add(rl_class* cls, unsigned char byte) {
+    cls->bits[byte >> 5] |= 1u << (byte & 31);
+}
+
+typedef struct dfa_state dfa_state;
+
+struct regex_linear {
+    rl_inst* insts;
+    int inst_count;
+    rl_class* classes;
+    int class_count;
+    int groups;                 // Capture groups, not counting the whole match
+    bool newline;
+
+    // Bytes every class treats alike share a column of the DFA
+    uint8_t byte_column[256];
+    int columns;
+
+    // Lazy DFA
+    dfa_state* buckets[RL_DFA_BUCKETS];
+    dfa_state* start;
+    size_t dfa_bytes;
+    unsigned flushes;
+
+    // Scratch shared by both matchers, sized by inst_count
+    int* dense;
+    int* sparse;
+    int* stack;
+};
+
+// ============================================================================
+// PARSER
+// ============================================================================
+
+typedef enum {
+    RN_EMPTY,
+    RN_CLASS,       // cls
+    RN_CAT,         // left right
+    RN_ALT,         // left right
+    RN_REPEAT,      // left {min, max}, max -1 for no limit
+    RN_GROUP,       // left, capture group
+    RN_BOL,
+    RN_EOL
+} rn_type;
+
+typedef struct {
+    rn_type type;
+    int left, right;
+    int min, max;
+    int cls;
+    int group;
+} rl_node;
+
+typedef struct {
+    const char* p;
+    bool icase;
+    bool newline;
+    bool failed;
+    int depth;
+    int groups;
+    rl_node* nodes;
+    int node_count, node_capacity;
+    rl_class* classes;
+    int class_count, class_capacity;
+} rl_parser;
+
+static int new_node(rl_parser* parser, rn_type type, int left, int right) {
+    if (parser->node_count == parser->node_capacity) {
+        int capacity = parser->node_capacity ? parser->node_capacity * 2 : 32;
+        rl_node* grown = realloc(parser->nodes, sizeof(rl_node) * capacity);
+        if (!grown) {
+            parser->failed = true;
+            return -1;
+        }
+        parser->nodes = grown;
+        parser->node_capacity = capacity;
+    }
+    rl_node* node = &parser->nodes[parser->node_count];
+    memset(node, 0, sizeof(*node));
+    node->type = type;
+    node->left = left;
+    node->right = right;
+    return parser->node_count++;
+}
+
+static void fold_case(rl_class* cls) {
+    for (int c = 'a'; c <= 'z'; c++) {
+        if (class_has(cls, (unsigned char)c) || class_has(cls, (unsigned char)(c - 32))) {
+            class_add(cls, (unsigned char)c);
+            class_add(cls, (unsigned char)(c - 32));
+        }
+    }
+}
+
+static int new_class(rl_parser* parser, const rl_class* cls) {
+    if (parser->class_count == parser->class_capacity) {
+        int capacity = parser->class_capacity ? parser->class_capacity * 2 : 16;
+        rl_class* grown = realloc(parser->classes, sizeof(rl_class) * capacity);
+        if (!grown) {
+            parser->failed = true;
+            return -1;
+        }
+        parser->classes = grown;
+        parser->class_capacity = capacity;
+    }
+    rl_class folded = *cls;
+    if (parser->icase) fold_case(&folded);
+    parser->classes[parser->class_count] = folded;
+    return parser->class_count++;
+}
+
+static int class_node(rl_parser* parser, const rl_class* cls) {
+    int index = new_class(parser, cls);
+    if (index < 0) return -1;
+    int node = new_node(parser, RN_CLASS, -1, -1);
+    if (node >= 0) parser->nodes[node].cls = index;
+    return node;
+}
+
+static bool named_class(const char* name, size_t length, rl_class* cls) {
+    static const char* names[] = {"alpha", "digit", "alnum", "upper", "lower", "space",
+                                  "blank", "punct", "print", "graph", "cntrl", "xdigit"};
+    int which = -1;
+    for (int i = 0; i < 12; i++) {
+        if (strlen(names[i]) == length && memcmp(names[i], name, length) == 0) which = i;
+    }
+    if (which < 0) return false;
+    for (int c = 0; c < 128; c++) {
+        bool upper = c >= 'A' && c <= 'Z', lower = c >= 'a' && c <= 'z', digit = c >= '0' && c <= '9';
+        bool space = c == ' ' || (c >= '\t' && c <= '\r');
+        bool print = c >= 32 && c < 127;
+        bool in;
+        switch (which) {
+            case 0: in = upper || lower; break;
+            case 1: in = digit; break;
+            case 2: in = upper || lower || digit; break;
+            case 3: in = upper; break;
+            case 4: in = lower; break;
+            case 5: in = space; break;
+            case 6: in = c == ' ' || c == '\t'; break;
+            case 7: in = print && c != ' ' && !upper && !lower && !digit; break;
+            case 8: in = print; break;
+            case 9: in = print && c != ' '; break;
+            case 10: in = c < 32 || c == 127; break;
+            default: in = digit || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); break;
+        }
+        if (in) class_add(cls, (unsigned char)c);
+    }
+    return true;
+}
+
+// Folded first, so [^a] excludes A too under icase
+static void negate_class(rl_parser* parser, rl_class* cls) {
+    if (parser->icase) fold_case(cls);
+    for (int i = 0; i < 8; i++) cls->bits[i] = ~cls->bits[i];
+    cls->bits[0] &= ~1u;                                    // Never NUL
+    if (parser->newline) cls->bits[0] &= ~(1u << '\n');
+}
+
+// [...] after the '['
+static int parse_bracket(rl_parser* parser) {
+    const char* p = parser->p;
+    rl_class cls = {{0}};
+    bool negated = *p == '^';
+    if (negated) p++;
+    bool first = true;
+    while (*p && (*p != ']' || first)) {
+        first = false;
+        if (p[0] == '[' && p[1] == ':') {
+            const char* end = strstr(p + 2, ":]");
+            if (!end || !named_class(p + 2, (size_t)(end - p - 2), &cls)) {
+                parser->failed = true;
+                return -1;
+            }
+            p = end + 2;
+            continue;
+        }
+        if ((p[0] == '[' && (p[1] == '.' || p[1] == '=')) || (unsigned char)*p >= 0x80) {
+            parser->failed = true;
+            return -1;
+        }
+        unsigned char low = (unsigned char)*p++;
+        unsigned char high = low;
+        if (p[0] == '-' && p[1] && p[1] != ']') {
+            high = (unsigned char)p[1];
+            if (high < low || high >= 0x80 || (p[1] == '[' && (p[2] == '.' || p[2] == '=' || p[2] == ':'))) {
+                parser->failed = true;
+                return -1;
+            }
+            p += 2;
+        }
+        for (int c = low; c <= high; c++) class_add(&cls, (unsigned char)c);
+    }
+    if (*p != ']') {
+        parser->failed = true;
+        return -1;
+    }
+    parser->p = p + 1;
+    if (negated) negate_class(parser, &cls);
+    return class_node(parser, &cls);
+}
+
+static int parse_alternation(rl_parser* parser);
+
+static int parse_atom(rl_parser* parser) {
+    const char* p = parser->p;
+    rl_class cls = {{0}};
+    switch (*p) {
+        case '(': {
+            if (++parser->depth > RL_MAX_DEPTH || parser->groups >= RL_MAX_GROUPS) {
+                parser->failed = true;
+                return -1;
+            }
+            int group = ++parser->groups;
+            parser->p = p + 1;
+            int inner = parse_alternation(parser);
+            if (parser->failed || *parser->p != ')') {
+                parser->failed = true;
+                return -1;
+            }
+            parser->p++;
+            parser->depth--;
+            int node = new_node(parser, RN_GROUP, inner, -1);
+            if (node >= 0) parser->nodes[node].group = group;
+            return node;
+        }
+        case '[':
+            parser->p = p + 1;
+            return parse_bracket(parser);
+        case '.':
+            parser->p = p + 1;
+            negate_class(parser, &cls);
+            return class_node(parser, &cls);
+        case '^':
+            parser->p = p + 1;
+            return new_node(parser, RN_BOL, -1, -1);
+        case '$':
+            parser->p = p + 1;
+            return new_node(parser, RN_EOL, -1, -1);
+        case '\\': {
+            char escaped = p[1];
+            parser->p = p + 2;
+            switch (escaped) {
+                case 'd': case 'D':
+                    named_class("digit", 5, &cls);
+                    break;
+                case 's': case 'S':
+                    named_class("space", 5, &cls);
+                    break;
+                case 'w': case 'W':
+                    named_class("alnum", 5, &cls);
+                    class_add(&cls, '_');
+                    break;
+                default:
+                    // Letters and digits are classes or references, and glibc
+                    // reads \< \> \` \' as word and buffer anchors
+                    if (!escaped || (escaped >= 'a' && escaped <= 'z') || (escaped >= 'A' && escaped <= 'Z') ||
+                        (escaped >= '0' && escaped <= '9') || strchr("<>`'", escaped)) {
+                        parser->failed = true;
+                        return -1;
+                    }
+                    class_add(&cls, (unsigned char)escaped);
+                    return class_node(parser, &cls);
+            }
+            if (escaped >= 'A' && escaped <= 'Z') negate_class(parser, &cls);
+            return class_node(parser, &cls);
+        }
+        case '*': case '+': case '?': case '{': case ')': case '|': case '\0':
+            // A quantifier with nothing to repeat; regcomp has its own reading
+            parser->failed = true;
+            return -1;
+        default:
+            parser->p = p + 1;
+            class_add(&cls, (unsigned char)*p);
+            return class_node(parser, &cls);
+    }
+}
+
+// {m}, {m,} or {m,n} at parser->p, after the '{'
+static bool parse_interval(rl_parser* parser, int* min, int* max) {
+    const char* p = parser->p;
+    if (*p < '0' || *p > '9') return false;
+    int low = 0;
+    while (*p >= '0' && *p <= '9') {
+        low = low * 10 + (*p++ - '0');
+        if (low > RL_MAX_INSTS) return false;
+    }
+    int high = low;
+    if (*p == ',') {
+        p++;
+        if (*p >= '0' && *p <= '9') {
+            high = 0;
+            while (*p >= '0' && *p <= '9') {
+                high = high * 10 + (*p++ - '0');
+                if (high > RL_MAX_INSTS) return false;
+            }
+            if (high < low) return false;
+        } else {
+            high = -1;
+        }
+    }
+    if (*p != '}') return false;
+    parser->p = p + 1;
+    *min = low;
+    *max = high;
+    return true;
+}
+
+static int parse_piece(rl_parser* parser) {
+    int atom = parse_atom(parser);
+    while (!parser->failed) {
+        int min, max;
+        char c = *parser->p;
+        if (c == '*') { min = 0; max = -1; parser->p++; }
+        else if (c == '+') { min = 1; max = -1; parser->p++; }
+        else if (c == '?') { min = 0; max = 1; parser->p++; }
+        else if (c == '{') {
+            parser->p++;
+            if (!parse_interval(parser, &min, &max)) {
+                parser->failed = true;
+                return -1;
+            }
+        } else {
+            break;
+        }
+        atom = new_node(parser, RN_REPEAT, atom, -1);
+        if (atom < 0) return -1;
+        parser->nodes[atom].min = min;
+        parser->nodes[atom].max = max;
+    }
+    return atom;
+}
+
+static int parse_branch(rl_parser* parser) {
+    int branch = -1;
+    while (!parser->failed && *parser->p && *parser->p != '|' && *parser->p != ')') {
+        int piece = parse_piece(parser);
+        if (parser->failed) return -1;
+        branch = branch < 0 ? piece : new_node(parser, RN_CAT, branch, piece);
+    }
+    return branch < 0 ? new_node(parser, RN_EMPTY, -1, -1) : branch;
+}
+
+static int parse_alternation(rl_parser* parser) {
+    int left = parse_branch(parser);
+    while (!parser->failed && *parser->p == '|') {
+        parser->p++;
+        int right = parse_branch(parser);
+        left = new_node(parser, RN_ALT, left, right);
+    }
+    return left;
+}
+
+// ============================================================================
+// CODE GENERATION
+// ============================================================================
+
+typedef struct {
+    rl_parser* parser;
+    rl_inst* insts;
+    int count, capacity;
+    bool failed;
+} rl_emitter;
+
+static int emit(rl_emitter* out, rl_op op, int x, int y) {
+    if (out->failed || out->count >= RL_MAX_INSTS) {
+        out->failed = true;
+        return 0;
+    }
+    if (out->count == out->capacity) {
+        int capacity = out->capacity ? out->capacity * 2 : 64;
+        rl_inst* grown = realloc(out->insts, sizeof(rl_inst) * capacity);
+        if (!grown) {
+            out->failed = true;
+            return 0;
+        }
+        out->insts = grown;
+        out->capacity = capacity;
+    }
+    out->insts[out->count].op = (uint8_t)op;
+    out->insts[out->count].x = x;
+    out->insts[out->count].y = y;
+    return out->count++;
+}
+
+static void emit_node(rl_emitter* out, int index) {
+    if (out->failed) return;
+    rl_node node = out->parser->nodes[index];
+    switch (node.type) {
+        case RN_EMPTY:
+            break;
+        case RN_CLASS:
+            emit(out, RL_CLASS, node.cls, 0);
+            break;
+        case RN_CAT: {
+            // Branches are left-deep chains; walk them rather than recurse
+            int depth = 0, leftmost = index;
+            while (out->parser->nodes[leftmost].type == RN_CAT) {
+                leftmost = out->parser->nodes[leftmost].left;
+                depth++;
+            }
+            int* rights = malloc(sizeof(int) * depth);
+            if (!rights) {
+                out->failed = true;
+                return;
+            }
+            int at = index;
+            for (int k = depth - 1; k >= 0; k--) {
+                rights[k] = out->parser->nodes[at].right;
+                at = out->parser->nodes[at].left;
+            }
+            emit_node(out, leftmost);
+            for (int k = 0; k < depth; k++) emit_node(out, rights[k]);
+            free(rights);
+            break;
+        }
+        case RN_ALT: {
+            int split = emit(out, RL_SPLIT, 0, 0);
+            emit_node(out, node.left);
+            int jump = emit(out, RL_JMP, 0, 0);
+            if (out->failed) return;
+            out->insts[split].x = split + 1;
+            out->insts[split].y = out->count;
+            emit_node(out, node.right);
+            if (out->failed) return;
+            out->insts[jump].x = out->count;
+            break;
+        }
+        case RN_GROUP:
+            emit(out, RL_SAVE, 2 * node.group, 0);
+            emit_node(out, node.left);
+            emit(out, RL_SAVE, 2 * node.group + 1, 0);
+            break;
+        case RN_REPEAT: {
+            int required = node.min;
+            if (node.max < 0 && required > 0) required--;    // The last one loops
+            for (int i = 0; i < required && !out->failed; i++) emit_node(out, node.left);
+            if (node.max < 0 && node.min > 0) {
+                // x+: the body, then back to it while preferred
+                int body = out->count;
+                emit_node(out, node.left);
+                emit(out, RL_SPLIT, body, out->count + 1);
+            } else if (node.max < 0) {
+                // x*: a split around the body
+                int split = emit(out, RL_SPLIT, 0, 0);
+                emit_node(out, node.left);
+                emit(out, RL_JMP, split, 0);
+                if (out->failed) return;
+                out->insts[split].x = split + 1;
+                out->insts[split].y = out->count;
+            } else {
+                // Each optional copy may end the repetition
+                int first = out->count;
+                for (int i = node.min; i < node.max && !out->failed; i++) {
+                    emit(out, RL_SPLIT, out->count + 1, -1);
+                    emit_node(out, node.left);
+                }
+                if (out->failed) return;
+                for (int pc = first; pc < out->count; pc++) {
+                    if (out->insts[pc].op == RL_SPLIT && out->insts[pc].y == -1) out->insts[pc].y = out->count;
+                }
+            }
+            break;
+        }
+        case RN_BOL:
+            emit(out, RL_BOL, 0, 0);
+            break;
+        case RN_EOL:
+            emit(out, RL_EOL, 0, 0);
+            break;
+    }
+}
+
+// Splits bytes into columns: two bytes share one when every class agrees
+// on them and neither is the line separator
+static void compute_columns(regex_linear* regex) {
+    uint8_t column[256] = {0};
+    int columns = 1;
+    for (int k = -1; k < regex->class_count; k++) {
+        int16_t remap[256][2];
+        memset(remap, -1, sizeof(remap));
+        int next = 0;
+        for (int b = 0; b < 256; b++) {
+            int side = k < 0 ? b == '\n' : class_has(&regex->classes[k], (unsigned char)b);
+            if (remap[column[b]][side] < 0) remap[column[b]][side] = (int16_t)next++;
+            column[b] = (uint8_t)remap[column[b]][side];
+        }
+        columns = next;
+    }
+    memcpy(regex->byte_column, column, sizeof(column));
+    regex->columns = columns;
+}
+
+regex_linear* regex_linear_compile(const char* pattern, bool icase, bool newline) {
+    rl_parser parser = {0};
+    parser.p = pattern;
+    parser.icase = icase;
+    parser.newline = newline;
+    int root = parse_alternation(&parser);
+    if (!parser.failed && *parser.p != '\0') parser.failed = true;    // A stray ')'
+
+    rl_emitter out = {0};
+    out.parser = &parser;
+    if (!parser.failed) {
+        emit(&out, RL_SAVE, 0, 0);
+        emit_node(&out, root);
+        emit(&out, RL_SAVE, 1, 0);
+        emit(&out, RL_MATCH, 0, 0);
+    }
+    free(parser.nodes);
+    regex_linear* regex = NULL;
+    if (!parser.failed && !out.failed) regex = calloc(1, sizeof(regex_linear));
+    if (regex) {
+        regex->insts = out.insts;
+        regex->inst_count = out.count;
+        regex->classes = parser.classes;
+        regex->class_count = parser.class_count;
+        regex->groups = parser.groups;
+        regex->newline = newline;
+        regex->dense = malloc(sizeof(int) * regex->inst_count);
+        regex->sparse = calloc((size_t)regex->inst_count, sizeof(int));
+        regex->stack = malloc(sizeof(int) * 3 * (regex->inst_count + 1));
+        if (!regex->dense || !regex->sparse || !regex->stack) {
+            regex_linear_free(regex);
+            return NULL;
+        }
+        compute_columns(regex);
+        return regex;
+    }
+    free(out.insts);
+    free(parser.classes);
+    return NULL;
+}
+
+// ============================================================================
+// LAZY DFA
+// ============================================================================
+
+// A set of NFA threads at one position: the instructions waiting on a byte,
+// MATCH, and $ assertions not yet known to hold
+struct dfa_state {
+    dfa_state* chain;
+    uint32_t hash;
+    bool bol;                 // Closed with ^ holding
+    bool match;
+    bool eol_match;           // Matches if $ holds here
+    int count;
+    int* pcs;                 // Sorted
+    dfa_state* next[];        // Per column, NULL until taken once
+};
+
+static inline bool at_bol(const regex_linear* regex, const char* text, size_t pos) {
+    return pos == 0 || (regex->newline && text[pos - 1] == '\n');
+}
+
+static inline bool at_eol(const regex_linear* regex, const char* text, size_t length, size_t pos) {
+    return pos == length || (regex->newline && text[pos] == '\n');
+}
+
+static int compare_ints(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+// The closure of the seeds into regex->dense (sorted), following ^ when bol
+// and $ when eol; $ instructions are kept when it is not yet known
+static int dfa_closure(regex_linear* regex, const int* seeds, int seed_count, bool bol, bool eol) {
+    int count = 0, top = 0;
+    int* stack = regex->stack;
+    for (int i = seed_count - 1; i >= 0; i--) stack[top++] = seeds[i];
+    while (top > 0) {
+        int pc = stack[--top];
+        unsigned slot = (unsigned)regex->sparse[pc];
+        if (slot < (unsigned)count && regex->dense[slot] == pc) continue;
+        regex->sparse[pc] = count;
+        regex->dense[count++] = pc;
+        const rl_inst* inst = &regex->insts[pc];
+        switch (inst->op) {
+            case RL_JMP: stack[top++] = inst->x; break;
+            case RL_SPLIT: stack[top++] = inst->y; stack[top++] = inst->x; break;
+            case RL_SAVE: stack[top++] = pc + 1; break;
+            case RL_BOL: if (bol) stack[top++] = pc + 1; break;
+            case RL_EOL: if (eol) stack[top++] = pc + 1; break;
+            default: break;
+        }
+    }
+    // Only what a later step looks at identifies the state
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        uint8_t op = regex->insts[regex->dense[i]].op;
+        if (op == RL_CLASS || op == RL_MATCH || (op == RL_EOL && !eol)) regex->dense[kept++] = regex->dense[i];
+    }
+    qsort(regex->dense, (size_t)kept, sizeof(int), compare_ints);
+    return kept;
+}
+
+static void dfa_flush(regex_linear* regex) {
+    for (int b = 0; b < RL_DFA_BUCKETS; b++) {
+        dfa_state* state = regex->buckets[b];
+        while (state) {
+            dfa_state* next = state->chain;
+            free(state->pcs);
+            free(state);
+            state = next;
+        }
+        regex->buckets[b] = NULL;
+    }
+    regex->start = NULL;
+    regex->dfa_bytes = 0;
+    regex->flushes++;
+}
+
+// The state for the set in regex->dense, made if new; NULL out of memory
+static dfa_state* dfa_intern(regex_linear* regex, int count, bool bol) {
+    uint32_t hash = 2166136261u ^ (uint32_t)bol;
+    for (int i = 0; i < count; i++) hash = (hash ^ (uint32_t)regex->dense[i]) * 16777619u;
+    dfa_state** bucket = &regex->buckets[hash % RL_DFA_BUCKETS];
+    for (dfa_state* state = *bucket; state; state = state->chain) {
+        if (state->hash == hash && state->bol == bol && state->count == count &&
+            memcmp(state->pcs, regex->dense, sizeof(int) * count) == 0) {
+            return state;
+        }
+    }
+
+    size_t size = sizeof(dfa_state) + sizeof(dfa_state*) * regex->columns;
+    if (regex->dfa_bytes + size + sizeof(int) * count > RL_DFA_BUDGET) {
+        // Start over rather than grow; the caller holds no state pointers
+        dfa_flush(regex);
+        bucket = &regex->buckets[hash % RL_DFA_BUCKETS];
+    }
+    dfa_state* state = calloc(1, size);
+    int* pcs = malloc(sizeof(int) * (count ? count : 1));
+    if (!state || !pcs) {
+        free(state);
+        free(pcs);
+        return NULL;
+    }
+    memcpy(pcs, regex->dense, sizeof(int) * count);
+    state->hash = hash;
+    state->bol = bol;
+    state->count = count;
+    state->pcs = pcs;
+    bool pending_eol = false;
+    for (int i = 0; i < count; i++) {
+        uint8_t op = regex->insts[pcs[i]].op;
+        if (op == RL_MATCH) state->match = true;
+        if (op == RL_EOL) pending_eol = true;
+    }
+    state->eol_match = state->match;
+    if (pending_eol && !state->match) {
+        int closed = dfa_closure(regex, pcs, count, bol, true);
+        for (int i = 0; i < closed; i++) {
+            if (regex->insts[regex->dense[i]].op == RL_MATCH) state->eol_match = true;
+        }
+    }
+    state->chain = *bucket;
+    *bucket = state;
+    regex->dfa_bytes += size + sizeof(int) * count;
+    return state;
+}
+
+// Where the state goes on byte; a search restarts at every position, so the
+// start instruction joins each step
+static dfa_state* dfa_step(regex_linear* regex, dfa_state* state, unsigned char byte) {
+    int* seeds = malloc(sizeof(int) * (state->count + 1));
+    if (!seeds) return NULL;
+    const int* from = state->pcs;
+    int from_count = state->count;
+    bool line_end = regex->newline && byte == '\n';
+    if (line_end) {
+        // The byte ends a line: threads waiting on $ go on first
+        from_count = dfa_closure(regex, state->pcs, state->count, state->bol, true);
+        int* expanded = malloc(sizeof(int) * (from_count ? from_count : 1));
+        if (!expanded) {
+            free(seeds);
+            return NULL;
+        }
+        memcpy(expanded, regex->dense, sizeof(int) * from_count);
+        from = expanded;
+        seeds = realloc(seeds, sizeof(int) * (from_count + 1));
+        if (!seeds) {
+            free(expanded);
+            return NULL;
+        }
+    }
+    int seed_count = 0;
+    for (int i = 0; i < from_count; i++) {
+        const rl_inst* inst = &regex->insts[from[i]];
+        if (inst->op == RL_CLASS && class_has(&regex->classes[inst->x], byte)) seeds[seed_count++] = from[i] + 1;
+    }
+    seeds[seed_count++] = 0;
+    if (from != state->pcs) free((void*)from);
+
+    bool bol = line_end;
+    int count = dfa_closure(regex, seeds, seed_count, bol, false);
+    free(seeds);
+    unsigned flushes = regex->flushes;
+    dfa_state* next = dfa_intern(regex, count, bol);
+    // Unless a flush just freed state along with everything else
+    if (next && regex->flushes == flushes) state->next[regex->byte_column[byte]] = next;
+    return next;
+}
+
+bool regex_linear_search(regex_linear* regex, const char* text, size_t length) {
+    if (!regex->start) {
+        int start_pc = 0;
+        int count = dfa_closure(regex, &start_pc, 1, true, false);
+        regex->start = dfa_intern(regex, count, true);
+        if (!regex->start) return regex_linear_exec(regex, text, length, 0, 0, NULL);
+    }
+    dfa_state* state = regex->start;
+    for (size_t pos = 0; pos < length; pos++) {
+        if (state->match) return true;
+        unsigned char byte = (unsigned char)text[pos];
+        if (regex->newline && byte == '\n' && state->eol_match) return true;
+        dfa_state* next = state->next[regex->byte_column[byte]];
+        if (!next) {
+            next = dfa_step(regex, state, byte);
+            if (!next) return regex_linear_exec(regex, text, length, 0, 0, NULL);
+        }
+        state = next;
+    }
+    return state->match || state->eol_match;
+}
+
+// ============================================================================
+// PIKE VM
+// ============================================================================
+
+typedef struct {
+    int* pcs;
+    int* caps;          // slots per thread, in list order
+    int count;
+} thread_list;
+
+// Adds pc and everything it reaches without consuming to list, in priority
+// order, with caps as the thread's captures (restored before returning)
+static void add_thread(regex_linear* regex, thread_list* list, int* sparse, int pc, int* caps, int slots,
+                       const char* text, size_t length, size_t pos) {
+    int* stack = regex->stack;
+    int top = 0;
+    stack[top++] = pc;
+    while (top > 0) {
+        int entry = stack[--top];
+        if (entry < 0) {
+            // Undo a SAVE: (-1 - slot), then the old value
+            int old = stack[--top];
+            caps[-1 - entry] = old;
+            continue;
+        }
+        unsigned slot = (unsigned)sparse[entry];
+        if (slot < (unsigned)list->count && list->pcs[slot] == entry) continue;
+        sparse[entry] = list->count;
+        int index = list->count++;
+        list->pcs[index] = entry;
+        const rl_inst* inst = &regex->insts[entry];
+        switch (inst->op) {
+            case RL_JMP: stack[top++] = inst->x; break;
+            case RL_SPLIT: stack[top++] = inst->y; stack[top++] = inst->x; break;
+            case RL_SAVE:
+                if (inst->x < slots) {
+                    stack[top++] = caps[inst->x];
+                    stack[top++] = -1 - inst->x;
+                    caps[inst->x] = (int)pos;
+                }
+                stack[top++] = entry + 1;
+                break;
+            case RL_BOL: if (at_bol(regex, text, pos)) stack[top++] = entry + 1; break;
+            case RL_EOL: if (at_eol(regex, text, length, pos)) stack[top++] = entry + 1; break;
+            default:
+                memcpy(list->caps + (size_t)index * slots, caps, sizeof(int) * slots);
+                break;
+        }
+    }
+}
+
+bool regex_linear_exec(regex_linear* regex, const char* text, size_t length, size_t from, size_t nmatch,
+                       regmatch_t* matches) {
+    // The whole match is always tracked, to tell leftmost and longest
+    int slots = 2 * (regex->groups + 1);
+    if (nmatch < (size_t)regex->groups + 1) {
+        slots = 2 * (int)(nmatch > 0 ? nmatch : 1);
+    }
+    int n = regex->inst_count;
+    int* memory = malloc(sizeof(int) * ((size_t)n * (2 * slots + 3) + 3 * (size_t)slots));
+    if (!memory) return false;
+    thread_list lists[2];
+    lists[0].pcs = memory;
+    lists[1].pcs = memory + n;
+    int* sparse[2] = {memory + 2 * n, regex->sparse};
+    lists[0].caps = memory + 3 * n;
+    lists[1].caps = lists[0].caps + (size_t)n * slots;
+    int* caps = lists[1].caps + (size_t)n * slots;
+    int* best = caps + slots;
+    lists[0].count = lists[1].count = 0;
+
+    bool matched = false;
+    thread_list* current = &lists[0];
+    thread_list* next = &lists[1];
+    int current_set = 0;
+    for (size_t pos = from; pos <= length; pos++) {
+        if (!matched) {
+            // A new thread for a match starting here, behind the earlier ones
+            for (int i = 0; i < slots; i++) caps[i] = -1;
+            add_thread(regex, current, sparse[current_set], 0, caps, slots, text, length, pos);
+        }
+        if (current->count == 0) {
+            if (matched) break;
+            continue;
+        }
+        next->count = 0;
+        for (int i = 0; i < current->count; i++) {
+            int* thread = current->caps + (size_t)i * slots;
+            if (matched && thread[0] > best[0]) continue;      // Starts after the match found
+            const rl_inst* inst = &regex->insts[current->pcs[i]];
+            if (inst->op == RL_CLASS) {
+                if (pos < length && class_has(&regex->classes[inst->x], (unsigned char)text[pos])) {
+                    add_thread(regex, next, sparse[!current_set], current->pcs[i] + 1, thread, slots, text,
+                               length, pos + 1);
+                }
+            } else if (inst->op == RL_MATCH) {
+                if (!matched || thread[0] < best[0] || (thread[0] == best[0] && thread[1] > best[1])) {
+                    memcpy(best, thread, sizeof(int) * slots);
+                    matched = true;
+                }
+            }
+        }
+        thread_list* swap = current;
+        current = next;
+        next = swap;
+        current_set = !current_set;
+    }
+
+    if (matched) {
+        for (size_t i = 0; i < nmatch; i++) {
+            bool tracked = 2 * i + 1 < (size_t)slots && i <= (size_t)regex->groups;
+            int start = tracked ? best[2 * i] : -1, end = tracked ? best[2 * i + 1] : -1;
+            bool set = start >= 0 && end >= start;
+            matches[i].rm_so = set ? start : -1;
+            matches[i].rm_eo = set ? end : -1;
+        }
+    }
+    free(memory);
+    return matched;
+}
+
+void regex_linear_free(regex_linear* regex) {
+    if (!regex) return;
+    dfa_flush(regex);
+    free(regex->insts);
+    free(regex->classes);
+    free(regex->dense);
+    free(regex->sparse);
+    free(regex->stack);
+    free(regex);
+}
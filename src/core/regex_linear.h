@@ -0,0 +1,41 @@
+#ifndef REGEX_LINEAR_H
+#define REGEX_LINEAR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <regex.h>
+
+// Linear-time POSIX ERE matching (regex_linear.c), the alternative to
+// regexec for patterns from untrusted input or hot loops.
+//
+// Patterns compile to a Thompson NFA. Yes/no searches run it as a DFA
+// built lazily one state and byte at a time, with a bounded state cache
+// that is flushed when full; match positions and groups come from a
+// Pike VM pass over the NFA. Both are linear in the text for a given
+// pattern, so no input can make matching backtrack.
+//
+// Covered: literals, '.', bracket expressions with ranges and [:class:]
+// names, ^ and $, groups, '|', * + ? and {m,n}, and the \w \W \s \S \d \D
+// escapes. Anything else (collating elements, \b, back-references,
+// non-ASCII bytes inside brackets, repetitions that expand past the
+// program size limit) makes compile return NULL so the caller can use
+// regcomp instead. Matching is byte-oriented. The overall match is
+// leftmost-longest, as with regexec; when a group could match in more than
+// one way, the earlier alternative or the greedier repetition wins.
+
+typedef struct regex_linear regex_linear;
+
+// NULL for a pattern outside the covered syntax or out of memory.
+// icase and newline mean REG_ICASE and REG_NEWLINE
+regex_linear* regex_linear_compile(const char* pattern, bool icase, bool newline);
+void regex_linear_free(regex_linear* regex);
+// Whether any part of text matches
+bool regex_linear_search(regex_linear* regex, const char* text, size_t length);
+// The leftmost-longest match starting at or after from, with groups, in
+// regexec's form (offsets into text, -1 for groups that did not take part);
+// false when there is none. Bytes before from are context for ^, as with
+// REG_STARTEND
+bool regex_linear_exec(regex_linear* regex, const char* text, size_t length, size_t from, size_t nmatch,
+                       regmatch_t* matches);
+
+#endif // REGEX_LINEAR_H
@@ -0,0 +1,145 @@
+#define _GNU_SOURCE
+#include "../../include/ember.h"
+#include "../vm.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+// Startup profile (ember_get_startup_profile). VM construction times its
+// GC, VFS and stdlib setup here, and ember_import_module its resolve,
+// compile and execute steps, itemized per module. A process only starts up
+// once, so there is one profile behind a lock rather than one per VM: the
+// prefetch threads and worker pools build VMs concurrently.
+
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+static ember_startup_profile profile;
+static double origin = 0;            // startup_clock() at begin or the first phase
+static double finished = 0;          // At ember_startup_profile_end, 0 while starting
+static int first_vm_done = 0;        // vm_creation_time is set
+
+double startup_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1000.0 + (double)now.tv_nsec / 1e6;
+}
+
+static double* phase_total(ember_startup_profile* p, startup_phase phase) {
+    switch (phase) {
+        case STARTUP_GC:             return &p->gc_init_time;
+        case STARTUP_VFS:            return &p->vfs_init_time;
+        case STARTUP_STDLIB:         return &p->stdlib_init_time;
+        case STARTUP_MODULE_RESOLVE: return &p->module_resolve_time;
+        case STARTUP_MODULE_COMPILE: return &p->module_compile_time;
+        case STARTUP_MODULE_EXECUTE: return &p->module_execute_time;
+    }
+    return NULL;
+}
+
+// Called with the lock held
+static void add_phase(startup_phase phase, double start, double now) {
+    if (origin == 0) origin = start;
+    double* total = phase_total(&profile, phase);
+    if (total) *total += now - start;
+    // ember_new_vm registers the builtins last
+    if (phase == STARTUP_STDLIB && !first_vm_done) {
+        profile.vm_creation_time = now - origin;
+        first_vm_done = 1;
+    }
+}
+
+void startup_profile_phase(startup_phase phase, double start) {
+    double now = startup_clock();
+    pthread_mutex_lock(&profile_lock);
+    add_phase(phase, start, now);
+    pthread_mutex_unlock(&profile_lock);
+}
+
+void startup_profile_module(const char* name, startup_phase phase, double start) {
+    double now = startup_clock();
+    pthread_mutex_lock(&profile_lock);
+    add_phase(phase, start, now);
+    if (name) {
+        int listed = profile.module_count < EMBER_STARTUP_MODULES ? profile.module_count : EMBER_STARTUP_MODULES;
+        ember_startup_module* module = NULL;
+        for (int i = 0; i < listed; i++) {
+            if (strncmp(profile.modules[i].name, name, sizeof(profile.modules[i].name) - 1) == 0) {
+                module = &profile.modules[i];
+                break;
+            }
+        }
+        // Resolving is the first step of every import; past the list the
+        // module is only counted
+        if (!module && phase == STARTUP_MODULE_RESOLVE) {
+            if (profile.module_count < EMBER_STARTUP_MODULES) {
+                module = &profile.modules[profile.module_count];
+                snprintf(module->name, sizeof(module->name), "%s", name);
+            }
+            profile.module_count++;
+        }
+        if (module) {
+            double elapsed = now - start;
+            switch (phase) {
+                case STARTUP_MODULE_RESOLVE: module->resolve_time += elapsed; break;
+                case STARTUP_MODULE_COMPILE: module->compile_time += elapsed; break;
+                case STARTUP_MODULE_EXECUTE: module->execute_time += elapsed; break;
+                default: break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&profile_lock);
+}
+
+void ember_startup_profile_begin(void) {
+    double now = startup_clock();
+    pthread_mutex_lock(&profile_lock);
+    memset(&profile, 0, sizeof(profile));
+    origin = now;
+    finished = 0;
+    first_vm_done = 0;
+    pthread_mutex_unlock(&profile_lock);
+}
+
+void ember_startup_profile_end(void) {
+    double now = startup_clock();
+    pthread_mutex_lock(&profile_lock);
+    if (finished == 0) finished = now;
+    pthread_mutex_unlock(&profile_lock);
+}
+
+void ember_get_startup_profile(ember_startup_profile* out) {
+    if (!out) return;
+    double now = startup_clock();
+    pthread_mutex_lock(&profile_lock);
+    *out = profile;
+    if (origin != 0) {
+        out->total_startup_time = (finished != 0 ? finished : now) - origin;
+    }
+    pthread_mutex_unlock(&profile_lock);
+}
+
+void ember_print_startup_profile(void) {
+    ember_startup_profile p;
+    ember_get_startup_profile(&p);
+    fprintf(stderr, "Startup profile (ms)\n");
+    fprintf(stderr, "  total            %10.3f\n", p.total_startup_time);
+    fprintf(stderr, "  vm creation      %10.3f\n", p.vm_creation_time);
+    fprintf(stderr, "    gc init        %10.3f\n", p.gc_init_time);
+    fprintf(stderr, "    vfs init       %10.3f\n", p.vfs_init_time);
+    fprintf(stderr, "    stdlib init    %10.3f\n", p.stdlib_init_time);
+    if (p.parser_init_time > 0) {
+        fprintf(stderr, "    parser init    %10.3f\n", p.parser_init_time);
+    }
+    if (p.module_count == 0) return;
+    fprintf(stderr, "  modules (%d)     %10.3f resolve %10.3f compile %10.3f execute\n", p.module_count,
+            p.module_resolve_time, p.module_compile_time, p.module_execute_time);
+    int listed = p.module_count < EMBER_STARTUP_MODULES ? p.module_count : EMBER_STARTUP_MODULES;
+    for (int i = 0; i < listed; i++) {
+        const ember_startup_module* m = &p.modules[i];
+        fprintf(stderr, "    %-14s %10.3f resolve %10.3f compile %10.3f execute\n", m->name,
+                m->resolve_time, m->compile_time, m->execute_time);
+    }
+    if (p.module_count > listed) {
+        fprintf(stderr, "    ... %d more\n", p.module_count - listed);
+    }
+}
@@ -0,0 +1,705 @@
+#define _GNU_SOURCE
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "../runtime/value/value.h"
+#include "object_shape.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Structured clone: a value graph encoded out of one VM and rebuilt in
+// another. Lengths and counts are LEB128 varints and numbers raw doubles.
+// Every string and container gets the next object index as it is written,
+// before its contents, and a second appearance of the same object is a
+// CLONE_REF to that index, so shared parts stay shared and cycles close.
+//
+// Channels queue encoded messages in a bounded lock-free ring (Vyukov's
+// MPMC queue): each cell's sequence number says whether it is free for the
+// sender at that position or full for the receiver, so senders and
+// receivers only contend on their own position counter.
+
+#define CLONE_VERSION 1
+#define CLONE_DEPTH_MAX 1000
+#define CHANNEL_CACHE_LINE 64
+
+enum {
+    CLONE_NIL,
+    CLONE_FALSE,
+    CLONE_TRUE,
+    CLONE_NUMBER,      // double
+    CLONE_STRING,      // length, bytes
+    CLONE_ARRAY,       // count, elements
+    CLONE_HASH_MAP,    // count, key/value pairs
+    CLONE_SET,         // count, elements
+    CLONE_MAP,         // count, key/value pairs in insertion order
+    CLONE_TYPED_ARRAY, // kind byte, length, raw elements
+    CLONE_INSTANCE,    // class name, field count, name/value pairs (names as length and bytes)
+    CLONE_REF          // index of an object written earlier
+};
+
+// ============================================================================
+// ENCODER
+// ============================================================================
+
+typedef struct {
+    uint8_t* data;
+    size_t length;
+    size_t capacity;
+    const void** seen;      // Open-addressed object -> index (parallel to seen_index)
+    uint32_t* seen_index;
+    size_t seen_capacity;   // Power of two, kept at most half full
+    uint32_t object_count;
+    int failed;
+} clone_writer;
+
+static uint32_t hash_pointer(const void* pointer) {
+    uint64_t bits = (uint64_t)(uintptr_t)pointer;
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdULL;
+    bits ^= bits >> 33;
+    return (uint32_t)bits;
+}
+
+static void put_bytes(clone_writer* writer, const void* bytes, size_t length) {
+    if (writer->failed) return;
+    if (writer->length + length > writer->capacity) {
+        size_t capacity = writer->capacity ? writer->capacity : 256;
+        while (capacity < writer->length + length) capacity *= 2;
+        uint8_t* data = realloc(writer->data, capacity);
+        if (!data) {
+            writer->failed = 1;
+            return;
+        }
+        writer->data = data;
+        writer->capacity = capacity;
+    }
+    memcpy(writer->data + writer->length, bytes, length);
+    writer->length += length;
+}
+
+static void put_tag(clone_writer* writer, uint8_t tag) {
+    put_bytes(writer, &tag, 1);
+}
+
+static void put_varint(clone_writer* writer, uint64_t value) {
+    uint8_t bytes[10];
+    int count = 0;
+    do {
+        bytes[count] = (uint8_t)(value & 0x7F);
+        value >>= 7;
+        if (value) bytes[count] |= 0x80;
+        count++;
+    } while (value);
+    put_bytes(writer, bytes, (size_t)count);
+}
+
+static int seen_grow(clone_writer* writer) {
+    size_t capacity = writer->seen_capacity ? writer->seen_capacity * 2 : 64;
+    const void** seen = calloc(capacity, sizeof(*seen));
+    uint32_t* seen_index = malloc(capacity * sizeof(*seen_index));
+    if (!seen || !seen_index) {
+        free(seen);
+        free(seen_index);
+        return 0;
+    }
+    for (size_t i = 0; i < writer->seen_capacity; i++) {
+        if (!writer->seen[i]) continue;
+        size_t slot = hash_pointer(writer->seen[i]) & (capacity - 1);
+        while (seen[slot]) slot = (slot + 1) & (capacity - 1);
+        seen[slot] = writer->seen[i];
+        seen_index[slot] = writer->seen_index[i];
+    }
+    free(writer->seen);
+    free(writer->seen_index);
+    writer->seen = seen;
+    writer->seen_index = seen_index;
+    writer->seen_capacity = capacity;
+    return 1;
+}
+
+// Writes a back-reference and returns 1 if object was written before;
+// otherwise gives it the next index and returns 0
+static int put_seen(clone_writer* writer, const void* object) {
+    if ((writer->object_count + 1) * 2 > writer->seen_capacity && !seen_grow(writer)) {
+        writer->failed = 1;
+        return 1;
+    }
+    size_t mask = writer->seen_capacity - 1;
+    size_t slot = hash_pointer(object) & mask;
+    for (; writer->seen[slot]; slot = (slot + 1) & mask) {
+        if (writer->seen[slot] == object) {
+            put_tag(writer, CLONE_REF);
+            put_varint(writer, writer->seen_index[slot]);
+            return 1;
+        }
+    }
+    writer->seen[slot] = object;
+    writer->seen_index[slot] = writer->object_count++;
+    return 0;
+}
+
+static void put_chars(clone_writer* writer, const char* chars, size_t length) {
+    put_varint(writer, length);
+    put_bytes(writer, chars, length);
+}
+
+static size_t typed_element_size(ember_typed_kind kind) {
+    return kind == EMBER_TYPED_FLOAT64 ? sizeof(double) : kind == EMBER_TYPED_INT32 ? sizeof(int32_t) : 1;
+}
+
+static void put_value(clone_writer* writer, ember_value value, int depth);
+
+static void put_entries(clone_writer* writer, const ember_hash_entry* entries, int capacity,
+                        int count, int with_values, int depth) {
+    put_varint(writer, (uint64_t)count);
+    for (int i = 0; entries && i < capacity && !writer->failed; i++) {
+        if (!entries[i].is_occupied) continue;
+        put_value(writer, entries[i].key, depth + 1);
+        if (with_values) put_value(writer, entries[i].value, depth + 1);
+    }
+}
+
+static void put_instance(clone_writer* writer, ember_instance* instance, int depth) {
+    ember_string* class_name = instance->klass ? instance->klass->name : NULL;
+    if (!class_name || !ember_string_flatten(class_name)) {
+        fprintf(stderr, "[CLONE] Cannot clone an instance of an anonymous class\n");
+        writer->failed = 1;
+        return;
+    }
+    put_tag(writer, CLONE_INSTANCE);
+    put_chars(writer, class_name->chars, (size_t)class_name->length);
+
+    // Field names are written as bare text, outside the object indexes
+    if (!instance->shape) {
+        ember_hash_map* fields = instance->fields;
+        put_varint(writer, fields ? (uint64_t)fields->length : 0);
+        for (int i = 0; fields && i < fields->capacity && !writer->failed; i++) {
+            if (!fields->entries[i].is_occupied) continue;
+            ember_string* name = AS_STRING(fields->entries[i].key);
+            if (!ember_string_flatten(name)) {
+                writer->failed = 1;
+                return;
+            }
+            put_chars(writer, name->chars, (size_t)name->length);
+            put_value(writer, fields->entries[i].value, depth + 1);
+        }
+        return;
+    }
+    // In the order the fields were added, so receivers share one layout
+    int count = instance->shape->field_count;
+    put_varint(writer, (uint64_t)count);
+    ember_shape** order = malloc(sizeof(*order) * (size_t)(count > 0 ? count : 1));
+    if (!order) {
+        writer->failed = 1;
+        return;
+    }
+    for (ember_shape* shape = instance->shape; shape && shape->name; shape = shape->parent) {
+        order[shape->field_count - 1] = shape;
+    }
+    for (int i = 0; i < count && !writer->failed; i++) {
+        put_chars(writer, order[i]->name, (size_t)order[i]->name_length);
+        put_value(writer, instance->slots[i], depth + 1);
+    }
+    free(order);
+}
+
+static void put_value(clone_writer* writer, ember_value value, int depth) {
+    if (writer->failed) return;
+    if (depth > CLONE_DEPTH_MAX) {
+        fprintf(stderr, "[CLONE] Value nests deeper than %d levels\n", CLONE_DEPTH_MAX);
+        writer->failed = 1;
+        return;
+    }
+    switch (value.type) {
+        case EMBER_VAL_NIL:
+            put_tag(writer, CLONE_NIL);
+            return;
+        case EMBER_VAL_BOOL:
+            put_tag(writer, value.as.bool_val ? CLONE_TRUE : CLONE_FALSE);
+            return;
+        case EMBER_VAL_NUMBER:
+            put_tag(writer, CLONE_NUMBER);
+            put_bytes(writer, &value.as.number_val, sizeof(double));
+            return;
+        default:
+            break;
+    }
+
+    ember_object* object = value.as.obj_val;
+    if (!object) {
+        put_tag(writer, CLONE_NIL);
+        return;
+    }
+    switch (value.type) {
+        case EMBER_VAL_STRING: {
+            ember_string* string = (ember_string*)object;
+            // Slices are read in place; only ropes are flattened
+            const char* bytes = ember_string_bytes(string);
+            if (!bytes) bytes = ember_string_flatten(string);
+            if (!bytes) {
+                writer->failed = 1;
+                return;
+            }
+            if (put_seen(writer, object)) return;
+            put_tag(writer, CLONE_STRING);
+            put_chars(writer, bytes, (size_t)string->length);
+            return;
+        }
+        case EMBER_VAL_ARRAY: {
+            if (put_seen(writer, object)) return;
+            ember_array* array = (ember_array*)object;
+            put_tag(writer, CLONE_ARRAY);
+            put_varint(writer, (uint64_t)array->length);
+            for (int i = 0; i < array->length && !writer->failed; i++) {
+                put_value(writer, array->elements[i], depth + 1);
+            }
+            return;
+        }
+        case EMBER_VAL_HASH_MAP: {
+            if (put_seen(writer, object)) return;
+            ember_hash_map* map = (ember_hash_map*)object;
+            put_tag(writer, CLONE_HASH_MAP);
+            put_entries(writer, map->entries, map->capacity, map->length, 1, depth);
+            return;
+        }
+        case EMBER_VAL_SET: {
+            if (put_seen(writer, object)) return;
+            ember_hash_map* elements = ((ember_set*)object)->elements;
+            put_tag(writer, CLONE_SET);
+            put_entries(writer, elements ? elements->entries : NULL, elements ? elements->capacity : 0,
+                        elements ? elements->length : 0, 0, depth);
+            return;
+        }
+        case EMBER_VAL_MAP: {
+            if (put_seen(writer, object)) return;
+            ember_map* map = (ember_map*)object;
+            put_tag(writer, CLONE_MAP);
+            put_entries(writer, map->entries, map->count, map->size, 1, depth);
+            return;
+        }
+        case EMBER_VAL_TYPED_ARRAY: {
+            if (put_seen(writer, object)) return;
+            ember_typed_array* array = (ember_typed_array*)object;
+            uint8_t kind = (uint8_t)array->kind;
+            put_tag(writer, CLONE_TYPED_ARRAY);
+            put_bytes(writer, &kind, 1);
+            put_varint(writer, (uint64_t)array->length);
+            put_bytes(writer, array->data, (size_t)array->length * typed_element_size(array->kind));
+            return;
+        }
+        case EMBER_VAL_INSTANCE:
+            if (put_seen(writer, object)) return;
+            put_instance(writer, (ember_instance*)object, depth);
+            return;
+        default:
+            fprintf(stderr, "[CLONE] Cannot clone a %s value\n", value_type_to_string(value.type));
+            writer->failed = 1;
+            return;
+    }
+}
+
+int ember_clone_encode(ember_value value, uint8_t** data, size_t* size) {
+    if (!data || !size) return -1;
+    clone_writer writer = {0};
+    put_tag(&writer, CLONE_VERSION);
+    put_value(&writer, value, 0);
+    free(writer.seen);
+    free(writer.seen_index);
+    if (writer.failed) {
+        free(writer.data);
+        return -1;
+    }
+    *data = writer.data;
+    *size = writer.length;
+    return 0;
+}
+
+// ============================================================================
+// DECODER
+// ============================================================================
+
+typedef struct {
+    ember_vm* vm;
+    const uint8_t* data;
+    size_t length;
+    size_t offset;
+    ember_value* objects;   // By index, for back-references
+    uint32_t object_count;
+    uint32_t object_capacity;
+    int failed;
+} clone_reader;
+
+static const uint8_t* take_bytes(clone_reader* reader, size_t length) {
+    if (reader->failed || length > reader->length - reader->offset) {
+        reader->failed = 1;
+        return NULL;
+    }
+    const uint8_t* bytes = reader->data + reader->offset;
+    reader->offset += length;
+    return bytes;
+}
+
+static uint64_t take_varint(clone_reader* reader) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        const uint8_t* byte = take_bytes(reader, 1);
+        if (!byte) return 0;
+        value |= (uint64_t)(*byte & 0x7F) << shift;
+        if (!(*byte & 0x80)) return value;
+    }
+    reader->failed = 1;
+    return 0;
+}
+
+// A count of things each at least min_size bytes long that the rest of the
+// data can hold, so a damaged message can't ask for a huge allocation
+static int take_count(clone_reader* reader, size_t min_size) {
+    uint64_t count = take_varint(reader);
+    if (reader->failed || count > INT32_MAX || count * min_size > reader->length - reader->offset) {
+        reader->failed = 1;
+        return 0;
+    }
+    return (int)count;
+}
+
+static void add_object(clone_reader* reader, ember_value value) {
+    if (reader->failed) return;
+    if (reader->object_count == reader->object_capacity) {
+        uint32_t capacity = reader->object_capacity ? reader->object_capacity * 2 : 16;
+        ember_value* objects = realloc(reader->objects, sizeof(ember_value) * capacity);
+        if (!objects) {
+            reader->failed = 1;
+            return;
+        }
+        reader->objects = objects;
+        reader->object_capacity = capacity;
+    }
+    reader->objects[reader->object_count++] = value;
+}
+
+static ember_value make_object_value(ember_val_type type, void* object) {
+    ember_value value;
+    if (!object) return ember_make_nil();
+    value.type = type;
+    value.as.obj_val = (ember_object*)object;
+    return value;
+}
+
+static ember_value take_value(clone_reader* reader, int depth);
+
+static ember_string* take_string(clone_reader* reader) {
+    int length = take_count(reader, 1);
+    const uint8_t* bytes = take_bytes(reader, (size_t)length);
+    ember_string* string = bytes ? copy_string(reader->vm, (const char*)bytes, length) : NULL;
+    if (!string) reader->failed = 1;
+    return string;
+}
+
+static ember_value take_instance(clone_reader* reader, int depth) {
+    ember_vm* vm = reader->vm;
+    int name_length = take_count(reader, 1);
+    const char* name = (const char*)take_bytes(reader, (size_t)name_length);
+    if (!name) return ember_make_nil();
+    int slot = ember_global_find(vm, name, name_length);
+    if (slot < 0 || vm->globals[slot].value.type != EMBER_VAL_CLASS) {
+        fprintf(stderr, "[CLONE] No class '%.*s' to rebuild an instance with\n", name_length, name);
+        reader->failed = 1;
+        return ember_make_nil();
+    }
+    ember_instance* instance = allocate_instance(vm, AS_CLASS(vm->globals[slot].value));
+    ember_value result = make_object_value(EMBER_VAL_INSTANCE, instance);
+    if (!instance) reader->failed = 1;
+    add_object(reader, result);
+
+    int count = take_count(reader, 2);
+    for (int i = 0; i < count && !reader->failed; i++) {
+        int field_length = take_count(reader, 1);
+        const char* field = (const char*)take_bytes(reader, (size_t)field_length);
+        if (!field) break;
+        // Interned like the compiler's names, so shapes match
+        ember_string* key = intern_string(vm, field, field_length);
+        ember_value value = take_value(reader, depth + 1);
+        if (reader->failed) break;
+        if (!key || !ember_instance_set_field(vm, instance, make_object_value(EMBER_VAL_STRING, key), value)) {
+            reader->failed = 1;
+        }
+    }
+    return result;
+}
+
+static ember_value take_value(clone_reader* reader, int depth) {
+    ember_vm* vm = reader->vm;
+    const uint8_t* tag = take_bytes(reader, 1);
+    if (!tag || depth > CLONE_DEPTH_MAX) {
+        reader->failed = 1;
+        return ember_make_nil();
+    }
+    switch (*tag) {
+        case CLONE_NIL:
+            return ember_make_nil();
+        case CLONE_FALSE:
+            return ember_make_bool(0);
+        case CLONE_TRUE:
+            return ember_make_bool(1);
+        case CLONE_NUMBER: {
+            const uint8_t* bytes = take_bytes(reader, sizeof(double));
+            double number = 0;
+            if (bytes) memcpy(&number, bytes, sizeof(number));
+            return ember_make_number(number);
+        }
+        case CLONE_STRING: {
+            ember_value value = make_object_value(EMBER_VAL_STRING, take_string(reader));
+            add_object(reader, value);
+            return value;
+        }
+        case CLONE_ARRAY: {
+            int count = take_count(reader, 1);
+            ember_array* array = reader->failed ? NULL : allocate_array(vm, count > 0 ? count : 1);
+            ember_value value = make_object_value(EMBER_VAL_ARRAY, array);
+            if (!array) reader->failed = 1;
+            add_object(reader, value);
+            for (int i = 0; i < count && !reader->failed; i++) {
+                ember_value element = take_value(reader, depth + 1);
+                if (!reader->failed) array_push_with_vm(vm, array, element);
+            }
+            return value;
+        }
+        case CLONE_HASH_MAP:
+        case CLONE_MAP: {
+            int count = take_count(reader, 2);
+            ember_value value = ember_make_nil();
+            if (!reader->failed) {
+                value = *tag == CLONE_MAP ? ember_make_map(vm)
+                                          : make_object_value(EMBER_VAL_HASH_MAP, allocate_hash_map(vm, count));
+            }
+            if (value.type == EMBER_VAL_NIL) reader->failed = 1;
+            add_object(reader, value);
+            for (int i = 0; i < count && !reader->failed; i++) {
+                ember_value key = take_value(reader, depth + 1);
+                ember_value item = take_value(reader, depth + 1);
+                if (reader->failed) break;
+                if (*tag == CLONE_MAP) {
+                    if (!map_set(AS_MAP(value), key, item)) reader->failed = 1;
+                } else {
+                    hash_map_set_with_vm(vm, AS_HASH_MAP(value), key, item);
+                }
+            }
+            return value;
+        }
+        case CLONE_SET: {
+            int count = take_count(reader, 1);
+            ember_value value = reader->failed ? ember_make_nil() : ember_make_set(vm);
+            if (value.type == EMBER_VAL_NIL) reader->failed = 1;
+            add_object(reader, value);
+            for (int i = 0; i < count && !reader->failed; i++) {
+                ember_value element = take_value(reader, depth + 1);
+                if (!reader->failed) set_add(AS_SET(value), element);
+            }
+            return value;
+        }
+        case CLONE_TYPED_ARRAY: {
+            const uint8_t* kind = take_bytes(reader, 1);
+            if (!kind || *kind > EMBER_TYPED_UINT8) {
+                reader->failed = 1;
+                return ember_make_nil();
+            }
+            size_t element_size = typed_element_size((ember_typed_kind)*kind);
+            int length = take_count(reader, element_size);
+            const uint8_t* bytes = take_bytes(reader, (size_t)length * element_size);
+            ember_value value = bytes ? ember_make_typed_array(vm, (ember_typed_kind)*kind, length)
+                                      : ember_make_nil();
+            if (value.type != EMBER_VAL_TYPED_ARRAY) {
+                reader->failed = 1;
+                return ember_make_nil();
+            }
+            memcpy(AS_TYPED_ARRAY(value)->data, bytes, (size_t)length * element_size);
+            add_object(reader, value);
+            return value;
+        }
+        case CLONE_INSTANCE:
+            return take_instance(reader, depth);
+        case CLONE_REF: {
+            uint64_t index = take_varint(reader);
+            if (reader->failed || index >= reader->object_count) {
+                reader->failed = 1;
+                return ember_make_nil();
+            }
+            return reader->objects[index];
+        }
+        default:
+            reader->failed = 1;
+            return ember_make_nil();
+    }
+}
+
+int ember_clone_decode(ember_vm* vm, const uint8_t* data, size_t size, ember_value* out) {
+    if (!vm || !data || !out) return -1;
+    clone_reader reader = {vm, data, size, 0, NULL, 0, 0, 0};
+    const uint8_t* version = take_bytes(&reader, 1);
+    if (!version || *version != CLONE_VERSION) {
+        fprintf(stderr, "[CLONE] Not a structured clone message\n");
+        return -1;
+    }
+
+    // Objects are only reachable through the reader until the value is
+    // whole, so collection waits until then
+    int64_t saved_next_gc = vm->next_gc;
+    vm->next_gc = INT64_MAX;
+    ember_value value = take_value(&reader, 0);
+    vm->next_gc = saved_next_gc;
+    free(reader.objects);
+    if (reader.failed || reader.offset != reader.length) {
+        fprintf(stderr, "[CLONE] Malformed structured clone message\n");
+        return -1;
+    }
+    *out = value;
+    return 0;
+}
+
+int ember_clone_value(ember_value value, ember_vm* to, ember_value* out) {
+    uint8_t* data;
+    size_t size;
+    if (!to || !out || ember_clone_encode(value, &data, &size) != 0) return -1;
+    int result = ember_clone_decode(to, data, size, out);
+    free(data);
+    return result;
+}
+
+// ============================================================================
+// CHANNELS
+// ============================================================================
+
+typedef struct {
+    size_t sequence;        // Position this cell is free for (sent) or full for (sent + 1)
+    uint8_t* data;
+    size_t size;
+} channel_cell;
+
+struct ember_channel {
+    channel_cell* cells;
+    size_t mask;
+    int refs;
+    int closed;
+    char pad0[CHANNEL_CACHE_LINE];
+    size_t send_position;   // On its own cache line, apart from the receivers'
+    char pad1[CHANNEL_CACHE_LINE - sizeof(size_t)];
+    size_t receive_position;
+    char pad2[CHANNEL_CACHE_LINE - sizeof(size_t)];
+};
+
+ember_channel* ember_channel_create(int capacity) {
+    if (capacity < 1 || capacity > (1 << 24)) return NULL;
+    size_t size = 2;
+    while (size < (size_t)capacity) size *= 2;
+    ember_channel* channel = calloc(1, sizeof(ember_channel));
+    if (!channel) return NULL;
+    channel->cells = calloc(size, sizeof(channel_cell));
+    if (!channel->cells) {
+        free(channel);
+        return NULL;
+    }
+    for (size_t i = 0; i < size; i++) {
+        channel->cells[i].sequence = i;
+    }
+    channel->mask = size - 1;
+    channel->refs = 1;
+    return channel;
+}
+
+ember_channel* ember_channel_retain(ember_channel* channel) {
+    if (channel) __atomic_add_fetch(&channel->refs, 1, __ATOMIC_RELAXED);
+    return channel;
+}
+
+void ember_channel_release(ember_channel* channel) {
+    if (!channel || __atomic_sub_fetch(&channel->refs, 1, __ATOMIC_ACQ_REL) != 0) return;
+    // Nobody else holds it: whatever was never received goes too
+    for (size_t i = 0; i <= channel->mask; i++) {
+        free(channel->cells[i].data);
+    }
+    free(channel->cells);
+    free(channel);
+}
+
+void ember_channel_close(ember_channel* channel) {
+    if (channel) __atomic_store_n(&channel->closed, 1, __ATOMIC_RELEASE);
+}
+
+// Claims the cell for the next send; NULL when the ring is full
+static channel_cell* channel_claim_send(ember_channel* channel, size_t* position) {
+    size_t pos = __atomic_load_n(&channel->send_position, __ATOMIC_RELAXED);
+    for (;;) {
+        channel_cell* cell = &channel->cells[pos & channel->mask];
+        size_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)pos;
+        if (difference == 0) {
+            if (__atomic_compare_exchange_n(&channel->send_position, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *position = pos;
+                return cell;
+            }
+        } else if (difference < 0) {
+            return NULL;
+        } else {
+            pos = __atomic_load_n(&channel->send_position, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static channel_cell* channel_claim_receive(ember_channel* channel, size_t* position) {
+    size_t pos = __atomic_load_n(&channel->receive_position, __ATOMIC_RELAXED);
+    for (;;) {
+        channel_cell* cell = &channel->cells[pos & channel->mask];
+        size_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)(pos + 1);
+        if (difference == 0) {
+            if (__atomic_compare_exchange_n(&channel->receive_position, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *position = pos;
+                return cell;
+            }
+        } else if (difference < 0) {
+            return NULL;
+        } else {
+            pos = __atomic_load_n(&channel->receive_position, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+int ember_channel_send(ember_channel* channel, ember_value value) {
+    if (!channel || __atomic_load_n(&channel->closed, __ATOMIC_ACQUIRE)) return -1;
+    uint8_t* data;
+    size_t size;
+    if (ember_clone_encode(value, &data, &size) != 0) return -1;
+    size_t position;
+    channel_cell* cell = channel_claim_send(channel, &position);
+    if (!cell) {
+        free(data);
+        return 1;
+    }
+    cell->data = data;
+    cell->size = size;
+    __atomic_store_n(&cell->sequence, position + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int ember_channel_receive(ember_channel* channel, ember_vm* vm, ember_value* out) {
+    if (!channel || !vm || !out) return -1;
+    size_t position;
+    channel_cell* cell = channel_claim_receive(channel, &position);
+    if (!cell) {
+        // Closed and drained is the end; otherwise more may come. Look
+        // again after seeing the close, which follows its sender's last send
+        if (!__atomic_load_n(&channel->closed, __ATOMIC_ACQUIRE)) return 1;
+        cell = channel_claim_receive(channel, &position);
+        if (!cell) return -1;
+    }
+    uint8_t* data = cell->data;
+    size_t size = cell->size;
+    cell->data = NULL;
+    __atomic_store_n(&cell->sequence, position + channel->mask + 1, __ATOMIC_RELEASE);
+    int result = ember_clone_decode(vm, data, size, out);
+    free(data);
+    return result;
+}
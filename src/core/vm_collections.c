@@ -1,8 +1,15 @@
 #include "../../include/ember.h"
 #include "../runtime/value/value.h"
+#include "../vm.h"
 #include "error.h"
 #include <stdio.h>
 
+static vm_operation_result frozen_error(ember_vm* vm) {
+    ember_error* error = ember_error_runtime(vm, "Cannot modify a frozen value");
+    ember_vm_set_error(vm, error);
+    return VM_RESULT_ERROR;
+}
+
 // VM operation handlers for Set operations
 vm_operation_result vm_handle_set_new(ember_vm* vm) {
     ember_value set_val = ember_make_set(vm);
@@ -33,7 +40,9 @@ vm_operation_result vm_handle_set_add(ember_vm* vm) {
     }
     
     ember_set* set = AS_SET(set_val);
+    if (ember_object_is_frozen(set)) return frozen_error(vm);
     int success __attribute__((unused)) = set_add(set, element);
+    gc_write_barrier_helper(vm, (ember_object*)set->elements, ember_make_nil(), element);
     
     // Push result (the set itself for chaining)
     vm->stack[vm->stack_top++] = set_val;
@@ -81,6 +90,7 @@ vm_operation_result vm_handle_set_delete(ember_vm* vm) {
     }
     
     ember_set* set = AS_SET(set_val);
+    if (ember_object_is_frozen(set)) return frozen_error(vm);
     int was_deleted = set_delete(set, element);
     
     ember_value result = ember_make_bool(was_deleted);
@@ -125,6 +135,7 @@ vm_operation_result vm_handle_set_clear(ember_vm* vm) {
     }
     
     ember_set* set = AS_SET(set_val);
+    if (ember_object_is_frozen(set)) return frozen_error(vm);
     set_clear(set);
     
     // Return the set for chaining
@@ -163,7 +174,10 @@ vm_operation_result vm_handle_map_set(ember_vm* vm) {
     }
     
     ember_map* map = AS_MAP(map_val);
+    if (ember_object_is_frozen(map)) return frozen_error(vm);
     int success __attribute__((unused)) = map_set(map, key, value);
+    gc_write_barrier_helper(vm, (ember_object*)map, ember_make_nil(), key);
+    gc_write_barrier_helper(vm, (ember_object*)map, ember_make_nil(), value);
     
     // Push result (the map itself for chaining)
     vm->stack[vm->stack_top++] = map_val;
@@ -234,6 +248,7 @@ vm_operation_result vm_handle_map_delete(ember_vm* vm) {
     }
     
     ember_map* map = AS_MAP(map_val);
+    if (ember_object_is_frozen(map)) return frozen_error(vm);
     int was_deleted = map_delete(map, key);
     
     ember_value result = ember_make_bool(was_deleted);
@@ -278,6 +293,7 @@ vm_operation_result vm_handle_map_clear(ember_vm* vm) {
     }
     
     ember_map* map = AS_MAP(map_val);
+    if (ember_object_is_frozen(map)) return frozen_error(vm);
     map_clear(map);
     
     // Return the map for chaining
@@ -286,3 +302,56 @@ vm_operation_result vm_handle_map_clear(ember_vm* vm) {
 }
 
 // VM operation handlers for Regex operations
+
+// VM operation handlers for typed array element access. Indices must be
+// integers in range; anything else is an error rather than nil, since a
+// typed array has no holes to read
+static int typed_array_index(ember_vm* vm, ember_typed_array* array, ember_value index_val, int* index) {
+    *index = index_val.type == EMBER_VAL_NUMBER ? ember_number_index(&index_val, array->length) : -1;
+    if (*index < 0) {
+        ember_error* error = ember_error_runtime(vm, "Typed array index out of range");
+        ember_vm_set_error(vm, error);
+        return 0;
+    }
+    return 1;
+}
+
+vm_operation_result vm_handle_typed_array_get(ember_vm* vm) {
+    if (vm->stack_top < 2 || vm->stack[vm->stack_top - 2].type != EMBER_VAL_TYPED_ARRAY) {
+        return VM_RESULT_CONTINUE;
+    }
+    ember_typed_array* array = AS_TYPED_ARRAY(vm->stack[vm->stack_top - 2]);
+    int index;
+    if (!typed_array_index(vm, array, vm->stack[vm->stack_top - 1], &index)) {
+        return VM_RESULT_ERROR;
+    }
+    vm->stack_top--;
+    vm->stack[vm->stack_top - 1] = ember_make_number(ember_typed_array_load(array, index));
+    return VM_RESULT_OK;
+}
+
+// Leaves the assigned value, as OP_ARRAY_SET does, even where the store
+// converted it
+vm_operation_result vm_handle_typed_array_set(ember_vm* vm) {
+    if (vm->stack_top < 3 || vm->stack[vm->stack_top - 3].type != EMBER_VAL_TYPED_ARRAY) {
+        return VM_RESULT_CONTINUE;
+    }
+    ember_typed_array* array = AS_TYPED_ARRAY(vm->stack[vm->stack_top - 3]);
+    ember_value value = vm->stack[vm->stack_top - 1];
+    int index;
+    if (!typed_array_index(vm, array, vm->stack[vm->stack_top - 2], &index)) {
+        return VM_RESULT_ERROR;
+    }
+    if (ember_object_is_frozen(array)) {
+        return frozen_error(vm);
+    }
+    if (value.type != EMBER_VAL_NUMBER) {
+        ember_error* error = ember_error_runtime(vm, "Typed arrays hold numbers only");
+        ember_vm_set_error(vm, error);
+        return VM_RESULT_ERROR;
+    }
+    ember_typed_array_store(array, index, value.as.number_val);
+    vm->stack_top -= 2;
+    vm->stack[vm->stack_top - 1] = value;
+    return VM_RESULT_OK;
+}
@@ -0,0 +1,306 @@
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "error.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Debugger. Breakpoints and steps cost nothing until they are hit: the
+// instruction to stop at has its opcode byte overwritten with
+// OP_BREAKPOINT and the original kept in a side table, so the dispatch
+// loop only ever meets a check where a debugger put one. The handler runs
+// the callback and hands back the original opcode, which the loop executes
+// in place of the patched byte; the site stays patched. A step patches
+// temporary sites: the statement starts of the chunk that stopped (step
+// in and over), the first statement of every function (step in) and the
+// instruction the caller resumes at, and the next stop restores them all.
+// Quickened opcodes are kept in their generic form, so an instruction run
+// in place of a breakpoint never writes its own byte back. Native code
+// would run past patched bytes, so a chunk with sites is kept from the JIT
+// until they are gone. Borrowed code is shared by other VMs and is never
+// patched.
+
+typedef struct {
+    ember_chunk* chunk;
+    int offset;
+    uint8_t original;    // Generic opcode the site replaced
+    uint8_t breakpoint;  // Set by the user, until cleared
+    uint8_t step;        // For the step in progress
+} debug_site;
+
+typedef struct {
+    ember_chunk* chunk;
+    int sites;
+    int jit_blacklisted;  // As it was before the first site
+} debug_chunk;
+
+typedef struct {
+    ember_debug_callback callback;
+    void* userdata;
+    debug_site* sites;
+    int site_count;
+    int site_capacity;
+    debug_chunk* chunks;
+    int chunk_count;
+    int chunk_capacity;
+    ember_debug_action step;  // EMBER_DEBUG_CONTINUE when not stepping
+    int step_depth;           // vm->frame_count where the step began
+    int stopped;              // Inside the callback
+} ember_debugger;
+
+static ember_debugger* debugger(ember_vm* vm) {
+    return vm ? (ember_debugger*)vm->debug_hooks : NULL;
+}
+
+static int find_site(const ember_debugger* dbg, const ember_chunk* chunk, int offset) {
+    for (int i = 0; i < dbg->site_count; i++) {
+        if (dbg->sites[i].chunk == chunk && dbg->sites[i].offset == offset) return i;
+    }
+    return -1;
+}
+
+static uint8_t opcode_at(const ember_debugger* dbg, const ember_chunk* chunk, int offset) {
+    int site = dbg ? find_site(dbg, chunk, offset) : -1;
+    return site >= 0 ? dbg->sites[site].original : chunk->code[offset];
+}
+
+// Bytes of an instruction whose opcode is op
+static int instruction_length(uint8_t op) {
+    int fused = opcode_fused_size(op);
+    if (fused > 0) return fused;
+    if (op == OP_WIDE) return 4;
+    return opcode_has_operand(op) ? 2 : 1;
+}
+
+static int instruction_starts_at(const ember_debugger* dbg, const ember_chunk* chunk, int offset) {
+    if (offset < 0 || offset >= chunk->count) return 0;
+    int at = 0;
+    while (at < offset) at += instruction_length(opcode_at(dbg, chunk, at));
+    return at == offset;
+}
+
+static debug_chunk* chunk_entry(ember_debugger* dbg, const ember_chunk* chunk) {
+    for (int i = 0; i < dbg->chunk_count; i++) {
+        if (dbg->chunks[i].chunk == chunk) return &dbg->chunks[i];
+    }
+    return NULL;
+}
+
+// Patch the instruction at offset (known to start one) as a breakpoint or
+// step site; 0 if memory ran out
+static int patch(ember_debugger* dbg, ember_chunk* chunk, int offset, int breakpoint) {
+    int index = find_site(dbg, chunk, offset);
+    if (index < 0) {
+        if (dbg->site_count == dbg->site_capacity) {
+            int capacity = dbg->site_capacity ? dbg->site_capacity * 2 : 16;
+            debug_site* sites = realloc(dbg->sites, sizeof(debug_site) * (size_t)capacity);
+            if (!sites) return 0;
+            dbg->sites = sites;
+            dbg->site_capacity = capacity;
+        }
+        debug_chunk* entry = chunk_entry(dbg, chunk);
+        if (!entry) {
+            if (dbg->chunk_count == dbg->chunk_capacity) {
+                int capacity = dbg->chunk_capacity ? dbg->chunk_capacity * 2 : 8;
+                debug_chunk* chunks = realloc(dbg->chunks, sizeof(debug_chunk) * (size_t)capacity);
+                if (!chunks) return 0;
+                dbg->chunks = chunks;
+                dbg->chunk_capacity = capacity;
+            }
+            entry = &dbg->chunks[dbg->chunk_count++];
+            entry->chunk = chunk;
+            entry->sites = 0;
+            entry->jit_blacklisted = chunk->jit_blacklisted;
+            // Native code is only entered while not blacklisted
+            chunk->jit_blacklisted = 1;
+        }
+        entry->sites++;
+        index = dbg->site_count++;
+        debug_site* site = &dbg->sites[index];
+        site->chunk = chunk;
+        site->offset = offset;
+        site->original = opcode_generic(chunk->code[offset]);
+        site->breakpoint = 0;
+        site->step = 0;
+        chunk->code[offset] = OP_BREAKPOINT;
+    }
+    if (breakpoint) {
+        dbg->sites[index].breakpoint = 1;
+    } else {
+        dbg->sites[index].step = 1;
+    }
+    return 1;
+}
+
+static void unpatch(ember_debugger* dbg, int index) {
+    debug_site site = dbg->sites[index];
+    site.chunk->code[site.offset] = site.original;
+    dbg->sites[index] = dbg->sites[--dbg->site_count];
+    debug_chunk* entry = chunk_entry(dbg, site.chunk);
+    if (entry && --entry->sites == 0) {
+        site.chunk->jit_blacklisted = entry->jit_blacklisted;
+        *entry = dbg->chunks[--dbg->chunk_count];
+    }
+}
+
+static void clear_steps(ember_debugger* dbg) {
+    for (int i = dbg->site_count - 1; i >= 0; i--) {
+        if (!dbg->sites[i].step) continue;
+        dbg->sites[i].step = 0;
+        if (!dbg->sites[i].breakpoint) unpatch(dbg, i);
+    }
+    dbg->step = EMBER_DEBUG_CONTINUE;
+}
+
+static void patch_step(ember_debugger* dbg, ember_chunk* chunk, int offset) {
+    if (chunk && !chunk->code_borrowed && offset >= 0 && offset < chunk->count) patch(dbg, chunk, offset, 0);
+}
+
+static void start_step(ember_vm* vm, ember_debugger* dbg, ember_chunk* chunk, int offset,
+                       ember_debug_action action) {
+    dbg->step = action;
+    dbg->step_depth = vm->frame_count;
+    if (action != EMBER_DEBUG_STEP_OUT) {
+        const ember_line_run* runs = ember_chunk_line_runs(chunk);
+        for (int r = 0; runs && r < chunk->line_count; r++) {
+            patch_step(dbg, chunk, runs[r].start);
+        }
+        // Without line information, a step is one instruction
+        if (!runs) patch_step(dbg, chunk, offset + instruction_length(opcode_at(dbg, chunk, offset)));
+    }
+    if (action == EMBER_DEBUG_STEP_IN) {
+        // Each function's first statement, or its first instruction
+        for (int i = 0; i < vm->function_chunk_count; i++) {
+            const ember_line_run* entry = ember_chunk_line_runs(vm->function_chunks[i]);
+            patch_step(dbg, vm->function_chunks[i], entry ? entry[0].start : 0);
+        }
+    }
+    // The caller's next instruction, unless returning hands control to C
+    if (vm->frame_count > 0) {
+        ember_frame* frame = &vm->frames[vm->frame_count - 1];
+        if (!frame->entry && frame->chunk && frame->return_ip) {
+            patch_step(dbg, frame->chunk, (int)(frame->return_ip - frame->chunk->code));
+        }
+    }
+}
+
+static int should_stop(ember_vm* vm, const ember_debugger* dbg, const debug_site* site) {
+    if (site->breakpoint) return 1;
+    if (!site->step) return 0;
+    switch (dbg->step) {
+        case EMBER_DEBUG_STEP_IN:   return 1;
+        case EMBER_DEBUG_STEP_OVER: return vm->frame_count <= dbg->step_depth;
+        case EMBER_DEBUG_STEP_OUT:  return vm->frame_count < dbg->step_depth;
+        default:                    return 0;
+    }
+}
+
+int ember_debug_attach(ember_vm* vm, ember_debug_callback callback, void* userdata) {
+    if (!vm || !callback) return EMBER_ERROR_INVALID_PARAMETER;
+    ember_debugger* dbg = debugger(vm);
+    if (!dbg) {
+        dbg = calloc(1, sizeof(ember_debugger));
+        if (!dbg) return EMBER_ERROR_MEMORY_ALLOCATION;
+        vm->debug_hooks = dbg;
+    }
+    dbg->callback = callback;
+    dbg->userdata = userdata;
+    vm->debug_enabled = 1;
+    // Breakpoints and steps need code to patch; functions defined while
+    // attached compile at once. A body with a syntax error reports it when
+    // called, as before
+    if (ember_vm_compile_lazy_functions(vm) != EMBER_SUCCESS) ember_vm_clear_error(vm);
+    return EMBER_SUCCESS;
+}
+
+void ember_debug_detach(ember_vm* vm) {
+    ember_debugger* dbg = debugger(vm);
+    if (!dbg) return;
+    while (dbg->site_count > 0) unpatch(dbg, dbg->site_count - 1);
+    free(dbg->sites);
+    free(dbg->chunks);
+    free(dbg);
+    vm->debug_hooks = NULL;
+    vm->debug_enabled = 0;
+}
+
+int ember_debug_set_breakpoint(ember_vm* vm, ember_chunk* chunk, int offset) {
+    ember_debugger* dbg = debugger(vm);
+    if (!chunk) return EMBER_ERROR_INVALID_PARAMETER;
+    if (!dbg || chunk->code_borrowed) return EMBER_ERROR_OPERATION_FAILED;
+    if (!instruction_starts_at(dbg, chunk, offset)) return EMBER_ERROR_INVALID_PARAMETER;
+    return patch(dbg, chunk, offset, 1) ? EMBER_SUCCESS : EMBER_ERROR_MEMORY_ALLOCATION;
+}
+
+int ember_debug_set_line_breakpoint(ember_vm* vm, ember_chunk* chunk, int line) {
+    if (!chunk || line <= 0) return EMBER_ERROR_INVALID_PARAMETER;
+    // The first statement on the line, or else the first after it
+    const ember_line_run* runs = ember_chunk_line_runs(chunk);
+    int offset = -1;
+    int found = 0;
+    for (int r = 0; runs && r < chunk->line_count; r++) {
+        if (runs[r].line < line || runs[r].start >= chunk->count) continue;
+        if (offset < 0 || runs[r].line < found) {
+            offset = runs[r].start;
+            found = runs[r].line;
+        }
+        if (found == line) break;
+    }
+    if (offset < 0) return EMBER_ERROR_INVALID_PARAMETER;
+    int result = ember_debug_set_breakpoint(vm, chunk, offset);
+    return result == EMBER_SUCCESS ? offset : result;
+}
+
+int ember_debug_clear_breakpoint(ember_vm* vm, ember_chunk* chunk, int offset) {
+    ember_debugger* dbg = debugger(vm);
+    int index = dbg && chunk ? find_site(dbg, chunk, offset) : -1;
+    if (index < 0 || !dbg->sites[index].breakpoint) return EMBER_ERROR_INVALID_PARAMETER;
+    dbg->sites[index].breakpoint = 0;
+    if (!dbg->sites[index].step) unpatch(dbg, index);
+    return EMBER_SUCCESS;
+}
+
+void ember_debug_clear_chunk(ember_vm* vm, ember_chunk* chunk) {
+    ember_debugger* dbg = debugger(vm);
+    if (!dbg) return;
+    for (int i = dbg->site_count - 1; i >= 0; i--) {
+        if (dbg->sites[i].chunk == chunk) unpatch(dbg, i);
+    }
+}
+
+int ember_debug_opcode_at(ember_vm* vm, const ember_chunk* chunk, int offset) {
+    if (!chunk || offset < 0 || offset >= chunk->count) return -1;
+    return opcode_at(debugger(vm), chunk, offset);
+}
+
+void vm_debug_run_end(ember_vm* vm) {
+    ember_debugger* dbg = debugger(vm);
+    if (dbg && !dbg->stopped) clear_steps(dbg);
+}
+
+vm_operation_result vm_handle_breakpoint(ember_vm* vm, ember_chunk* chunk, uint8_t* instruction, uint8_t* original) {
+    ember_debugger* dbg = debugger(vm);
+    int offset = chunk ? (int)(instruction - chunk->code) : -1;
+    int index = dbg ? find_site(dbg, chunk, offset) : -1;
+    if (index < 0) {
+        // Nobody patched this byte
+        ember_error* error = ember_error_runtime(vm, "Invalid breakpoint");
+        ember_vm_set_error(vm, error);
+        return VM_RESULT_ERROR;
+    }
+    debug_site site = dbg->sites[index];
+    // Code the callback runs (through ember_call) does not stop again
+    if (!dbg->stopped && should_stop(vm, dbg, &site)) {
+        clear_steps(dbg);
+        dbg->stopped = 1;
+        ember_debug_action action = dbg->callback(vm, chunk, offset, dbg->userdata);
+        // The callback may have detached
+        dbg = debugger(vm);
+        if (dbg) {
+            dbg->stopped = 0;
+            if (action != EMBER_DEBUG_CONTINUE) start_step(vm, dbg, chunk, offset, action);
+        }
+    }
+    *original = site.original;
+    return VM_RESULT_OK;
+}
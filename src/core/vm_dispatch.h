@@ -0,0 +1,225 @@
+#ifndef EMBER_VM_DISPATCH_H
+#define EMBER_VM_DISPATCH_H
+
+#include "../../include/ember.h"
+#include "../vm.h"
+
+// Opcode dispatch for the interpreter loop.
+//
+// Built with EMBER_COMPUTED_GOTO on GCC or Clang, every handler ends in its
+// own indirect jump through a label table (threaded dispatch), so the branch
+// predictor sees one jump site per opcode instead of the single switch.
+// Other compilers, or builds with COMPUTED_GOTO=0, get the switch. The loop
+// is written once for both:
+//
+//     VM_DISPATCH_TABLE_BEGIN
+//         VM_DISPATCH_ENTRY(OP_PUSH_CONST)
+//         VM_DISPATCH_ENTRY(OP_POP)
+//     VM_DISPATCH_TABLE_END
+//
+//     VM_DISPATCH_LOOP_BEGIN(ip)
+//         VM_CASE(OP_PUSH_CONST): ...; VM_NEXT(ip);
+//         VM_CASE(OP_POP): ...; VM_NEXT(ip);
+//         VM_DEFAULT: ...unknown opcode...
+//     VM_DISPATCH_LOOP_END
+//
+// Opcodes without a VM_DISPATCH_ENTRY land on VM_DEFAULT in both modes.
+
+#if defined(EMBER_COMPUTED_GOTO) && (defined(__GNUC__) || defined(__clang__))
+#define EMBER_THREADED_DISPATCH 1
+#else
+#define EMBER_THREADED_DISPATCH 0
+#endif
+
+#if EMBER_THREADED_DISPATCH
+
+// Every slot defaults to VM_DEFAULT; the entries below override it
+#define VM_DISPATCH_TABLE_BEGIN \
+    _Pragma("GCC diagnostic push") \
+    _Pragma("GCC diagnostic ignored \"-Woverride-init\"") \
+    static const void* const vm_dispatch_table[256] = { [0 ... 255] = &&vm_op_default,
+#define VM_DISPATCH_ENTRY(op) [op] = &&vm_op_##op,
+#define VM_DISPATCH_TABLE_END }; _Pragma("GCC diagnostic pop")
+
+#define VM_DISPATCH_LOOP_BEGIN(ip) VM_NEXT(ip);
+#define VM_DISPATCH_LOOP_END
+#define VM_CASE(op) vm_op_##op
+#define VM_DEFAULT vm_op_default
+#define VM_NEXT(ip) goto *vm_dispatch_table[*(ip)++]
+
+#else
+
+#define VM_DISPATCH_TABLE_BEGIN
+#define VM_DISPATCH_ENTRY(op)
+#define VM_DISPATCH_TABLE_END
+
+#define VM_DISPATCH_LOOP_BEGIN(ip) for (;;) switch (*(ip)++) {
+#define VM_DISPATCH_LOOP_END }
+#define VM_CASE(op) case op
+#define VM_DEFAULT default
+#define VM_NEXT(ip) continue
+
+#endif
+
+// Inline fast paths for the hottest handlers. Each one falls back to the
+// out-of-line vm_handle_* function whenever the fast path does not apply,
+// so errors and slow cases behave exactly as before.
+
+static inline vm_operation_result vm_dispatch_get_global(ember_vm* vm, ember_chunk* chunk, int constant) {
+    if (constant < chunk->global_cache_count && vm->stack_top < EMBER_STACK_MAX) {
+        const ember_global_cache* cache = &chunk->global_cache[constant];
+        if (cache->epoch == vm->globals_epoch && cache->epoch != 0) {
+            vm->stack[vm->stack_top++] = vm->globals[cache->slot].value;
+            return VM_RESULT_OK;
+        }
+    }
+    return vm_handle_get_global(vm, chunk, constant);
+}
+
+static inline vm_operation_result vm_dispatch_set_global(ember_vm* vm, ember_chunk* chunk, int constant) {
+    if (constant < chunk->global_cache_count && vm->stack_top > 0) {
+        const ember_global_cache* cache = &chunk->global_cache[constant];
+        if (cache->epoch == vm->globals_epoch && cache->epoch != 0) {
+            vm->globals[cache->slot].value = vm->stack[vm->stack_top - 1];
+            return VM_RESULT_OK;
+        }
+    }
+    return vm_handle_set_global(vm, chunk, constant);
+}
+
+static inline vm_operation_result vm_dispatch_arith_local_const(ember_vm* vm, ember_chunk* chunk, uint8_t op, int slot, int constant) {
+    int index = vm->local_base + slot;
+    if (index < EMBER_LOCALS_MAX && constant < chunk->const_count) {
+        ember_value* local = &vm->locals[index];
+        const ember_value* operand = &chunk->constants[constant];
+        if (local->type == EMBER_VAL_NUMBER && operand->type == EMBER_VAL_NUMBER) {
+            int32_t small;
+            if (local->as.number.is_small && operand->as.number.is_small &&
+                ember_small_int_arith(op, local->as.number.small, operand->as.number.small, &small)) {
+                *local = ember_make_int(small);
+                return VM_RESULT_OK;
+            }
+            if (op == OP_ADD_LOCAL_CONST) {
+                local->as.number_val += operand->as.number_val;
+            } else {
+                local->as.number_val -= operand->as.number_val;
+            }
+            local->as.number.is_small = 0;
+            return VM_RESULT_OK;
+        }
+    }
+    return vm_handle_arith_local_const(vm, chunk, op, slot, constant);
+}
+
+// OP_ARRAY_GET and OP_ARRAY_SET on a typed array with an in-range integer
+// index, unboxed in line. VM_RESULT_CONTINUE, from vm_handle_typed_array_*,
+// means the receiver is no typed array and the generic opcode runs
+static inline vm_operation_result vm_dispatch_array_get(ember_vm* vm) {
+    if (vm->stack_top >= 2) {
+        ember_value* receiver = &vm->stack[vm->stack_top - 2];
+        const ember_value* index = &vm->stack[vm->stack_top - 1];
+        if (receiver->type == EMBER_VAL_TYPED_ARRAY && index->type == EMBER_VAL_NUMBER) {
+            ember_typed_array* array = AS_TYPED_ARRAY(*receiver);
+            int slot = ember_number_index(index, array->length);
+            if (slot >= 0) {
+                *receiver = ember_make_number(ember_typed_array_load(array, slot));
+                vm->stack_top--;
+                return VM_RESULT_OK;
+            }
+        }
+    }
+    return vm_handle_typed_array_get(vm);
+}
+
+static inline vm_operation_result vm_dispatch_array_set(ember_vm* vm) {
+    if (vm->stack_top >= 3) {
+        const ember_value* receiver = &vm->stack[vm->stack_top - 3];
+        const ember_value* index = &vm->stack[vm->stack_top - 2];
+        const ember_value* value = &vm->stack[vm->stack_top - 1];
+        if (receiver->type == EMBER_VAL_TYPED_ARRAY && index->type == EMBER_VAL_NUMBER &&
+            value->type == EMBER_VAL_NUMBER) {
+            ember_typed_array* array = AS_TYPED_ARRAY(*receiver);
+            int slot = ember_number_index(index, array->length);
+            if (slot >= 0 && !ember_object_is_frozen(array)) {
+                ember_typed_array_store(array, slot, value->as.number_val);
+                vm->stack[vm->stack_top - 3] = *value;
+                vm->stack_top -= 2;
+                return VM_RESULT_OK;
+            }
+        }
+    }
+    return vm_handle_typed_array_set(vm);
+}
+
+// Type feedback for the instruction starting at instruction, before it runs,
+// while profiling is on for the VM or for a chunk with a hot loop (vm_osr.c);
+// predictable branches while it is off
+static inline void vm_dispatch_feedback(ember_vm* vm, ember_chunk* chunk, const uint8_t* instruction, uint8_t op, int operand) {
+    if (vm->type_feedback || chunk->osr_profile_budget) {
+        vm_feedback_record(vm, chunk, (int)(instruction - chunk->code), op, operand);
+    }
+}
+
+// Execution profile for the instruction starting at instruction, before it
+// runs, and the call stack when a sampling tick is due; two predictable
+// branches while neither profiler is on
+static inline void vm_dispatch_profile(ember_vm* vm, const uint8_t* instruction) {
+    if (vm->profiling) {
+        vm_profile_instruction(vm, instruction);
+    }
+    if (vm->sample_pending) {
+        vm_sample(vm);
+    }
+}
+
+// Number arithmetic and LESS cover the loop bodies quickening finds; the rest
+// of the quickened opcodes go out of line. Small ints stay small while the
+// result fits; the in-place double forms drop the flag
+static inline vm_operation_result vm_dispatch_quickened(ember_vm* vm, ember_chunk* chunk, uint8_t* instruction) {
+    if (vm->stack_top >= 2) {
+        ember_value* left = &vm->stack[vm->stack_top - 2];
+        const ember_value* right = &vm->stack[vm->stack_top - 1];
+        if (left->type == EMBER_VAL_NUMBER && right->type == EMBER_VAL_NUMBER) {
+            int32_t small;
+            if (left->as.number.is_small && right->as.number.is_small &&
+                ember_small_int_arith(*instruction, left->as.number.small, right->as.number.small, &small)) {
+                *left = ember_make_int(small);
+                vm->stack_top--;
+                return VM_RESULT_OK;
+            }
+            switch (*instruction) {
+                case OP_ADD_NUMBER: left->as.number_val += right->as.number_val; break;
+                case OP_SUB_NUMBER: left->as.number_val -= right->as.number_val; break;
+                case OP_MUL_NUMBER: left->as.number_val *= right->as.number_val; break;
+                case OP_LESS_NUMBER: {
+                    int less = left->as.number_val < right->as.number_val;
+                    left->type = EMBER_VAL_BOOL;
+                    left->as.bool_val = less;
+                    break;
+                }
+                default:
+                    return vm_handle_quickened(vm, chunk, instruction);
+            }
+            left->as.number.is_small = 0;
+            vm->stack_top--;
+            return VM_RESULT_OK;
+        }
+    }
+    return vm_handle_quickened(vm, chunk, instruction);
+}
+
+// LESS is the loop test the parser emits, so only it is inlined
+static inline vm_operation_result vm_dispatch_compare_local_const(ember_vm* vm, ember_chunk* chunk, uint8_t op, int slot, int constant, int* result) {
+    int index = vm->local_base + slot;
+    if (op == OP_LOCAL_LESS_CONST_JUMP_IF_FALSE && index < EMBER_LOCALS_MAX && constant < chunk->const_count) {
+        const ember_value* local = &vm->locals[index];
+        const ember_value* operand = &chunk->constants[constant];
+        if (local->type == EMBER_VAL_NUMBER && operand->type == EMBER_VAL_NUMBER) {
+            *result = local->as.number_val < operand->as.number_val;
+            return VM_RESULT_OK;
+        }
+    }
+    return vm_handle_compare_local_const(vm, chunk, op, slot, constant, result);
+}
+
+#endif // EMBER_VM_DISPATCH_H
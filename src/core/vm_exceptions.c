@@ -0,0 +1,82 @@
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "probes.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Exception tables. The compiler records each try block as a code range in
+// chunk->handlers instead of emitting instructions that install and remove
+// a handler at runtime, so entering and leaving a try costs nothing. Only a
+// throw consults the table: the innermost entry covering the throwing
+// instruction wins (entries are added as their try statement closes, so
+// nested blocks come first), and frames without one are unwound.
+
+int ember_chunk_add_handler(ember_chunk* chunk, const ember_handler_entry* entry) {
+    if (!chunk || !entry) return -1;
+    if (chunk->handler_count == chunk->handler_capacity) {
+        int capacity = chunk->handler_capacity < 4 ? 4 : chunk->handler_capacity * 2;
+        ember_handler_entry* handlers = realloc(chunk->handlers, sizeof(ember_handler_entry) * (size_t)capacity);
+        if (!handlers) {
+            fprintf(stderr, "[SECURITY] Memory allocation failed for exception table\n");
+            return -1;
+        }
+        chunk->handlers = handlers;
+        chunk->handler_capacity = capacity;
+    }
+    chunk->handlers[chunk->handler_count] = *entry;
+    return chunk->handler_count++;
+}
+
+const ember_handler_entry* ember_chunk_find_handler(const ember_chunk* chunk, int offset) {
+    if (!chunk) return NULL;
+    for (int i = 0; i < chunk->handler_count; i++) {
+        const ember_handler_entry* entry = &chunk->handlers[i];
+        if (offset >= entry->start && offset < entry->end) return entry;
+    }
+    return NULL;
+}
+
+void ember_chunk_free_handlers(ember_chunk* chunk) {
+    if (!chunk) return;
+    free(chunk->handlers);
+    chunk->handlers = NULL;
+    chunk->handler_count = 0;
+    chunk->handler_capacity = 0;
+}
+
+// VM operation handler for OP_THROW (and runtime errors raised as
+// exceptions): vm->current_exception holds the value being thrown. Resumes
+// at the nearest handler, dropping the frames and stack values above it;
+// VM_RESULT_ERROR when the exception leaves the code ember_run was given.
+vm_operation_result vm_handle_throw(ember_vm* vm) {
+    if (vm->current_exception.type == EMBER_VAL_EXCEPTION) {
+        ember_exception* exception = AS_EXCEPTION(vm->current_exception);
+        EMBER_PROBE2(exception__throw, exception->type_name, exception->message);
+        // Before unwinding; a rethrown exception keeps its first trace
+        ember_capture_stack_trace(vm, exception);
+    }
+    for (;;) {
+        ember_chunk* chunk = vm->chunk;
+        if (chunk && chunk->handler_count > 0 && vm->ip > chunk->code) {
+            // ip is past the throwing instruction (for callers, past the call)
+            int offset = (int)(vm->ip - chunk->code) - 1;
+            const ember_handler_entry* entry = ember_chunk_find_handler(chunk, offset);
+            if (entry) {
+                int base = vm->frame_count > 0 ? vm->frames[vm->frame_count - 1].stack_base : 0;
+                if (base + entry->stack_depth < vm->stack_top) {
+                    vm->stack_top = base + entry->stack_depth;
+                }
+                vm->ip = chunk->code + entry->handler;
+                // A finally block rethrows from OP_FINALLY_END while this is set
+                vm->exception_pending = entry->kind == EMBER_HANDLER_FINALLY;
+                return VM_RESULT_OK;
+            }
+        }
+        if (vm->frame_count == 0 || vm->frames[vm->frame_count - 1].entry) {
+            vm->exception_pending = 1;
+            return VM_RESULT_ERROR;
+        }
+        vm_unwind_frames(vm, vm->frame_count - 1);
+    }
+}
@@ -0,0 +1,242 @@
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "object_shape.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Type feedback. While vm->type_feedback is set, the dispatch loop reports
+// every profiled instruction (arithmetic, comparisons, array reads, property
+// access, calls) before running it. Each instruction gets one ember_feedback_slot,
+// found through chunk->feedback_index, a side table parallel to
+// chunk->code. The slot keeps the operand types seen and up to
+// EMBER_FEEDBACK_TARGETS distinct targets: the callee for calls, the class
+// for OP_INVOKE, the receiver's shape for property access and the operand
+// type pair for everything else. One target is monomorphic, a few
+// polymorphic, and any more megamorphic, after which targets stop being
+// recorded. Monomorphic sites are quickened into specialized opcodes
+// (vm_quicken.c).
+
+#define FEEDBACK_MAX_SLOTS 0xFFFF   // feedback_index stores slot + 1 in 16 bits
+
+int vm_feedback_profiled(uint8_t op) {
+    switch (op) {
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_MOD:
+        case OP_EQUAL:
+        case OP_NOT_EQUAL:
+        case OP_LESS:
+        case OP_LESS_EQUAL:
+        case OP_GREATER:
+        case OP_GREATER_EQUAL:
+        case OP_ARRAY_GET:
+        case OP_GET_PROPERTY:
+        case OP_SET_PROPERTY:
+        case OP_CALL:
+        case OP_TAIL_CALL:
+        case OP_INVOKE:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static uint32_t type_bit(ember_value value) {
+    return (unsigned)value.type < 32 ? 1u << value.type : 0;
+}
+
+// The slot for the instruction at offset, created on first use; NULL if the
+// table cannot grow
+static ember_feedback_slot* feedback_slot(ember_chunk* chunk, int offset, uint8_t op) {
+    if (chunk->feedback_index_length < chunk->count) {
+        // Sized to the code; a growing chunk (REPL) extends it
+        uint16_t* index = realloc(chunk->feedback_index, sizeof(uint16_t) * (size_t)chunk->count);
+        if (!index) return NULL;
+        memset(index + chunk->feedback_index_length, 0,
+               sizeof(uint16_t) * (size_t)(chunk->count - chunk->feedback_index_length));
+        chunk->feedback_index = index;
+        chunk->feedback_index_length = chunk->count;
+    }
+    uint16_t entry = chunk->feedback_index[offset];
+    if (entry) {
+        ember_feedback_slot* slot = &chunk->feedback[entry - 1];
+        if (slot->opcode == op) return slot;
+        // The code was rewritten under the slot: start over
+        memset(slot, 0, sizeof(*slot));
+        slot->offset = offset;
+        slot->opcode = op;
+        return slot;
+    }
+
+    if (chunk->feedback_count >= FEEDBACK_MAX_SLOTS) return NULL;
+    if (chunk->feedback_count == chunk->feedback_capacity) {
+        int capacity = chunk->feedback_capacity ? chunk->feedback_capacity * 2 : 16;
+        if (capacity > FEEDBACK_MAX_SLOTS) capacity = FEEDBACK_MAX_SLOTS;
+        ember_feedback_slot* slots = realloc(chunk->feedback, sizeof(ember_feedback_slot) * (size_t)capacity);
+        if (!slots) return NULL;
+        chunk->feedback = slots;
+        chunk->feedback_capacity = capacity;
+    }
+    ember_feedback_slot* slot = &chunk->feedback[chunk->feedback_count++];
+    memset(slot, 0, sizeof(*slot));
+    slot->offset = offset;
+    slot->opcode = op;
+    chunk->feedback_index[offset] = (uint16_t)chunk->feedback_count;
+    return slot;
+}
+
+static void record_target(ember_feedback_slot* slot, uint64_t target) {
+    if (slot->state == EMBER_FEEDBACK_MEGAMORPHIC) return;
+    for (int i = 0; i < slot->target_count; i++) {
+        if (slot->targets[i] == target) return;
+    }
+    if (slot->target_count == EMBER_FEEDBACK_TARGETS) {
+        slot->state = EMBER_FEEDBACK_MEGAMORPHIC;
+        return;
+    }
+    slot->targets[slot->target_count++] = target;
+    slot->state = slot->target_count == 1 ? EMBER_FEEDBACK_MONOMORPHIC : EMBER_FEEDBACK_POLYMORPHIC;
+}
+
+// What a call site dispatches on: the function's chunk or the native
+static uint64_t callee_target(ember_value callee) {
+    switch (callee.type) {
+        case EMBER_VAL_FUNCTION: return (uint64_t)(uintptr_t)callee.as.func_val.chunk;
+        case EMBER_VAL_NATIVE:   return (uint64_t)(uintptr_t)callee.as.native_val;
+        default:                 return (uint64_t)(uintptr_t)callee.as.obj_val | 1;
+    }
+}
+
+// Instances by shape (or class in dictionary mode); other receivers by type.
+// Shape ids are never reused, so a target cannot alias after a free.
+static uint64_t receiver_target(ember_value receiver) {
+    if (receiver.type == EMBER_VAL_INSTANCE && receiver.as.obj_val) {
+        ember_instance* instance = AS_INSTANCE(receiver);
+        if (instance->shape) return instance->shape->id << 1;
+        return (uint64_t)(uintptr_t)instance->klass | 1;
+    }
+    return ((uint64_t)receiver.type << 1) | 1;
+}
+
+void vm_feedback_record(ember_vm* vm, ember_chunk* chunk, int offset, uint8_t op, int operand) {
+    if (!chunk || offset < 0 || offset >= chunk->count || !vm_feedback_profiled(op)) return;
+    ember_feedback_slot* slot = feedback_slot(chunk, offset, op);
+    if (!slot) return;
+    if (slot->hits < UINT32_MAX) slot->hits++;
+
+    switch (op) {
+        case OP_GET_PROPERTY:
+        case OP_SET_PROPERTY: {
+            // The instance is under the value for stores
+            int depth = op == OP_SET_PROPERTY ? 2 : 1;
+            if (vm->stack_top < depth) return;
+            ember_value receiver = vm->stack[vm->stack_top - depth];
+            slot->left_types |= type_bit(receiver);
+            record_target(slot, receiver_target(receiver));
+            break;
+        }
+        case OP_CALL:
+        case OP_TAIL_CALL: {
+            if (vm->stack_top < operand + 1) return;
+            ember_value callee = vm->stack[vm->stack_top - 1];
+            slot->left_types |= type_bit(callee);
+            record_target(slot, callee_target(callee));
+            break;
+        }
+        case OP_INVOKE: {
+            // Receiver, arguments, method name
+            if (vm->stack_top < operand + 2) return;
+            ember_value receiver = vm->stack[vm->stack_top - operand - 2];
+            slot->left_types |= type_bit(receiver);
+            if (receiver.type == EMBER_VAL_INSTANCE && receiver.as.obj_val) {
+                record_target(slot, (uint64_t)(uintptr_t)AS_INSTANCE(receiver)->klass);
+            } else {
+                record_target(slot, ((uint64_t)receiver.type << 1) | 1);
+            }
+            break;
+        }
+        default: {
+            if (vm->stack_top < 2) return;
+            ember_value left = vm->stack[vm->stack_top - 2];
+            ember_value right = vm->stack[vm->stack_top - 1];
+            slot->left_types |= type_bit(left);
+            slot->right_types |= type_bit(right);
+            record_target(slot, ((uint64_t)left.type << 8 | (uint64_t)right.type) + 1);
+            vm_quicken(chunk, slot);
+            break;
+        }
+    }
+}
+
+int vm_feedback_restore(ember_chunk* chunk, const ember_feedback_slot* saved) {
+    if (!chunk || !saved || saved->offset < 0 || saved->offset >= chunk->count) return 0;
+    uint8_t op = chunk->code[saved->offset];
+    if (op != saved->opcode && opcode_generic(op) != saved->opcode) return 0;
+    ember_feedback_slot* slot = feedback_slot(chunk, saved->offset, saved->opcode);
+    if (!slot) return 0;
+    slot->hits = saved->hits > UINT32_MAX - slot->hits ? UINT32_MAX : slot->hits + saved->hits;
+    slot->left_types |= saved->left_types;
+    slot->right_types |= saved->right_types;
+    if (saved->state == EMBER_FEEDBACK_MEGAMORPHIC) {
+        slot->state = EMBER_FEEDBACK_MEGAMORPHIC;
+    }
+    for (int i = 0; i < saved->target_count && i < EMBER_FEEDBACK_TARGETS; i++) {
+        record_target(slot, saved->targets[i]);
+    }
+    vm_quicken(chunk, slot);
+    return 1;
+}
+
+const ember_feedback_slot* ember_chunk_feedback_at(const ember_chunk* chunk, int offset) {
+    if (!chunk || offset < 0 || offset >= chunk->feedback_index_length) return NULL;
+    uint16_t entry = chunk->feedback_index[offset];
+    return entry ? &chunk->feedback[entry - 1] : NULL;
+}
+
+void ember_chunk_free_feedback(ember_chunk* chunk) {
+    if (!chunk) return;
+    free(chunk->feedback);
+    chunk->feedback = NULL;
+    chunk->feedback_count = 0;
+    chunk->feedback_capacity = 0;
+    free(chunk->feedback_index);
+    chunk->feedback_index = NULL;
+    chunk->feedback_index_length = 0;
+}
+
+void ember_vm_set_type_feedback(ember_vm* vm, int enable) {
+    if (vm) vm->type_feedback = enable ? true : false;
+}
+
+static void print_types(uint32_t mask) {
+    if (!mask) {
+        printf("-");
+        return;
+    }
+    const char* separator = "";
+    for (int type = 0; type < 32; type++) {
+        if (!(mask & (1u << type))) continue;
+        printf("%s%s", separator, value_type_to_string((ember_val_type)type));
+        separator = "|";
+    }
+}
+
+void ember_chunk_print_feedback(const ember_chunk* chunk) {
+    if (!chunk) return;
+    static const char* const states[] = { "uninitialized", "monomorphic", "polymorphic", "megamorphic" };
+    printf("[FEEDBACK] %d profiled instructions\n", chunk->feedback_count);
+    for (int i = 0; i < chunk->feedback_count; i++) {
+        const ember_feedback_slot* slot = &chunk->feedback[i];
+        printf("[FEEDBACK] %5d op %3d hits %10u %-13s ", slot->offset, slot->opcode, slot->hits,
+               states[slot->state & 3]);
+        print_types(slot->left_types);
+        if (slot->right_types) {
+            printf(", ");
+            print_types(slot->right_types);
+        }
+        printf("\n");
+    }
+}
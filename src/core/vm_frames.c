@@ -0,0 +1,342 @@
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "../runtime/value/value.h"
+#include "error.h"
+#include "probes.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Ember-to-Ember calls push an ember_frame with the caller's chunk, ip and
+// local window, then point vm->chunk/vm->ip at the callee, so the dispatch
+// loop carries on without recursing into ember_run. Arguments move from the
+// value stack into the callee's slots 0..argc-1, where the compiler resolves
+// the parameters. The dispatch loop must reload any cached ip/chunk after
+// these handlers return.
+
+static vm_operation_result call_error(ember_vm* vm, const char* message) {
+    ember_error* error = ember_error_runtime(vm, message);
+    ember_vm_set_error(vm, error);
+    return VM_RESULT_ERROR;
+}
+
+// Calls and returns are GC safe points: every live value is reachable from
+// the VM, none is held only by a C local
+static void gc_safepoint(ember_vm* vm) {
+    vm_note_high_water(vm);
+    if (vm->gc_step_requested) {
+        gc_incremental_step(vm);
+    }
+    if (vm->gc_minor_requested) {
+        gc_collect_minor(vm);
+    }
+}
+
+// Fuel for a call, charged before anything moves so a TimeoutError unwinds
+// from the call site. False if the call must not go on: the error is
+// uncaught, or a handler caught it and ip is there now
+static int charge_call(ember_vm* vm, vm_operation_result* result) {
+    const uint8_t* ip = vm->ip;
+    const ember_chunk* chunk = vm->chunk;
+    *result = vm_fuel_charge(vm);
+    return *result == VM_RESULT_OK && vm->ip == ip && vm->chunk == chunk;
+}
+
+// Move the argc values on top of the stack into locals[base...]
+static int bind_arguments(ember_vm* vm, int base, int argc) {
+    if (base + argc > EMBER_LOCALS_MAX) return 0;
+    const ember_value* args = &vm->stack[vm->stack_top - argc];
+    for (int i = 0; i < argc; i++) {
+        vm->locals[base + i] = args[i];
+    }
+    vm->stack_top -= argc;
+    vm->local_count = base + argc;
+    return 1;
+}
+
+// Called with vm->frame_count already counting the new frame
+static void enter_function(ember_vm* vm, ember_chunk* chunk, const char* name) {
+    EMBER_PROBE2(function__entry, chunk->name, vm->frame_count);
+    // Before vm_jit_on_call, which may compile what the profile made hot
+    if (vm->warm_profile && !chunk->warm_checked) vm_warm_profile_apply(vm, chunk);
+    vm->chunk = chunk;
+    vm->ip = chunk->code;
+    vm->function_calls++;
+    if (vm->profiling) vm_profile_call(vm, chunk, name);
+    if (vm->sampler) vm_sampler_call(vm, chunk, name);
+}
+
+// A lazy function body compiles before its first call; on a syntax error
+// the call fails with the error set
+static int ensure_compiled(ember_vm* vm, ember_chunk* chunk) {
+    return !chunk->lazy_body || ember_chunk_compile_lazy(vm, chunk) == EMBER_SUCCESS;
+}
+
+static void restore_frame(ember_vm* vm, const ember_frame* frame) {
+    vm->chunk = frame->chunk;
+    vm->ip = frame->return_ip;
+    vm->local_base = frame->local_base;
+    vm->local_count = frame->local_count;
+}
+
+// Room for one more frame. Most VMs never nest deeply, so the frame array
+// starts small on the first call instead of being part of every ember_vm.
+static int reserve_frame(ember_vm* vm) {
+    if (vm->frame_count < vm->frame_capacity) return 1;
+    if (vm->frame_capacity >= EMBER_MAX_FRAMES) return 0;
+    int capacity = vm->frame_capacity ? vm->frame_capacity * 2 : EMBER_INITIAL_FRAMES;
+    if (capacity > EMBER_MAX_FRAMES) capacity = EMBER_MAX_FRAMES;
+    ember_frame* frames = realloc(vm->frames, sizeof(ember_frame) * (size_t)capacity);
+    if (!frames) {
+        fprintf(stderr, "[CALL] Memory allocation failed for call frames\n");
+        return 0;
+    }
+    vm->frames = frames;
+    vm->frame_capacity = capacity;
+    return 1;
+}
+
+void vm_frames_free(ember_vm* vm) {
+    if (!vm) return;
+    free(vm->frames);
+    vm->frames = NULL;
+    vm->frame_count = 0;
+    vm->frame_capacity = 0;
+}
+
+// Enter chunk (the function called name) with the argc values above
+// stack_base as its slots 0..argc-1
+static vm_operation_result push_call_frame(ember_vm* vm, ember_chunk* chunk, const char* name, int stack_base, int argc) {
+    if (!ensure_compiled(vm, chunk)) {
+        return VM_RESULT_ERROR;
+    }
+    if (!reserve_frame(vm)) {
+        return call_error(vm, "Call stack overflow");
+    }
+
+    ember_frame* frame = &vm->frames[vm->frame_count];
+    frame->chunk = vm->chunk;
+    frame->return_ip = vm->ip;
+    frame->local_base = vm->local_base;
+    frame->local_count = vm->local_count;
+    frame->stack_base = stack_base;
+    frame->entry = 0;
+    if (!bind_arguments(vm, vm->local_count, argc)) {
+        return call_error(vm, "Too many local variables");
+    }
+    vm->local_base = frame->local_count;
+    vm->frame_count++;
+    vm_note_high_water(vm);
+    enter_function(vm, chunk, name);
+    vm_jit_on_call(vm);
+    return VM_RESULT_OK;
+}
+
+// VM operation handler for OP_CALL: the stack holds the arguments, then the callee
+vm_operation_result vm_handle_call(ember_vm* vm, int argc) {
+    if (argc < 0 || argc > EMBER_MAX_ARGS || vm->stack_top < argc + 1) {
+        return call_error(vm, "Invalid argument count for call");
+    }
+    vm_operation_result fuel;
+    if (!charge_call(vm, &fuel)) {
+        return fuel;
+    }
+    ember_value callee = vm->stack[vm->stack_top - 1];
+    const ember_native_info* info = NULL;
+    if (callee.type == EMBER_VAL_NATIVE && vm->native_table) {
+        info = vm_native_info(vm, callee.as.native_val);
+    }
+    // A native that allocates nothing gives the collector no reason to run
+    if (info && (info->flags & EMBER_NATIVE_NO_GC)) {
+        vm_note_high_water(vm);
+    } else {
+        gc_safepoint(vm);
+    }
+    vm->stack_top--;
+    int stack_base = vm->stack_top - argc;
+
+    if (callee.type == EMBER_VAL_NATIVE) {
+        // Arguments stay where they are on the stack
+        ember_value* args = &vm->stack[stack_base];
+        ember_value result;
+        if (info && !vm_native_args_match(info, argc, args)) {
+            result = ember_make_nil();
+        } else {
+            // Natives read argument chars directly, unless they take ropes
+            if (!info || !(info->flags & EMBER_NATIVE_ROPES)) {
+                ember_flatten_string_args(argc, args);
+            }
+            result = callee.as.native_val(vm, argc, args);
+        }
+        vm->stack_top = stack_base;
+        vm->stack[vm->stack_top++] = result;
+        vm->function_calls++;
+        return VM_RESULT_OK;
+    }
+    if (callee.type != EMBER_VAL_FUNCTION || !callee.as.func_val.chunk) {
+        return call_error(vm, "Can only call functions");
+    }
+    if (callee.as.func_val.chunk->is_generator) {
+        // The body runs when the generator is resumed
+        ember_value generator = vm_generator_call(vm, callee.as.func_val.chunk, argc, &vm->stack[stack_base]);
+        if (generator.type != EMBER_VAL_GENERATOR) {
+            return call_error(vm, "Out of memory creating generator");
+        }
+        vm->stack_top = stack_base;
+        vm->stack[vm->stack_top++] = generator;
+        return VM_RESULT_OK;
+    }
+    return push_call_frame(vm, callee.as.func_val.chunk, callee.as.func_val.name, stack_base, argc);
+}
+
+// VM operation handler for OP_INVOKE: the stack holds the receiver, the
+// arguments, then the method name. A method the receiver's class defines is
+// entered directly with the receiver in slot 0, so obj.method(args) does not
+// allocate an ember_bound_method. VM_RESULT_CONTINUE (stack untouched) asks
+// the dispatch loop for the general path: other receivers, fields that
+// shadow a method, natives and missing methods.
+vm_operation_result vm_handle_invoke(ember_vm* vm, int argc) {
+    if (argc < 0 || argc > EMBER_MAX_ARGS || vm->stack_top < argc + 2) {
+        return call_error(vm, "Invalid argument count for call");
+    }
+    ember_value name = vm->stack[vm->stack_top - 1];
+    int stack_base = vm->stack_top - argc - 2;
+    ember_value receiver = vm->stack[stack_base];
+    if (receiver.type != EMBER_VAL_INSTANCE || name.type != EMBER_VAL_STRING) {
+        return VM_RESULT_CONTINUE;
+    }
+
+    ember_instance* instance = (ember_instance*)receiver.as.obj_val;
+    if (ember_instance_get_field(instance, name, NULL)) {
+        return VM_RESULT_CONTINUE;
+    }
+    ember_value method = ember_class_find_method(vm, instance->klass, name);
+    if (method.type != EMBER_VAL_FUNCTION || !method.as.func_val.chunk) {
+        return VM_RESULT_CONTINUE;
+    }
+
+    vm_operation_result fuel;
+    if (!charge_call(vm, &fuel)) {
+        return fuel;
+    }
+    vm->stack_top--;
+    gc_safepoint(vm);
+    return push_call_frame(vm, method.as.func_val.chunk, method.as.func_val.name, stack_base, argc + 1);
+}
+
+// VM operation handler for OP_TAIL_CALL: `return f(...)` replaces the running
+// function's locals and stack in place, so the frame depth stays constant.
+// Natives and calls from top-level code have no frame to reuse.
+vm_operation_result vm_handle_tail_call(ember_vm* vm, int argc) {
+    if (argc < 0 || argc > EMBER_MAX_ARGS || vm->stack_top < argc + 1) {
+        return call_error(vm, "Invalid argument count for call");
+    }
+    ember_value callee = vm->stack[vm->stack_top - 1];
+    if (vm->frame_count == 0 || callee.type != EMBER_VAL_FUNCTION || !callee.as.func_val.chunk ||
+        callee.as.func_val.chunk->is_generator) {
+        return vm_handle_call(vm, argc);
+    }
+    if (!ensure_compiled(vm, callee.as.func_val.chunk)) {
+        return VM_RESULT_ERROR;
+    }
+    // Tail recursion never reaches OP_CALL or OP_LOOP
+    vm_operation_result fuel;
+    if (!charge_call(vm, &fuel)) {
+        return fuel;
+    }
+
+    vm->stack_top--;
+    if (!bind_arguments(vm, vm->local_base, argc)) {
+        return call_error(vm, "Too many local variables");
+    }
+    EMBER_PROBE2(function__return, vm->chunk->name, vm->frame_count);
+    // Anything the finished function left under its arguments is dead
+    vm->stack_top = vm->frames[vm->frame_count - 1].stack_base;
+    enter_function(vm, callee.as.func_val.chunk, callee.as.func_val.name);
+    vm_jit_on_call(vm);
+    return VM_RESULT_OK;
+}
+
+// VM operation handler for OP_CALL_GUARD, in front of a body the optimizer
+// inlined: the inlined code is only valid while the global still holds the
+// function it was copied from. A reassigned global leaves the callee on the
+// stack for the real OP_CALL after the inlined code.
+vm_operation_result vm_handle_call_guard(ember_vm* vm, ember_chunk* chunk, int constant, int* inlined) {
+    *inlined = 0;
+    if (!chunk || constant < 0 || constant >= chunk->const_count || vm->stack_top < 1) {
+        return call_error(vm, "Invalid inlined call");
+    }
+    ember_value expected = chunk->constants[constant];
+    ember_value callee = vm->stack[vm->stack_top - 1];
+    if (callee.type == EMBER_VAL_FUNCTION && expected.type == EMBER_VAL_FUNCTION &&
+        callee.as.func_val.chunk == expected.as.func_val.chunk) {
+        vm->stack_top--;
+        *inlined = 1;
+    }
+    return VM_RESULT_OK;
+}
+
+// VM operation handler for OP_RETURN: replaces the callee's stack window
+// with its return value and resumes the caller
+vm_operation_result vm_handle_return(ember_vm* vm) {
+    gc_safepoint(vm);
+    if (vm->frame_count == 0) {
+        // Top-level return: leave the value for the embedder
+        return VM_RESULT_CONTINUE;
+    }
+
+    EMBER_PROBE2(function__return, vm->chunk->name, vm->frame_count);
+    ember_frame* frame = &vm->frames[--vm->frame_count];
+    ember_value result = vm->stack_top > frame->stack_base ? vm->stack[vm->stack_top - 1] : ember_make_nil();
+    vm->stack_top = frame->stack_base;
+    vm->stack[vm->stack_top++] = result;
+    restore_frame(vm, frame);
+    return frame->entry ? VM_RESULT_CONTINUE : VM_RESULT_OK;
+}
+
+// Enter chunk from C (ember_call) with argv bound to its parameters. The
+// frame is marked as an entry frame, so its OP_RETURN makes ember_run
+// return. Returns the frame depth to pass to vm_unwind_frames, or -1.
+int vm_push_entry_frame(ember_vm* vm, ember_chunk* chunk, int argc, ember_value* argv) {
+    if (vm->frame_count >= EMBER_MAX_FRAMES) {
+        fprintf(stderr, "[CALL] Call stack overflow (max: %d frames)\n", EMBER_MAX_FRAMES);
+        return -1;
+    }
+    if (!reserve_frame(vm)) return -1;
+    if (!ensure_compiled(vm, chunk)) return -1;
+    if (vm->local_count + argc > EMBER_LOCALS_MAX) {
+        fprintf(stderr, "[CALL] Not enough local slots for %d arguments\n", argc);
+        return -1;
+    }
+
+    ember_frame* frame = &vm->frames[vm->frame_count];
+    frame->chunk = vm->chunk;
+    frame->return_ip = vm->ip;
+    frame->local_base = vm->local_base;
+    frame->local_count = vm->local_count;
+    frame->stack_base = vm->stack_top;
+    frame->entry = 1;
+
+    vm->local_base = vm->local_count;
+    for (int i = 0; i < argc; i++) {
+        vm->locals[vm->local_count++] = argv[i];
+    }
+    int depth = vm->frame_count++;
+    vm_note_high_water(vm);
+    enter_function(vm, chunk, NULL);
+    return depth;
+}
+
+// Drop every frame above frame_count (after a runtime error) and restore
+// the state of the code that pushed the lowest of them
+void vm_unwind_frames(ember_vm* vm, int frame_count) {
+    if (frame_count < 0 || frame_count >= vm->frame_count) return;
+    // The function running at each depth leaves: vm->chunk on top, the
+    // chunk its caller saved below that
+    for (int depth = vm->frame_count; depth > frame_count; depth--) {
+        EMBER_PROBE2(function__return, depth == vm->frame_count ? vm->chunk->name : vm->frames[depth].chunk->name, depth);
+    }
+    const ember_frame* frame = &vm->frames[frame_count];
+    vm->stack_top = frame->stack_base;
+    restore_frame(vm, frame);
+    vm->frame_count = frame_count;
+}
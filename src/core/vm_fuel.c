@@ -0,0 +1,56 @@
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "../runtime/value/value.h"
+
+// Instruction fuel. A VM with a budget fills vm->fuel with fuel_slice units
+// and spends one at every OP_LOOP back edge and every call into Ember code
+// (vm_fuel_charge), which bounds everything a script can do between two
+// checks: straight-line code cannot run long without jumping back or
+// calling. Charging is a decrement and a branch, so the budget costs
+// nothing on the instructions in between.
+//
+// A VM without a budget keeps the tank at INT64_MAX. A new VM starts with
+// it empty; the first charge lands here and fills it.
+
+#define FUEL_UNLIMITED INT64_MAX
+
+vm_operation_result vm_fuel_exhausted(ember_vm* vm) {
+    if (vm->fuel_slice <= 0) {
+        vm->fuel = FUEL_UNLIMITED;
+        return VM_RESULT_OK;
+    }
+    vm->fuel_exhausted++;
+    if (vm->fuel_mode == EMBER_FUEL_YIELD) {
+        if (vm->fuel_hook) {
+            // Whatever the hook runs gets full slices of its own
+            vm->fuel = vm->fuel_slice;
+            vm->fuel_hook(vm, vm->fuel_hook_data);
+        }
+        vm->fuel = vm->fuel_slice;
+        return VM_RESULT_OK;
+    }
+    // Left empty, so a handler that loops or calls times out again
+    vm->fuel = 0;
+    vm->current_exception = ember_make_timeout_error(vm, "Instruction budget exhausted");
+    return vm_handle_throw(vm);
+}
+
+int ember_vm_set_fuel(ember_vm* vm, int64_t slice, ember_fuel_mode mode) {
+    if (!vm || slice < 0 || (mode != EMBER_FUEL_TIMEOUT && mode != EMBER_FUEL_YIELD)) {
+        return EMBER_ERROR_INVALID_PARAMETER;
+    }
+    vm->fuel_slice = slice;
+    vm->fuel_mode = mode;
+    ember_vm_refuel(vm);
+    return EMBER_SUCCESS;
+}
+
+void ember_vm_refuel(ember_vm* vm) {
+    if (vm) vm->fuel = vm->fuel_slice > 0 ? vm->fuel_slice : FUEL_UNLIMITED;
+}
+
+void ember_vm_set_fuel_hook(ember_vm* vm, ember_fuel_hook hook, void* userdata) {
+    if (!vm) return;
+    vm->fuel_hook = hook;
+    vm->fuel_hook_data = userdata;
+}
@@ -0,0 +1,203 @@
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "../runtime/value/value.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Generators as heap frames.
+//
+// Calling an fn* function makes a generator holding the call's frame: its
+// locals, then whatever the body had on the value stack at its last
+// OP_YIELD, in one block that is allocated with the generator and only
+// grows if a yield needs more room. Resuming binds the block back into the
+// VM as an ember_call-style entry frame and jumps to the saved ip, so the
+// body runs in the normal dispatch loop and its own calls push ordinary
+// frames on top. OP_YIELD stores the live slots back into the block and
+// returns the yielded value from the entry frame.
+//
+// The VM's locals and value stack are inline arrays, so the live window is
+// moved between them and the block on every resume and yield; nothing is
+// allocated per step, and a yield at statement level has no stack segment
+// to save.
+
+#define GENERATOR_FRAME_MIN 8
+
+static vm_operation_result generator_error(ember_vm* vm, const char* message) {
+    ember_error* error = ember_error_runtime(vm, message);
+    ember_vm_set_error(vm, error);
+    return VM_RESULT_ERROR;
+}
+
+static int reserve_frame(ember_generator* generator, int needed) {
+    if (needed <= generator->frame_capacity) return 1;
+    int capacity = generator->frame_capacity ? generator->frame_capacity : GENERATOR_FRAME_MIN;
+    while (capacity < needed) capacity *= 2;
+    ember_value* frame = realloc(generator->frame, sizeof(ember_value) * (size_t)capacity);
+    if (!frame) {
+        fprintf(stderr, "[GENERATOR] Memory allocation failed for generator frame\n");
+        return 0;
+    }
+    generator->frame = frame;
+    generator->frame_capacity = capacity;
+    return 1;
+}
+
+static void release_frame(ember_generator* generator) {
+    free(generator->frame);
+    generator->frame = NULL;
+    generator->frame_capacity = 0;
+    generator->local_count = 0;
+    generator->stack_top = 0;
+}
+
+ember_value ember_make_generator(ember_vm* vm, ember_chunk* chunk) {
+    return vm_generator_call(vm, chunk, 0, NULL);
+}
+
+ember_value vm_generator_call(ember_vm* vm, ember_chunk* chunk, int argc, ember_value* argv) {
+    if (!vm || !chunk || argc < 0 || argc > EMBER_MAX_ARGS) return ember_make_nil();
+    ember_generator* generator = (ember_generator*)allocate_object(vm, sizeof(ember_generator), OBJ_GENERATOR);
+    if (!generator) return ember_make_nil();
+
+    generator->state = GENERATOR_CREATED;
+    generator->chunk = chunk;
+    generator->ip = chunk->code;
+    generator->frame = NULL;
+    generator->frame_capacity = 0;
+    generator->local_count = 0;
+    generator->stack_top = 0;
+    generator->yielded_value = ember_make_nil();
+    generator->vm = vm;
+    generator->depth = -1;
+    if (!reserve_frame(generator, argc > GENERATOR_FRAME_MIN ? argc : GENERATOR_FRAME_MIN)) {
+        return ember_make_nil();
+    }
+    // The arguments become slots 0..argc-1, as for an ordinary call
+    for (int i = 0; i < argc; i++) {
+        generator->frame[i] = argv[i];
+    }
+    generator->local_count = argc;
+
+    ember_value value;
+    value.type = EMBER_VAL_GENERATOR;
+    value.as.obj_val = (ember_object*)generator;
+    return value;
+}
+
+// VM operation handler for OP_YIELD: the stack holds the yielded value
+vm_operation_result vm_handle_yield(ember_vm* vm) {
+    ember_generator* generator = vm->current_generator;
+    if (!generator || generator->state != GENERATOR_RUNNING || vm->frame_count - 1 != generator->depth) {
+        return generator_error(vm, "yield outside a running generator");
+    }
+    if (vm->stack_top < 1) {
+        return generator_error(vm, "Nothing to yield");
+    }
+
+    const ember_frame* call = &vm->frames[vm->frame_count - 1];
+    int local_count = vm->local_count - vm->local_base;
+    int stack_count = vm->stack_top - 1 - call->stack_base;
+    if (!reserve_frame(generator, local_count + stack_count)) {
+        return generator_error(vm, "Out of memory suspending generator");
+    }
+    ember_value* saved = generator->frame;
+    memcpy(saved, &vm->locals[vm->local_base], sizeof(ember_value) * (size_t)local_count);
+    if (stack_count > 0) {
+        memcpy(saved + local_count, &vm->stack[call->stack_base], sizeof(ember_value) * (size_t)stack_count);
+    }
+    // The generator may be old while the saved values are young
+    for (int i = 0; i < local_count + stack_count; i++) {
+        gc_write_barrier_helper(vm, (ember_object*)generator, ember_make_nil(), saved[i]);
+    }
+    generator->local_count = local_count;
+    generator->stack_top = stack_count;
+    generator->ip = vm->ip;
+    generator->yielded_value = vm->stack[vm->stack_top - 1];
+    gc_write_barrier_helper(vm, (ember_object*)generator, ember_make_nil(), generator->yielded_value);
+    generator->state = GENERATOR_SUSPENDED;
+
+    // Leaves the yielded value where vm_generator_resume picks it up
+    return vm_handle_return(vm);
+}
+
+int vm_generator_resume(ember_vm* vm, ember_generator* generator, ember_value sent, ember_value* result) {
+    *result = ember_make_nil();
+    if (generator->state == GENERATOR_COMPLETED) {
+        return 0;
+    }
+    if (generator->state == GENERATOR_RUNNING) {
+        generator_error(vm, "Generator is already running");
+        return -1;
+    }
+
+    int resuming = generator->state == GENERATOR_SUSPENDED;
+    int stack_base = vm->stack_top;
+    if (stack_base + generator->stack_top + 1 > EMBER_STACK_MAX) {
+        generator_error(vm, "Stack overflow resuming generator");
+        return -1;
+    }
+    // Binds the saved locals as if they were arguments
+    int depth = vm_push_entry_frame(vm, generator->chunk, generator->local_count, generator->frame);
+    if (depth < 0) {
+        generator_error(vm, "Call stack overflow resuming generator");
+        return -1;
+    }
+    if (generator->stack_top > 0) {
+        memcpy(&vm->stack[vm->stack_top], generator->frame + generator->local_count,
+               sizeof(ember_value) * (size_t)generator->stack_top);
+        vm->stack_top += generator->stack_top;
+    }
+    vm->ip = generator->ip;
+    if (resuming) {
+        // The value of the yield expression
+        vm->stack[vm->stack_top++] = sent;
+    }
+
+    ember_generator* outer = vm->current_generator;
+    vm->current_generator = generator;
+    generator->state = GENERATOR_RUNNING;
+    generator->depth = depth;
+    int status = ember_run(vm);
+    vm->current_generator = outer;
+    generator->depth = -1;
+
+    if (status != 0) {
+        vm_unwind_frames(vm, depth);
+        vm->stack_top = stack_base;
+        generator->state = GENERATOR_COMPLETED;
+        release_frame(generator);
+        return -1;
+    }
+    *result = vm->stack_top > stack_base ? vm->stack[vm->stack_top - 1] : ember_make_nil();
+    vm->stack_top = stack_base;
+    if (generator->state == GENERATOR_SUSPENDED) {
+        return 1;
+    }
+    // Returned: the frame is never needed again
+    generator->state = GENERATOR_COMPLETED;
+    generator->yielded_value = ember_make_nil();
+    release_frame(generator);
+    return 0;
+}
+
+// VM operation handler for OP_GENERATOR_NEXT: the stack holds a generator,
+// replaced by its next value (nil once it returns) and whether it is done
+vm_operation_result vm_handle_generator_next(ember_vm* vm) {
+    if (vm->stack_top < 1 || vm->stack[vm->stack_top - 1].type != EMBER_VAL_GENERATOR) {
+        return generator_error(vm, "Can only resume generators");
+    }
+    if (vm->stack_top + 1 > EMBER_STACK_MAX) {
+        return generator_error(vm, "Stack overflow");
+    }
+    ember_generator* generator = AS_GENERATOR(vm->stack[vm->stack_top - 1]);
+    ember_value value;
+    int status = vm_generator_resume(vm, generator, ember_make_nil(), &value);
+    if (status < 0) {
+        return VM_RESULT_ERROR;
+    }
+    // A return value is not one of the generated values
+    vm->stack[vm->stack_top - 1] = status == 1 ? value : ember_make_nil();
+    vm->stack[vm->stack_top++] = ember_make_bool(status == 0);
+    return VM_RESULT_OK;
+}
@@ -0,0 +1,274 @@
+#include "../../include/ember.h"
+#include "../../include/ember_interfaces.h"
+#include "../runtime/value/value.h"
+#include "../runtime/runtime.h"
+#include "error.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GLOBALS_INITIAL_CAPACITY 16
+
+// Epochs are handed out process-wide so a chunk shared between VMs (module
+// chunks, pooled VMs) never mistakes another table's slot for its own
+static uint32_t next_globals_epoch = 0;
+
+static uint32_t allocate_globals_epoch(void) {
+    uint32_t epoch;
+    do {
+        epoch = __sync_add_and_fetch(&next_globals_epoch, 1);
+    } while (epoch == 0);
+    return epoch;
+}
+
+static int global_index_probe(ember_vm* vm, const char* name, int length, uint32_t hash) {
+    int mask = vm->global_index_capacity - 1;
+    int index = (int)(hash & (uint32_t)mask);
+
+    for (;;) {
+        int entry = vm->global_index[index];
+        if (entry == 0) return -1;
+
+        struct ember_global* global = &vm->globals[entry - 1];
+        if (global->hash == hash && strncmp(global->key, name, length) == 0 &&
+            global->key[length] == '\0') {
+            return entry - 1;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+static void global_index_insert(int* index_table, int capacity, uint32_t hash, int slot) {
+    int mask = capacity - 1;
+    int index = (int)(hash & (uint32_t)mask);
+    while (index_table[index] != 0) {
+        index = (index + 1) & mask;
+    }
+    index_table[index] = slot + 1;
+}
+
+// Make room for one more global, keeping the index at most half full
+static int globals_reserve(ember_vm* vm) {
+    if (vm->globals_epoch == 0) {
+        vm->globals_epoch = allocate_globals_epoch();
+    }
+
+    if (vm->global_count >= vm->global_capacity) {
+        int new_capacity = vm->global_capacity < GLOBALS_INITIAL_CAPACITY ?
+                           GLOBALS_INITIAL_CAPACITY : vm->global_capacity * 2;
+        struct ember_global* globals = realloc(vm->globals, sizeof(struct ember_global) * new_capacity);
+        if (!globals) {
+            fprintf(stderr, "[SECURITY] Failed to grow global variable table\n");
+            return 0;
+        }
+        vm->globals = globals;
+        vm->global_capacity = new_capacity;
+    }
+
+    if ((vm->global_count + 1) * 2 > vm->global_index_capacity) {
+        int new_capacity = vm->global_index_capacity < GLOBALS_INITIAL_CAPACITY * 2 ?
+                           GLOBALS_INITIAL_CAPACITY * 2 : vm->global_index_capacity * 2;
+        int* index_table = calloc(new_capacity, sizeof(int));
+        if (!index_table) {
+            fprintf(stderr, "[SECURITY] Failed to grow global variable index\n");
+            return 0;
+        }
+        for (int i = 0; i < vm->global_count; i++) {
+            global_index_insert(index_table, new_capacity, vm->globals[i].hash, i);
+        }
+        free(vm->global_index);
+        vm->global_index = index_table;
+        vm->global_index_capacity = new_capacity;
+    }
+    return 1;
+}
+
+// Probe for name; with lazy stdlib loading a builtin is bound on its first miss
+static int global_lookup(ember_vm* vm, const char* name, int length, uint32_t hash) {
+    int slot = vm->global_index_capacity > 0 ? global_index_probe(vm, name, length, hash) : -1;
+    if (slot < 0 && vm->lazy_stdlib_loading && !vm->stdlib_initialized &&
+        ember_builtin_bind(vm, name, length)) {
+        slot = global_index_probe(vm, name, length, hash);
+    }
+    return slot;
+}
+
+// Slot of the global called name[0..length), or -1 if it is not defined
+int ember_global_find(ember_vm* vm, const char* name, int length) {
+    if (!vm || !name || length < 0) return -1;
+    return global_lookup(vm, name, length, hash_string_chars(name, length));
+}
+
+static int global_define_hashed(ember_vm* vm, const char* name, int length, uint32_t hash, ember_value value) {
+    if (vm->global_index_capacity > 0) {
+        int slot = global_index_probe(vm, name, length, hash);
+        if (slot >= 0) {
+            // Redefinition reuses the slot, so cached sites stay valid
+            vm->globals[slot].value = value;
+            return slot;
+        }
+    }
+
+    if (!globals_reserve(vm)) return -1;
+
+    char* key = malloc(length + 1);
+    if (!key) {
+        fprintf(stderr, "[SECURITY] Failed to allocate global variable name\n");
+        return -1;
+    }
+    memcpy(key, name, length);
+    key[length] = '\0';
+
+    int slot = vm->global_count++;
+    vm->globals[slot].key = key;
+    vm->globals[slot].value = value;
+    vm->globals[slot].hash = hash;
+    global_index_insert(vm->global_index, vm->global_index_capacity, hash, slot);
+    return slot;
+}
+
+// Define or overwrite a global; the name is copied. Returns the slot, or -1 on failure
+int ember_global_define(ember_vm* vm, const char* name, ember_value value) {
+    if (!vm || !name) return -1;
+    int length = (int)strlen(name);
+    return global_define_hashed(vm, name, length, hash_string_chars(name, length), value);
+}
+
+void ember_globals_free(ember_vm* vm) {
+    if (!vm) return;
+    for (int i = 0; i < vm->global_count; i++) {
+        free(vm->globals[i].key);
+    }
+    free(vm->globals);
+    free(vm->global_index);
+    vm->globals = NULL;
+    vm->global_count = 0;
+    vm->global_capacity = 0;
+    vm->global_index = NULL;
+    vm->global_index_capacity = 0;
+    // Any slot cached against the old table is now stale
+    vm->globals_epoch = 0;
+}
+
+void ember_chunk_free_global_cache(ember_chunk* chunk) {
+    if (!chunk) return;
+    free(chunk->global_cache);
+    chunk->global_cache = NULL;
+    chunk->global_cache_count = 0;
+    free(chunk->property_cache);
+    chunk->property_cache = NULL;
+    chunk->property_cache_count = 0;
+    ember_chunk_free_feedback(chunk);
+    ember_chunk_free_lines(chunk);
+    ember_chunk_free_lazy_body(chunk);
+    free(chunk->name);
+    chunk->name = NULL;
+}
+
+static ember_global_cache* global_cache_entry(ember_chunk* chunk, int constant) {
+    if (constant >= chunk->global_cache_count) {
+        // Sized to the constant pool so a growing chunk (REPL) re-allocates rarely
+        int new_count = chunk->const_capacity > constant ? chunk->const_capacity : constant + 1;
+        ember_global_cache* cache = realloc(chunk->global_cache, sizeof(ember_global_cache) * new_count);
+        if (!cache) return NULL;
+        memset(cache + chunk->global_cache_count, 0,
+               sizeof(ember_global_cache) * (new_count - chunk->global_cache_count));
+        chunk->global_cache = cache;
+        chunk->global_cache_count = new_count;
+    }
+    return &chunk->global_cache[constant];
+}
+
+static ember_string* global_name_constant(ember_vm* vm, ember_chunk* chunk, int constant) {
+    if (!chunk || constant < 0 || constant >= chunk->const_count) {
+        ember_error* error = ember_error_runtime(vm, "Invalid global variable name constant");
+        ember_vm_set_error(vm, error);
+        return NULL;
+    }
+    ember_value name_val = chunk->constants[constant];
+    if (name_val.type != EMBER_VAL_STRING || !name_val.as.obj_val) {
+        ember_error* error = ember_error_runtime(vm, "Global variable name must be a string");
+        ember_vm_set_error(vm, error);
+        return NULL;
+    }
+    ember_string* name = AS_STRING(name_val);
+    ember_string_flatten(name);
+    return name;
+}
+
+// VM operation handler for OP_GET_GLOBAL: after the first hit the site reads
+// its slot straight from the chunk's inline cache
+vm_operation_result vm_handle_get_global(ember_vm* vm, ember_chunk* chunk, int constant) {
+    if (vm->stack_top >= EMBER_STACK_MAX) {
+        ember_error* error = ember_error_runtime(vm, "Stack overflow reading global variable");
+        ember_vm_set_error(vm, error);
+        return VM_RESULT_ERROR;
+    }
+
+    ember_global_cache* cache = constant >= 0 && constant < chunk->global_cache_count ?
+                                &chunk->global_cache[constant] : NULL;
+    if (cache && cache->epoch == vm->globals_epoch && vm->globals_epoch != 0) {
+        vm->stack[vm->stack_top++] = vm->globals[cache->slot].value;
+        return VM_RESULT_OK;
+    }
+
+    ember_string* name = global_name_constant(vm, chunk, constant);
+    if (!name) return VM_RESULT_ERROR;
+
+    int slot = global_lookup(vm, name->chars, name->length, name->hash);
+    if (slot < 0 && vm->stdlib_pending && ember_stdlib_resolve_global(vm, name->chars, name->length)) {
+        // A lazily initialized stdlib module defines it
+        slot = global_lookup(vm, name->chars, name->length, name->hash);
+    }
+    if (slot < 0) {
+        char message[256];
+        snprintf(message, sizeof(message), "Undefined variable '%.*s'", name->length, name->chars);
+        ember_error* error = ember_error_runtime(vm, message);
+        ember_vm_set_error(vm, error);
+        return VM_RESULT_ERROR;
+    }
+
+    // Only hits are cached: a miss may be defined later under a new slot
+    cache = global_cache_entry(chunk, constant);
+    if (cache) {
+        cache->epoch = vm->globals_epoch;
+        cache->slot = slot;
+    }
+    vm->stack[vm->stack_top++] = vm->globals[slot].value;
+    return VM_RESULT_OK;
+}
+
+// VM operation handler for OP_SET_GLOBAL: defines the name on first
+// assignment; the assigned value stays on the stack
+vm_operation_result vm_handle_set_global(ember_vm* vm, ember_chunk* chunk, int constant) {
+    if (vm->stack_top < 1) {
+        ember_error* error = ember_error_runtime(vm, "Stack underflow in global assignment");
+        ember_vm_set_error(vm, error);
+        return VM_RESULT_ERROR;
+    }
+    ember_value value = vm->stack[vm->stack_top - 1];
+
+    ember_global_cache* cache = constant >= 0 && constant < chunk->global_cache_count ?
+                                &chunk->global_cache[constant] : NULL;
+    if (cache && cache->epoch == vm->globals_epoch && vm->globals_epoch != 0) {
+        vm->globals[cache->slot].value = value;
+        return VM_RESULT_OK;
+    }
+
+    ember_string* name = global_name_constant(vm, chunk, constant);
+    if (!name) return VM_RESULT_ERROR;
+
+    int slot = global_define_hashed(vm, name->chars, name->length, name->hash, value);
+    if (slot < 0) {
+        ember_error* error = ember_error_runtime(vm, "Failed to define global variable");
+        ember_vm_set_error(vm, error);
+        return VM_RESULT_ERROR;
+    }
+
+    cache = global_cache_entry(chunk, constant);
+    if (cache) {
+        cache->epoch = vm->globals_epoch;
+        cache->slot = slot;
+    }
+    return VM_RESULT_OK;
+}
@@ -0,0 +1,97 @@
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "../runtime/value/value.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Flattened method tables. Each class keeps klass->methods (what it defines
+// itself) and, once a method is looked up on it, klass->method_cache: every
+// method it responds to, inherited ones included, so a lookup is one probe
+// however deep the superclass chain is. Defining a method or changing a
+// superclass bumps vm->method_epoch, which invalidates every cache at once;
+// those happen while classes are being declared, calls come later.
+
+#define EMBER_CLASS_MAX_DEPTH 256   // Longest superclass chain
+
+static void copy_methods(ember_vm* vm, ember_hash_map* cache, ember_hash_map* methods) {
+    if (!methods) return;
+    for (int i = 0; i < methods->capacity; i++) {
+        if (methods->entries[i].is_occupied) {
+            hash_map_set_with_vm(vm, cache, methods->entries[i].key, methods->entries[i].value);
+        }
+    }
+}
+
+// Ancestors first, so subclasses override what they inherit
+static ember_hash_map* build_method_cache(ember_vm* vm, ember_class* klass) {
+    ember_class* chain[EMBER_CLASS_MAX_DEPTH];
+    int depth = 0;
+    int total = 0;
+    for (ember_class* c = klass; c && depth < EMBER_CLASS_MAX_DEPTH; c = (ember_class*)c->superclass) {
+        chain[depth++] = c;
+        total += c->methods ? c->methods->length : 0;
+    }
+
+    // The chain stays reachable through klass while the copies allocate
+    ember_hash_map* cache = allocate_hash_map(vm, total > 4 ? total * 2 : 8);
+    if (!cache) return NULL;
+    ember_value table;
+    table.type = EMBER_VAL_HASH_MAP;
+    table.as.obj_val = (ember_object*)cache;
+    gc_write_barrier_helper(vm, (ember_object*)klass, ember_make_nil(), table);
+    klass->method_cache = cache;
+    klass->method_cache_epoch = vm->method_epoch;
+    for (int i = depth - 1; i >= 0; i--) {
+        copy_methods(vm, cache, chain[i]->methods);
+    }
+    return cache;
+}
+
+ember_value ember_class_find_method(ember_vm* vm, ember_class* klass, ember_value name) {
+    if (!klass || name.type != EMBER_VAL_STRING) return ember_make_nil();
+    ember_hash_map* cache = klass->method_cache;
+    if (!vm || !cache || klass->method_cache_epoch != vm->method_epoch) {
+        cache = vm ? build_method_cache(vm, klass) : NULL;
+    }
+    if (cache) {
+        return cache->length > 0 ? hash_map_get(cache, name) : ember_make_nil();
+    }
+
+    // Out of memory: walk the chain
+    for (; klass; klass = (ember_class*)klass->superclass) {
+        if (klass->methods && klass->methods->length > 0) {
+            ember_value method = hash_map_get(klass->methods, name);
+            if (method.type != EMBER_VAL_NIL) return method;
+        }
+    }
+    return ember_make_nil();
+}
+
+int ember_class_define_method(ember_vm* vm, ember_class* klass, ember_value name, ember_value method) {
+    if (!vm || !klass || !klass->methods || name.type != EMBER_VAL_STRING) return 0;
+    hash_map_set_with_vm(vm, klass->methods, name, method);
+    vm->method_epoch++;
+    return 1;
+}
+
+int ember_class_inherit(ember_vm* vm, ember_class* klass, ember_class* superclass) {
+    if (!vm || !klass) return 0;
+    int depth = 0;
+    for (ember_class* c = superclass; c; c = (ember_class*)c->superclass) {
+        if (c == klass || ++depth >= EMBER_CLASS_MAX_DEPTH) {
+            fprintf(stderr, "[CLASS] Invalid superclass for '%s'\n",
+                    klass->name ? klass->name->chars : "?");
+            return 0;
+        }
+    }
+    if (superclass) {
+        ember_value parent;
+        parent.type = EMBER_VAL_CLASS;
+        parent.as.obj_val = (ember_object*)superclass;
+        gc_write_barrier_helper(vm, (ember_object*)klass, ember_make_nil(), parent);
+    }
+    klass->superclass = (struct ember_class*)superclass;
+    vm->method_epoch++;
+    return 1;
+}
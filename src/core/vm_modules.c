@@ -0,0 +1,209 @@
+#define _GNU_SOURCE
+#include "../../include/ember.h"
+#include "../runtime/value/value.h"
+#include "../runtime/module_image.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Module registry. Modules are allocated one at a time and listed in
+// vm->modules in load order, with an open-addressed index by name beside it,
+// so lookups are one probe and the VM itself carries only pointers. Each
+// module's exports are a growable slot array indexed the same way; a named
+// import resolves its key to a slot once and reads the slot afterwards.
+
+#define MODULES_INITIAL_CAPACITY 8
+#define EXPORTS_INITIAL_CAPACITY 8
+
+static void index_insert(int* index_table, int capacity, uint32_t hash, int slot) {
+    int mask = capacity - 1;
+    int index = (int)(hash & (uint32_t)mask);
+    while (index_table[index] != 0) {
+        index = (index + 1) & mask;
+    }
+    index_table[index] = slot + 1;
+}
+
+static int module_probe(ember_vm* vm, const char* name, uint32_t hash) {
+    int mask = vm->module_index_capacity - 1;
+    int index = (int)(hash & (uint32_t)mask);
+    for (;;) {
+        int entry = vm->module_index[index];
+        if (entry == 0) return -1;
+        ember_module* module = vm->modules[entry - 1];
+        if (module->hash == hash && strcmp(module->name, name) == 0) {
+            return entry - 1;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+ember_module* ember_module_find(ember_vm* vm, const char* name) {
+    if (!vm || !name || vm->module_index_capacity == 0) return NULL;
+    int slot = module_probe(vm, name, hash_string_chars(name, (int)strlen(name)));
+    return slot >= 0 ? vm->modules[slot] : NULL;
+}
+
+// Make room for one more module, keeping the index at most half full
+static int modules_reserve(ember_vm* vm) {
+    if (vm->module_count >= vm->module_capacity) {
+        int new_capacity = vm->module_capacity < MODULES_INITIAL_CAPACITY ?
+                           MODULES_INITIAL_CAPACITY : vm->module_capacity * 2;
+        ember_module** modules = realloc(vm->modules, sizeof(ember_module*) * (size_t)new_capacity);
+        if (!modules) {
+            fprintf(stderr, "[MODULE] Failed to grow module registry\n");
+            return 0;
+        }
+        vm->modules = modules;
+        vm->module_capacity = new_capacity;
+    }
+
+    if ((vm->module_count + 1) * 2 > vm->module_index_capacity) {
+        int new_capacity = vm->module_index_capacity < MODULES_INITIAL_CAPACITY * 2 ?
+                           MODULES_INITIAL_CAPACITY * 2 : vm->module_index_capacity * 2;
+        int* index_table = calloc((size_t)new_capacity, sizeof(int));
+        if (!index_table) {
+            fprintf(stderr, "[MODULE] Failed to grow module registry index\n");
+            return 0;
+        }
+        for (int i = 0; i < vm->module_count; i++) {
+            index_insert(index_table, new_capacity, vm->modules[i]->hash, i);
+        }
+        free(vm->module_index);
+        vm->module_index = index_table;
+        vm->module_index_capacity = new_capacity;
+    }
+    return 1;
+}
+
+ember_module* ember_module_add(ember_vm* vm, const char* name) {
+    if (!vm || !name) return NULL;
+    uint32_t hash = hash_string_chars(name, (int)strlen(name));
+    if (vm->module_index_capacity > 0) {
+        int slot = module_probe(vm, name, hash);
+        if (slot >= 0) return vm->modules[slot];
+    }
+    if (!modules_reserve(vm)) return NULL;
+
+    ember_module* module = calloc(1, sizeof(ember_module));
+    if (!module) {
+        fprintf(stderr, "[MODULE] Failed to allocate module entry\n");
+        return NULL;
+    }
+    module->name = strdup(name);
+    if (!module->name) {
+        fprintf(stderr, "[MODULE] Failed to allocate module entry\n");
+        free(module);
+        return NULL;
+    }
+    module->hash = hash;
+
+    int slot = vm->module_count++;
+    vm->modules[slot] = module;
+    index_insert(vm->module_index, vm->module_index_capacity, hash, slot);
+    return module;
+}
+
+static int export_probe(ember_module* module, const char* key, int length, uint32_t hash) {
+    int mask = module->export_index_capacity - 1;
+    int index = (int)(hash & (uint32_t)mask);
+    for (;;) {
+        int entry = module->export_index[index];
+        if (entry == 0) return -1;
+        ember_module_export_slot* slot = &module->exports[entry - 1];
+        if (slot->hash == hash && strncmp(slot->key, key, (size_t)length) == 0 &&
+            slot->key[length] == '\0') {
+            return entry - 1;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+int ember_module_export_find(ember_module* module, const char* key, int length) {
+    if (!module || !key || length < 0 || module->export_index_capacity == 0) return -1;
+    return export_probe(module, key, length, hash_string_chars(key, length));
+}
+
+static int exports_reserve(ember_module* module) {
+    if (module->export_count >= module->export_capacity) {
+        int new_capacity = module->export_capacity < EXPORTS_INITIAL_CAPACITY ?
+                           EXPORTS_INITIAL_CAPACITY : module->export_capacity * 2;
+        ember_module_export_slot* exports = realloc(module->exports,
+                                                    sizeof(ember_module_export_slot) * (size_t)new_capacity);
+        if (!exports) {
+            fprintf(stderr, "[MODULE] Failed to grow export table of %s\n", module->name);
+            return 0;
+        }
+        module->exports = exports;
+        module->export_capacity = new_capacity;
+    }
+
+    if ((module->export_count + 1) * 2 > module->export_index_capacity) {
+        int new_capacity = module->export_index_capacity < EXPORTS_INITIAL_CAPACITY * 2 ?
+                           EXPORTS_INITIAL_CAPACITY * 2 : module->export_index_capacity * 2;
+        int* index_table = calloc((size_t)new_capacity, sizeof(int));
+        if (!index_table) {
+            fprintf(stderr, "[MODULE] Failed to grow export index of %s\n", module->name);
+            return 0;
+        }
+        for (int i = 0; i < module->export_count; i++) {
+            index_insert(index_table, new_capacity, module->exports[i].hash, i);
+        }
+        free(module->export_index);
+        module->export_index = index_table;
+        module->export_index_capacity = new_capacity;
+    }
+    return 1;
+}
+
+int ember_module_export_define(ember_module* module, const char* key, ember_value value) {
+    if (!module || !key) return -1;
+    int length = (int)strlen(key);
+    uint32_t hash = hash_string_chars(key, length);
+    if (module->export_index_capacity > 0) {
+        int slot = export_probe(module, key, length, hash);
+        if (slot >= 0) {
+            // Re-export keeps the slot, so resolved imports stay valid
+            module->exports[slot].value = value;
+            return slot;
+        }
+    }
+    if (!exports_reserve(module)) return -1;
+
+    char* copy = malloc((size_t)length + 1);
+    if (!copy) {
+        fprintf(stderr, "[MODULE] Failed to allocate export name\n");
+        return -1;
+    }
+    memcpy(copy, key, (size_t)length + 1);
+
+    int slot = module->export_count++;
+    module->exports[slot].key = copy;
+    module->exports[slot].value = value;
+    module->exports[slot].hash = hash;
+    index_insert(module->export_index, module->export_index_capacity, hash, slot);
+    return slot;
+}
+
+void ember_modules_free(ember_vm* vm) {
+    if (!vm) return;
+    for (int i = 0; i < vm->module_count; i++) {
+        ember_module* module = vm->modules[i];
+        for (int j = 0; j < module->export_count; j++) {
+            free(module->exports[j].key);
+        }
+        free(module->exports);
+        free(module->export_index);
+        ember_module_image_release(module->image);
+        free(module->name);
+        free(module->path);
+        free(module);
+    }
+    free(vm->modules);
+    free(vm->module_index);
+    vm->modules = NULL;
+    vm->module_count = 0;
+    vm->module_capacity = 0;
+    vm->module_index = NULL;
+    vm->module_index_capacity = 0;
+}
@@ -0,0 +1,108 @@
+#include "../../include/ember.h"
+#include "../vm.h"
+#include <stdlib.h>
+#include <stdint.h>
+
+// Described natives. A VM keeps the ember_native_info of each native
+// registered with ember_register_native in an open-addressed table keyed by
+// the function pointer, which vm_handle_call probes on every native call
+// once the table exists. Natives bound with ember_register_func have no
+// entry and are called exactly as before.
+
+#define NATIVE_TABLE_MIN 16
+
+typedef struct {
+    ember_native_func func;     // NULL = empty
+    ember_native_info info;
+} native_entry;
+
+typedef struct ember_native_table {
+    native_entry* entries;
+    int count;
+    int capacity;               // Power of two
+} ember_native_table;
+
+static uint32_t native_hash(ember_native_func func) {
+    uint64_t key = (uint64_t)(uintptr_t)func;
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+static native_entry* table_find(ember_native_table* table, ember_native_func func) {
+    uint32_t mask = (uint32_t)table->capacity - 1;
+    for (uint32_t i = native_hash(func) & mask;; i = (i + 1) & mask) {
+        native_entry* entry = &table->entries[i];
+        if (entry->func == func || !entry->func) return entry;
+    }
+}
+
+static int table_grow(ember_native_table* table) {
+    int capacity = table->capacity ? table->capacity * 2 : NATIVE_TABLE_MIN;
+    native_entry* entries = calloc((size_t)capacity, sizeof(native_entry));
+    if (!entries) return 0;
+    native_entry* old = table->entries;
+    int old_capacity = table->capacity;
+    table->entries = entries;
+    table->capacity = capacity;
+    for (int i = 0; i < old_capacity; i++) {
+        if (old[i].func) *table_find(table, old[i].func) = old[i];
+    }
+    free(old);
+    return 1;
+}
+
+static int info_valid(const ember_native_info* info) {
+    if (!info || !info->func) return 0;
+    if (info->min_args < 0 || info->min_args > EMBER_MAX_ARGS) return 0;
+    if (info->max_args != EMBER_NATIVE_VARIADIC &&
+        (info->max_args < info->min_args || info->max_args > EMBER_MAX_ARGS)) return 0;
+    uint32_t known = EMBER_NATIVE_PURE | EMBER_NATIVE_NO_GC | EMBER_NATIVE_NO_THROW | EMBER_NATIVE_ROPES;
+    return (info->flags & ~known) == 0;
+}
+
+int ember_register_native(ember_vm* vm, const char* name, const ember_native_info* info) {
+    if (!vm || !name || !info_valid(info)) return -1;
+    ember_native_table* table = vm->native_table;
+    if (!table) {
+        table = calloc(1, sizeof(ember_native_table));
+        if (!table) return -1;
+        vm->native_table = table;
+    }
+    // At most half full, so probes stay short and always end
+    if ((table->count + 1) * 2 > table->capacity && !table_grow(table)) return -1;
+    native_entry* entry = table_find(table, info->func);
+    if (!entry->func) table->count++;
+    entry->func = info->func;
+    entry->info = *info;
+    ember_register_func(vm, name, info->func);
+    return 0;
+}
+
+const ember_native_info* vm_native_info(ember_vm* vm, ember_native_func func) {
+    ember_native_table* table = vm->native_table;
+    if (!table || !table->count) return NULL;
+    native_entry* entry = table_find(table, func);
+    return entry->func ? &entry->info : NULL;
+}
+
+const ember_native_info* ember_native_describe(ember_vm* vm, ember_native_func func) {
+    if (!vm || !func) return NULL;
+    return vm_native_info(vm, func);
+}
+
+int vm_native_args_match(const ember_native_info* info, int argc, const ember_value* argv) {
+    if (argc < info->min_args) return 0;
+    if (info->max_args != EMBER_NATIVE_VARIADIC && argc > info->max_args) return 0;
+    int typed = argc < EMBER_NATIVE_TYPED_ARGS ? argc : EMBER_NATIVE_TYPED_ARGS;
+    for (int i = 0; i < typed; i++) {
+        uint32_t mask = info->arg_types[i];
+        if (mask && !(mask & EMBER_TYPE_MASK(argv[i].type))) return 0;
+    }
+    return 1;
+}
+
+void native_table_free(ember_vm* vm) {
+    if (!vm || !vm->native_table) return;
+    free(vm->native_table->entries);
+    free(vm->native_table);
+    vm->native_table = NULL;
+}
@@ -0,0 +1,74 @@
+#include "../../include/ember.h"
+#include "../vm.h"
+
+// On-stack replacement. Call-triggered optimization never reaches a loop
+// that runs for the whole life of its function, and a top-level `while` in
+// a batch script is never called at all. OP_LOOP therefore counts back
+// edges in the innermost ember_runtime_loop_context (vm_push_loop_context
+// starts every loop at zero). Once one loop activation passes
+// vm->osr_threshold, its chunk is switched to optimized code while the loop
+// keeps running:
+//
+//   - Quickening: type feedback is recorded for the chunk's next
+//     OSR_PROFILE_BACK_EDGES iterations, even with vm->type_feedback off.
+//     Monomorphic sites are rewritten in place (vm_quicken.c), so the
+//     running frame picks them up on its next iteration; no frame state
+//     has to be translated.
+//   - JIT: with the JIT enabled, the chunk is made due for compilation and
+//     the same back edge enters native code at the loop header, with the
+//     loop's locals and stack as they are.
+//
+// Each chunk is profiled once; a loop that goes hot again in a later
+// activation only re-enters the JIT.
+
+#define OSR_DEFAULT_THRESHOLD 500
+// Iterations profiled after a loop goes hot; quickening needs 16 hits a site
+#define OSR_PROFILE_BACK_EDGES 64
+
+// The loop OP_LOOP just jumped back to, if its context is being tracked
+static ember_runtime_loop_context* current_loop(ember_vm* vm) {
+    ember_runtime_loop_context* loop = vm_get_current_loop_context(vm);
+    return loop && loop->loop_start == vm->ip ? loop : NULL;
+}
+
+static void loop_hot(ember_vm* vm, ember_chunk* chunk) {
+    vm->osr_entries++;
+    if (!chunk->osr_profiled && !chunk->code_borrowed) {
+        chunk->osr_profiled = 1;
+        chunk->osr_profile_budget = OSR_PROFILE_BACK_EDGES;
+    }
+    if (vm->jit_enabled && !chunk->jit_code && chunk->jit_counter < UINT32_MAX - 1) {
+        // Due whatever the threshold: vm_jit_on_loop counts this back edge
+        // and compiles
+        chunk->jit_counter = UINT32_MAX - 1;
+    }
+}
+
+vm_operation_result vm_osr_back_edge(ember_vm* vm) {
+    if (--vm->fuel < 0) {
+        const uint8_t* ip = vm->ip;
+        vm_operation_result fuel = vm_fuel_exhausted(vm);
+        // A TimeoutError left the loop: uncaught, or for a handler's ip
+        if (fuel != VM_RESULT_OK || vm->ip != ip) return fuel;
+    }
+    ember_chunk* chunk = vm->chunk;
+    if (!chunk) return VM_RESULT_OK;
+    if (chunk->osr_profile_budget > 0) chunk->osr_profile_budget--;
+
+    if (!vm->osr_disabled) {
+        ember_runtime_loop_context* loop = current_loop(vm);
+        uint32_t threshold = vm->osr_threshold ? vm->osr_threshold : OSR_DEFAULT_THRESHOLD;
+        if (loop && loop->back_edges < UINT32_MAX && ++loop->back_edges == threshold) {
+            loop_hot(vm, chunk);
+        }
+    }
+    vm_jit_on_loop(vm);
+    return VM_RESULT_OK;
+}
+
+int ember_vm_configure_osr(ember_vm* vm, int enabled, int threshold) {
+    if (!vm || threshold < 0) return EMBER_ERROR_INVALID_PARAMETER;
+    vm->osr_disabled = enabled ? false : true;
+    vm->osr_threshold = (uint32_t)threshold;
+    return EMBER_SUCCESS;
+}
@@ -0,0 +1,648 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "../runtime/module_prefetch.h"
+#include "probes.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+
+// VM pool behind ember_pool_*. Idle VMs sit in a fixed array of slots that
+// are threaded onto two lock-free stacks: one of slots holding an idle VM,
+// one of empty slots. A stack head packs the top slot index with a version
+// that every push and pop bumps, so a slot popped and pushed back between a
+// reader's load and its compare-and-swap fails the swap (no ABA).
+//
+// In front of the shared stacks each thread keeps a small cache of idle VMs
+// (thread_cache_size of them), which get and release use without any
+// atomic read-modify-write. The cache also carries the thread's rate limit
+// token bucket, its count of checked-out VMs and its share of the pool
+// statistics, so the per-thread limits and the counters never touch shared
+// memory; ember_pool_stats sums the caches when asked. A VM remembers the cache it was handed out from in
+// vm->vm_pool_context, and a release on another thread still credits that
+// cache. The optional pool-wide limit is one atomic word (window number and
+// allocations left in it), from which each thread leases POOL_LEASE_BATCH
+// allocations at a time, so most gets do not touch it either. Caches are never freed: a thread's cache is flushed to the shared
+// stack when the thread exits and is then reused by the next new thread.
+//
+// ember_pool_init, ember_pool_cleanup and ember_pool_set_snapshot must not
+// race with gets or releases.
+
+// Security validation constants
+#define MIN_POOL_SIZE 1
+#define MAX_POOL_SIZE 1000
+#define MIN_CHUNK_SIZE 1
+#define MAX_CHUNK_SIZE 100
+#define MIN_THREAD_CACHE 1
+#define MAX_THREAD_CACHE 100
+#define MIN_VMS_PER_THREAD 1
+#define MAX_VMS_PER_THREAD 100
+#define MIN_RATE_LIMIT_WINDOW 100
+#define MAX_RATE_LIMIT_WINDOW 86400000
+#define MIN_RATE_LIMIT_ALLOCS 1
+#define MAX_RATE_LIMIT_ALLOCS 10000
+#define MAX_GLOBAL_RATE_LIMIT_ALLOCS 1000000
+
+// Pool-wide allocations a thread takes from the shared budget at once
+#define POOL_LEASE_BATCH 8
+
+#define SLOT_NONE UINT32_MAX
+
+typedef struct pool_thread_cache {
+    ember_vm* vms[MAX_THREAD_CACHE];
+    uint32_t count;
+    uint32_t active;                   // Checked out from this cache; atomic, a release may come from another thread
+    uint64_t tokens;                   // Rate limit bucket, in allocations * rate_limit_window_ms
+    uint64_t refilled_at;              // Time of the last refill, ms
+    uint32_t lease;                    // Pool-wide allocations taken but not yet used
+    uint32_t lease_window;             // The pool-wide window the lease belongs to
+    vm_pool_stats_t stats;             // Written by the owning thread only
+    bool in_use;                       // Owned by a live thread
+    struct pool_thread_cache* next;    // All caches, for cleanup
+} pool_thread_cache;
+
+typedef struct {
+    ember_vm* vm;
+    uint32_t next;                     // Slot below this one on its stack
+} pool_slot;
+
+static pool_slot* slots = NULL;
+static uint64_t idle_head = 0;         // (version << 32) | top slot index
+static uint64_t empty_head = 0;
+static uint64_t global_budget = 0;     // (window number << 32) | pool-wide allocations left
+static vm_pool_config_t pool_config = {0};
+static bool pool_initialized = false;
+static uint64_t pool_generation = 0;   // Bumped by init and cleanup; stale thread caches re-register
+static ember_vm_snapshot* pool_snapshot = NULL;  // Source of fresh pool VMs, or NULL
+
+static pthread_mutex_t caches_lock = PTHREAD_MUTEX_INITIALIZER;
+static pool_thread_cache* caches = NULL;
+static pthread_key_t cache_key;
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+
+static __thread pool_thread_cache* thread_cache = NULL;
+static __thread uint64_t thread_cache_generation = 0;
+
+// Default secure configuration
+static const vm_pool_config_t DEFAULT_SECURE_CONFIG = {
+    .initial_size = 16,
+    .chunk_size = 8,
+    .thread_cache_size = 4,
+    .max_vms_per_thread = 10,
+    .rate_limit_window_ms = 1000,
+    .rate_limit_max_allocs = 50,
+    .rate_limit_global_allocs = 0
+};
+
+// Get current timestamp in milliseconds
+static uint64_t get_current_time_ms(void) {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        return 0;  // Return 0 on error (security: don't leak system details)
+    }
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Secure configuration validation
+static int validate_pool_config(const vm_pool_config_t* config) {
+    if (!config) {
+        return EMBER_ERROR_INVALID_PARAMETER;
+    }
+
+    // Check all parameters are within safe bounds
+    if (config->initial_size < MIN_POOL_SIZE || config->initial_size > MAX_POOL_SIZE) {
+        return EMBER_ERROR_INVALID_PARAMETER;
+    }
+
+    if (config->chunk_size < MIN_CHUNK_SIZE || config->chunk_size > MAX_CHUNK_SIZE) {
+        return EMBER_ERROR_INVALID_PARAMETER;
+    }
+
+    if (config->thread_cache_size < MIN_THREAD_CACHE || config->thread_cache_size > MAX_THREAD_CACHE) {
+        return EMBER_ERROR_INVALID_PARAMETER;
+    }
+
+    if (config->max_vms_per_thread < MIN_VMS_PER_THREAD || config->max_vms_per_thread > MAX_VMS_PER_THREAD) {
+        return EMBER_ERROR_INVALID_PARAMETER;
+    }
+
+    if (config->rate_limit_window_ms < MIN_RATE_LIMIT_WINDOW || config->rate_limit_window_ms > MAX_RATE_LIMIT_WINDOW) {
+        return EMBER_ERROR_INVALID_PARAMETER;
+    }
+
+    if (config->rate_limit_max_allocs < MIN_RATE_LIMIT_ALLOCS || config->rate_limit_max_allocs > MAX_RATE_LIMIT_ALLOCS) {
+        return EMBER_ERROR_INVALID_PARAMETER;
+    }
+
+    // Zero leaves the pool without a pool-wide limit
+    if (config->rate_limit_global_allocs > MAX_GLOBAL_RATE_LIMIT_ALLOCS) {
+        return EMBER_ERROR_INVALID_PARAMETER;
+    }
+
+    // Check for integer overflow potential
+    if (config->initial_size > UINT32_MAX / sizeof(pool_slot)) {
+        return EMBER_ERROR_SECURITY_VIOLATION;
+    }
+
+    return EMBER_SUCCESS;
+}
+
+// Apply secure defaults only for zero values (preserving invalid values for validation)
+static void apply_secure_defaults(vm_pool_config_t* config) {
+    if (!config) return;
+
+    // Apply defaults only for zero values - let validation catch invalid ones
+    if (config->initial_size == 0) {
+        config->initial_size = DEFAULT_SECURE_CONFIG.initial_size;
+    }
+
+    if (config->chunk_size == 0) {
+        config->chunk_size = DEFAULT_SECURE_CONFIG.chunk_size;
+    }
+
+    if (config->thread_cache_size == 0) {
+        config->thread_cache_size = DEFAULT_SECURE_CONFIG.thread_cache_size;
+    }
+
+    if (config->max_vms_per_thread == 0) {
+        config->max_vms_per_thread = DEFAULT_SECURE_CONFIG.max_vms_per_thread;
+    }
+
+    if (config->rate_limit_window_ms == 0) {
+        config->rate_limit_window_ms = DEFAULT_SECURE_CONFIG.rate_limit_window_ms;
+    }
+
+    if (config->rate_limit_max_allocs == 0) {
+        config->rate_limit_max_allocs = DEFAULT_SECURE_CONFIG.rate_limit_max_allocs;
+    }
+}
+
+// ============================================================================
+// LOCK-FREE SLOT STACKS
+// ============================================================================
+
+static uint32_t stack_pop(uint64_t* head) {
+    uint64_t old = __atomic_load_n(head, __ATOMIC_ACQUIRE);
+    for (;;) {
+        uint32_t top = (uint32_t)old;
+        if (top == SLOT_NONE) {
+            return SLOT_NONE;
+        }
+        // A stale next is harmless: the version check below rejects it
+        uint32_t next = __atomic_load_n(&slots[top].next, __ATOMIC_RELAXED);
+        uint64_t desired = ((old >> 32) + 1) << 32 | next;
+        if (__atomic_compare_exchange_n(head, &old, desired, true,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return top;
+        }
+    }
+}
+
+static void stack_push(uint64_t* head, uint32_t index) {
+    uint64_t old = __atomic_load_n(head, __ATOMIC_RELAXED);
+    for (;;) {
+        __atomic_store_n(&slots[index].next, (uint32_t)old, __ATOMIC_RELAXED);
+        uint64_t desired = ((old >> 32) + 1) << 32 | index;
+        if (__atomic_compare_exchange_n(head, &old, desired, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            return;
+        }
+    }
+}
+
+static ember_vm* shared_take(void) {
+    uint32_t index = stack_pop(&idle_head);
+    if (index == SLOT_NONE) {
+        return NULL;
+    }
+    ember_vm* vm = slots[index].vm;
+    slots[index].vm = NULL;
+    stack_push(&empty_head, index);
+    return vm;
+}
+
+// Returns false when every slot is taken
+static bool shared_put(ember_vm* vm) {
+    uint32_t index = stack_pop(&empty_head);
+    if (index == SLOT_NONE) {
+        return false;
+    }
+    slots[index].vm = vm;
+    stack_push(&idle_head, index);
+    return true;
+}
+
+// ============================================================================
+// THREAD CACHES
+// ============================================================================
+
+static void cache_flush(pool_thread_cache* cache) {
+    while (cache->count > 0) {
+        ember_vm* vm = cache->vms[--cache->count];
+        if (!pool_initialized || pool_snapshot || !shared_put(vm)) {
+            ember_free_vm(vm);
+        }
+    }
+}
+
+// Thread exit: hand the idle VMs to other threads and free the cache for reuse
+static void cache_release(void* data) {
+    pool_thread_cache* cache = data;
+    cache_flush(cache);
+    pthread_mutex_lock(&caches_lock);
+    cache->in_use = false;
+    pthread_mutex_unlock(&caches_lock);
+}
+
+static void cache_key_create(void) {
+    pthread_key_create(&cache_key, cache_release);
+}
+
+static pool_thread_cache* cache_get(void) {
+    uint64_t generation = __atomic_load_n(&pool_generation, __ATOMIC_ACQUIRE);
+    pool_thread_cache* cache = thread_cache;
+    if (cache && thread_cache_generation == generation) {
+        return cache;
+    }
+
+    if (!cache) {
+        pthread_once(&cache_key_once, cache_key_create);
+        pthread_mutex_lock(&caches_lock);
+        cache = caches;
+        while (cache && cache->in_use) {
+            cache = cache->next;
+        }
+        if (!cache) {
+            cache = calloc(1, sizeof(pool_thread_cache));
+            if (!cache) {
+                pthread_mutex_unlock(&caches_lock);
+                return NULL;
+            }
+            cache->next = caches;
+            caches = cache;
+        }
+        cache->in_use = true;
+        pthread_mutex_unlock(&caches_lock);
+        pthread_setspecific(cache_key, cache);
+        thread_cache = cache;
+    }
+
+    // New cache, or the pool was re-initialized since this thread last used
+    // it. Cleanup drains every cache, but whatever is still here belongs to
+    // a pool that is gone: free it rather than drop it
+    while (cache->count > 0) {
+        ember_free_vm(cache->vms[--cache->count]);
+    }
+    cache->tokens = (uint64_t)pool_config.rate_limit_max_allocs * pool_config.rate_limit_window_ms;
+    cache->refilled_at = get_current_time_ms();
+    cache->lease = 0;
+    thread_cache_generation = generation;
+    return cache;
+}
+
+// Only the owning thread writes a cache's counters; ember_pool_stats reads
+// them from others
+static void count(uint64_t* counter) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+}
+
+// Takes one allocation from the pool-wide budget, leasing a batch of them
+// when the thread has none left for the current window
+static bool global_take(pool_thread_cache* cache, uint64_t now) {
+    uint32_t window = (uint32_t)(now / pool_config.rate_limit_window_ms);
+    if (cache->lease > 0 && cache->lease_window == window) {
+        cache->lease--;
+        return true;
+    }
+    // A lease from an earlier window is not carried over
+    cache->lease = 0;
+
+    uint64_t old = __atomic_load_n(&global_budget, __ATOMIC_RELAXED);
+    for (;;) {
+        uint32_t left = (uint32_t)old;
+        if ((uint32_t)(old >> 32) != window) {
+            left = pool_config.rate_limit_global_allocs;
+        }
+        if (left == 0) {
+            return false;
+        }
+        uint32_t take = left < POOL_LEASE_BATCH ? left : POOL_LEASE_BATCH;
+        uint64_t desired = (uint64_t)window << 32 | (left - take);
+        if (__atomic_compare_exchange_n(&global_budget, &old, desired, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            cache->lease = take - 1;
+            cache->lease_window = window;
+            return true;
+        }
+    }
+}
+
+// Rate limiting: a token bucket per thread that refills at
+// rate_limit_max_allocs per window and holds at most that many, then the
+// pool-wide budget if one is configured
+static int check_rate_limit(pool_thread_cache* cache) {
+    uint64_t now = get_current_time_ms();
+    uint64_t cost = pool_config.rate_limit_window_ms;
+    uint64_t capacity = (uint64_t)pool_config.rate_limit_max_allocs * cost;
+
+    if (now > cache->refilled_at) {
+        uint64_t refill = (now - cache->refilled_at) * pool_config.rate_limit_max_allocs;
+        cache->tokens = refill >= capacity - cache->tokens ? capacity : cache->tokens + refill;
+        cache->refilled_at = now;
+    }
+
+    if (cache->tokens < cost) {
+        return EMBER_ERROR_RESOURCE_EXHAUSTED;
+    }
+    if (pool_config.rate_limit_global_allocs > 0 && !global_take(cache, now)) {
+        return EMBER_ERROR_RESOURCE_EXHAUSTED;
+    }
+
+    cache->tokens -= cost;
+    return EMBER_SUCCESS;
+}
+
+// Reset VM state for security before it serves another request; release
+// does it once, before the VM goes idle. Only what
+// the request touched is scrubbed: stack and locals up to their high-water
+// marks, and the frame, handler and loop counts, so the cost follows what
+// the request used rather than the size of ember_vm. The request's objects
+// are gone already (gc_request_end).
+static void reset_vm(ember_vm* vm) {
+    vm_note_high_water(vm);
+    for (int i = 0; i < vm->stack_high; i++) {
+        vm->stack[i] = ember_make_nil();
+    }
+    for (int i = 0; i < vm->locals_high; i++) {
+        vm->locals[i] = ember_make_nil();
+    }
+    vm->stack_high = 0;
+    vm->locals_high = 0;
+    vm->ip = 0;
+    vm->stack_top = 0;
+    vm->local_count = 0;
+    vm->local_base = 0;
+    vm->frame_count = 0;
+    vm->exception_handler_count = 0;
+    vm->finally_block_count = 0;
+    vm->call_stack_depth = 0;
+    vm->loop_depth = 0;
+    vm->async_stack_top = 0;
+    vm->current_generator = NULL;
+    vm->exception_pending = 0;
+    vm->current_exception = ember_make_nil();
+    ember_vm_clear_error(vm);
+    // The next request brings its own budget
+    ember_vm_set_fuel(vm, 0, EMBER_FUEL_TIMEOUT);
+    ember_vm_set_fuel_hook(vm, NULL, NULL);
+    // Timers, watches and suspended calls belong to the request that made them
+    event_loop_free(vm);
+    // What the request printed goes out before the next one prints
+    ember_vm_flush_output(vm);
+    // A connection left open by the request goes back to its pool
+    database_release_vm(vm);
+}
+
+// Frees every idle VM, shared or cached. Caller guarantees no concurrent use.
+static void drain_idle(void) {
+    ember_vm* vm;
+    while ((vm = shared_take()) != NULL) {
+        ember_free_vm(vm);
+    }
+    pthread_mutex_lock(&caches_lock);
+    for (pool_thread_cache* cache = caches; cache; cache = cache->next) {
+        while (cache->count > 0) {
+            ember_free_vm(cache->vms[--cache->count]);
+        }
+    }
+    pthread_mutex_unlock(&caches_lock);
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+// Secure VM pool initialization
+int ember_pool_init(const vm_pool_config_t* config) {
+    // NULL config is allowed - use secure defaults
+    vm_pool_config_t effective_config;
+
+    if (config == NULL) {
+        // Use default secure configuration
+        effective_config = DEFAULT_SECURE_CONFIG;
+    } else {
+        // Copy and validate provided configuration
+        effective_config = *config;
+        apply_secure_defaults(&effective_config);
+
+        int validation_result = validate_pool_config(&effective_config);
+        if (validation_result != EMBER_SUCCESS) {
+            return validation_result;
+        }
+    }
+
+    // Clean up existing pool if already initialized
+    if (pool_initialized) {
+        ember_pool_cleanup();
+    }
+
+    uint32_t pool_size = effective_config.initial_size;
+    slots = calloc(pool_size, sizeof(pool_slot));
+    if (!slots) {
+        return EMBER_ERROR_MEMORY_ALLOCATION;
+    }
+
+    // Every slot starts on the empty stack
+    for (uint32_t i = 0; i < pool_size; i++) {
+        slots[i].next = i + 1 < pool_size ? i + 1 : SLOT_NONE;
+    }
+    idle_head = SLOT_NONE;
+    empty_head = 0;
+
+    pool_config = effective_config;
+    global_budget = (get_current_time_ms() / pool_config.rate_limit_window_ms) << 32 |
+                    pool_config.rate_limit_global_allocs;
+    pthread_mutex_lock(&caches_lock);
+    for (pool_thread_cache* cache = caches; cache; cache = cache->next) {
+        memset(&cache->stats, 0, sizeof(cache->stats));
+    }
+    pthread_mutex_unlock(&caches_lock);
+    pool_initialized = true;
+    __atomic_add_fetch(&pool_generation, 1, __ATOMIC_RELEASE);
+
+    return EMBER_SUCCESS;
+}
+
+// Secure VM pool cleanup
+void ember_pool_cleanup(void) {
+    if (!pool_initialized) {
+        return;  // Safe to call multiple times
+    }
+
+    drain_idle();
+
+    pthread_mutex_lock(&caches_lock);
+    for (pool_thread_cache* cache = caches; cache; cache = cache->next) {
+        __atomic_store_n(&cache->active, 0, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&caches_lock);
+
+    free(slots);
+    slots = NULL;
+    idle_head = SLOT_NONE;
+    empty_head = SLOT_NONE;
+    pool_initialized = false;
+    __atomic_add_fetch(&pool_generation, 1, __ATOMIC_RELEASE);
+}
+
+// Secure VM acquisition with rate limiting; reuse = false always builds the
+// VM on the calling thread
+static ember_vm* pool_get(bool reuse) {
+    // Check if pool is initialized
+    if (!pool_initialized) {
+        return NULL;  // Graceful failure - no error leakage
+    }
+
+    pool_thread_cache* cache = cache_get();
+    if (!cache) {
+        return NULL;
+    }
+
+    // Apply rate limiting
+    if (check_rate_limit(cache) != EMBER_SUCCESS) {
+        count(&cache->stats.rate_limited);
+        return NULL;  // Rate limited - no error details leaked
+    }
+
+    if (__atomic_load_n(&cache->active, __ATOMIC_RELAXED) >= pool_config.max_vms_per_thread) {
+        count(&cache->stats.exhausted);
+        return NULL;  // Pool exhausted
+    }
+
+    ember_vm* vm = NULL;
+    if (pool_snapshot) {
+        // A fresh clone shares nothing mutable with earlier requests
+        vm = ember_vm_snapshot_clone(pool_snapshot);
+        if (vm) count(&cache->stats.created);
+    } else {
+        if (!reuse) {
+            vm = NULL;
+        } else if (cache->count > 0) {
+            vm = cache->vms[--cache->count];
+            count(&cache->stats.cache_hits);
+        } else {
+            vm = shared_take();
+            if (vm) count(&cache->stats.shared_hits);
+        }
+        if (vm) {
+            // Idle VMs were reset when they were released
+            gc_request_begin(vm);
+        } else {
+            vm = ember_new_vm();
+            if (vm) count(&cache->stats.created);
+        }
+    }
+
+    if (vm) {
+        vm->vm_pool_context = cache;
+        __atomic_add_fetch(&cache->active, 1, __ATOMIC_RELAXED);
+        count(&cache->stats.acquired);
+        EMBER_PROBE1(pool__acquire, vm);
+    }
+    return vm;
+}
+
+ember_vm* ember_pool_get_vm(void) {
+    return pool_get(true);
+}
+
+ember_vm* vm_pool_get_fresh(void) {
+    return pool_get(false);
+}
+
+// Secure VM release with validation
+void ember_pool_release_vm(ember_vm* vm) {
+    // NULL VM is safe to release - no error
+    if (!vm) {
+        return;
+    }
+    EMBER_PROBE1(pool__release, vm);
+    // Before gc_request_end drops stack_top and local_count
+    vm_note_high_water(vm);
+
+    // Check if pool is initialized
+    if (!pool_initialized) {
+        // Pool not initialized - just free the VM
+        ember_free_vm(vm);
+        return;
+    }
+
+    pool_thread_cache* owner = vm->vm_pool_context;
+    vm->vm_pool_context = NULL;
+    if (owner) {
+        // Never below zero: cleanup may have reset the count since the get
+        uint32_t active = __atomic_load_n(&owner->active, __ATOMIC_RELAXED);
+        while (active > 0 &&
+               !__atomic_compare_exchange_n(&owner->active, &active, active - 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        }
+    }
+
+    pool_thread_cache* cache = cache_get();
+    if (cache) {
+        count(&cache->stats.released);
+    }
+
+    if (pool_snapshot) {
+        // The next request gets a new clone
+        ember_free_vm(vm);
+        return;
+    }
+
+    // Drop the request's objects before the VM sits idle in the pool
+    gc_request_end(vm);
+    reset_vm(vm);
+    ember_prefetch_free(vm);
+
+    if (cache && cache->count < pool_config.thread_cache_size) {
+        cache->vms[cache->count++] = vm;
+        return;
+    }
+
+    // Pool is full - free the VM
+    if (!shared_put(vm)) {
+        ember_free_vm(vm);
+    }
+}
+
+void ember_pool_set_snapshot(ember_vm_snapshot* snapshot) {
+    pool_snapshot = snapshot;
+    if (!snapshot || !pool_initialized) {
+        return;
+    }
+    // Idle VMs predate the snapshot
+    drain_idle();
+}
+
+void ember_pool_stats(vm_pool_stats_t* stats) {
+    if (!stats) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+    pthread_mutex_lock(&caches_lock);
+    for (pool_thread_cache* cache = caches; cache; cache = cache->next) {
+        stats->acquired += __atomic_load_n(&cache->stats.acquired, __ATOMIC_RELAXED);
+        stats->cache_hits += __atomic_load_n(&cache->stats.cache_hits, __ATOMIC_RELAXED);
+        stats->shared_hits += __atomic_load_n(&cache->stats.shared_hits, __ATOMIC_RELAXED);
+        stats->created += __atomic_load_n(&cache->stats.created, __ATOMIC_RELAXED);
+        stats->released += __atomic_load_n(&cache->stats.released, __ATOMIC_RELAXED);
+        stats->rate_limited += __atomic_load_n(&cache->stats.rate_limited, __ATOMIC_RELAXED);
+        stats->exhausted += __atomic_load_n(&cache->stats.exhausted, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&caches_lock);
+}
@@ -0,0 +1,494 @@
+#define _GNU_SOURCE
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "optimizer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <x86intrin.h>
+#endif
+
+// Execution profiler. While vm->profiling is set the dispatch loop reports
+// every instruction before running it (vm_dispatch_profile). The time since
+// the previous report is charged to the previous instruction's opcode and,
+// as exclusive time, to the function that ran it. The functions on the
+// call stack are tracked by a shadow stack that follows vm->frame_count and
+// vm->chunk, so returns, exceptions unwinding several frames and tail calls
+// need no hooks of their own; vm_profile_call only counts calls and
+// supplies names. A statement is counted when the instruction starting its
+// line run (line_table.c) runs. Profiling costs a timestamp read and a few
+// table lookups per instruction, so it is for finding hot spots, not for
+// production runs.
+
+#define PROFILE_INITIAL_SLOTS 64
+
+typedef struct {
+    const ember_chunk* chunk;
+    int function;
+} profile_frame;
+
+struct ember_profile_state {
+    uint64_t last_tick;
+    int last_opcode;               // -1 while the clock is stopped
+    profile_frame* stack;          // Shadow call stack, top-level code at 0
+    int depth;
+    int stack_capacity;
+    int function_capacity;
+    int* function_slots;           // Open addressing on chunk, index + 1
+    int function_slot_capacity;
+    int line_capacity;
+    int* line_slots;               // Open addressing on (chunk, line), index + 1
+    int line_slot_capacity;
+    const ember_chunk* run_chunk;  // Line run of the last instruction
+    int run_start;
+    int run_end;
+    int run_line;
+    uint64_t start_tick;           // For ns_per_cycle
+    uint64_t start_ns;
+};
+
+static uint64_t monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static inline uint64_t profile_ticks(void) {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    return __rdtsc();
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+    uint64_t ticks;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return monotonic_ns();
+#endif
+}
+
+static char* copy_name(const char* name) {
+    size_t length = strlen(name);
+    char* copy = malloc(length + 1);
+    if (copy) memcpy(copy, name, length + 1);
+    return copy;
+}
+
+// ============================================================================
+// NAMES
+// ============================================================================
+
+void ember_chunk_set_name(ember_chunk* chunk, const char* name) {
+    if (!chunk || !name || chunk->name) return;
+    chunk->name = copy_name(name);
+}
+
+// ============================================================================
+// TABLES
+// ============================================================================
+
+static uint32_t hash_pointer(const void* pointer, int extra) {
+    uint64_t key = (uint64_t)(uintptr_t)pointer ^ ((uint64_t)(uint32_t)extra << 32);
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (uint32_t)key;
+}
+
+// Grow an open-addressed index table to twice its size and rehash entries
+// 0..count-1 into it; key_of gives each entry's hash
+static int* grow_slots(int* slots, int* capacity, int count, uint32_t (*key_of)(const ember_profile*, int),
+                       const ember_profile* profile) {
+    int grown = *capacity ? *capacity * 2 : PROFILE_INITIAL_SLOTS;
+    int* fresh = calloc((size_t)grown, sizeof(int));
+    if (!fresh) return NULL;
+    for (int i = 0; i < count; i++) {
+        uint32_t slot = key_of(profile, i) & (uint32_t)(grown - 1);
+        while (fresh[slot]) slot = (slot + 1) & (uint32_t)(grown - 1);
+        fresh[slot] = i + 1;
+    }
+    free(slots);
+    *capacity = grown;
+    return fresh;
+}
+
+static uint32_t function_key(const ember_profile* profile, int index) {
+    return hash_pointer(profile->functions[index].chunk, 0);
+}
+
+static uint32_t line_key(const ember_profile* profile, int index) {
+    return hash_pointer(profile->lines[index].chunk, profile->lines[index].line);
+}
+
+// The function entry for chunk, created on first use; -1 if out of memory.
+// name may be NULL when only the shadow stack has seen the chunk
+static int function_index(ember_profile* profile, const ember_chunk* chunk, const char* name) {
+    struct ember_profile_state* state = profile->state;
+    if (state->function_slot_capacity) {
+        uint32_t mask = (uint32_t)state->function_slot_capacity - 1;
+        for (uint32_t slot = hash_pointer(chunk, 0) & mask; state->function_slots[slot]; slot = (slot + 1) & mask) {
+            int index = state->function_slots[slot] - 1;
+            if (profile->functions[index].chunk != chunk) continue;
+            ember_function_profile* function = &profile->functions[index];
+            if (name && strcmp(function->name, "<anonymous>") == 0) {
+                char* named = copy_name(name);
+                if (named) {
+                    free(function->name);
+                    function->name = named;
+                }
+            }
+            return index;
+        }
+    }
+
+    if ((profile->function_count + 1) * 2 > state->function_slot_capacity) {
+        int* slots = grow_slots(state->function_slots, &state->function_slot_capacity,
+                                profile->function_count, function_key, profile);
+        if (!slots) return -1;
+        state->function_slots = slots;
+    }
+    if (profile->function_count == state->function_capacity) {
+        int capacity = state->function_capacity ? state->function_capacity * 2 : 16;
+        ember_function_profile* functions = realloc(profile->functions, sizeof(ember_function_profile) * (size_t)capacity);
+        if (!functions) return -1;
+        profile->functions = functions;
+        state->function_capacity = capacity;
+    }
+    ember_function_profile* function = &profile->functions[profile->function_count];
+    memset(function, 0, sizeof(*function));
+    function->chunk = chunk;
+    if (!name) name = chunk->name ? chunk->name : state->depth == 0 ? "<script>" : "<anonymous>";
+    function->name = copy_name(name);
+    if (!function->name) return -1;
+
+    uint32_t mask = (uint32_t)state->function_slot_capacity - 1;
+    uint32_t slot = hash_pointer(chunk, 0) & mask;
+    while (state->function_slots[slot]) slot = (slot + 1) & mask;
+    state->function_slots[slot] = ++profile->function_count;
+    return profile->function_count - 1;
+}
+
+static ember_line_profile* line_entry(ember_profile* profile, const ember_chunk* chunk, int line, int function) {
+    struct ember_profile_state* state = profile->state;
+    if (state->line_slot_capacity) {
+        uint32_t mask = (uint32_t)state->line_slot_capacity - 1;
+        for (uint32_t slot = hash_pointer(chunk, line) & mask; state->line_slots[slot]; slot = (slot + 1) & mask) {
+            ember_line_profile* entry = &profile->lines[state->line_slots[slot] - 1];
+            if (entry->chunk == chunk && entry->line == line) return entry;
+        }
+    }
+
+    if ((profile->line_count + 1) * 2 > state->line_slot_capacity) {
+        int* slots = grow_slots(state->line_slots, &state->line_slot_capacity, profile->line_count, line_key, profile);
+        if (!slots) return NULL;
+        state->line_slots = slots;
+    }
+    if (profile->line_count == state->line_capacity) {
+        int capacity = state->line_capacity ? state->line_capacity * 2 : 64;
+        ember_line_profile* lines = realloc(profile->lines, sizeof(ember_line_profile) * (size_t)capacity);
+        if (!lines) return NULL;
+        profile->lines = lines;
+        state->line_capacity = capacity;
+    }
+    ember_line_profile* entry = &profile->lines[profile->line_count];
+    entry->chunk = chunk;
+    entry->function = function;
+    entry->line = line;
+    entry->hits = 0;
+
+    uint32_t mask = (uint32_t)state->line_slot_capacity - 1;
+    uint32_t slot = hash_pointer(chunk, line) & mask;
+    while (state->line_slots[slot]) slot = (slot + 1) & mask;
+    state->line_slots[slot] = ++profile->line_count;
+    return entry;
+}
+
+// ============================================================================
+// RECORDING
+// ============================================================================
+
+static void push_frame(ember_profile* profile, const ember_chunk* chunk, uint64_t now) {
+    struct ember_profile_state* state = profile->state;
+    if (state->depth == state->stack_capacity) {
+        int capacity = state->stack_capacity ? state->stack_capacity * 2 : 16;
+        profile_frame* stack = realloc(state->stack, sizeof(profile_frame) * (size_t)capacity);
+        if (!stack) return;
+        state->stack = stack;
+        state->stack_capacity = capacity;
+    }
+    int function = function_index(profile, chunk, NULL);
+    state->stack[state->depth].chunk = chunk;
+    state->stack[state->depth].function = function;
+    state->depth++;
+    if (function >= 0 && profile->functions[function].active++ == 0) {
+        profile->functions[function].entered = now;
+    }
+}
+
+static void pop_frame(ember_profile* profile, uint64_t now) {
+    struct ember_profile_state* state = profile->state;
+    int function = state->stack[--state->depth].function;
+    if (function < 0) return;
+    ember_function_profile* entry = &profile->functions[function];
+    // Recursive activations are inside the outermost one's time already
+    if (--entry->active == 0) entry->inclusive_cycles += now - entry->entered;
+}
+
+// Bring the shadow stack in line with the VM's frames: one entry per frame
+// plus the running chunk on top
+static void sync_stack(ember_vm* vm, ember_profile* profile, uint64_t now) {
+    struct ember_profile_state* state = profile->state;
+    int depth = vm->frame_count + 1;
+    while (state->depth > depth ||
+           (state->depth == depth && state->stack[state->depth - 1].chunk != vm->chunk)) {
+        pop_frame(profile, now);
+    }
+    while (state->depth < depth) {
+        int level = state->depth;
+        const ember_chunk* chunk = level < vm->frame_count ? vm->frames[level].chunk : vm->chunk;
+        int before = state->depth;
+        push_frame(profile, chunk, now);
+        if (state->depth == before) return;
+    }
+}
+
+static void count_line(ember_profile* profile, const ember_chunk* chunk, int offset, int function) {
+    struct ember_profile_state* state = profile->state;
+    if (chunk != state->run_chunk || offset < state->run_start || offset >= state->run_end) {
+        int run = chunk->line_count ? ember_chunk_line_run_at(chunk, offset) : -1;
+        const ember_line_run* runs = chunk->lines;
+        state->run_chunk = chunk;
+        if (run < 0) {
+            state->run_start = 0;
+            state->run_end = runs ? runs[0].start : chunk->count;
+            state->run_line = 0;
+        } else {
+            state->run_start = runs[run].start;
+            state->run_end = run + 1 < chunk->line_count ? runs[run + 1].start : chunk->count;
+            // A later statement on the same line is not another visit to it
+            state->run_line = run > 0 && runs[run - 1].line == runs[run].line ? 0 : runs[run].line;
+        }
+    }
+    if (state->run_line > 0 && offset == state->run_start) {
+        ember_line_profile* entry = line_entry(profile, chunk, state->run_line, function);
+        if (entry) entry->hits++;
+    }
+}
+
+// Charge the time since the last report to the instruction that was running
+static void charge(ember_profile* profile, uint64_t now) {
+    struct ember_profile_state* state = profile->state;
+    if (state->last_opcode < 0) return;
+    uint64_t elapsed = now - state->last_tick;
+    profile->opcodes[state->last_opcode].cycles += elapsed;
+    if (state->depth > 0) {
+        int function = state->stack[state->depth - 1].function;
+        if (function >= 0) profile->functions[function].exclusive_cycles += elapsed;
+    }
+}
+
+void vm_profile_instruction(ember_vm* vm, const uint8_t* instruction) {
+    ember_profile* profile = vm->profile;
+    ember_chunk* chunk = vm->chunk;
+    if (!vm->profiling || !profile || !chunk) return;
+    struct ember_profile_state* state = profile->state;
+    uint64_t now = profile_ticks();
+    charge(profile, now);
+    sync_stack(vm, profile, now);
+
+    uint8_t op = *instruction;
+    if (op == OP_WIDE && instruction + 1 < chunk->code + chunk->count) op = instruction[1];
+    profile->opcodes[op].count++;
+    profile->instructions++;
+    int function = state->depth > 0 ? state->stack[state->depth - 1].function : -1;
+    count_line(profile, chunk, (int)(instruction - chunk->code), function);
+    state->last_opcode = op;
+    // The bookkeeping above is not the instruction's time
+    state->last_tick = profile_ticks();
+}
+
+void vm_profile_call(ember_vm* vm, const ember_chunk* chunk, const char* name) {
+    ember_profile* profile = vm->profile;
+    if (!vm->profiling || !profile || !chunk) return;
+    int function = function_index(profile, chunk, name);
+    if (function >= 0) profile->functions[function].calls++;
+}
+
+void vm_profile_pause(ember_vm* vm) {
+    ember_profile* profile = vm ? vm->profile : NULL;
+    if (!profile || profile->state->last_opcode < 0) return;
+    uint64_t now = profile_ticks();
+    charge(profile, now);
+    profile->state->last_opcode = -1;
+    while (profile->state->depth > 0) pop_frame(profile, now);
+    uint64_t cycles = now - profile->state->start_tick;
+    uint64_t ns = monotonic_ns() - profile->state->start_ns;
+    profile->ns_per_cycle = cycles ? (double)ns / (double)cycles : 1.0;
+}
+
+// ============================================================================
+// API
+// ============================================================================
+
+static void free_profile(ember_profile* profile) {
+    if (!profile) return;
+    for (int i = 0; i < profile->function_count; i++) free(profile->functions[i].name);
+    free(profile->functions);
+    free(profile->lines);
+    if (profile->state) {
+        free(profile->state->stack);
+        free(profile->state->function_slots);
+        free(profile->state->line_slots);
+        free(profile->state);
+    }
+    free(profile);
+}
+
+int ember_vm_set_profiling(ember_vm* vm, int enable) {
+    if (!vm) return EMBER_ERROR_INVALID_PARAMETER;
+    if (!enable) {
+        // Results stay readable; recording stops
+        vm_profile_pause(vm);
+        vm->profiling = false;
+        return EMBER_SUCCESS;
+    }
+    ember_profile* profile = calloc(1, sizeof(ember_profile));
+    struct ember_profile_state* state = profile ? calloc(1, sizeof(*state)) : NULL;
+    if (!state) {
+        free(profile);
+        return EMBER_ERROR_MEMORY_ALLOCATION;
+    }
+    profile->state = state;
+    profile->ns_per_cycle = 1.0;
+    state->last_opcode = -1;
+    state->start_tick = profile_ticks();
+    state->start_ns = monotonic_ns();
+    vm_profile_free(vm);
+    vm->profile = profile;
+    vm->profiling = true;
+    return EMBER_SUCCESS;
+}
+
+const ember_profile* ember_vm_get_profile(ember_vm* vm) {
+    if (!vm) return NULL;
+    // Bring times up to date; the next instruction restarts the clock
+    vm_profile_pause(vm);
+    return vm->profile;
+}
+
+void vm_profile_free(ember_vm* vm) {
+    if (!vm) return;
+    free_profile(vm->profile);
+    vm->profile = NULL;
+    vm->profiling = false;
+}
+
+void ember_get_optimization_stats(ember_vm* vm, ember_optimization_stats_t* stats) {
+    if (!stats) return;
+    ember_init_optimization_stats(stats);
+    if (!vm) return;
+    stats->instructions_executed = vm->instructions_executed;
+    stats->function_calls = vm->function_calls;
+    stats->jit_compilations = vm->jit_compilations;
+    stats->jit_deopts = vm->jit_deopts;
+    stats->osr_entries = vm->osr_entries;
+    stats->profile = ember_vm_get_profile(vm);
+    if (stats->profile && stats->instructions_executed < stats->profile->instructions) {
+        stats->instructions_executed = stats->profile->instructions;
+    }
+}
+
+// ============================================================================
+// REPORT
+// ============================================================================
+
+#define REPORT_ROWS 25
+
+typedef struct {
+    uint64_t key;
+    int index;
+} report_row;
+
+// Largest key first
+static int by_key(const void* a, const void* b) {
+    uint64_t x = ((const report_row*)a)->key;
+    uint64_t y = ((const report_row*)b)->key;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static double to_ms(const ember_profile* profile, uint64_t cycles) {
+    return (double)cycles * profile->ns_per_cycle / 1e6;
+}
+
+static void write_report(const ember_profile* profile, FILE* out) {
+    int count = profile->function_count > profile->line_count ? profile->function_count : profile->line_count;
+    if (count < 256) count = 256;
+    report_row* rows = malloc(sizeof(report_row) * (size_t)count);
+    if (!rows) return;
+
+    uint64_t total = 0;
+    for (int op = 0; op < 256; op++) total += profile->opcodes[op].cycles;
+    fprintf(out, "Ember profile: %llu instructions, %.3f ms\n\n",
+            (unsigned long long)profile->instructions, to_ms(profile, total));
+
+    int used = 0;
+    for (int op = 0; op < 256; op++) {
+        if (!profile->opcodes[op].count) continue;
+        rows[used].key = profile->opcodes[op].cycles;
+        rows[used++].index = op;
+    }
+    qsort(rows, (size_t)used, sizeof(report_row), by_key);
+    fprintf(out, "%-32s %14s %12s %7s %10s\n", "opcode", "count", "ms", "%", "cycles/op");
+    for (int i = 0; i < used && i < REPORT_ROWS; i++) {
+        const ember_opcode_profile* entry = &profile->opcodes[rows[i].index];
+        const char* name = opcode_name((uint8_t)rows[i].index);
+        char unnamed[16];
+        if (!name) {
+            snprintf(unnamed, sizeof(unnamed), "op %d", rows[i].index);
+            name = unnamed;
+        }
+        fprintf(out, "%-32s %14llu %12.3f %6.1f%% %10.1f\n", name, (unsigned long long)entry->count,
+                to_ms(profile, entry->cycles), total ? 100.0 * (double)entry->cycles / (double)total : 0.0,
+                (double)entry->cycles / (double)entry->count);
+    }
+
+    for (int i = 0; i < profile->function_count; i++) {
+        rows[i].key = profile->functions[i].exclusive_cycles;
+        rows[i].index = i;
+    }
+    qsort(rows, (size_t)profile->function_count, sizeof(report_row), by_key);
+    fprintf(out, "\n%-32s %10s %14s %14s\n", "function", "calls", "inclusive ms", "exclusive ms");
+    for (int i = 0; i < profile->function_count && i < REPORT_ROWS; i++) {
+        const ember_function_profile* entry = &profile->functions[rows[i].index];
+        fprintf(out, "%-32s %10llu %14.3f %14.3f\n", entry->name, (unsigned long long)entry->calls,
+                to_ms(profile, entry->inclusive_cycles), to_ms(profile, entry->exclusive_cycles));
+    }
+
+    for (int i = 0; i < profile->line_count; i++) {
+        rows[i].key = profile->lines[i].hits;
+        rows[i].index = i;
+    }
+    qsort(rows, (size_t)profile->line_count, sizeof(report_row), by_key);
+    fprintf(out, "\n%-8s %-32s %14s\n", "line", "function", "hits");
+    if (profile->line_count == 0) fprintf(out, "(no line information)\n");
+    for (int i = 0; i < profile->line_count && i < REPORT_ROWS; i++) {
+        const ember_line_profile* entry = &profile->lines[rows[i].index];
+        const char* function = entry->function >= 0 ? profile->functions[entry->function].name : "?";
+        fprintf(out, "%-8d %-32s %14llu\n", entry->line, function, (unsigned long long)entry->hits);
+    }
+    free(rows);
+}
+
+int ember_vm_write_profile(ember_vm* vm, const char* path) {
+    const ember_profile* profile = ember_vm_get_profile(vm);
+    if (!profile) return EMBER_ERROR_INVALID_PARAMETER;
+    int to_stderr = !path || strcmp(path, "-") == 0;
+    FILE* out = to_stderr ? stderr : fopen(path, "w");
+    if (!out) {
+        fprintf(stderr, "[PROFILE] Cannot write %s\n", path);
+        return EMBER_ERROR_OPERATION_FAILED;
+    }
+    write_report(profile, out);
+    if (!to_stderr && fclose(out) != 0) return EMBER_ERROR_OPERATION_FAILED;
+    return EMBER_SUCCESS;
+}
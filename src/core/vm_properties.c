@@ -0,0 +1,163 @@
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "../runtime/value/value.h"
+#include "object_shape.h"
+#include "error.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Inline caches for instance fields. Each name constant a chunk reads or
+// writes a property through gets up to EMBER_PROPERTY_CACHE_WAYS (shape,
+// slot) pairs per direction: one while a site only sees one layout
+// (monomorphic), more once several classes or field orders pass through it
+// (polymorphic). Further shapes take the shape lookup every time. A store
+// that adds a field also caches the shape it moves the instance to.
+
+static vm_operation_result property_error(ember_vm* vm, const char* message) {
+    ember_error* error = ember_error_runtime(vm, message);
+    ember_vm_set_error(vm, error);
+    return VM_RESULT_ERROR;
+}
+
+static struct ember_property_cache* property_cache_entry(ember_chunk* chunk, int constant) {
+    if (constant >= chunk->property_cache_count) {
+        // Sized to the constant pool like the global cache
+        int new_count = chunk->const_capacity > constant ? chunk->const_capacity : constant + 1;
+        struct ember_property_cache* cache = realloc(chunk->property_cache,
+                                                     sizeof(struct ember_property_cache) * (size_t)new_count);
+        if (!cache) return NULL;
+        memset(cache + chunk->property_cache_count, 0,
+               sizeof(struct ember_property_cache) * (size_t)(new_count - chunk->property_cache_count));
+        chunk->property_cache = cache;
+        chunk->property_cache_count = new_count;
+    }
+    return &chunk->property_cache[constant];
+}
+
+// Remember shape at a site; once every way is taken the site stops learning
+static void cache_shape(ember_property_cache_entry* ways, const ember_shape* shape,
+                        ember_shape* target, int slot) {
+    for (int i = 0; i < EMBER_PROPERTY_CACHE_WAYS; i++) {
+        if (ways[i].shape_id == 0) {
+            ways[i].shape_id = shape->id;
+            ways[i].target = target;
+            ways[i].slot = slot;
+            return;
+        }
+    }
+}
+
+static ember_value property_name(ember_chunk* chunk, int constant) {
+    if (!chunk || constant < 0 || constant >= chunk->const_count) {
+        return ember_make_nil();
+    }
+    ember_value name = chunk->constants[constant];
+    return name.type == EMBER_VAL_STRING && name.as.obj_val ? name : ember_make_nil();
+}
+
+// VM operation handler for OP_GET_PROPERTY: replaces the instance on top of
+// the stack with the field's value
+vm_operation_result vm_handle_get_property(ember_vm* vm, ember_chunk* chunk, int constant) {
+    if (vm->stack_top < 1) {
+        return property_error(vm, "Stack underflow reading property");
+    }
+    ember_value receiver = vm->stack[vm->stack_top - 1];
+    if (receiver.type != EMBER_VAL_INSTANCE) {
+        return VM_RESULT_CONTINUE;
+    }
+    ember_instance* instance = AS_INSTANCE(receiver);
+    ember_shape* shape = instance->shape;
+
+    if (shape && constant >= 0 && constant < chunk->property_cache_count) {
+        const ember_property_cache_entry* ways = chunk->property_cache[constant].get;
+        for (int i = 0; i < EMBER_PROPERTY_CACHE_WAYS; i++) {
+            if (ways[i].shape_id == shape->id) {
+                vm->stack[vm->stack_top - 1] = instance->slots[ways[i].slot];
+                return VM_RESULT_OK;
+            }
+        }
+    }
+
+    ember_value name = property_name(chunk, constant);
+    if (name.type != EMBER_VAL_STRING) {
+        return property_error(vm, "Property name must be a string");
+    }
+    if (!shape) {
+        ember_value value;
+        if (!ember_instance_get_field(instance, name, &value)) {
+            return VM_RESULT_CONTINUE;
+        }
+        vm->stack[vm->stack_top - 1] = value;
+        return VM_RESULT_OK;
+    }
+
+    int slot = shape_find_field(shape, AS_STRING(name));
+    if (slot < 0) {
+        // Methods and builtin properties
+        return VM_RESULT_CONTINUE;
+    }
+    struct ember_property_cache* cache = property_cache_entry(chunk, constant);
+    if (cache) {
+        cache_shape(cache->get, shape, NULL, slot);
+    }
+    vm->stack[vm->stack_top - 1] = instance->slots[slot];
+    return VM_RESULT_OK;
+}
+
+// VM operation handler for OP_SET_PROPERTY: the stack holds the instance,
+// then the value, which is left on the stack as the assignment's result
+vm_operation_result vm_handle_set_property(ember_vm* vm, ember_chunk* chunk, int constant) {
+    if (vm->stack_top < 2) {
+        return property_error(vm, "Stack underflow in property assignment");
+    }
+    ember_value receiver = vm->stack[vm->stack_top - 2];
+    ember_value value = vm->stack[vm->stack_top - 1];
+    if (receiver.type != EMBER_VAL_INSTANCE) {
+        return property_error(vm, "Only instances have fields");
+    }
+    ember_instance* instance = AS_INSTANCE(receiver);
+    ember_shape* shape = instance->shape;
+
+    if (shape && constant >= 0 && constant < chunk->property_cache_count) {
+        const ember_property_cache_entry* ways = chunk->property_cache[constant].set;
+        for (int i = 0; i < EMBER_PROPERTY_CACHE_WAYS; i++) {
+            if (ways[i].shape_id != shape->id) continue;
+            int slot = ways[i].slot;
+            ember_shape* target = ways[i].target;
+            if (target != shape) {
+                if (!instance_reserve_slots(instance, target->field_count)) break;
+                gc_write_barrier_helper(vm, (ember_object*)instance, ember_make_nil(), value);
+                instance->slots[slot] = value;
+                instance->shape = target;
+                if (target->field_count > instance->klass->instance_slots_hint) {
+                    instance->klass->instance_slots_hint = target->field_count;
+                }
+            } else {
+                gc_write_barrier_helper(vm, (ember_object*)instance, instance->slots[slot], value);
+                instance->slots[slot] = value;
+            }
+            vm->stack[vm->stack_top - 2] = value;
+            vm->stack_top--;
+            return VM_RESULT_OK;
+        }
+    }
+
+    ember_value name = property_name(chunk, constant);
+    if (name.type != EMBER_VAL_STRING) {
+        return property_error(vm, "Property name must be a string");
+    }
+    if (!ember_instance_set_field(vm, instance, name, value)) {
+        return property_error(vm, "Out of memory assigning property");
+    }
+    if (shape && instance->shape) {
+        struct ember_property_cache* cache = property_cache_entry(chunk, constant);
+        if (cache) {
+            int slot = shape_find_field(instance->shape, AS_STRING(name));
+            cache_shape(cache->set, shape, instance->shape, slot);
+        }
+    }
+    vm->stack[vm->stack_top - 2] = value;
+    vm->stack_top--;
+    return VM_RESULT_OK;
+}
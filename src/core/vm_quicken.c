@@ -0,0 +1,134 @@
+#include "../../include/ember.h"
+#include "../vm.h"
+#include <math.h>
+
+// Quickening. Once type feedback (vm_feedback.c) has seen a site run often
+// enough with a single operand type pair, its generic opcode is overwritten
+// in place by a variant that handles only that pair: OP_ADD on numbers
+// becomes OP_ADD_NUMBER, OP_ARRAY_GET on an array or a typed array with a
+// number index becomes OP_ARRAY_GET_NUMBER_INDEX. The variant checks its operands and computes
+// directly, in int32 while both are small ints and the result fits. On
+// other types it writes the generic opcode back and returns
+// VM_RESULT_CONTINUE, and the dispatch loop runs the generic opcode instead;
+// the site's feedback has then seen a second type pair, so it is
+// polymorphic and never quickened again. Quickened opcodes have the same
+// operands and stack effect as their generic forms, so only the opcode byte
+// changes. Borrowed code (module images, snapshot clones) is shared and
+// never rewritten.
+
+#define QUICKEN_MIN_HITS 16   // Executions before a monomorphic site is trusted
+
+#define NUMBER_PAIR (((uint64_t)EMBER_VAL_NUMBER << 8 | (uint64_t)EMBER_VAL_NUMBER) + 1)
+#define ARRAY_NUMBER_PAIR (((uint64_t)EMBER_VAL_ARRAY << 8 | (uint64_t)EMBER_VAL_NUMBER) + 1)
+#define TYPED_ARRAY_NUMBER_PAIR (((uint64_t)EMBER_VAL_TYPED_ARRAY << 8 | (uint64_t)EMBER_VAL_NUMBER) + 1)
+
+// The quickened form of op for the operand type pair target (as recorded by
+// vm_feedback_record), or op itself if there is none
+static uint8_t quickened_opcode(uint8_t op, uint64_t target) {
+    if (target == ARRAY_NUMBER_PAIR || target == TYPED_ARRAY_NUMBER_PAIR) {
+        return op == OP_ARRAY_GET ? OP_ARRAY_GET_NUMBER_INDEX : op;
+    }
+    if (target != NUMBER_PAIR) return op;
+    switch (op) {
+        case OP_ADD:           return OP_ADD_NUMBER;
+        case OP_SUB:           return OP_SUB_NUMBER;
+        case OP_MUL:           return OP_MUL_NUMBER;
+        case OP_DIV:           return OP_DIV_NUMBER;
+        case OP_MOD:           return OP_MOD_NUMBER;
+        case OP_LESS:          return OP_LESS_NUMBER;
+        case OP_LESS_EQUAL:    return OP_LESS_EQUAL_NUMBER;
+        case OP_GREATER:       return OP_GREATER_NUMBER;
+        case OP_GREATER_EQUAL: return OP_GREATER_EQUAL_NUMBER;
+        default:               return op;
+    }
+}
+
+void vm_quicken(ember_chunk* chunk, const ember_feedback_slot* slot) {
+    if (!chunk || !slot || chunk->code_borrowed) return;
+    if (slot->state != EMBER_FEEDBACK_MONOMORPHIC || slot->hits < QUICKEN_MIN_HITS) return;
+    if (slot->offset < 0 || slot->offset >= chunk->count) return;
+    // Only ever the generic opcode the slot profiled, so a slot left over from
+    // rewritten code cannot quicken an operand byte
+    if (chunk->code[slot->offset] != slot->opcode) return;
+    uint8_t quickened = quickened_opcode(slot->opcode, slot->targets[0]);
+    if (quickened != slot->opcode) chunk->code[slot->offset] = quickened;
+}
+
+// Operands of the wrong type: undo the specialization and let the generic
+// opcode handle this execution
+static vm_operation_result dequicken(ember_chunk* chunk, uint8_t* instruction) {
+    if (chunk && !chunk->code_borrowed) *instruction = opcode_generic(*instruction);
+    return VM_RESULT_CONTINUE;
+}
+
+static vm_operation_result array_get_number_index(ember_vm* vm, ember_chunk* chunk, uint8_t* instruction) {
+    ember_value* array_value = &vm->stack[vm->stack_top - 2];
+    ember_value* index_value = &vm->stack[vm->stack_top - 1];
+    if (array_value->type == EMBER_VAL_TYPED_ARRAY && index_value->type == EMBER_VAL_NUMBER) {
+        // The element unboxed straight from the buffer; anything out of
+        // range is vm_handle_typed_array_get's to report
+        ember_typed_array* typed = AS_TYPED_ARRAY(*array_value);
+        int index = ember_number_index(index_value, typed->length);
+        if (index < 0) return VM_RESULT_CONTINUE;
+        *array_value = ember_make_number(ember_typed_array_load(typed, index));
+        vm->stack_top--;
+        return VM_RESULT_OK;
+    }
+    if (array_value->type != EMBER_VAL_ARRAY || !array_value->as.obj_val ||
+        index_value->type != EMBER_VAL_NUMBER) {
+        return dequicken(chunk, instruction);
+    }
+    ember_array* array = AS_ARRAY(*array_value);
+    // Out of range or fractional indices keep the generic opcode's behavior;
+    // the types were still right, so the site stays quickened
+    int index = ember_number_index(index_value, array->length);
+    if (index < 0) return VM_RESULT_CONTINUE;
+    *array_value = array->elements[index];
+    vm->stack_top--;
+    return VM_RESULT_OK;
+}
+
+// VM operation handler for the quickened opcodes
+vm_operation_result vm_handle_quickened(ember_vm* vm, ember_chunk* chunk, uint8_t* instruction) {
+    // Underflow is reported by the generic opcode
+    if (vm->stack_top < 2) return VM_RESULT_CONTINUE;
+    uint8_t op = *instruction;
+    if (op == OP_ARRAY_GET_NUMBER_INDEX) return array_get_number_index(vm, chunk, instruction);
+
+    ember_value* left = &vm->stack[vm->stack_top - 2];
+    const ember_value* right = &vm->stack[vm->stack_top - 1];
+    if (left->type != EMBER_VAL_NUMBER || right->type != EMBER_VAL_NUMBER) {
+        return dequicken(chunk, instruction);
+    }
+    int32_t small;
+    if (left->as.number.is_small && right->as.number.is_small &&
+        ember_small_int_arith(op, left->as.number.small, right->as.number.small, &small)) {
+        *left = ember_make_int(small);
+        vm->stack_top--;
+        return VM_RESULT_OK;
+    }
+    double a = left->as.number_val;
+    double b = right->as.number_val;
+    switch (op) {
+        case OP_ADD_NUMBER: *left = ember_make_number(a + b); break;
+        case OP_SUB_NUMBER: *left = ember_make_number(a - b); break;
+        case OP_MUL_NUMBER: *left = ember_make_number(a * b); break;
+        case OP_DIV_NUMBER:
+            // Division by zero is the generic opcode's to report
+            if (b == 0) return VM_RESULT_CONTINUE;
+            *left = ember_make_number(a / b);
+            break;
+        case OP_MOD_NUMBER:
+            if (b == 0) return VM_RESULT_CONTINUE;
+            *left = ember_make_number(fmod(a, b));
+            break;
+        case OP_LESS_NUMBER:          *left = ember_make_bool(a < b); break;
+        case OP_LESS_EQUAL_NUMBER:    *left = ember_make_bool(a <= b); break;
+        case OP_GREATER_NUMBER:       *left = ember_make_bool(a > b); break;
+        case OP_GREATER_EQUAL_NUMBER: *left = ember_make_bool(a >= b); break;
+        default:
+            return dequicken(chunk, instruction);
+    }
+    vm->stack_top--;
+    return VM_RESULT_OK;
+}
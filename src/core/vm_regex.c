@@ -1,16 +1,337 @@
+#define _GNU_SOURCE
 #include "vm_regex.h"
 #include "ember.h"
 #include "../vm.h"
 #include "../runtime/value/value.h"
 #include "error.h"
+#include "regex_linear.h"
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <regex.h>
 
+#define REGEX_CACHE_SIZE 64
+#define REGEX_COMPILE_FLAGS (REGEX_CASE_INSENSITIVE | REGEX_MULTILINE | REGEX_LINEAR)
+
+// A compiled pattern. Regex objects made from the same pattern and compile
+// flags share one, found through the VM's cache, so a regex literal in a
+// loop compiles once. Freed when the cache and the last object let go
+struct regex_program {
+    char* pattern;
+    int cflags;                  // REGEX_COMPILE_FLAGS bits it was compiled with
+    uint32_t hash;
+    regex_linear* linear;        // The linear-time engine's form, or NULL for regexec
+    regex_t compiled;            // Unused with linear
+    char* required;              // Bytes every match contains, or NULL
+    size_t required_length;
+    bool anchored;               // ...as the text's prefix (a leading ^)
+    int refs;
+    uint64_t last_used;          // Cache clock at the last lookup
+};
+
+typedef struct ember_regex_cache {
+    regex_program* entries[REGEX_CACHE_SIZE];
+    int count;
+    uint64_t clock;
+} ember_regex_cache;
+
+static uint32_t pattern_hash(const char* pattern, int cflags) {
+    uint32_t hash = 2166136261u ^ (uint32_t)cflags;
+    for (const unsigned char* p = (const unsigned char*)pattern; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+// Past a bracket expression starting at p ('['), or NULL if unterminated
+static const char* skip_bracket(const char* p) {
+    p++;
+    if (*p == '^') p++;
+    if (*p == ']') p++;
+    while (*p && *p != ']') {
+        if (p[0] == '[' && (p[1] == ':' || p[1] == '.' || p[1] == '=')) {
+            char close = p[1];
+            p += 2;
+            while (*p && !(p[0] == close && p[1] == ']')) p++;
+            if (!*p) return NULL;
+            p += 2;
+        } else {
+            p++;
+        }
+    }
+    return *p ? p + 1 : NULL;
+}
+
+// Past a quantifier at p, or p; *optional when it allows zero repetitions
+static const char* skip_quantifier(const char* p, bool* optional) {
+    *optional = false;
+    if (*p == '*' || *p == '?') {
+        *optional = true;
+        return p + 1;
+    }
+    if (*p == '+') return p + 1;
+    if (*p == '{') {
+        const char* q = p + 1;
+        int min = 0;
+        while (*q >= '0' && *q <= '9') min = min * 10 + (*q++ - '0');
+        while (*q && *q != '}') q++;
+        if (!*q) return p;
+        *optional = min == 0;
+        return q + 1;
+    }
+    return p;
+}
+
+// Finds the longest run of literal bytes that every match of an ERE must
+// contain, so texts without it are rejected before regexec. Conservative:
+// a top-level alternation gives nothing, groups, classes, '.' and anything
+// non-ASCII end a run, and a byte made optional by its quantifier is dropped
+static void extract_required(regex_program* program) {
+    const char* pattern = program->pattern;
+    size_t pattern_length = strlen(pattern);
+    char* run = malloc(pattern_length + 1);
+    char* best = malloc(pattern_length + 1);
+    if (!run || !best) {
+        free(run);
+        free(best);
+        return;
+    }
+    size_t run_length = 0, best_length = 0;
+    bool run_anchored = false, best_anchored = false;
+    bool failed = false;
+    const char* p = pattern;
+    if (*p == '^') {
+        run_anchored = !(program->cflags & REGEX_MULTILINE);
+        p++;
+    }
+
+    while (*p && !failed) {
+        int byte = -1;
+        const char* next = p + 1;
+        if (*p == '|') {
+            failed = true;
+            break;
+        } else if (*p == '(') {
+            int depth = 1;
+            next = p + 1;
+            while (*next && depth > 0) {
+                if (*next == '\\' && next[1]) next += 2;
+                else if (*next == '[') {
+                    next = skip_bracket(next);
+                    if (!next) break;
+                } else {
+                    if (*next == '(') depth++;
+                    else if (*next == ')') depth--;
+                    next++;
+                }
+            }
+            if (!next || depth > 0) failed = true;
+        } else if (*p == '[') {
+            next = skip_bracket(p);
+            if (!next) failed = true;
+        } else if (*p == '\\') {
+            if (!p[1]) {
+                failed = true;
+            } else {
+                // Escaped punctuation is itself; escaped letters are classes
+                // and \< \> \` \' are glibc anchors
+                if (!((p[1] >= 'a' && p[1] <= 'z') || (p[1] >= 'A' && p[1] <= 'Z') ||
+                      (p[1] >= '0' && p[1] <= '9') || (unsigned char)p[1] >= 0x80 || strchr("<>`'", p[1]))) {
+                    byte = (unsigned char)p[1];
+                }
+                next = p + 2;
+            }
+        } else if (*p != '.' && *p != '^' && *p != '$' && *p != '*' && *p != '+' &&
+                   *p != '?' && *p != '{' && *p != ')' && (unsigned char)*p < 0x80) {
+            byte = (unsigned char)*p;
+        }
+        if (failed) break;
+
+        bool optional;
+        const char* after = skip_quantifier(next, &optional);
+        bool repeated = after != next;
+        if (byte >= 0 && !optional) run[run_length++] = (char)byte;
+        if (byte < 0 || repeated) {
+            // The run ends here; the byte before a + or {n} still counts
+            if (run_length > best_length) {
+                memcpy(best, run, run_length);
+                best_length = run_length;
+                best_anchored = run_anchored;
+            }
+            run_length = 0;
+            run_anchored = false;
+        }
+        p = after;
+    }
+    if (!failed && run_length > best_length) {
+        memcpy(best, run, run_length);
+        best_length = run_length;
+        best_anchored = run_anchored;
+    }
+    free(run);
+
+    if (failed || best_length == 0) {
+        free(best);
+        return;
+    }
+    best[best_length] = '\0';
+    program->required = best;
+    program->required_length = best_length;
+    program->anchored = best_anchored;
+}
+
+static regex_program* regex_compile(const char* pattern, int cflags, int* error) {
+    regex_program* program = calloc(1, sizeof(regex_program));
+    if (!program) {
+        *error = REG_ESPACE;
+        return NULL;
+    }
+    program->pattern = malloc(strlen(pattern) + 1);
+    if (!program->pattern) {
+        free(program);
+        *error = REG_ESPACE;
+        return NULL;
+    }
+    strcpy(program->pattern, pattern);
+    program->cflags = cflags;
+    program->hash = pattern_hash(pattern, cflags);
+
+    int posix_flags = REG_EXTENDED;
+    if (cflags & REGEX_CASE_INSENSITIVE) {
+        posix_flags |= REG_ICASE;
+    }
+    if (cflags & REGEX_MULTILINE) {
+        posix_flags |= REG_NEWLINE;
+    }
+    // Linear matching where asked for and the pattern is within its syntax
+    *error = 0;
+    if (cflags & REGEX_LINEAR) {
+        program->linear = regex_linear_compile(pattern, (cflags & REGEX_CASE_INSENSITIVE) != 0,
+                                               (cflags & REGEX_MULTILINE) != 0);
+    }
+    if (!program->linear) {
+        *error = regcomp(&program->compiled, pattern, posix_flags);
+    }
+    if (*error != 0) {
+        free(program->pattern);
+        free(program);
+        return NULL;
+    }
+    // A literal would need folding to prefilter case-insensitive input
+    if (!(cflags & REGEX_CASE_INSENSITIVE)) {
+        extract_required(program);
+    }
+    program->refs = 1;
+    return program;
+}
+
+void regex_program_release(regex_program* program) {
+    if (!program || --program->refs > 0) return;
+    if (program->linear) {
+        regex_linear_free(program->linear);
+    } else {
+        regfree(&program->compiled);
+    }
+    free(program->required);
+    free(program->pattern);
+    free(program);
+}
+
+// The program for (pattern, cflags) with a reference for the caller, from
+// the cache or compiled into it, evicting the least recently used entry
+static regex_program* regex_program_for(ember_vm* vm, const char* pattern, int cflags, int* error) {
+    ember_regex_cache* cache = vm->regex_cache;
+    if (!cache) {
+        cache = calloc(1, sizeof(ember_regex_cache));
+        vm->regex_cache = cache;
+    }
+    uint32_t hash = pattern_hash(pattern, cflags);
+    if (cache) {
+        cache->clock++;
+        for (int i = 0; i < cache->count; i++) {
+            regex_program* program = cache->entries[i];
+            if (program->hash == hash && program->cflags == cflags && strcmp(program->pattern, pattern) == 0) {
+                program->last_used = cache->clock;
+                program->refs++;
+                return program;
+            }
+        }
+    }
+
+    regex_program* program = regex_compile(pattern, cflags, error);
+    if (!program || !cache) return program;
+    int slot = cache->count;
+    if (slot == REGEX_CACHE_SIZE) {
+        slot = 0;
+        for (int i = 1; i < cache->count; i++) {
+            if (cache->entries[i]->last_used < cache->entries[slot]->last_used) slot = i;
+        }
+        regex_program_release(cache->entries[slot]);
+    } else {
+        cache->count++;
+    }
+    program->last_used = cache->clock;
+    program->refs++;
+    cache->entries[slot] = program;
+    return program;
+}
+
+void regex_cache_free(ember_vm* vm) {
+    ember_regex_cache* cache = vm->regex_cache;
+    if (!cache) return;
+    for (int i = 0; i < cache->count; i++) {
+        regex_program_release(cache->entries[i]);
+    }
+    free(cache);
+    vm->regex_cache = NULL;
+}
+
+// Whether text from from on can match at all: false only when it lacks the
+// required literal. Case-insensitive programs have none (see regex_compile)
+static bool regex_may_match(const regex_program* program, const char* text, size_t length, size_t from) {
+    if (from > length) return false;
+    if (!program->required) return true;
+    if (program->anchored) {
+        // ^ cannot match past the start
+        return from == 0 && length >= program->required_length &&
+               memcmp(text, program->required, program->required_length) == 0;
+    }
+    return memmem(text + from, length - from, program->required, program->required_length) != NULL;
+}
+
+// The first match in text at or after from, through whichever engine
+// compiled the program, with offsets into text (nmatch >= 1). The bytes
+// before from are context, so ^ only matches there after a newline
+static bool regex_find(const regex_program* program, const char* text, size_t length, size_t from,
+                       size_t nmatch, regmatch_t* matches) {
+    if (!regex_may_match(program, text, length, from)) return false;
+    if (program->linear) {
+        return regex_linear_exec(program->linear, text, length, from, nmatch, matches);
+    }
+    matches[0].rm_so = (regoff_t)from;
+    matches[0].rm_eo = (regoff_t)length;
+    return regexec(&program->compiled, text, nmatch, matches, REG_STARTEND) == 0;
+}
+
 // Create a new regex object
 ember_value ember_make_regex(ember_vm* vm, const char* pattern, ember_regex_flags flags) {
+    int cflags = (int)(flags & REGEX_COMPILE_FLAGS);
+#ifdef EMBER_LINEAR_REGEX
+    cflags |= REGEX_LINEAR;
+#endif
+    int result;
+    regex_program* program = regex_program_for(vm, pattern, cflags, &result);
+    if (!program) {
+        ember_error* error = result == REG_ESPACE
+            ? ember_error_memory("Failed to allocate compiled regex")
+            : ember_error_runtime(vm, "Invalid regex pattern");
+        ember_vm_set_error(vm, error);
+        return ember_make_nil();
+    }
+
     ember_regex* regex = (ember_regex*)malloc(sizeof(ember_regex));
     if (!regex) {
+        regex_program_release(program);
         ember_error* error = ember_error_memory("Failed to allocate regex object");
         ember_vm_set_error(vm, error);
         return ember_make_nil();
@@ -18,60 +339,25 @@ ember_value ember_make_regex(ember_vm* vm, const char* pattern, ember_regex_flag
     
     regex->obj.type = OBJ_REGEX;
     regex->obj.is_marked = 0;
+    regex->obj.is_old = 0;
+    regex->obj.in_slab = 0;
+    regex->obj.is_remembered = 0;
     regex->obj.next = vm->objects;
     vm->objects = (ember_object*)regex;
     
-    // Copy pattern
-    regex->pattern = (char*)malloc(strlen(pattern) + 1);
-    if (!regex->pattern) {
-        free(regex);
-        ember_error* error = ember_error_memory("Failed to allocate regex pattern");
-        ember_vm_set_error(vm, error);
-        return ember_make_nil();
-    }
-    strcpy(regex->pattern, pattern);
-    
+    regex->pattern = program->pattern;
     regex->flags = flags;
     regex->last_index = 0;
-    
-    // Compile the regex using POSIX regex
-    regex_t* compiled = (regex_t*)malloc(sizeof(regex_t));
-    if (!compiled) {
-        free(regex->pattern);
-        free(regex);
-        ember_error* error = ember_error_memory("Failed to allocate compiled regex");
-        ember_vm_set_error(vm, error);
-        return ember_make_nil();
-    }
-    
-    int cflags = REG_EXTENDED;
-    if (flags & REGEX_CASE_INSENSITIVE) {
-        cflags |= REG_ICASE;
-    }
-    if (flags & REGEX_MULTILINE) {
-        cflags |= REG_NEWLINE;
-    }
-    
-    int result = regcomp(compiled, pattern, cflags);
-    if (result != 0) {
-        char error_buffer[256];
-        regerror(result, compiled, error_buffer, sizeof(error_buffer));
-        
-        free(regex->pattern);
-        free(compiled);
-        free(regex);
-        
-        ember_error* error = ember_error_runtime(vm, "Invalid regex pattern");
-        ember_vm_set_error(vm, error);
-        return ember_make_nil();
-    }
-    
-    regex->compiled_regex = compiled;
-    regex->groups = (ember_array*)ember_make_array(vm, 10).as.obj_val;
+    regex->compiled_regex = program;
+    regex->groups = NULL;
     
     ember_value regex_val;
     regex_val.type = EMBER_VAL_REGEX;
     regex_val.as.obj_val = (ember_object*)regex;
+    // Rooted while the groups array allocates
+    vm->stack[vm->stack_top++] = regex_val;
+    regex->groups = (ember_array*)ember_make_array(vm, 10).as.obj_val;
+    vm->stack_top--;
     return regex_val;
 }
 
@@ -82,11 +368,55 @@ bool ember_regex_test(ember_vm* vm, ember_regex* regex, const char* text) {
         return false;
     }
     
-    regex_t* compiled = (regex_t*)regex->compiled_regex;
+    regex_program* program = (regex_program*)regex->compiled_regex;
+    size_t length = strlen(text);
+    if (program->linear) {
+        // Only whether, so the DFA rather than positions
+        return regex_may_match(program, text, length, 0) && regex_linear_search(program->linear, text, length);
+    }
     regmatch_t match;
+    return regex_find(program, text, length, 0, 1, &match);
+}
+
+// A match record, { match, index, length, groups }, for the match in
+// matches
+static ember_value match_record(ember_vm* vm, const char* text, const regmatch_t* matches) {
+    ember_value record = ember_make_hash_map(vm, 4);
+    if (record.type != EMBER_VAL_HASH_MAP) return ember_make_nil();
+    vm->stack[vm->stack_top++] = record;
+    ember_hash_map* map = AS_HASH_MAP(record);
+    
+    // Strings stay rooted on the stack until they are in the map
+    int match_len = (int)(matches[0].rm_eo - matches[0].rm_so);
+    ember_value fields[4];
+    fields[0].type = EMBER_VAL_STRING;
+    fields[0].as.obj_val = (ember_object*)copy_string(vm, text + matches[0].rm_so, match_len);
+    if (!fields[0].as.obj_val) {
+        vm->stack_top--;
+        return ember_make_nil();
+    }
+    vm->stack[vm->stack_top++] = fields[0];
+    fields[1] = ember_make_number(matches[0].rm_so);
+    fields[2] = ember_make_number(match_len);
+    
+    // Capture groups
+    fields[3] = ember_make_array(vm, 10);
+    vm->stack[vm->stack_top++] = fields[3];
+    for (int i = 1; i < 10 && matches[i].rm_so != -1; i++) {
+        ember_value group;
+        group.type = EMBER_VAL_STRING;
+        group.as.obj_val = (ember_object*)copy_string(vm, text + matches[i].rm_so,
+                                                      (int)(matches[i].rm_eo - matches[i].rm_so));
+        if (group.as.obj_val) array_push_with_vm(vm, AS_ARRAY(fields[3]), group);
+    }
     
-    int result = regexec(compiled, text, 1, &match, 0);
-    return result == 0;
+    static const char* names[4] = {"match", "index", "length", "groups"};
+    for (int i = 0; i < 4; i++) {
+        ember_value key = ember_make_string_gc(vm, names[i]);
+        hash_map_set_with_vm(vm, map, key, fields[i]);
+    }
+    vm->stack_top -= 3;
+    return record;
 }
 
 // Get match details from regex
@@ -95,11 +425,8 @@ ember_value ember_regex_match_function(ember_vm* vm, ember_regex* regex, const c
         return ember_make_nil();
     }
     
-    regex_t* compiled = (regex_t*)regex->compiled_regex;
     regmatch_t matches[10]; // Support up to 10 capture groups
-    
-    int result = regexec(compiled, text, 10, matches, 0);
-    if (result != 0) {
+    if (!regex_find(regex->compiled_regex, text, strlen(text), 0, 10, matches)) {
         return ember_make_nil(); // No match
     }
     
@@ -108,90 +435,102 @@ ember_value ember_regex_match_function(ember_vm* vm, ember_regex* regex, const c
         regex->groups->length = 0;
     }
     
-    // Create match result object
-    ember_value match_obj = ember_make_hash_map(vm, 4);
-    ember_hash_map* map = AS_HASH_MAP(match_obj);
-    
-    // Add match information
-    ember_value match_key = ember_make_string_gc(vm, "match");
-    int match_len = matches[0].rm_eo - matches[0].rm_so;
-    char* match_str = (char*)malloc(match_len + 1);
-    if (match_str) {
-        strncpy(match_str, text + matches[0].rm_so, match_len);
-        match_str[match_len] = '\0';
-        ember_value match_val = ember_make_string_gc(vm, match_str);
-        hash_map_set_with_vm(vm, map, match_key, match_val);
-        free(match_str);
+    return match_record(vm, text, matches);
+}
+
+// The next match at or after *offset, and where the one after it is looked
+// for; *offset ends up past length when there are no more
+static bool regex_find_from(ember_regex* regex, const char* text, size_t length, size_t* offset,
+                            regmatch_t* matches) {
+    if (!regex || !regex->compiled_regex || !text) return false;
+    if (!regex_find(regex->compiled_regex, text, length, *offset, 10, matches)) {
+        *offset = length + 1;
+        return false;
     }
-    
-    ember_value index_key = ember_make_string_gc(vm, "index");
-    ember_value index_val = ember_make_number(matches[0].rm_so);
-    hash_map_set_with_vm(vm, map, index_key, index_val);
-    
-    ember_value length_key = ember_make_string_gc(vm, "length");
-    ember_value length_val = ember_make_number(match_len);
-    hash_map_set_with_vm(vm, map, length_key, length_val);
-    
-    // Add capture groups
-    ember_value groups_array = ember_make_array(vm, 10);
-    ember_array* groups = AS_ARRAY(groups_array);
-    
-    for (int i = 1; i < 10 && matches[i].rm_so != -1; i++) {
-        int group_len = matches[i].rm_eo - matches[i].rm_so;
-        char* group_str = (char*)malloc(group_len + 1);
-        if (group_str) {
-            strncpy(group_str, text + matches[i].rm_so, group_len);
-            group_str[group_len] = '\0';
-            ember_value group_val = ember_make_string_gc(vm, group_str);
-            array_push(groups, group_val);
-            free(group_str);
+    // Past an empty match by one byte, so the same one is not found again
+    size_t end = (size_t)matches[0].rm_eo;
+    *offset = matches[0].rm_so == matches[0].rm_eo ? end + 1 : end;
+    return true;
+}
+
+ember_value ember_regex_next_match(ember_vm* vm, ember_regex* regex, const char* text, size_t length,
+                                   size_t* offset) {
+    regmatch_t matches[10];
+    if (!regex_find_from(regex, text, length, offset, matches)) return ember_make_nil();
+    return match_record(vm, text, matches);
+}
+
+bool ember_regex_has_match_from(ember_regex* regex, const char* text, size_t length, size_t offset) {
+    regmatch_t matches[10];
+    return regex_find_from(regex, text, length, &offset, matches);
+}
+
+// Appends replacement with $0-$9 and $& replaced by the match and its
+// groups, and $$ by a single $
+static bool append_replacement(ember_string_builder* builder, const char* replacement, size_t replacement_len,
+                               const char* text, const regmatch_t* matches) {
+    size_t start = 0;
+    for (size_t i = 0; i + 1 < replacement_len; i++) {
+        if (replacement[i] != '$') continue;
+        char next = replacement[i + 1];
+        int group = next == '&' ? 0 : (next >= '0' && next <= '9') ? next - '0' : -1;
+        if (group < 0 && next != '$') continue;
+        if (!string_builder_append(builder, replacement + start, i - start)) return false;
+        if (next == '$') {
+            if (!string_builder_append(builder, "$", 1)) return false;
+        } else if (matches[group].rm_so >= 0) {
+            if (!string_builder_append(builder, text + matches[group].rm_so,
+                                       (size_t)(matches[group].rm_eo - matches[group].rm_so))) {
+                return false;
+            }
         }
+        start = i + 2;
+        i++;
     }
-    
-    ember_value groups_key = ember_make_string_gc(vm, "groups");
-    hash_map_set_with_vm(vm, map, groups_key, groups_array);
-    
-    return match_obj;
+    return string_builder_append(builder, replacement + start, replacement_len - start);
 }
 
-// Replace matches in string with replacement
+// Replace the first match, or with REGEX_GLOBAL every match, in one pass
+// into one buffer; replacement may refer to groups as $1 and so on
 ember_value ember_regex_replace(ember_vm* vm, ember_regex* regex, const char* text, const char* replacement) {
     if (!regex || !regex->compiled_regex || !text || !replacement) {
         return ember_make_string_gc(vm, text ? text : "");
     }
     
-    regex_t* compiled = (regex_t*)regex->compiled_regex;
-    
-    // Simple implementation - find first match and replace
-    regmatch_t match;
-    int result = regexec(compiled, text, 1, &match, 0);
-    
-    if (result != 0) {
+    size_t length = strlen(text);
+    size_t replacement_len = strlen(replacement);
+    bool global = (regex->flags & REGEX_GLOBAL) != 0;
+    regmatch_t matches[10];
+    size_t offset = 0, copied = 0;
+    ember_string_builder builder = {0};
+    bool ok = true, replaced = false;
+    while (ok && regex_find_from(regex, text, length, &offset, matches)) {
+        // The text since the last match, then the replacement
+        size_t start = (size_t)matches[0].rm_so;
+        ok = string_builder_append(&builder, text + copied, start - copied) &&
+             append_replacement(&builder, replacement, replacement_len, text, matches);
+        copied = (size_t)matches[0].rm_eo;
+        replaced = true;
+        if (!global) break;
+    }
+    if (ok && !replaced) {
         // No match, return original string
         return ember_make_string_gc(vm, text);
     }
-    
-    // Calculate result string length
-    int text_len = strlen(text);
-    int replacement_len = strlen(replacement);
-    int match_len = match.rm_eo - match.rm_so;
-    int result_len = text_len - match_len + replacement_len;
-    
-    char* result_str = (char*)malloc(result_len + 1);
-    if (!result_str) {
+    ember_string* result = NULL;
+    if (ok && string_builder_append(&builder, text + copied, length - copied)) {
+        result = string_builder_take(vm, &builder);
+    }
+    string_builder_reset(&builder);
+    if (!result) {
         ember_error* error = ember_error_memory("Failed to allocate replacement string");
         ember_vm_set_error(vm, error);
         return ember_make_nil();
     }
     
-    // Build result string: before_match + replacement + after_match
-    strncpy(result_str, text, match.rm_so);
-    strcpy(result_str + match.rm_so, replacement);
-    strcpy(result_str + match.rm_so + replacement_len, text + match.rm_eo);
-    
-    ember_value result_val = ember_make_string_gc(vm, result_str);
-    free(result_str);
-    
+    ember_value result_val;
+    result_val.type = EMBER_VAL_STRING;
+    result_val.as.obj_val = (ember_object*)result;
     return result_val;
 }
 
@@ -204,46 +543,51 @@ ember_value ember_regex_split(ember_vm* vm, ember_regex* regex, const char* text
         return result;
     }
     
-    regex_t* compiled = (regex_t*)regex->compiled_regex;
     ember_value result = ember_make_array(vm, 10);
+    vm->stack[vm->stack_top++] = result;
     ember_array* array = AS_ARRAY(result);
     
-    const char* current = text;
-    regmatch_t match;
-    
-    while (regexec(compiled, current, 1, &match, 0) == 0) {
+    size_t length = strlen(text);
+    size_t offset = 0, copied = 0;
+    regmatch_t matches[10];
+    while (regex_find_from(regex, text, length, &offset, matches)) {
         // Add text before match
-        if (match.rm_so > 0) {
-            char* part = (char*)malloc(match.rm_so + 1);
-            if (part) {
-                strncpy(part, current, match.rm_so);
-                part[match.rm_so] = '\0';
-                array_push(array, ember_make_string_gc(vm, part));
-                free(part);
-            }
+        size_t start = (size_t)matches[0].rm_so;
+        if (start > copied) {
+            ember_value part;
+            part.type = EMBER_VAL_STRING;
+            part.as.obj_val = (ember_object*)copy_string(vm, text + copied, (int)(start - copied));
+            if (part.as.obj_val) array_push_with_vm(vm, array, part);
         }
-        
         // Move past the match
-        current += match.rm_eo;
-        
-        // Prevent infinite loop on zero-length matches
-        if (match.rm_so == match.rm_eo) {
-            if (*current != '\0') {
-                current++;
-            } else {
-                break;
-            }
-        }
+        copied = (size_t)matches[0].rm_eo;
     }
     
     // Add remaining text
-    if (*current != '\0') {
-        array_push(array, ember_make_string_gc(vm, current));
+    if (copied < length) {
+        ember_value part;
+        part.type = EMBER_VAL_STRING;
+        part.as.obj_val = (ember_object*)copy_string(vm, text + copied, (int)(length - copied));
+        if (part.as.obj_val) array_push_with_vm(vm, array, part);
     }
     
+    vm->stack_top--;
     return result;
 }
 
+// regex_match_all(regex, text): an iterator over the match records of
+// every match in text, each found when the loop asks for it
+ember_value ember_native_regex_match_all(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 2 || argv[0].type != EMBER_VAL_REGEX || argv[1].type != EMBER_VAL_STRING) {
+        return ember_make_nil();
+    }
+    ember_value iterator = ember_make_iterator(vm, argv[1], ITERATOR_REGEX);
+    if (iterator.type != EMBER_VAL_ITERATOR) return iterator;
+    AS_ITERATOR(iterator)->regex = argv[0];
+    AS_ITERATOR(iterator)->vm = vm;
+    return iterator;
+}
+
 // VM operation handlers
 vm_operation_result vm_handle_regex_new(ember_vm* vm) {
     if (vm->stack_top < 2) {
@@ -266,7 +610,7 @@ vm_operation_result vm_handle_regex_new(ember_vm* vm) {
         flags = (ember_regex_flags)(int)AS_NUMBER(flags_val);
     }
     
-    ember_value regex = ember_make_regex(vm, AS_STRING(pattern_val)->chars, flags);
+    ember_value regex = ember_make_regex(vm, AS_CSTRING(pattern_val), flags);
     vm->stack[vm->stack_top++] = regex;
     return VM_RESULT_OK;
 }
@@ -278,8 +622,9 @@ vm_operation_result vm_handle_regex_test(ember_vm* vm) {
         return VM_RESULT_ERROR;
     }
     
-    ember_value text_val = vm->stack[--vm->stack_top];
-    ember_value regex_val = vm->stack[--vm->stack_top];
+    // Left on the stack, so they stay rooted while the result allocates
+    ember_value text_val = vm->stack[vm->stack_top - 1];
+    ember_value regex_val = vm->stack[vm->stack_top - 2];
     
     if (!IS_REGEX(regex_val) || !IS_STRING(text_val)) {
         ember_error* error = ember_error_runtime(vm, "Invalid arguments for regex test");
@@ -287,7 +632,8 @@ vm_operation_result vm_handle_regex_test(ember_vm* vm) {
         return VM_RESULT_ERROR;
     }
     
-    bool matches = ember_regex_test(vm, AS_REGEX(regex_val), AS_STRING(text_val)->chars);
+    bool matches = ember_regex_test(vm, AS_REGEX(regex_val), AS_CSTRING(text_val));
+    vm->stack_top -= 2;
     vm->stack[vm->stack_top++] = ember_make_bool(matches);
     return VM_RESULT_OK;
 }
@@ -299,8 +645,9 @@ vm_operation_result vm_handle_regex_match(ember_vm* vm) {
         return VM_RESULT_ERROR;
     }
     
-    ember_value text_val = vm->stack[--vm->stack_top];
-    ember_value regex_val = vm->stack[--vm->stack_top];
+    // Left on the stack, so they stay rooted while the result allocates
+    ember_value text_val = vm->stack[vm->stack_top - 1];
+    ember_value regex_val = vm->stack[vm->stack_top - 2];
     
     if (!IS_REGEX(regex_val) || !IS_STRING(text_val)) {
         ember_error* error = ember_error_runtime(vm, "Invalid arguments for regex match");
@@ -308,7 +655,8 @@ vm_operation_result vm_handle_regex_match(ember_vm* vm) {
         return VM_RESULT_ERROR;
     }
     
-    ember_value match_result = ember_regex_match_function(vm, AS_REGEX(regex_val), AS_STRING(text_val)->chars);
+    ember_value match_result = ember_regex_match_function(vm, AS_REGEX(regex_val), AS_CSTRING(text_val));
+    vm->stack_top -= 2;
     vm->stack[vm->stack_top++] = match_result;
     return VM_RESULT_OK;
 }
@@ -321,8 +669,9 @@ vm_operation_result vm_handle_regex_replace(ember_vm* vm) {
     }
     
     ember_value replacement_val = vm->stack[--vm->stack_top];
-    ember_value text_val = vm->stack[--vm->stack_top];
-    ember_value regex_val = vm->stack[--vm->stack_top];
+    // Left on the stack, so they stay rooted while the result allocates
+    ember_value text_val = vm->stack[vm->stack_top - 1];
+    ember_value regex_val = vm->stack[vm->stack_top - 2];
     
     if (!IS_REGEX(regex_val) || !IS_STRING(text_val) || !IS_STRING(replacement_val)) {
         ember_error* error = ember_error_runtime(vm, "Invalid arguments for regex replace");
@@ -330,9 +679,9 @@ vm_operation_result vm_handle_regex_replace(ember_vm* vm) {
         return VM_RESULT_ERROR;
     }
     
-    ember_value result = ember_regex_replace(vm, AS_REGEX(regex_val), 
-                                           AS_STRING(text_val)->chars, 
-                                           AS_STRING(replacement_val)->chars);
+    ember_value result = ember_regex_replace(vm, AS_REGEX(regex_val), AS_CSTRING(text_val),
+                                             AS_CSTRING(replacement_val));
+    vm->stack_top -= 3;
     vm->stack[vm->stack_top++] = result;
     return VM_RESULT_OK;
 }
@@ -344,8 +693,9 @@ vm_operation_result vm_handle_regex_split(ember_vm* vm) {
         return VM_RESULT_ERROR;
     }
     
-    ember_value text_val = vm->stack[--vm->stack_top];
-    ember_value regex_val = vm->stack[--vm->stack_top];
+    // Left on the stack, so they stay rooted while the result allocates
+    ember_value text_val = vm->stack[vm->stack_top - 1];
+    ember_value regex_val = vm->stack[vm->stack_top - 2];
     
     if (!IS_REGEX(regex_val) || !IS_STRING(text_val)) {
         ember_error* error = ember_error_runtime(vm, "Invalid arguments for regex split");
@@ -353,7 +703,8 @@ vm_operation_result vm_handle_regex_split(ember_vm* vm) {
         return VM_RESULT_ERROR;
     }
     
-    ember_value result = ember_regex_split(vm, AS_REGEX(regex_val), AS_STRING(text_val)->chars);
+    ember_value result = ember_regex_split(vm, AS_REGEX(regex_val), AS_CSTRING(text_val));
+    vm->stack_top -= 2;
     vm->stack[vm->stack_top++] = result;
     return VM_RESULT_OK;
 }
\ No newline at end of file
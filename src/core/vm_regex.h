@@ -6,12 +6,23 @@
 // Forward declarations
 typedef struct ember_vm ember_vm;
 
+// A compiled pattern, shared through the VM's cache (vm->regex_cache) by
+// every regex object with the same pattern and compile flags
+typedef struct regex_program regex_program;
+
 // Regex creation and manipulation functions
 ember_value ember_make_regex(ember_vm* vm, const char* pattern, ember_regex_flags flags);
 bool ember_regex_test(ember_vm* vm, ember_regex* regex, const char* text);
 ember_value ember_regex_match_function(ember_vm* vm, ember_regex* regex, const char* text);
 ember_value ember_regex_replace(ember_vm* vm, ember_regex* regex, const char* text, const char* replacement);
 ember_value ember_regex_split(ember_vm* vm, ember_regex* regex, const char* text);
+// Match iteration over text: the record of the next match at or after
+// *offset (nil when there is none), moving *offset on past it
+ember_value ember_regex_next_match(ember_vm* vm, ember_regex* regex, const char* text, size_t length,
+                                   size_t* offset);
+bool ember_regex_has_match_from(ember_regex* regex, const char* text, size_t length, size_t offset);
+// Drops one reference to a regex object's compiled_regex; called by the GC
+void regex_program_release(regex_program* program);
 
 // VM operation handlers for regex opcodes
 vm_operation_result vm_handle_regex_new(ember_vm* vm);
@@ -0,0 +1,358 @@
+#define _GNU_SOURCE
+#include "../../include/ember.h"
+#include "../vm.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+// Sampling profiler. A profiling timer (ITIMER_PROF, so it advances with
+// CPU time, not wall time) raises SIGPROF at the requested rate. The signal
+// handler only bumps vm->sample_pending; the dispatch loop sees it before
+// its next instruction (vm_dispatch_profile) and records the Ember stack
+// there, where vm->frames is consistent. Between samples the cost is that
+// one branch per instruction plus a name lookup per call.
+//
+// Each stack is the chunks of vm->frames (outermost first) plus the running
+// chunk, folded into a count per distinct stack. Ticks that arrive while a
+// native function or JIT code runs are charged to the Ember stack when the
+// interpreter next dispatches. ember_vm_write_samples prints the counts in
+// the collapsed-stack format flamegraph.pl, speedscope and inferno read:
+//
+//     <script>;serve;handle_request 412
+//
+// The timer and SIGPROF belong to the process, so one VM samples at a time.
+
+#define SAMPLE_DEFAULT_HZ 99
+#define SAMPLE_MAX_HZ 10000
+#define SAMPLE_MAX_DEPTH 128
+#define SAMPLE_INITIAL_SLOTS 64
+
+typedef struct {
+    const ember_chunk* chunk;
+    char* label;
+} sample_label;
+
+typedef struct {
+    uint32_t hash;
+    int depth;
+    int* frames;                   // Label indices, outermost first
+    uint64_t count;
+} sample_stack;
+
+struct ember_sampler {
+    int hz;
+    uint64_t samples;
+    sample_label* labels;
+    int label_count;
+    int label_capacity;
+    int* label_slots;              // Open addressing on chunk, index + 1
+    int label_slot_capacity;
+    sample_stack* stacks;
+    int stack_count;
+    int stack_capacity;
+    int* stack_slots;              // Open addressing on the stack hash, index + 1
+    int stack_slot_capacity;
+    int truncated;                 // Label of the root that replaces cut-off frames, or -1
+    struct sigaction previous;     // Restored when sampling stops
+};
+
+// The VM SIGPROF is sampling, or NULL
+static ember_vm* volatile sampled_vm;
+
+static void on_sigprof(int signal_number) {
+    (void)signal_number;
+    ember_vm* vm = sampled_vm;
+    if (vm) vm->sample_pending = vm->sample_pending + 1;
+}
+
+static uint32_t hash_pointer(const void* pointer) {
+    uint64_t key = (uint64_t)(uintptr_t)pointer;
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (uint32_t)key;
+}
+
+static char* copy_label(const char* text) {
+    size_t length = strlen(text);
+    char* copy = malloc(length + 1);
+    if (copy) memcpy(copy, text, length + 1);
+    return copy;
+}
+
+// Double an open-addressed index and rehash count entries into it
+static int grow_slots(int** slots, int* capacity, int count, const uint32_t* hashes) {
+    int grown = *capacity ? *capacity * 2 : SAMPLE_INITIAL_SLOTS;
+    int* fresh = calloc((size_t)grown, sizeof(int));
+    if (!fresh) return 0;
+    for (int i = 0; i < count; i++) {
+        uint32_t slot = hashes[i] & (uint32_t)(grown - 1);
+        while (fresh[slot]) slot = (slot + 1) & (uint32_t)(grown - 1);
+        fresh[slot] = i + 1;
+    }
+    free(*slots);
+    *slots = fresh;
+    *capacity = grown;
+    return 1;
+}
+
+// ============================================================================
+// LABELS
+// ============================================================================
+
+// Frame text for a chunk no call has named: top-level code, or a function
+// entered before sampling started
+static char* default_label(const ember_chunk* chunk, int level) {
+    if (chunk->name) return copy_label(chunk->name);
+    if (level == 0) return copy_label("<script>");
+    int line = ember_chunk_line_at(chunk, 0);
+    if (line <= 0) return copy_label("<anonymous>");
+    char text[32];
+    snprintf(text, sizeof(text), "<anonymous:%d>", line);
+    return copy_label(text);
+}
+
+static int find_label(const struct ember_sampler* sampler, const ember_chunk* chunk) {
+    if (!sampler->label_slot_capacity) return -1;
+    uint32_t mask = (uint32_t)sampler->label_slot_capacity - 1;
+    for (uint32_t slot = hash_pointer(chunk) & mask; sampler->label_slots[slot]; slot = (slot + 1) & mask) {
+        int index = sampler->label_slots[slot] - 1;
+        if (sampler->labels[index].chunk == chunk) return index;
+    }
+    return -1;
+}
+
+static int add_label(struct ember_sampler* sampler, const ember_chunk* chunk, char* label) {
+    if (!label) return -1;
+    if ((sampler->label_count + 1) * 2 > sampler->label_slot_capacity) {
+        uint32_t* hashes = malloc(sizeof(uint32_t) * (size_t)(sampler->label_count + 1));
+        int grown = hashes != NULL;
+        for (int i = 0; grown && i < sampler->label_count; i++) hashes[i] = hash_pointer(sampler->labels[i].chunk);
+        grown = grown && grow_slots(&sampler->label_slots, &sampler->label_slot_capacity, sampler->label_count, hashes);
+        free(hashes);
+        if (!grown) {
+            free(label);
+            return -1;
+        }
+    }
+    if (sampler->label_count == sampler->label_capacity) {
+        int capacity = sampler->label_capacity ? sampler->label_capacity * 2 : 16;
+        sample_label* labels = realloc(sampler->labels, sizeof(sample_label) * (size_t)capacity);
+        if (!labels) {
+            free(label);
+            return -1;
+        }
+        sampler->labels = labels;
+        sampler->label_capacity = capacity;
+    }
+    sampler->labels[sampler->label_count].chunk = chunk;
+    sampler->labels[sampler->label_count].label = label;
+    uint32_t mask = (uint32_t)sampler->label_slot_capacity - 1;
+    uint32_t slot = hash_pointer(chunk) & mask;
+    while (sampler->label_slots[slot]) slot = (slot + 1) & mask;
+    sampler->label_slots[slot] = ++sampler->label_count;
+    return sampler->label_count - 1;
+}
+
+void vm_sampler_call(ember_vm* vm, const ember_chunk* chunk, const char* name) {
+    struct ember_sampler* sampler = vm->sampler;
+    if (!sampler || !chunk || !name) return;
+    int index = find_label(sampler, chunk);
+    if (index < 0) {
+        add_label(sampler, chunk, copy_label(name));
+    } else if (sampler->labels[index].label[0] == '<') {
+        // First seen in a sample before any call named it
+        char* named = copy_label(name);
+        if (named) {
+            free(sampler->labels[index].label);
+            sampler->labels[index].label = named;
+        }
+    }
+}
+
+// ============================================================================
+// STACKS
+// ============================================================================
+
+static uint32_t hash_frames(const int* frames, int depth) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < depth; i++) {
+        hash = (hash ^ (uint32_t)frames[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static sample_stack* stack_entry(struct ember_sampler* sampler, const int* frames, int depth) {
+    uint32_t hash = hash_frames(frames, depth);
+    if (sampler->stack_slot_capacity) {
+        uint32_t mask = (uint32_t)sampler->stack_slot_capacity - 1;
+        for (uint32_t slot = hash & mask; sampler->stack_slots[slot]; slot = (slot + 1) & mask) {
+            sample_stack* entry = &sampler->stacks[sampler->stack_slots[slot] - 1];
+            if (entry->hash == hash && entry->depth == depth &&
+                memcmp(entry->frames, frames, sizeof(int) * (size_t)depth) == 0) {
+                return entry;
+            }
+        }
+    }
+
+    if ((sampler->stack_count + 1) * 2 > sampler->stack_slot_capacity) {
+        uint32_t* hashes = malloc(sizeof(uint32_t) * (size_t)(sampler->stack_count + 1));
+        int grown = hashes != NULL;
+        for (int i = 0; grown && i < sampler->stack_count; i++) hashes[i] = sampler->stacks[i].hash;
+        grown = grown && grow_slots(&sampler->stack_slots, &sampler->stack_slot_capacity, sampler->stack_count, hashes);
+        free(hashes);
+        if (!grown) return NULL;
+    }
+    if (sampler->stack_count == sampler->stack_capacity) {
+        int capacity = sampler->stack_capacity ? sampler->stack_capacity * 2 : 64;
+        sample_stack* stacks = realloc(sampler->stacks, sizeof(sample_stack) * (size_t)capacity);
+        if (!stacks) return NULL;
+        sampler->stacks = stacks;
+        sampler->stack_capacity = capacity;
+    }
+    int* copy = malloc(sizeof(int) * (size_t)(depth ? depth : 1));
+    if (!copy) return NULL;
+    memcpy(copy, frames, sizeof(int) * (size_t)depth);
+
+    sample_stack* entry = &sampler->stacks[sampler->stack_count];
+    entry->hash = hash;
+    entry->depth = depth;
+    entry->frames = copy;
+    entry->count = 0;
+    uint32_t mask = (uint32_t)sampler->stack_slot_capacity - 1;
+    uint32_t slot = hash & mask;
+    while (sampler->stack_slots[slot]) slot = (slot + 1) & mask;
+    sampler->stack_slots[slot] = ++sampler->stack_count;
+    return entry;
+}
+
+void vm_sample(ember_vm* vm) {
+    int ticks = vm->sample_pending;
+    vm->sample_pending = 0;
+    struct ember_sampler* sampler = vm->sampler;
+    if (!sampler || !vm->chunk || ticks <= 0) return;
+
+    // Deep recursion keeps its innermost frames under one marker root
+    int levels = vm->frame_count + 1;
+    int first = levels > SAMPLE_MAX_DEPTH ? levels - SAMPLE_MAX_DEPTH + 1 : 0;
+    int frames[SAMPLE_MAX_DEPTH];
+    int depth = 0;
+    if (first > 0) {
+        if (sampler->truncated < 0) sampler->truncated = add_label(sampler, NULL, copy_label("[truncated]"));
+        if (sampler->truncated < 0) return;
+        frames[depth++] = sampler->truncated;
+    }
+    for (int level = first; level < levels; level++) {
+        const ember_chunk* chunk = level < vm->frame_count ? vm->frames[level].chunk : vm->chunk;
+        // An ember_call from C with no script running has no caller chunk
+        if (!chunk) continue;
+        int index = find_label(sampler, chunk);
+        if (index < 0) index = add_label(sampler, chunk, default_label(chunk, level));
+        if (index < 0) return;
+        frames[depth++] = index;
+    }
+
+    sample_stack* entry = stack_entry(sampler, frames, depth);
+    if (!entry) return;
+    entry->count += (uint64_t)ticks;
+    sampler->samples += (uint64_t)ticks;
+}
+
+// ============================================================================
+// API
+// ============================================================================
+
+static void free_sampler(struct ember_sampler* sampler) {
+    if (!sampler) return;
+    for (int i = 0; i < sampler->label_count; i++) free(sampler->labels[i].label);
+    for (int i = 0; i < sampler->stack_count; i++) free(sampler->stacks[i].frames);
+    free(sampler->labels);
+    free(sampler->label_slots);
+    free(sampler->stacks);
+    free(sampler->stack_slots);
+    free(sampler);
+}
+
+int ember_vm_start_sampling(ember_vm* vm, int hz) {
+    if (!vm || hz < 0 || hz > SAMPLE_MAX_HZ) return EMBER_ERROR_INVALID_PARAMETER;
+    if (sampled_vm) return EMBER_ERROR_OPERATION_FAILED;
+
+    struct ember_sampler* sampler = calloc(1, sizeof(struct ember_sampler));
+    if (!sampler) return EMBER_ERROR_MEMORY_ALLOCATION;
+    sampler->hz = hz ? hz : SAMPLE_DEFAULT_HZ;
+    sampler->truncated = -1;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_sigprof;
+    sigemptyset(&action.sa_mask);
+    // Worker I/O must not see EINTR because of the profiler
+    action.sa_flags = SA_RESTART;
+    if (sigaction(SIGPROF, &action, &sampler->previous) != 0) {
+        free_sampler(sampler);
+        return EMBER_ERROR_OPERATION_FAILED;
+    }
+
+    vm_sampler_free(vm);
+    vm->sampler = sampler;
+    vm->sample_pending = 0;
+    sampled_vm = vm;
+
+    struct itimerval timer;
+    long interval = 1000000L / sampler->hz;
+    timer.it_interval.tv_sec = interval / 1000000L;
+    timer.it_interval.tv_usec = interval % 1000000L;
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, NULL) != 0) {
+        sampled_vm = NULL;
+        sigaction(SIGPROF, &sampler->previous, NULL);
+        return EMBER_ERROR_OPERATION_FAILED;
+    }
+    return EMBER_SUCCESS;
+}
+
+int ember_vm_stop_sampling(ember_vm* vm) {
+    if (!vm) return EMBER_ERROR_INVALID_PARAMETER;
+    if (sampled_vm != vm) return EMBER_SUCCESS;
+    struct itimerval off;
+    memset(&off, 0, sizeof(off));
+    setitimer(ITIMER_PROF, &off, NULL);
+    sampled_vm = NULL;
+    sigaction(SIGPROF, &vm->sampler->previous, NULL);
+    // A tick already delivered would otherwise land in the next run
+    vm->sample_pending = 0;
+    return EMBER_SUCCESS;
+}
+
+uint64_t ember_vm_sample_count(ember_vm* vm) {
+    return vm && vm->sampler ? vm->sampler->samples : 0;
+}
+
+void vm_sampler_free(ember_vm* vm) {
+    if (!vm) return;
+    ember_vm_stop_sampling(vm);
+    free_sampler(vm->sampler);
+    vm->sampler = NULL;
+}
+
+int ember_vm_write_samples(ember_vm* vm, const char* path) {
+    struct ember_sampler* sampler = vm ? vm->sampler : NULL;
+    if (!sampler) return EMBER_ERROR_INVALID_PARAMETER;
+    int to_stderr = !path || strcmp(path, "-") == 0;
+    FILE* out = to_stderr ? stderr : fopen(path, "w");
+    if (!out) {
+        fprintf(stderr, "[SAMPLE] Cannot write %s\n", path);
+        return EMBER_ERROR_OPERATION_FAILED;
+    }
+    for (int i = 0; i < sampler->stack_count; i++) {
+        const sample_stack* entry = &sampler->stacks[i];
+        for (int level = 0; level < entry->depth; level++) {
+            fprintf(out, "%s%s", level ? ";" : "", sampler->labels[entry->frames[level]].label);
+        }
+        fprintf(out, " %llu\n", (unsigned long long)entry->count);
+    }
+    if (!to_stderr && fclose(out) != 0) return EMBER_ERROR_OPERATION_FAILED;
+    return EMBER_SUCCESS;
+}
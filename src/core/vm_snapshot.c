@@ -0,0 +1,664 @@
+#define _GNU_SOURCE
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "../runtime/value/value.h"
+#include "../runtime/module_image.h"
+#include "object_shape.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// VM snapshots. ember_vm_snapshot_create freezes an initialized VM as a
+// template; every clone is a fresh VM that runs the template's bytecode in
+// place (borrowed code is never quickened or otherwise written, like a shared
+// module image) and gets its own copy of everything mutable: globals, module
+// exports, and the objects they reach. Objects are copied shell first and
+// filled from a worklist, so cycles and deep structures need no recursion.
+// Only the copying allocates; no collection runs until the clone is whole.
+
+struct ember_vm_snapshot {
+    ember_vm* vm;               // Template; never runs again
+    void** chunks;              // Chunks function values may refer to (open-addressed)
+    int chunk_capacity;         // Power of two
+};
+
+typedef struct {
+    const void* from;
+    void* to;
+} snapshot_copy;
+
+typedef struct {
+    const void* from;
+    void* to;
+    int is_chunk;
+} snapshot_pending;
+
+typedef struct {
+    ember_vm_snapshot* snapshot;
+    ember_vm* vm;
+    snapshot_copy* copies;      // Source object or chunk -> its copy
+    int copy_count;
+    int copy_capacity;          // Power of two
+    snapshot_pending* pending;  // Shells whose contents are not copied yet
+    int pending_count;
+    int pending_capacity;
+} clone_context;
+
+static uint32_t hash_pointer(const void* pointer) {
+    uint64_t bits = (uint64_t)(uintptr_t)pointer;
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdULL;
+    bits ^= bits >> 33;
+    return (uint32_t)bits;
+}
+
+static int chunk_set_insert(ember_vm_snapshot* snapshot, ember_chunk* chunk) {
+    if (!chunk) return 1;
+    int mask = snapshot->chunk_capacity - 1;
+    for (int i = (int)(hash_pointer(chunk) & (uint32_t)mask);; i = (i + 1) & mask) {
+        if (snapshot->chunks[i] == chunk) return 1;
+        if (!snapshot->chunks[i]) {
+            snapshot->chunks[i] = chunk;
+            return 1;
+        }
+    }
+}
+
+static int chunk_set_has(const ember_vm_snapshot* snapshot, const ember_chunk* chunk) {
+    int mask = snapshot->chunk_capacity - 1;
+    for (int i = (int)(hash_pointer(chunk) & (uint32_t)mask); snapshot->chunks[i]; i = (i + 1) & mask) {
+        if (snapshot->chunks[i] == chunk) return 1;
+    }
+    return 0;
+}
+
+static void* copy_find(const clone_context* ctx, const void* from) {
+    if (ctx->copy_capacity == 0) return NULL;
+    int mask = ctx->copy_capacity - 1;
+    for (int i = (int)(hash_pointer(from) & (uint32_t)mask); ctx->copies[i].from; i = (i + 1) & mask) {
+        if (ctx->copies[i].from == from) return ctx->copies[i].to;
+    }
+    return NULL;
+}
+
+static void copy_insert(snapshot_copy* copies, int capacity, const void* from, void* to) {
+    int mask = capacity - 1;
+    int i = (int)(hash_pointer(from) & (uint32_t)mask);
+    while (copies[i].from) i = (i + 1) & mask;
+    copies[i].from = from;
+    copies[i].to = to;
+}
+
+// Records to as the copy of from
+static int copy_record(clone_context* ctx, const void* from, void* to) {
+    if ((ctx->copy_count + 1) * 2 > ctx->copy_capacity) {
+        int capacity = ctx->copy_capacity ? ctx->copy_capacity * 2 : 256;
+        snapshot_copy* copies = calloc((size_t)capacity, sizeof(snapshot_copy));
+        if (!copies) {
+            fprintf(stderr, "[SNAPSHOT] Memory allocation failed for clone\n");
+            return 0;
+        }
+        for (int i = 0; i < ctx->copy_capacity; i++) {
+            if (ctx->copies[i].from) copy_insert(copies, capacity, ctx->copies[i].from, ctx->copies[i].to);
+        }
+        free(ctx->copies);
+        ctx->copies = copies;
+        ctx->copy_capacity = capacity;
+    }
+    copy_insert(ctx->copies, ctx->copy_capacity, from, to);
+    ctx->copy_count++;
+    return 1;
+}
+
+// Records to as the copy of from, and queues it to be filled in
+static int copy_add(clone_context* ctx, const void* from, void* to, int is_chunk) {
+    if (!copy_record(ctx, from, to)) return 0;
+    if (ctx->pending_count == ctx->pending_capacity) {
+        int capacity = ctx->pending_capacity ? ctx->pending_capacity * 2 : 64;
+        snapshot_pending* pending = realloc(ctx->pending, sizeof(snapshot_pending) * (size_t)capacity);
+        if (!pending) {
+            fprintf(stderr, "[SNAPSHOT] Memory allocation failed for clone\n");
+            return 0;
+        }
+        ctx->pending = pending;
+        ctx->pending_capacity = capacity;
+    }
+    ctx->pending[ctx->pending_count].from = from;
+    ctx->pending[ctx->pending_count].to = to;
+    ctx->pending[ctx->pending_count].is_chunk = is_chunk;
+    ctx->pending_count++;
+    return 1;
+}
+
+// The clone's chunk for a template chunk: the same code, its own constants,
+// exception table and (empty) inline caches
+static ember_chunk* clone_chunk(clone_context* ctx, const ember_chunk* chunk) {
+    ember_chunk* copy = copy_find(ctx, chunk);
+    if (copy) return copy;
+    copy = malloc(sizeof(ember_chunk));
+    if (!copy) {
+        fprintf(stderr, "[SNAPSHOT] Memory allocation failed for clone\n");
+        return NULL;
+    }
+    init_chunk(copy);
+    copy->is_generator = chunk->is_generator;
+    if (chunk->count > 0) {
+        copy->code = chunk->code;
+        copy->count = chunk->count;
+        copy->capacity = chunk->count;
+        copy->code_borrowed = 1;
+    }
+    // Owned by the clone from here on, even if cloning fails
+    track_function_chunk(ctx->vm, copy);
+    return copy_add(ctx, chunk, copy, 1) ? copy : NULL;
+}
+
+// An empty object of the same kind, filled in by fill_object
+static ember_object* clone_shell(clone_context* ctx, ember_object* object) {
+    ember_object* copy = copy_find(ctx, object);
+    if (copy) return copy;
+    ember_vm* vm = ctx->vm;
+    switch (object->type) {
+        case OBJ_STRING: {
+            // Flattened when the snapshot was taken; nothing to fill in
+            ember_string* string = (ember_string*)object;
+            ember_string* result = string->is_interned ? intern_string(vm, string->chars, string->length)
+                                                       : copy_string(vm, string->chars, string->length);
+            if (!result || !copy_record(ctx, object, result)) return NULL;
+            return (ember_object*)result;
+        }
+        case OBJ_ARRAY:
+            copy = (ember_object*)allocate_array(vm, ((ember_array*)object)->length);
+            break;
+        case OBJ_HASH_MAP:
+            copy = (ember_object*)allocate_hash_map(vm, ((ember_hash_map*)object)->capacity);
+            break;
+        case OBJ_CLASS: {
+            ember_class* klass = (ember_class*)object;
+            ember_class* result = allocate_class(vm, klass->name ? klass->name->chars : "");
+            if (!result) return NULL;
+            // Sizes the instances copied before the class is filled in
+            result->instance_slots_hint = klass->instance_slots_hint;
+            copy = (ember_object*)result;
+            break;
+        }
+        case OBJ_INSTANCE: {
+            ember_instance* instance = (ember_instance*)object;
+            ember_class* klass = instance->klass ? (ember_class*)clone_shell(ctx, (ember_object*)instance->klass) : NULL;
+            if (instance->klass && !klass) return NULL;
+            copy = (ember_object*)allocate_instance(vm, klass);
+            break;
+        }
+        case OBJ_METHOD:
+            copy = (ember_object*)allocate_bound_method(vm, ember_make_nil(), ember_make_nil());
+            break;
+        case OBJ_SET: {
+            ember_value set = ember_make_set(vm);
+            copy = set.type == EMBER_VAL_SET ? set.as.obj_val : NULL;
+            break;
+        }
+        case OBJ_MAP: {
+            ember_value map = ember_make_map(vm);
+            copy = map.type == EMBER_VAL_MAP ? map.as.obj_val : NULL;
+            break;
+        }
+        case OBJ_STRING_BUILDER: {
+            // Holds bytes only, copied here like a string's
+            ember_string_builder* builder = (ember_string_builder*)object;
+            ember_value result = ember_make_string_builder(vm, builder->length);
+            if (result.type != EMBER_VAL_STRING_BUILDER ||
+                !string_builder_append(AS_STRING_BUILDER(result), builder->chars ? builder->chars : "",
+                                       builder->length)) {
+                return NULL;
+            }
+            copy = result.as.obj_val;
+            break;
+        }
+        case OBJ_CACHE: {
+            ember_value cache = ember_make_cache(vm, ((ember_cache*)object)->max_entries,
+                                                 ((ember_cache*)object)->max_bytes);
+            copy = cache.type == EMBER_VAL_CACHE ? cache.as.obj_val : NULL;
+            break;
+        }
+        case OBJ_DEQUE: {
+            ember_value deque = ember_make_deque(vm, ((ember_deque*)object)->length);
+            copy = deque.type == EMBER_VAL_DEQUE ? deque.as.obj_val : NULL;
+            break;
+        }
+        case OBJ_PRIORITY_QUEUE: {
+            ember_value queue = ember_make_priority_queue(vm, ember_make_nil());
+            copy = queue.type == EMBER_VAL_PRIORITY_QUEUE ? queue.as.obj_val : NULL;
+            break;
+        }
+        case OBJ_WEAK_REF: {
+            ember_value ref = ember_make_weak_ref(vm, ember_make_nil());
+            copy = ref.type == EMBER_VAL_WEAK_REF ? ref.as.obj_val : NULL;
+            break;
+        }
+        case OBJ_WEAK_MAP: {
+            ember_value map = ember_make_weak_map(vm);
+            copy = map.type == EMBER_VAL_WEAK_MAP ? map.as.obj_val : NULL;
+            break;
+        }
+        case OBJ_TYPED_ARRAY: {
+            // Holds numbers only, copied here like a builder's bytes
+            ember_typed_array* array = (ember_typed_array*)object;
+            ember_value result = ember_make_typed_array(vm, array->kind, array->length);
+            if (result.type != EMBER_VAL_TYPED_ARRAY) return NULL;
+            for (int i = 0; i < array->length; i++) {
+                ember_typed_array_store(AS_TYPED_ARRAY(result), i, ember_typed_array_load(array, i));
+            }
+            copy = result.as.obj_val;
+            break;
+        }
+        default:
+            // Exceptions, promises, generators, regexes, iterators,
+            // hashers, files and walkers hold execution state or native resources
+            fprintf(stderr, "[SNAPSHOT] Cannot copy a %s value into a clone\n",
+                    object->type == OBJ_EXCEPTION ? "exception" :
+                    object->type == OBJ_PROMISE ? "promise" :
+                    object->type == OBJ_GENERATOR ? "generator" :
+                    object->type == OBJ_REGEX ? "regex" :
+                    object->type == OBJ_HASHER ? "hasher" :
+                    object->type == OBJ_FILE ? "file" :
+                    object->type == OBJ_WALKER ? "walker" : "iterator");
+            return NULL;
+    }
+    if (!copy) return NULL;
+    return copy_add(ctx, object, copy, 0) ? copy : NULL;
+}
+
+static int clone_value(clone_context* ctx, ember_value value, ember_value* out) {
+    *out = value;
+    switch (value.type) {
+        case EMBER_VAL_NIL:
+        case EMBER_VAL_BOOL:
+        case EMBER_VAL_NUMBER:
+        case EMBER_VAL_NATIVE:
+            return 1;
+        case EMBER_VAL_FUNCTION: {
+            ember_chunk* chunk = value.as.func_val.chunk;
+            if (!chunk) return 1;
+            if (chunk_set_has(ctx->snapshot, chunk)) {
+                // The name stays the template's, like the code
+                out->as.func_val.chunk = clone_chunk(ctx, chunk);
+                return out->as.func_val.chunk != NULL;
+            }
+            if (value.as.obj_val->type != OBJ_METHOD) {
+                fprintf(stderr, "[SNAPSHOT] Function '%s' has no chunk in the snapshot\n",
+                        value.as.func_val.name ? value.as.func_val.name : "?");
+                return 0;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    if (!value.as.obj_val) return 1;
+    out->as.obj_val = clone_shell(ctx, value.as.obj_val);
+    return out->as.obj_val != NULL;
+}
+
+static int fill_hash_map(clone_context* ctx, ember_hash_map* copy, const ember_hash_map* map) {
+    for (int i = 0; map->entries && i < map->capacity; i++) {
+        if (!map->entries[i].is_occupied) continue;
+        ember_value key;
+        ember_value value;
+        if (!clone_value(ctx, map->entries[i].key, &key) || !clone_value(ctx, map->entries[i].value, &value)) {
+            return 0;
+        }
+        hash_map_set(copy, key, value);
+    }
+    return 1;
+}
+
+// Entries are added in insertion order, which the copy then shares
+static int fill_map(clone_context* ctx, ember_map* copy, const ember_map* map) {
+    for (int i = 0; i < map->count; i++) {
+        if (!map->entries[i].is_occupied) continue;
+        ember_value key;
+        ember_value value;
+        if (!clone_value(ctx, map->entries[i].key, &key) || !clone_value(ctx, map->entries[i].value, &value) ||
+            !map_set(copy, key, value)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Entries are put from least to most recently used, so the copy evicts in
+// the same order; deadlines and counters carry over as they were
+static int fill_cache(clone_context* ctx, ember_cache* copy, const ember_cache* cache) {
+    for (ember_cache_entry* entry = cache->oldest; entry; entry = entry->newer) {
+        ember_value key;
+        ember_value value;
+        if (!clone_value(ctx, entry->key, &key) || !clone_value(ctx, entry->value, &value) ||
+            !lru_cache_put(ctx->vm, copy, key, value, 0)) {
+            return 0;
+        }
+        copy->newest->expires_ms = entry->expires_ms;
+    }
+    copy->hits = cache->hits;
+    copy->misses = cache->misses;
+    copy->evictions = cache->evictions;
+    copy->expirations = cache->expirations;
+    return 1;
+}
+
+static int fill_deque(clone_context* ctx, ember_deque* copy, const ember_deque* deque) {
+    for (int i = 0; i < deque->length; i++) {
+        ember_value value;
+        if (!clone_value(ctx, deque_at(deque, i), &value) || !deque_push_back(ctx->vm, copy, value)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// The heap is copied slot for slot rather than pushed again, so a
+// comparator is never called while cloning and ties keep their order
+static int fill_priority_queue(clone_context* ctx, ember_priority_queue* copy,
+                               const ember_priority_queue* queue) {
+    if (!clone_value(ctx, queue->compare, &copy->compare)) return 0;
+    if (queue->length > 0) {
+        copy->items = malloc(sizeof(ember_heap_item) * (size_t)queue->length);
+        if (!copy->items) return 0;
+        copy->capacity = queue->length;
+    }
+    for (int i = 0; i < queue->length; i++) {
+        ember_heap_item* item = &copy->items[i];
+        if (!clone_value(ctx, queue->items[i].value, &item->value) ||
+            !clone_value(ctx, queue->items[i].priority, &item->priority)) {
+            return 0;
+        }
+        item->sequence = queue->items[i].sequence;
+        copy->length = i + 1;
+    }
+    copy->next_sequence = queue->next_sequence;
+    return 1;
+}
+
+// Keys are copied like any other reference, so an entry survives in the
+// clone exactly when its key is reachable there too
+static int fill_weak_map(clone_context* ctx, ember_weak_map* copy, const ember_weak_map* map) {
+    for (int i = 0; i < map->capacity; i++) {
+        ember_weak_entry* entry = &map->entries[i];
+        if (entry->key.type == EMBER_VAL_NIL) continue;
+        ember_value key;
+        ember_value value;
+        if (!clone_value(ctx, entry->key, &key) || !clone_value(ctx, entry->value, &value) ||
+            !weak_map_set(ctx->vm, copy, key, value)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int fill_chunk(clone_context* ctx, ember_chunk* copy, const ember_chunk* chunk) {
+    for (int i = 0; i < chunk->const_count; i++) {
+        ember_value value;
+        // Slots must line up with the code's operands
+        if (!clone_value(ctx, chunk->constants[i], &value) || add_constant(copy, value) != i) return 0;
+    }
+    for (int i = 0; i < chunk->handler_count; i++) {
+        if (ember_chunk_add_handler(copy, &chunk->handlers[i]) < 0) return 0;
+    }
+    for (int i = 0; i < chunk->switch_table_count; i++) {
+        const ember_switch_table* table = &chunk->switch_tables[i];
+        int index = ember_chunk_add_switch_table(copy);
+        if (index < 0 || !ember_chunk_set_switch_table(copy, index, table->keys, table->targets,
+                                                       table->count, table->default_target)) {
+            return 0;
+        }
+    }
+    return ember_chunk_set_line_table(copy, chunk->line_table, chunk->line_table_length);
+}
+
+static int fill_object(clone_context* ctx, ember_object* copy, ember_object* object) {
+    switch (object->type) {
+        case OBJ_ARRAY: {
+            ember_array* array = (ember_array*)object;
+            ember_array* result = (ember_array*)copy;
+            for (int i = 0; i < array->length; i++) {
+                if (!clone_value(ctx, array->elements[i], &result->elements[i])) return 0;
+                result->length = i + 1;
+            }
+            return 1;
+        }
+        case OBJ_HASH_MAP:
+            return fill_hash_map(ctx, (ember_hash_map*)copy, (ember_hash_map*)object);
+        case OBJ_CLASS: {
+            ember_class* klass = (ember_class*)object;
+            ember_class* result = (ember_class*)copy;
+            if (klass->superclass) {
+                result->superclass = (struct ember_class*)clone_shell(ctx, (ember_object*)klass->superclass);
+                if (!result->superclass) return 0;
+            }
+            return !klass->methods || fill_hash_map(ctx, result->methods, klass->methods);
+        }
+        case OBJ_INSTANCE: {
+            ember_instance* instance = (ember_instance*)object;
+            ember_instance* result = (ember_instance*)copy;
+            if (!instance->shape) {
+                return !instance->fields || fill_hash_map(ctx, result->fields, instance->fields);
+            }
+            // Added in the template's order, so clones share one layout
+            int count = instance->shape->field_count;
+            struct ember_shape** order = malloc(sizeof(*order) * (size_t)(count > 0 ? count : 1));
+            if (!order) return 0;
+            for (struct ember_shape* shape = instance->shape; shape && shape->name; shape = shape->parent) {
+                order[shape->field_count - 1] = shape;
+            }
+            int ok = 1;
+            for (int i = 0; ok && i < count; i++) {
+                ember_string* name = intern_string(ctx->vm, order[i]->name, order[i]->name_length);
+                ember_value key;
+                ember_value value;
+                key.type = EMBER_VAL_STRING;
+                key.as.obj_val = (ember_object*)name;
+                ok = name && clone_value(ctx, instance->slots[i], &value) &&
+                     ember_instance_set_field(ctx->vm, result, key, value);
+            }
+            free(order);
+            return ok;
+        }
+        case OBJ_METHOD: {
+            ember_bound_method* bound = (ember_bound_method*)object;
+            ember_bound_method* result = (ember_bound_method*)copy;
+            return clone_value(ctx, bound->receiver, &result->receiver) &&
+                   clone_value(ctx, bound->method, &result->method);
+        }
+        case OBJ_SET: {
+            ember_set* set = (ember_set*)object;
+            ember_set* result = (ember_set*)copy;
+            result->size = set->size;
+            return fill_hash_map(ctx, result->elements, set->elements);
+        }
+        case OBJ_MAP: {
+            ember_map* map = (ember_map*)object;
+            ember_map* result = (ember_map*)copy;
+            return fill_map(ctx, result, map);
+        }
+        case OBJ_CACHE:
+            return fill_cache(ctx, (ember_cache*)copy, (ember_cache*)object);
+        case OBJ_DEQUE:
+            return fill_deque(ctx, (ember_deque*)copy, (ember_deque*)object);
+        case OBJ_PRIORITY_QUEUE:
+            return fill_priority_queue(ctx, (ember_priority_queue*)copy, (ember_priority_queue*)object);
+        case OBJ_WEAK_REF:
+            return clone_value(ctx, ((ember_weak_ref*)object)->target, &((ember_weak_ref*)copy)->target);
+        case OBJ_WEAK_MAP:
+            return fill_weak_map(ctx, (ember_weak_map*)copy, (ember_weak_map*)object);
+        default:
+            return 1;
+    }
+}
+
+static int clone_modules(clone_context* ctx) {
+    ember_vm* source = ctx->snapshot->vm;
+    for (int i = 0; i < source->module_count; i++) {
+        ember_module* module = source->modules[i];
+        ember_module* copy = ember_module_add(ctx->vm, module->name);
+        if (!copy) return 0;
+        if (module->path && !copy->path) {
+            copy->path = strdup(module->path);
+            if (!copy->path) return 0;
+        }
+        copy->is_loaded = module->is_loaded;
+        if (module->chunk) {
+            copy->chunk = clone_chunk(ctx, module->chunk);
+            if (!copy->chunk) return 0;
+        }
+        if (module->image && !copy->image) {
+            ember_module_image_retain(module->image);
+            copy->image = module->image;
+        }
+        for (int j = 0; j < module->export_count; j++) {
+            ember_value value;
+            if (!clone_value(ctx, module->exports[j].value, &value) ||
+                ember_module_export_define(copy, module->exports[j].key, value) < 0) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static void clone_settings(ember_vm* vm, ember_vm* source) {
+    for (int i = 0; i < source->module_path_count; i++) {
+        int present = 0;
+        for (int j = 0; j < vm->module_path_count; j++) {
+            present = present || strcmp(vm->module_paths[j], source->module_paths[i]) == 0;
+        }
+        if (!present && vm->module_path_count < 8) {
+            char* path = strdup(source->module_paths[i]);
+            if (path) vm->module_paths[vm->module_path_count++] = path;
+        }
+    }
+    for (int i = 0; i < source->mount_count; i++) {
+        const ember_mount_point* mount = &source->mounts[i];
+        ember_vfs_mount(vm, mount->virtual_path, mount->host_path, mount->flags);
+    }
+    vm->lazy_stdlib_loading = source->lazy_stdlib_loading;
+    vm->stdlib_initialized = source->stdlib_initialized;
+    if (source->gc_generational || source->gc_incremental || source->gc_object_pooling) {
+        gc_configure(vm, source->gc_generational, source->gc_incremental, 1, source->gc_object_pooling);
+    }
+    ember_gc_policy policy;
+    ember_gc_get_policy(source, &policy);
+    ember_gc_configure_policy(vm, &policy);
+}
+
+static int clone_heap(clone_context* ctx) {
+    ember_vm* source = ctx->snapshot->vm;
+    // Same order, so every global keeps its slot
+    for (int i = 0; i < source->global_count; i++) {
+        ember_value value;
+        if (!clone_value(ctx, source->globals[i].value, &value) ||
+            ember_global_define(ctx->vm, source->globals[i].key, value) < 0) {
+            return 0;
+        }
+    }
+    if (!clone_modules(ctx)) return 0;
+
+    while (ctx->pending_count > 0) {
+        snapshot_pending item = ctx->pending[--ctx->pending_count];
+        int ok = item.is_chunk ? fill_chunk(ctx, item.to, item.from)
+                               : fill_object(ctx, item.to, (ember_object*)item.from);
+        if (!ok) return 0;
+    }
+    return 1;
+}
+
+ember_vm* ember_vm_snapshot_clone(ember_vm_snapshot* snapshot) {
+    if (!snapshot) return NULL;
+    // The template's globals bring the builtins it bound
+    ember_vm* vm = ember_new_vm_optimized(1);
+    if (!vm) return NULL;
+
+    // Shells are only reachable through the context until they are attached
+    int64_t saved_next_gc = vm->next_gc;
+    vm->next_gc = INT64_MAX;
+    clone_context ctx = {snapshot, vm, NULL, 0, 0, NULL, 0, 0};
+    int ok = clone_heap(&ctx);
+    free(ctx.copies);
+    free(ctx.pending);
+    vm->next_gc = saved_next_gc;
+    if (!ok) {
+        ember_free_vm(vm);
+        return NULL;
+    }
+    clone_settings(vm, snapshot->vm);
+    return vm;
+}
+
+ember_vm_snapshot* ember_vm_snapshot_create(ember_vm* vm) {
+    if (!vm) return NULL;
+    if (vm->frame_count > 0 || vm->stack_top > 0) {
+        fprintf(stderr, "[SNAPSHOT] VM is still running code\n");
+        return NULL;
+    }
+    if (ember_loop_pending(vm) > 0) {
+        fprintf(stderr, "[SNAPSHOT] VM has pending async work\n");
+        return NULL;
+    }
+    if (vm->debug_hooks) {
+        // Clones would share the code with its breakpoints patched in
+        fprintf(stderr, "[SNAPSHOT] VM has a debugger attached\n");
+        return NULL;
+    }
+    // Compile lazy bodies once here rather than in every clone
+    if (ember_vm_compile_lazy_functions(vm) != EMBER_SUCCESS) {
+        fprintf(stderr, "[SNAPSHOT] A function body does not compile\n");
+        return NULL;
+    }
+    ember_vm_snapshot* snapshot = calloc(1, sizeof(ember_vm_snapshot));
+    if (!snapshot) {
+        fprintf(stderr, "[SNAPSHOT] Memory allocation failed for snapshot\n");
+        return NULL;
+    }
+    int chunk_count = vm->function_chunk_count + vm->module_count;
+    snapshot->chunk_capacity = 16;
+    while (snapshot->chunk_capacity < chunk_count * 2) snapshot->chunk_capacity *= 2;
+    snapshot->chunks = calloc((size_t)snapshot->chunk_capacity, sizeof(void*));
+    if (!snapshot->chunks) {
+        fprintf(stderr, "[SNAPSHOT] Memory allocation failed for snapshot\n");
+        free(snapshot);
+        return NULL;
+    }
+    for (int i = 0; i < vm->function_chunk_count; i++) {
+        chunk_set_insert(snapshot, vm->function_chunks[i]);
+    }
+    for (int i = 0; i < vm->module_count; i++) {
+        chunk_set_insert(snapshot, vm->modules[i]->chunk);
+    }
+
+    // Finish any collection in progress, then make the template read-only:
+    // clones on other threads only read it, and flattening writes
+    ember_gc_collect(vm);
+    for (ember_object* object = vm->objects; object; object = object->next) {
+        if (object->type == OBJ_STRING) ember_string_flatten((ember_string*)object);
+    }
+    snapshot->vm = vm;
+
+    // A trial clone finds anything that can't be copied now rather than
+    // at every clone
+    ember_vm* trial = ember_vm_snapshot_clone(snapshot);
+    if (!trial) {
+        fprintf(stderr, "[SNAPSHOT] VM state can't be cloned\n");
+        snapshot->vm = NULL;
+        free(snapshot->chunks);
+        free(snapshot);
+        return NULL;
+    }
+    ember_free_vm(trial);
+    return snapshot;
+}
+
+void ember_vm_snapshot_free(ember_vm_snapshot* snapshot) {
+    if (!snapshot) return;
+    ember_free_vm(snapshot->vm);
+    free(snapshot->chunks);
+    free(snapshot);
+}
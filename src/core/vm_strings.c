@@ -0,0 +1,27 @@
+#include "../../include/ember.h"
+#include "../runtime/value/value.h"
+#include "error.h"
+#include <stdio.h>
+
+// VM operation handler for OP_CONCAT_N: the top count stack slots are joined
+// left to right into a single string
+vm_operation_result vm_handle_concat_n(ember_vm* vm, int count) {
+    if (count < 0 || vm->stack_top < count) {
+        ember_error* error = ember_error_runtime(vm, "Stack underflow in string concatenation");
+        ember_vm_set_error(vm, error);
+        return VM_RESULT_ERROR;
+    }
+    
+    ember_value* parts = &vm->stack[vm->stack_top - count];
+    ember_value result = concatenate_values(vm, count, parts);
+    if (result.type == EMBER_VAL_NIL) {
+        ember_error* error = ember_error_runtime(vm, "Failed to build interpolated string");
+        ember_vm_set_error(vm, error);
+        return VM_RESULT_ERROR;
+    }
+    
+    // Parts stay on the stack (and reachable) until the result exists
+    vm->stack_top -= count;
+    vm->stack[vm->stack_top++] = result;
+    return VM_RESULT_OK;
+}
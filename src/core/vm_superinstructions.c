@@ -0,0 +1,73 @@
+#include "../../include/ember.h"
+#include "error.h"
+#include <stdio.h>
+
+// Superinstructions replace the GET_LOCAL, PUSH_CONST, <op> ... sequences
+// that dominate loop bodies. The handlers only cover numbers; for any other
+// operand types they return VM_RESULT_CONTINUE without side effects and the
+// dispatch loop runs the equivalent plain opcodes (see opcode_fused_operation)
+
+static ember_value* fused_local(ember_vm* vm, int slot) {
+    int index = vm->local_base + slot;
+    if (slot < 0 || index < 0 || index >= EMBER_LOCALS_MAX) {
+        ember_error* error = ember_error_runtime(vm, "Invalid local variable slot");
+        ember_vm_set_error(vm, error);
+        return NULL;
+    }
+    return &vm->locals[index];
+}
+
+static ember_value* fused_constant(ember_vm* vm, ember_chunk* chunk, int constant) {
+    if (!chunk || constant < 0 || constant >= chunk->const_count) {
+        ember_error* error = ember_error_runtime(vm, "Invalid constant index");
+        ember_vm_set_error(vm, error);
+        return NULL;
+    }
+    return &chunk->constants[constant];
+}
+
+// VM operation handler for OP_ADD_LOCAL_CONST and OP_SUB_LOCAL_CONST
+vm_operation_result vm_handle_arith_local_const(ember_vm* vm, ember_chunk* chunk, uint8_t op, int slot, int constant) {
+    ember_value* local = fused_local(vm, slot);
+    ember_value* operand = fused_constant(vm, chunk, constant);
+    if (!local || !operand) return VM_RESULT_ERROR;
+
+    if (local->type != EMBER_VAL_NUMBER || operand->type != EMBER_VAL_NUMBER) {
+        return VM_RESULT_CONTINUE;
+    }
+    int32_t small;
+    if (local->as.number.is_small && operand->as.number.is_small &&
+        ember_small_int_arith(op, local->as.number.small, operand->as.number.small, &small)) {
+        *local = ember_make_int(small);
+        return VM_RESULT_OK;
+    }
+    *local = ember_make_number(op == OP_ADD_LOCAL_CONST ? local->as.number_val + operand->as.number_val
+                                                       : local->as.number_val - operand->as.number_val);
+    return VM_RESULT_OK;
+}
+
+// VM operation handler for the OP_LOCAL_<cmp>_CONST_JUMP_IF_FALSE family:
+// stores the comparison in *result; the caller takes the jump when it is 0
+vm_operation_result vm_handle_compare_local_const(ember_vm* vm, ember_chunk* chunk, uint8_t op, int slot, int constant, int* result) {
+    ember_value* local = fused_local(vm, slot);
+    ember_value* operand = fused_constant(vm, chunk, constant);
+    if (!local || !operand) return VM_RESULT_ERROR;
+
+    if (local->type != EMBER_VAL_NUMBER || operand->type != EMBER_VAL_NUMBER) {
+        return VM_RESULT_CONTINUE;
+    }
+    double a = local->as.number_val;
+    double b = operand->as.number_val;
+    switch (op) {
+        case OP_LOCAL_LESS_CONST_JUMP_IF_FALSE:          *result = a < b; break;
+        case OP_LOCAL_LESS_EQUAL_CONST_JUMP_IF_FALSE:    *result = a <= b; break;
+        case OP_LOCAL_GREATER_CONST_JUMP_IF_FALSE:       *result = a > b; break;
+        case OP_LOCAL_GREATER_EQUAL_CONST_JUMP_IF_FALSE: *result = a >= b; break;
+        default: {
+            ember_error* error = ember_error_runtime(vm, "Unknown local comparison superinstruction");
+            ember_vm_set_error(vm, error);
+            return VM_RESULT_ERROR;
+        }
+    }
+    return VM_RESULT_OK;
+}
@@ -0,0 +1,280 @@
+#include "../../include/ember.h"
+#include "../runtime/value/value.h"
+#include "../vm.h"
+#include "error.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Switch jump tables. A switch whose cases are all number or string
+// literals compiles to one OP_SWITCH_TABLE instead of a comparison per case.
+// Integer keys that fill most of their range index a slot array directly;
+// anything else goes through a perfect hash built by hash-and-displace:
+// keys are grouped into buckets, and each bucket, largest first, searches
+// for a seed that puts all its keys in free slots. A lookup then costs one
+// hash, one slot and one comparison. If no seed is found within the budget
+// the table keeps the linear-probing index it was built from.
+
+#define SWITCH_DENSE_FILL 2           // Dense while the range is at most twice the keys
+#define SWITCH_DENSE_MAX_RANGE 65536
+#define SWITCH_MAX_DISPLACEMENT 4096  // Seeds tried per bucket
+
+static uint32_t switch_mix(uint32_t hash, uint32_t seed) {
+    uint32_t h = (hash ^ seed) * 0x9E3779B1u;
+    h ^= h >> 15;
+    h *= 0x85EBCA77u;
+    h ^= h >> 13;
+    return h;
+}
+
+static int switch_keyable(ember_value value) {
+    return value.type == EMBER_VAL_NUMBER || (value.type == EMBER_VAL_STRING && value.as.obj_val);
+}
+
+static void switch_table_clear_index(ember_switch_table* table) {
+    free(table->slots);
+    free(table->displacements);
+    table->slots = NULL;
+    table->displacements = NULL;
+    table->slot_count = 0;
+    table->bucket_count = 0;
+    table->dense = 0;
+}
+
+static void switch_table_clear(ember_switch_table* table) {
+    switch_table_clear_index(table);
+    free(table->keys);
+    free(table->targets);
+    table->keys = NULL;
+    table->targets = NULL;
+    table->count = 0;
+    table->default_target = -1;
+}
+
+// Linear probing from the plain hash. Later duplicates of a key are left
+// out, so the first case with a value wins as it does in a comparison chain
+static int build_probed(const ember_chunk* chunk, ember_switch_table* table, int* unique) {
+    int capacity = 8;
+    while (capacity < table->count * 2) capacity *= 2;
+    int* slots = calloc((size_t)capacity, sizeof(int));
+    if (!slots) return 0;
+    int count = 0;
+    for (int i = 0; i < table->count; i++) {
+        ember_value key = chunk->constants[table->keys[i]];
+        uint32_t index = hash_value_fast(key) & (uint32_t)(capacity - 1);
+        while (slots[index] && !values_equal_fast(chunk->constants[table->keys[slots[index] - 1]], key)) {
+            index = (index + 1) & (uint32_t)(capacity - 1);
+        }
+        if (slots[index]) continue;
+        slots[index] = i + 1;
+        unique[count++] = i;
+    }
+    table->slots = slots;
+    table->slot_count = capacity;
+    return count;
+}
+
+static int build_dense(const ember_chunk* chunk, ember_switch_table* table, const int* unique, int count) {
+    double min = 0;
+    double max = 0;
+    for (int u = 0; u < count; u++) {
+        double number = chunk->constants[table->keys[unique[u]]].as.number_val;
+        if (chunk->constants[table->keys[unique[u]]].type != EMBER_VAL_NUMBER || number != floor(number) ||
+            fabs(number) > 2147483647.0) {
+            return 0;
+        }
+        if (u == 0 || number < min) min = number;
+        if (u == 0 || number > max) max = number;
+    }
+    double range = max - min + 1;
+    if (range > (double)count * SWITCH_DENSE_FILL || range > SWITCH_DENSE_MAX_RANGE) return 0;
+    int* slots = calloc((size_t)range, sizeof(int));
+    if (!slots) return 0;
+    for (int u = 0; u < count; u++) {
+        slots[(int)(chunk->constants[table->keys[unique[u]]].as.number_val - min)] = unique[u] + 1;
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->slot_count = (int)range;
+    table->dense_min = min;
+    table->dense = 1;
+    return 1;
+}
+
+static int build_perfect(const ember_chunk* chunk, ember_switch_table* table, const int* unique, int count) {
+    uint32_t mask = (uint32_t)table->slot_count - 1;
+    int bucket_count = count / 2 + 1;
+    uint32_t* hashes = malloc(sizeof(uint32_t) * (size_t)count);
+    int* order = malloc(sizeof(int) * (size_t)count);     // Keys grouped by bucket
+    int* placed = malloc(sizeof(int) * (size_t)count);    // Slots of the bucket being placed
+    int* starts = calloc((size_t)bucket_count + 1, sizeof(int));
+    int* fill = malloc(sizeof(int) * (size_t)bucket_count);
+    int* slots = calloc((size_t)table->slot_count, sizeof(int));
+    uint32_t* displacements = calloc((size_t)bucket_count, sizeof(uint32_t));
+    int ok = hashes && order && placed && starts && fill && slots && displacements;
+
+    int largest = 0;
+    if (ok) {
+        for (int u = 0; u < count; u++) {
+            hashes[u] = hash_value_fast(chunk->constants[table->keys[unique[u]]]);
+            starts[switch_mix(hashes[u], 0) % (uint32_t)bucket_count + 1]++;
+        }
+        for (int b = 0; b < bucket_count; b++) {
+            if (starts[b + 1] > largest) largest = starts[b + 1];
+            starts[b + 1] += starts[b];
+            fill[b] = starts[b];
+        }
+        for (int u = 0; u < count; u++) {
+            order[fill[switch_mix(hashes[u], 0) % (uint32_t)bucket_count]++] = u;
+        }
+    }
+    // Largest buckets first, while most slots are free. Seed 0 marks an
+    // empty bucket
+    for (int size = largest; ok && size > 0; size--) {
+        for (int b = 0; ok && b < bucket_count; b++) {
+            if (starts[b + 1] - starts[b] != size) continue;
+            const int* members = &order[starts[b]];
+            uint32_t seed;
+            for (seed = 1; seed <= SWITCH_MAX_DISPLACEMENT; seed++) {
+                int k;
+                for (k = 0; k < size; k++) {
+                    int slot = (int)(switch_mix(hashes[members[k]], seed) & mask);
+                    int j = 0;
+                    while (j < k && placed[j] != slot) j++;
+                    if (slots[slot] || j < k) break;
+                    placed[k] = slot;
+                }
+                if (k == size) break;
+            }
+            if (seed > SWITCH_MAX_DISPLACEMENT) {
+                ok = 0;
+                break;
+            }
+            displacements[b] = seed;
+            for (int k = 0; k < size; k++) slots[placed[k]] = unique[members[k]] + 1;
+        }
+    }
+
+    free(hashes);
+    free(order);
+    free(placed);
+    free(starts);
+    free(fill);
+    if (!ok) {
+        free(slots);
+        free(displacements);
+        return 0;
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->displacements = displacements;
+    table->bucket_count = bucket_count;
+    return 1;
+}
+
+static int build_index(const ember_chunk* chunk, ember_switch_table* table) {
+    if (table->count == 0) return 1;
+    int* unique = malloc(sizeof(int) * (size_t)table->count);
+    if (!unique) return 0;
+    int count = build_probed(chunk, table, unique);
+    // The probed index stays when neither form can be built
+    if (count > 0 && !build_dense(chunk, table, unique, count)) {
+        build_perfect(chunk, table, unique, count);
+    }
+    free(unique);
+    return table->slots != NULL;
+}
+
+int ember_chunk_add_switch_table(ember_chunk* chunk) {
+    if (!chunk) return -1;
+    if (chunk->switch_table_count == chunk->switch_table_capacity) {
+        int capacity = chunk->switch_table_capacity < 4 ? 4 : chunk->switch_table_capacity * 2;
+        ember_switch_table* tables = realloc(chunk->switch_tables, sizeof(ember_switch_table) * (size_t)capacity);
+        if (!tables) {
+            fprintf(stderr, "[SECURITY] Memory allocation failed for switch table\n");
+            return -1;
+        }
+        chunk->switch_tables = tables;
+        chunk->switch_table_capacity = capacity;
+    }
+    memset(&chunk->switch_tables[chunk->switch_table_count], 0, sizeof(ember_switch_table));
+    chunk->switch_tables[chunk->switch_table_count].default_target = -1;
+    return chunk->switch_table_count++;
+}
+
+int ember_chunk_set_switch_table(ember_chunk* chunk, int index, const int* keys, const int* targets,
+                                 int count, int default_target) {
+    if (!chunk || index < 0 || index >= chunk->switch_table_count || count < 0) return 0;
+    ember_switch_table* table = &chunk->switch_tables[index];
+    switch_table_clear(table);
+    for (int i = 0; i < count; i++) {
+        if (keys[i] < 0 || keys[i] >= chunk->const_count || !switch_keyable(chunk->constants[keys[i]])) return 0;
+    }
+    if (count > 0) {
+        table->keys = malloc(sizeof(int) * (size_t)count);
+        table->targets = malloc(sizeof(int) * (size_t)count);
+        if (!table->keys || !table->targets) {
+            switch_table_clear(table);
+            return 0;
+        }
+        memcpy(table->keys, keys, sizeof(int) * (size_t)count);
+        memcpy(table->targets, targets, sizeof(int) * (size_t)count);
+    }
+    table->count = count;
+    table->default_target = default_target;
+    if (!build_index(chunk, table)) {
+        switch_table_clear(table);
+        return 0;
+    }
+    return 1;
+}
+
+int ember_switch_table_target(const ember_chunk* chunk, const ember_switch_table* table, ember_value subject) {
+    int found = 0;
+    if (table->dense) {
+        if (subject.type == EMBER_VAL_NUMBER) {
+            double slot = subject.as.number_val - table->dense_min;
+            // NaN and fractions fail the floor test
+            if (slot >= 0 && slot < table->slot_count && slot == floor(slot)) found = table->slots[(int)slot];
+        }
+        return found ? table->targets[found - 1] : table->default_target;
+    }
+    if (!switch_keyable(subject) || !table->slots) return table->default_target;
+
+    uint32_t hash = hash_value_fast(subject);
+    uint32_t mask = (uint32_t)table->slot_count - 1;
+    if (table->displacements) {
+        uint32_t seed = table->displacements[switch_mix(hash, 0) % (uint32_t)table->bucket_count];
+        if (seed) found = table->slots[switch_mix(hash, seed) & mask];
+        if (found && !values_equal_fast(chunk->constants[table->keys[found - 1]], subject)) found = 0;
+    } else {
+        for (uint32_t index = hash & mask; (found = table->slots[index]) != 0; index = (index + 1) & mask) {
+            if (values_equal_fast(chunk->constants[table->keys[found - 1]], subject)) break;
+        }
+    }
+    return found ? table->targets[found - 1] : table->default_target;
+}
+
+void ember_chunk_free_switch_tables(ember_chunk* chunk) {
+    if (!chunk) return;
+    for (int i = 0; i < chunk->switch_table_count; i++) {
+        switch_table_clear(&chunk->switch_tables[i]);
+    }
+    free(chunk->switch_tables);
+    chunk->switch_tables = NULL;
+    chunk->switch_table_count = 0;
+    chunk->switch_table_capacity = 0;
+}
+
+vm_operation_result vm_handle_switch_table(ember_vm* vm, ember_chunk* chunk, int table, int* target) {
+    if (!chunk || table < 0 || table >= chunk->switch_table_count ||
+        chunk->switch_tables[table].default_target < 0 || vm->stack_top < 1) {
+        ember_error* error = ember_error_runtime(vm, "Invalid switch table");
+        ember_vm_set_error(vm, error);
+        return VM_RESULT_ERROR;
+    }
+    ember_value subject = vm->stack[--vm->stack_top];
+    *target = ember_switch_table_target(chunk, &chunk->switch_tables[table], subject);
+    return VM_RESULT_OK;
+}
@@ -0,0 +1,357 @@
+#define _GNU_SOURCE
+#include "../../include/ember.h"
+#include "../vm.h"
+#include "bytecode_format.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+
+// Warm-start profiles. Every new process relearns which sites are stable
+// enough to quicken, which loops OSR should profile and which functions
+// the JIT should compile. ember_vm_save_warm_profile writes what a VM has
+// learned per function: its type feedback slots, its JIT call counter,
+// whether it had native code and whether OSR had profiled it.
+// ember_vm_load_warm_profile reads that into vm->warm_profile, and each
+// chunk takes its part when it is first entered (enter_function in
+// vm_frames.c), before vm_jit_on_call counts the call. The profile is
+// freed once every function in it has found its chunk.
+//
+// The file is text: a header with ember_bytecode_source_key of the main
+// script, so another script or build ignores it, then a "function" line
+// per chunk followed by a line per feedback slot. Functions are matched by
+// name, code length and a checksum of their code, so one edited in a
+// module the key does not cover stays cold. Pointers do not survive a
+// restart: call, invoke and property slots keep their counts and types but
+// relearn their targets (a megamorphic site stays megamorphic), while
+// arithmetic, comparison and array slots keep their operand type pairs and
+// are quickened as they are restored.
+
+#define WARM_PROFILE_MAGIC "ember-warm-profile"
+#define WARM_PROFILE_VERSION 1
+#define WARM_NAME_MAX 255                // Longer names are saved as anonymous
+#define WARM_MAX_SLOTS 0xFFFF            // As many as a chunk can hold
+
+#define WARM_JIT_COMPILED (1 << 0)
+#define WARM_OSR_PROFILED (1 << 1)
+
+typedef struct {
+    char* name;                  // profile_name of the chunk
+    int length;                  // chunk->count
+    uint32_t checksum;           // code_checksum
+    uint32_t jit_counter;
+    int flags;
+    ember_feedback_slot* slots;
+    int slot_count;
+    int claimed;
+} warm_function;
+
+typedef struct ember_warm_profile ember_warm_profile;
+
+struct ember_warm_profile {
+    warm_function* functions;
+    int count;
+    int unclaimed;
+};
+
+// Names go between spaces; anything that would not reads back as "-"
+static const char* profile_name(const ember_chunk* chunk) {
+    const char* name = chunk->name;
+    if (!name || !name[0] || strlen(name) > WARM_NAME_MAX || strpbrk(name, " \t\r\n")) return "-";
+    return name;
+}
+
+// FNV-1a over the code as compiled: a quickened instruction counts as the
+// generic opcode its slot profiled
+static uint32_t code_checksum(const ember_chunk* chunk) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < chunk->count; i++) {
+        const ember_feedback_slot* slot = ember_chunk_feedback_at(chunk, i);
+        hash = (hash ^ (slot ? slot->opcode : chunk->code[i])) * 16777619u;
+    }
+    return hash;
+}
+
+// Targets that are operand type pairs rather than addresses or shape ids
+static int portable_targets(uint8_t op) {
+    switch (op) {
+        case OP_GET_PROPERTY:
+        case OP_SET_PROPERTY:
+        case OP_CALL:
+        case OP_TAIL_CALL:
+        case OP_INVOKE:
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+typedef struct {
+    ember_chunk** chunks;
+    int count;
+    int capacity;
+} chunk_list;
+
+static int list_add(chunk_list* list, ember_chunk* chunk) {
+    if (!chunk || !chunk->code || chunk->count == 0 || chunk->lazy_body) return 1;
+    for (int i = 0; i < list->count; i++) {
+        if (list->chunks[i] == chunk) return 1;
+    }
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 64;
+        ember_chunk** chunks = realloc(list->chunks, sizeof(ember_chunk*) * (size_t)capacity);
+        if (!chunks) return 0;
+        list->chunks = chunks;
+        list->capacity = capacity;
+    }
+    list->chunks[list->count++] = chunk;
+    return 1;
+}
+
+static int list_add_value(chunk_list* list, ember_value value) {
+    return value.type != EMBER_VAL_FUNCTION || list_add(list, value.as.func_val.chunk);
+}
+
+// Every compiled function of vm: the tracked ones (top-level and module
+// functions) and the methods of global classes
+static int collect_chunks(ember_vm* vm, chunk_list* list) {
+    for (int i = 0; i < vm->function_chunk_count; i++) {
+        if (!list_add(list, vm->function_chunks[i])) return 0;
+    }
+    for (int i = 0; i < vm->global_count; i++) {
+        ember_value value = vm->globals[i].value;
+        if (!list_add_value(list, value)) return 0;
+        if (value.type != EMBER_VAL_CLASS || !value.as.obj_val || !AS_CLASS(value)->methods) continue;
+        const ember_hash_map* methods = AS_CLASS(value)->methods;
+        for (int j = 0; j < methods->capacity; j++) {
+            if (methods->entries[j].is_occupied && !list_add_value(list, methods->entries[j].value)) return 0;
+        }
+    }
+    return 1;
+}
+
+// ============================================================================
+// SAVING
+// ============================================================================
+
+static void write_function(FILE* file, const ember_chunk* chunk) {
+    int slots = 0;
+    for (int i = 0; i < chunk->feedback_count; i++) {
+        if (chunk->feedback[i].hits) slots++;
+    }
+    int flags = (chunk->jit_code ? WARM_JIT_COMPILED : 0) | (chunk->osr_profiled ? WARM_OSR_PROFILED : 0);
+    // Never run, or never counted: nothing to warm
+    if (!slots && !flags && !chunk->jit_counter) return;
+
+    fprintf(file, "function %s %d %08x %u %d %d\n", profile_name(chunk), chunk->count,
+            code_checksum(chunk), chunk->jit_counter, flags, slots);
+    for (int i = 0; i < chunk->feedback_count; i++) {
+        const ember_feedback_slot* slot = &chunk->feedback[i];
+        if (!slot->hits) continue;
+        int state = slot->state;
+        int targets = slot->target_count;
+        if (!portable_targets(slot->opcode)) {
+            targets = 0;
+            if (state != EMBER_FEEDBACK_MEGAMORPHIC) state = EMBER_FEEDBACK_UNINITIALIZED;
+        }
+        fprintf(file, "%d %u %d %u %x %x %d", slot->offset, slot->opcode, state, slot->hits,
+                slot->left_types, slot->right_types, targets);
+        for (int t = 0; t < targets; t++) {
+            fprintf(file, " %llx", (unsigned long long)slot->targets[t]);
+        }
+        fprintf(file, "\n");
+    }
+}
+
+int ember_vm_save_warm_profile(ember_vm* vm, const char* source, const char* path) {
+    if (!vm || !source || !path) return EMBER_ERROR_INVALID_PARAMETER;
+    chunk_list list = {NULL, 0, 0};
+    if (!collect_chunks(vm, &list)) {
+        free(list.chunks);
+        return EMBER_ERROR_MEMORY_ALLOCATION;
+    }
+
+    // Workers sharing a profile may exit together; readers never see a
+    // partial file
+    char temp_path[PATH_MAX];
+    int written = snprintf(temp_path, sizeof(temp_path), "%s.tmp.%ld", path, (long)getpid());
+    FILE* file = written > 0 && (size_t)written < sizeof(temp_path) ? fopen(temp_path, "w") : NULL;
+    if (!file) {
+        fprintf(stderr, "[PROFILE] Cannot write %s\n", path);
+        free(list.chunks);
+        return EMBER_ERROR_OPERATION_FAILED;
+    }
+    fprintf(file, "%s %d %016llx\n", WARM_PROFILE_MAGIC, WARM_PROFILE_VERSION,
+            (unsigned long long)ember_bytecode_source_key(source));
+    for (int i = 0; i < list.count; i++) {
+        write_function(file, list.chunks[i]);
+    }
+    free(list.chunks);
+
+    int ok = !ferror(file);
+    ok = fclose(file) == 0 && ok;
+    if (ok && rename(temp_path, path) != 0) ok = 0;
+    if (!ok) {
+        fprintf(stderr, "[PROFILE] Cannot write %s\n", path);
+        unlink(temp_path);
+        return EMBER_ERROR_OPERATION_FAILED;
+    }
+    return EMBER_SUCCESS;
+}
+
+// ============================================================================
+// LOADING
+// ============================================================================
+
+static void profile_free(ember_warm_profile* profile) {
+    if (!profile) return;
+    for (int i = 0; i < profile->count; i++) {
+        free(profile->functions[i].name);
+        free(profile->functions[i].slots);
+    }
+    free(profile->functions);
+    free(profile);
+}
+
+void warm_profile_free(ember_vm* vm) {
+    if (!vm) return;
+    profile_free(vm->warm_profile);
+    vm->warm_profile = NULL;
+}
+
+static int parse_slot(const char* line, int length, ember_feedback_slot* slot) {
+    unsigned opcode, state, hits, left, right, targets;
+    unsigned long long target[EMBER_FEEDBACK_TARGETS] = {0};
+    int fields = sscanf(line, "%d %u %u %u %x %x %u %llx %llx %llx %llx", &slot->offset, &opcode, &state,
+                        &hits, &left, &right, &targets, &target[0], &target[1], &target[2], &target[3]);
+    if (fields < 7 || targets > EMBER_FEEDBACK_TARGETS || fields != 7 + (int)targets) return 0;
+    if (slot->offset < 0 || slot->offset >= length || opcode > UINT8_MAX || state > EMBER_FEEDBACK_MEGAMORPHIC) {
+        return 0;
+    }
+    slot->opcode = (uint8_t)opcode;
+    slot->state = (uint8_t)state;
+    slot->target_count = (uint8_t)targets;
+    slot->hits = hits;
+    slot->left_types = left;
+    slot->right_types = right;
+    for (int t = 0; t < EMBER_FEEDBACK_TARGETS; t++) {
+        slot->targets[t] = target[t];
+    }
+    return 1;
+}
+
+// The profile in file, NULL if it is malformed or for another key
+static ember_warm_profile* parse_profile(FILE* file, uint64_t key) {
+    char line[512];
+    int version;
+    unsigned long long file_key;
+    if (!fgets(line, sizeof(line), file) ||
+        sscanf(line, WARM_PROFILE_MAGIC " %d %llx", &version, &file_key) != 2 ||
+        version != WARM_PROFILE_VERSION || file_key != key) {
+        return NULL;
+    }
+
+    ember_warm_profile* profile = calloc(1, sizeof(ember_warm_profile));
+    if (!profile) return NULL;
+    int capacity = 0;
+    while (fgets(line, sizeof(line), file)) {
+        char name[WARM_NAME_MAX + 1];
+        warm_function function;
+        memset(&function, 0, sizeof(function));
+        if (sscanf(line, "function %255s %d %x %u %d %d", name, &function.length, &function.checksum,
+                   &function.jit_counter, &function.flags, &function.slot_count) != 6 ||
+            function.length <= 0 || function.slot_count < 0 || function.slot_count > WARM_MAX_SLOTS) {
+            profile_free(profile);
+            return NULL;
+        }
+        if (profile->count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            warm_function* functions = realloc(profile->functions, sizeof(warm_function) * (size_t)capacity);
+            if (!functions) {
+                profile_free(profile);
+                return NULL;
+            }
+            profile->functions = functions;
+        }
+        function.name = strdup(name);
+        function.slots = function.slot_count ? calloc((size_t)function.slot_count, sizeof(ember_feedback_slot)) : NULL;
+        // Counted from here on, so profile_free releases what it holds
+        profile->functions[profile->count++] = function;
+        if (!function.name || (function.slot_count && !function.slots)) {
+            profile_free(profile);
+            return NULL;
+        }
+        for (int i = 0; i < function.slot_count; i++) {
+            if (!fgets(line, sizeof(line), file) || !parse_slot(line, function.length, &function.slots[i])) {
+                profile_free(profile);
+                return NULL;
+            }
+        }
+    }
+    profile->unclaimed = profile->count;
+    return profile;
+}
+
+static void restore_function(ember_chunk* chunk, const warm_function* function) {
+    for (int i = 0; i < function->slot_count; i++) {
+        vm_feedback_restore(chunk, &function->slots[i]);
+    }
+    if (function->flags & WARM_OSR_PROFILED) {
+        // The slots it profiled are back, quickened already
+        chunk->osr_profiled = 1;
+    }
+    if (function->flags & WARM_JIT_COMPILED) {
+        // Due whatever the threshold, as after a hot loop (vm_osr.c)
+        if (!chunk->jit_code && chunk->jit_counter < UINT32_MAX - 1) chunk->jit_counter = UINT32_MAX - 1;
+    } else if (chunk->jit_counter < function->jit_counter) {
+        chunk->jit_counter = function->jit_counter;
+    }
+}
+
+void vm_warm_profile_apply(ember_vm* vm, ember_chunk* chunk) {
+    ember_warm_profile* profile = vm->warm_profile;
+    if (!profile || !chunk || !chunk->code || chunk->count == 0 || chunk->lazy_body) return;
+    chunk->warm_checked = 1;
+    const char* name = profile_name(chunk);
+    int summed = 0;
+    uint32_t checksum = 0;
+    for (int i = 0; i < profile->count; i++) {
+        warm_function* function = &profile->functions[i];
+        if (function->claimed || function->length != chunk->count || strcmp(function->name, name) != 0) continue;
+        if (!summed) {
+            checksum = code_checksum(chunk);
+            summed = 1;
+        }
+        if (function->checksum != checksum) continue;
+        restore_function(chunk, function);
+        function->claimed = 1;
+        if (--profile->unclaimed == 0) warm_profile_free(vm);
+        return;
+    }
+}
+
+int ember_vm_load_warm_profile(ember_vm* vm, const char* source, const char* path) {
+    if (!vm || !source || !path) return EMBER_ERROR_INVALID_PARAMETER;
+    // A first run has no profile yet; that is not worth a message
+    FILE* file = fopen(path, "r");
+    if (!file) return EMBER_ERROR_OPERATION_FAILED;
+    ember_warm_profile* profile = parse_profile(file, ember_bytecode_source_key(source));
+    fclose(file);
+    if (!profile) return EMBER_ERROR_OPERATION_FAILED;
+
+    warm_profile_free(vm);
+    if (profile->count == 0) {
+        profile_free(profile);
+        return EMBER_SUCCESS;
+    }
+    vm->warm_profile = profile;
+    // Functions compiled already are warmed now; the rest as they are entered
+    chunk_list list = {NULL, 0, 0};
+    collect_chunks(vm, &list);
+    for (int i = 0; i < list.count && vm->warm_profile; i++) {
+        vm_warm_profile_apply(vm, list.chunks[i]);
+    }
+    free(list.chunks);
+    return EMBER_SUCCESS;
+}
@@ -112,6 +112,17 @@ static size_t core_get_string_length(ember_value value) {
     return 0;
 }
 
+static const char* core_get_string_bytes(ember_value value, size_t* length) {
+    const char* bytes = NULL;
+    if (value.type == EMBER_VAL_STRING && value.as.obj_val) {
+        ember_string* string = AS_STRING(value);
+        bytes = ember_string_bytes(string);
+        if (!bytes) bytes = ember_string_flatten(string);
+    }
+    if (length) *length = bytes ? (size_t)AS_STRING(value)->length : 0;
+    return bytes;
+}
+
 static void core_register_native_function(ember_vm* vm, const char* name, ember_native_function_t func) {
     ember_register_func(vm, name, func);
 }
@@ -209,6 +220,11 @@ static const ember_core_interface_t core_interface = {
     .allocate = core_allocate,
     .deallocate = core_deallocate,
     .gc_collect = core_gc_collect,
+    
+    // Binary-safe strings
+    .make_string_len = ember_make_string_len,
+    .make_string_external = ember_make_string_external,
+    .get_string_bytes = core_get_string_bytes,
 };
 
 // Interface registration function
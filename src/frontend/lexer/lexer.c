@@ -1,57 +1,283 @@
 #include "lexer.h"
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 
-static lexer scanner;
+// Character classes, one table lookup per byte instead of <ctype.h> calls
+#define CHAR_DIGIT    0x01
+#define CHAR_ALPHA    0x02  // Letters and '_': may start an identifier
+#define CHAR_IDENT    (CHAR_DIGIT | CHAR_ALPHA)
+#define CHAR_SPACE    0x04  // Skipped between tokens (newlines are tokens)
+#define CHAR_STR_STOP 0x08  // Bytes a string body can't skip: '"' '$' '\n' NUL
+#define CHAR_LINE_END 0x10  // Ends a comment: '\n' NUL
 
-void init_scanner(const char* source) {
-    scanner.start = source;
-    scanner.current = source;
-    scanner.line = 1;
+static const uint8_t char_class[256] = {
+    0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x18, 0x00, 0x00, 0x04, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x04, 0x00, 0x08, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02,
+    0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x00, 0x00, 0x00, 0x00, 0x02,
+    0x00, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02,
+    0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00,
+    // Bytes 0x80-0xFF are all 0
+};
+
+#define CHAR_IS(c, cls) (char_class[(uint8_t)(c)] & (cls))
+
+// Keywords, by a perfect hash over the length and the first, second and
+// last bytes. Generated by searching for keyword_asso values that give every
+// keyword its own slot; adding a keyword means searching again.
+#define KEYWORD_SLOTS      64
+#define KEYWORD_MIN_LENGTH 2
+#define KEYWORD_MAX_LENGTH 8
+
+struct keyword {
+    const char* name;
+    int length;
+    ember_token_type type;
+};
+
+static const uint8_t keyword_asso[256] = {
+    ['a'] = 59, ['b'] = 54, ['c'] = 45, ['d'] = 54, ['e'] = 23, ['f'] = 24, ['h'] = 45, ['i'] = 33,
+    ['k'] = 38, ['l'] = 51, ['m'] = 28, ['n'] = 5, ['o'] = 52, ['p'] = 23, ['q'] = 4, ['r'] = 6,
+    ['s'] = 5, ['t'] = 58, ['u'] = 61, ['w'] = 37, ['x'] = 49, ['y'] = 35,
+};
+
+static const struct keyword keywords[KEYWORD_SLOTS] = {
+    [0] = {"continue", 8, TOKEN_CONTINUE},
+    [2] = {"or", 2, TOKEN_OR},
+    [3] = {"case", 4, TOKEN_CASE},
+    [4] = {"new", 3, TOKEN_NEW},
+    [7] = {"as", 2, TOKEN_AS},
+    [8] = {"export", 6, TOKEN_EXPORT},
+    [13] = {"super", 5, TOKEN_SUPER},
+    [14] = {"default", 7, TOKEN_DEFAULT},
+    [17] = {"throw", 5, TOKEN_THROW},
+    [19] = {"if", 2, TOKEN_IF},
+    [20] = {"extends", 7, TOKEN_EXTENDS},
+    [21] = {"for", 3, TOKEN_FOR},
+    [26] = {"catch", 5, TOKEN_CATCH},
+    [27] = {"true", 4, TOKEN_TRUE},
+    [29] = {"switch", 6, TOKEN_SWITCH},
+    [31] = {"await", 5, TOKEN_AWAIT},
+    [32] = {"do", 2, TOKEN_DO},
+    [34] = {"function", 8, TOKEN_FUNCTION},
+    [35] = {"finally", 7, TOKEN_FINALLY},
+    [36] = {"fn", 2, TOKEN_FN},
+    [37] = {"else", 4, TOKEN_ELSE},
+    [38] = {"try", 3, TOKEN_TRY},
+    [39] = {"break", 5, TOKEN_BREAK},
+    [40] = {"return", 6, TOKEN_RETURN},
+    [42] = {"class", 5, TOKEN_CLASS},
+    [46] = {"while", 5, TOKEN_WHILE},
+    [47] = {"false", 5, TOKEN_FALSE},
+    [48] = {"this", 4, TOKEN_THIS},
+    [50] = {"async", 5, TOKEN_ASYNC},
+    [54] = {"not", 3, TOKEN_NOT},
+    [57] = {"and", 3, TOKEN_AND},
+    [59] = {"require", 7, TOKEN_REQUIRE},
+    [61] = {"import", 6, TOKEN_IMPORT},
+    [62] = {"from", 4, TOKEN_FROM},
+    [63] = {"yield", 5, TOKEN_YIELD},
+};
+
+// Runs of identifier, whitespace and string bytes are measured 16 at a
+// time. A load never crosses into the next page, so it can't fault past
+// the source's NUL even though it may read beyond it; sanitizers would
+// still report those bytes, so instrumented builds scan bytewise.
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define LEXER_SIMD 0
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer) || __has_feature(memory_sanitizer)
+#define LEXER_SIMD 0
+#endif
+#endif
+
+#ifndef LEXER_SIMD
+#if defined(__SSE2__) || defined(__ARM_NEON)
+#define LEXER_SIMD 1
+#else
+#define LEXER_SIMD 0
+#endif
+#endif
+
+#if LEXER_SIMD
+#define LEXER_PAGE_SIZE 4096
+#define LEXER_CAN_LOAD(p) (((uintptr_t)(p) & (LEXER_PAGE_SIZE - 1)) <= LEXER_PAGE_SIZE - 16)
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+// One mask bit per byte
+#define LEXER_MASK_SHIFT 0
+typedef __m128i lexer_vec;
+
+static inline lexer_vec lexer_load(const char* p) {
+    return _mm_loadu_si128((const __m128i*)p);
+}
+
+static inline lexer_vec lexer_eq(lexer_vec v, char c) {
+    return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+}
+
+// lo <= v <= hi, for ASCII bounds (bytes >= 0x80 compare as negative)
+static inline lexer_vec lexer_range(lexer_vec v, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((char)(lo - 1))),
+                         _mm_cmplt_epi8(v, _mm_set1_epi8((char)(hi + 1))));
+}
+
+#define lexer_or(a, b) _mm_or_si128(a, b)
+#define lexer_fold_case(v) _mm_or_si128(v, _mm_set1_epi8(0x20))
+
+static inline uint64_t lexer_mask(lexer_vec match) {
+    return (uint64_t)(uint16_t)_mm_movemask_epi8(match);
+}
+#define LEXER_MASK_ALL 0xFFFFULL
+#else
+#include <arm_neon.h>
+
+// Four mask bits per byte (shift-narrow trick in place of movemask)
+#define LEXER_MASK_SHIFT 2
+typedef uint8x16_t lexer_vec;
+
+static inline lexer_vec lexer_load(const char* p) {
+    return vld1q_u8((const uint8_t*)p);
+}
+
+static inline lexer_vec lexer_eq(lexer_vec v, char c) {
+    return vceqq_u8(v, vdupq_n_u8((uint8_t)c));
+}
+
+static inline lexer_vec lexer_range(lexer_vec v, char lo, char hi) {
+    return vandq_u8(vcgeq_u8(v, vdupq_n_u8((uint8_t)lo)), vcleq_u8(v, vdupq_n_u8((uint8_t)hi)));
+}
+
+#define lexer_or(a, b) vorrq_u8(a, b)
+#define lexer_fold_case(v) vorrq_u8(v, vdupq_n_u8(0x20))
+
+static inline uint64_t lexer_mask(lexer_vec match) {
+    uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(match), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
 }
+#define LEXER_MASK_ALL (~0ULL)
+#endif
 
-static char advance() {
-    return *scanner.current++;
+// Leading bytes of the 16 at p outside the matched set (16 if none match)
+static inline int lexer_run_length(uint64_t stops) {
+    return stops ? __builtin_ctzll(stops) >> LEXER_MASK_SHIFT : 16;
 }
 
-static char peek_char() {
-    return *scanner.current;
+static inline uint64_t ident_stops(const char* p) {
+    lexer_vec v = lexer_load(p);
+    lexer_vec ident = lexer_or(lexer_or(lexer_range(lexer_fold_case(v), 'a', 'z'), lexer_range(v, '0', '9')),
+                               lexer_eq(v, '_'));
+    return ~lexer_mask(ident) & LEXER_MASK_ALL;
 }
 
-static char peek_next_char() {
-    if (*scanner.current == '\0') return '\0';
-    return scanner.current[1];
+static inline uint64_t space_stops(const char* p) {
+    lexer_vec v = lexer_load(p);
+    lexer_vec space = lexer_or(lexer_or(lexer_eq(v, ' '), lexer_eq(v, '\t')), lexer_eq(v, '\r'));
+    return ~lexer_mask(space) & LEXER_MASK_ALL;
 }
 
-static int is_at_end() {
-    return *scanner.current == '\0';
+static inline uint64_t string_stops(const char* p) {
+    lexer_vec v = lexer_load(p);
+    return lexer_mask(lexer_or(lexer_or(lexer_eq(v, '"'), lexer_eq(v, '$')),
+                               lexer_or(lexer_eq(v, '\n'), lexer_eq(v, '\0'))));
 }
 
-static void skip_whitespace() {
+static inline uint64_t line_end_stops(const char* p) {
+    lexer_vec v = lexer_load(p);
+    return lexer_mask(lexer_or(lexer_eq(v, '\n'), lexer_eq(v, '\0')));
+}
+
+#endif // LEXER_SIMD
+
+#define IS_IDENT(c)        CHAR_IS(c, CHAR_IDENT)
+#define IS_SPACE(c)        CHAR_IS(c, CHAR_SPACE)
+#define IS_STRING_BODY(c)  (!CHAR_IS(c, CHAR_STR_STOP))
+#define IS_COMMENT_BODY(c) (!CHAR_IS(c, CHAR_LINE_END))
+
+#if LEXER_SIMD
+#define LEXER_SKIP(p, stops_of, keep)                \
+    do {                                             \
+        while (LEXER_CAN_LOAD(p)) {                  \
+            int run = lexer_run_length(stops_of(p)); \
+            (p) += run;                              \
+            if (run < 16) return (p);                \
+        }                                            \
+        while (keep(*(p))) (p)++;                    \
+    } while (0)
+#else
+#define LEXER_SKIP(p, stops_of, keep) while (keep(*(p))) (p)++
+#endif
+
+// Past the run of identifier bytes, spaces, string body or comment at p
+static const char* skip_ident(const char* p) {
+    LEXER_SKIP(p, ident_stops, IS_IDENT);
+    return p;
+}
+
+static const char* skip_spaces(const char* p) {
+    LEXER_SKIP(p, space_stops, IS_SPACE);
+    return p;
+}
+
+static const char* skip_string_body(const char* p) {
+    LEXER_SKIP(p, string_stops, IS_STRING_BODY);
+    return p;
+}
+
+static const char* skip_comment(const char* p) {
+    LEXER_SKIP(p, line_end_stops, IS_COMMENT_BODY);
+    return p;
+}
+
+void lexer_init(lexer* lx, const char* source) {
+    lx->start = source;
+    lx->current = source;
+    lx->line = 1;
+    lx->line_start = source;
+}
+
+static char advance(lexer* lx) {
+    return *lx->current++;
+}
+
+static char peek_char(lexer* lx) {
+    return *lx->current;
+}
+
+static char peek_next_char(lexer* lx) {
+    if (*lx->current == '\0') return '\0';
+    return lx->current[1];
+}
+
+static int is_at_end(lexer* lx) {
+    return *lx->current == '\0';
+}
+
+static void skip_whitespace(lexer* lx) {
     for (;;) {
-        char c = peek_char();
+        char c = peek_char(lx);
         switch (c) {
             case ' ':
             case '\r':
             case '\t':
-                advance();
+                lx->current = skip_spaces(lx->current);
                 break;
             case '#':
                 // Skip comment until end of line
-                while (peek_char() != '\n' && !is_at_end()) {
-                    advance();
-                }
+                lx->current = skip_comment(lx->current);
                 break;
             case '/':
                 // Check for double-slash comment
-                if (peek_next_char() == '/') {
+                if (peek_next_char(lx) == '/') {
                     // Skip // comment until end of line
-                    advance(); // Skip first /
-                    advance(); // Skip second /
-                    while (peek_char() != '\n' && !is_at_end()) {
-                        advance();
-                    }
+                    advance(lx); // Skip first /
+                    advance(lx); // Skip second /
+                    lx->current = skip_comment(lx->current);
                 } else {
                     return; // Not a comment, let the main tokenizer handle it
                 }
@@ -62,385 +288,252 @@ static void skip_whitespace() {
     }
 }
 
-static ember_token make_token(ember_token_type type) {
+static ember_token make_token(lexer* lx, ember_token_type type) {
     ember_token token;
     token.type = type;
-    token.start = scanner.start;
-    token.length = (int)(scanner.current - scanner.start);
-    token.line = scanner.line;
+    token.start = lx->start;
+    token.length = (int)(lx->current - lx->start);
+    token.line = lx->line;
+    token.column = (int)(lx->start - lx->line_start) + 1;
     token.number = 0.0;
     return token;
 }
 
-static ember_token error_token(const char* message) {
+static ember_token error_token(lexer* lx, const char* message) {
     ember_token token;
     token.type = TOKEN_ERROR;
     token.start = message;
     token.length = (int)strlen(message);
-    token.line = scanner.line;
+    token.line = lx->line;
+    token.column = (int)(lx->start - lx->line_start) + 1;
     token.number = 0.0;
     return token;
 }
 
-static ember_token number() {
-    while (isdigit(peek_char())) advance();
+static ember_token number(lexer* lx) {
+    while (CHAR_IS(peek_char(lx), CHAR_DIGIT)) advance(lx);
     
     // Look for decimal point
-    if (peek_char() == '.' && isdigit(peek_next_char())) {
-        advance(); // consume '.'
-        while (isdigit(peek_char())) advance();
+    if (peek_char(lx) == '.' && CHAR_IS(peek_next_char(lx), CHAR_DIGIT)) {
+        advance(lx); // consume '.'
+        while (CHAR_IS(peek_char(lx), CHAR_DIGIT)) advance(lx);
     }
     
-    ember_token token = make_token(TOKEN_NUMBER);
-    token.number = strtod(scanner.start, NULL);
+    ember_token token = make_token(lx, TOKEN_NUMBER);
+    token.number = strtod(lx->start, NULL);
     return token;
 }
 
-static ember_token string() {
+static ember_token string(lexer* lx) {
     int has_interpolation = 0;
     
     // Scan through the entire string first to check for interpolation
-    const char* check_ptr = scanner.current;
+    const char* check_ptr = skip_string_body(lx->current);
     while (*check_ptr != '"' && *check_ptr != '\0') {
         if (*check_ptr == '$' && *(check_ptr + 1) == '{') {
             has_interpolation = 1;
             break;
         }
-        check_ptr++;
+        check_ptr = skip_string_body(check_ptr + 1);
     }
     
     // Now parse the string, handling interpolation properly
-    while (peek_char() != '"' && !is_at_end()) {
-        if (peek_char() == '\n') scanner.line++;
+    while (peek_char(lx) != '"' && !is_at_end(lx)) {
+        lx->current = skip_string_body(lx->current);
+        if (peek_char(lx) == '"' || is_at_end(lx)) break;
+        if (peek_char(lx) == '\n') {
+            lx->line++;
+            lx->line_start = lx->current + 1;
+        }
         
         // Handle interpolation expressions that may contain quotes
-        if (peek_char() == '$' && peek_next_char() == '{') {
-            advance(); // Skip $
-            advance(); // Skip {
+        if (peek_char(lx) == '$' && peek_next_char(lx) == '{') {
+            advance(lx); // Skip $
+            advance(lx); // Skip {
             
             int brace_count = 1;
-            while (brace_count > 0 && !is_at_end()) {
-                char c = peek_char();
+            while (brace_count > 0 && !is_at_end(lx)) {
+                char c = peek_char(lx);
                 if (c == '"') {
                     // Skip quoted string inside interpolation
-                    advance(); // Skip opening quote
-                    while (peek_char() != '"' && !is_at_end()) {
-                        if (peek_char() == '\\') advance(); // Skip escape sequences
-                        advance();
+                    advance(lx); // Skip opening quote
+                    while (peek_char(lx) != '"' && !is_at_end(lx)) {
+                        if (peek_char(lx) == '\\') advance(lx); // Skip escape sequences
+                        advance(lx);
                     }
-                    if (peek_char() == '"') advance(); // Skip closing quote
+                    if (peek_char(lx) == '"') advance(lx); // Skip closing quote
                 } else if (c == '{') {
                     brace_count++;
-                    advance();
+                    advance(lx);
                 } else if (c == '}') {
                     brace_count--;
-                    advance();
+                    advance(lx);
                 } else {
-                    advance();
+                    advance(lx);
                 }
             }
         } else {
-            advance();
+            advance(lx);
         }
     }
     
-    if (is_at_end()) return error_token("Unterminated string");
+    if (is_at_end(lx)) return error_token(lx, "Unterminated string");
     
     // The closing quote
-    advance();
+    advance(lx);
     
     if (has_interpolation) {
-        return make_token(TOKEN_INTERPOLATED_STRING);
+        return make_token(lx, TOKEN_INTERPOLATED_STRING);
     }
     
-    return make_token(TOKEN_STRING);
+    return make_token(lx, TOKEN_STRING);
 }
 
-static ember_token_type identifier_type() {
-    switch (scanner.start[0]) {
-        case 'a':
-            if (scanner.current - scanner.start == 3 && 
-                memcmp(scanner.start, "and", 3) == 0) {
-                return TOKEN_AND;
-            }
-            if (scanner.current - scanner.start == 5 && 
-                memcmp(scanner.start, "async", 5) == 0) {
-                return TOKEN_ASYNC;
-            }
-            if (scanner.current - scanner.start == 5 && 
-                memcmp(scanner.start, "await", 5) == 0) {
-                return TOKEN_AWAIT;
-            }
-            if (scanner.current - scanner.start == 2 && 
-                memcmp(scanner.start, "as", 2) == 0) {
-                return TOKEN_AS;
-            }
-            break;
-        case 'b':
-            if (scanner.current - scanner.start == 5 && 
-                memcmp(scanner.start, "break", 5) == 0) {
-                return TOKEN_BREAK;
-            }
-            break;
-        case 'c':
-            if (scanner.current - scanner.start == 8 && 
-                memcmp(scanner.start, "continue", 8) == 0) {
-                return TOKEN_CONTINUE;
-            }
-            if (scanner.current - scanner.start == 5 && 
-                memcmp(scanner.start, "catch", 5) == 0) {
-                return TOKEN_CATCH;
-            }
-            if (scanner.current - scanner.start == 5 && 
-                memcmp(scanner.start, "class", 5) == 0) {
-                return TOKEN_CLASS;
-            }
-            if (scanner.current - scanner.start == 4 && 
-                memcmp(scanner.start, "case", 4) == 0) {
-                return TOKEN_CASE;
-            }
-            break;
-        case 'd':
-            if (scanner.current - scanner.start == 2 && 
-                memcmp(scanner.start, "do", 2) == 0) {
-                return TOKEN_DO;
-            }
-            if (scanner.current - scanner.start == 7 && 
-                memcmp(scanner.start, "default", 7) == 0) {
-                return TOKEN_DEFAULT;
-            }
-            break;
-        case 'e': 
-            if (scanner.current - scanner.start == 4 && 
-                memcmp(scanner.start, "else", 4) == 0) {
-                return TOKEN_ELSE;
-            }
-            if (scanner.current - scanner.start == 7 && 
-                memcmp(scanner.start, "extends", 7) == 0) {
-                return TOKEN_EXTENDS;
-            }
-            if (scanner.current - scanner.start == 6 && 
-                memcmp(scanner.start, "export", 6) == 0) {
-                return TOKEN_EXPORT;
-            }
-            break;
-        case 'f':
-            if (scanner.current - scanner.start == 2 && 
-                memcmp(scanner.start, "fn", 2) == 0) {
-                return TOKEN_FN;
-            }
-            if (scanner.current - scanner.start == 3 && 
-                memcmp(scanner.start, "for", 3) == 0) {
-                return TOKEN_FOR;
-            }
-            if (scanner.current - scanner.start == 5 && 
-                memcmp(scanner.start, "false", 5) == 0) {
-                return TOKEN_FALSE;
-            }
-            if (scanner.current - scanner.start == 7 && 
-                memcmp(scanner.start, "finally", 7) == 0) {
-                return TOKEN_FINALLY;
-            }
-            if (scanner.current - scanner.start == 8 && 
-                memcmp(scanner.start, "function", 8) == 0) {
-                return TOKEN_FUNCTION;
-            }
-            if (scanner.current - scanner.start == 4 && 
-                memcmp(scanner.start, "from", 4) == 0) {
-                return TOKEN_FROM;
-            }
-            break;
-        case 'i':
-            if (scanner.current - scanner.start == 2 && 
-                memcmp(scanner.start, "if", 2) == 0) {
-                return TOKEN_IF;
-            }
-            if (scanner.current - scanner.start == 6 && 
-                memcmp(scanner.start, "import", 6) == 0) {
-                return TOKEN_IMPORT;
-            }
-            break;
-        case 'n':
-            if (scanner.current - scanner.start == 3 && 
-                memcmp(scanner.start, "not", 3) == 0) {
-                return TOKEN_NOT;
-            }
-            if (scanner.current - scanner.start == 3 && 
-                memcmp(scanner.start, "new", 3) == 0) {
-                return TOKEN_NEW;
-            }
-            break;
-        case 'o':
-            if (scanner.current - scanner.start == 2 && 
-                memcmp(scanner.start, "or", 2) == 0) {
-                return TOKEN_OR;
-            }
-            break;
-        case 'r':
-            if (scanner.current - scanner.start == 6 && 
-                memcmp(scanner.start, "return", 6) == 0) {
-                return TOKEN_RETURN;
-            }
-            if (scanner.current - scanner.start == 7 && 
-                memcmp(scanner.start, "require", 7) == 0) {
-                return TOKEN_REQUIRE;
-            }
-            break;
-        case 's':
-            if (scanner.current - scanner.start == 5 && 
-                memcmp(scanner.start, "super", 5) == 0) {
-                return TOKEN_SUPER;
-            }
-            if (scanner.current - scanner.start == 6 && 
-                memcmp(scanner.start, "switch", 6) == 0) {
-                return TOKEN_SWITCH;
-            }
-            break;
-        case 't':
-            if (scanner.current - scanner.start == 4 && 
-                memcmp(scanner.start, "true", 4) == 0) {
-                return TOKEN_TRUE;
-            }
-            if (scanner.current - scanner.start == 3 && 
-                memcmp(scanner.start, "try", 3) == 0) {
-                return TOKEN_TRY;
-            }
-            if (scanner.current - scanner.start == 5 && 
-                memcmp(scanner.start, "throw", 5) == 0) {
-                return TOKEN_THROW;
-            }
-            if (scanner.current - scanner.start == 4 && 
-                memcmp(scanner.start, "this", 4) == 0) {
-                return TOKEN_THIS;
-            }
-            break;
-        case 'w':
-            if (scanner.current - scanner.start == 5 && 
-                memcmp(scanner.start, "while", 5) == 0) {
-                return TOKEN_WHILE;
-            }
-            break;
-        case 'y':
-            if (scanner.current - scanner.start == 5 && 
-                memcmp(scanner.start, "yield", 5) == 0) {
-                return TOKEN_YIELD;
-            }
-            break;
+static ember_token_type identifier_type(lexer* lx) {
+    int length = (int)(lx->current - lx->start);
+    if (length < KEYWORD_MIN_LENGTH || length > KEYWORD_MAX_LENGTH) return TOKEN_IDENTIFIER;
+    
+    const uint8_t* name = (const uint8_t*)lx->start;
+    unsigned slot = ((unsigned)length + keyword_asso[name[0]] + keyword_asso[name[1]] +
+                     keyword_asso[name[length - 1]]) & (KEYWORD_SLOTS - 1);
+    const struct keyword* keyword = &keywords[slot];
+    if (keyword->length == length && memcmp(keyword->name, lx->start, (size_t)length) == 0) {
+        return keyword->type;
     }
     return TOKEN_IDENTIFIER;
 }
 
-static ember_token identifier() {
-    while (isalnum(peek_char()) || peek_char() == '_') advance();
-    return make_token(identifier_type());
+static ember_token identifier(lexer* lx) {
+    lx->current = skip_ident(lx->current);
+    return make_token(lx, identifier_type(lx));
 }
 
-ember_token scan_token() {
-    skip_whitespace();
-    scanner.start = scanner.current;
+ember_token lexer_scan_token(lexer* lx) {
+    skip_whitespace(lx);
+    lx->start = lx->current;
     
-    if (is_at_end()) return make_token(TOKEN_EOF);
+    if (is_at_end(lx)) return make_token(lx, TOKEN_EOF);
     
-    char c = advance();
+    char c = advance(lx);
     
-    if (isdigit(c)) return number();
-    if (isalpha(c) || c == '_') return identifier();
+    if (CHAR_IS(c, CHAR_DIGIT)) return number(lx);
+    if (CHAR_IS(c, CHAR_ALPHA)) return identifier(lx);
     
     switch (c) {
-        case '(': return make_token(TOKEN_LPAREN);
-        case ')': return make_token(TOKEN_RPAREN);
-        case '{': return make_token(TOKEN_LBRACE);
-        case '}': return make_token(TOKEN_RBRACE);
-        case '[': return make_token(TOKEN_LBRACKET);
-        case ']': return make_token(TOKEN_RBRACKET);
-        case ',': return make_token(TOKEN_COMMA);
+        case '(': return make_token(lx, TOKEN_LPAREN);
+        case ')': return make_token(lx, TOKEN_RPAREN);
+        case '{': return make_token(lx, TOKEN_LBRACE);
+        case '}': return make_token(lx, TOKEN_RBRACE);
+        case '[': return make_token(lx, TOKEN_LBRACKET);
+        case ']': return make_token(lx, TOKEN_RBRACKET);
+        case ',': return make_token(lx, TOKEN_COMMA);
         case '+':
-            if (peek_char() == '+') {
-                advance();
-                return make_token(TOKEN_PLUS_PLUS);
+            if (peek_char(lx) == '+') {
+                advance(lx);
+                return make_token(lx, TOKEN_PLUS_PLUS);
             }
-            if (peek_char() == '=') {
-                advance();
-                return make_token(TOKEN_PLUS_EQUAL);
+            if (peek_char(lx) == '=') {
+                advance(lx);
+                return make_token(lx, TOKEN_PLUS_EQUAL);
             }
-            return make_token(TOKEN_PLUS);
+            return make_token(lx, TOKEN_PLUS);
         case '-':
-            if (peek_char() == '-') {
-                advance();
-                return make_token(TOKEN_MINUS_MINUS);
+            if (peek_char(lx) == '-') {
+                advance(lx);
+                return make_token(lx, TOKEN_MINUS_MINUS);
             }
-            if (peek_char() == '=') {
-                advance();
-                return make_token(TOKEN_MINUS_EQUAL);
+            if (peek_char(lx) == '=') {
+                advance(lx);
+                return make_token(lx, TOKEN_MINUS_EQUAL);
             }
-            return make_token(TOKEN_MINUS);
+            return make_token(lx, TOKEN_MINUS);
         case '*':
-            if (peek_char() == '=') {
-                advance();
-                return make_token(TOKEN_MULTIPLY_EQUAL);
+            if (peek_char(lx) == '=') {
+                advance(lx);
+                return make_token(lx, TOKEN_MULTIPLY_EQUAL);
             }
-            return make_token(TOKEN_MULTIPLY);
+            return make_token(lx, TOKEN_MULTIPLY);
         case '/':
-            if (peek_char() == '=') {
-                advance();
-                return make_token(TOKEN_DIVIDE_EQUAL);
+            if (peek_char(lx) == '=') {
+                advance(lx);
+                return make_token(lx, TOKEN_DIVIDE_EQUAL);
             }
-            return make_token(TOKEN_DIVIDE);
-        case '%': return make_token(TOKEN_MODULO);
-        case '"': return string();
+            return make_token(lx, TOKEN_DIVIDE);
+        case '%': return make_token(lx, TOKEN_MODULO);
+        case '"': return string(lx);
         case '=':
-            if (peek_char() == '=') {
-                advance();
-                return make_token(TOKEN_EQUAL_EQUAL);
+            if (peek_char(lx) == '=') {
+                advance(lx);
+                return make_token(lx, TOKEN_EQUAL_EQUAL);
             }
-            return make_token(TOKEN_EQUAL);
+            return make_token(lx, TOKEN_EQUAL);
         case '!':
-            if (peek_char() == '=') {
-                advance();
-                return make_token(TOKEN_NOT_EQUAL);
+            if (peek_char(lx) == '=') {
+                advance(lx);
+                return make_token(lx, TOKEN_NOT_EQUAL);
             }
-            return make_token(TOKEN_NOT);
+            return make_token(lx, TOKEN_NOT);
         case '<':
-            if (peek_char() == '=') {
-                advance();
-                return make_token(TOKEN_LESS_EQUAL);
+            if (peek_char(lx) == '=') {
+                advance(lx);
+                return make_token(lx, TOKEN_LESS_EQUAL);
             }
-            return make_token(TOKEN_LESS);
+            return make_token(lx, TOKEN_LESS);
         case '>':
-            if (peek_char() == '=') {
-                advance();
-                return make_token(TOKEN_GREATER_EQUAL);
-            }
-            return make_token(TOKEN_GREATER);
-        case ':': return make_token(TOKEN_COLON);
-        case '@': return make_token(TOKEN_AT);
-        case ';': return make_token(TOKEN_SEMICOLON);
-        case '.': return make_token(TOKEN_DOT);
+            if (peek_char(lx) == '=') {
+                advance(lx);
+                return make_token(lx, TOKEN_GREATER_EQUAL);
+            }
+            return make_token(lx, TOKEN_GREATER);
+        case ':': return make_token(lx, TOKEN_COLON);
+        case '@': return make_token(lx, TOKEN_AT);
+        case ';': return make_token(lx, TOKEN_SEMICOLON);
+        case '.':
+            if (peek_char(lx) == '.') {
+                advance(lx);
+                return make_token(lx, TOKEN_DOT_DOT);
+            }
+            return make_token(lx, TOKEN_DOT);
         case '&':
-            if (peek_char() == '&') {
-                advance();
-                return make_token(TOKEN_AND_AND);
+            if (peek_char(lx) == '&') {
+                advance(lx);
+                return make_token(lx, TOKEN_AND_AND);
             }
-            return error_token("Unexpected character '&'");
+            return error_token(lx, "Unexpected character '&'");
         case '|':
-            if (peek_char() == '|') {
-                advance();
-                return make_token(TOKEN_OR_OR);
-            }
-            return error_token("Unexpected character '|'");
-        case '\n':
-            scanner.line++;
-            return make_token(TOKEN_NEWLINE);
+            if (peek_char(lx) == '|') {
+                advance(lx);
+                return make_token(lx, TOKEN_OR_OR);
+            }
+            return error_token(lx, "Unexpected character '|'");
+        case '\n': {
+            lx->line++;
+            ember_token token = make_token(lx, TOKEN_NEWLINE);
+            lx->line_start = lx->current;
+            return token;
+        }
     }
     
-    return error_token("Unexpected character");
+    return error_token(lx, "Unexpected character");
+}
+
+// Entry points for the parser, which scans through the calling thread's
+// lexer: each thread compiling scripts gets its own, and nested scans save
+// and restore it with get/set_scanner_state
+static __thread lexer scanner;
+
+void init_scanner(const char* source) {
+    lexer_init(&scanner, source);
+}
+
+ember_token scan_token(void) {
+    return lexer_scan_token(&scanner);
 }
 
-// Scanner state management for string interpolation
 lexer get_scanner_state(void) {
     return scanner;
 }
 
 void set_scanner_state(lexer state) {
     scanner = state;
-}
\ No newline at end of file
+}
@@ -8,9 +8,14 @@ typedef struct {
     const char* start;
     const char* current;
     int line;
+    const char* line_start;  // For token columns
 } lexer;
 
-// Lexer functions
+// Lexer over caller-owned state; independent lexers can run concurrently
+void lexer_init(lexer* lx, const char* source);
+ember_token lexer_scan_token(lexer* lx);
+
+// Lexer functions (on the calling thread's lexer)
 void init_scanner(const char* source);
 ember_token scan_token(void);
 
@@ -20,17 +20,15 @@
 
 // Generate bytecode for export call
 static void emit_export_call(ember_chunk* chunk, const char* export_name, int value_const_idx) {
-    // Push export name
     ember_value name_val = ember_make_string(export_name);
-    int name_const = add_constant(chunk, name_val);
-    emit_bytes(chunk, OP_PUSH_CONST, name_const);
+    int name_const = ember_chunk_add_constant(chunk, name_val);
     
     // Push value
-    emit_bytes(chunk, OP_PUSH_CONST, value_const_idx);
+    write_chunk_op(chunk, OP_PUSH_CONST, value_const_idx);
     
     // Call export function
     // For now, just store as global variable with export prefix
-    emit_byte(chunk, OP_SET_GLOBAL);
+    write_chunk_op(chunk, OP_SET_GLOBAL, name_const);
     emit_byte(chunk, OP_POP); // Pop the stored value
 }
 
@@ -56,7 +54,7 @@ void export_statement(ember_vm* vm, ember_chunk* chunk) {
                 name[name_token.length] = '\0';
                 
                 ember_value name_val = ember_make_string(name);
-                int name_const = add_constant(chunk, name_val);
+                int name_const = ember_chunk_add_constant(chunk, name_val);
                 emit_export_call(chunk, "default", name_const);
                 
                 free(name);
@@ -66,7 +64,7 @@ void export_statement(ember_vm* vm, ember_chunk* chunk) {
                 
                 // The function is now on top of stack, store temporarily
                 ember_value temp_val = ember_make_nil();
-                int temp_const = add_constant(chunk, temp_val);
+                int temp_const = ember_chunk_add_constant(chunk, temp_val);
                 emit_export_call(chunk, "default", temp_const);
             }
         } else {
@@ -75,7 +73,7 @@ void export_statement(ember_vm* vm, ember_chunk* chunk) {
             
             // The expression result is on stack, export it
             ember_value temp_val = ember_make_nil();
-            int temp_const = add_constant(chunk, temp_val);
+            int temp_const = ember_chunk_add_constant(chunk, temp_val);
             emit_export_call(chunk, "default", temp_const);
         }
         
@@ -102,9 +100,8 @@ void export_statement(ember_vm* vm, ember_chunk* chunk) {
             
             // Get the value from global scope
             ember_value var_name = ember_make_string(export_name);
-            int var_const = add_constant(chunk, var_name);
-            emit_bytes(chunk, OP_PUSH_CONST, var_const);
-            emit_byte(chunk, OP_GET_GLOBAL);
+            int var_const = ember_chunk_add_constant(chunk, var_name);
+            write_chunk_op(chunk, OP_GET_GLOBAL, var_const);
             
             // Export it with the alias name
             emit_export_call(chunk, alias_name, var_const);
@@ -168,9 +165,8 @@ void export_statement(ember_vm* vm, ember_chunk* chunk) {
             
             // Set as global variable
             ember_value name_val = ember_make_string(var_name);
-            int name_const = add_constant(chunk, name_val);
-            emit_bytes(chunk, OP_PUSH_CONST, name_const);
-            emit_byte(chunk, OP_SET_GLOBAL);
+            int name_const = ember_chunk_add_constant(chunk, name_val);
+            write_chunk_op(chunk, OP_SET_GLOBAL, name_const);
             
             // Also export it
             emit_export_call(chunk, var_name, name_const);
@@ -194,7 +190,7 @@ void export_statement(ember_vm* vm, ember_chunk* chunk) {
         
         // Export the function
         ember_value name_val = ember_make_string(func_name);
-        int name_const = add_constant(chunk, name_val);
+        int name_const = ember_chunk_add_constant(chunk, name_val);
         emit_export_call(chunk, func_name, name_const);
         
         free(func_name);
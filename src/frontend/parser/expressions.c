@@ -17,184 +17,361 @@ void number_literal(ember_chunk* chunk) {
     parser_state* parser = get_parser_state();
     double value = parser->previous.number;
     ember_value num_val = ember_make_number(value);
-    int const_idx = add_constant(chunk, num_val);
-    write_chunk(chunk, OP_PUSH_CONST);
-    write_chunk(chunk, const_idx);
+    int const_idx = ember_chunk_add_constant(chunk, num_val);
+    write_chunk_op(chunk, OP_PUSH_CONST, const_idx);
 }
 
-void string_literal(ember_chunk* chunk) {
+// Constant index of the string literal just consumed, or -1
+int string_constant(ember_chunk* chunk) {
     parser_state* parser = get_parser_state();
     // Extract string content (skip quotes) with bounds checking
     if (parser->previous.length < 2) {
         // Invalid string token - should have at least opening and closing quotes
-        return;
+        return -1;
     }
     int length = parser->previous.length - 2;
     if (length < 0) {
         // Additional safety check
+        return -1;
+    }
+    // Literals are interned so repeated occurrences share one constant string
+    ember_string* str = intern_string(parser->vm, parser->previous.start + 1, length);
+    if (!str) {
+        return -1;
+    }
+    ember_value string_val;
+    string_val.type = EMBER_VAL_STRING;
+    string_val.as.obj_val = (ember_object*)str;
+    return ember_chunk_add_constant(chunk, string_val);
+}
+
+void string_literal(ember_chunk* chunk) {
+    int const_idx = string_constant(chunk);
+    if (const_idx < 0) {
         return;
     }
-    char* str = malloc(length + 1);
-    if (str) {
-        if (length > 0) {
-            memcpy(str, parser->previous.start + 1, length);
-        }
-        str[length] = '\0';
-    } else {
-        // Memory allocation failed
+    write_chunk_op(chunk, OP_PUSH_CONST, const_idx);
+}
+
+// OP_CONCAT_N takes a one-byte count; longer templates fold into the running result
+#define INTERPOLATION_MAX_PARTS 255
+
+// Count one more part on the stack, folding a full run into a single string
+static void add_interpolation_part(ember_chunk* chunk, int* parts) {
+    if (++*parts == INTERPOLATION_MAX_PARTS) {
+        write_chunk(chunk, OP_CONCAT_N);
+        write_chunk(chunk, (uint8_t)*parts);
+        *parts = 1;
+    }
+}
+
+static void emit_interpolation_segment(ember_chunk* chunk, const char* start, int length) {
+    parser_state* parser = get_parser_state();
+    ember_string* segment = intern_string(parser->vm, start, length);
+    if (!segment) {
+        error("Out of memory in string interpolation");
+        return;
+    }
+    ember_value segment_val;
+    segment_val.type = EMBER_VAL_STRING;
+    segment_val.as.obj_val = (ember_object*)segment;
+    int const_idx = ember_chunk_add_constant(chunk, segment_val);
+    
+    write_chunk_op(chunk, OP_PUSH_CONST, const_idx);
+}
+
+// Compile the source of one ${...} hole in place by pointing the scanner at it,
+// then restore the scanner and token state of the enclosing expression
+static void compile_interpolation_expression(ember_chunk* chunk, const char* start, int length) {
+    parser_state* parser = get_parser_state();
+    
+    // The scanner stops at NUL, so the hole needs its own terminated copy
+    char* source = malloc(length + 1);
+    if (!source) {
+        error("Out of memory in string interpolation");
         return;
     }
+    memcpy(source, start, length);
+    source[length] = '\0';
     
-    // Use GC-managed string creation for proper concatenation support
-    ember_value string_val = ember_make_string_gc(parser->vm, str);
-    int const_idx = add_constant(chunk, string_val);
-    free(str);
+    lexer saved_scanner = get_scanner_state();
+    ember_token saved_current = parser->current;
+    ember_token saved_previous = parser->previous;
     
-    write_chunk(chunk, OP_PUSH_CONST);
-    write_chunk(chunk, const_idx);
+    lexer hole_scanner;
+    lexer_init(&hole_scanner, source);
+    hole_scanner.line = saved_previous.line;
+    set_scanner_state(hole_scanner);
+    
+    advance_parser();
+    if (check(TOKEN_EOF)) {
+        error("Expect expression inside '${}'");
+    } else {
+        expression(chunk);
+        if (!check(TOKEN_EOF)) {
+            error_at_current("Expect '}' after interpolated expression");
+        }
+    }
+    
+    set_scanner_state(saved_scanner);
+    parser->current = saved_current;
+    parser->previous = saved_previous;
+    free(source);
+}
+
+// Find the '}' closing a hole, skipping nested braces and quoted strings the
+// same way the lexer did when it scanned the token
+static const char* find_interpolation_end(const char* p, const char* end) {
+    int brace_count = 1;
+    while (p < end) {
+        if (*p == '"') {
+            p++;
+            while (p < end && *p != '"') {
+                if (*p == '\\' && p + 1 < end) p++;
+                p++;
+            }
+            if (p < end) p++;
+        } else if (*p == '{') {
+            brace_count++;
+            p++;
+        } else if (*p == '}') {
+            if (--brace_count == 0) return p;
+            p++;
+        } else {
+            p++;
+        }
+    }
+    return NULL;
 }
 
 void interpolated_string_literal(ember_chunk* chunk) {
     parser_state* parser = get_parser_state();
-    
     // Extract string content (skip quotes) with bounds checking
     if (parser->previous.length < 2) {
         // Invalid string token - should have at least opening and closing quotes
         return;
     }
-    int length = parser->previous.length - 2;
-    if (length < 0) {
-        // Additional safety check
-        return;
-    }
-    char* str = malloc(length + 1);
-    if (str) {
-        if (length > 0) {
-            memcpy(str, parser->previous.start + 1, length);
+    
+    // Split the template at compile time: literal segments become constants,
+    // each ${...} hole is compiled as an ordinary expression, and one
+    // OP_CONCAT_N joins them into a presized buffer at runtime
+    const char* p = parser->previous.start + 1;
+    const char* end = parser->previous.start + parser->previous.length - 1;
+    const char* segment = p;
+    int parts = 0;
+    
+    while (p < end) {
+        if (p[0] != '$' || p + 1 >= end || p[1] != '{') {
+            p++;
+            continue;
         }
-        str[length] = '\0';
-    } else {
-        // Memory allocation failed
-        return;
+        
+        const char* hole = p + 2;
+        const char* close = find_interpolation_end(hole, end);
+        if (!close) {
+            error("Unterminated '${' in string interpolation");
+            return;
+        }
+        
+        if (p > segment) {
+            emit_interpolation_segment(chunk, segment, (int)(p - segment));
+            add_interpolation_part(chunk, &parts);
+        }
+        compile_interpolation_expression(chunk, hole, (int)(close - hole));
+        add_interpolation_part(chunk, &parts);
+        
+        p = close + 1;
+        segment = p;
     }
     
-    // For now, use the OP_STRING_INTERPOLATE opcode to handle the interpolation
-    // Store the raw interpolated string as a constant and let the VM handle parsing
-    ember_value string_val = ember_make_string_gc(parser->vm, str);
-    int const_idx = add_constant(chunk, string_val);
-    
-    free(str);
+    if (end > segment || parts == 0) {
+        emit_interpolation_segment(chunk, segment, (int)(end - segment));
+        add_interpolation_part(chunk, &parts);
+    }
     
-    write_chunk(chunk, OP_PUSH_CONST);
-    write_chunk(chunk, const_idx);
-    write_chunk(chunk, OP_STRING_INTERPOLATE);
+    // A lone hole still goes through OP_CONCAT_N so the result is always a string
+    write_chunk(chunk, OP_CONCAT_N);
+    write_chunk(chunk, (uint8_t)parts);
 }
 
 void boolean_literal(ember_chunk* chunk) {
     parser_state* parser = get_parser_state();
     int is_true = parser->previous.type == TOKEN_TRUE;
     ember_value bool_val = ember_make_bool(is_true);
-    int const_idx = add_constant(chunk, bool_val);
-    write_chunk(chunk, OP_PUSH_CONST);
-    write_chunk(chunk, const_idx);
+    int const_idx = ember_chunk_add_constant(chunk, bool_val);
+    write_chunk_op(chunk, OP_PUSH_CONST, const_idx);
 }
 
-void variable(ember_chunk* chunk) {
+// Enter a function body: its parameters and locals get fresh slots starting at 0
+void begin_function_scope(local_scope* saved) {
+    parser_state* parser = get_parser_state();
+    *saved = parser->scope;
+    parser->scope.local_count = 0;
+    parser->scope.stack_depth = 0;
+    parser->scope.function_depth++;
+}
+
+// Leave a function body, restoring the enclosing function's (or top level's) slots
+void end_function_scope(const local_scope* saved) {
+    get_parser_state()->scope = *saved;
+}
+
+// Bind a name to the next slot of the current function; returns the slot
+int declare_local(const char* name, int length) {
     parser_state* parser = get_parser_state();
-    // Create string value from token
-    int length = parser->previous.length;
-    char* name = malloc(length + 1);
-    memcpy(name, parser->previous.start, length);
-    name[length] = '\0';
+    local_scope* scope = &parser->scope;
     
-    ember_value name_val = ember_make_string_gc(parser->vm, name);
-    int const_idx = add_constant(chunk, name_val);
-    free(name);
+    int existing = resolve_local(name, length);
+    if (existing >= 0) {
+        return existing;
+    }
+    if (scope->local_count >= EMBER_LOCALS_MAX) {
+        error("Too many local variables in function");
+        return -1;
+    }
+    
+    scope->locals[scope->local_count].name = name;
+    scope->locals[scope->local_count].length = length;
+    return scope->local_count++;
+}
+
+// A slot for compiler temporaries: no name resolves to it
+int declare_hidden_local(void) {
+    local_scope* scope = &get_parser_state()->scope;
+    if (scope->local_count >= EMBER_LOCALS_MAX) {
+        error("Too many local variables in function");
+        return -1;
+    }
+    scope->locals[scope->local_count].name = "";
+    scope->locals[scope->local_count].length = -1;
+    return scope->local_count++;
+}
+
+int resolve_local(const char* name, int length) {
+    local_scope* scope = &get_parser_state()->scope;
+    if (scope->function_depth == 0) {
+        return -1;
+    }
+    
+    for (int i = scope->local_count - 1; i >= 0; i--) {
+        local_variable* local = &scope->locals[i];
+        if (local->length == length && memcmp(local->name, name, length) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+variable_ref resolve_variable(ember_chunk* chunk, const char* name, int length) {
+    variable_ref ref;
+    
+    int slot = resolve_local(name, length);
+    if (slot >= 0) {
+        ref.get_op = OP_GET_LOCAL;
+        ref.set_op = OP_SET_LOCAL;
+        ref.operand = slot;
+        return ref;
+    }
+    
+    // Identifiers are interned straight from the token, so every use of a
+    // name shares one string and global lookups can compare pointers
+    ref.get_op = OP_GET_GLOBAL;
+    ref.set_op = OP_SET_GLOBAL;
+    ref.operand = -1;
+    ember_string* interned = intern_string(get_parser_state()->vm, name, length);
+    if (!interned) {
+        error("Out of memory while compiling variable name");
+        return ref;
+    }
+    ember_value name_val;
+    name_val.type = EMBER_VAL_STRING;
+    name_val.as.obj_val = (ember_object*)interned;
+    ref.operand = ember_chunk_add_constant(chunk, name_val);
+    return ref;
+}
+
+void emit_variable_get(ember_chunk* chunk, variable_ref ref) {
+    write_chunk_op(chunk, ref.get_op, ref.operand);
+}
+
+void emit_variable_set(ember_chunk* chunk, variable_ref ref) {
+    write_chunk_op(chunk, ref.set_op, ref.operand);
+}
+
+void variable(ember_chunk* chunk) {
+    parser_state* parser = get_parser_state();
+    variable_ref ref = resolve_variable(chunk, parser->previous.start, parser->previous.length);
+    if (ref.operand < 0) {
+        return;
+    }
     
     if (match(TOKEN_EQUAL)) {
         // Assignment: x = value
         expression(chunk);
-        write_chunk(chunk, OP_SET_GLOBAL);
-        write_chunk(chunk, const_idx);
+        emit_variable_set(chunk, ref);
     } else if (match(TOKEN_PLUS_EQUAL)) {
         // Compound assignment: x += value
         // Load current value
-        write_chunk(chunk, OP_GET_GLOBAL);
-        write_chunk(chunk, const_idx);
+        emit_variable_get(chunk, ref);
         // Parse right side
         expression(chunk);
         // Add them
         write_chunk(chunk, OP_ADD);
         // Store result
-        write_chunk(chunk, OP_SET_GLOBAL);
-        write_chunk(chunk, const_idx);
+        emit_variable_set(chunk, ref);
     } else if (match(TOKEN_MINUS_EQUAL)) {
         // Compound assignment: x -= value
-        write_chunk(chunk, OP_GET_GLOBAL);
-        write_chunk(chunk, const_idx);
+        emit_variable_get(chunk, ref);
         expression(chunk);
         write_chunk(chunk, OP_SUB);
-        write_chunk(chunk, OP_SET_GLOBAL);
-        write_chunk(chunk, const_idx);
+        emit_variable_set(chunk, ref);
     } else if (match(TOKEN_MULTIPLY_EQUAL)) {
         // Compound assignment: x *= value
-        write_chunk(chunk, OP_GET_GLOBAL);
-        write_chunk(chunk, const_idx);
+        emit_variable_get(chunk, ref);
         expression(chunk);
         write_chunk(chunk, OP_MUL);
-        write_chunk(chunk, OP_SET_GLOBAL);
-        write_chunk(chunk, const_idx);
+        emit_variable_set(chunk, ref);
     } else if (match(TOKEN_DIVIDE_EQUAL)) {
         // Compound assignment: x /= value
-        write_chunk(chunk, OP_GET_GLOBAL);
-        write_chunk(chunk, const_idx);
+        emit_variable_get(chunk, ref);
         expression(chunk);
         write_chunk(chunk, OP_DIV);
-        write_chunk(chunk, OP_SET_GLOBAL);
-        write_chunk(chunk, const_idx);
+        emit_variable_set(chunk, ref);
     } else if (match(TOKEN_PLUS_PLUS)) {
         // Postfix increment: x++
         // Load current value first (for return value)
-        write_chunk(chunk, OP_GET_GLOBAL);
-        write_chunk(chunk, const_idx);
+        emit_variable_get(chunk, ref);
         
         // Load current value again for increment
-        write_chunk(chunk, OP_GET_GLOBAL);
-        write_chunk(chunk, const_idx);
+        emit_variable_get(chunk, ref);
         
         // Add 1
         ember_value one = ember_make_number(1.0);
-        int one_idx = add_constant(chunk, one);
-        write_chunk(chunk, OP_PUSH_CONST);
-        write_chunk(chunk, one_idx);
+        int one_idx = ember_chunk_add_constant(chunk, one);
+        write_chunk_op(chunk, OP_PUSH_CONST, one_idx);
         write_chunk(chunk, OP_ADD);
         
         // Store new value
-        write_chunk(chunk, OP_SET_GLOBAL);
-        write_chunk(chunk, const_idx);
+        emit_variable_set(chunk, ref);
         write_chunk(chunk, OP_POP); // Pop the stored value
         
         // Original value is still on stack as return value
     } else if (match(TOKEN_MINUS_MINUS)) {
         // Postfix decrement: x--
         // Load current value first (for return value)
-        write_chunk(chunk, OP_GET_GLOBAL);
-        write_chunk(chunk, const_idx);
+        emit_variable_get(chunk, ref);
         
         // Load current value again for decrement
-        write_chunk(chunk, OP_GET_GLOBAL);
-        write_chunk(chunk, const_idx);
+        emit_variable_get(chunk, ref);
         
         // Subtract 1
         ember_value one = ember_make_number(1.0);
-        int one_idx = add_constant(chunk, one);
-        write_chunk(chunk, OP_PUSH_CONST);
-        write_chunk(chunk, one_idx);
+        int one_idx = ember_chunk_add_constant(chunk, one);
+        write_chunk_op(chunk, OP_PUSH_CONST, one_idx);
         write_chunk(chunk, OP_SUB);
         
         // Store new value
-        write_chunk(chunk, OP_SET_GLOBAL);
-        write_chunk(chunk, const_idx);
+        emit_variable_set(chunk, ref);
         write_chunk(chunk, OP_POP); // Pop the stored value
         
         // Original value is still on stack as return value
@@ -212,16 +389,14 @@ void variable(ember_chunk* chunk) {
         consume(TOKEN_RPAREN, "Expect ')' after arguments");
         
         // Load function name
-        write_chunk(chunk, OP_GET_GLOBAL);
-        write_chunk(chunk, const_idx);
+        emit_variable_get(chunk, ref);
         
         // Call function
         write_chunk(chunk, OP_CALL);
         write_chunk(chunk, arg_count);
     } else {
         // Variable access
-        write_chunk(chunk, OP_GET_GLOBAL);
-        write_chunk(chunk, const_idx);
+        emit_variable_get(chunk, ref);
     }
 }
 
@@ -254,9 +429,8 @@ void unary(ember_chunk* chunk) {
             // For negative numbers, push -1 and multiply
             {
                 ember_value neg_one = ember_make_number(-1);
-                int const_idx = add_constant(chunk, neg_one);
-                write_chunk(chunk, OP_PUSH_CONST);
-                write_chunk(chunk, const_idx);
+                int const_idx = ember_chunk_add_constant(chunk, neg_one);
+                write_chunk_op(chunk, OP_PUSH_CONST, const_idx);
                 write_chunk(chunk, OP_MUL);
             }
             break;
@@ -331,29 +505,22 @@ void prefix_increment(ember_chunk* chunk) {
     consume(TOKEN_IDENTIFIER, "Expect variable name after '++'");
     
     parser_state* parser = get_parser_state();
-    int length = parser->previous.length;
-    char* name = malloc(length + 1);
-    memcpy(name, parser->previous.start, length);
-    name[length] = '\0';
-    
-    ember_value name_val = ember_make_string_gc(parser->vm, name);
-    int const_idx = add_constant(chunk, name_val);
-    free(name);
+    variable_ref ref = resolve_variable(chunk, parser->previous.start, parser->previous.length);
+    if (ref.operand < 0) {
+        return;
+    }
     
     // Load current value
-    write_chunk(chunk, OP_GET_GLOBAL);
-    write_chunk(chunk, const_idx);
+    emit_variable_get(chunk, ref);
     
     // Add 1
     ember_value one = ember_make_number(1.0);
-    int one_idx = add_constant(chunk, one);
-    write_chunk(chunk, OP_PUSH_CONST);
-    write_chunk(chunk, one_idx);
+    int one_idx = ember_chunk_add_constant(chunk, one);
+    write_chunk_op(chunk, OP_PUSH_CONST, one_idx);
     write_chunk(chunk, OP_ADD);
     
     // Store new value
-    write_chunk(chunk, OP_SET_GLOBAL);
-    write_chunk(chunk, const_idx);
+    emit_variable_set(chunk, ref);
     
     // Leave the new value on stack for the expression result
 }
@@ -363,29 +530,22 @@ void prefix_decrement(ember_chunk* chunk) {
     consume(TOKEN_IDENTIFIER, "Expect variable name after '--'");
     
     parser_state* parser = get_parser_state();
-    int length = parser->previous.length;
-    char* name = malloc(length + 1);
-    memcpy(name, parser->previous.start, length);
-    name[length] = '\0';
-    
-    ember_value name_val = ember_make_string_gc(parser->vm, name);
-    int const_idx = add_constant(chunk, name_val);
-    free(name);
+    variable_ref ref = resolve_variable(chunk, parser->previous.start, parser->previous.length);
+    if (ref.operand < 0) {
+        return;
+    }
     
     // Load current value
-    write_chunk(chunk, OP_GET_GLOBAL);
-    write_chunk(chunk, const_idx);
+    emit_variable_get(chunk, ref);
     
     // Subtract 1
     ember_value one = ember_make_number(1.0);
-    int one_idx = add_constant(chunk, one);
-    write_chunk(chunk, OP_PUSH_CONST);
-    write_chunk(chunk, one_idx);
+    int one_idx = ember_chunk_add_constant(chunk, one);
+    write_chunk_op(chunk, OP_PUSH_CONST, one_idx);
     write_chunk(chunk, OP_SUB);
     
     // Store new value
-    write_chunk(chunk, OP_SET_GLOBAL);
-    write_chunk(chunk, const_idx);
+    emit_variable_set(chunk, ref);
     
     // Leave the new value on stack for the expression result
 }
@@ -604,9 +764,8 @@ void yield_expression(ember_chunk* chunk) {
     } else {
         // No expression provided, yield undefined
         ember_value nil_val = ember_make_nil();
-        int const_idx = add_constant(chunk, nil_val);
-        write_chunk(chunk, OP_PUSH_CONST);
-        write_chunk(chunk, const_idx);
+        int const_idx = ember_chunk_add_constant(chunk, nil_val);
+        write_chunk_op(chunk, OP_PUSH_CONST, const_idx);
     }
     
     // Emit YIELD instruction
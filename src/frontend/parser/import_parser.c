@@ -64,14 +64,13 @@ static void free_specifier_list(import_specifier_list* list) {
 static void emit_named_import(ember_chunk* chunk, const char* module_name, import_specifier_list* specifiers) {
     // Load the module
     ember_value module_name_val = ember_make_string(module_name);
-    int module_const = add_constant(chunk, module_name_val);
-    emit_bytes(chunk, OP_PUSH_CONST, module_const);
+    int module_const = ember_chunk_add_constant(chunk, module_name_val);
+    write_chunk_op(chunk, OP_PUSH_CONST, module_const);
     
     // Call import function (using native import)
     ember_value import_func = ember_make_string("import");
-    int import_const = add_constant(chunk, import_func);
-    emit_bytes(chunk, OP_PUSH_CONST, import_const);
-    emit_byte(chunk, OP_GET_GLOBAL);
+    int import_const = ember_chunk_add_constant(chunk, import_func);
+    write_chunk_op(chunk, OP_GET_GLOBAL, import_const);
     emit_bytes(chunk, OP_CALL, 1); // 1 argument (module name)
     
     // Extract each named export
@@ -84,15 +83,14 @@ static void emit_named_import(ember_chunk* chunk, const char* module_name, impor
         
         // Get the named property
         ember_value prop_name = ember_make_string(specifiers->specifiers[i].name);
-        int prop_const = add_constant(chunk, prop_name);
-        emit_bytes(chunk, OP_PUSH_CONST, prop_const);
+        int prop_const = ember_chunk_add_constant(chunk, prop_name);
+        write_chunk_op(chunk, OP_PUSH_CONST, prop_const);
         emit_byte(chunk, OP_HASH_MAP_GET);
         
         // Set as global variable with alias name
         ember_value alias_name = ember_make_string(specifiers->specifiers[i].alias);
-        int alias_const = add_constant(chunk, alias_name);
-        emit_bytes(chunk, OP_PUSH_CONST, alias_const);
-        emit_byte(chunk, OP_SET_GLOBAL);
+        int alias_const = ember_chunk_add_constant(chunk, alias_name);
+        write_chunk_op(chunk, OP_SET_GLOBAL, alias_const);
         emit_byte(chunk, OP_POP); // Pop the assigned value
     }
     
@@ -109,21 +107,19 @@ static void emit_named_import(ember_chunk* chunk, const char* module_name, impor
 static void emit_namespace_import(ember_chunk* chunk, const char* module_name, const char* namespace_name) {
     // Load the module
     ember_value module_name_val = ember_make_string(module_name);
-    int module_const = add_constant(chunk, module_name_val);
-    emit_bytes(chunk, OP_PUSH_CONST, module_const);
+    int module_const = ember_chunk_add_constant(chunk, module_name_val);
+    write_chunk_op(chunk, OP_PUSH_CONST, module_const);
     
     // Call import function
     ember_value import_func = ember_make_string("import");
-    int import_const = add_constant(chunk, import_func);
-    emit_bytes(chunk, OP_PUSH_CONST, import_const);
-    emit_byte(chunk, OP_GET_GLOBAL);
+    int import_const = ember_chunk_add_constant(chunk, import_func);
+    write_chunk_op(chunk, OP_GET_GLOBAL, import_const);
     emit_bytes(chunk, OP_CALL, 1);
     
     // Set as global variable with namespace name
     ember_value namespace_val = ember_make_string(namespace_name);
-    int namespace_const = add_constant(chunk, namespace_val);
-    emit_bytes(chunk, OP_PUSH_CONST, namespace_const);
-    emit_byte(chunk, OP_SET_GLOBAL);
+    int namespace_const = ember_chunk_add_constant(chunk, namespace_val);
+    write_chunk_op(chunk, OP_SET_GLOBAL, namespace_const);
     emit_byte(chunk, OP_POP);
 }
 
@@ -131,20 +127,19 @@ static void emit_namespace_import(ember_chunk* chunk, const char* module_name, c
 static void emit_default_import(ember_chunk* chunk, const char* module_name, const char* default_name) {
     // Load the module
     ember_value module_name_val = ember_make_string(module_name);
-    int module_const = add_constant(chunk, module_name_val);
-    emit_bytes(chunk, OP_PUSH_CONST, module_const);
+    int module_const = ember_chunk_add_constant(chunk, module_name_val);
+    write_chunk_op(chunk, OP_PUSH_CONST, module_const);
     
     // Call import function
     ember_value import_func = ember_make_string("import");
-    int import_const = add_constant(chunk, import_func);
-    emit_bytes(chunk, OP_PUSH_CONST, import_const);
-    emit_byte(chunk, OP_GET_GLOBAL);
+    int import_const = ember_chunk_add_constant(chunk, import_func);
+    write_chunk_op(chunk, OP_GET_GLOBAL, import_const);
     emit_bytes(chunk, OP_CALL, 1);
     
     // Try to get 'default' export, or use entire module
     ember_value default_key = ember_make_string("default");
-    int default_const = add_constant(chunk, default_key);
-    emit_bytes(chunk, OP_PUSH_CONST, default_const);
+    int default_const = ember_chunk_add_constant(chunk, default_key);
+    write_chunk_op(chunk, OP_PUSH_CONST, default_const);
     emit_byte(chunk, OP_HASH_MAP_GET);
     
     // Check if default export exists, otherwise use module itself
@@ -152,9 +147,8 @@ static void emit_default_import(ember_chunk* chunk, const char* module_name, con
     
     // Set as global variable
     ember_value name_val = ember_make_string(default_name);
-    int name_const = add_constant(chunk, name_val);
-    emit_bytes(chunk, OP_PUSH_CONST, name_const);
-    emit_byte(chunk, OP_SET_GLOBAL);
+    int name_const = ember_chunk_add_constant(chunk, name_val);
+    write_chunk_op(chunk, OP_SET_GLOBAL, name_const);
     emit_byte(chunk, OP_POP);
 }
 
@@ -260,14 +254,13 @@ void enhanced_import_statement(ember_vm* vm, ember_chunk* chunk) {
         
         // Just load the module (side effects only)
         ember_value module_name_val = ember_make_string(module_name);
-        int module_const = add_constant(chunk, module_name_val);
-        emit_bytes(chunk, OP_PUSH_CONST, module_const);
+        int module_const = ember_chunk_add_constant(chunk, module_name_val);
+        write_chunk_op(chunk, OP_PUSH_CONST, module_const);
         
         // Call import function
         ember_value import_func = ember_make_string("import");
-        int import_const = add_constant(chunk, import_func);
-        emit_bytes(chunk, OP_PUSH_CONST, import_const);
-        emit_byte(chunk, OP_GET_GLOBAL);
+        int import_const = ember_chunk_add_constant(chunk, import_func);
+        write_chunk_op(chunk, OP_GET_GLOBAL, import_const);
         emit_bytes(chunk, OP_CALL, 1);
         emit_byte(chunk, OP_POP); // Discard result
         
@@ -1,4 +1,6 @@
 #include "parser.h"
+#include "../../vm.h"
+#include "../../core/optimizer.h"
 #include "../../runtime/value/value.h"
 #include <string.h>
 #include <stdlib.h>
@@ -12,7 +14,6 @@ extern void consume(ember_token_type type, const char* message);
 extern void expression(ember_chunk* chunk);
 extern void emit_byte(ember_chunk* chunk, uint8_t byte);
 extern void emit_bytes(ember_chunk* chunk, uint8_t byte1, uint8_t byte2);
-extern int add_constant(ember_chunk* chunk, ember_value constant);
 extern void init_chunk(ember_chunk* chunk);
 extern void statement(ember_vm* vm, ember_chunk* chunk);
 extern void error_at(ember_token* token, const char* message);
@@ -20,13 +21,9 @@ extern void track_function_chunk(ember_vm* vm, ember_chunk* chunk);
 
 // Helper function to emit constant operation
 static void emit_constant(ember_chunk* chunk, ember_value value) {
-    int constant = add_constant(chunk, value);
-    if (constant < 256) {
-        emit_bytes(chunk, OP_PUSH_CONST, (uint8_t)constant);
-    } else {
-        // Handle large constant pools if needed
-        emit_bytes(chunk, OP_PUSH_CONST, (uint8_t)constant);
-    }
+    int constant = ember_chunk_add_constant(chunk, value);
+    // Indices past 255 get the OP_WIDE form
+    write_chunk_op(chunk, OP_PUSH_CONST, constant);
 }
 
 // Parse class declaration: class Name [extends Superclass] { ... }
@@ -56,20 +53,20 @@ void class_declaration(ember_vm* vm, ember_chunk* chunk) {
         
         // Emit code to get superclass from globals
         ember_value super_name_val = ember_make_string(super_name_str);
-        int super_name_idx = add_constant(chunk, super_name_val);
-        emit_bytes(chunk, OP_GET_GLOBAL, super_name_idx);
+        int super_name_idx = ember_chunk_add_constant(chunk, super_name_val);
+        write_chunk_op(chunk, OP_GET_GLOBAL, super_name_idx);
         
         free(super_name_str);
     }
     
     // Create the class
     ember_value class_name_val = ember_make_string(name_str);
-    int class_name_idx = add_constant(chunk, class_name_val);
+    int class_name_idx = ember_chunk_add_constant(chunk, class_name_val);
     
     if (has_superclass) {
-        emit_bytes(chunk, OP_INHERIT, class_name_idx);  // Pop superclass, push class
+        write_chunk_op(chunk, OP_INHERIT, class_name_idx);  // Pop superclass, push class
     } else {
-        emit_bytes(chunk, OP_CLASS_DEF, class_name_idx);  // Create new class
+        write_chunk_op(chunk, OP_CLASS_DEF, class_name_idx);  // Create new class
     }
     
     // Parse class body (class is on stack)
@@ -87,7 +84,7 @@ void class_declaration(ember_vm* vm, ember_chunk* chunk) {
     consume(TOKEN_RBRACE, "Expected '}' after class body");
     
     // Store class in global (class is still on stack)
-    emit_bytes(chunk, OP_SET_GLOBAL, class_name_idx);
+    write_chunk_op(chunk, OP_SET_GLOBAL, class_name_idx);
     emit_byte(chunk, OP_POP);  // Pop the class from stack
     free(name_str);
 }
@@ -105,14 +102,20 @@ void method_definition(ember_vm* vm, ember_chunk* chunk) {
     memcpy(name_str, method_name.start, method_name.length);
     name_str[method_name.length] = '\0';
     
-    // Parse parameters
+    // Parse parameters. Slot 0 holds the receiver (see this_expression), so
+    // parameters are bound from slot 1; the empty name never resolves
     consume(TOKEN_LPAREN, "Expected '(' after method name");
     
+    local_scope enclosing_scope;
+    begin_function_scope(&enclosing_scope);
+    declare_local("", 0);
+    
     int param_count = 0;
     if (!check(TOKEN_RPAREN)) {
         do {
             param_count++;
             consume(TOKEN_IDENTIFIER, "Expected parameter name");
+            declare_local(parser->previous.start, parser->previous.length);
             
             if (param_count > EMBER_MAX_ARGS) {
                 error_at(&parser->current, "Too many parameters");
@@ -162,15 +165,18 @@ void method_definition(ember_vm* vm, ember_chunk* chunk) {
     }
     
     consume(TOKEN_RBRACE, "Expected '}' after method body");
+    end_function_scope(&enclosing_scope);
     
     // Add implicit return at end of method
     emit_byte(method_chunk, OP_RETURN);
+    ember_optimize_for_level(method_chunk);
     
     // Create method value and emit it
     ember_value method_val;
     method_val.type = EMBER_VAL_FUNCTION;
     method_val.as.func_val.chunk = method_chunk;
     method_val.as.func_val.name = name_str;
+    ember_chunk_set_name(method_chunk, name_str);
     
     emit_constant(chunk, method_val);
     
@@ -205,8 +211,8 @@ void super_expression(ember_chunk* chunk) {
     name_str[method_name.length] = '\0';
     
     ember_value method_name_val = ember_make_string(name_str);
-    int method_name_idx = add_constant(chunk, method_name_val);
-    emit_bytes(chunk, OP_GET_SUPER, method_name_idx);
+    int method_name_idx = ember_chunk_add_constant(chunk, method_name_val);
+    write_chunk_op(chunk, OP_GET_SUPER, method_name_idx);
     
     free(name_str);
 }
@@ -224,8 +230,8 @@ void new_expression(ember_chunk* chunk) {
     
     // Load class from globals
     ember_value class_name_val = ember_make_string(name_str);
-    int class_name_idx = add_constant(chunk, class_name_val);
-    emit_bytes(chunk, OP_GET_GLOBAL, class_name_idx);
+    int class_name_idx = ember_chunk_add_constant(chunk, class_name_val);
+    write_chunk_op(chunk, OP_GET_GLOBAL, class_name_idx);
     
     // Create instance
     emit_byte(chunk, OP_INSTANCE_NEW);
@@ -286,10 +292,15 @@ void dot_expression(ember_chunk* chunk) {
         consume(TOKEN_RPAREN, "Expected ')' after arguments");
         emit_constant(chunk, property_name_val);
         emit_bytes(chunk, OP_INVOKE, (uint8_t)arg_count);
+    } else if (match(TOKEN_EQUAL)) {
+        // Property assignment: object.property = value
+        int property_name_idx = ember_chunk_add_constant(chunk, property_name_val);
+        expression(chunk);
+        write_chunk_op(chunk, OP_SET_PROPERTY, property_name_idx);
     } else {
         // Property access
-        int property_name_idx = add_constant(chunk, property_name_val);
-        emit_bytes(chunk, OP_GET_PROPERTY, property_name_idx);
+        int property_name_idx = ember_chunk_add_constant(chunk, property_name_val);
+        write_chunk_op(chunk, OP_GET_PROPERTY, property_name_idx);
     }
     
     free(name_str);
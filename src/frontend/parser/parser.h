@@ -6,8 +6,12 @@
 #include "../../runtime/package/package.h"
 
 // Loop context for break/continue tracking
+// Breaks per loop or switch; a switch dispatching a few hundred message
+// types has one per case
+#define PARSER_MAX_BREAKS 256
+
 typedef struct {
-    int break_jumps[16];    // Array to store break jump locations
+    int break_jumps[PARSER_MAX_BREAKS]; // Array to store break jump locations
     int break_count;        // Number of break jumps to patch
     int continue_jumps[16]; // Array to store continue jump locations
     int continue_count;     // Number of continue jumps to patch
@@ -24,7 +28,7 @@ typedef struct {
 
 // Exception context for try/catch/finally tracking
 typedef struct {
-    int handler_index;       // Index of exception handler in VM
+    int handler_index;       // Its entry in chunk->handlers (-1 until the try closes)
     int try_start;           // Start of try block
     catch_block_info catch_blocks[8];  // Multiple catch blocks
     int catch_count;         // Number of catch blocks
@@ -32,6 +36,29 @@ typedef struct {
     int stack_depth;         // Stack depth when try block started
 } exception_context;
 
+// Function-local variable, resolved to a slot index at compile time
+typedef struct {
+    const char* name;   // Points into the source being compiled
+    int length;
+} local_variable;
+
+// Local slots of the function being compiled. Slots are function-wide (there
+// is no block scoping); at top level every name remains a global.
+typedef struct {
+    local_variable locals[EMBER_LOCALS_MAX];
+    int local_count;
+    int function_depth;
+    int stack_depth;    // Values enclosing statements keep on the stack (switch subjects)
+} local_scope;
+
+// How a name is accessed: OP_GET/SET_LOCAL with a slot, or OP_GET/SET_GLOBAL
+// with the index of the interned name constant
+typedef struct {
+    uint8_t get_op;
+    uint8_t set_op;
+    int operand;        // -1 if the name could not be resolved
+} variable_ref;
+
 // Parser state
 typedef struct {
     ember_token current;
@@ -45,6 +72,7 @@ typedef struct {
     int exception_depth;         // Current exception nesting depth
     int in_async_function;       // Whether we're parsing an async function
     int in_generator_function;   // Whether we're parsing a generator function
+    local_scope scope;           // Locals of the function being compiled
 } parser_state;
 
 // Precedence levels
@@ -73,10 +101,21 @@ void parse_precedence(precedence prec, ember_chunk* chunk);
 // Literals and values
 void number_literal(ember_chunk* chunk);
 void string_literal(ember_chunk* chunk);
+int string_constant(ember_chunk* chunk);
 void interpolated_string_literal(ember_chunk* chunk);
 void boolean_literal(ember_chunk* chunk);
 void variable(ember_chunk* chunk);
 
+// Variable resolution
+void begin_function_scope(local_scope* saved);
+void end_function_scope(const local_scope* saved);
+int declare_local(const char* name, int length);
+int declare_hidden_local(void);
+int resolve_local(const char* name, int length);
+variable_ref resolve_variable(ember_chunk* chunk, const char* name, int length);
+void emit_variable_get(ember_chunk* chunk, variable_ref ref);
+void emit_variable_set(ember_chunk* chunk, variable_ref ref);
+
 // Statements
 void statement(ember_vm* vm, ember_chunk* chunk);
 void assignment_statement(ember_chunk* chunk);
@@ -138,7 +177,9 @@ int check(ember_token_type type);
 int match(ember_token_type type);
 void consume(ember_token_type type, const char* message);
 
-// Parser state access (for modular parser components)
+// Parser state access (for modular parser components). Returns the state
+// of the compile running on the calling thread, like scan_token's lexer, so
+// VM pool workers can compile at the same time.
 parser_state* get_parser_state(void);
 
 // Grouping and arrays
@@ -1,5 +1,6 @@
 #include "parser.h"
 #include "../../vm.h"
+#include "../../core/optimizer.h"
 #include "../../runtime/value/value.h"
 #include "../../runtime/package/package.h"
 #include <stdio.h>
@@ -10,24 +11,18 @@
 
 // Helper functions for increment expression generation
 static void generate_postfix_increment(ember_chunk* chunk, ember_token* identifier, int delta) {
-    // Create variable name string
-    char* name = malloc(identifier->length + 1);
-    memcpy(name, identifier->start, identifier->length);
-    name[identifier->length] = '\0';
-    
-    ember_value name_val = ember_make_string_gc(get_parser_state()->vm, name);
-    int const_idx = add_constant(chunk, name_val);
-    free(name);
+    variable_ref ref = resolve_variable(chunk, identifier->start, identifier->length);
+    if (ref.operand < 0) {
+        return;
+    }
     
     // Load current value
-    write_chunk(chunk, OP_GET_GLOBAL);
-    write_chunk(chunk, const_idx);
+    emit_variable_get(chunk, ref);
     
     // Add/subtract delta
     ember_value delta_val = ember_make_number((double)abs(delta));
-    int delta_idx = add_constant(chunk, delta_val);
-    write_chunk(chunk, OP_PUSH_CONST);
-    write_chunk(chunk, delta_idx);
+    int delta_idx = ember_chunk_add_constant(chunk, delta_val);
+    write_chunk_op(chunk, OP_PUSH_CONST, delta_idx);
     
     if (delta > 0) {
         write_chunk(chunk, OP_ADD);
@@ -36,9 +31,8 @@ static void generate_postfix_increment(ember_chunk* chunk, ember_token* identifi
     }
     
     // Store new value
-    write_chunk(chunk, OP_SET_GLOBAL);
-    write_chunk(chunk, const_idx);
-    // Note: OP_SET_GLOBAL leaves the value on stack, we should pop it
+    emit_variable_set(chunk, ref);
+    // Note: the store leaves the value on stack, we should pop it
     // However, this needs to be conditional for for-loop continue statements
     write_chunk(chunk, OP_POP); // Pop the stored value
 }
@@ -50,25 +44,19 @@ static void generate_prefix_increment(ember_chunk* chunk, ember_token* identifie
 }
 
 static void generate_compound_assignment(ember_chunk* chunk, ember_token* identifier, ember_token* operator, ember_token* value) {
-    // Create variable name string
-    char* name = malloc(identifier->length + 1);
-    memcpy(name, identifier->start, identifier->length);
-    name[identifier->length] = '\0';
-    
-    ember_value name_val = ember_make_string_gc(get_parser_state()->vm, name);
-    int const_idx = add_constant(chunk, name_val);
-    free(name);
+    variable_ref ref = resolve_variable(chunk, identifier->start, identifier->length);
+    if (ref.operand < 0) {
+        return;
+    }
     
     // Load current value
-    write_chunk(chunk, OP_GET_GLOBAL);
-    write_chunk(chunk, const_idx);
+    emit_variable_get(chunk, ref);
     
     // Push the operand value
     double operand_value = value->number;
     ember_value operand_val = ember_make_number(operand_value);
-    int operand_idx = add_constant(chunk, operand_val);
-    write_chunk(chunk, OP_PUSH_CONST);
-    write_chunk(chunk, operand_idx);
+    int operand_idx = ember_chunk_add_constant(chunk, operand_val);
+    write_chunk_op(chunk, OP_PUSH_CONST, operand_idx);
     
     // Emit the appropriate operation
     switch (operator->type) {
@@ -91,11 +79,32 @@ static void generate_compound_assignment(ember_chunk* chunk, ember_token* identi
     }
     
     // Store new value
-    write_chunk(chunk, OP_SET_GLOBAL);
-    write_chunk(chunk, const_idx);
+    emit_variable_set(chunk, ref);
     write_chunk(chunk, OP_POP); // Pop the stored value
 }
 
+// Jump offsets are measured from the end of the jump instruction. Jumps
+// emitted with write_chunk_jump carry a 2-byte operand at operand_pos
+static int patch_jump(ember_chunk* chunk, int operand_pos, int target) {
+    return patch_chunk_jump(chunk, operand_pos, target - (operand_pos + 2));
+}
+
+static int patch_jump_back(ember_chunk* chunk, int operand_pos, int target) {
+    return patch_chunk_jump(chunk, operand_pos, (operand_pos + 2) - target);
+}
+
+// OP_LOOP's backward distance is known up front, so short loops keep the
+// 1-byte operand; the offset counts one past the end of the instruction
+static void emit_loop(ember_chunk* chunk, int loop_start) {
+    int offset = chunk->count + 2 + 1 - loop_start;
+    if (offset > 0xFF) {
+        offset = chunk->count + 4 + 1 - loop_start;
+    }
+    if (!write_chunk_op(chunk, OP_LOOP, offset)) {
+        error("Loop body too large");
+    }
+}
+
 void parse_loop_body(ember_vm* vm, ember_chunk* chunk) {
     if (match(TOKEN_LBRACE)) {
         // Parse block statement with multiple statements
@@ -158,39 +167,30 @@ void do_while_statement(ember_vm* vm, ember_chunk* chunk) {
     consume(TOKEN_RPAREN, "Expect ')' after do-while condition");
     
     // Jump back to start if condition is true (note: opposite of while loop)
-    write_chunk(chunk, OP_JUMP_IF_FALSE);
-    int exit_jump = chunk->count;
-    write_chunk(chunk, 0); // Placeholder for exit jump offset
+    int exit_jump = write_chunk_jump(chunk, OP_JUMP_IF_FALSE); // Patched below
     
     // Jump back to loop start (continue loop)
-    write_chunk(chunk, OP_LOOP);
-    int loop_offset = chunk->count - loop_start + 2;
-    write_chunk(chunk, loop_offset);
+    emit_loop(chunk, loop_start);
     
     // Patch the exit jump - jump to after the loop
-    int exit_offset = chunk->count - exit_jump - 1;
-    if (exit_offset < 0 || exit_offset > 255) {
+    if (!patch_jump(chunk, exit_jump, chunk->count)) {
         error("Jump offset too large for do-while loop");
         return;
     }
-    chunk->code[exit_jump] = (uint8_t)exit_offset;
     
     // Patch all break statements to jump here
     for (int i = 0; i < loop_ctx->break_count; i++) {
-        int break_jump = loop_ctx->break_jumps[i];
-        chunk->code[break_jump] = chunk->count - break_jump - 1;
+        if (!patch_jump(chunk, loop_ctx->break_jumps[i], chunk->count)) {
+            error("Break jump offset too large");
+        }
     }
     
     // Patch all continue statements to jump to loop start (for body re-execution)
     for (int i = 0; i < loop_ctx->continue_count; i++) {
-        int continue_jump = loop_ctx->continue_jumps[i];
-        // Calculate backward jump offset: jump from (continue_jump + 1) to continue_target
-        int continue_offset = (continue_jump + 1) - loop_ctx->continue_target;
-        if (continue_offset < 0 || continue_offset > 255) {
+        // Backward jump from the end of the OP_CONTINUE to continue_target
+        if (!patch_jump_back(chunk, loop_ctx->continue_jumps[i], loop_ctx->continue_target)) {
             error("Continue jump offset too large");
-            continue;
         }
-        chunk->code[continue_jump] = (uint8_t)continue_offset;
     }
     
     // Clean up loop context
@@ -219,42 +219,33 @@ void while_statement(ember_vm* vm, ember_chunk* chunk) {
     expression(chunk);
     
     // Jump out of loop if condition is false
-    write_chunk(chunk, OP_JUMP_IF_FALSE);
-    int exit_jump = chunk->count;
-    write_chunk(chunk, 0); // Placeholder for jump offset (will be patched)
+    int exit_jump = write_chunk_jump(chunk, OP_JUMP_IF_FALSE); // Patched below
     
     // Parse body (supports both single expressions and block statements)
     parse_loop_body(vm, chunk);
     
     // Jump back to loop condition
-    write_chunk(chunk, OP_LOOP);
-    int loop_offset = chunk->count - loop_start + 2;
-    write_chunk(chunk, loop_offset);
+    emit_loop(chunk, loop_start);
     
     // Patch the exit jump - jump to after the loop
-    int exit_offset = chunk->count - exit_jump - 1;
-    if (exit_offset < 0 || exit_offset > 255) {
+    if (!patch_jump(chunk, exit_jump, chunk->count)) {
         error("Jump offset too large for while loop");
         return;
     }
-    chunk->code[exit_jump] = (uint8_t)exit_offset;
     
     // Patch all break statements to jump here
     for (int i = 0; i < loop_ctx->break_count; i++) {
-        int break_jump = loop_ctx->break_jumps[i];
-        chunk->code[break_jump] = chunk->count - break_jump - 1;
+        if (!patch_jump(chunk, loop_ctx->break_jumps[i], chunk->count)) {
+            error("Break jump offset too large");
+        }
     }
     
     // Patch all continue statements to jump to loop start
     for (int i = 0; i < loop_ctx->continue_count; i++) {
-        int continue_jump = loop_ctx->continue_jumps[i];
-        // Calculate backward jump offset: jump from (continue_jump + 1) to continue_target
-        int continue_offset = (continue_jump + 1) - loop_ctx->continue_target;
-        if (continue_offset < 0 || continue_offset > 255) {
+        // Backward jump from the end of the OP_CONTINUE to continue_target
+        if (!patch_jump_back(chunk, loop_ctx->continue_jumps[i], loop_ctx->continue_target)) {
             error("Continue jump offset too large");
-            continue;
         }
-        chunk->code[continue_jump] = (uint8_t)continue_offset;
     }
     
     // Clean up loop context
@@ -268,9 +259,7 @@ void if_statement(ember_vm* vm, ember_chunk* chunk) {
     expression(chunk);
     
     // Jump to else clause if condition is false
-    write_chunk(chunk, OP_JUMP_IF_FALSE);
-    int then_jump = chunk->count;
-    write_chunk(chunk, 0); // Placeholder for jump offset (will be patched)
+    int then_jump = write_chunk_jump(chunk, OP_JUMP_IF_FALSE); // Patched below
     
     // Parse then body - support both single statement and block
     if (check(TOKEN_LBRACE)) {
@@ -297,17 +286,13 @@ void if_statement(ember_vm* vm, ember_chunk* chunk) {
     }
     
     // Jump over else clause
-    write_chunk(chunk, OP_JUMP);
-    int else_jump = chunk->count;
-    write_chunk(chunk, 0); // Placeholder for jump offset (will be patched)
+    int else_jump = write_chunk_jump(chunk, OP_JUMP); // Patched below
     
     // Patch the then jump to here (start of else clause)
-    int then_offset = chunk->count - then_jump - 1;
-    if (then_offset < 0 || then_offset > 255) {
+    if (!patch_jump(chunk, then_jump, chunk->count)) {
         error("Jump offset too large for if statement");
         return;
     }
-    chunk->code[then_jump] = (uint8_t)then_offset;
     
     // Parse optional else clause
     if (match(TOKEN_ELSE)) {
@@ -336,12 +321,10 @@ void if_statement(ember_vm* vm, ember_chunk* chunk) {
     }
     
     // Patch the else jump to here (end of if statement)
-    int else_offset = chunk->count - else_jump - 1;
-    if (else_offset < 0 || else_offset > 255) {
+    if (!patch_jump(chunk, else_jump, chunk->count)) {
         error("Jump offset too large for else clause");
         return;
     }
-    chunk->code[else_jump] = (uint8_t)else_offset;
     
     // If statements don't produce values - no need to push nil
 }
@@ -355,13 +338,11 @@ void break_statement(ember_chunk* chunk) {
     }
     
     // Emit OP_BREAK with placeholder offset
-    write_chunk(chunk, OP_BREAK);
-    int break_jump = chunk->count;
-    write_chunk(chunk, 0); // Placeholder for jump offset (will be patched)
+    int break_jump = write_chunk_jump(chunk, OP_BREAK);
     
     // Store the break jump location for later patching
     loop_context* current_loop = &parser->loop_stack[parser->loop_depth - 1];
-    if (current_loop->break_count < 16) {
+    if (current_loop->break_count < PARSER_MAX_BREAKS) {
         current_loop->break_jumps[current_loop->break_count++] = break_jump;
     } else {
         error("Too many break statements in single loop");
@@ -377,9 +358,7 @@ void continue_statement(ember_chunk* chunk) {
     }
     
     // Emit OP_CONTINUE with placeholder offset
-    write_chunk(chunk, OP_CONTINUE);
-    int continue_jump = chunk->count;
-    write_chunk(chunk, 0); // Placeholder for jump offset (will be patched)
+    int continue_jump = write_chunk_jump(chunk, OP_CONTINUE);
     
     // Store the continue jump location for later patching
     loop_context* current_loop = &parser->loop_stack[parser->loop_depth - 1];
@@ -390,14 +369,155 @@ void continue_statement(ember_chunk* chunk) {
     }
 }
 
+// Range loops: for i in a..b { body } (or "for (i in a..b)") counts i from
+// a up to, not including, b. The bound is evaluated once; a number literal
+// bound is used in place. Inside a function i is a local, so the test and
+// the increment are the GET_LOCAL, PUSH_CONST, LESS, JUMP_IF_FALSE and
+// GET_LOCAL, PUSH_CONST, ADD, SET_LOCAL, POP sequences instruction fusion
+// turns into one superinstruction each; nothing is allocated, unlike
+// iterating over an array of the numbers. "in" is only a keyword here.
+static int is_range_for(void) {
+    lexer lookahead = get_scanner_state();
+    ember_token name = get_parser_state()->current;
+    if (name.type == TOKEN_LPAREN) name = lexer_scan_token(&lookahead);
+    if (name.type != TOKEN_IDENTIFIER) return 0;
+    ember_token in = lexer_scan_token(&lookahead);
+    return in.type == TOKEN_IDENTIFIER && in.length == 2 && memcmp(in.start, "in", 2) == 0;
+}
+
+// Constant index of a number literal bound (the literal is consumed), or -1
+static int range_literal_bound(ember_chunk* chunk) {
+    parser_state* parser = get_parser_state();
+    if (!check(TOKEN_NUMBER)) return -1;
+    lexer lookahead = get_scanner_state();
+    ember_token next = lexer_scan_token(&lookahead);
+    if (next.type != TOKEN_LBRACE && next.type != TOKEN_RPAREN) return -1;
+    advance_parser();
+    return ember_chunk_add_constant(chunk, ember_make_number(parser->previous.number));
+}
+
+// Where a computed bound is kept: a slot no name resolves to, or at top
+// level, which has no slots, a global no identifier can spell
+static variable_ref range_bound_variable(ember_chunk* chunk) {
+    parser_state* parser = get_parser_state();
+    variable_ref ref = {OP_GET_LOCAL, OP_SET_LOCAL, -1};
+    if (parser->scope.function_depth > 0) {
+        ref.operand = declare_hidden_local();
+        return ref;
+    }
+    char name[32];
+    int length = snprintf(name, sizeof(name), "(range %d)", parser->loop_depth);
+    ember_string* interned = intern_string(parser->vm, name, length);
+    if (!interned) {
+        error("Out of memory while compiling range loop");
+        return ref;
+    }
+    ember_value name_val;
+    name_val.type = EMBER_VAL_STRING;
+    name_val.as.obj_val = (ember_object*)interned;
+    ref.get_op = OP_GET_GLOBAL;
+    ref.set_op = OP_SET_GLOBAL;
+    ref.operand = ember_chunk_add_constant(chunk, name_val);
+    return ref;
+}
+
+static void range_for_statement(ember_vm* vm, ember_chunk* chunk) {
+    parser_state* parser = get_parser_state();
+    int parenthesized = match(TOKEN_LPAREN);
+    consume(TOKEN_IDENTIFIER, "Expect loop variable name");
+    ember_token name = parser->previous;
+    advance_parser(); // 'in'
+    if (parser->scope.function_depth > 0) {
+        declare_local(name.start, name.length);
+    }
+    variable_ref counter = resolve_variable(chunk, name.start, name.length);
+    if (counter.operand < 0) return;
+    
+    // Both ends are evaluated before the counter is assigned
+    expression(chunk);
+    consume(TOKEN_DOT_DOT, "Expect '..' in range");
+    int bound_constant = range_literal_bound(chunk);
+    variable_ref bound = {OP_GET_LOCAL, OP_SET_LOCAL, -1};
+    if (bound_constant < 0) {
+        expression(chunk);
+        bound = range_bound_variable(chunk);
+        if (bound.operand < 0) return;
+        emit_variable_set(chunk, bound);
+        write_chunk(chunk, OP_POP);
+    }
+    if (parenthesized) {
+        consume(TOKEN_RPAREN, "Expect ')' after range");
+    }
+    emit_variable_set(chunk, counter);
+    write_chunk(chunk, OP_POP);
+    
+    if (parser->loop_depth >= 8) {
+        error("Maximum loop nesting depth exceeded");
+        return;
+    }
+    loop_context* loop_ctx = &parser->loop_stack[parser->loop_depth++];
+    loop_ctx->break_count = 0;
+    loop_ctx->continue_count = 0;
+    
+    int loop_start = chunk->count;
+    emit_variable_get(chunk, counter);
+    if (bound_constant >= 0) {
+        write_chunk_op(chunk, OP_PUSH_CONST, bound_constant);
+    } else {
+        emit_variable_get(chunk, bound);
+    }
+    write_chunk(chunk, OP_LESS);
+    int exit_jump = write_chunk_jump(chunk, OP_JUMP_IF_FALSE); // Patched below
+    
+    parse_loop_body(vm, chunk);
+    
+    int increment_start = chunk->count;
+    generate_postfix_increment(chunk, &name, 1);
+    emit_loop(chunk, loop_start);
+    
+    if (!patch_jump(chunk, exit_jump, chunk->count)) {
+        error("Jump offset too large for range loop");
+    }
+    for (int i = 0; i < loop_ctx->break_count; i++) {
+        if (!patch_jump(chunk, loop_ctx->break_jumps[i], chunk->count)) {
+            error("Break jump offset too large");
+        }
+    }
+    // Continue goes forward to the increment, as in a C-style for
+    for (int i = 0; i < loop_ctx->continue_count; i++) {
+        int continue_jump = loop_ctx->continue_jumps[i];
+        chunk->code[continue_jump - 1] = OP_JUMP;
+        if (!patch_jump(chunk, continue_jump, increment_start)) {
+            error("Continue jump offset too large");
+        }
+    }
+    
+    parser->loop_depth--;
+}
+
 void for_statement(ember_vm* vm, ember_chunk* chunk) {
+    if (is_range_for()) {
+        range_for_statement(vm, chunk);
+        return;
+    }
+    
     // C-style for loop: for (init; condition; increment) { body }
     // Implementation: init; loop_start: if (!condition) goto end; body; increment; goto loop_start; end:
     
     consume(TOKEN_LPAREN, "Expect '(' after 'for'");
     
-    // Parse and emit initialization expression
+    // Parse and emit initialization expression; inside a function, an
+    // initializer of the form `name = ...` declares name as a local slot
     if (!check(TOKEN_SEMICOLON)) {
+        parser_state* init_parser = get_parser_state();
+        if (init_parser->scope.function_depth > 0 && check(TOKEN_IDENTIFIER)) {
+            // Peek through a copy; the parser's lexer stays where it is
+            lexer lookahead = get_scanner_state();
+            ember_token next = lexer_scan_token(&lookahead);
+            if (next.type == TOKEN_EQUAL) {
+                declare_local(init_parser->current.start, init_parser->current.length);
+            }
+        }
         expression(chunk);
         write_chunk(chunk, OP_POP);  // Pop init result from stack
     }
@@ -422,9 +542,7 @@ void for_statement(ember_vm* vm, ember_chunk* chunk) {
     int exit_jump = -1;
     if (!check(TOKEN_SEMICOLON)) {
         expression(chunk);
-        write_chunk(chunk, OP_JUMP_IF_FALSE);
-        exit_jump = chunk->count;
-        write_chunk(chunk, 0);  // Placeholder for jump offset (will be patched)
+        exit_jump = write_chunk_jump(chunk, OP_JUMP_IF_FALSE);  // Patched below
     }
     consume(TOKEN_SEMICOLON, "Expect ';' after for loop condition");
     
@@ -520,15 +638,8 @@ void for_statement(ember_vm* vm, ember_chunk* chunk) {
                 if (increment_tokens[0].type == TOKEN_IDENTIFIER && 
                     increment_tokens[1].type == TOKEN_EQUAL) {
                     
-                    // Get variable name
                     ember_token var_token = increment_tokens[0];
-                    char* name = malloc(var_token.length + 1);
-                    memcpy(name, var_token.start, var_token.length);
-                    name[var_token.length] = '\0';
-                    
-                    ember_value name_val = ember_make_string_gc(parser->vm, name);
-                    int const_idx = add_constant(chunk, name_val);
-                    free(name);
+                    variable_ref ref = resolve_variable(chunk, var_token.start, var_token.length);
                     
                     // Parse right-hand side as expression
                     // For "j + 1", we need to evaluate the tokens
@@ -540,21 +651,18 @@ void for_statement(ember_vm* vm, ember_chunk* chunk) {
                         // Handle "j = j + 1" pattern
                         
                         // Load variable j
-                        write_chunk(chunk, OP_GET_GLOBAL);
-                        write_chunk(chunk, const_idx);
+                        emit_variable_get(chunk, ref);
                         
                         // Load constant 1
                         ember_value num_val = ember_make_number(1.0);  // Assume +1 for now
-                        int num_idx = add_constant(chunk, num_val);
-                        write_chunk(chunk, OP_PUSH_CONST);
-                        write_chunk(chunk, num_idx);
+                        int num_idx = ember_chunk_add_constant(chunk, num_val);
+                        write_chunk_op(chunk, OP_PUSH_CONST, num_idx);
                         
                         // Add
                         write_chunk(chunk, OP_ADD);
                         
                         // Store back to variable
-                        write_chunk(chunk, OP_SET_GLOBAL);
-                        write_chunk(chunk, const_idx);
+                        emit_variable_set(chunk, ref);
                         write_chunk(chunk, OP_POP);  // Pop the result
                     }
                 }
@@ -570,19 +678,18 @@ void for_statement(ember_vm* vm, ember_chunk* chunk) {
     }
     
     // Jump back to condition check
-    write_chunk(chunk, OP_LOOP);
-    int loop_offset = chunk->count - loop_start + 2;
-    write_chunk(chunk, loop_offset);
+    emit_loop(chunk, loop_start);
     
     // Patch exit jump if we had a condition
-    if (exit_jump != -1) {
-        chunk->code[exit_jump] = chunk->count - exit_jump - 1;
+    if (exit_jump != -1 && !patch_jump(chunk, exit_jump, chunk->count)) {
+        error("Jump offset too large for for loop");
     }
     
     // Patch all break statements to jump here
     for (int i = 0; i < current_loop->break_count; i++) {
-        int break_offset = current_loop->break_jumps[i];
-        chunk->code[break_offset] = chunk->count - break_offset - 1;
+        if (!patch_jump(chunk, current_loop->break_jumps[i], chunk->count)) {
+            error("Break jump offset too large");
+        }
     }
     
     // Patch all continue statements to jump to appropriate target
@@ -602,20 +709,14 @@ void for_statement(ember_vm* vm, ember_chunk* chunk) {
             // For loops with increment: use forward jump (OP_JUMP) to increment section
             // Change OP_CONTINUE to OP_JUMP at continue_jump - 1
             chunk->code[continue_jump - 1] = OP_JUMP;
-            int continue_offset = continue_target - continue_jump - 1;
-            if (continue_offset < 0 || continue_offset > 255) {
+            if (!patch_jump(chunk, continue_jump, continue_target)) {
                 error("Continue jump offset too large");
-                continue;
             }
-            chunk->code[continue_jump] = (uint8_t)continue_offset;
         } else {
             // For loops without increment: use backward jump (OP_CONTINUE) to condition
-            int continue_offset = (continue_jump + 1) - continue_target;
-            if (continue_offset < 0 || continue_offset > 255) {
+            if (!patch_jump_back(chunk, continue_jump, continue_target)) {
                 error("Continue jump offset too large");
-                continue;
             }
-            chunk->code[continue_jump] = (uint8_t)continue_offset;
         }
     }
     
@@ -665,6 +766,12 @@ void import_statement(ember_vm* vm, ember_chunk* chunk) {
         }
     }
     
+    // Prefetch workers only compile; the importing VM loads it when linking
+    if (vm && vm->defer_imports) {
+        free(module_name);
+        return;
+    }
+    
     // Package management
     EmberPackage package;
     if (!ember_package_discover(module_name, &package)) {
@@ -704,6 +811,8 @@ void import_statement(ember_vm* vm, ember_chunk* chunk) {
 }
 
 void statement(ember_vm* vm, ember_chunk* chunk) {
+    // Line table for profiles and reports
+    ember_chunk_mark_position(chunk, get_parser_state()->current.line, get_parser_state()->current.column);
     if (match(TOKEN_ASYNC)) {
         // Handle async function declaration
         consume(TOKEN_FN, "Expect 'fn' after 'async'");
@@ -758,9 +867,8 @@ void return_statement(ember_chunk* chunk) {
     } else {
         // Return nil if no expression
         ember_value nil_val = ember_make_nil();
-        int const_idx = add_constant(chunk, nil_val);
-        write_chunk(chunk, OP_PUSH_CONST);
-        write_chunk(chunk, const_idx);
+        int const_idx = ember_chunk_add_constant(chunk, nil_val);
+        write_chunk_op(chunk, OP_PUSH_CONST, const_idx);
     }
     write_chunk(chunk, OP_RETURN);
 }
@@ -776,16 +884,9 @@ void assignment_statement(ember_chunk* chunk) {
         // This is indexed assignment: identifier[index] = value
         
         // Load the container (array or hash map)
-        char* name = malloc(identifier.length + 1);
-        memcpy(name, identifier.start, identifier.length);
-        name[identifier.length] = '\0';
+        variable_ref ref = resolve_variable(chunk, identifier.start, identifier.length);
         
-        ember_value name_val = ember_make_string(name);
-        int const_idx = add_constant(chunk, name_val);
-        free(name);
-        
-        write_chunk(chunk, OP_GET_GLOBAL);
-        write_chunk(chunk, const_idx);
+        emit_variable_get(chunk, ref);
         
         // Parse index expression
         expression(chunk);
@@ -804,20 +905,13 @@ void assignment_statement(ember_chunk* chunk) {
         write_chunk(chunk, OP_POP);
     } else if (match(TOKEN_EQUAL)) {
         // Regular variable assignment: identifier = value
-        char* name = malloc(identifier.length + 1);
-        memcpy(name, identifier.start, identifier.length);
-        name[identifier.length] = '\0';
-        
-        ember_value name_val = ember_make_string(name);
-        int const_idx = add_constant(chunk, name_val);
-        free(name);
+        variable_ref ref = resolve_variable(chunk, identifier.start, identifier.length);
         
         // Parse value expression
         expression(chunk);
         
         // Emit variable assignment instruction
-        write_chunk(chunk, OP_SET_GLOBAL);
-        write_chunk(chunk, const_idx);
+        emit_variable_set(chunk, ref);
         
         // Pop the result to prevent stack buildup  
         write_chunk(chunk, OP_POP);
@@ -829,10 +923,11 @@ void assignment_statement(ember_chunk* chunk) {
         int start_count = chunk->count;
         expression(chunk);
         
-        // Check if this was an assignment by looking for OP_SET_GLOBAL in the generated code
+        // Check if this was an assignment by looking for a store in the generated code
         bool has_assignment = false;
         for (int i = start_count; i < chunk->count; i++) {
-            if (chunk->code[i] == OP_SET_GLOBAL) {
+            if (chunk->code[i] == OP_SET_GLOBAL || chunk->code[i] == OP_SET_LOCAL ||
+                chunk->code[i] == OP_SET_PROPERTY) {
                 has_assignment = true;
                 break;
             }
@@ -849,10 +944,11 @@ void expression_statement(ember_chunk* chunk) {
     int start_count = chunk->count;
     expression(chunk);
     
-    // Check if this was an assignment by looking for OP_SET_GLOBAL or OP_ARRAY_SET in the generated code
+    // Check if this was an assignment by looking for a store or OP_ARRAY_SET in the generated code
     bool has_assignment = false;
     for (int i = start_count; i < chunk->count; i++) {
-        if (chunk->code[i] == OP_SET_GLOBAL || chunk->code[i] == OP_ARRAY_SET) {
+        if (chunk->code[i] == OP_SET_GLOBAL || chunk->code[i] == OP_SET_LOCAL ||
+            chunk->code[i] == OP_ARRAY_SET || chunk->code[i] == OP_SET_PROPERTY) {
             has_assignment = true;
             break;
         }
@@ -864,25 +960,24 @@ void expression_statement(ember_chunk* chunk) {
     }
 }
 
-void function_definition(ember_vm* vm, ember_chunk* chunk) {
-    (void)chunk; // Parameter used in future implementation
-    // Parse function name
-    consume(TOKEN_IDENTIFIER, "Expect function name");
-    
-    // Get function name
-    int name_length = get_parser_state()->previous.length;
-    char* func_name = malloc(name_length + 1);
-    memcpy(func_name, get_parser_state()->previous.start, name_length);
-    func_name[name_length] = '\0';
-    
+// Compile "(params) { body }", starting at the current token, into func_chunk
+static void function_body(ember_vm* vm, ember_chunk* func_chunk) {
     // Parse parameter list
     consume(TOKEN_LPAREN, "Expect '(' after function name");
     
-    int param_count = 0;
+    // Parameters occupy the first local slots, in order, matching where
+    // OP_CALL places the arguments
+    local_scope enclosing_scope;
+    begin_function_scope(&enclosing_scope);
+    
     if (!check(TOKEN_RPAREN)) {
         do {
             consume(TOKEN_IDENTIFIER, "Expect parameter name");
-            param_count++;
+            ember_token param = get_parser_state()->previous;
+            if (resolve_local(param.start, param.length) >= 0) {
+                error("Duplicate parameter name");
+            }
+            declare_local(param.start, param.length);
         } while (match(TOKEN_COMMA));
     }
     consume(TOKEN_RPAREN, "Expect ')' after parameters");
@@ -890,13 +985,6 @@ void function_definition(ember_vm* vm, ember_chunk* chunk) {
     // Parse function body
     consume(TOKEN_LBRACE, "Expect '{' before function body");
     
-    // Create a new chunk for the function body
-    ember_chunk* func_chunk = malloc(sizeof(ember_chunk));
-    init_chunk(func_chunk);
-    
-    // Track this function chunk for cleanup
-    track_function_chunk(vm, func_chunk);
-    
     // Parse function body statements
     // Keep parsing until we find the closing brace
     for (;;) {
@@ -931,23 +1019,251 @@ void function_definition(ember_vm* vm, ember_chunk* chunk) {
         error("Expect '}' after function body");
     }
     
+    end_function_scope(&enclosing_scope);
+    
     // Add return instruction at end of function if not already present
     write_chunk(func_chunk, OP_RETURN);
+    // Inlining needs the functions defined so far, which only the VM knows
+    if (vm_get_optimization_level() >= 2) {
+        ember_optimize_inline_calls(vm, func_chunk, NULL);
+    }
+    ember_optimize_for_level(func_chunk);
+}
+
+// Lazy function bodies. With vm->lazy_functions set, a top-level function
+// definition only scans its tokens to the matching '}' and keeps a copy of
+// that source; ember_chunk_compile_lazy compiles it before the first call.
+// A module whose functions mostly never run then pays for scanning them,
+// not for code generation, constants and the optimizer. Compiling a body
+// must have no effect but filling its chunk, so bodies that define
+// functions or classes or import modules (all of which bind names while
+// compiling) are compiled at once, and so is anything that does not scan
+// or has unbalanced braces, to report the error where it always was.
+struct ember_lazy_body {
+    char* source;   // "(params) { body }", indented to its column so tokens keep their columns
+    int line;       // Line of the '('
+};
+
+static int lazy_allowed(ember_vm* vm) {
+    parser_state* parser = get_parser_state();
+    // Nested or inside a loop, try or async/generator body, the body would
+    // compile against parser state that is gone by the first call
+    return vm->lazy_functions && !vm->debug_hooks && parser->scope.function_depth == 0 &&
+           parser->loop_depth == 0 && parser->exception_depth == 0 &&
+           !parser->in_async_function && !parser->in_generator_function;
+}
+
+// Scan from the '(' to the '}' closing the body. Returns the body's source,
+// or NULL with the scanner and tokens put back so it compiles now
+static ember_lazy_body* skim_function_body(void) {
+    parser_state* parser = get_parser_state();
+    lexer saved_scanner = get_scanner_state();
+    ember_token saved_current = parser->current;
+    ember_token saved_previous = parser->previous;
+    ember_token open = parser->current;
+    
+    int depth = 0;
+    int params_closed = 0;
+    int done = 0;
+    int lazy = open.type == TOKEN_LPAREN;
+    while (lazy && !done) {
+        parser->previous = parser->current;
+        parser->current = scan_token();
+        switch (parser->current.type) {
+            case TOKEN_LBRACE:
+                if (!params_closed) lazy = 0;
+                else depth++;
+                break;
+            case TOKEN_RBRACE:
+                if (depth == 0) lazy = 0;
+                else done = --depth == 0;
+                break;
+            case TOKEN_RPAREN:
+                if (depth == 0) {
+                    if (params_closed) lazy = 0;
+                    params_closed = 1;
+                }
+                break;
+            case TOKEN_IDENTIFIER:
+            case TOKEN_COMMA:
+                if (depth == 0 && params_closed) lazy = 0;
+                break;
+            case TOKEN_EOF:
+            case TOKEN_ERROR:
+            case TOKEN_FN:
+            case TOKEN_FUNCTION:
+            case TOKEN_ASYNC:
+            case TOKEN_CLASS:
+            case TOKEN_IMPORT:
+            case TOKEN_EXPORT:
+                lazy = 0;
+                break;
+            default:
+                // Only the parameter list comes before the body
+                if (depth == 0) lazy = 0;
+                break;
+        }
+    }
+    
+    ember_lazy_body* body = NULL;
+    if (lazy) {
+        const char* end = parser->current.start + parser->current.length;
+        int indent = open.column > 1 ? open.column - 1 : 0;
+        size_t length = (size_t)(end - open.start);
+        body = malloc(sizeof(ember_lazy_body));
+        char* source = body ? malloc((size_t)indent + length + 1) : NULL;
+        if (source) {
+            memset(source, ' ', (size_t)indent);
+            memcpy(source + indent, open.start, length);
+            source[indent + length] = '\0';
+            body->source = source;
+            body->line = open.line;
+        } else {
+            free(body);
+            body = NULL;
+        }
+    }
+    if (!body) {
+        set_scanner_state(saved_scanner);
+        parser->current = saved_current;
+        parser->previous = saved_previous;
+        return NULL;
+    }
+    advance_parser(); // Past the closing brace
+    return body;
+}
+
+void function_definition(ember_vm* vm, ember_chunk* chunk) {
+    (void)chunk; // Parameter used in future implementation
+    // Parse function name
+    consume(TOKEN_IDENTIFIER, "Expect function name");
+    
+    // Get function name
+    int name_length = get_parser_state()->previous.length;
+    char* func_name = malloc(name_length + 1);
+    memcpy(func_name, get_parser_state()->previous.start, name_length);
+    func_name[name_length] = '\0';
+    
+    // Create a new chunk for the function body
+    ember_chunk* func_chunk = malloc(sizeof(ember_chunk));
+    init_chunk(func_chunk);
+    
+    // Track this function chunk for cleanup
+    track_function_chunk(vm, func_chunk);
+    
+    func_chunk->lazy_body = lazy_allowed(vm) ? skim_function_body() : NULL;
+    if (!func_chunk->lazy_body) {
+        function_body(vm, func_chunk);
+    }
     
     // Create function value
     ember_value func_val;
     func_val.type = EMBER_VAL_FUNCTION;
     func_val.as.func_val.chunk = func_chunk;
     func_val.as.func_val.name = func_name;
+    ember_chunk_set_name(func_chunk, func_name);
     
     // Store function in global scope
-    vm->globals[vm->global_count].key = func_name;
-    vm->globals[vm->global_count].value = func_val;
-    vm->global_count++;
+    ember_global_define(vm, func_name, func_val);
     
     // Function definition doesn't need to push values to main execution stack
 }
 
+int ember_chunk_compile_lazy(ember_vm* vm, ember_chunk* chunk) {
+    if (!vm || !chunk) return EMBER_ERROR_INVALID_PARAMETER;
+    ember_lazy_body* body = chunk->lazy_body;
+    if (!body) return EMBER_SUCCESS;
+    
+    // This may run in the middle of another compile (a call made while
+    // loading a module), so set the thread's parser aside
+    parser_state* parser = get_parser_state();
+    parser_state* saved = malloc(sizeof(parser_state));
+    if (!saved) return EMBER_ERROR_MEMORY_ALLOCATION;
+    *saved = *parser;
+    lexer saved_scanner = get_scanner_state();
+    
+    memset(parser, 0, sizeof(parser_state));
+    parser->vm = vm;
+    lexer body_scanner;
+    lexer_init(&body_scanner, body->source);
+    body_scanner.line = body->line;
+    set_scanner_state(body_scanner);
+    chunk->lazy_body = NULL;
+    advance_parser();
+    function_body(vm, chunk);
+    int ok = !parser->had_error;
+    
+    *parser = *saved;
+    set_scanner_state(saved_scanner);
+    free(saved);
+    if (ok) {
+        free(body->source);
+        free(body);
+        return EMBER_SUCCESS;
+    }
+    
+    // Drop the partial code and keep the source, so every call fails alike
+    char* name = chunk->name;
+    chunk->name = NULL;
+    free_chunk(chunk);
+    init_chunk(chunk);
+    chunk->name = name;
+    chunk->lazy_body = body;
+    ember_error* error = ember_error_runtime(vm, "Syntax error in function body");
+    ember_vm_set_error(vm, error);
+    return EMBER_ERROR_OPERATION_FAILED;
+}
+
+int ember_vm_compile_lazy_functions(ember_vm* vm) {
+    if (!vm) return EMBER_ERROR_INVALID_PARAMETER;
+    int result = EMBER_SUCCESS;
+    for (int i = 0; i < vm->function_chunk_count; i++) {
+        int compiled = ember_chunk_compile_lazy(vm, vm->function_chunks[i]);
+        if (compiled != EMBER_SUCCESS) result = compiled;
+    }
+    return result;
+}
+
+void ember_chunk_free_lazy_body(ember_chunk* chunk) {
+    if (!chunk || !chunk->lazy_body) return;
+    free(chunk->lazy_body->source);
+    free(chunk->lazy_body);
+    chunk->lazy_body = NULL;
+}
+
+void ember_vm_set_lazy_functions(ember_vm* vm, int enable) {
+    if (vm) vm->lazy_functions = enable != 0;
+}
+
+// Record a finished try statement: throws from the try block go to the
+// catch block (or straight to finally), throws from the catch block to finally
+static void add_exception_handlers(ember_chunk* chunk, exception_context* exc_ctx, int try_end) {
+    const catch_block_info* catch_block = exc_ctx->catch_count > 0 ? &exc_ctx->catch_blocks[0] : NULL;
+    ember_handler_entry entry;
+    entry.start = exc_ctx->try_start;
+    entry.end = try_end;
+    entry.stack_depth = exc_ctx->stack_depth;
+    if (catch_block) {
+        entry.handler = catch_block->catch_start;
+        entry.kind = EMBER_HANDLER_CATCH;
+    } else {
+        entry.handler = exc_ctx->finally_start;
+        entry.kind = EMBER_HANDLER_FINALLY;
+    }
+    exc_ctx->handler_index = ember_chunk_add_handler(chunk, &entry);
+
+    if (catch_block && exc_ctx->finally_start >= 0) {
+        entry.start = catch_block->catch_start;
+        entry.end = catch_block->catch_end;
+        entry.handler = exc_ctx->finally_start;
+        entry.kind = EMBER_HANDLER_FINALLY;
+        ember_chunk_add_handler(chunk, &entry);
+    }
+    if (exc_ctx->handler_index < 0) {
+        error("Out of memory recording exception handler");
+    }
+}
+
 void try_statement(ember_vm* vm, ember_chunk* chunk) {
     parser_state* parser = get_parser_state();
     
@@ -957,16 +1273,14 @@ void try_statement(ember_vm* vm, ember_chunk* chunk) {
         return;
     }
     
+    // No instructions mark the try block: its range goes into the chunk's
+    // exception table, which the VM only reads when something throws
     exception_context* exc_ctx = &parser->exception_stack[parser->exception_depth++];
     exc_ctx->try_start = chunk->count;
     exc_ctx->catch_count = 0;
     exc_ctx->finally_start = -1;
-    exc_ctx->stack_depth = 0; // Will be set by VM at runtime
-    
-    // Emit TRY_BEGIN instruction
-    write_chunk(chunk, OP_TRY_BEGIN);
-    exc_ctx->handler_index = chunk->count;
-    write_chunk(chunk, 0xFF); // Placeholder for handler index
+    exc_ctx->stack_depth = parser->scope.stack_depth;
+    exc_ctx->handler_index = -1;
     
     // Parse try block
     consume(TOKEN_LBRACE, "Expect '{' after 'try'");
@@ -981,12 +1295,11 @@ void try_statement(ember_vm* vm, ember_chunk* chunk) {
         }
     }
     consume(TOKEN_RBRACE, "Expect '}' after try block");
+    int try_end = chunk->count;
     
-    // Emit TRY_END instruction
-    write_chunk(chunk, OP_TRY_END);
-    
-    // Handle catch block
+    // Handle catch block; normal completion of the try block jumps over it
     if (match(TOKEN_CATCH)) {
+        int skip_catch = write_chunk_jump(chunk, OP_JUMP);
         if (exc_ctx->catch_count >= 8) {
             error("Too many catch blocks");
             return;
@@ -1011,14 +1324,13 @@ void try_statement(ember_vm* vm, ember_chunk* chunk) {
         }
         
         // Emit CATCH_BEGIN instruction
-        write_chunk(chunk, OP_CATCH_BEGIN);
         if (catch_block->variable_name) {
             // Add exception variable name as constant
-            ember_value var_name = ember_make_string(catch_block->variable_name);
-            int const_idx = add_constant(chunk, var_name);
-            write_chunk(chunk, const_idx);
+            ember_value var_name = ember_make_string_gc(vm, catch_block->variable_name);
+            int const_idx = ember_chunk_add_constant(chunk, var_name);
+            write_chunk_op(chunk, OP_CATCH_BEGIN, const_idx);
         } else {
-            write_chunk(chunk, 0xFF); // No variable binding
+            write_chunk_op(chunk, OP_CATCH_BEGIN, 0xFF); // No variable binding
         }
         
         // Parse catch block
@@ -1037,6 +1349,10 @@ void try_statement(ember_vm* vm, ember_chunk* chunk) {
         
         // Emit CATCH_END instruction
         write_chunk(chunk, OP_CATCH_END);
+        catch_block->catch_end = chunk->count;
+        if (!patch_jump(chunk, skip_catch, chunk->count)) {
+            error("Catch block too large");
+        }
     }
     
     // Handle finally block
@@ -1067,6 +1383,8 @@ void try_statement(ember_vm* vm, ember_chunk* chunk) {
     // Must have at least catch or finally
     if (exc_ctx->catch_count == 0 && exc_ctx->finally_start == -1) {
         error("'try' statement must have either 'catch' or 'finally' block");
+    } else {
+        add_exception_handlers(chunk, exc_ctx, try_end);
     }
     
     // Clean up exception context
@@ -1095,7 +1413,7 @@ void async_function_definition(ember_vm* vm, ember_chunk* chunk) {
     name_str[name.length] = '\0';
     
     ember_value name_val = ember_make_string_gc(vm, name_str);
-    int const_idx = add_constant(chunk, name_val);
+    int const_idx = ember_chunk_add_constant(chunk, name_val);
     (void)const_idx; // Reserved for future bytecode implementation
     free(name_str);
     
@@ -1115,9 +1433,15 @@ void async_function_definition(ember_vm* vm, ember_chunk* chunk) {
     int prev_async = parser->in_async_function;
     parser->in_async_function = 1;
     
+    // Parameters are not bound yet, but the body still must not see the
+    // enclosing function's slots
+    local_scope enclosing_scope;
+    begin_function_scope(&enclosing_scope);
+    
     // Create a new chunk for the async function body
     ember_chunk* func_chunk = malloc(sizeof(ember_chunk));
     init_chunk(func_chunk);
+    func_chunk->is_generator = 1;
     track_function_chunk(vm, func_chunk);
     
     // Parse function body statements
@@ -1141,9 +1465,11 @@ void async_function_definition(ember_vm* vm, ember_chunk* chunk) {
     
     // Restore async context
     parser->in_async_function = prev_async;
+    end_function_scope(&enclosing_scope);
     
     // Add return instruction
     write_chunk(func_chunk, OP_RETURN);
+    ember_optimize_for_level(func_chunk);
     
     // Create async function value - for now, just store as regular function
     // In a full implementation, this would wrap the function to return a Promise
@@ -1153,12 +1479,9 @@ void async_function_definition(ember_vm* vm, ember_chunk* chunk) {
     func_val.as.func_val.name = NULL; // Avoid use-after-free
     
     // Store function directly in globals without stack operations
-    char* name_cstr = (name_val.type == EMBER_VAL_STRING && name_val.as.obj_val) ? 
-                      AS_CSTRING(name_val) : (char*)name_val.as.string_val;
-    vm->globals[vm->global_count].key = malloc(strlen(name_cstr) + 1);
-    strcpy(vm->globals[vm->global_count].key, name_cstr);
-    vm->globals[vm->global_count].value = func_val;
-    vm->global_count++;
+    const char* name_cstr = (name_val.type == EMBER_VAL_STRING && name_val.as.obj_val) ? 
+                      AS_CSTRING(name_val) : (const char*)name_val.as.string_val;
+    ember_global_define(vm, name_cstr, func_val);
 }
 
 // Generator function definition
@@ -1175,7 +1498,7 @@ void generator_function_definition(ember_vm* vm, ember_chunk* chunk) {
     name_str[name.length] = '\0';
     
     ember_value name_val = ember_make_string_gc(vm, name_str);
-    int const_idx = add_constant(chunk, name_val);
+    int const_idx = ember_chunk_add_constant(chunk, name_val);
     (void)const_idx; // Reserved for future bytecode implementation
     free(name_str);
     
@@ -1195,6 +1518,11 @@ void generator_function_definition(ember_vm* vm, ember_chunk* chunk) {
     int prev_generator = parser->in_generator_function;
     parser->in_generator_function = 1;
     
+    // Parameters are not bound yet, but the body still must not see the
+    // enclosing function's slots
+    local_scope enclosing_scope;
+    begin_function_scope(&enclosing_scope);
+    
     // Create a new chunk for the generator function body
     ember_chunk* func_chunk = malloc(sizeof(ember_chunk));
     init_chunk(func_chunk);
@@ -1221,9 +1549,11 @@ void generator_function_definition(ember_vm* vm, ember_chunk* chunk) {
     
     // Restore generator context
     parser->in_generator_function = prev_generator;
+    end_function_scope(&enclosing_scope);
     
     // Add return instruction (generators auto-complete when they reach the end)
     write_chunk(func_chunk, OP_RETURN);
+    ember_optimize_for_level(func_chunk);
     
     // Create generator constructor - this would create a generator when called
     ember_value gen_constructor;
@@ -1232,12 +1562,142 @@ void generator_function_definition(ember_vm* vm, ember_chunk* chunk) {
     gen_constructor.as.func_val.name = NULL; // Avoid use-after-free
     
     // Store generator function directly in globals without stack operations
-    char* name_cstr = (name_val.type == EMBER_VAL_STRING && name_val.as.obj_val) ? 
-                      AS_CSTRING(name_val) : (char*)name_val.as.string_val;
-    vm->globals[vm->global_count].key = malloc(strlen(name_cstr) + 1);
-    strcpy(vm->globals[vm->global_count].key, name_cstr);
-    vm->globals[vm->global_count].value = gen_constructor;
-    vm->global_count++;
+    const char* name_cstr = (name_val.type == EMBER_VAL_STRING && name_val.as.obj_val) ? 
+                      AS_CSTRING(name_val) : (const char*)name_val.as.string_val;
+    ember_global_define(vm, name_cstr, gen_constructor);
+}
+
+// Switches with at least this many cases, all number or string literals,
+// dispatch through a jump table (src/core/vm_switch.c) instead of comparing
+// case by case
+#define SWITCH_TABLE_MIN_CASES 4
+
+// Whether the switch body at the current '{' only has number and string
+// literal cases, and enough of them. Scans a copy of the lexer; the
+// parser's stays where it is
+static int switch_cases_are_literals(void) {
+    if (!check(TOKEN_LBRACE)) return 0;
+    lexer lookahead = get_scanner_state();
+    int depth = 0;
+    int cases = 0;
+    for (;;) {
+        ember_token token = lexer_scan_token(&lookahead);
+        switch (token.type) {
+            case TOKEN_LBRACE:
+                depth++;
+                break;
+            case TOKEN_RBRACE:
+                if (depth-- == 0) return cases >= SWITCH_TABLE_MIN_CASES;
+                break;
+            case TOKEN_EOF:
+            case TOKEN_ERROR:
+                return 0;
+            case TOKEN_CASE:
+                if (depth > 0) break;  // A nested switch's
+                token = lexer_scan_token(&lookahead);
+                if (token.type == TOKEN_MINUS) {
+                    token = lexer_scan_token(&lookahead);
+                    if (token.type != TOKEN_NUMBER) return 0;
+                } else if (token.type != TOKEN_NUMBER && token.type != TOKEN_STRING) {
+                    return 0;
+                }
+                if (lexer_scan_token(&lookahead).type != TOKEN_COLON) return 0;
+                cases++;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Constant index of the literal after 'case' (checked by
+// switch_cases_are_literals), or -1
+static int switch_case_constant(ember_chunk* chunk) {
+    parser_state* parser = get_parser_state();
+    if (match(TOKEN_STRING)) return string_constant(chunk);
+    int negative = match(TOKEN_MINUS);
+    consume(TOKEN_NUMBER, "Expect number or string after 'case'");
+    double value = parser->previous.number;
+    return ember_chunk_add_constant(chunk, ember_make_number(negative ? -value : value));
+}
+
+// Statements of one case (or of the default, which runs to the closing brace)
+static void switch_case_body(ember_vm* vm, ember_chunk* chunk, int is_default) {
+    while (!check(TOKEN_RBRACE) && !check(TOKEN_EOF) &&
+           (is_default || (!check(TOKEN_CASE) && !check(TOKEN_DEFAULT)))) {
+        if (match(TOKEN_NEWLINE) || match(TOKEN_SEMICOLON)) continue;
+        statement(vm, chunk);
+        if (match(TOKEN_NEWLINE) || match(TOKEN_SEMICOLON)) {
+            // Consumed separator
+        } else if (!check(TOKEN_RBRACE) && !check(TOKEN_EOF) &&
+                   (is_default || (!check(TOKEN_CASE) && !check(TOKEN_DEFAULT)))) {
+            error(is_default ? "Expect newline, semicolon, or '}' after statement"
+                             : "Expect newline, semicolon, or next case after statement");
+            break;
+        }
+    }
+}
+
+// OP_SWITCH_TABLE pops the subject and jumps straight to its case, so the
+// bodies are laid out back to back (falling through as they read) with
+// nothing of the switch left on the stack
+static void switch_table_body(ember_vm* vm, ember_chunk* chunk) {
+    int table = ember_chunk_add_switch_table(chunk);
+    if (table < 0) {
+        error("Too many switch statements in function");
+        return;
+    }
+    write_chunk_op(chunk, OP_SWITCH_TABLE, table);
+    consume(TOKEN_LBRACE, "Expect '{' before switch body");
+
+    int* keys = NULL;
+    int* targets = NULL;
+    int count = 0;
+    int capacity = 0;
+    int default_target = -1;
+    while (!check(TOKEN_RBRACE) && !check(TOKEN_EOF)) {
+        if (match(TOKEN_NEWLINE) || match(TOKEN_SEMICOLON)) continue;
+
+        if (match(TOKEN_CASE)) {
+            int key = switch_case_constant(chunk);
+            consume(TOKEN_COLON, "Expect ':' after case value");
+            if (count == capacity) {
+                capacity = capacity < 16 ? 16 : capacity * 2;
+                int* grown_keys = realloc(keys, sizeof(int) * (size_t)capacity);
+                if (grown_keys) keys = grown_keys;
+                int* grown_targets = realloc(targets, sizeof(int) * (size_t)capacity);
+                if (grown_targets) targets = grown_targets;
+                if (!grown_keys || !grown_targets) {
+                    error("Out of memory compiling switch");
+                    break;
+                }
+            }
+            if (key < 0) {
+                error("Invalid case value");
+                break;
+            }
+            keys[count] = key;
+            targets[count] = chunk->count;
+            count++;
+            switch_case_body(vm, chunk, 0);
+        } else if (match(TOKEN_DEFAULT)) {
+            consume(TOKEN_COLON, "Expect ':' after 'default'");
+            default_target = chunk->count;
+            switch_case_body(vm, chunk, 1);
+            break; // Default should be last
+        } else {
+            error("Expect 'case' or 'default' in switch statement");
+            break;
+        }
+    }
+    consume(TOKEN_RBRACE, "Expect '}' after switch body");
+
+    if (default_target < 0) default_target = chunk->count;
+    if (!ember_chunk_set_switch_table(chunk, table, keys, targets, count, default_target)) {
+        error("Could not build switch table");
+    }
+    free(keys);
+    free(targets);
 }
 
 // Switch statement implementation
@@ -1257,6 +1717,18 @@ void switch_statement(ember_vm* vm, ember_chunk* chunk) {
     
     loop_context* switch_ctx = &parser->loop_stack[parser->loop_depth++];
     switch_ctx->break_count = 0;
+
+    if (switch_cases_are_literals()) {
+        switch_table_body(vm, chunk);
+        for (int i = 0; i < switch_ctx->break_count; i++) {
+            if (!patch_jump(chunk, switch_ctx->break_jumps[i], chunk->count)) {
+                error("Switch break jump offset too large");
+            }
+        }
+        parser->loop_depth--;
+        return;
+    }
+    parser->scope.stack_depth++;
     
     // Parse switch body
     consume(TOKEN_LBRACE, "Expect '{' before switch body");
@@ -1275,9 +1747,7 @@ void switch_statement(ember_vm* vm, ember_chunk* chunk) {
             expression(chunk); // Push case value to stack
             
             // Emit case comparison instruction
-            write_chunk(chunk, OP_CASE);
-            case_jumps[case_count] = chunk->count;
-            write_chunk(chunk, 0); // Placeholder for jump offset (will patch later)
+            case_jumps[case_count] = write_chunk_jump(chunk, OP_CASE); // Patched after the body
             
             consume(TOKEN_COLON, "Expect ':' after case value");
             
@@ -1326,6 +1796,7 @@ void switch_statement(ember_vm* vm, ember_chunk* chunk) {
     
     // Pop the switch expression value from stack (it's been used for comparisons)
     write_chunk(chunk, OP_POP);
+    parser->scope.stack_depth--;
     
     // If no match was found and there's a default case, execution falls through to it
     if (default_body != -1) {
@@ -1336,35 +1807,29 @@ void switch_statement(ember_vm* vm, ember_chunk* chunk) {
     for (int i = 0; i < case_count; i++) {
         int jump_location = case_jumps[i];
         
-        // Calculate offset to next case or end of switch
-        int target_offset;
+        // Target the next case or end of switch
+        int target;
         if (i + 1 < case_count) {
             // Jump to next case for comparison
-            target_offset = case_bodies[i + 1] - jump_location - 1;
+            target = case_bodies[i + 1];
         } else if (default_body != -1) {
             // Jump to default case
-            target_offset = default_body - jump_location - 1;
+            target = default_body;
         } else {
             // Jump to end of switch
-            target_offset = chunk->count - jump_location - 1;
+            target = chunk->count;
         }
         
-        if (target_offset < 0 || target_offset > 255) {
+        if (!patch_jump(chunk, jump_location, target)) {
             error("Switch case jump offset too large");
-            continue;
         }
-        chunk->code[jump_location] = (uint8_t)target_offset;
     }
     
     // Patch all break statements to jump to end of switch
     for (int i = 0; i < switch_ctx->break_count; i++) {
-        int break_jump = switch_ctx->break_jumps[i];
-        int break_offset = chunk->count - break_jump - 1;
-        if (break_offset < 0 || break_offset > 255) {
+        if (!patch_jump(chunk, switch_ctx->break_jumps[i], chunk->count)) {
             error("Switch break jump offset too large");
-            continue;
         }
-        chunk->code[break_jump] = (uint8_t)break_offset;
     }
     
     // Clean up switch context
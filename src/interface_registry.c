@@ -5,6 +5,7 @@
  */
 
 #include "ember_interfaces.h"
+#include "ember.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -117,6 +118,77 @@ int ember_validate_stdlib_interface(const ember_stdlib_interface_t* interface) {
     return 1;
 }
 
+// Lazy stdlib initialization
+static const char* const stdlib_module_names[EMBER_STDLIB_MODULE_COUNT] = {
+    "crypto", "datetime", "http", "io", "json", "math",
+    "regex", "string", "template", "database", "session", "websocket",
+};
+
+static int (*stdlib_module_init(const ember_stdlib_interface_t* stdlib, int module))(ember_vm*) {
+    switch (module) {
+        case EMBER_STDLIB_CRYPTO:    return stdlib->init_crypto;
+        case EMBER_STDLIB_DATETIME:  return stdlib->init_datetime;
+        case EMBER_STDLIB_HTTP:      return stdlib->init_http;
+        case EMBER_STDLIB_IO:        return stdlib->init_io;
+        case EMBER_STDLIB_JSON:      return stdlib->init_json;
+        case EMBER_STDLIB_MATH:      return stdlib->init_math;
+        case EMBER_STDLIB_REGEX:     return stdlib->init_regex;
+        case EMBER_STDLIB_STRING:    return stdlib->init_string;
+        case EMBER_STDLIB_TEMPLATE:  return stdlib->init_template;
+        case EMBER_STDLIB_DATABASE:  return stdlib->init_database;
+        case EMBER_STDLIB_SESSION:   return stdlib->init_session;
+        case EMBER_STDLIB_WEBSOCKET: return stdlib->init_websocket;
+        default:                     return NULL;
+    }
+}
+
+int ember_stdlib_init_lazy(ember_vm* vm) {
+    if (!vm || !g_stdlib_interface) return -1;
+    uint32_t pending = 0;
+    for (int module = 0; module < EMBER_STDLIB_MODULE_COUNT; module++) {
+        if (stdlib_module_init(g_stdlib_interface, module)) pending |= 1u << module;
+    }
+    vm->stdlib_pending = pending;
+    return 0;
+}
+
+static int stdlib_run_init(ember_vm* vm, int module) {
+    // Cleared first, so globals the init looks up itself cannot re-enter it
+    vm->stdlib_pending &= ~(1u << module);
+    return stdlib_module_init(g_stdlib_interface, module)(vm) == 0 ? 0 : -1;
+}
+
+int ember_stdlib_require(ember_vm* vm, const char* module_name) {
+    if (!vm || !vm->stdlib_pending || !module_name || !g_stdlib_interface) return -1;
+    for (int module = 0; module < EMBER_STDLIB_MODULE_COUNT; module++) {
+        if ((vm->stdlib_pending & (1u << module)) && strcmp(stdlib_module_names[module], module_name) == 0) {
+            return stdlib_run_init(vm, module);
+        }
+    }
+    return -1;
+}
+
+int ember_stdlib_resolve_global(ember_vm* vm, const char* name, int length) {
+    if (!vm || !vm->stdlib_pending || !name || !g_stdlib_interface) return 0;
+    int ran = 0;
+    for (int module = 0; module < EMBER_STDLIB_MODULE_COUNT && vm->stdlib_pending; module++) {
+        if (!(vm->stdlib_pending & (1u << module))) continue;
+        if (!g_stdlib_interface->module_globals) {
+            stdlib_run_init(vm, module);
+            ran = 1;
+            continue;
+        }
+        const char* const* globals = g_stdlib_interface->module_globals((ember_stdlib_module_t)module);
+        for (int i = 0; globals && globals[i]; i++) {
+            if (strncmp(globals[i], name, (size_t)length) == 0 && globals[i][length] == '\0') {
+                stdlib_run_init(vm, module);
+                return 1;
+            }
+        }
+    }
+    return ran;
+}
+
 // EmberWeb interface management
 void ember_register_emberweb_interface(const emberweb_interface_t* interface) {
     if (!interface) {
@@ -0,0 +1,454 @@
+/**
+ * Native array sorting: array_sort(array[, cmp]) and
+ * array_sort_by(array, key_fn), both in place and stable.
+ *
+ * Without cmp the elements are compared by type, then value: nil, false,
+ * true, numbers, strings, then everything else in its original order.
+ * Every element a number (or every key, for array_sort_by) is the common
+ * case and gets an LSD radix sort on the doubles' bits; strings compare
+ * an 8-byte big-endian prefix first and memcmp only on a tie. cmp(a, b)
+ * returns a number, negative when a goes first; key_fn(element, index,
+ * array) runs once per element rather than once per comparison.
+ *
+ * What is sorted is a permutation of original indexes, and ties are
+ * broken by index: the order is total, so an introsort (quicksort with a
+ * heapsort fallback) gives the stable result, and a cmp that contradicts
+ * itself still terminates within bounds.
+ */
+
+#include "ember.h"
+#include "../vm.h"
+#include "value/value.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define SORT_INSERTION_MAX 16
+#define SORT_RADIX_MIN 256
+
+typedef enum {
+    SORT_RANK_NIL,
+    SORT_RANK_FALSE,
+    SORT_RANK_TRUE,
+    SORT_RANK_NUMBER,
+    SORT_RANK_STRING,
+    SORT_RANK_OTHER
+} sort_rank;
+
+typedef struct {
+    ember_vm* vm;
+    // Key order (no cmp): a rank and 64-bit key per element, and for
+    // strings their bytes past the prefix
+    uint8_t* ranks;
+    uint64_t* keys;
+    const char** bytes;
+    int* lengths;
+    // cmp order
+    ember_value compare;
+    ember_value* values;
+    ember_value* args;       // Two reserved slots on vm->stack
+    bool failed;
+} sort_context;
+
+// ============================================================================
+// KEYS
+// ============================================================================
+
+// Doubles as unsigned integers in the same order: negative numbers have
+// every bit flipped, the rest only the sign. NaN (either sign) sorts last
+static uint64_t sort_number_key(double number) {
+    if (number != number) return UINT64_MAX;
+    uint64_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+    return (bits >> 63) ? ~bits : bits | (UINT64_C(1) << 63);
+}
+
+static uint64_t sort_string_prefix(const char* bytes, int length) {
+    uint64_t prefix = 0;
+    for (int i = 0; i < 8; i++) {
+        prefix = prefix << 8 | (i < length ? (uint8_t)bytes[i] : 0);
+    }
+    return prefix;
+}
+
+// Fills ranks and keys for the given values; false if a string could not
+// be flattened. *all_numbers tells whether the radix sort applies
+static bool sort_build_keys(sort_context* ctx, ember_value* values, int n, bool* all_numbers) {
+    *all_numbers = true;
+    for (int i = 0; i < n; i++) {
+        ember_value value = values[i];
+        ctx->keys[i] = 0;
+        switch (value.type) {
+            case EMBER_VAL_NIL: ctx->ranks[i] = SORT_RANK_NIL; break;
+            case EMBER_VAL_BOOL: ctx->ranks[i] = value.as.bool_val ? SORT_RANK_TRUE : SORT_RANK_FALSE; break;
+            case EMBER_VAL_NUMBER:
+                ctx->ranks[i] = SORT_RANK_NUMBER;
+                ctx->keys[i] = sort_number_key(value.as.number_val);
+                break;
+            case EMBER_VAL_STRING: {
+                ember_string* string = AS_STRING(value);
+                const char* chars = ember_string_bytes(string);
+                if (!chars) chars = ember_string_flatten(string);
+                if (!chars) return false;
+                if (!ctx->bytes) {
+                    ctx->bytes = calloc((size_t)n, sizeof(const char*));
+                    ctx->lengths = calloc((size_t)n, sizeof(int));
+                    if (!ctx->bytes || !ctx->lengths) return false;
+                }
+                ctx->ranks[i] = SORT_RANK_STRING;
+                ctx->keys[i] = sort_string_prefix(chars, string->length);
+                ctx->bytes[i] = chars;
+                ctx->lengths[i] = string->length;
+                break;
+            }
+            default: ctx->ranks[i] = SORT_RANK_OTHER; break;
+        }
+        if (ctx->ranks[i] != SORT_RANK_NUMBER) *all_numbers = false;
+    }
+    return true;
+}
+
+// ============================================================================
+// ORDERINGS
+// ============================================================================
+
+static bool sort_key_less(sort_context* ctx, int a, int b) {
+    if (ctx->ranks[a] != ctx->ranks[b]) return ctx->ranks[a] < ctx->ranks[b];
+    if (ctx->keys[a] != ctx->keys[b]) return ctx->keys[a] < ctx->keys[b];
+    if (ctx->ranks[a] == SORT_RANK_STRING) {
+        int length_a = ctx->lengths[a], length_b = ctx->lengths[b];
+        int shorter = length_a < length_b ? length_a : length_b;
+        // The prefix covered the first 8 bytes
+        int compared = shorter > 8 ? memcmp(ctx->bytes[a] + 8, ctx->bytes[b] + 8, (size_t)(shorter - 8)) : 0;
+        if (compared != 0) return compared < 0;
+        if (length_a != length_b) return length_a < length_b;
+    }
+    return a < b;
+}
+
+// After a failure every comparison answers false, so the sort runs out
+// without calling back again
+static bool sort_compare_less(sort_context* ctx, int a, int b) {
+    if (ctx->failed) return false;
+    ctx->args[0] = ctx->values[a];
+    ctx->args[1] = ctx->values[b];
+    ember_value result;
+    if (vm_call_prepared(ctx->vm, ctx->compare, 2, ctx->args, &result) != 0 || result.type != EMBER_VAL_NUMBER) {
+        ctx->failed = true;
+        return false;
+    }
+    double order = result.as.number_val;
+    if (order < 0) return true;
+    if (order > 0) return false;
+    return a < b;
+}
+
+static inline bool sort_less(sort_context* ctx, int a, int b) {
+    return ctx->values ? sort_compare_less(ctx, a, b) : sort_key_less(ctx, a, b);
+}
+
+// ============================================================================
+// INTROSORT
+// ============================================================================
+
+static void sort_insertion(sort_context* ctx, int* order, int lo, int hi) {
+    for (int i = lo + 1; i < hi; i++) {
+        int item = order[i];
+        int j = i;
+        for (; j > lo && sort_less(ctx, item, order[j - 1]); j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = item;
+    }
+}
+
+static void sort_sift_down(sort_context* ctx, int* order, int lo, int root, int count) {
+    int item = order[lo + root];
+    for (;;) {
+        int child = 2 * root + 1;
+        if (child >= count) break;
+        if (child + 1 < count && sort_less(ctx, order[lo + child], order[lo + child + 1])) child++;
+        if (!sort_less(ctx, item, order[lo + child])) break;
+        order[lo + root] = order[lo + child];
+        root = child;
+    }
+    order[lo + root] = item;
+}
+
+static void sort_heap(sort_context* ctx, int* order, int lo, int hi) {
+    int count = hi - lo;
+    for (int root = count / 2 - 1; root >= 0; root--) {
+        sort_sift_down(ctx, order, lo, root, count);
+    }
+    for (int end = count - 1; end > 0; end--) {
+        int top = order[lo];
+        order[lo] = order[lo + end];
+        order[lo + end] = top;
+        sort_sift_down(ctx, order, lo, 0, end);
+    }
+}
+
+static inline void sort_swap(int* order, int a, int b) {
+    int item = order[a];
+    order[a] = order[b];
+    order[b] = item;
+}
+
+// Median of first, middle and last moved to lo, then partitioned around
+// it; every scan is bounded, whatever the comparisons answer
+static int sort_partition(sort_context* ctx, int* order, int lo, int hi) {
+    int mid = lo + (hi - lo) / 2;
+    int last = hi - 1;
+    if (sort_less(ctx, order[mid], order[lo])) sort_swap(order, mid, lo);
+    if (sort_less(ctx, order[last], order[mid])) {
+        sort_swap(order, last, mid);
+        if (sort_less(ctx, order[mid], order[lo])) sort_swap(order, mid, lo);
+    }
+    sort_swap(order, lo, mid);
+
+    int pivot = order[lo];
+    int i = lo, j = hi;
+    for (;;) {
+        do i++; while (i < hi && sort_less(ctx, order[i], pivot));
+        do j--; while (j > lo && sort_less(ctx, pivot, order[j]));
+        if (i >= j) break;
+        sort_swap(order, i, j);
+    }
+    sort_swap(order, lo, j);
+    return j;
+}
+
+static void sort_intro(sort_context* ctx, int* order, int lo, int hi, int depth) {
+    while (hi - lo > SORT_INSERTION_MAX) {
+        if (depth-- == 0) {
+            sort_heap(ctx, order, lo, hi);
+            return;
+        }
+        int split = sort_partition(ctx, order, lo, hi);
+        // Recurse into the smaller side, loop on the larger
+        if (split - lo < hi - split) {
+            sort_intro(ctx, order, lo, split, depth);
+            lo = split + 1;
+        } else {
+            sort_intro(ctx, order, split + 1, hi, depth);
+            hi = split;
+        }
+    }
+    sort_insertion(ctx, order, lo, hi);
+}
+
+// Input that is already in order, or exactly reversed, costs one pass
+static void sort_order(sort_context* ctx, int* order, int n) {
+    int ascending = 1, descending = 1;
+    for (int i = 0; i + 1 < n && ascending == i + 1; i++) {
+        if (sort_less(ctx, order[i], order[i + 1])) ascending++;
+    }
+    if (ascending >= n) return;
+    if (ascending == 1) {
+        for (int i = 0; i + 1 < n && descending == i + 1; i++) {
+            if (sort_less(ctx, order[i + 1], order[i])) descending++;
+        }
+        if (descending >= n) {
+            for (int i = 0; i < n / 2; i++) sort_swap(order, i, n - 1 - i);
+            return;
+        }
+    }
+    int depth = 0;
+    for (int size = n; size > 1; size >>= 1) depth += 2;
+    sort_intro(ctx, order, 0, n, depth);
+}
+
+// ============================================================================
+// RADIX SORT
+// ============================================================================
+
+typedef struct {
+    uint64_t key;
+    int index;
+} sort_radix_item;
+
+// LSD, a byte per pass; passes where every key has the same byte (the
+// high bytes of small integers, say) are skipped. Stable, so equal keys
+// keep index order. False without memory for the scratch buffer
+static bool sort_radix(const uint64_t* keys, int* order, int n) {
+    sort_radix_item* items = malloc((size_t)n * 2 * sizeof(sort_radix_item));
+    size_t (*counts)[256] = calloc(8, sizeof(*counts));
+    if (!items || !counts) {
+        free(items);
+        free(counts);
+        return false;
+    }
+    sort_radix_item* from = items;
+    sort_radix_item* to = items + n;
+    for (int i = 0; i < n; i++) {
+        from[i].key = keys[i];
+        from[i].index = i;
+        for (int pass = 0; pass < 8; pass++) counts[pass][(keys[i] >> (pass * 8)) & 0xFF]++;
+    }
+    for (int pass = 0; pass < 8; pass++) {
+        int shift = pass * 8;
+        if (counts[pass][(keys[0] >> shift) & 0xFF] == (size_t)n) continue;
+        size_t offset = 0;
+        for (int byte = 0; byte < 256; byte++) {
+            size_t count = counts[pass][byte];
+            counts[pass][byte] = offset;
+            offset += count;
+        }
+        for (int i = 0; i < n; i++) {
+            to[counts[pass][(from[i].key >> shift) & 0xFF]++] = from[i];
+        }
+        sort_radix_item* swap = from;
+        from = to;
+        to = swap;
+    }
+    for (int i = 0; i < n; i++) order[i] = from[i].index;
+    free(items);
+    free(counts);
+    return true;
+}
+
+// ============================================================================
+// NATIVES
+// ============================================================================
+
+// Order by key (values[i] for array_sort, keys[i] for array_sort_by) into
+// order; false if memory ran out
+static bool sort_by_keys(ember_vm* vm, ember_value* keys, int n, int* order) {
+    sort_context ctx = {0};
+    ctx.vm = vm;
+    ctx.ranks = malloc((size_t)n);
+    ctx.keys = malloc((size_t)n * sizeof(uint64_t));
+    bool all_numbers = false;
+    bool ok = ctx.ranks && ctx.keys && sort_build_keys(&ctx, keys, n, &all_numbers);
+    if (ok && !(all_numbers && n >= SORT_RADIX_MIN && sort_radix(ctx.keys, order, n))) {
+        for (int i = 0; i < n; i++) order[i] = i;
+        sort_order(&ctx, order, n);
+    }
+    free(ctx.ranks);
+    free(ctx.keys);
+    free((void*)ctx.bytes);
+    free(ctx.lengths);
+    return ok;
+}
+
+// Writes source[order[i]] over array's elements. Callbacks may have
+// resized the array meanwhile; only what is still there is written
+static void sort_apply(ember_vm* vm, ember_array* array, const ember_value* source, const int* order, int n) {
+    int count = n < array->length ? n : array->length;
+    for (int i = 0; i < count; i++) {
+        ember_value value = source[order[i]];
+        ember_value old = array->elements[i];
+        array->elements[i] = value;
+        gc_write_barrier_helper(vm, (ember_object*)array, old, value);
+    }
+}
+
+// A GC-visible copy of the elements, kept alive in *slot while callbacks run
+static ember_array* sort_snapshot(ember_vm* vm, ember_array* array, ember_value* slot) {
+    ember_value copy = ember_make_array(vm, array->length > 0 ? array->length : 1);
+    if (copy.type != EMBER_VAL_ARRAY) return NULL;
+    *slot = copy;
+    for (int i = 0; i < array->length; i++) {
+        array_push_with_vm(vm, AS_ARRAY(copy), array->elements[i]);
+    }
+    return AS_ARRAY(copy);
+}
+
+static bool sort_reserve(ember_vm* vm, int slots) {
+    if (vm->stack_top + slots > EMBER_STACK_MAX) {
+        fprintf(stderr, "[CALL] Stack overflow calling sort callback\n");
+        return false;
+    }
+    for (int i = 0; i < slots; i++) {
+        vm->stack[vm->stack_top + i] = ember_make_nil();
+    }
+    vm->stack_top += slots;
+    return true;
+}
+
+// array_sort(array[, cmp]): array, sorted in place; nil if cmp fails or
+// returns something other than a number, leaving the array as it was
+ember_value ember_native_array_sort(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc < 1 || argc > 2 || argv[0].type != EMBER_VAL_ARRAY || ember_object_is_frozen(argv[0].as.obj_val)) {
+        return ember_make_nil();
+    }
+    bool with_compare = argc == 2 && argv[1].type != EMBER_VAL_NIL;
+    if (with_compare && !vm_callable(argv[1], 2)) return ember_make_nil();
+    ember_array* array = AS_ARRAY(argv[0]);
+    int n = array->length;
+    if (n < 2) return argv[0];
+    int* order = malloc((size_t)n * sizeof(int));
+    if (!order) return ember_make_nil();
+
+    bool ok;
+    if (!with_compare) {
+        ok = sort_by_keys(vm, array->elements, n, order);
+        if (ok) {
+            ember_value* source = malloc((size_t)n * sizeof(ember_value));
+            ok = source != NULL;
+            if (ok) {
+                memcpy(source, array->elements, (size_t)n * sizeof(ember_value));
+                sort_apply(vm, array, source, order, n);
+                free(source);
+            }
+        }
+    } else {
+        // Slots: the snapshot, then cmp's two arguments
+        int base = vm->stack_top;
+        ember_array* snapshot = sort_reserve(vm, 3) ? sort_snapshot(vm, array, &vm->stack[base]) : NULL;
+        ok = snapshot != NULL;
+        if (ok) {
+            sort_context ctx = {0};
+            ctx.vm = vm;
+            ctx.compare = argv[1];
+            ctx.values = snapshot->elements;
+            ctx.args = &vm->stack[base + 1];
+            for (int i = 0; i < n; i++) order[i] = i;
+            sort_order(&ctx, order, n);
+            ok = !ctx.failed;
+            if (ok) sort_apply(vm, array, snapshot->elements, order, n);
+        }
+        if (vm->stack_top > base) vm->stack_top = base;
+    }
+    free(order);
+    return ok ? argv[0] : ember_make_nil();
+}
+
+// array_sort_by(array, key_fn): array sorted in place by key_fn(element,
+// index, array), compared as array_sort compares elements; nil if key_fn
+// fails, leaving the array as it was
+ember_value ember_native_array_sort_by(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 2 || argv[0].type != EMBER_VAL_ARRAY || !vm_callable(argv[1], 3) ||
+        ember_object_is_frozen(argv[0].as.obj_val)) {
+        return ember_make_nil();
+    }
+    ember_array* array = AS_ARRAY(argv[0]);
+    int n = array->length;
+    if (n < 2) return argv[0];
+
+    // Slots: the snapshot, the keys, then key_fn's three arguments
+    int base = vm->stack_top;
+    if (!sort_reserve(vm, 5)) return ember_make_nil();
+    ember_value* slots = &vm->stack[base];
+    ember_array* snapshot = sort_snapshot(vm, array, &slots[0]);
+    ember_value keys = snapshot ? ember_make_array(vm, n) : ember_make_nil();
+    bool ok = keys.type == EMBER_VAL_ARRAY;
+    if (ok) {
+        slots[1] = keys;
+        slots[4] = argv[0];
+        for (int i = 0; ok && i < n; i++) {
+            slots[2] = snapshot->elements[i];
+            slots[3] = ember_make_number(i);
+            ember_value key;
+            ok = vm_call_prepared(vm, argv[1], 3, &slots[2], &key) == 0;
+            if (ok) array_push_with_vm(vm, AS_ARRAY(keys), key);
+        }
+    }
+    int* order = ok ? malloc((size_t)n * sizeof(int)) : NULL;
+    ok = order && sort_by_keys(vm, AS_ARRAY(keys)->elements, n, order);
+    if (ok) sort_apply(vm, array, snapshot->elements, order, n);
+    free(order);
+    vm->stack_top = base;
+    return ok ? argv[0] : ember_make_nil();
+}
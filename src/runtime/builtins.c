@@ -3,6 +3,7 @@
 #include "../vm.h"
 #include "value/value.h"
 #include "stdlib_working.h"
+#include "json_stream.h"
 // ember-native functions moved to ember-core stdlib modules
 #include "template_stubs.h"
 #include <stdio.h>
@@ -10,6 +11,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <limits.h>
 
 // Forward declarations for exception handling functions
 ember_value ember_native_create_error(ember_vm* vm, int argc, ember_value* argv);
@@ -49,49 +51,6 @@ int ember_strcasecmp(const char* a, const char* b) {
     return tolower(*a) - tolower(*b);
 }
 
-// Native print function
-ember_value ember_native_print(ember_vm* vm, int argc, ember_value* argv) {
-    (void)vm;
-    for (int i = 0; i < argc; i++) {
-        if (i > 0) printf(" "); // Space separator between arguments
-        
-        if (argv[i].type == EMBER_VAL_NUMBER) {
-            printf("%g", argv[i].as.number_val);
-        } else if (argv[i].type == EMBER_VAL_STRING) {
-            const char* str = ember_get_string_value(argv[i]);
-            if (str) printf("%s", str);
-        } else if (argv[i].type == EMBER_VAL_BOOL) {
-            printf("%s", argv[i].as.bool_val ? "true" : "false");
-        } else if (argv[i].type == EMBER_VAL_ARRAY) {
-            ember_array* array = AS_ARRAY(argv[i]);
-            printf("[");
-            for (int j = 0; j < array->length; j++) {
-                if (j > 0) printf(", ");
-                print_value(array->elements[j]);
-            }
-            printf("]");
-        } else if (argv[i].type == EMBER_VAL_HASH_MAP) {
-            ember_hash_map* map = AS_HASH_MAP(argv[i]);
-            printf("{");
-            int first = 1;
-            for (int j = 0; j < map->capacity; j++) {
-                if (map->entries[j].is_occupied) {
-                    if (!first) printf(", ");
-                    print_value(map->entries[j].key);
-                    printf(": ");
-                    print_value(map->entries[j].value);
-                    first = 0;
-                }
-            }
-            printf("}");
-        } else {
-            printf("nil");
-        }
-    }
-    printf("\n"); // Single newline at the end
-    return ember_make_nil();
-}
-
 // Type checking functions
 ember_value ember_native_type(ember_vm* vm, int argc, ember_value* argv) {
     if (argc != 1) {
@@ -266,81 +225,456 @@ ember_value ember_native_bool(ember_vm* vm, int argc, ember_value* argv) {
     }
 }
 
-// Function to register all built-in functions with the VM
-void register_builtin_functions(ember_vm* vm) {
+// Higher-order array functions: the callback is a script function or a
+// native, called with (element, index, array); array_reduce passes the
+// accumulator first. Nil for bad arguments or a callback that fails
+static int array_callback_args(int argc, ember_value* argv, int max_args) {
+    return argc >= 2 && argc <= max_args && argv[0].type == EMBER_VAL_ARRAY &&
+           (argv[1].type == EMBER_VAL_FUNCTION || argv[1].type == EMBER_VAL_NATIVE);
+}
+
+ember_value ember_native_array_foreach(ember_vm* vm, int argc, ember_value* argv) {
+    if (!array_callback_args(argc, argv, 2)) return ember_make_nil();
+    array_foreach(vm, AS_ARRAY(argv[0]), argv[1]);
+    return ember_make_nil();
+}
+
+ember_value ember_native_array_map(ember_vm* vm, int argc, ember_value* argv) {
+    if (!array_callback_args(argc, argv, 2)) return ember_make_nil();
+    return array_map(vm, AS_ARRAY(argv[0]), argv[1]);
+}
+
+ember_value ember_native_array_filter(ember_vm* vm, int argc, ember_value* argv) {
+    if (!array_callback_args(argc, argv, 2)) return ember_make_nil();
+    return array_filter(vm, AS_ARRAY(argv[0]), argv[1]);
+}
+
+// array_reduce(array, fn[, initial]): without initial the first element
+// starts the accumulator
+ember_value ember_native_array_reduce(ember_vm* vm, int argc, ember_value* argv) {
+    if (!array_callback_args(argc, argv, 3)) return ember_make_nil();
+    return array_reduce(vm, AS_ARRAY(argv[0]), argv[1], argc == 3 ? argv[2] : ember_make_nil());
+}
+
+ember_value ember_native_array_find(ember_vm* vm, int argc, ember_value* argv) {
+    if (!array_callback_args(argc, argv, 2)) return ember_make_nil();
+    return array_find(vm, AS_ARRAY(argv[0]), argv[1]);
+}
+
+ember_value ember_native_array_some(ember_vm* vm, int argc, ember_value* argv) {
+    if (!array_callback_args(argc, argv, 2)) return ember_make_nil();
+    return ember_make_bool(array_some(vm, AS_ARRAY(argv[0]), argv[1]));
+}
+
+ember_value ember_native_array_every(ember_vm* vm, int argc, ember_value* argv) {
+    if (!array_callback_args(argc, argv, 2)) return ember_make_nil();
+    return ember_make_bool(array_every(vm, AS_ARRAY(argv[0]), argv[1]));
+}
+
+// Bulk array building: array_reserve, array_extend and array_insert
+// change the array in place and return it; array_splice returns what it
+// removed. Indexes below zero count from the end, as in JavaScript
+static int array_position_arg(ember_value value, int length, int* position) {
+    if (value.type != EMBER_VAL_NUMBER || value.as.number_val != value.as.number_val) return 0;
+    double index = value.as.number_val;
+    if (index < 0) index += length;
+    *position = index < 0 ? 0 : index > length ? length : (int)index;
+    return 1;
+}
+
+// array_reserve(array, n): room for n elements without reallocating
+ember_value ember_native_array_reserve(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc != 2 || argv[0].type != EMBER_VAL_ARRAY || argv[1].type != EMBER_VAL_NUMBER) return ember_make_nil();
+    double count = argv[1].as.number_val;
+    if (!(count >= 0 && count <= INT_MAX) || !array_reserve_with_vm(vm, AS_ARRAY(argv[0]), (int)count)) return ember_make_nil();
+    return argv[0];
+}
+
+// array_extend(array, other): appends every element of other
+ember_value ember_native_array_extend(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 2 || argv[0].type != EMBER_VAL_ARRAY || argv[1].type != EMBER_VAL_ARRAY) return ember_make_nil();
+    if (!array_extend(vm, AS_ARRAY(argv[0]), AS_ARRAY(argv[1]))) return ember_make_nil();
+    return argv[0];
+}
+
+// array_insert(array, index, value...): the values before index
+ember_value ember_native_array_insert(ember_vm* vm, int argc, ember_value* argv) {
+    int start;
+    if (argc < 2 || argv[0].type != EMBER_VAL_ARRAY ||
+        !array_position_arg(argv[1], AS_ARRAY(argv[0])->length, &start)) {
+        return ember_make_nil();
+    }
+    if (!array_splice(vm, AS_ARRAY(argv[0]), start, 0, argv + 2, argc - 2, NULL)) return ember_make_nil();
+    return argv[0];
+}
+
+// array_splice(array, start[, count[, value...]]): removes count elements
+// (all from start without it) and puts the values in their place
+ember_value ember_native_array_splice(ember_vm* vm, int argc, ember_value* argv) {
+    int start;
+    if (argc < 2 || argv[0].type != EMBER_VAL_ARRAY ||
+        !array_position_arg(argv[1], AS_ARRAY(argv[0])->length, &start)) {
+        return ember_make_nil();
+    }
+    ember_array* array = AS_ARRAY(argv[0]);
+    int count = array->length - start;
+    if (argc >= 3) {
+        if (argv[2].type != EMBER_VAL_NUMBER || argv[2].as.number_val != argv[2].as.number_val) return ember_make_nil();
+        double requested = argv[2].as.number_val;
+        count = requested < 0 ? 0 : requested < count ? (int)requested : count;
+    }
+    ember_value removed;
+    int item_count = argc > 3 ? argc - 3 : 0;
+    if (!array_splice(vm, array, start, count, argv + 3, item_count, &removed)) return ember_make_nil();
+    return removed;
+}
+
+// Set algebra over two sets: set_union, set_intersection and
+// set_difference make a new set; set_union_with and set_retain_all update
+// the first in place and return it
+static int set_pair_args(int argc, ember_value* argv) {
+    return argc == 2 && argv[0].type == EMBER_VAL_SET && argv[1].type == EMBER_VAL_SET;
+}
+
+ember_value ember_native_set_from_array(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 1 || argv[0].type != EMBER_VAL_ARRAY) return ember_make_nil();
+    return set_from_array(vm, AS_ARRAY(argv[0]));
+}
+
+ember_value ember_native_set_union(ember_vm* vm, int argc, ember_value* argv) {
+    if (!set_pair_args(argc, argv)) return ember_make_nil();
+    return set_union(vm, AS_SET(argv[0]), AS_SET(argv[1]));
+}
+
+ember_value ember_native_set_intersection(ember_vm* vm, int argc, ember_value* argv) {
+    if (!set_pair_args(argc, argv)) return ember_make_nil();
+    return set_intersection(vm, AS_SET(argv[0]), AS_SET(argv[1]));
+}
+
+ember_value ember_native_set_difference(ember_vm* vm, int argc, ember_value* argv) {
+    if (!set_pair_args(argc, argv)) return ember_make_nil();
+    return set_difference(vm, AS_SET(argv[0]), AS_SET(argv[1]));
+}
+
+ember_value ember_native_set_union_with(ember_vm* vm, int argc, ember_value* argv) {
+    if (!set_pair_args(argc, argv)) return ember_make_nil();
+    return set_union_with(vm, AS_SET(argv[0]), AS_SET(argv[1])) ? argv[0] : ember_make_nil();
+}
+
+ember_value ember_native_set_retain_all(ember_vm* vm, int argc, ember_value* argv) {
+    if (!set_pair_args(argc, argv)) return ember_make_nil();
+    return set_retain_all(vm, AS_SET(argv[0]), AS_SET(argv[1])) ? argv[0] : ember_make_nil();
+}
+
+// Built-in functions. A VM created with lazy_stdlib_loading binds none of
+// them up front; each is registered the first time its name misses in the
+// globals table (ember_builtin_bind, called from vm_globals.c), so creating
+// a VM costs nothing for the ones a script never uses.
+// Builtins with an ember_native_info are bound with ember_register_native,
+// so the VM checks their arguments and knows their flags.
+typedef struct {
+    const char* name;
+    int length;
+    ember_native_func func;
+    const ember_native_info* info;
+} builtin_def;
+
+#define BUILTIN(name, func) {name, sizeof(name) - 1, func, NULL}
+#define BUILTIN_DESCRIBED(name, info) {name, sizeof(name) - 1, (info).func, &(info)}
+
+#define NUMBER_ARG EMBER_TYPE_MASK(EMBER_VAL_NUMBER)
+#define SIZED_ARG (EMBER_TYPE_MASK(EMBER_VAL_STRING) | EMBER_TYPE_MASK(EMBER_VAL_ARRAY) | \
+                   EMBER_TYPE_MASK(EMBER_VAL_HASH_MAP) | EMBER_TYPE_MASK(EMBER_VAL_TYPED_ARRAY) | \
+                   EMBER_TYPE_MASK(EMBER_VAL_DEQUE) | EMBER_TYPE_MASK(EMBER_VAL_PRIORITY_QUEUE))
+#define ARITHMETIC (EMBER_NATIVE_PURE | EMBER_NATIVE_NO_GC | EMBER_NATIVE_NO_THROW)
+
+static const ember_native_info abs_info = {ember_native_abs, 1, 1, {NUMBER_ARG}, ARITHMETIC};
+static const ember_native_info sqrt_info = {ember_native_sqrt, 1, 1, {NUMBER_ARG}, ARITHMETIC};
+static const ember_native_info max_info = {ember_native_max, 2, 2, {NUMBER_ARG, NUMBER_ARG}, ARITHMETIC};
+static const ember_native_info min_info = {ember_native_min, 2, 2, {NUMBER_ARG, NUMBER_ARG}, ARITHMETIC};
+static const ember_native_info floor_info = {ember_native_floor, 1, 1, {NUMBER_ARG}, ARITHMETIC};
+static const ember_native_info ceil_info = {ember_native_ceil, 1, 1, {NUMBER_ARG}, ARITHMETIC};
+static const ember_native_info round_info = {ember_native_round, 1, 1, {NUMBER_ARG}, ARITHMETIC};
+static const ember_native_info pow_info = {ember_native_pow, 2, 2, {NUMBER_ARG, NUMBER_ARG}, ARITHMETIC};
+static const ember_native_info len_info = {ember_native_len, 1, 1, {SIZED_ARG}, ARITHMETIC | EMBER_NATIVE_ROPES};
+
+static const builtin_def builtins[] = {
     // Built-in functions from runtime/builtins.c
-    ember_register_func(vm, "print", ember_native_print);
-    ember_register_func(vm, "type", ember_native_type);
-    ember_register_func(vm, "not", ember_native_not);
-    ember_register_func(vm, "str", ember_native_str);
-    ember_register_func(vm, "num", ember_native_num);
-    ember_register_func(vm, "int", ember_native_int);
-    ember_register_func(vm, "bool", ember_native_bool);
+    BUILTIN("print", ember_native_print),
+    BUILTIN("flush_output", ember_native_flush_output),
+    BUILTIN("log", ember_native_log),
+    BUILTIN("log_flush", ember_native_log_flush),
+    BUILTIN("type", ember_native_type),
+    BUILTIN("not", ember_native_not),
+    BUILTIN("str", ember_native_str),
+    BUILTIN("num", ember_native_num),
+    BUILTIN("int", ember_native_int),
+    BUILTIN("bool", ember_native_bool),
+    BUILTIN("array_foreach", ember_native_array_foreach),
+    BUILTIN("array_map", ember_native_array_map),
+    BUILTIN("array_filter", ember_native_array_filter),
+    BUILTIN("array_reduce", ember_native_array_reduce),
+    BUILTIN("array_find", ember_native_array_find),
+    BUILTIN("array_some", ember_native_array_some),
+    BUILTIN("array_every", ember_native_array_every),
+    BUILTIN("array_reserve", ember_native_array_reserve),
+    BUILTIN("array_extend", ember_native_array_extend),
+    BUILTIN("array_insert", ember_native_array_insert),
+    BUILTIN("array_splice", ember_native_array_splice),
+    BUILTIN("array_sort", ember_native_array_sort),
+    BUILTIN("array_sort_by", ember_native_array_sort_by),
+    BUILTIN("set_from_array", ember_native_set_from_array),
+    BUILTIN("set_union", ember_native_set_union),
+    BUILTIN("set_intersection", ember_native_set_intersection),
+    BUILTIN("set_difference", ember_native_set_difference),
+    BUILTIN("set_union_with", ember_native_set_union_with),
+    BUILTIN("set_retain_all", ember_native_set_retain_all),
+    BUILTIN("parallel_map", ember_native_parallel_map),
+    BUILTIN("parallel_filter", ember_native_parallel_filter),
+    BUILTIN("parallel_reduce", ember_native_parallel_reduce),
+    BUILTIN("float64_array", ember_native_float64_array),
+    BUILTIN("int32_array", ember_native_int32_array),
+    BUILTIN("uint8_array", ember_native_uint8_array),
+    BUILTIN("typed_fill", ember_native_typed_fill),
+    BUILTIN("typed_copy", ember_native_typed_copy),
+    BUILTIN("typed_slice", ember_native_typed_slice),
+    BUILTIN("typed_to_array", ember_native_typed_to_array),
+    BUILTIN("cache_new", ember_native_cache_new),
+    BUILTIN("cache_get", ember_native_cache_get),
+    BUILTIN("cache_has", ember_native_cache_has),
+    BUILTIN("cache_put", ember_native_cache_put),
+    BUILTIN("cache_delete", ember_native_cache_delete),
+    BUILTIN("cache_size", ember_native_cache_size),
+    BUILTIN("cache_clear", ember_native_cache_clear),
+    BUILTIN("cache_prune", ember_native_cache_prune),
+    BUILTIN("cache_stats", ember_native_cache_stats),
+    BUILTIN("deque", ember_native_deque),
+    BUILTIN("deque_push_back", ember_native_deque_push_back),
+    BUILTIN("deque_push_front", ember_native_deque_push_front),
+    BUILTIN("deque_pop_back", ember_native_deque_pop_back),
+    BUILTIN("deque_pop_front", ember_native_deque_pop_front),
+    BUILTIN("deque_peek_back", ember_native_deque_peek_back),
+    BUILTIN("deque_peek_front", ember_native_deque_peek_front),
+    BUILTIN("deque_get", ember_native_deque_get),
+    BUILTIN("deque_clear", ember_native_deque_clear),
+    BUILTIN("deque_to_array", ember_native_deque_to_array),
+    BUILTIN("priority_queue", ember_native_priority_queue),
+    BUILTIN("pqueue_push", ember_native_pqueue_push),
+    BUILTIN("pqueue_pop", ember_native_pqueue_pop),
+    BUILTIN("pqueue_peek", ember_native_pqueue_peek),
+    BUILTIN("pqueue_clear", ember_native_pqueue_clear),
+    BUILTIN("weak_ref", ember_native_weak_ref),
+    BUILTIN("weak_ref_get", ember_native_weak_ref_get),
+    BUILTIN("weak_map", ember_native_weak_map),
+    BUILTIN("weak_map_get", ember_native_weak_map_get),
+    BUILTIN("weak_map_set", ember_native_weak_map_set),
+    BUILTIN("weak_map_has", ember_native_weak_map_has),
+    BUILTIN("weak_map_delete", ember_native_weak_map_delete),
+    BUILTIN("weak_map_size", ember_native_weak_map_size),
+    BUILTIN("vmath_sum", ember_native_vmath_sum),
+    BUILTIN("vmath_dot", ember_native_vmath_dot),
+    BUILTIN("vmath_min", ember_native_vmath_min),
+    BUILTIN("vmath_max", ember_native_vmath_max),
+    BUILTIN("vmath_scale", ember_native_vmath_scale),
+    BUILTIN("vmath_add", ember_native_vmath_add),
+    BUILTIN("vmath_mul", ember_native_vmath_mul),
+    BUILTIN("vmath_clamp", ember_native_vmath_clamp),
+    BUILTIN("vmath_prefix_sum", ember_native_vmath_prefix_sum),
+    BUILTIN("vmath_sqrt", ember_native_vmath_sqrt),
+    BUILTIN("vmath_exp", ember_native_vmath_exp),
+    BUILTIN("vmath_log", ember_native_vmath_log),
+    BUILTIN("iter", ember_native_iter),
+    BUILTIN("iter_map", ember_native_iter_map),
+    BUILTIN("iter_filter", ember_native_iter_filter),
+    BUILTIN("iter_take", ember_native_iter_take),
+    BUILTIN("iter_skip", ember_native_iter_skip),
+    BUILTIN("iter_zip", ember_native_iter_zip),
+    BUILTIN("iter_chunk", ember_native_iter_chunk),
+    BUILTIN("iter_collect", ember_native_iter_collect),
+    BUILTIN("iter_reduce", ember_native_iter_reduce),
+    BUILTIN("iter_count", ember_native_iter_count),
     
     // Math functions from runtime/math_stdlib.c
-    ember_register_func(vm, "abs", ember_native_abs);
-    ember_register_func(vm, "sqrt", ember_native_sqrt);
-    ember_register_func(vm, "max", ember_native_max);
-    ember_register_func(vm, "min", ember_native_min);
-    ember_register_func(vm, "floor", ember_native_floor);
-    ember_register_func(vm, "ceil", ember_native_ceil);
-    ember_register_func(vm, "round", ember_native_round);
-    ember_register_func(vm, "pow", ember_native_pow);
+    BUILTIN_DESCRIBED("abs", abs_info),
+    BUILTIN_DESCRIBED("sqrt", sqrt_info),
+    BUILTIN_DESCRIBED("max", max_info),
+    BUILTIN_DESCRIBED("min", min_info),
+    BUILTIN_DESCRIBED("floor", floor_info),
+    BUILTIN_DESCRIBED("ceil", ceil_info),
+    BUILTIN_DESCRIBED("round", round_info),
+    BUILTIN_DESCRIBED("pow", pow_info),
     
     // String functions from runtime/string_stdlib.c
-    ember_register_func(vm, "len", ember_native_len);
-    ember_register_func(vm, "substr", ember_native_substr);
-    ember_register_func(vm, "split", ember_native_split);
-    ember_register_func(vm, "join", ember_native_join);
-    ember_register_func(vm, "starts_with", ember_native_starts_with);
-    ember_register_func(vm, "ends_with", ember_native_ends_with);
+    BUILTIN_DESCRIBED("len", len_info),
+    BUILTIN("substr", ember_native_substr),
+    BUILTIN("split", ember_native_split),
+    BUILTIN("join", ember_native_join),
+    BUILTIN("starts_with", ember_native_starts_with),
+    BUILTIN("ends_with", ember_native_ends_with),
+    BUILTIN("replace_all", ember_replace_all),
+    BUILTIN("string_builder", ember_native_string_builder),
+    BUILTIN("builder_append", ember_native_builder_append),
+    BUILTIN("builder_appendf", ember_native_builder_appendf),
+    BUILTIN("builder_length", ember_native_builder_length),
+    BUILTIN("builder_clear", ember_native_builder_clear),
+    BUILTIN("builder_to_string", ember_native_builder_to_string),
+    
+    // Templates
+    BUILTIN("template_render", ember_template_render),
+    BUILTIN("template_render_file", ember_template_render_file),
+    BUILTIN("html_render", ember_html_render),
+    BUILTIN("html_render_file", ember_html_render_file),
+    BUILTIN("html_escape", ember_html_escape),
+    BUILTIN("url_encode", ember_url_encode),
     
     // File I/O functions (working implementations)
-    ember_register_func(vm, "read_file", ember_native_read_file_working);
-    ember_register_func(vm, "write_file", ember_native_write_file_working);
-    ember_register_func(vm, "append_file", ember_native_append_file_working);
-    ember_register_func(vm, "file_exists", ember_native_file_exists_working);
+    BUILTIN("read_file", ember_native_read_file_working),
+    BUILTIN("write_file", ember_native_write_file_working),
+    BUILTIN("append_file", ember_native_append_file_working),
+    BUILTIN("file_exists", ember_native_file_exists_working),
+    BUILTIN("file_open", ember_native_file_open),
+    BUILTIN("file_read_line", ember_native_file_read_line),
+    BUILTIN("file_read_chunk", ember_native_file_read_chunk),
+    BUILTIN("file_lines", ember_native_file_lines),
+    BUILTIN("file_writer", ember_native_file_writer),
+    BUILTIN("file_write", ember_native_file_write),
+    BUILTIN("file_flush", ember_native_file_flush),
+    BUILTIN("fs_walk", ember_native_fs_walk),
+    BUILTIN("file_close", ember_native_file_close),
     
     // JSON functions from runtime/json_simple.c (working implementations)
-    ember_register_func(vm, "json_parse", ember_json_parse_working);
-    ember_register_func(vm, "json_stringify", ember_json_stringify_working);
-    ember_register_func(vm, "json_validate", ember_json_validate_working);
+    BUILTIN("json_parse", ember_json_parse_working),
+    BUILTIN("json_stringify", ember_json_stringify_working),
+    BUILTIN("json_validate", ember_json_validate_working),
+    BUILTIN("json_read", ember_json_read_working),
+    BUILTIN("json_write", ember_json_write_working),
+    BUILTIN("serialize", ember_native_serialize),
+    BUILTIN("deserialize", ember_native_deserialize),
     
     // Cryptographic functions from runtime/crypto_simple.c (working implementations)
-    ember_register_func(vm, "sha256", ember_native_sha256_working);
-    ember_register_func(vm, "sha512", ember_native_sha512_working);
-    ember_register_func(vm, "hmac_sha256", ember_native_hmac_sha256_working);
-    ember_register_func(vm, "secure_random", ember_native_secure_random_working);
+    BUILTIN("sha256", ember_native_sha256_working),
+    BUILTIN("sha512", ember_native_sha512_working),
+    BUILTIN("hmac_sha256", ember_native_hmac_sha256_working),
+    BUILTIN("hmac_sha512", ember_native_hmac_sha512_working),
+    BUILTIN("secure_random", ember_native_secure_random_working),
+    BUILTIN("uuid_v4", ember_native_uuid_v4),
+    BUILTIN("uuid_v7", ember_native_uuid_v7),
+    BUILTIN("hasher", ember_native_hasher),
+    BUILTIN("hasher_update", ember_native_hasher_update),
+    BUILTIN("hasher_digest", ember_native_hasher_digest),
     // Additional crypto functions (some may need testing)
-    // ember_register_func(vm, "hmac_sha512", ember_native_hmac_sha512);
-    // ember_register_func(vm, "secure_compare", ember_native_secure_compare);
-    // ember_register_func(vm, "bcrypt_hash", ember_native_bcrypt_hash);
-    // ember_register_func(vm, "bcrypt_verify", ember_native_bcrypt_verify);
+    // BUILTIN("secure_compare", ember_native_secure_compare),
+    // BUILTIN("bcrypt_hash", ember_native_bcrypt_hash),
+    // BUILTIN("bcrypt_verify", ember_native_bcrypt_verify),
     
     // Regular expression functions from stdlib/regex_native.c (temporarily disabled)
-    // ember_register_func(vm, "regex_match", ember_regex_match_func);
-    // ember_register_func(vm, "regex_test", ember_regex_test);
-    // ember_register_func(vm, "regex_replace", ember_regex_replace);
-    // ember_register_func(vm, "regex_split", ember_regex_split);
-    // ember_register_func(vm, "regex_find_all", ember_regex_find_all);
+    // BUILTIN("regex_match", ember_regex_match_func),
+    // BUILTIN("regex_test", ember_regex_test),
+    // BUILTIN("regex_replace", ember_regex_replace),
+    // BUILTIN("regex_split", ember_regex_split),
+    // BUILTIN("regex_find_all", ember_regex_find_all),
+    BUILTIN("regex_match_all", ember_native_regex_match_all),
     
-    // Date/time functions from stdlib/datetime_native.c (may need testing)
-    // ember_register_func(vm, "datetime_now", ember_native_datetime_now);
+    // Dates and times
+    BUILTIN("datetime_now", ember_native_datetime_now),
+    BUILTIN("datetime_timestamp", ember_native_datetime_timestamp),
+    BUILTIN("datetime_parse", ember_native_datetime_parse),
+    BUILTIN("datetime_format", ember_native_datetime_format),
+    BUILTIN("datetime_add", ember_native_datetime_add),
+    BUILTIN("datetime_diff", ember_native_datetime_diff),
+    BUILTIN("datetime_to_utc", ember_native_datetime_to_utc),
+    BUILTIN("datetime_from_utc", ember_native_datetime_from_utc),
+    BUILTIN("datetime_year", ember_native_datetime_year),
+    BUILTIN("datetime_month", ember_native_datetime_month),
+    BUILTIN("datetime_day", ember_native_datetime_day),
+    BUILTIN("datetime_hour", ember_native_datetime_hour),
+    BUILTIN("datetime_minute", ember_native_datetime_minute),
+    BUILTIN("datetime_second", ember_native_datetime_second),
+    BUILTIN("datetime_weekday", ember_native_datetime_weekday),
+    BUILTIN("datetime_yearday", ember_native_datetime_yearday),
     
     // Exception handling utility functions
     // TODO: Implement exception creation functions
-    // ember_register_func(vm, "Error", ember_native_create_error);
-    // ember_register_func(vm, "TypeError", ember_native_create_type_error);
-    // ember_register_func(vm, "RuntimeError", ember_native_create_runtime_error);
-    // ember_register_func(vm, "RangeError", ember_native_create_range_error);
-    // ember_register_func(vm, "IOError", ember_native_create_io_error);
-    // ember_register_func(vm, "SecurityError", ember_native_create_security_error);
-    ember_register_func(vm, "is_exception", ember_native_is_exception);
-    ember_register_func(vm, "get_exception_type", ember_native_get_exception_type);
-    ember_register_func(vm, "get_stack_trace", ember_native_get_stack_trace);
+    // BUILTIN("Error", ember_native_create_error),
+    // BUILTIN("TypeError", ember_native_create_type_error),
+    // BUILTIN("RuntimeError", ember_native_create_runtime_error),
+    // BUILTIN("RangeError", ember_native_create_range_error),
+    // BUILTIN("IOError", ember_native_create_io_error),
+    // BUILTIN("SecurityError", ember_native_create_security_error),
+    BUILTIN("is_exception", ember_native_is_exception),
+    BUILTIN("get_exception_type", ember_native_get_exception_type),
+    BUILTIN("get_stack_trace", ember_native_get_stack_trace),
+    
+    // Event loop
+    BUILTIN("delay", ember_native_delay),
+    BUILTIN("setTimeout", ember_native_set_timeout),
+    BUILTIN("setInterval", ember_native_set_interval),
+    BUILTIN("clearTimeout", ember_native_clear_timeout),
+    BUILTIN("clearInterval", ember_native_clear_timeout),
+    
+    // HTTP server
+    BUILTIN("http_listen_and_serve", ember_native_http_listen_and_serve),
+    BUILTIN("http_stop_server", ember_native_http_stop_server),
+    BUILTIN("request_get_method", ember_native_request_get_method),
+    BUILTIN("request_get_path", ember_native_request_get_path),
+    BUILTIN("request_get_query", ember_native_request_get_query),
+    BUILTIN("request_get_header", ember_native_request_get_header),
+    BUILTIN("request_get_body", ember_native_request_get_body),
+    BUILTIN("response_set_status", ember_native_response_set_status),
+    BUILTIN("response_set_header", ember_native_response_set_header),
+    BUILTIN("response_write", ember_native_response_write),
+    BUILTIN("response_end", ember_native_response_end),
+    BUILTIN("response_send_file", ember_native_response_send_file),
+    BUILTIN("websocket_upgrade", ember_native_websocket_upgrade),
+    BUILTIN("websocket_send", ember_native_websocket_send),
+    BUILTIN("websocket_broadcast", ember_native_websocket_broadcast),
+    BUILTIN("websocket_close", ember_native_websocket_close),
+
+    // Sessions
+    BUILTIN("session_set", ember_native_session_set),
+    BUILTIN("session_get", ember_native_session_get),
+    BUILTIN("session_touch", ember_native_session_touch),
+    BUILTIN("session_delete", ember_native_session_delete),
+    BUILTIN("session_count", ember_native_session_count),
+
+    // Compression
+    BUILTIN("compress", ember_native_compress),
+    BUILTIN("decompress", ember_native_decompress),
     
-    // Note: HTTP, WebSocket, upload, streaming, router, session, and template functions 
+    // Note: upload, streaming and router functions
     // temporarily disabled due to integration issues - focus on core stdlib first
+};
+
+#define BUILTIN_COUNT ((int)(sizeof(builtins) / sizeof(builtins[0])))
+
+static void builtin_register(ember_vm* vm, const builtin_def* builtin) {
+    if (!builtin->info || ember_register_native(vm, builtin->name, builtin->info) != 0) {
+        ember_register_func(vm, builtin->name, builtin->func);
+    }
+}
+
+// Function to register all built-in functions with the VM
+void register_builtin_functions(ember_vm* vm) {
+    double start = startup_clock();
+    if (!vm->lazy_stdlib_loading) {
+        for (int i = 0; i < BUILTIN_COUNT; i++) {
+            builtin_register(vm, &builtins[i]);
+        }
+        vm->stdlib_initialized = 1;
+    }
+    startup_profile_phase(STARTUP_STDLIB, start);
+}
+
+int ember_builtin_bind(ember_vm* vm, const char* name, int length) {
+    for (int i = 0; i < BUILTIN_COUNT; i++) {
+        const builtin_def* builtin = &builtins[i];
+        if (builtin->length == length && memcmp(builtin->name, name, (size_t)length) == 0) {
+            builtin_register(vm, builtin);
+            return 1;
+        }
+    }
+    return 0;
 }
 
 // Exception handling utility functions
@@ -353,4 +353,13 @@ void ember_platform_init_with_stdlib(ember_vm* vm) {
     } else {
         printf("Info: Running with core functions only (stdlib not available)\n");
     }
-}
\ No newline at end of file
+}
+
+// Demand-driven variant: no stdlib module initializes until the VM imports
+// it or looks up one of its globals (ember_stdlib_init_lazy)
+void ember_platform_init_with_stdlib_lazy(ember_vm* vm) {
+    ember_register_core_builtins(vm);
+    if (ember_stdlib_init_lazy(vm) != 0) {
+        printf("Info: Running with core functions only (stdlib not available)\n");
+    }
+}
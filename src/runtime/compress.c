@@ -0,0 +1,568 @@
+/**
+ * Streaming compression: the codecs behind the HTTP server's
+ * Content-Encoding and the compress / decompress natives. See compress.h.
+ *
+ * Each codec is compiled in only where the Makefile found its library, and
+ * the rest answer as unavailable. Streams are cached per thread, one per
+ * codec: a deflate state is reset and its level changed in place, a zstd
+ * context reset for the next frame, so the large allocations behind them
+ * are made once per thread rather than once per response.
+ */
+
+#define _GNU_SOURCE
+#include "ember.h"
+#include "value/value.h"
+#include "compress.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_BROTLI
+#include <brotli/encode.h>
+#include <brotli/decode.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define COMPRESS_CHUNK (16 * 1024)           // Output room made at a time
+#define COMPRESS_FEED (1u << 30)             // Input handed to zlib at a time: its counts are 32-bit
+#define COMPRESS_MAX_OUTPUT (64 * 1024 * 1024)  // decompress's default limit
+
+struct compress_stream {
+    compress_encoding encoding;
+    int level;
+    int failed;
+#ifdef HAVE_ZLIB
+    z_stream zlib;
+    int zlib_ready;                          // deflateInit2 done; reset rather than redone
+#endif
+#ifdef HAVE_BROTLI
+    BrotliEncoderState* brotli;
+#endif
+#ifdef HAVE_ZSTD
+    ZSTD_CCtx* zstd;
+#endif
+};
+
+// ============================================================================
+// ENCODINGS
+// ============================================================================
+
+static const char* const encoding_names[COMPRESS_ENCODINGS] = {NULL, "gzip", "br", "zstd"};
+
+int compress_available(compress_encoding encoding) {
+    switch (encoding) {
+#ifdef HAVE_ZLIB
+        case COMPRESS_GZIP: return 1;
+#endif
+#ifdef HAVE_BROTLI
+        case COMPRESS_BROTLI: return 1;
+#endif
+#ifdef HAVE_ZSTD
+        case COMPRESS_ZSTD: return 1;
+#endif
+        default: return 0;
+    }
+}
+
+compress_encoding compress_encoding_named(const char* name, size_t length) {
+    for (int encoding = COMPRESS_GZIP; encoding < COMPRESS_ENCODINGS; encoding++) {
+        if (length == strlen(encoding_names[encoding]) && strncasecmp(name, encoding_names[encoding], length) == 0) {
+            return (compress_encoding)encoding;
+        }
+    }
+    if (length == 6 && strncasecmp(name, "x-gzip", 6) == 0) return COMPRESS_GZIP;
+    return COMPRESS_NONE;
+}
+
+const char* compress_encoding_name(compress_encoding encoding) {
+    return encoding > COMPRESS_NONE && encoding < COMPRESS_ENCODINGS ? encoding_names[encoding] : NULL;
+}
+
+// A qvalue ("0", "0.5", "1.000") in thousandths; -1 if malformed
+static int parse_quality(const char* at, const char* end) {
+    if (at == end || (*at != '0' && *at != '1')) return -1;
+    int quality = (*at++ - '0') * 1000;
+    if (at == end) return quality;
+    if (*at++ != '.') return -1;
+    int scale = 100;
+    for (; at < end; at++, scale /= 10) {
+        if (*at < '0' || *at > '9' || scale == 0) return -1;
+        quality += (*at - '0') * scale;
+    }
+    return quality <= 1000 ? quality : -1;
+}
+
+compress_encoding compress_accept(const char* accept, size_t length) {
+    // Preference order at equal q
+    static const compress_encoding preferred[] = {COMPRESS_BROTLI, COMPRESS_ZSTD, COMPRESS_GZIP};
+    int quality[COMPRESS_ENCODINGS] = {-1, -1, -1, -1};
+    int any = -1;                            // "*", when listed
+    const char* at = accept;
+    const char* end = accept + length;
+    while (at < end) {
+        const char* item_end = memchr(at, ',', (size_t)(end - at));
+        if (!item_end) item_end = end;
+        while (at < item_end && (*at == ' ' || *at == '\t')) at++;
+        const char* name_end = at;
+        while (name_end < item_end && *name_end != ';' && *name_end != ' ' && *name_end != '\t') name_end++;
+
+        // Parameters: only q counts
+        int q = 1000;
+        const char* param = name_end;
+        while (param < item_end) {
+            param = memchr(param, ';', (size_t)(item_end - param));
+            if (!param) break;
+            param++;
+            while (param < item_end && (*param == ' ' || *param == '\t')) param++;
+            if (item_end - param >= 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+                const char* value_end = param + 2;
+                while (value_end < item_end && *value_end != ';' && *value_end != ' ' && *value_end != '\t') {
+                    value_end++;
+                }
+                q = parse_quality(param + 2, value_end);
+                param = value_end;
+            }
+        }
+        size_t name_length = (size_t)(name_end - at);
+        if (q >= 0 && name_length > 0) {
+            compress_encoding encoding = compress_encoding_named(at, name_length);
+            if (encoding != COMPRESS_NONE) {
+                quality[encoding] = q;
+            } else if (name_length == 1 && *at == '*') {
+                any = q;
+            }
+        }
+        at = item_end + 1;
+    }
+
+    compress_encoding best = COMPRESS_NONE;
+    int best_quality = 0;
+    for (size_t i = 0; i < sizeof(preferred) / sizeof(preferred[0]); i++) {
+        int q = quality[preferred[i]] >= 0 ? quality[preferred[i]] : any;
+        if (q > best_quality && compress_available(preferred[i])) {
+            best = preferred[i];
+            best_quality = q;
+        }
+    }
+    return best;
+}
+
+// ============================================================================
+// OUTPUT
+// ============================================================================
+
+#if defined(HAVE_ZLIB) || defined(HAVE_BROTLI) || defined(HAVE_ZSTD)
+// Room for at least want more bytes at the end of out; NULL when out of memory
+static char* output_room(compress_output* out, size_t want, size_t* room) {
+    if (out->capacity - out->length < want) {
+        size_t capacity = out->capacity ? out->capacity : COMPRESS_CHUNK;
+        while (capacity - out->length < want) {
+            if (capacity > SIZE_MAX / 2) return NULL;
+            capacity *= 2;
+        }
+        char* grown = realloc(out->data, capacity);
+        if (!grown) return NULL;
+        out->data = grown;
+        out->capacity = capacity;
+    }
+    *room = out->capacity - out->length;
+    return out->data + out->length;
+}
+#endif
+
+// ============================================================================
+// STREAMS
+// ============================================================================
+
+// This thread's idle streams, one per codec
+typedef struct {
+    compress_stream* idle[COMPRESS_ENCODINGS];
+} compress_cache;
+
+static __thread compress_cache* thread_cache = NULL;
+static pthread_key_t cache_key;
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+
+static void stream_free(compress_stream* stream) {
+#ifdef HAVE_ZLIB
+    if (stream->zlib_ready) deflateEnd(&stream->zlib);
+#endif
+#ifdef HAVE_BROTLI
+    if (stream->brotli) BrotliEncoderDestroyInstance(stream->brotli);
+#endif
+#ifdef HAVE_ZSTD
+    if (stream->zstd) ZSTD_freeCCtx(stream->zstd);
+#endif
+    free(stream);
+}
+
+static void cache_free(void* arg) {
+    compress_cache* cache = arg;
+    for (int i = 0; i < COMPRESS_ENCODINGS; i++) {
+        if (cache->idle[i]) stream_free(cache->idle[i]);
+    }
+    free(cache);
+    thread_cache = NULL;
+}
+
+static void cache_key_create(void) {
+    pthread_key_create(&cache_key, cache_free);
+}
+
+static compress_cache* cache_get(void) {
+    if (!thread_cache) {
+        pthread_once(&cache_once, cache_key_create);
+        compress_cache* cache = calloc(1, sizeof(compress_cache));
+        if (!cache) return NULL;
+        if (pthread_setspecific(cache_key, cache) != 0) {
+            free(cache);
+            return NULL;
+        }
+        thread_cache = cache;
+    }
+    return thread_cache;
+}
+
+// level within the codec's range, COMPRESS_FAST and COMPRESS_BEST resolved
+static int codec_level(compress_encoding encoding, int level) {
+    int fast, best, low, high;
+    switch (encoding) {
+        case COMPRESS_GZIP: fast = 5, best = 9, low = 1, high = 9; break;
+        case COMPRESS_BROTLI: fast = 4, best = 11, low = 0, high = 11; break;
+        default: fast = 3, best = 19, low = 1, high = 22; break;
+    }
+    if (level == COMPRESS_FAST) return fast;
+    if (level == COMPRESS_BEST) return best;
+    return level < low ? low : level > high ? high : level;
+}
+
+compress_stream* compress_begin(compress_encoding encoding, int level) {
+    if (!compress_available(encoding)) return NULL;
+    level = codec_level(encoding, level);
+    compress_cache* cache = cache_get();
+    compress_stream* stream = cache ? cache->idle[encoding] : NULL;
+    if (stream) {
+        cache->idle[encoding] = NULL;
+    } else {
+        stream = calloc(1, sizeof(compress_stream));
+        if (!stream) return NULL;
+        stream->encoding = encoding;
+        stream->level = -1;
+    }
+    stream->failed = 0;
+
+    int ok = 0;
+    switch (encoding) {
+#ifdef HAVE_ZLIB
+        case COMPRESS_GZIP:
+            if (!stream->zlib_ready) {
+                // windowBits 15 + 16: the gzip wrapper rather than zlib's
+                ok = deflateInit2(&stream->zlib, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+                stream->zlib_ready = ok;
+            } else {
+                ok = deflateReset(&stream->zlib) == Z_OK &&
+                     (level == stream->level || deflateParams(&stream->zlib, level, Z_DEFAULT_STRATEGY) == Z_OK);
+            }
+            break;
+#endif
+#ifdef HAVE_BROTLI
+        case COMPRESS_BROTLI:
+            stream->brotli = BrotliEncoderCreateInstance(NULL, NULL, NULL);
+            ok = stream->brotli && BrotliEncoderSetParameter(stream->brotli, BROTLI_PARAM_QUALITY, (uint32_t)level);
+            break;
+#endif
+#ifdef HAVE_ZSTD
+        case COMPRESS_ZSTD:
+            if (!stream->zstd) stream->zstd = ZSTD_createCCtx();
+            ok = stream->zstd && !ZSTD_isError(ZSTD_CCtx_reset(stream->zstd, ZSTD_reset_session_only)) &&
+                 !ZSTD_isError(ZSTD_CCtx_setParameter(stream->zstd, ZSTD_c_compressionLevel, level));
+            break;
+#endif
+        default:
+            break;
+    }
+    if (!ok) {
+        stream_free(stream);
+        return NULL;
+    }
+    stream->level = level;
+    return stream;
+}
+
+// Runs the codec over length bytes, to the end of the stream if finishing
+static int stream_run(compress_stream* stream, const void* data, size_t length, int finishing,
+                      compress_output* out) {
+    if (stream->failed) return 0;
+    size_t room;
+    (void)data;
+    (void)length;
+    (void)finishing;
+    (void)out;
+    (void)room;
+    switch (stream->encoding) {
+#ifdef HAVE_ZLIB
+        case COMPRESS_GZIP: {
+            z_stream* z = &stream->zlib;
+            const unsigned char* in = data;
+            for (;;) {
+                size_t feed = length < COMPRESS_FEED ? length : COMPRESS_FEED;
+                z->next_in = (unsigned char*)in;
+                z->avail_in = (uInt)feed;
+                int flush = finishing && feed == length ? Z_FINISH : Z_NO_FLUSH;
+                int result;
+                do {
+                    char* at = output_room(out, COMPRESS_CHUNK, &room);
+                    if (!at) goto failed;
+                    if (room > COMPRESS_FEED) room = COMPRESS_FEED;
+                    z->next_out = (unsigned char*)at;
+                    z->avail_out = (uInt)room;
+                    result = deflate(z, flush);
+                    if (result == Z_STREAM_ERROR) goto failed;
+                    out->length += room - z->avail_out;
+                } while (flush == Z_FINISH ? result != Z_STREAM_END : z->avail_out == 0);
+                in += feed;
+                length -= feed;
+                if (length == 0) return 1;
+            }
+        }
+#endif
+#ifdef HAVE_BROTLI
+        case COMPRESS_BROTLI: {
+            const uint8_t* in = data;
+            size_t available = length;
+            BrotliEncoderOperation operation = finishing ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
+            while (available > 0 || BrotliEncoderHasMoreOutput(stream->brotli) ||
+                   (finishing && !BrotliEncoderIsFinished(stream->brotli))) {
+                char* at = output_room(out, COMPRESS_CHUNK, &room);
+                if (!at) goto failed;
+                uint8_t* next = (uint8_t*)at;
+                size_t left = room;
+                if (!BrotliEncoderCompressStream(stream->brotli, operation, &available, &in, &left, &next, NULL)) {
+                    goto failed;
+                }
+                out->length += room - left;
+            }
+            return 1;
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case COMPRESS_ZSTD: {
+            ZSTD_inBuffer in = {data, length, 0};
+            size_t pending;
+            do {
+                char* at = output_room(out, COMPRESS_CHUNK, &room);
+                if (!at) goto failed;
+                ZSTD_outBuffer buffer = {at, room, 0};
+                pending = ZSTD_compressStream2(stream->zstd, &buffer, &in, finishing ? ZSTD_e_end : ZSTD_e_continue);
+                if (ZSTD_isError(pending)) goto failed;
+                out->length += buffer.pos;
+            } while (finishing ? pending != 0 : in.pos < in.size);
+            return 1;
+        }
+#endif
+        default:
+            break;
+    }
+#if defined(HAVE_ZLIB) || defined(HAVE_BROTLI) || defined(HAVE_ZSTD)
+failed:
+#endif
+    stream->failed = 1;
+    return 0;
+}
+
+int compress_write(compress_stream* stream, const void* data, size_t length, compress_output* out) {
+    return length == 0 || stream_run(stream, data, length, 0, out);
+}
+
+int compress_finish(compress_stream* stream, compress_output* out) {
+    return stream_run(stream, NULL, 0, 1, out);
+}
+
+void compress_end(compress_stream* stream) {
+    if (!stream) return;
+#ifdef HAVE_BROTLI
+    if (stream->brotli) {
+        BrotliEncoderDestroyInstance(stream->brotli);
+        stream->brotli = NULL;
+    }
+#endif
+    // A stream that failed, or one begun while the cached one was out, is
+    // not kept
+    compress_cache* cache = thread_cache;
+    if (!stream->failed && cache && !cache->idle[stream->encoding]) {
+        cache->idle[stream->encoding] = stream;
+    } else {
+        stream_free(stream);
+    }
+}
+
+// ============================================================================
+// DECOMPRESSION
+// ============================================================================
+
+int compress_decompress(compress_encoding encoding, const void* data, size_t length, size_t max_length,
+                        compress_output* out) {
+    size_t start = out->length;
+    size_t room;
+    int ok = 0;
+    (void)data;
+    (void)length;
+    (void)max_length;
+    (void)room;
+    switch (encoding) {
+#ifdef HAVE_ZLIB
+        case COMPRESS_GZIP: {
+            z_stream z = {0};
+            if (length > COMPRESS_FEED || inflateInit2(&z, 15 + 16) != Z_OK) return 0;
+            z.next_in = (unsigned char*)data;
+            z.avail_in = (uInt)length;
+            int result = Z_OK;
+            while (result == Z_OK && out->length - start <= max_length) {
+                char* at = output_room(out, COMPRESS_CHUNK, &room);
+                if (!at) break;
+                if (room > COMPRESS_FEED) room = COMPRESS_FEED;
+                z.next_out = (unsigned char*)at;
+                z.avail_out = (uInt)room;
+                result = inflate(&z, Z_NO_FLUSH);
+                out->length += room - z.avail_out;
+            }
+            ok = result == Z_STREAM_END && z.avail_in == 0;
+            inflateEnd(&z);
+            break;
+        }
+#endif
+#ifdef HAVE_BROTLI
+        case COMPRESS_BROTLI: {
+            BrotliDecoderState* decoder = BrotliDecoderCreateInstance(NULL, NULL, NULL);
+            if (!decoder) return 0;
+            const uint8_t* in = data;
+            size_t available = length;
+            BrotliDecoderResult result = BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT;
+            while (result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT && out->length - start <= max_length) {
+                char* at = output_room(out, COMPRESS_CHUNK, &room);
+                if (!at) break;
+                uint8_t* next = (uint8_t*)at;
+                size_t left = room;
+                result = BrotliDecoderDecompressStream(decoder, &available, &in, &left, &next, NULL);
+                out->length += room - left;
+            }
+            ok = result == BROTLI_DECODER_RESULT_SUCCESS && available == 0;
+            BrotliDecoderDestroyInstance(decoder);
+            break;
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case COMPRESS_ZSTD: {
+            ZSTD_DCtx* decoder = ZSTD_createDCtx();
+            if (!decoder) return 0;
+            ZSTD_inBuffer in = {data, length, 0};
+            size_t pending = 1;
+            // Frames follow one another until the input ends on a whole one
+            while ((in.pos < in.size || pending != 0) && out->length - start <= max_length) {
+                char* at = output_room(out, COMPRESS_CHUNK, &room);
+                if (!at) break;
+                ZSTD_outBuffer buffer = {at, room, 0};
+                size_t before = in.pos;
+                pending = ZSTD_decompressStream(decoder, &buffer, &in);
+                if (ZSTD_isError(pending)) break;
+                out->length += buffer.pos;
+                // No progress with room to spare: the input stopped mid-frame
+                if (in.pos == before && buffer.pos == 0) break;
+            }
+            ok = !ZSTD_isError(pending) && pending == 0 && in.pos == in.size && length > 0;
+            ZSTD_freeDCtx(decoder);
+            break;
+        }
+#endif
+        default:
+            break;
+    }
+    if (!ok || out->length - start > max_length) {
+        out->length = start;
+        return 0;
+    }
+    return 1;
+}
+
+// ============================================================================
+// NATIVES
+// ============================================================================
+
+static const char* string_bytes(ember_value value, size_t* length) {
+    if (value.type != EMBER_VAL_STRING || !value.as.obj_val) return NULL;
+    if (value.as.obj_val->type != OBJ_STRING) {
+        *length = strlen(value.as.string_val);
+        return value.as.string_val;
+    }
+    ember_string* string = AS_STRING(value);
+    *length = (size_t)string->length;
+    const char* bytes = ember_string_bytes(string);
+    return bytes ? bytes : ember_string_flatten(string);
+}
+
+static compress_encoding encoding_value(ember_value value) {
+    size_t length;
+    const char* name = string_bytes(value, &length);
+    return name ? compress_encoding_named(name, length) : COMPRESS_NONE;
+}
+
+static ember_value output_string(ember_vm* vm, const compress_output* out) {
+    if (out->length > INT32_MAX) return ember_make_nil();
+    ember_string* string = copy_string(vm, out->data ? out->data : "", (int)out->length);
+    if (!string) return ember_make_nil();
+    ember_value value;
+    value.type = EMBER_VAL_STRING;
+    value.as.obj_val = (ember_object*)string;
+    return value;
+}
+
+// compress(data, encoding [, level]): data compressed as "gzip", "br" or
+// "zstd", as a string of bytes; nil if this build has no such codec.
+// level is the codec's own (gzip 1-9, br 0-11, zstd 1-22), defaulting to
+// a fast one
+ember_value ember_native_compress(ember_vm* vm, int argc, ember_value* argv) {
+    size_t length;
+    const char* data = argc >= 2 && argc <= 3 ? string_bytes(argv[0], &length) : NULL;
+    if (!data || (argc == 3 && argv[2].type != EMBER_VAL_NUMBER)) return ember_make_nil();
+    int level = COMPRESS_FAST;
+    if (argc == 3) {
+        double number = argv[2].as.number_val;
+        if (!(number >= 0 && number <= 22) || number != (int)number) return ember_make_nil();
+        level = (int)number;
+    }
+    compress_stream* stream = compress_begin(encoding_value(argv[1]), level);
+    if (!stream) return ember_make_nil();
+    compress_output out = {0};
+    int ok = compress_write(stream, data, length, &out) && compress_finish(stream, &out);
+    compress_end(stream);
+    ember_value result = ok ? output_string(vm, &out) : ember_make_nil();
+    free(out.data);
+    return result;
+}
+
+// decompress(data, encoding [, max_length]): what compress made of it; nil
+// if data is not whole, valid data of encoding or would decompress to more
+// than max_length bytes (64 MB by default)
+ember_value ember_native_decompress(ember_vm* vm, int argc, ember_value* argv) {
+    size_t length;
+    const char* data = argc >= 2 && argc <= 3 ? string_bytes(argv[0], &length) : NULL;
+    if (!data || (argc == 3 && argv[2].type != EMBER_VAL_NUMBER)) return ember_make_nil();
+    size_t max_length = COMPRESS_MAX_OUTPUT;
+    if (argc == 3) {
+        double number = argv[2].as.number_val;
+        if (!(number >= 0 && number <= INT32_MAX)) return ember_make_nil();
+        max_length = (size_t)number;
+    }
+    compress_output out = {0};
+    int ok = compress_decompress(encoding_value(argv[1]), data, length, max_length, &out);
+    ember_value result = ok ? output_string(vm, &out) : ember_make_nil();
+    free(out.data);
+    return result;
+}
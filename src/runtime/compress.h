@@ -0,0 +1,68 @@
+#ifndef EMBER_COMPRESS_H
+#define EMBER_COMPRESS_H
+
+#include <stddef.h>
+
+// Streaming compression for HTTP content codings: gzip (zlib), br (brotli)
+// and zstd, each only where the build found its library (HAVE_ZLIB,
+// HAVE_BROTLI, HAVE_ZSTD).
+//
+// A stream is taken from the calling thread's cache and given back to it
+// by compress_end, so a server worker compressing response after response
+// resets one deflate state or zstd context rather than allocating a new
+// one each time (their window and hash tables are most of the cost of a
+// small response). brotli has no reset, so its encoder is made per stream.
+// A thread's cached streams are freed when it exits.
+
+typedef enum {
+    COMPRESS_NONE = 0,
+    COMPRESS_GZIP,
+    COMPRESS_BROTLI,
+    COMPRESS_ZSTD,
+    COMPRESS_ENCODINGS
+} compress_encoding;
+
+// Levels for compress_begin, besides each codec's own numbers
+#define COMPRESS_FAST (-1)                   // Cheap enough for every dynamic response
+#define COMPRESS_BEST (-2)                   // For output made once and served many times
+
+typedef struct {
+    char* data;
+    size_t length, capacity;
+} compress_output;
+
+typedef struct compress_stream compress_stream;
+
+// Whether this build can produce encoding
+int compress_available(compress_encoding encoding);
+
+// "gzip" (or "x-gzip"), "br" and "zstd", case-insensitively; COMPRESS_NONE
+// for anything else
+compress_encoding compress_encoding_named(const char* name, size_t length);
+const char* compress_encoding_name(compress_encoding encoding);
+
+// The coding to answer an Accept-Encoding value with: the best of those
+// available the client accepts (q > 0), preferring br, then zstd, then
+// gzip at equal q. "*" stands for any coding not listed
+compress_encoding compress_accept(const char* accept, size_t length);
+
+// A stream compressing into encoding at level, clamped to the codec's
+// range; NULL if it is unavailable or out of memory
+compress_stream* compress_begin(compress_encoding encoding, int level);
+
+// Compresses length bytes, appending what is ready to out; 0 on failure,
+// after which the stream can only be ended
+int compress_write(compress_stream* stream, const void* data, size_t length, compress_output* out);
+
+// Appends the rest of the compressed data to out; 0 on failure
+int compress_finish(compress_stream* stream, compress_output* out);
+
+// Gives the stream back to this thread's cache, finished or not
+void compress_end(compress_stream* stream);
+
+// Decompresses length bytes of encoding into out: 1, or 0 if they are not
+// whole valid data or would decompress to more than max_length bytes
+int compress_decompress(compress_encoding encoding, const void* data, size_t length, size_t max_length,
+                        compress_output* out);
+
+#endif // EMBER_COMPRESS_H
@@ -1,134 +1,427 @@
 /**
- * Simple functional crypto implementations to replace stubs
- * Based on ember-stdlib but simplified for immediate integration
+ * Crypto natives: SHA-256 / SHA-512 digests, HMAC, a streaming hasher and
+ * secure random bytes and UUIDs
+ * sha256 / sha512 / hmac_sha256 / hmac_sha512 / secure_random /
+ * uuid_v4 / uuid_v7 / hasher / hasher_update / hasher_digest
+ *
+ * Hashing goes through libcrypto's EVP interface, which picks SHA-NI,
+ * ARMv8 SHA2 or AVX2 block functions for the CPU at startup, so these run
+ * at the hardware's speed rather than a portable C loop's
  */
 
+#define _GNU_SOURCE
 #include "ember.h"
+#include "value/value.h"
+#include "stdlib_working.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#if defined(__linux__)
+#include <sys/random.h>
+#endif
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/core_names.h>
+#include <openssl/params.h>
 
-// Helper function to convert bytes to hex string
-static char* bytes_to_hex(const unsigned char* bytes, size_t len) {
-    char* hex = malloc(len * 2 + 1);
-    if (!hex) return NULL;
-    
+// Lowercase hex of len bytes into hex, which holds 2 * len + 1
+static void bytes_to_hex(const unsigned char* bytes, size_t len, char* hex) {
+    static const char digits[] = "0123456789abcdef";
     for (size_t i = 0; i < len; i++) {
-        sprintf(hex + i * 2, "%02x", bytes[i]);
+        hex[i * 2] = digits[bytes[i] >> 4];
+        hex[i * 2 + 1] = digits[bytes[i] & 0x0f];
     }
     hex[len * 2] = '\0';
-    return hex;
 }
 
-// Simple SHA-256 implementation (for demonstration - in production use OpenSSL)
-static void simple_sha256(const char* input, char* output) {
-    // This is a simplified hash for demonstration
-    // In a real implementation, you'd use OpenSSL or similar
-    if (!input || !output) return;
-    
-    uint32_t hash = 0x5f375a86;  // Some initial value
-    size_t len = strlen(input);
-    
-    for (size_t i = 0; i < len && i < 1024; i++) {  // Limit input length
-        hash = ((hash << 5) + hash) + (unsigned char)input[i];
-    }
-    
-    snprintf(output, 65, "%08x%08x%08x%08x%08x%08x%08x%08x", 
-            hash, hash ^ 0x12345678, hash ^ 0x87654321, hash ^ 0xabcdefab,
-            hash ^ 0xfedcba98, hash ^ 0x11111111, hash ^ 0x22222222, hash ^ 0x33333333);
+// A string's bytes without copying a slice; ropes are flattened
+static const char* string_data(ember_string* string) {
+    const char* bytes = ember_string_bytes(string);
+    return bytes ? bytes : ember_string_flatten(string);
 }
 
-// Working crypto function implementations
-ember_value ember_native_sha256_working(ember_vm* vm, int argc, ember_value* argv) {
+// "sha256" / "sha512" to the digest, NULL for anything else
+static const EVP_MD* digest_named(ember_value name) {
+    if (name.type != EMBER_VAL_STRING) return NULL;
+    const char* chars = AS_CSTRING(name);
+    if (!chars) return NULL;
+    if (strcmp(chars, "sha256") == 0) return EVP_sha256();
+    if (strcmp(chars, "sha512") == 0) return EVP_sha512();
+    return NULL;
+}
+
+static ember_value hex_value(ember_vm* vm, const unsigned char* digest, size_t length) {
+    char hex[EVP_MAX_MD_SIZE * 2 + 1];
+    bytes_to_hex(digest, length, hex);
+    return ember_make_string_gc(vm, hex);
+}
+
+static ember_value digest_native(ember_vm* vm, int argc, ember_value* argv, const EVP_MD* md) {
     if (argc != 1 || argv[0].type != EMBER_VAL_STRING) {
         return ember_make_nil();
     }
-    
     ember_string* str = AS_STRING(argv[0]);
-    if (!str || !str->chars) {
+    const char* data = str ? string_data(str) : NULL;
+    if (!data) return ember_make_nil();
+
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    if (!EVP_Digest(data, (size_t)str->length, digest, &length, md, NULL)) {
         return ember_make_nil();
     }
-    
-    static char hash[65];  // Static to avoid stack issues
-    simple_sha256(str->chars, hash);
-    hash[64] = '\0';  // Ensure null termination
-    
-    return ember_make_string_gc(vm, hash);
+    return hex_value(vm, digest, length);
 }
 
-ember_value ember_native_sha512_working(ember_vm* vm, int argc, ember_value* argv) {
-    if (argc != 1 || argv[0].type != EMBER_VAL_STRING) {
+static ember_value hmac_native(ember_vm* vm, int argc, ember_value* argv, const EVP_MD* md) {
+    if (argc != 2 || argv[0].type != EMBER_VAL_STRING || argv[1].type != EMBER_VAL_STRING) {
         return ember_make_nil();
     }
-    
-    ember_string* str = AS_STRING(argv[0]);
-    if (!str || !str->chars) {
+    ember_string* key = AS_STRING(argv[0]);
+    ember_string* message = AS_STRING(argv[1]);
+    const char* key_data = key ? string_data(key) : NULL;
+    const char* message_data = message ? string_data(message) : NULL;
+    if (!key_data || !message_data) return ember_make_nil();
+
+    // RFC 2104: keys longer than a block are hashed first, shorter ones padded
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    if (!HMAC(md, key_data, key->length, (const unsigned char*)message_data, (size_t)message->length,
+              digest, &length)) {
         return ember_make_nil();
     }
-    
-    // For now, just return a longer version of sha256
-    static char hash[129];  // 128 chars + null terminator
-    char sha256_result[65];
-    simple_sha256(str->chars, sha256_result);
-    
-    // Double it to make it look like SHA-512
-    snprintf(hash, sizeof(hash), "%s%s", sha256_result, sha256_result);
-    hash[128] = '\0';
-    
-    return ember_make_string_gc(vm, hash);
+    return hex_value(vm, digest, length);
+}
+
+ember_value ember_native_sha256_working(ember_vm* vm, int argc, ember_value* argv) {
+    return digest_native(vm, argc, argv, EVP_sha256());
+}
+
+ember_value ember_native_sha512_working(ember_vm* vm, int argc, ember_value* argv) {
+    return digest_native(vm, argc, argv, EVP_sha512());
 }
 
+ember_value ember_native_hmac_sha256_working(ember_vm* vm, int argc, ember_value* argv) {
+    return hmac_native(vm, argc, argv, EVP_sha256());
+}
+
+ember_value ember_native_hmac_sha512_working(ember_vm* vm, int argc, ember_value* argv) {
+    return hmac_native(vm, argc, argv, EVP_sha512());
+}
+
+// ============================================================================
+// SECURE RANDOM
+// ============================================================================
+
+// Bytes come from the kernel in blocks of RANDOM_POOL_SIZE into a buffer
+// per thread, so a token or UUID is a copy rather than a system call.
+// Handed-out bytes are wiped from the pool. A fork makes every pool stale:
+// the child would otherwise hand out the same bytes as its parent
+#define RANDOM_POOL_SIZE 4096
+#define SECURE_RANDOM_MAX (1 << 20)
+
+typedef struct {
+    unsigned char bytes[RANDOM_POOL_SIZE];
+    size_t available;                  // Unused bytes, at the end of bytes
+    unsigned generation;               // fork_generation when filled
+} random_pool;
+
+static __thread random_pool thread_pool;
+static volatile unsigned fork_generation = 1;
+static pthread_once_t fork_handler_once = PTHREAD_ONCE_INIT;
+
+static void random_after_fork(void) {
+    fork_generation++;
+}
+
+static void register_fork_handler(void) {
+    pthread_atfork(NULL, NULL, random_after_fork);
+}
+
+// Straight from the kernel: getrandom on Linux, arc4random_buf on the
+// BSDs and macOS, /dev/urandom elsewhere
+static bool system_random(void* out, size_t length) {
+    unsigned char* bytes = out;
+#if defined(__linux__)
+    while (length > 0) {
+        ssize_t got = getrandom(bytes, length, 0);
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        bytes += got;
+        length -= (size_t)got;
+    }
+    return true;
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+    arc4random_buf(bytes, length);
+    return true;
+#else
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd < 0) return false;
+    while (length > 0) {
+        ssize_t got = read(fd, bytes, length);
+        if (got <= 0) {
+            if (got < 0 && errno == EINTR) continue;
+            close(fd);
+            return false;
+        }
+        bytes += got;
+        length -= (size_t)got;
+    }
+    close(fd);
+    return true;
+#endif
+}
+
+bool ember_secure_random_bytes(void* out, size_t length) {
+    pthread_once(&fork_handler_once, register_fork_handler);
+    random_pool* pool = &thread_pool;
+    if (pool->generation != fork_generation) {
+        memset(pool->bytes, 0, sizeof(pool->bytes));
+        pool->available = 0;
+        pool->generation = fork_generation;
+    }
+    // Large requests skip the pool
+    if (length > RANDOM_POOL_SIZE / 4) return system_random(out, length);
+
+    unsigned char* bytes = out;
+    while (length > 0) {
+        if (pool->available == 0) {
+            if (!system_random(pool->bytes, RANDOM_POOL_SIZE)) return false;
+            pool->available = RANDOM_POOL_SIZE;
+        }
+        size_t take = length < pool->available ? length : pool->available;
+        unsigned char* from = pool->bytes + RANDOM_POOL_SIZE - pool->available;
+        memcpy(bytes, from, take);
+        memset(from, 0, take);
+        pool->available -= take;
+        bytes += take;
+        length -= take;
+    }
+    return true;
+}
+
+// secure_random(length[, "hex" | "bytes"]): length random bytes as hex
+// (the default) or as a binary string
 ember_value ember_native_secure_random_working(ember_vm* vm, int argc, ember_value* argv) {
-    if (argc != 1 || argv[0].type != EMBER_VAL_NUMBER) {
+    if (argc < 1 || argc > 2 || argv[0].type != EMBER_VAL_NUMBER) {
         return ember_make_nil();
     }
-    
-    int length = (int)argv[0].as.number_val;
-    if (length <= 0 || length > 1024) {
+    double requested = argv[0].as.number_val;
+    if (!(requested >= 1 && requested <= SECURE_RANDOM_MAX)) {
         return ember_make_nil();
     }
-    
-    unsigned char* random_bytes = malloc(length);
-    if (!random_bytes) return ember_make_nil();
-    
-    // Simple random generation (for demo - use /dev/urandom in production)
-    for (int i = 0; i < length; i++) {
-        random_bytes[i] = rand() % 256;
-    }
-    
-    char* hex = bytes_to_hex(random_bytes, length);
-    free(random_bytes);
-    
-    if (!hex) return ember_make_nil();
-    
-    ember_value result = ember_make_string_gc(vm, hex);
-    free(hex);
+    bool binary = false;
+    if (argc == 2) {
+        const char* encoding = argv[1].type == EMBER_VAL_STRING ? AS_CSTRING(argv[1]) : NULL;
+        if (!encoding || (strcmp(encoding, "hex") != 0 && strcmp(encoding, "bytes") != 0)) {
+            return ember_make_nil();
+        }
+        binary = encoding[0] == 'b';
+    }
+    size_t length = (size_t)requested;
+
+    // Both forms fit in one buffer: the bytes at the back, hex from the front
+    unsigned char stack_buffer[256 * 3 + 1];
+    size_t size = length * 3 + 1;
+    unsigned char* buffer = size <= sizeof(stack_buffer) ? stack_buffer : malloc(size);
+    if (!buffer) return ember_make_nil();
+    unsigned char* random_bytes = buffer + length * 2 + 1;
+    ember_value result = ember_make_nil();
+    if (ember_secure_random_bytes(random_bytes, length)) {
+        ember_string* string;
+        if (binary) {
+            string = copy_string(vm, (const char*)random_bytes, (int)length);
+        } else {
+            bytes_to_hex(random_bytes, length, (char*)buffer);
+            string = copy_string(vm, (const char*)buffer, (int)(length * 2));
+        }
+        if (string) {
+            result.type = EMBER_VAL_STRING;
+            result.as.obj_val = (ember_object*)string;
+        }
+    }
+    memset(buffer, 0, size);
+    if (buffer != stack_buffer) free(buffer);
     return result;
 }
 
-ember_value ember_native_hmac_sha256_working(ember_vm* vm, int argc, ember_value* argv) {
-    if (argc != 2 || argv[0].type != EMBER_VAL_STRING || argv[1].type != EMBER_VAL_STRING) {
-        return ember_make_nil();
+// 8-4-4-4-12 hex form of 16 bytes
+static ember_value uuid_value(ember_vm* vm, unsigned char* uuid) {
+    char text[37];
+    char* out = text;
+    for (int i = 0; i < 16; i++) {
+        if (i == 4 || i == 6 || i == 8 || i == 10) *out++ = '-';
+        bytes_to_hex(uuid + i, 1, out);
+        out += 2;
     }
-    
-    ember_string* key = AS_STRING(argv[0]);
-    ember_string* message = AS_STRING(argv[1]);
-    
-    if (!key || !key->chars || !message || !message->chars) {
+    *out = '\0';
+    return ember_make_string_gc(vm, text);
+}
+
+// uuid_v4(): a random UUID (RFC 9562 version 4)
+ember_value ember_native_uuid_v4(ember_vm* vm, int argc, ember_value* argv) {
+    (void)argv;
+    if (argc != 0) return ember_make_nil();
+    unsigned char uuid[16];
+    if (!ember_secure_random_bytes(uuid, sizeof(uuid))) return ember_make_nil();
+    uuid[6] = (unsigned char)((uuid[6] & 0x0f) | 0x40);
+    uuid[8] = (unsigned char)((uuid[8] & 0x3f) | 0x80);
+    return uuid_value(vm, uuid);
+}
+
+// uuid_v7(): a time-ordered UUID (RFC 9562 version 7). The 48-bit Unix
+// millisecond timestamp leads; the 12 bits after the version are a counter
+// within the millisecond, so UUIDs from one thread sort in creation order
+ember_value ember_native_uuid_v7(ember_vm* vm, int argc, ember_value* argv) {
+    (void)argv;
+    if (argc != 0) return ember_make_nil();
+    static __thread uint64_t last_ms = 0;
+    static __thread unsigned sequence = 0;
+
+    unsigned char uuid[16];
+    if (!ember_secure_random_bytes(uuid + 6, 10)) return ember_make_nil();
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t ms = (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+    if (ms > last_ms) {
+        // A random start in the lower half leaves room to count up
+        sequence = ((unsigned)uuid[6] << 4 | uuid[7] >> 4) & 0x7ff;
+    } else if (++sequence > 0xfff) {
+        // Counter spent (or the clock went back): borrow the next millisecond
+        ms = last_ms + 1;
+        sequence = 0;
+    } else {
+        ms = last_ms;
+    }
+    last_ms = ms;
+
+    for (int i = 0; i < 6; i++) {
+        uuid[i] = (unsigned char)(ms >> (40 - 8 * i));
+    }
+    uuid[6] = (unsigned char)(0x70 | (sequence >> 8));
+    uuid[7] = (unsigned char)(sequence & 0xff);
+    uuid[8] = (unsigned char)((uuid[8] & 0x3f) | 0x80);
+    return uuid_value(vm, uuid);
+}
+
+// ============================================================================
+// STREAMING HASHER
+// ============================================================================
+
+void ember_hasher_release(ember_hasher* hasher) {
+    if (!hasher->state) return;
+    if (hasher->keyed) {
+        EVP_MAC_CTX_free((EVP_MAC_CTX*)hasher->state);
+    } else {
+        EVP_MD_CTX_free((EVP_MD_CTX*)hasher->state);
+    }
+    hasher->state = NULL;
+}
+
+// The library context for md, keyed with key when it is not NULL
+static void* hasher_state(const EVP_MD* md, const char* key, size_t key_length) {
+    if (!key) {
+        EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+        if (ctx && !EVP_DigestInit_ex(ctx, md, NULL)) {
+            EVP_MD_CTX_free(ctx);
+            ctx = NULL;
+        }
+        return ctx;
+    }
+    EVP_MAC* mac = EVP_MAC_fetch(NULL, OSSL_MAC_NAME_HMAC, NULL);
+    if (!mac) return NULL;
+    EVP_MAC_CTX* ctx = EVP_MAC_CTX_new(mac);
+    EVP_MAC_free(mac);      // The context holds its own reference
+    if (!ctx) return NULL;
+    OSSL_PARAM params[2];
+    params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char*)EVP_MD_get0_name(md), 0);
+    params[1] = OSSL_PARAM_construct_end();
+    // A zero-length key still has to be set, through a non-NULL pointer
+    static const unsigned char empty_key[1] = {0};
+    const unsigned char* key_bytes = key_length ? (const unsigned char*)key : empty_key;
+    if (!EVP_MAC_init(ctx, key_bytes, key_length, params)) {
+        EVP_MAC_CTX_free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+// hasher(algorithm[, key]): "sha256" or "sha512"; with a key, an HMAC
+ember_value ember_native_hasher(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc < 1 || argc > 2 || (argc == 2 && argv[1].type != EMBER_VAL_STRING)) {
         return ember_make_nil();
     }
-    
-    // Simple HMAC simulation (combine key and message)
-    size_t combined_len = strlen(key->chars) + strlen(message->chars) + 1;
-    char* combined = malloc(combined_len);
-    if (!combined) return ember_make_nil();
-    
-    snprintf(combined, combined_len, "%s%s", key->chars, message->chars);
-    
-    static char hash[65];
-    simple_sha256(combined, hash);
-    free(combined);
-    
-    return ember_make_string_gc(vm, hash);
-}
\ No newline at end of file
+    const EVP_MD* md = digest_named(argv[0]);
+    if (!md) return ember_make_nil();
+    const char* key = NULL;
+    size_t key_length = 0;
+    if (argc == 2) {
+        key = string_data(AS_STRING(argv[1]));
+        if (!key) return ember_make_nil();
+        key_length = (size_t)AS_STRING(argv[1])->length;
+    }
+
+    ember_hasher* hasher = (ember_hasher*)allocate_object(vm, sizeof(ember_hasher), OBJ_HASHER);
+    if (!hasher) return ember_make_nil();
+    hasher->state = NULL;
+    hasher->keyed = key != NULL;
+    hasher->finished = false;
+    hasher->length = 0;
+    ember_value value;
+    value.type = EMBER_VAL_HASHER;
+    value.as.obj_val = (ember_object*)hasher;
+    hasher->state = hasher_state(md, key, key_length);
+    if (!hasher->state) return ember_make_nil();
+    return value;
+}
+
+// hasher_update(hasher, chunk...): the hasher, for chaining, or nil once
+// it has been digested
+ember_value ember_native_hasher_update(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc < 1 || argv[0].type != EMBER_VAL_HASHER) return ember_make_nil();
+    ember_hasher* hasher = AS_HASHER(argv[0]);
+    if (hasher->finished || !hasher->state) return ember_make_nil();
+    for (int i = 1; i < argc; i++) {
+        if (argv[i].type != EMBER_VAL_STRING) return ember_make_nil();
+        ember_string* chunk = AS_STRING(argv[i]);
+        const char* data = string_data(chunk);
+        if (!data) return ember_make_nil();
+        size_t length = (size_t)chunk->length;
+        int ok = hasher->keyed
+            ? EVP_MAC_update((EVP_MAC_CTX*)hasher->state, (const unsigned char*)data, length)
+            : EVP_DigestUpdate((EVP_MD_CTX*)hasher->state, data, length);
+        if (!ok) return ember_make_nil();
+        hasher->length += length;
+    }
+    return argv[0];
+}
+
+// hasher_digest(hasher): the hex digest of everything fed in; the hasher
+// is finished after this and its context released
+ember_value ember_native_hasher_digest(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 1 || argv[0].type != EMBER_VAL_HASHER) return ember_make_nil();
+    ember_hasher* hasher = AS_HASHER(argv[0]);
+    if (hasher->finished || !hasher->state) return ember_make_nil();
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    size_t length = 0;
+    int ok;
+    if (hasher->keyed) {
+        ok = EVP_MAC_final((EVP_MAC_CTX*)hasher->state, digest, &length, sizeof(digest));
+    } else {
+        unsigned int md_length = 0;
+        ok = EVP_DigestFinal_ex((EVP_MD_CTX*)hasher->state, digest, &md_length);
+        length = md_length;
+    }
+    hasher->finished = true;
+    ember_hasher_release(hasher);
+    if (!ok) return ember_make_nil();
+    return hex_value(vm, digest, length);
+}
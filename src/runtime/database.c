@@ -0,0 +1,669 @@
+/**
+ * SQL databases: db_connect / db_disconnect / db_query / db_batch /
+ * db_begin / db_commit / db_rollback / db_error / db_pool_stats
+ *
+ * SQLite, built when the library is found (HAVE_SQLITE). Connections are
+ * pooled per database file for the whole process and shared by every VM:
+ * db_connect takes an idle connection from the file's pool, opening a new
+ * one only while the pool is under its limit and otherwise waiting for one
+ * to come back, and db_disconnect returns it still open. An endpoint that
+ * connects per request reuses the same few connections.
+ *
+ * Each connection keeps its prepared statements in a small LRU keyed by the
+ * SQL text, so a query it has seen before is rebound and stepped, never
+ * parsed again. Rows come back as arrays, one per row with the columns in
+ * select order, built straight from sqlite3_column_*. db_batch runs one
+ * statement once per parameter array inside a single transaction.
+ *
+ * A handle is a number naming a checked-out connection. It belongs to the
+ * VM that connected until db_disconnect, or until that VM is freed or reset
+ * by the pool (database_release_vm). Other VMs and stale handles are
+ * refused.
+ */
+
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../vm.h"
+#include "value/value.h"
+
+#ifdef HAVE_SQLITE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sqlite3.h>
+
+#define DB_MAX_HANDLES 4096
+#define DB_DEFAULT_CONNECTIONS 16            // Open connections per database file
+#define DB_DEFAULT_STATEMENTS 64             // Prepared statements kept per connection
+#define DB_CONNECT_WAIT_MS 5000              // db_connect's wait for a busy pool
+#define DB_BUSY_TIMEOUT_MS 5000              // SQLite's wait for another connection's lock
+#define DB_MAX_PATH 4096
+
+typedef struct {
+    char* sql;
+    size_t length;
+    uint32_t hash;
+    uint64_t used;                           // Connection tick of the last use, for LRU
+    sqlite3_stmt* stmt;
+} db_statement;
+
+typedef struct db_connection {
+    sqlite3* db;
+    struct db_pool* pool;
+    db_statement* statements;
+    int statement_count;
+    int statement_capacity;
+    uint64_t tick;
+    struct db_connection* next_idle;
+} db_connection;
+
+typedef struct db_pool {
+    char* path;
+    db_connection* idle;
+    int idle_count;
+    int open_count;                          // Idle and checked out, and ones being opened
+    struct db_pool* next;
+} db_pool;
+
+typedef struct {
+    db_connection* connection;               // NULL when free
+    ember_vm* owner;
+    uint32_t generation;                     // Bumped on release, so old handles go stale
+} db_handle;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t released;                 // A connection went back to some pool
+    db_pool* pools;
+    int max_connections;
+    int statement_capacity;
+    int handle_count;
+    int handle_cursor;
+    db_handle handles[DB_MAX_HANDLES];
+    uint64_t opened;
+    uint64_t reused;
+    uint64_t statement_hits;
+    uint64_t statement_misses;
+} db = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .released = PTHREAD_COND_INITIALIZER,
+    .max_connections = DB_DEFAULT_CONNECTIONS,
+    .statement_capacity = DB_DEFAULT_STATEMENTS,
+};
+
+// ============================================================================
+// VALUES
+// ============================================================================
+
+static const char* string_bytes(ember_value value, size_t* length) {
+    if (value.type != EMBER_VAL_STRING || !value.as.obj_val) return NULL;
+    if (value.as.obj_val->type != OBJ_STRING) {
+        *length = strlen(value.as.string_val);
+        return value.as.string_val;
+    }
+    ember_string* string = AS_STRING(value);
+    *length = (size_t)string->length;
+    const char* bytes = ember_string_bytes(string);
+    return bytes ? bytes : ember_string_flatten(string);
+}
+
+static int bind_value(sqlite3_stmt* stmt, int index, ember_value value) {
+    switch (value.type) {
+        case EMBER_VAL_NIL:
+            return sqlite3_bind_null(stmt, index);
+        case EMBER_VAL_BOOL:
+            return sqlite3_bind_int(stmt, index, value.as.bool_val ? 1 : 0);
+        case EMBER_VAL_NUMBER: {
+            double number = value.as.number_val;
+            if (IS_SMALL_INT(value)) return sqlite3_bind_int64(stmt, index, AS_SMALL_INT(value));
+            if (number >= -9007199254740992.0 && number <= 9007199254740992.0 && number == (double)(int64_t)number) {
+                return sqlite3_bind_int64(stmt, index, (int64_t)number);
+            }
+            return sqlite3_bind_double(stmt, index, number);
+        }
+        case EMBER_VAL_STRING: {
+            size_t length;
+            const char* bytes = string_bytes(value, &length);
+            if (!bytes || length > INT32_MAX) return SQLITE_MISUSE;
+            return sqlite3_bind_text(stmt, index, bytes, (int)length, SQLITE_TRANSIENT);
+        }
+        default:
+            return SQLITE_MISUSE;
+    }
+}
+
+// params is nil or an array with one value per placeholder
+static int bind_params(sqlite3_stmt* stmt, ember_value params) {
+    if (params.type == EMBER_VAL_NIL) {
+        return sqlite3_bind_parameter_count(stmt) == 0 ? SQLITE_OK : SQLITE_RANGE;
+    }
+    if (params.type != EMBER_VAL_ARRAY) return SQLITE_MISUSE;
+    ember_array* array = AS_ARRAY(params);
+    if (array->length != sqlite3_bind_parameter_count(stmt)) return SQLITE_RANGE;
+    for (int i = 0; i < array->length; i++) {
+        int result = bind_value(stmt, i + 1, array->elements[i]);
+        if (result != SQLITE_OK) return result;
+    }
+    return SQLITE_OK;
+}
+
+static ember_value column_value(ember_vm* vm, sqlite3_stmt* stmt, int column) {
+    switch (sqlite3_column_type(stmt, column)) {
+        case SQLITE_INTEGER:
+            return ember_make_number((double)sqlite3_column_int64(stmt, column));
+        case SQLITE_FLOAT:
+            return ember_make_number(sqlite3_column_double(stmt, column));
+        case SQLITE_TEXT: {
+            const char* text = (const char*)sqlite3_column_text(stmt, column);
+            return ember_make_string_len(vm, text ? text : "", (size_t)sqlite3_column_bytes(stmt, column));
+        }
+        case SQLITE_BLOB: {
+            const char* blob = sqlite3_column_blob(stmt, column);
+            return ember_make_string_len(vm, blob ? blob : "", (size_t)sqlite3_column_bytes(stmt, column));
+        }
+        default:
+            return ember_make_nil();
+    }
+}
+
+// Steps a bound statement to the end: an array of row arrays if it has
+// columns, otherwise the number of rows it changed; nil on an error. The
+// statement is reset either way
+static ember_value statement_run(ember_vm* vm, sqlite3_stmt* stmt) {
+    int columns = sqlite3_column_count(stmt);
+    ember_value result = ember_make_nil();
+    int step;
+    if (columns == 0) {
+        while ((step = sqlite3_step(stmt)) == SQLITE_ROW) {
+        }
+        if (step == SQLITE_DONE) result = ember_make_number((double)sqlite3_changes(sqlite3_db_handle(stmt)));
+    } else if (vm->stack_top < EMBER_STACK_MAX) {
+        ember_value rows = ember_make_array(vm, 8);
+        if (rows.type == EMBER_VAL_ARRAY) {
+            // Rooted while rows and their strings allocate
+            vm->stack[vm->stack_top++] = rows;
+            while ((step = sqlite3_step(stmt)) == SQLITE_ROW) {
+                ember_value row = ember_make_array(vm, columns);
+                if (row.type != EMBER_VAL_ARRAY) break;
+                array_push(AS_ARRAY(rows), row);
+                for (int i = 0; i < columns; i++) {
+                    array_push(AS_ARRAY(row), column_value(vm, stmt, i));
+                }
+            }
+            vm->stack_top--;
+            if (step == SQLITE_DONE) result = rows;
+        }
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return result;
+}
+
+// ============================================================================
+// STATEMENT CACHE
+// ============================================================================
+
+static uint32_t sql_hash(const char* sql, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)sql[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool only_space(const char* text, const char* end) {
+    while (text < end && (isspace((unsigned char)*text) || *text == ';')) text++;
+    return text >= end;
+}
+
+static void statements_free(db_connection* connection) {
+    for (int i = 0; i < connection->statement_count; i++) {
+        sqlite3_finalize(connection->statements[i].stmt);
+        free(connection->statements[i].sql);
+    }
+    free(connection->statements);
+    connection->statements = NULL;
+    connection->statement_count = 0;
+}
+
+// The connection's prepared statement for sql, preparing and caching it on
+// a miss; NULL with *more set when sql holds more than one statement, NULL
+// alone when it does not compile
+static sqlite3_stmt* statement_get(db_connection* connection, const char* sql, size_t length, bool* more) {
+    *more = false;
+    uint32_t hash = sql_hash(sql, length);
+    for (int i = 0; i < connection->statement_count; i++) {
+        db_statement* entry = &connection->statements[i];
+        if (entry->hash == hash && entry->length == length && memcmp(entry->sql, sql, length) == 0) {
+            entry->used = ++connection->tick;
+            __atomic_add_fetch(&db.statement_hits, 1, __ATOMIC_RELAXED);
+            return entry->stmt;
+        }
+    }
+    __atomic_add_fetch(&db.statement_misses, 1, __ATOMIC_RELAXED);
+
+    sqlite3_stmt* stmt = NULL;
+    const char* tail = NULL;
+    if (length > INT32_MAX ||
+        sqlite3_prepare_v3(connection->db, sql, (int)length, SQLITE_PREPARE_PERSISTENT, &stmt, &tail) != SQLITE_OK) {
+        return NULL;
+    }
+    if (tail && !only_space(tail, sql + length)) {
+        sqlite3_finalize(stmt);
+        *more = true;
+        return NULL;
+    }
+    if (!stmt) return NULL;  // Only whitespace or comments
+
+    if (connection->statement_capacity <= 0) return stmt;  // Caching is off: the caller finalizes
+    db_statement* entry;
+    if (connection->statement_count < connection->statement_capacity) {
+        if (!connection->statements) {
+            connection->statements = calloc((size_t)connection->statement_capacity, sizeof(db_statement));
+            if (!connection->statements) return stmt;
+        }
+        entry = &connection->statements[connection->statement_count++];
+    } else {
+        entry = &connection->statements[0];
+        for (int i = 1; i < connection->statement_count; i++) {
+            if (connection->statements[i].used < entry->used) entry = &connection->statements[i];
+        }
+        sqlite3_finalize(entry->stmt);
+        free(entry->sql);
+    }
+    entry->sql = malloc(length + 1);
+    if (!entry->sql) {
+        // Leave the slot empty-handed rather than dangling
+        *entry = connection->statements[--connection->statement_count];
+        return stmt;
+    }
+    memcpy(entry->sql, sql, length);
+    entry->sql[length] = '\0';
+    entry->length = length;
+    entry->hash = hash;
+    entry->used = ++connection->tick;
+    entry->stmt = stmt;
+    return stmt;
+}
+
+static bool statement_cached(db_connection* connection, sqlite3_stmt* stmt) {
+    for (int i = 0; i < connection->statement_count; i++) {
+        if (connection->statements[i].stmt == stmt) return true;
+    }
+    return false;
+}
+
+// Runs sql with params on connection: rows, a change count or nil
+static ember_value connection_query(ember_vm* vm, db_connection* connection, const char* sql, size_t length,
+                                    ember_value params) {
+    bool more;
+    sqlite3_stmt* stmt = statement_get(connection, sql, length, &more);
+    if (stmt) {
+        ember_value result = bind_params(stmt, params) == SQLITE_OK ? statement_run(vm, stmt) : ember_make_nil();
+        if (!statement_cached(connection, stmt)) {
+            sqlite3_finalize(stmt);
+        } else if (result.type == EMBER_VAL_NIL) {
+            sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+        }
+        return result;
+    }
+    if (!more || params.type != EMBER_VAL_NIL) return ember_make_nil();
+
+    // A script: each statement in turn, uncached; the last one's result
+    ember_value result = ember_make_nil();
+    const char* end = sql + length;
+    while (sql < end && !only_space(sql, end)) {
+        const char* tail = NULL;
+        if (sqlite3_prepare_v2(connection->db, sql, (int)(end - sql), &stmt, &tail) != SQLITE_OK) {
+            return ember_make_nil();
+        }
+        if (stmt) {
+            result = statement_run(vm, stmt);
+            sqlite3_finalize(stmt);
+            if (result.type == EMBER_VAL_NIL) return result;
+        }
+        sql = tail ? tail : end;
+    }
+    return result;
+}
+
+static bool connection_exec(ember_vm* vm, db_connection* connection, const char* sql) {
+    return connection_query(vm, connection, sql, strlen(sql), ember_make_nil()).type != EMBER_VAL_NIL;
+}
+
+// ============================================================================
+// POOLS AND HANDLES
+// ============================================================================
+
+static db_pool* pool_find(const char* path) {
+    for (db_pool* pool = db.pools; pool; pool = pool->next) {
+        if (strcmp(pool->path, path) == 0) return pool;
+    }
+    db_pool* pool = calloc(1, sizeof(db_pool));
+    if (!pool) return NULL;
+    pool->path = strdup(path);
+    if (!pool->path) {
+        free(pool);
+        return NULL;
+    }
+    pool->next = db.pools;
+    db.pools = pool;
+    return pool;
+}
+
+static db_connection* connection_open(db_pool* pool) {
+    db_connection* connection = calloc(1, sizeof(db_connection));
+    if (!connection) return NULL;
+    // One VM uses a connection at a time, so SQLite's own mutexes are not needed
+    int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_URI;
+    if (sqlite3_open_v2(pool->path, &connection->db, flags, NULL) != SQLITE_OK) {
+        sqlite3_close(connection->db);
+        free(connection);
+        return NULL;
+    }
+    sqlite3_busy_timeout(connection->db, DB_BUSY_TIMEOUT_MS);
+    connection->pool = pool;
+    connection->statement_capacity = __atomic_load_n(&db.statement_capacity, __ATOMIC_RELAXED);
+    return connection;
+}
+
+static void connection_close(db_connection* connection) {
+    statements_free(connection);
+    sqlite3_close(connection->db);
+    free(connection);
+}
+
+// A free handle slot for connection, with db.lock held; -1 if all are taken
+static int handle_alloc(db_connection* connection, ember_vm* vm) {
+    for (int n = 0; n < DB_MAX_HANDLES; n++) {
+        int index = (db.handle_cursor + n) % DB_MAX_HANDLES;
+        if (!db.handles[index].connection) {
+            db.handles[index].connection = connection;
+            db.handles[index].owner = vm;
+            db.handle_cursor = (index + 1) % DB_MAX_HANDLES;
+            __atomic_add_fetch(&db.handle_count, 1, __ATOMIC_RELAXED);
+            return index;
+        }
+    }
+    return -1;
+}
+
+static double handle_number(int index) {
+    return (double)db.handles[index].generation * DB_MAX_HANDLES + index + 1;
+}
+
+// The connection vm holds under handle, or NULL
+static db_connection* handle_lookup(ember_vm* vm, ember_value handle, int* index_out) {
+    if (handle.type != EMBER_VAL_NUMBER) return NULL;
+    double number = handle.as.number_val;
+    if (!(number >= 1 && number <= 9007199254740992.0) || number != (double)(int64_t)number) return NULL;
+    int64_t id = (int64_t)number - 1;
+    int index = (int)(id % DB_MAX_HANDLES);
+    pthread_mutex_lock(&db.lock);
+    db_handle* slot = &db.handles[index];
+    db_connection* connection = slot->owner == vm && (int64_t)slot->generation == id / DB_MAX_HANDLES ?
+                                slot->connection : NULL;
+    pthread_mutex_unlock(&db.lock);
+    if (connection && index_out) *index_out = index;
+    return connection;
+}
+
+// Gives a checked-out connection back to its pool, first rolling back a
+// transaction left open; closes it instead if the pool is over its limit
+static void connection_release(ember_vm* vm, int index, db_connection* connection) {
+    if (!sqlite3_get_autocommit(connection->db)) connection_exec(vm, connection, "ROLLBACK");
+    pthread_mutex_lock(&db.lock);
+    db.handles[index].connection = NULL;
+    db.handles[index].owner = NULL;
+    db.handles[index].generation++;
+    __atomic_sub_fetch(&db.handle_count, 1, __ATOMIC_RELAXED);
+    db_pool* pool = connection->pool;
+    bool close = pool->open_count > db.max_connections;
+    if (close) {
+        pool->open_count--;
+    } else {
+        connection->next_idle = pool->idle;
+        pool->idle = connection;
+        pool->idle_count++;
+    }
+    pthread_cond_broadcast(&db.released);
+    pthread_mutex_unlock(&db.lock);
+    if (close) connection_close(connection);
+}
+
+void database_release_vm(ember_vm* vm) {
+    if (!vm || __atomic_load_n(&db.handle_count, __ATOMIC_RELAXED) == 0) return;
+    for (int index = 0; index < DB_MAX_HANDLES; index++) {
+        pthread_mutex_lock(&db.lock);
+        db_connection* connection = db.handles[index].owner == vm ? db.handles[index].connection : NULL;
+        pthread_mutex_unlock(&db.lock);
+        if (connection) connection_release(vm, index, connection);
+    }
+}
+
+int ember_db_configure(int max_connections, int statement_cache) {
+    if (max_connections < 1 || statement_cache < 0) return EMBER_ERROR_INVALID_PARAMETER;
+    pthread_mutex_lock(&db.lock);
+    db.max_connections = max_connections;
+    __atomic_store_n(&db.statement_capacity, statement_cache, __ATOMIC_RELAXED);
+    pthread_cond_broadcast(&db.released);
+    pthread_mutex_unlock(&db.lock);
+    return EMBER_SUCCESS;
+}
+
+// ============================================================================
+// NATIVES
+// ============================================================================
+
+// db_connect(path): a handle to a pooled connection to the SQLite database
+// at path, or nil if none could be opened or freed up in time
+ember_value ember_native_db_connect(ember_vm* vm, int argc, ember_value* argv) {
+    size_t length;
+    const char* bytes = argc == 1 ? string_bytes(argv[0], &length) : NULL;
+    char path[DB_MAX_PATH];
+    if (!bytes || length == 0 || length >= sizeof(path) || memchr(bytes, '\0', length)) return ember_make_nil();
+    memcpy(path, bytes, length);
+    path[length] = '\0';
+
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += DB_CONNECT_WAIT_MS / 1000;
+    until.tv_nsec += (DB_CONNECT_WAIT_MS % 1000) * 1000000L;
+    if (until.tv_nsec >= 1000000000L) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&db.lock);
+    db_pool* pool = pool_find(path);
+    while (pool && !pool->idle && pool->open_count >= db.max_connections) {
+        if (pthread_cond_timedwait(&db.released, &db.lock, &until) == ETIMEDOUT) pool = NULL;
+    }
+    if (!pool) {
+        pthread_mutex_unlock(&db.lock);
+        return ember_make_nil();
+    }
+    db_connection* connection = pool->idle;
+    if (connection) {
+        pool->idle = connection->next_idle;
+        pool->idle_count--;
+        db.reused++;
+    } else {
+        // Opened outside the lock; the slot is held meanwhile
+        pool->open_count++;
+        pthread_mutex_unlock(&db.lock);
+        connection = connection_open(pool);
+        pthread_mutex_lock(&db.lock);
+        if (!connection) {
+            pool->open_count--;
+            pthread_cond_broadcast(&db.released);
+            pthread_mutex_unlock(&db.lock);
+            return ember_make_nil();
+        }
+        db.opened++;
+    }
+    connection->next_idle = NULL;
+    int index = handle_alloc(connection, vm);
+    if (index < 0) {
+        connection->next_idle = pool->idle;
+        pool->idle = connection;
+        pool->idle_count++;
+        pthread_mutex_unlock(&db.lock);
+        return ember_make_nil();
+    }
+    double number = handle_number(index);
+    pthread_mutex_unlock(&db.lock);
+    return ember_make_number(number);
+}
+
+// db_disconnect(handle): the connection goes back to its pool, open; true,
+// or nil for a handle this VM does not hold
+ember_value ember_native_db_disconnect(ember_vm* vm, int argc, ember_value* argv) {
+    int index;
+    db_connection* connection = argc == 1 ? handle_lookup(vm, argv[0], &index) : NULL;
+    if (!connection) return ember_make_nil();
+    connection_release(vm, index, connection);
+    return ember_make_bool(true);
+}
+
+// db_query(handle, sql [, params]): rows as arrays for a query, the number
+// of changed rows otherwise; nil on an error (see db_error). params fill the
+// ? placeholders in order. Text holding several statements runs them all
+// (without params) and gives the last one's result
+ember_value ember_native_db_query(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc < 2 || argc > 3) return ember_make_nil();
+    db_connection* connection = handle_lookup(vm, argv[0], NULL);
+    size_t length;
+    const char* sql = string_bytes(argv[1], &length);
+    if (!connection || !sql) return ember_make_nil();
+    return connection_query(vm, connection, sql, length, argc == 3 ? argv[2] : ember_make_nil());
+}
+
+// db_batch(handle, sql, rows): runs sql once for each params array in rows,
+// in one transaction (or the one already open); the total number of changed
+// rows, or nil after rolling the batch back on an error
+ember_value ember_native_db_batch(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 3 || argv[2].type != EMBER_VAL_ARRAY) return ember_make_nil();
+    db_connection* connection = handle_lookup(vm, argv[0], NULL);
+    size_t length;
+    const char* sql = string_bytes(argv[1], &length);
+    if (!connection || !sql) return ember_make_nil();
+    bool more;
+    sqlite3_stmt* stmt = statement_get(connection, sql, length, &more);
+    if (!stmt) return ember_make_nil();
+    bool cached = statement_cached(connection, stmt);
+
+    bool own_transaction = sqlite3_get_autocommit(connection->db) != 0;
+    if (own_transaction && !connection_exec(vm, connection, "BEGIN")) {
+        if (!cached) sqlite3_finalize(stmt);
+        return ember_make_nil();
+    }
+    ember_array* rows = AS_ARRAY(argv[2]);
+    double changes = 0;
+    bool ok = true;
+    for (int i = 0; ok && i < rows->length; i++) {
+        int step = bind_params(stmt, rows->elements[i]);
+        if (step == SQLITE_OK) {
+            while ((step = sqlite3_step(stmt)) == SQLITE_ROW) {
+            }
+        }
+        ok = step == SQLITE_DONE;
+        if (ok) changes += sqlite3_changes(connection->db);
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    }
+    if (!cached) sqlite3_finalize(stmt);
+    if (own_transaction) {
+        if (ok) ok = connection_exec(vm, connection, "COMMIT");
+        if (!ok) connection_exec(vm, connection, "ROLLBACK");
+    }
+    return ok ? ember_make_number(changes) : ember_make_nil();
+}
+
+static ember_value transaction_control(ember_vm* vm, int argc, ember_value* argv, const char* sql) {
+    db_connection* connection = argc == 1 ? handle_lookup(vm, argv[0], NULL) : NULL;
+    if (!connection) return ember_make_nil();
+    return ember_make_bool(connection_exec(vm, connection, sql));
+}
+
+// db_begin(handle) / db_commit(handle) / db_rollback(handle): true, false
+// if SQLite refused (see db_error), nil for a bad handle
+ember_value ember_native_db_begin(ember_vm* vm, int argc, ember_value* argv) {
+    return transaction_control(vm, argc, argv, "BEGIN");
+}
+
+ember_value ember_native_db_commit(ember_vm* vm, int argc, ember_value* argv) {
+    return transaction_control(vm, argc, argv, "COMMIT");
+}
+
+ember_value ember_native_db_rollback(ember_vm* vm, int argc, ember_value* argv) {
+    return transaction_control(vm, argc, argv, "ROLLBACK");
+}
+
+// db_error(handle): the connection's last error message, or nil
+ember_value ember_native_db_error(ember_vm* vm, int argc, ember_value* argv) {
+    db_connection* connection = argc == 1 ? handle_lookup(vm, argv[0], NULL) : NULL;
+    if (!connection || sqlite3_errcode(connection->db) == SQLITE_OK) return ember_make_nil();
+    return ember_make_string_gc(vm, sqlite3_errmsg(connection->db));
+}
+
+static void stats_set(ember_vm* vm, ember_hash_map* map, const char* key, double value) {
+    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, key), ember_make_number(value));
+}
+
+// db_pool_stats(): connections and statement cache use over every pool
+ember_value ember_native_db_pool_stats(ember_vm* vm, int argc, ember_value* argv) {
+    (void)argv;
+    if (argc != 0 || vm->stack_top >= EMBER_STACK_MAX) return ember_make_nil();
+    pthread_mutex_lock(&db.lock);
+    int databases = 0;
+    int total = 0;
+    int idle = 0;
+    for (db_pool* pool = db.pools; pool; pool = pool->next) {
+        databases++;
+        total += pool->open_count;
+        idle += pool->idle_count;
+    }
+    double opened = (double)db.opened;
+    double reused = (double)db.reused;
+    int max_connections = db.max_connections;
+    pthread_mutex_unlock(&db.lock);
+
+    ember_value stats = ember_make_hash_map(vm, 16);
+    if (stats.type != EMBER_VAL_HASH_MAP) return ember_make_nil();
+    vm->stack[vm->stack_top++] = stats;
+    ember_hash_map* map = AS_HASH_MAP(stats);
+    stats_set(vm, map, "databases", databases);
+    stats_set(vm, map, "total_connections", total);
+    stats_set(vm, map, "active_connections", total - idle);
+    stats_set(vm, map, "idle_connections", idle);
+    stats_set(vm, map, "max_connections", max_connections);
+    stats_set(vm, map, "connections_opened", opened);
+    stats_set(vm, map, "connections_reused", reused);
+    stats_set(vm, map, "statement_hits", (double)__atomic_load_n(&db.statement_hits, __ATOMIC_RELAXED));
+    stats_set(vm, map, "statement_misses", (double)__atomic_load_n(&db.statement_misses, __ATOMIC_RELAXED));
+    vm->stack_top--;
+    return stats;
+}
+
+#else
+
+// Without SQLite there are no handles to give back
+void database_release_vm(ember_vm* vm) {
+    (void)vm;
+}
+
+int ember_db_configure(int max_connections, int statement_cache) {
+    (void)max_connections;
+    (void)statement_cache;
+    return EMBER_ERROR_OPERATION_FAILED;
+}
+
+#endif // HAVE_SQLITE
@@ -0,0 +1,1027 @@
+/**
+ * Date and time natives: datetime_now / datetime_timestamp / datetime_parse /
+ * datetime_format / datetime_add / datetime_diff / datetime_to_utc /
+ * datetime_from_utc and the field readers datetime_year .. datetime_yearday
+ *
+ * Times are seconds since the Unix epoch, as numbers, from year 1 to 9999.
+ * Calendar fields come from integer day arithmetic rather than gmtime_r /
+ * localtime_r, so no call touches the process's TZ state or libc's
+ * timezone lock. A zone is "UTC", "local", an IANA name ("Europe/Paris")
+ * or a POSIX TZ rule ("EST5EDT,M3.2.0,M11.1.0"). Each is read once per
+ * process and kept: the transitions from its tzdata file, and the file's
+ * footer rule for times after the last one. "local" is $TZ, or
+ * /etc/localtime, as it was when first used.
+ *
+ * datetime_format compiles its strftime-style pattern once into a list of
+ * fields, kept in the VM's cache (vm->datetime_cache) with its zone and the
+ * text of the last second it formatted, so a log line or Date header
+ * stamped many times a second is a copy of that text.
+ */
+
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../vm.h"
+#include "value/value.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DATETIME_MIN (-62135596800LL)        // 0001-01-01T00:00:00Z
+#define DATETIME_MAX 253402300799LL          // 9999-12-31T23:59:59Z
+#define DATETIME_CACHE_SIZE 16
+#define DATETIME_MAX_PATTERN 256
+#define DATETIME_DEFAULT_PATTERN "%Y-%m-%dT%H:%M:%SZ"
+#define ZONE_MAX_FILE (1 << 20)
+#define ZONE_MAX_NAMES 512                   // Past this many zones, unknown names are not remembered
+
+static const char* const weekday_names[] = {"Sunday", "Monday", "Tuesday", "Wednesday",
+                                            "Thursday", "Friday", "Saturday"};
+static const char* const month_names[] = {"January", "February", "March", "April", "May", "June", "July",
+                                          "August", "September", "October", "November", "December"};
+
+// ============================================================================
+// CALENDAR
+// ============================================================================
+
+// Days since 1970-01-01 of a proleptic Gregorian date, and back
+static int64_t days_from_civil(int64_t year, int month, int day) {
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t year_of_era = year - era * 400;
+    int64_t day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+static void civil_from_days(int64_t days, int64_t* year, int* month, int* day) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t day_of_era = days - era * 146097;
+    int64_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    int64_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    int64_t shifted_month = (5 * day_of_year + 2) / 153;
+    *day = (int)(day_of_year - (153 * shifted_month + 2) / 5 + 1);
+    *month = (int)(shifted_month < 10 ? shifted_month + 3 : shifted_month - 9);
+    *year = year_of_era + era * 400 + (*month <= 2);
+}
+
+static int is_leap_year(int64_t year) {
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+static int days_in_month(int64_t year, int month) {
+    static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return month == 2 && is_leap_year(year) ? 29 : days[month - 1];
+}
+
+static int64_t floor_div(int64_t a, int64_t b) {
+    return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+// ============================================================================
+// ZONES
+// ============================================================================
+
+typedef struct {
+    int32_t offset;                          // Seconds east of UTC
+    int is_dst;
+    char abbr[8];
+} zone_type;
+
+// A POSIX TZ rule date: Mm.w.d, Jn (no Feb 29) or n (from 0)
+typedef struct {
+    char kind;
+    int month, week, day;
+    int32_t time;                            // Seconds after local midnight
+} zone_rule_date;
+
+typedef struct {
+    zone_type std, dst;
+    int has_dst;
+    zone_rule_date start, end;
+} zone_rule;
+
+typedef struct ember_zone {
+    char* name;
+    int valid;                               // Found; lookups of unknown names are remembered too
+    int64_t* transitions;                    // UTC seconds, ascending
+    uint8_t* transition_types;
+    int transition_count;
+    zone_type* types;
+    int type_count;
+    int has_rule;                            // rule applies before and after the transitions
+    zone_rule rule;
+    struct ember_zone* next;
+} ember_zone;
+
+static ember_zone utc_zone = {
+    .name = "UTC", .valid = 1, .has_rule = 1, .rule = {.std = {0, 0, "UTC"}},
+};
+
+static pthread_mutex_t zone_lock = PTHREAD_MUTEX_INITIALIZER;
+static ember_zone* zone_list;
+static int zone_list_count;
+static pthread_once_t local_zone_once = PTHREAD_ONCE_INIT;
+static ember_zone* local_zone;
+
+// Reads an abbreviation, alphabetic or <quoted>, of at least 3 characters
+static const char* rule_name(const char* at, char* abbr) {
+    int length = 0;
+    if (*at == '<') {
+        at++;
+        while (*at && *at != '>') {
+            if (length < 7) abbr[length] = *at;
+            length++;
+            at++;
+        }
+        if (*at++ != '>') return NULL;
+    } else {
+        while ((*at >= 'a' && *at <= 'z') || (*at >= 'A' && *at <= 'Z')) {
+            if (length < 7) abbr[length] = *at;
+            length++;
+            at++;
+        }
+    }
+    if (length < 3) return NULL;
+    abbr[length < 7 ? length : 7] = '\0';
+    return at;
+}
+
+// [+-]hh[:mm[:ss]], hours up to 167
+static const char* rule_clock(const char* at, int32_t* seconds) {
+    int sign = 1;
+    if (*at == '+' || *at == '-') sign = *at++ == '-' ? -1 : 1;
+    if (*at < '0' || *at > '9') return NULL;
+    int32_t parts[3] = {0, 0, 0};
+    for (int part = 0; part < 3; part++) {
+        if (part > 0) {
+            if (*at != ':') break;
+            at++;
+        }
+        if (*at < '0' || *at > '9') return NULL;
+        int digits = 0;
+        while (*at >= '0' && *at <= '9' && digits < 3) {
+            parts[part] = parts[part] * 10 + (*at++ - '0');
+            digits++;
+        }
+    }
+    if (parts[0] > 167 || parts[1] > 59 || parts[2] > 59) return NULL;
+    *seconds = sign * (parts[0] * 3600 + parts[1] * 60 + parts[2]);
+    return at;
+}
+
+static const char* rule_number(const char* at, int* value, int min, int max) {
+    if (*at < '0' || *at > '9') return NULL;
+    int number = 0;
+    while (*at >= '0' && *at <= '9' && number <= max) number = number * 10 + (*at++ - '0');
+    if (number < min || number > max) return NULL;
+    *value = number;
+    return at;
+}
+
+static const char* rule_date(const char* at, zone_rule_date* date) {
+    date->time = 7200;
+    if (*at == 'M') {
+        date->kind = 'M';
+        if (!(at = rule_number(at + 1, &date->month, 1, 12)) || *at++ != '.' ||
+            !(at = rule_number(at, &date->week, 1, 5)) || *at++ != '.' ||
+            !(at = rule_number(at, &date->day, 0, 6))) {
+            return NULL;
+        }
+    } else if (*at == 'J') {
+        date->kind = 'J';
+        if (!(at = rule_number(at + 1, &date->day, 1, 365))) return NULL;
+    } else {
+        date->kind = 'n';
+        if (!(at = rule_number(at, &date->day, 0, 365))) return NULL;
+    }
+    if (*at == '/' && !(at = rule_clock(at + 1, &date->time))) return NULL;
+    return at;
+}
+
+// std offset [dst [offset] [,start[/time],end[/time]]]. POSIX offsets count
+// west of UTC; they are stored east
+static int rule_parse(const char* text, zone_rule* rule) {
+    memset(rule, 0, sizeof(*rule));
+    int32_t offset;
+    const char* at = rule_name(text, rule->std.abbr);
+    if (!at || !(at = rule_clock(at, &offset))) return 0;
+    rule->std.offset = -offset;
+    if (!*at) return 1;
+    if (!(at = rule_name(at, rule->dst.abbr))) return 0;
+    rule->has_dst = 1;
+    rule->dst.is_dst = 1;
+    rule->dst.offset = rule->std.offset + 3600;
+    if (*at && *at != ',') {
+        if (!(at = rule_clock(at, &offset))) return 0;
+        rule->dst.offset = -offset;
+    }
+    if (!*at) {
+        // No dates: the US rule, as glibc assumes
+        rule->start = (zone_rule_date){'M', 3, 2, 0, 7200};
+        rule->end = (zone_rule_date){'M', 11, 1, 0, 7200};
+        return 1;
+    }
+    if (*at++ != ',' || !(at = rule_date(at, &rule->start)) || *at++ != ',' ||
+        !(at = rule_date(at, &rule->end))) {
+        return 0;
+    }
+    return *at == '\0';
+}
+
+// The UTC second a rule date falls on in year, given the local offset then
+static int64_t rule_transition(const zone_rule_date* date, int64_t year, int32_t offset) {
+    int64_t days;
+    if (date->kind == 'M') {
+        int64_t first = days_from_civil(year, date->month, 1);
+        int first_weekday = (int)((first % 7 + 11) % 7);
+        int day = 1 + (date->day - first_weekday + 7) % 7 + (date->week - 1) * 7;
+        while (day > days_in_month(year, date->month)) day -= 7;
+        days = first + day - 1;
+    } else {
+        days = days_from_civil(year, 1, 1) + date->day;
+        if (date->kind == 'J') days += -1 + (is_leap_year(year) && date->day >= 60);
+    }
+    return days * 86400 + date->time - offset;
+}
+
+static const zone_type* rule_type_at(const zone_rule* rule, int64_t seconds) {
+    if (!rule->has_dst) return &rule->std;
+    int64_t year;
+    int month, day;
+    civil_from_days(floor_div(seconds + rule->std.offset, 86400), &year, &month, &day);
+    int64_t start = rule_transition(&rule->start, year, rule->std.offset);
+    int64_t end = rule_transition(&rule->end, year, rule->dst.offset);
+    int in_dst = start < end ? seconds >= start && seconds < end : !(seconds >= end && seconds < start);
+    return in_dst ? &rule->dst : &rule->std;
+}
+
+static const zone_type* zone_type_at(const ember_zone* zone, int64_t seconds) {
+    int count = zone->transition_count;
+    if (count == 0) return zone->has_rule ? rule_type_at(&zone->rule, seconds) : &zone->types[0];
+    if (seconds < zone->transitions[0]) return &zone->types[0];
+    if (seconds >= zone->transitions[count - 1] && zone->has_rule) return rule_type_at(&zone->rule, seconds);
+    // The last transition at or before seconds
+    int low = 0, high = count - 1;
+    while (low < high) {
+        int middle = low + (high - low + 1) / 2;
+        if (zone->transitions[middle] <= seconds) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return &zone->types[zone->transition_types[low]];
+}
+
+static uint32_t read_be32(const unsigned char* at) {
+    return (uint32_t)at[0] << 24 | (uint32_t)at[1] << 16 | (uint32_t)at[2] << 8 | at[3];
+}
+
+static int64_t read_be64(const unsigned char* at) {
+    return (int64_t)((uint64_t)read_be32(at) << 32 | read_be32(at + 4));
+}
+
+typedef struct {
+    uint32_t utc_count, std_count, leap_count, time_count, type_count, char_count;
+    size_t size;                             // Of the data after the header
+} tzif_header;
+
+static int tzif_read_header(const unsigned char* at, const unsigned char* end, size_t time_size,
+                            tzif_header* header) {
+    if (end - at < 44 || memcmp(at, "TZif", 4) != 0) return 0;
+    header->utc_count = read_be32(at + 20);
+    header->std_count = read_be32(at + 24);
+    header->leap_count = read_be32(at + 28);
+    header->time_count = read_be32(at + 32);
+    header->type_count = read_be32(at + 36);
+    header->char_count = read_be32(at + 40);
+    if (header->type_count == 0 || header->type_count > 256 || header->time_count > ZONE_MAX_FILE ||
+        header->char_count > ZONE_MAX_FILE || header->leap_count > ZONE_MAX_FILE ||
+        header->utc_count > 256 || header->std_count > 256) {
+        return 0;
+    }
+    header->size = header->time_count * (time_size + 1) + header->type_count * 6 + header->char_count +
+                   header->leap_count * (time_size + 4) + header->std_count + header->utc_count;
+    return (size_t)(end - at - 44) >= header->size;
+}
+
+static void zone_free(ember_zone* zone) {
+    free(zone->transitions);
+    free(zone->transition_types);
+    free(zone->types);
+    free(zone->name);
+    free(zone);
+}
+
+// A zone from the contents of a TZif file (RFC 8536). Version 2 and later
+// files are read from their 64-bit block and footer rule
+static ember_zone* zone_parse_tzif(const unsigned char* data, size_t size) {
+    const unsigned char* end = data + size;
+    tzif_header header;
+    size_t time_size = 4;
+    if (!tzif_read_header(data, end, 4, &header)) return NULL;
+    const unsigned char* at = data + 44;
+    if (data[4] >= '2') {
+        at += header.size;
+        time_size = 8;
+        if (!tzif_read_header(at, end, 8, &header)) return NULL;
+        at += 44;
+    }
+    ember_zone* zone = calloc(1, sizeof(ember_zone));
+    if (!zone) return NULL;
+    zone->transition_count = (int)header.time_count;
+    zone->type_count = (int)header.type_count;
+    zone->transitions = malloc(sizeof(int64_t) * (header.time_count + 1));
+    zone->transition_types = malloc(header.time_count + 1);
+    zone->types = calloc(header.type_count, sizeof(zone_type));
+    if (!zone->transitions || !zone->transition_types || !zone->types) goto fail;
+
+    for (uint32_t i = 0; i < header.time_count; i++) {
+        zone->transitions[i] = time_size == 8 ? read_be64(at + i * 8) : (int32_t)read_be32(at + i * 4);
+        if (i > 0 && zone->transitions[i] <= zone->transitions[i - 1]) goto fail;
+    }
+    at += header.time_count * time_size;
+    for (uint32_t i = 0; i < header.time_count; i++) {
+        if (at[i] >= header.type_count) goto fail;
+        zone->transition_types[i] = at[i];
+    }
+    at += header.time_count;
+    const unsigned char* chars = at + header.type_count * 6;
+    for (uint32_t i = 0; i < header.type_count; i++, at += 6) {
+        zone_type* type = &zone->types[i];
+        type->offset = (int32_t)read_be32(at);
+        type->is_dst = at[4] != 0;
+        if (at[5] >= header.char_count || type->offset < -89999 || type->offset > 93599) goto fail;
+        size_t length = strnlen((const char*)chars + at[5], header.char_count - at[5]);
+        if (length > 7) length = 7;
+        memcpy(type->abbr, chars + at[5], length);
+    }
+    at = chars + header.char_count + header.leap_count * (time_size + 4) + header.std_count + header.utc_count;
+
+    // The footer, "\n<rule>\n", covers times after the last transition
+    if (time_size == 8 && at < end && *at == '\n') {
+        const unsigned char* close = memchr(at + 1, '\n', (size_t)(end - at - 1));
+        size_t length = close ? (size_t)(close - at - 1) : 0;
+        if (length > 0 && length < 128) {
+            char text[128];
+            memcpy(text, at + 1, length);
+            text[length] = '\0';
+            zone->has_rule = rule_parse(text, &zone->rule);
+        }
+    }
+    zone->valid = 1;
+    return zone;
+
+fail:
+    zone_free(zone);
+    return NULL;
+}
+
+static ember_zone* zone_load_file(const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    ember_zone* zone = NULL;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && st.st_size <= ZONE_MAX_FILE) {
+        unsigned char* data = malloc((size_t)st.st_size);
+        size_t length = 0;
+        while (data && length < (size_t)st.st_size) {
+            ssize_t n = read(fd, data + length, (size_t)st.st_size - length);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            length += (size_t)n;
+        }
+        if (data && length == (size_t)st.st_size) zone = zone_parse_tzif(data, length);
+        free(data);
+    }
+    close(fd);
+    return zone;
+}
+
+// An IANA name under $TZDIR (or /usr/share/zoneinfo), else a POSIX rule
+static ember_zone* zone_load(const char* name) {
+    int safe = name[0] != '\0' && name[0] != '/' && strstr(name, "..") == NULL;
+    for (const char* at = name; *at && safe; at++) {
+        safe = (*at >= 'a' && *at <= 'z') || (*at >= 'A' && *at <= 'Z') || (*at >= '0' && *at <= '9') ||
+               *at == '/' || *at == '_' || *at == '-' || *at == '+';
+    }
+    if (safe) {
+        const char* dir = getenv("TZDIR");
+        char path[4096];
+        int length = snprintf(path, sizeof(path), "%s/%s", dir && *dir ? dir : "/usr/share/zoneinfo", name);
+        if (length > 0 && (size_t)length < sizeof(path)) {
+            ember_zone* zone = zone_load_file(path);
+            if (zone) return zone;
+        }
+    }
+    ember_zone* zone = calloc(1, sizeof(ember_zone));
+    if (!zone) return NULL;
+    zone->valid = strlen(name) < 128 && rule_parse(name, &zone->rule);
+    zone->has_rule = zone->valid;
+    return zone;
+}
+
+static void load_local_zone(void) {
+    const char* tz = getenv("TZ");
+    ember_zone* zone = NULL;
+    if (!tz) {
+        zone = zone_load_file("/etc/localtime");
+    } else if (*tz) {
+        if (*tz == ':') tz++;
+        zone = tz[0] == '/' ? zone_load_file(tz) : zone_load(tz);
+    }
+    if (zone && !zone->valid) {
+        zone_free(zone);
+        zone = NULL;
+    }
+    local_zone = zone ? zone : &utc_zone;
+}
+
+// The zone named by name, read the first time any VM asks for it; NULL if
+// there is no such zone
+static const ember_zone* zone_find(const char* name) {
+    if (strcmp(name, "UTC") == 0 || strcmp(name, "Z") == 0) return &utc_zone;
+    if (strcmp(name, "local") == 0) {
+        pthread_once(&local_zone_once, load_local_zone);
+        return local_zone;
+    }
+    pthread_mutex_lock(&zone_lock);
+    ember_zone* zone = zone_list;
+    while (zone && strcmp(zone->name, name) != 0) zone = zone->next;
+    if (!zone) {
+        zone = zone_load(name);
+        if (zone) zone->name = strdup(name);
+        // Zones found are kept for good, since patterns point at them; past
+        // ZONE_MAX_NAMES, names that are not zones are no longer remembered
+        if (zone && zone->name && (zone->valid || zone_list_count < ZONE_MAX_NAMES)) {
+            zone->next = zone_list;
+            zone_list = zone;
+            zone_list_count++;
+        } else if (zone) {
+            zone_free(zone);
+            zone = NULL;
+        }
+    }
+    pthread_mutex_unlock(&zone_lock);
+    return zone && zone->valid ? zone : NULL;
+}
+
+// Local wall-clock seconds to UTC: the offset in force at the result. A
+// wall time skipped by a change reads with the offset from before it
+static int64_t zone_wall_to_utc(const ember_zone* zone, int64_t wall) {
+    int32_t guess = zone_type_at(zone, wall)->offset;
+    int64_t first = wall - guess;
+    int32_t actual = zone_type_at(zone, first)->offset;
+    if (actual == guess) return first;
+    int64_t second = wall - actual;
+    return zone_type_at(zone, second)->offset == actual ? second : first;
+}
+
+// ============================================================================
+// ARGUMENTS AND FIELDS
+// ============================================================================
+
+typedef struct {
+    int64_t seconds;                         // UTC
+    int milliseconds;
+    int64_t year;
+    int month, day, hour, minute, second;
+    int weekday;                             // 0 = Sunday
+    int yearday;                             // 1 = January 1
+    const zone_type* type;
+} datetime_fields;
+
+static int time_arg(ember_value value, double* out) {
+    if (value.type != EMBER_VAL_NUMBER) return 0;
+    double number = value.as.number_val;
+    if (!(number >= (double)DATETIME_MIN && number < (double)DATETIME_MAX + 1)) return 0;
+    *out = number;
+    return 1;
+}
+
+// The zone named by argv[index], or fallback when there is no such argument
+static const ember_zone* zone_arg(int argc, ember_value* argv, int index, const char* fallback) {
+    if (index >= argc || argv[index].type == EMBER_VAL_NIL) return zone_find(fallback);
+    if (argv[index].type != EMBER_VAL_STRING) return NULL;
+    return zone_find(ember_string_flatten(AS_STRING(argv[index])));
+}
+
+static void datetime_split(double time, const ember_zone* zone, datetime_fields* fields) {
+    double whole = floor(time);
+    fields->seconds = (int64_t)whole;
+    fields->milliseconds = (int)((time - whole) * 1000.0);
+    if (fields->milliseconds > 999) fields->milliseconds = 999;
+    fields->type = zone_type_at(zone, fields->seconds);
+    int64_t local = fields->seconds + fields->type->offset;
+    int64_t days = floor_div(local, 86400);
+    int64_t clock = local - days * 86400;
+    civil_from_days(days, &fields->year, &fields->month, &fields->day);
+    fields->hour = (int)(clock / 3600);
+    fields->minute = (int)(clock / 60 % 60);
+    fields->second = (int)(clock % 60);
+    fields->weekday = (int)((days % 7 + 11) % 7);
+    fields->yearday = (int)(days - days_from_civil(fields->year, 1, 1)) + 1;
+}
+
+static ember_value number_or_nil(double number) {
+    if (!(number >= (double)DATETIME_MIN && number < (double)DATETIME_MAX + 1)) return ember_make_nil();
+    return ember_make_number(number);
+}
+
+static ember_value string_value(ember_string* string) {
+    if (!string) return ember_make_nil();
+    ember_value value;
+    value.type = EMBER_VAL_STRING;
+    value.as.obj_val = (ember_object*)string;
+    return value;
+}
+
+// ============================================================================
+// FORMAT PATTERNS AND CACHE
+// ============================================================================
+
+typedef struct {
+    char conversion;                         // 0 for literal text
+    uint16_t start, length;                  // Literal text in the pattern's literals
+} datetime_op;
+
+typedef struct {
+    char* key;                               // pattern, '\0', zone name
+    size_t key_length;
+    const ember_zone* zone;
+    datetime_op* ops;
+    int op_count, op_capacity;
+    char* literals;
+    size_t literal_length;
+    size_t max_length;                       // Longest text the pattern can produce
+    int subsecond;                           // Has %L, so the last second's text can't be reused
+    int has_last;
+    int64_t last_second;
+    size_t last_length;
+    char* last_text;                         // max_length + 1 bytes
+    uint64_t last_used;
+} datetime_pattern;
+
+typedef struct ember_datetime_cache {
+    datetime_pattern* entries[DATETIME_CACHE_SIZE];
+    int count;
+    uint64_t clock;
+} ember_datetime_cache;
+
+static void datetime_pattern_free(datetime_pattern* pattern) {
+    if (!pattern) return;
+    free(pattern->key);
+    free(pattern->ops);
+    free(pattern->literals);
+    free(pattern->last_text);
+    free(pattern);
+}
+
+static int pattern_emit(datetime_pattern* pattern, char conversion, const char* text, size_t length) {
+    datetime_op* last = pattern->op_count ? &pattern->ops[pattern->op_count - 1] : NULL;
+    if (conversion == 0 && last && last->conversion == 0) {
+        // Literal text after literal text extends it
+        memcpy(pattern->literals + pattern->literal_length, text, length);
+        pattern->literal_length += length;
+        last->length = (uint16_t)(last->length + length);
+        pattern->max_length += length;
+        return 1;
+    }
+    if (pattern->op_count == pattern->op_capacity) {
+        int capacity = pattern->op_capacity ? pattern->op_capacity * 2 : 16;
+        datetime_op* ops = realloc(pattern->ops, sizeof(datetime_op) * (size_t)capacity);
+        if (!ops) return 0;
+        pattern->ops = ops;
+        pattern->op_capacity = capacity;
+    }
+    datetime_op* op = &pattern->ops[pattern->op_count++];
+    op->conversion = conversion;
+    op->start = (uint16_t)pattern->literal_length;
+    op->length = (uint16_t)length;
+    if (conversion == 0) {
+        memcpy(pattern->literals + pattern->literal_length, text, length);
+        pattern->literal_length += length;
+        pattern->max_length += length;
+        return 1;
+    }
+    // The widest each conversion writes
+    switch (conversion) {
+        case 'a': case 'b': case 'p': pattern->max_length += 3; break;
+        case 'A': case 'B': pattern->max_length += 9; break;
+        case 'Y': pattern->max_length += 5; break;
+        case 'Z': pattern->max_length += 7; break;
+        case 'z': pattern->max_length += 5; break;
+        case 's': pattern->max_length += 20; break;
+        case 'C': case 'j': case 'L': pattern->max_length += 3; break;
+        case 'u': case 'w': pattern->max_length += 1; break;
+        default: pattern->max_length += 2; break;
+    }
+    if (conversion == 'L') pattern->subsecond = 1;
+    return 1;
+}
+
+// Conversions spelled as others, as strftime does in the C locale
+static const char* pattern_expansion(char conversion) {
+    switch (conversion) {
+        case 'F': return "%Y-%m-%d";
+        case 'T': case 'X': return "%H:%M:%S";
+        case 'D': case 'x': return "%m/%d/%y";
+        case 'R': return "%H:%M";
+        case 'r': return "%I:%M:%S %p";
+        case 'c': return "%a %b %e %H:%M:%S %Y";
+        case 'h': return "%b";
+        default: return NULL;
+    }
+}
+
+static int pattern_compile_text(datetime_pattern* pattern, const char* text, size_t length) {
+    size_t run = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] != '%') continue;
+        if (i > run && !pattern_emit(pattern, 0, text + run, i - run)) return 0;
+        if (++i == length) return 0;
+        char conversion = text[i];
+        const char* expansion = pattern_expansion(conversion);
+        if (expansion) {
+            if (!pattern_compile_text(pattern, expansion, strlen(expansion))) return 0;
+        } else if (conversion == '%' || conversion == 'n' || conversion == 't') {
+            const char* literal = conversion == '%' ? "%" : conversion == 'n' ? "\n" : "\t";
+            if (!pattern_emit(pattern, 0, literal, 1)) return 0;
+        } else if (strchr("YmdHMSyeCjIlpaAbBZzsuwL", conversion)) {
+            if (!pattern_emit(pattern, conversion, NULL, 0)) return 0;
+        } else {
+            return 0;
+        }
+        run = i + 1;
+    }
+    return run == length || pattern_emit(pattern, 0, text + run, length - run);
+}
+
+static datetime_pattern* pattern_compile(const char* text, size_t length, const char* zone_name,
+                                         const ember_zone* zone) {
+    datetime_pattern* pattern = calloc(1, sizeof(datetime_pattern));
+    if (!pattern) return NULL;
+    size_t zone_length = strlen(zone_name);
+    pattern->key_length = length + 1 + zone_length;
+    pattern->key = malloc(pattern->key_length);
+    // %c, the longest expansion, adds three bytes of literal text for its two
+    pattern->literals = malloc(length * 3 + 1);
+    if (!pattern->key || !pattern->literals || !pattern_compile_text(pattern, text, length)) {
+        datetime_pattern_free(pattern);
+        return NULL;
+    }
+    memcpy(pattern->key, text, length);
+    pattern->key[length] = '\0';
+    memcpy(pattern->key + length + 1, zone_name, zone_length);
+    pattern->zone = zone;
+    pattern->last_text = malloc(pattern->max_length + 1);
+    if (!pattern->last_text) {
+        datetime_pattern_free(pattern);
+        return NULL;
+    }
+    return pattern;
+}
+
+static char* put_digits(char* out, int64_t value, int width, char pad) {
+    char digits[24];
+    int count = 0;
+    uint64_t magnitude = value < 0 ? (uint64_t)0 - (uint64_t)value : (uint64_t)value;
+    do {
+        digits[count++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0) *out++ = '-';
+    for (int i = count; i < width; i++) *out++ = pad;
+    while (count) *out++ = digits[--count];
+    return out;
+}
+
+static char* put_text(char* out, const char* text, size_t length) {
+    memcpy(out, text, length);
+    return out + length;
+}
+
+static size_t pattern_format(const datetime_pattern* pattern, const datetime_fields* fields, char* out) {
+    char* at = out;
+    for (int i = 0; i < pattern->op_count; i++) {
+        const datetime_op* op = &pattern->ops[i];
+        int hour12 = fields->hour % 12 ? fields->hour % 12 : 12;
+        switch (op->conversion) {
+            case 0: at = put_text(at, pattern->literals + op->start, op->length); break;
+            case 'Y': at = put_digits(at, fields->year, 4, '0'); break;
+            case 'C': at = put_digits(at, fields->year / 100, 2, '0'); break;
+            case 'y': at = put_digits(at, fields->year % 100, 2, '0'); break;
+            case 'm': at = put_digits(at, fields->month, 2, '0'); break;
+            case 'd': at = put_digits(at, fields->day, 2, '0'); break;
+            case 'e': at = put_digits(at, fields->day, 2, ' '); break;
+            case 'j': at = put_digits(at, fields->yearday, 3, '0'); break;
+            case 'H': at = put_digits(at, fields->hour, 2, '0'); break;
+            case 'I': at = put_digits(at, hour12, 2, '0'); break;
+            case 'l': at = put_digits(at, hour12, 2, ' '); break;
+            case 'M': at = put_digits(at, fields->minute, 2, '0'); break;
+            case 'S': at = put_digits(at, fields->second, 2, '0'); break;
+            case 'L': at = put_digits(at, fields->milliseconds, 3, '0'); break;
+            case 'p': at = put_text(at, fields->hour < 12 ? "AM" : "PM", 2); break;
+            case 'a': at = put_text(at, weekday_names[fields->weekday], 3); break;
+            case 'A': {
+                const char* name = weekday_names[fields->weekday];
+                at = put_text(at, name, strlen(name));
+                break;
+            }
+            case 'b': at = put_text(at, month_names[fields->month - 1], 3); break;
+            case 'B': {
+                const char* name = month_names[fields->month - 1];
+                at = put_text(at, name, strlen(name));
+                break;
+            }
+            case 'u': at = put_digits(at, fields->weekday ? fields->weekday : 7, 1, '0'); break;
+            case 'w': at = put_digits(at, fields->weekday, 1, '0'); break;
+            case 's': at = put_digits(at, fields->seconds, 1, '0'); break;
+            case 'Z': at = put_text(at, fields->type->abbr, strlen(fields->type->abbr)); break;
+            case 'z': {
+                int32_t offset = fields->type->offset;
+                *at++ = offset < 0 ? '-' : '+';
+                if (offset < 0) offset = -offset;
+                at = put_digits(at, offset / 3600, 2, '0');
+                at = put_digits(at, offset / 60 % 60, 2, '0');
+                break;
+            }
+            default: break;
+        }
+    }
+    return (size_t)(at - out);
+}
+
+static ember_datetime_cache* datetime_cache_for(ember_vm* vm) {
+    if (!vm->datetime_cache) {
+        vm->datetime_cache = calloc(1, sizeof(ember_datetime_cache));
+    }
+    if (vm->datetime_cache) vm->datetime_cache->clock++;
+    return vm->datetime_cache;
+}
+
+// The compiled pattern for text in zone_name, from the cache or compiled
+// into it. Owned by the cache, or by the caller (*owned set) when there is
+// no cache; NULL if the pattern is malformed or the zone unknown
+static datetime_pattern* pattern_for(ember_vm* vm, const char* text, size_t length, const char* zone_name,
+                                     int* owned) {
+    ember_datetime_cache* cache = datetime_cache_for(vm);
+    size_t zone_length = strlen(zone_name);
+    *owned = 0;
+    if (cache) {
+        for (int i = 0; i < cache->count; i++) {
+            datetime_pattern* pattern = cache->entries[i];
+            if (pattern->key_length == length + 1 + zone_length && memcmp(pattern->key, text, length) == 0 &&
+                pattern->key[length] == '\0' && memcmp(pattern->key + length + 1, zone_name, zone_length) == 0) {
+                pattern->last_used = cache->clock;
+                return pattern;
+            }
+        }
+    }
+    const ember_zone* zone = zone_find(zone_name);
+    if (!zone) return NULL;
+    datetime_pattern* pattern = pattern_compile(text, length, zone_name, zone);
+    if (!pattern) return NULL;
+    if (!cache) {
+        *owned = 1;
+        return pattern;
+    }
+    int slot = cache->count;
+    if (slot == DATETIME_CACHE_SIZE) {
+        slot = 0;
+        for (int i = 1; i < cache->count; i++) {
+            if (cache->entries[i]->last_used < cache->entries[slot]->last_used) slot = i;
+        }
+        datetime_pattern_free(cache->entries[slot]);
+    } else {
+        cache->count++;
+    }
+    pattern->last_used = cache->clock;
+    cache->entries[slot] = pattern;
+    return pattern;
+}
+
+void datetime_cache_free(ember_vm* vm) {
+    ember_datetime_cache* cache = vm->datetime_cache;
+    if (!cache) return;
+    for (int i = 0; i < cache->count; i++) {
+        datetime_pattern_free(cache->entries[i]);
+    }
+    free(cache);
+    vm->datetime_cache = NULL;
+}
+
+// ============================================================================
+// NATIVES
+// ============================================================================
+
+// datetime_now() -> seconds since the epoch, with the fraction
+ember_value ember_native_datetime_now(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    (void)argv;
+    if (argc != 0) return ember_make_nil();
+    struct timespec now;
+    if (clock_gettime(CLOCK_REALTIME, &now) != 0) return ember_make_nil();
+    return ember_make_number((double)now.tv_sec + (double)now.tv_nsec / 1e9);
+}
+
+// datetime_timestamp() -> now; datetime_timestamp(year, month, day[, hour,
+// minute, second][, zone]) -> that wall-clock time, UTC unless zone given
+ember_value ember_native_datetime_timestamp(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc == 0) return ember_native_datetime_now(vm, 0, argv);
+    int count = argc;
+    const ember_zone* zone = &utc_zone;
+    if (argv[argc - 1].type == EMBER_VAL_STRING) {
+        zone = zone_arg(argc, argv, --count, "UTC");
+        if (!zone) return ember_make_nil();
+    }
+    if (count < 3 || count > 6) return ember_make_nil();
+    // year, month, day, hour, minute whole; the second may have a fraction
+    static const double limits[6] = {9999, 12, 31, 23, 59, 60};
+    double parts[6] = {1, 1, 1, 0, 0, 0};
+    for (int i = 0; i < count; i++) {
+        double part = argv[i].type == EMBER_VAL_NUMBER ? argv[i].as.number_val : NAN;
+        if (!(part >= (i < 3 ? 1 : 0) && part <= limits[i]) || (i < 5 && part != floor(part))) {
+            return ember_make_nil();
+        }
+        parts[i] = part;
+    }
+    if (parts[2] > days_in_month((int64_t)parts[0], (int)parts[1])) return ember_make_nil();
+    int64_t wall = days_from_civil((int64_t)parts[0], (int)parts[1], (int)parts[2]) * 86400 +
+                   (int64_t)parts[3] * 3600 + (int64_t)parts[4] * 60;
+    return number_or_nil((double)zone_wall_to_utc(zone, wall) + parts[5]);
+}
+
+static int parse_digits(const char** at, int count, int* value) {
+    int number = 0;
+    for (int i = 0; i < count; i++) {
+        char c = (*at)[i];
+        if (c < '0' || c > '9') return 0;
+        number = number * 10 + (c - '0');
+    }
+    *at += count;
+    *value = number;
+    return 1;
+}
+
+// datetime_parse(text[, zone]) -> seconds, from ISO 8601:
+// YYYY-MM-DD[(T| )HH:MM[:SS[.fff]]][Z|+HH[:MM]|-HH[:MM]]. Without an offset
+// the time is read in zone, UTC by default; nil if malformed
+ember_value ember_native_datetime_parse(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc < 1 || argc > 2 || argv[0].type != EMBER_VAL_STRING) return ember_make_nil();
+    const char* at = ember_string_flatten(AS_STRING(argv[0]));
+    int year, month, day, hour = 0, minute = 0, second = 0;
+    double fraction = 0;
+    if (!parse_digits(&at, 4, &year) || *at++ != '-' || !parse_digits(&at, 2, &month) || *at++ != '-' ||
+        !parse_digits(&at, 2, &day) || year < 1 || month < 1 || month > 12 || day < 1 ||
+        day > days_in_month(year, month)) {
+        return ember_make_nil();
+    }
+    if (*at == 'T' || *at == 't' || *at == ' ') {
+        at++;
+        if (!parse_digits(&at, 2, &hour) || *at++ != ':' || !parse_digits(&at, 2, &minute)) return ember_make_nil();
+        if (*at == ':') {
+            at++;
+            if (!parse_digits(&at, 2, &second)) return ember_make_nil();
+            if (*at == '.' || *at == ',') {
+                at++;
+                if (*at < '0' || *at > '9') return ember_make_nil();
+                for (double scale = 0.1; *at >= '0' && *at <= '9'; at++, scale /= 10) {
+                    fraction += (*at - '0') * scale;
+                }
+            }
+        }
+        if (hour > 23 || minute > 59 || second > 60) return ember_make_nil();
+    }
+    int64_t wall = days_from_civil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+    if (*at == 'Z' || *at == 'z') {
+        at++;
+    } else if (*at == '+' || *at == '-') {
+        int sign = *at++ == '-' ? -1 : 1;
+        int offset_hours, offset_minutes = 0;
+        if (!parse_digits(&at, 2, &offset_hours)) return ember_make_nil();
+        if (*at == ':') at++;
+        if (*at >= '0' && *at <= '9' && !parse_digits(&at, 2, &offset_minutes)) return ember_make_nil();
+        if (offset_hours > 23 || offset_minutes > 59) return ember_make_nil();
+        wall -= sign * (offset_hours * 3600 + offset_minutes * 60);
+    } else {
+        const ember_zone* zone = zone_arg(argc, argv, 1, "UTC");
+        if (!zone) return ember_make_nil();
+        wall = zone_wall_to_utc(zone, wall);
+    }
+    if (*at) return ember_make_nil();
+    return number_or_nil((double)wall + fraction);
+}
+
+// datetime_format(time[, pattern[, zone]]) -> text. pattern takes strftime's
+// conversions (C locale; %Y always four digits) plus %L for milliseconds;
+// ISO 8601 UTC by default
+ember_value ember_native_datetime_format(ember_vm* vm, int argc, ember_value* argv) {
+    double time;
+    if (argc < 1 || argc > 3 || !time_arg(argv[0], &time)) return ember_make_nil();
+    const char* text = DATETIME_DEFAULT_PATTERN;
+    size_t length = sizeof(DATETIME_DEFAULT_PATTERN) - 1;
+    if (argc >= 2 && argv[1].type != EMBER_VAL_NIL) {
+        if (argv[1].type != EMBER_VAL_STRING) return ember_make_nil();
+        ember_string* string = AS_STRING(argv[1]);
+        text = ember_string_flatten(string);
+        length = (size_t)string->length;
+        if (length > DATETIME_MAX_PATTERN) return ember_make_nil();
+    }
+    const char* zone_name = "UTC";
+    if (argc == 3 && argv[2].type != EMBER_VAL_NIL) {
+        if (argv[2].type != EMBER_VAL_STRING) return ember_make_nil();
+        zone_name = ember_string_flatten(AS_STRING(argv[2]));
+    }
+
+    int owned;
+    datetime_pattern* pattern = pattern_for(vm, text, length, zone_name, &owned);
+    if (!pattern) return ember_make_nil();
+    int64_t second = (int64_t)floor(time);
+    if (pattern->subsecond || !pattern->has_last || pattern->last_second != second) {
+        datetime_fields fields;
+        datetime_split(time, pattern->zone, &fields);
+        pattern->last_length = pattern_format(pattern, &fields, pattern->last_text);
+        pattern->last_second = second;
+        pattern->has_last = !pattern->subsecond;
+    }
+    ember_value result = string_value(copy_string(vm, pattern->last_text, (int)pattern->last_length));
+    if (owned) datetime_pattern_free(pattern);
+    return result;
+}
+
+// datetime_add(time, seconds) -> time + seconds
+ember_value ember_native_datetime_add(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    double time;
+    if (argc != 2 || !time_arg(argv[0], &time) || argv[1].type != EMBER_VAL_NUMBER) return ember_make_nil();
+    return number_or_nil(time + argv[1].as.number_val);
+}
+
+// datetime_diff(a, b) -> a - b in seconds
+ember_value ember_native_datetime_diff(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    double a, b;
+    if (argc != 2 || !time_arg(argv[0], &a) || !time_arg(argv[1], &b)) return ember_make_nil();
+    return ember_make_number(a - b);
+}
+
+// datetime_to_utc(time[, zone]): time read as wall-clock seconds in zone
+// (local by default) -> the UTC time it names
+ember_value ember_native_datetime_to_utc(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    double time;
+    if (argc < 1 || argc > 2 || !time_arg(argv[0], &time)) return ember_make_nil();
+    const ember_zone* zone = zone_arg(argc, argv, 1, "local");
+    if (!zone) return ember_make_nil();
+    double whole = floor(time);
+    return number_or_nil((double)zone_wall_to_utc(zone, (int64_t)whole) + (time - whole));
+}
+
+// datetime_from_utc(time[, zone]) -> the wall-clock seconds time shows in
+// zone, local by default
+ember_value ember_native_datetime_from_utc(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    double time;
+    if (argc < 1 || argc > 2 || !time_arg(argv[0], &time)) return ember_make_nil();
+    const ember_zone* zone = zone_arg(argc, argv, 1, "local");
+    if (!zone) return ember_make_nil();
+    return number_or_nil(time + zone_type_at(zone, (int64_t)floor(time))->offset);
+}
+
+// Field readers: datetime_year(time[, zone]) and the rest, UTC by default
+static int fields_arg(int argc, ember_value* argv, datetime_fields* fields) {
+    double time;
+    if (argc < 1 || argc > 2 || !time_arg(argv[0], &time)) return 0;
+    const ember_zone* zone = zone_arg(argc, argv, 1, "UTC");
+    if (!zone) return 0;
+    datetime_split(time, zone, fields);
+    return 1;
+}
+
+#define DATETIME_FIELD(name, expression)                                              \
+    ember_value ember_native_datetime_##name(ember_vm* vm, int argc, ember_value* argv) { \
+        (void)vm;                                                                     \
+        datetime_fields fields;                                                       \
+        if (!fields_arg(argc, argv, &fields)) return ember_make_nil();                \
+        return ember_make_number((double)(expression));                               \
+    }
+
+DATETIME_FIELD(year, fields.year)
+DATETIME_FIELD(month, fields.month)
+DATETIME_FIELD(day, fields.day)
+DATETIME_FIELD(hour, fields.hour)
+DATETIME_FIELD(minute, fields.minute)
+DATETIME_FIELD(second, fields.second)
+DATETIME_FIELD(weekday, fields.weekday)
+DATETIME_FIELD(yearday, fields.yearday)
@@ -0,0 +1,381 @@
+/**
+ * File handles for Ember: files read a line or a chunk at a time through
+ * one reusable buffer, so memory stays bounded by the longest line, and
+ * writers that batch many small writes into few write() calls
+ * file_open / file_read_line / file_read_chunk / file_lines
+ * file_writer / file_write / file_flush / file_close
+ */
+
+#define _GNU_SOURCE
+#include "ember.h"
+#include "value/value.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define FILE_BUFFER_SIZE (64 * 1024)
+#define FILE_MAX_LINE ((size_t)INT32_MAX)   // ember_string lengths are ints
+#define FILE_DIRECT_ALIGN 4096                 // Covers the logical block size of common devices
+#define FILE_MAX_WRITE_BUFFER (64 * 1024 * 1024)
+
+static bool write_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        data += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+
+// Writes the pending bytes out. O_DIRECT writes only whole blocks, so a
+// direct writer keeps a partial block back until final, when it drops
+// O_DIRECT for that last write
+static bool writer_flush(ember_file* file, bool final) {
+    if (file->failed || file->fd < 0) return false;
+    size_t length = file->end;
+    if (file->sync == FILE_SYNC_DIRECT && length % FILE_DIRECT_ALIGN != 0) {
+        if (final) {
+            int flags = fcntl(file->fd, F_GETFL);
+            if (flags >= 0) fcntl(file->fd, F_SETFL, flags & ~O_DIRECT);
+        } else {
+            length -= length % FILE_DIRECT_ALIGN;
+        }
+    }
+    if (length > 0) {
+        if (!write_all(file->fd, file->buffer, length)) {
+            file->failed = true;
+            return false;
+        }
+        memmove(file->buffer, file->buffer + length, file->end - length);
+        file->end -= length;
+    }
+    if (file->sync == FILE_SYNC_DATA && fdatasync(file->fd) != 0) {
+        file->failed = true;
+        return false;
+    }
+    return true;
+}
+
+bool ember_file_release(ember_file* file) {
+    bool flushed = true;
+    if (file->writing && file->fd >= 0) flushed = writer_flush(file, true);
+    if (file->fd >= 0) close(file->fd);
+    file->fd = -1;
+    free(file->buffer);
+    file->buffer = NULL;
+    file->start = file->end = file->capacity = 0;
+    return flushed;
+}
+
+// Reads more after the buffered bytes, moving them to the front and
+// growing the buffer when it is full. False at end of file or on error
+static bool file_fill(ember_file* file) {
+    if (file->fd < 0 || file->eof || file->writing) return false;
+    if (file->start > 0) {
+        memmove(file->buffer, file->buffer + file->start, file->end - file->start);
+        file->end -= file->start;
+        file->start = 0;
+    }
+    if (file->end == file->capacity) {
+        // A line longer than the buffer: double it rather than split the line
+        if (file->capacity >= FILE_MAX_LINE) return false;
+        size_t capacity = file->capacity ? file->capacity * 2 : FILE_BUFFER_SIZE;
+        char* grown = realloc(file->buffer, capacity);
+        if (!grown) return false;
+        file->buffer = grown;
+        file->capacity = capacity;
+    }
+    for (;;) {
+        ssize_t got = read(file->fd, file->buffer + file->end, file->capacity - file->end);
+        if (got > 0) {
+            file->end += (size_t)got;
+            return true;
+        }
+        if (got < 0 && errno == EINTR) continue;
+        // Errors end the file like EOF does; what was read stays readable
+        file->eof = true;
+        return false;
+    }
+}
+
+bool ember_file_at_end(ember_file* file) {
+    return file->writing || (file->start == file->end && !file_fill(file));
+}
+
+static ember_value string_value(ember_vm* vm, const char* chars, size_t length) {
+    ember_string* string = copy_string(vm, chars, (int)length);
+    if (!string) return ember_make_nil();
+    ember_value value;
+    value.type = EMBER_VAL_STRING;
+    value.as.obj_val = (ember_object*)string;
+    return value;
+}
+
+ember_value ember_file_read_line(ember_vm* vm, ember_file* file) {
+    if (file->writing) return ember_make_nil();
+    size_t scanned = 0;      // Bytes past start already known to hold no newline
+    for (;;) {
+        size_t unscanned = file->end - file->start - scanned;
+        char* newline = unscanned ? memchr(file->buffer + file->start + scanned, '\n', unscanned) : NULL;
+        if (newline) {
+            size_t length = (size_t)(newline - (file->buffer + file->start));
+            const char* line = file->buffer + file->start;
+            file->start += length + 1;
+            // \r\n ends a line too
+            if (length > 0 && line[length - 1] == '\r') length--;
+            return string_value(vm, line, length);
+        }
+        scanned = file->end - file->start;
+        if (!file_fill(file)) break;
+    }
+    // The last line need not end in a newline
+    if (file->start == file->end) return ember_make_nil();
+    size_t length = file->end - file->start;
+    const char* line = file->buffer + file->start;
+    file->start = file->end;
+    return string_value(vm, line, length);
+}
+
+// file_open(path): a handle for reading path, or nil
+ember_value ember_native_file_open(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 1 || argv[0].type != EMBER_VAL_STRING) return ember_make_nil();
+    const char* path = AS_CSTRING(argv[0]);
+    int fd = path ? open(path, O_RDONLY | O_CLOEXEC) : -1;
+    if (fd < 0) return ember_make_nil();
+    struct stat st;
+    if (fstat(fd, &st) != 0 || S_ISDIR(st.st_mode)) {
+        close(fd);
+        return ember_make_nil();
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    // Front to back: let the kernel read ahead further
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    ember_file* file = (ember_file*)allocate_object(vm, sizeof(ember_file), OBJ_FILE);
+    if (!file) {
+        close(fd);
+        return ember_make_nil();
+    }
+    file->fd = fd;
+    file->buffer = NULL;      // Allocated by the first read
+    file->start = file->end = file->capacity = 0;
+    file->eof = false;
+    file->writing = false;
+    file->failed = false;
+    file->sync = FILE_SYNC_NONE;
+    ember_value value;
+    value.type = EMBER_VAL_FILE;
+    value.as.obj_val = (ember_object*)file;
+    return value;
+}
+
+// file_read_line(file): the next line without its newline, or nil at the end
+ember_value ember_native_file_read_line(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 1 || argv[0].type != EMBER_VAL_FILE) return ember_make_nil();
+    return ember_file_read_line(vm, AS_FILE(argv[0]));
+}
+
+// file_read_chunk(file, n): the next n bytes, fewer only at the end of the
+// file, or nil once it is reached
+ember_value ember_native_file_read_chunk(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 2 || argv[0].type != EMBER_VAL_FILE || argv[1].type != EMBER_VAL_NUMBER) {
+        return ember_make_nil();
+    }
+    double requested = argv[1].as.number_val;
+    if (!(requested >= 1 && requested <= (double)FILE_MAX_LINE)) return ember_make_nil();
+    size_t wanted = (size_t)requested;
+    ember_file* file = AS_FILE(argv[0]);
+    if (ember_file_at_end(file)) return ember_make_nil();
+
+    size_t buffered = file->end - file->start;
+    if (buffered >= wanted || (file->eof && buffered > 0)) {
+        size_t length = buffered < wanted ? buffered : wanted;
+        ember_value chunk = string_value(vm, file->buffer + file->start, length);
+        file->start += length;
+        return chunk;
+    }
+
+    // More than the buffer holds: the buffered bytes, then straight from
+    // the file into the string's own storage
+    ember_string_builder builder = {0};
+    if (!string_builder_reserve(&builder, wanted) ||
+        !string_builder_append(&builder, file->buffer + file->start, buffered)) {
+        string_builder_reset(&builder);
+        return ember_make_nil();
+    }
+    file->start = file->end = 0;
+    while (builder.length < wanted) {
+        ssize_t got = read(file->fd, builder.chars + builder.length, wanted - builder.length);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) {
+            file->eof = true;
+            break;
+        }
+        builder.length += (size_t)got;
+    }
+    builder.chars[builder.length] = '\0';
+    ember_string* string = string_builder_take(vm, &builder);
+    string_builder_reset(&builder);
+    if (!string) return ember_make_nil();
+    ember_value chunk;
+    chunk.type = EMBER_VAL_STRING;
+    chunk.as.obj_val = (ember_object*)string;
+    return chunk;
+}
+
+// file_lines(file): an iterator over the remaining lines, for for loops
+ember_value ember_native_file_lines(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 1 || argv[0].type != EMBER_VAL_FILE) return ember_make_nil();
+    return ember_make_iterator(vm, argv[0], ITERATOR_FILE_LINES);
+}
+
+static const char* optional_string(int argc, ember_value* argv, int index) {
+    return index < argc && argv[index].type == EMBER_VAL_STRING ? AS_CSTRING(argv[index]) : NULL;
+}
+
+// file_writer(path[, mode[, buffer_size[, sync]]]): a handle that batches
+// writes in a buffer_size buffer (64 KB by default, 0 for none). mode "w"
+// truncates, "a" appends. sync "data" fdatasyncs each flush; "direct"
+// writes whole blocks with O_DIRECT where the filesystem allows it,
+// otherwise through the page cache
+ember_value ember_native_file_writer(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc < 1 || argc > 4 || argv[0].type != EMBER_VAL_STRING) return ember_make_nil();
+    if ((argc > 1 && argv[1].type != EMBER_VAL_STRING && argv[1].type != EMBER_VAL_NIL) ||
+        (argc > 2 && argv[2].type != EMBER_VAL_NUMBER && argv[2].type != EMBER_VAL_NIL) ||
+        (argc > 3 && argv[3].type != EMBER_VAL_STRING)) {
+        return ember_make_nil();
+    }
+    const char* mode = optional_string(argc, argv, 1);
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+    if (!mode || strcmp(mode, "w") == 0) flags |= O_TRUNC;
+    else if (strcmp(mode, "a") == 0) flags |= O_APPEND;
+    else return ember_make_nil();
+
+    size_t capacity = FILE_BUFFER_SIZE;
+    if (argc > 2 && argv[2].type == EMBER_VAL_NUMBER) {
+        double size = argv[2].as.number_val;
+        if (!(size >= 0 && size <= FILE_MAX_WRITE_BUFFER)) return ember_make_nil();
+        capacity = (size_t)size;
+    }
+    ember_file_sync sync = FILE_SYNC_NONE;
+    const char* policy = optional_string(argc, argv, 3);
+    if (policy && strcmp(policy, "data") == 0) sync = FILE_SYNC_DATA;
+    else if (policy && strcmp(policy, "direct") == 0) sync = FILE_SYNC_DIRECT;
+    else if (policy && strcmp(policy, "none") != 0) return ember_make_nil();
+
+    const char* path = AS_CSTRING(argv[0]);
+    if (!path) return ember_make_nil();
+    int fd = -1;
+#ifdef O_DIRECT
+    if (sync == FILE_SYNC_DIRECT) {
+        fd = open(path, flags | O_DIRECT, 0644);
+        // tmpfs and some network filesystems refuse it
+        if (fd < 0 && errno == EINVAL) sync = FILE_SYNC_NONE;
+    }
+#else
+    if (sync == FILE_SYNC_DIRECT) sync = FILE_SYNC_NONE;
+#endif
+    if (sync != FILE_SYNC_DIRECT) fd = open(path, flags, 0644);
+    if (fd < 0) return ember_make_nil();
+
+    char* buffer = NULL;
+    if (sync == FILE_SYNC_DIRECT) {
+        // Whole aligned blocks from an aligned buffer
+        capacity = (capacity + FILE_DIRECT_ALIGN - 1) / FILE_DIRECT_ALIGN * FILE_DIRECT_ALIGN;
+        if (capacity == 0) capacity = FILE_DIRECT_ALIGN;
+        void* aligned = NULL;
+        if (posix_memalign(&aligned, FILE_DIRECT_ALIGN, capacity) != 0) aligned = NULL;
+        buffer = aligned;
+    } else if (capacity > 0) {
+        buffer = malloc(capacity);
+    }
+    if (capacity > 0 && !buffer) {
+        close(fd);
+        return ember_make_nil();
+    }
+
+    ember_file* file = (ember_file*)allocate_object(vm, sizeof(ember_file), OBJ_FILE);
+    if (!file) {
+        free(buffer);
+        close(fd);
+        return ember_make_nil();
+    }
+    file->fd = fd;
+    file->buffer = buffer;
+    file->start = file->end = 0;
+    file->capacity = capacity;
+    file->eof = true;
+    file->writing = true;
+    file->failed = false;
+    file->sync = sync;
+    ember_value value;
+    value.type = EMBER_VAL_FILE;
+    value.as.obj_val = (ember_object*)file;
+    return value;
+}
+
+// file_write(file, text, ...): buffers the strings' bytes; false once a
+// write has failed
+ember_value ember_native_file_write(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc < 2 || argv[0].type != EMBER_VAL_FILE) return ember_make_bool(0);
+    ember_file* file = AS_FILE(argv[0]);
+    if (!file->writing || file->fd < 0 || file->failed) return ember_make_bool(0);
+    for (int i = 1; i < argc; i++) {
+        if (argv[i].type != EMBER_VAL_STRING) return ember_make_bool(0);
+    }
+
+    for (int i = 1; i < argc; i++) {
+        ember_string* string = AS_STRING(argv[i]);
+        const char* data = ember_string_bytes(string);
+        size_t length = (size_t)string->length;
+        if (!data && length > 0) return ember_make_bool(0);
+        while (length > 0) {
+            // Nothing pending and at least a buffer's worth: skip the copy
+            if (file->end == 0 && length >= file->capacity && file->sync != FILE_SYNC_DIRECT) {
+                if (!write_all(file->fd, data, length)) {
+                    file->failed = true;
+                    return ember_make_bool(0);
+                }
+                if (file->sync == FILE_SYNC_DATA && !writer_flush(file, false)) return ember_make_bool(0);
+                break;
+            }
+            if (file->end == file->capacity && !writer_flush(file, false)) return ember_make_bool(0);
+            size_t room = file->capacity - file->end;
+            size_t piece = length < room ? length : room;
+            memcpy(file->buffer + file->end, data, piece);
+            file->end += piece;
+            data += piece;
+            length -= piece;
+        }
+    }
+    return ember_make_bool(1);
+}
+
+// file_flush(file): writes out what is buffered, and syncs under "data".
+// A direct writer keeps back a trailing partial block until it is closed
+ember_value ember_native_file_flush(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc != 1 || argv[0].type != EMBER_VAL_FILE) return ember_make_bool(0);
+    ember_file* file = AS_FILE(argv[0]);
+    if (!file->writing) return ember_make_bool(0);
+    return ember_make_bool(writer_flush(file, false));
+}
+
+// file_close(file): flushes a writer and closes the file now rather than
+// when it is collected; false if it was closed or bytes were lost
+ember_value ember_native_file_close(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc != 1 || argv[0].type != EMBER_VAL_FILE) return ember_make_bool(0);
+    ember_file* file = AS_FILE(argv[0]);
+    bool was_open = file->fd >= 0;
+    bool flushed = ember_file_release(file);
+    file->eof = true;
+    return ember_make_bool(was_open && flushed);
+}
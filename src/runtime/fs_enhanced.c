@@ -3,6 +3,7 @@
  * Provides advanced file and directory management capabilities
  */
 
+#define _GNU_SOURCE
 #include "ember.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -14,6 +15,13 @@
 #include <fcntl.h>
 #include <time.h>
 #include <errno.h>
+#if defined(__linux__)
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
+#endif
+#include "value/value.h"
 
 #define MAX_PATH_LENGTH 4096
 #define MAX_FILE_SIZE (100 * 1024 * 1024) // 100MB limit
@@ -71,7 +79,109 @@ ember_value ember_native_rmdir(ember_vm* vm, int argc, ember_value* argv) {
     return ember_make_bool(result == 0);
 }
 
-// List directory contents
+#define DIR_BATCH_SIZE (64 * 1024)             // getdents64 buffer: hundreds of entries per call
+
+// Reads a directory's entries a batch at a time, skipping . and ..
+typedef struct {
+    int fd;
+#if defined(__linux__) && defined(SYS_getdents64)
+    char* batch;
+    long position;
+    long size;
+#else
+    DIR* dir;
+#endif
+} dir_reader;
+
+#if defined(__linux__) && defined(SYS_getdents64)
+// The kernel's record; glibc only wraps getdents64 from 2.30
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+static int dir_open(dir_reader* reader, const char* path) {
+    reader->fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (reader->fd < 0) {
+        return 0;
+    }
+#if defined(__linux__) && defined(SYS_getdents64)
+    reader->batch = malloc(DIR_BATCH_SIZE);
+    reader->position = reader->size = 0;
+    if (!reader->batch) {
+        close(reader->fd);
+        return 0;
+    }
+#else
+    // readdir batches internally; the fd stays usable for fstatat
+    reader->dir = fdopendir(dup(reader->fd));
+    if (!reader->dir) {
+        close(reader->fd);
+        return 0;
+    }
+#endif
+    return 1;
+}
+
+// The next entry's name and DT_* type; 0 at the end or on error
+static int dir_next(dir_reader* reader, const char** name, unsigned char* type) {
+    for (;;) {
+#if defined(__linux__) && defined(SYS_getdents64)
+        if (reader->position >= reader->size) {
+            long got = syscall(SYS_getdents64, reader->fd, reader->batch, DIR_BATCH_SIZE);
+            if (got <= 0) {
+                return 0;
+            }
+            reader->position = 0;
+            reader->size = got;
+        }
+        struct linux_dirent64* entry = (struct linux_dirent64*)(reader->batch + reader->position);
+        reader->position += entry->d_reclen;
+        *name = entry->d_name;
+        *type = entry->d_type;
+#else
+        struct dirent* entry = readdir(reader->dir);
+        if (!entry) {
+            return 0;
+        }
+        *name = entry->d_name;
+#ifdef DT_UNKNOWN
+        *type = entry->d_type;
+#else
+        *type = 0;
+#endif
+#endif
+        if (strcmp(*name, ".") != 0 && strcmp(*name, "..") != 0) {
+            return 1;
+        }
+    }
+}
+
+static void dir_close(dir_reader* reader) {
+#if defined(__linux__) && defined(SYS_getdents64)
+    free(reader->batch);
+#else
+    closedir(reader->dir);
+#endif
+    close(reader->fd);
+}
+
+static ember_value string_value(ember_vm* vm, const char* chars) {
+    ember_string* string = copy_string(vm, chars, (int)strlen(chars));
+    if (!string) {
+        return ember_make_nil();
+    }
+    ember_value value;
+    value.type = EMBER_VAL_STRING;
+    value.as.obj_val = (ember_object*)string;
+    return value;
+}
+
+// List directory contents as an array of names, in directory order
 ember_value ember_native_listdir(ember_vm* vm, int argc, ember_value* argv) {
     if (argc != 1 || argv[0].type != EMBER_VAL_STRING) {
         return ember_make_nil();
@@ -83,41 +193,22 @@ ember_value ember_native_listdir(ember_vm* vm, int argc, ember_value* argv) {
         return ember_make_nil();
     }
     
-    DIR* dir = opendir(path_str->chars);
-    if (!dir) {
+    dir_reader reader;
+    if (!dir_open(&reader, path_str->chars)) {
         return ember_make_nil();
     }
     
-    // Build comma-separated list of filenames
-    char* result_buffer = malloc(4096);
-    if (!result_buffer) {
-        closedir(dir);
-        return ember_make_nil();
+    ember_value names = ember_make_array(vm, 16);
+    vm->stack[vm->stack_top++] = names;
+    const char* name;
+    unsigned char type;
+    while (dir_next(&reader, &name, &type)) {
+        array_push_with_vm(vm, AS_ARRAY(names), string_value(vm, name));
     }
+    dir_close(&reader);
+    vm->stack_top--;
     
-    result_buffer[0] = '\0';
-    int first = 1;
-    
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != NULL) {
-        // Skip . and ..
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            continue;
-        }
-        
-        if (!first) {
-            strcat(result_buffer, ",");
-        }
-        strcat(result_buffer, entry->d_name);
-        first = 0;
-    }
-    
-    closedir(dir);
-    
-    ember_value result = ember_make_string_gc(vm, result_buffer);
-    free(result_buffer);
-    
-    return result;
+    return names;
 }
 
 // Check if path is a directory
@@ -239,7 +330,72 @@ ember_value ember_native_rename(ember_vm* vm, int argc, ember_value* argv) {
     return ember_make_bool(result == 0);
 }
 
-// Copy file (simple implementation)
+#define COPY_BUFFER_SIZE (1024 * 1024)
+#define COPY_STEP (1L << 30)                   // Bytes per copy_file_range/sendfile call
+
+// Whether a kernel copy failed because it cannot handle these files, as
+// opposed to a real I/O error
+static int copy_unsupported(int error) {
+    return error == ENOSYS || error == EXDEV || error == EINVAL || error == EOPNOTSUPP ||
+           error == ENOTSUP || error == EPERM || error == ETXTBSY;
+}
+
+// Copies in to out from their current offsets to the end of in. Tries a
+// reflink that shares the blocks, then copy_file_range and sendfile, which
+// keep the bytes in the kernel; a read/write loop is the last resort.
+// Each step carries on from where the previous one stopped
+static int copy_fd(int in, int out) {
+#if defined(__linux__)
+#ifdef FICLONE
+    if (ioctl(out, FICLONE, in) == 0) return 1;
+#endif
+    for (;;) {
+        ssize_t copied = copy_file_range(in, NULL, out, NULL, COPY_STEP, 0);
+        if (copied == 0) return 1;
+        if (copied > 0) continue;
+        if (errno == EINTR) continue;
+        if (!copy_unsupported(errno)) return 0;
+        break;
+    }
+    for (;;) {
+        ssize_t copied = sendfile(out, in, NULL, COPY_STEP);
+        if (copied == 0) return 1;
+        if (copied > 0) continue;
+        if (errno == EINTR) continue;
+        if (!copy_unsupported(errno)) return 0;
+        break;
+    }
+#endif
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    char* buffer = malloc(COPY_BUFFER_SIZE);
+    if (!buffer) return 0;
+    int ok = 1;
+    for (;;) {
+        ssize_t got = read(in, buffer, COPY_BUFFER_SIZE);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) {
+            ok = got == 0;
+            break;
+        }
+        for (ssize_t done = 0; done < got;) {
+            ssize_t put = write(out, buffer + done, (size_t)(got - done));
+            if (put < 0 && errno == EINTR) continue;
+            if (put <= 0) {
+                ok = 0;
+                break;
+            }
+            done += put;
+        }
+        if (!ok) break;
+    }
+    free(buffer);
+    return ok;
+}
+
+// Copy file; the bytes stay in the kernel where it can copy them itself
 ember_value ember_native_copy_file(ember_vm* vm, int argc, ember_value* argv) {
     (void)vm;
     if (argc != 2 || argv[0].type != EMBER_VAL_STRING || argv[1].type != EMBER_VAL_STRING) {
@@ -253,41 +409,39 @@ ember_value ember_native_copy_file(ember_vm* vm, int argc, ember_value* argv) {
         return ember_make_bool(0);
     }
     
-    // Check source file size
+    int src = open(src_path->chars, O_RDONLY | O_CLOEXEC);
+    if (src < 0) {
+        return ember_make_bool(0);
+    }
     struct stat st;
-    if (stat(src_path->chars, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size > MAX_FILE_SIZE) {
+    if (fstat(src, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(src);
         return ember_make_bool(0);
     }
     
-    FILE* src = fopen(src_path->chars, "rb");
-    if (!src) {
+    // Truncated only once it is known not to be the source itself
+    int dst = open(dst_path->chars, O_WRONLY | O_CREAT | O_CLOEXEC, st.st_mode & 0777);
+    if (dst < 0) {
+        close(src);
         return ember_make_bool(0);
     }
-    
-    FILE* dst = fopen(dst_path->chars, "wb");
-    if (!dst) {
-        fclose(src);
+    struct stat dst_st;
+    if (fstat(dst, &dst_st) != 0 || (dst_st.st_dev == st.st_dev && dst_st.st_ino == st.st_ino) ||
+        ftruncate(dst, 0) != 0) {
+        close(src);
+        close(dst);
         return ember_make_bool(0);
     }
     
-    char buffer[8192];
-    size_t bytes_copied = 0;
-    size_t bytes_read;
-    
-    while ((bytes_read = fread(buffer, 1, sizeof(buffer), src)) > 0) {
-        if (fwrite(buffer, 1, bytes_read, dst) != bytes_read) {
-            fclose(src);
-            fclose(dst);
-            unlink(dst_path->chars); // Remove partial file
-            return ember_make_bool(0);
-        }
-        bytes_copied += bytes_read;
+    int ok = copy_fd(src, dst);
+    close(src);
+    if (close(dst) != 0) {
+        ok = 0;
     }
-    
-    fclose(src);
-    fclose(dst);
-    
-    return ember_make_bool(bytes_copied == (size_t)st.st_size);
+    if (!ok) {
+        unlink(dst_path->chars); // Remove partial file
+    }
+    return ember_make_bool(ok);
 }
 
 // Get current working directory
@@ -352,75 +506,81 @@ ember_value ember_native_access(ember_vm* vm, int argc, ember_value* argv) {
     return ember_make_bool(result == 0);
 }
 
-// Read directory with file types (enhanced version)
+static const char* entry_type_name(unsigned char type) {
+    switch (type) {
+        case DT_REG: return "f";
+        case DT_DIR: return "d";
+        case DT_LNK: return "l";
+        default:     return "?";
+    }
+}
+
+static const char* mode_type_name(mode_t mode) {
+    if (S_ISREG(mode)) return "f";
+    if (S_ISDIR(mode)) return "d";
+    if (S_ISLNK(mode)) return "l";
+    return "?";
+}
+
+static void set_field(ember_vm* vm, ember_hash_map* map, const char* key, ember_value value) {
+    vm->stack[vm->stack_top++] = value;
+    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, key), value);
+    vm->stack_top--;
+}
+
+// Read directory with file types: a map from each name to {type, size,
+// mtime}, type "f", "d", "l" (not followed) or "?". Pass false to skip
+// the per-entry stat and take types from the directory alone; size and
+// mtime are then -1
 ember_value ember_native_listdir_detailed(ember_vm* vm, int argc, ember_value* argv) {
-    if (argc != 1 || argv[0].type != EMBER_VAL_STRING) {
+    if (argc < 1 || argc > 2 || argv[0].type != EMBER_VAL_STRING ||
+        (argc == 2 && argv[1].type != EMBER_VAL_BOOL)) {
         return ember_make_nil();
     }
     
     ember_string* path_str = AS_STRING(argv[0]);
+    int with_stat = argc < 2 || argv[1].as.bool_val;
     
     if (!validate_file_path(path_str->chars)) {
         return ember_make_nil();
     }
     
-    DIR* dir = opendir(path_str->chars);
-    if (!dir) {
-        return ember_make_nil();
-    }
-    
-    // Build JSON-like string with file details
-    char* result_buffer = malloc(8192);
-    if (!result_buffer) {
-        closedir(dir);
+    dir_reader reader;
+    if (!dir_open(&reader, path_str->chars)) {
         return ember_make_nil();
     }
     
-    strcpy(result_buffer, "{");
-    int first = 1;
-    
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != NULL) {
-        // Skip . and ..
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            continue;
-        }
-        
-        // Get full path for stat
-        char full_path[MAX_PATH_LENGTH];
-        snprintf(full_path, sizeof(full_path), "%s/%s", path_str->chars, entry->d_name);
-        
+    ember_value entries = ember_make_hash_map(vm, 16);
+    vm->stack[vm->stack_top++] = entries;
+    const char* name;
+    unsigned char type;
+    while (dir_next(&reader, &name, &type)) {
+        const char* type_name = entry_type_name(type);
+        double size = -1;
+        double mtime = -1;
+        // Relative to the directory: no path joins, no length limit
         struct stat st;
-        char type = '?';
-        long size = -1;
-        
-        if (stat(full_path, &st) == 0) {
-            if (S_ISDIR(st.st_mode)) {
-                type = 'd';
-            } else if (S_ISREG(st.st_mode)) {
-                type = 'f';
-                size = st.st_size;
-            } else if (S_ISLNK(st.st_mode)) {
-                type = 'l';
+        if ((with_stat || type == DT_UNKNOWN) &&
+            fstatat(reader.fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+            type_name = mode_type_name(st.st_mode);
+            if (with_stat) {
+                size = S_ISREG(st.st_mode) ? (double)st.st_size : -1;
+                mtime = (double)st.st_mtime;
             }
         }
         
-        if (!first) {
-            strcat(result_buffer, ",");
-        }
-        
-        char entry_info[512];
-        snprintf(entry_info, sizeof(entry_info), "\"%s\":{\"type\":\"%c\",\"size\":%ld}", 
-                entry->d_name, type, size);
-        strcat(result_buffer, entry_info);
-        first = 0;
-    }
-    
-    strcat(result_buffer, "}");
-    closedir(dir);
-    
-    ember_value result = ember_make_string_gc(vm, result_buffer);
-    free(result_buffer);
-    
-    return result;
-}
\ No newline at end of file
+        ember_value info = ember_make_hash_map(vm, 4);
+        vm->stack[vm->stack_top++] = info;
+        set_field(vm, AS_HASH_MAP(info), "type", ember_make_string_gc(vm, type_name));
+        set_field(vm, AS_HASH_MAP(info), "size", ember_make_number(size));
+        set_field(vm, AS_HASH_MAP(info), "mtime", ember_make_number(mtime));
+        ember_value key = string_value(vm, name);
+        vm->stack[vm->stack_top++] = key;
+        hash_map_set_with_vm(vm, AS_HASH_MAP(entries), key, info);
+        vm->stack_top -= 2;
+    }
+    dir_close(&reader);
+    vm->stack_top--;
+    
+    return entries;
+}
@@ -0,0 +1,545 @@
+/**
+ * Recursive directory walks for Ember: a few threads read directories in
+ * parallel against the root's fd, filter names through a compiled glob,
+ * and hand matching paths to an iterator as they are found
+ * fs_walk(root[, pattern[, max_depth[, follow_symlinks]]])
+ *
+ * Results come in no particular order. The result queue is bounded, so a
+ * walk the script stops reading stalls its threads rather than its memory
+ */
+
+#define _GNU_SOURCE
+#include "ember.h"
+#include "value/value.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#define WALK_MAX_THREADS 4
+#define WALK_RESULT_LIMIT 4096                 // Paths found but not yet taken
+
+// ---------------------------------------------------------------------------
+// Globs
+//
+// * and ? stay within a path segment, ** crosses them and **/ also matches
+// no directories at all; [abc], [a-z] and [!...] are classes and \ escapes.
+// A pattern without / matches the entry's name, one with / its path below
+// the root. Matching is one pass per token over the text, so no pattern
+// can backtrack exponentially
+
+typedef enum {
+    GLOB_LITERAL,
+    GLOB_ANY,                                  // ?
+    GLOB_CLASS,                                // [...]
+    GLOB_STAR,                                 // *
+    GLOB_GLOBSTAR,                             // ** not followed by /
+    GLOB_GLOBSTAR_DIRS                         // **/
+} glob_token_type;
+
+typedef struct {
+    glob_token_type type;
+    unsigned char literal;
+    uint8_t set[32];                           // GLOB_CLASS: bit per byte
+} glob_token;
+
+typedef struct {
+    glob_token* tokens;
+    int count;
+    bool whole_path;
+} glob_program;
+
+static void glob_free(glob_program* glob) {
+    if (!glob) return;
+    free(glob->tokens);
+    free(glob);
+}
+
+static glob_program* glob_compile(const char* pattern) {
+    size_t length = strlen(pattern);
+    glob_program* glob = calloc(1, sizeof(glob_program));
+    if (!glob) return NULL;
+    glob->tokens = calloc(length + 1, sizeof(glob_token));
+    if (!glob->tokens) {
+        free(glob);
+        return NULL;
+    }
+    glob->whole_path = strchr(pattern, '/') != NULL;
+
+    for (size_t i = 0; i < length;) {
+        glob_token* token = &glob->tokens[glob->count++];
+        char c = pattern[i];
+        if (c == '*' && pattern[i + 1] == '*') {
+            i += 2;
+            while (pattern[i] == '*') i++;
+            if (pattern[i] == '/') {
+                token->type = GLOB_GLOBSTAR_DIRS;
+                i++;
+            } else {
+                token->type = GLOB_GLOBSTAR;
+            }
+        } else if (c == '*') {
+            token->type = GLOB_STAR;
+            i++;
+        } else if (c == '?') {
+            token->type = GLOB_ANY;
+            i++;
+        } else if (c == '[' && strchr(pattern + i + 1, ']')) {
+            size_t j = i + 1;
+            bool negate = pattern[j] == '!' || pattern[j] == '^';
+            if (negate) j++;
+            // A ] first in the class is a member
+            bool first = true;
+            while (j < length && (pattern[j] != ']' || first)) {
+                unsigned char low = (unsigned char)pattern[j];
+                unsigned char high = low;
+                if (pattern[j + 1] == '-' && j + 2 < length && pattern[j + 2] != ']') {
+                    high = (unsigned char)pattern[j + 2];
+                    j += 2;
+                }
+                for (unsigned int b = low; b <= high; b++) token->set[b >> 3] |= (uint8_t)(1u << (b & 7));
+                j++;
+                first = false;
+            }
+            if (j >= length) {
+                // No closing ]: a literal [
+                memset(token->set, 0, sizeof(token->set));
+                token->type = GLOB_LITERAL;
+                token->literal = '[';
+                i++;
+                continue;
+            }
+            if (negate) {
+                for (int b = 0; b < 32; b++) token->set[b] = (uint8_t)~token->set[b];
+            }
+            // Classes never match the separator
+            token->set['/' >> 3] &= (uint8_t)~(1u << ('/' & 7));
+            token->type = GLOB_CLASS;
+            i = j + 1;
+        } else {
+            if (c == '\\' && i + 1 < length) i++;
+            token->type = GLOB_LITERAL;
+            token->literal = (unsigned char)pattern[i];
+            i++;
+        }
+    }
+    return glob;
+}
+
+// Per-thread rows for glob_match
+typedef struct {
+    bool* reach;
+    bool* next;
+    size_t capacity;
+} glob_scratch;
+
+// reach[i]: whether the tokens so far match text[0, i)
+static bool glob_match(const glob_program* glob, const char* text, size_t length, glob_scratch* scratch) {
+    if (length + 1 > scratch->capacity) {
+        size_t capacity = (length + 1) * 2;
+        bool* reach = realloc(scratch->reach, capacity);
+        if (reach) scratch->reach = reach;
+        bool* next = realloc(scratch->next, capacity);
+        if (next) scratch->next = next;
+        if (!reach || !next) return false;
+        scratch->capacity = capacity;
+    }
+    bool* reach = scratch->reach;
+    bool* next = scratch->next;
+    memset(reach, 0, length + 1);
+    reach[0] = true;
+    for (int t = 0; t < glob->count; t++) {
+        const glob_token* token = &glob->tokens[t];
+        bool any = false;
+        bool seen = false;                     // GLOB_GLOBSTAR_DIRS: some earlier position matched
+        next[0] = token->type >= GLOB_STAR && reach[0];
+        for (size_t i = 1; i <= length; i++) {
+            unsigned char c = (unsigned char)text[i - 1];
+            switch (token->type) {
+                case GLOB_LITERAL: next[i] = reach[i - 1] && c == token->literal; break;
+                case GLOB_ANY:     next[i] = reach[i - 1] && c != '/'; break;
+                case GLOB_CLASS:   next[i] = reach[i - 1] && (token->set[c >> 3] & (1u << (c & 7))); break;
+                case GLOB_STAR:    next[i] = reach[i] || (next[i - 1] && c != '/'); break;
+                case GLOB_GLOBSTAR: next[i] = reach[i] || next[i - 1]; break;
+                case GLOB_GLOBSTAR_DIRS:
+                    seen = seen || reach[i - 1];
+                    next[i] = reach[i] || (seen && c == '/');
+                    break;
+            }
+            any = any || next[i];
+        }
+        if (!any && !next[0]) return false;
+        bool* swap = reach;
+        reach = next;
+        next = swap;
+    }
+    return reach[length];
+}
+
+// ---------------------------------------------------------------------------
+// The walk
+
+typedef struct {
+    char* path;                                // Below the root; "" for the root itself
+    int depth;                                 // Of the entries inside it
+} walk_dir;
+
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+} walk_inode;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;                 // A directory was queued, or the walk is over
+    pthread_cond_t result_ready;               // A path was queued, or the walk is over
+    pthread_cond_t result_space;               // The script took paths
+
+    int root_fd;
+    char* root;                                // Prefixed to every result
+    glob_program* glob;                        // NULL matches everything
+    int max_depth;                             // Negative for no limit
+    bool follow;
+
+    walk_dir* dirs;                            // Still to read; a stack, so the walk stays narrow
+    size_t dir_count;
+    size_t dir_capacity;
+    char* results[WALK_RESULT_LIMIT];          // Ring of full paths
+    size_t result_head;
+    size_t result_count;
+    int busy;                                  // Threads reading a directory
+    bool stopping;
+
+    walk_inode* visited;                       // Following links: directories already queued
+    size_t visited_count;
+    size_t visited_capacity;
+
+    pthread_t threads[WALK_MAX_THREADS];
+    int thread_count;
+} walk_state;
+
+static bool walk_finished(const walk_state* walk) {
+    return walk->dir_count == 0 && walk->busy == 0;
+}
+
+// Under the lock. False if it was visited already, so links back up the
+// tree end instead of looping
+static bool walk_visit(walk_state* walk, dev_t dev, ino_t ino) {
+    if (walk->visited_count * 2 >= walk->visited_capacity) {
+        size_t capacity = walk->visited_capacity ? walk->visited_capacity * 2 : 64;
+        walk_inode* grown = calloc(capacity, sizeof(walk_inode));
+        if (!grown) return false;
+        for (size_t i = 0; i < walk->visited_capacity; i++) {
+            walk_inode entry = walk->visited[i];
+            if (entry.ino == 0 && entry.dev == 0) continue;
+            size_t slot = (size_t)(entry.ino * 31 + entry.dev) & (capacity - 1);
+            while (grown[slot].ino != 0 || grown[slot].dev != 0) slot = (slot + 1) & (capacity - 1);
+            grown[slot] = entry;
+        }
+        free(walk->visited);
+        walk->visited = grown;
+        walk->visited_capacity = capacity;
+    }
+    size_t slot = (size_t)(ino * 31 + dev) & (walk->visited_capacity - 1);
+    while (walk->visited[slot].ino != 0 || walk->visited[slot].dev != 0) {
+        if (walk->visited[slot].ino == ino && walk->visited[slot].dev == dev) return false;
+        slot = (slot + 1) & (walk->visited_capacity - 1);
+    }
+    walk->visited[slot].dev = dev;
+    walk->visited[slot].ino = ino;
+    walk->visited_count++;
+    return true;
+}
+
+// Under the lock; takes path
+static void walk_push_dir(walk_state* walk, char* path, int depth) {
+    if (walk->dir_count == walk->dir_capacity) {
+        size_t capacity = walk->dir_capacity ? walk->dir_capacity * 2 : 64;
+        walk_dir* grown = realloc(walk->dirs, capacity * sizeof(walk_dir));
+        if (!grown) {
+            free(path);
+            return;
+        }
+        walk->dirs = grown;
+        walk->dir_capacity = capacity;
+    }
+    walk->dirs[walk->dir_count].path = path;
+    walk->dirs[walk->dir_count].depth = depth;
+    walk->dir_count++;
+    pthread_cond_signal(&walk->work_ready);
+}
+
+// Under the lock; takes path. Waits while the script is behind
+static void walk_push_result(walk_state* walk, char* path) {
+    while (walk->result_count == WALK_RESULT_LIMIT && !walk->stopping) {
+        pthread_cond_wait(&walk->result_space, &walk->lock);
+    }
+    if (walk->stopping) {
+        free(path);
+        return;
+    }
+    walk->results[(walk->result_head + walk->result_count) % WALK_RESULT_LIMIT] = path;
+    walk->result_count++;
+    pthread_cond_signal(&walk->result_ready);
+}
+
+static char* join_path(const char* parent, const char* name) {
+    size_t parent_length = strlen(parent);
+    size_t name_length = strlen(name);
+    bool slash = parent_length > 0 && parent[parent_length - 1] != '/';
+    char* path = malloc(parent_length + slash + name_length + 1);
+    if (!path) return NULL;
+    memcpy(path, parent, parent_length);
+    if (slash) path[parent_length] = '/';
+    memcpy(path + parent_length + slash, name, name_length + 1);
+    return path;
+}
+
+static void walk_read_dir(walk_state* walk, walk_dir* dir, glob_scratch* scratch) {
+    const char* relative = dir->path[0] ? dir->path : ".";
+    int fd = openat(walk->root_fd, relative, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return;
+    DIR* stream = fdopendir(fd);
+    if (!stream) {
+        close(fd);
+        return;
+    }
+
+    struct dirent* entry;
+    while ((entry = readdir(stream)) != NULL) {
+        const char* name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+
+        // d_type saves a stat per entry where the filesystem fills it in
+        bool is_dir = entry->d_type == DT_DIR;
+        bool is_link = entry->d_type == DT_LNK;
+        struct stat st;
+        bool have_stat = false;
+        if (entry->d_type == DT_UNKNOWN && fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+            is_dir = S_ISDIR(st.st_mode);
+            is_link = S_ISLNK(st.st_mode);
+            have_stat = true;
+        }
+        if (is_link && walk->follow && fstatat(fd, name, &st, 0) == 0 && S_ISDIR(st.st_mode)) {
+            is_dir = true;
+            have_stat = true;
+        } else if (is_link) {
+            is_dir = false;
+        }
+        bool descend = is_dir && (walk->max_depth < 0 || dir->depth < walk->max_depth);
+        if (descend && walk->follow && !have_stat) {
+            descend = fstatat(fd, name, &st, 0) == 0;
+        }
+
+        char* path = join_path(dir->path, name);
+        if (!path) continue;
+        bool matches = true;
+        if (walk->glob) {
+            const char* subject = walk->glob->whole_path ? path : name;
+            matches = glob_match(walk->glob, subject, strlen(subject), scratch);
+        }
+        char* result = matches ? join_path(walk->root, path) : NULL;
+
+        pthread_mutex_lock(&walk->lock);
+        if (walk->stopping) {
+            pthread_mutex_unlock(&walk->lock);
+            free(path);
+            free(result);
+            break;
+        }
+        if (descend && walk->follow && !walk_visit(walk, st.st_dev, st.st_ino)) descend = false;
+        if (descend) {
+            walk_push_dir(walk, path, dir->depth + 1);
+            path = NULL;
+        }
+        if (result) walk_push_result(walk, result);
+        pthread_mutex_unlock(&walk->lock);
+        free(path);
+    }
+    closedir(stream);
+}
+
+static void* walk_thread(void* arg) {
+    walk_state* walk = arg;
+    glob_scratch scratch = {0};
+
+    pthread_mutex_lock(&walk->lock);
+    for (;;) {
+        while (!walk->stopping && walk->dir_count == 0 && walk->busy > 0) {
+            pthread_cond_wait(&walk->work_ready, &walk->lock);
+        }
+        if (walk->stopping || walk->dir_count == 0) break;
+        walk_dir dir = walk->dirs[--walk->dir_count];
+        walk->busy++;
+        pthread_mutex_unlock(&walk->lock);
+
+        walk_read_dir(walk, &dir, &scratch);
+        free(dir.path);
+
+        pthread_mutex_lock(&walk->lock);
+        walk->busy--;
+        if (walk_finished(walk)) {
+            pthread_cond_broadcast(&walk->work_ready);
+            pthread_cond_broadcast(&walk->result_ready);
+        }
+    }
+    pthread_mutex_unlock(&walk->lock);
+    free(scratch.reach);
+    free(scratch.next);
+    return NULL;
+}
+
+// Once no thread runs
+static void walk_free(walk_state* walk) {
+    for (size_t i = 0; i < walk->dir_count; i++) free(walk->dirs[i].path);
+    for (size_t i = 0; i < walk->result_count; i++) {
+        free(walk->results[(walk->result_head + i) % WALK_RESULT_LIMIT]);
+    }
+    free(walk->dirs);
+    free(walk->visited);
+    glob_free(walk->glob);
+    free(walk->root);
+    close(walk->root_fd);
+    pthread_mutex_destroy(&walk->lock);
+    pthread_cond_destroy(&walk->work_ready);
+    pthread_cond_destroy(&walk->result_ready);
+    pthread_cond_destroy(&walk->result_space);
+    free(walk);
+}
+
+void ember_walker_release(ember_walker* walker) {
+    walk_state* walk = walker->state;
+    if (!walk) return;
+    walker->state = NULL;
+
+    pthread_mutex_lock(&walk->lock);
+    walk->stopping = true;
+    pthread_cond_broadcast(&walk->work_ready);
+    pthread_cond_broadcast(&walk->result_space);
+    pthread_mutex_unlock(&walk->lock);
+    for (int i = 0; i < walk->thread_count; i++) pthread_join(walk->threads[i], NULL);
+    walk_free(walk);
+}
+
+// Under the lock: waits until a path is queued or the walk is over
+static bool walk_wait(walk_state* walk) {
+    while (walk->result_count == 0 && !walk_finished(walk)) {
+        pthread_cond_wait(&walk->result_ready, &walk->lock);
+    }
+    return walk->result_count > 0;
+}
+
+bool ember_walker_done(ember_walker* walker) {
+    walk_state* walk = walker->state;
+    if (!walk) return true;
+    pthread_mutex_lock(&walk->lock);
+    bool more = walk_wait(walk);
+    pthread_mutex_unlock(&walk->lock);
+    return !more;
+}
+
+ember_value ember_walker_next(ember_vm* vm, ember_walker* walker) {
+    walk_state* walk = walker->state;
+    if (!walk) return ember_make_nil();
+    pthread_mutex_lock(&walk->lock);
+    char* path = NULL;
+    if (walk_wait(walk)) {
+        path = walk->results[walk->result_head];
+        walk->result_head = (walk->result_head + 1) % WALK_RESULT_LIMIT;
+        walk->result_count--;
+        pthread_cond_signal(&walk->result_space);
+    }
+    pthread_mutex_unlock(&walk->lock);
+    if (!path) return ember_make_nil();
+
+    ember_string* string = copy_string(vm, path, (int)strlen(path));
+    free(path);
+    if (!string) return ember_make_nil();
+    ember_value value;
+    value.type = EMBER_VAL_STRING;
+    value.as.obj_val = (ember_object*)string;
+    return value;
+}
+
+// fs_walk(root[, pattern[, max_depth[, follow_symlinks]]]): an iterator
+// over the paths below root, root included as their prefix, whose name
+// (or, for a pattern with /, whose path below root) matches the glob
+ember_value ember_native_fs_walk(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc < 1 || argc > 4 || argv[0].type != EMBER_VAL_STRING) return ember_make_nil();
+    if ((argc > 1 && argv[1].type != EMBER_VAL_STRING && argv[1].type != EMBER_VAL_NIL) ||
+        (argc > 2 && argv[2].type != EMBER_VAL_NUMBER && argv[2].type != EMBER_VAL_NIL) ||
+        (argc > 3 && argv[3].type != EMBER_VAL_BOOL)) {
+        return ember_make_nil();
+    }
+    const char* root = AS_CSTRING(argv[0]);
+    if (!root || !*root) return ember_make_nil();
+    int max_depth = -1;
+    if (argc > 2 && argv[2].type == EMBER_VAL_NUMBER) {
+        double depth = argv[2].as.number_val;
+        if (!(depth >= 1 && depth <= INT32_MAX)) return ember_make_nil();
+        max_depth = (int)depth;
+    }
+
+    int root_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd < 0) return ember_make_nil();
+    walk_state* walk = calloc(1, sizeof(walk_state));
+    if (!walk) {
+        close(root_fd);
+        return ember_make_nil();
+    }
+    walk->root_fd = root_fd;
+    walk->root = strdup(root);
+    walk->max_depth = max_depth;
+    walk->follow = argc > 3 && argv[3].as.bool_val;
+    const char* pattern = argc > 1 && argv[1].type == EMBER_VAL_STRING ? AS_CSTRING(argv[1]) : NULL;
+    if (pattern) walk->glob = glob_compile(pattern);
+    pthread_mutex_init(&walk->lock, NULL);
+    pthread_cond_init(&walk->work_ready, NULL);
+    pthread_cond_init(&walk->result_ready, NULL);
+    pthread_cond_init(&walk->result_space, NULL);
+
+    char* start = strdup("");
+    if (!walk->root || (pattern && !walk->glob) || !start) {
+        free(start);
+        walk_free(walk);
+        return ember_make_nil();
+    }
+    if (walk->follow) {
+        struct stat st;
+        if (fstat(root_fd, &st) == 0) walk_visit(walk, st.st_dev, st.st_ino);
+    }
+    walk_push_dir(walk, start, 1);
+
+    // Allocated before any thread starts, so a failure frees an idle walk
+    ember_walker* walker = (ember_walker*)allocate_object(vm, sizeof(ember_walker), OBJ_WALKER);
+    if (!walker) {
+        walk_free(walk);
+        return ember_make_nil();
+    }
+    walker->state = walk;
+
+    // Directory reads block on the disk, so even one core gains from a second thread
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus > WALK_MAX_THREADS ? WALK_MAX_THREADS : cpus < 2 ? 2 : (int)cpus;
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&walk->threads[walk->thread_count], NULL, walk_thread, walk) != 0) break;
+        walk->thread_count++;
+    }
+    if (walk->thread_count == 0) {
+        ember_walker_release(walker);
+        return ember_make_nil();
+    }
+
+    ember_value value;
+    value.type = EMBER_VAL_WALKER;
+    value.as.obj_val = (ember_object*)walker;
+    vm->stack[vm->stack_top++] = value;
+    ember_value iterator = ember_make_iterator(vm, value, ITERATOR_WALK);
+    vm->stack_top--;
+    return iterator;
+}
@@ -4,6 +4,8 @@
  */
 
 #include "ember.h"
+#include "http_share.h"
+#include "../core/probes.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -48,6 +50,11 @@ static size_t write_memory_callback(void* contents, size_t size, size_t nmemb, h
     return realsize;
 }
 
+// libcurl callback for downloads: the body goes straight to the file
+static size_t write_file_callback(void* contents, size_t size, size_t nmemb, FILE* file) {
+    return fwrite(contents, size, nmemb, file) * size;
+}
+
 // Initialize HTTP subsystem
 int ember_http_init(void) {
     if (g_http_initialized) {
@@ -74,23 +81,25 @@ void ember_http_cleanup(void) {
     }
 }
 
-// Generic HTTP request function
+// Generic HTTP request function. With a sink the body is written there and
+// response->data stays empty; error statuses fail the request
 static http_response_t* http_request(const char* method, const char* url, const char* data, 
-                                   const char* headers[], const char* auth_token) {
+                                   const char* headers[], const char* auth_token, FILE* sink) {
     if (!g_http_initialized) {
         if (ember_http_init() != 0) {
             return NULL;
         }
     }
     
-    CURL* curl = curl_easy_init();
+    // Reused handle: connections, DNS and TLS sessions carry over
+    CURL* curl = http_handle_acquire();
     if (!curl) {
         return NULL;
     }
     
     http_response_t* response = malloc(sizeof(http_response_t));
     if (!response) {
-        curl_easy_cleanup(curl);
+        http_handle_release(curl);
         return NULL;
     }
     
@@ -127,8 +136,14 @@ static http_response_t* http_request(const char* method, const char* url, const
     // GET is default, no special handling needed
     
     // Set response callbacks
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_memory_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*)&chunk);
+    if (sink) {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_file_callback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*)sink);
+        curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    } else {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_memory_callback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*)&chunk);
+    }
     curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, write_memory_callback);
     curl_easy_setopt(curl, CURLOPT_HEADERDATA, (void*)&header_chunk);
     
@@ -168,21 +183,24 @@ static http_response_t* http_request(const char* method, const char* url, const
     }
     
     // Perform request
+    EMBER_PROBE3(http__request__start, curl, method, url);
     CURLcode res = curl_easy_perform(curl);
     
     if (res != CURLE_OK) {
+        EMBER_PROBE4(http__request__done, curl, 0L, (size_t)0, curl_easy_strerror(res));
         printf("HTTP: Request failed: %s\n", curl_easy_strerror(res));
         free(response);
         free(chunk.memory);
         free(header_chunk.memory);
         curl_slist_free_all(header_list);
-        curl_easy_cleanup(curl);
+        http_handle_release(curl);
         return NULL;
     }
     
     // Get response info
     curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response->response_code);
     curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &response->download_time);
+    EMBER_PROBE4(http__request__done, curl, response->response_code, chunk.size, (const char*)NULL);
     
     char* content_type = NULL;
     curl_easy_getinfo(curl, CURLINFO_CONTENT_TYPE, &content_type);
@@ -198,7 +216,7 @@ static http_response_t* http_request(const char* method, const char* url, const
     
     // Cleanup
     curl_slist_free_all(header_list);
-    curl_easy_cleanup(curl);
+    http_handle_release(curl);
     
     printf("HTTP: %s %s -> %ld (%.2fs, %zu bytes)\n", 
            method, url, response->response_code, response->download_time, response->size);
@@ -248,7 +266,7 @@ ember_value ember_native_http_get(ember_vm* vm, int argc, ember_value* argv) {
         auth_token = auth_str->chars;
     }
     
-    http_response_t* response = http_request("GET", url_str->chars, NULL, NULL, auth_token);
+    http_response_t* response = http_request("GET", url_str->chars, NULL, NULL, auth_token, NULL);
     return http_response_to_ember_object(vm, response);
 }
 
@@ -267,7 +285,7 @@ ember_value ember_native_http_post(ember_vm* vm, int argc, ember_value* argv) {
         auth_token = auth_str->chars;
     }
     
-    http_response_t* response = http_request("POST", url_str->chars, data_str->chars, NULL, auth_token);
+    http_response_t* response = http_request("POST", url_str->chars, data_str->chars, NULL, auth_token, NULL);
     return http_response_to_ember_object(vm, response);
 }
 
@@ -286,7 +304,7 @@ ember_value ember_native_http_put(ember_vm* vm, int argc, ember_value* argv) {
         auth_token = auth_str->chars;
     }
     
-    http_response_t* response = http_request("PUT", url_str->chars, data_str->chars, NULL, auth_token);
+    http_response_t* response = http_request("PUT", url_str->chars, data_str->chars, NULL, auth_token, NULL);
     return http_response_to_ember_object(vm, response);
 }
 
@@ -304,7 +322,7 @@ ember_value ember_native_http_delete(ember_vm* vm, int argc, ember_value* argv)
         auth_token = auth_str->chars;
     }
     
-    http_response_t* response = http_request("DELETE", url_str->chars, NULL, NULL, auth_token);
+    http_response_t* response = http_request("DELETE", url_str->chars, NULL, NULL, auth_token, NULL);
     return http_response_to_ember_object(vm, response);
 }
 
@@ -323,7 +341,7 @@ ember_value ember_native_http_patch(ember_vm* vm, int argc, ember_value* argv) {
         auth_token = auth_str->chars;
     }
     
-    http_response_t* response = http_request("PATCH", url_str->chars, data_str->chars, NULL, auth_token);
+    http_response_t* response = http_request("PATCH", url_str->chars, data_str->chars, NULL, auth_token, NULL);
     return http_response_to_ember_object(vm, response);
 }
 
@@ -336,23 +354,20 @@ ember_value ember_native_http_download(ember_vm* vm, int argc, ember_value* argv
     ember_string* url_str = AS_STRING(argv[0]);
     ember_string* file_str = AS_STRING(argv[1]);
     
-    http_response_t* response = http_request("GET", url_str->chars, NULL, NULL, NULL);
-    if (!response || response->response_code != 200) {
-        free_http_response(response);
-        return ember_make_bool(0);
-    }
-    
-    // Write to file
+    // Written as it arrives, so the body is never held in memory
     FILE* file = fopen(file_str->chars, "wb");
     if (!file) {
-        free_http_response(response);
         return ember_make_bool(0);
     }
     
-    size_t written = fwrite(response->data, 1, response->size, file);
-    fclose(file);
-    
-    int success = (written == response->size);
+    http_response_t* response = http_request("GET", url_str->chars, NULL, NULL, NULL, file);
+    int success = response && response->response_code == 200;
+    if (fclose(file) != 0) {
+        success = 0;
+    }
+    if (!success) {
+        remove(file_str->chars);
+    }
     free_http_response(response);
     
     return ember_make_bool(success);
@@ -0,0 +1,616 @@
+/**
+ * Non-blocking HTTP client for Ember: http.fetch, http.stream, http.download
+ * Transfers share one curl multi handle per VM, driven by the VM's event loop
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "ember.h"
+#include "../vm.h"
+#include "value/value.h"
+#include "http_share.h"
+#include "json_stream.h"
+#include "../core/probes.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// fetch(url [, method [, body [, auth_token]]]) starts the request and
+// returns a promise at once. curl's multi socket API tells us which sockets
+// to wait on and when to time out; those become one-shot watches and a
+// timer on the VM's event loop, so any number of transfers make progress
+// while the script runs, and each settles its promise from the loop: with
+// the response body on completion (whatever the status code, as http_get),
+// or rejected with an HTTPError if the transfer fails. Handles come from
+// the thread's cache and share DNS, TLS sessions and connections with
+// every other request (http_share.c).
+//
+// stream(url, on_chunk [, method [, body [, auth_token]]]) hands the body
+// to on_chunk piece by piece instead: curl's writes are collected while
+// curl runs and passed to the script once it returns, so only what arrived
+// in one loop turn is ever held. download(url, path [, auth_token]) writes
+// the body straight to a file at a VFS path. Both promises resolve with
+// the number of bytes received.
+//
+// stream_json(url, on_value [, elements [, method [, body [, auth_token]]]])
+// is stream with a JSON reader (json_stream.c) in between: on_value gets
+// each value of an NDJSON or concatenated-JSON body, or with elements each
+// element of a body that is one array, as soon as it has arrived. Its
+// promise resolves with the number of values.
+
+#define FETCH_MAX_SOCKETS_INITIAL 8
+
+typedef enum {
+    FETCH_BUFFER,                      // Whole body, resolved as a string
+    FETCH_STREAM,                      // Chunks to a script callback
+    FETCH_FILE                         // Written to a file as it arrives
+} fetch_mode;
+
+typedef struct {
+    char* memory;
+    size_t size;
+} fetch_buffer;
+
+typedef struct fetch_transfer {
+    CURL* easy;
+    fetch_mode mode;
+    fetch_buffer body;                 // FETCH_STREAM: not yet delivered
+    size_t received;
+    FILE* file;                        // FETCH_FILE
+    char* file_path;                   // Host path, removed if the transfer fails
+    ember_value on_chunk;              // FETCH_STREAM
+    json_reader* reader;               // FETCH_STREAM: on_chunk gets values, not chunks
+    int callback_failed;
+    struct curl_slist* header_list;
+    char* data;                        // Request body (owned; curl does not copy it)
+    ember_value promise;
+    struct fetch_transfer* next;
+} fetch_transfer;
+
+typedef struct {
+    curl_socket_t fd;
+    int events;                        // EMBER_LOOP_READ | EMBER_LOOP_WRITE
+} fetch_socket;
+
+typedef struct ember_http_client {
+    ember_vm* vm;
+    CURLM* multi;
+    int timer_id;                      // Loop timer for curl's timeout, 0 if none
+    fetch_transfer* transfers;         // In flight
+    fetch_socket* sockets;             // Sockets curl wants watched
+    int socket_count;
+    int socket_capacity;
+} ember_http_client;
+
+// Returning anything but realsize fails the transfer
+static size_t fetch_write(void* contents, size_t size, size_t nmemb, void* userdata) {
+    fetch_transfer* transfer = userdata;
+    size_t realsize = size * nmemb;
+    if (transfer->callback_failed) {
+        return 0;
+    }
+    if (transfer->mode == FETCH_FILE) {
+        if (fwrite(contents, 1, realsize, transfer->file) != realsize) {
+            return 0;
+        }
+        transfer->received += realsize;
+        return realsize;
+    }
+    fetch_buffer* buffer = &transfer->body;
+    char* memory = realloc(buffer->memory, buffer->size + realsize + 1);
+    if (!memory) {
+        return 0;
+    }
+    buffer->memory = memory;
+    memcpy(buffer->memory + buffer->size, contents, realsize);
+    buffer->size += realsize;
+    buffer->memory[buffer->size] = '\0';
+    transfer->received += realsize;
+    return realsize;
+}
+
+// ============================================================================
+// PROMISE ROOTS
+// ============================================================================
+
+// In-flight promises and stream callbacks may be unreachable from the
+// script, so they are kept in vm->pending_promises until settled
+static int keep_promise(ember_vm* vm, ember_value promise) {
+    if (!vm->pending_promises) {
+        ember_value array = ember_make_array(vm, 8);
+        if (array.type != EMBER_VAL_ARRAY) return 0;
+        vm->pending_promises = AS_ARRAY(array);
+    }
+    array_push_with_vm(vm, vm->pending_promises, promise);
+    return 1;
+}
+
+static void drop_promise(ember_vm* vm, ember_value promise) {
+    ember_array* pending = vm->pending_promises;
+    if (!pending) return;
+    for (int i = 0; i < pending->length; i++) {
+        if (pending->elements[i].as.obj_val == promise.as.obj_val) {
+            pending->elements[i] = pending->elements[--pending->length];
+            return;
+        }
+    }
+}
+
+// Both roots of a transfer; on_chunk is nil unless streaming
+static void drop_roots(ember_vm* vm, fetch_transfer* transfer) {
+    drop_promise(vm, transfer->promise);
+    if (transfer->mode == FETCH_STREAM) {
+        drop_promise(vm, transfer->on_chunk);
+    }
+}
+
+// ============================================================================
+// TRANSFERS
+// ============================================================================
+
+static void free_transfer(ember_http_client* client, fetch_transfer* transfer) {
+    if (transfer->easy) {
+        curl_multi_remove_handle(client->multi, transfer->easy);
+        http_handle_release(transfer->easy);
+    }
+    if (transfer->file) {
+        // Still open: the transfer did not complete
+        fclose(transfer->file);
+        remove(transfer->file_path);
+    }
+    curl_slist_free_all(transfer->header_list);
+    json_reader_free(transfer->reader);
+    free(transfer->body.memory);
+    free(transfer->file_path);
+    free(transfer->data);
+    free(transfer);
+}
+
+static void unlink_transfer(ember_http_client* client, fetch_transfer* transfer) {
+    fetch_transfer** link = &client->transfers;
+    while (*link && *link != transfer) link = &(*link)->next;
+    if (*link) *link = transfer->next;
+}
+
+// Passes what streaming transfers received to their callbacks. Runs after
+// curl returns, so the script may start or finish other transfers
+static void deliver_chunks(ember_http_client* client) {
+    ember_vm* vm = client->vm;
+    for (fetch_transfer* transfer = client->transfers; transfer; transfer = transfer->next) {
+        if (transfer->mode != FETCH_STREAM || transfer->body.size == 0 || transfer->callback_failed) {
+            continue;
+        }
+        if (transfer->reader) {
+            // The reader calls on_value for every value the chunk completes
+            if (json_reader_feed(transfer->reader, transfer->body.memory, transfer->body.size) != 0) {
+                transfer->callback_failed = 1;
+            }
+            transfer->body.size = 0;
+            continue;
+        }
+        ember_string* chunk = copy_string(vm, transfer->body.memory, (int)transfer->body.size);
+        transfer->body.size = 0;
+        ember_value argument;
+        argument.type = EMBER_VAL_STRING;
+        argument.as.obj_val = (ember_object*)chunk;
+        ember_value ignored;
+        if (!chunk || vm_call_value(vm, transfer->on_chunk, 1, &argument, &ignored) != 0) {
+            // The next write fails the transfer and rejects its promise
+            fprintf(stderr, "[HTTP] Stream callback failed\n");
+            vm->exception_pending = 0;
+            vm->current_exception = ember_make_nil();
+            transfer->callback_failed = 1;
+        }
+    }
+}
+
+// 0 when no response arrived
+static inline long response_status(CURL* easy) {
+    long status = 0;
+    curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+    return status;
+}
+
+// Settles the promise of every transfer curl reports as done
+static void collect_done(ember_http_client* client) {
+    ember_vm* vm = client->vm;
+    CURLMsg* message;
+    int remaining;
+    while ((message = curl_multi_info_read(client->multi, &remaining)) != NULL) {
+        if (message->msg != CURLMSG_DONE) continue;
+        fetch_transfer* transfer = NULL;
+        curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, (char**)&transfer);
+        if (!transfer) continue;
+        CURLcode result = message->data.result;
+        unlink_transfer(client, transfer);
+
+        const char* failure = result == CURLE_OK ? NULL : curl_easy_strerror(result);
+        if (!failure && transfer->reader) {
+            json_reader_finish(transfer->reader);
+        }
+        if (transfer->callback_failed) {
+            failure = "Stream callback failed";
+        }
+        if (transfer->reader && json_reader_error(transfer->reader)) {
+            failure = json_reader_error(transfer->reader);
+        }
+        if (transfer->file) {
+            FILE* file = transfer->file;
+            transfer->file = NULL;
+            if (fclose(file) != 0 && !failure) failure = "Failed to write download";
+            if (failure) remove(transfer->file_path);
+        }
+        EMBER_PROBE4(http__request__done, transfer, response_status(message->easy_handle),
+                     transfer->received, failure);
+
+        ember_value promise = transfer->promise;
+        if (failure) {
+            ember_promise_reject(vm, promise, ember_make_exception(vm, "HTTPError", failure));
+        } else if (transfer->reader) {
+            ember_promise_resolve(vm, promise, ember_make_number((double)json_reader_count(transfer->reader)));
+        } else if (transfer->mode == FETCH_BUFFER) {
+            ember_value body = transfer->body.memory
+                ? ember_make_string_gc(vm, transfer->body.memory)
+                : ember_make_string_gc(vm, "");
+            ember_promise_resolve(vm, promise, body);
+        } else {
+            ember_promise_resolve(vm, promise, ember_make_number((double)transfer->received));
+        }
+        drop_roots(vm, transfer);
+        free_transfer(client, transfer);
+    }
+}
+
+// ============================================================================
+// EVENT LOOP GLUE
+// ============================================================================
+
+static fetch_socket* find_socket(ember_http_client* client, curl_socket_t fd) {
+    for (int i = 0; i < client->socket_count; i++) {
+        if (client->sockets[i].fd == fd) return &client->sockets[i];
+    }
+    return NULL;
+}
+
+static void on_socket_ready(ember_vm* vm, int fd, int events, void* userdata);
+
+static void arm_socket(ember_http_client* client, const fetch_socket* sock) {
+    ember_loop_unwatch_fd(client->vm, (int)sock->fd);
+    ember_loop_watch_fd(client->vm, (int)sock->fd, sock->events, on_socket_ready, client);
+}
+
+static void on_socket_ready(ember_vm* vm, int fd, int events, void* userdata) {
+    ember_http_client* client = userdata;
+    int flags = 0;
+    if (events & EMBER_LOOP_READ) flags |= CURL_CSELECT_IN;
+    if (events & EMBER_LOOP_WRITE) flags |= CURL_CSELECT_OUT;
+    int running;
+    curl_multi_socket_action(client->multi, (curl_socket_t)fd, flags, &running);
+    deliver_chunks(client);
+    collect_done(client);
+    // Watches are one-shot; keep waiting while curl still wants the socket
+    fetch_socket* sock = find_socket(client, (curl_socket_t)fd);
+    if (sock) {
+        ember_loop_watch_fd(vm, fd, sock->events, on_socket_ready, client);
+    }
+}
+
+// CURLMOPT_SOCKETFUNCTION: what to wait for on s
+static int on_socket_change(CURL* easy, curl_socket_t s, int what, void* userp, void* socketp) {
+    (void)easy;
+    (void)socketp;
+    ember_http_client* client = userp;
+    fetch_socket* sock = find_socket(client, s);
+    if (what == CURL_POLL_REMOVE) {
+        if (sock) {
+            ember_loop_unwatch_fd(client->vm, (int)s);
+            *sock = client->sockets[--client->socket_count];
+        }
+        return 0;
+    }
+    if (!sock) {
+        if (client->socket_count == client->socket_capacity) {
+            int capacity = client->socket_capacity ? client->socket_capacity * 2 : FETCH_MAX_SOCKETS_INITIAL;
+            fetch_socket* sockets = realloc(client->sockets, sizeof(fetch_socket) * (size_t)capacity);
+            if (!sockets) return -1;
+            client->sockets = sockets;
+            client->socket_capacity = capacity;
+        }
+        sock = &client->sockets[client->socket_count++];
+        sock->fd = s;
+    }
+    sock->events = 0;
+    if (what == CURL_POLL_IN || what == CURL_POLL_INOUT) sock->events |= EMBER_LOOP_READ;
+    if (what == CURL_POLL_OUT || what == CURL_POLL_INOUT) sock->events |= EMBER_LOOP_WRITE;
+    arm_socket(client, sock);
+    return 0;
+}
+
+static void on_timeout(ember_vm* vm, void* userdata) {
+    (void)vm;
+    ember_http_client* client = userdata;
+    client->timer_id = 0;
+    int running;
+    curl_multi_socket_action(client->multi, CURL_SOCKET_TIMEOUT, 0, &running);
+    deliver_chunks(client);
+    collect_done(client);
+}
+
+// CURLMOPT_TIMERFUNCTION: replace the single timeout; -1 removes it
+static int on_timer_change(CURLM* multi, long timeout_ms, void* userp) {
+    (void)multi;
+    ember_http_client* client = userp;
+    if (client->timer_id > 0) {
+        ember_loop_cancel_timer(client->vm, client->timer_id);
+        client->timer_id = 0;
+    }
+    if (timeout_ms >= 0) {
+        int id = ember_loop_add_timer(client->vm, (double)timeout_ms, on_timeout, client);
+        client->timer_id = id > 0 ? id : 0;
+    }
+    return 0;
+}
+
+// Loop close hook: transfers still in flight are abandoned with their VM
+static void free_client(ember_vm* vm, void* userdata) {
+    ember_http_client* client = userdata;
+    while (client->transfers) {
+        fetch_transfer* transfer = client->transfers;
+        client->transfers = transfer->next;
+        drop_roots(vm, transfer);
+        free_transfer(client, transfer);
+    }
+    curl_multi_cleanup(client->multi);
+    free(client->sockets);
+    free(client);
+    if (vm->http_client == client) {
+        vm->http_client = NULL;
+    }
+}
+
+static ember_http_client* get_client(ember_vm* vm) {
+    if (vm->http_client) return vm->http_client;
+    if (!http_share_init()) {
+        return NULL;
+    }
+    ember_http_client* client = calloc(1, sizeof(ember_http_client));
+    if (!client) {
+        fprintf(stderr, "[HTTP] Memory allocation failed for HTTP client\n");
+        return NULL;
+    }
+    client->vm = vm;
+    client->multi = curl_multi_init();
+    if (!client->multi || ember_loop_on_close(vm, free_client, client) != EMBER_SUCCESS) {
+        if (client->multi) curl_multi_cleanup(client->multi);
+        free(client);
+        return NULL;
+    }
+    curl_multi_setopt(client->multi, CURLMOPT_SOCKETFUNCTION, on_socket_change);
+    curl_multi_setopt(client->multi, CURLMOPT_SOCKETDATA, client);
+    curl_multi_setopt(client->multi, CURLMOPT_TIMERFUNCTION, on_timer_change);
+    curl_multi_setopt(client->multi, CURLMOPT_TIMERDATA, client);
+    vm->http_client = client;
+    return client;
+}
+
+// ============================================================================
+// NATIVE
+// ============================================================================
+
+static int setup_transfer(fetch_transfer* transfer, const char* method, const char* url,
+                          const char* data, const char* auth_token) {
+    CURL* easy = transfer->easy;
+    curl_easy_setopt(easy, CURLOPT_URL, url);
+    curl_easy_setopt(easy, CURLOPT_PRIVATE, (char*)transfer);
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, fetch_write);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, (void*)transfer);
+    curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(easy, CURLOPT_MAXREDIRS, 5L);
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT, 30L);
+    curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT, 10L);
+    curl_easy_setopt(easy, CURLOPT_SSL_VERIFYPEER, 1L);
+    curl_easy_setopt(easy, CURLOPT_SSL_VERIFYHOST, 2L);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_USERAGENT, "EmberWeb/2.0.0 (Ember HTTP Client)");
+    if (transfer->mode == FETCH_FILE || transfer->reader) {
+        // An error page is not the file or the document that was asked for
+        curl_easy_setopt(easy, CURLOPT_FAILONERROR, 1L);
+    }
+
+    if (strcmp(method, "GET") != 0) {
+        curl_easy_setopt(easy, CURLOPT_CUSTOMREQUEST, method);
+    }
+    if (data) {
+        transfer->data = strdup(data);
+        if (!transfer->data) return 0;
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDS, transfer->data);
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, (long)strlen(transfer->data));
+        transfer->header_list = curl_slist_append(transfer->header_list, "Content-Type: application/json");
+    }
+    if (auth_token) {
+        size_t length = strlen(auth_token) + sizeof("Authorization: Bearer ");
+        char* header = malloc(length);
+        if (!header) return 0;
+        snprintf(header, length, "Authorization: Bearer %s", auth_token);
+        transfer->header_list = curl_slist_append(transfer->header_list, header);
+        free(header);
+    }
+    if (transfer->header_list) {
+        curl_easy_setopt(easy, CURLOPT_HTTPHEADER, transfer->header_list);
+    }
+    return 1;
+}
+
+static int valid_method(const char* method) {
+    static const char* const methods[] = {"GET", "POST", "PUT", "DELETE", "PATCH", "HEAD", NULL};
+    for (int i = 0; methods[i]; i++) {
+        if (strcmp(method, methods[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+static int optional_strings(int argc, ember_value* argv, int first) {
+    for (int i = first; i < argc; i++) {
+        if (argv[i].type != EMBER_VAL_STRING && argv[i].type != EMBER_VAL_NIL) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static const char* optional_string(int argc, ember_value* argv, int index) {
+    return index < argc && argv[index].type == EMBER_VAL_STRING ? AS_CSTRING(argv[index]) : NULL;
+}
+
+// Starts transfer on the VM's multi handle; frees it and returns nil on
+// failure. FETCH_STREAM transfers have on_chunk set, FETCH_FILE ones their
+// file open
+static ember_value start_transfer(ember_vm* vm, ember_http_client* client, fetch_transfer* transfer,
+                                  const char* method, const char* url, const char* data,
+                                  const char* auth_token) {
+    transfer->promise = ember_make_nil();
+    transfer->easy = http_handle_acquire();
+    if (!transfer->easy || !setup_transfer(transfer, method, url, data, auth_token)) {
+        free_transfer(client, transfer);
+        return ember_make_nil();
+    }
+
+    if (transfer->mode == FETCH_STREAM && !keep_promise(vm, transfer->on_chunk)) {
+        free_transfer(client, transfer);
+        return ember_make_nil();
+    }
+    transfer->promise = ember_make_promise(vm);
+    if (transfer->promise.type != EMBER_VAL_PROMISE || !keep_promise(vm, transfer->promise)) {
+        if (transfer->mode == FETCH_STREAM) drop_promise(vm, transfer->on_chunk);
+        free_transfer(client, transfer);
+        return ember_make_nil();
+    }
+    // curl asks for its first timeout from here; nothing runs until the loop does
+    if (curl_multi_add_handle(client->multi, transfer->easy) != CURLM_OK) {
+        drop_roots(vm, transfer);
+        free_transfer(client, transfer);
+        return ember_make_nil();
+    }
+    transfer->next = client->transfers;
+    client->transfers = transfer;
+    EMBER_PROBE3(http__request__start, transfer, method, url);
+    return transfer->promise;
+}
+
+// fetch(url [, method [, body [, auth_token]]]): a promise for the response body
+ember_value ember_native_http_fetch(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc < 1 || argc > 4 || argv[0].type != EMBER_VAL_STRING || !optional_strings(argc, argv, 1)) {
+        return ember_make_nil();
+    }
+    const char* method = optional_string(argc, argv, 1);
+    if (!method) method = "GET";
+    if (!valid_method(method)) {
+        return ember_make_nil();
+    }
+
+    ember_http_client* client = get_client(vm);
+    if (!client) return ember_make_nil();
+    fetch_transfer* transfer = calloc(1, sizeof(fetch_transfer));
+    if (!transfer) return ember_make_nil();
+    transfer->mode = FETCH_BUFFER;
+    return start_transfer(vm, client, transfer, method, AS_CSTRING(argv[0]),
+                          optional_string(argc, argv, 2), optional_string(argc, argv, 3));
+}
+
+static int is_callable(ember_value value) {
+    return value.type == EMBER_VAL_FUNCTION || value.type == EMBER_VAL_NATIVE;
+}
+
+// stream(url, on_chunk [, method [, body [, auth_token]]]): on_chunk(string)
+// for each piece of the body; a promise for the number of bytes
+ember_value ember_native_http_stream(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc < 2 || argc > 5 || argv[0].type != EMBER_VAL_STRING || !is_callable(argv[1]) ||
+        !optional_strings(argc, argv, 2)) {
+        return ember_make_nil();
+    }
+    const char* method = optional_string(argc, argv, 2);
+    if (!method) method = "GET";
+    if (!valid_method(method)) {
+        return ember_make_nil();
+    }
+
+    ember_http_client* client = get_client(vm);
+    if (!client) return ember_make_nil();
+    fetch_transfer* transfer = calloc(1, sizeof(fetch_transfer));
+    if (!transfer) return ember_make_nil();
+    transfer->mode = FETCH_STREAM;
+    transfer->on_chunk = argv[1];
+    return start_transfer(vm, client, transfer, method, AS_CSTRING(argv[0]),
+                          optional_string(argc, argv, 3), optional_string(argc, argv, 4));
+}
+
+static int emit_value(ember_vm* vm, ember_value value, void* context) {
+    fetch_transfer* transfer = context;
+    ember_value ignored;
+    if (vm_call_value(vm, transfer->on_chunk, 1, &value, &ignored) != 0) {
+        fprintf(stderr, "[HTTP] Stream callback failed\n");
+        vm->exception_pending = 0;
+        vm->current_exception = ember_make_nil();
+        return -1;
+    }
+    return 0;
+}
+
+// stream_json(url, on_value [, elements [, method [, body [, auth_token]]]]):
+// on_value(value) for each JSON value of the body; a promise for the count
+ember_value ember_native_http_stream_json(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc < 2 || argc > 6 || argv[0].type != EMBER_VAL_STRING || !is_callable(argv[1]) ||
+        (argc > 2 && argv[2].type != EMBER_VAL_BOOL && argv[2].type != EMBER_VAL_NIL) ||
+        !optional_strings(argc, argv, 3)) {
+        return ember_make_nil();
+    }
+    const char* method = optional_string(argc, argv, 3);
+    if (!method) method = "GET";
+    if (!valid_method(method)) {
+        return ember_make_nil();
+    }
+
+    ember_http_client* client = get_client(vm);
+    if (!client) return ember_make_nil();
+    fetch_transfer* transfer = calloc(1, sizeof(fetch_transfer));
+    if (!transfer) return ember_make_nil();
+    transfer->mode = FETCH_STREAM;
+    transfer->on_chunk = argv[1];
+    int elements = argc > 2 && argv[2].type == EMBER_VAL_BOOL && argv[2].as.bool_val;
+    transfer->reader = json_reader_new(vm, elements, emit_value, transfer);
+    if (!transfer->reader) {
+        free(transfer);
+        return ember_make_nil();
+    }
+    return start_transfer(vm, client, transfer, method, AS_CSTRING(argv[0]),
+                          optional_string(argc, argv, 4), optional_string(argc, argv, 5));
+}
+
+// download(url, path [, auth_token]): writes the body to the VFS path; a
+// promise for the number of bytes. Nothing is left at path if it fails
+ember_value ember_native_http_download_async(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc < 2 || argc > 3 || argv[0].type != EMBER_VAL_STRING || argv[1].type != EMBER_VAL_STRING ||
+        !optional_strings(argc, argv, 2)) {
+        return ember_make_nil();
+    }
+    const char* path = AS_CSTRING(argv[1]);
+    if (!ember_vfs_check_access(vm, path, 1)) {
+        return ember_make_nil();
+    }
+
+    ember_http_client* client = get_client(vm);
+    if (!client) return ember_make_nil();
+    fetch_transfer* transfer = calloc(1, sizeof(fetch_transfer));
+    if (!transfer) return ember_make_nil();
+    transfer->mode = FETCH_FILE;
+    transfer->file_path = ember_vfs_resolve(vm, path);
+    if (transfer->file_path) {
+        transfer->file = fopen(transfer->file_path, "wb");
+    }
+    if (!transfer->file) {
+        free_transfer(client, transfer);
+        return ember_make_nil();
+    }
+    return start_transfer(vm, client, transfer, "GET", AS_CSTRING(argv[0]), NULL,
+                          optional_string(argc, argv, 2));
+}
@@ -0,0 +1,2725 @@
+/**
+ * HTTP/1.1 server: http_listen_and_serve / http_stop_server and the
+ * request_* / response_* natives a handler calls, plus the
+ * ember_http_server_* C API they are built on.
+ *
+ * A fixed set of worker threads each run their own event loop over their
+ * own listening socket (SO_REUSEPORT, so the kernel spreads connections
+ * across them) and hold one VM from ember_pool_get_vm for their whole
+ * life, as executor workers do: the prelude defining the handler runs once
+ * per worker and the handler's function handle, globals and inline caches
+ * stay warm across requests.
+ *
+ * The loop runs on io_uring where the kernel has it (5.10 on), and on
+ * epoll otherwise. On io_uring every accept, receive and send is a request
+ * and one io_uring_enter both hands over the ones the last round of
+ * completions made and waits for the next round, where epoll takes a call
+ * per readiness event, read and write. The listener, the wake eventfd and
+ * each connection sit in the ring's fixed-file table, and connections
+ * receive into registered buffers until they need more room.
+ *
+ * Requests are parsed in place: the method, target and header fields are
+ * offsets into the connection's receive buffer, and a string is made only
+ * for the parts a handler asks for. A large body is read straight into a
+ * buffer of its own that request_get_body's string takes over. Connections
+ * are kept alive and pipelined requests are served in order from the same
+ * buffer; their responses queue up and go out together in one gathered
+ * write (sendmsg, writev's socket form, which can't raise SIGPIPE), the
+ * head of each response and its body as separate pieces. Long strings a
+ * handler writes aren't copied into the body either: the response is
+ * gathered from their bytes, and only what the socket can't take at once
+ * is copied to wait for it.
+ *
+ * The handler is a global function the prelude defines, called as
+ * handler(method, path). What it writes with response_write, or else the
+ * string it returns, is the body. Request bodies need a Content-Length;
+ * chunked request bodies are answered with 501.
+ *
+ * A handler that calls websocket_upgrade turns its connection into a
+ * WebSocket once it returns (framing in websocket.c). Its frames are read
+ * from the same receive buffer, and each message is handed to the message
+ * handler it named on the worker holding the socket. A frame sent to many
+ * sockets is encoded once into a reference-counted buffer: a socket with
+ * nothing queued gets it straight away, the rest queue the shared buffer
+ * itself. Frames for sockets on other workers go through their mailbox,
+ * an eventfd their loop watches, and one buffer serves every worker.
+ *
+ * Bodies are compressed (compress.c) when the client's Accept-Encoding
+ * allows and the handler left Content-Encoding alone: text-like types of
+ * HTTP_COMPRESS_MIN bytes or more, streamed from the parts the handler
+ * wrote at a fast level, on the worker thread's cached compressor.
+ * response_send_file serves a file from a process-wide cache instead, each
+ * coding of it compressed once at the codec's best level the first time a
+ * client asks for it, and every response after queues the cached buffer
+ * itself.
+ */
+
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../vm.h"
+#include "value/value.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "../core/io_ring.h"
+#include "compress.h"
+#include "websocket.h"
+
+#define HTTP_WORKERS_MAX 256
+#define HTTP_EVENTS 64
+#define HTTP_BUFFER_INITIAL 8192
+#define HTTP_MAX_HEAD (16 * 1024)
+#define HTTP_MAX_BODY (8 * 1024 * 1024)
+#define HTTP_MAX_HEADERS 64
+#define HTTP_MAX_QUEUED (1 << 20)            // Response bytes waiting before pipelined requests wait too
+#define HTTP_IOV_BATCH 64
+#define HTTP_LARGE (16 * 1024)               // Bodies and written strings this long are not copied
+#define HTTP_RING_ENTRIES 256
+#define HTTP_RING_FILES 1024                 // Fixed-file slots: the listener, the wake eventfd, connections
+#define HTTP_RING_BUFFERS 256                // Registered receive buffers of HTTP_BUFFER_INITIAL bytes
+#define WS_MAX_QUEUED (4 * HTTP_MAX_QUEUED)  // Frames waiting on a WebSocket before it is dropped as too slow
+#define HTTP_COMPRESS_MIN 1024               // Shorter bodies aren't worth a compressor's framing
+#define HTTP_STATIC_MAX_FILE (16 * 1024 * 1024)  // Largest file response_send_file serves
+#define HTTP_STATIC_CACHE (64 * 1024 * 1024)     // Cached file bytes, every coding counted
+#define HTTP_STATIC_BUCKETS 256
+
+// What an io_uring completion is for: the low bits of its user_data, over
+// the connection's address for receives and sends. 0 marks a cancel
+enum { RING_RECEIVE = 1, RING_SEND = 2, RING_ACCEPT = 3, RING_WAKE = 4, RING_MAIL = 5 };
+#define RING_TAG_MASK 7u
+#define RING_SLOT_LISTENER 0
+#define RING_SLOT_WAKE 1
+
+// A header field as offsets into the receive buffer
+typedef struct {
+    uint32_t name, name_length;
+    uint32_t value, value_length;
+} http_header_view;
+
+typedef struct {
+    uint32_t method, method_length;
+    uint32_t path, path_length;
+    uint32_t query, query_length;            // After '?', or 0 long
+    int minor_version;
+    http_header_view headers[HTTP_MAX_HEADERS];
+    int header_count;
+    size_t head_length;                      // Through the blank line
+    size_t body_length;
+    int keep_alive;
+} http_request;
+
+// A reference-counted buffer shared by every connection it is queued on:
+// an encoded server frame, or a static file as cached
+typedef struct {
+    int refs;
+    size_t length;
+    char data[];
+} http_shared;
+
+typedef struct {
+    char* data;
+    size_t length;
+    http_shared* shared;                     // data points into it, which is released rather than freed
+} http_piece;
+
+// Frames another worker sent this one's WebSockets
+typedef struct ws_post {
+    http_shared* frame;
+    uint64_t* ids;                           // NULL: every WebSocket on the worker
+    size_t id_count;
+    int closing;                             // A close frame: each socket closes after it
+    struct ws_post* next;
+} ws_post;
+
+// A message handler websocket_upgrade named, resolved on the worker's VM
+typedef struct {
+    char* name;
+    ember_function_handle* handle;
+} ws_handler;
+
+typedef struct http_connection {
+    int fd;
+    char* in;                                // Received bytes; requests start at in_start
+    size_t in_start, in_length, in_capacity;
+    size_t scanned;                          // Bytes after in_start searched for the end of the head
+    int continued;                           // Sent "100 Continue" for the request being read
+    char* body;                              // A large body being read straight into its own buffer
+    size_t body_length, body_received;
+    http_piece* out;                         // Queued response pieces
+    int out_count, out_capacity;
+    size_t out_offset;                       // Already sent of out[0]
+    size_t out_bytes;
+    int closing;                             // Close once out drains
+    int peer_closed;
+    int writing;                             // Watching for EPOLLOUT
+    // io_uring only
+    int slot;                                // Fixed-file slot, or -1
+    int buffer;                              // Registered buffer in is, or -1
+    int reading;                             // A receive is in flight...
+    int reading_body;                        // ...into body rather than in
+    int sending;                             // A send of out's first pieces is in flight
+    int dead;                                // Closed once its requests in flight end
+    struct msghdr message;                   // The send in flight
+    struct iovec iov[HTTP_IOV_BATCH];
+    // WebSocket only
+    int websocket;                           // Upgraded: in holds frames, not requests
+    uint64_t ws_id;
+    int ws_handler;                          // Index into the worker's ws_handlers
+    ws_reader ws;
+    int flush_pending;                       // On the worker's flush list
+    int dropped;                             // Too slow for the frames sent it: closed at the flush
+    struct http_connection* flush_next;
+    struct http_connection* prev;
+    struct http_connection* next;
+} http_connection;
+
+typedef struct {
+    char* data;
+    size_t length, capacity;
+} http_buffer;
+
+typedef struct http_worker {
+    ember_http_server* server;
+    int listen_fd;
+    int epoll_fd;
+    io_ring* ring;                           // Drives the loop instead of epoll_fd
+    int ring_pending;                        // Requests in flight, but for cancels
+    int* free_slots;                         // Fixed-file slots for connections
+    int free_slot_count;
+    char* buffers;                           // HTTP_RING_BUFFERS registered receive buffers
+    int* free_buffers;
+    int free_buffer_count;
+    ember_vm* vm;
+    int pooled;
+    ember_function_handle* handler;
+    http_connection* connections;
+    time_t date_second;                      // The second date was formatted for
+    char date[40];
+    pthread_t thread;
+    int index;
+    int stopping;                            // Tearing down: closed WebSockets aren't reported
+    ws_handler* ws_handlers;
+    int ws_handler_count;
+    http_connection** ws_table;              // WebSockets by ID, open addressing
+    size_t ws_capacity, ws_count;
+    uint64_t ws_serial;
+    int ws_live;                             // ws_count, read by other workers' broadcasts
+    http_connection* flush_list;             // Connections frames were queued on, flushed at the loop's turn
+    pthread_mutex_t mail_lock;
+    ws_post* mail;                           // Newest first
+    int mail_fd;                             // eventfd, readable once mail has come
+} http_worker;
+
+struct ember_http_server {
+    http_worker* workers;
+    int worker_count;
+    int port;
+    int wake_fd;                             // eventfd, readable once stopping
+    const char* prelude;                     // Only read while workers start
+    const char* handler_name;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int started;                             // Workers that finished VM setup
+    int failed;
+    int stop_requested;                      // By http_stop_server
+};
+
+// A run of a response body: the bytes of a long string the handler wrote,
+// or a range of the exchange's body buffer, where short writes gather
+typedef struct {
+    const char* data;                        // NULL: body.data[offset, offset + length)
+    size_t offset, length;
+} http_body_part;
+
+// The request a handler on this thread is serving
+typedef struct {
+    http_worker* worker;
+    http_connection* connection;
+    const http_request* request;
+    ember_value* roots;                      // Stack slots: the request body string, then the written strings
+    int body_taken;                          // roots[0] holds request_get_body's value
+    int status;
+    http_buffer headers;                     // "Name: value\r\n" lines the handler set
+    http_buffer body;
+    http_body_part* parts;                   // Once a long string is written: the whole body, in order
+    int part_count, part_capacity;
+    size_t body_length;
+    int has_content_type;
+    int compressible;                        // Its Content-Type is worth compressing, as text/plain is
+    int has_content_encoding;                // The handler's own: the body is sent as it is
+    http_shared* file;                       // response_send_file's body, a reference to the cached buffer
+    compress_encoding file_coding;           // ...and its Content-Encoding
+    int ended;
+    int upgrade;                             // websocket_upgrade accepted the handshake
+    uint64_t ws_id;
+    int ws_handler;
+    char ws_accept[29];
+} http_exchange;
+
+static __thread http_exchange* http_current = NULL;
+// The worker whose handler (request or WebSocket message) is running
+static __thread http_worker* http_current_worker = NULL;
+
+// ============================================================================
+// BUFFERS
+// ============================================================================
+
+static int buffer_append(http_buffer* buffer, const char* data, size_t length) {
+    if (buffer->capacity - buffer->length < length) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 256;
+        while (capacity - buffer->length < length) capacity *= 2;
+        char* grown = realloc(buffer->data, capacity);
+        if (!grown) return 0;
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    return 1;
+}
+
+static int buffer_printf(http_buffer* buffer, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+static int buffer_printf(http_buffer* buffer, const char* format, ...) {
+    char line[128];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    return length >= 0 && (size_t)length < sizeof(line) && buffer_append(buffer, line, (size_t)length);
+}
+
+// ============================================================================
+// PARSING
+// ============================================================================
+
+static int is_token_char(unsigned char c) {
+    return c > 32 && c < 127 && !strchr("()<>@,;:\\\"/[]?={}", c);
+}
+
+static int view_equals(const char* base, uint32_t at, uint32_t length, const char* text) {
+    size_t text_length = strlen(text);
+    return length == text_length && strncasecmp(base + at, text, text_length) == 0;
+}
+
+// Whether a comma-separated header value lists token, ignoring case
+static int view_lists(const char* base, uint32_t at, uint32_t length, const char* token) {
+    size_t token_length = strlen(token);
+    const char* item = base + at;
+    const char* end = item + length;
+    while (item < end) {
+        while (item < end && (*item == ' ' || *item == '\t' || *item == ',')) item++;
+        const char* stop = item;
+        while (stop < end && *stop != ',') stop++;
+        const char* last = stop;
+        while (last > item && (last[-1] == ' ' || last[-1] == '\t')) last--;
+        if ((size_t)(last - item) == token_length && strncasecmp(item, token, token_length) == 0) return 1;
+        item = stop;
+    }
+    return 0;
+}
+
+// Parses the request at the start of connection's unread bytes: 1 when it
+// and its body have arrived, 0 when more is needed, or the error status
+// to answer with, negated
+static int http_parse(http_connection* connection, http_request* request) {
+    const char* base = connection->in;
+    size_t start = connection->in_start;
+    size_t available = connection->in_length - start;
+    const char* head = base + start;
+
+    // Blank lines between pipelined requests are allowed
+    size_t skip = 0;
+    while (skip + 1 < available && head[skip] == '\r' && head[skip + 1] == '\n') skip += 2;
+    if (skip) {
+        connection->in_start += skip;
+        connection->scanned = connection->scanned > skip ? connection->scanned - skip : 0;
+        return http_parse(connection, request);
+    }
+
+    size_t from = connection->scanned > 3 ? connection->scanned - 3 : 0;
+    const char* end = from < available ? memmem(head + from, available - from, "\r\n\r\n", 4) : NULL;
+    if (!end) {
+        connection->scanned = available;
+        return available > HTTP_MAX_HEAD ? -431 : 0;
+    }
+    size_t head_length = (size_t)(end - head) + 4;
+    if (head_length > HTTP_MAX_HEAD) return -431;
+
+    memset(request, 0, offsetof(http_request, headers));
+    request->header_count = 0;
+    request->head_length = head_length;
+
+    // Request line: METHOD SP target SP HTTP/1.x
+    const char* at = head;
+    const char* line_end = memchr(at, '\r', head_length);
+    const char* space = at;
+    while (space < line_end && is_token_char((unsigned char)*space)) space++;
+    if (space == at || space >= line_end || *space != ' ') return -400;
+    request->method = (uint32_t)(at - base);
+    request->method_length = (uint32_t)(space - at);
+    const char* target = space + 1;
+    const char* target_end = target;
+    while (target_end < line_end && *target_end != ' ') {
+        if ((unsigned char)*target_end < 33 || *target_end == 127) return -400;
+        target_end++;
+    }
+    if (target_end == target || target_end + 9 != line_end || memcmp(target_end, " HTTP/1.", 8) != 0 ||
+        (target_end[8] != '0' && target_end[8] != '1')) {
+        return -400;
+    }
+    request->minor_version = target_end[8] - '0';
+    const char* question = memchr(target, '?', (size_t)(target_end - target));
+    request->path = (uint32_t)(target - base);
+    request->path_length = (uint32_t)((question ? question : target_end) - target);
+    if (question) {
+        request->query = (uint32_t)(question + 1 - base);
+        request->query_length = (uint32_t)(target_end - question - 1);
+    }
+
+    // Header fields
+    int has_length = 0;
+    int close = request->minor_version == 0;
+    size_t body_length = 0;
+    at = line_end + 2;
+    while (at < end + 2) {
+        line_end = memchr(at, '\r', (size_t)(end + 2 - at));
+        if (!line_end || line_end[1] != '\n') return -400;
+        const char* colon = at;
+        while (colon < line_end && is_token_char((unsigned char)*colon)) colon++;
+        if (colon == at || colon >= line_end || *colon != ':') return -400;
+        const char* value = colon + 1;
+        while (value < line_end && (*value == ' ' || *value == '\t')) value++;
+        const char* value_end = line_end;
+        while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t')) value_end--;
+        if (request->header_count == HTTP_MAX_HEADERS) return -431;
+        http_header_view* header = &request->headers[request->header_count++];
+        header->name = (uint32_t)(at - base);
+        header->name_length = (uint32_t)(colon - at);
+        header->value = (uint32_t)(value - base);
+        header->value_length = (uint32_t)(value_end - value);
+
+        if (view_equals(base, header->name, header->name_length, "content-length")) {
+            size_t length = 0;
+            if (value == value_end) return -400;
+            for (const char* digit = value; digit < value_end; digit++) {
+                if (*digit < '0' || *digit > '9') return -400;
+                length = length * 10 + (size_t)(*digit - '0');
+                if (length > HTTP_MAX_BODY) return -413;
+            }
+            if (has_length && length != body_length) return -400;
+            has_length = 1;
+            body_length = length;
+        } else if (view_equals(base, header->name, header->name_length, "transfer-encoding")) {
+            return -501;
+        } else if (view_equals(base, header->name, header->name_length, "connection")) {
+            if (view_lists(base, header->value, header->value_length, "close")) close = 1;
+            if (view_lists(base, header->value, header->value_length, "keep-alive")) close = 0;
+        }
+        at = line_end + 2;
+    }
+    request->keep_alive = !close;
+    request->body_length = body_length;
+    if (connection->body ? connection->body_received < body_length : available - head_length < body_length) {
+        connection->scanned = head_length - 4;
+        return 0;
+    }
+    return 1;
+}
+
+// The request's header named name, ignoring case; NULL if absent
+static const http_header_view* request_header(const char* base, const http_request* request, const char* name,
+                                              size_t length) {
+    for (int i = 0; i < request->header_count; i++) {
+        const http_header_view* header = &request->headers[i];
+        if (header->name_length == length && strncasecmp(base + header->name, name, length) == 0) return header;
+    }
+    return NULL;
+}
+
+// ============================================================================
+// RESPONSES
+// ============================================================================
+
+static const char* status_reason(int status) {
+    switch (status) {
+        case 100: return "Continue";
+        case 200: return "OK";
+        case 201: return "Created";
+        case 202: return "Accepted";
+        case 204: return "No Content";
+        case 301: return "Moved Permanently";
+        case 302: return "Found";
+        case 303: return "See Other";
+        case 304: return "Not Modified";
+        case 307: return "Temporary Redirect";
+        case 308: return "Permanent Redirect";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 409: return "Conflict";
+        case 413: return "Content Too Large";
+        case 415: return "Unsupported Media Type";
+        case 422: return "Unprocessable Content";
+        case 429: return "Too Many Requests";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        default: return status < 400 ? "OK" : status < 500 ? "Client Error" : "Server Error";
+    }
+}
+
+static const char* worker_date(http_worker* worker) {
+    time_t now = time(NULL);
+    if (now != worker->date_second) {
+        struct tm tm;
+        gmtime_r(&now, &tm);
+        strftime(worker->date, sizeof(worker->date), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        worker->date_second = now;
+    }
+    return worker->date;
+}
+
+static int piece_add(http_connection* connection, char* data, size_t length, http_shared* shared) {
+    if (connection->out_count == connection->out_capacity) {
+        int capacity = connection->out_capacity ? connection->out_capacity * 2 : 8;
+        http_piece* out = realloc(connection->out, sizeof(http_piece) * (size_t)capacity);
+        if (!out) return 0;
+        connection->out = out;
+        connection->out_capacity = capacity;
+    }
+    connection->out[connection->out_count].data = data;
+    connection->out[connection->out_count].length = length;
+    connection->out[connection->out_count].shared = shared;
+    connection->out_count++;
+    connection->out_bytes += length;
+    return 1;
+}
+
+// Adds a piece to connection's output; data is taken over, and freed on failure
+static int queue_piece(http_connection* connection, char* data, size_t length) {
+    if (length == 0) {
+        free(data);
+        return 1;
+    }
+    if (!piece_add(connection, data, length, NULL)) {
+        free(data);
+        return 0;
+    }
+    return 1;
+}
+
+static http_shared* shared_new(size_t length) {
+    http_shared* shared = malloc(sizeof(http_shared) + length);
+    if (!shared) return NULL;
+    shared->refs = 1;
+    shared->length = length;
+    return shared;
+}
+
+static void shared_release(http_shared* shared) {
+    if (__atomic_sub_fetch(&shared->refs, 1, __ATOMIC_ACQ_REL) == 0) free(shared);
+}
+
+// Queues the rest of shared from offset on, holding a reference to it
+static int queue_shared(http_connection* connection, http_shared* shared, size_t offset) {
+    if (!piece_add(connection, shared->data + offset, shared->length - offset, shared)) return 0;
+    __atomic_add_fetch(&shared->refs, 1, __ATOMIC_RELAXED);
+    return 1;
+}
+
+static void piece_free(http_piece* piece) {
+    if (piece->shared) {
+        shared_release(piece->shared);
+    } else {
+        free(piece->data);
+    }
+}
+
+// The head of a response with a body_length-byte body in coding. vary: the
+// coding depended on Accept-Encoding
+static int response_head(http_worker* worker, http_connection* connection, http_buffer* head, int status,
+                         const http_buffer* extra, int has_content_type, size_t body_length,
+                         compress_encoding coding, int vary) {
+    int ok = buffer_printf(head, "HTTP/1.1 %d %s\r\nDate: %s\r\nContent-Length: %zu\r\n", status,
+                           status_reason(status), worker_date(worker), body_length);
+    if (!has_content_type && body_length > 0) {
+        ok = ok && buffer_append(head, "Content-Type: text/plain; charset=utf-8\r\n", 41);
+    }
+    if (coding != COMPRESS_NONE) {
+        ok = ok && buffer_printf(head, "Content-Encoding: %s\r\n", compress_encoding_name(coding));
+    }
+    if (vary) ok = ok && buffer_append(head, "Vary: Accept-Encoding\r\n", 23);
+    if (extra && extra->length) ok = ok && buffer_append(head, extra->data, extra->length);
+    if (connection->closing) ok = ok && buffer_append(head, "Connection: close\r\n", 19);
+    return ok && buffer_append(head, "\r\n", 2);
+}
+
+static void queue_error(http_worker* worker, http_connection* connection, int status) {
+    http_buffer response = {0};
+    const char* reason = status_reason(status);
+    connection->closing = 1;
+    if (response_head(worker, connection, &response, status, NULL, 0, strlen(reason), COMPRESS_NONE, 0) &&
+        buffer_append(&response, reason, strlen(reason))) {
+        queue_piece(connection, response.data, response.length);
+    } else {
+        free(response.data);
+    }
+}
+
+// Sends what is queued: 1 when it all went, 0 when the socket is full, -1
+// on error
+static int connection_flush(http_worker* worker, http_connection* connection);
+
+// Sends a response whose body points into strings the handler wrote. They
+// are only kept alive until the handler's roots are dropped, so the
+// response goes straight to the socket (once earlier ones have) and what
+// the socket doesn't take now is copied into one queued piece
+static void send_parts(http_worker* worker, http_connection* connection, http_buffer* head,
+                       const http_exchange* exchange) {
+    int count = exchange->part_count + 1;
+    struct iovec* iov = malloc(sizeof(struct iovec) * (size_t)count);
+    if (!iov) {
+        connection->closing = 1;
+        return;
+    }
+    iov[0].iov_base = head->data;
+    iov[0].iov_len = head->length;
+    for (int i = 0; i < exchange->part_count; i++) {
+        const http_body_part* part = &exchange->parts[i];
+        iov[i + 1].iov_base = (char*)(part->data ? part->data : exchange->body.data + part->offset);
+        iov[i + 1].iov_len = part->length;
+    }
+
+    // Behind output that is still queued the whole response is copied. On
+    // io_uring a send of the queued pieces may be in flight
+    int direct = connection->out_count == 0 || (!worker->ring && connection_flush(worker, connection) == 1);
+    int first = 0;
+    while (direct && first < count) {
+        struct msghdr message = {0};
+        message.msg_iov = iov + first;
+        message.msg_iovlen = (size_t)(count - first < HTTP_IOV_BATCH ? count - first : HTTP_IOV_BATCH);
+        ssize_t sent = sendmsg(connection->fd, &message, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            break;  // Full, or failed: the next flush finds out which
+        }
+        size_t left = (size_t)sent;
+        while (first < count && left >= iov[first].iov_len) {
+            left -= iov[first].iov_len;
+            first++;
+        }
+        if (first < count) {
+            iov[first].iov_base = (char*)iov[first].iov_base + left;
+            iov[first].iov_len -= left;
+        }
+    }
+
+    size_t rest = 0;
+    for (int i = first; i < count; i++) {
+        rest += iov[i].iov_len;
+    }
+    char* copy = rest ? malloc(rest) : NULL;
+    if (copy) {
+        size_t at = 0;
+        for (int i = first; i < count; i++) {
+            memcpy(copy + at, iov[i].iov_base, iov[i].iov_len);
+            at += iov[i].iov_len;
+        }
+        queue_piece(connection, copy, rest);
+    } else if (rest) {
+        connection->closing = 1;
+    }
+    free(iov);
+}
+
+// The coding the request's Accept-Encoding asks for, if any is available
+static compress_encoding accepted_coding(const http_connection* connection, const http_request* request) {
+    const http_header_view* accept = request_header(connection->in, request, "accept-encoding", 15);
+    return accept ? compress_accept(connection->in + accept->value, accept->value_length) : COMPRESS_NONE;
+}
+
+// Compresses the body the handler wrote into packed, a part at a time; 0
+// if that failed or came out no smaller
+static int body_compress(const http_exchange* exchange, compress_encoding coding, compress_output* packed) {
+    compress_stream* stream = compress_begin(coding, COMPRESS_FAST);
+    if (!stream) return 0;
+    int ok = 1;
+    if (exchange->part_count == 0) {
+        ok = compress_write(stream, exchange->body.data, exchange->body.length, packed);
+    }
+    for (int i = 0; ok && i < exchange->part_count; i++) {
+        const http_body_part* part = &exchange->parts[i];
+        ok = compress_write(stream, part->data ? part->data : exchange->body.data + part->offset, part->length, packed);
+    }
+    ok = ok && compress_finish(stream, packed) && packed->length < exchange->body_length;
+    compress_end(stream);
+    if (!ok) {
+        free(packed->data);
+        *packed = (compress_output){0};
+    }
+    return ok;
+}
+
+static void send_response(http_worker* worker, http_connection* connection, http_exchange* exchange, int head_only) {
+    http_buffer head = {0};
+    if (exchange->file) {
+        // A cached file: the buffer itself is queued, on as many
+        // connections as are sending it
+        http_shared* file = exchange->file;
+        if (!response_head(worker, connection, &head, exchange->status, &exchange->headers, 1, file->length,
+                           exchange->file_coding, exchange->compressible && !exchange->has_content_encoding)) {
+            free(head.data);
+            connection->closing = 1;
+            return;
+        }
+        queue_piece(connection, head.data, head.length);
+        if (!head_only && file->length > 0 && !queue_shared(connection, file, 0)) connection->closing = 1;
+        return;
+    }
+
+    // Compressed, the body is a buffer of its own and nothing points into
+    // the handler's strings any more
+    int vary = exchange->compressible && !exchange->has_content_encoding && exchange->body_length >= HTTP_COMPRESS_MIN;
+    compress_encoding coding = vary ? accepted_coding(connection, exchange->request) : COMPRESS_NONE;
+    compress_output packed = {0};
+    if (coding != COMPRESS_NONE && !body_compress(exchange, coding, &packed)) coding = COMPRESS_NONE;
+    if (!response_head(worker, connection, &head, exchange->status, &exchange->headers, exchange->has_content_type,
+                       coding != COMPRESS_NONE ? packed.length : exchange->body_length, coding, vary)) {
+        free(head.data);
+        free(packed.data);
+        connection->closing = 1;
+        return;
+    }
+    if (coding != COMPRESS_NONE) {
+        queue_piece(connection, head.data, head.length);
+        if (head_only) {
+            free(packed.data);
+        } else {
+            queue_piece(connection, packed.data, packed.length);
+        }
+        return;
+    }
+    if (head_only || exchange->part_count == 0) {
+        queue_piece(connection, head.data, head.length);
+        if (!head_only) {
+            // The body buffer itself is queued, not copied
+            queue_piece(connection, exchange->body.data, exchange->body.length);
+            exchange->body = (http_buffer){0};
+        }
+        return;
+    }
+    send_parts(worker, connection, &head, exchange);
+    free(head.data);
+}
+
+static int body_part(http_exchange* exchange, const char* data, size_t offset, size_t length) {
+    if (exchange->part_count == exchange->part_capacity) {
+        int capacity = exchange->part_capacity ? exchange->part_capacity * 2 : 8;
+        http_body_part* parts = realloc(exchange->parts, sizeof(http_body_part) * (size_t)capacity);
+        if (!parts) return 0;
+        exchange->parts = parts;
+        exchange->part_capacity = capacity;
+    }
+    exchange->parts[exchange->part_count].data = data;
+    exchange->parts[exchange->part_count].offset = offset;
+    exchange->parts[exchange->part_count].length = length;
+    exchange->part_count++;
+    return 1;
+}
+
+// Adds text to the response body: short text is copied into the body
+// buffer, long text is sent from its own bytes and kept alive meanwhile in
+// the array at roots[1]. The caller keeps text reachable
+static int body_append(ember_vm* vm, http_exchange* exchange, ember_value text) {
+    ember_string* string = AS_STRING(text);
+    const char* chars = ember_string_flatten(string);
+    size_t length = (size_t)string->length;
+    if (!chars) return 0;
+    if (length < HTTP_LARGE) {
+        if (!buffer_append(&exchange->body, chars, length)) return 0;
+        if (exchange->part_count > 0) {
+            http_body_part* last = &exchange->parts[exchange->part_count - 1];
+            if (last->data) {
+                if (!body_part(exchange, NULL, exchange->body.length - length, length)) return 0;
+            } else {
+                last->length += length;
+            }
+        }
+    } else {
+        if (exchange->roots[1].type != EMBER_VAL_ARRAY) {
+            exchange->roots[1] = ember_make_array(vm, 4);
+            if (exchange->roots[1].type != EMBER_VAL_ARRAY) return 0;
+        }
+        array_push_with_vm(vm, AS_ARRAY(exchange->roots[1]), text);
+        if (exchange->part_count == 0 && exchange->body.length > 0 &&
+            !body_part(exchange, NULL, 0, exchange->body.length)) {
+            return 0;
+        }
+        if (!body_part(exchange, chars, 0, length)) return 0;
+    }
+    exchange->body_length += length;
+    return 1;
+}
+
+// ============================================================================
+// STATIC FILES
+// ============================================================================
+
+// A file response_send_file served, as read and in each coding a client
+// has asked for
+typedef struct static_file {
+    char* path;
+    uint32_t hash;
+    dev_t device;                            // What stat said when it was read: any change, and it is read again
+    ino_t inode;
+    off_t size;
+    struct timespec modified;
+    const char* content_type;
+    int compressible;
+    http_shared* variants[COMPRESS_ENCODINGS];  // [COMPRESS_NONE]: the file as it is
+    int tried[COMPRESS_ENCODINGS];           // Compressed once; a NULL variant came out no smaller
+    struct static_file* next;
+} static_file;
+
+static struct {
+    pthread_mutex_t lock;
+    static_file* buckets[HTTP_STATIC_BUCKETS];
+    size_t bytes;                            // In every variant, against HTTP_STATIC_CACHE
+} statics = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static const struct {
+    const char* extension;
+    const char* type;
+} static_types[] = {
+    {"html", "text/html; charset=utf-8"},
+    {"htm", "text/html; charset=utf-8"},
+    {"css", "text/css; charset=utf-8"},
+    {"js", "text/javascript; charset=utf-8"},
+    {"mjs", "text/javascript; charset=utf-8"},
+    {"json", "application/json"},
+    {"map", "application/json"},
+    {"txt", "text/plain; charset=utf-8"},
+    {"md", "text/markdown; charset=utf-8"},
+    {"csv", "text/csv; charset=utf-8"},
+    {"xml", "application/xml"},
+    {"svg", "image/svg+xml"},
+    {"wasm", "application/wasm"},
+    {"png", "image/png"},
+    {"jpg", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    {"gif", "image/gif"},
+    {"webp", "image/webp"},
+    {"avif", "image/avif"},
+    {"ico", "image/x-icon"},
+    {"woff", "font/woff"},
+    {"woff2", "font/woff2"},
+    {"pdf", "application/pdf"},
+};
+
+// Whether a body of this Content-Type compresses: text, and the structured
+// formats sent as application/ or image/svg+xml. Images, fonts and
+// archives are compressed already
+static int compressible_type(const char* type, size_t length) {
+    const char* end = memchr(type, ';', length);
+    if (end) length = (size_t)(end - type);
+    while (length > 0 && (type[length - 1] == ' ' || type[length - 1] == '\t')) length--;
+    static const char* const exact[] = {"application/json", "application/javascript", "application/xml",
+                                        "application/wasm", "image/svg+xml"};
+    if (length >= 5 && strncasecmp(type, "text/", 5) == 0) return 1;
+    for (size_t i = 0; i < sizeof(exact) / sizeof(exact[0]); i++) {
+        if (length == strlen(exact[i]) && strncasecmp(type, exact[i], length) == 0) return 1;
+    }
+    return (length > 5 && strncasecmp(type + length - 5, "+json", 5) == 0) ||
+           (length > 4 && strncasecmp(type + length - 4, "+xml", 4) == 0);
+}
+
+static const char* static_type(const char* path) {
+    const char* dot = strrchr(path, '.');
+    if (dot && !strchr(dot, '/')) {
+        for (size_t i = 0; i < sizeof(static_types) / sizeof(static_types[0]); i++) {
+            if (strcasecmp(dot + 1, static_types[i].extension) == 0) return static_types[i].type;
+        }
+    }
+    return "application/octet-stream";
+}
+
+static uint32_t static_hash(const char* path) {
+    uint32_t hash = 2166136261u;
+    for (const char* at = path; *at; at++) {
+        hash = (hash ^ (uint8_t)*at) * 16777619u;
+    }
+    return hash;
+}
+
+static int static_current(const static_file* file, const struct stat* info) {
+    return file->device == info->st_dev && file->inode == info->st_ino && file->size == info->st_size &&
+           file->modified.tv_sec == info->st_mtim.tv_sec && file->modified.tv_nsec == info->st_mtim.tv_nsec;
+}
+
+// With statics.lock held
+static static_file** static_find(const char* path, uint32_t hash) {
+    static_file** link = &statics.buckets[hash % HTTP_STATIC_BUCKETS];
+    while (*link && ((*link)->hash != hash || strcmp((*link)->path, path) != 0)) link = &(*link)->next;
+    return link;
+}
+
+static void static_free(static_file* file) {
+    for (int i = 0; i < COMPRESS_ENCODINGS; i++) {
+        if (file->variants[i]) shared_release(file->variants[i]);
+    }
+    free(file->path);
+    free(file);
+}
+
+// With statics.lock held: unlinks file and gives its bytes back
+static void static_remove(static_file** link) {
+    static_file* file = *link;
+    *link = file->next;
+    for (int i = 0; i < COMPRESS_ENCODINGS; i++) {
+        if (file->variants[i]) statics.bytes -= file->variants[i]->length;
+    }
+    static_free(file);
+}
+
+// Reads path, which stat described as info, into a new entry
+static static_file* static_read(const char* path, uint32_t hash, const struct stat* info) {
+    static_file* file = calloc(1, sizeof(static_file));
+    http_shared* data = shared_new((size_t)info->st_size);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    size_t got = 0;
+    while (fd >= 0 && data && got < (size_t)info->st_size) {
+        ssize_t n = read(fd, data->data + got, (size_t)info->st_size - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    if (fd >= 0) close(fd);
+    if (!file || !data || got != (size_t)info->st_size || !(file->path = strdup(path))) {
+        if (data) shared_release(data);
+        free(file);
+        return NULL;
+    }
+    file->hash = hash;
+    file->device = info->st_dev;
+    file->inode = info->st_ino;
+    file->size = info->st_size;
+    file->modified = info->st_mtim;
+    file->content_type = static_type(path);
+    file->compressible =
+        info->st_size >= HTTP_COMPRESS_MIN && compressible_type(file->content_type, strlen(file->content_type));
+    file->variants[COMPRESS_NONE] = data;
+    return file;
+}
+
+// The file at path in coding, or as it is when that coding isn't worth
+// having: a reference to the buffer, its coding in *coding. The entry is
+// read on first use and again once the file changes, and each coding is
+// made once, outside the lock, at the codec's best level. NULL if path is
+// not a readable regular file of at most HTTP_STATIC_MAX_FILE bytes
+static http_shared* static_get(const char* path, compress_encoding wanted, compress_encoding* coding,
+                               const char** content_type, int* compressible) {
+    struct stat info;
+    if (stat(path, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size > HTTP_STATIC_MAX_FILE) return NULL;
+    uint32_t hash = static_hash(path);
+
+    pthread_mutex_lock(&statics.lock);
+    static_file** link = static_find(path, hash);
+    if (*link && !static_current(*link, &info)) static_remove(link);
+    static_file* file = *link;
+    if (!file) {
+        pthread_mutex_unlock(&statics.lock);
+        static_file* fresh = static_read(path, hash, &info);
+        if (!fresh) return NULL;
+        pthread_mutex_lock(&statics.lock);
+        link = static_find(path, hash);
+        if (*link && static_current(*link, &info)) {
+            // Another worker read it meanwhile
+            static_free(fresh);
+        } else if (statics.bytes + fresh->variants[COMPRESS_NONE]->length <= HTTP_STATIC_CACHE) {
+            if (*link) static_remove(link);
+            fresh->next = statics.buckets[hash % HTTP_STATIC_BUCKETS];
+            statics.buckets[hash % HTTP_STATIC_BUCKETS] = fresh;
+            statics.bytes += fresh->variants[COMPRESS_NONE]->length;
+        } else {
+            // No room: served this once, as it is
+            pthread_mutex_unlock(&statics.lock);
+            http_shared* data = fresh->variants[COMPRESS_NONE];
+            fresh->variants[COMPRESS_NONE] = NULL;
+            *coding = COMPRESS_NONE;
+            *content_type = fresh->content_type;
+            *compressible = 0;
+            static_free(fresh);
+            return data;
+        }
+        file = *link;
+    }
+
+    *content_type = file->content_type;
+    *compressible = file->compressible;
+    if (!file->compressible || wanted == COMPRESS_NONE) wanted = COMPRESS_NONE;
+    if (wanted != COMPRESS_NONE && !file->tried[wanted]) {
+        http_shared* data = file->variants[COMPRESS_NONE];
+        __atomic_add_fetch(&data->refs, 1, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&statics.lock);
+
+        http_shared* packed = NULL;
+        compress_output out = {0};
+        compress_stream* stream = compress_begin(wanted, COMPRESS_BEST);
+        if (stream && compress_write(stream, data->data, data->length, &out) && compress_finish(stream, &out) &&
+            out.length < data->length && (packed = shared_new(out.length))) {
+            memcpy(packed->data, out.data, out.length);
+        }
+        compress_end(stream);
+        free(out.data);
+
+        // Kept if the entry is still the one it was made from; the reference
+        // held on its data means a replaced entry can't share the address
+        pthread_mutex_lock(&statics.lock);
+        link = static_find(path, hash);
+        file = *link && (*link)->variants[COMPRESS_NONE] == data ? *link : NULL;
+        if (file && !file->tried[wanted] && (!packed || statics.bytes + packed->length <= HTTP_STATIC_CACHE)) {
+            file->tried[wanted] = 1;
+            file->variants[wanted] = packed;
+            if (packed) {
+                statics.bytes += packed->length;
+                __atomic_add_fetch(&packed->refs, 1, __ATOMIC_RELAXED);
+            }
+        }
+        pthread_mutex_unlock(&statics.lock);
+        if (packed) {
+            *coding = wanted;
+            shared_release(data);
+            return packed;
+        }
+        *coding = COMPRESS_NONE;
+        return data;
+    }
+
+    http_shared* result = file->variants[wanted] ? file->variants[wanted] : file->variants[COMPRESS_NONE];
+    *coding = file->variants[wanted] ? wanted : COMPRESS_NONE;
+    __atomic_add_fetch(&result->refs, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&statics.lock);
+    return result;
+}
+
+// ============================================================================
+// SERVING
+// ============================================================================
+
+static ember_value string_value(ember_string* string) {
+    if (!string) return ember_make_nil();
+    ember_value value;
+    value.type = EMBER_VAL_STRING;
+    value.as.obj_val = (ember_object*)string;
+    return value;
+}
+
+static ember_value view_string(ember_vm* vm, const char* chars, uint32_t length) {
+    return string_value(copy_string(vm, chars, (int)length));
+}
+
+// WebSockets (below): a handshake the handler accepted, frames received,
+// and a socket closing
+static void ws_start(http_worker* worker, http_connection* connection, const http_exchange* exchange);
+static int ws_answer(http_worker* worker, http_connection* connection);
+static void ws_closed(http_worker* worker, http_connection* connection);
+
+static void serve_request(http_worker* worker, http_connection* connection, const http_request* request) {
+    const char* base = connection->in;
+    ember_vm* vm = worker->vm;
+    http_exchange exchange = {0};
+    exchange.worker = worker;
+    exchange.connection = connection;
+    exchange.request = request;
+    exchange.status = 200;
+    exchange.compressible = 1;
+    if (!request->keep_alive) connection->closing = 1;
+    int head_only = view_equals(base, request->method, request->method_length, "HEAD");
+
+    // Two stack slots under the handler's frame keep the request body and
+    // the strings the response points into alive until it is sent
+    ember_value* args = vm->stack_top + 2 <= EMBER_STACK_MAX ? ember_function_args(worker->handler, 2) : NULL;
+    if (!args) {
+        queue_error(worker, connection, 500);
+        return;
+    }
+    int stack_base = vm->stack_top;
+    exchange.roots = &vm->stack[stack_base];
+    exchange.roots[0] = ember_make_nil();
+    exchange.roots[1] = ember_make_nil();
+    vm->stack_top += 2;
+
+    ember_value result = ember_make_nil();
+    args[0] = view_string(vm, base + request->method, request->method_length);
+    args[1] = view_string(vm, base + request->path, request->path_length);
+    http_current = &exchange;
+    http_current_worker = worker;
+    int status = ember_function_call(worker->handler, 2, args, &result);
+    http_current = NULL;
+    http_current_worker = NULL;
+
+    int ok = status == 0;
+    if (ok && !exchange.ended && exchange.body_length == 0 && result.type == EMBER_VAL_STRING) {
+        exchange.roots[0] = result;
+        ok = body_append(vm, &exchange, result);
+    }
+    if (ok && exchange.upgrade) {
+        ws_start(worker, connection, &exchange);
+    } else if (ok) {
+        send_response(worker, connection, &exchange, head_only);
+    } else {
+        queue_error(worker, connection, 500);
+    }
+    vm->stack_top = stack_base;
+    if (exchange.file) shared_release(exchange.file);
+    free(exchange.headers.data);
+    free(exchange.body.data);
+    free(exchange.parts);
+}
+
+static void connection_close(http_worker* worker, http_connection* connection) {
+    if (connection->websocket) ws_closed(worker, connection);
+    if (connection->flush_pending) {
+        http_connection** link = &worker->flush_list;
+        while (*link != connection) link = &(*link)->flush_next;
+        *link = connection->flush_next;
+    }
+    if (!worker->ring) {
+        epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, connection->fd, NULL);
+    } else if (connection->slot >= 0) {
+        // The table holds a reference to the socket too
+        io_ring_set_file(worker->ring, (unsigned)connection->slot, -1);
+        worker->free_slots[worker->free_slot_count++] = connection->slot;
+    }
+    close(connection->fd);
+    if (connection->prev) {
+        connection->prev->next = connection->next;
+    } else {
+        worker->connections = connection->next;
+    }
+    if (connection->next) connection->next->prev = connection->prev;
+    for (int i = 0; i < connection->out_count; i++) {
+        piece_free(&connection->out[i]);
+    }
+    free(connection->out);
+    if (connection->buffer >= 0) {
+        worker->free_buffers[worker->free_buffer_count++] = connection->buffer;
+    } else {
+        free(connection->in);
+    }
+    free(connection->body);
+    free(connection);
+}
+
+static void connection_watch(http_worker* worker, http_connection* connection, int writing) {
+    if (connection->writing == writing) return;
+    struct epoll_event event = {0};
+    event.events = writing ? EPOLLOUT : EPOLLIN | EPOLLRDHUP;
+    event.data.ptr = connection;
+    epoll_ctl(worker->epoll_fd, EPOLL_CTL_MOD, connection->fd, &event);
+    connection->writing = writing;
+}
+
+// Drops the first sent bytes of out
+static void connection_sent(http_connection* connection, size_t sent) {
+    connection->out_bytes -= sent;
+    int done = 0;
+    while (done < connection->out_count && sent >= connection->out[done].length - connection->out_offset) {
+        sent -= connection->out[done].length - connection->out_offset;
+        piece_free(&connection->out[done]);
+        connection->out_offset = 0;
+        done++;
+    }
+    connection->out_offset += sent;
+    connection->out_count -= done;
+    memmove(connection->out, connection->out + done, sizeof(http_piece) * (size_t)connection->out_count);
+}
+
+// Fills iov with out's first pieces: how many
+static int connection_pieces(const http_connection* connection, struct iovec* iov) {
+    int count = connection->out_count < HTTP_IOV_BATCH ? connection->out_count : HTTP_IOV_BATCH;
+    for (int i = 0; i < count; i++) {
+        size_t skip = i == 0 ? connection->out_offset : 0;
+        iov[i].iov_base = connection->out[i].data + skip;
+        iov[i].iov_len = connection->out[i].length - skip;
+    }
+    return count;
+}
+
+static int connection_flush(http_worker* worker, http_connection* connection) {
+    while (connection->out_count > 0) {
+        struct iovec iov[HTTP_IOV_BATCH];
+        struct msghdr message = {0};
+        message.msg_iov = iov;
+        message.msg_iovlen = (size_t)connection_pieces(connection, iov);
+        ssize_t sent = sendmsg(connection->fd, &message, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                connection_watch(worker, connection, 1);
+                return 0;
+            }
+            return -1;
+        }
+        connection_sent(connection, (size_t)sent);
+    }
+    connection_watch(worker, connection, 0);
+    return 1;
+}
+
+// Where the next bytes received go: 1, or 0 when there is no room until
+// queued responses drain, -1 on error. A large body being received goes
+// straight into its buffer
+static int connection_space(http_worker* worker, http_connection* connection, char** into, size_t* space) {
+    if (connection->body && connection->body_received < connection->body_length) {
+        *into = connection->body + connection->body_received;
+        *space = connection->body_length - connection->body_received;
+        return 1;
+    }
+    if (connection->in_start > 0 && (connection->in_start == connection->in_length ||
+                                     connection->in_capacity - connection->in_length < 1024)) {
+        memmove(connection->in, connection->in + connection->in_start, connection->in_length - connection->in_start);
+        connection->in_length -= connection->in_start;
+        connection->in_start = 0;
+    }
+    if (connection->in_capacity - connection->in_length < 1024) {
+        size_t capacity = connection->in_capacity ? connection->in_capacity * 2 : HTTP_BUFFER_INITIAL;
+        if (capacity > HTTP_MAX_HEAD + HTTP_MAX_BODY + 1024) capacity = HTTP_MAX_HEAD + HTTP_MAX_BODY + 1024;
+        if (capacity <= connection->in_capacity) return 0;
+        // Outgrowing a registered buffer moves the bytes to the heap
+        char* grown = connection->buffer >= 0 ? malloc(capacity) : realloc(connection->in, capacity);
+        if (!grown) return -1;
+        if (connection->buffer >= 0) {
+            memcpy(grown, connection->in, connection->in_length);
+            worker->free_buffers[worker->free_buffer_count++] = connection->buffer;
+            connection->buffer = -1;
+        }
+        connection->in = grown;
+        connection->in_capacity = capacity;
+    }
+    *into = connection->in + connection->in_length;
+    *space = connection->in_capacity - connection->in_length;
+    return 1;
+}
+
+// Reads once: 1 when bytes arrived, 0 when there are none for now or the
+// peer closed its end (the requests already received are still answered),
+// -1 on error
+static int connection_read(http_worker* worker, http_connection* connection) {
+    char* into;
+    size_t space;
+    int room = connection_space(worker, connection, &into, &space);
+    if (room <= 0) return room;
+    for (;;) {
+        ssize_t received = read(connection->fd, into, space);
+        if (received > 0) {
+            if (into == connection->in + connection->in_length) {
+                connection->in_length += (size_t)received;
+            } else {
+                connection->body_received += (size_t)received;
+            }
+            return 1;
+        }
+        if (received == 0) {
+            connection->peer_closed = 1;
+            return 0;
+        }
+        if (errno == EINTR) continue;
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+}
+
+// Answers every complete request received: 1 when some are held back
+// because too much output is queued, to be served once it drains
+static int connection_answer(http_worker* worker, http_connection* connection) {
+    int held = 0;
+    while (!connection->closing) {
+        if (connection->websocket) {
+            held = ws_answer(worker, connection);
+            break;
+        }
+        if (connection->out_bytes >= HTTP_MAX_QUEUED) {
+            held = 1;
+            break;
+        }
+        if (connection->body && connection->body_received < connection->body_length) break;
+        http_request request;
+        request.head_length = 0;
+        int parsed = http_parse(connection, &request);
+        if (parsed < 0) {
+            queue_error(worker, connection, -parsed);
+            break;
+        }
+        if (parsed == 0) {
+            // A client waiting on Expect: 100-continue is told to send the body
+            const http_header_view* expect =
+                request.head_length && !connection->continued && request.minor_version == 1
+                    ? request_header(connection->in, &request, "expect", 6)
+                    : NULL;
+            if (expect && view_equals(connection->in, expect->value, expect->value_length, "100-continue")) {
+                char* line = strdup("HTTP/1.1 100 Continue\r\n\r\n");
+                if (line) queue_piece(connection, line, strlen(line));
+                connection->continued = 1;
+            }
+            // The rest of a large body is read into a buffer of its own,
+            // which request_get_body's string then takes over
+            if (request.head_length && request.body_length >= HTTP_LARGE && !connection->body) {
+                size_t head_end = connection->in_start + request.head_length;
+                char* body = malloc(request.body_length + 1);
+                if (body) {
+                    connection->body_received = connection->in_length - head_end;
+                    memcpy(body, connection->in + head_end, connection->body_received);
+                    connection->body = body;
+                    connection->body_length = request.body_length;
+                    connection->in_length = head_end;
+                }
+            }
+            break;
+        }
+        int separate = connection->body != NULL;
+        serve_request(worker, connection, &request);
+        free(connection->body);
+        connection->body = NULL;
+        connection->in_start += request.head_length + (separate ? 0 : request.body_length);
+        connection->scanned = 0;
+        connection->continued = 0;
+    }
+    // Once the peer has closed, what is left can never be finished
+    if (connection->peer_closed && !held) connection->closing = 1;
+    return held;
+}
+
+// Answers every complete request received, then sends the responses: 0 if
+// that closed the connection
+static int connection_serve(http_worker* worker, http_connection* connection) {
+    for (;;) {
+        int held = connection_answer(worker, connection);
+        int flushed = connection_flush(worker, connection);
+        if (flushed < 0 || (flushed == 1 && connection->closing)) {
+            connection_close(worker, connection);
+            return 0;
+        }
+        if (flushed == 0 || !held) return 1;
+    }
+}
+
+// Reads and answers until the socket has nothing more for now, or output
+// backs up
+static void connection_receive(http_worker* worker, http_connection* connection) {
+    for (;;) {
+        int got = connection_read(worker, connection);
+        if (got < 0) {
+            connection_close(worker, connection);
+            return;
+        }
+        if (!connection_serve(worker, connection) || got == 0 || connection->writing) return;
+    }
+}
+
+// A connection for an accepted socket, not yet in the worker's list
+static http_connection* connection_new(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    http_connection* connection = calloc(1, sizeof(http_connection));
+    if (!connection) {
+        close(fd);
+        return NULL;
+    }
+    connection->fd = fd;
+    connection->slot = -1;
+    connection->buffer = -1;
+    return connection;
+}
+
+static void connection_add(http_worker* worker, http_connection* connection) {
+    connection->next = worker->connections;
+    if (worker->connections) worker->connections->prev = connection;
+    worker->connections = connection;
+}
+
+static void worker_accept(http_worker* worker) {
+    for (;;) {
+        int fd = accept4(worker->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return;
+        }
+        http_connection* connection = connection_new(fd);
+        if (!connection) continue;
+        struct epoll_event event = {0};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.ptr = connection;
+        if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(fd);
+            free(connection);
+            continue;
+        }
+        connection_add(worker, connection);
+    }
+}
+
+// ============================================================================
+// WEBSOCKETS
+// ============================================================================
+
+static void ring_close(http_worker* worker, http_connection* connection);
+static void ring_progress(http_worker* worker, http_connection* connection);
+
+// IDs carry the index of the worker holding the socket in their low byte
+#define WS_ID(serial, worker) ((serial) * HTTP_WORKERS_MAX + (uint64_t)(worker))
+#define WS_ID_MAX ((uint64_t)1 << 53)        // Exact as a number
+
+static http_shared* frame_new(int opcode, const char* payload, size_t length) {
+    http_shared* frame = shared_new(WS_HEAD_MAX + length);
+    if (!frame) return NULL;
+    size_t head = ws_frame_head((uint8_t*)frame->data, opcode, length);
+    if (length) memcpy(frame->data + head, payload, length);
+    frame->length = head + length;
+    return frame;
+}
+
+static size_t ws_slot(uint64_t id, size_t mask) {
+    return (size_t)(id * 0x9E3779B97F4A7C15ull >> 32) & mask;
+}
+
+static http_connection* ws_find(http_worker* worker, uint64_t id) {
+    if (worker->ws_count == 0) return NULL;
+    size_t mask = worker->ws_capacity - 1;
+    for (size_t slot = ws_slot(id, mask);; slot = (slot + 1) & mask) {
+        http_connection* connection = worker->ws_table[slot];
+        if (!connection || connection->ws_id == id) return connection;
+    }
+}
+
+static int ws_insert(http_worker* worker, http_connection* connection) {
+    if ((worker->ws_count + 1) * 4 > worker->ws_capacity * 3) {
+        size_t capacity = worker->ws_capacity ? worker->ws_capacity * 2 : 64;
+        http_connection** table = calloc(capacity, sizeof(http_connection*));
+        if (!table) return 0;
+        for (size_t i = 0; i < worker->ws_capacity; i++) {
+            http_connection* moved = worker->ws_table[i];
+            if (!moved) continue;
+            size_t slot = ws_slot(moved->ws_id, capacity - 1);
+            while (table[slot]) slot = (slot + 1) & (capacity - 1);
+            table[slot] = moved;
+        }
+        free(worker->ws_table);
+        worker->ws_table = table;
+        worker->ws_capacity = capacity;
+    }
+    size_t mask = worker->ws_capacity - 1;
+    size_t slot = ws_slot(connection->ws_id, mask);
+    while (worker->ws_table[slot]) slot = (slot + 1) & mask;
+    worker->ws_table[slot] = connection;
+    worker->ws_count++;
+    __atomic_store_n(&worker->ws_live, (int)worker->ws_count, __ATOMIC_RELAXED);
+    return 1;
+}
+
+// Backward-shift deletion: no tombstones for lookups to step over
+static void ws_remove(http_worker* worker, http_connection* connection) {
+    size_t mask = worker->ws_capacity - 1;
+    size_t hole = ws_slot(connection->ws_id, mask);
+    while (worker->ws_table[hole] != connection) hole = (hole + 1) & mask;
+    for (size_t next = (hole + 1) & mask; worker->ws_table[next]; next = (next + 1) & mask) {
+        size_t home = ws_slot(worker->ws_table[next]->ws_id, mask);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            worker->ws_table[hole] = worker->ws_table[next];
+            hole = next;
+        }
+    }
+    worker->ws_table[hole] = NULL;
+    worker->ws_count--;
+    __atomic_store_n(&worker->ws_live, (int)worker->ws_count, __ATOMIC_RELAXED);
+}
+
+// Sends the queued output of connection at the loop's next turn, outside
+// any handler
+static void flush_later(http_worker* worker, http_connection* connection) {
+    if (connection->flush_pending) return;
+    connection->flush_pending = 1;
+    connection->flush_next = worker->flush_list;
+    worker->flush_list = connection;
+}
+
+// Sends frame on a WebSocket of this worker: straight to the socket when
+// nothing is queued ahead of it, otherwise by queuing the shared frame
+// itself. A socket with too much waiting already is dropped
+static void ws_deliver(http_worker* worker, http_connection* connection, http_shared* frame, int closing) {
+    if (!connection->websocket || connection->closing || connection->dead || connection->dropped) return;
+    size_t sent = 0;
+    while (connection->out_count == 0) {
+        ssize_t result = send(connection->fd, frame->data, frame->length, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (result < 0 && errno == EINTR) continue;
+        if (result > 0) sent = (size_t)result;
+        break;  // Full, or failed: the flush finds out which
+    }
+    if (sent < frame->length) {
+        if (connection->out_bytes + (frame->length - sent) > WS_MAX_QUEUED || !queue_shared(connection, frame, sent)) {
+            connection->dropped = 1;
+        }
+        flush_later(worker, connection);
+    }
+    if (closing) {
+        connection->closing = 1;
+        flush_later(worker, connection);
+    }
+}
+
+static void ws_send(http_worker* worker, http_connection* connection, int opcode, const void* payload, size_t length) {
+    http_shared* frame = frame_new(opcode, payload, length);
+    if (!frame) {
+        connection->dropped = 1;
+        flush_later(worker, connection);
+        return;
+    }
+    ws_deliver(worker, connection, frame, opcode == WS_CLOSE);
+    shared_release(frame);
+}
+
+static void ws_send_close(http_worker* worker, http_connection* connection, int code) {
+    uint8_t payload[2] = {(uint8_t)(code >> 8), (uint8_t)code};
+    ws_send(worker, connection, WS_CLOSE, payload, sizeof(payload));
+}
+
+// Delivers frame to the WebSockets ids of this worker, or to all of them
+static void ws_deliver_local(http_worker* worker, http_shared* frame, const uint64_t* ids, size_t id_count,
+                             int closing) {
+    if (!ids) {
+        for (http_connection* connection = worker->connections; connection; connection = connection->next) {
+            ws_deliver(worker, connection, frame, closing);
+        }
+        return;
+    }
+    for (size_t i = 0; i < id_count; i++) {
+        http_connection* connection = ws_find(worker, ids[i]);
+        if (connection) ws_deliver(worker, connection, frame, closing);
+    }
+}
+
+// Hands frame to another worker for its WebSockets ids (all of them when
+// ids is NULL); 0 if it is stopping or out of memory
+static int ws_post_to(http_worker* worker, http_shared* frame, const uint64_t* ids, size_t id_count, int closing) {
+    ws_post* post = malloc(sizeof(ws_post));
+    if (!post) return 0;
+    post->ids = NULL;
+    if (ids) {
+        post->ids = malloc(sizeof(uint64_t) * id_count);
+        if (!post->ids) {
+            free(post);
+            return 0;
+        }
+        memcpy(post->ids, ids, sizeof(uint64_t) * id_count);
+    }
+    post->frame = frame;
+    post->id_count = id_count;
+    post->closing = closing;
+    __atomic_add_fetch(&frame->refs, 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&worker->mail_lock);
+    int open = worker->mail_fd >= 0;
+    if (open) {
+        post->next = worker->mail;
+        worker->mail = post;
+        uint64_t one = 1;
+        ssize_t written = write(worker->mail_fd, &one, sizeof(one));
+        (void)written;
+    }
+    pthread_mutex_unlock(&worker->mail_lock);
+    if (!open) {
+        shared_release(frame);
+        free(post->ids);
+        free(post);
+    }
+    return open;
+}
+
+static void ws_post_free(ws_post* post) {
+    shared_release(post->frame);
+    free(post->ids);
+    free(post);
+}
+
+// Sends frame from worker to the WebSockets ids, wherever they are, or to
+// every WebSocket when ids is NULL: this worker's straight away, each other
+// worker's in one post. ids may be reordered
+static int ws_send_all(http_worker* worker, http_shared* frame, uint64_t* ids, size_t id_count, int closing) {
+    ember_http_server* server = worker->server;
+    int ok = 1;
+    if (!ids) {
+        ws_deliver_local(worker, frame, NULL, 0, closing);
+        for (int i = 0; i < server->worker_count; i++) {
+            http_worker* other = &server->workers[i];
+            if (other != worker && __atomic_load_n(&other->ws_live, __ATOMIC_RELAXED) > 0) {
+                ok &= ws_post_to(other, frame, NULL, 0, closing);
+            }
+        }
+        return ok;
+    }
+
+    // Grouped by worker with a counting sort on the index in each ID
+    size_t counts[HTTP_WORKERS_MAX + 1] = {0};
+    for (size_t i = 0; i < id_count; i++) {
+        counts[ids[i] % HTTP_WORKERS_MAX + 1]++;
+    }
+    for (int i = 1; i <= HTTP_WORKERS_MAX; i++) {
+        counts[i] += counts[i - 1];
+    }
+    uint64_t* sorted = malloc(sizeof(uint64_t) * (id_count ? id_count : 1));
+    if (!sorted) return 0;
+    size_t next[HTTP_WORKERS_MAX];
+    memcpy(next, counts, sizeof(next));
+    for (size_t i = 0; i < id_count; i++) {
+        sorted[next[ids[i] % HTTP_WORKERS_MAX]++] = ids[i];
+    }
+    for (int i = 0; i < server->worker_count; i++) {
+        size_t first = counts[i], count = counts[i + 1] - counts[i];
+        if (count == 0) continue;
+        http_worker* other = &server->workers[i];
+        if (other == worker) {
+            ws_deliver_local(worker, frame, sorted + first, count, closing);
+        } else {
+            ok &= ws_post_to(other, frame, sorted + first, count, closing);
+        }
+    }
+    free(sorted);
+    return ok;
+}
+
+// Delivers the frames other workers posted, oldest first
+static void worker_mail(http_worker* worker) {
+    uint64_t value;
+    ssize_t got = read(worker->mail_fd, &value, sizeof(value));
+    (void)got;
+    pthread_mutex_lock(&worker->mail_lock);
+    ws_post* post = worker->mail;
+    worker->mail = NULL;
+    pthread_mutex_unlock(&worker->mail_lock);
+    ws_post* oldest = NULL;
+    while (post) {
+        ws_post* next = post->next;
+        post->next = oldest;
+        oldest = post;
+        post = next;
+    }
+    while (oldest) {
+        ws_post* next = oldest->next;
+        ws_deliver_local(worker, oldest->frame, oldest->ids, oldest->id_count, oldest->closing);
+        ws_post_free(oldest);
+        oldest = next;
+    }
+}
+
+// Sends what frames left queued, and closes the sockets they dropped
+static void worker_flush(http_worker* worker) {
+    while (worker->flush_list) {
+        http_connection* connection = worker->flush_list;
+        worker->flush_list = connection->flush_next;
+        connection->flush_pending = 0;
+        if (worker->ring) {
+            if (connection->dead) continue;  // Closed once its requests in flight end
+            if (connection->dropped) {
+                ring_close(worker, connection);
+            } else {
+                ring_progress(worker, connection);
+            }
+            continue;
+        }
+        int flushed = connection->dropped ? -1 : connection_flush(worker, connection);
+        if (flushed < 0 || (flushed == 1 && connection->closing)) connection_close(worker, connection);
+    }
+}
+
+// Calls the WebSocket's message handler as handler(id, message), or
+// handler(id, nil) once it has closed: 0 if the handler failed
+static int ws_dispatch(http_worker* worker, http_connection* connection, const ws_message* message) {
+    ember_vm* vm = worker->vm;
+    ember_function_handle* handler = worker->ws_handlers[connection->ws_handler].handle;
+    ember_value* args = vm->stack_top + 2 <= EMBER_STACK_MAX ? ember_function_args(handler, 2) : NULL;
+    if (!args) return 0;
+    ember_value result = ember_make_nil();
+    args[0] = ember_make_number((double)connection->ws_id);
+    args[1] = message ? view_string(vm, (const char*)message->payload, (uint32_t)message->length) : ember_make_nil();
+    http_current_worker = worker;
+    int status = ember_function_call(handler, 2, args, &result);
+    http_current_worker = NULL;
+    return status == 0;
+}
+
+static void ws_start(http_worker* worker, http_connection* connection, const http_exchange* exchange) {
+    http_buffer head = {0};
+    if (!buffer_printf(&head, "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n") ||
+        !buffer_printf(&head, "Sec-WebSocket-Accept: %s\r\n\r\n", exchange->ws_accept)) {
+        free(head.data);
+        connection->closing = 1;
+        return;
+    }
+    connection->ws_id = exchange->ws_id;
+    connection->ws_handler = exchange->ws_handler;
+    if (!queue_piece(connection, head.data, head.length) || !ws_insert(worker, connection)) {
+        connection->closing = 1;
+        return;
+    }
+    ws_reader_init(&connection->ws, HTTP_MAX_BODY);
+    connection->websocket = 1;
+}
+
+// Handles every whole frame received on a WebSocket: 1 when the rest are
+// held back because too much output is queued
+static int ws_answer(http_worker* worker, http_connection* connection) {
+    while (!connection->closing && !connection->dropped) {
+        if (connection->out_bytes >= HTTP_MAX_QUEUED) return 1;
+        ws_message message;
+        ssize_t used = ws_read(&connection->ws, (uint8_t*)connection->in + connection->in_start,
+                               connection->in_length - connection->in_start, &message);
+        if (used < 0) {
+            ws_send_close(worker, connection, (int)-used);
+            break;
+        }
+        if (used == 0) break;
+        if (message.opcode == WS_TEXT || message.opcode == WS_BINARY) {
+            if (!ws_dispatch(worker, connection, &message)) ws_send_close(worker, connection, 1011);
+        } else if (message.opcode == WS_PING) {
+            ws_send(worker, connection, WS_PONG, message.payload, message.length);
+        } else if (message.opcode == WS_CLOSE) {
+            // Answered with the code it came with
+            ws_send(worker, connection, WS_CLOSE, message.payload, message.length < 2 ? 0 : 2);
+        }
+        connection->in_start += (size_t)used;
+    }
+    return 0;
+}
+
+static void ws_closed(http_worker* worker, http_connection* connection) {
+    ws_remove(worker, connection);
+    ws_reader_free(&connection->ws);
+    connection->websocket = 0;
+    if (!worker->stopping) ws_dispatch(worker, connection, NULL);
+}
+
+// ============================================================================
+// IO_URING LOOP
+// ============================================================================
+
+// Points entry at fd, or at its fixed-file slot when it has one
+static void ring_file(struct io_uring_sqe* entry, int fd, int slot) {
+    if (slot >= 0) {
+        entry->fd = slot;
+        entry->flags |= IOSQE_FIXED_FILE;
+    } else {
+        entry->fd = fd;
+    }
+}
+
+static void ring_accept(http_worker* worker) {
+    struct io_uring_sqe* entry = io_ring_sqe(worker->ring);
+    if (!entry) return;
+    entry->opcode = IORING_OP_ACCEPT;
+    ring_file(entry, worker->listen_fd, worker->free_slots ? RING_SLOT_LISTENER : -1);
+    entry->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    entry->user_data = RING_ACCEPT;
+    worker->ring_pending++;
+}
+
+// The wake eventfd is polled, not read: every worker has to see it
+static void ring_watch_wake(http_worker* worker) {
+    struct io_uring_sqe* entry = io_ring_sqe(worker->ring);
+    if (!entry) return;
+    entry->opcode = IORING_OP_POLL_ADD;
+    ring_file(entry, worker->server->wake_fd, worker->free_slots ? RING_SLOT_WAKE : -1);
+    entry->poll32_events = POLLIN;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    entry->poll32_events = POLLIN << 16;
+#endif
+    entry->user_data = RING_WAKE;
+    worker->ring_pending++;
+}
+
+// Mail for this worker's WebSockets: the eventfd is polled, then read
+static void ring_watch_mail(http_worker* worker) {
+    struct io_uring_sqe* entry = io_ring_sqe(worker->ring);
+    if (!entry) return;
+    entry->opcode = IORING_OP_POLL_ADD;
+    entry->fd = worker->mail_fd;
+    entry->poll32_events = POLLIN;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    entry->poll32_events = POLLIN << 16;
+#endif
+    entry->user_data = RING_MAIL;
+    worker->ring_pending++;
+}
+
+static int ring_receive(http_worker* worker, http_connection* connection) {
+    char* into;
+    size_t space;
+    int room = connection_space(worker, connection, &into, &space);
+    if (room <= 0) return room;  // No room: once output drains
+    struct io_uring_sqe* entry = io_ring_sqe(worker->ring);
+    if (!entry) return -1;
+    connection->reading_body = into != connection->in + connection->in_length;
+    if (connection->buffer >= 0 && !connection->reading_body) {
+        entry->opcode = IORING_OP_READ_FIXED;
+        entry->buf_index = 0;
+    } else {
+        entry->opcode = IORING_OP_RECV;
+    }
+    ring_file(entry, connection->fd, connection->slot);
+    entry->addr = (uint64_t)(uintptr_t)into;
+    entry->len = space > UINT32_MAX ? UINT32_MAX : (uint32_t)space;
+    entry->user_data = (uint64_t)(uintptr_t)connection | RING_RECEIVE;
+    connection->reading = 1;
+    worker->ring_pending++;
+    return 1;
+}
+
+static int ring_send(http_worker* worker, http_connection* connection) {
+    struct io_uring_sqe* entry = io_ring_sqe(worker->ring);
+    if (!entry) return -1;
+    memset(&connection->message, 0, sizeof(connection->message));
+    connection->message.msg_iov = connection->iov;
+    connection->message.msg_iovlen = (size_t)connection_pieces(connection, connection->iov);
+    entry->opcode = IORING_OP_SENDMSG;
+    ring_file(entry, connection->fd, connection->slot);
+    entry->addr = (uint64_t)(uintptr_t)&connection->message;
+    entry->len = 1;
+    entry->msg_flags = MSG_NOSIGNAL;
+    entry->user_data = (uint64_t)(uintptr_t)connection | RING_SEND;
+    connection->sending = 1;
+    worker->ring_pending++;
+    return 1;
+}
+
+// Closes connection once nothing in flight points into it any more; until
+// then shutting the socket down makes its requests end
+static void ring_close(http_worker* worker, http_connection* connection) {
+    if (connection->reading || connection->sending) {
+        if (!connection->dead) shutdown(connection->fd, SHUT_RDWR);
+        connection->dead = 1;
+        return;
+    }
+    connection_close(worker, connection);
+}
+
+// After a completion: answers what has arrived (never while a receive may
+// still write into the buffer) and keeps a send and a receive in flight
+// while there is output, and room and reason to read
+static void ring_progress(http_worker* worker, http_connection* connection) {
+    int held = connection->reading ? 0 : connection_answer(worker, connection);
+    if (connection->out_count > 0) {
+        if (!connection->sending && ring_send(worker, connection) < 0) {
+            ring_close(worker, connection);
+            return;
+        }
+    } else if (connection->closing) {
+        ring_close(worker, connection);
+        return;
+    }
+    if (!connection->reading && !connection->closing && !held && ring_receive(worker, connection) < 0) {
+        ring_close(worker, connection);
+    }
+}
+
+static void ring_accepted(http_worker* worker, int fd) {
+    http_connection* connection = connection_new(fd);
+    if (!connection) return;
+    if (worker->free_slot_count > 0) {
+        int slot = worker->free_slots[worker->free_slot_count - 1];
+        if (io_ring_set_file(worker->ring, (unsigned)slot, fd) == 0) {
+            connection->slot = slot;
+            worker->free_slot_count--;
+        }
+    }
+    if (worker->free_buffer_count > 0) {
+        connection->buffer = worker->free_buffers[--worker->free_buffer_count];
+        connection->in = worker->buffers + (size_t)connection->buffer * HTTP_BUFFER_INITIAL;
+        connection->in_capacity = HTTP_BUFFER_INITIAL;
+    }
+    connection_add(worker, connection);
+    if (ring_receive(worker, connection) < 0) connection_close(worker, connection);
+}
+
+static void ring_complete(http_worker* worker, uint64_t tag, int result, int* running) {
+    if (tag == 0) return;  // A cancel
+    worker->ring_pending--;
+    unsigned kind = (unsigned)(tag & RING_TAG_MASK);
+    if (kind == RING_WAKE) {
+        *running = 0;
+        return;
+    }
+    if (kind == RING_ACCEPT) {
+        if (result >= 0) ring_accepted(worker, result);
+        if (*running) ring_accept(worker);
+        return;
+    }
+    if (kind == RING_MAIL) {
+        if (*running) {
+            worker_mail(worker);
+            ring_watch_mail(worker);
+        }
+        return;
+    }
+    http_connection* connection = (http_connection*)(uintptr_t)(tag & ~(uint64_t)RING_TAG_MASK);
+    if (kind == RING_RECEIVE) {
+        connection->reading = 0;
+        if (result > 0) {
+            if (connection->reading_body) {
+                connection->body_received += (size_t)result;
+            } else {
+                connection->in_length += (size_t)result;
+            }
+        } else if (result == 0) {
+            connection->peer_closed = 1;
+        } else if (result != -EINTR && result != -EAGAIN) {
+            connection->dead = 1;
+        }
+    } else {
+        connection->sending = 0;
+        if (result >= 0) {
+            connection_sent(connection, (size_t)result);
+        } else if (result != -EINTR && result != -EAGAIN) {
+            connection->dead = 1;
+        }
+    }
+    if (connection->dead || !*running) {
+        ring_close(worker, connection);
+    } else {
+        ring_progress(worker, connection);
+    }
+}
+
+static void worker_ring_loop(http_worker* worker) {
+    int running = 1;
+    ring_watch_wake(worker);
+    ring_watch_mail(worker);
+    ring_accept(worker);
+    while (running) {
+        worker_flush(worker);
+        int submitted = io_ring_submit(worker->ring, 1, -1);
+        if (submitted < 0 && submitted != -EINTR && submitted != -EBUSY) break;
+        struct io_uring_cqe* cqe;
+        while ((cqe = io_ring_peek(worker->ring))) {
+            uint64_t tag = cqe->user_data;
+            int result = cqe->res;
+            io_ring_seen(worker->ring);
+            ring_complete(worker, tag, result, &running);
+        }
+    }
+    running = 0;
+    worker->stopping = 1;
+
+    // Everything in flight points into the worker or its connections: end
+    // it all and wait for the last completions before anything is freed
+    for (http_connection* connection = worker->connections; connection; connection = connection->next) {
+        if (connection->reading || connection->sending) shutdown(connection->fd, SHUT_RDWR);
+        connection->dead = 1;
+    }
+    uint64_t pending[] = {RING_ACCEPT, RING_WAKE, RING_MAIL};
+    for (int i = 0; i < 3; i++) {
+        struct io_uring_sqe* entry = io_ring_sqe(worker->ring);
+        if (!entry) break;
+        entry->opcode = IORING_OP_ASYNC_CANCEL;
+        entry->fd = -1;
+        entry->addr = pending[i];
+    }
+    while (worker->ring_pending > 0) {
+        int submitted = io_ring_submit(worker->ring, 1, -1);
+        if (submitted < 0 && submitted != -EINTR && submitted != -EBUSY) break;
+        struct io_uring_cqe* cqe;
+        while ((cqe = io_ring_peek(worker->ring))) {
+            uint64_t tag = cqe->user_data;
+            int result = cqe->res;
+            io_ring_seen(worker->ring);
+            ring_complete(worker, tag, result, &running);
+        }
+    }
+}
+
+// ============================================================================
+// WORKERS
+// ============================================================================
+
+static void worker_ring_free(http_worker* worker) {
+    if (worker->ring) {
+        io_ring_free(worker->ring);
+        free(worker->ring);
+    }
+    free(worker->free_slots);
+    free(worker->buffers);
+    free(worker->free_buffers);
+    worker->ring = NULL;
+    worker->free_slots = NULL;
+    worker->buffers = NULL;
+    worker->free_buffers = NULL;
+    worker->free_slot_count = 0;
+    worker->free_buffer_count = 0;
+}
+
+// 0 when the worker runs on io_uring. Fixed files and registered buffers
+// are each left out if the kernel won't take them (RLIMIT_NOFILE, or
+// RLIMIT_MEMLOCK before 5.12)
+static int worker_ring_setup(http_worker* worker) {
+    worker->ring = malloc(sizeof(io_ring));
+    if (!worker->ring || io_ring_init(worker->ring, HTTP_RING_ENTRIES) != 0) {
+        free(worker->ring);
+        worker->ring = NULL;
+        return -1;
+    }
+    io_ring* ring = worker->ring;
+    worker->free_slots = malloc(sizeof(int) * HTTP_RING_FILES);
+    if (worker->free_slots && io_ring_register_files(ring, HTTP_RING_FILES) == 0 &&
+        io_ring_set_file(ring, RING_SLOT_LISTENER, worker->listen_fd) == 0 &&
+        io_ring_set_file(ring, RING_SLOT_WAKE, worker->server->wake_fd) == 0) {
+        // Taken from the end: low slots first
+        for (int slot = HTTP_RING_FILES - 1; slot > RING_SLOT_WAKE; slot--) {
+            worker->free_slots[worker->free_slot_count++] = slot;
+        }
+    } else {
+        free(worker->free_slots);
+        worker->free_slots = NULL;
+    }
+    worker->buffers = malloc((size_t)HTTP_RING_BUFFERS * HTTP_BUFFER_INITIAL);
+    worker->free_buffers = malloc(sizeof(int) * HTTP_RING_BUFFERS);
+    struct iovec region = {worker->buffers, (size_t)HTTP_RING_BUFFERS * HTTP_BUFFER_INITIAL};
+    if (worker->buffers && worker->free_buffers && io_ring_register_buffers(ring, &region, 1) == 0) {
+        for (int i = HTTP_RING_BUFFERS - 1; i >= 0; i--) {
+            worker->free_buffers[worker->free_buffer_count++] = i;
+        }
+    } else {
+        free(worker->buffers);
+        free(worker->free_buffers);
+        worker->buffers = NULL;
+        worker->free_buffers = NULL;
+    }
+    return 0;
+}
+
+static int worker_setup(http_worker* worker) {
+    ember_http_server* server = worker->server;
+    worker->vm = ember_pool_get_vm();
+    worker->pooled = worker->vm != NULL;
+    if (!worker->vm) worker->vm = ember_new_vm();
+    if (!worker->vm) return -1;
+    if (server->prelude && ember_eval(worker->vm, server->prelude) != 0) return -1;
+    worker->handler = ember_function_resolve(worker->vm, server->handler_name);
+    if (!worker->handler) return -1;
+    pthread_mutex_lock(&worker->mail_lock);
+    worker->mail_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    pthread_mutex_unlock(&worker->mail_lock);
+    if (worker->mail_fd < 0) return -1;
+
+    if (worker_ring_setup(worker) == 0) return 0;
+    worker->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (worker->epoll_fd < 0) return -1;
+    struct epoll_event event = {0};
+    event.events = EPOLLIN;
+    event.data.ptr = &worker->listen_fd;
+    if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->listen_fd, &event) != 0) return -1;
+    event.data.ptr = &worker->mail_fd;
+    if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->mail_fd, &event) != 0) return -1;
+    event.data.ptr = &server->wake_fd;
+    return epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, server->wake_fd, &event);
+}
+
+static void worker_teardown(http_worker* worker) {
+    worker->stopping = 1;
+    while (worker->connections) {
+        connection_close(worker, worker->connections);
+    }
+    worker_ring_free(worker);
+    if (worker->epoll_fd >= 0) close(worker->epoll_fd);
+    worker->epoll_fd = -1;
+
+    // Nothing is posted here once the mailbox is shut
+    pthread_mutex_lock(&worker->mail_lock);
+    if (worker->mail_fd >= 0) close(worker->mail_fd);
+    worker->mail_fd = -1;
+    ws_post* post = worker->mail;
+    worker->mail = NULL;
+    pthread_mutex_unlock(&worker->mail_lock);
+    while (post) {
+        ws_post* next = post->next;
+        ws_post_free(post);
+        post = next;
+    }
+    free(worker->ws_table);
+    worker->ws_table = NULL;
+    worker->ws_capacity = 0;
+    for (int i = 0; i < worker->ws_handler_count; i++) {
+        free(worker->ws_handlers[i].name);
+        ember_function_release(worker->ws_handlers[i].handle);
+    }
+    free(worker->ws_handlers);
+    worker->ws_handlers = NULL;
+    worker->ws_handler_count = 0;
+    if (worker->handler) ember_function_release(worker->handler);
+    worker->handler = NULL;
+    if (worker->vm) {
+        if (worker->pooled) {
+            ember_pool_release_vm(worker->vm);
+        } else {
+            ember_free_vm(worker->vm);
+        }
+        worker->vm = NULL;
+    }
+}
+
+static void worker_epoll_loop(http_worker* worker) {
+    ember_http_server* server = worker->server;
+    struct epoll_event events[HTTP_EVENTS];
+    int running = 1;
+    while (running) {
+        int count = epoll_wait(worker->epoll_fd, events, HTTP_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            void* source = events[i].data.ptr;
+            if (source == &server->wake_fd) {
+                running = 0;
+            } else if (source == &worker->mail_fd) {
+                worker_mail(worker);
+            } else if (source == &worker->listen_fd) {
+                worker_accept(worker);
+            } else {
+                http_connection* connection = source;
+                if (events[i].events & (EPOLLERR | EPOLLHUP) && !(events[i].events & EPOLLIN)) {
+                    connection_close(worker, connection);
+                } else if (events[i].events & EPOLLOUT) {
+                    int flushed = connection_flush(worker, connection);
+                    if (flushed < 0 || (flushed == 1 && connection->closing)) {
+                        connection_close(worker, connection);
+                    } else if (flushed == 1) {
+                        connection_serve(worker, connection);  // Pipelined requests held back
+                    }
+                } else {
+                    connection_receive(worker, connection);
+                }
+            }
+        }
+        worker_flush(worker);
+    }
+}
+
+static void* worker_thread(void* arg) {
+    http_worker* worker = arg;
+    ember_http_server* server = worker->server;
+    int setup = worker_setup(worker);
+    pthread_mutex_lock(&server->lock);
+    server->started++;
+    if (setup != 0) server->failed++;
+    pthread_cond_broadcast(&server->cond);
+    pthread_mutex_unlock(&server->lock);
+
+    if (setup == 0 && worker->ring) {
+        worker_ring_loop(worker);
+    } else if (setup == 0) {
+        worker_epoll_loop(worker);
+    }
+    worker_teardown(worker);
+    return NULL;
+}
+
+
+// A listening socket on host:port (port 0: any free port). Every worker
+// binds its own to the same port
+static int open_listener(const char* host, int port) {
+    struct addrinfo hints = {0};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+    char service[16];
+    snprintf(service, sizeof(service), "%d", port);
+    struct addrinfo* found = NULL;
+    if (getaddrinfo(host, service, &hints, &found) != 0) return -1;
+    int fd = -1;
+    for (struct addrinfo* address = found; address && fd < 0; address = address->ai_next) {
+        fd = socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, address->ai_protocol);
+        if (fd < 0) continue;
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+        if (bind(fd, address->ai_addr, address->ai_addrlen) != 0 || listen(fd, SOMAXCONN) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    return fd;
+}
+
+static int listener_port(int fd) {
+    struct sockaddr_storage address;
+    socklen_t length = sizeof(address);
+    if (getsockname(fd, (struct sockaddr*)&address, &length) != 0) return -1;
+    if (address.ss_family == AF_INET6) return ntohs(((struct sockaddr_in6*)&address)->sin6_port);
+    return ntohs(((struct sockaddr_in*)&address)->sin_port);
+}
+
+static void server_free(ember_http_server* server, int started) {
+    if (server->wake_fd >= 0) {
+        uint64_t one = 1;
+        ssize_t written = write(server->wake_fd, &one, sizeof(one));
+        (void)written;
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(server->workers[i].thread, NULL);
+    }
+    for (int i = 0; i < server->worker_count; i++) {
+        if (server->workers[i].listen_fd >= 0) close(server->workers[i].listen_fd);
+    }
+    if (server->wake_fd >= 0) close(server->wake_fd);
+    for (int i = 0; i < server->worker_count; i++) {
+        pthread_mutex_destroy(&server->workers[i].mail_lock);
+    }
+    pthread_cond_destroy(&server->cond);
+    pthread_mutex_destroy(&server->lock);
+    free(server->workers);
+    free(server);
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+ember_http_server* ember_http_server_start(const char* host, int port, int workers, const char* prelude,
+                                           const char* handler) {
+    if (!handler || port < 0 || port > 65535) return NULL;
+    if (workers <= 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = online > 0 ? (int)online : 1;
+    }
+    if (workers > HTTP_WORKERS_MAX) workers = HTTP_WORKERS_MAX;
+
+    ember_http_server* server = calloc(1, sizeof(ember_http_server));
+    if (!server) return NULL;
+    server->workers = calloc((size_t)workers, sizeof(http_worker));
+    if (!server->workers) {
+        free(server);
+        return NULL;
+    }
+    server->worker_count = workers;
+    server->prelude = prelude;
+    server->handler_name = handler;
+    pthread_mutex_init(&server->lock, NULL);
+    pthread_cond_init(&server->cond, NULL);
+    server->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    for (int i = 0; i < workers; i++) {
+        server->workers[i].server = server;
+        server->workers[i].epoll_fd = -1;
+        server->workers[i].listen_fd = -1;
+        server->workers[i].index = i;
+        server->workers[i].mail_fd = -1;
+        pthread_mutex_init(&server->workers[i].mail_lock, NULL);
+    }
+    if (server->wake_fd < 0) {
+        server_free(server, 0);
+        return NULL;
+    }
+
+    // The first socket settles the port (port 0 picks one), the rest share it
+    for (int i = 0; i < workers; i++) {
+        server->workers[i].listen_fd = open_listener(host, i == 0 ? port : server->port);
+        if (server->workers[i].listen_fd < 0) {
+            fprintf(stderr, "[HTTP] Could not listen on %s:%d: %s\n", host ? host : "*", port, strerror(errno));
+            server_free(server, 0);
+            return NULL;
+        }
+        if (i == 0) server->port = listener_port(server->workers[0].listen_fd);
+    }
+
+    int started = 0;
+    for (; started < workers; started++) {
+        if (pthread_create(&server->workers[started].thread, NULL, worker_thread, &server->workers[started]) != 0) {
+            fprintf(stderr, "[HTTP] Could not start worker thread %d\n", started);
+            break;
+        }
+    }
+    // Every worker holds its VM (and has run the prelude) before the first request
+    pthread_mutex_lock(&server->lock);
+    while (server->started < started) {
+        pthread_cond_wait(&server->cond, &server->lock);
+    }
+    int failed = server->failed;
+    pthread_mutex_unlock(&server->lock);
+    if (started < workers || failed > 0) {
+        if (failed > 0) fprintf(stderr, "[HTTP] %d worker(s) could not set up a VM and handler\n", failed);
+        server_free(server, started);
+        return NULL;
+    }
+    server->prelude = NULL;
+    return server;
+}
+
+int ember_http_server_port(const ember_http_server* server) {
+    return server ? server->port : -1;
+}
+
+void ember_http_server_wait(ember_http_server* server) {
+    pthread_mutex_lock(&server->lock);
+    while (!server->stop_requested) {
+        pthread_cond_wait(&server->cond, &server->lock);
+    }
+    pthread_mutex_unlock(&server->lock);
+}
+
+void ember_http_server_stop(ember_http_server* server) {
+    if (server) server_free(server, server->worker_count);
+}
+
+// ============================================================================
+// NATIVES
+// ============================================================================
+
+// http_listen_and_serve(port, handler, prelude[, workers]) -> true once a
+// handler calls http_stop_server; nil if the server can't start. prelude
+// runs on every worker's VM and defines the global function handler
+ember_value ember_native_http_listen_and_serve(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc < 3 || argc > 4 || argv[0].type != EMBER_VAL_NUMBER || argv[1].type != EMBER_VAL_STRING ||
+        argv[2].type != EMBER_VAL_STRING || (argc == 4 && argv[3].type != EMBER_VAL_NUMBER)) {
+        return ember_make_nil();
+    }
+    double port = argv[0].as.number_val;
+    if (!(port >= 0 && port <= 65535)) return ember_make_nil();
+    char* handler = strdup(AS_CSTRING(argv[1]));
+    char* prelude = strdup(AS_CSTRING(argv[2]));
+    ember_http_server* server = NULL;
+    if (handler && prelude) {
+        server = ember_http_server_start(NULL, (int)port, argc == 4 ? (int)argv[3].as.number_val : 0, prelude,
+                                         handler);
+    }
+    if (server) {
+        ember_http_server_wait(server);
+        ember_http_server_stop(server);
+    }
+    free(handler);
+    free(prelude);
+    return server ? ember_make_bool(1) : ember_make_nil();
+}
+
+// http_stop_server() from a handler: the server finishes and
+// http_listen_and_serve returns
+ember_value ember_native_http_stop_server(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    (void)argv;
+    if (argc != 0 || !http_current_worker) return ember_make_nil();
+    ember_http_server* server = http_current_worker->server;
+    pthread_mutex_lock(&server->lock);
+    server->stop_requested = 1;
+    pthread_cond_broadcast(&server->cond);
+    pthread_mutex_unlock(&server->lock);
+    return ember_make_bool(1);
+}
+
+ember_value ember_native_request_get_method(ember_vm* vm, int argc, ember_value* argv) {
+    (void)argv;
+    if (argc != 0 || !http_current) return ember_make_nil();
+    const http_request* request = http_current->request;
+    return view_string(vm, http_current->connection->in + request->method, request->method_length);
+}
+
+ember_value ember_native_request_get_path(ember_vm* vm, int argc, ember_value* argv) {
+    (void)argv;
+    if (argc != 0 || !http_current) return ember_make_nil();
+    const http_request* request = http_current->request;
+    return view_string(vm, http_current->connection->in + request->path, request->path_length);
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// request_get_query() -> the raw query string; request_get_query(name) ->
+// the first value of name, %XX and + decoded, or nil
+ember_value ember_native_request_get_query(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc > 1 || !http_current || (argc == 1 && argv[0].type != EMBER_VAL_STRING)) return ember_make_nil();
+    const http_request* request = http_current->request;
+    const char* query = http_current->connection->in + request->query;
+    if (argc == 0) return view_string(vm, query, request->query_length);
+
+    ember_string* name = AS_STRING(argv[0]);
+    const char* wanted = ember_string_flatten(name);
+    const char* end = query + request->query_length;
+    for (const char* pair = query; pair < end;) {
+        const char* stop = memchr(pair, '&', (size_t)(end - pair));
+        if (!stop) stop = end;
+        const char* equals = memchr(pair, '=', (size_t)(stop - pair));
+        const char* key_end = equals ? equals : stop;
+        if ((size_t)(key_end - pair) == (size_t)name->length && memcmp(pair, wanted, (size_t)name->length) == 0) {
+            const char* value = equals ? equals + 1 : stop;
+            char* decoded = malloc((size_t)(stop - value) + 1);
+            if (!decoded) return ember_make_nil();
+            size_t length = 0;
+            for (const char* at = value; at < stop; at++) {
+                if (*at == '+') {
+                    decoded[length++] = ' ';
+                } else if (*at == '%' && stop - at > 2 && hex_value(at[1]) >= 0 && hex_value(at[2]) >= 0) {
+                    decoded[length++] = (char)(hex_value(at[1]) * 16 + hex_value(at[2]));
+                    at += 2;
+                } else {
+                    decoded[length++] = *at;
+                }
+            }
+            ember_value result = view_string(vm, decoded, (uint32_t)length);
+            free(decoded);
+            return result;
+        }
+        pair = stop + 1;
+    }
+    return ember_make_nil();
+}
+
+// request_get_header(name) -> its value, the name matched ignoring case; nil
+// if absent
+ember_value ember_native_request_get_header(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 1 || !http_current || argv[0].type != EMBER_VAL_STRING) return ember_make_nil();
+    const char* base = http_current->connection->in;
+    ember_string* name = AS_STRING(argv[0]);
+    const http_header_view* header =
+        request_header(base, http_current->request, ember_string_flatten(name), (size_t)name->length);
+    return header ? view_string(vm, base + header->value, header->value_length) : ember_make_nil();
+}
+
+// request_get_body() -> the body. A large one was read into a buffer of its
+// own, which the string takes over instead of copying
+ember_value ember_native_request_get_body(ember_vm* vm, int argc, ember_value* argv) {
+    (void)argv;
+    if (argc != 0 || !http_current) return ember_make_nil();
+    http_exchange* exchange = http_current;
+    if (exchange->body_taken) return exchange->roots[0];
+    http_connection* connection = exchange->connection;
+    const http_request* request = exchange->request;
+    if (connection->body) {
+        connection->body[request->body_length] = '\0';
+        // allocate_string owns the buffer from here, freeing it on failure
+        exchange->roots[0] = string_value(allocate_string(vm, connection->body, (int)request->body_length));
+        connection->body = NULL;
+    } else {
+        const char* body = connection->in + connection->in_start + request->head_length;
+        exchange->roots[0] = view_string(vm, body, (uint32_t)request->body_length);
+    }
+    exchange->body_taken = 1;
+    return exchange->roots[0];
+}
+
+ember_value ember_native_response_set_status(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc != 1 || !http_current || argv[0].type != EMBER_VAL_NUMBER) return ember_make_nil();
+    double status = argv[0].as.number_val;
+    if (!(status >= 200 && status <= 599) || status != (int)status) return ember_make_nil();
+    http_current->status = (int)status;
+    return ember_make_bool(1);
+}
+
+// response_set_header(name, value). Content-Length and Connection are the
+// server's to set
+ember_value ember_native_response_set_header(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc != 2 || !http_current || argv[0].type != EMBER_VAL_STRING || argv[1].type != EMBER_VAL_STRING) {
+        return ember_make_nil();
+    }
+    ember_string* name = AS_STRING(argv[0]);
+    ember_string* value = AS_STRING(argv[1]);
+    const char* name_chars = ember_string_flatten(name);
+    const char* value_chars = ember_string_flatten(value);
+    if (name->length == 0) return ember_make_nil();
+    for (int i = 0; i < name->length; i++) {
+        if (!is_token_char((unsigned char)name_chars[i])) return ember_make_nil();
+    }
+    for (int i = 0; i < value->length; i++) {
+        if (value_chars[i] == '\r' || value_chars[i] == '\n' || value_chars[i] == '\0') return ember_make_nil();
+    }
+    if (strcasecmp(name_chars, "content-length") == 0 || strcasecmp(name_chars, "connection") == 0 ||
+        strcasecmp(name_chars, "transfer-encoding") == 0) {
+        return ember_make_nil();
+    }
+    http_buffer* headers = &http_current->headers;
+    if (!buffer_append(headers, name_chars, (size_t)name->length) || !buffer_append(headers, ": ", 2) ||
+        !buffer_append(headers, value_chars, (size_t)value->length) || !buffer_append(headers, "\r\n", 2)) {
+        return ember_make_nil();
+    }
+    if (strcasecmp(name_chars, "content-type") == 0) {
+        http_current->has_content_type = 1;
+        http_current->compressible = compressible_type(value_chars, (size_t)value->length);
+    }
+    if (strcasecmp(name_chars, "content-encoding") == 0) http_current->has_content_encoding = 1;
+    return ember_make_bool(1);
+}
+
+// response_write(text, ...) appends to the body. Long strings are not
+// copied: the response is gathered from their bytes when it is sent
+ember_value ember_native_response_write(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc < 1 || !http_current || http_current->ended) return ember_make_nil();
+    for (int i = 0; i < argc; i++) {
+        if (argv[i].type != EMBER_VAL_STRING) return ember_make_nil();
+    }
+    for (int i = 0; i < argc; i++) {
+        if (!body_append(vm, http_current, argv[i])) return ember_make_nil();
+    }
+    return ember_make_bool(1);
+}
+
+// response_end([text, ...]) appends text and finishes the body; what the
+// handler returns is then ignored
+ember_value ember_native_response_end(ember_vm* vm, int argc, ember_value* argv) {
+    if (!http_current || http_current->ended) return ember_make_nil();
+    if (argc > 0 && ember_native_response_write(vm, argc, argv).type == EMBER_VAL_NIL) return ember_make_nil();
+    http_current->ended = 1;
+    return ember_make_bool(1);
+}
+
+// Whether path has a ".." segment
+static int path_climbs(const char* path) {
+    for (const char* at = path; (at = strstr(at, "..")) != NULL; at += 2) {
+        if ((at == path || at[-1] == '/') && (at[2] == '\0' || at[2] == '/')) return 1;
+    }
+    return 0;
+}
+
+// response_send_file(path) makes the file at path the body, in place of
+// anything written, and ends it. The Content-Type comes from its extension
+// unless the handler set one. Files are cached, and a text-like file is
+// sent compressed as Accept-Encoding allows, each coding of it made once.
+// -> true; nil if path has a ".." segment or is not a regular file of at
+// most 16 MB the server can read
+ember_value ember_native_response_send_file(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc != 1 || !http_current || http_current->ended || argv[0].type != EMBER_VAL_STRING) {
+        return ember_make_nil();
+    }
+    http_exchange* exchange = http_current;
+    ember_string* string = AS_STRING(argv[0]);
+    const char* path = ember_string_flatten(string);
+    if (!path || string->length == 0 || strlen(path) != (size_t)string->length || path_climbs(path)) {
+        return ember_make_nil();
+    }
+    compress_encoding wanted =
+        exchange->has_content_encoding ? COMPRESS_NONE : accepted_coding(exchange->connection, exchange->request);
+    compress_encoding coding;
+    const char* content_type;
+    int compressible;
+    http_shared* file = static_get(path, wanted, &coding, &content_type, &compressible);
+    if (!file) return ember_make_nil();
+    if (!exchange->has_content_type) {
+        http_buffer* headers = &exchange->headers;
+        if (!buffer_printf(headers, "Content-Type: %s\r\n", content_type)) {
+            shared_release(file);
+            return ember_make_nil();
+        }
+        exchange->has_content_type = 1;
+    }
+    exchange->file = file;
+    exchange->file_coding = coding;
+    exchange->compressible = compressible;
+    exchange->ended = 1;
+    return ember_make_bool(1);
+}
+
+// websocket_upgrade(handler) from a handler answering a WebSocket
+// handshake: the connection is upgraded once the handler returns, and
+// whatever it wrote is dropped. handler names a global function the
+// prelude defines, called as handler(id, message) for each message and as
+// handler(id, nil) once the socket has closed. -> the socket's ID; nil if
+// the request is not a handshake
+ember_value ember_native_websocket_upgrade(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 1 || !http_current || argv[0].type != EMBER_VAL_STRING) return ember_make_nil();
+    http_exchange* exchange = http_current;
+    if (exchange->upgrade) return ember_make_number((double)exchange->ws_id);
+    const char* base = exchange->connection->in;
+    const http_request* request = exchange->request;
+    const http_header_view* upgrade = request_header(base, request, "upgrade", 7);
+    const http_header_view* connection = request_header(base, request, "connection", 10);
+    const http_header_view* version = request_header(base, request, "sec-websocket-version", 21);
+    const http_header_view* key = request_header(base, request, "sec-websocket-key", 17);
+    if (!view_equals(base, request->method, request->method_length, "GET") || request->minor_version != 1 ||
+        !upgrade || !view_lists(base, upgrade->value, upgrade->value_length, "websocket") || !connection ||
+        !view_lists(base, connection->value, connection->value_length, "upgrade") || !version ||
+        !view_equals(base, version->value, version->value_length, "13") || !key ||
+        ws_accept_key(base + key->value, key->value_length, exchange->ws_accept) != 0) {
+        return ember_make_nil();
+    }
+
+    http_worker* worker = exchange->worker;
+    const char* name = ember_string_flatten(AS_STRING(argv[0]));
+    if (!name) return ember_make_nil();
+    int handler = 0;
+    while (handler < worker->ws_handler_count && strcmp(worker->ws_handlers[handler].name, name) != 0) handler++;
+    if (handler == worker->ws_handler_count) {
+        ws_handler* handlers = realloc(worker->ws_handlers, sizeof(ws_handler) * (size_t)(handler + 1));
+        if (!handlers) return ember_make_nil();
+        worker->ws_handlers = handlers;
+        char* copy = strdup(name);
+        ember_function_handle* handle = copy ? ember_function_resolve(vm, name) : NULL;
+        if (!handle) {
+            free(copy);
+            return ember_make_nil();
+        }
+        handlers[handler].name = copy;
+        handlers[handler].handle = handle;
+        worker->ws_handler_count++;
+    }
+    uint64_t id = WS_ID(worker->ws_serial + 1, worker->index);
+    if (id >= WS_ID_MAX) return ember_make_nil();
+    worker->ws_serial++;
+    exchange->upgrade = 1;
+    exchange->ws_id = id;
+    exchange->ws_handler = handler;
+    return ember_make_number((double)id);
+}
+
+// A WebSocket ID from a script value: 1, or 0 if it can't be one
+static int ws_id_value(const http_worker* worker, ember_value value, uint64_t* id) {
+    if (value.type != EMBER_VAL_NUMBER) return 0;
+    double number = value.as.number_val;
+    if (!(number >= 0 && number < (double)WS_ID_MAX) || number != (double)(uint64_t)number) return 0;
+    *id = (uint64_t)number;
+    return *id % HTTP_WORKERS_MAX < (uint64_t)worker->server->worker_count;
+}
+
+// Encodes one frame and sends it to ids (every WebSocket when NULL)
+static ember_value ws_native_send(http_worker* worker, int opcode, const void* payload, size_t length, uint64_t* ids,
+                                  size_t id_count) {
+    http_shared* frame = frame_new(opcode, payload, length);
+    if (!frame) return ember_make_nil();
+    int ok = ws_send_all(worker, frame, ids, id_count, opcode == WS_CLOSE);
+    shared_release(frame);
+    return ok ? ember_make_bool(1) : ember_make_nil();
+}
+
+// websocket_send(id, text) from a handler sends text as a message on the
+// WebSocket id, whichever worker holds it. -> true; a socket that has
+// closed meanwhile drops it
+ember_value ember_native_websocket_send(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    http_worker* worker = http_current_worker;
+    uint64_t id;
+    if (argc != 2 || !worker || !ws_id_value(worker, argv[0], &id) || argv[1].type != EMBER_VAL_STRING) {
+        return ember_make_nil();
+    }
+    ember_string* text = AS_STRING(argv[1]);
+    const char* chars = ember_string_flatten(text);
+    if (!chars) return ember_make_nil();
+    return ws_native_send(worker, WS_TEXT, chars, (size_t)text->length, &id, 1);
+}
+
+// websocket_broadcast(text[, ids]) sends text as a message on every
+// WebSocket of the server, or on those in the array ids. The frame is
+// encoded once for all of them
+ember_value ember_native_websocket_broadcast(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    http_worker* worker = http_current_worker;
+    if (argc < 1 || argc > 2 || !worker || argv[0].type != EMBER_VAL_STRING ||
+        (argc == 2 && argv[1].type != EMBER_VAL_ARRAY)) {
+        return ember_make_nil();
+    }
+    ember_string* text = AS_STRING(argv[0]);
+    const char* chars = ember_string_flatten(text);
+    if (!chars) return ember_make_nil();
+    if (argc == 1) return ws_native_send(worker, WS_TEXT, chars, (size_t)text->length, NULL, 0);
+
+    ember_array* targets = AS_ARRAY(argv[1]);
+    if (targets->length == 0) return ember_make_bool(1);
+    uint64_t* ids = malloc(sizeof(uint64_t) * (size_t)targets->length);
+    if (!ids) return ember_make_nil();
+    for (int i = 0; i < (int)targets->length; i++) {
+        if (!ws_id_value(worker, targets->elements[i], &ids[i])) {
+            free(ids);
+            return ember_make_nil();
+        }
+    }
+    ember_value result = ws_native_send(worker, WS_TEXT, chars, (size_t)text->length, ids, (size_t)targets->length);
+    free(ids);
+    return result;
+}
+
+// websocket_close(id) closes the WebSocket id with a close frame
+ember_value ember_native_websocket_close(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    http_worker* worker = http_current_worker;
+    uint64_t id;
+    if (argc != 1 || !worker || !ws_id_value(worker, argv[0], &id)) return ember_make_nil();
+    uint8_t payload[2] = {WS_CLOSE_NORMAL >> 8, WS_CLOSE_NORMAL & 0xFF};
+    return ws_native_send(worker, WS_CLOSE, payload, sizeof(payload), &id, 1);
+}
+
+#else  // !__linux__
+
+// The server needs epoll; elsewhere it can't start and the natives give nil
+ember_http_server* ember_http_server_start(const char* host, int port, int workers, const char* prelude,
+                                           const char* handler) {
+    (void)host;
+    (void)port;
+    (void)workers;
+    (void)prelude;
+    (void)handler;
+    return NULL;
+}
+
+int ember_http_server_port(const ember_http_server* server) {
+    (void)server;
+    return -1;
+}
+
+void ember_http_server_wait(ember_http_server* server) {
+    (void)server;
+}
+
+void ember_http_server_stop(ember_http_server* server) {
+    (void)server;
+}
+
+#define HTTP_UNAVAILABLE(name)                                                  \
+    ember_value name(ember_vm* vm, int argc, ember_value* argv) {               \
+        (void)vm;                                                               \
+        (void)argc;                                                             \
+        (void)argv;                                                             \
+        return ember_make_nil();                                                \
+    }
+
+HTTP_UNAVAILABLE(ember_native_http_listen_and_serve)
+HTTP_UNAVAILABLE(ember_native_http_stop_server)
+HTTP_UNAVAILABLE(ember_native_request_get_method)
+HTTP_UNAVAILABLE(ember_native_request_get_path)
+HTTP_UNAVAILABLE(ember_native_request_get_query)
+HTTP_UNAVAILABLE(ember_native_request_get_header)
+HTTP_UNAVAILABLE(ember_native_request_get_body)
+HTTP_UNAVAILABLE(ember_native_response_set_status)
+HTTP_UNAVAILABLE(ember_native_response_set_header)
+HTTP_UNAVAILABLE(ember_native_response_write)
+HTTP_UNAVAILABLE(ember_native_response_end)
+HTTP_UNAVAILABLE(ember_native_response_send_file)
+HTTP_UNAVAILABLE(ember_native_websocket_upgrade)
+HTTP_UNAVAILABLE(ember_native_websocket_send)
+HTTP_UNAVAILABLE(ember_native_websocket_broadcast)
+HTTP_UNAVAILABLE(ember_native_websocket_close)
+
+#endif
@@ -0,0 +1,106 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "http_share.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#define HTTP_HANDLE_CACHE_SIZE 16
+
+typedef struct {
+    CURL* handles[HTTP_HANDLE_CACHE_SIZE];
+    int count;
+} http_handle_cache;
+
+static pthread_once_t g_share_once = PTHREAD_ONCE_INIT;
+static CURLSH* g_share = NULL;
+static int g_share_ok = 0;
+// One lock per kind of shared data, so DNS lookups don't wait on the
+// connection cache
+static pthread_mutex_t g_share_locks[CURL_LOCK_DATA_LAST];
+static pthread_key_t g_cache_key;
+static __thread http_handle_cache* t_cache = NULL;
+
+static void share_lock(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr) {
+    (void)handle;
+    (void)access;
+    (void)userptr;
+    pthread_mutex_lock(&g_share_locks[data]);
+}
+
+static void share_unlock(CURL* handle, curl_lock_data data, void* userptr) {
+    (void)handle;
+    (void)userptr;
+    pthread_mutex_unlock(&g_share_locks[data]);
+}
+
+// Thread exit: the cached handles go with the thread
+static void free_cache(void* value) {
+    http_handle_cache* cache = value;
+    while (cache->count > 0) {
+        curl_easy_cleanup(cache->handles[--cache->count]);
+    }
+    free(cache);
+}
+
+static void share_init_once(void) {
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+        fprintf(stderr, "[HTTP] Failed to initialize libcurl\n");
+        return;
+    }
+    if (pthread_key_create(&g_cache_key, free_cache) != 0) {
+        return;
+    }
+    g_share_ok = 1;
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_init(&g_share_locks[i], NULL);
+    }
+    g_share = curl_share_init();
+    if (!g_share) {
+        // Handles still work, they just don't share
+        fprintf(stderr, "[HTTP] Failed to create connection share\n");
+        return;
+    }
+    curl_share_setopt(g_share, CURLSHOPT_LOCKFUNC, share_lock);
+    curl_share_setopt(g_share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+    curl_share_setopt(g_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(g_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(g_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+}
+
+int http_share_init(void) {
+    pthread_once(&g_share_once, share_init_once);
+    return g_share_ok;
+}
+
+CURL* http_handle_acquire(void) {
+    if (!http_share_init()) return NULL;
+    CURL* handle;
+    if (t_cache && t_cache->count > 0) {
+        handle = t_cache->handles[--t_cache->count];
+        curl_easy_reset(handle);
+    } else {
+        handle = curl_easy_init();
+        if (!handle) return NULL;
+    }
+    if (g_share) {
+        curl_easy_setopt(handle, CURLOPT_SHARE, g_share);
+    }
+    return handle;
+}
+
+void http_handle_release(CURL* handle) {
+    if (!handle) return;
+    if (!t_cache) {
+        t_cache = calloc(1, sizeof(http_handle_cache));
+        if (t_cache && pthread_setspecific(g_cache_key, t_cache) != 0) {
+            free(t_cache);
+            t_cache = NULL;
+        }
+    }
+    if (!t_cache || t_cache->count == HTTP_HANDLE_CACHE_SIZE) {
+        curl_easy_cleanup(handle);
+        return;
+    }
+    t_cache->handles[t_cache->count++] = handle;
+}
@@ -0,0 +1,25 @@
+#ifndef EMBER_HTTP_SHARE_H
+#define EMBER_HTTP_SHARE_H
+
+#include <curl/curl.h>
+
+// Connection reuse for the HTTP clients (http_fetch.c, http_enhanced.c).
+//
+// Every handle is attached to one process-wide CURLSH sharing the DNS
+// cache, TLS sessions and the connection cache, so a request to a host
+// another request (on any thread) already reached skips the lookup and
+// both handshakes. Handles themselves are cached per thread: acquire
+// returns a reset handle from the calling thread's cache or a new one,
+// release puts it back (or frees it when the cache is full). A handle
+// keeps its own caches across curl_easy_reset, so reuse pays off even
+// without the share.
+
+// curl_global_init and the share, once per process; 0 if curl failed
+int http_share_init(void);
+// A reset handle attached to the share, or NULL. Set options as for a
+// new handle
+CURL* http_handle_acquire(void);
+// handle must not be in a multi handle any more
+void http_handle_release(CURL* handle);
+
+#endif // EMBER_HTTP_SHARE_H
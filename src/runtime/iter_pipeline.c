@@ -0,0 +1,378 @@
+/**
+ * Lazy iterator pipelines: iter_map, iter_filter, iter_take, iter_skip,
+ * iter_zip and iter_chunk wrap a source in a new iterator without reading
+ * any of it, and iter_collect, iter_reduce and iter_count drive the chain.
+ *
+ * Each stage is an ember_iterator whose collection is the stage before
+ * it. Pulling the last stage pulls one value through every stage, so a
+ * chain runs as a single loop with no array between steps and holds one
+ * value (or one chunk) at a time: file_lines(f) through iter_map and
+ * iter_filter handles a file of any size in constant memory. take stops
+ * pulling its source once it has enough, so endless generators are fine
+ * sources. Stages are iterators like any other and work in for loops.
+ *
+ * Sources are iterators or anything iter() accepts: arrays, sets, maps
+ * (as [key, value] entries), generators and files (by line). A callback
+ * that fails ends its stage with ITERATOR_PIPE_FAILED, which the stages
+ * after it pass on, leaving vm->exception_pending set; the terminal ops
+ * then return nil.
+ */
+
+#include "ember.h"
+#include "../vm.h"
+#include "value/value.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+// Chunks are grown to their size rather than allocated at it up front
+#define PIPE_CHUNK_INITIAL 64
+
+// ============================================================================
+// STAGES
+// ============================================================================
+
+// An iterator over value, or nil for something that cannot be iterated
+static ember_value pipe_source(ember_vm* vm, ember_value value) {
+    switch (value.type) {
+        case EMBER_VAL_ITERATOR: return value;
+        case EMBER_VAL_ARRAY: return ember_make_iterator(vm, value, ITERATOR_ARRAY);
+        case EMBER_VAL_SET: return ember_make_iterator(vm, value, ITERATOR_SET);
+        case EMBER_VAL_MAP: return ember_make_iterator(vm, value, ITERATOR_MAP_ENTRIES);
+        case EMBER_VAL_GENERATOR: return ember_make_iterator(vm, value, ITERATOR_GENERATOR);
+        case EMBER_VAL_FILE: return ember_make_iterator(vm, value, ITERATOR_FILE_LINES);
+        default: return ember_make_nil();
+    }
+}
+
+// Reserves count stack slots, or reports why it cannot
+static ember_value* pipe_reserve(ember_vm* vm, int count) {
+    if (vm->stack_top + count > EMBER_STACK_MAX) {
+        fprintf(stderr, "[CALL] Stack overflow in iterator pipeline\n");
+        return NULL;
+    }
+    ember_value* slots = &vm->stack[vm->stack_top];
+    for (int i = 0; i < count; i++) {
+        slots[i] = ember_make_nil();
+    }
+    vm->stack_top += count;
+    return slots;
+}
+
+// The next value of source: 1, 0 at its end, or -1 once a stage in it failed
+static int pipe_pull(ember_iterator* source, ember_value* value) {
+    ember_iterator_result next = iterator_next(source);
+    if (!next.done) {
+        *value = next.value;
+        return 1;
+    }
+    return (source->pipe_flags & ITERATOR_PIPE_FAILED) ? -1 : 0;
+}
+
+// step(value, index), with the arguments rooted on the stack for the call
+static int pipe_call(ember_iterator* stage, ember_value value, ember_value* result) {
+    ember_vm* vm = stage->vm;
+    ember_value* args = pipe_reserve(vm, 2);
+    if (!args) return -1;
+    args[0] = value;
+    args[1] = ember_make_number(stage->index);
+    int status = vm_call_prepared(vm, stage->step, 2, args, result);
+    vm->stack_top -= 2;
+    return status;
+}
+
+// Nil, false and 0 are false, as for array_filter
+static int pipe_truthy(ember_value value) {
+    switch (value.type) {
+        case EMBER_VAL_NIL: return 0;
+        case EMBER_VAL_BOOL: return value.as.bool_val;
+        case EMBER_VAL_NUMBER: return value.as.number_val != 0.0;
+        default: return 1;
+    }
+}
+
+// One value out of a stage, pulling its source as far as it needs to
+static int pipe_step(ember_iterator* stage, ember_value* out) {
+    ember_vm* vm = stage->vm;
+    ember_iterator* source = AS_ITERATOR(stage->collection);
+    ember_value value;
+    int status = 0;
+
+    switch (stage->type) {
+        case ITERATOR_PIPE_MAP:
+            status = pipe_pull(source, &value);
+            if (status == 1) {
+                if (pipe_call(stage, value, out) != 0) return -1;
+                stage->index++;
+            }
+            return status;
+        case ITERATOR_PIPE_FILTER:
+            while ((status = pipe_pull(source, &value)) == 1) {
+                ember_value keep;
+                if (pipe_call(stage, value, &keep) != 0) return -1;
+                stage->index++;
+                if (pipe_truthy(keep)) {
+                    *out = value;
+                    return 1;
+                }
+            }
+            return status;
+        case ITERATOR_PIPE_TAKE:
+            // Never pulls past the last value it gives
+            if (stage->index >= stage->length) return 0;
+            status = pipe_pull(source, out);
+            if (status == 1) stage->index++;
+            return status;
+        case ITERATOR_PIPE_SKIP:
+            while (stage->index < stage->length) {
+                status = pipe_pull(source, &value);
+                if (status != 1) return status;
+                stage->index++;
+            }
+            return pipe_pull(source, out);
+        case ITERATOR_PIPE_ZIP: {
+            ember_value* held = pipe_reserve(vm, 2);
+            if (!held) return -1;
+            // Ends with the shorter source; the longer is left one value on
+            status = pipe_pull(source, &held[0]);
+            if (status == 1) status = pipe_pull(AS_ITERATOR(stage->step), &held[1]);
+            if (status == 1) {
+                *out = ember_make_array(vm, 2);
+                if (out->type != EMBER_VAL_ARRAY) {
+                    status = -1;
+                } else {
+                    array_push_with_vm(vm, AS_ARRAY(*out), held[0]);
+                    array_push_with_vm(vm, AS_ARRAY(*out), held[1]);
+                }
+            }
+            vm->stack_top -= 2;
+            return status;
+        }
+        case ITERATOR_PIPE_CHUNK: {
+            ember_value* held = pipe_reserve(vm, 1);
+            if (!held) return -1;
+            held[0] = ember_make_array(vm, stage->length < PIPE_CHUNK_INITIAL ? stage->length : PIPE_CHUNK_INITIAL);
+            if (held[0].type != EMBER_VAL_ARRAY) {
+                vm->stack_top--;
+                return -1;
+            }
+            ember_array* chunk = AS_ARRAY(held[0]);
+            while (chunk->length < stage->length && (status = pipe_pull(source, &value)) == 1) {
+                array_push_with_vm(vm, chunk, value);
+            }
+            // The last chunk may be short
+            if (status >= 0 && chunk->length > 0) {
+                *out = held[0];
+                status = 1;
+            }
+            vm->stack_top--;
+            return status;
+        }
+        default:
+            return 0;
+    }
+}
+
+ember_iterator_result iterator_pipe_next(ember_iterator* iterator) {
+    ember_iterator_result result;
+    result.value = ember_make_nil();
+    result.done = 1;
+
+    if (iterator->pipe_flags & ITERATOR_PIPE_PENDING) {
+        result.value = iterator->pending;
+        result.done = 0;
+        iterator->pending = ember_make_nil();
+        iterator->pipe_flags &= ~ITERATOR_PIPE_PENDING;
+        return result;
+    }
+    if ((iterator->pipe_flags & ITERATOR_PIPE_FAILED) || iterator->collection.type != EMBER_VAL_ITERATOR) {
+        return result;
+    }
+
+    int status = pipe_step(iterator, &result.value);
+    if (status == 1) {
+        result.done = 0;
+    } else {
+        result.value = ember_make_nil();
+        if (status < 0) iterator->pipe_flags |= ITERATOR_PIPE_FAILED;
+    }
+    return result;
+}
+
+// Whether the stage has ended can only be known by running it: the value
+// is pulled ahead and kept for the next iterator_next
+int iterator_pipe_done(ember_iterator* iterator) {
+    if (iterator->pipe_flags & ITERATOR_PIPE_PENDING) return 0;
+    ember_iterator_result next = iterator_pipe_next(iterator);
+    if (next.done) return 1;
+    gc_write_barrier_helper(iterator->vm, (ember_object*)iterator, iterator->pending, next.value);
+    iterator->pending = next.value;
+    iterator->pipe_flags |= ITERATOR_PIPE_PENDING;
+    return 0;
+}
+
+// A new stage over source; step must already be rooted by the caller
+static ember_value pipe_stage(ember_vm* vm, ember_value source, ember_iterator_type type, ember_value step,
+                              int length) {
+    ember_value* held = pipe_reserve(vm, 1);
+    if (!held) return ember_make_nil();
+    held[0] = pipe_source(vm, source);
+    ember_value stage = ember_make_nil();
+    if (held[0].type == EMBER_VAL_ITERATOR) {
+        stage = ember_make_iterator(vm, held[0], type);
+    }
+    vm->stack_top--;
+    if (stage.type != EMBER_VAL_ITERATOR) return ember_make_nil();
+
+    ember_iterator* iterator = AS_ITERATOR(stage);
+    gc_write_barrier_helper(vm, (ember_object*)iterator, ember_make_nil(), step);
+    iterator->step = step;
+    iterator->length = length;
+    return stage;
+}
+
+// A count argument: a whole number from 0 up, or -1
+static int pipe_count_arg(ember_value value, int minimum) {
+    if (value.type != EMBER_VAL_NUMBER) return -1;
+    double number = value.as.number_val;
+    if (!(number >= minimum && number <= INT_MAX) || number != (double)(int)number) return -1;
+    return (int)number;
+}
+
+// ============================================================================
+// NATIVES
+// ============================================================================
+
+// iter(value): an iterator over an array, set, map (entries), generator or
+// file (lines); iterators come back as they are
+ember_value ember_native_iter(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 1) return ember_make_nil();
+    return pipe_source(vm, argv[0]);
+}
+
+// iter_map(source, fn): fn(value, index) for each value
+ember_value ember_native_iter_map(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 2 || !vm_callable(argv[1], 2)) return ember_make_nil();
+    return pipe_stage(vm, argv[0], ITERATOR_PIPE_MAP, argv[1], 0);
+}
+
+// iter_filter(source, fn): the values for which fn(value, index) is truthy
+ember_value ember_native_iter_filter(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 2 || !vm_callable(argv[1], 2)) return ember_make_nil();
+    return pipe_stage(vm, argv[0], ITERATOR_PIPE_FILTER, argv[1], 0);
+}
+
+// iter_take(source, n): the first n values
+ember_value ember_native_iter_take(ember_vm* vm, int argc, ember_value* argv) {
+    int count = argc == 2 ? pipe_count_arg(argv[1], 0) : -1;
+    if (count < 0) return ember_make_nil();
+    return pipe_stage(vm, argv[0], ITERATOR_PIPE_TAKE, ember_make_nil(), count);
+}
+
+// iter_skip(source, n): everything after the first n values
+ember_value ember_native_iter_skip(ember_vm* vm, int argc, ember_value* argv) {
+    int count = argc == 2 ? pipe_count_arg(argv[1], 0) : -1;
+    if (count < 0) return ember_make_nil();
+    return pipe_stage(vm, argv[0], ITERATOR_PIPE_SKIP, ember_make_nil(), count);
+}
+
+// iter_zip(a, b): [a value, b value] pairs until either runs out
+ember_value ember_native_iter_zip(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 2) return ember_make_nil();
+    ember_value* held = pipe_reserve(vm, 1);
+    if (!held) return ember_make_nil();
+    held[0] = pipe_source(vm, argv[1]);
+    ember_value stage = ember_make_nil();
+    if (held[0].type == EMBER_VAL_ITERATOR) {
+        stage = pipe_stage(vm, argv[0], ITERATOR_PIPE_ZIP, held[0], 0);
+    }
+    vm->stack_top--;
+    return stage;
+}
+
+// iter_chunk(source, n): arrays of n values, the last one possibly shorter
+ember_value ember_native_iter_chunk(ember_vm* vm, int argc, ember_value* argv) {
+    int size = argc == 2 ? pipe_count_arg(argv[1], 1) : -1;
+    if (size < 0) return ember_make_nil();
+    return pipe_stage(vm, argv[0], ITERATOR_PIPE_CHUNK, ember_make_nil(), size);
+}
+
+// iter_collect(source): the remaining values in an array
+ember_value ember_native_iter_collect(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 1) return ember_make_nil();
+    ember_value* held = pipe_reserve(vm, 2);
+    if (!held) return ember_make_nil();
+    held[0] = pipe_source(vm, argv[0]);
+    if (held[0].type == EMBER_VAL_ITERATOR) {
+        held[1] = ember_make_array(vm, 8);
+    }
+
+    ember_value result = held[1];
+    if (result.type == EMBER_VAL_ARRAY) {
+        ember_value value;
+        int status;
+        while ((status = pipe_pull(AS_ITERATOR(held[0]), &value)) == 1) {
+            array_push_with_vm(vm, AS_ARRAY(result), value);
+        }
+        if (status < 0) result = ember_make_nil();
+    }
+    vm->stack_top -= 2;
+    return result;
+}
+
+// iter_reduce(source, fn[, initial]): fn(accumulator, value, index) over
+// the values; without initial the first value starts the accumulator
+ember_value ember_native_iter_reduce(ember_vm* vm, int argc, ember_value* argv) {
+    if ((argc != 2 && argc != 3) || !vm_callable(argv[1], 3)) return ember_make_nil();
+    // The source, then the callback's three arguments
+    ember_value* held = pipe_reserve(vm, 4);
+    if (!held) return ember_make_nil();
+    ember_value* args = &held[1];
+    held[0] = pipe_source(vm, argv[0]);
+    if (held[0].type != EMBER_VAL_ITERATOR) {
+        vm->stack_top -= 4;
+        return ember_make_nil();
+    }
+
+    // The accumulator lives in args[0], rooted while the source is pulled
+    ember_iterator* source = AS_ITERATOR(held[0]);
+    int index = 0;
+    int status = 1;
+    if (argc == 3) {
+        args[0] = argv[2];
+    } else {
+        status = pipe_pull(source, &args[0]);
+        index = 1;
+    }
+    while (status == 1 && (status = pipe_pull(source, &args[1])) == 1) {
+        args[2] = ember_make_number(index++);
+        ember_value accumulator;
+        if (vm_call_prepared(vm, argv[1], 3, args, &accumulator) != 0) {
+            status = -1;
+        } else {
+            args[0] = accumulator;
+        }
+    }
+    ember_value result = args[0];
+    vm->stack_top -= 4;
+    return status < 0 ? ember_make_nil() : result;
+}
+
+// iter_count(source): how many values remain, reading them all
+ember_value ember_native_iter_count(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 1) return ember_make_nil();
+    ember_value* held = pipe_reserve(vm, 1);
+    if (!held) return ember_make_nil();
+    held[0] = pipe_source(vm, argv[0]);
+
+    double count = 0;
+    int status = -1;
+    if (held[0].type == EMBER_VAL_ITERATOR) {
+        ember_value value;
+        while ((status = pipe_pull(AS_ITERATOR(held[0]), &value)) == 1) {
+            count++;
+        }
+    }
+    vm->stack_top--;
+    return status < 0 ? ember_make_nil() : ember_make_number(count);
+}
@@ -4,76 +4,623 @@
  */
 
 #include "ember.h"
+#include "../vm.h"
+#include "value/value.h"
+#include "json_stream.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
 
-// Simple JSON parsing - supports basic objects and primitives
-static char* skip_whitespace(char* json) {
-    while (*json && isspace(*json)) json++;
-    return json;
+// JSON parsing: one recursive-descent pass that builds the maps and arrays
+// directly. Each container is sized from a look-ahead count of its members,
+// strings are copied once (escapes decode straight into the bytes the string
+// keeps), and keys are interned, so the same key in a thousand records is
+// one string.
+//
+// Collection can run on any allocation. The top-level container sits on the
+// VM stack and every nested one is stored into its parent before it is
+// filled, so only the key waiting for its value needs a root of its own: a
+// second stack slot.
+
+#define JSON_MAX_DEPTH 128
+
+// Large documents get a structural index first (simdjson's stage one): the
+// offsets of every unescaped quote and of every {}[]:, outside a string,
+// found 64 bytes at a time with vector compares and bit arithmetic. The
+// descent then takes each string's closing quote and each container's
+// member count from the index instead of rescanning bytes; below the
+// threshold, or without vector instructions, it scans as before.
+#define JSON_INDEX_MIN (64 * 1024)
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define JSON_SIMD 1
+#define JSON_LANE 32
+
+typedef __m256i json_vec;
+static inline json_vec json_load(const char* at) { return _mm256_loadu_si256((const __m256i*)at); }
+static inline json_vec json_eq(json_vec v, char c) { return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)); }
+static inline json_vec json_or(json_vec a, json_vec b) { return _mm256_or_si256(a, b); }
+static inline json_vec json_control(json_vec v) {
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1F)), v);
 }
+static inline uint64_t json_bits(json_vec m) { return (uint32_t)_mm256_movemask_epi8(m); }
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define JSON_SIMD 1
+#define JSON_LANE 16
 
-// Parse a simple JSON string (very basic implementation)
-static ember_value parse_json_value(ember_vm* vm, char** json_ptr) {
-    char* json = skip_whitespace(*json_ptr);
-    
-    if (*json == '"') {
-        // Parse string
-        json++; // Skip opening quote
-        char* start = json;
-        while (*json && *json != '"') {
-            if (*json == '\\') json++; // Skip escaped chars
-            json++;
-        }
-        if (*json == '"') {
-            size_t len = json - start;
-            char* str = malloc(len + 1);
-            if (str) {
-                strncpy(str, start, len);
-                str[len] = '\0';
-                ember_value result = ember_make_string_gc(vm, str);
-                free(str);
-                *json_ptr = json + 1;
-                return result;
+typedef __m128i json_vec;
+static inline json_vec json_load(const char* at) { return _mm_loadu_si128((const __m128i*)at); }
+static inline json_vec json_eq(json_vec v, char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); }
+static inline json_vec json_or(json_vec a, json_vec b) { return _mm_or_si128(a, b); }
+static inline json_vec json_control(json_vec v) {
+    return _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1F)), v);
+}
+static inline uint64_t json_bits(json_vec m) { return (uint16_t)_mm_movemask_epi8(m); }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define JSON_SIMD 1
+#define JSON_LANE 16
+
+typedef uint8x16_t json_vec;
+static inline json_vec json_load(const char* at) { return vld1q_u8((const uint8_t*)at); }
+static inline json_vec json_eq(json_vec v, char c) { return vceqq_u8(v, vdupq_n_u8((uint8_t)c)); }
+static inline json_vec json_or(json_vec a, json_vec b) { return vorrq_u8(a, b); }
+static inline json_vec json_control(json_vec v) { return vcleq_u8(v, vdupq_n_u8(0x1F)); }
+// One bit per byte: weight each lane by its bit and add across halves
+static inline uint64_t json_bits(json_vec m) {
+    static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t weighted = vandq_u8(m, vld1q_u8(weights));
+    return (uint64_t)vaddv_u8(vget_low_u8(weighted)) | (uint64_t)vaddv_u8(vget_high_u8(weighted)) << 8;
+}
+#else
+#define JSON_SIMD 0
+#endif
+
+typedef struct {
+    uint32_t* positions;         // Ascending offsets of quotes and structural characters
+    uint32_t* members;           // For each '{' or '[' entry, its member count
+    size_t count;
+    size_t next;                 // First entry not behind the parser's cursor
+} json_index;
+
+typedef struct {
+    ember_vm* vm;
+    const char* cursor;
+    const char* end;
+    int depth;
+    int key_slot;                // vm->stack slot holding the pending key
+    char* scratch;               // Decoded short strings and keys
+    size_t scratch_capacity;
+    const char* start;
+    json_index* index;           // NULL for small documents
+} json_parser;
+
+#if JSON_SIMD
+typedef struct {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t structural;
+    uint64_t control;
+} json_block;
+
+static void classify_block(const char* at, json_block* block) {
+    for (int i = 0; i < 64; i += JSON_LANE) {
+        json_vec v = json_load(at + i);
+        json_vec structural = json_or(json_or(json_or(json_eq(v, '{'), json_eq(v, '}')),
+                                              json_or(json_eq(v, '['), json_eq(v, ']'))),
+                                      json_or(json_eq(v, ':'), json_eq(v, ',')));
+        block->quote |= json_bits(json_eq(v, '"')) << i;
+        block->backslash |= json_bits(json_eq(v, '\\')) << i;
+        block->structural |= json_bits(structural) << i;
+        block->control |= json_bits(json_control(v)) << i;
+    }
+}
+
+// Bits just past each odd-length run of backslashes: the escaped bytes.
+// Runs starting on even and odd bits are added separately so each carry
+// lands right after its run, and *carry says the block ended mid-run
+// with an odd count.
+static uint64_t escaped_bits(uint64_t backslash, uint64_t* carry) {
+    const uint64_t even = 0x5555555555555555ULL;
+    uint64_t starts = backslash & ~(backslash << 1);
+    uint64_t even_start_mask = even ^ *carry;
+    uint64_t even_starts = starts & even_start_mask;
+    uint64_t odd_starts = starts & ~even_start_mask;
+    uint64_t even_carries = backslash + even_starts;
+    uint64_t odd_carries = backslash + odd_starts;
+    bool overflow = odd_carries < backslash;
+    odd_carries |= *carry;
+    *carry = overflow ? 1 : 0;
+    uint64_t even_ends = even_carries & ~backslash & ~even;
+    uint64_t odd_ends = odd_carries & ~backslash & even;
+    return even_ends | odd_ends;
+}
+
+// Each bit becomes the parity of the bits at and below it: set from an
+// opening quote up to, not including, its closing one
+static uint64_t prefix_xor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+// Members of every container from one walk over the index: commas at its
+// own level plus one unless it's empty. Like count_members this only sizes
+// containers, but nesting past JSON_MAX_DEPTH fails the parse either way
+static bool count_index_members(json_index* index, const char* json) {
+    size_t open[JSON_MAX_DEPTH];
+    int depth = 0;
+    for (size_t i = 0; i < index->count; i++) {
+        uint32_t at = index->positions[i];
+        switch (json[at]) {
+            case '"':
+                i++;             // The closing quote
+                break;
+            case '{': case '[':
+                if (depth == JSON_MAX_DEPTH) return false;
+                index->members[i] = 0;
+                open[depth++] = i;
+                break;
+            case ',':
+                if (depth > 0) index->members[open[depth - 1]]++;
+                break;
+            case '}': case ']': {
+                if (depth == 0) break;
+                size_t opened = open[--depth];
+                bool any = i > opened + 1;
+                for (uint32_t c = index->positions[opened] + 1; !any && c < at; c++) {
+                    any = json[c] != ' ' && json[c] != '\n' && json[c] != '\r' && json[c] != '\t';
+                }
+                index->members[opened] = any ? index->members[opened] + 1 : 0;
+                break;
             }
         }
-        return ember_make_nil();
-    } else if (*json == '{') {
-        // Parse object (return simple representation)
-        ember_value map = ember_make_hash_map(vm, 8);
-        json++; // Skip {
-        json = skip_whitespace(json);
-        
-        if (*json == '}') {
-            *json_ptr = json + 1;
-            return map;
-        }
-        
-        // For simplicity, just return an empty map
-        while (*json && *json != '}') json++;
-        if (*json == '}') json++;
-        *json_ptr = json;
-        return map;
-    } else if (isdigit(*json) || *json == '-') {
-        // Parse number
-        char* endptr;
-        double num = strtod(json, &endptr);
-        *json_ptr = endptr;
-        return ember_make_number(num);
-    } else if (strncmp(json, "true", 4) == 0) {
-        *json_ptr = json + 4;
-        return ember_make_bool(1);
-    } else if (strncmp(json, "false", 5) == 0) {
-        *json_ptr = json + 5;
-        return ember_make_bool(0);
-    } else if (strncmp(json, "null", 4) == 0) {
-        *json_ptr = json + 4;
-        return ember_make_nil();
+    }
+    return true;
+}
+
+// Builds the index; false when the document is malformed in a way the
+// index already shows (an unterminated string, a control character in a
+// string, nesting too deep) or memory runs out, with *malformed telling
+// which
+static bool build_index(json_index* index, const char* json, size_t length, bool* malformed) {
+    *malformed = false;
+    index->positions = malloc(length * sizeof(uint32_t));
+    if (!index->positions) return false;
+    index->count = 0;
+    index->next = 0;
+
+    uint64_t escape_carry = 0;
+    uint64_t in_string_carry = 0;
+    uint64_t bad = 0;
+    for (size_t at = 0; at < length; at += 64) {
+        json_block block = {0, 0, 0, 0};
+        if (length - at >= 64) {
+            classify_block(json + at, &block);
+        } else {
+            char tail[64];
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, json + at, length - at);
+            classify_block(tail, &block);
+        }
+        uint64_t quotes = block.quote & ~escaped_bits(block.backslash, &escape_carry);
+        uint64_t in_string = prefix_xor(quotes) ^ in_string_carry;
+        in_string_carry = (uint64_t)((int64_t)in_string >> 63);
+        bad |= block.control & in_string;
+        for (uint64_t marks = quotes | (block.structural & ~in_string); marks; marks &= marks - 1) {
+            index->positions[index->count++] = (uint32_t)(at + (size_t)__builtin_ctzll(marks));
+        }
+    }
+    if (bad || in_string_carry) {
+        *malformed = true;
+        return false;
+    }
+
+    index->members = malloc((index->count ? index->count : 1) * sizeof(uint32_t));
+    if (!index->members) return false;
+    if (!count_index_members(index, json)) {
+        *malformed = true;
+        return false;
+    }
+    return true;
+}
+#endif
+
+// The index entry for the character at `at`, or -1. The cursor only moves
+// forward, so the search resumes where the last one stopped
+static long index_entry(json_parser* p, const char* at) {
+    json_index* index = p->index;
+    uint32_t offset = (uint32_t)(at - p->start);
+    while (index->next < index->count && index->positions[index->next] < offset) index->next++;
+    return index->next < index->count && index->positions[index->next] == offset ? (long)index->next : -1;
+}
+
+static void skip_space(json_parser* p) {
+    while (p->cursor < p->end && (*p->cursor == ' ' || *p->cursor == '\n' ||
+                                  *p->cursor == '\r' || *p->cursor == '\t')) {
+        p->cursor++;
+    }
+}
+
+static bool consume(json_parser* p, char c) {
+    skip_space(p);
+    if (p->cursor < p->end && *p->cursor == c) {
+        p->cursor++;
+        return true;
+    }
+    return false;
+}
+
+static bool consume_word(json_parser* p, const char* word, size_t length) {
+    if ((size_t)(p->end - p->cursor) < length || memcmp(p->cursor, word, length) != 0) return false;
+    p->cursor += length;
+    return true;
+}
+
+// Members of the container opened at the cursor: commas at its own level
+// plus one. Only sizes the container, so malformed input just counts wrong
+static int count_members(json_parser* p) {
+    if (p->index) {
+        long entry = index_entry(p, p->cursor);
+        if (entry >= 0) return (int)p->index->members[entry];
+    }
+    const char* from = p->cursor + 1;
+    const char* end = p->end;
+    int depth = 0;
+    int count = 0;
+    bool any = false;
+    for (const char* c = from; c < end; c++) {
+        switch (*c) {
+            case '"':
+                for (c++; c < end && *c != '"'; c++) {
+                    if (*c == '\\') c++;
+                }
+                any = true;
+                break;
+            case '{': case '[':
+                depth++;
+                any = true;
+                break;
+            case '}': case ']':
+                if (depth-- == 0) return any ? count + 1 : 0;
+                break;
+            case ',':
+                if (depth == 0) count++;
+                break;
+            case ' ': case '\n': case '\r': case '\t':
+                break;
+            default:
+                any = true;
+                break;
+        }
+    }
+    return any ? count + 1 : 0;
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool read_hex4(const char* at, const char* end, unsigned* out) {
+    if (end - at < 4) return false;
+    unsigned value = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = hex_digit(at[i]);
+        if (digit < 0) return false;
+        value = value << 4 | (unsigned)digit;
+    }
+    *out = value;
+    return true;
+}
+
+// Decodes the string body from..close into out (at most close - from bytes);
+// returns the decoded length, or -1 for a bad escape
+static int decode_string(const char* from, const char* close, char* out) {
+    char* o = out;
+    for (const char* c = from; c < close; c++) {
+        if (*c != '\\') {
+            *o++ = *c;
+            continue;
+        }
+        c++;
+        switch (*c) {
+            case '"':  *o++ = '"'; break;
+            case '\\': *o++ = '\\'; break;
+            case '/':  *o++ = '/'; break;
+            case 'b':  *o++ = '\b'; break;
+            case 'f':  *o++ = '\f'; break;
+            case 'n':  *o++ = '\n'; break;
+            case 'r':  *o++ = '\r'; break;
+            case 't':  *o++ = '\t'; break;
+            case 'u': {
+                unsigned code;
+                if (!read_hex4(c + 1, close, &code)) return -1;
+                c += 4;
+                if (code >= 0xD800 && code <= 0xDBFF) {
+                    // A high surrogate needs its low half
+                    unsigned low;
+                    if (close - c < 7 || c[1] != '\\' || c[2] != 'u' ||
+                        !read_hex4(c + 3, close, &low) || low < 0xDC00 || low > 0xDFFF) {
+                        return -1;
+                    }
+                    c += 6;
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                } else if (code >= 0xDC00 && code <= 0xDFFF) {
+                    return -1;
+                }
+                // UTF-8 is never longer than the escape it came from
+                if (code < 0x80) {
+                    *o++ = (char)code;
+                } else if (code < 0x800) {
+                    *o++ = (char)(0xC0 | code >> 6);
+                    *o++ = (char)(0x80 | (code & 0x3F));
+                } else if (code < 0x10000) {
+                    *o++ = (char)(0xE0 | code >> 12);
+                    *o++ = (char)(0x80 | (code >> 6 & 0x3F));
+                    *o++ = (char)(0x80 | (code & 0x3F));
+                } else {
+                    *o++ = (char)(0xF0 | code >> 18);
+                    *o++ = (char)(0x80 | (code >> 12 & 0x3F));
+                    *o++ = (char)(0x80 | (code >> 6 & 0x3F));
+                    *o++ = (char)(0x80 | (code & 0x3F));
+                }
+                break;
+            }
+            default:
+                return -1;
+        }
+    }
+    return (int)(o - out);
+}
+
+// Finds the closing quote of the string at the cursor; *escaped tells
+// whether the body has to be decoded
+static const char* scan_string(json_parser* p, bool* escaped) {
+    if (p->index) {
+        // Control characters in strings were rejected while indexing
+        long entry = index_entry(p, p->cursor);
+        if (entry >= 0 && (size_t)entry + 1 < p->index->count) {
+            const char* close = p->start + p->index->positions[entry + 1];
+            *escaped = memchr(p->cursor + 1, '\\', (size_t)(close - p->cursor - 1)) != NULL;
+            return close;
+        }
+    }
+    *escaped = false;
+    for (const char* c = p->cursor + 1; c < p->end; c++) {
+        if (*c == '"') return c;
+        if (*c == '\\') {
+            *escaped = true;
+            c++;
+        } else if ((unsigned char)*c < 0x20) {
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+static char* scratch(json_parser* p, size_t size) {
+    if (size > p->scratch_capacity) {
+        size_t capacity = p->scratch_capacity ? p->scratch_capacity : 256;
+        while (capacity < size) capacity *= 2;
+        char* grown = realloc(p->scratch, capacity);
+        if (!grown) return NULL;
+        p->scratch = grown;
+        p->scratch_capacity = capacity;
+    }
+    return p->scratch;
+}
+
+// Reads a string at the cursor; keys are interned
+static ember_string* parse_string(json_parser* p, bool key) {
+    bool escaped;
+    const char* close = scan_string(p, &escaped);
+    if (!close) return NULL;
+    const char* from = p->cursor + 1;
+    size_t raw = (size_t)(close - from);
+    p->cursor = close + 1;
+    if (raw > INT32_MAX) return NULL;
+
+    if (!escaped) {
+        return key ? intern_string(p->vm, from, (int)raw) : copy_string(p->vm, from, (int)raw);
+    }
+    if (!key && raw > EMBER_STRING_INLINE_MAX) {
+        // Decode into the buffer the string will own
+        char* chars = malloc(raw + 1);
+        if (!chars) return NULL;
+        int length = decode_string(from, close, chars);
+        if (length < 0) {
+            free(chars);
+            return NULL;
+        }
+        chars[length] = '\0';
+        return allocate_string(p->vm, chars, length);
+    }
+    char* buffer = scratch(p, raw + 1);
+    if (!buffer) return NULL;
+    int length = decode_string(from, close, buffer);
+    if (length < 0) return NULL;
+    return key ? intern_string(p->vm, buffer, length) : copy_string(p->vm, buffer, length);
+}
+
+static bool parse_number(json_parser* p, ember_value* out) {
+    const char* c = p->cursor;
+    bool negative = c < p->end && *c == '-';
+    if (negative) c++;
+    if (c >= p->end || !isdigit((unsigned char)*c)) return false;
+
+    // Integers short enough to be exact skip strtod
+    double integer = 0;
+    int digits = 0;
+    if (*c == '0') {
+        c++;
+        digits = 1;
+    } else {
+        for (; c < p->end && isdigit((unsigned char)*c); c++, digits++) {
+            integer = integer * 10 + (*c - '0');
+        }
+    }
+    bool simple = digits <= 15;
+    if (c < p->end && *c == '.') {
+        c++;
+        if (c >= p->end || !isdigit((unsigned char)*c)) return false;
+        while (c < p->end && isdigit((unsigned char)*c)) c++;
+        simple = false;
+    }
+    if (c < p->end && (*c == 'e' || *c == 'E')) {
+        c++;
+        if (c < p->end && (*c == '+' || *c == '-')) c++;
+        if (c >= p->end || !isdigit((unsigned char)*c)) return false;
+        while (c < p->end && isdigit((unsigned char)*c)) c++;
+        simple = false;
+    }
+
+    double value = simple ? (negative ? -integer : integer) : strtod(p->cursor, NULL);
+    p->cursor = c;
+    *out = ember_make_number(value);
+    return true;
+}
+
+// Reads a scalar at the cursor, or creates the container a '{' or '[' opens,
+// sized for its members and still empty: the caller stores it where the
+// collector sees it and then calls fill_container
+static bool begin_value(json_parser* p, ember_value* out) {
+    skip_space(p);
+    if (p->cursor >= p->end) return false;
+    switch (*p->cursor) {
+        case '"': {
+            ember_string* string = parse_string(p, false);
+            if (!string) return false;
+            out->type = EMBER_VAL_STRING;
+            out->as.obj_val = (ember_object*)string;
+            return true;
+        }
+        case '{': {
+            int members = count_members(p);
+            *out = ember_make_hash_map(p->vm, members ? members + members / 7 + 1 : 0);
+            return out->type == EMBER_VAL_HASH_MAP;
+        }
+        case '[':
+            *out = ember_make_array(p->vm, count_members(p));
+            return out->type == EMBER_VAL_ARRAY;
+        case 't':
+            *out = ember_make_bool(1);
+            return consume_word(p, "true", 4);
+        case 'f':
+            *out = ember_make_bool(0);
+            return consume_word(p, "false", 5);
+        case 'n':
+            *out = ember_make_nil();
+            return consume_word(p, "null", 4);
+        default:
+            return parse_number(p, out);
+    }
+}
+
+static bool fill_container(json_parser* p, ember_value container);
+
+static bool fill_array(json_parser* p, ember_array* array) {
+    if (consume(p, ']')) return true;
+    do {
+        ember_value element;
+        if (!begin_value(p, &element)) return false;
+        array_push_with_vm(p->vm, array, element);
+        if (!fill_container(p, element)) return false;
+    } while (consume(p, ','));
+    return consume(p, ']');
+}
+
+static bool fill_map(json_parser* p, ember_hash_map* map) {
+    if (consume(p, '}')) return true;
+    do {
+        skip_space(p);
+        if (p->cursor >= p->end || *p->cursor != '"') return false;
+        ember_string* key_string = parse_string(p, true);
+        if (!key_string) return false;
+        ember_value key;
+        key.type = EMBER_VAL_STRING;
+        key.as.obj_val = (ember_object*)key_string;
+        p->vm->stack[p->key_slot] = key;
+        if (!consume(p, ':')) return false;
+
+        ember_value value;
+        if (!begin_value(p, &value)) return false;
+        hash_map_set_with_vm(p->vm, map, key, value);
+        if (!fill_container(p, value)) return false;
+    } while (consume(p, ','));
+    return consume(p, '}');
+}
+
+// Parses the members of a container begin_value created; scalars are done
+static bool fill_container(json_parser* p, ember_value container) {
+    if (container.type != EMBER_VAL_ARRAY && container.type != EMBER_VAL_HASH_MAP) return true;
+    if (++p->depth > JSON_MAX_DEPTH) return false;
+    p->cursor++;
+    bool ok = container.type == EMBER_VAL_ARRAY ? fill_array(p, AS_ARRAY(container))
+                                                 : fill_map(p, AS_HASH_MAP(container));
+    p->depth--;
+    return ok;
+}
+
+bool ember_json_parse_text(ember_vm* vm, const char* json, size_t length, ember_value* out) {
+    *out = ember_make_nil();
+    if (vm->stack_top + 2 > EMBER_STACK_MAX) {
+        return false;
+    }
+    
+    json_parser parser = {vm, json, json + length, 0, 0, NULL, 0, json, NULL};
+#if JSON_SIMD
+    json_index index = {NULL, NULL, 0, 0};
+    if (length >= JSON_INDEX_MIN && length <= UINT32_MAX) {
+        bool malformed;
+        if (build_index(&index, json, length, &malformed)) {
+            parser.index = &index;
+        } else {
+            free(index.positions);
+            free(index.members);
+            index.positions = NULL;
+            index.members = NULL;
+            if (malformed) return false;
+        }
+    }
+#endif
+    int root_slot = vm->stack_top;
+    parser.key_slot = root_slot + 1;
+    vm->stack[root_slot] = ember_make_nil();
+    vm->stack[parser.key_slot] = ember_make_nil();
+    vm->stack_top += 2;
+    
+    ember_value result;
+    bool ok = begin_value(&parser, &result);
+    if (ok) {
+        vm->stack[root_slot] = result;
+        ok = fill_container(&parser, result);
+    }
+    // Nothing but whitespace may follow
+    if (ok) {
+        skip_space(&parser);
+        ok = parser.cursor == parser.end;
     }
     
-    return ember_make_nil();
+    vm->stack_top = root_slot;
+    free(parser.scratch);
+#if JSON_SIMD
+    free(index.positions);
+    free(index.members);
+#endif
+    if (ok) *out = result;
+    return ok;
 }
 
 ember_value ember_json_parse_working(ember_vm* vm, int argc, ember_value* argv) {
@@ -82,94 +629,289 @@ ember_value ember_json_parse_working(ember_vm* vm, int argc, ember_value* argv)
     }
     
     ember_string* json_str = AS_STRING(argv[0]);
-    char* json_copy = malloc(strlen(json_str->chars) + 1);
-    if (!json_copy) return ember_make_nil();
-    
-    strcpy(json_copy, json_str->chars);
-    char* json_ptr = json_copy;
-    
-    ember_value result = parse_json_value(vm, &json_ptr);
-    free(json_copy);
+    const char* json = ember_string_flatten(json_str);
+    if (!json) return ember_make_nil();
     
+    ember_value result;
+    ember_json_parse_text(vm, json, (size_t)json_str->length, &result);
     return result;
 }
 
-static void append_escaped_string(char** buffer, size_t* size, size_t* capacity, const char* str) {
-    size_t needed = strlen(str) + 2; // quotes
-    if (*size + needed >= *capacity) {
-        *capacity = (*capacity == 0) ? 256 : *capacity * 2;
-        *buffer = realloc(*buffer, *capacity);
+// JSON encoding: one recursive walk into a json_out. json_stringify builds
+// its result in a per-VM buffer that stays allocated between calls, so a
+// response serialized every request reuses last request's memory; json_write
+// (json_stream.c) drains the same walk into a file or callback instead.
+// Strings are scanned a vector at a time for bytes that need escaping and
+// copied in runs, and numbers come out as the shortest text that reads back
+// as the same double.
+
+#define JSON_BUFFER_KEEP (1024 * 1024)    // Larger buffers go to the result string
+
+typedef struct {
+    json_out* out;
+    ember_object* open[JSON_MAX_DEPTH];   // Containers being written, outermost first
+    int depth;
+} json_encoder;
+
+static bool out_reserve(json_out* out, size_t size) {
+    if (out->length + size <= out->capacity) return true;
+    if (out->flush) {
+        if (!out->flush(out)) return false;
+        if (size <= out->capacity) return true;
     }
-    
-    (*buffer)[(*size)++] = '"';
-    while (*str) {
-        if (*str == '"' || *str == '\\') {
-            (*buffer)[(*size)++] = '\\';
-        }
-        (*buffer)[(*size)++] = *str++;
+    size_t capacity = out->capacity ? out->capacity : 256;
+    while (capacity < out->length + size) capacity *= 2;
+    char* grown = realloc(out->data, capacity);
+    if (!grown) return false;
+    out->data = grown;
+    out->capacity = capacity;
+    return true;
+}
+
+static bool out_write(json_out* out, const char* data, size_t length) {
+    // A flushed output keeps its chunk size however long the string
+    while (out->flush && out->length + length > out->capacity) {
+        size_t part = out->capacity - out->length;
+        memcpy(out->data + out->length, data, part);
+        out->length += part;
+        data += part;
+        length -= part;
+        if (!out->flush(out)) return false;
     }
-    (*buffer)[(*size)++] = '"';
+    if (!out_reserve(out, length)) return false;
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+    return true;
+}
+
+static inline bool out_char(json_out* out, char c) {
+    if (out->length == out->capacity && !out_reserve(out, 1)) return false;
+    out->data[out->length++] = c;
+    return true;
 }
 
-static void append_string(char** buffer, size_t* size, size_t* capacity, const char* str) {
-    size_t len = strlen(str);
-    if (*size + len >= *capacity) {
-        *capacity = (*capacity == 0) ? 256 : *capacity * 2;
-        while (*size + len >= *capacity) *capacity *= 2;
-        *buffer = realloc(*buffer, *capacity);
+// Bytes from `from` that need no escape
+static size_t plain_run(const char* from, size_t length) {
+    size_t i = 0;
+#if JSON_SIMD
+    for (; i + JSON_LANE <= length; i += JSON_LANE) {
+        json_vec v = json_load(from + i);
+        uint64_t stops = json_bits(json_or(json_or(json_eq(v, '"'), json_eq(v, '\\')), json_control(v)));
+        if (stops) return i + (size_t)__builtin_ctzll(stops);
     }
-    strcpy(*buffer + *size, str);
-    *size += len;
+#endif
+    for (; i < length; i++) {
+        unsigned char c = (unsigned char)from[i];
+        if (c < 0x20 || c == '"' || c == '\\') break;
+    }
+    return i;
 }
 
-ember_value ember_json_stringify_working(ember_vm* vm, int argc, ember_value* argv) {
-    (void)vm;
-    if (argc != 1) {
-        return ember_make_nil();
+static bool encode_string(json_out* out, const char* chars, size_t length) {
+    if (!out_char(out, '"')) return false;
+    for (size_t at = 0; at < length;) {
+        size_t run = plain_run(chars + at, length - at);
+        if (run && !out_write(out, chars + at, run)) return false;
+        at += run;
+        if (at == length) break;
+        char escape[8] = {'\\', 0};
+        size_t size = 2;
+        unsigned char c = (unsigned char)chars[at++];
+        switch (c) {
+            case '"':  escape[1] = '"'; break;
+            case '\\': escape[1] = '\\'; break;
+            case '\n': escape[1] = 'n'; break;
+            case '\r': escape[1] = 'r'; break;
+            case '\t': escape[1] = 't'; break;
+            case '\b': escape[1] = 'b'; break;
+            case '\f': escape[1] = 'f'; break;
+            default:
+                size = (size_t)snprintf(escape, sizeof(escape), "\\u%04x", c);
+                break;
+        }
+        if (!out_write(out, escape, size)) return false;
     }
-    
-    char* buffer = NULL;
-    size_t size = 0;
-    size_t capacity = 0;
-    
-    ember_value value = argv[0];
-    char temp[64];
-    
-    switch (value.type) {
+    return out_char(out, '"');
+}
+
+// Shortest text that strtod reads back as number: integers are written
+// digit by digit, anything else tries 15, 16 and then 17 significant digits
+int json_format_number(double number, char* text, size_t size) {
+    // JSON has no NaN or infinities
+    if (number != number || number - number != 0) return snprintf(text, size, "null");
+    if (number == (double)(int64_t)number && number > -9007199254740992.0 && number < 9007199254740992.0) {
+        int64_t integer = (int64_t)number;
+        char digits[24];
+        int count = 0;
+        uint64_t magnitude = integer < 0 ? (uint64_t)-integer : (uint64_t)integer;
+        do {
+            digits[count++] = (char)('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude);
+        int length = 0;
+        if (integer < 0 || (integer == 0 && 1 / number < 0)) text[length++] = '-';
+        while (count) text[length++] = digits[--count];
+        text[length] = '\0';
+        return length;
+    }
+    int length = 0;
+    for (int precision = 15; precision <= 17; precision++) {
+        length = snprintf(text, size, "%.*g", precision, number);
+        if (precision == 17 || strtod(text, NULL) == number) break;
+    }
+    return length;
+}
+
+static bool encode(json_encoder* encoder, ember_value value);
+
+static bool encode_key(json_out* out, ember_value key) {
+    char text[32];
+    switch (key.type) {
         case EMBER_VAL_STRING: {
-            ember_string* str = AS_STRING(value);
-            append_escaped_string(&buffer, &size, &capacity, str->chars);
-            break;
+            ember_string* string = AS_STRING(key);
+            const char* chars = ember_string_flatten(string);
+            return chars && encode_string(out, chars, (size_t)string->length);
         }
         case EMBER_VAL_NUMBER:
-            snprintf(temp, sizeof(temp), "%g", value.as.number_val);
-            append_string(&buffer, &size, &capacity, temp);
-            break;
+            return encode_string(out, text, (size_t)json_format_number(key.as.number_val, text, sizeof(text)));
         case EMBER_VAL_BOOL:
-            append_string(&buffer, &size, &capacity, value.as.bool_val ? "true" : "false");
-            break;
+            return key.as.bool_val ? encode_string(out, "true", 4) : encode_string(out, "false", 5);
+        default:
+            return false;
+    }
+}
+
+// Enters a container: false for one already being written (a cycle) or
+// nesting deeper than the parser accepts
+static bool enter(json_encoder* encoder, ember_object* container) {
+    if (encoder->depth == JSON_MAX_DEPTH) return false;
+    for (int i = 0; i < encoder->depth; i++) {
+        if (encoder->open[i] == container) return false;
+    }
+    encoder->open[encoder->depth++] = container;
+    return true;
+}
+
+// Lengths and entries are read again for every element: a json_write sink
+// runs script code and may change the containers being written
+static bool encode(json_encoder* encoder, ember_value value) {
+    json_out* out = encoder->out;
+    switch (value.type) {
         case EMBER_VAL_NIL:
-            append_string(&buffer, &size, &capacity, "null");
-            break;
-        case EMBER_VAL_HASH_MAP:
-            append_string(&buffer, &size, &capacity, "{}");
-            break;
-        case EMBER_VAL_ARRAY:
-            append_string(&buffer, &size, &capacity, "[]");
-            break;
+            return out_write(out, "null", 4);
+        case EMBER_VAL_BOOL:
+            return value.as.bool_val ? out_write(out, "true", 4) : out_write(out, "false", 5);
+        case EMBER_VAL_NUMBER: {
+            char text[32];
+            return out_write(out, text, (size_t)json_format_number(value.as.number_val, text, sizeof(text)));
+        }
+        case EMBER_VAL_STRING: {
+            ember_string* string = AS_STRING(value);
+            const char* chars = ember_string_flatten(string);
+            return chars && encode_string(out, chars, (size_t)string->length);
+        }
+        case EMBER_VAL_ARRAY: {
+            ember_array* array = AS_ARRAY(value);
+            if (!enter(encoder, value.as.obj_val) || !out_char(out, '[')) return false;
+            for (int i = 0; i < array->length; i++) {
+                if ((i > 0 && !out_char(out, ',')) || !encode(encoder, array->elements[i])) return false;
+            }
+            encoder->depth--;
+            return out_char(out, ']');
+        }
+        case EMBER_VAL_HASH_MAP: {
+            ember_hash_map* map = AS_HASH_MAP(value);
+            if (!enter(encoder, value.as.obj_val) || !out_char(out, '{')) return false;
+            bool first = true;
+            for (int i = 0; i < map->capacity; i++) {
+                if (!map->entries[i].is_occupied) continue;
+                if ((!first && !out_char(out, ',')) || !encode_key(out, map->entries[i].key) ||
+                    !out_char(out, ':') || !encode(encoder, map->entries[i].value)) {
+                    return false;
+                }
+                first = false;
+            }
+            encoder->depth--;
+            return out_char(out, '}');
+        }
+        case EMBER_VAL_MAP: {
+            // Entries are dense and in insertion order: keys come out as
+            // they went in, and only live ones are visited
+            ember_map* map = AS_MAP(value);
+            if (!enter(encoder, value.as.obj_val) || !out_char(out, '{')) return false;
+            bool first = true;
+            for (int i = 0; i < map->count; i++) {
+                if (!map->entries[i].is_occupied) continue;
+                if ((!first && !out_char(out, ',')) || !encode_key(out, map->entries[i].key) ||
+                    !out_char(out, ':') || !encode(encoder, map->entries[i].value)) {
+                    return false;
+                }
+                first = false;
+            }
+            encoder->depth--;
+            return out_char(out, '}');
+        }
         default:
-            append_string(&buffer, &size, &capacity, "null");
-            break;
+            // Functions, classes and the like have no JSON form
+            return out_write(out, "null", 4);
+    }
+}
+
+bool json_encode_value(json_out* out, ember_value value) {
+    json_encoder encoder;
+    encoder.out = out;
+    encoder.depth = 0;
+    return encode(&encoder, value);
+}
+
+void json_buffer_free(ember_vm* vm) {
+    free(vm->json_buffer);
+    vm->json_buffer = NULL;
+    vm->json_buffer_capacity = 0;
+}
+
+ember_value ember_json_stringify_working(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 1) {
+        return ember_make_nil();
     }
     
-    if (buffer) {
-        buffer[size] = '\0';
-        ember_value result = ember_make_string_gc(vm, buffer);
-        free(buffer);
-        return result;
+    // Borrow the VM's buffer; a nested call (none today) would get its own
+    json_out out = {vm->json_buffer, 0, vm->json_buffer_capacity, NULL, NULL};
+    vm->json_buffer = NULL;
+    vm->json_buffer_capacity = 0;
+    
+    bool ok = json_encode_value(&out, argv[0]) && out.length <= INT32_MAX;
+    ember_value result = ember_make_nil();
+    if (ok && out.capacity > JSON_BUFFER_KEEP && out_reserve(&out, 1)) {
+        // Too big to keep around: the string takes the buffer itself
+        char* chars = realloc(out.data, out.length + 1);
+        if (chars) {
+            chars[out.length] = '\0';
+            ember_string* string = allocate_string(vm, chars, (int)out.length);
+            out.data = NULL;
+            out.capacity = 0;
+            if (string) {
+                result.type = EMBER_VAL_STRING;
+                result.as.obj_val = (ember_object*)string;
+            }
+        }
+    } else if (ok) {
+        ember_string* string = copy_string(vm, out.data ? out.data : "", (int)out.length);
+        if (string) {
+            result.type = EMBER_VAL_STRING;
+            result.as.obj_val = (ember_object*)string;
+        }
     }
     
-    return ember_make_nil();
+    if (out.capacity > JSON_BUFFER_KEEP) {
+        free(out.data);
+    } else if (!vm->json_buffer) {
+        vm->json_buffer = out.data;
+        vm->json_buffer_capacity = out.capacity;
+    } else {
+        free(out.data);
+    }
+    return result;
 }
 
 ember_value ember_json_validate_working(ember_vm* vm, int argc, ember_value* argv) {
@@ -0,0 +1,419 @@
+/**
+ * Streaming JSON for Ember: incremental reader and chunked encoder
+ * json_read / json_write, and the reader behind http.stream_json
+ */
+
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../vm.h"
+#include "value/value.h"
+#include "json_stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define JSON_STREAM_CHUNK (64 * 1024)   // File reads and encoder flushes
+
+// ============================================================================
+// READER
+// ============================================================================
+
+typedef enum {
+    READER_VALUES,                     // Top-level values, whitespace between
+    READER_OPEN,                       // Elements mode: before the '['
+    READER_FIRST,                      // After '[': an element or ']'
+    READER_ELEMENT,                    // After ',': an element
+    READER_AFTER,                      // After an element: ',' or ']'
+    READER_CLOSED                      // After the ']': whitespace only
+} reader_state;
+
+struct json_reader {
+    ember_vm* vm;
+    json_reader_emit emit;
+    void* context;
+    reader_state state;
+    char* buffer;                      // The unfinished value, from its first byte
+    size_t length;
+    size_t capacity;
+    size_t scanned;                    // Bytes of buffer already scanned
+    int in_value;
+    int depth;                         // Containers open in the value
+    int in_string;
+    int escaped;                       // The last byte was a backslash in a string
+    size_t count;
+    const char* error;
+};
+
+static inline int is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static int reader_fail(json_reader* reader, const char* error) {
+    if (!reader->error) reader->error = error;
+    return -1;
+}
+
+static int reserve(json_reader* reader, size_t size) {
+    if (size <= reader->capacity) return 1;
+    size_t capacity = reader->capacity ? reader->capacity : 256;
+    while (capacity < size) capacity *= 2;
+    char* grown = realloc(reader->buffer, capacity);
+    if (!grown) return 0;
+    reader->buffer = grown;
+    reader->capacity = capacity;
+    return 1;
+}
+
+// The value framed in from..from+length is complete
+static int emit_value(json_reader* reader, const char* from, size_t length) {
+    ember_value value;
+    reader->in_value = 0;
+    if (!ember_json_parse_text(reader->vm, from, length, &value)) {
+        return reader_fail(reader, "Malformed JSON");
+    }
+    reader->count++;
+    if (reader->state != READER_VALUES) reader->state = READER_AFTER;
+    if (reader->emit(reader->vm, value, reader->context) != 0) {
+        return reader_fail(reader, "Value callback failed");
+    }
+    return 0;
+}
+
+// Scans region from reader->scanned, emitting every value that ends in it.
+// *start is where the unfinished value begins
+static int scan(json_reader* reader, const char* region, size_t length, size_t* start) {
+    for (size_t i = reader->scanned; i < length; i++) {
+        char c = region[i];
+        if (reader->in_value) {
+            if (reader->in_string) {
+                if (reader->escaped) {
+                    reader->escaped = 0;
+                    continue;
+                }
+                while (i < length && region[i] != '"' && region[i] != '\\') i++;
+                if (i == length) break;
+                if (region[i] == '\\') {
+                    reader->escaped = 1;
+                } else {
+                    reader->in_string = 0;
+                    if (reader->depth == 0 && emit_value(reader, region + *start, i + 1 - *start) != 0) {
+                        return -1;
+                    }
+                }
+                continue;
+            }
+            if (reader->depth == 0) {
+                // A number or literal ends where anything else begins; that
+                // byte is looked at again
+                if (is_space(c) || c == ',' || c == ':' || c == '"' ||
+                    c == '[' || c == ']' || c == '{' || c == '}') {
+                    if (emit_value(reader, region + *start, i - *start) != 0) return -1;
+                    i--;
+                }
+                continue;
+            }
+            switch (c) {
+                case '"':
+                    reader->in_string = 1;
+                    break;
+                case '{': case '[':
+                    reader->depth++;
+                    break;
+                case '}': case ']':
+                    if (--reader->depth == 0 && emit_value(reader, region + *start, i + 1 - *start) != 0) {
+                        return -1;
+                    }
+                    break;
+                default:
+                    break;
+            }
+            continue;
+        }
+
+        if (is_space(c)) continue;
+        switch (reader->state) {
+            case READER_OPEN:
+                if (c != '[') return reader_fail(reader, "Expected a JSON array");
+                reader->state = READER_FIRST;
+                continue;
+            case READER_FIRST:
+                if (c == ']') {
+                    reader->state = READER_CLOSED;
+                    continue;
+                }
+                break;
+            case READER_AFTER:
+                if (c == ',') {
+                    reader->state = READER_ELEMENT;
+                } else if (c == ']') {
+                    reader->state = READER_CLOSED;
+                } else {
+                    return reader_fail(reader, "Malformed JSON");
+                }
+                continue;
+            case READER_CLOSED:
+                return reader_fail(reader, "Malformed JSON");
+            case READER_VALUES:
+            case READER_ELEMENT:
+                break;
+        }
+        if (c == ',' || c == ':' || c == ']' || c == '}') {
+            return reader_fail(reader, "Malformed JSON");
+        }
+        reader->in_value = 1;
+        *start = i;
+        if (c == '"') {
+            reader->in_string = 1;
+        } else if (c == '{' || c == '[') {
+            reader->depth = 1;
+        }
+    }
+    return 0;
+}
+
+json_reader* json_reader_new(ember_vm* vm, bool elements, json_reader_emit emit, void* context) {
+    if (!vm || !emit) return NULL;
+    json_reader* reader = calloc(1, sizeof(json_reader));
+    if (!reader) return NULL;
+    reader->vm = vm;
+    reader->emit = emit;
+    reader->context = context;
+    reader->state = elements ? READER_OPEN : READER_VALUES;
+    return reader;
+}
+
+void json_reader_free(json_reader* reader) {
+    if (!reader) return;
+    free(reader->buffer);
+    free(reader);
+}
+
+int json_reader_feed(json_reader* reader, const char* data, size_t length) {
+    if (reader->error) return -1;
+    // Values that start and end in data are parsed where they are; only the
+    // unfinished one at the end is copied
+    const char* region = data;
+    size_t region_length = length;
+    if (reader->length > 0) {
+        if (!reserve(reader, reader->length + length)) return reader_fail(reader, "Out of memory");
+        memcpy(reader->buffer + reader->length, data, length);
+        reader->length += length;
+        region = reader->buffer;
+        region_length = reader->length;
+    }
+    size_t start = 0;
+    if (scan(reader, region, region_length, &start) != 0) return -1;
+
+    if (!reader->in_value) {
+        reader->length = 0;
+        reader->scanned = 0;
+        return 0;
+    }
+    size_t keep = region_length - start;
+    if (region == reader->buffer) {
+        memmove(reader->buffer, reader->buffer + start, keep);
+    } else {
+        if (!reserve(reader, keep)) return reader_fail(reader, "Out of memory");
+        memcpy(reader->buffer, data + start, keep);
+    }
+    reader->length = keep;
+    reader->scanned = keep;
+    return 0;
+}
+
+int json_reader_finish(json_reader* reader) {
+    if (reader->error) return -1;
+    if (reader->in_value) {
+        if (reader->depth > 0 || reader->in_string) return reader_fail(reader, "Truncated JSON");
+        // A number or literal runs to the end of the input
+        if (emit_value(reader, reader->buffer, reader->length) != 0) return -1;
+        reader->length = 0;
+        reader->scanned = 0;
+    }
+    if (reader->state != READER_VALUES && reader->state != READER_CLOSED) {
+        return reader_fail(reader, "Truncated JSON");
+    }
+    return 0;
+}
+
+size_t json_reader_count(const json_reader* reader) {
+    return reader->count;
+}
+
+const char* json_reader_error(const json_reader* reader) {
+    return reader->error;
+}
+
+// ============================================================================
+// ENCODER
+// ============================================================================
+
+// The output goes to a file or to a callback, JSON_STREAM_CHUNK bytes at a
+// time; the document itself is never built. The encoding is json_simple.c's,
+// with writer_flush as the json_out's flush
+typedef struct {
+    ember_vm* vm;
+    FILE* file;
+    ember_value sink;                  // Called with each chunk when file is NULL
+    json_out out;
+    size_t written;
+    int failed;
+} json_writer;
+
+static int is_callable(ember_value value) {
+    return value.type == EMBER_VAL_FUNCTION || value.type == EMBER_VAL_NATIVE;
+}
+
+// A callback that throws ends the call it was made from; the exception is
+// reported and dropped as the event loop does for promise callbacks
+static int call_back(ember_vm* vm, ember_value callback, ember_value argument) {
+    ember_value ignored;
+    if (vm_call_value(vm, callback, 1, &argument, &ignored) != 0) {
+        fprintf(stderr, "[JSON] Stream callback failed\n");
+        vm->exception_pending = 0;
+        vm->current_exception = ember_make_nil();
+        return -1;
+    }
+    return 0;
+}
+
+static bool writer_flush(json_out* out) {
+    json_writer* writer = out->context;
+    if (writer->failed) return false;
+    if (out->length == 0) return true;
+    if (writer->file) {
+        if (fwrite(out->data, 1, out->length, writer->file) != out->length) {
+            writer->failed = 1;
+        }
+    } else {
+        ember_string* chunk = copy_string(writer->vm, out->data, (int)out->length);
+        ember_value argument;
+        argument.type = EMBER_VAL_STRING;
+        argument.as.obj_val = (ember_object*)chunk;
+        if (!chunk || call_back(writer->vm, writer->sink, argument) != 0) {
+            writer->failed = 1;
+        }
+    }
+    if (!writer->failed) writer->written += out->length;
+    out->length = 0;
+    return !writer->failed;
+}
+
+static int put_char(json_writer* writer, char c) {
+    if (writer->out.length == writer->out.capacity && !writer_flush(&writer->out)) return 0;
+    writer->out.data[writer->out.length++] = c;
+    return 1;
+}
+
+// Pulls the next element of an array or generator source into *out; 0 at
+// the end, -1 if the generator failed
+static int next_element(ember_vm* vm, ember_value source, int* index, ember_value* out) {
+    if (source.type == EMBER_VAL_ARRAY) {
+        ember_array* array = AS_ARRAY(source);
+        if (*index >= array->length) return 0;
+        *out = array->elements[(*index)++];
+        return 1;
+    }
+    int status = vm_generator_resume(vm, AS_GENERATOR(source), ember_make_nil(), out);
+    if (status < 0) {
+        vm->exception_pending = 0;
+        vm->current_exception = ember_make_nil();
+    }
+    return status;
+}
+
+// Each element of source, as NDJSON lines or as one array
+static int encode_elements(json_writer* writer, ember_value source, int lines) {
+    ember_vm* vm = writer->vm;
+    if (vm->stack_top + 1 > EMBER_STACK_MAX) return 0;
+    if (!lines && !put_char(writer, '[')) return 0;
+    int index = 0;
+    int status;
+    ember_value element;
+    for (int count = 0; (status = next_element(vm, source, &index, &element)) == 1; count++) {
+        // A generated value is nowhere else while it is written
+        vm->stack[vm->stack_top++] = element;
+        int ok = (lines || count == 0 || put_char(writer, ',')) && json_encode_value(&writer->out, element) &&
+                 (!lines || put_char(writer, '\n'));
+        vm->stack_top--;
+        if (!ok) return 0;
+    }
+    return status == 0 && (lines || put_char(writer, ']'));
+}
+
+// ============================================================================
+// NATIVES
+// ============================================================================
+
+static int emit_to_callback(ember_vm* vm, ember_value value, void* context) {
+    return call_back(vm, *(ember_value*)context, value);
+}
+
+// json_read(path, on_value [, elements])
+ember_value ember_json_read_working(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc < 2 || argc > 3 || argv[0].type != EMBER_VAL_STRING || !is_callable(argv[1]) ||
+        (argc == 3 && argv[2].type != EMBER_VAL_BOOL)) {
+        return ember_make_nil();
+    }
+    const char* path = AS_CSTRING(argv[0]);
+    int fd = ember_vfs_open(vm, path, O_RDONLY, 0);
+    FILE* file = fd >= 0 ? fdopen(fd, "rb") : NULL;
+    if (!file) {
+        if (fd >= 0) close(fd);
+        return ember_make_nil();
+    }
+
+    ember_value on_value = argv[1];
+    json_reader* reader = json_reader_new(vm, argc == 3 && argv[2].as.bool_val, emit_to_callback, &on_value);
+    char* chunk = malloc(JSON_STREAM_CHUNK);
+    int ok = reader && chunk;
+    while (ok) {
+        size_t length = fread(chunk, 1, JSON_STREAM_CHUNK, file);
+        if (length > 0 && json_reader_feed(reader, chunk, length) != 0) ok = 0;
+        if (length < JSON_STREAM_CHUNK) break;
+    }
+    ok = ok && !ferror(file) && json_reader_finish(reader) == 0;
+    fclose(file);
+    free(chunk);
+
+    ember_value result = ok ? ember_make_number((double)json_reader_count(reader)) : ember_make_nil();
+    json_reader_free(reader);
+    return result;
+}
+
+// json_write(sink, source [, lines])
+ember_value ember_json_write_working(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc < 2 || argc > 3 || (argv[0].type != EMBER_VAL_STRING && !is_callable(argv[0])) ||
+        (argc == 3 && argv[2].type != EMBER_VAL_BOOL)) {
+        return ember_make_nil();
+    }
+    ember_value source = argv[1];
+    int lines = argc == 3 && argv[2].as.bool_val;
+    int elements = source.type == EMBER_VAL_GENERATOR || (lines && source.type == EMBER_VAL_ARRAY);
+    if (lines && !elements) {
+        return ember_make_nil();
+    }
+
+    json_writer writer = {vm, NULL, argv[0], {NULL, 0, JSON_STREAM_CHUNK, writer_flush, NULL}, 0, 0};
+    writer.out.context = &writer;
+    if (argv[0].type == EMBER_VAL_STRING) {
+        const char* path = AS_CSTRING(argv[0]);
+        int fd = ember_vfs_open(vm, path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        writer.file = fd >= 0 ? fdopen(fd, "wb") : NULL;
+        if (!writer.file) {
+            if (fd >= 0) close(fd);
+            return ember_make_nil();
+        }
+    }
+    writer.out.data = malloc(JSON_STREAM_CHUNK);
+    int ok = writer.out.data != NULL;
+    if (ok) {
+        ok = elements ? encode_elements(&writer, source, lines) : json_encode_value(&writer.out, source);
+    }
+    ok = ok && writer_flush(&writer.out);
+    if (writer.file && fclose(writer.file) != 0) ok = 0;
+    free(writer.out.data);
+    return ok ? ember_make_number((double)writer.written) : ember_make_nil();
+}
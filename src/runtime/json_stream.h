@@ -0,0 +1,68 @@
+#ifndef EMBER_JSON_STREAM_H
+#define EMBER_JSON_STREAM_H
+
+#include "ember.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Incremental JSON (json_stream.c) for documents that should never exist as
+// one string: NDJSON logs, huge exports, HTTP bodies still arriving.
+//
+// A reader takes the input in chunks of any size and hands each complete
+// value to its emit callback as soon as the value's last byte arrives. It
+// frames values with a small byte scanner (depth, strings, escapes) and
+// parses each one with the one-shot parser, so it only ever holds the value
+// being read. Top-level values may follow one another separated by
+// whitespace (NDJSON, concatenated JSON); in elements mode the input is one
+// array and each of its elements is a value instead.
+
+// One-shot parse of length bytes (json_simple.c); false and nil if the text
+// is not exactly one JSON value
+bool ember_json_parse_text(ember_vm* vm, const char* json, size_t length, ember_value* out);
+
+// Output for the JSON encoder (json_simple.c). Without flush the buffer just
+// grows; with it, a full buffer is handed to flush, which empties it (sets
+// length to 0) and returns false to abandon the encode.
+typedef struct json_out {
+    char* data;
+    size_t length;
+    size_t capacity;
+    bool (*flush)(struct json_out* out);
+    void* context;
+} json_out;
+
+// Appends value's JSON text: false for a cycle, a key that is not a string,
+// number or bool, nesting past the parser's limit, or a failed flush.
+// Values with no JSON form (functions and the like) are written as null
+bool json_encode_value(json_out* out, ember_value value);
+// Shortest text for number that reads back as the same double; its length
+int json_format_number(double number, char* text, size_t size);
+
+// Non-zero stops the reader, which then fails
+typedef int (*json_reader_emit)(ember_vm* vm, ember_value value, void* context);
+
+typedef struct json_reader json_reader;
+
+json_reader* json_reader_new(ember_vm* vm, bool elements, json_reader_emit emit, void* context);
+void json_reader_free(json_reader* reader);
+// 0, or -1 once the input is malformed or emit stopped the reader; later
+// calls fail too
+int json_reader_feed(json_reader* reader, const char* data, size_t length);
+// The end of the input: a value still open is malformed
+int json_reader_finish(json_reader* reader);
+// Values emitted so far
+size_t json_reader_count(const json_reader* reader);
+// Why the reader failed, or NULL
+const char* json_reader_error(const json_reader* reader);
+
+// json_read(path, on_value [, elements]): on_value(value) for each value
+// in the file at a VFS path, read in chunks; the number of values, or nil
+ember_value ember_json_read_working(ember_vm* vm, int argc, ember_value* argv);
+// json_write(sink, source [, lines]): encodes source to a VFS path or, when
+// sink is a function, to sink(chunk) one buffer at a time. With lines, an
+// array or generator source is written as NDJSON, one line per element; a
+// generator is otherwise written as an array of what it yields. The number
+// of bytes written, or nil
+ember_value ember_json_write_working(ember_vm* vm, int argc, ember_value* argv);
+
+#endif // EMBER_JSON_STREAM_H
@@ -0,0 +1,362 @@
+/**
+ * Structured logger: log / log_flush
+ *
+ * log(level, message [, fields]) formats one JSON line on the calling
+ * thread and queues it; a background writer thread owns the file
+ * descriptor and hands whatever has queued to writev(2) in one call, so a
+ * busy script pays for formatting and a few atomics per record, never for
+ * a write. Records below the configured level are dropped before they are
+ * formatted. The queue is a fixed ring shared by every VM in the process
+ * (the bounded MPMC ring of structured_clone.c's channels, drained by one
+ * consumer); when it is full the record is dropped and counted rather than
+ * making the script wait for the disk.
+ *
+ * A record is {"ts":<Unix seconds>,"level":"info","msg":<message>,...} with
+ * the fields map's entries after msg, and a newline. log_flush and
+ * ember_log_flush wait until everything queued so far is written; the
+ * queue is also drained at process exit.
+ */
+
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../vm.h"
+#include "value/value.h"
+#include "template_stubs.h"  // ember_get_string_value
+#include "json_stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#define LOG_RING_SIZE 4096                   // Records waiting; a power of two
+#define LOG_INLINE 232                       // Longer records are allocated
+#define LOG_BATCH 64                         // Records per writev
+#define LOG_IDLE_WAIT_MS 100                 // The writer's sleep, in case a wakeup is missed
+#define LOG_CACHE_LINE 64
+#define LOG_BUFFER_KEEP (64 * 1024)
+
+static const char* const level_names[] = {"debug", "info", "warn", "error"};
+
+typedef struct {
+    size_t sequence;        // Position this cell is free for (queued) or full for (queued + 1)
+    char* heap;             // The record when it did not fit in text
+    uint32_t length;
+    char text[LOG_INLINE];
+} log_cell;
+
+static struct {
+    log_cell* cells;
+    int fd;
+    int level;
+    int started;            // The writer thread is running
+    int stopping;
+    int sleeping;           // The writer is (about to be) waiting on wake
+    uint64_t dropped;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;    // Records were queued, or stopping
+    pthread_cond_t drained; // written moved on
+    char pad0[LOG_CACHE_LINE];
+    size_t queue_position;  // Next cell to claim, on its own cache line
+    char pad1[LOG_CACHE_LINE - sizeof(size_t)];
+    size_t written;         // Records handed to the fd (or dropped by a failed write)
+    char pad2[LOG_CACHE_LINE - sizeof(size_t)];
+} logger = {
+    .fd = STDERR_FILENO,
+    .level = EMBER_LOG_INFO,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .drained = PTHREAD_COND_INITIALIZER,
+};
+
+static pthread_once_t start_once = PTHREAD_ONCE_INIT;
+
+// ============================================================================
+// WRITER
+// ============================================================================
+
+static int write_all(int fd, struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0 && errno == EINTR) continue;
+        if (written < 0) return -1;
+        // Partial write: skip what went out and go again with the rest
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + written;
+            iov->iov_len -= (size_t)written;
+        }
+    }
+    return 0;
+}
+
+// Ready records from position on, up to LOG_BATCH of them
+static int ready_records(size_t position) {
+    int count = 0;
+    while (count < LOG_BATCH) {
+        log_cell* cell = &logger.cells[(position + (size_t)count) & (LOG_RING_SIZE - 1)];
+        if (__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) != position + (size_t)count + 1) break;
+        count++;
+    }
+    return count;
+}
+
+static void* writer_main(void* arg) {
+    (void)arg;
+    struct iovec iov[LOG_BATCH];
+    size_t position = 0;
+    for (;;) {
+        int count = ready_records(position);
+        if (count == 0) {
+            pthread_mutex_lock(&logger.lock);
+            __atomic_store_n(&logger.sleeping, 1, __ATOMIC_SEQ_CST);
+            // A producer publishes, then reads sleeping; reading the ring
+            // after setting it means one of the two sees the other
+            count = ready_records(position);
+            if (count == 0) {
+                if (logger.stopping &&
+                    __atomic_load_n(&logger.queue_position, __ATOMIC_SEQ_CST) == position) {
+                    __atomic_store_n(&logger.sleeping, 0, __ATOMIC_RELAXED);
+                    pthread_mutex_unlock(&logger.lock);
+                    return NULL;
+                }
+                struct timespec until;
+                clock_gettime(CLOCK_REALTIME, &until);
+                until.tv_nsec += LOG_IDLE_WAIT_MS * 1000000L;
+                if (until.tv_nsec >= 1000000000L) {
+                    until.tv_sec++;
+                    until.tv_nsec -= 1000000000L;
+                }
+                pthread_cond_timedwait(&logger.wake, &logger.lock, &until);
+            }
+            __atomic_store_n(&logger.sleeping, 0, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&logger.lock);
+            continue;
+        }
+
+        for (int i = 0; i < count; i++) {
+            log_cell* cell = &logger.cells[(position + (size_t)i) & (LOG_RING_SIZE - 1)];
+            iov[i].iov_base = cell->heap ? cell->heap : cell->text;
+            iov[i].iov_len = cell->length;
+        }
+        // A failed write loses the batch; the records are counted as written
+        // so flush does not wait on them forever
+        write_all(__atomic_load_n(&logger.fd, __ATOMIC_ACQUIRE), iov, count);
+        for (int i = 0; i < count; i++) {
+            log_cell* cell = &logger.cells[(position + (size_t)i) & (LOG_RING_SIZE - 1)];
+            free(cell->heap);
+            cell->heap = NULL;
+            __atomic_store_n(&cell->sequence, position + (size_t)i + LOG_RING_SIZE, __ATOMIC_RELEASE);
+        }
+        position += (size_t)count;
+
+        pthread_mutex_lock(&logger.lock);
+        __atomic_store_n(&logger.written, position, __ATOMIC_RELEASE);
+        pthread_cond_broadcast(&logger.drained);
+        pthread_mutex_unlock(&logger.lock);
+    }
+}
+
+static void logger_stop(void) {
+    ember_log_flush();
+    pthread_mutex_lock(&logger.lock);
+    logger.stopping = 1;
+    pthread_cond_signal(&logger.wake);
+    pthread_mutex_unlock(&logger.lock);
+    pthread_join(logger.thread, NULL);
+    __atomic_store_n(&logger.started, 0, __ATOMIC_RELEASE);
+}
+
+static void logger_start(void) {
+    log_cell* cells = calloc(LOG_RING_SIZE, sizeof(log_cell));
+    if (!cells) return;
+    for (size_t i = 0; i < LOG_RING_SIZE; i++) {
+        cells[i].sequence = i;
+    }
+    logger.cells = cells;
+    if (pthread_create(&logger.thread, NULL, writer_main, NULL) != 0) return;
+    __atomic_store_n(&logger.started, 1, __ATOMIC_RELEASE);
+    atexit(logger_stop);
+}
+
+// ============================================================================
+// QUEUE
+// ============================================================================
+
+// Queues length bytes of record; false when the ring is full. Takes data
+// when it had to be allocated anyway (owned), copies it otherwise
+static bool logger_enqueue(char* record, size_t length, bool owned) {
+    size_t position = __atomic_load_n(&logger.queue_position, __ATOMIC_RELAXED);
+    log_cell* cell;
+    for (;;) {
+        cell = &logger.cells[position & (LOG_RING_SIZE - 1)];
+        size_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+        if (difference == 0) {
+            if (__atomic_compare_exchange_n(&logger.queue_position, &position, position + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (difference < 0) {
+            if (owned) free(record);
+            __atomic_add_fetch(&logger.dropped, 1, __ATOMIC_RELAXED);
+            return false;
+        } else {
+            position = __atomic_load_n(&logger.queue_position, __ATOMIC_RELAXED);
+        }
+    }
+    if (length <= LOG_INLINE) {
+        memcpy(cell->text, record, length);
+        if (owned) free(record);
+    } else if (owned) {
+        cell->heap = record;
+    } else {
+        cell->heap = malloc(length);
+        if (cell->heap) {
+            memcpy(cell->heap, record, length);
+        } else {
+            length = 0;  // The cell still has to be published: it goes out empty
+        }
+    }
+    cell->length = (uint32_t)length;
+    __atomic_store_n(&cell->sequence, position + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&logger.sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&logger.lock);
+        pthread_cond_signal(&logger.wake);
+        pthread_mutex_unlock(&logger.lock);
+    }
+    return true;
+}
+
+static bool log_append(json_out* out, const char* text, size_t length) {
+    if (out->length + length > out->capacity) {
+        size_t capacity = out->capacity ? out->capacity : 256;
+        while (capacity < out->length + length) capacity *= 2;
+        char* data = realloc(out->data, capacity);
+        if (!data) return false;
+        out->data = data;
+        out->capacity = capacity;
+    }
+    memcpy(out->data + out->length, text, length);
+    out->length += length;
+    return true;
+}
+
+static bool format_record(json_out* out, int level, ember_value message, ember_value fields) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    char head[96];
+    int length = snprintf(head, sizeof(head), "{\"ts\":%lld.%03ld,\"level\":\"%s\",\"msg\":",
+                          (long long)now.tv_sec, now.tv_nsec / 1000000L, level_names[level]);
+    if (!log_append(out, head, (size_t)length) || !json_encode_value(out, message)) return false;
+    if (fields.type != EMBER_VAL_NIL) {
+        // The map's own braces become the record's: {"k":v} -> ,"k":v}
+        size_t at = out->length;
+        if (!json_encode_value(out, fields)) return false;
+        if (out->length - at == 2) {
+            out->length = at;
+        } else {
+            out->data[at] = ',';
+            out->length--;
+        }
+    }
+    return log_append(out, "}\n", 2);
+}
+
+// ============================================================================
+// API
+// ============================================================================
+
+static int parse_level(ember_value value) {
+    const char* name = value.type == EMBER_VAL_STRING ? ember_get_string_value(value) : NULL;
+    if (!name) return -1;
+    for (int i = 0; i < 4; i++) {
+        if (strcmp(name, level_names[i]) == 0) return i;
+    }
+    return strcmp(name, "warning") == 0 ? EMBER_LOG_WARN : -1;
+}
+
+// log(level, message [, fields]): true once the record is queued, false if
+// it is below the level or the queue is full; nil for an unknown level,
+// fields that are not a map, or a record JSON cannot encode
+ember_value ember_native_log(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc < 2 || argc > 3) return ember_make_nil();
+    int level = parse_level(argv[0]);
+    if (level < 0) return ember_make_nil();
+    ember_value fields = argc == 3 ? argv[2] : ember_make_nil();
+    if (fields.type != EMBER_VAL_NIL && fields.type != EMBER_VAL_HASH_MAP && fields.type != EMBER_VAL_MAP) {
+        return ember_make_nil();
+    }
+    if (level < __atomic_load_n(&logger.level, __ATOMIC_RELAXED)) return ember_make_bool(false);
+
+    // Borrow the VM's JSON buffer, as json_stringify does
+    json_out out = {vm->json_buffer, 0, vm->json_buffer_capacity, NULL, NULL};
+    vm->json_buffer = NULL;
+    vm->json_buffer_capacity = 0;
+    ember_value result = ember_make_nil();
+    if (format_record(&out, level, argv[1], fields)) {
+        pthread_once(&start_once, logger_start);
+        if (__atomic_load_n(&logger.started, __ATOMIC_ACQUIRE)) {
+            // A record too long for a cell keeps the buffer and the VM starts a new one
+            bool owned = out.length > LOG_INLINE;
+            result = ember_make_bool(logger_enqueue(out.data, out.length, owned));
+            if (owned) {
+                out.data = NULL;
+                out.capacity = 0;
+            }
+        } else {
+            // No writer thread: write it here
+            struct iovec iov = {out.data, out.length};
+            result = ember_make_bool(write_all(__atomic_load_n(&logger.fd, __ATOMIC_ACQUIRE), &iov, 1) == 0);
+        }
+    }
+    if (out.capacity > LOG_BUFFER_KEEP || vm->json_buffer) {
+        free(out.data);
+    } else {
+        vm->json_buffer = out.data;
+        vm->json_buffer_capacity = out.capacity;
+    }
+    return result;
+}
+
+// log_flush(): true once every record queued so far is written
+ember_value ember_native_log_flush(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    (void)argv;
+    if (argc != 0) return ember_make_nil();
+    return ember_make_bool(ember_log_flush() == EMBER_SUCCESS);
+}
+
+int ember_log_flush(void) {
+    if (!__atomic_load_n(&logger.started, __ATOMIC_ACQUIRE)) return EMBER_SUCCESS;
+    size_t target = __atomic_load_n(&logger.queue_position, __ATOMIC_ACQUIRE);
+    pthread_mutex_lock(&logger.lock);
+    while (__atomic_load_n(&logger.written, __ATOMIC_ACQUIRE) < target) {
+        pthread_cond_signal(&logger.wake);
+        pthread_cond_wait(&logger.drained, &logger.lock);
+    }
+    pthread_mutex_unlock(&logger.lock);
+    return EMBER_SUCCESS;
+}
+
+int ember_log_configure(int fd, ember_log_level level) {
+    if (fd < 0 || level < EMBER_LOG_DEBUG || level > EMBER_LOG_ERROR) return EMBER_ERROR_INVALID_PARAMETER;
+    // Records already queued go where they were headed
+    ember_log_flush();
+    __atomic_store_n(&logger.fd, fd, __ATOMIC_RELEASE);
+    __atomic_store_n(&logger.level, (int)level, __ATOMIC_RELAXED);
+    return EMBER_SUCCESS;
+}
+
+uint64_t ember_log_dropped(void) {
+    return __atomic_load_n(&logger.dropped, __ATOMIC_RELAXED);
+}
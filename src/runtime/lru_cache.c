@@ -0,0 +1,382 @@
+/**
+ * LRU caches for Ember: cache_new / cache_get / cache_has / cache_put /
+ * cache_delete / cache_size / cache_clear / cache_prune / cache_stats
+ *
+ * A cache is bounded by a number of entries, an estimate of their bytes,
+ * or both, and evicts the least recently used entry to stay within them.
+ * Each entry sits on its bucket's chain in a hash index and on one doubly
+ * linked list ordered by use, so a get finds it and moves it to the front,
+ * and a put evicts from the back, in constant time; nothing is scanned.
+ *
+ * An entry may carry a TTL. Expired entries are dropped when a get or has
+ * finds them, from the back of the list as puts come in, and by
+ * cache_prune, so one that is never read again still goes. Deadlines are
+ * on the monotonic clock, read only for entries that have one.
+ *
+ * Keys hash and compare as a map's do. A put counts the entry's own size,
+ * the bytes of string, typed array and builder keys and values, and an
+ * array's element slots; any other object counts as its reference only.
+ * The estimate is taken when the entry is stored.
+ */
+
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../vm.h"
+#include "value/value.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+
+#define CACHE_MIN_BUCKETS 16
+#define CACHE_MAX_BUCKETS (1 << 30)
+#define CACHE_EXPIRED_PER_PUT 4              // Expired entries a put drops from the back
+
+static int64_t now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static size_t value_bytes(ember_value value) {
+    if (!value.as.obj_val) return 0;
+    switch (value.type) {
+        case EMBER_VAL_STRING:
+            if (value.as.obj_val->type != OBJ_STRING) return 0;
+            return sizeof(ember_string) + (size_t)AS_STRING(value)->length;
+        case EMBER_VAL_TYPED_ARRAY: {
+            ember_typed_array* array = AS_TYPED_ARRAY(value);
+            size_t element = array->kind == EMBER_TYPED_FLOAT64 ? sizeof(double)
+                             : array->kind == EMBER_TYPED_INT32 ? sizeof(int32_t)
+                                                                : sizeof(uint8_t);
+            return sizeof(ember_typed_array) + (size_t)array->length * element;
+        }
+        case EMBER_VAL_STRING_BUILDER:
+            return sizeof(ember_string_builder) + AS_STRING_BUILDER(value)->capacity;
+        case EMBER_VAL_ARRAY:
+            return sizeof(ember_array) + (size_t)AS_ARRAY(value)->capacity * sizeof(ember_value);
+        default:
+            return 0;
+    }
+}
+
+// ============================================================================
+// INDEX AND RECENCY LIST
+// ============================================================================
+
+static ember_cache_entry* cache_find(ember_cache* cache, ember_value key, uint32_t hash) {
+    if (!cache->buckets) return NULL;
+    ember_cache_entry* entry = cache->buckets[hash & (uint32_t)(cache->bucket_count - 1)];
+    while (entry && (entry->hash != hash || !values_equal_fast(entry->key, key))) {
+        entry = entry->chain;
+    }
+    return entry;
+}
+
+static void list_unlink(ember_cache* cache, ember_cache_entry* entry) {
+    if (entry->newer) entry->newer->older = entry->older;
+    else cache->newest = entry->older;
+    if (entry->older) entry->older->newer = entry->newer;
+    else cache->oldest = entry->newer;
+}
+
+static void list_push_front(ember_cache* cache, ember_cache_entry* entry) {
+    entry->newer = NULL;
+    entry->older = cache->newest;
+    if (cache->newest) cache->newest->newer = entry;
+    else cache->oldest = entry;
+    cache->newest = entry;
+}
+
+// Takes entry out of the index and the list, keeping it as the spare
+static void cache_remove(ember_cache* cache, ember_cache_entry* entry) {
+    ember_cache_entry** link = &cache->buckets[entry->hash & (uint32_t)(cache->bucket_count - 1)];
+    while (*link != entry) link = &(*link)->chain;
+    *link = entry->chain;
+    list_unlink(cache, entry);
+    cache->size--;
+    cache->bytes -= entry->bytes;
+    free(cache->spare);
+    cache->spare = entry;
+}
+
+static int cache_grow(ember_cache* cache) {
+    int count = cache->bucket_count ? cache->bucket_count * 2 : CACHE_MIN_BUCKETS;
+    if (count > CACHE_MAX_BUCKETS) return cache->buckets != NULL;
+    ember_cache_entry** buckets = calloc((size_t)count, sizeof(ember_cache_entry*));
+    if (!buckets) return cache->buckets != NULL;
+    for (ember_cache_entry* entry = cache->newest; entry; entry = entry->older) {
+        ember_cache_entry** head = &buckets[entry->hash & (uint32_t)(count - 1)];
+        entry->chain = *head;
+        *head = entry;
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->bucket_count = count;
+    return 1;
+}
+
+static int expired(const ember_cache_entry* entry, int64_t* now) {
+    if (entry->expires_ms == 0) return 0;
+    if (*now == 0) *now = now_ms();
+    return entry->expires_ms <= *now;
+}
+
+// The live entry for key, dropping it if it has expired
+static ember_cache_entry* cache_lookup(ember_cache* cache, ember_value key) {
+    ember_cache_entry* entry = cache_find(cache, key, hash_value_fast(key));
+    int64_t now = 0;
+    if (entry && expired(entry, &now)) {
+        cache_remove(cache, entry);
+        cache->expirations++;
+        return NULL;
+    }
+    return entry;
+}
+
+// ============================================================================
+// C API
+// ============================================================================
+
+ember_value ember_make_cache(ember_vm* vm, int max_entries, size_t max_bytes) {
+    if (max_entries < 0) return ember_make_nil();
+    ember_cache* cache = (ember_cache*)allocate_object(vm, sizeof(ember_cache), OBJ_CACHE);
+    if (!cache) return ember_make_nil();
+    cache->buckets = NULL;
+    cache->bucket_count = 0;
+    cache->size = 0;
+    cache->newest = NULL;
+    cache->oldest = NULL;
+    cache->spare = NULL;
+    cache->max_entries = max_entries;
+    cache->max_bytes = max_bytes;
+    cache->bytes = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+    cache->expirations = 0;
+    if (!cache_grow(cache)) return ember_make_nil();
+    ember_value value;
+    value.type = EMBER_VAL_CACHE;
+    value.as.obj_val = (ember_object*)cache;
+    return value;
+}
+
+int lru_cache_get(ember_cache* cache, ember_value key, ember_value* value) {
+    ember_cache_entry* entry = cache_lookup(cache, key);
+    if (!entry) {
+        cache->misses++;
+        return 0;
+    }
+    cache->hits++;
+    if (entry != cache->newest) {
+        list_unlink(cache, entry);
+        list_push_front(cache, entry);
+    }
+    *value = entry->value;
+    return 1;
+}
+
+int lru_cache_has(ember_cache* cache, ember_value key) {
+    return cache_lookup(cache, key) != NULL;
+}
+
+int lru_cache_put(ember_vm* vm, ember_cache* cache, ember_value key, ember_value value, int64_t ttl_ms) {
+    if (ember_object_is_frozen(cache) || ttl_ms < 0) return 0;
+    size_t bytes = sizeof(ember_cache_entry) + value_bytes(key) + value_bytes(value);
+    uint32_t hash = hash_value_fast(key);
+    ember_cache_entry* entry = cache_find(cache, key, hash);
+    if (cache->max_bytes && bytes > cache->max_bytes) {
+        // Never fits; the value it would have replaced is stale now
+        if (entry) cache_remove(cache, entry);
+        return 0;
+    }
+    int64_t now = 0;
+    ember_value old_key = ember_make_nil(), old_value = ember_make_nil();
+    if (entry) {
+        old_key = entry->key;
+        old_value = entry->value;
+        cache->bytes -= entry->bytes;
+        list_unlink(cache, entry);
+    } else {
+        if (cache->size >= cache->bucket_count && !cache_grow(cache)) return 0;
+        entry = cache->spare ? cache->spare : malloc(sizeof(ember_cache_entry));
+        if (!entry) return 0;
+        cache->spare = NULL;
+        entry->hash = hash;
+        ember_cache_entry** head = &cache->buckets[hash & (uint32_t)(cache->bucket_count - 1)];
+        entry->chain = *head;
+        *head = entry;
+        cache->size++;
+    }
+    entry->key = key;
+    entry->value = value;
+    entry->bytes = bytes;
+    entry->expires_ms = ttl_ms ? (now = now_ms()) + ttl_ms : 0;
+    cache->bytes += bytes;
+    list_push_front(cache, entry);
+    // Only once the entry is whole: the barrier may run a collection
+    gc_write_barrier_helper(vm, (ember_object*)cache, old_key, key);
+    gc_write_barrier_helper(vm, (ember_object*)cache, old_value, value);
+
+    // Whatever has expired at the back goes before anything live is evicted
+    for (int i = 0; i < CACHE_EXPIRED_PER_PUT && cache->oldest != entry && expired(cache->oldest, &now); i++) {
+        cache_remove(cache, cache->oldest);
+        cache->expirations++;
+    }
+    while (cache->oldest != entry && ((cache->max_entries && cache->size > cache->max_entries) ||
+                                      (cache->max_bytes && cache->bytes > cache->max_bytes))) {
+        cache_remove(cache, cache->oldest);
+        cache->evictions++;
+    }
+    return 1;
+}
+
+int lru_cache_delete(ember_cache* cache, ember_value key) {
+    if (ember_object_is_frozen(cache)) return 0;
+    ember_cache_entry* entry = cache_find(cache, key, hash_value_fast(key));
+    if (!entry) return 0;
+    cache_remove(cache, entry);
+    return 1;
+}
+
+void lru_cache_clear(ember_cache* cache) {
+    if (ember_object_is_frozen(cache)) return;
+    ember_cache_entry* entry = cache->newest;
+    while (entry) {
+        ember_cache_entry* older = entry->older;
+        free(entry);
+        entry = older;
+    }
+    if (cache->buckets) memset(cache->buckets, 0, (size_t)cache->bucket_count * sizeof(ember_cache_entry*));
+    cache->newest = NULL;
+    cache->oldest = NULL;
+    cache->size = 0;
+    cache->bytes = 0;
+}
+
+int lru_cache_prune(ember_cache* cache) {
+    if (ember_object_is_frozen(cache)) return 0;
+    int64_t now = 0;
+    int count = 0;
+    ember_cache_entry* entry = cache->newest;
+    while (entry) {
+        ember_cache_entry* older = entry->older;
+        if (expired(entry, &now)) {
+            cache_remove(cache, entry);
+            count++;
+        }
+        entry = older;
+    }
+    cache->expirations += (uint64_t)count;
+    return count;
+}
+
+// ============================================================================
+// NATIVES
+// ============================================================================
+
+// A count or size argument: a non-negative integer up to max
+static int bound_arg(ember_value value, double max, double* out) {
+    if (value.type == EMBER_VAL_NIL) {
+        *out = 0;
+        return 1;
+    }
+    double number = value.as.number_val;
+    if (value.type != EMBER_VAL_NUMBER || !(number >= 0 && number <= max) || number != trunc(number)) return 0;
+    *out = number;
+    return 1;
+}
+
+// cache_new(max_entries[, max_bytes]): 0 or nil leaves a bound off
+ember_value ember_native_cache_new(ember_vm* vm, int argc, ember_value* argv) {
+    double max_entries, max_bytes = 0;
+    if (argc < 1 || argc > 2 || !bound_arg(argv[0], INT32_MAX, &max_entries) ||
+        (argc == 2 && !bound_arg(argv[1], 9007199254740992.0, &max_bytes))) {
+        return ember_make_nil();
+    }
+    return ember_make_cache(vm, (int)max_entries, (size_t)max_bytes);
+}
+
+// lru_cache_get(c, key[, default]): the value, or default (nil) on a miss
+ember_value ember_native_cache_get(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc < 2 || argc > 3 || argv[0].type != EMBER_VAL_CACHE) return ember_make_nil();
+    ember_value value;
+    if (lru_cache_get(AS_CACHE(argv[0]), argv[1], &value)) return value;
+    return argc == 3 ? argv[2] : ember_make_nil();
+}
+
+ember_value ember_native_cache_has(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc != 2 || argv[0].type != EMBER_VAL_CACHE) return ember_make_nil();
+    return ember_make_bool(lru_cache_has(AS_CACHE(argv[0]), argv[1]));
+}
+
+// lru_cache_put(c, key, value[, ttl]): ttl in seconds. Whether it was stored;
+// false if the entry alone is over the cache's byte bound
+ember_value ember_native_cache_put(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc < 3 || argc > 4 || argv[0].type != EMBER_VAL_CACHE) return ember_make_nil();
+    int64_t ttl_ms = 0;
+    if (argc == 4 && argv[3].type != EMBER_VAL_NIL) {
+        double seconds = argv[3].as.number_val;
+        if (argv[3].type != EMBER_VAL_NUMBER || !(seconds > 0 && seconds <= 1e12)) return ember_make_nil();
+        ttl_ms = (int64_t)ceil(seconds * 1000);
+    }
+    ember_cache* cache = AS_CACHE(argv[0]);
+    if (ember_object_is_frozen(cache)) return ember_make_nil();
+    return ember_make_bool(lru_cache_put(vm, cache, argv[1], argv[2], ttl_ms));
+}
+
+ember_value ember_native_cache_delete(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc != 2 || argv[0].type != EMBER_VAL_CACHE) return ember_make_nil();
+    return ember_make_bool(lru_cache_delete(AS_CACHE(argv[0]), argv[1]));
+}
+
+ember_value ember_native_cache_size(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc != 1 || argv[0].type != EMBER_VAL_CACHE) return ember_make_nil();
+    return ember_make_number(AS_CACHE(argv[0])->size);
+}
+
+// lru_cache_clear(c): c, emptied; its counters are kept
+ember_value ember_native_cache_clear(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc != 1 || argv[0].type != EMBER_VAL_CACHE) return ember_make_nil();
+    lru_cache_clear(AS_CACHE(argv[0]));
+    return argv[0];
+}
+
+// lru_cache_prune(c): how many expired entries were dropped
+ember_value ember_native_cache_prune(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc != 1 || argv[0].type != EMBER_VAL_CACHE) return ember_make_nil();
+    return ember_make_number(lru_cache_prune(AS_CACHE(argv[0])));
+}
+
+static void stats_set(ember_vm* vm, ember_hash_map* map, const char* key, double value) {
+    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, key), ember_make_number(value));
+}
+
+// cache_stats(c): size, bytes, bounds, and hit, miss, eviction and
+// expiration counts
+ember_value ember_native_cache_stats(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 1 || argv[0].type != EMBER_VAL_CACHE || vm->stack_top >= EMBER_STACK_MAX) return ember_make_nil();
+    ember_cache* cache = AS_CACHE(argv[0]);
+    ember_value stats = ember_make_hash_map(vm, 16);
+    if (stats.type != EMBER_VAL_HASH_MAP) return ember_make_nil();
+    vm->stack[vm->stack_top++] = stats;
+    ember_hash_map* map = AS_HASH_MAP(stats);
+    stats_set(vm, map, "size", cache->size);
+    stats_set(vm, map, "bytes", (double)cache->bytes);
+    stats_set(vm, map, "max_entries", cache->max_entries);
+    stats_set(vm, map, "max_bytes", (double)cache->max_bytes);
+    stats_set(vm, map, "hits", (double)cache->hits);
+    stats_set(vm, map, "misses", (double)cache->misses);
+    stats_set(vm, map, "evictions", (double)cache->evictions);
+    stats_set(vm, map, "expirations", (double)cache->expirations);
+    vm->stack_top--;
+    return stats;
+}
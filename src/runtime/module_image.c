@@ -0,0 +1,232 @@
+#define _GNU_SOURCE
+#include "module_image.h"
+#include "module_prefetch.h"
+#include "value/value.h"
+#include "../vm.h"
+#include "../core/bytecode_format.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+// Shared module images. Without them every pooled VM lexes, parses and
+// compiles its own copy of each module it imports. The first import of a
+// path compiles it in a scratch VM and publishes the serialized unit here;
+// later imports, from any VM, load that unit with the code left in place
+// (ember_bytecode_load_shared), so only constants, function bindings and
+// globals are built per VM. An image is replaced when its file changes and
+// freed once no module uses it.
+
+#define IMAGES_INITIAL_CAPACITY 32
+
+static pthread_mutex_t images_lock = PTHREAD_MUTEX_INITIALIZER;
+static ember_module_image** images = NULL;   // Open addressing by path, NULL = empty
+static int image_count = 0;
+static int image_capacity = 0;               // Power of two
+
+static uint32_t path_hash(const char* path) {
+    return hash_string_chars(path, (int)strlen(path));
+}
+
+static int image_probe(const char* path, uint32_t hash) {
+    int mask = image_capacity - 1;
+    int index = (int)(hash & (uint32_t)mask);
+    while (images[index] && strcmp(images[index]->path, path) != 0) {
+        index = (index + 1) & mask;
+    }
+    return index;
+}
+
+// Keeps the table at most half full
+static int images_reserve(void) {
+    if ((image_count + 1) * 2 <= image_capacity) return 1;
+    int new_capacity = image_capacity < IMAGES_INITIAL_CAPACITY ? IMAGES_INITIAL_CAPACITY : image_capacity * 2;
+    ember_module_image** table = calloc((size_t)new_capacity, sizeof(ember_module_image*));
+    if (!table) {
+        fprintf(stderr, "[MODULE] Failed to grow module image table\n");
+        return 0;
+    }
+    for (int i = 0; i < image_capacity; i++) {
+        if (!images[i]) continue;
+        int index = (int)(path_hash(images[i]->path) & (uint32_t)(new_capacity - 1));
+        while (table[index]) {
+            index = (index + 1) & (new_capacity - 1);
+        }
+        table[index] = images[i];
+    }
+    free(images);
+    images = table;
+    image_capacity = new_capacity;
+    return 1;
+}
+
+static void image_free(ember_module_image* image) {
+    for (int i = 0; i < image->dep_count; i++) {
+        free(image->deps[i]);
+    }
+    free(image->deps);
+    free(image->data);
+    free(image->path);
+    free(image);
+}
+
+// Called with images_lock held
+static void image_unref(ember_module_image* image) {
+    if (--image->refs == 0) image_free(image);
+}
+
+void ember_module_image_retain(ember_module_image* image) {
+    if (!image) return;
+    pthread_mutex_lock(&images_lock);
+    image->refs++;
+    pthread_mutex_unlock(&images_lock);
+}
+
+void ember_module_image_release(ember_module_image* image) {
+    if (!image) return;
+    pthread_mutex_lock(&images_lock);
+    image_unref(image);
+    pthread_mutex_unlock(&images_lock);
+}
+
+static char* read_source(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+    char* source = NULL;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        long size = ftell(file);
+        if (size >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+            source = malloc((size_t)size + 1);
+            if (source) {
+                size_t read = fread(source, 1, (size_t)size, file);
+                source[read] = '\0';
+            }
+        }
+    }
+    fclose(file);
+    return source;
+}
+
+static void add_dep(void* context, const char* name) {
+    ember_module_image* image = context;
+    char** deps = realloc(image->deps, sizeof(char*) * (size_t)(image->dep_count + 1));
+    if (!deps) return;
+    image->deps = deps;
+    char* copy = strdup(name);
+    if (copy) image->deps[image->dep_count++] = copy;
+}
+
+static ember_module_image* image_build(const char* path, const struct stat* info) {
+    char* source = read_source(path);
+    if (!source) return NULL;
+    ember_module_image* image = calloc(1, sizeof(ember_module_image));
+    if (!image || !(image->path = strdup(path))) {
+        fprintf(stderr, "[MODULE] Memory allocation failed for module image\n");
+        free(image);
+        free(source);
+        return NULL;
+    }
+    image->mtime = (long long)info->st_mtime;
+    image->file_size = (long long)info->st_size;
+
+    // Compiled apart from any importing VM: its imports are only recorded
+    // here and linked into each VM that uses the image
+    ember_scan_imports(source, add_dep, image);
+    ember_vm* scratch = ember_new_vm();
+    if (scratch) {
+        scratch->defer_imports = 1;
+        if (!ember_bytecode_compile(scratch, source, &image->data, &image->size)) {
+            image->data = NULL;
+            image->size = 0;
+        }
+        ember_free_vm(scratch);
+    }
+    free(source);
+    return image;
+}
+
+ember_module_image* ember_module_image_acquire(const char* path) {
+    if (!path) return NULL;
+    struct stat info;
+    if (stat(path, &info) != 0) return NULL;
+    uint32_t hash = path_hash(path);
+
+    pthread_mutex_lock(&images_lock);
+    if (image_capacity > 0) {
+        ember_module_image* image = images[image_probe(path, hash)];
+        if (image && image->mtime == (long long)info.st_mtime && image->file_size == (long long)info.st_size) {
+            image->refs++;
+            pthread_mutex_unlock(&images_lock);
+            return image;
+        }
+    }
+    pthread_mutex_unlock(&images_lock);
+
+    // Compile without the lock; if another VM publishes the same file
+    // meanwhile, its image wins
+    ember_module_image* built = image_build(path, &info);
+    if (!built) return NULL;
+
+    pthread_mutex_lock(&images_lock);
+    ember_module_image* result = built;
+    if (images_reserve()) {
+        int index = image_probe(path, hash);
+        ember_module_image* published = images[index];
+        if (published && published->mtime == built->mtime && published->file_size == built->file_size) {
+            image_free(built);
+            result = published;
+        } else {
+            if (published) {
+                image_unref(published);
+            } else {
+                image_count++;
+            }
+            images[index] = built;
+            built->refs = 1;
+        }
+    }
+    result->refs++;
+    pthread_mutex_unlock(&images_lock);
+    return result;
+}
+
+int ember_module_image_link(ember_vm* vm, ember_module* module, ember_module_image* image) {
+    if (!vm || !module || !image || !image->data) return -1;
+    // The module takes over the caller's reference
+    ember_module_image_release(module->image);
+    module->image = image;
+
+    for (int i = 0; i < image->dep_count; i++) {
+        ember_import_module(vm, image->deps[i]);
+    }
+
+    double start = startup_clock();
+    ember_chunk* chunk = ember_bytecode_load_shared(vm, image->data, image->size);
+    startup_profile_module(module->name, STARTUP_MODULE_COMPILE, start);
+    if (!chunk) return -1;
+    // Kept for the VM's lifetime, like a chunk compiled on import
+    track_function_chunk(vm, chunk);
+    module->chunk = chunk;
+
+    int saved_local_count = vm->local_count;
+    vm->local_count = 0;
+    start = startup_clock();
+    int result = ember_bytecode_run(vm, chunk);
+    startup_profile_module(module->name, STARTUP_MODULE_EXECUTE, start);
+    vm->local_count = saved_local_count;
+    return result;
+}
+
+void ember_clear_module_images(void) {
+    pthread_mutex_lock(&images_lock);
+    for (int i = 0; i < image_capacity; i++) {
+        // Modules still running an image keep it until they are freed
+        if (images[i]) image_unref(images[i]);
+    }
+    free(images);
+    images = NULL;
+    image_count = 0;
+    image_capacity = 0;
+    pthread_mutex_unlock(&images_lock);
+}
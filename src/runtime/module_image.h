@@ -0,0 +1,33 @@
+#ifndef EMBER_MODULE_IMAGE_H
+#define EMBER_MODULE_IMAGE_H
+
+#include "ember.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// A module compiled once per process and shared by every VM that imports
+// it. The serialized unit is immutable: VMs run its code in place and only
+// build their own constants, function bindings and globals from it.
+typedef struct ember_module_image {
+    char* path;
+    long long mtime;         // Source file identity when compiled
+    long long file_size;
+    uint8_t* data;           // Serialized unit; NULL if the module did not compile
+    size_t size;
+    char** deps;             // Names it imports, in source order
+    int dep_count;
+    int refs;                // Modules using it, plus one while it is published
+} ember_module_image;
+
+// The image for path, compiled on first use or when the file changed, with a
+// reference taken; NULL if the file can't be read. An image whose data is
+// NULL records a failed compile, left to the caller's usual path.
+ember_module_image* ember_module_image_acquire(const char* path);
+// Another reference to an image already held (VM snapshot clones)
+void ember_module_image_retain(ember_module_image* image);
+void ember_module_image_release(ember_module_image* image);
+// Imports the image's dependencies into vm, then runs it there as module's
+// chunk; module keeps the reference. Returns ember_run's result.
+int ember_module_image_link(ember_vm* vm, ember_module* module, ember_module_image* image);
+
+#endif // EMBER_MODULE_IMAGE_H
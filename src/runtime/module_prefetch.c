@@ -0,0 +1,252 @@
+#define _GNU_SOURCE
+#include "module_prefetch.h"
+#include "../vm.h"
+#include "../core/bytecode_format.h"
+#include "../frontend/lexer/lexer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// Import-graph prefetching. Imports are compiled when the parser reaches
+// them, one module at a time. ember_prefetch_imports instead walks the graph
+// up front with a token scan for `import name`, then compiles every module it
+// found on a pool of threads, each with a private VM (the lexer and parser
+// keep per-thread state), and keeps the serialized units. ember_import_module
+// links a prefetched unit by importing its dependencies and running it, so
+// modules still execute in dependency order, in the importing VM.
+
+#define PREFETCH_MAX_THREADS 64
+
+static char* read_source(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+    char* source = NULL;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        long size = ftell(file);
+        if (size >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+            source = malloc((size_t)size + 1);
+            if (source) {
+                size_t read = fread(source, 1, (size_t)size, file);
+                source[read] = '\0';
+            }
+        }
+    }
+    fclose(file);
+    return source;
+}
+
+static int find_unit(struct ember_module_prefetch* prefetch, const char* name) {
+    for (int i = 0; i < prefetch->count; i++) {
+        if (strcmp(prefetch->units[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+// Index of the unit for name, added (and its file read) if new; -1 if it
+// can't be found or was already loaded
+static int add_unit(ember_vm* vm, struct ember_module_prefetch* prefetch, const char* name) {
+    int index = find_unit(prefetch, name);
+    if (index >= 0) return index;
+    ember_module* module = ember_module_find(vm, name);
+    if (module && module->is_loaded == 1) return -1;
+
+    double start = startup_clock();
+    char* path = ember_resolve_module_path_vm(vm, name);
+    startup_profile_module(name, STARTUP_MODULE_RESOLVE, start);
+    if (!path) return -1;
+    char* source = read_source(path);
+    if (!source) {
+        free(path);
+        return -1;
+    }
+    if (prefetch->count == prefetch->capacity) {
+        int capacity = prefetch->capacity ? prefetch->capacity * 2 : 8;
+        ember_module_unit* units = realloc(prefetch->units, sizeof(ember_module_unit) * (size_t)capacity);
+        if (!units) {
+            fprintf(stderr, "[MODULE] Memory allocation failed for import graph\n");
+            free(source);
+            free(path);
+            return -1;
+        }
+        prefetch->units = units;
+        prefetch->capacity = capacity;
+    }
+    ember_module_unit* unit = &prefetch->units[prefetch->count];
+    memset(unit, 0, sizeof(*unit));
+    unit->name = strdup(name);
+    unit->path = path;
+    unit->source = source;
+    if (!unit->name) {
+        free(source);
+        free(path);
+        return -1;
+    }
+    return prefetch->count++;
+}
+
+void ember_scan_imports(const char* source, void (*found)(void* context, const char* name), void* context) {
+    lexer lx;
+    lexer_init(&lx, source);
+    ember_token_type last = TOKEN_NEWLINE;
+    for (;;) {
+        ember_token token = lexer_scan_token(&lx);
+        if (token.type == TOKEN_EOF) return;
+        if (token.type == TOKEN_IMPORT &&
+            (last == TOKEN_NEWLINE || last == TOKEN_SEMICOLON || last == TOKEN_LBRACE || last == TOKEN_RBRACE)) {
+            ember_token name = lexer_scan_token(&lx);
+            if (name.type == TOKEN_IDENTIFIER && name.length < EMBER_MAX_PATH_LEN) {
+                char buffer[EMBER_MAX_PATH_LEN];
+                memcpy(buffer, name.start, (size_t)name.length);
+                buffer[name.length] = '\0';
+                found(context, buffer);
+            }
+            if (name.type == TOKEN_EOF) return;
+            last = name.type;
+            continue;
+        }
+        last = token.type;
+    }
+}
+
+typedef struct {
+    ember_vm* vm;
+    struct ember_module_prefetch* prefetch;
+    int unit;                // Importing unit, -1 for the entry script
+} scan_context;
+
+static void add_dependency(void* arg, const char* name) {
+    scan_context* context = arg;
+    int dep = add_unit(context->vm, context->prefetch, name);
+    if (dep < 0 || context->unit < 0) return;
+    ember_module_unit* unit = &context->prefetch->units[context->unit];
+    int* deps = realloc(unit->deps, sizeof(int) * (size_t)(unit->dep_count + 1));
+    if (!deps) return;
+    unit->deps = deps;
+    unit->deps[unit->dep_count++] = dep;
+}
+
+typedef struct {
+    struct ember_module_prefetch* prefetch;
+    int next;                // Next unit to compile (atomic)
+} compile_queue;
+
+static void* compile_worker(void* arg) {
+    compile_queue* queue = arg;
+    ember_vm* vm = ember_new_vm();
+    if (!vm) return NULL;
+    vm->defer_imports = 1;
+    for (;;) {
+        int index = __sync_fetch_and_add(&queue->next, 1);
+        if (index >= queue->prefetch->count) break;
+        ember_module_unit* unit = &queue->prefetch->units[index];
+        double start = startup_clock();
+        if (!ember_bytecode_compile(vm, unit->source, &unit->data, &unit->size)) {
+            // Left to ember_import_module, which reports the error as usual
+            unit->data = NULL;
+        }
+        startup_profile_module(unit->name, STARTUP_MODULE_COMPILE, start);
+        free(unit->source);
+        unit->source = NULL;
+    }
+    ember_free_vm(vm);
+    return NULL;
+}
+
+int ember_prefetch_imports(ember_vm* vm, const char* source, int threads) {
+    if (!vm || !source) return -1;
+    ember_prefetch_free(vm);
+    struct ember_module_prefetch* prefetch = calloc(1, sizeof(*prefetch));
+    if (!prefetch) {
+        fprintf(stderr, "[MODULE] Memory allocation failed for import graph\n");
+        return -1;
+    }
+
+    // Breadth-first over the graph; units appended while scanning are
+    // scanned in turn
+    scan_context context = {vm, prefetch, -1};
+    ember_scan_imports(source, add_dependency, &context);
+    for (int i = 0; i < prefetch->count; i++) {
+        context.unit = i;
+        ember_scan_imports(prefetch->units[i].source, add_dependency, &context);
+    }
+    vm->module_prefetch = prefetch;
+    if (prefetch->count == 0) return 0;
+
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+    if (threads > prefetch->count) threads = prefetch->count;
+    if (threads > PREFETCH_MAX_THREADS) threads = PREFETCH_MAX_THREADS;
+
+    compile_queue queue = {prefetch, 0};
+    pthread_t workers[PREFETCH_MAX_THREADS];
+    int started = 0;
+    for (; started < threads; started++) {
+        if (pthread_create(&workers[started], NULL, compile_worker, &queue) != 0) break;
+    }
+    if (started == 0) {
+        // No threads available: compile here instead
+        compile_worker(&queue);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    int compiled = 0;
+    for (int i = 0; i < prefetch->count; i++) {
+        if (prefetch->units[i].data) compiled++;
+    }
+    return compiled;
+}
+
+ember_module_unit* ember_prefetch_find(ember_vm* vm, const char* path) {
+    struct ember_module_prefetch* prefetch = vm ? vm->module_prefetch : NULL;
+    if (!prefetch || !path) return NULL;
+    for (int i = 0; i < prefetch->count; i++) {
+        ember_module_unit* unit = &prefetch->units[i];
+        if (!unit->linked && unit->data && strcmp(unit->path, path) == 0) return unit;
+    }
+    return NULL;
+}
+
+int ember_prefetch_link(ember_vm* vm, ember_module_unit* unit) {
+    unit->linked = 1;
+    // The unit's import statements were parsed without loading anything
+    for (int i = 0; i < unit->dep_count; i++) {
+        ember_import_module(vm, vm->module_prefetch->units[unit->deps[i]].name);
+    }
+
+    double start = startup_clock();
+    ember_chunk* chunk = ember_bytecode_load(vm, unit->data, unit->size);
+    startup_profile_module(unit->name, STARTUP_MODULE_COMPILE, start);
+    free(unit->data);
+    unit->data = NULL;
+    if (!chunk) return -1;
+    int saved_local_count = vm->local_count;
+    vm->local_count = 0;
+    start = startup_clock();
+    int result = ember_bytecode_run(vm, chunk);
+    startup_profile_module(unit->name, STARTUP_MODULE_EXECUTE, start);
+    vm->local_count = saved_local_count;
+    ember_bytecode_free_chunk(chunk);
+    return result;
+}
+
+void ember_prefetch_free(ember_vm* vm) {
+    struct ember_module_prefetch* prefetch = vm ? vm->module_prefetch : NULL;
+    if (!prefetch) return;
+    for (int i = 0; i < prefetch->count; i++) {
+        ember_module_unit* unit = &prefetch->units[i];
+        free(unit->name);
+        free(unit->path);
+        free(unit->source);
+        free(unit->data);
+        free(unit->deps);
+    }
+    free(prefetch->units);
+    free(prefetch);
+    vm->module_prefetch = NULL;
+}
@@ -0,0 +1,40 @@
+#ifndef EMBER_MODULE_PREFETCH_H
+#define EMBER_MODULE_PREFETCH_H
+
+#include "ember.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// A module found in the import graph and compiled ahead of ember_import_module
+typedef struct {
+    char* name;
+    char* path;              // As resolved by ember_resolve_module_path_vm
+    char* source;            // Freed once compiled
+    uint8_t* data;           // Serialized unit (ember_bytecode_compile); NULL if it failed
+    size_t size;
+    int* deps;               // Indices of the units it imports, in source order
+    int dep_count;
+    int linked;              // Handed to ember_import_module
+} ember_module_unit;
+
+struct ember_module_prefetch {
+    ember_module_unit* units;
+    int count;
+    int capacity;
+};
+
+// Path resolution shared with ember_import_module (src/api.c)
+char* ember_resolve_module_path_vm(ember_vm* vm, const char* module_name);
+
+// Calls found(context, name) for each `import name` statement in source
+void ember_scan_imports(const char* source, void (*found)(void* context, const char* name), void* context);
+
+// The compiled unit for path that has not been linked yet, or NULL
+ember_module_unit* ember_prefetch_find(ember_vm* vm, const char* path);
+// Imports the unit's dependencies, then runs the unit in vm. Returns
+// ember_run's result.
+int ember_prefetch_link(ember_vm* vm, ember_module_unit* unit);
+// Releases vm->module_prefetch (ember_free_vm)
+void ember_prefetch_free(ember_vm* vm);
+
+#endif // EMBER_MODULE_PREFETCH_H
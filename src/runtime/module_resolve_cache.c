@@ -0,0 +1,160 @@
+#define _GNU_SOURCE
+#include "module_resolve_cache.h"
+#include "ember.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define RESOLVE_CACHE_INITIAL_CAPACITY 64
+
+typedef struct {
+    char* key;       // specifier '\0' base '\0'
+    size_t key_size;
+    uint32_t hash;
+    char* path;      // NULL: the specifier did not resolve
+} resolve_entry;
+
+static pthread_mutex_t resolve_lock = PTHREAD_MUTEX_INITIALIZER;
+static resolve_entry* resolve_entries = NULL;   // Open addressing, key NULL = empty
+static int resolve_count = 0;
+static int resolve_capacity = 0;                // Power of two
+
+static pthread_once_t home_once = PTHREAD_ONCE_INIT;
+static const char* home_dir = NULL;
+
+static void read_home(void) {
+    const char* home = getenv("HOME");
+    home_dir = home ? strdup(home) : NULL;
+}
+
+const char* ember_resolve_home(void) {
+    pthread_once(&home_once, read_home);
+    return home_dir;
+}
+
+// FNV-1a over both parts, terminators included
+static uint32_t key_hash(const char* key, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (uint8_t)key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static char* make_key(const char* specifier, const char* base, size_t* size) {
+    size_t specifier_size = strlen(specifier) + 1;
+    size_t base_size = strlen(base) + 1;
+    char* key = malloc(specifier_size + base_size);
+    if (!key) return NULL;
+    memcpy(key, specifier, specifier_size);
+    memcpy(key + specifier_size, base, base_size);
+    *size = specifier_size + base_size;
+    return key;
+}
+
+static resolve_entry* probe(const char* key, size_t size, uint32_t hash) {
+    int mask = resolve_capacity - 1;
+    int index = (int)(hash & (uint32_t)mask);
+    for (;;) {
+        resolve_entry* entry = &resolve_entries[index];
+        if (!entry->key) return entry;
+        if (entry->hash == hash && entry->key_size == size && memcmp(entry->key, key, size) == 0) {
+            return entry;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+// Keeps the table at most half full
+static int reserve(void) {
+    if ((resolve_count + 1) * 2 <= resolve_capacity) return 1;
+    int new_capacity = resolve_capacity < RESOLVE_CACHE_INITIAL_CAPACITY ?
+                       RESOLVE_CACHE_INITIAL_CAPACITY : resolve_capacity * 2;
+    resolve_entry* entries = calloc((size_t)new_capacity, sizeof(resolve_entry));
+    if (!entries) return 0;
+    for (int i = 0; i < resolve_capacity; i++) {
+        if (!resolve_entries[i].key) continue;
+        int index = (int)(resolve_entries[i].hash & (uint32_t)(new_capacity - 1));
+        while (entries[index].key) {
+            index = (index + 1) & (new_capacity - 1);
+        }
+        entries[index] = resolve_entries[i];
+    }
+    free(resolve_entries);
+    resolve_entries = entries;
+    resolve_capacity = new_capacity;
+    return 1;
+}
+
+int ember_resolve_cache_lookup(const char* specifier, const char* base, char** path) {
+    if (!specifier || !path) return 0;
+    size_t size;
+    char* key = make_key(specifier, base ? base : "", &size);
+    if (!key) return 0;
+    uint32_t hash = key_hash(key, size);
+
+    int found = 0;
+    pthread_mutex_lock(&resolve_lock);
+    if (resolve_capacity > 0) {
+        resolve_entry* entry = probe(key, size, hash);
+        if (entry->key) {
+            *path = entry->path ? strdup(entry->path) : NULL;
+            // Out of memory copying a hit: resolve it again instead
+            found = !entry->path || *path;
+        }
+    }
+    pthread_mutex_unlock(&resolve_lock);
+    free(key);
+    return found;
+}
+
+void ember_resolve_cache_store(const char* specifier, const char* base, const char* path) {
+    if (!specifier) return;
+    size_t size;
+    char* key = make_key(specifier, base ? base : "", &size);
+    char* copy = path ? strdup(path) : NULL;
+    if (!key || (path && !copy)) {
+        free(key);
+        free(copy);
+        return;
+    }
+    uint32_t hash = key_hash(key, size);
+
+    pthread_mutex_lock(&resolve_lock);
+    if (reserve()) {
+        resolve_entry* entry = probe(key, size, hash);
+        if (entry->key) {
+            // Another VM resolved it meanwhile; keep the newer result
+            free(entry->path);
+            entry->path = copy;
+            free(key);
+        } else {
+            entry->key = key;
+            entry->key_size = size;
+            entry->hash = hash;
+            entry->path = copy;
+            resolve_count++;
+        }
+        key = NULL;
+        copy = NULL;
+    }
+    pthread_mutex_unlock(&resolve_lock);
+    free(key);
+    free(copy);
+}
+
+void ember_clear_module_resolution_cache(void) {
+    pthread_mutex_lock(&resolve_lock);
+    for (int i = 0; i < resolve_capacity; i++) {
+        free(resolve_entries[i].key);
+        free(resolve_entries[i].path);
+    }
+    free(resolve_entries);
+    resolve_entries = NULL;
+    resolve_count = 0;
+    resolve_capacity = 0;
+    pthread_mutex_unlock(&resolve_lock);
+}
@@ -0,0 +1,16 @@
+#ifndef EMBER_MODULE_RESOLVE_CACHE_H
+#define EMBER_MODULE_RESOLVE_CACHE_H
+
+// Per-process cache of module path resolution, shared by every VM. Entries
+// are keyed by the specifier and the directory it was resolved from, and
+// hold either the resolved path or a miss, so neither costs a probe twice.
+
+// 1 if (specifier, base) is cached: *path is a malloc'd copy of the result,
+// or NULL for a cached miss. 0 if it has to be resolved.
+int ember_resolve_cache_lookup(const char* specifier, const char* base, char** path);
+// Records the result of resolving specifier from base; path NULL is a miss
+void ember_resolve_cache_store(const char* specifier, const char* base, const char* path);
+// $HOME, read once per process; NULL if unset
+const char* ember_resolve_home(void);
+
+#endif // EMBER_MODULE_RESOLVE_CACHE_H
@@ -9,7 +9,13 @@
 #include "../vm.h"
 #include "value/value.h"
 #include "module_system.h"
+#include "module_resolve_cache.h"
+#include "json_stream.h"
+#include "stdlib_working.h"
+#include "template_stubs.h"
 #include "../frontend/parser/parser.h"
+#include "../core/probes.h"
+#include "../../include/ember_interfaces.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -17,45 +23,333 @@
 #include <unistd.h>
 #include <limits.h>
 
-// Global module registry
-static ember_module_context* g_module_registry = NULL;
+// Global module registry: contexts hashed by path (open addressing, at most
+// half full), so the cache check on every import is one probe
+static ember_module_context** g_module_registry = NULL;
+static int g_module_registry_count = 0;
+static int g_module_registry_capacity = 0;   // Power of two
 static ember_module_context* g_module_stack = NULL;  // Current module being loaded
 
-// Core module definitions
+#define MODULE_REGISTRY_INITIAL_CAPACITY 16
+
+// Core module definitions. Each is a static export table; nothing is
+// allocated until a VM asks for it. A named import materializes just that
+// export into the VM's registry entry for the module ("core:<name>"), and
+// only a namespace import builds the whole map, once per VM.
+typedef enum {
+    CORE_EXPORT_NUMBER,
+    CORE_EXPORT_STRING,
+    CORE_EXPORT_BOOL,
+    CORE_EXPORT_NATIVE
+} core_export_kind;
+
+typedef struct {
+    const char* name;
+    core_export_kind kind;
+    double number;           // Number or bool
+    const char* string;
+    ember_native_func native;
+} core_export;
+
+#define CORE_NUMBER(name, value) {name, CORE_EXPORT_NUMBER, value, NULL, NULL}
+#define CORE_STRING(name, value) {name, CORE_EXPORT_STRING, 0, value, NULL}
+#define CORE_BOOL(name, value)   {name, CORE_EXPORT_BOOL, value, NULL, NULL}
+#define CORE_NATIVE(name, func)  {name, CORE_EXPORT_NATIVE, 0, NULL, func}
+#define CORE_END                 {NULL, CORE_EXPORT_NUMBER, 0, NULL, NULL}
+
 typedef struct {
     const char* name;
-    ember_value (*initializer)(ember_vm* vm);
+    const core_export* exports;  // CORE_END terminated
 } core_module_def;
 
-// Forward declarations for core modules
-static ember_value init_math_module(ember_vm* vm);
-static ember_value init_string_module(ember_vm* vm);
-static ember_value init_crypto_module(ember_vm* vm);
-static ember_value init_json_module(ember_vm* vm);
-static ember_value init_io_module(ember_vm* vm);
-static ember_value init_http_module(ember_vm* vm);
-static ember_value init_path_module(ember_vm* vm);
-static ember_value init_fs_module(ember_vm* vm);
-static ember_value init_os_module(ember_vm* vm);
-static ember_value init_util_module(ember_vm* vm);
+#define CORE_NAMESPACE_EXPORT "*"    // Registry export slot holding the namespace map
+
+#if defined(__linux__)
+#define CORE_OS_PLATFORM "linux"
+#elif defined(__APPLE__)
+#define CORE_OS_PLATFORM "darwin"
+#elif defined(_WIN32)
+#define CORE_OS_PLATFORM "win32"
+#else
+#define CORE_OS_PLATFORM "unknown"
+#endif
+
+static const core_export math_exports[] = {
+    // Math constants
+    CORE_NUMBER("PI", 3.14159265358979323846),
+    CORE_NUMBER("E", 2.71828182845904523536),
+    CORE_NUMBER("LN2", 0.69314718055994530942),
+    CORE_NUMBER("LN10", 2.30258509299404568402),
+    CORE_NUMBER("SQRT2", 1.41421356237309504880),
+    // Math functions would be added here
+    CORE_BOOL("loaded", true),
+    CORE_STRING("version", "1.0.0"),
+    CORE_END
+};
+
+#define CORE_BASIC_EXPORTS(type_name) \
+    CORE_BOOL("loaded", true), \
+    CORE_STRING("type", type_name), \
+    CORE_STRING("version", "1.0.0")
+
+static const core_export string_exports[] = {
+    CORE_BASIC_EXPORTS("string"),
+    CORE_NATIVE("replace_all", ember_replace_all),
+    CORE_NATIVE("builder", ember_native_string_builder),
+    CORE_NATIVE("append", ember_native_builder_append),
+    CORE_NATIVE("appendf", ember_native_builder_appendf),
+    CORE_NATIVE("length", ember_native_builder_length),
+    CORE_NATIVE("clear", ember_native_builder_clear),
+    CORE_NATIVE("to_string", ember_native_builder_to_string),
+    CORE_END
+};
+static const core_export template_exports[] = {
+    CORE_BASIC_EXPORTS("template"),
+    CORE_NATIVE("render", ember_template_render),
+    CORE_NATIVE("render_file", ember_template_render_file),
+    CORE_NATIVE("html", ember_html_render),
+    CORE_NATIVE("html_file", ember_html_render_file),
+    CORE_NATIVE("escape", ember_html_escape),
+    CORE_NATIVE("url_encode", ember_url_encode),
+    CORE_END
+};
+static const core_export datetime_exports[] = {
+    CORE_BASIC_EXPORTS("datetime"),
+    CORE_NATIVE("now", ember_native_datetime_now),
+    CORE_NATIVE("timestamp", ember_native_datetime_timestamp),
+    CORE_NATIVE("parse", ember_native_datetime_parse),
+    CORE_NATIVE("format", ember_native_datetime_format),
+    CORE_NATIVE("add", ember_native_datetime_add),
+    CORE_NATIVE("diff", ember_native_datetime_diff),
+    CORE_NATIVE("to_utc", ember_native_datetime_to_utc),
+    CORE_NATIVE("from_utc", ember_native_datetime_from_utc),
+    CORE_NATIVE("year", ember_native_datetime_year),
+    CORE_NATIVE("month", ember_native_datetime_month),
+    CORE_NATIVE("day", ember_native_datetime_day),
+    CORE_NATIVE("hour", ember_native_datetime_hour),
+    CORE_NATIVE("minute", ember_native_datetime_minute),
+    CORE_NATIVE("second", ember_native_datetime_second),
+    CORE_NATIVE("weekday", ember_native_datetime_weekday),
+    CORE_NATIVE("yearday", ember_native_datetime_yearday),
+    CORE_END
+};
+static const core_export crypto_exports[] = {
+    CORE_BASIC_EXPORTS("crypto"),
+    CORE_NATIVE("sha256", ember_native_sha256_working),
+    CORE_NATIVE("sha512", ember_native_sha512_working),
+    CORE_NATIVE("hmac_sha256", ember_native_hmac_sha256_working),
+    CORE_NATIVE("hmac_sha512", ember_native_hmac_sha512_working),
+    CORE_NATIVE("random", ember_native_secure_random_working),
+    CORE_NATIVE("uuid_v4", ember_native_uuid_v4),
+    CORE_NATIVE("uuid_v7", ember_native_uuid_v7),
+    CORE_NATIVE("hasher", ember_native_hasher),
+    CORE_NATIVE("update", ember_native_hasher_update),
+    CORE_NATIVE("digest", ember_native_hasher_digest),
+    CORE_END
+};
+static const core_export json_exports[] = {
+    CORE_BASIC_EXPORTS("json"),
+    CORE_NATIVE("read", ember_json_read_working),
+    CORE_NATIVE("write", ember_json_write_working),
+    CORE_END
+};
+static const core_export io_exports[] = {
+    CORE_BASIC_EXPORTS("io"),
+    CORE_NATIVE("open", ember_native_file_open),
+    CORE_NATIVE("read_line", ember_native_file_read_line),
+    CORE_NATIVE("read_chunk", ember_native_file_read_chunk),
+    CORE_NATIVE("lines", ember_native_file_lines),
+    CORE_NATIVE("writer", ember_native_file_writer),
+    CORE_NATIVE("write", ember_native_file_write),
+    CORE_NATIVE("flush", ember_native_file_flush),
+    CORE_NATIVE("walk", ember_native_fs_walk),
+    CORE_NATIVE("close", ember_native_file_close),
+    CORE_END
+};
+static const core_export http_exports[] = {
+    CORE_BASIC_EXPORTS("http"),
+#ifdef HAVE_CURL
+    CORE_NATIVE("fetch", ember_native_http_fetch),
+    CORE_NATIVE("stream", ember_native_http_stream),
+    CORE_NATIVE("stream_json", ember_native_http_stream_json),
+    CORE_NATIVE("download", ember_native_http_download_async),
+#endif
+    CORE_NATIVE("listen_and_serve", ember_native_http_listen_and_serve),
+    CORE_NATIVE("stop_server", ember_native_http_stop_server),
+    CORE_NATIVE("request_method", ember_native_request_get_method),
+    CORE_NATIVE("request_path", ember_native_request_get_path),
+    CORE_NATIVE("request_query", ember_native_request_get_query),
+    CORE_NATIVE("request_header", ember_native_request_get_header),
+    CORE_NATIVE("request_body", ember_native_request_get_body),
+    CORE_NATIVE("set_status", ember_native_response_set_status),
+    CORE_NATIVE("set_header", ember_native_response_set_header),
+    CORE_NATIVE("write", ember_native_response_write),
+    CORE_NATIVE("end", ember_native_response_end),
+    CORE_NATIVE("send_file", ember_native_response_send_file),
+    CORE_END
+};
+static const core_export db_exports[] = {
+    CORE_BASIC_EXPORTS("db"),
+#ifdef HAVE_SQLITE
+    CORE_NATIVE("connect", ember_native_db_connect),
+    CORE_NATIVE("disconnect", ember_native_db_disconnect),
+    CORE_NATIVE("query", ember_native_db_query),
+    CORE_NATIVE("batch", ember_native_db_batch),
+    CORE_NATIVE("begin", ember_native_db_begin),
+    CORE_NATIVE("commit", ember_native_db_commit),
+    CORE_NATIVE("rollback", ember_native_db_rollback),
+    CORE_NATIVE("error", ember_native_db_error),
+    CORE_NATIVE("pool_stats", ember_native_db_pool_stats),
+#endif
+    CORE_END
+};
+static const core_export path_exports[] = {
+    CORE_BASIC_EXPORTS("path"),
+    // Path utilities
+    CORE_STRING("sep", "/"),
+    CORE_STRING("delimiter", ":"),
+    CORE_END
+};
+static const core_export fs_exports[] = {CORE_BASIC_EXPORTS("fs"), CORE_END};
+static const core_export os_exports[] = {
+    CORE_BASIC_EXPORTS("os"),
+    // OS information
+    CORE_STRING("platform", CORE_OS_PLATFORM),
+    CORE_END
+};
+static const core_export vmath_exports[] = {
+    CORE_BASIC_EXPORTS("vmath"),
+    CORE_NATIVE("sum", ember_native_vmath_sum),
+    CORE_NATIVE("dot", ember_native_vmath_dot),
+    CORE_NATIVE("min", ember_native_vmath_min),
+    CORE_NATIVE("max", ember_native_vmath_max),
+    CORE_NATIVE("scale", ember_native_vmath_scale),
+    CORE_NATIVE("add", ember_native_vmath_add),
+    CORE_NATIVE("mul", ember_native_vmath_mul),
+    CORE_NATIVE("clamp", ember_native_vmath_clamp),
+    CORE_NATIVE("prefix_sum", ember_native_vmath_prefix_sum),
+    CORE_NATIVE("sqrt", ember_native_vmath_sqrt),
+    CORE_NATIVE("exp", ember_native_vmath_exp),
+    CORE_NATIVE("log", ember_native_vmath_log),
+    CORE_END
+};
+static const core_export iter_exports[] = {
+    CORE_BASIC_EXPORTS("iter"),
+    CORE_NATIVE("from", ember_native_iter),
+    CORE_NATIVE("map", ember_native_iter_map),
+    CORE_NATIVE("filter", ember_native_iter_filter),
+    CORE_NATIVE("take", ember_native_iter_take),
+    CORE_NATIVE("skip", ember_native_iter_skip),
+    CORE_NATIVE("zip", ember_native_iter_zip),
+    CORE_NATIVE("chunk", ember_native_iter_chunk),
+    CORE_NATIVE("collect", ember_native_iter_collect),
+    CORE_NATIVE("reduce", ember_native_iter_reduce),
+    CORE_NATIVE("count", ember_native_iter_count),
+    CORE_END
+};
+
+static const core_export util_exports[] = {
+    CORE_BASIC_EXPORTS("util"),
+    // Higher-order array functions
+    CORE_NATIVE("each", ember_native_array_foreach),
+    CORE_NATIVE("map", ember_native_array_map),
+    CORE_NATIVE("filter", ember_native_array_filter),
+    CORE_NATIVE("reduce", ember_native_array_reduce),
+    CORE_NATIVE("find", ember_native_array_find),
+    CORE_NATIVE("some", ember_native_array_some),
+    CORE_NATIVE("every", ember_native_array_every),
+    CORE_NATIVE("reserve", ember_native_array_reserve),
+    CORE_NATIVE("extend", ember_native_array_extend),
+    CORE_NATIVE("insert", ember_native_array_insert),
+    CORE_NATIVE("splice", ember_native_array_splice),
+    CORE_NATIVE("sort", ember_native_array_sort),
+    CORE_NATIVE("sort_by", ember_native_array_sort_by),
+    CORE_NATIVE("set_from_array", ember_native_set_from_array),
+    CORE_NATIVE("set_union", ember_native_set_union),
+    CORE_NATIVE("set_intersection", ember_native_set_intersection),
+    CORE_NATIVE("set_difference", ember_native_set_difference),
+    CORE_NATIVE("set_union_with", ember_native_set_union_with),
+    CORE_NATIVE("set_retain_all", ember_native_set_retain_all),
+    CORE_NATIVE("parallel_map", ember_native_parallel_map),
+    CORE_NATIVE("parallel_filter", ember_native_parallel_filter),
+    CORE_NATIVE("parallel_reduce", ember_native_parallel_reduce),
+    // Typed arrays
+    CORE_NATIVE("float64_array", ember_native_float64_array),
+    CORE_NATIVE("int32_array", ember_native_int32_array),
+    CORE_NATIVE("uint8_array", ember_native_uint8_array),
+    CORE_NATIVE("fill", ember_native_typed_fill),
+    CORE_NATIVE("copy", ember_native_typed_copy),
+    CORE_NATIVE("slice", ember_native_typed_slice),
+    CORE_NATIVE("to_array", ember_native_typed_to_array),
+    // LRU caches
+    CORE_NATIVE("cache_new", ember_native_cache_new),
+    CORE_NATIVE("cache_get", ember_native_cache_get),
+    CORE_NATIVE("cache_has", ember_native_cache_has),
+    CORE_NATIVE("cache_put", ember_native_cache_put),
+    CORE_NATIVE("cache_delete", ember_native_cache_delete),
+    CORE_NATIVE("cache_size", ember_native_cache_size),
+    CORE_NATIVE("cache_clear", ember_native_cache_clear),
+    CORE_NATIVE("cache_prune", ember_native_cache_prune),
+    CORE_NATIVE("cache_stats", ember_native_cache_stats),
+    // Deques and priority queues
+    CORE_NATIVE("deque", ember_native_deque),
+    CORE_NATIVE("deque_push_back", ember_native_deque_push_back),
+    CORE_NATIVE("deque_push_front", ember_native_deque_push_front),
+    CORE_NATIVE("deque_pop_back", ember_native_deque_pop_back),
+    CORE_NATIVE("deque_pop_front", ember_native_deque_pop_front),
+    CORE_NATIVE("deque_peek_back", ember_native_deque_peek_back),
+    CORE_NATIVE("deque_peek_front", ember_native_deque_peek_front),
+    CORE_NATIVE("deque_get", ember_native_deque_get),
+    CORE_NATIVE("deque_clear", ember_native_deque_clear),
+    CORE_NATIVE("deque_to_array", ember_native_deque_to_array),
+    CORE_NATIVE("priority_queue", ember_native_priority_queue),
+    CORE_NATIVE("pqueue_push", ember_native_pqueue_push),
+    CORE_NATIVE("pqueue_pop", ember_native_pqueue_pop),
+    CORE_NATIVE("pqueue_peek", ember_native_pqueue_peek),
+    CORE_NATIVE("pqueue_clear", ember_native_pqueue_clear),
+    // Weak references and weak maps
+    CORE_NATIVE("weak_ref", ember_native_weak_ref),
+    CORE_NATIVE("weak_ref_get", ember_native_weak_ref_get),
+    CORE_NATIVE("weak_map", ember_native_weak_map),
+    CORE_NATIVE("weak_map_get", ember_native_weak_map_get),
+    CORE_NATIVE("weak_map_set", ember_native_weak_map_set),
+    CORE_NATIVE("weak_map_has", ember_native_weak_map_has),
+    CORE_NATIVE("weak_map_delete", ember_native_weak_map_delete),
+    CORE_NATIVE("weak_map_size", ember_native_weak_map_size),
+    CORE_END
+};
 
 // Core module registry
-static core_module_def core_modules[] = {
-    {"math", init_math_module},
-    {"string", init_string_module},
-    {"crypto", init_crypto_module},
-    {"json", init_json_module},
-    {"io", init_io_module},
-    {"http", init_http_module},
-    {"path", init_path_module},
-    {"fs", init_fs_module},
-    {"os", init_os_module},
-    {"util", init_util_module},
+static const core_module_def core_modules[] = {
+    {"math", math_exports},
+    {"string", string_exports},
+    {"crypto", crypto_exports},
+    {"json", json_exports},
+    {"io", io_exports},
+    {"http", http_exports},
+    {"db", db_exports},
+    {"path", path_exports},
+    {"fs", fs_exports},
+    {"os", os_exports},
+    {"util", util_exports},
+    {"vmath", vmath_exports},
+    {"iter", iter_exports},
+    {"template", template_exports},
+    {"datetime", datetime_exports},
     {NULL, NULL}
 };
 
+static const core_module_def* find_core_module(const char* module_name) {
+    for (int i = 0; core_modules[i].name; i++) {
+        if (strcmp(core_modules[i].name, module_name) == 0) {
+            return &core_modules[i];
+        }
+    }
+    return NULL;
+}
+
 // Path resolution for modules
-char* ember_resolve_module_path(const char* module_name, const char* current_file) {
+static char* resolve_module_path_uncached(const char* module_name, const char* current_file) {
     char* resolved_path = malloc(EMBER_MAX_PATH_LEN);
     if (!resolved_path) return NULL;
     
@@ -112,7 +406,7 @@ char* ember_resolve_module_path(const char* module_name, const char* current_fil
         snprintf(candidates[candidate_count++], EMBER_MAX_PATH_LEN, "./lib/%s.ember", module_name);
         
         // User library directory
-        const char* home = getenv("HOME");
+        const char* home = ember_resolve_home();
         if (home) {
             snprintf(candidates[candidate_count++], EMBER_MAX_PATH_LEN, 
                     "%s/.local/lib/ember/%s.ember", home, module_name);
@@ -156,14 +450,30 @@ char* ember_resolve_module_path(const char* module_name, const char* current_fil
     return resolved_path;
 }
 
+// Cached by specifier and the importing file's directory, so each VM after
+// the first resolves without touching the filesystem
+char* ember_resolve_module_path(const char* module_name, const char* current_file) {
+    if (!module_name) return NULL;
+    char base[EMBER_MAX_PATH_LEN] = "";
+    const char* slash = current_file ? strrchr(current_file, '/') : NULL;
+    if (slash && (size_t)(slash - current_file) + 1 < sizeof(base)) {
+        size_t length = (size_t)(slash - current_file) + 1;
+        memcpy(base, current_file, length);
+        base[length] = '\0';
+    }
+    
+    char* resolved_path;
+    if (ember_resolve_cache_lookup(module_name, base, &resolved_path)) {
+        return resolved_path;
+    }
+    resolved_path = resolve_module_path_uncached(module_name, current_file);
+    ember_resolve_cache_store(module_name, base, resolved_path);
+    return resolved_path;
+}
+
 // Check if module name refers to a core module
 bool ember_is_core_module(const char* module_name) {
-    for (int i = 0; core_modules[i].name; i++) {
-        if (strcmp(core_modules[i].name, module_name) == 0) {
-            return true;
-        }
-    }
-    return false;
+    return find_core_module(module_name) != NULL;
 }
 
 // Check if module file exists
@@ -176,30 +486,76 @@ bool ember_module_exists(const char* module_path) {
     return stat(module_path, &st) == 0;
 }
 
-// Get or create module context
-ember_module_context* ember_get_module_context(ember_vm* vm __attribute__((unused)), const char* module_path) {
-    ember_module_context* context = g_module_registry;
-    while (context) {
-        if (strcmp(context->module_path, module_path) == 0) {
-            return context;
+// Registry slot for path: the context stored there, or the empty slot it would take
+static int registry_probe(const char* module_path, uint32_t hash) {
+    int mask = g_module_registry_capacity - 1;
+    int index = (int)(hash & (uint32_t)mask);
+    while (g_module_registry[index]) {
+        ember_module_context* context = g_module_registry[index];
+        if (context->hash == hash && strcmp(context->module_path, module_path) == 0) {
+            break;
         }
-        context = context->next;
+        index = (index + 1) & mask;
     }
-    return NULL;
+    return index;
+}
+
+static bool registry_reserve(void) {
+    if ((g_module_registry_count + 1) * 2 <= g_module_registry_capacity) return true;
+    int new_capacity = g_module_registry_capacity < MODULE_REGISTRY_INITIAL_CAPACITY ?
+                       MODULE_REGISTRY_INITIAL_CAPACITY : g_module_registry_capacity * 2;
+    ember_module_context** table = calloc((size_t)new_capacity, sizeof(ember_module_context*));
+    if (!table) {
+        fprintf(stderr, "[MODULE] Failed to grow module registry\n");
+        return false;
+    }
+    for (int i = 0; i < g_module_registry_capacity; i++) {
+        ember_module_context* context = g_module_registry[i];
+        if (!context) continue;
+        int index = (int)(context->hash & (uint32_t)(new_capacity - 1));
+        while (table[index]) {
+            index = (index + 1) & (new_capacity - 1);
+        }
+        table[index] = context;
+    }
+    free(g_module_registry);
+    g_module_registry = table;
+    g_module_registry_capacity = new_capacity;
+    return true;
+}
+
+// Get or create module context
+ember_module_context* ember_get_module_context(ember_vm* vm __attribute__((unused)), const char* module_path) {
+    if (!module_path || g_module_registry_capacity == 0) return NULL;
+    uint32_t hash = hash_string_chars(module_path, (int)strlen(module_path));
+    return g_module_registry[registry_probe(module_path, hash)];
 }
 
 ember_module_context* ember_create_module_context(ember_vm* vm, const char* module_path) {
-    ember_module_context* context = malloc(sizeof(ember_module_context));
-    if (!context) return NULL;
+    if (!module_path || !registry_reserve()) return NULL;
+    uint32_t hash = hash_string_chars(module_path, (int)strlen(module_path));
+    int index = registry_probe(module_path, hash);
+    ember_module_context* context = g_module_registry[index];
+    if (!context) {
+        context = malloc(sizeof(ember_module_context));
+        if (!context) return NULL;
+        context->module_path = strdup(module_path);
+        if (!context->module_path) {
+            free(context);
+            return NULL;
+        }
+        context->hash = hash;
+        context->next = NULL;
+        g_module_registry[index] = context;
+        g_module_registry_count++;
+    }
     
-    context->module_path = strdup(module_path);
+    // A reload starts from a fresh export table
     context->exports = ember_make_hash_map(vm, 16);
     context->default_export = ember_make_nil();
     context->has_default_export = false;
     context->is_loaded = false;
     context->is_loading = false;
-    context->next = g_module_registry;
-    g_module_registry = context;
     
     return context;
 }
@@ -303,6 +659,10 @@ void ember_module_export_all(ember_vm* vm, const char* from_module) {
 
 // Import functions
 ember_value ember_module_import_named(ember_vm* vm, const char* module_name, const char* export_name) {
+    if (ember_is_core_module(module_name)) {
+        // Binds just this export
+        return ember_core_module_export(vm, module_name, export_name);
+    }
     ember_value module = ember_load_module(vm, module_name, NULL);
     if (module.type != EMBER_VAL_HASH_MAP) {
         return ember_make_nil();
@@ -310,10 +670,7 @@ ember_value ember_module_import_named(ember_vm* vm, const char* module_name, con
     
     ember_hash_map* exports_map = AS_HASH_MAP(module);
     ember_value name_val = ember_make_string_gc(vm, export_name);
-    // TODO: Implement hash_map_get_with_vm or equivalent
-    // For now, return nil as placeholder
-    (void)exports_map; (void)name_val; // Suppress unused warnings
-    return ember_make_nil();
+    return hash_map_get(exports_map, name_val);
 }
 
 ember_value ember_module_import_default(ember_vm* vm, const char* module_name) {
@@ -324,9 +681,7 @@ ember_value ember_module_import_default(ember_vm* vm, const char* module_name) {
     
     ember_hash_map* exports_map = AS_HASH_MAP(module);
     ember_value default_key = ember_make_string_gc(vm, "default");
-    // TODO: Implement hash_map_get_with_vm or equivalent
-    ember_value default_export = ember_make_nil();
-    (void)exports_map; (void)default_key; // Suppress unused warnings
+    ember_value default_export = hash_map_get(exports_map, default_key);
     
     // If no default export, return the module itself
     if (default_export.type == EMBER_VAL_NIL) {
@@ -406,18 +761,83 @@ static ember_value load_file_module(ember_vm* vm, const char* file_path) {
     return context->exports;
 }
 
-// Load core module
-ember_value ember_init_core_module(ember_vm* vm, const char* module_name) {
-    for (int i = 0; core_modules[i].name; i++) {
-        if (strcmp(core_modules[i].name, module_name) == 0) {
-            return core_modules[i].initializer(vm);
+// The VM's registry entry for a core module; its export slots are the
+// exports materialized so far
+static ember_module* core_module_entry(ember_vm* vm, const core_module_def* def) {
+    char key[64];
+    snprintf(key, sizeof(key), "core:%s", def->name);
+    ember_module* module = ember_module_add(vm, key);
+    if (module) module->is_loaded = 1;
+    return module;
+}
+
+static ember_value core_export_value(ember_vm* vm, const core_export* export) {
+    switch (export->kind) {
+        case CORE_EXPORT_STRING: return ember_make_string_gc(vm, export->string);
+        case CORE_EXPORT_BOOL:   return ember_make_bool(export->number != 0);
+        case CORE_EXPORT_NATIVE: {
+            ember_value value;
+            value.type = EMBER_VAL_NATIVE;
+            value.as.native_val = export->native;
+            return value;
+        }
+        case CORE_EXPORT_NUMBER:
+        default:                 return ember_make_number(export->number);
+    }
+}
+
+// Materializes one export on first use; nil if the module has no such export
+static ember_value core_module_export(ember_vm* vm, ember_module* module, const core_export* export) {
+    int slot = ember_module_export_find(module, export->name, (int)strlen(export->name));
+    if (slot >= 0) return module->exports[slot].value;
+    // Registry exports are GC roots, so the new value is safe once defined
+    ember_value value = core_export_value(vm, export);
+    ember_module_export_define(module, export->name, value);
+    return value;
+}
+
+ember_value ember_core_module_export(ember_vm* vm, const char* module_name, const char* export_name) {
+    const core_module_def* def = find_core_module(module_name);
+    ember_module* module = def ? core_module_entry(vm, def) : NULL;
+    if (!module || !export_name) return ember_make_nil();
+    for (const core_export* export = def->exports; export->name; export++) {
+        if (strcmp(export->name, export_name) == 0) {
+            return core_module_export(vm, module, export);
         }
     }
     return ember_make_nil();
 }
 
-// Main module loading function
-ember_value ember_load_module(ember_vm* vm, const char* module_name, const char* current_file) {
+// Load core module: the namespace map, built on the VM's first namespace import
+ember_value ember_init_core_module(ember_vm* vm, const char* module_name) {
+    const core_module_def* def = find_core_module(module_name);
+    ember_module* module = def ? core_module_entry(vm, def) : NULL;
+    if (!module) return ember_make_nil();
+    int slot = ember_module_export_find(module, CORE_NAMESPACE_EXPORT, 1);
+    if (slot >= 0) return module->exports[slot].value;
+    
+    int count = 0;
+    while (def->exports[count].name) count++;
+    ember_value exports = ember_make_hash_map(vm, count * 2 > 16 ? count * 2 : 16);
+    // Rooted before the entries allocate
+    if (ember_module_export_define(module, CORE_NAMESPACE_EXPORT, exports) < 0) return ember_make_nil();
+    ember_hash_map* map = AS_HASH_MAP(exports);
+    for (const core_export* export = def->exports; export->name; export++) {
+        ember_value value = core_module_export(vm, module, export);
+        hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, export->name), value);
+    }
+    return exports;
+}
+
+static ember_value load_module(ember_vm* vm, const char* module_name, const char* current_file) {
+    // Importing a lazily initialized stdlib module is its first use
+    if (module_name && vm->stdlib_pending) ember_stdlib_require(vm, module_name);
+    
+    // Core modules never touch the filesystem
+    if (module_name && ember_is_core_module(module_name)) {
+        return ember_init_core_module(vm, module_name);
+    }
+    
     // Resolve module path
     char* module_path = ember_resolve_module_path(module_name, current_file);
     if (!module_path) {
@@ -452,6 +872,14 @@ ember_value ember_load_module(ember_vm* vm, const char* module_name, const char*
     return result;
 }
 
+// Main module loading function
+ember_value ember_load_module(ember_vm* vm, const char* module_name, const char* current_file) {
+    EMBER_PROBE1(module__load__start, module_name);
+    ember_value module = load_module(vm, module_name, current_file);
+    EMBER_PROBE2(module__load__done, module_name, module.type != EMBER_VAL_NIL);
+    return module;
+}
+
 // Native functions
 ember_value ember_native_import(ember_vm* vm, int argc, ember_value* argv) {
     if (argc != 1 || argv[0].type != EMBER_VAL_STRING) {
@@ -477,139 +905,6 @@ ember_value ember_native_export(ember_vm* vm, int argc, ember_value* argv) {
     return argv[1];
 }
 
-// Core module implementations
-static ember_value init_math_module(ember_vm* vm) {
-    ember_value exports = ember_make_hash_map(vm, 32);
-    ember_hash_map* map = AS_HASH_MAP(exports);
-    
-    // Math constants
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "PI"), ember_make_number(3.14159265358979323846));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "E"), ember_make_number(2.71828182845904523536));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "LN2"), ember_make_number(0.69314718055994530942));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "LN10"), ember_make_number(2.30258509299404568402));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "SQRT2"), ember_make_number(1.41421356237309504880));
-    
-    // Math functions would be added here
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "loaded"), ember_make_bool(true));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "version"), ember_make_string_gc(vm, "1.0.0"));
-    
-    return exports;
-}
-
-static ember_value init_string_module(ember_vm* vm) {
-    ember_value exports = ember_make_hash_map(vm, 16);
-    ember_hash_map* map = AS_HASH_MAP(exports);
-    
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "loaded"), ember_make_bool(true));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "type"), ember_make_string_gc(vm, "string"));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "version"), ember_make_string_gc(vm, "1.0.0"));
-    
-    return exports;
-}
-
-static ember_value init_crypto_module(ember_vm* vm) {
-    ember_value exports = ember_make_hash_map(vm, 16);
-    ember_hash_map* map = AS_HASH_MAP(exports);
-    
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "loaded"), ember_make_bool(true));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "type"), ember_make_string_gc(vm, "crypto"));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "version"), ember_make_string_gc(vm, "1.0.0"));
-    
-    return exports;
-}
-
-static ember_value init_json_module(ember_vm* vm) {
-    ember_value exports = ember_make_hash_map(vm, 16);
-    ember_hash_map* map = AS_HASH_MAP(exports);
-    
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "loaded"), ember_make_bool(true));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "type"), ember_make_string_gc(vm, "json"));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "version"), ember_make_string_gc(vm, "1.0.0"));
-    
-    return exports;
-}
-
-static ember_value init_io_module(ember_vm* vm) {
-    ember_value exports = ember_make_hash_map(vm, 16);
-    ember_hash_map* map = AS_HASH_MAP(exports);
-    
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "loaded"), ember_make_bool(true));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "type"), ember_make_string_gc(vm, "io"));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "version"), ember_make_string_gc(vm, "1.0.0"));
-    
-    return exports;
-}
-
-static ember_value init_http_module(ember_vm* vm) {
-    ember_value exports = ember_make_hash_map(vm, 16);
-    ember_hash_map* map = AS_HASH_MAP(exports);
-    
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "loaded"), ember_make_bool(true));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "type"), ember_make_string_gc(vm, "http"));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "version"), ember_make_string_gc(vm, "1.0.0"));
-    
-    return exports;
-}
-
-static ember_value init_path_module(ember_vm* vm) {
-    ember_value exports = ember_make_hash_map(vm, 16);
-    ember_hash_map* map = AS_HASH_MAP(exports);
-    
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "loaded"), ember_make_bool(true));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "type"), ember_make_string_gc(vm, "path"));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "version"), ember_make_string_gc(vm, "1.0.0"));
-    
-    // Path utilities
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "sep"), ember_make_string_gc(vm, "/"));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "delimiter"), ember_make_string_gc(vm, ":"));
-    
-    return exports;
-}
-
-static ember_value init_fs_module(ember_vm* vm) {
-    ember_value exports = ember_make_hash_map(vm, 16);
-    ember_hash_map* map = AS_HASH_MAP(exports);
-    
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "loaded"), ember_make_bool(true));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "type"), ember_make_string_gc(vm, "fs"));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "version"), ember_make_string_gc(vm, "1.0.0"));
-    
-    return exports;
-}
-
-static ember_value init_os_module(ember_vm* vm) {
-    ember_value exports = ember_make_hash_map(vm, 16);
-    ember_hash_map* map = AS_HASH_MAP(exports);
-    
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "loaded"), ember_make_bool(true));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "type"), ember_make_string_gc(vm, "os"));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "version"), ember_make_string_gc(vm, "1.0.0"));
-    
-    // OS information
-    #if defined(__linux__)
-        hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "platform"), ember_make_string_gc(vm, "linux"));
-    #elif defined(__APPLE__)
-        hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "platform"), ember_make_string_gc(vm, "darwin"));
-    #elif defined(_WIN32)
-        hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "platform"), ember_make_string_gc(vm, "win32"));
-    #else
-        hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "platform"), ember_make_string_gc(vm, "unknown"));
-    #endif
-    
-    return exports;
-}
-
-static ember_value init_util_module(ember_vm* vm) {
-    ember_value exports = ember_make_hash_map(vm, 16);
-    ember_hash_map* map = AS_HASH_MAP(exports);
-    
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "loaded"), ember_make_bool(true));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "type"), ember_make_string_gc(vm, "util"));
-    hash_map_set_with_vm(vm, map, ember_make_string_gc(vm, "version"), ember_make_string_gc(vm, "1.0.0"));
-    
-    return exports;
-}
-
 // Register module system native functions
 void ember_module_system_register_natives(ember_vm* vm) {
     ember_register_func(vm, "import", ember_native_import);
@@ -619,13 +914,16 @@ void ember_module_system_register_natives(ember_vm* vm) {
 
 // Clean up module cache
 void ember_module_system_cleanup(void) {
-    ember_module_context* context = g_module_registry;
-    while (context) {
-        ember_module_context* next = context->next;
-        free(context->module_path);
-        free(context);
-        context = next;
+    for (int i = 0; i < g_module_registry_capacity; i++) {
+        ember_module_context* context = g_module_registry[i];
+        if (context) {
+            free(context->module_path);
+            free(context);
+        }
     }
+    free(g_module_registry);
     g_module_registry = NULL;
+    g_module_registry_count = 0;
+    g_module_registry_capacity = 0;
     g_module_stack = NULL;
 }
\ No newline at end of file
@@ -16,12 +16,13 @@ extern "C" {
 // Module context for tracking exports and imports
 typedef struct ember_module_context {
     char* module_path;                // Path to this module
+    uint32_t hash;                    // hash_string_chars(module_path), the registry key
     ember_value exports;              // Hash map of exported values
     ember_value default_export;       // Default export value
     bool has_default_export;          // Whether default export exists
     bool is_loaded;                   // Whether module is fully loaded
     bool is_loading;                  // Whether module is currently loading (for circular deps)
-    struct ember_module_context* next; // Linked list for module registry
+    struct ember_module_context* next; // Module load stack (ember_push_module_context)
 } ember_module_context;
 
 // Export types
@@ -86,8 +87,10 @@ void ember_push_module_context(ember_vm* vm, ember_module_context* context);
 ember_module_context* ember_pop_module_context(ember_vm* vm);
 ember_module_context* ember_get_current_module_context(ember_vm* vm);
 
-// Standard library module initialization
+// Standard library modules. init returns the namespace map, built once per
+// VM; export materializes a single export (nil if there is none)
 ember_value ember_init_core_module(ember_vm* vm, const char* module_name);
+ember_value ember_core_module_export(ember_vm* vm, const char* module_name, const char* export_name);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,397 @@
+/**
+ * Binary serialization for Ember: serialize / deserialize in MessagePack
+ * format, for caching values on disk or in Redis
+ */
+
+#include "ember.h"
+#include "../vm.h"
+#include "value/value.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// serialize writes MessagePack into the VM's serialization buffer
+// (vm->json_buffer, shared with json_stringify), which stays allocated
+// between calls, and copies the result into a binary string. deserialize
+// reads straight from the string's bytes; each decoded string is its one
+// copy. Integral numbers use the smallest integer encoding, others float32
+// when that is exact and float64 otherwise. Ordered maps come back as
+// hash maps, sets and typed arrays as arrays, and bin is read as a string,
+// so anything other MessagePack writers produce (except ext) reads back.
+
+#define PACK_MAX_DEPTH 512
+#define PACK_BUFFER_KEEP (1024 * 1024)  // Larger buffers are not kept between calls
+
+typedef struct {
+    uint8_t* data;
+    size_t length;
+    size_t capacity;
+    ember_object* open[PACK_MAX_DEPTH];   // Containers being written, outermost first
+    int depth;
+} pack_writer;
+
+static int pack_reserve(pack_writer* writer, size_t size) {
+    if (writer->length + size <= writer->capacity) return 1;
+    size_t capacity = writer->capacity ? writer->capacity : 256;
+    while (capacity < writer->length + size) capacity *= 2;
+    uint8_t* grown = realloc(writer->data, capacity);
+    if (!grown) return 0;
+    writer->data = grown;
+    writer->capacity = capacity;
+    return 1;
+}
+
+// A tag followed by size big-endian bytes of value
+static int pack_tagged(pack_writer* writer, uint8_t tag, uint64_t value, int size) {
+    if (!pack_reserve(writer, (size_t)size + 1)) return 0;
+    uint8_t* at = writer->data + writer->length;
+    at[0] = tag;
+    for (int i = 0; i < size; i++) {
+        at[1 + i] = (uint8_t)(value >> (8 * (size - 1 - i)));
+    }
+    writer->length += (size_t)size + 1;
+    return 1;
+}
+
+// A length in the fix form when it fits, else with the 8, 16 or 32-bit tag
+// (tag8 is 0 for arrays and maps, which have none)
+static int pack_length(pack_writer* writer, uint32_t length, uint8_t fix, uint32_t fix_max,
+                       uint8_t tag8, uint8_t tag16, uint8_t tag32) {
+    if (length <= fix_max) return pack_tagged(writer, (uint8_t)(fix | length), 0, 0);
+    if (tag8 && length <= 0xFF) return pack_tagged(writer, tag8, length, 1);
+    if (length <= 0xFFFF) return pack_tagged(writer, tag16, length, 2);
+    return pack_tagged(writer, tag32, length, 4);
+}
+
+static int pack_number(pack_writer* writer, double number) {
+    if (number >= -9223372036854775808.0 && number < 9223372036854775808.0 &&
+        number == (double)(int64_t)number && !(number == 0 && 1 / number < 0)) {
+        int64_t integer = (int64_t)number;
+        if (integer >= 0) {
+            if (integer <= 0x7F) return pack_tagged(writer, (uint8_t)integer, 0, 0);
+            if (integer <= 0xFF) return pack_tagged(writer, 0xCC, (uint64_t)integer, 1);
+            if (integer <= 0xFFFF) return pack_tagged(writer, 0xCD, (uint64_t)integer, 2);
+            if (integer <= 0xFFFFFFFFLL) return pack_tagged(writer, 0xCE, (uint64_t)integer, 4);
+            return pack_tagged(writer, 0xCF, (uint64_t)integer, 8);
+        }
+        if (integer >= -32) return pack_tagged(writer, (uint8_t)(int8_t)integer, 0, 0);
+        if (integer >= INT8_MIN) return pack_tagged(writer, 0xD0, (uint8_t)(int8_t)integer, 1);
+        if (integer >= INT16_MIN) return pack_tagged(writer, 0xD1, (uint16_t)(int16_t)integer, 2);
+        if (integer >= INT32_MIN) return pack_tagged(writer, 0xD2, (uint32_t)(int32_t)integer, 4);
+        return pack_tagged(writer, 0xD3, (uint64_t)integer, 8);
+    }
+    float single = (float)number;
+    if ((double)single == number || number != number) {
+        uint32_t bits;
+        memcpy(&bits, &single, sizeof(bits));
+        return pack_tagged(writer, 0xCA, bits, 4);
+    }
+    uint64_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+    return pack_tagged(writer, 0xCB, bits, 8);
+}
+
+static int pack_string(pack_writer* writer, ember_string* string) {
+    const char* chars = ember_string_bytes(string);
+    if (!chars) chars = ember_string_flatten(string);
+    if (!chars) return 0;
+    size_t length = (size_t)string->length;
+    if (!pack_length(writer, (uint32_t)length, 0xA0, 31, 0xD9, 0xDA, 0xDB)) return 0;
+    if (!pack_reserve(writer, length)) return 0;
+    memcpy(writer->data + writer->length, chars, length);
+    writer->length += length;
+    return 1;
+}
+
+// Enters a container: 0 for one already being written (a cycle) or
+// nesting deeper than deserialize accepts
+static int pack_enter(pack_writer* writer, ember_object* container) {
+    if (writer->depth == PACK_MAX_DEPTH) return 0;
+    for (int i = 0; i < writer->depth; i++) {
+        if (writer->open[i] == container) return 0;
+    }
+    writer->open[writer->depth++] = container;
+    return 1;
+}
+
+static int pack_value(pack_writer* writer, ember_value value);
+
+static int pack_entries(pack_writer* writer, const ember_hash_entry* entries, int slots, int count,
+                        int with_values) {
+    if (with_values ? !pack_length(writer, (uint32_t)count, 0x80, 15, 0, 0xDE, 0xDF)
+                    : !pack_length(writer, (uint32_t)count, 0x90, 15, 0, 0xDC, 0xDD)) {
+        return 0;
+    }
+    for (int i = 0; entries && i < slots; i++) {
+        if (!entries[i].is_occupied) continue;
+        if (!pack_value(writer, entries[i].key)) return 0;
+        if (with_values && !pack_value(writer, entries[i].value)) return 0;
+    }
+    return 1;
+}
+
+static int pack_value(pack_writer* writer, ember_value value) {
+    switch (value.type) {
+        case EMBER_VAL_NIL:
+            return pack_tagged(writer, 0xC0, 0, 0);
+        case EMBER_VAL_BOOL:
+            return pack_tagged(writer, value.as.bool_val ? 0xC3 : 0xC2, 0, 0);
+        case EMBER_VAL_NUMBER:
+            return pack_number(writer, value.as.number_val);
+        case EMBER_VAL_STRING:
+            return pack_string(writer, AS_STRING(value));
+        case EMBER_VAL_ARRAY: {
+            ember_array* array = AS_ARRAY(value);
+            if (!pack_enter(writer, value.as.obj_val) ||
+                !pack_length(writer, (uint32_t)array->length, 0x90, 15, 0, 0xDC, 0xDD)) {
+                return 0;
+            }
+            for (int i = 0; i < array->length; i++) {
+                if (!pack_value(writer, array->elements[i])) return 0;
+            }
+            writer->depth--;
+            return 1;
+        }
+        case EMBER_VAL_HASH_MAP: {
+            ember_hash_map* map = AS_HASH_MAP(value);
+            if (!pack_enter(writer, value.as.obj_val) ||
+                !pack_entries(writer, map->entries, map->capacity, map->length, 1)) {
+                return 0;
+            }
+            writer->depth--;
+            return 1;
+        }
+        case EMBER_VAL_MAP: {
+            // In insertion order
+            ember_map* map = AS_MAP(value);
+            if (!pack_enter(writer, value.as.obj_val) ||
+                !pack_entries(writer, map->entries, map->count, map->size, 1)) {
+                return 0;
+            }
+            writer->depth--;
+            return 1;
+        }
+        case EMBER_VAL_SET: {
+            ember_hash_map* elements = AS_SET(value)->elements;
+            if (!pack_enter(writer, value.as.obj_val) ||
+                !pack_entries(writer, elements ? elements->entries : NULL, elements ? elements->capacity : 0,
+                              elements ? elements->length : 0, 0)) {
+                return 0;
+            }
+            writer->depth--;
+            return 1;
+        }
+        case EMBER_VAL_TYPED_ARRAY: {
+            ember_typed_array* array = AS_TYPED_ARRAY(value);
+            if (!pack_length(writer, (uint32_t)array->length, 0x90, 15, 0, 0xDC, 0xDD)) return 0;
+            for (int i = 0; i < array->length; i++) {
+                if (!pack_number(writer, ember_typed_array_load(array, i))) return 0;
+            }
+            return 1;
+        }
+        default:
+            // Functions, instances and the like would not come back the same
+            return 0;
+    }
+}
+
+// ============================================================================
+// DECODING
+// ============================================================================
+
+typedef struct {
+    ember_vm* vm;
+    const uint8_t* at;
+    const uint8_t* end;
+} pack_reader;
+
+static int unpack_bytes(pack_reader* reader, size_t size, const uint8_t** bytes) {
+    if ((size_t)(reader->end - reader->at) < size) return 0;
+    *bytes = reader->at;
+    reader->at += size;
+    return 1;
+}
+
+static int unpack_uint(pack_reader* reader, int size, uint64_t* out) {
+    const uint8_t* bytes;
+    if (!unpack_bytes(reader, (size_t)size, &bytes)) return 0;
+    uint64_t value = 0;
+    for (int i = 0; i < size; i++) {
+        value = value << 8 | bytes[i];
+    }
+    *out = value;
+    return 1;
+}
+
+static int unpack_value(pack_reader* reader, ember_value* out, int depth);
+
+static int unpack_string(pack_reader* reader, uint64_t length, ember_value* out) {
+    const uint8_t* bytes;
+    if (length > INT32_MAX || !unpack_bytes(reader, (size_t)length, &bytes)) return 0;
+    ember_string* string = copy_string(reader->vm, (const char*)bytes, (int)length);
+    if (!string) return 0;
+    out->type = EMBER_VAL_STRING;
+    out->as.obj_val = (ember_object*)string;
+    return 1;
+}
+
+static int unpack_array(pack_reader* reader, uint64_t count, ember_value* out, int depth) {
+    // Every element takes at least a byte, so a damaged count can't ask for
+    // more than the input holds
+    if (count > (uint64_t)(reader->end - reader->at)) return 0;
+    ember_array* array = allocate_array(reader->vm, count > 0 ? (int)count : 1);
+    if (!array) return 0;
+    out->type = EMBER_VAL_ARRAY;
+    out->as.obj_val = (ember_object*)array;
+    for (uint64_t i = 0; i < count; i++) {
+        ember_value element;
+        if (!unpack_value(reader, &element, depth + 1)) return 0;
+        array->elements[array->length++] = element;
+    }
+    return 1;
+}
+
+static int unpack_map(pack_reader* reader, uint64_t count, ember_value* out, int depth) {
+    if (count > (uint64_t)(reader->end - reader->at) / 2) return 0;
+    ember_hash_map* map = allocate_hash_map(reader->vm, (int)count);
+    if (!map) return 0;
+    out->type = EMBER_VAL_HASH_MAP;
+    out->as.obj_val = (ember_object*)map;
+    for (uint64_t i = 0; i < count; i++) {
+        ember_value key, value;
+        if (!unpack_value(reader, &key, depth + 1) || !unpack_value(reader, &value, depth + 1)) return 0;
+        hash_map_set_with_vm(reader->vm, map, key, value);
+    }
+    return 1;
+}
+
+static int unpack_value(pack_reader* reader, ember_value* out, int depth) {
+    const uint8_t* tag_byte;
+    if (depth > PACK_MAX_DEPTH || !unpack_bytes(reader, 1, &tag_byte)) return 0;
+    uint8_t tag = *tag_byte;
+    uint64_t bits;
+
+    if (tag <= 0x7F) {
+        *out = ember_make_number(tag);
+        return 1;
+    }
+    if (tag >= 0xE0) {
+        *out = ember_make_number((int8_t)tag);
+        return 1;
+    }
+    if (tag <= 0x8F) return unpack_map(reader, tag & 0x0F, out, depth);
+    if (tag <= 0x9F) return unpack_array(reader, tag & 0x0F, out, depth);
+    if (tag <= 0xBF) return unpack_string(reader, tag & 0x1F, out);
+
+    switch (tag) {
+        case 0xC0:
+            *out = ember_make_nil();
+            return 1;
+        case 0xC2:
+        case 0xC3:
+            *out = ember_make_bool(tag == 0xC3);
+            return 1;
+        case 0xC4: case 0xC5: case 0xC6:   // bin 8/16/32
+            return unpack_uint(reader, 1 << (tag - 0xC4), &bits) && unpack_string(reader, bits, out);
+        case 0xD9: case 0xDA: case 0xDB:   // str 8/16/32
+            return unpack_uint(reader, 1 << (tag - 0xD9), &bits) && unpack_string(reader, bits, out);
+        case 0xDC: case 0xDD:              // array 16/32
+            return unpack_uint(reader, tag == 0xDC ? 2 : 4, &bits) && unpack_array(reader, bits, out, depth);
+        case 0xDE: case 0xDF:              // map 16/32
+            return unpack_uint(reader, tag == 0xDE ? 2 : 4, &bits) && unpack_map(reader, bits, out, depth);
+        case 0xCA: {
+            if (!unpack_uint(reader, 4, &bits)) return 0;
+            uint32_t narrow = (uint32_t)bits;
+            float single;
+            memcpy(&single, &narrow, sizeof(single));
+            *out = ember_make_number(single);
+            return 1;
+        }
+        case 0xCB: {
+            if (!unpack_uint(reader, 8, &bits)) return 0;
+            double number;
+            memcpy(&number, &bits, sizeof(number));
+            *out = ember_make_number(number);
+            return 1;
+        }
+        case 0xCC: case 0xCD: case 0xCE: case 0xCF:   // uint 8/16/32/64
+            if (!unpack_uint(reader, 1 << (tag - 0xCC), &bits)) return 0;
+            *out = ember_make_number((double)bits);
+            return 1;
+        case 0xD0:
+            if (!unpack_uint(reader, 1, &bits)) return 0;
+            *out = ember_make_number((int8_t)bits);
+            return 1;
+        case 0xD1:
+            if (!unpack_uint(reader, 2, &bits)) return 0;
+            *out = ember_make_number((int16_t)bits);
+            return 1;
+        case 0xD2:
+            if (!unpack_uint(reader, 4, &bits)) return 0;
+            *out = ember_make_number((int32_t)bits);
+            return 1;
+        case 0xD3:
+            if (!unpack_uint(reader, 8, &bits)) return 0;
+            *out = ember_make_number((double)(int64_t)bits);
+            return 1;
+        default:
+            // 0xC1 is never used; ext types have no Ember value
+            return 0;
+    }
+}
+
+// serialize(value): MessagePack bytes as a string; nil for a cycle, nesting
+// past 512 levels or a value with no MessagePack form (functions, instances)
+ember_value ember_native_serialize(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 1) return ember_make_nil();
+
+    // Borrow the VM's buffer, as json_stringify does
+    pack_writer writer;
+    writer.data = (uint8_t*)vm->json_buffer;
+    writer.length = 0;
+    writer.capacity = vm->json_buffer_capacity;
+    writer.depth = 0;
+    vm->json_buffer = NULL;
+    vm->json_buffer_capacity = 0;
+
+    ember_value result = ember_make_nil();
+    if (pack_value(&writer, argv[0]) && writer.length <= INT32_MAX) {
+        ember_string* string = copy_string(vm, writer.data ? (const char*)writer.data : "", (int)writer.length);
+        if (string) {
+            result.type = EMBER_VAL_STRING;
+            result.as.obj_val = (ember_object*)string;
+        }
+    }
+
+    if (writer.capacity > PACK_BUFFER_KEEP || vm->json_buffer) {
+        free(writer.data);
+    } else {
+        vm->json_buffer = (char*)writer.data;
+        vm->json_buffer_capacity = writer.capacity;
+    }
+    return result;
+}
+
+// deserialize(bytes): the value a string of MessagePack bytes holds; nil if
+// the bytes are not exactly one value
+ember_value ember_native_deserialize(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 1 || argv[0].type != EMBER_VAL_STRING) return ember_make_nil();
+    ember_string* string = AS_STRING(argv[0]);
+    const char* bytes = ember_string_bytes(string);
+    if (!bytes) bytes = ember_string_flatten(string);
+    if (!bytes) return ember_make_nil();
+    return msgpack_decode(vm, (const uint8_t*)bytes, (size_t)string->length);
+}
+
+ember_value msgpack_decode(ember_vm* vm, const uint8_t* bytes, size_t length) {
+    pack_reader reader = {vm, bytes, bytes + length};
+    // What is built so far is only reachable from here; collection waits
+    // until the value is whole
+    int64_t saved_next_gc = vm->next_gc;
+    vm->next_gc = INT64_MAX;
+    ember_value result;
+    int ok = unpack_value(&reader, &result, 0) && reader.at == reader.end;
+    vm->next_gc = saved_next_gc;
+    return ok ? result : ember_make_nil();
+}
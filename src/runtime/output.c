@@ -0,0 +1,251 @@
+/**
+ * print's output buffer: print / flush_output
+ *
+ * print used to make a printf call per argument, each one a trip through
+ * stdio's lock. Each VM now formats its prints into its own buffer
+ * (vm->output), handed to write(2) in one piece once byte_limit bytes or
+ * line_limit lines are waiting, when the VM is reset by the pool or freed,
+ * on flush_output() / ember_vm_flush_output, and at process exit. When
+ * stdout is a terminal every line is written as it is printed.
+ *
+ * Text written to stdout some other way (print_value, a host's printf) goes
+ * out through stdio, which every flush empties first: it can land ahead of
+ * prints made before it, so flush when the order matters.
+ */
+
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../vm.h"
+#include "value/value.h"
+#include "template_stubs.h"  // ember_get_string_value
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define OUTPUT_DEFAULT_BYTES 8192
+#define OUTPUT_DEFAULT_LINES 64
+#define OUTPUT_KEEP (64 * 1024)              // Past this, a flushed buffer is given back
+
+struct ember_output {
+    pthread_mutex_t lock;                    // The VM's thread against the exit flush
+    char* data;
+    size_t length;
+    size_t capacity;
+    size_t byte_limit;                       // 0 = every print is written at once
+    int line_limit;                          // 0 = no line limit
+    int lines;                               // Prints waiting
+    struct ember_output* next;               // Live buffers, for the exit flush
+    struct ember_output* prev;
+};
+
+static pthread_mutex_t live_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct ember_output* live_outputs;
+static pthread_once_t exit_once = PTHREAD_ONCE_INIT;
+
+// Hands the waiting text to stdout; with the buffer's lock held
+static int output_flush_locked(struct ember_output* output) {
+    int result = 0;
+    fflush(stdout);
+    size_t written = 0;
+    while (written < output->length) {
+        ssize_t count = write(STDOUT_FILENO, output->data + written, output->length - written);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) {
+            result = -1;  // A closed pipe or full disk: the text is dropped
+            break;
+        }
+        written += (size_t)count;
+    }
+    output->length = 0;
+    output->lines = 0;
+    if (output->capacity > OUTPUT_KEEP) {
+        free(output->data);
+        output->data = NULL;
+        output->capacity = 0;
+    }
+    return result;
+}
+
+static void flush_live_outputs(void) {
+    pthread_mutex_lock(&live_lock);
+    for (struct ember_output* output = live_outputs; output; output = output->next) {
+        pthread_mutex_lock(&output->lock);
+        output_flush_locked(output);
+        pthread_mutex_unlock(&output->lock);
+    }
+    pthread_mutex_unlock(&live_lock);
+}
+
+static void register_exit_flush(void) {
+    atexit(flush_live_outputs);
+}
+
+static struct ember_output* output_get(ember_vm* vm) {
+    if (vm->output) return vm->output;
+    struct ember_output* output = calloc(1, sizeof(struct ember_output));
+    if (!output) return NULL;
+    pthread_mutex_init(&output->lock, NULL);
+    output->byte_limit = OUTPUT_DEFAULT_BYTES;
+    output->line_limit = isatty(STDOUT_FILENO) ? 1 : OUTPUT_DEFAULT_LINES;
+    pthread_once(&exit_once, register_exit_flush);
+    pthread_mutex_lock(&live_lock);
+    output->next = live_outputs;
+    if (live_outputs) live_outputs->prev = output;
+    live_outputs = output;
+    pthread_mutex_unlock(&live_lock);
+    vm->output = output;
+    return output;
+}
+
+// ember_text_sink into the buffer (locked by the caller), or straight to
+// stdout without one
+static void output_append(void* context, const char* text, size_t length) {
+    struct ember_output* output = context;
+    if (!output) {
+        fwrite(text, 1, length, stdout);
+        return;
+    }
+    if (output->length + length > output->capacity) {
+        size_t capacity = output->capacity ? output->capacity : 256;
+        while (capacity < output->length + length) capacity *= 2;
+        char* data = realloc(output->data, capacity);
+        if (!data) {
+            // Out of memory: write what is waiting, then this piece directly
+            output_flush_locked(output);
+            fwrite(text, 1, length, stdout);
+            fflush(stdout);
+            return;
+        }
+        output->data = data;
+        output->capacity = capacity;
+    }
+    memcpy(output->data + output->length, text, length);
+    output->length += length;
+    // One huge print is written in pieces rather than held whole
+    if (output->length >= OUTPUT_KEEP) {
+        output_flush_locked(output);
+    }
+}
+
+static void print_argument(ember_value value, struct ember_output* output) {
+    char number[32];
+    switch (value.type) {
+        case EMBER_VAL_NUMBER: {
+            int length = snprintf(number, sizeof(number), "%g", value.as.number_val);
+            output_append(output, number, (size_t)length);
+            break;
+        }
+        case EMBER_VAL_STRING: {
+            const char* str = ember_get_string_value(value);
+            if (str) output_append(output, str, strlen(str));
+            break;
+        }
+        case EMBER_VAL_BOOL:
+            if (value.as.bool_val) {
+                output_append(output, "true", 4);
+            } else {
+                output_append(output, "false", 5);
+            }
+            break;
+        case EMBER_VAL_ARRAY: {
+            ember_array* array = AS_ARRAY(value);
+            output_append(output, "[", 1);
+            for (int j = 0; j < array->length; j++) {
+                if (j > 0) output_append(output, ", ", 2);
+                ember_value_write(array->elements[j], output_append, output);
+            }
+            output_append(output, "]", 1);
+            break;
+        }
+        case EMBER_VAL_HASH_MAP: {
+            ember_hash_map* map = AS_HASH_MAP(value);
+            output_append(output, "{", 1);
+            int first = 1;
+            for (int j = 0; j < map->capacity; j++) {
+                if (map->entries[j].is_occupied) {
+                    if (!first) output_append(output, ", ", 2);
+                    ember_value_write(map->entries[j].key, output_append, output);
+                    output_append(output, ": ", 2);
+                    ember_value_write(map->entries[j].value, output_append, output);
+                    first = 0;
+                }
+            }
+            output_append(output, "}", 1);
+            break;
+        }
+        default:
+            output_append(output, "nil", 3);
+            break;
+    }
+}
+
+// Native print function
+ember_value ember_native_print(ember_vm* vm, int argc, ember_value* argv) {
+    struct ember_output* output = vm ? output_get(vm) : NULL;
+    if (output) pthread_mutex_lock(&output->lock);
+    for (int i = 0; i < argc; i++) {
+        if (i > 0) output_append(output, " ", 1); // Space separator between arguments
+        print_argument(argv[i], output);
+    }
+    output_append(output, "\n", 1); // Single newline at the end
+    if (output) {
+        output->lines++;
+        if (output->length >= output->byte_limit ||
+            (output->line_limit > 0 && output->lines >= output->line_limit)) {
+            output_flush_locked(output);
+        }
+        pthread_mutex_unlock(&output->lock);
+    }
+    return ember_make_nil();
+}
+
+// flush_output(): true once everything printed so far is written, false if
+// stdout refused it
+ember_value ember_native_flush_output(ember_vm* vm, int argc, ember_value* argv) {
+    (void)argv;
+    if (argc != 0) return ember_make_nil();
+    return ember_make_bool(ember_vm_flush_output(vm) == EMBER_SUCCESS);
+}
+
+int ember_vm_flush_output(ember_vm* vm) {
+    if (!vm) return EMBER_ERROR_INVALID_PARAMETER;
+    struct ember_output* output = vm->output;
+    if (!output) return fflush(stdout) == 0 ? EMBER_SUCCESS : EMBER_ERROR_OPERATION_FAILED;
+    pthread_mutex_lock(&output->lock);
+    int result = output_flush_locked(output);
+    pthread_mutex_unlock(&output->lock);
+    return result == 0 ? EMBER_SUCCESS : EMBER_ERROR_OPERATION_FAILED;
+}
+
+int ember_vm_set_output_buffering(ember_vm* vm, size_t byte_limit, int line_limit) {
+    if (!vm || line_limit < 0) return EMBER_ERROR_INVALID_PARAMETER;
+    struct ember_output* output = output_get(vm);
+    if (!output) return EMBER_ERROR_MEMORY_ALLOCATION;
+    pthread_mutex_lock(&output->lock);
+    int result = output_flush_locked(output);
+    output->byte_limit = byte_limit;
+    output->line_limit = line_limit;
+    pthread_mutex_unlock(&output->lock);
+    return result == 0 ? EMBER_SUCCESS : EMBER_ERROR_OPERATION_FAILED;
+}
+
+void vm_output_free(ember_vm* vm) {
+    struct ember_output* output = vm->output;
+    if (!output) return;
+    pthread_mutex_lock(&live_lock);
+    if (output->prev) {
+        output->prev->next = output->next;
+    } else {
+        live_outputs = output->next;
+    }
+    if (output->next) output->next->prev = output->prev;
+    pthread_mutex_unlock(&live_lock);
+    output_flush_locked(output);
+    pthread_mutex_destroy(&output->lock);
+    free(output->data);
+    free(output);
+    vm->output = NULL;
+}
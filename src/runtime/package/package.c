@@ -6,6 +6,7 @@
 #include "package.h"
 #include "../value/value.h"
 #include "http_stubs.h"
+#include "../../core/bytecode_format.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,6 +14,11 @@
 #include <unistd.h>
 #include <libgen.h>
 #include <time.h>
+#include <dirent.h>
+
+#ifdef HAVE_CURL
+#include "../http_share.h"
+#endif
 
 // Global package registry
 static EmberPackageRegistry* g_package_registry = NULL;
@@ -198,6 +204,119 @@ bool ember_package_download(EmberPackage* package) {
     return true;
 }
 
+/**
+ * Precompiled modules ship next to their sources as
+ * .bytecode/<file>.v<format>-<opcodes>.emberc. The tag is part of the name,
+ * so a build with another bytecode format or instruction set finds no chunk
+ * and compiles the source instead.
+ */
+static bool package_chunk_path(const char* source_path, char* path, size_t size) {
+    const char* slash = strrchr(source_path, '/');
+    int dir_length = slash ? (int)(slash - source_path) : 1;
+    int written = snprintf(path, size, "%.*s/.bytecode/%s.v%d-%d.emberc",
+                           dir_length, slash ? source_path : ".",
+                           slash ? slash + 1 : source_path,
+                           EMBER_BYTECODE_VERSION, OP_HALT + 1);
+    return written > 0 && (size_t)written < size;
+}
+
+/**
+ * Run a module's precompiled chunk in vm when this build has one that is not
+ * older than the source. False tells the caller to compile the source; a
+ * damaged chunk is rejected by the loader and lands there too.
+ */
+static bool package_run_chunk(ember_vm* vm, const char* source_path, int* result) {
+    char path[1024];
+    struct stat source_info, chunk_info;
+    if (!package_chunk_path(source_path, path, sizeof(path)) ||
+        stat(path, &chunk_info) != 0 || stat(source_path, &source_info) != 0 ||
+        chunk_info.st_mtime < source_info.st_mtime) {
+        return false;
+    }
+    ember_chunk* chunk = ember_bytecode_load_file(vm, path);
+    if (!chunk) return false;
+    *result = ember_bytecode_run(vm, chunk);
+    ember_bytecode_free_chunk(chunk);
+    return true;
+}
+
+static char* package_read_source(const char* path, long max_size) {
+    FILE* file = fopen(path, "r");
+    if (!file) return NULL;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* source = size > 0 && size <= max_size ? malloc(size + 1) : NULL;
+    if (source && fread(source, 1, size, file) != (size_t)size) {
+        free(source);
+        source = NULL;
+    }
+    if (source) source[size] = '\0';
+    fclose(file);
+    return source;
+}
+
+/**
+ * Imports run while a module is compiled and leave nothing in its bytecode,
+ * so a module that imports anything is published as source only
+ */
+static bool package_source_imports(const char* source) {
+    for (const char* line = source; line; line = strchr(line, '\n')) {
+        if (*line == '\n') line++;
+        line += strspn(line, " \t");
+        if (strncmp(line, "import", 6) == 0 && (line[6] == ' ' || line[6] == '\t')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Compile the package's top-level modules into .bytecode/ for publishing.
+ * Best effort: a module that does not compile here ships as source only.
+ */
+static int package_precompile_modules(const char* package_dir) {
+    DIR* dir = opendir(package_dir);
+    if (!dir) return 0;
+    int compiled = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir))) {
+        size_t length = strlen(entry->d_name);
+        if (length <= 6 || strcmp(entry->d_name + length - 6, ".ember") != 0) continue;
+
+        char source_path[1024], chunk_path[1024];
+        struct stat info;
+        snprintf(source_path, sizeof(source_path), "%s/%s", package_dir, entry->d_name);
+        if (stat(source_path, &info) != 0 || !S_ISREG(info.st_mode) ||
+            !package_chunk_path(source_path, chunk_path, sizeof(chunk_path))) {
+            continue;
+        }
+        char* source = package_read_source(source_path, 1024 * 1024);
+        if (!source || package_source_imports(source)) {
+            free(source);
+            continue;
+        }
+
+        // A fresh VM per module, since compiling binds its functions
+        ember_vm* vm = ember_new_vm();
+        uint8_t* data = NULL;
+        size_t size = 0;
+        if (vm && ember_bytecode_compile(vm, source, &data, &size)) {
+            char bytecode_dir[1024];
+            snprintf(bytecode_dir, sizeof(bytecode_dir), "%s/.bytecode", package_dir);
+            mkdir(bytecode_dir, 0755);
+            if (ember_bytecode_write_file(chunk_path, data, size)) {
+                compiled++;
+            }
+        }
+        free(data);
+        if (vm) ember_free_vm(vm);
+        free(source);
+    }
+    closedir(dir);
+    return compiled;
+}
+
 /**
  * Load package into VM
  */
@@ -264,9 +383,13 @@ bool ember_package_load(EmberPackage* package) {
         return false;
     }
     
-    // 3. Execute initialization code
+    // 3. Execute initialization code, from the published chunk when it
+    //    matches this build, otherwise by compiling the source
     printf("[PACKAGE] Executing package initialization code...\n");
-    int exec_result = ember_eval(vm, source_code);
+    int exec_result;
+    if (!package_run_chunk(vm, package_file, &exec_result)) {
+        exec_result = ember_eval(vm, source_code);
+    }
     if (exec_result != 0) {
         printf("[PACKAGE] ERROR: Package initialization failed with code %d\n", exec_result);
         ember_free_vm(vm);
@@ -314,14 +437,7 @@ bool ember_package_register_functions(EmberPackage* package, ember_vm* target_vm
         if (func_value.type == EMBER_VAL_FUNCTION || func_value.type == EMBER_VAL_NATIVE) {
             printf("[PACKAGE] Found function: %s\n", func_name);
             
-            // 2. Register function in target VM's global namespace
-            // Check if target VM has space for more globals
-            if (target_vm->global_count >= EMBER_MAX_GLOBALS) {
-                fprintf(stderr, "[PACKAGE] ERROR: Target VM has reached maximum global count\n");
-                return false;
-            }
-            
-            // 3. Create namespaced function name (package_name.function_name)
+            // 2. Create namespaced function name (package_name.function_name)
             size_t namespaced_name_len = strlen(package->name) + strlen(func_name) + 2; // +2 for '.' and '\0'
             char* namespaced_name = malloc(namespaced_name_len);
             if (!namespaced_name) {
@@ -333,43 +449,28 @@ bool ember_package_register_functions(EmberPackage* package, ember_vm* target_vm
             // Also register the function without namespace for direct access
             // (this allows both "testpkg.greet" and "greet" to work)
             
-            // First, register with namespace
-            target_vm->globals[target_vm->global_count].key = namespaced_name;
-            target_vm->globals[target_vm->global_count].value = func_value;
-            target_vm->global_count++;
+            // 3. First, register with namespace in the target VM's global table
+            if (ember_global_define(target_vm, namespaced_name, func_value) < 0) {
+                fprintf(stderr, "[PACKAGE] ERROR: Failed to register function %s\n", namespaced_name);
+                free(namespaced_name);
+                return false;
+            }
             functions_registered++;
             
             printf("[PACKAGE] Registered function: %s\n", namespaced_name);
             
             // Then register without namespace if there's no conflict
-            if (target_vm->global_count < EMBER_MAX_GLOBALS) {
-                // Check if function name already exists
-                bool name_exists = false;
-                for (int j = 0; j < target_vm->global_count - 1; j++) {
-                    if (strcmp(target_vm->globals[j].key, func_name) == 0) {
-                        name_exists = true;
-                        break;
-                    }
-                }
-                
-                if (!name_exists) {
-                    // Create a copy of the function name
-                    size_t func_name_len = strlen(func_name) + 1;
-                    char* func_name_copy = malloc(func_name_len);
-                    if (func_name_copy) {
-                        strcpy(func_name_copy, func_name);
-                        target_vm->globals[target_vm->global_count].key = func_name_copy;
-                        target_vm->globals[target_vm->global_count].value = func_value;
-                        target_vm->global_count++;
-                        functions_registered++;
-                        
-                        printf("[PACKAGE] Also registered function without namespace: %s\n", func_name);
-                    }
-                } else {
-                    printf("[PACKAGE] Function %s already exists in target VM, only available as %s\n", 
-                           func_name, namespaced_name);
+            if (ember_global_find(target_vm, func_name, (int)strlen(func_name)) < 0) {
+                if (ember_global_define(target_vm, func_name, func_value) >= 0) {
+                    functions_registered++;
+                    
+                    printf("[PACKAGE] Also registered function without namespace: %s\n", func_name);
                 }
+            } else {
+                printf("[PACKAGE] Function %s already exists in target VM, only available as %s\n", 
+                       func_name, namespaced_name);
             }
+            free(namespaced_name);
         }
     }
     
@@ -671,6 +772,75 @@ int ember_package_version_compare(const char* version1, const char* version2) {
     return 0;
 }
 
+/**
+ * Directory packages are installed under (~/.ember/packages); false if
+ * it does not fit in path
+ */
+static bool packages_directory(char* path, size_t size) {
+    return snprintf(path, size, "%s/.ember/packages", getenv("HOME") ? getenv("HOME") : "/tmp") < (int)size;
+}
+
+/**
+ * Whether version names one release rather than a range or "latest"
+ */
+static bool version_is_exact(const char* version) {
+    return version[0] >= '0' && version[0] <= '9' && !strpbrk(version, "xX*");
+}
+
+/**
+ * Check a downloaded archive, add it to the package store and install it
+ * as package_dir. The archive is removed either way
+ */
+static bool install_archive(const char* archive_path, const char* package_dir,
+                            const char* package_name, const char* version) {
+    // Verify downloaded file exists and has reasonable size
+    struct stat archive_stat;
+    if (stat(archive_path, &archive_stat) != 0) {
+        printf("[REPOSITORY] ERROR: Downloaded archive not found\n");
+        return false;
+    }
+    
+    if (archive_stat.st_size == 0) {
+        printf("[REPOSITORY] ERROR: Downloaded archive is empty\n");
+        unlink(archive_path);
+        return false;
+    }
+    
+    if (archive_stat.st_size > EMBER_PACKAGE_MAX_ARCHIVE_SIZE) {
+        printf("[REPOSITORY] ERROR: Downloaded archive too large (%ld bytes)\n", archive_stat.st_size);
+        unlink(archive_path);
+        return false;
+    }
+    
+    printf("[REPOSITORY] Downloaded %ld bytes\n", archive_stat.st_size);
+    
+    // Extracted and validated only if the store doesn't have these bytes yet
+    char hash[EMBER_PACKAGE_HASH_LEN];
+    bool stored = ember_package_store_add(archive_path, hash);
+    unlink(archive_path);
+    if (!stored || !ember_package_store_install(hash, package_dir)) {
+        return false;
+    }
+    
+    if (version_is_exact(version)) {
+        ember_package_store_remember(package_name, version, hash);
+    }
+    return true;
+}
+
+/**
+ * Install an exact package version straight from the package store
+ */
+static bool install_from_store(const char* package_name, const char* version, const char* package_dir) {
+    char hash[EMBER_PACKAGE_HASH_LEN];
+    if (!version_is_exact(version) || !ember_package_store_lookup(package_name, version, hash)) {
+        return false;
+    }
+    if (!ember_package_store_install(hash, package_dir)) return false;
+    printf("[REPOSITORY] Package %s@%s installed from the store\n", package_name, version);
+    return true;
+}
+
 /**
  * Fetch package from repository
  */
@@ -698,21 +868,32 @@ bool ember_package_fetch_from_repository(const char* package_name, const char* v
     
     // Create local packages directory
     char packages_dir[512];
-    snprintf(packages_dir, sizeof(packages_dir), "%s/.ember/packages", 
-             getenv("HOME") ? getenv("HOME") : "/tmp");
-    
-    if (ember_package_create_directory_recursive(packages_dir) != 0) {
+    if (!packages_directory(packages_dir, sizeof(packages_dir)) ||
+        ember_package_create_directory_recursive(packages_dir) != 0) {
         printf("[REPOSITORY] ERROR: Failed to create packages directory\n");
         ember_http_cleanup();
         return false;
     }
     
+    char package_dir[600];
+    if (snprintf(package_dir, sizeof(package_dir), "%s/%s", packages_dir, package_name) >= (int)sizeof(package_dir)) {
+        printf("[REPOSITORY] ERROR: Package path too long\n");
+        ember_http_cleanup();
+        return false;
+    }
+    
+    if (install_from_store(package_name, version, package_dir)) {
+        ember_http_cleanup();
+        return true;
+    }
+    
     // Download package archive
     char archive_path[600];
     int archive_path_len = snprintf(archive_path, sizeof(archive_path), "%s/%s-%s.tar.gz", 
                                    packages_dir, package_name, version);
     if (archive_path_len >= (int)sizeof(archive_path)) {
         printf("[REPOSITORY] ERROR: Archive path too long\n");
+        ember_http_cleanup();
         return false;
     }
     
@@ -729,74 +910,225 @@ bool ember_package_fetch_from_repository(const char* package_name, const char* v
         return false;
     }
     
-    // Verify downloaded file exists and has reasonable size
-    struct stat archive_stat;
-    if (stat(archive_path, &archive_stat) != 0) {
-        printf("[REPOSITORY] ERROR: Downloaded archive not found\n");
+    if (!install_archive(archive_path, package_dir, package_name, version)) {
         ember_http_cleanup();
         return false;
     }
     
-    if (archive_stat.st_size == 0) {
-        printf("[REPOSITORY] ERROR: Downloaded archive is empty\n");
-        unlink(archive_path);
-        ember_http_cleanup();
-        return false;
-    }
+    printf("[REPOSITORY] Package %s@%s fetched successfully\n", package_name, version);
     
-    if (archive_stat.st_size > 100 * 1024 * 1024) {  // 100MB limit
-        printf("[REPOSITORY] ERROR: Downloaded archive too large (%ld bytes)\n", archive_stat.st_size);
-        unlink(archive_path);
-        ember_http_cleanup();
-        return false;
+    ember_http_cleanup();
+    return true;
+}
+
+#ifdef HAVE_CURL
+
+// One download of ember_package_fetch_all
+typedef struct {
+    EmberPackage* package;
+    CURL* handle;
+    FILE* file;
+    char archive_path[600];
+} package_transfer;
+
+/**
+ * Download every package at once on one curl multi handle, installing
+ * each archive as soon as it is complete while the others continue
+ */
+static size_t fetch_all_parallel(EmberPackage** packages, size_t count, const char* repo_url,
+                                 const char* packages_dir) {
+    CURLM* multi = curl_multi_init();
+    package_transfer* transfers = calloc(count, sizeof(package_transfer));
+    if (!multi || !transfers) {
+        if (multi) curl_multi_cleanup(multi);
+        free(transfers);
+        return 0;
+    }
+    // Handles come from http_share.c, so transfers to the registry reuse
+    // its connection, TLS session and DNS entry; HTTP/2 multiplexes them
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)EMBER_PACKAGE_FETCH_CONNECTIONS);
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+    
+    struct curl_slist* headers = NULL;
+    const char* auth_token = getenv("EMBER_REGISTRY_TOKEN");
+    if (auth_token && auth_token[0]) {
+        char authorization[512];
+        if (snprintf(authorization, sizeof(authorization), "Authorization: Bearer %s", auth_token) <
+            (int)sizeof(authorization)) {
+            headers = curl_slist_append(NULL, authorization);
+        } else {
+            printf("[REPOSITORY] WARNING: EMBER_REGISTRY_TOKEN too long, downloading without it\n");
+        }
     }
     
-    printf("[REPOSITORY] Downloaded %ld bytes\n", archive_stat.st_size);
-    
-    // Create package directory
-    char package_dir[600];
-    snprintf(package_dir, sizeof(package_dir), "%s/%s", packages_dir, package_name);
+    for (size_t i = 0; i < count; i++) {
+        package_transfer* transfer = &transfers[i];
+        EmberPackage* package = packages[i];
+        transfer->package = package;
+        
+        char download_url[1024];
+        int download_url_len = snprintf(download_url, sizeof(download_url), "%s/download/%s/%s", 
+                                        repo_url, package->name, package->version);
+        if (download_url_len >= (int)sizeof(download_url)) {
+            printf("[REPOSITORY] ERROR: Download URL too long for %s\n", package->name);
+            continue;
+        }
+        int archive_path_len = snprintf(transfer->archive_path, sizeof(transfer->archive_path),
+                                        "%s/%s-%s.tar.gz", packages_dir, package->name, package->version);
+        if (archive_path_len >= (int)sizeof(transfer->archive_path)) {
+            printf("[REPOSITORY] ERROR: Archive path too long for %s\n", package->name);
+            continue;
+        }
+        
+        transfer->file = fopen(transfer->archive_path, "wb");
+        transfer->handle = transfer->file ? http_handle_acquire() : NULL;
+        if (!transfer->handle) {
+            printf("[REPOSITORY] ERROR: Failed to start download of %s\n", package->name);
+            if (transfer->file) {
+                fclose(transfer->file);
+                unlink(transfer->archive_path);
+                transfer->file = NULL;
+            }
+            continue;
+        }
+        
+        CURL* handle = transfer->handle;
+        curl_easy_setopt(handle, CURLOPT_URL, download_url);
+        curl_easy_setopt(handle, CURLOPT_WRITEDATA, transfer->file);
+        curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(handle, CURLOPT_FAILONERROR, 1L);
+        curl_easy_setopt(handle, CURLOPT_MAXFILESIZE_LARGE, (curl_off_t)EMBER_PACKAGE_MAX_ARCHIVE_SIZE);
+        curl_easy_setopt(handle, CURLOPT_PRIVATE, transfer);
+        if (headers) curl_easy_setopt(handle, CURLOPT_HTTPHEADER, headers);
+        curl_multi_add_handle(multi, handle);
+    }
+    
+    size_t fetched = 0;
+    int running = 0;
+    do {
+        curl_multi_perform(multi, &running);
+        
+        CURLMsg* message;
+        int remaining;
+        while ((message = curl_multi_info_read(multi, &remaining)) != NULL) {
+            if (message->msg != CURLMSG_DONE) continue;
+            package_transfer* transfer = NULL;
+            curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, (char**)&transfer);
+            CURLcode result = message->data.result;
+            
+            curl_multi_remove_handle(multi, transfer->handle);
+            http_handle_release(transfer->handle);
+            transfer->handle = NULL;
+            fclose(transfer->file);
+            transfer->file = NULL;
+            
+            EmberPackage* package = transfer->package;
+            if (result != CURLE_OK) {
+                printf("[REPOSITORY] ERROR: Failed to download %s@%s: %s\n",
+                       package->name, package->version, curl_easy_strerror(result));
+                unlink(transfer->archive_path);
+                continue;
+            }
+            
+            // Extracting holds up the other transfers only as long as
+            // their data fits in the socket buffers
+            char package_dir[600];
+            if (snprintf(package_dir, sizeof(package_dir), "%s/%s", packages_dir, package->name) >=
+                (int)sizeof(package_dir)) {
+                printf("[REPOSITORY] ERROR: Package path too long for %s\n", package->name);
+                unlink(transfer->archive_path);
+                continue;
+            }
+            if (!install_archive(transfer->archive_path, package_dir, package->name, package->version)) continue;
+            
+            strncpy(package->local_path, package_dir, EMBER_PACKAGE_MAX_PATH_LEN - 1);
+            package->local_path[EMBER_PACKAGE_MAX_PATH_LEN - 1] = '\0';
+            package->verified = true;
+            fetched++;
+            printf("[REPOSITORY] Package %s@%s fetched successfully\n", package->name, package->version);
+        }
+        
+        if (running > 0) {
+            curl_multi_poll(multi, NULL, 0, 1000, NULL);
+        }
+    } while (running > 0);
     
-    if (ember_package_create_directory_recursive(package_dir) != 0) {
-        printf("[REPOSITORY] ERROR: Failed to create package directory\n");
-        unlink(archive_path);
-        ember_http_cleanup();
-        return false;
+    curl_multi_cleanup(multi);
+    curl_slist_free_all(headers);
+    free(transfers);
+    return fetched;
+}
+
+#endif
+
+/**
+ * Fetch several packages from repository at once
+ */
+size_t ember_package_fetch_all(EmberPackage** packages, size_t count, const char* repo_url) {
+    if (!packages || count == 0 || !repo_url) return 0;
+    
+    // Versions come from other packages' manifests and end up in paths
+    for (size_t i = 0; i < count; i++) {
+        const char* version = packages[i]->version;
+        if (ember_package_validate_name(packages[i]->name) != 0 || !version[0] ||
+            strspn(version, "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ.-+_") != strlen(version) ||
+            strstr(version, "..")) {
+            printf("[REPOSITORY] ERROR: Invalid package: %s@%s\n", packages[i]->name, version);
+            return 0;
+        }
     }
     
-    // Extract archive using tar command (secure implementation)
-    char extract_cmd[1024];
-    int cmd_len = snprintf(extract_cmd, sizeof(extract_cmd), 
-                          "cd \"%s\" && tar -xzf \"%s\" --strip-components=1 2>/dev/null", 
-                          package_dir, archive_path);
-    if (cmd_len >= (int)sizeof(extract_cmd)) {
-        printf("[REPOSITORY] ERROR: Command too long\n");
-        return false;
+    char packages_dir[512];
+    if (!packages_directory(packages_dir, sizeof(packages_dir)) ||
+        ember_package_create_directory_recursive(packages_dir) != 0) {
+        printf("[REPOSITORY] ERROR: Failed to create packages directory\n");
+        return 0;
+    }
+    
+    // Exact versions the store already has need no download
+    EmberPackage** missing = malloc(sizeof(EmberPackage*) * count);
+    if (!missing) return 0;
+    size_t missing_count = 0;
+    size_t fetched = 0;
+    for (size_t i = 0; i < count; i++) {
+        EmberPackage* package = packages[i];
+        if (snprintf(package->local_path, EMBER_PACKAGE_MAX_PATH_LEN, "%s/%s", packages_dir,
+                     package->name) >= EMBER_PACKAGE_MAX_PATH_LEN) {
+            printf("[REPOSITORY] ERROR: Package path too long for %s\n", package->name);
+            package->local_path[0] = '\0';
+            continue;
+        }
+        if (install_from_store(package->name, package->version, package->local_path)) {
+            package->verified = true;
+            fetched++;
+        } else {
+            missing[missing_count++] = package;
+        }
+    }
+    if (missing_count == 0) {
+        free(missing);
+        return fetched;
     }
     
-    printf("[REPOSITORY] Extracting package archive...\n");
-    int extract_result = system(extract_cmd);
-    
-    // Clean up archive file
-    unlink(archive_path);
+    printf("[REPOSITORY] Fetching %zu package(s) from %s\n", missing_count, repo_url);
     
-    if (extract_result != 0) {
-        printf("[REPOSITORY] ERROR: Failed to extract package archive\n");
-        ember_http_cleanup();
-        return false;
+#ifdef HAVE_CURL
+    if (http_share_init()) {
+        fetched += fetch_all_parallel(missing, missing_count, repo_url, packages_dir);
+        free(missing);
+        return fetched;
     }
+#endif
     
-    // Verify package structure
-    if (!ember_package_validate_structure(package_dir)) {
-        printf("[REPOSITORY] ERROR: Package structure validation failed\n");
-        ember_http_cleanup();
-        return false;
+    // No curl: one download after another
+    for (size_t i = 0; i < missing_count; i++) {
+        EmberPackage* package = missing[i];
+        if (!ember_package_fetch_from_repository(package->name, package->version, repo_url)) continue;
+        package->verified = true;
+        fetched++;
     }
-    
-    printf("[REPOSITORY] Package %s@%s fetched successfully\n", package_name, version);
-    
-    ember_http_cleanup();
-    return true;
+    free(missing);
+    return fetched;
 }
 
 /**
@@ -854,12 +1186,20 @@ bool ember_package_publish_to_repository(const EmberPackage* package, const char
         return false;
     }
     
+    // Ship compiled modules alongside the sources for matching builds
+    int precompiled = package_precompile_modules(package->local_path);
+    if (precompiled > 0) {
+        printf("[REPOSITORY] Precompiled %d module(s) for bytecode v%d\n",
+               precompiled, EMBER_BYTECODE_VERSION);
+    }
+    
     printf("[REPOSITORY] Creating package archive...\n");
     
-    // Create tar.gz archive from package directory
+    // Create tar.gz archive from package directory. Archiving "." keeps
+    // .bytecode/ and gives the one leading component installs strip
     char create_cmd[1024];
     int create_len = snprintf(create_cmd, sizeof(create_cmd), 
-                             "cd \"%s\" && tar -czf \"%s\" * 2>/dev/null", 
+                             "cd \"%s\" && tar -czf \"%s\" . 2>/dev/null", 
                              package->local_path, archive_path);
     if (create_len >= (int)sizeof(create_cmd)) {
         printf("[REPOSITORY] ERROR: Create command too long\n");
@@ -1331,6 +1671,8 @@ bool ember_project_load_from_file(const char* filepath, EmberProject** project)
         // Trim whitespace
         while (*key == ' ' || *key == '\t') key++;
         while (*value == ' ' || *value == '\t') value++;
+        char* key_end = key + strlen(key);
+        while (key_end > key && (key_end[-1] == ' ' || key_end[-1] == '\t')) *--key_end = '\0';
         
         // Remove quotes from value
         if (value[0] == '"') {
@@ -1505,6 +1847,7 @@ bool ember_project_scan_imports(const char* script_path, EmberProject* project)
             if (comment) *comment = '\0';
             char* space = strchr(package_name, ' ');
             if (space) *space = '\0';
+            version[strcspn(version, " \t#")] = '\0';
             
             if (strlen(package_name) > 0) {
                 printf("[SCAN] Found import: %s@%s\n", package_name, version);
@@ -1519,6 +1862,286 @@ bool ember_project_scan_imports(const char* script_path, EmberProject* project)
     return true;
 }
 
+// Remembered results of ember_package_version_satisfies: every round of
+// resolution checks each installed package against all its constraints
+// again, and most pairs repeat across packages
+#define SATISFIES_CACHE_SIZE 256
+
+typedef struct {
+    char version[EMBER_PACKAGE_MAX_VERSION_LEN];
+    char constraint[EMBER_PACKAGE_MAX_VERSION_LEN];
+    bool used;
+    bool result;
+} satisfies_entry;
+
+// A package in the dependency graph
+typedef struct {
+    EmberPackage package;          // version: the one to download
+    char version[EMBER_PACKAGE_MAX_VERSION_LEN];  // From its manifest, "" if unknown
+    bool installed;                // Present under ~/.ember/packages
+    bool scanned;                  // Its manifest's dependencies are in the graph
+    bool fetched;                  // Download attempted; never retried
+} resolve_node;
+
+// One edge: required_by needs node at constraint
+typedef struct {
+    size_t node;
+    char constraint[EMBER_PACKAGE_MAX_VERSION_LEN];
+    char required_by[EMBER_PACKAGE_MAX_NAME_LEN];
+} resolve_constraint;
+
+typedef struct {
+    resolve_node* nodes;
+    size_t node_count;
+    size_t node_capacity;
+    resolve_constraint* constraints;
+    size_t constraint_count;
+    size_t constraint_capacity;
+    satisfies_entry* cache;
+    size_t cache_count;
+    char packages_dir[512];
+} dependency_resolver;
+
+static bool resolver_satisfies(dependency_resolver* resolver, const char* version, const char* constraint) {
+    uint32_t hash = 2166136261u;
+    for (const char* c = version; *c; c++) hash = (hash ^ (unsigned char)*c) * 16777619u;
+    hash = (hash ^ '@') * 16777619u;
+    for (const char* c = constraint; *c; c++) hash = (hash ^ (unsigned char)*c) * 16777619u;
+    
+    size_t mask = SATISFIES_CACHE_SIZE - 1;
+    for (size_t probe = 0; probe < SATISFIES_CACHE_SIZE; probe++) {
+        satisfies_entry* entry = &resolver->cache[(hash + probe) & mask];
+        if (!entry->used) {
+            bool result = ember_package_version_satisfies(version, constraint);
+            // Keep a quarter free so misses stay short
+            if (resolver->cache_count < SATISFIES_CACHE_SIZE * 3 / 4 &&
+                strlen(version) < sizeof(entry->version) && strlen(constraint) < sizeof(entry->constraint)) {
+                strcpy(entry->version, version);
+                strcpy(entry->constraint, constraint);
+                entry->result = result;
+                entry->used = true;
+                resolver->cache_count++;
+            }
+            return result;
+        }
+        if (strcmp(entry->version, version) == 0 && strcmp(entry->constraint, constraint) == 0) {
+            return entry->result;
+        }
+    }
+    return ember_package_version_satisfies(version, constraint);
+}
+
+/**
+ * Index of the node for name, added if new; -1 if it can't be
+ */
+static long resolver_node(dependency_resolver* resolver, const char* name) {
+    for (size_t i = 0; i < resolver->node_count; i++) {
+        if (strcmp(resolver->nodes[i].package.name, name) == 0) return (long)i;
+    }
+    if (ember_package_validate_name(name) != 0) {
+        fprintf(stderr, "[SECURITY] Dependency %s blocked due to invalid package name\n", name);
+        return -1;
+    }
+    if (resolver->node_count >= resolver->node_capacity) {
+        size_t new_capacity = resolver->node_capacity ? resolver->node_capacity * 2 : 16;
+        resolve_node* new_nodes = realloc(resolver->nodes, sizeof(resolve_node) * new_capacity);
+        if (!new_nodes) return -1;
+        resolver->nodes = new_nodes;
+        resolver->node_capacity = new_capacity;
+    }
+    
+    resolve_node* node = &resolver->nodes[resolver->node_count];
+    memset(node, 0, sizeof(resolve_node));
+    strncpy(node->package.name, name, EMBER_PACKAGE_MAX_NAME_LEN - 1);
+    if (snprintf(node->package.local_path, EMBER_PACKAGE_MAX_PATH_LEN, "%s/%s", resolver->packages_dir,
+                 name) >= EMBER_PACKAGE_MAX_PATH_LEN) {
+        fprintf(stderr, "[ERROR] Package path too long for %s\n", name);
+        return -1;
+    }
+    node->installed = access(node->package.local_path, F_OK) == 0;
+    return (long)resolver->node_count++;
+}
+
+static bool resolver_require(dependency_resolver* resolver, const char* name, const char* constraint,
+                             const char* required_by) {
+    long node = resolver_node(resolver, name);
+    if (node < 0) return false;
+    if (resolver->constraint_count >= resolver->constraint_capacity) {
+        size_t new_capacity = resolver->constraint_capacity ? resolver->constraint_capacity * 2 : 16;
+        resolve_constraint* new_constraints = realloc(resolver->constraints,
+                                                      sizeof(resolve_constraint) * new_capacity);
+        if (!new_constraints) return false;
+        resolver->constraints = new_constraints;
+        resolver->constraint_capacity = new_capacity;
+    }
+    
+    resolve_constraint* edge = &resolver->constraints[resolver->constraint_count++];
+    edge->node = (size_t)node;
+    strncpy(edge->constraint, constraint, EMBER_PACKAGE_MAX_VERSION_LEN - 1);
+    edge->constraint[EMBER_PACKAGE_MAX_VERSION_LEN - 1] = '\0';
+    strncpy(edge->required_by, required_by, EMBER_PACKAGE_MAX_NAME_LEN - 1);
+    edge->required_by[EMBER_PACKAGE_MAX_NAME_LEN - 1] = '\0';
+    return true;
+}
+
+/**
+ * Add the dependencies in an installed package's package.toml to the graph
+ */
+static bool resolver_scan(dependency_resolver* resolver, size_t index) {
+    char manifest_path[600];
+    if (snprintf(manifest_path, sizeof(manifest_path), "%s/package.toml",
+                 resolver->nodes[index].package.local_path) >= (int)sizeof(manifest_path)) {
+        fprintf(stderr, "[ERROR] Manifest path too long for %s\n", resolver->nodes[index].package.name);
+        resolver->nodes[index].scanned = true;
+        return false;
+    }
+    char name[EMBER_PACKAGE_MAX_NAME_LEN];
+    strcpy(name, resolver->nodes[index].package.name);  // nodes may move
+    resolver->nodes[index].scanned = true;
+    resolver->nodes[index].version[0] = '\0';
+    
+    // A package fetched again drops what its old manifest asked for
+    size_t kept = 0;
+    for (size_t i = 0; i < resolver->constraint_count; i++) {
+        if (strcmp(resolver->constraints[i].required_by, name) != 0) {
+            resolver->constraints[kept++] = resolver->constraints[i];
+        }
+    }
+    resolver->constraint_count = kept;
+    
+    if (access(manifest_path, F_OK) != 0) return true;  // Nothing to add; any version will do
+    
+    // A manifest has the same layout as ember.toml
+    EmberProject* manifest = NULL;
+    if (!ember_project_load_from_file(manifest_path, &manifest)) return true;
+    strncpy(resolver->nodes[index].version, manifest->version, EMBER_PACKAGE_MAX_VERSION_LEN - 1);
+    resolver->nodes[index].version[EMBER_PACKAGE_MAX_VERSION_LEN - 1] = '\0';
+    
+    bool ok = true;
+    for (size_t i = 0; i < manifest->dependency_count; i++) {
+        const EmberPackage* dep = &manifest->dependencies[i];
+        if (!resolver_require(resolver, dep->name, dep->version, name)) ok = false;
+    }
+    ember_project_cleanup(manifest);
+    return ok;
+}
+
+/**
+ * First constraint on index that the installed version fails, or NULL.
+ * A package without a manifest version satisfies everything
+ */
+static const resolve_constraint* resolver_unsatisfied(dependency_resolver* resolver, size_t index) {
+    const resolve_node* node = &resolver->nodes[index];
+    for (size_t i = 0; i < resolver->constraint_count; i++) {
+        const resolve_constraint* edge = &resolver->constraints[i];
+        if (edge->node != index) continue;
+        if (!node->installed) return edge;
+        if (node->version[0] && !resolver_satisfies(resolver, node->version, edge->constraint)) {
+            return edge;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Version to download for index: the first exact version asked for, else latest
+ */
+static void resolver_pick_version(dependency_resolver* resolver, size_t index, char* version) {
+    strcpy(version, "latest");
+    for (size_t i = 0; i < resolver->constraint_count; i++) {
+        const resolve_constraint* edge = &resolver->constraints[i];
+        if (edge->node == index && version_is_exact(edge->constraint)) {
+            strcpy(version, edge->constraint);
+            return;
+        }
+    }
+}
+
+static void resolver_free(dependency_resolver* resolver) {
+    free(resolver->nodes);
+    free(resolver->constraints);
+    free(resolver->cache);
+}
+
+/**
+ * Resolve the whole dependency graph of project and fetch what is missing.
+ * Rounds alternate: every installed package's manifest is read, then every
+ * package that is missing or fails a constraint is downloaded at once, and
+ * the manifests of those are read in the next round
+ */
+static bool resolve_dependencies(dependency_resolver* resolver, EmberProject* project) {
+    const char* repo_url = getenv("EMBER_REGISTRY_URL");
+    if (!repo_url || !repo_url[0]) repo_url = EMBER_PACKAGE_DEFAULT_REGISTRY_URL;
+    
+    bool ok = true;
+    for (size_t i = 0; i < project->dependency_count; i++) {
+        const EmberPackage* dep = &project->dependencies[i];
+        if (!resolver_require(resolver, dep->name, dep->version, project->name)) ok = false;
+    }
+    
+    EmberPackage** wanted = NULL;
+    size_t* wanted_nodes = NULL;
+    for (;;) {
+        for (size_t i = 0; i < resolver->node_count; i++) {
+            if (resolver->nodes[i].installed && !resolver->nodes[i].scanned && !resolver_scan(resolver, i)) {
+                ok = false;
+            }
+        }
+        
+        size_t wanted_count = 0;
+        free(wanted);
+        free(wanted_nodes);
+        wanted = malloc(sizeof(EmberPackage*) * (resolver->node_count + 1));
+        wanted_nodes = malloc(sizeof(size_t) * (resolver->node_count + 1));
+        if (!wanted || !wanted_nodes) {
+            free(wanted);
+            free(wanted_nodes);
+            return false;
+        }
+        for (size_t i = 0; i < resolver->node_count; i++) {
+            resolve_node* node = &resolver->nodes[i];
+            if (node->fetched || !resolver_unsatisfied(resolver, i)) continue;
+            node->fetched = true;
+            resolver_pick_version(resolver, i, node->package.version);
+            wanted_nodes[wanted_count] = i;
+            wanted[wanted_count++] = &node->package;
+        }
+        if (wanted_count == 0) break;
+        
+        printf("[INSTALL] Fetching %zu package(s) in parallel...\n", wanted_count);
+        ember_package_fetch_all(wanted, wanted_count, repo_url);
+        for (size_t i = 0; i < wanted_count; i++) {
+            resolve_node* node = &resolver->nodes[wanted_nodes[i]];
+            if (!node->package.verified) continue;
+            // New, or replaced: its manifest is read next round
+            node->installed = true;
+            node->scanned = false;
+        }
+    }
+    free(wanted);
+    free(wanted_nodes);
+    
+    // Whatever still fails a constraint can't be installed
+    for (size_t i = 0; i < resolver->node_count; i++) {
+        const resolve_constraint* edge = resolver_unsatisfied(resolver, i);
+        if (!edge) continue;
+        const resolve_node* node = &resolver->nodes[i];
+        if (!node->installed) {
+            // Direct dependencies still get ember_package_load's fallback
+            bool direct = strcmp(edge->required_by, project->name) == 0;
+            if (!direct) {
+                fprintf(stderr, "[ERROR] Failed to fetch %s required by %s\n", node->package.name, edge->required_by);
+                ok = false;
+            }
+            continue;
+        }
+        fprintf(stderr, "[ERROR] %s@%s does not satisfy %s required by %s\n",
+                node->package.name, node->version, edge->constraint, edge->required_by);
+        ok = false;
+    }
+    return ok;
+}
+
 /**
  * Install all dependencies for a project
  */
@@ -1535,14 +2158,40 @@ bool ember_project_install_dependencies(EmberProject* project) {
         return false;
     }
     
+    dependency_resolver resolver;
+    memset(&resolver, 0, sizeof(resolver));
+    if (!packages_directory(resolver.packages_dir, sizeof(resolver.packages_dir))) {
+        fprintf(stderr, "[ERROR] Packages directory path too long\n");
+        return false;
+    }
+    resolver.cache = calloc(SATISFIES_CACHE_SIZE, sizeof(satisfies_entry));
+    if (!resolver.cache) {
+        fprintf(stderr, "[ERROR] Failed to allocate dependency resolver\n");
+        return false;
+    }
+    
+    // The whole graph is settled and downloaded before anything loads
+    bool all_success = resolve_dependencies(&resolver, project);
+    printf("[INSTALL] Resolved %zu package(s)\n", resolver.node_count);
+    
     EmberPackageRegistry* registry = ember_package_get_global_registry();
-    bool all_success = true;
     
     for (size_t i = 0; i < project->dependency_count; i++) {
         EmberPackage* dep = &project->dependencies[i];
         
         printf("[INSTALL] Installing %s@%s...\n", dep->name, dep->version);
         
+        // Fetched by the resolver
+        if (strlen(dep->local_path) == 0) {
+            for (size_t j = 0; j < resolver.node_count; j++) {
+                if (resolver.nodes[j].installed && strcmp(resolver.nodes[j].package.name, dep->name) == 0) {
+                    strncpy(dep->local_path, resolver.nodes[j].package.local_path, EMBER_PACKAGE_MAX_PATH_LEN - 1);
+                    dep->local_path[EMBER_PACKAGE_MAX_PATH_LEN - 1] = '\0';
+                    break;
+                }
+            }
+        }
+        
         // Validate package structure
         if (strlen(dep->local_path) > 0 && !ember_package_validate_structure(dep->local_path)) {
             printf("[WARN] Package structure validation failed for %s, attempting download\n", dep->name);
@@ -1563,6 +2212,8 @@ bool ember_project_install_dependencies(EmberProject* project) {
         printf("[SUCCESS] Installed %s@%s\n", dep->name, dep->version);
     }
     
+    resolver_free(&resolver);
+    
     if (all_success) {
         printf("[INSTALL] All dependencies installed successfully!\n");
     } else {
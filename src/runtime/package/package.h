@@ -14,6 +14,10 @@
 #define EMBER_PACKAGE_MAX_VERSION_LEN 64
 #define EMBER_PACKAGE_MAX_PATH_LEN 512
 #define EMBER_PACKAGE_SIGNATURE_LEN 64
+#define EMBER_PACKAGE_MAX_ARCHIVE_SIZE (100 * 1024 * 1024)
+#define EMBER_PACKAGE_HASH_LEN 65           // Hex SHA-256 and its terminator
+#define EMBER_PACKAGE_FETCH_CONNECTIONS 8   // Per registry host, for ember_package_fetch_all
+#define EMBER_PACKAGE_DEFAULT_REGISTRY_URL "https://packages.ember-lang.org"  // EMBER_REGISTRY_URL overrides
 
 // Package management structures
 typedef struct {
@@ -67,6 +71,20 @@ int ember_package_version_compare(const char* version1, const char* version2);
 // Package repository integration (HTTP-based)
 bool ember_package_fetch_from_repository(const char* package_name, const char* version, const char* repo_url);
 bool ember_package_publish_to_repository(const EmberPackage* package, const char* repo_url);
+// Downloads and installs all of packages (name and version set) at once,
+// taking exact versions the package store has from there. Sets local_path,
+// and verified on each one installed. Returns how many were
+size_t ember_package_fetch_all(EmberPackage** packages, size_t count, const char* repo_url);
+
+// Content-addressed package store (package_store.c): ~/.ember/store
+// Unpacks and validates an archive into the store unless its contents are
+// there already; hash gets the entry's name
+bool ember_package_store_add(const char* archive_path, char* hash);
+// The entry an exact package version was stored as, if it is still intact
+bool ember_package_store_lookup(const char* name, const char* version, char* hash);
+void ember_package_store_remember(const char* name, const char* version, const char* hash);
+// Replaces package_dir with hardlinks to the entry's files
+bool ember_package_store_install(const char* hash, const char* package_dir);
 
 // Package validation
 bool ember_package_validate_structure(const char* package_path);
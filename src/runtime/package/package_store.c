@@ -0,0 +1,421 @@
+/**
+ * Ember Package Store
+ * Content-addressed cache of unpacked package archives, shared by every
+ * install on the machine
+ */
+
+#define _GNU_SOURCE
+
+#include "package.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <openssl/evp.h>
+#if defined(__linux__)
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
+// ~/.ember/store/<SHA-256 of an archive>/ holds the tree that archive
+// unpacks to, extracted and validated once. Its .ember-integrity lists every
+// file with its size and mtime and is written last, so an entry that has
+// one is complete. Installs hardlink from the entry (reflink or copy when
+// the store is on another filesystem), so a package version is on disk once
+// however many projects use it. ~/.ember/store/index/<name>@<version>
+// remembers which entry an exact version unpacked to, so installing it
+// again needs no download at all.
+//
+// On a hit the files are only stat'ed against the integrity list instead
+// of being extracted and validated again. Store files are read-only, and
+// an in-place edit through a link still moves the mtime, so a damaged
+// entry is dropped and unpacked afresh.
+
+#define STORE_INTEGRITY_FILE ".ember-integrity"
+#define STORE_INTEGRITY_HEADER "ember-store 1"
+
+typedef bool (*store_visit)(const char* path, const char* relative, const struct stat* info, void* context);
+
+// Path builders return false rather than hand back a truncated path
+static bool store_directory(char* path, size_t size) {
+    return snprintf(path, size, "%s/.ember/store", getenv("HOME") ? getenv("HOME") : "/tmp") < (int)size;
+}
+
+static bool store_entry_path(const char* hash, char* path, size_t size) {
+    if (strlen(hash) != EMBER_PACKAGE_HASH_LEN - 1 || strspn(hash, "0123456789abcdef") != strlen(hash)) {
+        return false;
+    }
+    char store[512];
+    return store_directory(store, sizeof(store)) && snprintf(path, size, "%s/%s", store, hash) < (int)size;
+}
+
+/**
+ * Visit everything under root/relative, depth first. Directories are
+ * visited before their contents, or after them with children_first
+ */
+static bool store_walk(const char* root, const char* relative, bool children_first, store_visit visit, void* context) {
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s%s%s", root, relative[0] ? "/" : "", relative) >= (int)sizeof(path)) {
+        return false;
+    }
+    DIR* dir = opendir(path);
+    if (!dir) return false;
+
+    bool ok = true;
+    struct dirent* entry;
+    while (ok && (entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        char child[PATH_MAX];
+        char child_relative[PATH_MAX];
+        if (snprintf(child, sizeof(child), "%s/%s", path, entry->d_name) >= (int)sizeof(child) ||
+            snprintf(child_relative, sizeof(child_relative), "%s%s%s", relative, relative[0] ? "/" : "",
+                     entry->d_name) >= (int)sizeof(child_relative)) {
+            ok = false;
+            break;
+        }
+        struct stat info;
+        if (lstat(child, &info) != 0) {
+            ok = false;
+            break;
+        }
+        bool directory = S_ISDIR(info.st_mode);
+        if (directory && !children_first) ok = visit(child, child_relative, &info, context);
+        if (ok && directory) ok = store_walk(root, child_relative, children_first, visit, context);
+        if (ok && (!directory || children_first)) ok = visit(child, child_relative, &info, context);
+    }
+    closedir(dir);
+    return ok;
+}
+
+static bool remove_visit(const char* path, const char* relative, const struct stat* info, void* context) {
+    (void)relative;
+    (void)info;
+    (void)context;
+    return remove(path) == 0 || errno == ENOENT;
+}
+
+static bool remove_tree(const char* path) {
+    store_walk(path, "", true, remove_visit, NULL);
+    return rmdir(path) == 0 || errno == ENOENT;
+}
+
+/**
+ * Hex SHA-256 of a file
+ */
+static bool archive_hash(const char* path, char* hash) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+    EVP_MD_CTX* context = EVP_MD_CTX_new();
+    bool ok = context && EVP_DigestInit_ex(context, EVP_sha256(), NULL);
+
+    unsigned char buffer[65536];
+    size_t got;
+    while (ok && (got = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        ok = EVP_DigestUpdate(context, buffer, got);
+    }
+    ok = ok && !ferror(file);
+
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    ok = ok && EVP_DigestFinal_ex(context, digest, &length) && length * 2 + 1 == EMBER_PACKAGE_HASH_LEN;
+    if (ok) {
+        for (unsigned int i = 0; i < length; i++) {
+            sprintf(hash + i * 2, "%02x", digest[i]);
+        }
+    }
+    EVP_MD_CTX_free(context);
+    fclose(file);
+    return ok;
+}
+
+/**
+ * Whether the entry's files still match its integrity list
+ */
+static bool store_entry_intact(const char* entry) {
+    char list_path[PATH_MAX];
+    if (snprintf(list_path, sizeof(list_path), "%s/%s", entry, STORE_INTEGRITY_FILE) >= (int)sizeof(list_path)) {
+        return false;
+    }
+    FILE* list = fopen(list_path, "r");
+    if (!list) return false;
+
+    char line[PATH_MAX + 64];
+    bool ok = fgets(line, sizeof(line), list) && strncmp(line, STORE_INTEGRITY_HEADER, strlen(STORE_INTEGRITY_HEADER)) == 0;
+    while (ok && fgets(line, sizeof(line), list)) {
+        line[strcspn(line, "\n")] = '\0';
+        long long size;
+        long long mtime;
+        int offset = 0;
+        if (sscanf(line, "%lld %lld %n", &size, &mtime, &offset) != 2 || offset == 0) {
+            ok = false;
+            break;
+        }
+        char path[PATH_MAX];
+        struct stat info;
+        if (snprintf(path, sizeof(path), "%s/%s", entry, line + offset) >= (int)sizeof(path) ||
+            lstat(path, &info) != 0 || (long long)info.st_size != size || (long long)info.st_mtime != mtime) {
+            ok = false;
+        }
+    }
+    fclose(list);
+    return ok;
+}
+
+static bool integrity_visit(const char* path, const char* relative, const struct stat* info, void* context) {
+    if (!S_ISREG(info->st_mode)) return true;
+    if (strcmp(relative, STORE_INTEGRITY_FILE) == 0) return true;
+    // Read-only, so writing through an install's link fails instead of
+    // changing every project that shares the file
+    chmod(path, info->st_mode & ~(S_IWUSR | S_IWGRP | S_IWOTH));
+    return fprintf((FILE*)context, "%lld %lld %s\n", (long long)info->st_size, (long long)info->st_mtime,
+                   relative) > 0;
+}
+
+/**
+ * Add an archive to the store
+ */
+bool ember_package_store_add(const char* archive_path, char* hash) {
+    if (!archive_path || !hash) return false;
+    if (!archive_hash(archive_path, hash)) {
+        printf("[STORE] ERROR: Failed to hash %s\n", archive_path);
+        return false;
+    }
+
+    char entry[PATH_MAX];
+    if (!store_entry_path(hash, entry, sizeof(entry))) {
+        printf("[STORE] ERROR: Store path too long\n");
+        return false;
+    }
+    if (store_entry_intact(entry)) {
+        printf("[STORE] Already have %.12s, skipping extraction\n", hash);
+        return true;
+    }
+    if (access(entry, F_OK) == 0) {
+        printf("[STORE] Entry %.12s is damaged, unpacking again\n", hash);
+        remove_tree(entry);
+    }
+
+    char store[512];
+    if (!store_directory(store, sizeof(store)) || ember_package_create_directory_recursive(store) != 0) {
+        printf("[STORE] ERROR: Failed to create store directory\n");
+        return false;
+    }
+
+    // Unpacked beside the entry and renamed into place once complete, so a
+    // concurrent install never sees half an entry
+    char staging[PATH_MAX];
+    if (snprintf(staging, sizeof(staging), "%s/.unpack-XXXXXX", store) >= (int)sizeof(staging) || !mkdtemp(staging)) {
+        printf("[STORE] ERROR: Failed to create staging directory\n");
+        return false;
+    }
+
+    char extract_cmd[PATH_MAX * 2 + 64];
+    int command_length = snprintf(extract_cmd, sizeof(extract_cmd),
+                                  "cd \"%s\" && tar -xzf \"%s\" --strip-components=1 2>/dev/null",
+                                  staging, archive_path);
+    printf("[REPOSITORY] Extracting package archive...\n");
+    if (command_length >= (int)sizeof(extract_cmd) || system(extract_cmd) != 0) {
+        printf("[REPOSITORY] ERROR: Failed to extract package archive\n");
+        remove_tree(staging);
+        return false;
+    }
+
+    if (!ember_package_validate_structure(staging)) {
+        printf("[REPOSITORY] ERROR: Package structure validation failed\n");
+        remove_tree(staging);
+        return false;
+    }
+
+    char list_path[PATH_MAX];
+    FILE* list = NULL;
+    if (snprintf(list_path, sizeof(list_path), "%s/%s", staging, STORE_INTEGRITY_FILE) < (int)sizeof(list_path)) {
+        list = fopen(list_path, "w");
+    }
+    bool listed = list && fprintf(list, "%s\n", STORE_INTEGRITY_HEADER) > 0 &&
+                  store_walk(staging, "", false, integrity_visit, list);
+    if (list && fclose(list) != 0) listed = false;
+    if (!listed) {
+        printf("[STORE] ERROR: Failed to write integrity list\n");
+        remove_tree(staging);
+        return false;
+    }
+
+    if (rename(staging, entry) != 0) {
+        // Another install stored the same archive first
+        remove_tree(staging);
+        if (!store_entry_intact(entry)) {
+            printf("[STORE] ERROR: Failed to store %.12s\n", hash);
+            return false;
+        }
+    }
+    printf("[STORE] Stored %.12s\n", hash);
+    return true;
+}
+
+static bool index_path(const char* name, const char* version, char* path, size_t size) {
+    char store[512];
+    return store_directory(store, sizeof(store)) &&
+           snprintf(path, size, "%s/index/%s@%s", store, name, version) < (int)size;
+}
+
+/**
+ * Look up the entry a package version was stored as
+ */
+bool ember_package_store_lookup(const char* name, const char* version, char* hash) {
+    if (!name || !version || !hash || ember_package_validate_name(name) != 0 || strchr(version, '/')) return false;
+    char path[PATH_MAX];
+    if (!index_path(name, version, path, sizeof(path))) return false;
+    FILE* file = fopen(path, "r");
+    if (!file) return false;
+    bool found = fgets(hash, EMBER_PACKAGE_HASH_LEN, file) != NULL;
+    fclose(file);
+
+    char entry[PATH_MAX];
+    return found && store_entry_path(hash, entry, sizeof(entry)) && store_entry_intact(entry);
+}
+
+/**
+ * Record which entry a package version was stored as
+ */
+void ember_package_store_remember(const char* name, const char* version, const char* hash) {
+    if (!name || !version || !hash || ember_package_validate_name(name) != 0 || strchr(version, '/')) return;
+    char store[512];
+    char index[600];
+    if (!store_directory(store, sizeof(store)) ||
+        snprintf(index, sizeof(index), "%s/index", store) >= (int)sizeof(index) ||
+        ember_package_create_directory_recursive(index) != 0) {
+        return;
+    }
+
+    // Written aside and renamed, so a reader never sees half a hash
+    char path[PATH_MAX];
+    char temp[PATH_MAX];
+    if (!index_path(name, version, path, sizeof(path)) ||
+        snprintf(temp, sizeof(temp), "%s.%d", path, (int)getpid()) >= (int)sizeof(temp)) {
+        return;
+    }
+    FILE* file = fopen(temp, "w");
+    if (!file) return;
+    bool ok = fputs(hash, file) >= 0;
+    if (fclose(file) != 0 || !ok || rename(temp, path) != 0) unlink(temp);
+}
+
+// Copy when a hardlink is impossible (another filesystem, link limits):
+// a reflink shares the blocks where the filesystem can, else the bytes
+static bool copy_file(const char* from, const char* to, mode_t mode) {
+    int in = open(from, O_RDONLY | O_CLOEXEC);
+    if (in < 0) return false;
+    int out = open(to, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode & 0777);
+    if (out < 0) {
+        close(in);
+        return false;
+    }
+    bool ok = false;
+#if defined(__linux__) && defined(FICLONE)
+    ok = ioctl(out, FICLONE, in) == 0;
+#endif
+    if (!ok) {
+        ok = true;
+        char buffer[65536];
+        ssize_t got;
+        while (ok && (got = read(in, buffer, sizeof(buffer))) != 0) {
+            if (got < 0) {
+                ok = errno == EINTR;
+                continue;
+            }
+            for (ssize_t done = 0; ok && done < got;) {
+                ssize_t put = write(out, buffer + done, (size_t)(got - done));
+                if (put < 0 && errno == EINTR) continue;
+                if (put <= 0) ok = false;
+                else done += put;
+            }
+        }
+    }
+    close(in);
+    if (close(out) != 0) ok = false;
+    return ok;
+}
+
+typedef struct {
+    const char* target;
+    size_t linked;
+    size_t copied;
+} link_context;
+
+static bool link_visit(const char* path, const char* relative, const struct stat* info, void* context) {
+    link_context* links = context;
+    if (strcmp(relative, STORE_INTEGRITY_FILE) == 0) return true;
+    char target[PATH_MAX];
+    if (snprintf(target, sizeof(target), "%s/%s", links->target, relative) >= (int)sizeof(target)) return false;
+
+    if (S_ISDIR(info->st_mode)) {
+        return mkdir(target, info->st_mode & 0777) == 0 || errno == EEXIST;
+    }
+    if (S_ISLNK(info->st_mode)) {
+        char destination[PATH_MAX];
+        ssize_t length = readlink(path, destination, sizeof(destination) - 1);
+        if (length < 0) return false;
+        destination[length] = '\0';
+        return symlink(destination, target) == 0;
+    }
+    if (!S_ISREG(info->st_mode)) return true;
+    if (link(path, target) == 0) {
+        links->linked++;
+        return true;
+    }
+    if (!copy_file(path, target, info->st_mode)) return false;
+    links->copied++;
+    return true;
+}
+
+/**
+ * Install a stored entry as package_dir
+ */
+bool ember_package_store_install(const char* hash, const char* package_dir) {
+    char entry[PATH_MAX];
+    if (!hash || !package_dir || !store_entry_path(hash, entry, sizeof(entry))) return false;
+
+    // Built beside package_dir and swapped in, so the old install stays
+    // usable until the new one is complete
+    char staging[PATH_MAX];
+    char retired[PATH_MAX];
+    if (snprintf(staging, sizeof(staging), "%s.install-XXXXXX", package_dir) >= (int)sizeof(staging) ||
+        snprintf(retired, sizeof(retired), "%s.old-XXXXXX", package_dir) >= (int)sizeof(retired)) {
+        printf("[STORE] ERROR: Install path too long: %s\n", package_dir);
+        return false;
+    }
+    if (!mkdtemp(staging)) {
+        printf("[STORE] ERROR: Failed to create %s\n", staging);
+        return false;
+    }
+
+    link_context links = {staging, 0, 0};
+    if (!store_walk(entry, "", false, link_visit, &links)) {
+        printf("[STORE] ERROR: Failed to install %.12s into %s\n", hash, package_dir);
+        remove_tree(staging);
+        return false;
+    }
+
+    bool replaced = access(package_dir, F_OK) == 0;
+    if (replaced && (!mkdtemp(retired) || rename(package_dir, retired) != 0)) {
+        printf("[STORE] ERROR: Failed to replace %s\n", package_dir);
+        rmdir(retired);
+        remove_tree(staging);
+        return false;
+    }
+    if (rename(staging, package_dir) != 0) {
+        printf("[STORE] ERROR: Failed to install %s\n", package_dir);
+        if (replaced) rename(retired, package_dir);
+        remove_tree(staging);
+        return false;
+    }
+    if (replaced) remove_tree(retired);
+
+    printf("[STORE] Installed %.12s: %zu file(s) linked, %zu copied\n", hash, links.linked, links.copied);
+    return true;
+}
@@ -0,0 +1,421 @@
+/**
+ * Deques and priority queues for Ember
+ *
+ * deque / deque_push_back / deque_push_front / deque_pop_back /
+ * deque_pop_front / deque_peek_back / deque_peek_front / deque_get /
+ * deque_clear / deque_to_array. A deque is a ring buffer whose capacity
+ * is a power of two, so an index wraps with a mask; it doubles when full
+ * and halves once a quarter full, and pushes and pops at either end are
+ * amortized O(1) where array shift and unshift move every element.
+ *
+ * priority_queue / pqueue_push / pqueue_pop / pqueue_peek / pqueue_clear.
+ * A priority queue is a 4-ary min-heap: half the depth of a binary heap,
+ * with a node's four children side by side in memory, which pays for the
+ * extra comparisons on the way down. Without a comparator priorities are
+ * numbers compared in line; with one, cmp(a, b) orders them and is called
+ * with the queue locked against changes. Equal priorities come out in the
+ * order they went in. len() gives the size of either.
+ */
+
+#include "ember.h"
+#include "../vm.h"
+#include "value/value.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#define DEQUE_MIN_CAPACITY 8
+#define DEQUE_MAX_CAPACITY (1 << 30)
+#define HEAP_ARITY 4
+#define HEAP_MIN_CAPACITY 16
+#define HEAP_SLOTS 5                         // Stack slots a sift with a comparator takes
+
+// ============================================================================
+// DEQUE
+// ============================================================================
+
+// Moves the elements, in order, to the front of a buffer of capacity slots
+static int deque_resize(ember_deque* deque, int capacity) {
+    ember_value* items = malloc((size_t)capacity * sizeof(ember_value));
+    if (!items) return 0;
+    int first = deque->capacity - deque->head;
+    if (first > deque->length) first = deque->length;
+    if (deque->length > 0) {
+        memcpy(items, deque->items + deque->head, (size_t)first * sizeof(ember_value));
+        memcpy(items + first, deque->items, (size_t)(deque->length - first) * sizeof(ember_value));
+    }
+    free(deque->items);
+    deque->items = items;
+    deque->head = 0;
+    deque->capacity = capacity;
+    return 1;
+}
+
+static int deque_reserve_one(ember_deque* deque) {
+    if (deque->length < deque->capacity) return 1;
+    if (deque->capacity >= DEQUE_MAX_CAPACITY) return 0;
+    return deque_resize(deque, deque->capacity ? deque->capacity * 2 : DEQUE_MIN_CAPACITY);
+}
+
+// Gives memory back after a burst; a failed shrink changes nothing
+static void deque_shrink(ember_deque* deque) {
+    if (deque->capacity > DEQUE_MIN_CAPACITY && deque->length < deque->capacity / 4) {
+        deque_resize(deque, deque->capacity / 2);
+    }
+}
+
+ember_value ember_make_deque(ember_vm* vm, int capacity) {
+    if (capacity < 0 || capacity > DEQUE_MAX_CAPACITY) return ember_make_nil();
+    ember_deque* deque = (ember_deque*)allocate_object(vm, sizeof(ember_deque), OBJ_DEQUE);
+    if (!deque) return ember_make_nil();
+    deque->items = NULL;
+    deque->head = 0;
+    deque->length = 0;
+    deque->capacity = 0;
+    if (capacity > 0) {
+        int rounded = DEQUE_MIN_CAPACITY;
+        while (rounded < capacity) rounded *= 2;
+        if (!deque_resize(deque, rounded)) return ember_make_nil();
+    }
+    ember_value value;
+    value.type = EMBER_VAL_DEQUE;
+    value.as.obj_val = (ember_object*)deque;
+    return value;
+}
+
+int deque_push_back(ember_vm* vm, ember_deque* deque, ember_value value) {
+    if (ember_object_is_frozen(deque) || !deque_reserve_one(deque)) return 0;
+    deque->items[(deque->head + deque->length) & (deque->capacity - 1)] = value;
+    deque->length++;
+    gc_write_barrier_helper(vm, (ember_object*)deque, ember_make_nil(), value);
+    return 1;
+}
+
+int deque_push_front(ember_vm* vm, ember_deque* deque, ember_value value) {
+    if (ember_object_is_frozen(deque) || !deque_reserve_one(deque)) return 0;
+    deque->head = (deque->head - 1) & (deque->capacity - 1);
+    deque->items[deque->head] = value;
+    deque->length++;
+    gc_write_barrier_helper(vm, (ember_object*)deque, ember_make_nil(), value);
+    return 1;
+}
+
+int deque_pop_back(ember_deque* deque, ember_value* value) {
+    if (deque->length == 0 || ember_object_is_frozen(deque)) return 0;
+    deque->length--;
+    ember_value* slot = &deque->items[(deque->head + deque->length) & (deque->capacity - 1)];
+    *value = *slot;
+    *slot = ember_make_nil();
+    deque_shrink(deque);
+    return 1;
+}
+
+int deque_pop_front(ember_deque* deque, ember_value* value) {
+    if (deque->length == 0 || ember_object_is_frozen(deque)) return 0;
+    *value = deque->items[deque->head];
+    deque->items[deque->head] = ember_make_nil();
+    deque->head = (deque->head + 1) & (deque->capacity - 1);
+    deque->length--;
+    deque_shrink(deque);
+    return 1;
+}
+
+// ============================================================================
+// PRIORITY QUEUE
+// ============================================================================
+
+typedef struct {
+    ember_vm* vm;
+    ember_priority_queue* queue;
+    ember_value* slots;                      // The moving item's value and priority, a popped value, cmp's arguments
+    bool failed;
+} heap_context;
+
+// Whether a goes before b. After a failed comparison every answer is
+// false, so a sift stops where it is
+static inline bool heap_less(heap_context* ctx, const ember_heap_item* a, const ember_heap_item* b) {
+    if (ctx->queue->compare.type == EMBER_VAL_NIL) {
+        double x = a->priority.as.number_val, y = b->priority.as.number_val;
+        return x < y || (x == y && a->sequence < b->sequence);
+    }
+    if (ctx->failed) return false;
+    ctx->slots[3] = a->priority;
+    ctx->slots[4] = b->priority;
+    ember_value result;
+    ctx->queue->busy = true;
+    int status = vm_call_prepared(ctx->vm, ctx->queue->compare, 2, &ctx->slots[3], &result);
+    ctx->queue->busy = false;
+    if (status != 0 || result.type != EMBER_VAL_NUMBER || result.as.number_val != result.as.number_val) {
+        ctx->failed = true;
+        return false;
+    }
+    double order = result.as.number_val;
+    return order < 0 || (order == 0 && a->sequence < b->sequence);
+}
+
+// The items are moved along into the hole, and item written once where
+// it ends up
+static void heap_sift_up(heap_context* ctx, int at, ember_heap_item item) {
+    ember_heap_item* items = ctx->queue->items;
+    while (at > 0) {
+        int parent = (at - 1) / HEAP_ARITY;
+        if (!heap_less(ctx, &item, &items[parent])) break;
+        items[at] = items[parent];
+        at = parent;
+    }
+    items[at] = item;
+}
+
+static void heap_sift_down(heap_context* ctx, int at, ember_heap_item item) {
+    ember_heap_item* items = ctx->queue->items;
+    int length = ctx->queue->length;
+    for (;;) {
+        int first = HEAP_ARITY * at + 1;
+        if (first >= length) break;
+        int last = first + HEAP_ARITY < length ? first + HEAP_ARITY : length;
+        int best = first;
+        for (int child = first + 1; child < last; child++) {
+            if (heap_less(ctx, &items[child], &items[best])) best = child;
+        }
+        if (!heap_less(ctx, &items[best], &item)) break;
+        items[at] = items[best];
+        at = best;
+    }
+    items[at] = item;
+}
+
+// Reserves the slots a comparator needs, rooting item while it is only in
+// C locals and in the hole a sift leaves
+static bool heap_begin(heap_context* ctx, ember_vm* vm, ember_priority_queue* queue, const ember_heap_item* item) {
+    ctx->vm = vm;
+    ctx->queue = queue;
+    ctx->slots = NULL;
+    ctx->failed = false;
+    if (queue->compare.type == EMBER_VAL_NIL) return true;
+    if (vm->stack_top + HEAP_SLOTS > EMBER_STACK_MAX) {
+        fprintf(stderr, "[CALL] Stack overflow calling priority queue comparator\n");
+        return false;
+    }
+    ctx->slots = &vm->stack[vm->stack_top];
+    ctx->slots[0] = item->value;
+    ctx->slots[1] = item->priority;
+    for (int i = 2; i < HEAP_SLOTS; i++) {
+        ctx->slots[i] = ember_make_nil();
+    }
+    vm->stack_top += HEAP_SLOTS;
+    return true;
+}
+
+static void heap_end(heap_context* ctx) {
+    if (ctx->slots) ctx->vm->stack_top -= HEAP_SLOTS;
+}
+
+ember_value ember_make_priority_queue(ember_vm* vm, ember_value compare) {
+    ember_priority_queue* queue =
+        (ember_priority_queue*)allocate_object(vm, sizeof(ember_priority_queue), OBJ_PRIORITY_QUEUE);
+    if (!queue) return ember_make_nil();
+    queue->items = NULL;
+    queue->length = 0;
+    queue->capacity = 0;
+    queue->compare = compare;
+    queue->next_sequence = 0;
+    queue->busy = false;
+    ember_value value;
+    value.type = EMBER_VAL_PRIORITY_QUEUE;
+    value.as.obj_val = (ember_object*)queue;
+    return value;
+}
+
+// 1 once pushed, 0 if nothing changed, -1 if compare failed: value is in
+// the queue, though maybe not yet in order with its parent
+int priority_queue_push(ember_vm* vm, ember_priority_queue* queue, ember_value value, ember_value priority) {
+    if (ember_object_is_frozen(queue) || queue->busy) return 0;
+    if (queue->compare.type == EMBER_VAL_NIL &&
+        (priority.type != EMBER_VAL_NUMBER || priority.as.number_val != priority.as.number_val)) {
+        return 0;
+    }
+    if (queue->length == queue->capacity) {
+        if (queue->capacity > INT32_MAX / 2) return 0;
+        int capacity = queue->capacity ? queue->capacity * 2 : HEAP_MIN_CAPACITY;
+        ember_heap_item* items = realloc(queue->items, (size_t)capacity * sizeof(ember_heap_item));
+        if (!items) return 0;
+        queue->items = items;
+        queue->capacity = capacity;
+    }
+    ember_heap_item item = {value, priority, queue->next_sequence++};
+    heap_context ctx;
+    if (!heap_begin(&ctx, vm, queue, &item)) return 0;
+    // Written before the sift, so a collection during compare never
+    // traces a stale slot
+    queue->items[queue->length++] = item;
+    gc_write_barrier_helper(vm, (ember_object*)queue, ember_make_nil(), value);
+    gc_write_barrier_helper(vm, (ember_object*)queue, ember_make_nil(), priority);
+    heap_sift_up(&ctx, queue->length - 1, item);
+    heap_end(&ctx);
+    return ctx.failed ? -1 : 1;
+}
+
+// 1 with the first value, 0 if empty or nothing could change, -1 with
+// the first value if compare failed while reordering the rest
+int priority_queue_pop(ember_vm* vm, ember_priority_queue* queue, ember_value* value) {
+    if (queue->length == 0 || ember_object_is_frozen(queue) || queue->busy) return 0;
+    ember_heap_item last = queue->items[queue->length - 1];
+    heap_context ctx;
+    if (!heap_begin(&ctx, vm, queue, &last)) return 0;
+    *value = queue->items[0].value;
+    queue->length--;
+    if (queue->length > 0) {
+        // Neither the popped value nor last is in the heap's range now
+        if (ctx.slots) ctx.slots[2] = *value;
+        heap_sift_down(&ctx, 0, last);
+    }
+    heap_end(&ctx);
+    return ctx.failed ? -1 : 1;
+}
+
+// ============================================================================
+// NATIVES
+// ============================================================================
+
+static int deque_arg(int argc, ember_value* argv, int count) {
+    return argc == count && argv[0].type == EMBER_VAL_DEQUE;
+}
+
+// deque([values]): a new deque, holding the elements of an array in order
+ember_value ember_native_deque(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc > 1 || (argc == 1 && argv[0].type != EMBER_VAL_ARRAY)) return ember_make_nil();
+    ember_array* source = argc == 1 ? AS_ARRAY(argv[0]) : NULL;
+    ember_value value = ember_make_deque(vm, source ? source->length : 0);
+    if (value.type != EMBER_VAL_DEQUE || !source || source->length == 0) return value;
+    ember_deque* deque = AS_DEQUE(value);
+    memcpy(deque->items, source->elements, (size_t)source->length * sizeof(ember_value));
+    deque->length = source->length;
+    for (int i = 0; i < source->length; i++) {
+        gc_write_barrier_helper(vm, (ember_object*)deque, ember_make_nil(), source->elements[i]);
+    }
+    return value;
+}
+
+// deque_push_back(d, value) and deque_push_front(d, value): the new length
+ember_value ember_native_deque_push_back(ember_vm* vm, int argc, ember_value* argv) {
+    if (!deque_arg(argc, argv, 2) || !deque_push_back(vm, AS_DEQUE(argv[0]), argv[1])) return ember_make_nil();
+    return ember_make_number(AS_DEQUE(argv[0])->length);
+}
+
+ember_value ember_native_deque_push_front(ember_vm* vm, int argc, ember_value* argv) {
+    if (!deque_arg(argc, argv, 2) || !deque_push_front(vm, AS_DEQUE(argv[0]), argv[1])) return ember_make_nil();
+    return ember_make_number(AS_DEQUE(argv[0])->length);
+}
+
+// deque_pop_back(d) and deque_pop_front(d): the element taken, or nil if
+// there was none
+ember_value ember_native_deque_pop_back(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    ember_value value;
+    if (!deque_arg(argc, argv, 1) || !deque_pop_back(AS_DEQUE(argv[0]), &value)) return ember_make_nil();
+    return value;
+}
+
+ember_value ember_native_deque_pop_front(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    ember_value value;
+    if (!deque_arg(argc, argv, 1) || !deque_pop_front(AS_DEQUE(argv[0]), &value)) return ember_make_nil();
+    return value;
+}
+
+ember_value ember_native_deque_peek_back(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (!deque_arg(argc, argv, 1) || AS_DEQUE(argv[0])->length == 0) return ember_make_nil();
+    return deque_at(AS_DEQUE(argv[0]), AS_DEQUE(argv[0])->length - 1);
+}
+
+ember_value ember_native_deque_peek_front(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (!deque_arg(argc, argv, 1) || AS_DEQUE(argv[0])->length == 0) return ember_make_nil();
+    return deque_at(AS_DEQUE(argv[0]), 0);
+}
+
+// deque_get(d, index): negative indexes count from the back; nil out of range
+ember_value ember_native_deque_get(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (!deque_arg(argc, argv, 2) || argv[1].type != EMBER_VAL_NUMBER) return ember_make_nil();
+    ember_deque* deque = AS_DEQUE(argv[0]);
+    double index = argv[1].as.number_val;
+    if (index < 0) index += deque->length;
+    if (!(index >= 0 && index < deque->length) || index != trunc(index)) return ember_make_nil();
+    return deque_at(deque, (int)index);
+}
+
+ember_value ember_native_deque_clear(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (!deque_arg(argc, argv, 1) || ember_object_is_frozen(argv[0].as.obj_val)) return ember_make_nil();
+    ember_deque* deque = AS_DEQUE(argv[0]);
+    free(deque->items);
+    deque->items = NULL;
+    deque->head = 0;
+    deque->length = 0;
+    deque->capacity = 0;
+    return argv[0];
+}
+
+// deque_to_array(d): the elements front to back
+ember_value ember_native_deque_to_array(ember_vm* vm, int argc, ember_value* argv) {
+    if (!deque_arg(argc, argv, 1)) return ember_make_nil();
+    ember_deque* deque = AS_DEQUE(argv[0]);
+    ember_value array = ember_make_array(vm, deque->length > 0 ? deque->length : 1);
+    if (array.type != EMBER_VAL_ARRAY) return array;
+    for (int i = 0; i < deque->length; i++) {
+        array_push_with_vm(vm, AS_ARRAY(array), deque_at(deque, i));
+    }
+    return array;
+}
+
+// priority_queue([cmp]): a new queue, ordered by cmp(a, b) on priorities
+// (negative when a goes first), or by number priorities, smallest first
+ember_value ember_native_priority_queue(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc > 1) return ember_make_nil();
+    ember_value compare = argc == 1 ? argv[0] : ember_make_nil();
+    if (compare.type != EMBER_VAL_NIL && !vm_callable(compare, 2)) return ember_make_nil();
+    return ember_make_priority_queue(vm, compare);
+}
+
+static int pqueue_arg(int argc, ember_value* argv, int min, int max) {
+    return argc >= min && argc <= max && argv[0].type == EMBER_VAL_PRIORITY_QUEUE;
+}
+
+// pqueue_push(q, value[, priority]): the new length. The priority is the
+// value itself without one; nil if it is no number in a queue without cmp,
+// or if cmp fails
+ember_value ember_native_pqueue_push(ember_vm* vm, int argc, ember_value* argv) {
+    if (!pqueue_arg(argc, argv, 2, 3)) return ember_make_nil();
+    ember_priority_queue* queue = AS_PRIORITY_QUEUE(argv[0]);
+    if (priority_queue_push(vm, queue, argv[1], argc == 3 ? argv[2] : argv[1]) != 1) return ember_make_nil();
+    return ember_make_number(queue->length);
+}
+
+// pqueue_pop(q): the value first in priority order, or nil if empty or
+// cmp fails
+ember_value ember_native_pqueue_pop(ember_vm* vm, int argc, ember_value* argv) {
+    ember_value value;
+    if (!pqueue_arg(argc, argv, 1, 1) || priority_queue_pop(vm, AS_PRIORITY_QUEUE(argv[0]), &value) != 1) {
+        return ember_make_nil();
+    }
+    return value;
+}
+
+ember_value ember_native_pqueue_peek(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (!pqueue_arg(argc, argv, 1, 1) || AS_PRIORITY_QUEUE(argv[0])->length == 0) return ember_make_nil();
+    return AS_PRIORITY_QUEUE(argv[0])->items[0].value;
+}
+
+ember_value ember_native_pqueue_clear(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (!pqueue_arg(argc, argv, 1, 1)) return ember_make_nil();
+    ember_priority_queue* queue = AS_PRIORITY_QUEUE(argv[0]);
+    if (ember_object_is_frozen(queue) || queue->busy) return ember_make_nil();
+    queue->length = 0;
+    return argv[0];
+}
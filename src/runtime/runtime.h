@@ -20,8 +20,11 @@ void free_ember_value(ember_value value);
 // String operations
 ember_value concatenate_strings(ember_vm* vm, ember_value a, ember_value b);
 
-// Built-in functions registration
+// Built-in functions registration; with vm->lazy_stdlib_loading set nothing
+// is bound until ember_builtin_bind is asked for a name
 void register_builtin_functions(ember_vm* vm);
+// Registers the builtin called name[0..length); 0 if there is none
+int ember_builtin_bind(ember_vm* vm, const char* name, int length);
 
 // Module system
 int ember_import_module(ember_vm* vm, const char* module_name);
@@ -0,0 +1,433 @@
+/**
+ * Sessions: session_set / session_get / session_touch / session_delete /
+ * session_count
+ *
+ * An in-process store shared by every VM, so a session lookup is a hash
+ * probe rather than a round trip to Redis. It is split into shards, each
+ * with its own lock, chosen by the session ID's hash: requests for
+ * different sessions rarely wait on each other.
+ *
+ * Values are kept as MessagePack bytes (the serialize format) in a
+ * reference-counted blob, so session_get decodes them outside the shard's
+ * lock straight into the calling VM's heap, and the value shares nothing
+ * with the VM that stored it.
+ *
+ * Expiry is a hierarchical timer wheel per shard: four levels of 64 slots,
+ * at 1 s, 64 s, ~68 min and ~3 days per slot. Setting or touching a
+ * session moves it to the slot for its deadline, and a shard advances its
+ * wheel to the current second whenever it is used, freeing what the slots
+ * it passes hold. Sessions nearing their deadline cascade down a level as
+ * the wheel turns, so nothing is ever found by scanning. A get checks the
+ * exact deadline too, so a session is never seen past it.
+ */
+
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../vm.h"
+#include "value/value.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#define SESSION_SHARDS 64                    // Power of two
+#define SESSION_WHEEL_BITS 6
+#define SESSION_WHEEL_SLOTS (1 << SESSION_WHEEL_BITS)
+#define SESSION_WHEEL_LEVELS 4               // 64^4 s, ~194 days; longer deadlines wait at the top
+#define SESSION_DEFAULT_TTL 1800.0           // Seconds, without a ttl argument
+#define SESSION_MAX_ID 256
+
+typedef struct {
+    int refs;                                // The entry's, and each get decoding it
+    size_t length;
+    uint8_t bytes[];
+} session_blob;
+
+typedef struct session_entry {
+    struct session_entry* next;              // Bucket chain
+    struct session_entry* timer_next;        // Wheel slot list
+    struct session_entry** timer_link;       // What points at this entry in it
+    uint64_t hash;
+    int64_t expires_ms;                      // Monotonic clock
+    session_blob* blob;
+    size_t id_length;
+    char id[];
+} session_entry;
+
+typedef struct {
+    pthread_mutex_t lock;
+    session_entry** buckets;
+    int bucket_count;                        // Power of two, 0 until the first set
+    int count;
+    int64_t tick;                            // Second the wheel has reached
+    session_entry* wheel[SESSION_WHEEL_LEVELS][SESSION_WHEEL_SLOTS];
+} session_shard;
+
+static session_shard shards[SESSION_SHARDS];
+static pthread_once_t shards_once = PTHREAD_ONCE_INIT;
+static int64_t default_ttl_ms = (int64_t)(SESSION_DEFAULT_TTL * 1000);
+
+static void shards_init(void) {
+    for (int i = 0; i < SESSION_SHARDS; i++) {
+        pthread_mutex_init(&shards[i].lock, NULL);
+    }
+}
+
+static int64_t now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static uint64_t id_hash(const char* id, size_t length) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)id[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static void blob_release(session_blob* blob) {
+    if (blob && __atomic_sub_fetch(&blob->refs, 1, __ATOMIC_ACQ_REL) == 0) free(blob);
+}
+
+// ============================================================================
+// TIMER WHEEL
+// ============================================================================
+
+static void timer_unlink(session_entry* entry) {
+    if (!entry->timer_link) return;
+    *entry->timer_link = entry->timer_next;
+    if (entry->timer_next) entry->timer_next->timer_link = entry->timer_link;
+    entry->timer_next = NULL;
+    entry->timer_link = NULL;
+}
+
+// Files entry under the slot its deadline falls in, relative to the wheel's tick
+static void timer_place(session_shard* shard, session_entry* entry) {
+    // The second at whose tick the entry is due
+    int64_t due = (entry->expires_ms + 999) / 1000;
+    if (due <= shard->tick) due = shard->tick + 1;
+    int64_t delta = due - shard->tick;
+    int level = 0;
+    while (level < SESSION_WHEEL_LEVELS - 1 && delta >= (int64_t)1 << (SESSION_WHEEL_BITS * (level + 1))) {
+        level++;
+    }
+    int64_t span = (int64_t)1 << (SESSION_WHEEL_BITS * SESSION_WHEEL_LEVELS);
+    if (delta >= span) due = shard->tick + span - 1;  // Re-filed each time the top level comes round
+    int slot = (int)((due >> (SESSION_WHEEL_BITS * level)) & (SESSION_WHEEL_SLOTS - 1));
+    session_entry** head = &shard->wheel[level][slot];
+    entry->timer_next = *head;
+    if (*head) (*head)->timer_link = &entry->timer_next;
+    entry->timer_link = head;
+    *head = entry;
+}
+
+static void entry_remove(session_shard* shard, session_entry* entry) {
+    session_entry** link = &shard->buckets[entry->hash & (uint64_t)(shard->bucket_count - 1)];
+    while (*link != entry) link = &(*link)->next;
+    *link = entry->next;
+    timer_unlink(entry);
+    shard->count--;
+    blob_release(entry->blob);
+    free(entry);
+}
+
+// Takes a slot's entries off the wheel, as a list through timer_next
+static session_entry* timer_take(session_entry** head) {
+    session_entry* list = *head;
+    *head = NULL;
+    for (session_entry* entry = list; entry; entry = entry->timer_next) {
+        entry->timer_link = NULL;
+    }
+    return list;
+}
+
+// Refiles a taken list, freeing what is due by now
+static void timer_refile(session_shard* shard, session_entry* list, int64_t now) {
+    while (list) {
+        session_entry* next = list->timer_next;
+        list->timer_next = NULL;
+        if (list->expires_ms <= now) {
+            entry_remove(shard, list);
+        } else {
+            timer_place(shard, list);
+        }
+        list = next;
+    }
+}
+
+// Turns the shard's wheel up to now, expiring what is due; with its lock held
+static void shard_advance(session_shard* shard, int64_t now) {
+    int64_t target = now / 1000;
+    if (target <= shard->tick) return;
+    if (shard->count == 0) {
+        shard->tick = target;
+        return;
+    }
+    if (target - shard->tick > SESSION_WHEEL_SLOTS * SESSION_WHEEL_SLOTS) {
+        // Idle for over an hour: refiling everything beats turning through
+        // every second since
+        shard->tick = target;
+        for (int level = 0; level < SESSION_WHEEL_LEVELS; level++) {
+            for (int slot = 0; slot < SESSION_WHEEL_SLOTS; slot++) {
+                timer_refile(shard, timer_take(&shard->wheel[level][slot]), now);
+            }
+        }
+        return;
+    }
+    while (shard->tick < target && shard->count > 0) {
+        int64_t tick = ++shard->tick;
+        // Where a level's lower bits roll over, its slot cascades into the
+        // levels below; highest first, so what it drops lands in place
+        for (int level = SESSION_WHEEL_LEVELS - 1; level > 0; level--) {
+            if ((tick & (((int64_t)1 << (SESSION_WHEEL_BITS * level)) - 1)) != 0) continue;
+            int slot = (int)((tick >> (SESSION_WHEEL_BITS * level)) & (SESSION_WHEEL_SLOTS - 1));
+            timer_refile(shard, timer_take(&shard->wheel[level][slot]), now);
+        }
+        timer_refile(shard, timer_take(&shard->wheel[0][tick & (SESSION_WHEEL_SLOTS - 1)]), now);
+    }
+    shard->tick = target;
+}
+
+// ============================================================================
+// TABLE
+// ============================================================================
+
+// The shard for id, locked and advanced to now
+static session_shard* shard_lock(uint64_t hash, int64_t now) {
+    pthread_once(&shards_once, shards_init);
+    session_shard* shard = &shards[hash >> 58 & (SESSION_SHARDS - 1)];
+    pthread_mutex_lock(&shard->lock);
+    shard_advance(shard, now);
+    return shard;
+}
+
+static session_entry* shard_find(session_shard* shard, const char* id, size_t length, uint64_t hash) {
+    if (shard->bucket_count == 0) return NULL;
+    for (session_entry* entry = shard->buckets[hash & (uint64_t)(shard->bucket_count - 1)]; entry; entry = entry->next) {
+        if (entry->hash == hash && entry->id_length == length && memcmp(entry->id, id, length) == 0) return entry;
+    }
+    return NULL;
+}
+
+static bool shard_grow(session_shard* shard) {
+    int count = shard->bucket_count ? shard->bucket_count * 2 : 16;
+    session_entry** buckets = calloc((size_t)count, sizeof(session_entry*));
+    if (!buckets) return false;
+    for (int i = 0; i < shard->bucket_count; i++) {
+        session_entry* entry = shard->buckets[i];
+        while (entry) {
+            session_entry* next = entry->next;
+            session_entry** bucket = &buckets[entry->hash & (uint64_t)(count - 1)];
+            entry->next = *bucket;
+            *bucket = entry;
+            entry = next;
+        }
+    }
+    free(shard->buckets);
+    shard->buckets = buckets;
+    shard->bucket_count = count;
+    return true;
+}
+
+// ============================================================================
+// NATIVES
+// ============================================================================
+
+static const char* string_bytes(ember_value value, size_t* length) {
+    if (value.type != EMBER_VAL_STRING || !value.as.obj_val) return NULL;
+    if (value.as.obj_val->type != OBJ_STRING) {
+        *length = strlen(value.as.string_val);
+        return value.as.string_val;
+    }
+    ember_string* string = AS_STRING(value);
+    *length = (size_t)string->length;
+    const char* bytes = ember_string_bytes(string);
+    return bytes ? bytes : ember_string_flatten(string);
+}
+
+static const char* session_id(ember_value value, size_t* length) {
+    const char* id = string_bytes(value, length);
+    return id && *length > 0 && *length <= SESSION_MAX_ID ? id : NULL;
+}
+
+// ttl in seconds from argv[index] if given, else the default; -1 if bad
+static int64_t session_ttl_ms(int argc, ember_value* argv, int index) {
+    if (argc <= index) return __atomic_load_n(&default_ttl_ms, __ATOMIC_RELAXED);
+    if (argv[index].type != EMBER_VAL_NUMBER) return -1;
+    double ttl = argv[index].as.number_val;
+    if (!(ttl > 0) || ttl > 1e12) return -1;
+    return (int64_t)(ttl * 1000);
+}
+
+// session_set(id, value [, ttl]): stores value under id for ttl seconds
+// (30 minutes by default), replacing what was there; true, or nil for a
+// bad argument or a value serialize cannot write
+ember_value ember_native_session_set(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc < 2 || argc > 3) return ember_make_nil();
+    size_t length;
+    const char* id = session_id(argv[0], &length);
+    int64_t ttl = session_ttl_ms(argc, argv, 2);
+    if (!id || ttl < 0) return ember_make_nil();
+
+    ember_value packed = ember_native_serialize(vm, 1, &argv[1]);
+    size_t size;
+    const char* bytes = string_bytes(packed, &size);
+    if (!bytes) return ember_make_nil();
+    session_blob* blob = malloc(sizeof(session_blob) + size);
+    if (!blob) return ember_make_nil();
+    blob->refs = 1;
+    blob->length = size;
+    memcpy(blob->bytes, bytes, size);
+
+    uint64_t hash = id_hash(id, length);
+    int64_t now = now_ms();
+    session_shard* shard = shard_lock(hash, now);
+    session_entry* entry = shard_find(shard, id, length, hash);
+    session_blob* old = NULL;
+    if (entry) {
+        old = entry->blob;
+        timer_unlink(entry);
+    } else {
+        if (shard->count < shard->bucket_count || shard_grow(shard)) {
+            entry = malloc(sizeof(session_entry) + length + 1);
+        }
+        if (!entry) {
+            pthread_mutex_unlock(&shard->lock);
+            free(blob);
+            return ember_make_nil();
+        }
+        memcpy(entry->id, id, length);
+        entry->id[length] = '\0';
+        entry->id_length = length;
+        entry->hash = hash;
+        entry->timer_link = NULL;
+        entry->timer_next = NULL;
+        session_entry** bucket = &shard->buckets[hash & (uint64_t)(shard->bucket_count - 1)];
+        entry->next = *bucket;
+        *bucket = entry;
+        shard->count++;
+    }
+    entry->blob = blob;
+    entry->expires_ms = now + ttl;
+    timer_place(shard, entry);
+    pthread_mutex_unlock(&shard->lock);
+    blob_release(old);
+    return ember_make_bool(true);
+}
+
+// session_get(id): the value stored under id, or nil if there is none or it
+// has expired
+ember_value ember_native_session_get(ember_vm* vm, int argc, ember_value* argv) {
+    size_t length;
+    const char* id = argc == 1 ? session_id(argv[0], &length) : NULL;
+    if (!id) return ember_make_nil();
+    uint64_t hash = id_hash(id, length);
+    int64_t now = now_ms();
+    session_shard* shard = shard_lock(hash, now);
+    session_entry* entry = shard_find(shard, id, length, hash);
+    session_blob* blob = NULL;
+    if (entry && entry->expires_ms > now) {
+        blob = entry->blob;
+        __atomic_add_fetch(&blob->refs, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    if (!blob) return ember_make_nil();
+    ember_value value = msgpack_decode(vm, blob->bytes, blob->length);
+    blob_release(blob);
+    return value;
+}
+
+// session_touch(id [, ttl]): moves id's deadline to ttl seconds from now
+// (the default if not given); true, false if there is no such session
+ember_value ember_native_session_touch(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    size_t length;
+    const char* id = argc >= 1 && argc <= 2 ? session_id(argv[0], &length) : NULL;
+    int64_t ttl = session_ttl_ms(argc, argv, 1);
+    if (!id || ttl < 0) return ember_make_nil();
+    uint64_t hash = id_hash(id, length);
+    int64_t now = now_ms();
+    session_shard* shard = shard_lock(hash, now);
+    session_entry* entry = shard_find(shard, id, length, hash);
+    bool found = entry && entry->expires_ms > now;
+    if (found) {
+        timer_unlink(entry);
+        entry->expires_ms = now + ttl;
+        timer_place(shard, entry);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return ember_make_bool(found);
+}
+
+// session_delete(id): true if a live session was removed
+ember_value ember_native_session_delete(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    size_t length;
+    const char* id = argc == 1 ? session_id(argv[0], &length) : NULL;
+    if (!id) return ember_make_nil();
+    uint64_t hash = id_hash(id, length);
+    int64_t now = now_ms();
+    session_shard* shard = shard_lock(hash, now);
+    session_entry* entry = shard_find(shard, id, length, hash);
+    bool found = entry && entry->expires_ms > now;
+    if (entry) entry_remove(shard, entry);
+    pthread_mutex_unlock(&shard->lock);
+    return ember_make_bool(found);
+}
+
+// session_count(): sessions held, after expiring what is due in every shard
+ember_value ember_native_session_count(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    (void)argv;
+    if (argc != 0) return ember_make_nil();
+    pthread_once(&shards_once, shards_init);
+    int64_t now = now_ms();
+    double total = 0;
+    for (int i = 0; i < SESSION_SHARDS; i++) {
+        pthread_mutex_lock(&shards[i].lock);
+        shard_advance(&shards[i], now);
+        total += shards[i].count;
+        pthread_mutex_unlock(&shards[i].lock);
+    }
+    return ember_make_number(total);
+}
+
+int ember_session_configure(double ttl_seconds) {
+    if (!(ttl_seconds > 0) || ttl_seconds > 1e12) return EMBER_ERROR_INVALID_PARAMETER;
+    __atomic_store_n(&default_ttl_ms, (int64_t)(ttl_seconds * 1000), __ATOMIC_RELAXED);
+    return EMBER_SUCCESS;
+}
+
+void ember_session_clear(void) {
+    pthread_once(&shards_once, shards_init);
+    for (int i = 0; i < SESSION_SHARDS; i++) {
+        session_shard* shard = &shards[i];
+        pthread_mutex_lock(&shard->lock);
+        for (int b = 0; b < shard->bucket_count; b++) {
+            session_entry* entry = shard->buckets[b];
+            while (entry) {
+                session_entry* next = entry->next;
+                blob_release(entry->blob);
+                free(entry);
+                entry = next;
+            }
+        }
+        free(shard->buckets);
+        shard->buckets = NULL;
+        shard->bucket_count = 0;
+        shard->count = 0;
+        memset(shard->wheel, 0, sizeof(shard->wheel));
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+void ember_register_session_native(ember_vm* vm) {
+    ember_register_func(vm, "session_set", ember_native_session_set);
+    ember_register_func(vm, "session_get", ember_native_session_get);
+    ember_register_func(vm, "session_touch", ember_native_session_touch);
+    ember_register_func(vm, "session_delete", ember_native_session_delete);
+    ember_register_func(vm, "session_count", ember_native_session_count);
+}
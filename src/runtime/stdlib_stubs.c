@@ -8,8 +8,7 @@
 // String utility functions 
 const char* ember_get_string_data(ember_value value) {
     if (value.type == EMBER_VAL_STRING) {
-        ember_string* str = AS_STRING(value);
-        return str->chars;
+        return ember_string_flatten(AS_STRING(value));
     }
     return NULL;
 }
@@ -233,7 +232,8 @@ ember_value ember_native_join(ember_vm* vm, int argc, ember_value* argv) {
         
         if (arr->elements[i].type == EMBER_VAL_STRING) {
             ember_string* str = AS_STRING(arr->elements[i]);
-            strncat(result, str->chars, str->length);
+            const char* chars = ember_string_flatten(str);
+            if (chars) strncat(result, chars, str->length);
         }
     }
     
@@ -11,6 +11,7 @@ ember_value ember_native_sha256_working(ember_vm* vm, int argc, ember_value* arg
 ember_value ember_native_sha512_working(ember_vm* vm, int argc, ember_value* argv);
 ember_value ember_native_secure_random_working(ember_vm* vm, int argc, ember_value* argv);
 ember_value ember_native_hmac_sha256_working(ember_vm* vm, int argc, ember_value* argv);
+ember_value ember_native_hmac_sha512_working(ember_vm* vm, int argc, ember_value* argv);
 
 // JSON functions (working implementations)
 ember_value ember_json_parse_working(ember_vm* vm, int argc, ember_value* argv);
@@ -0,0 +1,269 @@
+/**
+ * String builder for Ember: output assembled piece by piece in linear time
+ * string_builder / builder_append / builder_appendf / builder_length /
+ * builder_clear / builder_to_string, and the C API the other natives use
+ */
+
+#include "ember.h"
+#include "../vm.h"
+#include "value/value.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+
+#define BUILDER_MIN_CAPACITY 64
+#define BUILDER_MAX_LENGTH ((size_t)INT32_MAX)   // ember_string lengths are ints
+
+// ============================================================================
+// C API
+// ============================================================================
+
+bool string_builder_reserve(ember_string_builder* builder, size_t extra) {
+    if (extra > BUILDER_MAX_LENGTH - builder->length) return false;
+    size_t needed = builder->length + extra + 1;          // Room for the terminator
+    if (needed <= builder->capacity) return true;
+    // Doubling keeps appends amortized; one big reservation is taken exactly
+    size_t capacity = builder->capacity ? builder->capacity * 2 : BUILDER_MIN_CAPACITY;
+    if (capacity < needed) capacity = needed;
+    char* grown = realloc(builder->chars, capacity);
+    if (!grown) return false;
+    builder->chars = grown;
+    builder->capacity = capacity;
+    return true;
+}
+
+bool string_builder_append(ember_string_builder* builder, const char* chars, size_t length) {
+    if (!string_builder_reserve(builder, length)) return false;
+    memcpy(builder->chars + builder->length, chars, length);
+    builder->length += length;
+    builder->chars[builder->length] = '\0';
+    return true;
+}
+
+static bool builder_vappendf(ember_string_builder* builder, const char* format, va_list args) {
+    // Straight into the spare capacity; a second pass only when it is short
+    va_list retry;
+    va_copy(retry, args);
+    size_t room = builder->capacity > builder->length ? builder->capacity - builder->length : 0;
+    int size = vsnprintf(room ? builder->chars + builder->length : NULL, room, format, args);
+    bool ok = size >= 0;
+    if (ok && (size_t)size >= room) {
+        ok = string_builder_reserve(builder, (size_t)size) &&
+             vsnprintf(builder->chars + builder->length, (size_t)size + 1, format, retry) == size;
+    }
+    va_end(retry);
+    if (!ok) {
+        if (builder->chars) builder->chars[builder->length] = '\0';
+        return false;
+    }
+    builder->length += (size_t)size;
+    return true;
+}
+
+bool string_builder_appendf(ember_string_builder* builder, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    bool ok = builder_vappendf(builder, format, args);
+    va_end(args);
+    return ok;
+}
+
+ember_string* string_builder_take(ember_vm* vm, ember_string_builder* builder) {
+    ember_string* string;
+    if (builder->length <= EMBER_STRING_INLINE_MAX) {
+        // Short output lives inside the string header; keep the buffer
+        string = copy_string(vm, builder->chars ? builder->chars : "", (int)builder->length);
+        if (string) builder->length = 0;
+        return string;
+    }
+    char* chars = builder->chars;
+    int length = (int)builder->length;
+    if (builder->capacity - builder->length > builder->length / 4) {
+        // Give back most of the doubling slack; shrinking rarely moves
+        char* trimmed = realloc(chars, builder->length + 1);
+        if (trimmed) chars = trimmed;
+    }
+    builder->chars = NULL;
+    builder->length = 0;
+    builder->capacity = 0;
+    return allocate_string(vm, chars, length);
+}
+
+void string_builder_reset(ember_string_builder* builder) {
+    free(builder->chars);
+    builder->chars = NULL;
+    builder->length = 0;
+    builder->capacity = 0;
+}
+
+ember_value ember_make_string_builder(ember_vm* vm, size_t capacity) {
+    ember_string_builder* builder =
+        (ember_string_builder*)allocate_object(vm, sizeof(ember_string_builder), OBJ_STRING_BUILDER);
+    if (!builder) return ember_make_nil();
+    builder->chars = NULL;
+    builder->length = 0;
+    builder->capacity = 0;
+    if (capacity > 0 && !string_builder_reserve(builder, capacity)) {
+        // Left empty; the first append tries again
+        builder->capacity = 0;
+    }
+    ember_value value;
+    value.type = EMBER_VAL_STRING_BUILDER;
+    value.as.obj_val = (ember_object*)builder;
+    return value;
+}
+
+// ============================================================================
+// NATIVES
+// ============================================================================
+
+// What str() gives for value, appended
+static bool append_value(ember_string_builder* builder, ember_value value) {
+    switch (value.type) {
+        case EMBER_VAL_STRING: {
+            ember_string* string = AS_STRING(value);
+            const char* chars = ember_string_flatten(string);
+            return chars && string_builder_append(builder, chars, (size_t)string->length);
+        }
+        case EMBER_VAL_NUMBER:
+            return string_builder_appendf(builder, "%g", value.as.number_val);
+        case EMBER_VAL_BOOL:
+            return value.as.bool_val ? string_builder_append(builder, "true", 4)
+                                     : string_builder_append(builder, "false", 5);
+        case EMBER_VAL_NIL:
+            return string_builder_append(builder, "nil", 3);
+        case EMBER_VAL_STRING_BUILDER: {
+            // Appending a builder to itself reads what it had before
+            ember_string_builder* other = AS_STRING_BUILDER(value);
+            size_t length = other->length;
+            return string_builder_reserve(builder, length) &&
+                   string_builder_append(builder, other->chars ? other->chars : "", length);
+        }
+        default: {
+            const char* name = value_type_to_string(value.type);
+            return string_builder_append(builder, name, strlen(name));
+        }
+    }
+}
+
+// string_builder([capacity])
+ember_value ember_native_string_builder(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc > 1 || (argc == 1 && (argv[0].type != EMBER_VAL_NUMBER || argv[0].as.number_val < 0))) {
+        return ember_make_nil();
+    }
+    double capacity = argc == 1 ? argv[0].as.number_val : 0;
+    if (capacity > (double)BUILDER_MAX_LENGTH) return ember_make_nil();
+    return ember_make_string_builder(vm, (size_t)capacity);
+}
+
+// builder_append(builder, value...): the builder, for chaining, or nil
+ember_value ember_native_builder_append(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc < 1 || argv[0].type != EMBER_VAL_STRING_BUILDER) return ember_make_nil();
+    ember_string_builder* builder = AS_STRING_BUILDER(argv[0]);
+    for (int i = 1; i < argc; i++) {
+        if (!append_value(builder, argv[i])) return ember_make_nil();
+    }
+    return argv[0];
+}
+
+// builder_appendf(builder, format, value...): printf-style directives
+// (flags, width, precision) with %d %i %x %X %o %c taking an integer,
+// %f %e %g (and capitals) a number, %s any value as str() shows it, and %%
+ember_value ember_native_builder_appendf(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc < 2 || argv[0].type != EMBER_VAL_STRING_BUILDER || argv[1].type != EMBER_VAL_STRING) {
+        return ember_make_nil();
+    }
+    ember_string_builder* builder = AS_STRING_BUILDER(argv[0]);
+    const char* format = ember_string_flatten(AS_STRING(argv[1]));
+    if (!format) return ember_make_nil();
+    int next = 2;
+    while (*format) {
+        const char* percent = strchr(format, '%');
+        size_t run = percent ? (size_t)(percent - format) : strlen(format);
+        if (run && !string_builder_append(builder, format, run)) return ember_make_nil();
+        if (!percent) break;
+        if (percent[1] == '%') {
+            if (!string_builder_append(builder, "%", 1)) return ember_make_nil();
+            format = percent + 2;
+            continue;
+        }
+
+        // One directive, copied out without its length modifiers
+        char spec[32];
+        size_t at = 0;
+        const char* p = percent;
+        spec[at++] = *p++;
+        while (*p && strchr("-+ #0", *p) && at < 8) spec[at++] = *p++;
+        while (*p >= '0' && *p <= '9' && at < 16) spec[at++] = *p++;
+        if (*p == '.') {
+            spec[at++] = *p++;
+            while (*p >= '0' && *p <= '9' && at < 24) spec[at++] = *p++;
+        }
+        char conversion = *p;
+        if (!conversion || !strchr("diouxXcfFeEgGs", conversion) || next >= argc) return ember_make_nil();
+        ember_value value = argv[next++];
+        bool ok;
+        if (conversion == 's') {
+            ember_string_builder text = {0};
+            ok = append_value(&text, value);
+            spec[at++] = 's';
+            spec[at] = '\0';
+            ok = ok && string_builder_appendf(builder, spec, text.chars ? text.chars : "");
+            string_builder_reset(&text);
+        } else if (value.type != EMBER_VAL_NUMBER) {
+            ok = false;
+        } else if (strchr("fFeEgG", conversion)) {
+            spec[at++] = conversion;
+            spec[at] = '\0';
+            ok = string_builder_appendf(builder, spec, value.as.number_val);
+        } else if (conversion == 'c') {
+            spec[at++] = 'c';
+            spec[at] = '\0';
+            ok = string_builder_appendf(builder, spec, (int)value.as.number_val);
+        } else {
+            double number = value.as.number_val;
+            if (number != number || number >= 9.2e18 || number <= -9.2e18) return ember_make_nil();
+            spec[at++] = 'l';
+            spec[at++] = 'l';
+            spec[at++] = conversion == 'i' ? 'd' : conversion;
+            spec[at] = '\0';
+            ok = string_builder_appendf(builder, spec, (long long)number);
+        }
+        if (!ok) return ember_make_nil();
+        format = p + 1;
+    }
+    return argv[0];
+}
+
+// builder_length(builder): bytes appended so far
+ember_value ember_native_builder_length(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc != 1 || argv[0].type != EMBER_VAL_STRING_BUILDER) return ember_make_nil();
+    return ember_make_number((double)AS_STRING_BUILDER(argv[0])->length);
+}
+
+// builder_clear(builder): empties it, keeping the buffer for reuse
+ember_value ember_native_builder_clear(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc != 1 || argv[0].type != EMBER_VAL_STRING_BUILDER) return ember_make_nil();
+    ember_string_builder* builder = AS_STRING_BUILDER(argv[0]);
+    builder->length = 0;
+    if (builder->chars) builder->chars[0] = '\0';
+    return argv[0];
+}
+
+// builder_to_string(builder): the text, leaving the builder empty; long
+// output becomes the string's own buffer instead of being copied
+ember_value ember_native_builder_to_string(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 1 || argv[0].type != EMBER_VAL_STRING_BUILDER) return ember_make_nil();
+    ember_string* string = string_builder_take(vm, AS_STRING_BUILDER(argv[0]));
+    if (!string) return ember_make_nil();
+    ember_value value;
+    value.type = EMBER_VAL_STRING;
+    value.as.obj_val = (ember_object*)string;
+    return value;
+}
@@ -3,20 +3,27 @@
  * Consolidated from ember-native with simplified error handling
  */
 
+#define _GNU_SOURCE                  // memmem
 #include "ember.h"
+#include "value/value.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 
 // ember_get_string_value is provided globally by template_stubs.c
 extern const char* ember_get_string_value(ember_value value);
 
-// String length function - supports strings, arrays, and hash maps
+// String length function - supports strings, arrays, typed arrays and hash maps
 ember_value ember_native_len(ember_vm* vm, int argc, ember_value* argv) {
     (void)vm;
     if (argc != 1) return ember_make_nil();
     
     if (argv[0].type == EMBER_VAL_STRING) {
+        // GC strings know their length, ropes and NULs included
+        if (argv[0].as.obj_val && argv[0].as.obj_val->type == OBJ_STRING) {
+            return ember_make_number((double)AS_STRING(argv[0])->length);
+        }
         const char* str = ember_get_string_value(argv[0]);
         if (!str) return ember_make_number(0);
         return ember_make_number((double)strlen(str));
@@ -26,22 +33,58 @@ ember_value ember_native_len(ember_vm* vm, int argc, ember_value* argv) {
     } else if (argv[0].type == EMBER_VAL_HASH_MAP) {
         ember_hash_map* map = AS_HASH_MAP(argv[0]);
         return ember_make_number((double)map->length);
+    } else if (argv[0].type == EMBER_VAL_TYPED_ARRAY) {
+        return ember_make_number((double)AS_TYPED_ARRAY(argv[0])->length);
+    } else if (argv[0].type == EMBER_VAL_DEQUE) {
+        return ember_make_number((double)AS_DEQUE(argv[0])->length);
+    } else if (argv[0].type == EMBER_VAL_PRIORITY_QUEUE) {
+        return ember_make_number((double)AS_PRIORITY_QUEUE(argv[0])->length);
     } else {
         return ember_make_nil();
     }
 }
 
-// String substring function
+// The bytes and length of a string argument; slices are read in place, ropes
+// are flattened once and only legacy C strings need strlen
+static const char* string_bytes(ember_value value, size_t* length) {
+    if (value.type != EMBER_VAL_STRING || !value.as.obj_val) return NULL;
+    if (value.as.obj_val->type != OBJ_STRING) {
+        *length = strlen(value.as.string_val);
+        return value.as.string_val;
+    }
+    ember_string* string = AS_STRING(value);
+    *length = (size_t)string->length;
+    const char* bytes = ember_string_bytes(string);
+    return bytes ? bytes : ember_string_flatten(string);
+}
+
+// Where needle next occurs in haystack, or NULL. memchr finds candidates
+// for the first byte, which libc scans a vector at a time
+static const char* find_bytes(const char* haystack, size_t length, const char* needle, size_t needle_len) {
+    if (needle_len == 1) return memchr(haystack, needle[0], length);
+    return memmem(haystack, length, needle, needle_len);
+}
+
+// length bytes of a string argument from start: a slice of a GC string,
+// a copy of a legacy one
+static ember_string* string_part(ember_vm* vm, ember_value value, const char* bytes, int start, int length) {
+    if (value.as.obj_val->type != OBJ_STRING) return copy_string(vm, bytes + start, length);
+    return ember_string_slice(vm, AS_STRING(value), start, length);
+}
+
+// String substring function. Long results are slices sharing the input's
+// bytes (see ember_string_slice), so tokenizers do not copy every token
 ember_value ember_native_substr(ember_vm* vm, int argc, ember_value* argv) {
     if (argc < 2 || argc > 3) return ember_make_nil();
     if (argv[0].type != EMBER_VAL_STRING) return ember_make_nil();
     if (argv[1].type != EMBER_VAL_NUMBER) return ember_make_nil();
     
-    const char* str = ember_get_string_value(argv[0]);
+    size_t str_len;
+    const char* str = string_bytes(argv[0], &str_len);
     if (!str) return ember_make_nil();
     
     int start = (int)argv[1].as.number_val;
-    int len = strlen(str);
+    int len = (int)str_len;
     int substr_len = (argc == 3 && argv[2].type == EMBER_VAL_NUMBER) ? 
                      (int)argv[2].as.number_val : len - start;
     
@@ -49,103 +92,106 @@ ember_value ember_native_substr(ember_vm* vm, int argc, ember_value* argv) {
         return ember_make_string_gc(vm, "");
     }
     
-    if (start + substr_len > len) {
+    if (substr_len > len - start) {
         substr_len = len - start;
     }
     
-    char* result = malloc(substr_len + 1);
+    ember_string* result = string_part(vm, argv[0], str, start, substr_len);
     if (!result) return ember_make_nil();
-    
-    strncpy(result, str + start, substr_len);
-    result[substr_len] = '\0';
-    
-    ember_value ret_val = ember_make_string_gc(vm, result);
-    free(result);
+    ember_value ret_val;
+    ret_val.type = EMBER_VAL_STRING;
+    ret_val.as.obj_val = (ember_object*)result;
     return ret_val;
 }
 
-// String split function - simple implementation
+// String split function: every field between delimiters, empty ones
+// included, like "a,,b" -> ["a", "", "b"]; an empty delimiter splits into
+// characters (UTF-8 sequences)
 ember_value ember_native_split(ember_vm* vm, int argc, ember_value* argv) {
     if (argc != 2) return ember_make_nil();
-    if (argv[0].type != EMBER_VAL_STRING || argv[1].type != EMBER_VAL_STRING) {
-        return ember_make_nil();
-    }
-    
-    const char* str = ember_get_string_value(argv[0]);
-    const char* delimiter = ember_get_string_value(argv[1]);
-    if (!str || !delimiter) return ember_make_nil();
+    size_t str_len;
+    size_t delimiter_len;
+    const char* str = string_bytes(argv[0], &str_len);
+    const char* delimiter = string_bytes(argv[1], &delimiter_len);
+    if (!str || !delimiter || vm->stack_top >= EMBER_STACK_MAX) return ember_make_nil();
     
     ember_value array = ember_make_array(vm, 8);
+    if (array.type != EMBER_VAL_ARRAY) return ember_make_nil();
+    // Rooted while the fields allocate
+    vm->stack[vm->stack_top++] = array;
     ember_array* arr = AS_ARRAY(array);
     
-    size_t str_len = strlen(str);
-    char* str_copy = malloc(str_len + 1);
-    if (!str_copy) return ember_make_nil();
-    
-    strcpy(str_copy, str);
-    
-    char* token = strtok(str_copy, delimiter);
-    while (token != NULL && arr->length < arr->capacity) {
-        arr->elements[arr->length++] = ember_make_string_gc(vm, token);
-        token = strtok(NULL, delimiter);
+    const char* end = str + str_len;
+    const char* field = str;
+    while (field < end || (delimiter_len > 0 && field == end)) {
+        const char* stop;
+        const char* next;
+        if (delimiter_len == 0) {
+            stop = field + 1;
+            while (stop < end && ((unsigned char)*stop & 0xC0) == 0x80) stop++;
+            next = stop;
+        } else {
+            stop = find_bytes(field, (size_t)(end - field), delimiter, delimiter_len);
+            if (!stop) stop = end;
+            next = stop + delimiter_len;
+        }
+        ember_string* part = string_part(vm, argv[0], str, (int)(field - str), (int)(stop - field));
+        if (!part) {
+            vm->stack_top--;
+            return ember_make_nil();
+        }
+        ember_value value;
+        value.type = EMBER_VAL_STRING;
+        value.as.obj_val = (ember_object*)part;
+        array_push_with_vm(vm, arr, value);
+        if (stop == end) break;
+        field = next;
     }
     
-    free(str_copy);
+    vm->stack_top--;
     return array;
 }
 
-// String join function - join array elements with delimiter
+// String join function - join array elements with delimiter. Lengths come
+// from the strings themselves, so the output is sized in one pass and
+// written in another
 ember_value ember_native_join(ember_vm* vm, int argc, ember_value* argv) {
     if (argc != 2) return ember_make_nil();
-    if (argv[0].type != EMBER_VAL_ARRAY || argv[1].type != EMBER_VAL_STRING) {
+    size_t delimiter_len;
+    const char* delimiter = string_bytes(argv[1], &delimiter_len);
+    if (argv[0].type != EMBER_VAL_ARRAY || !delimiter) {
         return ember_make_nil();
     }
     
     ember_array* arr = AS_ARRAY(argv[0]);
-    const char* delimiter = ember_get_string_value(argv[1]);
-    if (!delimiter) return ember_make_nil();
-    
-    if (arr->length == 0) {
-        return ember_make_string_gc(vm, "");
-    }
-    
-    // Calculate total length needed
     size_t total_len = 0;
-    size_t delimiter_len = strlen(delimiter);
-    
     for (int i = 0; i < arr->length; i++) {
-        if (arr->elements[i].type == EMBER_VAL_STRING) {
-            const char* str = ember_get_string_value(arr->elements[i]);
-            if (str) {
-                total_len += strlen(str);
-                if (i < arr->length - 1) {
-                    total_len += delimiter_len;
-                }
-            }
+        size_t len;
+        if (string_bytes(arr->elements[i], &len)) {
+            total_len += len;
+            if (i < arr->length - 1) total_len += delimiter_len;
         }
     }
+    // ember_string lengths are ints
+    if (total_len > (size_t)INT32_MAX) return ember_make_nil();
     
-    // Security limit
-    if (total_len > 1048576) return ember_make_nil(); // 1MB max
-    
-    char* result = malloc(total_len + 1);
-    if (!result) return ember_make_nil();
-    
-    result[0] = '\0';
+    ember_string_builder builder = {0};
+    if (!string_builder_reserve(&builder, total_len)) return ember_make_nil();
     for (int i = 0; i < arr->length; i++) {
-        if (arr->elements[i].type == EMBER_VAL_STRING) {
-            const char* str = ember_get_string_value(arr->elements[i]);
-            if (str) {
-                strcat(result, str);
-                if (i < arr->length - 1) {
-                    strcat(result, delimiter);
-                }
-            }
-        }
+        size_t len;
+        const char* str = string_bytes(arr->elements[i], &len);
+        if (!str) continue;
+        // Within the reservation, so these only copy
+        string_builder_append(&builder, str, len);
+        if (i < arr->length - 1) string_builder_append(&builder, delimiter, delimiter_len);
     }
     
-    ember_value ret_val = ember_make_string_gc(vm, result);
-    free(result);
+    ember_string* result = string_builder_take(vm, &builder);
+    string_builder_reset(&builder);
+    if (!result) return ember_make_nil();
+    ember_value ret_val;
+    ret_val.type = EMBER_VAL_STRING;
+    ret_val.as.obj_val = (ember_object*)result;
     return ret_val;
 }
 
@@ -185,4 +231,271 @@ ember_value ember_native_ends_with(ember_vm* vm, int argc, ember_value* argv) {
     
     const char* start_pos = str + str_len - suffix_len;
     return ember_make_bool(strcmp(start_pos, suffix) == 0);
-}
\ No newline at end of file
+}
+// ============================================================================
+// REPLACE_ALL
+// ============================================================================
+
+// replace_all(text, needle, replacement) or replace_all(text, table): every
+// occurrence of each needle replaced, left to right, in one pass over text.
+// table maps needles to replacements: a map, a hash map, or an array of
+// [needle, replacement] pairs. Where needles overlap the one starting first
+// wins, and of those the longest; replaced text is never matched again.
+//
+// One needle is found with memmem. A table is compiled into an Aho-Corasick
+// automaton, a complete DFA over the byte classes the needles use, so the
+// text is read once however many needles there are instead of once per
+// needle.
+
+typedef struct {
+    const char* needle;
+    size_t needle_length;
+    const char* replacement;
+    size_t replacement_length;
+} replace_pair;
+
+typedef struct {
+    int32_t* next;               // state * class_count + class: the next state
+    int32_t* depth;              // Length of the prefix a state stands for
+    int32_t* match;              // Pair of the longest needle ending in the state, or -1
+    int state_count;
+    int class_count;
+    uint8_t classes[256];        // Byte to class; 0 for bytes in no needle
+    bool first[256];             // Bytes a needle starts with
+} replace_automaton;
+
+static void automaton_free(replace_automaton* automaton) {
+    free(automaton->next);
+    free(automaton->depth);
+    free(automaton->match);
+}
+
+static bool automaton_build(replace_automaton* automaton, const replace_pair* pairs, int pair_count) {
+    memset(automaton, 0, sizeof(*automaton));
+    size_t max_states = 1;
+    automaton->class_count = 1;
+    for (int i = 0; i < pair_count; i++) {
+        max_states += pairs[i].needle_length;
+        automaton->first[(unsigned char)pairs[i].needle[0]] = true;
+        for (size_t j = 0; j < pairs[i].needle_length; j++) {
+            unsigned char c = (unsigned char)pairs[i].needle[j];
+            if (!automaton->classes[c]) automaton->classes[c] = (uint8_t)automaton->class_count++;
+        }
+    }
+    size_t classes = (size_t)automaton->class_count;
+    if (max_states > (size_t)INT32_MAX / classes) return false;
+    automaton->next = malloc(max_states * classes * sizeof(int32_t));
+    automaton->depth = malloc(max_states * sizeof(int32_t));
+    automaton->match = malloc(max_states * sizeof(int32_t));
+    int32_t* fail = malloc(max_states * sizeof(int32_t));
+    int32_t* queue = malloc(max_states * sizeof(int32_t));
+    if (!automaton->next || !automaton->depth || !automaton->match || !fail || !queue) {
+        free(fail);
+        free(queue);
+        automaton_free(automaton);
+        return false;
+    }
+
+    // The trie; -1 marks a missing edge until the links fill it in
+    int32_t* next = automaton->next;
+    memset(next, 0xff, classes * sizeof(int32_t));
+    automaton->depth[0] = 0;
+    automaton->match[0] = -1;
+    automaton->state_count = 1;
+    for (int i = 0; i < pair_count; i++) {
+        int32_t state = 0;
+        for (size_t j = 0; j < pairs[i].needle_length; j++) {
+            size_t edge = (size_t)state * classes + automaton->classes[(unsigned char)pairs[i].needle[j]];
+            if (next[edge] < 0) {
+                int32_t added = automaton->state_count++;
+                memset(&next[(size_t)added * classes], 0xff, classes * sizeof(int32_t));
+                automaton->depth[added] = (int32_t)(j + 1);
+                automaton->match[added] = -1;
+                next[edge] = added;
+            }
+            state = next[edge];
+        }
+        // A repeated needle keeps its first replacement
+        if (automaton->match[state] < 0) automaton->match[state] = i;
+    }
+
+    // Breadth first, each state's failure link is the longest proper suffix
+    // that is also a prefix; missing edges take the failure state's edge,
+    // and a state with no needle of its own reports its failure state's
+    int head = 0, tail = 0;
+    for (size_t c = 0; c < classes; c++) {
+        int32_t child = next[c];
+        if (child < 0) {
+            next[c] = 0;
+        } else {
+            fail[child] = 0;
+            queue[tail++] = child;
+        }
+    }
+    while (head < tail) {
+        int32_t state = queue[head++];
+        if (automaton->match[state] < 0) automaton->match[state] = automaton->match[fail[state]];
+        for (size_t c = 0; c < classes; c++) {
+            size_t edge = (size_t)state * classes + c;
+            int32_t fallback = next[(size_t)fail[state] * classes + c];
+            if (next[edge] < 0) {
+                next[edge] = fallback;
+            } else {
+                fail[next[edge]] = fallback;
+                queue[tail++] = next[edge];
+            }
+        }
+    }
+    free(fail);
+    free(queue);
+    return true;
+}
+
+static bool replace_one(ember_string_builder* out, const char* text, size_t length, const replace_pair* pair) {
+    size_t copied = 0;
+    const char* found;
+    while ((found = find_bytes(text + copied, length - copied, pair->needle, pair->needle_length))) {
+        size_t at = (size_t)(found - text);
+        if (!string_builder_append(out, text + copied, at - copied) ||
+            !string_builder_append(out, pair->replacement, pair->replacement_length)) {
+            return false;
+        }
+        copied = at + pair->needle_length;
+    }
+    return string_builder_append(out, text + copied, length - copied);
+}
+
+static bool replace_many(ember_string_builder* out, const char* text, size_t length,
+                         const replace_pair* pairs, const replace_automaton* automaton) {
+    const int32_t* next = automaton->next;
+    size_t classes = (size_t)automaton->class_count;
+    size_t copied = 0;
+    int32_t state = 0;
+    // The best match seen: earliest start, then longest
+    int best = -1;
+    size_t best_start = 0;
+    size_t i = 0;
+    for (;;) {
+        for (; i < length; i++) {
+            if (state == 0 && best < 0) {
+                // Nothing pending: skip to a byte some needle starts with
+                while (i < length && !automaton->first[(unsigned char)text[i]]) i++;
+                if (i == length) break;
+            }
+            state = next[(size_t)state * classes + automaton->classes[(unsigned char)text[i]]];
+            int found = automaton->match[state];
+            if (found >= 0) {
+                size_t start = i + 1 - pairs[found].needle_length;
+                if (best < 0 || start < best_start ||
+                    (start == best_start && pairs[found].needle_length > pairs[best].needle_length)) {
+                    best = found;
+                    best_start = start;
+                }
+            }
+            // Once the text still being matched starts past the best match,
+            // no earlier or longer one can turn up
+            if (best >= 0 && i + 1 - (size_t)automaton->depth[state] > best_start) break;
+        }
+        if (best < 0) break;
+        // Replace the best match and go on right after it
+        if (!string_builder_append(out, text + copied, best_start - copied) ||
+            !string_builder_append(out, pairs[best].replacement, pairs[best].replacement_length)) {
+            return false;
+        }
+        copied = best_start + pairs[best].needle_length;
+        i = copied;
+        state = 0;
+        best = -1;
+    }
+    return string_builder_append(out, text + copied, length - copied);
+}
+
+static bool replace_pair_from(replace_pair* pair, ember_value needle, ember_value replacement) {
+    pair->needle = string_bytes(needle, &pair->needle_length);
+    pair->replacement = string_bytes(replacement, &pair->replacement_length);
+    return pair->needle && pair->replacement && pair->needle_length > 0;
+}
+
+// The pairs of a replace_all table, or NULL (with *count -1) if it is not one
+static replace_pair* replace_table(ember_value table, int* count) {
+    int capacity = 0;
+    switch (table.type) {
+        case EMBER_VAL_MAP: capacity = AS_MAP(table)->size; break;
+        case EMBER_VAL_HASH_MAP: capacity = AS_HASH_MAP(table)->length; break;
+        case EMBER_VAL_ARRAY: capacity = AS_ARRAY(table)->length; break;
+        default: *count = -1; return NULL;
+    }
+    *count = 0;
+    replace_pair* pairs = malloc((size_t)(capacity > 0 ? capacity : 1) * sizeof(replace_pair));
+    if (!pairs) {
+        *count = -1;
+        return NULL;
+    }
+    bool ok = true;
+    if (table.type == EMBER_VAL_MAP) {
+        ember_map* map = AS_MAP(table);
+        for (int i = 0; i < map->count && ok; i++) {
+            if (!map->entries[i].is_occupied) continue;
+            ok = replace_pair_from(&pairs[(*count)++], map->entries[i].key, map->entries[i].value);
+        }
+    } else if (table.type == EMBER_VAL_HASH_MAP) {
+        ember_hash_map* map = AS_HASH_MAP(table);
+        for (int i = 0; i < map->capacity && ok; i++) {
+            if (!map->entries[i].is_occupied) continue;
+            ok = replace_pair_from(&pairs[(*count)++], map->entries[i].key, map->entries[i].value);
+        }
+    } else {
+        ember_array* array = AS_ARRAY(table);
+        for (int i = 0; i < array->length && ok; i++) {
+            ember_value entry = array->elements[i];
+            ok = entry.type == EMBER_VAL_ARRAY && AS_ARRAY(entry)->length == 2 &&
+                 replace_pair_from(&pairs[(*count)++], AS_ARRAY(entry)->elements[0], AS_ARRAY(entry)->elements[1]);
+        }
+    }
+    if (!ok) {
+        free(pairs);
+        *count = -1;
+        return NULL;
+    }
+    return pairs;
+}
+
+ember_value ember_replace_all(ember_vm* vm, int argc, ember_value* argv) {
+    size_t length;
+    const char* text = argc == 2 || argc == 3 ? string_bytes(argv[0], &length) : NULL;
+    if (!text) return ember_make_nil();
+
+    replace_pair single;
+    replace_pair* pairs = &single;
+    int pair_count = 1;
+    if (argc == 3) {
+        if (!replace_pair_from(&single, argv[1], argv[2])) return ember_make_nil();
+    } else {
+        pairs = replace_table(argv[1], &pair_count);
+        if (pair_count < 0) return ember_make_nil();
+    }
+
+    ember_string_builder out = {0};
+    bool ok = string_builder_reserve(&out, length);
+    if (ok && pair_count == 0) {
+        ok = string_builder_append(&out, text, length);
+    } else if (ok && pair_count == 1) {
+        ok = replace_one(&out, text, length, pairs);
+    } else if (ok) {
+        replace_automaton automaton;
+        ok = automaton_build(&automaton, pairs, pair_count);
+        if (ok) {
+            ok = replace_many(&out, text, length, pairs, &automaton);
+            automaton_free(&automaton);
+        }
+    }
+    if (pairs != &single) free(pairs);
+    // ember_string lengths are ints
+    ember_string* result = ok && out.length <= (size_t)INT32_MAX ? string_builder_take(vm, &out) : NULL;
+    string_builder_reset(&out);
+    if (!result) return ember_make_nil();
+    ember_value value;
+    value.type = EMBER_VAL_STRING;
+    value.as.obj_val = (ember_object*)result;
+    return value;
+}
@@ -0,0 +1,1076 @@
+/**
+ * Template engine: template_render / template_render_file / html_render /
+ * html_render_file, and the html_escape / url_encode kernels.
+ *
+ * A template is compiled once into a flat program of ops: copy a run of
+ * literal text, write the value at a path, and the jumps that implement
+ * sections. Programs are kept in the VM's cache (vm->template_cache),
+ * inline templates by their text and files by path, modification time and
+ * size, so a page rendered on every request is parsed only when its file
+ * changes. Rendering walks the ops into one string builder, reserved up
+ * front at the size the program's last output had, and allocates nothing
+ * on the GC heap until the result string is made.
+ *
+ * Syntax, a subset of Mustache / Handlebars:
+ *   {{ path }}                  The value; HTML-escaped by the html_ natives
+ *   {{{ path }}}, {{& path }}   The value, never escaped
+ *   {{#if path}} .. {{else}} .. {{/if}}
+ *   {{#unless path}} .. {{else}} .. {{/unless}}
+ *   {{#each path}} .. {{else}} .. {{/each}}
+ *   {{! comment }}
+ * A path is names and array indexes joined by dots (user.tags.0), looked
+ * up in the innermost each item first and then outward to the data. this
+ * (or .) is the current item, @index its position and @key its key when
+ * iterating a map. each walks arrays, maps and hash maps; sections treat
+ * nil, false, 0, "" and empty collections as false.
+ */
+
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../vm.h"
+#include "value/value.h"
+#include "template_stubs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TEMPLATE_CACHE_SIZE 64
+#define TEMPLATE_MAX_DEPTH 32                // Nested sections
+#define TEMPLATE_MAX_SIZE ((size_t)INT32_MAX)
+
+typedef enum {
+    TEMPLATE_TEXT,          // Copy text[a, a + b)
+    TEMPLATE_VALUE,         // Write paths[a], escaped when b is set and the render escapes
+    TEMPLATE_IF,            // paths[a]: false jumps to b (negated for unless)
+    TEMPLATE_UNLESS,
+    TEMPLATE_JUMP,          // To b
+    TEMPLATE_EACH,          // paths[a]: enter the loop, or jump to b if it is empty
+    TEMPLATE_NEXT           // Next item and back to b, or leave the loop
+} template_opcode;
+
+typedef struct {
+    uint8_t opcode;
+    int a;
+    int b;
+} template_op;
+
+typedef enum {
+    SEGMENT_KEY,            // Field or key: key
+    SEGMENT_INDEX,          // Array element, or a key for maps
+    SEGMENT_THIS,
+    SEGMENT_AT_INDEX,
+    SEGMENT_AT_KEY
+} template_segment_kind;
+
+// key is a string made for lookups only: never on the GC heap, never stored
+typedef struct {
+    template_segment_kind kind;
+    int index;
+    ember_string* key;
+} template_segment;
+
+typedef struct {
+    int first;              // Into segments
+    int count;
+} template_path;
+
+typedef struct template_program {
+    char* text;             // The template's source; literal ops point into it
+    size_t length;
+    uint32_t hash;          // Of text, for inline templates
+    char* path;             // File templates: path, mtime and size at compile time
+    struct timespec mtime;
+    off_t size;
+    ino_t inode;
+    template_op* ops;
+    int op_count;
+    template_path* paths;
+    int path_count;
+    template_segment* segments;
+    int segment_count;
+    size_t literal_bytes;   // Text every render copies at least
+    size_t last_output;     // Length of the last render, the next one's first guess
+    uint64_t last_used;     // Cache clock at the last lookup
+} template_program;
+
+typedef struct ember_template_cache {
+    template_program* entries[TEMPLATE_CACHE_SIZE];
+    int count;
+    uint64_t clock;
+} ember_template_cache;
+
+// ============================================================================
+// COMPILER
+// ============================================================================
+
+typedef struct {
+    template_program* program;
+    int op_capacity;
+    int path_capacity;
+    int segment_capacity;
+    int open[TEMPLATE_MAX_DEPTH];   // Ops of the sections not yet closed
+    int else_jump[TEMPLATE_MAX_DEPTH];  // Their {{else}} jump, or -1
+    int depth;
+} template_compiler;
+
+static void template_program_free(template_program* program) {
+    if (!program) return;
+    for (int i = 0; i < program->segment_count; i++) {
+        free(program->segments[i].key);
+    }
+    free(program->segments);
+    free(program->paths);
+    free(program->ops);
+    free(program->path);
+    free(program->text);
+    free(program);
+}
+
+static int emit(template_compiler* compiler, template_opcode opcode, int a, int b) {
+    template_program* program = compiler->program;
+    if (program->op_count == compiler->op_capacity) {
+        int capacity = compiler->op_capacity ? compiler->op_capacity * 2 : 16;
+        template_op* grown = realloc(program->ops, (size_t)capacity * sizeof(template_op));
+        if (!grown) return -1;
+        program->ops = grown;
+        compiler->op_capacity = capacity;
+    }
+    template_op* op = &program->ops[program->op_count];
+    op->opcode = (uint8_t)opcode;
+    op->a = a;
+    op->b = b;
+    return program->op_count++;
+}
+
+static int add_segment(template_compiler* compiler, const char* name, int length) {
+    template_program* program = compiler->program;
+    if (program->segment_count == compiler->segment_capacity) {
+        int capacity = compiler->segment_capacity ? compiler->segment_capacity * 2 : 16;
+        template_segment* grown = realloc(program->segments, (size_t)capacity * sizeof(template_segment));
+        if (!grown) return 0;
+        program->segments = grown;
+        compiler->segment_capacity = capacity;
+    }
+    template_segment* segment = &program->segments[program->segment_count];
+    segment->key = NULL;
+    segment->index = -1;
+    if ((length == 4 && memcmp(name, "this", 4) == 0) || (length == 1 && name[0] == '.')) {
+        segment->kind = SEGMENT_THIS;
+    } else if (length == 6 && memcmp(name, "@index", 6) == 0) {
+        segment->kind = SEGMENT_AT_INDEX;
+    } else if (length == 4 && memcmp(name, "@key", 4) == 0) {
+        segment->kind = SEGMENT_AT_KEY;
+    } else {
+        if (name[0] == '@') return 0;
+        int index = 0;
+        int digits = 0;
+        while (digits < length && name[digits] >= '0' && name[digits] <= '9' && index < 100000000) {
+            index = index * 10 + (name[digits] - '0');
+            digits++;
+        }
+        segment->kind = digits == length ? SEGMENT_INDEX : SEGMENT_KEY;
+        segment->index = digits == length ? index : -1;
+        // The same key serves maps with string keys and instances' fields
+        ember_string* key = calloc(1, sizeof(ember_string) + (size_t)length + 1);
+        if (!key) return 0;
+        key->obj.type = OBJ_STRING;
+        key->chars = key->inline_chars;
+        memcpy(key->chars, name, (size_t)length);
+        key->length = length;
+        key->hash = hash_string_chars(key->chars, length);
+        key->is_inline = 1;
+        segment->key = key;
+    }
+    program->segment_count++;
+    return 1;
+}
+
+// The path in tag[0, length), added to the program; its index or -1
+static int compile_path(template_compiler* compiler, const char* tag, int length) {
+    template_program* program = compiler->program;
+    if (length == 0) return -1;
+    if (program->path_count == compiler->path_capacity) {
+        int capacity = compiler->path_capacity ? compiler->path_capacity * 2 : 16;
+        template_path* grown = realloc(program->paths, (size_t)capacity * sizeof(template_path));
+        if (!grown) return -1;
+        program->paths = grown;
+        compiler->path_capacity = capacity;
+    }
+    template_path* path = &program->paths[program->path_count];
+    path->first = program->segment_count;
+    path->count = 0;
+    if (length == 1 && tag[0] == '.') {
+        if (!add_segment(compiler, tag, 1)) return -1;
+        path->count = 1;
+        return program->path_count++;
+    }
+    int start = 0;
+    for (int i = 0; i <= length; i++) {
+        if (i < length && tag[i] != '.') {
+            char c = tag[i];
+            int name_char = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                            c == '_' || c == '-' || c == '$' || (c == '@' && i == start);
+            if (!name_char) return -1;
+            continue;
+        }
+        if (i == start || !add_segment(compiler, tag + start, i - start)) return -1;
+        // this, @index and @key only begin a path
+        if (path->count > 0 && program->segments[program->segment_count - 1].kind > SEGMENT_INDEX) return -1;
+        path->count++;
+        start = i + 1;
+    }
+    return program->path_count++;
+}
+
+static const char* trim(const char* start, const char* end, int* length) {
+    while (start < end && (*start == ' ' || *start == '\t' || *start == '\n' || *start == '\r')) start++;
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n' || end[-1] == '\r')) end--;
+    *length = (int)(end - start);
+    return start;
+}
+
+static int word_is(const char* tag, int length, const char* word) {
+    int word_length = (int)strlen(word);
+    return length >= word_length && memcmp(tag, word, (size_t)word_length) == 0 &&
+           (length == word_length || tag[word_length] == ' ' || tag[word_length] == '\t');
+}
+
+// One {{...}} tag, body trimmed; 0 if it is malformed or out of place
+static int compile_tag(template_compiler* compiler, const char* tag, int length, int raw) {
+    template_program* program = compiler->program;
+    if (raw) {
+        int path = compile_path(compiler, tag, length);
+        return path >= 0 && emit(compiler, TEMPLATE_VALUE, path, 0) >= 0;
+    }
+    if (length == 0) return 0;
+    int body_length;
+    const char* body = trim(tag + 1, tag + length, &body_length);
+    switch (tag[0]) {
+        case '!':
+            return 1;
+        case '&': {
+            int path = compile_path(compiler, body, body_length);
+            return path >= 0 && emit(compiler, TEMPLATE_VALUE, path, 0) >= 0;
+        }
+        case '#': {
+            template_opcode opcode;
+            int word;
+            if (word_is(body, body_length, "if")) {
+                opcode = TEMPLATE_IF;
+                word = 2;
+            } else if (word_is(body, body_length, "unless")) {
+                opcode = TEMPLATE_UNLESS;
+                word = 6;
+            } else if (word_is(body, body_length, "each")) {
+                opcode = TEMPLATE_EACH;
+                word = 4;
+            } else {
+                return 0;
+            }
+            if (compiler->depth == TEMPLATE_MAX_DEPTH) return 0;
+            int path_length;
+            const char* path_text = trim(body + word, body + body_length, &path_length);
+            int path = compile_path(compiler, path_text, path_length);
+            int op = path >= 0 ? emit(compiler, opcode, path, -1) : -1;
+            if (op < 0) return 0;
+            compiler->open[compiler->depth] = op;
+            compiler->else_jump[compiler->depth] = -1;
+            compiler->depth++;
+            return 1;
+        }
+        case '/': {
+            if (compiler->depth == 0) return 0;
+            int open = compiler->open[compiler->depth - 1];
+            template_opcode opcode = (template_opcode)program->ops[open].opcode;
+            const char* word = opcode == TEMPLATE_EACH ? "each" : opcode == TEMPLATE_IF ? "if" : "unless";
+            if (body_length != (int)strlen(word) || memcmp(body, word, (size_t)body_length) != 0) return 0;
+            int else_jump = compiler->else_jump[compiler->depth - 1];
+            compiler->depth--;
+            if (opcode == TEMPLATE_EACH && else_jump < 0) {
+                if (emit(compiler, TEMPLATE_NEXT, 0, open + 1) < 0) return 0;
+            }
+            if (else_jump >= 0) {
+                program->ops[else_jump].b = program->op_count;
+            } else {
+                program->ops[open].b = program->op_count;
+            }
+            return 1;
+        }
+        default:
+            break;
+    }
+    if (length == 4 && memcmp(tag, "else", 4) == 0) {
+        if (compiler->depth == 0 || compiler->else_jump[compiler->depth - 1] >= 0) return 0;
+        int open = compiler->open[compiler->depth - 1];
+        if (program->ops[open].opcode == TEMPLATE_EACH && emit(compiler, TEMPLATE_NEXT, 0, open + 1) < 0) {
+            return 0;
+        }
+        int jump = emit(compiler, TEMPLATE_JUMP, 0, -1);
+        if (jump < 0) return 0;
+        compiler->else_jump[compiler->depth - 1] = jump;
+        program->ops[open].b = program->op_count;
+        return 1;
+    }
+    int path = compile_path(compiler, tag, length);
+    return path >= 0 && emit(compiler, TEMPLATE_VALUE, path, 1) >= 0;
+}
+
+// Compiles text, which the program takes over; NULL (text freed) if the
+// template is malformed
+static template_program* template_compile(char* text, size_t length) {
+    template_program* program = calloc(1, sizeof(template_program));
+    if (!program) {
+        free(text);
+        return NULL;
+    }
+    program->text = text;
+    program->length = length;
+    template_compiler compiler = {0};
+    compiler.program = program;
+
+    const char* p = text;
+    const char* end = text + length;
+    while (p < end) {
+        const char* open = memmem(p, (size_t)(end - p), "{{", 2);
+        const char* literal_end = open ? open : end;
+        if (literal_end > p) {
+            if (emit(&compiler, TEMPLATE_TEXT, (int)(p - text), (int)(literal_end - p)) < 0) goto fail;
+            program->literal_bytes += (size_t)(literal_end - p);
+        }
+        if (!open) break;
+        int raw = open + 2 < end && open[2] == '{';
+        const char* body = open + (raw ? 3 : 2);
+        const char* close = memmem(body, (size_t)(end - body), raw ? "}}}" : "}}", raw ? 3 : 2);
+        if (!close) goto fail;
+        int tag_length;
+        const char* tag = trim(body, close, &tag_length);
+        if (!compile_tag(&compiler, tag, tag_length, raw)) goto fail;
+        p = close + (raw ? 3 : 2);
+    }
+    if (compiler.depth != 0) goto fail;
+    program->last_output = program->literal_bytes;
+    return program;
+
+fail:
+    template_program_free(program);
+    return NULL;
+}
+
+// ============================================================================
+// CACHE
+// ============================================================================
+
+static ember_template_cache* template_cache_for(ember_vm* vm) {
+    if (!vm->template_cache) {
+        vm->template_cache = calloc(1, sizeof(ember_template_cache));
+    }
+    if (vm->template_cache) vm->template_cache->clock++;
+    return vm->template_cache;
+}
+
+// Adds program to the cache, evicting the least recently used entry. The
+// program stays valid only until the next insertion
+static void template_cache_insert(ember_template_cache* cache, template_program* program) {
+    int slot = cache->count;
+    if (slot == TEMPLATE_CACHE_SIZE) {
+        slot = 0;
+        for (int i = 1; i < cache->count; i++) {
+            if (cache->entries[i]->last_used < cache->entries[slot]->last_used) slot = i;
+        }
+        template_program_free(cache->entries[slot]);
+    } else {
+        cache->count++;
+    }
+    program->last_used = cache->clock;
+    cache->entries[slot] = program;
+}
+
+// The program for inline template text. Owned by the cache, or by the
+// caller (*owned set) when there is no cache
+static template_program* template_for_text(ember_vm* vm, const char* text, int length, int* owned) {
+    ember_template_cache* cache = template_cache_for(vm);
+    uint32_t hash = hash_string_chars(text, length);
+    *owned = 0;
+    if (cache) {
+        for (int i = 0; i < cache->count; i++) {
+            template_program* program = cache->entries[i];
+            if (!program->path && program->hash == hash && program->length == (size_t)length &&
+                memcmp(program->text, text, (size_t)length) == 0) {
+                program->last_used = cache->clock;
+                return program;
+            }
+        }
+    }
+    char* copy = malloc((size_t)length + 1);
+    if (!copy) return NULL;
+    memcpy(copy, text, (size_t)length);
+    copy[length] = '\0';
+    template_program* program = template_compile(copy, (size_t)length);
+    if (!program) return NULL;
+    program->hash = hash;
+    if (cache) {
+        template_cache_insert(cache, program);
+    } else {
+        *owned = 1;
+    }
+    return program;
+}
+
+static int same_file(const template_program* program, const struct stat* st) {
+    return program->mtime.tv_sec == st->st_mtim.tv_sec && program->mtime.tv_nsec == st->st_mtim.tv_nsec &&
+           program->size == st->st_size && program->inode == st->st_ino;
+}
+
+// Reads the whole of fd, size bytes expected; NULL on error
+static char* read_template(int fd, size_t size, size_t* length) {
+    char* text = malloc(size + 1);
+    if (!text) return NULL;
+    size_t got = 0;
+    while (got < size) {
+        ssize_t n = read(fd, text + got, size - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    text[got] = '\0';
+    *length = got;
+    return text;
+}
+
+// The program for the template file at path, compiled again if the file
+// changed since it was cached. Ownership as template_for_text
+static template_program* template_for_file(ember_vm* vm, const char* path, int* owned) {
+    *owned = 0;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (size_t)st.st_size > TEMPLATE_MAX_SIZE) {
+        close(fd);
+        return NULL;
+    }
+
+    ember_template_cache* cache = template_cache_for(vm);
+    int stale = -1;
+    if (cache) {
+        for (int i = 0; i < cache->count; i++) {
+            template_program* program = cache->entries[i];
+            if (program->path && strcmp(program->path, path) == 0) {
+                if (same_file(program, &st)) {
+                    close(fd);
+                    program->last_used = cache->clock;
+                    return program;
+                }
+                stale = i;
+                break;
+            }
+        }
+    }
+
+    size_t length;
+    char* text = read_template(fd, (size_t)st.st_size, &length);
+    close(fd);
+    if (!text) return NULL;
+    template_program* program = template_compile(text, length);
+    if (!program) return NULL;
+    program->path = strdup(path);
+    if (!program->path) {
+        template_program_free(program);
+        return NULL;
+    }
+    program->mtime = st.st_mtim;
+    program->size = st.st_size;
+    program->inode = st.st_ino;
+    if (!cache) {
+        *owned = 1;
+    } else if (stale >= 0) {
+        // Replaced in place: the old one's output size is still a fair guess
+        program->last_output = cache->entries[stale]->last_output;
+        template_program_free(cache->entries[stale]);
+        program->last_used = cache->clock;
+        cache->entries[stale] = program;
+    } else {
+        template_cache_insert(cache, program);
+    }
+    return program;
+}
+
+void template_cache_free(ember_vm* vm) {
+    ember_template_cache* cache = vm->template_cache;
+    if (!cache) return;
+    for (int i = 0; i < cache->count; i++) {
+        template_program_free(cache->entries[i]);
+    }
+    free(cache);
+    vm->template_cache = NULL;
+}
+
+// ============================================================================
+// ESCAPING
+// ============================================================================
+
+// Both escapes find the bytes that need one a vector at a time, as
+// json_simple.c's string encoder does, and size their output exactly before
+// writing it: one counting scan, then clean runs copied with memcpy between
+// the escapes. Text needing no escape is returned or appended as it is.
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TEMPLATE_SIMD 1
+#define TEMPLATE_LANE 32
+
+typedef __m256i template_vec;
+static inline template_vec tpl_load(const char* at) { return _mm256_loadu_si256((const __m256i*)at); }
+static inline template_vec tpl_eq(template_vec v, char c) { return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)); }
+static inline template_vec tpl_or(template_vec a, template_vec b) { return _mm256_or_si256(a, b); }
+// Bytes in [lo, hi], compared unsigned
+static inline template_vec tpl_range(template_vec v, char lo, char hi) {
+    template_vec shifted = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8((char)(hi - lo))), shifted);
+}
+static inline uint64_t tpl_bits(template_vec m) { return (uint32_t)_mm256_movemask_epi8(m); }
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define TEMPLATE_SIMD 1
+#define TEMPLATE_LANE 16
+
+typedef __m128i template_vec;
+static inline template_vec tpl_load(const char* at) { return _mm_loadu_si128((const __m128i*)at); }
+static inline template_vec tpl_eq(template_vec v, char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); }
+static inline template_vec tpl_or(template_vec a, template_vec b) { return _mm_or_si128(a, b); }
+static inline template_vec tpl_range(template_vec v, char lo, char hi) {
+    template_vec shifted = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8((char)(hi - lo))), shifted);
+}
+static inline uint64_t tpl_bits(template_vec m) { return (uint16_t)_mm_movemask_epi8(m); }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define TEMPLATE_SIMD 1
+#define TEMPLATE_LANE 16
+
+typedef uint8x16_t template_vec;
+static inline template_vec tpl_load(const char* at) { return vld1q_u8((const uint8_t*)at); }
+static inline template_vec tpl_eq(template_vec v, char c) { return vceqq_u8(v, vdupq_n_u8((uint8_t)c)); }
+static inline template_vec tpl_or(template_vec a, template_vec b) { return vorrq_u8(a, b); }
+static inline template_vec tpl_range(template_vec v, char lo, char hi) {
+    return vcleq_u8(vsubq_u8(v, vdupq_n_u8((uint8_t)lo)), vdupq_n_u8((uint8_t)(hi - lo)));
+}
+// One bit per byte: weight each lane by its bit and add across halves
+static inline uint64_t tpl_bits(template_vec m) {
+    static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t weighted = vandq_u8(m, vld1q_u8(weights));
+    return (uint64_t)vaddv_u8(vget_low_u8(weighted)) | (uint64_t)vaddv_u8(vget_high_u8(weighted)) << 8;
+}
+#else
+#define TEMPLATE_SIMD 0
+#endif
+
+#define TEMPLATE_LANE_MASK(lane) ((lane) == 64 ? ~0ULL : (1ULL << (lane)) - 1)
+
+// Entity for an HTML byte, or NULL for one written as it is
+static inline const char* html_entity(char c, size_t* length) {
+    switch (c) {
+        case '&': *length = 5; return "&amp;";
+        case '<': *length = 4; return "&lt;";
+        case '>': *length = 4; return "&gt;";
+        case '"': *length = 6; return "&quot;";
+        case '\'': *length = 5; return "&#39;";
+        default: *length = 0; return NULL;
+    }
+}
+
+// Bytes html_escape adds to chars
+static size_t html_escape_extra(const char* chars, size_t length) {
+    size_t extra = 0;
+    size_t i = 0;
+#if TEMPLATE_SIMD
+    for (; i + TEMPLATE_LANE <= length; i += TEMPLATE_LANE) {
+        template_vec v = tpl_load(chars + i);
+        uint64_t amp = tpl_bits(tpl_eq(v, '&'));
+        uint64_t angle = tpl_bits(tpl_or(tpl_eq(v, '<'), tpl_eq(v, '>')));
+        uint64_t quote = tpl_bits(tpl_eq(v, '"'));
+        uint64_t apos = tpl_bits(tpl_eq(v, '\''));
+        if ((amp | angle | quote | apos) == 0) continue;
+        extra += 4 * (size_t)__builtin_popcountll(amp | apos) + 3 * (size_t)__builtin_popcountll(angle) +
+                 5 * (size_t)__builtin_popcountll(quote);
+    }
+#endif
+    for (; i < length; i++) {
+        size_t entity_length = 0;
+        if (html_entity(chars[i], &entity_length)) extra += entity_length - 1;
+    }
+    return extra;
+}
+
+// Bytes from `from` that html_escape copies as they are
+static size_t html_plain_run(const char* from, size_t length) {
+    size_t i = 0;
+#if TEMPLATE_SIMD
+    for (; i + TEMPLATE_LANE <= length; i += TEMPLATE_LANE) {
+        template_vec v = tpl_load(from + i);
+        uint64_t stops = tpl_bits(tpl_or(tpl_or(tpl_eq(v, '&'), tpl_eq(v, '<')),
+                                         tpl_or(tpl_or(tpl_eq(v, '>'), tpl_eq(v, '"')), tpl_eq(v, '\''))));
+        if (stops) return i + (size_t)__builtin_ctzll(stops);
+    }
+#endif
+    size_t entity_length = 0;
+    while (i < length && !html_entity(from[i], &entity_length)) i++;
+    return i;
+}
+
+// Writes chars escaped into dest, which has room for exactly that
+static void html_escape_into(char* dest, const char* chars, size_t length) {
+    for (size_t at = 0; at < length;) {
+        size_t run = html_plain_run(chars + at, length - at);
+        memcpy(dest, chars + at, run);
+        dest += run;
+        at += run;
+        if (at == length) break;
+        size_t entity_length = 0;
+        const char* entity = html_entity(chars[at], &entity_length);
+        if (!entity) {
+            // The plain run stops only at an entity; copy anything else as is
+            *dest++ = chars[at++];
+            continue;
+        }
+        at++;
+        memcpy(dest, entity, entity_length);
+        dest += entity_length;
+    }
+}
+
+// RFC 3986 unreserved bytes, which url_encode leaves alone
+static inline int url_unreserved(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           c == '-' || c == '_' || c == '.' || c == '~';
+}
+
+#if TEMPLATE_SIMD
+static inline uint64_t url_stop_bits(template_vec v) {
+    template_vec plain = tpl_or(tpl_or(tpl_range(v, 'a', 'z'), tpl_range(v, 'A', 'Z')),
+                                tpl_or(tpl_range(v, '0', '9'),
+                                       tpl_or(tpl_or(tpl_eq(v, '-'), tpl_eq(v, '_')),
+                                              tpl_or(tpl_eq(v, '.'), tpl_eq(v, '~')))));
+    return ~tpl_bits(plain) & TEMPLATE_LANE_MASK(TEMPLATE_LANE);
+}
+#endif
+
+// Bytes url_encode turns into %XX
+static size_t url_encode_count(const char* chars, size_t length) {
+    size_t count = 0;
+    size_t i = 0;
+#if TEMPLATE_SIMD
+    for (; i + TEMPLATE_LANE <= length; i += TEMPLATE_LANE) {
+        count += (size_t)__builtin_popcountll(url_stop_bits(tpl_load(chars + i)));
+    }
+#endif
+    for (; i < length; i++) {
+        if (!url_unreserved((unsigned char)chars[i])) count++;
+    }
+    return count;
+}
+
+static size_t url_plain_run(const char* from, size_t length) {
+    size_t i = 0;
+#if TEMPLATE_SIMD
+    for (; i + TEMPLATE_LANE <= length; i += TEMPLATE_LANE) {
+        uint64_t stops = url_stop_bits(tpl_load(from + i));
+        if (stops) return i + (size_t)__builtin_ctzll(stops);
+    }
+#endif
+    while (i < length && url_unreserved((unsigned char)from[i])) i++;
+    return i;
+}
+
+static void url_encode_into(char* dest, const char* chars, size_t length) {
+    static const char hex[] = "0123456789ABCDEF";
+    for (size_t at = 0; at < length;) {
+        size_t run = url_plain_run(chars + at, length - at);
+        memcpy(dest, chars + at, run);
+        dest += run;
+        at += run;
+        if (at == length) break;
+        unsigned char c = (unsigned char)chars[at++];
+        dest[0] = '%';
+        dest[1] = hex[c >> 4];
+        dest[2] = hex[c & 15];
+        dest += 3;
+    }
+}
+
+// ============================================================================
+// RENDERER
+// ============================================================================
+
+// An each loop in progress
+typedef struct {
+    ember_value collection;
+    int position;           // Array index or entry slot
+    int index;              // Items visited, for @index
+    ember_value item;
+    ember_value key;
+} template_loop;
+
+typedef struct {
+    const template_program* program;
+    ember_value data;
+    template_loop loops[TEMPLATE_MAX_DEPTH];
+    int loop_count;
+    int escape;
+} template_render_state;
+
+static ember_value string_value(ember_string* string) {
+    ember_value value;
+    value.type = EMBER_VAL_STRING;
+    value.as.obj_val = (ember_object*)string;
+    return value;
+}
+
+// value[segment], or *found cleared
+static ember_value lookup(ember_value value, const template_segment* segment, int* found) {
+    ember_value result = ember_make_nil();
+    *found = 0;
+    switch (value.type) {
+        case EMBER_VAL_ARRAY:
+            if (!value.as.obj_val) break;
+            if (segment->kind == SEGMENT_INDEX && segment->index < AS_ARRAY(value)->length) {
+                *found = 1;
+                return AS_ARRAY(value)->elements[segment->index];
+            }
+            if (segment->key->length == 6 && memcmp(segment->key->chars, "length", 6) == 0) {
+                *found = 1;
+                return ember_make_number(AS_ARRAY(value)->length);
+            }
+            break;
+        case EMBER_VAL_STRING:
+            if (value.as.obj_val && segment->key->length == 6 && memcmp(segment->key->chars, "length", 6) == 0) {
+                *found = 1;
+                return ember_make_number(AS_STRING(value)->length);
+            }
+            break;
+        case EMBER_VAL_HASH_MAP: {
+            ember_value key = string_value(segment->key);
+            if (value.as.obj_val && hash_map_has_key(AS_HASH_MAP(value), key)) {
+                *found = 1;
+                return hash_map_get(AS_HASH_MAP(value), key);
+            }
+            break;
+        }
+        case EMBER_VAL_MAP: {
+            ember_value key = string_value(segment->key);
+            if (value.as.obj_val && map_has(AS_MAP(value), key)) {
+                *found = 1;
+                return map_get(AS_MAP(value), key);
+            }
+            if (segment->kind == SEGMENT_INDEX && map_has(AS_MAP(value), ember_make_number(segment->index))) {
+                *found = 1;
+                return map_get(AS_MAP(value), ember_make_number(segment->index));
+            }
+            break;
+        }
+        case EMBER_VAL_INSTANCE:
+            if (value.as.obj_val) {
+                *found = ember_instance_get_field(AS_INSTANCE(value), string_value(segment->key), &result);
+            }
+            break;
+        default:
+            break;
+    }
+    return result;
+}
+
+static ember_value resolve(const template_render_state* state, int path_index) {
+    const template_path* path = &state->program->paths[path_index];
+    const template_segment* segment = &state->program->segments[path->first];
+    const template_loop* loop = state->loop_count ? &state->loops[state->loop_count - 1] : NULL;
+    ember_value value = ember_make_nil();
+    int found = 0;
+    switch (segment->kind) {
+        case SEGMENT_THIS:
+            value = loop ? loop->item : state->data;
+            break;
+        case SEGMENT_AT_INDEX:
+            value = loop ? ember_make_number(loop->index) : ember_make_nil();
+            break;
+        case SEGMENT_AT_KEY:
+            value = loop ? loop->key : ember_make_nil();
+            break;
+        default:
+            // Innermost item first, out to the data
+            for (int i = state->loop_count - 1; i >= 0 && !found; i--) {
+                value = lookup(state->loops[i].item, segment, &found);
+            }
+            if (!found) value = lookup(state->data, segment, &found);
+            if (!found) return ember_make_nil();
+            break;
+    }
+    for (int i = 1; i < path->count; i++) {
+        value = lookup(value, &segment[i], &found);
+        if (!found) return ember_make_nil();
+    }
+    return value;
+}
+
+static int template_truthy(ember_value value) {
+    switch (value.type) {
+        case EMBER_VAL_NIL: return 0;
+        case EMBER_VAL_BOOL: return value.as.bool_val;
+        case EMBER_VAL_NUMBER: return value.as.number_val != 0;
+        case EMBER_VAL_STRING: return value.as.obj_val && AS_STRING(value)->length > 0;
+        case EMBER_VAL_ARRAY: return value.as.obj_val && AS_ARRAY(value)->length > 0;
+        case EMBER_VAL_HASH_MAP: return value.as.obj_val && AS_HASH_MAP(value)->length > 0;
+        case EMBER_VAL_MAP: return value.as.obj_val && AS_MAP(value)->size > 0;
+        default: return 1;
+    }
+}
+
+// Steps loop to its next item; 0 when there are no more
+static int loop_advance(template_loop* loop) {
+    ember_value collection = loop->collection;
+    if (collection.type != EMBER_VAL_ARRAY && collection.type != EMBER_VAL_MAP &&
+        collection.type != EMBER_VAL_HASH_MAP) {
+        return 0;
+    }
+    if (!collection.as.obj_val) return 0;
+    switch (collection.type) {
+        case EMBER_VAL_ARRAY: {
+            ember_array* array = AS_ARRAY(collection);
+            if (loop->position >= array->length) return 0;
+            loop->item = array->elements[loop->position];
+            loop->key = ember_make_number(loop->position);
+            loop->position++;
+            return 1;
+        }
+        case EMBER_VAL_MAP: {
+            ember_map* map = AS_MAP(collection);
+            while (loop->position < map->count && !map->entries[loop->position].is_occupied) loop->position++;
+            if (loop->position >= map->count) return 0;
+            loop->item = map->entries[loop->position].value;
+            loop->key = map->entries[loop->position].key;
+            loop->position++;
+            return 1;
+        }
+        case EMBER_VAL_HASH_MAP: {
+            ember_hash_map* map = AS_HASH_MAP(collection);
+            while (loop->position < map->capacity && !map->entries[loop->position].is_occupied) loop->position++;
+            if (loop->position >= map->capacity) return 0;
+            loop->item = map->entries[loop->position].value;
+            loop->key = map->entries[loop->position].key;
+            loop->position++;
+            return 1;
+        }
+        default:
+            return 0;
+    }
+}
+
+// Copies chars into out with html_escape's rules, sized exactly first
+static bool append_escaped(ember_string_builder* out, const char* chars, size_t length) {
+    size_t size = length + html_escape_extra(chars, length);
+    if (size == length) return string_builder_append(out, chars, length);
+    if (!string_builder_reserve(out, size)) return false;
+    html_escape_into(out->chars + out->length, chars, length);
+    out->length += size;
+    out->chars[out->length] = '\0';
+    return true;
+}
+
+// value as str() shows it; nil writes nothing
+static bool append_value(ember_string_builder* out, ember_value value, int escape) {
+    char scratch[32];
+    const char* chars;
+    size_t length;
+    switch (value.type) {
+        case EMBER_VAL_NIL:
+            return true;
+        case EMBER_VAL_STRING:
+            if (!value.as.obj_val) return true;
+            chars = ember_string_flatten(AS_STRING(value));
+            if (!chars) return false;
+            length = (size_t)AS_STRING(value)->length;
+            break;
+        case EMBER_VAL_NUMBER:
+            length = (size_t)snprintf(scratch, sizeof(scratch), "%g", value.as.number_val);
+            chars = scratch;
+            break;
+        case EMBER_VAL_BOOL:
+            chars = value.as.bool_val ? "true" : "false";
+            length = strlen(chars);
+            break;
+        default:
+            chars = value_type_to_string(value.type);
+            length = strlen(chars);
+            break;
+    }
+    return escape ? append_escaped(out, chars, length) : string_builder_append(out, chars, length);
+}
+
+static bool template_execute(template_render_state* state, ember_string_builder* out) {
+    const template_program* program = state->program;
+    const template_op* ops = program->ops;
+    int pc = 0;
+    while (pc < program->op_count) {
+        const template_op* op = &ops[pc++];
+        switch ((template_opcode)op->opcode) {
+            case TEMPLATE_TEXT:
+                if (!string_builder_append(out, program->text + op->a, (size_t)op->b)) return false;
+                break;
+            case TEMPLATE_VALUE:
+                if (!append_value(out, resolve(state, op->a), op->b && state->escape)) return false;
+                break;
+            case TEMPLATE_IF:
+            case TEMPLATE_UNLESS: {
+                int truthy = template_truthy(resolve(state, op->a));
+                if (truthy != (op->opcode == TEMPLATE_IF)) pc = op->b;
+                break;
+            }
+            case TEMPLATE_JUMP:
+                pc = op->b;
+                break;
+            case TEMPLATE_EACH: {
+                template_loop* loop = &state->loops[state->loop_count];
+                loop->collection = resolve(state, op->a);
+                loop->position = 0;
+                loop->index = 0;
+                if (!loop_advance(loop)) {
+                    pc = op->b;
+                } else {
+                    state->loop_count++;
+                }
+                break;
+            }
+            case TEMPLATE_NEXT: {
+                template_loop* loop = &state->loops[state->loop_count - 1];
+                loop->index++;
+                if (loop_advance(loop)) {
+                    pc = op->b;
+                } else {
+                    state->loop_count--;
+                }
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+// The rendered string, or nil if out of memory
+static ember_value template_run(ember_vm* vm, template_program* program, ember_value data, int escape) {
+    template_render_state state;
+    state.program = program;
+    state.data = data;
+    state.loop_count = 0;
+    state.escape = escape;
+
+    // Sized for the last output, so a steady page renders without growing
+    ember_string_builder out = {0};
+    size_t guess = program->last_output > program->literal_bytes ? program->last_output : program->literal_bytes;
+    if (!string_builder_reserve(&out, guess + guess / 8 + 16) || !template_execute(&state, &out)) {
+        string_builder_reset(&out);
+        return ember_make_nil();
+    }
+    program->last_output = out.length;
+    ember_string* string = string_builder_take(vm, &out);
+    string_builder_reset(&out);
+    return string ? string_value(string) : ember_make_nil();
+}
+
+// ============================================================================
+// NATIVES
+// ============================================================================
+
+static ember_value render_text(ember_vm* vm, int argc, ember_value* argv, int escape) {
+    if (argc < 1 || argc > 2 || argv[0].type != EMBER_VAL_STRING || !argv[0].as.obj_val) {
+        return ember_make_nil();
+    }
+    const char* text = ember_string_flatten(AS_STRING(argv[0]));
+    if (!text) return ember_make_nil();
+    int owned;
+    template_program* program = template_for_text(vm, text, AS_STRING(argv[0])->length, &owned);
+    if (!program) return ember_make_nil();
+    ember_value result = template_run(vm, program, argc == 2 ? argv[1] : ember_make_nil(), escape);
+    if (owned) template_program_free(program);
+    return result;
+}
+
+static ember_value render_file(ember_vm* vm, int argc, ember_value* argv, int escape) {
+    if (argc < 1 || argc > 2 || argv[0].type != EMBER_VAL_STRING || !argv[0].as.obj_val) {
+        return ember_make_nil();
+    }
+    const char* path = AS_CSTRING(argv[0]);
+    if (!path) return ember_make_nil();
+    int owned;
+    template_program* program = template_for_file(vm, path, &owned);
+    if (!program) return ember_make_nil();
+    ember_value result = template_run(vm, program, argc == 2 ? argv[1] : ember_make_nil(), escape);
+    if (owned) template_program_free(program);
+    return result;
+}
+
+// template_render(template, data): the text with data filled in, or nil if
+// the template is malformed. Values are written as they are
+ember_value ember_template_render(ember_vm* vm, int argc, ember_value* argv) {
+    return render_text(vm, argc, argv, 0);
+}
+
+// template_render_file(path, data): as template_render, the template read
+// from path; nil if it cannot be read
+ember_value ember_template_render_file(ember_vm* vm, int argc, ember_value* argv) {
+    return render_file(vm, argc, argv, 0);
+}
+
+// html_render(template, data): as template_render, with {{ }} values
+// HTML-escaped
+ember_value ember_html_render(ember_vm* vm, int argc, ember_value* argv) {
+    return render_text(vm, argc, argv, 1);
+}
+
+// html_render_file(path, data)
+ember_value ember_html_render_file(ember_vm* vm, int argc, ember_value* argv) {
+    return render_file(vm, argc, argv, 1);
+}
+
+// The string in argv[0] escaped by size_extra / write, or the string itself
+// when nothing needs escaping
+static ember_value escape_native(ember_vm* vm, int argc, ember_value* argv,
+                                 size_t (*size_extra)(const char*, size_t),
+                                 void (*write)(char*, const char*, size_t)) {
+    if (argc != 1 || argv[0].type != EMBER_VAL_STRING || !argv[0].as.obj_val) {
+        return ember_make_nil();
+    }
+    ember_string* input = AS_STRING(argv[0]);
+    const char* chars = ember_string_flatten(input);
+    if (!chars) return ember_make_nil();
+    size_t length = (size_t)input->length;
+    size_t extra = size_extra(chars, length);
+    if (extra == 0) return argv[0];
+    if (extra > TEMPLATE_MAX_SIZE - length) return ember_make_nil();
+
+    ember_string_builder out = {0};
+    if (!string_builder_reserve(&out, length + extra)) return ember_make_nil();
+    write(out.chars, chars, length);
+    out.length = length + extra;
+    out.chars[out.length] = '\0';
+    ember_string* string = string_builder_take(vm, &out);
+    string_builder_reset(&out);
+    return string ? string_value(string) : ember_make_nil();
+}
+
+static size_t url_encode_extra(const char* chars, size_t length) {
+    return 2 * url_encode_count(chars, length);
+}
+
+// html_escape(text): & < > " ' replaced by entities
+ember_value ember_html_escape(ember_vm* vm, int argc, ember_value* argv) {
+    return escape_native(vm, argc, argv, html_escape_extra, html_escape_into);
+}
+
+// url_encode(text): every byte but A-Z a-z 0-9 - _ . ~ as %XX, like
+// JavaScript's encodeURIComponent
+ember_value ember_url_encode(ember_vm* vm, int argc, ember_value* argv) {
+    return escape_native(vm, argc, argv, url_encode_extra, url_encode_into);
+}
@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 // External test suite declarations
 extern void run_collections_tests(test_runner* runner);
@@ -134,8 +135,6 @@ TEST_SUITE(error_handling_suite) {
 }
 
 int main(int argc, char* argv[]) {
-    (void)argc; (void)argv; // Suppress unused parameter warnings
-    
     printf("Ember Testing Framework v2.0.3\\n");
     printf("Comprehensive test suite for new language features\\n\\n");
     
@@ -150,6 +149,20 @@ int main(int argc, char* argv[]) {
     runner->verbose = 1;
     runner->stop_on_failure = 0;
     
+    // -j N runs tests on N worker threads (0: one per CPU), --timeout MS
+    // limits each test and --fail-fast stops after the first failure. Set
+    // before suites are added, which decides how their tests run
+    for (int i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) && i + 1 < argc) {
+            runner->jobs = atoi(argv[++i]);
+            if (runner->jobs <= 0) runner->jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+            runner->timeout_ms = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--fail-fast") == 0) {
+            runner->stop_on_failure = 1;
+        }
+    }
+    
     // Add test suites
     run_core_tests(runner);
     run_error_handling_suite_tests(runner);
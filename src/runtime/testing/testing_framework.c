@@ -1,10 +1,11 @@
-#define _POSIX_C_SOURCE 199309L
+#define _POSIX_C_SOURCE 200809L
 #include "testing_framework.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <math.h>
+#include <pthread.h>
 
 // Color codes for output
 #define COLOR_RED     "\x1b[31m"
@@ -26,9 +27,8 @@ static char* custom_strdup(const char* s) {
     return dup;
 }
 
-// Global test context for assertions
-static test_case* current_test = NULL;
-static test_suite* current_suite = NULL;
+// Test context for assertions, per thread for parallel runs
+static __thread test_case* current_test = NULL;
 
 // Helper function to get current time in milliseconds
 static double get_time_ms(void) {
@@ -53,6 +53,8 @@ test_runner* test_runner_create(void) {
     runner->total_duration_ms = 0.0;
     runner->verbose = 1;
     runner->stop_on_failure = 0;
+    runner->jobs = 1;
+    runner->timeout_ms = 0.0;
     
     return runner;
 }
@@ -97,34 +99,14 @@ test_suite* test_runner_add_suite(test_runner* runner, const char* name) {
     suite->skipped = 0;
     suite->errors = 0;
     suite->total_duration_ms = 0.0;
+    suite->deferred = runner->jobs > 1 || runner->timeout_ms > 0;
     
     return suite;
 }
 
-void test_suite_add_test(test_suite* suite, const char* name, test_function func, ember_vm* vm) {
-    if (!suite || !name || !func || !vm) return;
-    
-    // Expand tests array if needed
-    if (suite->test_count >= suite->test_capacity) {
-        int new_capacity = suite->test_capacity == 0 ? 8 : suite->test_capacity * 2;
-        test_case* new_tests = realloc(suite->tests, sizeof(test_case) * new_capacity);
-        if (!new_tests) return;
-        
-        suite->tests = new_tests;
-        suite->test_capacity = new_capacity;
-    }
-    
-    test_case* test = &suite->tests[suite->test_count++];
-    test->name = custom_strdup(name);
-    test->status = TEST_PASS;
-    test->message = NULL;
-    test->duration_ms = 0.0;
-    test->line = 0;
-    test->file = NULL;
-    
-    // Set global context for assertions
+// Run one test on vm, recording its outcome in test
+static void run_test_case(test_case* test, test_function func, ember_vm* vm) {
     current_test = test;
-    current_suite = suite;
     
     // Run the test
     double start_time = get_time_ms();
@@ -141,6 +123,7 @@ void test_suite_add_test(test_suite* suite, const char* name, test_function func
     // Check if VM has error after test
     if (ember_vm_has_error(vm)) {
         test->status = TEST_ERROR;
+        free(test->message);
         ember_error* error = ember_vm_get_error(vm);
         if (error && error->message[0] != '\0') {
             test->message = custom_strdup(error->message);
@@ -155,7 +138,11 @@ void test_suite_add_test(test_suite* suite, const char* name, test_function func
     double end_time = get_time_ms();
     test->duration_ms = end_time - start_time;
     
-    // Update suite statistics
+    current_test = NULL;
+}
+
+// Update suite statistics
+static void suite_record(test_suite* suite, const test_case* test) {
     switch (test->status) {
         case TEST_PASS:
             suite->passed++;
@@ -172,10 +159,269 @@ void test_suite_add_test(test_suite* suite, const char* name, test_function func
     }
     
     suite->total_duration_ms += test->duration_ms;
+}
+
+void test_suite_add_test(test_suite* suite, const char* name, test_function func, ember_vm* vm) {
+    if (!suite || !name || !func || (!vm && !suite->deferred)) return;
     
-    // Clear global context
-    current_test = NULL;
-    current_suite = NULL;
+    // Expand tests array if needed
+    if (suite->test_count >= suite->test_capacity) {
+        int new_capacity = suite->test_capacity == 0 ? 8 : suite->test_capacity * 2;
+        test_case* new_tests = realloc(suite->tests, sizeof(test_case) * new_capacity);
+        if (!new_tests) return;
+        
+        suite->tests = new_tests;
+        suite->test_capacity = new_capacity;
+    }
+    
+    test_case* test = &suite->tests[suite->test_count++];
+    test->name = custom_strdup(name);
+    test->status = TEST_PASS;
+    test->message = NULL;
+    test->duration_ms = 0.0;
+    test->line = 0;
+    test->file = NULL;
+    test->func = NULL;
+    
+    if (suite->deferred) {
+        test->func = func;
+        return;
+    }
+    
+    run_test_case(test, func, vm);
+    suite_record(suite, test);
+}
+
+// ============================================================================
+// PARALLEL RUNS
+// ============================================================================
+//
+// Deferred tests are queued in the order they were added and workers take
+// the next one from a shared index, each on its own VM. A worker writes its
+// result back into the test's own slot, so the report reads the same however
+// the tests were spread. A test past the timeout cannot be stopped: the
+// watchdog reports it, leaves its worker to finish (or not) on its own and
+// starts another in its place. The run state is shared with such workers
+// and freed by whoever lets go of it last.
+
+typedef struct parallel_run parallel_run;
+
+typedef struct {
+    parallel_run* run;
+    pthread_t thread;
+    test_case* test;          // Running now, NULL between tests
+    double started_ms;
+    int abandoned;            // Timed out: the worker owns itself and drops its result
+} parallel_worker;
+
+struct parallel_run {
+    test_case** tests;
+    int count;
+    int next;
+    int fail_fast;
+    int stop;                 // A test failed with fail_fast set
+    int active;               // Workers the watchdog waits for
+    int refs;                 // The runner and every worker thread
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+};
+
+static void parallel_run_release(parallel_run* run) {
+    pthread_mutex_lock(&run->lock);
+    int last = --run->refs == 0;
+    pthread_mutex_unlock(&run->lock);
+    if (!last) return;
+    pthread_mutex_destroy(&run->lock);
+    pthread_cond_destroy(&run->changed);
+    free(run->tests);
+    free(run);
+}
+
+static void* parallel_worker_main(void* arg) {
+    parallel_worker* worker = arg;
+    parallel_run* run = worker->run;
+    ember_vm* vm = ember_pool_get_vm();
+    int pooled = vm != NULL;
+    if (!vm) vm = ember_new_vm();
+    
+    pthread_mutex_lock(&run->lock);
+    while (vm && !worker->abandoned && !run->stop && run->next < run->count) {
+        test_case* test = run->tests[run->next++];
+        test_function func = test->func;
+        worker->test = test;
+        worker->started_ms = get_time_ms();
+        pthread_mutex_unlock(&run->lock);
+        
+        test_case result = {0};
+        result.status = TEST_PASS;
+        run_test_case(&result, func, vm);
+        
+        pthread_mutex_lock(&run->lock);
+        if (worker->abandoned) {
+            free(result.message);
+            break;
+        }
+        test->status = result.status;
+        test->message = result.message;
+        test->duration_ms = result.duration_ms;
+        test->func = NULL;
+        worker->test = NULL;
+        if (run->fail_fast && (result.status == TEST_FAIL || result.status == TEST_ERROR)) {
+            run->stop = 1;
+        }
+    }
+    int abandoned = worker->abandoned;
+    if (!abandoned) run->active--;
+    pthread_cond_broadcast(&run->changed);
+    pthread_mutex_unlock(&run->lock);
+    
+    if (vm) {
+        if (pooled) {
+            ember_pool_release_vm(vm);
+        } else {
+            ember_free_vm(vm);
+        }
+    }
+    if (abandoned) free(worker);
+    parallel_run_release(run);
+    return NULL;
+}
+
+// Called with run->lock held
+static parallel_worker* parallel_worker_start(parallel_run* run) {
+    parallel_worker* worker = calloc(1, sizeof(parallel_worker));
+    if (!worker) return NULL;
+    worker->run = run;
+    run->refs++;
+    run->active++;
+    if (pthread_create(&worker->thread, NULL, parallel_worker_main, worker) != 0) {
+        run->refs--;
+        run->active--;
+        free(worker);
+        return NULL;
+    }
+    return worker;
+}
+
+// Called with run->lock held. Reports tests over the limit and replaces
+// their workers; returns how long until the next one could time out
+static double parallel_check_timeouts(parallel_run* run, parallel_worker** workers, int jobs,
+                                      double timeout_ms) {
+    double now = get_time_ms();
+    double wait_ms = timeout_ms;
+    for (int i = 0; i < jobs; i++) {
+        parallel_worker* worker = workers[i];
+        if (!worker || !worker->test) continue;
+        double left = worker->started_ms + timeout_ms - now;
+        if (left > 0) {
+            if (left < wait_ms) wait_ms = left;
+            continue;
+        }
+        
+        test_case* test = worker->test;
+        char message[128];
+        snprintf(message, sizeof(message), "Timed out after %.0fms", timeout_ms);
+        test->status = TEST_ERROR;
+        test->message = custom_strdup(message);
+        test->duration_ms = now - worker->started_ms;
+        test->func = NULL;
+        if (run->fail_fast) run->stop = 1;
+        
+        worker->abandoned = 1;
+        run->active--;
+        pthread_detach(worker->thread);
+        workers[i] = NULL;
+        if (!run->stop && run->next < run->count) {
+            workers[i] = parallel_worker_start(run);
+        }
+    }
+    return wait_ms;
+}
+
+static void run_deferred_tests(test_runner* runner) {
+    int count = 0;
+    for (int i = 0; i < runner->suite_count; i++) {
+        for (int j = 0; j < runner->suites[i].test_count; j++) {
+            if (runner->suites[i].tests[j].func) count++;
+        }
+    }
+    if (count == 0) return;
+    
+    parallel_run* run = calloc(1, sizeof(parallel_run));
+    test_case** tests = calloc(count, sizeof(test_case*));
+    int jobs = runner->jobs > 1 ? runner->jobs : 1;
+    if (jobs > count) jobs = count;
+    parallel_worker** workers = calloc(jobs, sizeof(parallel_worker*));
+    if (!run || !tests || !workers) {
+        free(run);
+        free(tests);
+        free(workers);
+        return;
+    }
+    for (int i = 0; i < runner->suite_count; i++) {
+        for (int j = 0; j < runner->suites[i].test_count; j++) {
+            if (runner->suites[i].tests[j].func) tests[run->count++] = &runner->suites[i].tests[j];
+        }
+    }
+    run->tests = tests;
+    run->fail_fast = runner->stop_on_failure;
+    run->refs = 1;
+    pthread_mutex_init(&run->lock, NULL);
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&run->changed, &attributes);
+    pthread_condattr_destroy(&attributes);
+    
+    pthread_mutex_lock(&run->lock);
+    for (int i = 0; i < jobs; i++) {
+        workers[i] = parallel_worker_start(run);
+    }
+    while (run->active > 0) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        if (runner->timeout_ms > 0) {
+            double wait_ms = parallel_check_timeouts(run, workers, jobs, runner->timeout_ms);
+            if (run->active == 0) break;
+            long long wait_ns = (long long)(wait_ms * 1000000.0) + 1000000;
+            deadline.tv_sec += wait_ns / 1000000000;
+            deadline.tv_nsec += wait_ns % 1000000000;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&run->changed, &run->lock, &deadline);
+        } else {
+            pthread_cond_wait(&run->changed, &run->lock);
+        }
+    }
+    pthread_mutex_unlock(&run->lock);
+    
+    for (int i = 0; i < jobs; i++) {
+        if (!workers[i]) continue;
+        pthread_join(workers[i]->thread, NULL);
+        free(workers[i]);
+    }
+    free(workers);
+    
+    // Tests nobody took: the run stopped early or no worker got a VM
+    for (int i = 0; i < run->count; i++) {
+        test_case* test = run->tests[i];
+        if (!test->func) continue;
+        test->status = run->stop ? TEST_SKIP : TEST_ERROR;
+        test->message = custom_strdup(run->stop ? "Not run: stopped after a failure"
+                                                : "Not run: no test worker could start");
+        test->func = NULL;
+    }
+    parallel_run_release(run);
+    
+    for (int i = 0; i < runner->suite_count; i++) {
+        test_suite* suite = &runner->suites[i];
+        if (!suite->deferred) continue;
+        for (int j = 0; j < suite->test_count; j++) {
+            suite_record(suite, &suite->tests[j]);
+        }
+    }
 }
 
 void test_runner_run_all(test_runner* runner) {
@@ -186,6 +432,11 @@ void test_runner_run_all(test_runner* runner) {
     
     double start_time = get_time_ms();
     
+    if (runner->jobs > 1) {
+        printf("Running tests on %d worker threads\\n\\n", runner->jobs);
+    }
+    run_deferred_tests(runner);
+    
     for (int i = 0; i < runner->suite_count; i++) {
         test_suite* suite = &runner->suites[i];
         
@@ -520,37 +771,314 @@ ember_value test_create_test_map(ember_vm* vm) {
     return map;
 }
 
+// ============================================================================
+// BENCHMARKS
+// ============================================================================
+
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Sorts the samples; p99 is the nearest-rank percentile
+static void benchmark_statistics(double* samples, int count, test_benchmark_result* result) {
+    qsort(samples, count, sizeof(double), compare_doubles);
+    
+    double sum = 0.0;
+    for (int i = 0; i < count; i++) sum += samples[i];
+    result->mean_ns = sum / count;
+    
+    double squares = 0.0;
+    for (int i = 0; i < count; i++) {
+        double delta = samples[i] - result->mean_ns;
+        squares += delta * delta;
+    }
+    result->stddev_ns = count > 1 ? sqrt(squares / (count - 1)) : 0.0;
+    
+    result->median_ns = count % 2 ? samples[count / 2]
+                                  : (samples[count / 2 - 1] + samples[count / 2]) / 2.0;
+    int rank = (int)ceil(0.99 * count);
+    result->p99_ns = samples[rank > 0 ? rank - 1 : 0];
+    result->min_ns = samples[0];
+    result->max_ns = samples[count - 1];
+}
+
+// One timed batch of calls, in nanoseconds
+static double benchmark_batch(void (*func)(ember_vm*), ember_vm* vm, long batch) {
+    test_setup_vm(vm);
+    uint64_t start = get_time_ns();
+    for (long i = 0; i < batch; i++) {
+        func(vm);
+    }
+    uint64_t end = get_time_ns();
+    test_cleanup_vm(vm);
+    return (double)(end - start);
+}
+
+// Counter totals at one point of a benchmark
+typedef struct {
+    uint64_t instructions;
+    uint64_t allocations;
+    uint64_t bytes_allocated;
+    uint64_t gc_collections;
+    perf_sample hardware;
+} benchmark_counters;
+
+static void benchmark_counters_take(ember_vm* vm, const perf_counters* perf, benchmark_counters* counters) {
+    counters->instructions = vm->instructions_executed;
+    counters->allocations = vm->memory_allocations;
+    counters->bytes_allocated = vm->memory_allocated_bytes;
+    counters->gc_collections = vm->gc_collections;
+    perf_counters_read(perf, &counters->hardware);
+}
+
+// Per-call deltas between two takes
+static void benchmark_counters_record(const benchmark_counters* start, const benchmark_counters* end,
+                                      double calls, test_benchmark_result* result) {
+    result->instructions = (double)(end->instructions - start->instructions) / calls;
+    result->allocations = (double)(end->allocations - start->allocations) / calls;
+    result->bytes_allocated = (double)(end->bytes_allocated - start->bytes_allocated) / calls;
+    result->gc_collections = (double)(end->gc_collections - start->gc_collections) / calls;
+    perf_sample delta;
+    perf_sample_delta(&start->hardware, &end->hardware, &delta);
+    result->hardware = delta.available;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        result->hardware_counts[i] = (double)delta.values[i] / calls;
+    }
+}
+
+static void benchmark_counters_print(const test_benchmark_result* result) {
+    printf("  Per call: %.1f instructions, %.2f allocations (%.0f bytes), %.4f collections\n",
+           result->instructions, result->allocations, result->bytes_allocated, result->gc_collections);
+    if (!result->hardware) return;
+    printf("  Hardware:");
+    const char* separator = " ";
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (!(result->hardware & (1u << i))) continue;
+        printf("%s%.1f %s", separator, result->hardware_counts[i], perf_counter_name((perf_counter)i));
+        separator = ", ";
+    }
+    printf("\n");
+}
+
+// Baseline files hold one "<median ns> <name>" line per benchmark
+static int baseline_parse(char* line, double* median_ns, char** name) {
+    char* end;
+    *median_ns = strtod(line, &end);
+    if (end == line || *end != ' ') return 0;
+    *name = end + 1;
+    (*name)[strcspn(*name, "\n")] = '\0';
+    return 1;
+}
+
+static double baseline_read(const char* path, const char* name) {
+    FILE* file = fopen(path, "r");
+    if (!file) return 0.0;
+    
+    char line[512];
+    double found = 0.0;
+    while (fgets(line, sizeof(line), file)) {
+        double median_ns;
+        char* entry;
+        if (baseline_parse(line, &median_ns, &entry) && strcmp(entry, name) == 0) {
+            found = median_ns;
+            break;
+        }
+    }
+    fclose(file);
+    return found;
+}
+
+// Replaces or appends name's entry; written beside the file and renamed
+// over it, so an interrupted run keeps the old baseline
+static int baseline_write(const char* path, const char* name, double median_ns) {
+    char temp_path[1024];
+    int length = snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    if (length < 0 || length >= (int)sizeof(temp_path)) return -1;
+    FILE* out = fopen(temp_path, "w");
+    if (!out) return -1;
+    
+    int written = 0;
+    FILE* in = fopen(path, "r");
+    if (in) {
+        char line[512];
+        char copy[512];
+        while (fgets(line, sizeof(line), in)) {
+            double old_ns;
+            char* entry;
+            memcpy(copy, line, sizeof(line));
+            if (baseline_parse(copy, &old_ns, &entry) && strcmp(entry, name) == 0) {
+                fprintf(out, "%.3f %s\n", median_ns, name);
+                written = 1;
+            } else {
+                fputs(line, out);
+            }
+        }
+        fclose(in);
+    }
+    if (!written) {
+        fprintf(out, "%.3f %s\n", median_ns, name);
+    }
+    if (fclose(out) != 0 || rename(temp_path, path) != 0) {
+        remove(temp_path);
+        return -1;
+    }
+    return 0;
+}
+
+void test_benchmark_default_options(test_benchmark_options* options) {
+    if (!options) return;
+    options->warmup_ms = 100.0;
+    options->budget_ms = 1000.0;
+    options->target_samples = 100;
+    options->baseline_path = getenv("EMBER_BENCH_BASELINE");
+    options->regression_threshold = 0.10;
+    const char* update = getenv("EMBER_BENCH_UPDATE");
+    options->update_baseline = update && strcmp(update, "1") == 0;
+    options->hardware_counters = 1;
+}
+
+int test_benchmark_run(const char* name, void (*func)(ember_vm*), ember_vm* vm,
+                       const test_benchmark_options* options, test_benchmark_result* result) {
+    if (!name || !func || !vm || !result) return -1;
+    test_benchmark_options defaults;
+    if (!options) {
+        test_benchmark_default_options(&defaults);
+        options = &defaults;
+    }
+    memset(result, 0, sizeof(*result));
+    
+    int target = options->target_samples > 0 ? options->target_samples : 100;
+    // Batches of at least 0.1ms keep the clock's own cost out of the numbers
+    double sample_ns = options->budget_ms * 1000000.0 / target;
+    if (sample_ns < 100000.0) sample_ns = 100000.0;
+    
+    // Warmup, growing the batch until one takes a sample's worth of time
+    long batch = 1;
+    uint64_t warmup_end = get_time_ns() + (uint64_t)(options->warmup_ms * 1000000.0);
+    for (;;) {
+        double elapsed = benchmark_batch(func, vm, batch);
+        if (elapsed < sample_ns && batch < 1000000000L) {
+            double scale = elapsed > 0.0 ? sample_ns / elapsed * 1.1 : 10.0;
+            if (scale > 10.0) scale = 10.0;
+            long next = (long)(batch * scale);
+            batch = next > batch ? next : batch + 1;
+            continue;
+        }
+        if (get_time_ns() >= warmup_end) break;
+    }
+    
+    // Measure until the budget is spent, with at least 10 samples
+    int capacity = target * 4 > 10 ? target * 4 : 10;
+    double* samples = malloc(sizeof(double) * capacity);
+    if (!samples) return -1;
+    int count = 0;
+    perf_counters perf;
+    if (options->hardware_counters) {
+        perf_counters_open(&perf);
+    } else {
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++) perf.fds[i] = -1;
+    }
+    benchmark_counters start, end;
+    benchmark_counters_take(vm, &perf, &start);
+    uint64_t measure_end = get_time_ns() + (uint64_t)(options->budget_ms * 1000000.0);
+    while (count < capacity && (count < 10 || get_time_ns() < measure_end)) {
+        samples[count++] = benchmark_batch(func, vm, batch) / batch;
+    }
+    benchmark_counters_take(vm, &perf, &end);
+    perf_counters_close(&perf);
+    benchmark_counters_record(&start, &end, (double)count * batch, result);
+    benchmark_statistics(samples, count, result);
+    free(samples);
+    result->samples = count;
+    result->batch = batch;
+    
+    if (options->baseline_path) {
+        result->baseline_ns = baseline_read(options->baseline_path, name);
+        if (result->baseline_ns > 0.0 && !options->update_baseline) {
+            result->regressed = result->median_ns >
+                                result->baseline_ns * (1.0 + options->regression_threshold);
+        }
+        if (result->baseline_ns <= 0.0 || options->update_baseline) {
+            if (baseline_write(options->baseline_path, name, result->median_ns) != 0) {
+                printf("  %sCould not save baseline to %s%s\\n", COLOR_RED,
+                       options->baseline_path, COLOR_RESET);
+            }
+        }
+    }
+    
+    printf("%sBenchmark: %s%s\\n", COLOR_YELLOW, name, COLOR_RESET);
+    printf("  Samples: %d x %ld calls\\n", result->samples, result->batch);
+    printf("  Mean: %.1fns  Median: %.1fns  P99: %.1fns  Stddev: %.1fns\\n",
+           result->mean_ns, result->median_ns, result->p99_ns, result->stddev_ns);
+    printf("  Min: %.1fns  Max: %.1fns\\n", result->min_ns, result->max_ns);
+    benchmark_counters_print(result);
+    if (result->baseline_ns > 0.0) {
+        double change = (result->median_ns / result->baseline_ns - 1.0) * 100.0;
+        printf("  %sBaseline: %.1fns (%+.1f%%)%s\\n",
+               result->regressed ? COLOR_RED : COLOR_GREEN, result->baseline_ns, change, COLOR_RESET);
+    }
+    printf("\\n");
+    
+    if (result->regressed) {
+        char message[512];
+        snprintf(message, sizeof(message),
+                 "Benchmark %s regressed: median %.1fns against a %.1fns baseline (threshold %.0f%%)",
+                 name, result->median_ns, result->baseline_ns, options->regression_threshold * 100.0);
+        set_test_failure(message);
+    }
+    return 0;
+}
+
 void test_benchmark(const char* name, void (*func)(ember_vm*), ember_vm* vm, int iterations) {
-    if (!name || !func || !vm || iterations <= 0) return;
+    if (!name || !func || !vm) return;
+    
+    // No iteration count: calibrate one to the default time budget
+    if (iterations <= 0) {
+        test_benchmark_result result;
+        test_benchmark_run(name, func, vm, NULL, &result);
+        return;
+    }
+    
+    double* times = malloc(sizeof(double) * iterations);
+    if (!times) return;
     
     printf("%sBenchmark: %s%s\\n", COLOR_YELLOW, name, COLOR_RESET);
     
+    perf_counters perf;
+    perf_counters_open(&perf);
+    benchmark_counters start, end;
+    benchmark_counters_take(vm, &perf, &start);
     double total_time = 0.0;
-    double min_time = INFINITY;
-    double max_time = 0.0;
-    
     for (int i = 0; i < iterations; i++) {
-        test_setup_vm(vm);
-        
-        double start_time = get_time_ms();
-        func(vm);
-        double end_time = get_time_ms();
-        
-        double iteration_time = end_time - start_time;
-        total_time += iteration_time;
-        
-        if (iteration_time < min_time) min_time = iteration_time;
-        if (iteration_time > max_time) max_time = iteration_time;
-        
-        test_cleanup_vm(vm);
+        times[i] = benchmark_batch(func, vm, 1);
+        total_time += times[i] / 1000000.0;
     }
+    benchmark_counters_take(vm, &perf, &end);
+    perf_counters_close(&perf);
     
+    test_benchmark_result stats;
+    memset(&stats, 0, sizeof(stats));
+    benchmark_counters_record(&start, &end, iterations, &stats);
+    benchmark_statistics(times, iterations, &stats);
+    free(times);
     double avg_time = total_time / iterations;
     
     printf("  Iterations: %d\\n", iterations);
     printf("  Total Time: %.2fms\\n", total_time);
     printf("  Average: %.4fms\\n", avg_time);
-    printf("  Min: %.4fms\\n", min_time);
-    printf("  Max: %.4fms\\n", max_time);
+    printf("  Median: %.4fms\\n", stats.median_ns / 1000000.0);
+    printf("  P99: %.4fms\\n", stats.p99_ns / 1000000.0);
+    printf("  Stddev: %.4fms\\n", stats.stddev_ns / 1000000.0);
+    printf("  Min: %.4fms\\n", stats.min_ns / 1000000.0);
+    printf("  Max: %.4fms\\n", stats.max_ns / 1000000.0);
+    benchmark_counters_print(&stats);
     printf("  Ops/sec: %.0f\\n\\n", 1000.0 / avg_time);
-}
\ No newline at end of file
+}
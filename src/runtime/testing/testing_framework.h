@@ -2,6 +2,7 @@
 #define EMBER_TESTING_FRAMEWORK_H
 
 #include "../../../include/ember.h"
+#include "../../core/perf_counters.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -15,6 +16,9 @@ typedef enum {
     TEST_ERROR
 } test_status;
 
+// Test function type
+typedef void (*test_function)(ember_vm* vm);
+
 // Test case structure
 typedef struct {
     char* name;
@@ -23,6 +27,7 @@ typedef struct {
     double duration_ms;
     int line;
     const char* file;
+    test_function func;       // Set while a deferred test has not run yet
 } test_case;
 
 // Test suite structure
@@ -36,6 +41,7 @@ typedef struct {
     int skipped;
     int errors;
     double total_duration_ms;
+    int deferred;             // Tests run in test_runner_run_all, not when added
 } test_suite;
 
 // Test runner context
@@ -51,15 +57,20 @@ typedef struct {
     double total_duration_ms;
     int verbose;
     int stop_on_failure;
+    int jobs;                 // Worker threads; more than 1 runs tests in parallel
+    double timeout_ms;        // Per-test limit, 0 for none
 } test_runner;
 
-// Test function type
-typedef void (*test_function)(ember_vm* vm);
-
 // Core testing framework functions
 test_runner* test_runner_create(void);
 void test_runner_free(test_runner* runner);
 test_suite* test_runner_add_suite(test_runner* runner, const char* name);
+// Runs the test on vm right away. In suites added while the runner has
+// jobs > 1 or a timeout set, the test is only recorded (vm may be NULL) and
+// test_runner_run_all runs it on a worker thread with its own pooled VM.
+// Results are reported in the order tests were added either way; with
+// stop_on_failure, tests not started after the first failure are skipped,
+// and a test over timeout_ms is reported as an error while the rest go on.
 void test_suite_add_test(test_suite* suite, const char* name, test_function func, ember_vm* vm);
 void test_runner_run_all(test_runner* runner);
 void test_runner_print_results(test_runner* runner);
@@ -83,6 +94,48 @@ ember_value test_create_test_array(ember_vm* vm, int size);
 ember_value test_create_test_map(ember_vm* vm);
 void test_benchmark(const char* name, void (*func)(ember_vm*), ember_vm* vm, int iterations);
 
+// Benchmark harness. Calls are timed in batches sized so one batch takes
+// budget_ms / target_samples, after warmup_ms of untimed runs, until the
+// budget is spent; statistics are per call. With a baseline file the median
+// is compared to the one saved under the same name and a slowdown past
+// regression_threshold fails the running test. Missing entries are added,
+// and update_baseline rewrites existing ones.
+typedef struct {
+    double warmup_ms;              // Untimed runs first (default 100)
+    double budget_ms;              // Time to spend measuring (default 1000)
+    int target_samples;            // Batches to aim for (default 100)
+    const char* baseline_path;     // NULL: no comparison (default $EMBER_BENCH_BASELINE)
+    double regression_threshold;   // 0.10 fails a median 10% over the baseline
+    int update_baseline;           // Default: $EMBER_BENCH_UPDATE=1
+    int hardware_counters;         // Read perf_event counters when allowed (default 1)
+} test_benchmark_options;
+
+typedef struct {
+    int samples;
+    long batch;                    // Calls per timed sample
+    double mean_ns;
+    double median_ns;
+    double p99_ns;
+    double stddev_ns;
+    double min_ns;
+    double max_ns;
+    double baseline_ns;            // Saved median, 0 if there was none
+    int regressed;
+    // Per call over the measured batches: deltas of the VM's counters, which
+    // unlike time do not depend on what else the host is running
+    double instructions;           // vm->instructions_executed
+    double allocations;            // vm->memory_allocations
+    double bytes_allocated;        // vm->memory_allocated_bytes
+    double gc_collections;         // vm->gc_collections
+    unsigned hardware;             // Bit per perf_counter in hardware_counts
+    double hardware_counts[PERF_COUNTER_COUNT];
+} test_benchmark_result;
+
+void test_benchmark_default_options(test_benchmark_options* options);
+// Returns 0, or -1 when the arguments are invalid or no sample was taken
+int test_benchmark_run(const char* name, void (*func)(ember_vm*), ember_vm* vm,
+                       const test_benchmark_options* options, test_benchmark_result* result);
+
 // Macros for easier testing
 #define TEST_ASSERT(condition, message) \
     test_assert_true(vm, (condition), (message))
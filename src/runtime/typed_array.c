@@ -0,0 +1,237 @@
+/**
+ * Typed arrays for Ember: fixed-length buffers of unboxed float64, int32 or
+ * uint8 elements, 8, 4 or 1 bytes each instead of a boxed ember_value
+ * float64_array / int32_array / uint8_array / typed_fill / typed_copy /
+ * typed_slice / typed_to_array. Elements are read and written with a[i]
+ * (vm_handle_typed_array_get/set, and vm_dispatch.h in line)
+ */
+
+#include "ember.h"
+#include "../vm.h"
+#include "value/value.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#define TYPED_MAX_LENGTH INT32_MAX
+
+static const size_t typed_element_size[] = {
+    [EMBER_TYPED_FLOAT64] = sizeof(double),
+    [EMBER_TYPED_INT32] = sizeof(int32_t),
+    [EMBER_TYPED_UINT8] = sizeof(uint8_t)
+};
+
+// ============================================================================
+// C API
+// ============================================================================
+
+int32_t ember_typed_wrap_int32(double value) {
+    if (!isfinite(value)) return 0;
+    double wrapped = fmod(trunc(value), 4294967296.0);
+    if (wrapped < 0) wrapped += 4294967296.0;
+    return (int32_t)(uint32_t)wrapped;
+}
+
+ember_value ember_make_typed_array(ember_vm* vm, ember_typed_kind kind, int length) {
+    if (length < 0) return ember_make_nil();
+    ember_typed_array* array =
+        (ember_typed_array*)allocate_object(vm, sizeof(ember_typed_array), OBJ_TYPED_ARRAY);
+    if (!array) return ember_make_nil();
+    array->kind = kind;
+    array->length = 0;
+    array->data = calloc(length > 0 ? (size_t)length : 1, typed_element_size[kind]);
+    if (!array->data) return ember_make_nil();
+    array->length = length;
+    ember_value value;
+    value.type = EMBER_VAL_TYPED_ARRAY;
+    value.as.obj_val = (ember_object*)array;
+    return value;
+}
+
+// ============================================================================
+// NATIVES
+// ============================================================================
+
+// Reads [start, end) from argv[first] and argv[first + 1], each optional;
+// negative positions count from the end and both are clamped to length
+static bool typed_range(int argc, ember_value* argv, int first, int length, int* start, int* end) {
+    double bounds[2] = {0, length};
+    for (int i = 0; i < 2 && first + i < argc; i++) {
+        ember_value bound = argv[first + i];
+        if (bound.type == EMBER_VAL_NIL) continue;
+        if (bound.type != EMBER_VAL_NUMBER || bound.as.number_val != bound.as.number_val) return false;
+        double position = trunc(bound.as.number_val);
+        if (position < 0) position += length;
+        bounds[i] = position < 0 ? 0 : position > length ? length : position;
+    }
+    *start = (int)bounds[0];
+    *end = bounds[1] > bounds[0] ? (int)bounds[1] : *start;
+    return true;
+}
+
+// float64_array(length) zero-filled, or float64_array(values) from an array
+// or typed array of numbers, converted
+static ember_value make_from_args(ember_vm* vm, ember_typed_kind kind, int argc, ember_value* argv) {
+    if (argc != 1) return ember_make_nil();
+    ember_value source = argv[0];
+    if (source.type == EMBER_VAL_NUMBER) {
+        double length = source.as.number_val;
+        if (!(length >= 0 && length <= TYPED_MAX_LENGTH) || length != trunc(length)) return ember_make_nil();
+        return ember_make_typed_array(vm, kind, (int)length);
+    }
+    if (source.type == EMBER_VAL_TYPED_ARRAY) {
+        ember_typed_array* from = AS_TYPED_ARRAY(source);
+        ember_value value = ember_make_typed_array(vm, kind, from->length);
+        if (value.type != EMBER_VAL_TYPED_ARRAY) return value;
+        ember_typed_array* array = AS_TYPED_ARRAY(value);
+        if (from->kind == kind) {
+            memcpy(array->data, from->data, (size_t)from->length * typed_element_size[kind]);
+        } else {
+            for (int i = 0; i < from->length; i++) {
+                ember_typed_array_store(array, i, ember_typed_array_load(from, i));
+            }
+        }
+        return value;
+    }
+    if (source.type != EMBER_VAL_ARRAY) return ember_make_nil();
+    ember_array* elements = AS_ARRAY(source);
+    for (int i = 0; i < elements->length; i++) {
+        if (elements->elements[i].type != EMBER_VAL_NUMBER) return ember_make_nil();
+    }
+    ember_value value = ember_make_typed_array(vm, kind, elements->length);
+    if (value.type != EMBER_VAL_TYPED_ARRAY) return value;
+    ember_typed_array* array = AS_TYPED_ARRAY(value);
+    for (int i = 0; i < elements->length; i++) {
+        ember_typed_array_store(array, i, elements->elements[i].as.number_val);
+    }
+    return value;
+}
+
+ember_value ember_native_float64_array(ember_vm* vm, int argc, ember_value* argv) {
+    return make_from_args(vm, EMBER_TYPED_FLOAT64, argc, argv);
+}
+
+ember_value ember_native_int32_array(ember_vm* vm, int argc, ember_value* argv) {
+    return make_from_args(vm, EMBER_TYPED_INT32, argc, argv);
+}
+
+ember_value ember_native_uint8_array(ember_vm* vm, int argc, ember_value* argv) {
+    return make_from_args(vm, EMBER_TYPED_UINT8, argc, argv);
+}
+
+// typed_fill(a, value[, start[, end]]): a, or nil
+ember_value ember_native_typed_fill(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc < 2 || argc > 4 || argv[0].type != EMBER_VAL_TYPED_ARRAY || argv[1].type != EMBER_VAL_NUMBER) {
+        return ember_make_nil();
+    }
+    ember_typed_array* array = AS_TYPED_ARRAY(argv[0]);
+    int start, end;
+    if (ember_object_is_frozen(array) || !typed_range(argc, argv, 2, array->length, &start, &end)) {
+        return ember_make_nil();
+    }
+    if (start == end) return argv[0];
+    // One conversion, then a plain store or memset per element
+    ember_typed_array_store(array, start, argv[1].as.number_val);
+    switch (array->kind) {
+        case EMBER_TYPED_UINT8:
+            memset((uint8_t*)array->data + start, ((uint8_t*)array->data)[start], (size_t)(end - start));
+            break;
+        case EMBER_TYPED_INT32: {
+            int32_t* data = array->data;
+            for (int i = start + 1; i < end; i++) data[i] = data[start];
+            break;
+        }
+        default: {
+            double* data = array->data;
+            for (int i = start + 1; i < end; i++) data[i] = data[start];
+            break;
+        }
+    }
+    return argv[0];
+}
+
+// typed_copy(dest, src[, offset[, start[, end]]]): src[start, end), from a
+// typed array or an array of numbers, written into dest from offset; dest,
+// or nil if it does not fit. Overlapping copies within one array are safe
+ember_value ember_native_typed_copy(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc < 2 || argc > 5 || argv[0].type != EMBER_VAL_TYPED_ARRAY) return ember_make_nil();
+    ember_typed_array* dest = AS_TYPED_ARRAY(argv[0]);
+    if (ember_object_is_frozen(dest)) return ember_make_nil();
+    ember_value source = argv[1];
+    int source_length;
+    if (source.type == EMBER_VAL_TYPED_ARRAY) {
+        source_length = AS_TYPED_ARRAY(source)->length;
+    } else if (source.type == EMBER_VAL_ARRAY) {
+        source_length = AS_ARRAY(source)->length;
+    } else {
+        return ember_make_nil();
+    }
+
+    double offset = 0;
+    if (argc >= 3 && argv[2].type != EMBER_VAL_NIL) {
+        if (argv[2].type != EMBER_VAL_NUMBER) return ember_make_nil();
+        offset = argv[2].as.number_val;
+    }
+    int start, end;
+    if (!typed_range(argc, argv, 3, source_length, &start, &end)) return ember_make_nil();
+    int count = end - start;
+    if (!(offset >= 0 && offset <= (double)(dest->length - count)) || offset != trunc(offset)) {
+        return ember_make_nil();
+    }
+    int at = (int)offset;
+
+    if (source.type == EMBER_VAL_ARRAY) {
+        ember_value* elements = AS_ARRAY(source)->elements;
+        for (int i = start; i < end; i++) {
+            if (elements[i].type != EMBER_VAL_NUMBER) return ember_make_nil();
+        }
+        for (int i = 0; i < count; i++) {
+            ember_typed_array_store(dest, at + i, elements[start + i].as.number_val);
+        }
+        return argv[0];
+    }
+    ember_typed_array* from = AS_TYPED_ARRAY(source);
+    if (from->kind == dest->kind) {
+        size_t size = typed_element_size[dest->kind];
+        memmove((char*)dest->data + (size_t)at * size, (char*)from->data + (size_t)start * size,
+                (size_t)count * size);
+    } else {
+        // Different kinds never share a buffer
+        for (int i = 0; i < count; i++) {
+            ember_typed_array_store(dest, at + i, ember_typed_array_load(from, start + i));
+        }
+    }
+    return argv[0];
+}
+
+// typed_slice(a[, start[, end]]): a new typed array of the same kind
+// holding a copy of a[start, end)
+ember_value ember_native_typed_slice(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc < 1 || argc > 3 || argv[0].type != EMBER_VAL_TYPED_ARRAY) return ember_make_nil();
+    ember_typed_array* array = AS_TYPED_ARRAY(argv[0]);
+    int start, end;
+    if (!typed_range(argc, argv, 1, array->length, &start, &end)) return ember_make_nil();
+    ember_value value = ember_make_typed_array(vm, array->kind, end - start);
+    if (value.type != EMBER_VAL_TYPED_ARRAY) return value;
+    size_t size = typed_element_size[array->kind];
+    memcpy(AS_TYPED_ARRAY(value)->data, (char*)array->data + (size_t)start * size, (size_t)(end - start) * size);
+    return value;
+}
+
+// typed_to_array(a): the elements as an ordinary array of numbers
+ember_value ember_native_typed_to_array(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 1 || argv[0].type != EMBER_VAL_TYPED_ARRAY) return ember_make_nil();
+    ember_typed_array* array = AS_TYPED_ARRAY(argv[0]);
+    ember_value value = ember_make_array(vm, array->length > 0 ? array->length : 1);
+    if (value.type != EMBER_VAL_ARRAY) return value;
+    ember_array* elements = AS_ARRAY(value);
+    for (int i = 0; i < array->length; i++) {
+        elements->elements[i] = ember_make_number(ember_typed_array_load(array, i));
+    }
+    elements->length = array->length;
+    return value;
+}
@@ -1,16 +1,30 @@
+#define _GNU_SOURCE
 #include "value.h"
 #include "../../vm.h"
+#include "../../core/gc_trace.h"
+#include "../../core/huge_pages.h"
+#include "../../core/object_slab.h"
+#include "../../core/object_shape.h"
+#include "../../core/vm_regex.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <stdint.h>
 #include <limits.h>
+#include <math.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 ember_value ember_make_number(double num) {
     ember_value value;
     value.type = EMBER_VAL_NUMBER;
-    value.as.number_val = num;
+    value.as.number.value = num;
+    // Integral values carry their int32 too; -0 stays a plain double
+    value.as.number.is_small = num >= INT32_MIN && num <= INT32_MAX && (double)(int32_t)num == num &&
+                               (num != 0 || !signbit(num));
+    value.as.number.small = value.as.number.is_small ? (int32_t)num : 0;
     return value;
 }
 
@@ -67,12 +81,33 @@ const char* value_type_to_string(ember_val_type type) {
         case EMBER_VAL_SET: return "set";
         case EMBER_VAL_MAP: return "map";
         case EMBER_VAL_REGEX: return "regex";
+        case EMBER_VAL_STRING_BUILDER: return "string_builder";
+        case EMBER_VAL_HASHER: return "hasher";
+        case EMBER_VAL_FILE: return "file";
+        case EMBER_VAL_WALKER: return "walker";
+        case EMBER_VAL_TYPED_ARRAY: return "typed_array";
+        case EMBER_VAL_CACHE: return "cache";
+        case EMBER_VAL_DEQUE: return "deque";
+        case EMBER_VAL_PRIORITY_QUEUE: return "priority_queue";
+        case EMBER_VAL_WEAK_REF: return "weak_ref";
+        case EMBER_VAL_WEAK_MAP: return "weak_map";
         default: return "unknown";
     }
 }
 
 ember_object* allocate_object(ember_vm* vm, size_t size, ember_object_type type) {
-    ember_object* object = (ember_object*)malloc(size);
+    ember_object* object = vm->gc_object_pooling ? gc_pool_take(vm, type, size) : NULL;
+    int in_slab = object ? object->in_slab : 0;
+#ifdef EMBER_SLAB_OBJECTS
+    // The headers a program allocates most often share per-VM slabs
+    if (!object && (type == OBJ_STRING || type == OBJ_ARRAY || type == OBJ_HASH_MAP || type == OBJ_INSTANCE)) {
+        object = (ember_object*)object_slab_alloc(vm, size);
+        in_slab = object != NULL;
+    }
+#endif
+    if (!object) {
+        object = (ember_object*)malloc(size);
+    }
     if (!object) {
         fprintf(stderr, "[SECURITY] Memory allocation failed for object of size %zu\n", size);
         return NULL;
@@ -80,17 +115,139 @@ ember_object* allocate_object(ember_vm* vm, size_t size, ember_object_type type)
     
     object->type = type;
     object->is_marked = 0;
+    object->is_old = 0;
+    object->is_remembered = 0;
+    object->in_slab = (uint8_t)in_slab;
     object->next = vm->objects;
     vm->objects = object;
     
-    vm->bytes_allocated += size;
-    if (vm->bytes_allocated > vm->next_gc) {
-        collect_garbage(vm);
+    vm->bytes_allocated += (int64_t)size;
+    vm->memory_allocations++;
+    vm->memory_allocated_bytes += size;
+    if (vm->gc_alloc_sample_countdown && --vm->gc_alloc_sample_countdown == 0) {
+        gc_stats_sample_allocation(vm, type, size);
+    }
+    if (vm->gc_generational) {
+        // Minor collections wait for a safe point (see gc_generational.c)
+        vm->gc_nursery_bytes += (int64_t)size;
+        if (vm->gc_nursery_bytes > vm->gc_nursery_limit) {
+            vm->gc_minor_requested = 1;
+        }
+    }
+    if (vm->gc_incremental) {
+        // Starts a cycle past next_gc; the work itself happens in steps
+        gc_incremental_allocated(vm, object, size);
+    } else if (vm->gc_phase == GC_PHASE_SWEEP) {
+        // A lazily swept cycle is paid off a few objects at a time
+        gc_sweep_allocated(vm);
+    } else if (vm->bytes_allocated > vm->next_gc) {
+        gc_collect_triggered(vm, object);
     }
     
     return object;
 }
 
+// String and number hashes are wyhash: eight bytes per step (48 per round
+// in three independent lanes for long keys) through a 128-bit multiply,
+// keyed by a per-process random seed so colliding keys cannot be worked
+// out ahead of time. String hashes are cached in ember_string so hashing a
+// string key never rescans its characters.
+
+#define HASH_SECRET0 0xa0761d6478bd642fULL
+#define HASH_SECRET1 0xe7037ed1a0b428dbULL
+#define HASH_SECRET2 0x8ebc6af09c88c6e3ULL
+#define HASH_SECRET3 0x589965cc75374cc3ULL
+
+uint64_t ember_hash_seed;
+static uint64_t string_seed;   // ember_hash_seed premixed for hash_string_chars
+
+__attribute__((constructor))
+static void hash_seed_init(void) {
+    const char* setting = getenv("EMBER_HASH_SEED");
+    uint64_t seed = 0;
+    if (setting && *setting) {
+        seed = strtoull(setting, NULL, 0);
+    } else if (!ember_secure_random_bytes(&seed, sizeof(seed))) {
+        // Still differs per run with ASLR
+        seed = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32) ^ (uint64_t)(uintptr_t)&seed;
+    }
+    ember_hash_seed = seed;
+    string_seed = seed ^ hash_mix(seed ^ HASH_SECRET0, HASH_SECRET1);
+}
+
+static inline uint64_t hash_read64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t hash_read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Both halves of the 128-bit product, for the final round
+static inline void hash_mum(uint64_t* low, uint64_t* high, uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t product = (__uint128_t)a * b;
+    *low = (uint64_t)product;
+    *high = (uint64_t)(product >> 64);
+#else
+    uint64_t ha = a >> 32, la = (uint32_t)a, hb = b >> 32, lb = (uint32_t)b;
+    uint64_t hh = ha * hb, hl = ha * lb, lh = la * hb, ll = la * lb;
+    uint64_t mid = (ll >> 32) + (uint32_t)hl + (uint32_t)lh;
+    *low = (mid << 32) | (uint32_t)ll;
+    *high = hh + (hl >> 32) + (lh >> 32) + (mid >> 32);
+#endif
+}
+
+uint32_t hash_string_chars(const char* chars, int length) {
+    if (!chars) return 0;
+    
+    const uint8_t* p = (const uint8_t*)chars;
+    size_t size = length > 0 ? (size_t)length : 0;
+    size_t remaining = size;
+    uint64_t seed = string_seed;
+    uint64_t a, b;
+    if (remaining <= 16) {
+        if (remaining >= 4) {
+            // Two overlapping pairs of 4-byte reads cover 4..16 bytes
+            size_t shift = (remaining >> 3) << 2;
+            a = (hash_read32(p) << 32) | hash_read32(p + shift);
+            b = (hash_read32(p + remaining - 4) << 32) | hash_read32(p + remaining - 4 - shift);
+        } else if (remaining > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[remaining >> 1] << 8) | p[remaining - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        if (remaining > 48) {
+            uint64_t lane1 = seed, lane2 = seed;
+            do {
+                seed = hash_mix(hash_read64(p) ^ HASH_SECRET1, hash_read64(p + 8) ^ seed);
+                lane1 = hash_mix(hash_read64(p + 16) ^ HASH_SECRET2, hash_read64(p + 24) ^ lane1);
+                lane2 = hash_mix(hash_read64(p + 32) ^ HASH_SECRET3, hash_read64(p + 40) ^ lane2);
+                p += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= lane1 ^ lane2;
+        }
+        while (remaining > 16) {
+            seed = hash_mix(hash_read64(p) ^ HASH_SECRET1, hash_read64(p + 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+        // The last 16 bytes, overlapping what came before
+        a = hash_read64(p + remaining - 16);
+        b = hash_read64(p + remaining - 8);
+    }
+    hash_mum(&a, &b, HASH_SECRET1 ^ a, seed ^ b);
+    uint64_t hash = hash_mix(a ^ HASH_SECRET0 ^ (uint64_t)size, b ^ HASH_SECRET1);
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
 ember_string* allocate_string(ember_vm* vm, char* chars, int length) {
     ember_string* string = (ember_string*)allocate_object(vm, sizeof(ember_string), OBJ_STRING);
     if (!string) {
@@ -99,6 +256,38 @@ ember_string* allocate_string(ember_vm* vm, char* chars, int length) {
     }
     string->length = length;
     string->chars = chars;
+    string->hash = hash_string_chars(chars, length);
+    string->left = NULL;
+    string->right = NULL;
+    string->is_interned = 0;
+    string->is_inline = 0;
+    string->is_mapped = 0;
+    string->is_external = 0;
+    string->slice_start = 0;
+    return string;
+}
+
+// Short strings keep their bytes right after the header: one allocation, and
+// chars points into the same cache line instead of a separate buffer
+static ember_string* allocate_inline_string(ember_vm* vm, const char* chars, int length) {
+    size_t size = sizeof(ember_string) + (size_t)length + 1;
+    ember_string* string = (ember_string*)allocate_object(vm, size, OBJ_STRING);
+    if (!string) {
+        return NULL;
+    }
+    
+    memcpy(string->inline_chars, chars, length);
+    string->inline_chars[length] = '\0';
+    string->chars = string->inline_chars;
+    string->length = length;
+    string->hash = hash_string_chars(chars, length);
+    string->left = NULL;
+    string->right = NULL;
+    string->is_interned = 0;
+    string->is_inline = 1;
+    string->is_mapped = 0;
+    string->is_external = 0;
+    string->slice_start = 0;
     return string;
 }
 
@@ -107,6 +296,10 @@ ember_string* copy_string(ember_vm* vm, const char* chars, int length) {
         return NULL;
     }
     
+    if (length <= EMBER_STRING_INLINE_MAX) {
+        return allocate_inline_string(vm, chars, length);
+    }
+    
     char* heap_chars = malloc(length + 1);
     if (!heap_chars) {
         fprintf(stderr, "[SECURITY] Memory allocation failed for string of length %d\n", length);
@@ -118,6 +311,282 @@ ember_string* copy_string(ember_vm* vm, const char* chars, int length) {
     return allocate_string(vm, heap_chars, length);
 }
 
+// A mapped string's span: the file's bytes, then at least one zero byte
+// (the rest of the last page, or a whole page when the file ends on a page
+// boundary) so chars stays NUL-terminated like any flat string's
+static size_t mapped_string_size(int length) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return ((size_t)length + page) / page * page;
+}
+
+ember_string* ember_string_map_file(ember_vm* vm, int fd, int length) {
+    if (length <= 0) return NULL;
+    size_t size = mapped_string_size(length);
+    // Reserve the span as zero pages, then lay the file over its start
+    char* chars = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (chars == MAP_FAILED) return NULL;
+    if (mmap(chars, (size_t)length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(chars, size);
+        return NULL;
+    }
+    ember_string* string = (ember_string*)allocate_object(vm, sizeof(ember_string), OBJ_STRING);
+    if (!string) {
+        munmap(chars, size);
+        return NULL;
+    }
+    string->chars = chars;
+    string->length = length;
+    string->hash = hash_string_chars(chars, length);
+    string->left = NULL;
+    string->right = NULL;
+    string->is_interned = 0;
+    string->is_inline = 0;
+    string->is_mapped = 1;
+    string->is_external = 0;
+    string->slice_start = 0;
+    return string;
+}
+
+ember_value ember_make_string_len(ember_vm* vm, const char* chars, size_t length) {
+    ember_value value;
+    value.type = EMBER_VAL_NIL;
+    if (!vm || (!chars && length > 0) || length > INT_MAX) return value;
+    
+    ember_string* string = copy_string(vm, chars ? chars : "", (int)length);
+    if (!string) return value;
+    value.type = EMBER_VAL_STRING;
+    value.as.obj_val = (ember_object*)string;
+    return value;
+}
+
+ember_value ember_make_string_external(ember_vm* vm, const char* chars, size_t length,
+                                       ember_string_release release, void* userdata) {
+    ember_value value;
+    value.type = EMBER_VAL_NIL;
+    if (!vm || !chars || length > INT_MAX) {
+        if (release && chars) release(chars, length, userdata);
+        return value;
+    }
+    
+    // Copying a short string costs less than the callback; a buffer without
+    // the terminator has to be copied to get one
+    if (length <= EMBER_STRING_INLINE_MAX || chars[length] != '\0') {
+        value = ember_make_string_len(vm, chars, length);
+        if (release) release(chars, length, userdata);
+        return value;
+    }
+    
+    ember_string* string = (ember_string*)allocate_object(vm, EMBER_STRING_EXTERNAL_SIZE, OBJ_STRING);
+    if (!string) {
+        if (release) release(chars, length, userdata);
+        return value;
+    }
+    ember_string_external external = {release, userdata};
+    memcpy(string->inline_chars, &external, sizeof(external));
+    // Never written through: external strings are only read and released
+    string->chars = (char*)chars;
+    string->length = (int)length;
+    string->hash = hash_string_chars(chars, (int)length);
+    string->left = NULL;
+    string->right = NULL;
+    string->is_interned = 0;
+    string->is_inline = 0;
+    string->is_mapped = 0;
+    string->is_external = 1;
+    string->slice_start = 0;
+    value.type = EMBER_VAL_STRING;
+    value.as.obj_val = (ember_object*)string;
+    return value;
+}
+
+// Rope node for a + b: O(1) now, the bytes are copied once by ember_string_flatten
+static ember_string* allocate_rope(ember_vm* vm, ember_string* left, ember_string* right) {
+    ember_string* string = (ember_string*)allocate_object(vm, sizeof(ember_string), OBJ_STRING);
+    if (!string) {
+        return NULL;
+    }
+    
+    string->chars = NULL;
+    string->length = left->length + right->length;
+    string->hash = 0;
+    string->left = left;
+    string->right = right;
+    string->is_interned = 0;
+    string->is_inline = 0;
+    string->is_mapped = 0;
+    string->is_external = 0;
+    string->slice_start = 0;
+    return string;
+}
+
+const char* ember_string_bytes(const ember_string* string) {
+    if (string->chars) return string->chars;
+    if (string->left && !string->right) return string->left->chars + string->slice_start;
+    return NULL;
+}
+
+ember_string* ember_string_slice(ember_vm* vm, ember_string* parent, int start, int length) {
+    if (!parent || start < 0 || length < 0 || start > parent->length - length) return NULL;
+    if (start == 0 && length == parent->length) return parent;
+    
+    // A slice of a slice points at the flat string underneath
+    if (!parent->chars && parent->left && !parent->right) {
+        start += parent->slice_start;
+        parent = parent->left;
+    }
+    if (!ember_string_flatten(parent)) return NULL;
+    if (length < EMBER_ROPE_MIN_LENGTH) {
+        return copy_string(vm, parent->chars + start, length);
+    }
+    
+    ember_string* string = (ember_string*)allocate_object(vm, sizeof(ember_string), OBJ_STRING);
+    if (!string) {
+        return NULL;
+    }
+    string->chars = NULL;
+    string->length = length;
+    string->hash = 0;
+    string->left = parent;
+    string->right = NULL;
+    string->is_interned = 0;
+    string->is_inline = 0;
+    string->is_mapped = 0;
+    string->is_external = 0;
+    string->slice_start = start;
+    return string;
+}
+
+// Copy every leaf under a rope into buffer. Each node's bytes land at a known
+// offset, so a flat child is copied immediately and only nodes with two rope
+// children need the explicit stack; left- or right-deep chains built by
+// loops therefore flatten without growing it.
+static int rope_copy_leaves(ember_string* root, char* buffer) {
+    int stack_capacity = 16;
+    int stack_count = 0;
+    ember_string** nodes = malloc(sizeof(ember_string*) * stack_capacity);
+    int* offsets = malloc(sizeof(int) * stack_capacity);
+    if (!nodes || !offsets) {
+        free(nodes);
+        free(offsets);
+        return 0;
+    }
+    
+    ember_string* node = root;
+    int offset = 0;
+    for (;;) {
+        // Slices have their bytes at hand, like flat strings
+        while (node && !ember_string_bytes(node)) {
+            ember_string* left = node->left;
+            ember_string* right = node->right;
+            int right_offset = offset + left->length;
+            const char* left_bytes = ember_string_bytes(left);
+            const char* right_bytes = ember_string_bytes(right);
+            
+            if (left_bytes) {
+                memcpy(buffer + offset, left_bytes, left->length);
+                node = right;
+                offset = right_offset;
+            } else if (right_bytes) {
+                memcpy(buffer + right_offset, right_bytes, right->length);
+                node = left;
+            } else {
+                if (stack_count == stack_capacity) {
+                    int new_capacity = stack_capacity * 2;
+                    ember_string** new_nodes = realloc(nodes, sizeof(ember_string*) * new_capacity);
+                    if (new_nodes) nodes = new_nodes;
+                    int* new_offsets = new_nodes ? realloc(offsets, sizeof(int) * new_capacity) : NULL;
+                    if (!new_offsets) {
+                        free(nodes);
+                        free(offsets);
+                        return 0;
+                    }
+                    offsets = new_offsets;
+                    stack_capacity = new_capacity;
+                }
+                nodes[stack_count] = right;
+                offsets[stack_count] = right_offset;
+                stack_count++;
+                node = left;
+            }
+        }
+        
+        if (node) {
+            memcpy(buffer + offset, ember_string_bytes(node), node->length);
+        }
+        if (stack_count == 0) {
+            break;
+        }
+        stack_count--;
+        node = nodes[stack_count];
+        offset = offsets[stack_count];
+    }
+    
+    free(nodes);
+    free(offsets);
+    return 1;
+}
+
+const char* ember_string_flatten(ember_string* string) {
+    if (!string) return NULL;
+    if (string->chars) return string->chars;
+    
+    char* chars = malloc((size_t)string->length + 1);
+    if (!chars) {
+        fprintf(stderr, "[SECURITY] Memory allocation failed for string of length %d\n", string->length);
+        return NULL;
+    }
+    if (string->right == NULL) {
+        // A slice: one copy out of the parent, which it then stops holding
+        memcpy(chars, string->left->chars + string->slice_start, (size_t)string->length);
+    } else if (!rope_copy_leaves(string, chars)) {
+        fprintf(stderr, "[SECURITY] Memory allocation failed while flattening rope of length %d\n", string->length);
+        free(chars);
+        return NULL;
+    }
+    chars[string->length] = '\0';
+    
+    // Drop the operands so intermediate nodes become collectable
+    string->chars = chars;
+    string->hash = hash_string_chars(chars, string->length);
+    string->left = NULL;
+    string->right = NULL;
+    return chars;
+}
+
+void ember_flatten_string_args(int argc, ember_value* argv) {
+    if (!argv) return;
+    for (int i = 0; i < argc; i++) {
+        if (argv[i].type == EMBER_VAL_STRING && argv[i].as.obj_val &&
+            argv[i].as.obj_val->type == OBJ_STRING) {
+            ember_string_flatten(AS_STRING(argv[i]));
+        }
+    }
+}
+
+// Release a string object; the collector must use this rather than freeing
+// chars directly, since inline strings share one allocation with their header
+void free_object_storage(ember_object* object) {
+    if (object->in_slab) {
+        object_slab_free(object);
+    } else {
+        free(object);
+    }
+}
+
+void free_string_object(ember_string* string) {
+    if (!string) return;
+    if (string->is_mapped) {
+        munmap(string->chars, mapped_string_size(string->length));
+    } else if (string->is_external) {
+        ember_string_external external;
+        memcpy(&external, string->inline_chars, sizeof(external));
+        if (external.release) external.release(string->chars, (size_t)string->length, external.userdata);
+    } else if (!string->is_inline) {
+        free(string->chars);
+    }
+    free_object_storage(&string->obj);
+}
+
 ember_value ember_make_string_gc(ember_vm* vm, const char* str) {
     ember_value value;
     
@@ -137,6 +606,14 @@ ember_value ember_make_string_gc(ember_vm* vm, const char* str) {
     return value;
 }
 
+// Element buffers of a huge page or more back onto huge pages, in VMs that
+// use them; each reallocation may have moved the buffer
+static void advise_grown_elements(ember_vm* vm, ember_array* array, int old_capacity) {
+    if (vm && vm->huge_pages && array->capacity != old_capacity) {
+        huge_pages_advise(array->elements, sizeof(ember_value) * (size_t)array->capacity);
+    }
+}
+
 ember_array* allocate_array(ember_vm* vm, int capacity) {
     if (capacity < 0) {
         fprintf(stderr, "[SECURITY] Invalid array capacity: %d\n", capacity);
@@ -158,6 +635,7 @@ ember_array* allocate_array(ember_vm* vm, int capacity) {
             // Note: object is already linked in VM, will be freed by GC
             return NULL;
         }
+        advise_grown_elements(vm, array, 0);
     } else {
         array->elements = NULL;
     }
@@ -179,32 +657,121 @@ ember_value ember_make_array(ember_vm* vm, int capacity) {
     return value;
 }
 
+// Room for at least min_capacity elements. Capacity grows by half again,
+// or straight to min_capacity when that is more, so n pushes copy O(n)
+// elements in all while a reserve gets exactly what it asked for
+int array_reserve(ember_array* array, int min_capacity) {
+    if (!array || min_capacity < 0) return 0;
+    if (min_capacity <= array->capacity) return 1;
+    
+    // Check for integer overflow
+    int capacity = array->capacity < 8 ? 8 :
+                   array->capacity > INT_MAX - array->capacity / 2 ? INT_MAX :
+                   array->capacity + array->capacity / 2;
+    if (capacity < min_capacity) capacity = min_capacity;
+    if ((size_t)capacity > SIZE_MAX / sizeof(ember_value)) {
+        fprintf(stderr, "[SECURITY] Array capacity overflow prevented\n");
+        return 0;
+    }
+    
+    ember_value* new_elements = realloc(array->elements, sizeof(ember_value) * (size_t)capacity);
+    if (!new_elements) {
+        fprintf(stderr, "[SECURITY] Memory reallocation failed for array (new capacity: %d)\n", capacity);
+        return 0;
+    }
+    array->elements = new_elements;
+    array->capacity = capacity;
+    return 1;
+}
+
+int array_reserve_with_vm(ember_vm* vm, ember_array* array, int min_capacity) {
+    int capacity = array ? array->capacity : 0;
+    if (!array_reserve(array, min_capacity)) return 0;
+    advise_grown_elements(vm, array, capacity);
+    return 1;
+}
+
 void array_push(ember_array* array, ember_value value) {
-    if (!array) return;
+    if (!array || ember_object_is_frozen(array)) return;
     
     if (array->length >= array->capacity) {
-        int old_capacity = array->capacity;
-        
-        // Check for integer overflow
-        if (old_capacity >= INT_MAX / 2) {
+        if (array->length == INT_MAX) {
             fprintf(stderr, "[SECURITY] Array capacity overflow prevented\n");
             return;
         }
-        
-        array->capacity = old_capacity < 8 ? 8 : old_capacity * 2;
-        ember_value* new_elements = realloc(array->elements, sizeof(ember_value) * array->capacity);
-        
-        if (!new_elements) {
-            fprintf(stderr, "[SECURITY] Memory reallocation failed for array (new capacity: %d)\n", array->capacity);
-            array->capacity = old_capacity;  // Restore old capacity
-            return;
-        }
-        
-        array->elements = new_elements;
+        if (!array_reserve(array, array->length + 1)) return;
     }
     array->elements[array->length++] = value;
 }
 
+// Appends all of source (which may be array itself) with one copy
+int array_extend(ember_vm* vm, ember_array* array, ember_array* source) {
+    if (!array || !source || ember_object_is_frozen(array)) return 0;
+    int count = source->length;
+    if (count > INT_MAX - array->length || !array_reserve_with_vm(vm, array, array->length + count)) return 0;
+    
+    // Read source->elements after the reserve: for array itself it moved
+    if (count > 0) {
+        memcpy(array->elements + array->length, source->elements, sizeof(ember_value) * (size_t)count);
+    }
+    ember_value* added = array->elements + array->length;
+    array->length += count;
+    for (int i = 0; i < count; i++) {
+        gc_write_barrier_helper(vm, (ember_object*)array, ember_make_nil(), added[i]);
+    }
+    return 1;
+}
+
+// Removes delete_count elements at start and puts item_count items there,
+// moving the tail once. The removed elements go to *removed, a new array,
+// when it is given; start and delete_count must already be in range
+int array_splice(ember_vm* vm, ember_array* array, int start, int delete_count, const ember_value* items,
+                 int item_count, ember_value* removed) {
+    if (!array || ember_object_is_frozen(array) || start < 0 || delete_count < 0 || item_count < 0 ||
+        start > array->length || delete_count > array->length - start ||
+        item_count - delete_count > INT_MAX - array->length) {
+        return 0;
+    }
+    int length = array->length + item_count - delete_count;
+    if (removed) {
+        // Before anything moves, so a failure leaves the array as it was
+        *removed = ember_make_array(vm, delete_count);
+        if (removed->type != EMBER_VAL_ARRAY) return 0;
+        ember_array* taken = AS_ARRAY(*removed);
+        if (delete_count > 0) {
+            memcpy(taken->elements, array->elements + start, sizeof(ember_value) * (size_t)delete_count);
+        }
+        taken->length = delete_count;
+        for (int i = 0; i < delete_count; i++) {
+            gc_write_barrier_helper(vm, (ember_object*)taken, ember_make_nil(), taken->elements[i]);
+        }
+    }
+    if (!array_reserve_with_vm(vm, array, length)) return 0;
+    
+    int tail = array->length - start - delete_count;
+    if (tail > 0 && item_count != delete_count) {
+        memmove(array->elements + start + item_count, array->elements + start + delete_count,
+                sizeof(ember_value) * (size_t)tail);
+    }
+    if (item_count > 0) {
+        memcpy(array->elements + start, items, sizeof(ember_value) * (size_t)item_count);
+    }
+    array->length = length;
+    for (int i = 0; i < item_count; i++) {
+        gc_write_barrier_helper(vm, (ember_object*)array, ember_make_nil(), items[i]);
+    }
+    return 1;
+}
+
+// VM-aware array push with write barrier
+void array_push_with_vm(ember_vm* vm, ember_array* array, ember_value value) {
+    if (!array) return;
+    int capacity = array->capacity;
+    array_push(array, value);
+    advise_grown_elements(vm, array, capacity);
+    gc_write_barrier_helper(vm, (ember_object*)array, ember_make_nil(), value);
+}
+
 // Enhanced hash function for values with comprehensive type support
 uint32_t hash_value(ember_value value) {
     switch (value.type) {
@@ -212,36 +779,21 @@ uint32_t hash_value(ember_value value) {
             return 0;
         case EMBER_VAL_BOOL:
             return value.as.bool_val ? 1 : 0;
-        case EMBER_VAL_NUMBER: {
-            // Robust hash for numbers - handle special cases and precision
-            double d = value.as.number_val;
-            if (d == 0.0) return 0; // Handle +0.0 and -0.0 as same
-            if (d != d) return 2147483647u; // NaN handling
-            
-            union { double d; uint64_t i; } u;
-            u.d = d;
-            // Mix high and low bits for better distribution
-            uint64_t hash64 = u.i;
-            hash64 ^= hash64 >> 32;
-            hash64 *= 0x9e3779b97f4a7c15ULL; // Golden ratio constant
-            return (uint32_t)(hash64 ^ (hash64 >> 32));
-        }
+        case EMBER_VAL_NUMBER:
+            if (value.as.number.is_small) return hash_small_int(value.as.number.small);
+            return hash_number(value.as.number_val);
         case EMBER_VAL_STRING: {
             if (value.as.obj_val) {
                 ember_string* str = AS_STRING(value);
-                if (!str || !str->chars) return 0;
-                
-                // Enhanced FNV-1a with better avalanche properties
-                uint32_t hash = 2166136261u;
-                for (int i = 0; i < str->length; i++) {
-                    hash ^= (uint8_t)str->chars[i];
-                    hash *= 16777619u;
+                if (!str) return 0;
+                const char* bytes = ember_string_bytes(str);
+                if (!str->chars && bytes) {
+                    // A slice hashes its shared bytes; it stays unflattened
+                    if (str->hash == 0) str->hash = hash_string_chars(bytes, str->length);
+                    return str->hash;
                 }
-                // Additional mixing for better distribution
-                hash ^= hash >> 16;
-                hash *= 0x85ebca6b;
-                hash ^= hash >> 13;
-                return hash;
+                if (!ember_string_flatten(str)) return 0;
+                return str->hash;
             }
             return 0;
         }
@@ -285,6 +837,145 @@ uint32_t hash_value(ember_value value) {
     }
 }
 
+// ============================================================================
+// SWISS-TABLE HASH MAP
+// ============================================================================
+//
+// Each slot has a control byte: HASH_CTRL_EMPTY, HASH_CTRL_DELETED, or the low
+// 7 bits of the key hash (h2) when full. Lookups hash once, then scan a whole
+// group of control bytes for h2 in a single SIMD compare and only call
+// values_equal on candidates whose cached 32-bit hash also matches. Groups are
+// probed triangularly over a power-of-two table, so masking replaces modulo.
+
+#define HASH_CTRL_EMPTY   ((uint8_t)0x80)
+#define HASH_CTRL_DELETED ((uint8_t)0xFE)
+#define HASH_GROUP_WIDTH  16
+#define HASH_MIN_CAPACITY 8
+
+#define HASH_H1(hash) ((hash) >> 7)
+#define HASH_H2(hash) ((uint8_t)((hash) & 0x7F))
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+// One mask bit per slot
+#define HASH_MASK_SHIFT 0
+#define HASH_MASK_SLOT  0x1ULL
+
+static inline uint64_t hash_group_match(const uint8_t* ctrl, uint8_t byte) {
+    __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+    return (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)byte)));
+}
+
+static inline uint64_t hash_group_match_empty_or_deleted(const uint8_t* ctrl) {
+    // EMPTY and DELETED are the only control bytes with the high bit set
+    __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+    return (uint64_t)(uint16_t)_mm_movemask_epi8(group);
+}
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+
+// Four mask bits per slot (shift-narrow trick in place of movemask)
+#define HASH_MASK_SHIFT 2
+#define HASH_MASK_SLOT  0xFULL
+
+static inline uint64_t hash_neon_mask(uint8x16_t cmp) {
+    uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+}
+
+static inline uint64_t hash_group_match(const uint8_t* ctrl, uint8_t byte) {
+    return hash_neon_mask(vceqq_u8(vld1q_u8(ctrl), vdupq_n_u8(byte)));
+}
+
+static inline uint64_t hash_group_match_empty_or_deleted(const uint8_t* ctrl) {
+    return hash_neon_mask(vcltq_s8(vreinterpretq_s8_u8(vld1q_u8(ctrl)), vdupq_n_s8(0)));
+}
+#else
+// Portable fallback: one mask bit per slot
+#define HASH_MASK_SHIFT 0
+#define HASH_MASK_SLOT  0x1ULL
+
+static inline uint64_t hash_group_match(const uint8_t* ctrl, uint8_t byte) {
+    uint64_t mask = 0;
+    for (int i = 0; i < HASH_GROUP_WIDTH; i++) {
+        if (ctrl[i] == byte) mask |= 1ULL << i;
+    }
+    return mask;
+}
+
+static inline uint64_t hash_group_match_empty_or_deleted(const uint8_t* ctrl) {
+    uint64_t mask = 0;
+    for (int i = 0; i < HASH_GROUP_WIDTH; i++) {
+        if (ctrl[i] & 0x80) mask |= 1ULL << i;
+    }
+    return mask;
+}
+#endif
+
+#define HASH_MASK_NEXT_SLOT(mask) ((int)(__builtin_ctzll(mask) >> HASH_MASK_SHIFT))
+#define HASH_MASK_CLEAR_SLOT(mask, slot) ((mask) & ~(HASH_MASK_SLOT << ((slot) << HASH_MASK_SHIFT)))
+
+static inline uint64_t hash_group_match_empty(const uint8_t* ctrl) {
+    return hash_group_match(ctrl, HASH_CTRL_EMPTY);
+}
+
+// Tables smaller than one group use a single, partially valid group
+static inline int hash_group_count(int capacity) {
+    return capacity < HASH_GROUP_WIDTH ? 1 : capacity / HASH_GROUP_WIDTH;
+}
+
+static inline uint64_t hash_group_valid_mask(int capacity) {
+    if (capacity >= HASH_GROUP_WIDTH) return ~0ULL;
+    return (1ULL << (capacity << HASH_MASK_SHIFT)) - 1;
+}
+
+static inline int hash_ctrl_size(int capacity) {
+    return capacity < HASH_GROUP_WIDTH ? HASH_GROUP_WIDTH : capacity;
+}
+
+static int round_up_power_of_two(int value) {
+    int result = HASH_MIN_CAPACITY;
+    while (result < value) {
+        if (result >= INT_MAX / 2) return -1;
+        result <<= 1;
+    }
+    return result;
+}
+
+// Maximum number of used (full) slots before the table must grow: 7/8 load
+static inline int hash_max_load(int capacity) {
+    return capacity - capacity / 8;
+}
+
+static int hash_map_alloc_storage(int capacity, ember_hash_entry** entries_out, uint8_t** ctrl_out) {
+    if ((size_t)capacity > SIZE_MAX / sizeof(ember_hash_entry)) {
+        fprintf(stderr, "[SECURITY] Hash map capacity overflow prevented\n");
+        return 0;
+    }
+    
+    ember_hash_entry* entries = malloc(sizeof(ember_hash_entry) * capacity);
+    uint8_t* ctrl = malloc(hash_ctrl_size(capacity));
+    if (!entries || !ctrl) {
+        fprintf(stderr, "[SECURITY] Memory allocation failed for hash map storage (capacity: %d)\n", capacity);
+        free(entries);
+        free(ctrl);
+        return 0;
+    }
+    
+    memset(ctrl, HASH_CTRL_EMPTY, hash_ctrl_size(capacity));
+    for (int i = 0; i < capacity; i++) {
+        entries[i].is_occupied = 0;
+        entries[i].hash = 0;
+        entries[i].key = ember_make_nil();
+        entries[i].value = ember_make_nil();
+    }
+    
+    *entries_out = entries;
+    *ctrl_out = ctrl;
+    return 1;
+}
+
 ember_hash_map* allocate_hash_map(ember_vm* vm, int capacity) {
     ember_hash_map* map = (ember_hash_map*)allocate_object(vm, sizeof(ember_hash_map), OBJ_HASH_MAP);
     if (!map) {
@@ -292,28 +983,23 @@ ember_hash_map* allocate_hash_map(ember_vm* vm, int capacity) {
     }
     
     map->length = 0;
-    map->capacity = capacity > 0 ? capacity : 8;
+    map->tombstones = 0;
+    map->entries = NULL;
+    map->ctrl = NULL;
+    map->capacity = round_up_power_of_two(capacity > 0 ? capacity : HASH_MIN_CAPACITY);
     
-    // Check for integer overflow
-    if ((size_t)map->capacity > SIZE_MAX / sizeof(ember_hash_entry)) {
+    if (map->capacity < 0) {
         fprintf(stderr, "[SECURITY] Hash map capacity overflow prevented\n");
+        map->capacity = 0;
         return NULL;
     }
     
-    map->entries = malloc(sizeof(ember_hash_entry) * map->capacity);
-    if (!map->entries) {
-        fprintf(stderr, "[SECURITY] Memory allocation failed for hash map entries (capacity: %d)\n", map->capacity);
+    if (!hash_map_alloc_storage(map->capacity, &map->entries, &map->ctrl)) {
         // Note: object is already linked in VM, will be freed by GC
+        map->capacity = 0;
         return NULL;
     }
     
-    // Initialize all entries as unoccupied
-    for (int i = 0; i < map->capacity; i++) {
-        map->entries[i].is_occupied = 0;
-        map->entries[i].key = ember_make_nil();
-        map->entries[i].value = ember_make_nil();
-    }
-    
     return map;
 }
 
@@ -331,88 +1017,222 @@ ember_value ember_make_hash_map(ember_vm* vm, int capacity) {
     return value;
 }
 
-static ember_hash_entry* find_entry(ember_hash_entry* entries, int capacity, ember_value key) {
-    uint32_t index = hash_value(key) % capacity;
+// Locate the slot holding key, or -1 if absent
+static int hash_map_find_slot(ember_hash_map* map, ember_value key, uint32_t hash) {
+    if (!map || !map->ctrl || map->capacity == 0) return -1;
     
-    // Linear probing for collision resolution
-    for (int i = 0; i < capacity; i++) {
-        ember_hash_entry* entry = &entries[index];
+    int group_count = hash_group_count(map->capacity);
+    uint64_t valid = hash_group_valid_mask(map->capacity);
+    uint8_t h2 = HASH_H2(hash);
+    int group = (int)(HASH_H1(hash) & (uint32_t)(group_count - 1));
+    
+    for (int probe = 0; probe < group_count; probe++) {
+        int base = group * HASH_GROUP_WIDTH;
+        const uint8_t* ctrl = map->ctrl + base;
         
-        if (!entry->is_occupied || values_equal(entry->key, key)) {
-            return entry;
+        uint64_t match = hash_group_match(ctrl, h2) & valid;
+        while (match) {
+            int slot = HASH_MASK_NEXT_SLOT(match);
+            ember_hash_entry* entry = &map->entries[base + slot];
+            if (entry->hash == hash && values_equal_fast(entry->key, key)) {
+                return base + slot;
+            }
+            match = HASH_MASK_CLEAR_SLOT(match, slot);
+        }
+        
+        // An empty slot ends the probe chain: the key was never inserted past it
+        if (hash_group_match_empty(ctrl) & valid) {
+            return -1;
         }
         
-        index = (index + 1) % capacity;
+        group = (group + probe + 1) & (group_count - 1);
     }
     
-    return NULL; // Should never happen if capacity > length
+    return -1;
 }
 
-void hash_map_set(ember_hash_map* map, ember_value key, ember_value value) {
-    if (!map) return;
-    
-    // Store old value for write barrier
-    ember_value old_val __attribute__((unused)) = hash_map_get(map, key);
+// First empty or deleted slot on the probe chain for hash
+static int hash_map_find_insert_slot(uint8_t* ctrl_bytes, int capacity, uint32_t hash) {
+    int group_count = hash_group_count(capacity);
+    uint64_t valid = hash_group_valid_mask(capacity);
+    int group = (int)(HASH_H1(hash) & (uint32_t)(group_count - 1));
     
-    // Resize if load factor > 0.75
-    if (map->length + 1 > map->capacity * 0.75) {
-        int old_capacity = map->capacity;
-        ember_hash_entry* old_entries = map->entries;
-        
-        // Check for integer overflow
-        if (map->capacity >= INT_MAX / 2) {
-            fprintf(stderr, "[SECURITY] Hash map capacity overflow prevented\n");
-            return;
+    for (int probe = 0; probe < group_count; probe++) {
+        int base = group * HASH_GROUP_WIDTH;
+        uint64_t free_slots = hash_group_match_empty_or_deleted(ctrl_bytes + base) & valid;
+        if (free_slots) {
+            return base + HASH_MASK_NEXT_SLOT(free_slots);
         }
+        group = (group + probe + 1) & (group_count - 1);
+    }
+    
+    return -1;
+}
+
+// Rebuild the table at new_capacity, reusing cached hashes (no rehash or key comparison)
+static int hash_map_resize(ember_hash_map* map, int new_capacity) {
+    ember_hash_entry* new_entries;
+    uint8_t* new_ctrl;
+    
+    if (!hash_map_alloc_storage(new_capacity, &new_entries, &new_ctrl)) {
+        return 0;
+    }
+    
+    for (int i = 0; i < map->capacity; i++) {
+        ember_hash_entry* old_entry = &map->entries[i];
+        if (!old_entry->is_occupied) continue;
         
-        map->capacity *= 2;
+        int slot = hash_map_find_insert_slot(new_ctrl, new_capacity, old_entry->hash);
+        new_ctrl[slot] = HASH_H2(old_entry->hash);
+        new_entries[slot] = *old_entry;
+    }
+    
+    free(map->entries);
+    free(map->ctrl);
+    map->entries = new_entries;
+    map->ctrl = new_ctrl;
+    map->capacity = new_capacity;
+    map->tombstones = 0;
+    return 1;
+}
+
+// Purge tombstones without allocating: every full slot is first demoted to
+// DELETED ("unplaced") and every tombstone to EMPTY, then unplaced entries are
+// moved to the first free slot on their probe chain, swapping with any other
+// unplaced entry found there.
+static void hash_map_rehash_in_place(ember_hash_map* map) {
+    int capacity = map->capacity;
+    int group_count = hash_group_count(capacity);
+    
+    for (int i = 0; i < capacity; i++) {
+        map->ctrl[i] = map->entries[i].is_occupied ? HASH_CTRL_DELETED : HASH_CTRL_EMPTY;
+    }
+    
+    for (int i = 0; i < capacity; i++) {
+        if (map->ctrl[i] != HASH_CTRL_DELETED) continue;
         
-        // Check for allocation size overflow
-        if ((size_t)map->capacity > SIZE_MAX / sizeof(ember_hash_entry)) {
-            fprintf(stderr, "[SECURITY] Hash map allocation size overflow prevented\n");
-            map->capacity = old_capacity;
-            return;
-        }
+        uint32_t hash = map->entries[i].hash;
+        int target = hash_map_find_insert_slot(map->ctrl, capacity, hash);
         
-        ember_hash_entry* new_entries = malloc(sizeof(ember_hash_entry) * map->capacity);
-        if (!new_entries) {
-            fprintf(stderr, "[SECURITY] Memory allocation failed for hash map resize (new capacity: %d)\n", map->capacity);
-            map->capacity = old_capacity;
-            return;
+        // Lookups scan whole groups, so staying anywhere in the target's group is enough
+        if (group_count == 1 || target / HASH_GROUP_WIDTH == i / HASH_GROUP_WIDTH) {
+            map->ctrl[i] = HASH_H2(hash);
+            continue;
         }
         
-        map->entries = new_entries;
-        map->length = 0;
-        
-        // Initialize new entries
-        for (int i = 0; i < map->capacity; i++) {
+        if (map->ctrl[target] == HASH_CTRL_EMPTY) {
+            map->entries[target] = map->entries[i];
+            map->ctrl[target] = HASH_H2(hash);
+            map->ctrl[i] = HASH_CTRL_EMPTY;
             map->entries[i].is_occupied = 0;
             map->entries[i].key = ember_make_nil();
             map->entries[i].value = ember_make_nil();
+        } else {
+            // Target holds another unplaced entry: swap and re-process slot i
+            ember_hash_entry displaced = map->entries[target];
+            map->entries[target] = map->entries[i];
+            map->entries[i] = displaced;
+            map->ctrl[target] = HASH_H2(hash);
+            i--;
         }
-        
-        // Rehash existing entries
-        for (int i = 0; i < old_capacity; i++) {
-            if (old_entries[i].is_occupied) {
-                hash_map_set(map, old_entries[i].key, old_entries[i].value);
-            }
-        }
-        
-        free(old_entries);
     }
     
-    ember_hash_entry* entry = find_entry(map->entries, map->capacity, key);
-    if (entry) {
-        int is_new_key = !entry->is_occupied;
-        entry->key = key;
-        entry->value = value;
-        entry->is_occupied = 1;
-        
-        if (is_new_key) {
-            map->length++;
-        }
-        
+    map->tombstones = 0;
+}
+
+// Make room for one more insertion: purge tombstones when they are what fills
+// the table, otherwise double the capacity
+static int hash_map_reserve_one(ember_hash_map* map) {
+    if (map->length + map->tombstones + 1 <= hash_max_load(map->capacity)) {
+        return 1;
+    }
+    
+    if (map->tombstones > 0 && map->length + 1 <= hash_max_load(map->capacity) / 2) {
+        hash_map_rehash_in_place(map);
+        return 1;
+    }
+    
+    if (map->capacity >= INT_MAX / 2) {
+        fprintf(stderr, "[SECURITY] Hash map capacity overflow prevented\n");
+        return 0;
+    }
+    return hash_map_resize(map, map->capacity * 2);
+}
+
+// Shrink once the table drops to 1/8 occupancy, landing at roughly half load
+// so a few inserts right after a burst of deletes do not immediately regrow it
+static void hash_map_maybe_shrink(ember_hash_map* map) {
+    if (map->capacity <= HASH_MIN_CAPACITY || map->length > map->capacity / 8) {
+        return;
+    }
+    
+    int new_capacity = round_up_power_of_two(map->length * 2);
+    if (new_capacity > 0 && new_capacity < map->capacity) {
+        hash_map_resize(map, new_capacity);
+    }
+}
+
+// Smallest table that holds count entries under the load bound
+static int hash_capacity_for(int count) {
+    int capacity = HASH_MIN_CAPACITY;
+    while (hash_max_load(capacity) < count) {
+        if (capacity >= INT_MAX / 2) return -1;
+        capacity <<= 1;
     }
+    return capacity;
+}
+
+// Grow (or purge tombstones) once so count entries fit without a resize
+// on the way; for bulk inserts whose size is known up front
+int hash_map_reserve(ember_hash_map* map, int count) {
+    if (!map || !map->ctrl) return 0;
+    if (count + map->tombstones <= hash_max_load(map->capacity)) {
+        return 1;
+    }
+    int capacity = hash_capacity_for(count);
+    if (capacity < 0) {
+        fprintf(stderr, "[SECURITY] Hash map capacity overflow prevented\n");
+        return 0;
+    }
+    return hash_map_resize(map, capacity > map->capacity ? capacity : map->capacity);
+}
+
+// Insert a key known to be absent, its hash already computed (copying
+// between tables reuses the cached one)
+static void hash_map_insert_new(ember_hash_map* map, ember_value key, ember_value value, uint32_t hash) {
+    // Full slots plus tombstones are kept under 7/8 load so every probe chain ends
+    if (!hash_map_reserve_one(map)) {
+        return;
+    }
+    
+    int slot = hash_map_find_insert_slot(map->ctrl, map->capacity, hash);
+    if (slot < 0) {
+        return; // Unreachable while the load factor bound holds
+    }
+    
+    if (map->ctrl[slot] == HASH_CTRL_DELETED) {
+        map->tombstones--;
+    }
+    
+    ember_hash_entry* entry = &map->entries[slot];
+    map->ctrl[slot] = HASH_H2(hash);
+    entry->key = key;
+    entry->value = value;
+    entry->hash = hash;
+    entry->is_occupied = 1;
+    map->length++;
+}
+
+void hash_map_set(ember_hash_map* map, ember_value key, ember_value value) {
+    if (!map || !map->ctrl || ember_object_is_frozen(map)) return;
+    
+    uint32_t hash = hash_value_fast(key);
+    int slot = hash_map_find_slot(map, key, hash);
+    if (slot >= 0) {
+        map->entries[slot].value = value;
+        return;
+    }
+    hash_map_insert_new(map, key, value, hash);
 }
 
 
@@ -426,21 +1246,64 @@ void hash_map_set_with_vm(ember_vm* vm, ember_hash_map* map, ember_value key, em
     // Call the regular hash_map_set
     hash_map_set(map, key, value);
     
-    // Trigger write barrier for GC
+    // Trigger write barrier for GC; a new key is a reference too
     gc_write_barrier_helper(vm, (ember_object*)map, old_val, value);
+    gc_write_barrier_helper(vm, (ember_object*)map, ember_make_nil(), key);
 }
 
 ember_value hash_map_get(ember_hash_map* map, ember_value key) {
-    ember_hash_entry* entry = find_entry(map->entries, map->capacity, key);
-    if (entry && entry->is_occupied) {
-        return entry->value;
+    int slot = hash_map_find_slot(map, key, hash_value_fast(key));
+    if (slot >= 0) {
+        return map->entries[slot].value;
     }
     return ember_make_nil();
 }
 
 int hash_map_has_key(ember_hash_map* map, ember_value key) {
-    ember_hash_entry* entry = find_entry(map->entries, map->capacity, key);
-    return entry && entry->is_occupied;
+    return hash_map_find_slot(map, key, hash_value_fast(key)) >= 0;
+}
+
+// Vacate a full slot without shrinking, so callers may keep scanning entries
+static void hash_map_remove_slot(ember_hash_map* map, int slot) {
+    // A slot whose group still has an empty byte never caused a probe to
+    // continue past it, so it can go straight back to EMPTY; otherwise leave
+    // a tombstone so probe chains passing through this slot stay intact
+    int base = (slot / HASH_GROUP_WIDTH) * HASH_GROUP_WIDTH;
+    if (hash_group_match_empty(map->ctrl + base) & hash_group_valid_mask(map->capacity)) {
+        map->ctrl[slot] = HASH_CTRL_EMPTY;
+    } else {
+        map->ctrl[slot] = HASH_CTRL_DELETED;
+        map->tombstones++;
+    }
+    map->entries[slot].is_occupied = 0;
+    map->entries[slot].key = ember_make_nil();
+    map->entries[slot].value = ember_make_nil();
+    map->length--;
+}
+
+int hash_map_delete(ember_hash_map* map, ember_value key) {
+    if (ember_object_is_frozen(map)) return 0;
+    int slot = hash_map_find_slot(map, key, hash_value_fast(key));
+    if (slot < 0) {
+        return 0;
+    }
+    
+    hash_map_remove_slot(map, slot);
+    hash_map_maybe_shrink(map);
+    return 1;
+}
+
+void hash_map_clear(ember_hash_map* map) {
+    if (!map || !map->ctrl || ember_object_is_frozen(map)) return;
+    
+    memset(map->ctrl, HASH_CTRL_EMPTY, hash_ctrl_size(map->capacity));
+    for (int i = 0; i < map->capacity; i++) {
+        map->entries[i].is_occupied = 0;
+        map->entries[i].key = ember_make_nil();
+        map->entries[i].value = ember_make_nil();
+    }
+    map->length = 0;
+    map->tombstones = 0;
 }
 
 ember_value concatenate_strings(ember_vm* vm, ember_value a, ember_value b) {
@@ -468,6 +1331,46 @@ ember_value concatenate_strings(ember_vm* vm, ember_value a, ember_value b) {
     }
     
     int length = a_string->length + b_string->length;
+    
+    // Strings are immutable, so an empty operand lets the other one be reused
+    if (a_string->length == 0) return b;
+    if (b_string->length == 0) return a;
+    
+    // Long results become rope nodes, so building a string with repeated `+`
+    // is linear overall instead of recopying the prefix every time
+    if (length >= EMBER_ROPE_MIN_LENGTH) {
+        ember_string* rope = allocate_rope(vm, a_string, b_string);
+        if (!rope) {
+            ember_value nil_val;
+            nil_val.type = EMBER_VAL_NIL;
+            return nil_val;
+        }
+        
+        ember_value value;
+        value.type = EMBER_VAL_STRING;
+        value.as.obj_val = (ember_object*)rope;
+        return value;
+    }
+    
+    // Short operands are always flat: a rope never has fewer than EMBER_ROPE_MIN_LENGTH bytes
+    if (length <= EMBER_STRING_INLINE_MAX) {
+        char buffer[EMBER_STRING_INLINE_MAX + 1];
+        memcpy(buffer, a_string->chars, a_string->length);
+        memcpy(buffer + a_string->length, b_string->chars, b_string->length);
+        
+        ember_string* result = allocate_inline_string(vm, buffer, length);
+        if (!result) {
+            ember_value nil_val;
+            nil_val.type = EMBER_VAL_NIL;
+            return nil_val;
+        }
+        
+        ember_value value;
+        value.type = EMBER_VAL_STRING;
+        value.as.obj_val = (ember_object*)result;
+        return value;
+    }
+    
     char* chars = malloc(length + 1);
     
     if (!chars) {
@@ -494,6 +1397,82 @@ ember_value concatenate_strings(ember_vm* vm, ember_value a, ember_value b) {
     return value;
 }
 
+// Text of one interpolation part; numbers are formatted into scratch
+static const char* concat_part_text(ember_value value, char* scratch, size_t scratch_size, int* length) {
+    const char* text;
+    switch (value.type) {
+        case EMBER_VAL_STRING:
+            if (value.as.obj_val) {
+                ember_string* str = AS_STRING(value);
+                text = ember_string_flatten(str);
+                *length = text ? str->length : 0;
+                return text ? text : "";
+            }
+            text = "";
+            break;
+        case EMBER_VAL_NUMBER:
+            *length = snprintf(scratch, scratch_size, "%g", value.as.number_val);
+            return scratch;
+        case EMBER_VAL_BOOL:
+            text = value.as.bool_val ? "true" : "false";
+            break;
+        case EMBER_VAL_NIL:
+            text = "nil";
+            break;
+        default:
+            text = value_type_to_string(value.type);
+            break;
+    }
+    *length = (int)strlen(text);
+    return text;
+}
+
+// Join count values into one string, sizing the result exactly up front
+// (used by OP_CONCAT_N for compiled string interpolation)
+ember_value concatenate_values(ember_vm* vm, int count, ember_value* values) {
+    if (!vm || count < 0 || (count > 0 && !values)) {
+        return ember_make_nil();
+    }
+    
+    char scratch[32];
+    int part_length;
+    int total = 0;
+    for (int i = 0; i < count; i++) {
+        concat_part_text(values[i], scratch, sizeof(scratch), &part_length);
+        if (total > INT_MAX - part_length) {
+            fprintf(stderr, "[SECURITY] String concatenation length overflow prevented\n");
+            return ember_make_nil();
+        }
+        total += part_length;
+    }
+    
+    char inline_buffer[EMBER_STRING_INLINE_MAX + 1];
+    char* chars = total <= EMBER_STRING_INLINE_MAX ? inline_buffer : malloc((size_t)total + 1);
+    if (!chars) {
+        fprintf(stderr, "[SECURITY] Memory allocation failed for string concatenation (length: %d)\n", total);
+        return ember_make_nil();
+    }
+    
+    int offset = 0;
+    for (int i = 0; i < count; i++) {
+        const char* text = concat_part_text(values[i], scratch, sizeof(scratch), &part_length);
+        memcpy(chars + offset, text, part_length);
+        offset += part_length;
+    }
+    chars[total] = '\0';
+    
+    ember_string* result = chars == inline_buffer ? copy_string(vm, chars, total)
+                                                  : allocate_string(vm, chars, total);
+    if (!result) {
+        return ember_make_nil();
+    }
+    
+    ember_value value;
+    value.type = EMBER_VAL_STRING;
+    value.as.obj_val = (ember_object*)result;
+    return value;
+}
+
 void free_ember_value(ember_value value) {
     switch (value.type) {
         case EMBER_VAL_STRING:
@@ -571,13 +1550,34 @@ int values_equal(ember_value a, ember_value b) {
             if (a.as.obj_val && b.as.obj_val) {
                 ember_string* a_str = AS_STRING(a);
                 ember_string* b_str = AS_STRING(b);
-                // Optimization: if both strings are interned, we can compare pointers
                 if (a_str == b_str) {
                     return 1;
                 }
-                // Otherwise, compare contents
-                return a_str->length == b_str->length &&
-                       memcmp(a_str->chars, b_str->chars, a_str->length) == 0;
+                // Interned strings are unique per content, so distinct pointers differ
+                if (a_str->is_interned && b_str->is_interned) {
+                    return 0;
+                }
+                if (a_str->length != b_str->length) {
+                    return 0;
+                }
+                // Cached hashes that differ settle it before any bytes are
+                // made; 0 may just not be computed yet
+                if (a_str->hash && b_str->hash && a_str->hash != b_str->hash) {
+                    return 0;
+                }
+                // Otherwise, compare contents (materializing ropes first;
+                // slices compare in place)
+                const char* a_bytes = ember_string_bytes(a_str);
+                const char* b_bytes = ember_string_bytes(b_str);
+                if (!a_bytes) a_bytes = ember_string_flatten(a_str);
+                if (!b_bytes) b_bytes = ember_string_flatten(b_str);
+                if (!a_bytes || !b_bytes) {
+                    return 0;
+                }
+                if (a_str->chars && b_str->chars && a_str->hash != b_str->hash) {
+                    return 0;
+                }
+                return memcmp(a_bytes, b_bytes, a_str->length) == 0;
             }
             return a.as.obj_val == b.as.obj_val;
         case EMBER_VAL_ARRAY:
@@ -635,10 +1635,10 @@ int values_equal(ember_value a, ember_value b) {
                 if (a_map->size != b_map->size) return 0;
                 
                 // Check if all key-value pairs match
-                for (int i = 0; i < a_map->entries->capacity; i++) {
-                    if (a_map->entries->entries[i].is_occupied) {
-                        ember_value b_value = map_get(b_map, a_map->entries->entries[i].key);
-                        if (!values_equal(a_map->entries->entries[i].value, b_value)) {
+                for (int i = 0; i < a_map->count; i++) {
+                    if (a_map->entries[i].is_occupied) {
+                        ember_value b_value = map_get(b_map, a_map->entries[i].key);
+                        if (!values_equal(a_map->entries[i].value, b_value)) {
                             return 0;
                         }
                     }
@@ -674,150 +1674,233 @@ int values_equal(ember_value a, ember_value b) {
         case EMBER_VAL_ITERATOR:
             // Iterators are equal if they are the same object
             return a.as.obj_val == b.as.obj_val;
+        case EMBER_VAL_STRING_BUILDER:
+            // Builders change; only the same builder is equal
+            return a.as.obj_val == b.as.obj_val;
+        case EMBER_VAL_HASHER:
+        case EMBER_VAL_FILE:
+        case EMBER_VAL_WALKER:
+        case EMBER_VAL_TYPED_ARRAY:
+        case EMBER_VAL_CACHE:
+        case EMBER_VAL_DEQUE:
+        case EMBER_VAL_PRIORITY_QUEUE:
+        case EMBER_VAL_WEAK_REF:
+        case EMBER_VAL_WEAK_MAP:
+            return a.as.obj_val == b.as.obj_val;
         default:
             return 0;
     }
 }
 
-void print_value(ember_value value) {
+// Formats into a stack buffer, or the heap for longer text
+static void sink_printf(ember_text_sink sink, void* context, const char* format, ...) {
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (length < 0) return;
+    if ((size_t)length < sizeof(text)) {
+        sink(context, text, (size_t)length);
+        return;
+    }
+    char* long_text = malloc((size_t)length + 1);
+    if (!long_text) return;
+    va_start(args, format);
+    vsnprintf(long_text, (size_t)length + 1, format, args);
+    va_end(args);
+    sink(context, long_text, (size_t)length);
+    free(long_text);
+}
+
+#define SINK_TEXT(text) sink(context, text, sizeof(text) - 1)
+
+void ember_value_write(ember_value value, ember_text_sink sink, void* context) {
     switch (value.type) {
         case EMBER_VAL_NIL:
-            printf("nil");
+            SINK_TEXT("nil");
             break;
         case EMBER_VAL_BOOL:
-            printf(value.as.bool_val ? "true" : "false");
+            if (value.as.bool_val) SINK_TEXT("true");
+            else SINK_TEXT("false");
             break;
         case EMBER_VAL_NUMBER:
-            printf("%.15g", value.as.number_val);
+            sink_printf(sink, context, "%.15g", value.as.number_val);
             break;
         case EMBER_VAL_STRING:
             if (value.as.obj_val) {
-                printf("%s", AS_CSTRING(value));
+                const char* chars = AS_CSTRING(value);
+                if (chars) sink(context, chars, strlen(chars));
             } else if (value.as.string_val) {
-                printf("%s", value.as.string_val);
+                sink(context, value.as.string_val, strlen(value.as.string_val));
             }
             break;
         case EMBER_VAL_FUNCTION:
             if (value.as.obj_val && value.as.obj_val->type == OBJ_METHOD) {
-                printf("<bound method>");
+                SINK_TEXT("<bound method>");
             } else {
-                printf("<function %s>", value.as.func_val.name ? value.as.func_val.name : "anonymous");
+                sink_printf(sink, context, "<function %s>", value.as.func_val.name ? value.as.func_val.name : "anonymous");
             }
             break;
         case EMBER_VAL_NATIVE:
-            printf("<native function>");
+            SINK_TEXT("<native function>");
             break;
         case EMBER_VAL_ARRAY: {
             ember_array* array = AS_ARRAY(value);
-            printf("[");
+            SINK_TEXT("[");
             for (int i = 0; i < array->length; i++) {
-                if (i > 0) printf(", ");
-                print_value(array->elements[i]);
+                if (i > 0) SINK_TEXT(", ");
+                ember_value_write(array->elements[i], sink, context);
             }
-            printf("]");
+            SINK_TEXT("]");
             break;
         }
         case EMBER_VAL_HASH_MAP: {
             ember_hash_map* map = AS_HASH_MAP(value);
-            printf("{");
+            SINK_TEXT("{");
             int first = 1;
             for (int i = 0; i < map->capacity; i++) {
                 if (map->entries[i].is_occupied) {
-                    if (!first) printf(", ");
-                    print_value(map->entries[i].key);
-                    printf(": ");
-                    print_value(map->entries[i].value);
+                    if (!first) SINK_TEXT(", ");
+                    ember_value_write(map->entries[i].key, sink, context);
+                    SINK_TEXT(": ");
+                    ember_value_write(map->entries[i].value, sink, context);
                     first = 0;
                 }
             }
-            printf("}");
+            SINK_TEXT("}");
             break;
         }
         case EMBER_VAL_EXCEPTION: {
             ember_exception* exc = AS_EXCEPTION(value);
-            printf("<%s: %s>", 
-                   exc->type_name ? exc->type_name : "Exception", 
-                   exc->message ? exc->message : "");
+            sink_printf(sink, context, "<%s: %s>",
+                        exc->type_name ? exc->type_name : "Exception",
+                        exc->message ? exc->message : "");
             if (exc->file_name && exc->line_number > 0) {
-                printf(" at %s:%d", exc->file_name, exc->line_number);
+                sink_printf(sink, context, " at %s:%d", exc->file_name, exc->line_number);
             }
             break;
         }
         case EMBER_VAL_CLASS: {
             ember_class* klass = AS_CLASS(value);
-            printf("<class %s>", klass->name ? klass->name->chars : "unnamed");
+            sink_printf(sink, context, "<class %s>", klass->name ? klass->name->chars : "unnamed");
             break;
         }
         case EMBER_VAL_INSTANCE: {
             ember_instance* instance = AS_INSTANCE(value);
-            printf("<%s instance>", instance->klass->name ? instance->klass->name->chars : "unnamed");
+            sink_printf(sink, context, "<%s instance>", instance->klass->name ? instance->klass->name->chars : "unnamed");
             break;
         }
         case EMBER_VAL_PROMISE: {
             ember_promise* promise = AS_PROMISE(value);
-            printf("<Promise [%s]>", 
-                   promise->state == PROMISE_PENDING ? "pending" :
-                   promise->state == PROMISE_RESOLVED ? "resolved" : "rejected");
+            sink_printf(sink, context, "<Promise [%s]>",
+                        promise->state == PROMISE_PENDING ? "pending" :
+                        promise->state == PROMISE_RESOLVED ? "resolved" : "rejected");
             break;
         }
         case EMBER_VAL_GENERATOR: {
             ember_generator* generator = AS_GENERATOR(value);
-            printf("<Generator [%s]>",
-                   generator->state == GENERATOR_CREATED ? "created" :
-                   generator->state == GENERATOR_SUSPENDED ? "suspended" : "completed");
+            sink_printf(sink, context, "<Generator [%s]>",
+                        generator->state == GENERATOR_CREATED ? "created" :
+                        generator->state == GENERATOR_SUSPENDED ? "suspended" :
+                        generator->state == GENERATOR_RUNNING ? "running" : "completed");
             break;
         }
         case EMBER_VAL_SET: {
             ember_set* set = AS_SET(value);
-            printf("Set(%d) {", set->size);
+            sink_printf(sink, context, "Set(%d) {", set->size);
             int first = 1;
             for (int i = 0; i < set->elements->capacity; i++) {
                 if (set->elements->entries[i].is_occupied) {
-                    if (!first) printf(", ");
-                    print_value(set->elements->entries[i].key);
+                    if (!first) SINK_TEXT(", ");
+                    ember_value_write(set->elements->entries[i].key, sink, context);
                     first = 0;
                 }
             }
-            printf("}");
+            SINK_TEXT("}");
             break;
         }
         case EMBER_VAL_MAP: {
             ember_map* map = AS_MAP(value);
-            printf("Map(%d) {", map->size);
+            sink_printf(sink, context, "Map(%d) {", map->size);
             int first = 1;
-            for (int i = 0; i < map->entries->capacity; i++) {
-                if (map->entries->entries[i].is_occupied) {
-                    if (!first) printf(", ");
-                    print_value(map->entries->entries[i].key);
-                    printf(" => ");
-                    print_value(map->entries->entries[i].value);
+            for (int i = 0; i < map->count; i++) {
+                if (map->entries[i].is_occupied) {
+                    if (!first) SINK_TEXT(", ");
+                    ember_value_write(map->entries[i].key, sink, context);
+                    SINK_TEXT(" => ");
+                    ember_value_write(map->entries[i].value, sink, context);
                     first = 0;
                 }
             }
-            printf("}");
+            SINK_TEXT("}");
             break;
         }
         case EMBER_VAL_REGEX: {
             ember_regex* regex = AS_REGEX(value);
-            printf("/");
+            SINK_TEXT("/");
             if (regex->pattern) {
-                printf("%s", regex->pattern);
+                sink(context, regex->pattern, strlen(regex->pattern));
             }
-            printf("/");
-            if (regex->flags & REGEX_GLOBAL) printf("g");
-            if (regex->flags & REGEX_CASE_INSENSITIVE) printf("i");
-            if (regex->flags & REGEX_MULTILINE) printf("m");
-            if (regex->flags & REGEX_DOTALL) printf("s");
+            SINK_TEXT("/");
+            if (regex->flags & REGEX_GLOBAL) SINK_TEXT("g");
+            if (regex->flags & REGEX_CASE_INSENSITIVE) SINK_TEXT("i");
+            if (regex->flags & REGEX_MULTILINE) SINK_TEXT("m");
+            if (regex->flags & REGEX_DOTALL) SINK_TEXT("s");
             break;
         }
         case EMBER_VAL_ITERATOR: {
             ember_iterator* iterator = AS_ITERATOR(value);
-            printf("<Iterator [type: %d, index: %d]>", iterator->type, iterator->index);
+            sink_printf(sink, context, "<Iterator [type: %d, index: %d]>", iterator->type, iterator->index);
             break;
         }
+        case EMBER_VAL_STRING_BUILDER:
+            sink_printf(sink, context, "<StringBuilder [%zu bytes]>", AS_STRING_BUILDER(value)->length);
+            break;
+        case EMBER_VAL_HASHER:
+            sink_printf(sink, context, "<Hasher [%llu bytes%s]>", (unsigned long long)AS_HASHER(value)->length,
+                        AS_HASHER(value)->finished ? ", digested" : "");
+            break;
+        case EMBER_VAL_FILE:
+            if (AS_FILE(value)->fd >= 0) sink_printf(sink, context, "<File fd=%d>", AS_FILE(value)->fd);
+            else SINK_TEXT("<File closed>");
+            break;
+        case EMBER_VAL_WALKER:
+            sink_printf(sink, context, "<Walker%s>", AS_WALKER(value)->state ? "" : " released");
+            break;
+        case EMBER_VAL_TYPED_ARRAY: {
+            static const char* names[] = {"Float64Array", "Int32Array", "Uint8Array"};
+            sink_printf(sink, context, "<%s length=%d>", names[AS_TYPED_ARRAY(value)->kind], AS_TYPED_ARRAY(value)->length);
+            break;
+        }
+        case EMBER_VAL_CACHE:
+            sink_printf(sink, context, "<Cache size=%d>", AS_CACHE(value)->size);
+            break;
+        case EMBER_VAL_DEQUE:
+            sink_printf(sink, context, "<Deque length=%d>", AS_DEQUE(value)->length);
+            break;
+        case EMBER_VAL_PRIORITY_QUEUE:
+            sink_printf(sink, context, "<PriorityQueue length=%d>", AS_PRIORITY_QUEUE(value)->length);
+            break;
+        case EMBER_VAL_WEAK_REF:
+            sink_printf(sink, context, "<WeakRef%s>",
+                        AS_WEAK_REF(value)->target.type == EMBER_VAL_NIL ? " collected" : "");
+            break;
+        case EMBER_VAL_WEAK_MAP:
+            sink_printf(sink, context, "<WeakMap size=%d>", AS_WEAK_MAP(value)->count);
+            break;
     }
 }
 
+static void write_stdout(void* context, const char* text, size_t length) {
+    (void)context;
+    fwrite(text, 1, length, stdout);
+}
+
+void print_value(ember_value value) {
+    ember_value_write(value, write_stdout, NULL);
+}
+
 ember_value ember_make_exception(ember_vm* vm, const char* type, const char* message) {
     ember_exception* exc = (ember_exception*)allocate_object(vm, sizeof(ember_exception), OBJ_EXCEPTION);
     if (!exc) {
@@ -851,6 +1934,8 @@ ember_value ember_make_exception(ember_vm* vm, const char* type, const char* mes
     exc->file_name = NULL;
     exc->stack_frames = NULL;
     exc->stack_frame_count = 0;
+    exc->trace = NULL;
+    exc->trace_count = 0;
     exc->cause = ember_make_nil();
     exc->data = ember_make_nil();
     exc->suppressed_count = 0;
@@ -905,6 +1990,8 @@ ember_value ember_make_exception_detailed(ember_vm* vm, ember_exception_type typ
     // Initialize stack trace
     exc->stack_frames = NULL;
     exc->stack_frame_count = 0;
+    exc->trace = NULL;
+    exc->trace_count = 0;
     
     // Initialize other fields
     exc->cause = ember_make_nil();
@@ -991,8 +2078,9 @@ const char* ember_exception_type_to_string(ember_exception_type type) {
 void ember_exception_add_stack_frame(ember_vm* vm, ember_exception* exc, const char* function_name, 
                                      const char* file_name, int line_number, int column_number, 
                                      uint8_t* instruction_ptr) {
-    (void)vm; // Currently unused
     if (!exc) return;
+    // Frames added by hand go after the ones captured at throw time
+    ember_exception_symbolize(vm, exc);
     
     // Reallocate stack frames array
     exc->stack_frames = realloc(exc->stack_frames, sizeof(ember_stack_frame) * (exc->stack_frame_count + 1));
@@ -1063,23 +2151,72 @@ void ember_exception_add_suppressed(ember_vm* vm, ember_exception* exc, ember_va
     exc->suppressed_count++;
 }
 
-// Capture the current stack trace
+// Capture the current stack trace. Only the (chunk, offset) of each active
+// frame is recorded, in one allocation: exceptions used for control flow are
+// rarely asked for their trace, so names are looked up when it is read.
 void ember_capture_stack_trace(ember_vm* vm, ember_exception* exc) {
-    if (!vm || !exc) return;
+    if (!vm || !exc || !vm->chunk || exc->trace || exc->stack_frame_count > 0) return;
+    
+    int count = vm->frame_count + 1;
+    exc->trace = malloc(sizeof(ember_trace_entry) * (size_t)count);
+    if (!exc->trace) {
+        fprintf(stderr, "[SECURITY] Memory allocation failed for stack trace\n");
+        return;
+    }
     
-    // Add current call stack frames
-    for (int i = vm->call_stack_depth - 1; i >= 0; i--) {
-        ember_call_frame* frame = &vm->call_stack[i];
-        ember_exception_add_stack_frame(vm, exc, frame->function_name, 
-                                       frame->location.filename,
-                                       frame->location.line,
-                                       frame->location.column,
-                                       frame->instruction_pointer);
+    // ip is past the instruction that threw; return addresses are past the call
+    ember_chunk* chunk = vm->chunk;
+    int offset = vm->ip && vm->ip > chunk->code ? (int)(vm->ip - chunk->code) - 1 : 0;
+    exc->trace[0].chunk = chunk;
+    exc->trace[0].offset = offset;
+    for (int i = vm->frame_count - 1; i >= 0; i--) {
+        ember_frame* frame = &vm->frames[i];
+        ember_trace_entry* entry = &exc->trace[vm->frame_count - i];
+        entry->chunk = frame->chunk;
+        entry->offset = frame->chunk && frame->return_ip > frame->chunk->code
+                            ? (int)(frame->return_ip - frame->chunk->code) - 1 : 0;
     }
+    exc->trace_count = count;
+}
+
+// Name of the global function whose body is chunk, if any
+static const char* trace_function_name(ember_vm* vm, ember_chunk* chunk) {
+    if (!vm || !chunk) return NULL;
+    for (int i = 0; i < vm->global_count; i++) {
+        ember_value value = vm->globals[i].value;
+        if (value.type == EMBER_VAL_FUNCTION && !IS_BOUND_METHOD(value) &&
+            value.as.func_val.chunk == chunk) {
+            return value.as.func_val.name ? value.as.func_val.name : vm->globals[i].key;
+        }
+    }
+    return NULL;
+}
+
+void ember_exception_symbolize(ember_vm* vm, ember_exception* exc) {
+    if (!exc || !exc->trace) return;
+    
+    ember_trace_entry* trace = exc->trace;
+    int count = exc->trace_count;
+    exc->trace = NULL;
+    exc->trace_count = 0;
+    for (int i = 0; i < count; i++) {
+        const char* name = trace_function_name(vm, trace[i].chunk);
+        if (!name) {
+            // Only the outermost entry runs top-level code
+            name = i == count - 1 ? "<script>" : "<anonymous>";
+        }
+        // Positions come from the chunk's line table, decoded on first use
+        int column = 0;
+        int line = ember_chunk_position_at(trace[i].chunk, trace[i].offset, &column);
+        ember_exception_add_stack_frame(vm, exc, name, NULL, line, column,
+                                        trace[i].chunk ? trace[i].chunk->code + trace[i].offset : NULL);
+    }
+    free(trace);
 }
 
 // Get stack trace as a formatted string
 ember_value ember_exception_get_stack_trace_string(ember_vm* vm, ember_exception* exc) {
+    ember_exception_symbolize(vm, exc);
     if (!exc || exc->stack_frame_count == 0) {
         return ember_make_string_gc(vm, "No stack trace available");
     }
@@ -1138,6 +2275,7 @@ void ember_print_exception_details(ember_vm* vm, ember_exception* exc) {
     }
     
     // Print stack trace
+    ember_exception_symbolize(vm, exc);
     if (exc->stack_frame_count > 0) {
         printf("Stack trace:\n");
         for (int i = 0; i < exc->stack_frame_count; i++) {
@@ -1199,26 +2337,151 @@ ember_value ember_get_root_cause(ember_value exception) {
     return result;
 }
 
-// String interning stubs (simplified implementation for now)
+// String interning
+//
+// vm->string_intern_table maps each interned ember_string (key) to nil. The
+// table is allocated outside vm->objects, so the collector never traces it and
+// its keys are weak: sweep_string_intern_table() drops unmarked strings before
+// they are freed.
+
 void init_string_intern_table(ember_vm* vm) {
-    // Placeholder - string interning disabled for now
-    if (vm) vm->string_intern_table = NULL;
+    if (!vm || vm->string_intern_table) return;
+    
+    ember_hash_map* table = (ember_hash_map*)malloc(sizeof(ember_hash_map));
+    if (!table) {
+        fprintf(stderr, "[SECURITY] Memory allocation failed for string intern table\n");
+        return;
+    }
+    
+    table->obj.type = OBJ_HASH_MAP;
+    table->obj.is_marked = 0;
+    table->obj.in_slab = 0;
+    table->obj.next = NULL;
+    table->length = 0;
+    table->tombstones = 0;
+    table->capacity = 64;
+    if (!hash_map_alloc_storage(table->capacity, &table->entries, &table->ctrl)) {
+        free(table);
+        return;
+    }
+    
+    vm->string_intern_table = table;
 }
 
 void free_string_intern_table(ember_vm* vm) {
-    // Placeholder - string interning disabled for now
-    if (vm) vm->string_intern_table = NULL;
+    if (!vm || !vm->string_intern_table) return;
+    
+    // The strings themselves belong to the GC object list
+    ember_hash_map* table = vm->string_intern_table;
+    for (int i = 0; i < table->capacity; i++) {
+        if (table->entries[i].is_occupied) {
+            AS_STRING(table->entries[i].key)->is_interned = 0;
+        }
+    }
+    free(table->entries);
+    free(table->ctrl);
+    free(table);
+    vm->string_intern_table = NULL;
 }
 
-ember_string* find_interned_string(ember_vm* vm, const char* chars, int length) {
-    // Placeholder - always return NULL (not found)
-    (void)vm; (void)chars; (void)length;
+// Probe for a string by contents, without allocating a key
+static ember_string* intern_table_lookup(ember_hash_map* table, const char* chars, int length, uint32_t hash) {
+    int group_count = hash_group_count(table->capacity);
+    uint64_t valid = hash_group_valid_mask(table->capacity);
+    uint8_t h2 = HASH_H2(hash);
+    int group = (int)(HASH_H1(hash) & (uint32_t)(group_count - 1));
+    
+    for (int probe = 0; probe < group_count; probe++) {
+        int base = group * HASH_GROUP_WIDTH;
+        const uint8_t* ctrl = table->ctrl + base;
+        
+        uint64_t match = hash_group_match(ctrl, h2) & valid;
+        while (match) {
+            int slot = HASH_MASK_NEXT_SLOT(match);
+            ember_hash_entry* entry = &table->entries[base + slot];
+            if (entry->hash == hash) {
+                ember_string* candidate = AS_STRING(entry->key);
+                if (candidate->length == length && memcmp(candidate->chars, chars, length) == 0) {
+                    return candidate;
+                }
+            }
+            match = HASH_MASK_CLEAR_SLOT(match, slot);
+        }
+        
+        if (hash_group_match_empty(ctrl) & valid) {
+            return NULL;
+        }
+        
+        group = (group + probe + 1) & (group_count - 1);
+    }
+    
     return NULL;
 }
 
-ember_string* intern_string(ember_vm* vm, const char* chars, int length) {
-    // Placeholder - just use regular copy_string for now
-    return copy_string(vm, chars, length);
+ember_string* find_interned_string(ember_vm* vm, const char* chars, int length) {
+    if (!vm || !vm->string_intern_table || !chars || length < 0) {
+        return NULL;
+    }
+    return intern_table_lookup(vm->string_intern_table, chars, length, hash_string_chars(chars, length));
+}
+
+ember_string* intern_string(ember_vm* vm, const char* chars, int length) {
+    if (!vm || !chars || length < 0) {
+        return NULL;
+    }
+    
+    if (!vm->string_intern_table) {
+        init_string_intern_table(vm);
+        if (!vm->string_intern_table) {
+            return copy_string(vm, chars, length);
+        }
+    }
+    
+    ember_hash_map* table = vm->string_intern_table;
+    ember_string* existing = intern_table_lookup(table, chars, length, hash_string_chars(chars, length));
+    if (existing) {
+        return existing;
+    }
+    
+    ember_string* string = copy_string(vm, chars, length);
+    if (!string) {
+        return NULL;
+    }
+    
+    ember_value key;
+    key.type = EMBER_VAL_STRING;
+    key.as.obj_val = (ember_object*)string;
+    int before = table->length;
+    hash_map_set(table, key, ember_make_nil());
+    // Only flag the string once the table really holds it
+    string->is_interned = table->length > before;
+    return string;
+}
+
+void sweep_string_intern_table(ember_vm* vm) {
+    if (!vm || !vm->string_intern_table) return;
+    
+    ember_hash_map* table = vm->string_intern_table;
+    for (int i = 0; i < table->capacity; i++) {
+        ember_hash_entry* entry = &table->entries[i];
+        if (entry->is_occupied && !entry->key.as.obj_val->is_marked) {
+            hash_map_remove_slot(table, i);
+        }
+    }
+    hash_map_maybe_shrink(table);
+}
+
+void sweep_young_string_intern_table(ember_vm* vm) {
+    if (!vm || !vm->string_intern_table) return;
+    
+    ember_hash_map* table = vm->string_intern_table;
+    for (int i = 0; i < table->capacity; i++) {
+        ember_hash_entry* entry = &table->entries[i];
+        if (entry->is_occupied && !entry->key.as.obj_val->is_old && !entry->key.as.obj_val->is_marked) {
+            hash_map_remove_slot(table, i);
+        }
+    }
+    hash_map_maybe_shrink(table);
 }
 
 // OOP Value creation functions
@@ -1228,6 +2491,8 @@ ember_class* allocate_class(ember_vm* vm, const char* name) {
     if (!klass) {
         return NULL;
     }
+    klass->method_cache = NULL;
+    klass->method_cache_epoch = 0;
     
     // Set class name
     klass->name = copy_string(vm, name, strlen(name));
@@ -1244,21 +2509,35 @@ ember_class* allocate_class(ember_vm* vm, const char* name) {
     // No superclass by default
     klass->superclass = NULL;
     
+    // Field layouts are created with the first instance
+    klass->shape_root = NULL;
+    klass->instance_slots_hint = EMBER_INSTANCE_INLINE_MIN;
+    
     return klass;
 }
 
 ember_instance* allocate_instance(ember_vm* vm, ember_class* klass) {
-    ember_instance* instance = (ember_instance*)allocate_object(vm, sizeof(ember_instance), OBJ_INSTANCE);
+    // Sized for as many fields as earlier instances of the class reached
+    int inline_capacity = klass ? klass->instance_slots_hint : EMBER_INSTANCE_INLINE_MIN;
+    if (inline_capacity < EMBER_INSTANCE_INLINE_MIN) inline_capacity = EMBER_INSTANCE_INLINE_MIN;
+    if (inline_capacity > EMBER_INSTANCE_INLINE_MAX) inline_capacity = EMBER_INSTANCE_INLINE_MAX;
+    ember_instance* instance = (ember_instance*)allocate_object(vm, instance_object_size(inline_capacity), OBJ_INSTANCE);
     if (!instance) {
         return NULL;
     }
     
     instance->klass = klass;
-    
-    // Initialize instance fields
-    instance->fields = allocate_hash_map(vm, 8);
-    if (!instance->fields) {
-        return NULL;
+    instance->slots = instance->inline_slots;
+    instance->slot_capacity = inline_capacity;
+    instance->inline_capacity = inline_capacity;
+    instance->fields = NULL;
+    instance->shape = shape_root(klass);
+    if (!instance->shape) {
+        // No layout to share: keep fields in a hash map from the start
+        instance->fields = allocate_hash_map(vm, 8);
+        if (!instance->fields) {
+            return NULL;
+        }
     }
     
     return instance;
@@ -1312,6 +2591,142 @@ ember_value ember_make_bound_method(ember_vm* vm, ember_value receiver, ember_va
     return value;
 }
 
+ember_function* allocate_function(ember_vm* vm, ember_chunk* chunk, const char* name, ember_native_func native) {
+    ember_function* function = (ember_function*)allocate_object(vm, sizeof(ember_function), OBJ_FUNCTION);
+    if (!function) {
+        return NULL;
+    }
+    
+    function->chunk = chunk;
+    function->native = native;
+    function->name = NULL;
+    
+    if (name) {
+        size_t name_len = strlen(name);
+        function->name = malloc(name_len + 1);
+        if (!function->name) {
+            fprintf(stderr, "[SECURITY] Memory allocation failed for function name (length: %zu)\n", name_len);
+            return NULL;
+        }
+        memcpy(function->name, name, name_len + 1);
+    }
+    
+    return function;
+}
+
+ember_value ember_make_function_value(ember_chunk* chunk, const char* name, ember_native_func native) {
+    ember_value value;
+    if (native) {
+        value.type = EMBER_VAL_NATIVE;
+        value.as.native_val = native;
+        return value;
+    }
+    
+    value.type = EMBER_VAL_FUNCTION;
+    value.as.func_val.chunk = chunk;
+    value.as.func_val.name = NULL;
+    if (name) {
+        size_t len = strlen(name);
+        value.as.func_val.name = malloc(len + 1);
+        if (!value.as.func_val.name) {
+            fprintf(stderr, "[SECURITY] Memory allocation failed for function name (length: %zu)\n", len);
+            return ember_make_nil();
+        }
+        memcpy(value.as.func_val.name, name, len + 1);
+    }
+    return value;
+}
+
+#ifdef EMBER_NAN_BOXING
+// Map a heap object back to the value type it was packed from
+static ember_val_type object_value_type(ember_object* object) {
+    switch (object->type) {
+        case OBJ_STRING: return EMBER_VAL_STRING;
+        case OBJ_ARRAY: return EMBER_VAL_ARRAY;
+        case OBJ_HASH_MAP: return EMBER_VAL_HASH_MAP;
+        case OBJ_EXCEPTION: return EMBER_VAL_EXCEPTION;
+        case OBJ_CLASS: return EMBER_VAL_CLASS;
+        case OBJ_INSTANCE: return EMBER_VAL_INSTANCE;
+        case OBJ_METHOD: return EMBER_VAL_FUNCTION;
+        case OBJ_PROMISE: return EMBER_VAL_PROMISE;
+        case OBJ_GENERATOR: return EMBER_VAL_GENERATOR;
+        case OBJ_SET: return EMBER_VAL_SET;
+        case OBJ_MAP: return EMBER_VAL_MAP;
+        case OBJ_REGEX: return EMBER_VAL_REGEX;
+        case OBJ_ITERATOR: return EMBER_VAL_ITERATOR;
+        case OBJ_STRING_BUILDER: return EMBER_VAL_STRING_BUILDER;
+        case OBJ_HASHER: return EMBER_VAL_HASHER;
+        case OBJ_FILE: return EMBER_VAL_FILE;
+        case OBJ_WALKER: return EMBER_VAL_WALKER;
+        case OBJ_TYPED_ARRAY: return EMBER_VAL_TYPED_ARRAY;
+        case OBJ_CACHE: return EMBER_VAL_CACHE;
+        case OBJ_DEQUE: return EMBER_VAL_DEQUE;
+        case OBJ_PRIORITY_QUEUE: return EMBER_VAL_PRIORITY_QUEUE;
+        case OBJ_WEAK_REF: return EMBER_VAL_WEAK_REF;
+        case OBJ_WEAK_MAP: return EMBER_VAL_WEAK_MAP;
+        case OBJ_FUNCTION:
+            return ((ember_function*)object)->native ? EMBER_VAL_NATIVE : EMBER_VAL_FUNCTION;
+    }
+    return EMBER_VAL_NIL;
+}
+
+int ember_value_to_packed(ember_value value, ember_packed_value* packed) {
+    switch (value.type) {
+        case EMBER_VAL_NIL:
+            *packed = EMBER_PACKED_NIL;
+            return 1;
+        case EMBER_VAL_BOOL:
+            *packed = EMBER_PACKED_BOOL(value.as.bool_val);
+            return 1;
+        case EMBER_VAL_NUMBER:
+            *packed = EMBER_PACKED_NUMBER(value.as.number_val);
+            return 1;
+        case EMBER_VAL_FUNCTION:
+            if (!IS_BOUND_METHOD(value)) return 0;
+            *packed = EMBER_PACKED_OBJ(value.as.obj_val);
+            return 1;
+        case EMBER_VAL_NATIVE:
+            return 0;
+        default:
+            if (!value.as.obj_val) return 0;
+            *packed = EMBER_PACKED_OBJ(value.as.obj_val);
+            return 1;
+    }
+}
+
+ember_value ember_value_from_packed(ember_packed_value packed) {
+    ember_value value;
+    
+    if (EMBER_PACKED_IS_NUMBER(packed)) {
+        return ember_make_number(EMBER_PACKED_AS_NUMBER(packed));
+    }
+    if (EMBER_PACKED_IS_BOOL(packed)) {
+        return ember_make_bool(EMBER_PACKED_AS_BOOL(packed));
+    }
+    if (!EMBER_PACKED_IS_OBJ(packed)) {
+        return ember_make_nil();
+    }
+    
+    ember_object* object = EMBER_PACKED_AS_OBJ(packed);
+    value.type = object_value_type(object);
+    
+    if (object->type == OBJ_FUNCTION) {
+        // Name is borrowed from the function object, which owns it
+        ember_function* function = (ember_function*)object;
+        if (function->native) {
+            value.as.native_val = function->native;
+        } else {
+            value.as.func_val.chunk = function->chunk;
+            value.as.func_val.name = function->name;
+        }
+        return value;
+    }
+    
+    value.as.obj_val = object;
+    return value;
+}
+#endif
+
 // Set allocation and creation functions
 ember_set* allocate_set(ember_vm* vm) {
     ember_set* set = (ember_set*)allocate_object(vm, sizeof(ember_set), OBJ_SET);
@@ -1342,19 +2757,102 @@ ember_value ember_make_set(ember_vm* vm) {
 }
 
 // Map allocation and creation functions
+#define MAP_INDEX_EMPTY   (-1)
+#define MAP_INDEX_DELETED (-2)
+#define MAP_MIN_CAPACITY  8
+#define MAP_PERTURB_SHIFT 5
+
+// Index slots for an entries table of the given capacity: a power of two
+// kept at most 2/3 full
+static int map_index_capacity_for(int capacity) {
+    int index_capacity = MAP_MIN_CAPACITY;
+    while (index_capacity < capacity + capacity / 2) {
+        index_capacity <<= 1;
+    }
+    return index_capacity;
+}
+
+// Probe the index for key. Returns its position in entries, or -1 with
+// *insert_slot the index slot a new entry for it should take
+static int map_find(ember_map* map, ember_value key, uint32_t hash, int* insert_slot) {
+    uint32_t mask = (uint32_t)map->index_capacity - 1;
+    uint32_t perturb = hash;
+    uint32_t slot = hash & mask;
+    int first_deleted = -1;
+    
+    // CPython's probe: every slot is visited, and high hash bits take part
+    for (;;) {
+        int32_t position = map->index[slot];
+        if (position == MAP_INDEX_EMPTY) {
+            if (insert_slot) *insert_slot = first_deleted >= 0 ? first_deleted : (int)slot;
+            return -1;
+        }
+        if (position == MAP_INDEX_DELETED) {
+            if (first_deleted < 0) first_deleted = (int)slot;
+        } else {
+            ember_hash_entry* entry = &map->entries[position];
+            if (entry->hash == hash && values_equal_fast(entry->key, key)) {
+                if (insert_slot) *insert_slot = (int)slot;
+                return position;
+            }
+        }
+        perturb >>= MAP_PERTURB_SHIFT;
+        slot = (slot * 5 + 1 + perturb) & mask;
+    }
+}
+
+// Lay the live entries out again, in order and without holes, in a table
+// of the given capacity, and rebuild the index over them
+static int map_rebuild(ember_map* map, int capacity) {
+    if (capacity < MAP_MIN_CAPACITY) capacity = MAP_MIN_CAPACITY;
+    if (capacity > INT_MAX / 2 / (int)sizeof(ember_hash_entry)) return 0;
+    int index_capacity = map_index_capacity_for(capacity);
+    ember_hash_entry* entries = malloc(sizeof(ember_hash_entry) * (size_t)capacity);
+    int32_t* index = malloc(sizeof(int32_t) * (size_t)index_capacity);
+    if (!entries || !index) {
+        free(entries);
+        free(index);
+        return 0;
+    }
+    
+    int count = 0;
+    for (int i = 0; i < map->count; i++) {
+        if (map->entries[i].is_occupied) {
+            entries[count++] = map->entries[i];
+        }
+    }
+    free(map->entries);
+    free(map->index);
+    map->entries = entries;
+    map->index = index;
+    map->count = count;
+    map->capacity = capacity;
+    map->index_capacity = index_capacity;
+    
+    memset(index, 0xff, sizeof(int32_t) * (size_t)index_capacity);  // MAP_INDEX_EMPTY
+    for (int i = 0; i < count; i++) {
+        int slot;
+        map_find(map, entries[i].key, entries[i].hash, &slot);
+        index[slot] = i;
+    }
+    return 1;
+}
+
 ember_map* allocate_map(ember_vm* vm) {
     ember_map* map = (ember_map*)allocate_object(vm, sizeof(ember_map), OBJ_MAP);
     if (!map) {
         return NULL;
     }
     
-    // Initialize with internal hash map for key-value storage
-    map->entries = allocate_hash_map(vm, 8);
-    if (!map->entries) {
+    map->entries = NULL;
+    map->index = NULL;
+    map->count = 0;
+    map->capacity = 0;
+    map->index_capacity = 0;
+    map->size = 0;
+    if (!map_rebuild(map, MAP_MIN_CAPACITY)) {
         return NULL;
     }
-    
-    map->size = 0;
     return map;
 }
 
@@ -1372,14 +2870,10 @@ ember_value ember_make_map(ember_vm* vm) {
 
 // Set operation functions
 int set_add(ember_set* set, ember_value element) {
-    if (!set) return 0;
-    
-    // Check if element already exists
-    if (hash_map_has_key(set->elements, element)) {
-        return 1; // Element already exists, no change
-    }
+    if (!set || ember_object_is_frozen(set)) return 0;
     
-    // Add element using itself as both key and value (Set behavior)
+    // Add element using itself as both key and value (Set behavior);
+    // re-adding an existing element only overwrites it in place
     hash_map_set(set->elements, element, element);
     set->size = set->elements->length;
     return 1;
@@ -1391,97 +2885,92 @@ int set_has(ember_set* set, ember_value element) {
 }
 
 int set_delete(ember_set* set, ember_value element) {
-    if (!set) return 0;
+    if (!set || ember_object_is_frozen(set)) return 0;
     
-    if (!hash_map_has_key(set->elements, element)) {
+    if (!hash_map_delete(set->elements, element)) {
         return 0; // Element doesn't exist
     }
     
-    // Find and remove the element
-    ember_hash_entry* entry = find_entry(set->elements->entries, set->elements->capacity, element);
-    if (entry && entry->is_occupied) {
-        entry->is_occupied = 0;
-        entry->key = ember_make_nil();
-        entry->value = ember_make_nil();
-        set->elements->length--;
-        set->size = set->elements->length;
-        return 1;
-    }
-    
-    return 0;
+    set->size = set->elements->length;
+    return 1;
 }
 
 void set_clear(ember_set* set) {
-    if (!set) return;
-    
-    // Clear all entries
-    for (int i = 0; i < set->elements->capacity; i++) {
-        set->elements->entries[i].is_occupied = 0;
-        set->elements->entries[i].key = ember_make_nil();
-        set->elements->entries[i].value = ember_make_nil();
-    }
+    if (!set || ember_object_is_frozen(set)) return;
     
-    set->elements->length = 0;
+    hash_map_clear(set->elements);
     set->size = 0;
 }
 
 // Map operation functions
 int map_set(ember_map* map, ember_value key, ember_value value) {
-    if (!map) return 0;
-    
-    int had_key = hash_map_has_key(map->entries, key);
-    hash_map_set(map->entries, key, value);
+    if (!map || ember_object_is_frozen(map)) return 0;
+    
+    uint32_t hash = hash_value_fast(key);
+    int slot;
+    int position = map_find(map, key, hash, &slot);
+    if (position >= 0) {
+        // Overwriting keeps the key where it was in insertion order
+        map->entries[position].value = value;
+        return 1;
+    }
     
-    if (!had_key) {
-        map->size = map->entries->length;
+    if (map->count == map->capacity) {
+        // Out of room: squeeze out the holes, growing only if mostly live
+        int capacity = map->size >= map->capacity / 2 ? map->capacity * 2 : map->capacity;
+        if (!map_rebuild(map, capacity)) return 0;
+        map_find(map, key, hash, &slot);
     }
     
+    ember_hash_entry* entry = &map->entries[map->count];
+    entry->key = key;
+    entry->value = value;
+    entry->hash = hash;
+    entry->is_occupied = 1;
+    map->index[slot] = map->count++;
+    map->size++;
     return 1;
 }
 
 ember_value map_get(ember_map* map, ember_value key) {
     if (!map) return ember_make_nil();
-    return hash_map_get(map->entries, key);
+    int position = map_find(map, key, hash_value_fast(key), NULL);
+    return position >= 0 ? map->entries[position].value : ember_make_nil();
 }
 
 int map_has(ember_map* map, ember_value key) {
     if (!map) return 0;
-    return hash_map_has_key(map->entries, key);
+    return map_find(map, key, hash_value_fast(key), NULL) >= 0;
 }
 
 int map_delete(ember_map* map, ember_value key) {
-    if (!map) return 0;
+    if (!map || ember_object_is_frozen(map)) return 0;
     
-    if (!hash_map_has_key(map->entries, key)) {
+    int slot;
+    int position = map_find(map, key, hash_value_fast(key), &slot);
+    if (position < 0) {
         return 0; // Key doesn't exist
     }
     
-    // Find and remove the key-value pair
-    ember_hash_entry* entry = find_entry(map->entries->entries, map->entries->capacity, key);
-    if (entry && entry->is_occupied) {
-        entry->is_occupied = 0;
-        entry->key = ember_make_nil();
-        entry->value = ember_make_nil();
-        map->entries->length--;
-        map->size = map->entries->length;
-        return 1;
-    }
+    // Leave a hole so later entries keep their positions for the index
+    map->index[slot] = MAP_INDEX_DELETED;
+    map->entries[position].is_occupied = 0;
+    map->entries[position].key = ember_make_nil();
+    map->entries[position].value = ember_make_nil();
+    map->size--;
     
-    return 0;
+    if (map->capacity > MAP_MIN_CAPACITY && map->size < map->capacity / 8) {
+        map_rebuild(map, map->size * 2);
+    }
+    return 1;
 }
 
 void map_clear(ember_map* map) {
-    if (!map) return;
-    
-    // Clear all entries
-    for (int i = 0; i < map->entries->capacity; i++) {
-        map->entries->entries[i].is_occupied = 0;
-        map->entries->entries[i].key = ember_make_nil();
-        map->entries->entries[i].value = ember_make_nil();
-    }
+    if (!map || ember_object_is_frozen(map)) return;
     
-    map->entries->length = 0;
+    map->count = 0;
     map->size = 0;
+    memset(map->index, 0xff, sizeof(int32_t) * (size_t)map->index_capacity);  // MAP_INDEX_EMPTY
 }
 
 // Enhanced Map methods for comprehensive functionality
@@ -1499,9 +2988,9 @@ ember_value map_keys(ember_vm* vm, ember_map* map) {
     }
     
     // Collect all keys
-    for (int i = 0; i < map->entries->capacity; i++) {
-        if (map->entries->entries[i].is_occupied) {
-            keys_array->elements[keys_array->length++] = map->entries->entries[i].key;
+    for (int i = 0; i < map->count; i++) {
+        if (map->entries[i].is_occupied) {
+            keys_array->elements[keys_array->length++] = map->entries[i].key;
         }
     }
     
@@ -1525,9 +3014,9 @@ ember_value map_values(ember_vm* vm, ember_map* map) {
     }
     
     // Collect all values
-    for (int i = 0; i < map->entries->capacity; i++) {
-        if (map->entries->entries[i].is_occupied) {
-            values_array->elements[values_array->length++] = map->entries->entries[i].value;
+    for (int i = 0; i < map->count; i++) {
+        if (map->entries[i].is_occupied) {
+            values_array->elements[values_array->length++] = map->entries[i].value;
         }
     }
     
@@ -1551,8 +3040,8 @@ ember_value map_entries(ember_vm* vm, ember_map* map) {
     }
     
     // Collect all key-value pairs as [key, value] arrays
-    for (int i = 0; i < map->entries->capacity; i++) {
-        if (map->entries->entries[i].is_occupied) {
+    for (int i = 0; i < map->count; i++) {
+        if (map->entries[i].is_occupied) {
             // Create [key, value] array for each entry
             ember_array* pair = (ember_array*)allocate_object(vm, sizeof(ember_array), OBJ_ARRAY);
             if (!pair) continue;
@@ -1562,8 +3051,8 @@ ember_value map_entries(ember_vm* vm, ember_map* map) {
             pair->elements = malloc(sizeof(ember_value) * 2);
             if (!pair->elements) continue;
             
-            pair->elements[0] = map->entries->entries[i].key;
-            pair->elements[1] = map->entries->entries[i].value;
+            pair->elements[0] = map->entries[i].key;
+            pair->elements[1] = map->entries[i].value;
             
             ember_value pair_value;
             pair_value.type = EMBER_VAL_ARRAY;
@@ -1606,74 +3095,94 @@ ember_value set_to_array(ember_vm* vm, ember_set* set) {
     return result;
 }
 
+// Set algebra. Results are sized for their largest possible outcome up
+// front, so filling them never rehashes, and elements move between tables
+// with their cached hashes: nothing is hashed twice. Lookups go into the
+// larger operand wherever the result allows
+
+static ember_value set_value(ember_set* set) {
+    if (!set) return ember_make_nil();
+    ember_value value;
+    value.type = EMBER_VAL_SET;
+    value.as.obj_val = (ember_object*)set;
+    return value;
+}
+
+// A set whose table holds count elements without growing
+static ember_set* allocate_set_sized(ember_vm* vm, int count) {
+    int capacity = hash_capacity_for(count);
+    if (capacity < 0) return NULL;
+    if (vm->stack_top >= EMBER_STACK_MAX) return NULL;
+    ember_set* set = (ember_set*)allocate_object(vm, sizeof(ember_set), OBJ_SET);
+    if (!set) return NULL;
+    set->size = 0;
+    set->elements = NULL;
+    // Rooted while its table is allocated
+    vm->stack[vm->stack_top++] = set_value(set);
+    set->elements = allocate_hash_map(vm, capacity);
+    vm->stack_top--;
+    return set->elements ? set : NULL;
+}
+
+static inline int set_entry_in(ember_set* set, const ember_hash_entry* entry) {
+    return hash_map_find_slot(set->elements, entry->key, entry->hash) >= 0;
+}
+
+static void set_insert_entry(ember_vm* vm, ember_set* set, const ember_hash_entry* entry) {
+    hash_map_insert_new(set->elements, entry->key, entry->key, entry->hash);
+    set->size = set->elements->length;
+    gc_write_barrier_helper(vm, (ember_object*)set->elements, ember_make_nil(), entry->key);
+}
+
+#define SET_FOR_EACH(set, entry) \
+    for (ember_hash_entry* entry = (set)->elements->entries; \
+         entry < (set)->elements->entries + (set)->elements->capacity; entry++) \
+        if (entry->is_occupied)
+
 ember_value set_union(ember_vm* vm, ember_set* set1, ember_set* set2) {
     if (!set1 || !set2 || !vm) return ember_make_nil();
+    ember_set* larger = set1->size >= set2->size ? set1 : set2;
+    ember_set* smaller = larger == set1 ? set2 : set1;
     
-    ember_set* result_set = allocate_set(vm);
+    ember_set* result_set = allocate_set_sized(vm, set1->size + set2->size);
     if (!result_set) return ember_make_nil();
     
-    // Add all elements from set1
-    for (int i = 0; i < set1->elements->capacity; i++) {
-        if (set1->elements->entries[i].is_occupied) {
-            set_add(result_set, set1->elements->entries[i].key);
-        }
+    // The larger set goes in without lookups: its elements are distinct
+    SET_FOR_EACH(larger, entry) {
+        set_insert_entry(vm, result_set, entry);
     }
-    
-    // Add all elements from set2
-    for (int i = 0; i < set2->elements->capacity; i++) {
-        if (set2->elements->entries[i].is_occupied) {
-            set_add(result_set, set2->elements->entries[i].key);
-        }
+    SET_FOR_EACH(smaller, entry) {
+        if (!set_entry_in(result_set, entry)) set_insert_entry(vm, result_set, entry);
     }
-    
-    ember_value result;
-    result.type = EMBER_VAL_SET;
-    result.as.obj_val = (ember_object*)result_set;
-    return result;
+    return set_value(result_set);
 }
 
 ember_value set_intersection(ember_vm* vm, ember_set* set1, ember_set* set2) {
     if (!set1 || !set2 || !vm) return ember_make_nil();
+    // Walk the smaller set, probing the larger
+    ember_set* larger = set1->size >= set2->size ? set1 : set2;
+    ember_set* smaller = larger == set1 ? set2 : set1;
     
-    ember_set* result_set = allocate_set(vm);
+    ember_set* result_set = allocate_set_sized(vm, smaller->size);
     if (!result_set) return ember_make_nil();
     
-    // Add elements that exist in both sets
-    for (int i = 0; i < set1->elements->capacity; i++) {
-        if (set1->elements->entries[i].is_occupied) {
-            ember_value elem = set1->elements->entries[i].key;
-            if (set_has(set2, elem)) {
-                set_add(result_set, elem);
-            }
-        }
+    SET_FOR_EACH(smaller, entry) {
+        if (set_entry_in(larger, entry)) set_insert_entry(vm, result_set, entry);
     }
-    
-    ember_value result;
-    result.type = EMBER_VAL_SET;
-    result.as.obj_val = (ember_object*)result_set;
-    return result;
+    return set_value(result_set);
 }
 
 ember_value set_difference(ember_vm* vm, ember_set* set1, ember_set* set2) {
     if (!set1 || !set2 || !vm) return ember_make_nil();
     
-    ember_set* result_set = allocate_set(vm);
+    ember_set* result_set = allocate_set_sized(vm, set1->size);
     if (!result_set) return ember_make_nil();
     
     // Add elements that exist in set1 but not in set2
-    for (int i = 0; i < set1->elements->capacity; i++) {
-        if (set1->elements->entries[i].is_occupied) {
-            ember_value elem = set1->elements->entries[i].key;
-            if (!set_has(set2, elem)) {
-                set_add(result_set, elem);
-            }
-        }
+    SET_FOR_EACH(set1, entry) {
+        if (set2->size == 0 || !set_entry_in(set2, entry)) set_insert_entry(vm, result_set, entry);
     }
-    
-    ember_value result;
-    result.type = EMBER_VAL_SET;
-    result.as.obj_val = (ember_object*)result_set;
-    return result;
+    return set_value(result_set);
 }
 
 int set_is_subset(ember_set* subset, ember_set* superset) {
@@ -1681,267 +3190,296 @@ int set_is_subset(ember_set* subset, ember_set* superset) {
     if (subset->size > superset->size) return 0;
     
     // Check if all elements of subset are in superset
-    for (int i = 0; i < subset->elements->capacity; i++) {
-        if (subset->elements->entries[i].is_occupied) {
-            if (!set_has(superset, subset->elements->entries[i].key)) {
-                return 0;
+    SET_FOR_EACH(subset, entry) {
+        if (!set_entry_in(superset, entry)) return 0;
+    }
+    return 1;
+}
+
+// In place: target gains source's elements. Sized once for the case where
+// they share none
+int set_union_with(ember_vm* vm, ember_set* target, ember_set* source) {
+    if (!vm || !target || !source || ember_object_is_frozen(target)) return 0;
+    if (target == source) return 1;
+    if (!hash_map_reserve(target->elements, target->size + source->size)) return 0;
+    SET_FOR_EACH(source, entry) {
+        if (!set_entry_in(target, entry)) set_insert_entry(vm, target, entry);
+    }
+    return 1;
+}
+
+// In place: target keeps only the elements also in other. Against a much
+// smaller other, the survivors are found by walking other and move into a
+// fresh table sized for them; otherwise target is walked and trimmed
+int set_retain_all(ember_vm* vm, ember_set* target, ember_set* other) {
+    if (!vm || !target || !other || ember_object_is_frozen(target)) return 0;
+    if (target == other) return 1;
+    ember_hash_map* map = target->elements;
+    
+    if (other->size < target->size / 4) {
+        int capacity = hash_capacity_for(other->size);
+        ember_hash_entry* entries;
+        uint8_t* ctrl;
+        if (capacity < 0 || !hash_map_alloc_storage(capacity, &entries, &ctrl)) return 0;
+        int kept = 0;
+        SET_FOR_EACH(other, entry) {
+            int from = hash_map_find_slot(map, entry->key, entry->hash);
+            if (from < 0) continue;
+            int slot = hash_map_find_insert_slot(ctrl, capacity, entry->hash);
+            ctrl[slot] = HASH_H2(entry->hash);
+            entries[slot] = map->entries[from];
+            kept++;
+        }
+        free(map->entries);
+        free(map->ctrl);
+        map->entries = entries;
+        map->ctrl = ctrl;
+        map->capacity = capacity;
+        map->length = kept;
+        map->tombstones = 0;
+    } else {
+        for (int i = 0; i < map->capacity; i++) {
+            if (map->entries[i].is_occupied && !set_entry_in(other, &map->entries[i])) {
+                hash_map_remove_slot(map, i);
             }
         }
+        hash_map_maybe_shrink(map);
     }
-    
+    target->size = map->length;
     return 1;
 }
 
+// A set of array's elements, sized for all of them being distinct
+ember_value set_from_array(ember_vm* vm, ember_array* array) {
+    if (!vm || !array) return ember_make_nil();
+    ember_set* set = allocate_set_sized(vm, array->length);
+    if (!set) return ember_make_nil();
+    for (int i = 0; i < array->length; i++) {
+        ember_hash_entry entry;
+        entry.key = array->elements[i];
+        entry.hash = hash_value_fast(entry.key);
+        if (!set_entry_in(set, &entry)) set_insert_entry(vm, set, &entry);
+    }
+    return set_value(set);
+}
+
+#undef SET_FOR_EACH
+
 // Array enhancement methods for functional programming
+//
+// The callback may be a native or a bytecode function; it is checked once
+// and then run through vm_call_prepared for each element. Its arguments
+// live in one frame of slots reserved on the VM stack, so what they hold
+// stays rooted between calls and nothing is rebuilt per element. A
+// callback that fails stops the loop, leaving vm->exception_pending set
+
+typedef struct {
+    ember_value callback;
+    ember_value* args;       // Reserved slots on vm->stack
+    int argc;
+    int base;                // vm->stack_top before the slots
+} array_callback;
+
+// Reserves argc slots plus extra for the caller's own values; the last
+// argument is always the array
+static int array_callback_begin(ember_vm* vm, array_callback* call, ember_array* array, ember_value callback,
+                                int argc, int extra) {
+    if (!vm || !array || !vm_callable(callback, argc)) return 0;
+    if (vm->stack_top + argc + extra > EMBER_STACK_MAX) {
+        fprintf(stderr, "[CALL] Stack overflow calling array callback\n");
+        return 0;
+    }
+    call->callback = callback;
+    call->argc = argc;
+    call->base = vm->stack_top;
+    call->args = &vm->stack[vm->stack_top];
+    for (int i = 0; i < argc + extra; i++) {
+        call->args[i] = ember_make_nil();
+    }
+    call->args[argc - 1].type = EMBER_VAL_ARRAY;
+    call->args[argc - 1].as.obj_val = (ember_object*)array;
+    vm->stack_top += argc + extra;
+    return 1;
+}
+
+static void array_callback_end(ember_vm* vm, array_callback* call) {
+    vm->stack_top = call->base;
+}
+
+// Calls back with (element, index, array); the element and index are
+// written into the frame in place
+static int array_callback_element(ember_vm* vm, array_callback* call, ember_array* array, int index,
+                                  ember_value* result) {
+    call->args[0] = array->elements[index];
+    call->args[1] = ember_make_number(index);
+    return vm_call_prepared(vm, call->callback, call->argc, call->args, result);
+}
+
+// Nil, false and 0 are false, as for the not builtin
+static int callback_truthy(ember_value value) {
+    switch (value.type) {
+        case EMBER_VAL_NIL: return 0;
+        case EMBER_VAL_BOOL: return value.as.bool_val;
+        case EMBER_VAL_NUMBER: return value.as.number_val != 0.0;
+        default: return 1;
+    }
+}
 
 // Array.forEach(callback) - execute callback for each element
 void array_foreach(ember_vm* vm, ember_array* array, ember_value callback) {
-    if (!vm || !array || callback.type != EMBER_VAL_FUNCTION) return;
+    array_callback call;
+    if (!array_callback_begin(vm, &call, array, callback, 3, 0)) return;
     
-    for (int i = 0; i < array->length; i++) {
-        // Call callback with (element, index, array)
-        ember_value args[3];
-        args[0] = array->elements[i];           // element
-        args[1] = ember_make_number(i);         // index
-        
-        // Create array value for third parameter
-        ember_value array_val;
-        array_val.type = EMBER_VAL_ARRAY;
-        array_val.as.obj_val = (ember_object*)array;
-        args[2] = array_val;                    // array
-        
-        // Execute callback (simplified - would need proper function call implementation)
-        if (callback.as.native_val) {
-            callback.as.native_val(vm, 3, args);
-        }
+    // The callback may shrink the array; elements it adds are not visited
+    int length = array->length;
+    ember_value ignored;
+    for (int i = 0; i < length && i < array->length; i++) {
+        if (array_callback_element(vm, &call, array, i, &ignored) != 0) break;
     }
+    array_callback_end(vm, &call);
 }
 
 // Array.map(callback) - create new array with transformed elements
 ember_value array_map(ember_vm* vm, ember_array* array, ember_value callback) {
-    if (!vm || !array || callback.type != EMBER_VAL_FUNCTION) {
+    array_callback call;
+    if (!array_callback_begin(vm, &call, array, callback, 3, 1)) {
         return ember_make_nil();
     }
     
-    ember_array* result = (ember_array*)allocate_object(vm, sizeof(ember_array), OBJ_ARRAY);
-    if (!result) return ember_make_nil();
-    
-    result->capacity = array->length > 0 ? array->length : 1;
-    result->length = 0;
-    result->elements = malloc(sizeof(ember_value) * result->capacity);
-    if (!result->elements) return ember_make_nil();
-    
-    for (int i = 0; i < array->length; i++) {
-        // Call callback with (element, index, array)
-        ember_value args[3];
-        args[0] = array->elements[i];           // element
-        args[1] = ember_make_number(i);         // index
-        
-        ember_value array_val;
-        array_val.type = EMBER_VAL_ARRAY;
-        array_val.as.obj_val = (ember_object*)array;
-        args[2] = array_val;                    // array
-        
-        // Execute callback and store result
-        ember_value transformed = ember_make_nil();
-        if (callback.as.native_val) {
-            transformed = callback.as.native_val(vm, 3, args);
+    int length = array->length;
+    ember_value result = ember_make_array(vm, length > 0 ? length : 1);
+    call.args[3] = result;
+    for (int i = 0; result.type == EMBER_VAL_ARRAY && i < length && i < array->length; i++) {
+        ember_value transformed;
+        if (array_callback_element(vm, &call, array, i, &transformed) != 0) {
+            result = ember_make_nil();
+            break;
         }
-        
-        result->elements[result->length++] = transformed;
+        array_push_with_vm(vm, AS_ARRAY(result), transformed);
     }
-    
-    ember_value result_val;
-    result_val.type = EMBER_VAL_ARRAY;
-    result_val.as.obj_val = (ember_object*)result;
-    return result_val;
+    array_callback_end(vm, &call);
+    return result;
 }
 
 // Array.filter(callback) - create new array with elements that pass test
 ember_value array_filter(ember_vm* vm, ember_array* array, ember_value callback) {
-    if (!vm || !array || callback.type != EMBER_VAL_FUNCTION) {
+    array_callback call;
+    if (!array_callback_begin(vm, &call, array, callback, 3, 1)) {
         return ember_make_nil();
     }
     
-    ember_array* result = (ember_array*)allocate_object(vm, sizeof(ember_array), OBJ_ARRAY);
-    if (!result) return ember_make_nil();
-    
-    result->capacity = array->length > 0 ? array->length : 1;
-    result->length = 0;
-    result->elements = malloc(sizeof(ember_value) * result->capacity);
-    if (!result->elements) return ember_make_nil();
-    
-    for (int i = 0; i < array->length; i++) {
-        // Call callback with (element, index, array)
-        ember_value args[3];
-        args[0] = array->elements[i];           // element
-        args[1] = ember_make_number(i);         // index
-        
-        ember_value array_val;
-        array_val.type = EMBER_VAL_ARRAY;
-        array_val.as.obj_val = (ember_object*)array;
-        args[2] = array_val;                    // array
-        
-        // Execute callback and check result
-        ember_value test_result = ember_make_nil();
-        if (callback.as.native_val) {
-            test_result = callback.as.native_val(vm, 3, args);
+    int length = array->length;
+    ember_value result = ember_make_array(vm, length > 0 ? length : 1);
+    call.args[3] = result;
+    for (int i = 0; result.type == EMBER_VAL_ARRAY && i < length && i < array->length; i++) {
+        ember_value test_result;
+        if (array_callback_element(vm, &call, array, i, &test_result) != 0) {
+            result = ember_make_nil();
+            break;
         }
-        
-        // If result is truthy, include element
-        if ((test_result.type == EMBER_VAL_BOOL && test_result.as.bool_val) ||
-            (test_result.type == EMBER_VAL_NUMBER && test_result.as.number_val != 0.0) ||
-            (test_result.type == EMBER_VAL_STRING && test_result.as.obj_val != NULL)) {
-            result->elements[result->length++] = array->elements[i];
+        // The element passed to the callback, even if it replaced it since
+        if (callback_truthy(test_result)) {
+            array_push_with_vm(vm, AS_ARRAY(result), call.args[0]);
         }
     }
-    
-    ember_value result_val;
-    result_val.type = EMBER_VAL_ARRAY;
-    result_val.as.obj_val = (ember_object*)result;
-    return result_val;
+    array_callback_end(vm, &call);
+    return result;
 }
 
 // Array.reduce(callback, initialValue) - reduce array to single value
 ember_value array_reduce(ember_vm* vm, ember_array* array, ember_value callback, ember_value initial) {
-    if (!vm || !array || callback.type != EMBER_VAL_FUNCTION) {
-        return ember_make_nil();
-    }
-    
-    if (array->length == 0) {
+    if (!array || array->length == 0) {
         return initial;
     }
-    
-    ember_value accumulator = initial;
-    int start_index = 0;
+    // Called with (accumulator, currentValue, index, array)
+    array_callback call;
+    if (!array_callback_begin(vm, &call, array, callback, 4, 0)) {
+        return ember_make_nil();
+    }
     
     // If no initial value provided, use first element
-    if (initial.type == EMBER_VAL_NIL && array->length > 0) {
-        accumulator = array->elements[0];
+    int start_index = 0;
+    call.args[0] = initial;
+    if (initial.type == EMBER_VAL_NIL) {
+        call.args[0] = array->elements[0];
         start_index = 1;
     }
     
-    for (int i = start_index; i < array->length; i++) {
-        // Call callback with (accumulator, currentValue, index, array)
-        ember_value args[4];
-        args[0] = accumulator;                  // accumulator
-        args[1] = array->elements[i];           // currentValue
-        args[2] = ember_make_number(i);         // index
-        
-        ember_value array_val;
-        array_val.type = EMBER_VAL_ARRAY;
-        array_val.as.obj_val = (ember_object*)array;
-        args[3] = array_val;                    // array
-        
-        // Execute callback and update accumulator
-        if (callback.as.native_val) {
-            accumulator = callback.as.native_val(vm, 4, args);
+    int length = array->length;
+    ember_value accumulator = call.args[0];
+    for (int i = start_index; i < length && i < array->length; i++) {
+        call.args[0] = accumulator;
+        call.args[1] = array->elements[i];
+        call.args[2] = ember_make_number(i);
+        if (vm_call_prepared(vm, call.callback, 4, call.args, &accumulator) != 0) {
+            accumulator = ember_make_nil();
+            break;
         }
     }
-    
+    array_callback_end(vm, &call);
     return accumulator;
 }
 
 // Array.find(callback) - find first element that passes test
 ember_value array_find(ember_vm* vm, ember_array* array, ember_value callback) {
-    if (!vm || !array || callback.type != EMBER_VAL_FUNCTION) {
+    array_callback call;
+    if (!array_callback_begin(vm, &call, array, callback, 3, 0)) {
         return ember_make_nil();
     }
     
-    for (int i = 0; i < array->length; i++) {
-        // Call callback with (element, index, array)
-        ember_value args[3];
-        args[0] = array->elements[i];           // element
-        args[1] = ember_make_number(i);         // index
-        
-        ember_value array_val;
-        array_val.type = EMBER_VAL_ARRAY;
-        array_val.as.obj_val = (ember_object*)array;
-        args[2] = array_val;                    // array
-        
-        // Execute callback and check result
-        ember_value test_result = ember_make_nil();
-        if (callback.as.native_val) {
-            test_result = callback.as.native_val(vm, 3, args);
-        }
-        
-        // If result is truthy, return element
-        if ((test_result.type == EMBER_VAL_BOOL && test_result.as.bool_val) ||
-            (test_result.type == EMBER_VAL_NUMBER && test_result.as.number_val != 0.0) ||
-            (test_result.type == EMBER_VAL_STRING && test_result.as.obj_val != NULL)) {
-            return array->elements[i];
+    int length = array->length;
+    ember_value found = ember_make_nil();
+    for (int i = 0; i < length && i < array->length; i++) {
+        ember_value test_result;
+        if (array_callback_element(vm, &call, array, i, &test_result) != 0) break;
+        if (callback_truthy(test_result)) {
+            found = call.args[0];
+            break;
         }
     }
-    
-    return ember_make_nil();
+    array_callback_end(vm, &call);
+    return found;
 }
 
 // Array.some(callback) - test if at least one element passes test
 int array_some(ember_vm* vm, ember_array* array, ember_value callback) {
-    if (!vm || !array || callback.type != EMBER_VAL_FUNCTION) {
+    array_callback call;
+    if (!array_callback_begin(vm, &call, array, callback, 3, 0)) {
         return 0;
     }
     
-    for (int i = 0; i < array->length; i++) {
-        // Call callback with (element, index, array)
-        ember_value args[3];
-        args[0] = array->elements[i];           // element
-        args[1] = ember_make_number(i);         // index
-        
-        ember_value array_val;
-        array_val.type = EMBER_VAL_ARRAY;
-        array_val.as.obj_val = (ember_object*)array;
-        args[2] = array_val;                    // array
-        
-        // Execute callback and check result
-        ember_value test_result = ember_make_nil();
-        if (callback.as.native_val) {
-            test_result = callback.as.native_val(vm, 3, args);
-        }
-        
-        // If result is truthy, return true
-        if ((test_result.type == EMBER_VAL_BOOL && test_result.as.bool_val) ||
-            (test_result.type == EMBER_VAL_NUMBER && test_result.as.number_val != 0.0) ||
-            (test_result.type == EMBER_VAL_STRING && test_result.as.obj_val != NULL)) {
-            return 1;
+    int length = array->length;
+    int passed = 0;
+    for (int i = 0; i < length && i < array->length; i++) {
+        ember_value test_result;
+        if (array_callback_element(vm, &call, array, i, &test_result) != 0) break;
+        if (callback_truthy(test_result)) {
+            passed = 1;
+            break;
         }
     }
-    
-    return 0;
+    array_callback_end(vm, &call);
+    return passed;
 }
 
 // Array.every(callback) - test if all elements pass test
 int array_every(ember_vm* vm, ember_array* array, ember_value callback) {
-    if (!vm || !array || callback.type != EMBER_VAL_FUNCTION) {
+    array_callback call;
+    if (!array_callback_begin(vm, &call, array, callback, 3, 0)) {
         return 0;
     }
     
-    for (int i = 0; i < array->length; i++) {
-        // Call callback with (element, index, array)
-        ember_value args[3];
-        args[0] = array->elements[i];           // element
-        args[1] = ember_make_number(i);         // index
-        
-        ember_value array_val;
-        array_val.type = EMBER_VAL_ARRAY;
-        array_val.as.obj_val = (ember_object*)array;
-        args[2] = array_val;                    // array
-        
-        // Execute callback and check result
-        ember_value test_result = ember_make_nil();
-        if (callback.as.native_val) {
-            test_result = callback.as.native_val(vm, 3, args);
-        }
-        
-        // If result is falsy, return false
-        if (!((test_result.type == EMBER_VAL_BOOL && test_result.as.bool_val) ||
-              (test_result.type == EMBER_VAL_NUMBER && test_result.as.number_val != 0.0) ||
-              (test_result.type == EMBER_VAL_STRING && test_result.as.obj_val != NULL))) {
-            return 0;
+    int length = array->length;
+    int passed = 1;
+    for (int i = 0; i < length && i < array->length; i++) {
+        ember_value test_result;
+        if (array_callback_element(vm, &call, array, i, &test_result) != 0 || !callback_truthy(test_result)) {
+            passed = 0;
+            break;
         }
     }
-    
-    return 1;
+    array_callback_end(vm, &call);
+    return passed;
 }
 
 // Array.indexOf(searchElement) - find index of element
@@ -1949,7 +3487,7 @@ int array_index_of(ember_array* array, ember_value search_element) {
     if (!array) return -1;
     
     for (int i = 0; i < array->length; i++) {
-        if (values_equal(array->elements[i], search_element)) {
+        if (values_equal_fast(array->elements[i], search_element)) {
             return i;
         }
     }
@@ -1974,6 +3512,11 @@ ember_value ember_make_iterator(ember_vm* vm, ember_value collection, ember_iter
     iterator->type = type;
     iterator->collection = collection;
     iterator->index = 0;
+    iterator->regex = ember_make_nil();
+    iterator->vm = vm;
+    iterator->step = ember_make_nil();
+    iterator->pending = ember_make_nil();
+    iterator->pipe_flags = 0;
     
     // Set capacity and length based on collection type
     switch (collection.type) {
@@ -1991,7 +3534,7 @@ ember_value ember_make_iterator(ember_vm* vm, ember_value collection, ember_iter
         }
         case EMBER_VAL_MAP: {
             ember_map* map = AS_MAP(collection);
-            iterator->capacity = map->entries->capacity;
+            iterator->capacity = map->count;
             iterator->length = map->size;
             break;
         }
@@ -2048,9 +3591,9 @@ ember_iterator_result iterator_next(ember_iterator* iterator) {
             ember_map* map = AS_MAP(iterator->collection);
             
             // Find next occupied entry
-            while (iterator->index < map->entries->capacity) {
-                if (map->entries->entries[iterator->index].is_occupied) {
-                    result.value = map->entries->entries[iterator->index].key;
+            while (iterator->index < map->count) {
+                if (map->entries[iterator->index].is_occupied) {
+                    result.value = map->entries[iterator->index].key;
                     result.done = 0;
                     iterator->index++;
                     return result;
@@ -2064,9 +3607,9 @@ ember_iterator_result iterator_next(ember_iterator* iterator) {
             ember_map* map = AS_MAP(iterator->collection);
             
             // Find next occupied entry
-            while (iterator->index < map->entries->capacity) {
-                if (map->entries->entries[iterator->index].is_occupied) {
-                    result.value = map->entries->entries[iterator->index].value;
+            while (iterator->index < map->count) {
+                if (map->entries[iterator->index].is_occupied) {
+                    result.value = map->entries[iterator->index].value;
                     result.done = 0;
                     iterator->index++;
                     return result;
@@ -2080,26 +3623,16 @@ ember_iterator_result iterator_next(ember_iterator* iterator) {
             ember_map* map = AS_MAP(iterator->collection);
             
             // Find next occupied entry and return [key, value] array
-            while (iterator->index < map->entries->capacity) {
-                if (map->entries->entries[iterator->index].is_occupied) {
-                    // Create [key, value] array
-                    ember_array* entry_array = (ember_array*)malloc(sizeof(ember_array));
-                    if (!entry_array) break;
-                    
-                    entry_array->capacity = 2;
-                    entry_array->length = 2;
-                    entry_array->elements = malloc(sizeof(ember_value) * 2);
-                    if (!entry_array->elements) {
-                        free(entry_array);
-                        break;
-                    }
-                    
-                    entry_array->elements[0] = map->entries->entries[iterator->index].key;
-                    entry_array->elements[1] = map->entries->entries[iterator->index].value;
+            while (iterator->index < map->count) {
+                if (map->entries[iterator->index].is_occupied) {
+                    // A heap array, so pipelines and collect can keep it;
+                    // the map (rooted through the iterator) holds its parts
+                    ember_value pair = ember_make_array(iterator->vm, 2);
+                    if (pair.type != EMBER_VAL_ARRAY) break;
+                    array_push_with_vm(iterator->vm, AS_ARRAY(pair), map->entries[iterator->index].key);
+                    array_push_with_vm(iterator->vm, AS_ARRAY(pair), map->entries[iterator->index].value);
                     
-                    // Note: This is simplified - in a real implementation, this array should be GC-managed
-                    result.value.type = EMBER_VAL_ARRAY;
-                    result.value.as.obj_val = (ember_object*)entry_array;
+                    result.value = pair;
                     result.done = 0;
                     iterator->index++;
                     return result;
@@ -2108,6 +3641,64 @@ ember_iterator_result iterator_next(ember_iterator* iterator) {
             }
             break;
         }
+        case ITERATOR_GENERATOR: {
+            if (iterator->collection.type != EMBER_VAL_GENERATOR) break;
+            ember_generator* generator = AS_GENERATOR(iterator->collection);
+            
+            // Each step runs the body to its next yield; its return value
+            // only ends the iteration
+            ember_value value;
+            if (vm_generator_resume(generator->vm, generator, ember_make_nil(), &value) == 1) {
+                result.value = value;
+                result.done = 0;
+                iterator->index++;
+            }
+            break;
+        }
+        case ITERATOR_REGEX: {
+            if (iterator->collection.type != EMBER_VAL_STRING || iterator->regex.type != EMBER_VAL_REGEX) break;
+            ember_string* text = AS_STRING(iterator->collection);
+            const char* chars = ember_string_flatten(text);
+            if (!chars || iterator->index < 0) break;
+
+            // One search from where the last match ended
+            size_t offset = (size_t)iterator->index;
+            ember_value match = ember_regex_next_match(iterator->vm, AS_REGEX(iterator->regex), chars,
+                                                       (size_t)text->length, &offset);
+            iterator->index = (int)offset;
+            if (match.type != EMBER_VAL_NIL) {
+                result.value = match;
+                result.done = 0;
+            }
+            break;
+        }
+        case ITERATOR_FILE_LINES: {
+            if (iterator->collection.type != EMBER_VAL_FILE) break;
+            ember_value line = ember_file_read_line(iterator->vm, AS_FILE(iterator->collection));
+            if (line.type != EMBER_VAL_NIL) {
+                result.value = line;
+                result.done = 0;
+                iterator->index++;
+            }
+            break;
+        }
+        case ITERATOR_WALK: {
+            if (iterator->collection.type != EMBER_VAL_WALKER) break;
+            ember_value path = ember_walker_next(iterator->vm, AS_WALKER(iterator->collection));
+            if (path.type != EMBER_VAL_NIL) {
+                result.value = path;
+                result.done = 0;
+                iterator->index++;
+            }
+            break;
+        }
+        case ITERATOR_PIPE_MAP:
+        case ITERATOR_PIPE_FILTER:
+        case ITERATOR_PIPE_TAKE:
+        case ITERATOR_PIPE_SKIP:
+        case ITERATOR_PIPE_ZIP:
+        case ITERATOR_PIPE_CHUNK:
+            return iterator_pipe_next(iterator);
     }
     
     return result;
@@ -2117,6 +3708,35 @@ ember_iterator_result iterator_next(ember_iterator* iterator) {
 int iterator_done(ember_iterator* iterator) {
     if (!iterator) return 1;
     
+    // Peeking would run the body; done once it has returned
+    if (iterator->type == ITERATOR_GENERATOR) {
+        return iterator->collection.type != EMBER_VAL_GENERATOR ||
+               AS_GENERATOR(iterator->collection)->state == GENERATOR_COMPLETED;
+    }
+    // Searches without building the match record or moving on
+    if (iterator->type == ITERATOR_REGEX) {
+        if (iterator->collection.type != EMBER_VAL_STRING || iterator->regex.type != EMBER_VAL_REGEX ||
+            iterator->index < 0) {
+            return 1;
+        }
+        ember_string* text = AS_STRING(iterator->collection);
+        const char* chars = ember_string_flatten(text);
+        return !chars || !ember_regex_has_match_from(AS_REGEX(iterator->regex), chars, (size_t)text->length,
+                                                     (size_t)iterator->index);
+    }
+    // Reads ahead into the buffer; the line is taken by the next call
+    if (iterator->type == ITERATOR_FILE_LINES) {
+        return iterator->collection.type != EMBER_VAL_FILE || ember_file_at_end(AS_FILE(iterator->collection));
+    }
+    // Waits for the next path without taking it
+    if (iterator->type == ITERATOR_WALK) {
+        return iterator->collection.type != EMBER_VAL_WALKER || ember_walker_done(AS_WALKER(iterator->collection));
+    }
+    // Pulls the next value ahead, since stages run callbacks
+    if (iterator->type >= ITERATOR_PIPE_MAP) {
+        return iterator_pipe_done(iterator);
+    }
+    
     ember_iterator_result result = iterator_next(iterator);
     // Reset index to previous position since next() incremented it
     if (!result.done) {
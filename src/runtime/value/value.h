@@ -21,21 +21,54 @@ void free_ember_value(ember_value value);
 ember_value copy_ember_value(ember_value value);
 int values_equal(ember_value a, ember_value b);
 void print_value(ember_value value);
+// print_value's text, handed to sink in pieces instead of written to stdout
+typedef void (*ember_text_sink)(void* context, const char* text, size_t length);
+void ember_value_write(ember_value value, ember_text_sink sink, void* context);
 
 // String operations
 ember_string* allocate_string(ember_vm* vm, char* chars, int length);
+// A string whose chars are a read-only private mapping of the first length
+// bytes of fd, unmapped when the string is freed; NULL if mmap fails. The
+// file must not shrink while the string lives: reading a truncated page
+// raises SIGBUS
+ember_string* ember_string_map_file(ember_vm* vm, int fd, int length);
+// An external string's release callback, stored behind its header where an
+// inline string keeps its bytes
+typedef struct {
+    ember_string_release release;
+    void* userdata;
+} ember_string_external;
+#define EMBER_STRING_EXTERNAL_SIZE (sizeof(ember_string) + sizeof(ember_string_external))
 ember_string* copy_string(ember_vm* vm, const char* chars, int length);
+void free_string_object(ember_string* string);
+// Release an object header from allocate_object; collectors must use this
+// rather than free(), since the header may live in a slab
+void free_object_storage(ember_object* object);
 ember_value concatenate_strings(ember_vm* vm, ember_value a, ember_value b);
+ember_value concatenate_values(ember_vm* vm, int count, ember_value* values);
+uint32_t hash_string_chars(const char* chars, int length);
 
 // String interning
 void init_string_intern_table(ember_vm* vm);
 void free_string_intern_table(ember_vm* vm);
 ember_string* intern_string(ember_vm* vm, const char* chars, int length);
 ember_string* find_interned_string(ember_vm* vm, const char* chars, int length);
+// Weak-table sweep: drop interned strings left unmarked. The collector must call
+// this after marking and before freeing unreachable objects.
+void sweep_string_intern_table(ember_vm* vm);
+// Minor-collection variant: only young (never promoted) strings are dropped
+void sweep_young_string_intern_table(ember_vm* vm);
 
 // Array operations
 ember_array* allocate_array(ember_vm* vm, int capacity);
 void array_push(ember_array* array, ember_value value);
+void array_push_with_vm(ember_vm* vm, ember_array* array, ember_value value);
+int array_reserve(ember_array* array, int min_capacity);
+// array_reserve, advising a grown buffer for huge pages (ember_vm_set_huge_pages)
+int array_reserve_with_vm(ember_vm* vm, ember_array* array, int min_capacity);
+int array_extend(ember_vm* vm, ember_array* array, ember_array* source);
+int array_splice(ember_vm* vm, ember_array* array, int start, int delete_count, const ember_value* items,
+                 int item_count, ember_value* removed);
 
 // Hash map operations
 ember_hash_map* allocate_hash_map(ember_vm* vm, int capacity);
@@ -43,12 +76,115 @@ void hash_map_set(ember_hash_map* map, ember_value key, ember_value value);
 void hash_map_set_with_vm(ember_vm* vm, ember_hash_map* map, ember_value key, ember_value value);
 ember_value hash_map_get(ember_hash_map* map, ember_value key);
 int hash_map_has_key(ember_hash_map* map, ember_value key);
+int hash_map_reserve(ember_hash_map* map, int count);
 uint32_t hash_value(ember_value value);
 
+// Per-process random seed for string and number hashes, chosen before main
+// (EMBER_HASH_SEED fixes it for reproducible runs). Hashes are never
+// persisted, so maps and the intern table only need it stable within a run
+extern uint64_t ember_hash_seed;
+
+// 64x64->128 multiply folded to 64 bits (the wyhash "mum")
+static inline uint64_t hash_mix(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t product = (__uint128_t)a * b;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+#else
+    uint64_t ha = a >> 32, la = (uint32_t)a, hb = b >> 32, lb = (uint32_t)b;
+    uint64_t hh = ha * hb, hl = ha * lb, lh = la * hb, ll = la * lb;
+    uint64_t mid = (ll >> 32) + (uint32_t)hl + (uint32_t)lh;
+    uint64_t low = (mid << 32) | (uint32_t)ll;
+    uint64_t high = hh + (hl >> 32) + (lh >> 32) + (mid >> 32);
+    return low ^ high;
+#endif
+}
+
+static inline uint32_t hash_word(uint64_t word) {
+    uint64_t hash = hash_mix(word ^ ember_hash_seed, 0x9e3779b97f4a7c15ULL);
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static inline uint32_t hash_small_int(int32_t n) {
+    return hash_word((uint32_t)n);
+}
+
+// Integral numbers hash as their int32, so a small int needs no conversion
+// and agrees with the same double (-0 included); others hash by their bits,
+// with every NaN alike
+static inline uint32_t hash_number(double d) {
+    if (d >= INT32_MIN && d <= INT32_MAX && (double)(int32_t)d == d) return hash_small_int((int32_t)d);
+    if (d != d) return 2147483647u;
+    
+    union { double d; uint64_t i; } u;
+    u.d = d;
+    return hash_word(u.i);
+}
+
+// Fast paths for the probe loops of hash maps, sets and maps. Numbers (small
+// ints straight from their int) and flat strings (whose hash is cached when
+// their bytes are made) hash inline; equality settles numbers, nil, booleans
+// and identity-compared objects without a call, and rejects strings on
+// length or cached hash before any bytes are read. Everything else goes to
+// hash_value / values_equal
+static inline uint32_t hash_value_fast(ember_value value) {
+    if (value.type == EMBER_VAL_NUMBER) {
+        return value.as.number.is_small ? hash_small_int(value.as.number.small) : hash_number(value.as.number_val);
+    }
+    if (value.type == EMBER_VAL_STRING && value.as.obj_val && AS_STRING(value)->chars) {
+        return AS_STRING(value)->hash;
+    }
+    return hash_value(value);
+}
+
+static inline int values_equal_fast(ember_value a, ember_value b) {
+    if (a.type != b.type) return 0;
+    switch (a.type) {
+        case EMBER_VAL_NUMBER:
+            return a.as.number_val == b.as.number_val;
+        case EMBER_VAL_NIL:
+            return 1;
+        case EMBER_VAL_BOOL:
+            return a.as.bool_val == b.as.bool_val;
+        case EMBER_VAL_STRING: {
+            ember_string* a_str = AS_STRING(a);
+            ember_string* b_str = AS_STRING(b);
+            if (a_str == b_str) return 1;
+            if (!a_str || !b_str || a_str->length != b_str->length) return 0;
+            // Interned strings are unique per content
+            if (a_str->is_interned && b_str->is_interned) return 0;
+            // A hash of 0 may just not be computed yet (ropes, slices)
+            if (a_str->hash && b_str->hash && a_str->hash != b_str->hash) return 0;
+            break;
+        }
+        case EMBER_VAL_EXCEPTION:
+        case EMBER_VAL_CLASS:
+        case EMBER_VAL_INSTANCE:
+        case EMBER_VAL_PROMISE:
+        case EMBER_VAL_GENERATOR:
+        case EMBER_VAL_ITERATOR:
+        case EMBER_VAL_STRING_BUILDER:
+        case EMBER_VAL_HASHER:
+        case EMBER_VAL_FILE:
+        case EMBER_VAL_WALKER:
+        case EMBER_VAL_TYPED_ARRAY:
+        case EMBER_VAL_CACHE:
+        case EMBER_VAL_DEQUE:
+        case EMBER_VAL_PRIORITY_QUEUE:
+        case EMBER_VAL_WEAK_REF:
+        case EMBER_VAL_WEAK_MAP:
+            // Equal only to themselves
+            return a.as.obj_val == b.as.obj_val;
+        default:
+            break;
+    }
+    return values_equal(a, b);
+}
+
 // OOP operations
 ember_class* allocate_class(ember_vm* vm, const char* name);
 ember_instance* allocate_instance(ember_vm* vm, ember_class* klass);
 ember_bound_method* allocate_bound_method(ember_vm* vm, ember_value receiver, ember_value method);
+ember_function* allocate_function(ember_vm* vm, ember_chunk* chunk, const char* name, ember_native_func native);
 
 // Garbage collection helpers
 ember_object* allocate_object(ember_vm* vm, size_t size, ember_object_type type);
@@ -1,5 +1,6 @@
 #define _GNU_SOURCE
 #include "ember.h"
+#include "../../vm.h"
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -7,15 +8,195 @@
 #include <limits.h>
 #include <stdio.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/openat2.h>
+#endif
+
+#define VFS_CACHE_SIZE 256                     // Resolved paths kept per VM; a power of two
+
+// Mounts by path component, so the longest mount prefix of a path is one
+// walk down its components rather than a scan of every mount
+typedef struct vfs_trie_node {
+    char* name;                                // Component below the parent; NULL at the root
+    size_t length;
+    int mount;                                 // Index in vm->mounts, or -1
+    struct vfs_trie_node* children;
+    int child_count;
+} vfs_trie_node;
+
+// A path that resolved to an existing file inside its mount. Paths that
+// did not exist are never cached: they must be checked again once they do
+typedef struct {
+    uint64_t hash;
+    char* virtual_path;                        // NULL when the slot is empty
+    char* host_path;
+} vfs_cache_entry;
+
+struct ember_vfs_index {
+    vfs_trie_node root;
+    vfs_cache_entry cache[VFS_CACHE_SIZE];     // Direct-mapped by hash
+};
+
+static void vfs_trie_free(vfs_trie_node* node) {
+    for (int i = 0; i < node->child_count; i++) {
+        vfs_trie_free(&node->children[i]);
+    }
+    free(node->children);
+    free(node->name);
+}
+
+static void vfs_index_free(struct ember_vfs_index* index) {
+    if (!index) return;
+    vfs_trie_free(&index->root);
+    for (int i = 0; i < VFS_CACHE_SIZE; i++) {
+        free(index->cache[i].virtual_path);
+        free(index->cache[i].host_path);
+    }
+    free(index);
+}
+
+static vfs_trie_node* vfs_trie_child(vfs_trie_node* node, const char* name, size_t length, int create) {
+    for (int i = 0; i < node->child_count; i++) {
+        if (node->children[i].length == length && memcmp(node->children[i].name, name, length) == 0) {
+            return &node->children[i];
+        }
+    }
+    if (!create) return NULL;
+    vfs_trie_node* children = realloc(node->children, (size_t)(node->child_count + 1) * sizeof(vfs_trie_node));
+    if (!children) return NULL;
+    node->children = children;
+    vfs_trie_node* child = &children[node->child_count];
+    memset(child, 0, sizeof(*child));
+    child->name = malloc(length + 1);
+    if (!child->name) return NULL;
+    memcpy(child->name, name, length);
+    child->name[length] = '\0';
+    child->length = length;
+    child->mount = -1;
+    node->child_count++;
+    return child;
+}
+
+// Rebuilds the trie from vm->mounts with an empty cache; every mount
+// change goes through here, so no resolution outlives the mounts it used
+static void vfs_rebuild_index(ember_vm* vm) {
+    vfs_index_free(vm->vfs_index);
+    vm->vfs_index = calloc(1, sizeof(struct ember_vfs_index));
+    if (!vm->vfs_index) return;
+    vm->vfs_index->root.mount = -1;
+
+    for (int i = 0; i < vm->mount_count; i++) {
+        if (!vm->mounts[i].virtual_path || !vm->mounts[i].host_path) continue;
+        vfs_trie_node* node = &vm->vfs_index->root;
+        const char* component = vm->mounts[i].virtual_path;
+        while (node && *component) {
+            while (*component == '/') component++;
+            if (!*component) break;
+            size_t length = strcspn(component, "/");
+            node = vfs_trie_child(node, component, length, 1);
+            component += length;
+        }
+        if (!node) {
+            // Out of memory: no index, so lookups fall back to the mount list
+            vfs_index_free(vm->vfs_index);
+            vm->vfs_index = NULL;
+            return;
+        }
+        node->mount = i;
+    }
+}
+
+// The mount with the longest prefix of virtual_path ending at a component
+// boundary, and the length of that prefix; NULL if none
+static ember_mount_point* vfs_find_mount(ember_vm* vm, const char* virtual_path, size_t* prefix_length) {
+    size_t vpath_len = strlen(virtual_path);
+    if (!vm->vfs_index) {
+        // Linear scan of the mounts
+        ember_mount_point* best_mount = NULL;
+        size_t best_len = 0;
+        for (int i = 0; i < vm->mount_count; i++) {
+            if (!vm->mounts[i].virtual_path || !vm->mounts[i].host_path) continue;
+            size_t mount_len = strlen(vm->mounts[i].virtual_path);
+            if (mount_len == 0 || mount_len > vpath_len) continue;
+            if (strncmp(virtual_path, vm->mounts[i].virtual_path, mount_len) == 0 &&
+                (virtual_path[mount_len] == '\0' || virtual_path[mount_len] == '/' ||
+                 vm->mounts[i].virtual_path[mount_len - 1] == '/') &&
+                mount_len > best_len) {
+                best_mount = &vm->mounts[i];
+                best_len = mount_len;
+            }
+        }
+        *prefix_length = best_len;
+        return best_mount;
+    }
+
+    vfs_trie_node* node = &vm->vfs_index->root;
+    int best = node->mount;
+    size_t best_len = 0;
+    const char* component = virtual_path;
+    while (*component) {
+        while (*component == '/') component++;
+        if (!*component) break;
+        size_t length = strcspn(component, "/");
+        node = vfs_trie_child(node, component, length, 0);
+        if (!node) break;
+        component += length;
+        if (node->mount >= 0) {
+            best = node->mount;
+            best_len = (size_t)(component - virtual_path);
+        }
+    }
+    *prefix_length = best_len;
+    return best >= 0 ? &vm->mounts[best] : NULL;
+}
+
+static uint64_t vfs_hash(const char* path, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;   // FNV-1a
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)path[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static const char* vfs_cache_lookup(ember_vm* vm, const char* virtual_path, size_t length, uint64_t hash) {
+    if (!vm->vfs_index) return NULL;
+    vfs_cache_entry* entry = &vm->vfs_index->cache[hash & (VFS_CACHE_SIZE - 1)];
+    if (entry->virtual_path && entry->hash == hash && strncmp(entry->virtual_path, virtual_path, length + 1) == 0) {
+        return entry->host_path;
+    }
+    return NULL;
+}
+
+static void vfs_cache_store(ember_vm* vm, const char* virtual_path, size_t length, uint64_t hash,
+                            const char* host_path) {
+    if (!vm->vfs_index) return;
+    char* vpath = malloc(length + 1);
+    char* hpath = strdup(host_path);
+    if (!vpath || !hpath) {
+        free(vpath);
+        free(hpath);
+        return;
+    }
+    memcpy(vpath, virtual_path, length + 1);
+    vfs_cache_entry* entry = &vm->vfs_index->cache[hash & (VFS_CACHE_SIZE - 1)];
+    free(entry->virtual_path);
+    free(entry->host_path);
+    entry->hash = hash;
+    entry->virtual_path = vpath;
+    entry->host_path = hpath;
+}
 
 // Initialize VFS with default mount (current working directory to /app)
-void ember_vfs_init(ember_vm* vm) {
-    if (!vm) return;
-    
+static void vfs_init_mounts(ember_vm* vm) {
     // Initialize VFS
     vm->mounts = NULL;
     vm->mount_count = 0;
     vm->mount_capacity = 0;
+    vm->vfs_index = NULL;
     
     // Add default mount: current working directory -> /app
     char* cwd = getcwd(NULL, 0);
@@ -67,6 +248,24 @@ void ember_vfs_init(ember_vm* vm) {
     }
 }
 
+void ember_vfs_init(ember_vm* vm) {
+    if (!vm) return;
+    double start = startup_clock();
+    vfs_init_mounts(vm);
+    startup_profile_phase(STARTUP_VFS, start);
+}
+
+// The mounted directory, held open so files below it are opened relative
+// to it. O_PATH asks for no read permission on the directory itself
+static int vfs_open_dir(const char* host_path) {
+#ifdef O_PATH
+    int fd = open(host_path, O_PATH | O_DIRECTORY | O_CLOEXEC);
+#else
+    int fd = open(host_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+#endif
+    return fd;
+}
+
 // Mount a host path to a virtual path
 int ember_vfs_mount(ember_vm* vm, const char* virtual_path, const char* host_path, int flags) {
     if (!vm || !virtual_path || !host_path) return -1;
@@ -121,6 +320,7 @@ int ember_vfs_mount(ember_vm* vm, const char* virtual_path, const char* host_pat
             
             free(vm->mounts[i].virtual_path);
             free(vm->mounts[i].host_path);
+            if (vm->mounts[i].dir_fd >= 0) close(vm->mounts[i].dir_fd);
             
             memcpy(new_vpath, virtual_path, vpath_len + 1);
             memcpy(new_hpath, resolved_host, hpath_len + 1);
@@ -128,6 +328,8 @@ int ember_vfs_mount(ember_vm* vm, const char* virtual_path, const char* host_pat
             vm->mounts[i].virtual_path = new_vpath;
             vm->mounts[i].host_path = new_hpath;
             vm->mounts[i].flags = flags;
+            vm->mounts[i].dir_fd = vfs_open_dir(new_hpath);
+            vfs_rebuild_index(vm);
             return 0;
         }
     }
@@ -153,7 +355,9 @@ int ember_vfs_mount(ember_vm* vm, const char* virtual_path, const char* host_pat
     memcpy(mount->virtual_path, virtual_path, vpath_len + 1);
     memcpy(mount->host_path, resolved_host, hpath_len + 1);
     mount->flags = flags;
+    mount->dir_fd = vfs_open_dir(mount->host_path);
     vm->mount_count++;
+    vfs_rebuild_index(vm);
     
     return 0;
 }
@@ -166,12 +370,14 @@ int ember_vfs_unmount(ember_vm* vm, const char* virtual_path) {
         if (strcmp(vm->mounts[i].virtual_path, virtual_path) == 0) {
             free(vm->mounts[i].virtual_path);
             free(vm->mounts[i].host_path);
+            if (vm->mounts[i].dir_fd >= 0) close(vm->mounts[i].dir_fd);
             
             // Move last mount to this position
             if (i < vm->mount_count - 1) {
                 vm->mounts[i] = vm->mounts[vm->mount_count - 1];
             }
             vm->mount_count--;
+            vfs_rebuild_index(vm);
             return 0;
         }
     }
@@ -201,21 +407,8 @@ static int is_safe_path_component(const char* component, size_t len) {
     return 1;
 }
 
-// Resolve a virtual path to a host path
-char* ember_vfs_resolve(ember_vm* vm, const char* virtual_path) {
-    if (!vm || !virtual_path) return NULL;
-    
-    // Validate input path length to prevent buffer overflows
-    size_t vpath_len = strlen(virtual_path);
-    if (vpath_len == 0 || vpath_len >= PATH_MAX) {
-        fprintf(stderr, "[SECURITY] Invalid path length: %zu\n", vpath_len);
-        return NULL;
-    }
-    
-    // Virtual paths must be absolute
-    if (virtual_path[0] != '/') return NULL;
-    
-    // Validate path components to prevent traversal
+// Every component after the leading slash is safe to join onto a host path
+static int vfs_valid_components(const char* virtual_path, size_t vpath_len) {
     const char* component = virtual_path + 1;  // Skip initial /
     const char* next_slash;
     
@@ -225,7 +418,7 @@ char* ember_vfs_resolve(ember_vm* vm, const char* virtual_path) {
         // Prevent integer overflow in pointer arithmetic
         if (next_slash && next_slash < component) {
             fprintf(stderr, "[SECURITY] Invalid pointer arithmetic detected\n");
-            return NULL;
+            return 0;
         }
         
         size_t component_len;
@@ -234,20 +427,20 @@ char* ember_vfs_resolve(ember_vm* vm, const char* virtual_path) {
             ptrdiff_t diff = next_slash - component;
             if (diff < 0 || diff > PATH_MAX) {
                 fprintf(stderr, "[SECURITY] Component length overflow detected\n");
-                return NULL;
+                return 0;
             }
             component_len = (size_t)diff;
         } else {
             component_len = strlen(component);
             if (component_len > PATH_MAX) {
                 fprintf(stderr, "[SECURITY] Component too long: %zu\n", component_len);
-                return NULL;
+                return 0;
             }
         }
         
         if (!is_safe_path_component(component, component_len)) {
             fprintf(stderr, "[SECURITY] Path traversal attempt blocked: %s\n", virtual_path);
-            return NULL;
+            return 0;
         }
         
         component = next_slash ? next_slash + 1 : component + component_len;
@@ -255,46 +448,47 @@ char* ember_vfs_resolve(ember_vm* vm, const char* virtual_path) {
         // Prevent infinite loops from malformed paths
         if (component > virtual_path + vpath_len) {
             fprintf(stderr, "[SECURITY] Path parsing error detected\n");
-            return NULL;
+            return 0;
         }
     }
+    return 1;
+}
+
+// Resolve a virtual path to a host path
+char* ember_vfs_resolve(ember_vm* vm, const char* virtual_path) {
+    if (!vm || !virtual_path) return NULL;
     
-    // Find the best matching mount (longest prefix match)
-    ember_mount_point* best_mount = NULL;
-    size_t best_len = 0;
+    // Validate input path length to prevent buffer overflows
+    size_t vpath_len = strlen(virtual_path);
+    if (vpath_len == 0 || vpath_len >= PATH_MAX) {
+        fprintf(stderr, "[SECURITY] Invalid path length: %zu\n", vpath_len);
+        return NULL;
+    }
+    
+    // Virtual paths must be absolute
+    if (virtual_path[0] != '/') return NULL;
     
+    // Resolved before, against the same mounts
+    uint64_t hash = vfs_hash(virtual_path, vpath_len);
+    const char* cached = vfs_cache_lookup(vm, virtual_path, vpath_len, hash);
+    if (cached) {
+        return strdup(cached);
+    }
+    
+    // Validate path components to prevent traversal
+    if (!vfs_valid_components(virtual_path, vpath_len)) {
+        return NULL;
+    }
+    
+    // Find the best matching mount (longest prefix match)
     // Ensure mount_count is within bounds to prevent out-of-bounds access
     if (vm->mount_count < 0 || vm->mount_count > EMBER_MAX_MOUNTS) {
         fprintf(stderr, "[SECURITY] Invalid mount count: %d\n", vm->mount_count);
         return NULL;
     }
     
-    for (int i = 0; i < vm->mount_count; i++) {
-        // Validate mount structure integrity
-        if (!vm->mounts[i].virtual_path || !vm->mounts[i].host_path) {
-            fprintf(stderr, "[SECURITY] Invalid mount at index %d\n", i);
-            continue;
-        }
-        
-        size_t mount_len = strlen(vm->mounts[i].virtual_path);
-        
-        // Prevent buffer overread with mount_len check
-        if (mount_len == 0 || mount_len > vpath_len) continue;
-        
-        // Check if virtual path starts with mount's virtual path
-        if (strncmp(virtual_path, vm->mounts[i].virtual_path, mount_len) == 0) {
-            // Ensure it's a proper path boundary with safe array access
-            if (virtual_path[mount_len] == '\0' || 
-                virtual_path[mount_len] == '/' ||
-                (mount_len > 0 && vm->mounts[i].virtual_path[mount_len - 1] == '/')) {
-                
-                if (mount_len > best_len) {
-                    best_mount = &vm->mounts[i];
-                    best_len = mount_len;
-                }
-            }
-        }
-    }
+    size_t best_len = 0;
+    ember_mount_point* best_mount = vfs_find_mount(vm, virtual_path, &best_len);
     
     if (!best_mount) {
         fprintf(stderr, "[SECURITY] No valid mount found for path: %s\n", virtual_path);
@@ -403,6 +597,7 @@ char* ember_vfs_resolve(ember_vm* vm, const char* virtual_path) {
             return NULL;
         }
         strcpy(resolved, final_path);
+        vfs_cache_store(vm, virtual_path, vpath_len, hash, resolved);
     }
     
     return resolved;
@@ -428,38 +623,84 @@ int ember_vfs_check_access(ember_vm* vm, const char* virtual_path, int write_acc
         return 0;
     }
     
-    // Find the matching mount
-    for (int i = 0; i < vm->mount_count; i++) {
-        // Validate mount structure
-        if (!vm->mounts[i].virtual_path || !vm->mounts[i].host_path) {
-            fprintf(stderr, "[SECURITY] Invalid mount structure at index %d\n", i);
-            continue;
-        }
-        
-        size_t mount_len = strlen(vm->mounts[i].virtual_path);
-        
-        // Prevent buffer overread
-        if (mount_len == 0 || mount_len > path_len) continue;
-        
-        if (strncmp(virtual_path, vm->mounts[i].virtual_path, mount_len) == 0) {
-            if (virtual_path[mount_len] == '\0' || 
-                virtual_path[mount_len] == '/' ||
-                (mount_len > 0 && vm->mounts[i].virtual_path[mount_len - 1] == '/')) {
-                
-                // Check permissions
-                if (write_access && (vm->mounts[i].flags & EMBER_MOUNT_RO)) {
-                    fprintf(stderr, "[SECURITY] Write access denied on read-only mount: %s\n", virtual_path);
-                    return 0; // Write access denied on read-only mount
-                }
-                return 1; // Access allowed
-            }
+    // Find the matching mount; a nested mount decides for the paths below it
+    size_t prefix_length = 0;
+    ember_mount_point* mount = vfs_find_mount(vm, virtual_path, &prefix_length);
+    if (mount) {
+        // Check permissions
+        if (write_access && (mount->flags & EMBER_MOUNT_RO)) {
+            fprintf(stderr, "[SECURITY] Write access denied on read-only mount: %s\n", virtual_path);
+            return 0; // Write access denied on read-only mount
         }
+        return 1; // Access allowed
     }
     
     fprintf(stderr, "[SECURITY] No mount found for path: %s\n", virtual_path);
     return 0; // No mount found - access denied
 }
 
+#if defined(__linux__) && defined(SYS_openat2)
+// Set once the kernel turns openat2 down, so later opens go straight to
+// the path checks
+static int vfs_openat2_missing = 0;
+#endif
+
+// Open a virtual path. Where openat2 exists the lookup starts at the
+// mount's directory fd and the kernel keeps it beneath that directory,
+// symlinks included; elsewhere the path goes through ember_vfs_resolve.
+// Returns a descriptor, or -1
+int ember_vfs_open(ember_vm* vm, const char* virtual_path, int flags, int mode) {
+    if (!vm || !virtual_path) return -1;
+    
+    size_t vpath_len = strlen(virtual_path);
+    if (vpath_len == 0 || vpath_len >= PATH_MAX || virtual_path[0] != '/') {
+        fprintf(stderr, "[SECURITY] Invalid path: %s\n", virtual_path);
+        return -1;
+    }
+    if (!vfs_valid_components(virtual_path, vpath_len)) {
+        return -1;
+    }
+    
+    size_t prefix_length = 0;
+    ember_mount_point* mount = vfs_find_mount(vm, virtual_path, &prefix_length);
+    if (!mount) {
+        fprintf(stderr, "[SECURITY] No mount found for path: %s\n", virtual_path);
+        return -1;
+    }
+    int writes = (flags & O_ACCMODE) != O_RDONLY || (flags & (O_CREAT | O_TRUNC | O_APPEND));
+    if (writes && (mount->flags & EMBER_MOUNT_RO)) {
+        fprintf(stderr, "[SECURITY] Write access denied on read-only mount: %s\n", virtual_path);
+        return -1;
+    }
+    
+#if defined(__linux__) && defined(SYS_openat2)
+    if (mount->dir_fd >= 0 && !__atomic_load_n(&vfs_openat2_missing, __ATOMIC_RELAXED)) {
+        const char* relative = virtual_path + prefix_length;
+        while (*relative == '/') relative++;
+        struct open_how how;
+        memset(&how, 0, sizeof(how));
+        how.flags = (uint64_t)(flags | O_CLOEXEC);
+        how.mode = (flags & O_CREAT) ? (uint64_t)mode : 0;
+        how.resolve = RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS;
+        int fd = (int)syscall(SYS_openat2, mount->dir_fd, *relative ? relative : ".", &how, sizeof(how));
+        if (fd >= 0 || errno != ENOSYS) {
+            if (fd < 0 && errno == EXDEV) {
+                fprintf(stderr, "[SECURITY] Path escape attempt blocked: %s\n", virtual_path);
+            }
+            return fd;
+        }
+        // An older kernel, or a seccomp filter that does not know openat2
+        __atomic_store_n(&vfs_openat2_missing, 1, __ATOMIC_RELAXED);
+    }
+#endif
+    
+    char* host_path = ember_vfs_resolve(vm, virtual_path);
+    if (!host_path) return -1;
+    int fd = open(host_path, flags | O_CLOEXEC, mode);
+    free(host_path);
+    return fd;
+}
+
 // Clean up VFS resources
 void ember_vfs_cleanup(ember_vm* vm) {
     if (!vm) return;
@@ -467,10 +708,13 @@ void ember_vfs_cleanup(ember_vm* vm) {
     for (int i = 0; i < vm->mount_count; i++) {
         free(vm->mounts[i].virtual_path);
         free(vm->mounts[i].host_path);
+        if (vm->mounts[i].dir_fd >= 0) close(vm->mounts[i].dir_fd);
     }
     
     free(vm->mounts);
     vm->mounts = NULL;
     vm->mount_count = 0;
     vm->mount_capacity = 0;
+    vfs_index_free(vm->vfs_index);
+    vm->vfs_index = NULL;
 }
\ No newline at end of file
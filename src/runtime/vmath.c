@@ -0,0 +1,405 @@
+/**
+ * Vector math over typed arrays: whole-array kernels run in C with SIMD
+ * instead of an Ember loop per element
+ * vmath_sum / vmath_dot / vmath_min / vmath_max reduce to a number;
+ * vmath_scale / vmath_add / vmath_mul / vmath_clamp / vmath_prefix_sum /
+ * vmath_sqrt / vmath_exp / vmath_log write a float64 array, a new one or
+ * the `out` argument (which may be an input, for in-place updates).
+ * int32 and uint8 inputs are read as doubles
+ */
+
+#include "ember.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+// One vector type per target, chosen at compile time like json_simple.c's
+// scanner; the scalar fallback is a vector of one double, so each kernel
+// below is written once
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#define VMATH_WIDTH 8
+
+typedef __m512d vmath_vec;
+static inline vmath_vec vmath_load(const double* at) { return _mm512_loadu_pd(at); }
+static inline void vmath_store(double* at, vmath_vec v) { _mm512_storeu_pd(at, v); }
+static inline vmath_vec vmath_set(double x) { return _mm512_set1_pd(x); }
+static inline vmath_vec vmath_add(vmath_vec a, vmath_vec b) { return _mm512_add_pd(a, b); }
+static inline vmath_vec vmath_mul(vmath_vec a, vmath_vec b) { return _mm512_mul_pd(a, b); }
+static inline vmath_vec vmath_min(vmath_vec a, vmath_vec b) { return _mm512_min_pd(a, b); }
+static inline vmath_vec vmath_max(vmath_vec a, vmath_vec b) { return _mm512_max_pd(a, b); }
+static inline vmath_vec vmath_sqrt(vmath_vec v) { return _mm512_sqrt_pd(v); }
+static inline int vmath_nan(vmath_vec v) { return _mm512_cmp_pd_mask(v, v, _CMP_UNORD_Q) != 0; }
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define VMATH_WIDTH 4
+
+typedef __m256d vmath_vec;
+static inline vmath_vec vmath_load(const double* at) { return _mm256_loadu_pd(at); }
+static inline void vmath_store(double* at, vmath_vec v) { _mm256_storeu_pd(at, v); }
+static inline vmath_vec vmath_set(double x) { return _mm256_set1_pd(x); }
+static inline vmath_vec vmath_add(vmath_vec a, vmath_vec b) { return _mm256_add_pd(a, b); }
+static inline vmath_vec vmath_mul(vmath_vec a, vmath_vec b) { return _mm256_mul_pd(a, b); }
+static inline vmath_vec vmath_min(vmath_vec a, vmath_vec b) { return _mm256_min_pd(a, b); }
+static inline vmath_vec vmath_max(vmath_vec a, vmath_vec b) { return _mm256_max_pd(a, b); }
+static inline vmath_vec vmath_sqrt(vmath_vec v) { return _mm256_sqrt_pd(v); }
+static inline int vmath_nan(vmath_vec v) { return _mm256_movemask_pd(_mm256_cmp_pd(v, v, _CMP_UNORD_Q)) != 0; }
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define VMATH_WIDTH 2
+
+typedef __m128d vmath_vec;
+static inline vmath_vec vmath_load(const double* at) { return _mm_loadu_pd(at); }
+static inline void vmath_store(double* at, vmath_vec v) { _mm_storeu_pd(at, v); }
+static inline vmath_vec vmath_set(double x) { return _mm_set1_pd(x); }
+static inline vmath_vec vmath_add(vmath_vec a, vmath_vec b) { return _mm_add_pd(a, b); }
+static inline vmath_vec vmath_mul(vmath_vec a, vmath_vec b) { return _mm_mul_pd(a, b); }
+static inline vmath_vec vmath_min(vmath_vec a, vmath_vec b) { return _mm_min_pd(a, b); }
+static inline vmath_vec vmath_max(vmath_vec a, vmath_vec b) { return _mm_max_pd(a, b); }
+static inline vmath_vec vmath_sqrt(vmath_vec v) { return _mm_sqrt_pd(v); }
+static inline int vmath_nan(vmath_vec v) { return _mm_movemask_pd(_mm_cmpunord_pd(v, v)) != 0; }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define VMATH_WIDTH 2
+
+typedef float64x2_t vmath_vec;
+static inline vmath_vec vmath_load(const double* at) { return vld1q_f64(at); }
+static inline void vmath_store(double* at, vmath_vec v) { vst1q_f64(at, v); }
+static inline vmath_vec vmath_set(double x) { return vdupq_n_f64(x); }
+static inline vmath_vec vmath_add(vmath_vec a, vmath_vec b) { return vaddq_f64(a, b); }
+static inline vmath_vec vmath_mul(vmath_vec a, vmath_vec b) { return vmulq_f64(a, b); }
+static inline vmath_vec vmath_min(vmath_vec a, vmath_vec b) { return vminq_f64(a, b); }
+static inline vmath_vec vmath_max(vmath_vec a, vmath_vec b) { return vmaxq_f64(a, b); }
+static inline vmath_vec vmath_sqrt(vmath_vec v) { return vsqrtq_f64(v); }
+static inline int vmath_nan(vmath_vec v) {
+    uint64x2_t ordered = vceqq_f64(v, v);
+    return (vgetq_lane_u64(ordered, 0) & vgetq_lane_u64(ordered, 1)) == 0;
+}
+#else
+#define VMATH_WIDTH 1
+
+typedef double vmath_vec;
+static inline vmath_vec vmath_load(const double* at) { return *at; }
+static inline void vmath_store(double* at, vmath_vec v) { *at = v; }
+static inline vmath_vec vmath_set(double x) { return x; }
+static inline vmath_vec vmath_add(vmath_vec a, vmath_vec b) { return a + b; }
+static inline vmath_vec vmath_mul(vmath_vec a, vmath_vec b) { return a * b; }
+static inline vmath_vec vmath_min(vmath_vec a, vmath_vec b) { return a < b ? a : b; }
+static inline vmath_vec vmath_max(vmath_vec a, vmath_vec b) { return a > b ? a : b; }
+static inline vmath_vec vmath_sqrt(vmath_vec v) { return sqrt(v); }
+static inline int vmath_nan(vmath_vec v) { return v != v; }
+#endif
+
+// Sums and dot products keep 16 running partial sums, element i going to
+// sum i % 16, added pairwise at the end: enough independent adds to hide
+// their latency, and the same rounding whatever VMATH_WIDTH is. Multiply
+// and add stay separate instructions (no FMA) for the same reason
+#define VMATH_LANES 16
+#define VMATH_VECTORS (VMATH_LANES / VMATH_WIDTH)
+
+typedef enum { VMATH_MIN, VMATH_MAX } vmath_extreme;
+typedef enum { VMATH_ADD, VMATH_MUL } vmath_binary;
+typedef enum { VMATH_EXP, VMATH_LOG } vmath_unary;
+
+// ============================================================================
+// KERNELS
+// ============================================================================
+
+static double vmath_fold_lanes(double* lanes) {
+    for (int width = VMATH_LANES / 2; width > 0; width /= 2) {
+        for (int i = 0; i < width; i++) lanes[i] += lanes[i + width];
+    }
+    return lanes[0];
+}
+
+// b NULL: sum of a; otherwise the dot product of a and b
+static double vmath_reduce(const double* a, const double* b, int n) {
+    vmath_vec sums[VMATH_VECTORS];
+    for (int v = 0; v < VMATH_VECTORS; v++) sums[v] = vmath_set(0);
+    int i = 0;
+    for (; i + VMATH_LANES <= n; i += VMATH_LANES) {
+        for (int v = 0; v < VMATH_VECTORS; v++) {
+            vmath_vec x = vmath_load(a + i + v * VMATH_WIDTH);
+            if (b) x = vmath_mul(x, vmath_load(b + i + v * VMATH_WIDTH));
+            sums[v] = vmath_add(sums[v], x);
+        }
+    }
+    double lanes[VMATH_LANES];
+    for (int v = 0; v < VMATH_VECTORS; v++) vmath_store(lanes + v * VMATH_WIDTH, sums[v]);
+    for (int lane = 0; i < n; i++, lane++) lanes[lane] += b ? a[i] * b[i] : a[i];
+    return vmath_fold_lanes(lanes);
+}
+
+// NaN if any element is NaN, as Math.min/max do; n > 0
+static double vmath_extremum(const double* a, int n, vmath_extreme which) {
+    vmath_vec best = vmath_set(a[0]);
+    int nan = 0;
+    int i = 0;
+    for (; i + VMATH_WIDTH <= n; i += VMATH_WIDTH) {
+        vmath_vec x = vmath_load(a + i);
+        nan |= vmath_nan(x);
+        best = which == VMATH_MIN ? vmath_min(x, best) : vmath_max(x, best);
+    }
+    if (nan) return NAN;
+    double lanes[VMATH_WIDTH];
+    vmath_store(lanes, best);
+    double result = lanes[0];
+    for (int lane = 1; lane < VMATH_WIDTH; lane++) {
+        result = which == VMATH_MIN ? fmin(result, lanes[lane]) : fmax(result, lanes[lane]);
+    }
+    for (; i < n; i++) {
+        if (a[i] != a[i]) return NAN;
+        result = which == VMATH_MIN ? fmin(result, a[i]) : fmax(result, a[i]);
+    }
+    return result;
+}
+
+// out[i] = a[i] op b[i], or a[i] op scalar when b is NULL
+static void vmath_combine(double* out, const double* a, const double* b, double scalar, int n, vmath_binary op) {
+    vmath_vec k = vmath_set(scalar);
+    int i = 0;
+    for (; i + VMATH_WIDTH <= n; i += VMATH_WIDTH) {
+        vmath_vec y = b ? vmath_load(b + i) : k;
+        vmath_vec x = vmath_load(a + i);
+        vmath_store(out + i, op == VMATH_ADD ? vmath_add(x, y) : vmath_mul(x, y));
+    }
+    for (; i < n; i++) {
+        double y = b ? b[i] : scalar;
+        out[i] = op == VMATH_ADD ? a[i] + y : a[i] * y;
+    }
+}
+
+// min(hi, max(lo, x)) with NaN passed through: vector min/max return their
+// second operand when either is NaN
+static void vmath_clamp_kernel(double* out, const double* a, double lo, double hi, int n) {
+    vmath_vec low = vmath_set(lo), high = vmath_set(hi);
+    int i = 0;
+    for (; i + VMATH_WIDTH <= n; i += VMATH_WIDTH) {
+        vmath_store(out + i, vmath_min(high, vmath_max(low, vmath_load(a + i))));
+    }
+    for (; i < n; i++) {
+        double x = a[i];
+        out[i] = x != x ? x : x < lo ? lo : x > hi ? hi : x;
+    }
+}
+
+static void vmath_sqrt_kernel(double* out, const double* a, int n) {
+    int i = 0;
+    for (; i + VMATH_WIDTH <= n; i += VMATH_WIDTH) {
+        vmath_store(out + i, vmath_sqrt(vmath_load(a + i)));
+    }
+    for (; i < n; i++) out[i] = sqrt(a[i]);
+}
+
+// ============================================================================
+// NATIVES
+// ============================================================================
+
+// The elements of a typed array as doubles: float64 data itself, or a
+// converted copy left in *owned for the caller to free
+static const double* vmath_view(ember_typed_array* array, double** owned) {
+    *owned = NULL;
+    if (array->kind == EMBER_TYPED_FLOAT64) return array->data;
+    double* copy = malloc((array->length > 0 ? (size_t)array->length : 1) * sizeof(double));
+    if (!copy) return NULL;
+    for (int i = 0; i < array->length; i++) copy[i] = ember_typed_array_load(array, i);
+    *owned = copy;
+    return copy;
+}
+
+// argv[at], if given, must be a float64 array of the given length; without
+// it a new one is made. Nil on failure
+static ember_value vmath_output(ember_vm* vm, int argc, ember_value* argv, int at, int length) {
+    if (at < argc && argv[at].type != EMBER_VAL_NIL) {
+        if (argv[at].type != EMBER_VAL_TYPED_ARRAY) return ember_make_nil();
+        ember_typed_array* out = AS_TYPED_ARRAY(argv[at]);
+        if (out->kind != EMBER_TYPED_FLOAT64 || out->length != length) return ember_make_nil();
+        return argv[at];
+    }
+    return ember_make_typed_array(vm, EMBER_TYPED_FLOAT64, length);
+}
+
+static bool vmath_is_number(ember_value value) {
+    return value.type == EMBER_VAL_NUMBER;
+}
+
+// vmath_sum(a): the sum of the elements, 0 when empty
+ember_value ember_native_vmath_sum(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc != 1 || argv[0].type != EMBER_VAL_TYPED_ARRAY) return ember_make_nil();
+    ember_typed_array* array = AS_TYPED_ARRAY(argv[0]);
+    double* owned;
+    const double* a = vmath_view(array, &owned);
+    if (!a) return ember_make_nil();
+    double sum = vmath_reduce(a, NULL, array->length);
+    free(owned);
+    return ember_make_number(sum);
+}
+
+// vmath_dot(a, b): the sum of a[i] * b[i]; nil if the lengths differ
+ember_value ember_native_vmath_dot(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc != 2 || argv[0].type != EMBER_VAL_TYPED_ARRAY || argv[1].type != EMBER_VAL_TYPED_ARRAY) {
+        return ember_make_nil();
+    }
+    ember_typed_array* left = AS_TYPED_ARRAY(argv[0]);
+    ember_typed_array* right = AS_TYPED_ARRAY(argv[1]);
+    if (left->length != right->length) return ember_make_nil();
+    double* owned_a;
+    double* owned_b = NULL;
+    const double* a = vmath_view(left, &owned_a);
+    const double* b = a ? vmath_view(right, &owned_b) : NULL;
+    ember_value result = a && b ? ember_make_number(vmath_reduce(a, b, left->length)) : ember_make_nil();
+    free(owned_a);
+    free(owned_b);
+    return result;
+}
+
+static ember_value vmath_native_extremum(int argc, ember_value* argv, vmath_extreme which) {
+    if (argc != 1 || argv[0].type != EMBER_VAL_TYPED_ARRAY) return ember_make_nil();
+    ember_typed_array* array = AS_TYPED_ARRAY(argv[0]);
+    if (array->length == 0) return ember_make_nil();
+    double* owned;
+    const double* a = vmath_view(array, &owned);
+    if (!a) return ember_make_nil();
+    double result = vmath_extremum(a, array->length, which);
+    free(owned);
+    return ember_make_number(result);
+}
+
+// vmath_min(a) / vmath_max(a): nil when empty, NaN if any element is
+ember_value ember_native_vmath_min(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    return vmath_native_extremum(argc, argv, VMATH_MIN);
+}
+
+ember_value ember_native_vmath_max(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    return vmath_native_extremum(argc, argv, VMATH_MAX);
+}
+
+// a op b elementwise, b a typed array of a's length or a number
+static ember_value vmath_native_binary(ember_vm* vm, int argc, ember_value* argv, vmath_binary op) {
+    if (argc < 2 || argc > 3 || argv[0].type != EMBER_VAL_TYPED_ARRAY) return ember_make_nil();
+    ember_typed_array* left = AS_TYPED_ARRAY(argv[0]);
+    int length = left->length;
+    if (!vmath_is_number(argv[1]) &&
+        (argv[1].type != EMBER_VAL_TYPED_ARRAY || AS_TYPED_ARRAY(argv[1])->length != length)) {
+        return ember_make_nil();
+    }
+    ember_value out = vmath_output(vm, argc, argv, 2, length);
+    if (out.type != EMBER_VAL_TYPED_ARRAY) return out;
+
+    double* owned_a;
+    double* owned_b = NULL;
+    const double* a = vmath_view(left, &owned_a);
+    const double* b = NULL;
+    if (a && argv[1].type == EMBER_VAL_TYPED_ARRAY) {
+        b = vmath_view(AS_TYPED_ARRAY(argv[1]), &owned_b);
+        if (!b) a = NULL;
+    }
+    if (a) {
+        double scalar = vmath_is_number(argv[1]) ? argv[1].as.number_val : 0;
+        vmath_combine(AS_TYPED_ARRAY(out)->data, a, b, scalar, length, op);
+    }
+    free(owned_a);
+    free(owned_b);
+    return a ? out : ember_make_nil();
+}
+
+// vmath_add(a, b[, out]) / vmath_mul(a, b[, out])
+ember_value ember_native_vmath_add(ember_vm* vm, int argc, ember_value* argv) {
+    return vmath_native_binary(vm, argc, argv, VMATH_ADD);
+}
+
+ember_value ember_native_vmath_mul(ember_vm* vm, int argc, ember_value* argv) {
+    return vmath_native_binary(vm, argc, argv, VMATH_MUL);
+}
+
+// vmath_scale(a, k[, out]): a * k
+ember_value ember_native_vmath_scale(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc >= 2 && !vmath_is_number(argv[1])) return ember_make_nil();
+    return vmath_native_binary(vm, argc, argv, VMATH_MUL);
+}
+
+// vmath_clamp(a, lo, hi[, out]); nil if lo > hi
+ember_value ember_native_vmath_clamp(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc < 3 || argc > 4 || argv[0].type != EMBER_VAL_TYPED_ARRAY ||
+        !vmath_is_number(argv[1]) || !vmath_is_number(argv[2])) {
+        return ember_make_nil();
+    }
+    double lo = argv[1].as.number_val, hi = argv[2].as.number_val;
+    if (!(lo <= hi)) return ember_make_nil();
+    ember_typed_array* array = AS_TYPED_ARRAY(argv[0]);
+    ember_value out = vmath_output(vm, argc, argv, 3, array->length);
+    if (out.type != EMBER_VAL_TYPED_ARRAY) return out;
+    double* owned;
+    const double* a = vmath_view(array, &owned);
+    if (!a) return ember_make_nil();
+    vmath_clamp_kernel(AS_TYPED_ARRAY(out)->data, a, lo, hi, array->length);
+    free(owned);
+    return out;
+}
+
+// vmath_prefix_sum(a[, out]): out[i] = a[0] + ... + a[i]. Each sum needs
+// the one before, so this stays a scalar loop, added left to right
+ember_value ember_native_vmath_prefix_sum(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc < 1 || argc > 2 || argv[0].type != EMBER_VAL_TYPED_ARRAY) return ember_make_nil();
+    ember_typed_array* array = AS_TYPED_ARRAY(argv[0]);
+    ember_value out = vmath_output(vm, argc, argv, 1, array->length);
+    if (out.type != EMBER_VAL_TYPED_ARRAY) return out;
+    double* owned;
+    const double* a = vmath_view(array, &owned);
+    if (!a) return ember_make_nil();
+    double* result = AS_TYPED_ARRAY(out)->data;
+    double running = 0;
+    for (int i = 0; i < array->length; i++) {
+        running += a[i];
+        result[i] = running;
+    }
+    free(owned);
+    return out;
+}
+
+// vmath_sqrt(a[, out]): negative elements give NaN
+ember_value ember_native_vmath_sqrt(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc < 1 || argc > 2 || argv[0].type != EMBER_VAL_TYPED_ARRAY) return ember_make_nil();
+    ember_typed_array* array = AS_TYPED_ARRAY(argv[0]);
+    ember_value out = vmath_output(vm, argc, argv, 1, array->length);
+    if (out.type != EMBER_VAL_TYPED_ARRAY) return out;
+    double* owned;
+    const double* a = vmath_view(array, &owned);
+    if (!a) return ember_make_nil();
+    vmath_sqrt_kernel(AS_TYPED_ARRAY(out)->data, a, array->length);
+    free(owned);
+    return out;
+}
+
+// exp and log have no vector instruction; a tight loop over libm, which
+// the compiler may vectorize itself when it has a vector libm to call
+static ember_value vmath_native_unary(ember_vm* vm, int argc, ember_value* argv, vmath_unary op) {
+    if (argc < 1 || argc > 2 || argv[0].type != EMBER_VAL_TYPED_ARRAY) return ember_make_nil();
+    ember_typed_array* array = AS_TYPED_ARRAY(argv[0]);
+    ember_value out = vmath_output(vm, argc, argv, 1, array->length);
+    if (out.type != EMBER_VAL_TYPED_ARRAY) return out;
+    double* owned;
+    const double* a = vmath_view(array, &owned);
+    if (!a) return ember_make_nil();
+    double* result = AS_TYPED_ARRAY(out)->data;
+    if (op == VMATH_EXP) {
+        for (int i = 0; i < array->length; i++) result[i] = exp(a[i]);
+    } else {
+        for (int i = 0; i < array->length; i++) result[i] = log(a[i]);
+    }
+    free(owned);
+    return out;
+}
+
+// vmath_exp(a[, out]) / vmath_log(a[, out])
+ember_value ember_native_vmath_exp(ember_vm* vm, int argc, ember_value* argv) {
+    return vmath_native_unary(vm, argc, argv, VMATH_EXP);
+}
+
+ember_value ember_native_vmath_log(ember_vm* vm, int argc, ember_value* argv) {
+    return vmath_native_unary(vm, argc, argv, VMATH_LOG);
+}
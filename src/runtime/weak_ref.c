@@ -0,0 +1,226 @@
+/**
+ * Weak references and weak maps for Ember: weak_ref / weak_ref_get /
+ * weak_map / weak_map_get / weak_map_set / weak_map_has /
+ * weak_map_delete / weak_map_size
+ *
+ * A weak reference holds an object without keeping it alive; once a
+ * collection finds nothing else that does, the reference reads nil.
+ * A weak map attaches values to objects the same way: an entry lasts as
+ * long as its key does, and its value is kept only through the key, so
+ * metadata hung on request or instance objects goes with them, cycles
+ * back to the key included.
+ *
+ * Neither is traced. Both register with the collector when made, and
+ * gc_sweep_weak (gc_generational.c) clears them once marking is done,
+ * reading the mark bits every collector leaves on ember_object. For the
+ * same reason neither needs the write barrier: every map is visited after
+ * marking, however old it is.
+ */
+
+#include "ember.h"
+#include "../vm.h"
+#include "value/value.h"
+#include "../core/gc_trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define WEAK_MAP_MIN_CAPACITY 8
+#define WEAK_MAP_MAX_CAPACITY (1 << 30)
+
+// The object a key stands for, or NULL if the value cannot be a key
+static ember_object* weak_key(ember_value key) {
+    return key.type == EMBER_VAL_STRING ? NULL : gc_value_object(key);
+}
+
+// Objects never move, so the address is the identity; the low bits are
+// alignment and the mix spreads the rest
+static inline uint32_t weak_hash(const ember_object* object) {
+    uint64_t h = (uint64_t)(uintptr_t)object;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (uint32_t)h;
+}
+
+static int weak_map_find(const ember_weak_map* map, const ember_object* key) {
+    if (map->capacity == 0) return -1;
+    int mask = map->capacity - 1;
+    for (int slot = (int)(weak_hash(key) & (uint32_t)mask);; slot = (slot + 1) & mask) {
+        const ember_weak_entry* entry = &map->entries[slot];
+        if (entry->key.type == EMBER_VAL_NIL) return -1;
+        if (entry->key.as.obj_val == key) return slot;
+    }
+}
+
+static int weak_map_resize(ember_weak_map* map, int capacity) {
+    ember_weak_entry* entries = malloc((size_t)capacity * sizeof(ember_weak_entry));
+    if (!entries) return 0;
+    for (int i = 0; i < capacity; i++) {
+        entries[i].key = ember_make_nil();
+        entries[i].value = ember_make_nil();
+    }
+    int mask = capacity - 1;
+    for (int i = 0; i < map->capacity; i++) {
+        ember_weak_entry* entry = &map->entries[i];
+        if (entry->key.type == EMBER_VAL_NIL) continue;
+        int slot = (int)(weak_hash(entry->key.as.obj_val) & (uint32_t)mask);
+        while (entries[slot].key.type != EMBER_VAL_NIL) {
+            slot = (slot + 1) & mask;
+        }
+        entries[slot] = *entry;
+    }
+    free(map->entries);
+    map->entries = entries;
+    map->capacity = capacity;
+    return 1;
+}
+
+ember_value ember_make_weak_ref(ember_vm* vm, ember_value target) {
+    if (target.type != EMBER_VAL_NIL && !gc_value_object(target)) return ember_make_nil();
+    ember_weak_ref* ref = (ember_weak_ref*)allocate_object(vm, sizeof(ember_weak_ref), OBJ_WEAK_REF);
+    if (!ref) return ember_make_nil();
+    ref->target = target;
+    if (!gc_register_weak(vm, (ember_object*)ref)) {
+        // Unregistered, the target could be freed under it
+        ref->target = ember_make_nil();
+        return ember_make_nil();
+    }
+    ember_value value;
+    value.type = EMBER_VAL_WEAK_REF;
+    value.as.obj_val = (ember_object*)ref;
+    return value;
+}
+
+ember_value ember_make_weak_map(ember_vm* vm) {
+    ember_weak_map* map = (ember_weak_map*)allocate_object(vm, sizeof(ember_weak_map), OBJ_WEAK_MAP);
+    if (!map) return ember_make_nil();
+    map->entries = NULL;
+    map->capacity = 0;
+    map->count = 0;
+    if (!gc_register_weak(vm, (ember_object*)map)) return ember_make_nil();
+    ember_value value;
+    value.type = EMBER_VAL_WEAK_MAP;
+    value.as.obj_val = (ember_object*)map;
+    return value;
+}
+
+int weak_map_get(const ember_weak_map* map, ember_value key, ember_value* value) {
+    ember_object* object = weak_key(key);
+    int slot = object ? weak_map_find(map, object) : -1;
+    if (slot < 0) return 0;
+    *value = map->entries[slot].value;
+    return 1;
+}
+
+int weak_map_set(ember_vm* vm, ember_weak_map* map, ember_value key, ember_value value) {
+    (void)vm;
+    ember_object* object = weak_key(key);
+    if (!object || ember_object_is_frozen(map)) return 0;
+    int slot = weak_map_find(map, object);
+    if (slot >= 0) {
+        map->entries[slot].value = value;
+        return 1;
+    }
+    // At most three quarters full
+    if ((map->count + 1) * 4 > map->capacity * 3) {
+        if (map->capacity >= WEAK_MAP_MAX_CAPACITY) return 0;
+        if (!weak_map_resize(map, map->capacity ? map->capacity * 2 : WEAK_MAP_MIN_CAPACITY)) return 0;
+    }
+    int mask = map->capacity - 1;
+    slot = (int)(weak_hash(object) & (uint32_t)mask);
+    while (map->entries[slot].key.type != EMBER_VAL_NIL) {
+        slot = (slot + 1) & mask;
+    }
+    map->entries[slot].key = key;
+    map->entries[slot].value = value;
+    map->count++;
+    return 1;
+}
+
+void weak_map_remove_slot(ember_weak_map* map, int slot) {
+    int mask = map->capacity - 1;
+    int hole = slot;
+    for (int next = (hole + 1) & mask; map->entries[next].key.type != EMBER_VAL_NIL; next = (next + 1) & mask) {
+        // An entry moves back unless its home lies after the hole, up to
+        // where it sits now
+        int home = (int)(weak_hash(map->entries[next].key.as.obj_val) & (uint32_t)mask);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            map->entries[hole] = map->entries[next];
+            hole = next;
+        }
+    }
+    map->entries[hole].key = ember_make_nil();
+    map->entries[hole].value = ember_make_nil();
+    map->count--;
+}
+
+int weak_map_delete(ember_weak_map* map, ember_value key) {
+    ember_object* object = weak_key(key);
+    int slot = object ? weak_map_find(map, object) : -1;
+    if (slot < 0 || ember_object_is_frozen(map)) return 0;
+    weak_map_remove_slot(map, slot);
+    return 1;
+}
+
+// ============================================================================
+// NATIVES
+// ============================================================================
+
+// weak_ref(object): a weak reference, or nil for numbers, booleans and nil
+ember_value ember_native_weak_ref(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 1 || argv[0].type == EMBER_VAL_NIL) return ember_make_nil();
+    return ember_make_weak_ref(vm, argv[0]);
+}
+
+// weak_ref_get(r): the target, or nil once it has been collected
+ember_value ember_native_weak_ref_get(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc != 1 || argv[0].type != EMBER_VAL_WEAK_REF) return ember_make_nil();
+    return AS_WEAK_REF(argv[0])->target;
+}
+
+ember_value ember_native_weak_map(ember_vm* vm, int argc, ember_value* argv) {
+    (void)argv;
+    if (argc != 0) return ember_make_nil();
+    return ember_make_weak_map(vm);
+}
+
+// weak_map_get(m, key[, default])
+ember_value ember_native_weak_map_get(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc < 2 || argc > 3 || argv[0].type != EMBER_VAL_WEAK_MAP) return ember_make_nil();
+    ember_value value;
+    if (weak_map_get(AS_WEAK_MAP(argv[0]), argv[1], &value)) return value;
+    return argc == 3 ? argv[2] : ember_make_nil();
+}
+
+// weak_map_set(m, key, value): whether it was stored; false for keys that
+// are no objects, and strings
+ember_value ember_native_weak_map_set(ember_vm* vm, int argc, ember_value* argv) {
+    if (argc != 3 || argv[0].type != EMBER_VAL_WEAK_MAP) return ember_make_nil();
+    ember_weak_map* map = AS_WEAK_MAP(argv[0]);
+    if (ember_object_is_frozen(map)) return ember_make_nil();
+    return ember_make_bool(weak_map_set(vm, map, argv[1], argv[2]));
+}
+
+ember_value ember_native_weak_map_has(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc != 2 || argv[0].type != EMBER_VAL_WEAK_MAP) return ember_make_nil();
+    ember_value value;
+    return ember_make_bool(weak_map_get(AS_WEAK_MAP(argv[0]), argv[1], &value));
+}
+
+ember_value ember_native_weak_map_delete(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc != 2 || argv[0].type != EMBER_VAL_WEAK_MAP) return ember_make_nil();
+    return ember_make_bool(weak_map_delete(AS_WEAK_MAP(argv[0]), argv[1]));
+}
+
+// weak_map_size(m): the entries left by the last collection and added since,
+// some of whose keys may already be unreachable
+ember_value ember_native_weak_map_size(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    if (argc != 1 || argv[0].type != EMBER_VAL_WEAK_MAP) return ember_make_nil();
+    return ember_make_number(AS_WEAK_MAP(argv[0])->count);
+}
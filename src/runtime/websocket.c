@@ -0,0 +1,217 @@
+/**
+ * WebSocket framing (RFC 6455): the codec behind the HTTP server's
+ * websocket_* natives. See websocket.h.
+ *
+ * Unmasking is the one pass over every byte a client sends, so it runs a
+ * vector at a time (AVX2, SSE2 or NEON, as json_simple.c picks) with the
+ * mask repeated across the register, then eight bytes at a time, then
+ * bytewise. Every frame's mask starts over at its first payload byte, and
+ * the lanes are multiples of four, so the phase never needs carrying.
+ */
+
+#include "websocket.h"
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/evp.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define WS_SIMD 1
+#define WS_LANE 32
+
+typedef __m256i ws_vec;
+static inline ws_vec ws_load(const uint8_t* at) { return _mm256_loadu_si256((const __m256i*)at); }
+static inline void ws_store(uint8_t* at, ws_vec v) { _mm256_storeu_si256((__m256i*)at, v); }
+static inline ws_vec ws_xor(ws_vec a, ws_vec b) { return _mm256_xor_si256(a, b); }
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define WS_SIMD 1
+#define WS_LANE 16
+
+typedef __m128i ws_vec;
+static inline ws_vec ws_load(const uint8_t* at) { return _mm_loadu_si128((const __m128i*)at); }
+static inline void ws_store(uint8_t* at, ws_vec v) { _mm_storeu_si128((__m128i*)at, v); }
+static inline ws_vec ws_xor(ws_vec a, ws_vec b) { return _mm_xor_si128(a, b); }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define WS_SIMD 1
+#define WS_LANE 16
+
+typedef uint8x16_t ws_vec;
+static inline ws_vec ws_load(const uint8_t* at) { return vld1q_u8(at); }
+static inline void ws_store(uint8_t* at, ws_vec v) { vst1q_u8(at, v); }
+static inline ws_vec ws_xor(ws_vec a, ws_vec b) { return veorq_u8(a, b); }
+#else
+#define WS_SIMD 0
+#define WS_LANE 8
+#endif
+
+#define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+void ws_unmask(uint8_t* data, size_t length, const uint8_t mask[4]) {
+    // The mask repeated, in memory order, so loading it is endian-safe
+    uint8_t pattern[WS_LANE];
+    for (int i = 0; i < WS_LANE; i++) {
+        pattern[i] = mask[i & 3];
+    }
+    size_t i = 0;
+#if WS_SIMD
+    ws_vec key = ws_load(pattern);
+    for (; i + 4 * WS_LANE <= length; i += 4 * WS_LANE) {
+        ws_store(data + i, ws_xor(ws_load(data + i), key));
+        ws_store(data + i + WS_LANE, ws_xor(ws_load(data + i + WS_LANE), key));
+        ws_store(data + i + 2 * WS_LANE, ws_xor(ws_load(data + i + 2 * WS_LANE), key));
+        ws_store(data + i + 3 * WS_LANE, ws_xor(ws_load(data + i + 3 * WS_LANE), key));
+    }
+    for (; i + WS_LANE <= length; i += WS_LANE) {
+        ws_store(data + i, ws_xor(ws_load(data + i), key));
+    }
+#endif
+    uint64_t wide;
+    memcpy(&wide, pattern, sizeof(wide));
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        word ^= wide;
+        memcpy(data + i, &word, sizeof(word));
+    }
+    for (; i < length; i++) {
+        data[i] ^= mask[i & 3];
+    }
+}
+
+void ws_reader_init(ws_reader* reader, size_t max_message) {
+    memset(reader, 0, sizeof(*reader));
+    reader->max_message = max_message;
+}
+
+void ws_reader_free(ws_reader* reader) {
+    free(reader->data);
+    memset(reader, 0, sizeof(*reader));
+}
+
+static int reader_append(ws_reader* reader, const uint8_t* data, size_t length) {
+    if (reader->capacity - reader->length < length) {
+        size_t capacity = reader->capacity ? reader->capacity : 4096;
+        while (capacity - reader->length < length) capacity *= 2;
+        uint8_t* grown = realloc(reader->data, capacity);
+        if (!grown) return 0;
+        reader->data = grown;
+        reader->capacity = capacity;
+    }
+    memcpy(reader->data + reader->length, data, length);
+    reader->length += length;
+    return 1;
+}
+
+ssize_t ws_read(ws_reader* reader, uint8_t* data, size_t length, ws_message* message) {
+    message->opcode = 0;
+    if (length < 2) return 0;
+    int final = data[0] & 0x80;
+    int opcode = data[0] & 0x0F;
+    // No extension was negotiated, and a client must mask
+    if ((data[0] & 0x70) || !(data[1] & 0x80)) return -WS_CLOSE_PROTOCOL;
+
+    uint64_t payload = data[1] & 0x7F;
+    size_t head = 2;
+    if (payload == 126) {
+        if (length < 4) return 0;
+        payload = (uint64_t)data[2] << 8 | data[3];
+        head = 4;
+    } else if (payload == 127) {
+        if (length < 10) return 0;
+        payload = 0;
+        for (int i = 2; i < 10; i++) {
+            payload = payload << 8 | data[i];
+        }
+        if (payload >> 63) return -WS_CLOSE_PROTOCOL;
+        head = 10;
+    }
+
+    if (opcode & 0x8) {
+        // Control frames are short and whole, and may come between fragments
+        if (opcode > WS_PONG || !final || payload > 125) return -WS_CLOSE_PROTOCOL;
+    } else {
+        if (opcode > WS_BINARY || (opcode == WS_CONTINUATION) != (reader->opcode != 0)) return -WS_CLOSE_PROTOCOL;
+        // Refused before it arrives, so it never has to be buffered
+        size_t so_far = opcode == WS_CONTINUATION ? reader->length : 0;
+        if (payload > reader->max_message - so_far) return -WS_CLOSE_TOO_BIG;
+    }
+    if (length - head < 4 || length - head - 4 < payload) return 0;
+
+    uint8_t* body = data + head + 4;
+    ws_unmask(body, (size_t)payload, data + head);
+    if (opcode & 0x8 || (final && opcode != WS_CONTINUATION)) {
+        message->opcode = opcode;
+        message->payload = body;
+        message->length = (size_t)payload;
+    } else {
+        if (opcode != WS_CONTINUATION) {
+            reader->opcode = opcode;
+            reader->length = 0;
+        }
+        if (!reader_append(reader, body, (size_t)payload)) return -WS_CLOSE_TOO_BIG;
+        if (final) {
+            message->opcode = reader->opcode;
+            message->payload = reader->data ? reader->data : body;
+            message->length = reader->length;
+            reader->opcode = 0;
+        }
+    }
+    return (ssize_t)(head + 4 + payload);
+}
+
+size_t ws_frame_head(uint8_t* head, int opcode, size_t length) {
+    head[0] = (uint8_t)(0x80 | opcode);
+    if (length < 126) {
+        head[1] = (uint8_t)length;
+        return 2;
+    }
+    if (length <= 0xFFFF) {
+        head[1] = 126;
+        head[2] = (uint8_t)(length >> 8);
+        head[3] = (uint8_t)length;
+        return 4;
+    }
+    head[1] = 127;
+    for (int i = 0; i < 8; i++) {
+        head[2 + i] = (uint8_t)((uint64_t)length >> (56 - 8 * i));
+    }
+    return 10;
+}
+
+int ws_accept_key(const char* key, size_t length, char accept[29]) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    // 16 bytes in base64: 22 characters and "=="
+    if (length != 24 || key[22] != '=' || key[23] != '=') return -1;
+    for (size_t i = 0; i < 22; i++) {
+        if (!strchr(alphabet, key[i]) || key[i] == '\0') return -1;
+    }
+
+    char joined[24 + sizeof(WS_GUID)];
+    memcpy(joined, key, 24);
+    memcpy(joined + 24, WS_GUID, sizeof(WS_GUID) - 1);
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_length = 0;
+    if (!EVP_Digest(joined, 24 + sizeof(WS_GUID) - 1, digest, &digest_length, EVP_sha1(), NULL) ||
+        digest_length != 20) {
+        return -1;
+    }
+
+    // 20 bytes: six groups of three, then two bytes and one '='
+    char* out = accept;
+    for (int i = 0; i < 18; i += 3) {
+        uint32_t group = (uint32_t)digest[i] << 16 | (uint32_t)digest[i + 1] << 8 | digest[i + 2];
+        *out++ = alphabet[group >> 18 & 63];
+        *out++ = alphabet[group >> 12 & 63];
+        *out++ = alphabet[group >> 6 & 63];
+        *out++ = alphabet[group & 63];
+    }
+    uint32_t group = (uint32_t)digest[18] << 16 | (uint32_t)digest[19] << 8;
+    *out++ = alphabet[group >> 18 & 63];
+    *out++ = alphabet[group >> 12 & 63];
+    *out++ = alphabet[group >> 6 & 63];
+    *out++ = '=';
+    *out = '\0';
+    return 0;
+}
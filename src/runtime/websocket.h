@@ -0,0 +1,67 @@
+#ifndef EMBER_WEBSOCKET_H
+#define EMBER_WEBSOCKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// WebSocket framing (RFC 6455) for the HTTP server's upgraded connections
+// (http_server.c).
+//
+// Frames are parsed where they were received: a client's masked payload is
+// unmasked in place a vector at a time, and a message that came as one
+// frame is handed over from the receive buffer itself. Only a fragmented
+// message is copied, its fragments gathered into the reader's buffer as
+// they arrive. Server frames are never masked, so a frame encoded once can
+// be sent as it is to any number of connections.
+
+#define WS_HEAD_MAX 10
+
+enum {
+    WS_CONTINUATION = 0x0,
+    WS_TEXT = 0x1,
+    WS_BINARY = 0x2,
+    WS_CLOSE = 0x8,
+    WS_PING = 0x9,
+    WS_PONG = 0xA
+};
+
+#define WS_CLOSE_NORMAL 1000
+#define WS_CLOSE_PROTOCOL 1002
+#define WS_CLOSE_TOO_BIG 1009
+
+typedef struct {
+    uint8_t* data;                           // The fragmented message so far
+    size_t length, capacity;
+    int opcode;                              // Its first frame's; 0 when none is under way
+    size_t max_message;
+} ws_reader;
+
+typedef struct {
+    int opcode;                              // 0 when the frame read finished no message
+    const uint8_t* payload;
+    size_t length;
+} ws_message;
+
+void ws_reader_init(ws_reader* reader, size_t max_message);
+void ws_reader_free(ws_reader* reader);
+
+// Reads the client frame at the start of data, unmasking it in place: the
+// bytes it took, 0 until all of it has arrived, or the close code to fail
+// the connection with, negated. A frame that ends a message, and any
+// control frame, fills message; the payload is valid until the next call
+// and while data is
+ssize_t ws_read(ws_reader* reader, uint8_t* data, size_t length, ws_message* message);
+
+// XORs data with the repeating four-byte mask
+void ws_unmask(uint8_t* data, size_t length, const uint8_t mask[4]);
+
+// Writes the head of an unmasked, final frame with a length-byte payload:
+// how long it is, at most WS_HEAD_MAX
+size_t ws_frame_head(uint8_t* head, int opcode, size_t length);
+
+// The Sec-WebSocket-Accept answer to a Sec-WebSocket-Key, as 28 characters
+// and a NUL; -1 if key is not a 16-byte key in base64
+int ws_accept_key(const char* key, size_t length, char accept[29]);
+
+#endif // EMBER_WEBSOCKET_H
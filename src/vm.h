@@ -36,6 +36,176 @@ void gc_print_statistics(ember_vm* vm);
 void gc_write_barrier_helper(ember_vm* vm, ember_object* obj, ember_value old_val, ember_value new_val);
 void gc_init(ember_vm* vm);
 void gc_cleanup(ember_vm* vm);
+// Generational collection: allocation sets vm->gc_minor_requested, safe
+// points run gc_collect_minor; call gc_promote_survivors after collect_garbage
+void gc_collect_minor(ember_vm* vm);
+void gc_promote_survivors(ember_vm* vm);
+// Weak references and weak maps are registered when made, so every
+// collection can find them. gc_sweep_weak runs once the gray stack is
+// drained and before the sweep (collect_garbage included, young_only in
+// minor collections): it marks the values of live keys until nothing
+// changes, then clears every target and entry whose object is unmarked
+int gc_register_weak(ember_vm* vm, ember_object* object);
+void gc_sweep_weak(ember_vm* vm, int young_only);
+// Object pooling: collectors offer freed headers to gc_pool_recycle (0 if
+// not kept), allocate_object reuses them through gc_pool_take
+ember_object* gc_pool_take(ember_vm* vm, ember_object_type type, size_t size);
+int gc_pool_recycle(ember_vm* vm, ember_object* object);
+void gc_pool_drain(ember_vm* vm);
+// Request heap mode: called by the VM pool when a VM is handed out/returned
+void gc_request_begin(ember_vm* vm);
+void gc_request_end(ember_vm* vm);
+// GC telemetry (src/core/gc_stats.c): every pause, then each finished
+// collection with the survivors counted into vm->gc_survivors (census
+// counts the whole heap, for collectors that do not sweep here)
+void gc_stats_pause(ember_vm* vm, uint64_t pause_us);
+void gc_stats_collected(ember_vm* vm, ember_gc_kind kind, uint64_t pause_us,
+                        int64_t bytes_before, int64_t bytes_freed);
+void gc_stats_census(ember_vm* vm);
+// allocate_object, when vm->gc_alloc_sample_countdown runs out
+void gc_stats_sample_allocation(ember_vm* vm, ember_object_type type, size_t size);
+void gc_stats_free(ember_vm* vm);
+// Startup profile (src/core/startup_profile.c). Phases are timed from a
+// startup_clock() reading taken when they began; module phases are also
+// itemized under the module's name
+typedef enum {
+    STARTUP_GC,
+    STARTUP_VFS,
+    STARTUP_STDLIB,
+    STARTUP_MODULE_RESOLVE,
+    STARTUP_MODULE_COMPILE,
+    STARTUP_MODULE_EXECUTE
+} startup_phase;
+double startup_clock(void);
+void startup_profile_phase(startup_phase phase, double start);
+void startup_profile_module(const char* name, startup_phase phase, double start);
+// VM pool: ember_pool_get_vm without reusing an idle VM, so the VM is built
+// (and its memory first touched) on the calling thread
+ember_vm* vm_pool_get_fresh(void);
+// Raise the marks up to which the pool scrubs stack and locals on release.
+// Called at calls, returns and resumes, the points where either peaks
+static inline void vm_note_high_water(ember_vm* vm) {
+    if (vm->stack_top > vm->stack_high) vm->stack_high = vm->stack_top;
+    if (vm->local_count > vm->locals_high) vm->locals_high = vm->local_count;
+}
+// Instruction fuel (src/core/vm_fuel.c), charged at OP_LOOP back edges
+// (vm_osr_back_edge) and calls, where every live value is reachable. Without
+// a budget the tank is never dry in practice, so this is a decrement and a
+// predictable branch. Exhausted either throws a TimeoutError through
+// vm_handle_throw or runs the yield hook; in both cases the dispatch loop
+// must reload ip
+vm_operation_result vm_fuel_exhausted(ember_vm* vm);
+static inline vm_operation_result vm_fuel_charge(ember_vm* vm) {
+    if (--vm->fuel < 0) return vm_fuel_exhausted(vm);
+    return VM_RESULT_OK;
+}
+// Call a function value from C; returns ember_run's status, the function's
+// return value goes to *result
+int vm_call_value(ember_vm* vm, ember_value func_val, int argc, ember_value* argv, ember_value* result);
+// The same in two halves for calling one function many times (array_map
+// and friends): vm_callable checks func_val once, vm_call_prepared runs it.
+// Calls are reentrant: each gets an entry frame above the caller's
+int vm_callable(ember_value func_val, int argc);
+int vm_call_prepared(ember_vm* vm, ember_value func_val, int argc, ember_value* argv, ember_value* result);
+// Generators (src/core/vm_generators.c): call makes a generator for an fn*
+// chunk with argv as its first slots; resume runs it to its next yield
+// (returns 1) or its return (0), putting the value in *result, or fails (-1)
+ember_value vm_generator_call(ember_vm* vm, ember_chunk* chunk, int argc, ember_value* argv);
+int vm_generator_resume(ember_vm* vm, ember_generator* generator, ember_value sent, ember_value* result);
+// Executor internals (src/core/executor.c): work runs on a worker thread
+// with the worker's VM, which it must leave as it found it. on_worker is
+// true on the executor's own worker threads, where waiting for further
+// work could leave nobody to run it
+typedef void (*executor_work)(ember_vm* vm, void* userdata);
+int executor_submit_work(ember_executor* executor, executor_work work, void* userdata);
+int executor_worker_count(const ember_executor* executor);
+int executor_on_worker(const ember_executor* executor);
+// Event loop (src/core/event_loop.c): GC roots held by queued microtasks,
+// suspended async frames and timers; free is called by ember_free_vm and
+// when the pool resets a VM
+void event_loop_gray_roots(ember_vm* vm);
+void event_loop_free(ember_vm* vm);
+// Incremental collection: allocation starts a cycle past next_gc and requests
+// steps, safe points run gc_incremental_step; finish completes the cycle
+void gc_incremental_allocated(ember_vm* vm, ember_object* object, size_t size);
+void gc_incremental_start(ember_vm* vm);
+void gc_incremental_step(ember_vm* vm);
+void gc_incremental_finish(ember_vm* vm);
+// Whole cycle without a budget, marking with vm->gc_mark_threads; keep (the
+// object being allocated, or NULL) survives even if nothing references it
+void gc_collect_full(ember_vm* vm, ember_object* keep);
+// Lazy sweeping: the same cycle, returning in GC_PHASE_SWEEP; outside
+// incremental mode allocate_object then calls gc_sweep_allocated until the
+// cycle is done
+void gc_collect_lazy(ember_vm* vm, ember_object* keep);
+void gc_sweep_allocated(ember_vm* vm);
+// Trigger policy (gc_policy.c): allocate_object collects through
+// gc_collect_triggered; every finished full collection reports to
+// gc_policy_collected, which sets next_gc
+void gc_policy_init(ember_vm* vm);
+void gc_collect_triggered(ember_vm* vm, ember_object* keep);
+void gc_policy_collected(ember_vm* vm, int64_t bytes_before, uint64_t pause_us);
+uint64_t gc_now_us(void);
+// Baseline JIT (src/core/jit): on_call runs once a call has entered its
+// chunk, on_loop after OP_LOOP has jumped back; either may run native code
+// from vm->ip and return with vm->ip further on. free_chunk drops a
+// chunk's native code and is called by free_chunk
+void vm_jit_on_call(ember_vm* vm);
+void vm_jit_on_loop(ember_vm* vm);
+void vm_jit_free_chunk(ember_chunk* chunk);
+// On-stack replacement (src/core/vm_osr.c): OP_LOOP calls back_edge after
+// jumping back, instead of vm_jit_on_loop (which it calls in turn). It
+// charges fuel first, so the loop must stop on VM_RESULT_ERROR and reload
+// ip otherwise
+vm_operation_result vm_osr_back_edge(ember_vm* vm);
+// Execution profiler (src/core/vm_profiler.c), while vm->profiling:
+// instruction is reported by the dispatch loop (vm_dispatch_profile), call
+// when a frame is entered, pause when ember_run returns (so time between
+// runs is not charged to the last instruction); free by ember_free_vm
+void vm_profile_instruction(ember_vm* vm, const uint8_t* instruction);
+void vm_profile_call(ember_vm* vm, const ember_chunk* chunk, const char* name);
+void vm_profile_pause(ember_vm* vm);
+void vm_profile_free(ember_vm* vm);
+// Sampling profiler (src/core/vm_sampler.c): sample records the stack when
+// vm->sample_pending is set (vm_dispatch_profile), call names functions as
+// frames are entered while vm->sampler is set; free by ember_free_vm
+void vm_sample(ember_vm* vm);
+void vm_sampler_call(ember_vm* vm, const ember_chunk* chunk, const char* name);
+void vm_sampler_free(ember_vm* vm);
+// Debugger (src/core/vm_debug.c): run_end drops the sites of a step still in
+// progress, called when ember_run returns while vm->debug_hooks is set;
+// ember_free_vm detaches (ember_debug_detach) before freeing any chunk
+void vm_debug_run_end(ember_vm* vm);
+// Warm-start profile (vm->warm_profile, warm_profile.c): apply gives chunk
+// its saved part, if any, and is called as a frame enters a chunk not yet
+// warm_checked while a profile is loaded; free by ember_free_vm
+void vm_warm_profile_apply(ember_vm* vm, ember_chunk* chunk);
+void warm_profile_free(ember_vm* vm);
+// json_stringify's and serialize's reused output buffer (vm->json_buffer); free by ember_free_vm
+void json_buffer_free(ember_vm* vm);
+// Compiled regex cache (vm->regex_cache, vm_regex.c); free by ember_free_vm
+void regex_cache_free(ember_vm* vm);
+// Compiled template cache (vm->template_cache, template_engine.c); free by ember_free_vm
+void template_cache_free(ember_vm* vm);
+// Compiled datetime format cache (vm->datetime_cache, datetime.c); free by ember_free_vm
+void datetime_cache_free(ember_vm* vm);
+// print's buffer (vm->output, output.c): written out, then freed by ember_free_vm
+void vm_output_free(ember_vm* vm);
+// deserialize without the string (msgpack.c), for stores holding MessagePack
+// bytes of their own: nil unless the bytes are exactly one value
+ember_value msgpack_decode(ember_vm* vm, const uint8_t* bytes, size_t length);
+// Database connections the VM still holds go back to their pools
+// (database.c); called by ember_free_vm and when the pool resets a VM
+void database_release_vm(ember_vm* vm);
+// Compiled scripts (vm->eval_cache, eval_cache.c): their top-level chunks are
+// GC roots until released; free by ember_free_vm
+void eval_cache_gray_roots(ember_vm* vm);
+void eval_cache_free(ember_vm* vm);
+// Described natives (vm->native_table, vm_natives.c): the call path's lookup
+// and argument check; free by ember_free_vm
+const ember_native_info* vm_native_info(ember_vm* vm, ember_native_func func);
+int vm_native_args_match(const ember_native_info* info, int argc, const ember_value* argv);
+void native_table_free(ember_vm* vm);
 
 // Chunk operations
 void init_chunk(ember_chunk* chunk);
@@ -43,6 +213,19 @@ void free_chunk(ember_chunk* chunk);
 void write_chunk(ember_chunk* chunk, uint8_t byte);
 int add_constant(ember_chunk* chunk, ember_value value);
 
+// Operand encoding (compact 1-byte form or OP_WIDE prefixed)
+int write_chunk_op(ember_chunk* chunk, uint8_t op, int operand);
+int write_chunk_jump(ember_chunk* chunk, uint8_t op);
+int patch_chunk_jump(ember_chunk* chunk, int operand_pos, int offset);
+int read_chunk_operand(const ember_chunk* chunk, int offset, uint8_t* op, int* length);
+int opcode_has_operand(uint8_t op);
+int opcode_fused_size(uint8_t op);
+uint8_t opcode_fused_operation(uint8_t op);
+uint8_t opcode_generic(uint8_t op);
+const char* opcode_name(uint8_t op);
+int write_chunk_fused(ember_chunk* chunk, uint8_t op, int slot, int constant);
+int read_chunk_u16(const ember_chunk* chunk, int offset);
+
 // Emit functions for parser compatibility
 void emit_byte(ember_chunk* chunk, uint8_t byte);
 void emit_bytes(ember_chunk* chunk, uint8_t byte1, uint8_t byte2);
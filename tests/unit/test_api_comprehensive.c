@@ -317,7 +317,7 @@ static bool test_memory_management_gc(void) {
     UNUSED(vm);
     if (!vm) return false;
     
-    int initial_bytes = vm->bytes_allocated;
+    int64_t initial_bytes = vm->bytes_allocated;
 
     
     UNUSED(initial_bytes);
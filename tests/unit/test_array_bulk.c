@@ -0,0 +1,143 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static ember_value call(ember_vm* vm, ember_native_func func, int argc, ember_value* argv) {
+    int base = vm->stack_top;
+    for (int i = 0; i < argc; i++) {
+        vm->stack[vm->stack_top++] = argv[i];
+    }
+    ember_value result = func(vm, argc, &vm->stack[base]);
+    vm->stack_top = base;
+    return result;
+}
+
+// first, first + 1, ..., rooted on the stack
+static ember_value range(ember_vm* vm, int first, int count) {
+    ember_value array = ember_make_array(vm, 0);
+    assert(array.type == EMBER_VAL_ARRAY);
+    vm->stack[vm->stack_top++] = array;
+    for (int i = 0; i < count; i++) {
+        array_push_with_vm(vm, AS_ARRAY(array), ember_make_number(first + i));
+    }
+    return array;
+}
+
+static void assert_numbers(ember_value array, const double* expected, int count) {
+    assert(AS_ARRAY(array)->length == count);
+    for (int i = 0; i < count; i++) {
+        assert(AS_ARRAY(array)->elements[i].as.number_val == expected[i]);
+    }
+}
+
+void test_growth_and_reserve(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+
+    // Pushes grow by half again, so reallocations stay logarithmic
+    ember_value array = range(vm, 0, 0);
+    int reallocations = 0;
+    int capacity = AS_ARRAY(array)->capacity;
+    for (int i = 0; i < 100000; i++) {
+        array_push(AS_ARRAY(array), ember_make_number(i));
+        if (AS_ARRAY(array)->capacity != capacity) {
+            assert(capacity < 8 || AS_ARRAY(array)->capacity <= capacity + capacity / 2);
+            capacity = AS_ARRAY(array)->capacity;
+            reallocations++;
+        }
+    }
+    assert(reallocations < 30);
+    assert(AS_ARRAY(array)->elements[99999].as.number_val == 99999);
+
+    // Reserved room is used without moving the elements
+    ember_value empty = range(vm, 0, 0);
+    ember_value args[2] = {empty, ember_make_number(1000)};
+    assert(call(vm, ember_native_array_reserve, 2, args).as.obj_val == empty.as.obj_val);
+    ember_value* elements = AS_ARRAY(empty)->elements;
+    assert(AS_ARRAY(empty)->capacity == 1000);
+    for (int i = 0; i < 1000; i++) {
+        array_push(AS_ARRAY(empty), ember_make_number(i));
+    }
+    assert(AS_ARRAY(empty)->elements == elements);
+    assert(array_reserve(AS_ARRAY(empty), 10) && AS_ARRAY(empty)->capacity == 1000);
+    args[1] = ember_make_number(-1);
+    assert(call(vm, ember_native_array_reserve, 2, args).type == EMBER_VAL_NIL);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("  ✓ Geometric growth and reserve\n");
+}
+
+void test_extend_insert_splice(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value array = range(vm, 0, 3);
+    ember_value more = range(vm, 3, 2);
+
+    ember_value args[6] = {array, more};
+    assert(call(vm, ember_native_array_extend, 2, args).as.obj_val == array.as.obj_val);
+    assert_numbers(array, (const double[]){0, 1, 2, 3, 4}, 5);
+    // Extending with itself doubles it
+    args[1] = array;
+    call(vm, ember_native_array_extend, 2, args);
+    assert_numbers(array, (const double[]){0, 1, 2, 3, 4, 0, 1, 2, 3, 4}, 10);
+
+    // Insert before an index, counted from either end
+    ember_value small = range(vm, 0, 3);
+    args[0] = small;
+    args[1] = ember_make_number(1);
+    args[2] = ember_make_number(10);
+    args[3] = ember_make_number(11);
+    assert(call(vm, ember_native_array_insert, 4, args).as.obj_val == small.as.obj_val);
+    assert_numbers(small, (const double[]){0, 10, 11, 1, 2}, 5);
+    args[1] = ember_make_number(-1);
+    args[2] = ember_make_number(-5);
+    call(vm, ember_native_array_insert, 3, args);
+    assert_numbers(small, (const double[]){0, 10, 11, 1, -5, 2}, 6);
+    args[1] = ember_make_number(99);
+    call(vm, ember_native_array_insert, 3, args);
+    assert_numbers(small, (const double[]){0, 10, 11, 1, -5, 2, -5}, 7);
+
+    // Splice out two and put three in, then take the rest
+    args[1] = ember_make_number(1);
+    args[2] = ember_make_number(2);
+    args[3] = ember_make_number(7);
+    args[4] = ember_make_number(8);
+    args[5] = ember_make_number(9);
+    ember_value removed = call(vm, ember_native_array_splice, 6, args);
+    assert_numbers(removed, (const double[]){10, 11}, 2);
+    assert_numbers(small, (const double[]){0, 7, 8, 9, 1, -5, 2, -5}, 8);
+    args[1] = ember_make_number(-3);
+    removed = call(vm, ember_native_array_splice, 2, args);
+    assert_numbers(removed, (const double[]){-5, 2, -5}, 3);
+    assert_numbers(small, (const double[]){0, 7, 8, 9, 1}, 5);
+    args[1] = ember_make_number(0);
+    args[2] = ember_make_number(0);
+    assert(AS_ARRAY(call(vm, ember_native_array_splice, 3, args))->length == 0);
+    assert(AS_ARRAY(small)->length == 5);
+
+    // Bad arguments
+    args[1] = ember_make_nil();
+    assert(call(vm, ember_native_array_insert, 2, args).type == EMBER_VAL_NIL);
+    args[1] = ember_make_number(1);
+    assert(call(vm, ember_native_array_extend, 2, args).type == EMBER_VAL_NIL);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("  ✓ Extend, insert and splice\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running array bulk tests...\n");
+    test_growth_and_reserve();
+    test_extend_insert_splice();
+    printf("All array bulk tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void expect_numbers(ember_value value, const double* expected, int count) {
+    assert(value.type == EMBER_VAL_ARRAY);
+    ember_array* array = AS_ARRAY(value);
+    assert(array->length == count);
+    for (int i = 0; i < count; i++) {
+        assert(array->elements[i].type == EMBER_VAL_NUMBER && array->elements[i].as.number_val == expected[i]);
+    }
+}
+
+static ember_value native_value(ember_native_func func) {
+    ember_value value;
+    value.type = EMBER_VAL_NATIVE;
+    value.as.native_val = func;
+    return value;
+}
+
+static int native_calls = 0;
+
+static ember_value native_square(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    assert(argc == 3 && argv[1].type == EMBER_VAL_NUMBER && argv[2].type == EMBER_VAL_ARRAY);
+    native_calls++;
+    return ember_make_number(argv[0].as.number_val * argv[0].as.number_val);
+}
+
+void test_script_callbacks(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    assert(ember_eval(vm,
+        "fn double(x, i, a) { return x * 2 }\n"
+        "fn big(x, i, a) { return x > 2 }\n"
+        "fn add(acc, x, i, a) { return acc + x }\n"
+        "fn at(x, i, a) { return i }\n"
+        "nums = [1, 2, 3, 4, 5]\n"
+        "doubled = array_map(nums, double)\n"
+        "bigs = array_filter(nums, big)\n"
+        "total = array_reduce(nums, add)\n"
+        "offset = array_reduce(nums, add, 100)\n"
+        "indexes = array_map(nums, at)\n"
+        "first_big = array_find(nums, big)\n"
+        "any_big = array_some(nums, big)\n"
+        "all_big = array_every(nums, big)\n") == 0);
+
+    const double doubled[] = {2, 4, 6, 8, 10};
+    const double bigs[] = {3, 4, 5};
+    const double indexes[] = {0, 1, 2, 3, 4};
+    expect_numbers(global_value(vm, "doubled"), doubled, 5);
+    expect_numbers(global_value(vm, "bigs"), bigs, 3);
+    expect_numbers(global_value(vm, "indexes"), indexes, 5);
+    assert(global_value(vm, "total").as.number_val == 15);
+    assert(global_value(vm, "offset").as.number_val == 115);
+    assert(global_value(vm, "first_big").as.number_val == 3);
+    assert(global_value(vm, "any_big").as.bool_val);
+    assert(!global_value(vm, "all_big").as.bool_val);
+    assert(vm->stack_top == 0 && vm->frame_count == 0);
+
+    ember_free_vm(vm);
+    printf("  ✓ Script functions run as array callbacks\n");
+}
+
+void test_nested_and_native_callbacks(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    // A callback that maps in turn, so calls nest through native code
+    assert(ember_eval(vm,
+        "fn double(x, i, a) { return x * 2 }\n"
+        "fn add(acc, x, i, a) { return acc + x }\n"
+        "fn row(x, i, a) { return array_reduce(array_map(a, double), add) + x }\n"
+        "rows = array_map([1, 2, 3], row)\n") == 0);
+    const double rows[] = {13, 14, 15};
+    expect_numbers(global_value(vm, "rows"), rows, 3);
+
+    // Natives go through the same path, one frame for the whole loop
+    ember_value numbers = ember_make_array(vm, 4);
+    vm->stack[vm->stack_top++] = numbers;
+    for (int i = 1; i <= 4; i++) {
+        array_push_with_vm(vm, AS_ARRAY(numbers), ember_make_number(i));
+    }
+    ember_value args[2] = {numbers, native_value(native_square)};
+    int stack_top = vm->stack_top;
+    ember_value squares = ember_native_array_map(vm, 2, args);
+    const double expected[] = {1, 4, 9, 16};
+    expect_numbers(squares, expected, 4);
+    assert(native_calls == 4 && vm->stack_top == stack_top);
+
+    // Anything but an array and a function is refused
+    ember_value bad[2] = {numbers, ember_make_number(1)};
+    assert(ember_native_array_map(vm, 2, bad).type == EMBER_VAL_NIL);
+    assert(ember_native_array_filter(vm, 1, args).type == EMBER_VAL_NIL);
+    assert(vm->stack_top == stack_top);
+    vm->stack_top = 0;
+
+    ember_free_vm(vm);
+    printf("  ✓ Nested and native callbacks\n");
+}
+
+void test_failing_callback(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    assert(ember_eval(vm,
+        "fn boom(x, i, a) {\n"
+        "    if (x == 2) { throw \"bad element\" }\n"
+        "    return x\n"
+        "}\n"
+        "nums = [1, 2, 3]\n") == 0);
+
+    // The loop stops at the failure and leaves the exception for the caller
+    ember_value args[2] = {global_value(vm, "nums"), global_value(vm, "boom")};
+    assert(ember_native_array_map(vm, 2, args).type == EMBER_VAL_NIL);
+    assert(vm->exception_pending);
+    assert(vm->stack_top == 0 && vm->frame_count == 0);
+    vm->exception_pending = 0;
+    vm->current_exception = ember_make_nil();
+
+    ember_free_vm(vm);
+    printf("  ✓ A failing callback stops the loop\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running array callback tests...\n");
+    test_script_callbacks();
+    test_nested_and_native_callbacks();
+    test_failing_callback();
+    printf("All array callback tests passed!\n");
+    return 0;
+}
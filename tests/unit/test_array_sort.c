@@ -0,0 +1,194 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Past the radix sort threshold
+#define SORT_TEST_LENGTH 5000
+
+static ember_value native_value(ember_native_func func) {
+    ember_value value;
+    value.type = EMBER_VAL_NATIVE;
+    value.as.native_val = func;
+    return value;
+}
+
+static ember_value new_array(ember_vm* vm, int capacity) {
+    ember_value array = ember_make_array(vm, capacity);
+    assert(array.type == EMBER_VAL_ARRAY);
+    vm->stack[vm->stack_top++] = array;
+    return array;
+}
+
+static double number_at(ember_value array, int index) {
+    ember_value element = AS_ARRAY(array)->elements[index];
+    assert(element.type == EMBER_VAL_NUMBER);
+    return element.as.number_val;
+}
+
+static ember_value descending(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    assert(argc == 2);
+    return ember_make_number(argv[1].as.number_val - argv[0].as.number_val);
+}
+
+static ember_value not_a_number(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    (void)argc;
+    (void)argv;
+    return ember_make_bool(1);
+}
+
+static int key_calls = 0;
+
+// The tens digit: many elements share each key
+static ember_value tens(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    assert(argc == 3 && argv[1].type == EMBER_VAL_NUMBER && argv[2].type == EMBER_VAL_ARRAY);
+    key_calls++;
+    return ember_make_number(floor(fmod(argv[0].as.number_val, 100) / 10));
+}
+
+void test_numbers(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+
+    // Large enough for the radix sort, with duplicates, negatives, -0 and NaN
+    ember_value array = new_array(vm, SORT_TEST_LENGTH);
+    srand(7);
+    for (int i = 0; i < SORT_TEST_LENGTH; i++) {
+        double value = (rand() % 2000 - 1000) / 4.0;
+        if (i == 10) value = NAN;
+        if (i == 20) value = -INFINITY;
+        if (i == 30) value = -0.0;
+        array_push_with_vm(vm, AS_ARRAY(array), ember_make_number(value));
+    }
+    assert(ember_native_array_sort(vm, 1, &array).as.obj_val == array.as.obj_val);
+    assert(number_at(array, 0) == -INFINITY);
+    assert(isnan(number_at(array, SORT_TEST_LENGTH - 1)));
+    for (int i = 1; i < SORT_TEST_LENGTH - 1; i++) {
+        assert(number_at(array, i - 1) <= number_at(array, i));
+    }
+
+    // Small arrays take the comparison sort, with the same order
+    ember_value small = new_array(vm, 6);
+    const double inputs[] = {3, -1, 2.5, 3, -7, 0};
+    const double sorted[] = {-7, -1, 0, 2.5, 3, 3};
+    for (int i = 0; i < 6; i++) {
+        array_push_with_vm(vm, AS_ARRAY(small), ember_make_number(inputs[i]));
+    }
+    ember_native_array_sort(vm, 1, &small);
+    for (int i = 0; i < 6; i++) {
+        assert(number_at(small, i) == sorted[i]);
+    }
+
+    // A comparator, over shuffled input and then over sorted input
+    ember_value args[2] = {array, native_value(descending)};
+    ember_value* elements = AS_ARRAY(array)->elements;
+    elements[SORT_TEST_LENGTH - 1] = ember_make_number(0);
+    for (int i = SORT_TEST_LENGTH - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        ember_value swap = elements[i];
+        elements[i] = elements[j];
+        elements[j] = swap;
+    }
+    assert(ember_native_array_sort(vm, 2, args).type == EMBER_VAL_ARRAY);
+    for (int i = 1; i < SORT_TEST_LENGTH; i++) {
+        assert(number_at(array, i - 1) >= number_at(array, i));
+    }
+    args[0] = small;
+    ember_native_array_sort(vm, 2, args);
+    assert(number_at(small, 0) == 3 && number_at(small, 5) == -7);
+
+    // A comparator that answers something else leaves the array alone
+    args[1] = native_value(not_a_number);
+    assert(ember_native_array_sort(vm, 2, args).type == EMBER_VAL_NIL);
+    assert(number_at(small, 0) == 3 && number_at(small, 5) == -7);
+    args[1] = ember_make_number(1);
+    assert(ember_native_array_sort(vm, 2, args).type == EMBER_VAL_NIL);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("  ✓ Numbers sort by value, by radix or comparison\n");
+}
+
+void test_strings_and_mixed(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+
+    // Shared 8-byte prefixes, and strings that are prefixes of each other
+    const char* words[] = {"pear", "apple", "application_b", "application_a", "app", "", "zebra", "apple"};
+    const char* sorted[] = {"", "app", "apple", "apple", "application_a", "application_b", "pear", "zebra"};
+    ember_value array = new_array(vm, 10);
+    for (int i = 0; i < 8; i++) {
+        array_push_with_vm(vm, AS_ARRAY(array), ember_make_string_gc(vm, words[i]));
+    }
+    ember_native_array_sort(vm, 1, &array);
+    for (int i = 0; i < 8; i++) {
+        assert(strcmp(AS_CSTRING(AS_ARRAY(array)->elements[i]), sorted[i]) == 0);
+    }
+
+    // Mixed types: nil, false, true, numbers, strings, then the rest
+    ember_value mixed = new_array(vm, 6);
+    ember_value nested = ember_make_array(vm, 1);
+    array_push_with_vm(vm, AS_ARRAY(mixed), nested);
+    array_push_with_vm(vm, AS_ARRAY(mixed), ember_make_string_gc(vm, "b"));
+    array_push_with_vm(vm, AS_ARRAY(mixed), ember_make_number(2));
+    array_push_with_vm(vm, AS_ARRAY(mixed), ember_make_bool(1));
+    array_push_with_vm(vm, AS_ARRAY(mixed), ember_make_nil());
+    array_push_with_vm(vm, AS_ARRAY(mixed), ember_make_number(-2));
+    ember_native_array_sort(vm, 1, &mixed);
+    ember_value* elements = AS_ARRAY(mixed)->elements;
+    assert(elements[0].type == EMBER_VAL_NIL && elements[1].type == EMBER_VAL_BOOL);
+    assert(elements[2].as.number_val == -2 && elements[3].as.number_val == 2);
+    assert(elements[4].type == EMBER_VAL_STRING && elements[5].as.obj_val == nested.as.obj_val);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("  ✓ Strings by bytes, mixed types by type\n");
+}
+
+void test_sort_by(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value array = new_array(vm, SORT_TEST_LENGTH);
+    for (int i = 0; i < SORT_TEST_LENGTH; i++) {
+        array_push_with_vm(vm, AS_ARRAY(array), ember_make_number(SORT_TEST_LENGTH - 1 - i));
+    }
+
+    // One key per element, and equal keys keep their order
+    ember_value args[2] = {array, native_value(tens)};
+    assert(ember_native_array_sort_by(vm, 2, args).as.obj_val == array.as.obj_val);
+    assert(key_calls == SORT_TEST_LENGTH);
+    for (int i = 1; i < SORT_TEST_LENGTH; i++) {
+        double previous = number_at(array, i - 1), current = number_at(array, i);
+        double previous_key = floor(fmod(previous, 100) / 10), key = floor(fmod(current, 100) / 10);
+        assert(previous_key < key || (previous_key == key && previous > current));
+    }
+
+    // Bad arguments
+    assert(ember_native_array_sort_by(vm, 1, args).type == EMBER_VAL_NIL);
+    args[1] = ember_make_nil();
+    assert(ember_native_array_sort_by(vm, 2, args).type == EMBER_VAL_NIL);
+    assert(vm->stack_top == 1);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("  ✓ Sort by key, stable\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running array sort tests...\n");
+    test_numbers();
+    test_strings_and_mixed();
+    test_sort_by();
+    printf("All array sort tests passed!\n");
+    return 0;
+}
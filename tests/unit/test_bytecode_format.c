@@ -0,0 +1,255 @@
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/core/bytecode_format.h"
+#include "../../src/frontend/parser/parser.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+
+static const char* source =
+    "fn add(a, b) {\n"
+    "    return a + b\n"
+    "}\n"
+    "fn greet(name) {\n"
+    "    return \"hello \" + name\n"
+    "}\n"
+    "total = add(1, 2.5)\n"
+    "message = greet(\"ember\")\n"
+    "try {\n"
+    "    total = add(total, 1)\n"
+    "} catch (e) {\n"
+    "    total = 0\n"
+    "}\n";
+
+static void assert_same_chunk(const ember_chunk* a, const ember_chunk* b) {
+    assert(a->count == b->count);
+    assert(memcmp(a->code, b->code, a->count) == 0);
+    assert(a->const_count == b->const_count);
+    for (int i = 0; i < a->const_count; i++) {
+        ember_value x = a->constants[i];
+        ember_value y = b->constants[i];
+        assert(x.type == y.type);
+        if (x.type == EMBER_VAL_NUMBER) {
+            assert(x.as.number_val == y.as.number_val);
+        } else if (x.type == EMBER_VAL_STRING) {
+            assert(strcmp(AS_CSTRING(x), AS_CSTRING(y)) == 0);
+        }
+    }
+    assert(a->handler_count == b->handler_count);
+    for (int i = 0; i < a->handler_count; i++) {
+        assert(memcmp(&a->handlers[i], &b->handlers[i], sizeof(ember_handler_entry)) == 0);
+    }
+    // Line tables travel encoded, byte for byte
+    assert(a->line_count == b->line_count && a->line_table_length == b->line_table_length);
+    assert(a->line_table_length == 0 || memcmp(a->line_table, b->line_table, a->line_table_length) == 0);
+}
+
+static ember_chunk* global_chunk(ember_vm* vm, const char* name) {
+    int slot = ember_global_find(vm, name, (int)strlen(name));
+    assert(slot >= 0);
+    assert(vm->globals[slot].value.type == EMBER_VAL_FUNCTION);
+    return vm->globals[slot].value.as.func_val.chunk;
+}
+
+void test_round_trip(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    uint8_t* data = NULL;
+    size_t size = 0;
+    int rc = ember_bytecode_compile(vm, source, &data, &size);
+    assert(rc);
+    (void)rc;
+    assert(memcmp(data, EMBER_BYTECODE_MAGIC, 4) == 0);
+    assert(size > EMBER_BYTECODE_HEADER_SIZE);
+    
+    // Loading rebuilds the same chunks as compiling from source
+    ember_vm* loaded = ember_new_vm();
+    assert(loaded != NULL);
+    ember_chunk* main = ember_bytecode_load(loaded, data, size);
+    assert(main != NULL);
+    
+    ember_vm* reference = ember_new_vm();
+    assert(reference != NULL);
+    ember_chunk expected;
+    init_chunk(&expected);
+    rc = compile(reference, source, &expected);
+    assert(rc);
+    assert_same_chunk(&expected, main);
+    assert(main->handler_count == 1 && main->handlers[0].kind == EMBER_HANDLER_CATCH);
+    assert(main->line_count > 0 && ember_chunk_line_at(main, main->count - 1) > 0);
+    assert_same_chunk(global_chunk(reference, "add"), global_chunk(loaded, "add"));
+    assert_same_chunk(global_chunk(reference, "greet"), global_chunk(loaded, "greet"));
+    
+    // A later unit only carries the functions it defines itself
+    uint8_t* more = NULL;
+    size_t more_size = 0;
+    rc = ember_bytecode_compile(vm, "fn more() { return 1 }\n", &more, &more_size);
+    assert(rc);
+    assert(more[EMBER_BYTECODE_OFF_FUNCTIONS] == 1);
+    assert(data[EMBER_BYTECODE_OFF_FUNCTIONS] == 2);
+    
+    free_chunk(&expected);
+    ember_bytecode_free_chunk(main);
+    free(more);
+    free(data);
+    ember_free_vm(reference);
+    ember_free_vm(loaded);
+    ember_free_vm(vm);
+    printf("Bytecode round trip test passed\n");
+}
+
+void test_rejects_damaged_data(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    uint8_t* data = NULL;
+    size_t size = 0;
+    int rc = ember_bytecode_compile(vm, source, &data, &size);
+    assert(rc);
+    (void)rc;
+    
+    // Truncation, corruption and a different opcode set are all refused
+    for (size_t cut = 0; cut < size; cut += 5) {
+        assert(ember_bytecode_load(vm, data, cut) == NULL);
+    }
+    data[size - 1] ^= 0x40;
+    assert(ember_bytecode_load(vm, data, size) == NULL);
+    data[size - 1] ^= 0x40;
+    data[EMBER_BYTECODE_OFF_OPCODES]++;
+    assert(ember_bytecode_load(vm, data, size) == NULL);
+    data[EMBER_BYTECODE_OFF_OPCODES]--;
+    
+    ember_chunk* main = ember_bytecode_load(vm, data, size);
+    assert(main != NULL);
+    ember_bytecode_free_chunk(main);
+    free(data);
+    ember_free_vm(vm);
+    printf("Damaged bytecode test passed\n");
+}
+
+void test_bytecode_file(void) {
+    const char* path = "/tmp/ember_test_bytecode.emberc";
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    uint8_t* data = NULL;
+    size_t size = 0;
+    int rc = ember_bytecode_compile(vm, source, &data, &size);
+    assert(rc);
+    (void)rc;
+    rc = ember_bytecode_write_file(path, data, size);
+    assert(rc);
+    
+    ember_vm* loaded = ember_new_vm();
+    assert(loaded != NULL);
+    ember_chunk* main = ember_bytecode_load_file(loaded, path);
+    assert(main != NULL);
+    assert(main->count > 0 && main->code[main->count - 1] == OP_HALT);
+    assert(ember_global_find(loaded, "add", 3) >= 0);
+    
+    // Running the file defines what the source would have
+    ember_vm* runner = ember_new_vm();
+    assert(runner != NULL);
+    rc = ember_run_bytecode_file(runner, path);
+    assert(rc == 0);
+    int slot = ember_global_find(runner, "total", 5);
+    assert(slot >= 0 && runner->globals[slot].value.as.number_val == 3.5);
+    
+    ember_bytecode_free_chunk(main);
+    free(data);
+    remove(path);
+    ember_free_vm(runner);
+    ember_free_vm(loaded);
+    ember_free_vm(vm);
+    printf("Bytecode file test passed\n");
+}
+
+static int count_cache_entries(const char* dir) {
+    DIR* handle = opendir(dir);
+    if (!handle) return 0;
+    int count = 0;
+    struct dirent* entry;
+    while ((entry = readdir(handle)) != NULL) {
+        size_t length = strlen(entry->d_name);
+        if (length > 7 && strcmp(entry->d_name + length - 7, ".emberc") == 0) count++;
+    }
+    closedir(handle);
+    return count;
+}
+
+void test_bytecode_cache(void) {
+    char dir[] = "/tmp/ember_test_cache_XXXXXX";
+    char* made = mkdtemp(dir);
+    assert(made != NULL);
+    (void)made;
+    char path[PATH_MAX];
+    int rc = ember_bytecode_cache_path(source, path, sizeof(path));
+    assert(rc == -1);
+    (void)rc;
+    ember_set_bytecode_cache_dir(dir);
+    rc = ember_bytecode_cache_path(source, path, sizeof(path));
+    assert(rc == 0);
+    assert(strncmp(path, dir, strlen(dir)) == 0);
+    
+    // Different source, different entry
+    char other[PATH_MAX];
+    rc = ember_bytecode_cache_path("x = 1\n", other, sizeof(other));
+    assert(rc == 0);
+    assert(strcmp(path, other) != 0);
+    
+    // Cold: compiles, stores and runs
+    ember_vm* cold = ember_new_vm();
+    assert(cold != NULL);
+    rc = ember_eval_cached(cold, source);
+    assert(rc == 0);
+    assert(count_cache_entries(dir) == 1);
+    int slot = ember_global_find(cold, "total", 5);
+    assert(slot >= 0 && cold->globals[slot].value.as.number_val == 3.5);
+    
+    // Warm: loaded from the cache, same result, nothing new written
+    ember_vm* warm = ember_new_vm();
+    assert(warm != NULL);
+    rc = ember_eval_cached(warm, source);
+    assert(rc == 0);
+    assert(count_cache_entries(dir) == 1);
+    slot = ember_global_find(warm, "total", 5);
+    assert(slot >= 0 && warm->globals[slot].value.as.number_val == 3.5);
+    assert(ember_global_find(warm, "greet", 5) >= 0);
+    
+    // A damaged entry is recompiled and replaced
+    FILE* file = fopen(path, "r+b");
+    assert(file != NULL);
+    fseek(file, EMBER_BYTECODE_HEADER_SIZE, SEEK_SET);
+    fputc(0xFF, file);
+    fclose(file);
+    ember_vm* repaired = ember_new_vm();
+    assert(repaired != NULL);
+    rc = ember_eval_cached(repaired, source);
+    assert(rc == 0);
+    ember_chunk* main = ember_bytecode_load_file(repaired, path);
+    assert(main != NULL);
+    
+    ember_set_bytecode_cache_dir(NULL);
+    rc = ember_bytecode_cache_path(source, path, sizeof(path));
+    assert(rc == -1);
+    ember_bytecode_free_chunk(main);
+    ember_free_vm(repaired);
+    ember_free_vm(warm);
+    ember_free_vm(cold);
+    printf("Bytecode cache test passed\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running bytecode format tests...\n");
+    test_round_trip();
+    test_rejects_damaged_data();
+    test_bytecode_file();
+    test_bytecode_cache();
+    printf("All bytecode format tests passed!\n");
+    return 0;
+}
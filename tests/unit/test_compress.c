@@ -0,0 +1,170 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "../../src/runtime/compress.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Text that compresses, with some variety so it isn't all one run
+static char* sample(size_t length) {
+    char* text = malloc(length);
+    for (size_t i = 0; i < length; i++) {
+        text[i] = "<li class=\"item\">entry</li>\n"[i % 28] + (i % 997 == 0);
+    }
+    return text;
+}
+
+static void round_trip(compress_encoding encoding, int level, const char* data, size_t length, size_t piece) {
+    compress_stream* stream = compress_begin(encoding, level);
+    assert(stream != NULL);
+    compress_output packed = {0};
+    for (size_t at = 0; at < length; at += piece) {
+        assert(compress_write(stream, data + at, length - at < piece ? length - at : piece, &packed));
+    }
+    assert(compress_finish(stream, &packed));
+    compress_end(stream);
+    if (length > 4096) assert(packed.length < length / 4);
+
+    compress_output plain = {0};
+    assert(compress_decompress(encoding, packed.data, packed.length, length, &plain));
+    assert(plain.length == length && (length == 0 || memcmp(plain.data, data, length) == 0));
+    free(packed.data);
+    free(plain.data);
+}
+
+void test_round_trips(void) {
+    size_t length = 300000;
+    char* text = sample(length);
+    int count = 0;
+    for (int encoding = COMPRESS_GZIP; encoding < COMPRESS_ENCODINGS; encoding++) {
+        if (!compress_available(encoding)) {
+            assert(compress_begin(encoding, COMPRESS_FAST) == NULL);
+            continue;
+        }
+        // Whole, in small and odd pieces, empty, and at every level kind;
+        // the cached stream is reused between them
+        round_trip(encoding, COMPRESS_FAST, text, length, length);
+        round_trip(encoding, COMPRESS_FAST, text, length, 1000);
+        round_trip(encoding, COMPRESS_BEST, text, length, 7777);
+        round_trip(encoding, 1, text, length, 65536);
+        round_trip(encoding, 99, text, 5000, 5000);
+        round_trip(encoding, COMPRESS_FAST, text, 0, 1);
+
+        // Two streams at once: the second isn't the cached one
+        compress_stream* first = compress_begin(encoding, COMPRESS_FAST);
+        compress_stream* second = compress_begin(encoding, COMPRESS_FAST);
+        assert(first && second && first != second);
+        compress_output a = {0}, b = {0};
+        assert(compress_write(first, "first", 5, &a) && compress_write(second, "second", 6, &b));
+        assert(compress_finish(first, &a) && compress_finish(second, &b));
+        compress_end(first);
+        compress_end(second);
+        compress_output plain = {0};
+        assert(compress_decompress(encoding, b.data, b.length, 100, &plain));
+        assert(plain.length == 6 && memcmp(plain.data, "second", 6) == 0);
+        free(a.data);
+        free(b.data);
+        free(plain.data);
+        count++;
+    }
+    free(text);
+    printf("  ✓ %d codecs round-trip, whole and in pieces, on reused streams\n", count);
+}
+
+void test_bad_input(void) {
+    size_t length = 100000;
+    char* text = sample(length);
+    for (int encoding = COMPRESS_GZIP; encoding < COMPRESS_ENCODINGS; encoding++) {
+        if (!compress_available(encoding)) continue;
+        compress_stream* stream = compress_begin(encoding, COMPRESS_FAST);
+        compress_output packed = {0}, plain = {0};
+        assert(compress_write(stream, text, length, &packed) && compress_finish(stream, &packed));
+        compress_end(stream);
+
+        // Over the limit, cut short, and corrupted
+        assert(!compress_decompress(encoding, packed.data, packed.length, length - 1, &plain));
+        assert(plain.length == 0);
+        assert(!compress_decompress(encoding, packed.data, packed.length / 2, length, &plain));
+        assert(!compress_decompress(encoding, text, 1000, length, &plain));
+        assert(!compress_decompress(encoding, "", 0, length, &plain));
+        assert(plain.length == 0);
+        free(packed.data);
+        free(plain.data);
+    }
+    compress_output plain = {0};
+    assert(!compress_decompress(COMPRESS_NONE, text, 10, 100, &plain));
+    free(text);
+    printf("  ✓ Truncated, corrupt and oversized input is refused\n");
+}
+
+void test_accept(void) {
+    assert(compress_encoding_named("GZip", 4) == COMPRESS_GZIP);
+    assert(compress_encoding_named("x-gzip", 6) == COMPRESS_GZIP);
+    assert(compress_encoding_named("br", 2) == COMPRESS_BROTLI);
+    assert(compress_encoding_named("deflate", 7) == COMPRESS_NONE);
+    assert(strcmp(compress_encoding_name(COMPRESS_ZSTD), "zstd") == 0);
+
+    // What each list gets, given which codecs this build has
+    compress_encoding best = compress_available(COMPRESS_BROTLI) ? COMPRESS_BROTLI
+                             : compress_available(COMPRESS_ZSTD) ? COMPRESS_ZSTD
+                             : compress_available(COMPRESS_GZIP) ? COMPRESS_GZIP
+                                                                  : COMPRESS_NONE;
+    compress_encoding gzip = compress_available(COMPRESS_GZIP) ? COMPRESS_GZIP : COMPRESS_NONE;
+    const char* list = "gzip, deflate, br, zstd";
+    assert(compress_accept(list, strlen(list)) == best);
+    list = "*";
+    assert(compress_accept(list, strlen(list)) == best);
+    list = "gzip;q=1.0, br;q=0.5, zstd;q=0.5";
+    assert(compress_accept(list, strlen(list)) == (gzip ? gzip : best));
+    list = "br;q=0, zstd ; q=0, gzip";
+    assert(compress_accept(list, strlen(list)) == gzip);
+    list = "*;q=0, gzip;q=0.001";
+    assert(compress_accept(list, strlen(list)) == gzip);
+    list = "identity";
+    assert(compress_accept(list, strlen(list)) == COMPRESS_NONE);
+    list = "gzip;q=2, br;q=x";
+    assert(compress_accept(list, strlen(list)) == COMPRESS_NONE);
+    assert(compress_accept("", 0) == COMPRESS_NONE);
+    printf("  ✓ Accept-Encoding picks the best coding by q, then br, zstd, gzip\n");
+}
+
+void test_natives(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value args[3] = {text(vm, "hello hello hello hello"), ember_make_nil(), ember_make_number(9)};
+    for (int encoding = COMPRESS_GZIP; encoding < COMPRESS_ENCODINGS; encoding++) {
+        args[1] = text(vm, compress_encoding_name(encoding));
+        ember_value packed = keep(vm, ember_native_compress(vm, 3, args));
+        if (!compress_available(encoding)) {
+            assert(packed.type == EMBER_VAL_NIL);
+            continue;
+        }
+        assert(packed.type == EMBER_VAL_STRING);
+        ember_value unpack[2] = {packed, args[1]};
+        ember_value plain = ember_native_decompress(vm, 2, unpack);
+        assert(plain.type == EMBER_VAL_STRING && strcmp(AS_CSTRING(plain), "hello hello hello hello") == 0);
+        ember_value limited[3] = {packed, args[1], ember_make_number(5)};
+        assert(ember_native_decompress(vm, 3, limited).type == EMBER_VAL_NIL);
+    }
+    args[1] = text(vm, "deflate");
+    assert(ember_native_compress(vm, 2, args).type == EMBER_VAL_NIL);
+    args[1] = text(vm, "gzip");
+    args[2] = ember_make_number(1.5);
+    assert(ember_native_compress(vm, 3, args).type == EMBER_VAL_NIL);
+    assert(ember_native_compress(vm, 1, args).type == EMBER_VAL_NIL);
+    ember_free_vm(vm);
+    printf("  ✓ compress and decompress natives round-trip and refuse bad arguments\n");
+}
+
+int main(void) {
+    printf("Running compression tests...\n");
+    test_round_trips();
+    test_bad_input();
+    test_accept();
+    test_natives();
+    printf("All compression tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/frontend/frontend.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static int count_string_constants(const ember_chunk* chunk, const char* chars) {
+    int found = 0;
+    for (int i = 0; i < chunk->const_count; i++) {
+        ember_value value = chunk->constants[i];
+        if (value.type == EMBER_VAL_STRING && strcmp(AS_CSTRING(value), chars) == 0) found++;
+    }
+    return found;
+}
+
+void test_equal_constants_share_a_slot(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_chunk chunk;
+    init_chunk(&chunk);
+
+    int five = ember_chunk_add_constant(&chunk, ember_make_number(5));
+    assert(ember_chunk_add_constant(&chunk, ember_make_number(5)) == five);
+    assert(ember_chunk_add_constant(&chunk, ember_make_bool(1)) == ember_chunk_add_constant(&chunk, ember_make_bool(1)));
+    assert(ember_chunk_add_constant(&chunk, ember_make_nil()) == ember_chunk_add_constant(&chunk, ember_make_nil()));
+
+    // Same bits only: 0 and -0 differ, NaN matches itself, 1 is not true
+    int zero = ember_chunk_add_constant(&chunk, ember_make_number(0.0));
+    assert(ember_chunk_add_constant(&chunk, ember_make_number(-0.0)) != zero);
+    assert(ember_chunk_add_constant(&chunk, ember_make_number(NAN)) == ember_chunk_add_constant(&chunk, ember_make_number(NAN)));
+    assert(ember_chunk_add_constant(&chunk, ember_make_number(1)) != ember_chunk_add_constant(&chunk, ember_make_bool(1)));
+
+    // Strings by content, interned or not; rooted on the stack, the chunk is not a root
+    ember_value first = ember_make_string_len(vm, "count", 5);
+    vm->stack[vm->stack_top++] = first;
+    ember_value second = ember_make_string_len(vm, "count", 5);
+    vm->stack[vm->stack_top++] = second;
+    assert(AS_STRING(first) != AS_STRING(second));
+    int name = ember_chunk_add_constant(&chunk, first);
+    assert(ember_chunk_add_constant(&chunk, second) == name);
+
+    // Past the scanned size the index answers the same, for old and new slots
+    int before = chunk.const_count;
+    for (int i = 0; i < 1000; i++) {
+        assert(ember_chunk_add_constant(&chunk, ember_make_number(1000 + i)) == before + i);
+    }
+    for (int i = 0; i < 1000; i++) {
+        assert(ember_chunk_add_constant(&chunk, ember_make_number(1000 + i)) == before + i);
+    }
+    assert(ember_chunk_add_constant(&chunk, ember_make_number(5)) == five);
+    assert(ember_chunk_add_constant(&chunk, second) == name);
+    assert(chunk.const_count == before + 1000);
+    assert(ember_chunk_find_constant(&chunk, ember_make_number(-1)) == -1);
+
+    // add_constant itself always appends, as the loader needs
+    assert(add_constant(&chunk, ember_make_number(5)) == before + 1000);
+    assert(ember_chunk_find_constant(&chunk, ember_make_number(5)) == five);
+
+    free_chunk(&chunk);
+    ember_free_vm(vm);
+    printf("  ✓ Equal constants share a slot\n");
+}
+
+void test_compiled_names_are_pooled_once(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    char source[2048];
+    size_t length = (size_t)snprintf(source, sizeof(source), "count = 0\n");
+    for (int i = 0; i < 20; i++) {
+        length += (size_t)snprintf(source + length, sizeof(source) - length,
+                                   "count = count + 1\nlabel = \"tick\"\n");
+    }
+    ember_chunk chunk;
+    init_chunk(&chunk);
+    assert(compile(vm, source, &chunk));
+    assert(count_string_constants(&chunk, "count") == 1);
+    assert(count_string_constants(&chunk, "tick") == 1);
+    free_chunk(&chunk);
+
+    assert(ember_eval(vm, source) == 0);
+    int slot = ember_global_find(vm, "count", 5);
+    assert(slot >= 0 && vm->globals[slot].value.as.number_val == 20);
+
+    ember_free_vm(vm);
+    printf("  ✓ A name used twenty times is pooled once\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running constant pool tests...\n");
+    test_equal_constants_share_a_slot();
+    test_compiled_names_are_pooled_once();
+    printf("All constant pool tests passed!\n");
+    return 0;
+}
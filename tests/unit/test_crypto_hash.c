@@ -0,0 +1,166 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "../../src/runtime/stdlib_working.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static ember_value string_of(ember_vm* vm, const char* chars, int length) {
+    ember_value value;
+    value.type = EMBER_VAL_STRING;
+    value.as.obj_val = (ember_object*)copy_string(vm, chars, length);
+    return value;
+}
+
+static void check_hex(ember_value result, const char* expected) {
+    assert(result.type == EMBER_VAL_STRING);
+    if (strcmp(AS_CSTRING(result), expected) != 0) {
+        fprintf(stderr, "got %s\nexpected %s\n", AS_CSTRING(result), expected);
+        abort();
+    }
+}
+
+void test_digests(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    // FIPS 180-2 examples
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, "abc");
+    ember_value* abc = &vm->stack[vm->stack_top - 1];
+    check_hex(ember_native_sha256_working(vm, 1, abc),
+              "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    check_hex(ember_native_sha512_working(vm, 1, abc),
+              "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+              "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f");
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, "");
+    check_hex(ember_native_sha256_working(vm, 1, &vm->stack[vm->stack_top - 1]),
+              "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+
+    // Every byte counts: past 1 KB, and after an embedded NUL
+    char* block = malloc(1000000);
+    memset(block, 'a', 1000000);
+    vm->stack[vm->stack_top++] = string_of(vm, block, 1000000);
+    check_hex(ember_native_sha256_working(vm, 1, &vm->stack[vm->stack_top - 1]),
+              "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+    vm->stack[vm->stack_top++] = string_of(vm, "a\0b", 3);
+    ember_value with_nul = ember_native_sha256_working(vm, 1, &vm->stack[vm->stack_top - 1]);
+    vm->stack[vm->stack_top++] = with_nul;
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, "a");
+    ember_value without = ember_native_sha256_working(vm, 1, &vm->stack[vm->stack_top - 1]);
+    assert(strcmp(AS_CSTRING(with_nul), AS_CSTRING(without)) != 0);
+
+    // Wrong arguments
+    ember_value number = ember_make_number(1);
+    assert(ember_native_sha256_working(vm, 1, &number).type == EMBER_VAL_NIL);
+    assert(ember_native_sha512_working(vm, 0, NULL).type == EMBER_VAL_NIL);
+
+    free(block);
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("Digest test passed\n");
+}
+
+void test_hmac(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    // RFC 4231 test case 2
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, "Jefe");
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, "what do ya want for nothing?");
+    ember_value* args = &vm->stack[vm->stack_top - 2];
+    check_hex(ember_native_hmac_sha256_working(vm, 2, args),
+              "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+    check_hex(ember_native_hmac_sha512_working(vm, 2, args),
+              "164b7a7bfcf819e2e395fbe73b56e0a387bd64222e831fd610270cd7ea250554"
+              "9758bf75c05a994a6d034f65f8f0e6fdcaeab1a34d4a6b4b636e070a38bce737");
+
+    // RFC 4231 test case 6: a key longer than the block is hashed first
+    char key[131];
+    memset(key, 0xaa, sizeof(key));
+    vm->stack[vm->stack_top++] = string_of(vm, key, sizeof(key));
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, "Test Using Larger Than Block-Size Key - Hash Key First");
+    check_hex(ember_native_hmac_sha256_working(vm, 2, &vm->stack[vm->stack_top - 2]),
+              "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54");
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("HMAC test passed\n");
+}
+
+void test_streaming(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    // A 1 MB text fed in uneven chunks digests as it does in one piece
+    char* text = malloc(1 << 20);
+    for (int i = 0; i < (1 << 20); i++) text[i] = (char)(i * 31 + (i >> 9));
+    vm->stack[vm->stack_top++] = string_of(vm, text, 1 << 20);
+    ember_value whole = vm->stack[vm->stack_top - 1];
+
+    const char* algorithms[] = {"sha256", "sha512"};
+    ember_native_func one_shot[] = {ember_native_sha256_working, ember_native_sha512_working};
+    for (int a = 0; a < 2; a++) {
+        vm->stack[vm->stack_top++] = ember_make_string_gc(vm, algorithms[a]);
+        ember_value hasher = ember_native_hasher(vm, 1, &vm->stack[vm->stack_top - 1]);
+        assert(hasher.type == EMBER_VAL_HASHER);
+        vm->stack[vm->stack_top++] = hasher;
+        int offset = 0, size = 1;
+        while (offset < (1 << 20)) {
+            int length = size < (1 << 20) - offset ? size : (1 << 20) - offset;
+            ember_value update[2] = {hasher, string_of(vm, text + offset, length)};
+            vm->stack[vm->stack_top++] = update[1];
+            assert(ember_native_hasher_update(vm, 2, update).as.obj_val == hasher.as.obj_val);
+            vm->stack_top--;
+            offset += length;
+            size = size * 3 + 1;
+        }
+        assert(AS_HASHER(hasher)->length == (1 << 20));
+        ember_value streamed = ember_native_hasher_digest(vm, 1, &hasher);
+        vm->stack[vm->stack_top++] = streamed;
+        assert(strcmp(AS_CSTRING(streamed), AS_CSTRING(one_shot[a](vm, 1, &whole))) == 0);
+
+        // Digested once; further use is refused
+        ember_value again[2] = {hasher, whole};
+        assert(ember_native_hasher_update(vm, 2, again).type == EMBER_VAL_NIL);
+        assert(ember_native_hasher_digest(vm, 1, &hasher).type == EMBER_VAL_NIL);
+        vm->stack_top -= 3;
+    }
+
+    // Keyed: an HMAC, chunk by chunk
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, "sha256");
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, "Jefe");
+    ember_value hmac = ember_native_hasher(vm, 2, &vm->stack[vm->stack_top - 2]);
+    vm->stack[vm->stack_top++] = hmac;
+    const char* pieces[] = {"what do ya", " want ", "for nothing?"};
+    for (int i = 0; i < 3; i++) {
+        ember_value update[2] = {hmac, ember_make_string_gc(vm, pieces[i])};
+        assert(ember_native_hasher_update(vm, 2, update).type == EMBER_VAL_HASHER);
+    }
+    check_hex(ember_native_hasher_digest(vm, 1, &hmac),
+              "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+
+    // Unknown algorithm, and hashers dropped undigested are freed by the GC
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, "md5");
+    assert(ember_native_hasher(vm, 1, &vm->stack[vm->stack_top - 1]).type == EMBER_VAL_NIL);
+    vm->stack[vm->stack_top - 1] = ember_make_string_gc(vm, "sha512");
+    for (int i = 0; i < 100; i++) {
+        assert(ember_native_hasher(vm, 1, &vm->stack[vm->stack_top - 1]).type == EMBER_VAL_HASHER);
+    }
+    vm->stack_top = 0;
+    ember_gc_collect(vm);
+
+    free(text);
+    ember_free_vm(vm);
+    printf("Streaming test passed\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running crypto hash tests...\n");
+    test_digests();
+    test_hmac();
+    test_streaming();
+    printf("All crypto hash tests passed!\n");
+    return 0;
+}
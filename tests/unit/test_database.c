@@ -0,0 +1,180 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef HAVE_SQLITE
+
+static char db_path[64];
+
+static ember_value connect(ember_vm* vm) {
+    ember_value path = text(vm, db_path);
+    return ember_native_db_connect(vm, 1, &path);
+}
+
+static ember_value query(ember_vm* vm, ember_value handle, const char* sql, ember_value params) {
+    ember_value args[3] = {handle, text(vm, sql), params};
+    return ember_native_db_query(vm, params.type == EMBER_VAL_NIL ? 2 : 3, args);
+}
+
+static double stat(ember_vm* vm, const char* key) {
+    ember_value stats = keep(vm, ember_native_db_pool_stats(vm, 0, NULL));
+    assert(stats.type == EMBER_VAL_HASH_MAP);
+    ember_value value = hash_map_get(AS_HASH_MAP(stats), text(vm, key));
+    assert(value.type == EMBER_VAL_NUMBER);
+    return value.as.number_val;
+}
+
+void test_query(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value handle = connect(vm);
+    assert(handle.type == EMBER_VAL_NUMBER);
+    ember_value nil = ember_make_nil();
+
+    // A script runs statement by statement; the last one's change count
+    ember_value result = query(vm, handle,
+        "CREATE TABLE users (id INTEGER PRIMARY KEY, name TEXT, score REAL);"
+        "INSERT INTO users (name, score) VALUES ('ann', 1.5);", nil);
+    assert(result.type == EMBER_VAL_NUMBER && result.as.number_val == 1);
+
+    ember_value params = keep(vm, ember_make_array(vm, 2));
+    array_push(AS_ARRAY(params), text(vm, "bob"));
+    array_push(AS_ARRAY(params), ember_make_number(2.5));
+    result = query(vm, handle, "INSERT INTO users (name, score) VALUES (?, ?)", params);
+    assert(result.type == EMBER_VAL_NUMBER && result.as.number_val == 1);
+
+    // Rows are arrays in select order; NULL reads back as nil
+    result = keep(vm, query(vm, handle, "SELECT id, name, score, NULL FROM users ORDER BY id", nil));
+    assert(result.type == EMBER_VAL_ARRAY && AS_ARRAY(result)->length == 2);
+    ember_array* row = AS_ARRAY(AS_ARRAY(result)->elements[1]);
+    assert(row->length == 4);
+    assert(row->elements[0].as.number_val == 2);
+    assert(strcmp(AS_CSTRING(row->elements[1]), "bob") == 0);
+    assert(row->elements[2].as.number_val == 2.5);
+    assert(row->elements[3].type == EMBER_VAL_NIL);
+
+    // The same SQL again is a cache hit, not a fresh prepare
+    double hits = stat(vm, "statement_hits");
+    double misses = stat(vm, "statement_misses");
+    for (int i = 0; i < 3; i++) {
+        result = query(vm, handle, "SELECT id, name, score, NULL FROM users ORDER BY id", nil);
+        assert(result.type == EMBER_VAL_ARRAY && AS_ARRAY(result)->length == 2);
+    }
+    assert(stat(vm, "statement_hits") == hits + 3);
+    assert(stat(vm, "statement_misses") == misses);
+
+    // Errors give nil, and db.error says why
+    assert(query(vm, handle, "SELECT * FROM missing", nil).type == EMBER_VAL_NIL);
+    ember_value error = ember_native_db_error(vm, 1, &handle);
+    assert(error.type == EMBER_VAL_STRING && strstr(AS_CSTRING(error), "missing") != NULL);
+    assert(query(vm, handle, "SELECT ?", nil).type == EMBER_VAL_NIL);
+
+    assert(ember_native_db_disconnect(vm, 1, &handle).as.bool_val);
+    ember_free_vm(vm);
+    printf("  ✓ Queries bind params, return rows and reuse prepared statements\n");
+}
+
+void test_batch_and_transactions(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value handle = connect(vm);
+    assert(handle.type == EMBER_VAL_NUMBER);
+    ember_value nil = ember_make_nil();
+
+    ember_value rows = keep(vm, ember_make_array(vm, 100));
+    for (int i = 0; i < 100; i++) {
+        ember_value row = keep(vm, ember_make_array(vm, 2));
+        array_push(AS_ARRAY(row), text(vm, "batch"));
+        array_push(AS_ARRAY(row), ember_make_number(i));
+        array_push(AS_ARRAY(rows), row);
+    }
+    ember_value args[3] = {handle, text(vm, "INSERT INTO users (name, score) VALUES (?, ?)"), rows};
+    ember_value result = ember_native_db_batch(vm, 3, args);
+    assert(result.type == EMBER_VAL_NUMBER && result.as.number_val == 100);
+
+    // A bad row rolls back the whole batch
+    array_push(AS_ARRAY(rows), ember_make_number(1));
+    assert(ember_native_db_batch(vm, 3, args).type == EMBER_VAL_NIL);
+    result = query(vm, handle, "SELECT count(*) FROM users", nil);
+    assert(AS_ARRAY(AS_ARRAY(result)->elements[0])->elements[0].as.number_val == 102);
+
+    assert(ember_native_db_begin(vm, 1, &handle).as.bool_val);
+    query(vm, handle, "DELETE FROM users WHERE name = 'batch'", nil);
+    assert(ember_native_db_rollback(vm, 1, &handle).as.bool_val);
+    assert(ember_native_db_commit(vm, 1, &handle).as.bool_val == false);
+
+    // A transaction left open is rolled back when the VM lets go
+    assert(ember_native_db_begin(vm, 1, &handle).as.bool_val);
+    query(vm, handle, "DELETE FROM users", nil);
+    database_release_vm(vm);
+    assert(ember_native_db_disconnect(vm, 1, &handle).type == EMBER_VAL_NIL);
+    handle = connect(vm);
+    result = query(vm, handle, "SELECT count(*) FROM users", nil);
+    assert(AS_ARRAY(AS_ARRAY(result)->elements[0])->elements[0].as.number_val == 102);
+
+    ember_free_vm(vm);
+    printf("  ✓ Batches run in one transaction; open ones roll back on release\n");
+}
+
+void test_pool(void) {
+    ember_vm* first = ember_new_vm();
+    ember_vm* second = ember_new_vm();
+    assert(first != NULL && second != NULL);
+
+    // Disconnecting keeps the connection open for the next connect
+    double opened = stat(first, "connections_opened");
+    ember_value handle = connect(first);
+    double reused = stat(first, "connections_reused");
+    assert(ember_native_db_disconnect(first, 1, &handle).as.bool_val);
+    ember_value again = connect(first);
+    assert(again.type == EMBER_VAL_NUMBER && again.as.number_val != handle.as.number_val);
+    assert(stat(first, "connections_opened") == opened);
+    assert(stat(first, "connections_reused") == reused + 1);
+
+    // Stale handles and other VMs' handles are refused
+    assert(ember_native_db_disconnect(first, 1, &handle).type == EMBER_VAL_NIL);
+    assert(query(second, again, "SELECT 1", ember_make_nil()).type == EMBER_VAL_NIL);
+    ember_value bogus = ember_make_number(0.5);
+    assert(ember_native_db_error(first, 1, &bogus).type == EMBER_VAL_NIL);
+
+    // Past the limit, connect waits for one to come back; the VM being
+    // freed gives its connection up
+    assert(ember_db_configure(1, 8) == EMBER_SUCCESS);
+    assert(ember_db_configure(0, 8) == EMBER_ERROR_INVALID_PARAMETER);
+    assert(stat(first, "active_connections") == 1);
+    ember_free_vm(first);
+    ember_value other = connect(second);
+    assert(other.type == EMBER_VAL_NUMBER);
+    assert(stat(second, "total_connections") == 1 && stat(second, "max_connections") == 1);
+
+    assert(ember_db_configure(16, 64) == EMBER_SUCCESS);
+    ember_free_vm(second);
+    printf("  ✓ Connections are pooled across VMs and handles are checked\n");
+}
+
+int main(void) {
+    printf("Running database tests...\n");
+    snprintf(db_path, sizeof(db_path), "/tmp/ember-test-db-%d.sqlite", (int)getpid());
+    unlink(db_path);
+    test_query();
+    test_batch_and_transactions();
+    test_pool();
+    unlink(db_path);
+    printf("All database tests passed!\n");
+    return 0;
+}
+
+#else
+
+int main(void) {
+    printf("Running database tests...\n");
+    printf("  - SQLite not available, skipped\n");
+    return 0;
+}
+
+#endif
@@ -0,0 +1,249 @@
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+
+static double number(ember_value value) {
+    assert(value.type == EMBER_VAL_NUMBER);
+    return value.as.number_val;
+}
+
+static const char* format(ember_vm* vm, double time, const char* pattern, const char* zone) {
+    ember_value args[3] = {ember_make_number(time), pattern ? text(vm, pattern) : ember_make_nil(),
+                           zone ? text(vm, zone) : ember_make_nil()};
+    ember_value result = ember_native_datetime_format(vm, zone ? 3 : pattern ? 2 : 1, args);
+    return result.type == EMBER_VAL_STRING ? AS_CSTRING(result) : NULL;
+}
+
+// A second between 1900 and 2100
+static time_t random_second(void) {
+    return (time_t)(-2208988800LL + (long long)((double)rand() / RAND_MAX * 6311347200.0));
+}
+
+void test_fields_and_format(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+
+    ember_value epoch = ember_make_number(0);
+    assert(strcmp(format(vm, 0, NULL, NULL), "1970-01-01T00:00:00Z") == 0);
+    assert(number(ember_native_datetime_year(vm, 1, &epoch)) == 1970);
+    assert(number(ember_native_datetime_weekday(vm, 1, &epoch)) == 4);
+    assert(number(ember_native_datetime_yearday(vm, 1, &epoch)) == 1);
+
+    // Every field agrees with gmtime_r and strftime, from year 1000 to 9999
+    const char* pattern = "%Y-%m-%d %H:%M:%S %a %A %b %B %j %u %w %y %C %e %I %l %p %s %% %F %T %D %R %c";
+    char expected[256];
+    srand(7);
+    for (int i = 0; i < 20000; i++) {
+        time_t second = i < 10000 ? random_second()
+                                  : (time_t)(-30610224000LL + (long long)((double)rand() / RAND_MAX * 284012524799.0));
+        struct tm tm;
+        gmtime_r(&second, &tm);
+        strftime(expected, sizeof(expected), pattern, &tm);
+        const char* formatted = format(vm, (double)second + 0.25, pattern, NULL);
+        if (strcmp(formatted, expected) != 0) {
+            fprintf(stderr, "%lld: \"%s\", expected \"%s\"\n", (long long)second, formatted, expected);
+            assert(0);
+        }
+        ember_value time = ember_make_number((double)second);
+        assert(number(ember_native_datetime_month(vm, 1, &time)) == tm.tm_mon + 1);
+        assert(number(ember_native_datetime_day(vm, 1, &time)) == tm.tm_mday);
+        assert(number(ember_native_datetime_hour(vm, 1, &time)) == tm.tm_hour);
+        assert(number(ember_native_datetime_minute(vm, 1, &time)) == tm.tm_min);
+        assert(number(ember_native_datetime_second(vm, 1, &time)) == tm.tm_sec);
+        assert(number(ember_native_datetime_yearday(vm, 1, &time)) == tm.tm_yday + 1);
+        vm->stack_top = 0;
+    }
+    assert(strcmp(format(vm, -0.5, "%T.%L", NULL), "23:59:59.500") == 0);
+    // Years before 1000 keep four digits, so the text parses back
+    assert(strcmp(format(vm, -52383194426.0, NULL, NULL), "0310-01-17T00:39:34Z") == 0);
+    assert(strcmp(format(vm, -62135596800.0, NULL, NULL), "0001-01-01T00:00:00Z") == 0);
+
+    vm->stack_top = 0;
+    datetime_cache_free(vm);
+    ember_free_vm(vm);
+    printf("  ✓ Fields and strftime conversions\n");
+}
+
+void test_zones(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+
+    // Zone files and their footer rules, and a bare POSIX rule, against libc
+    const char* zones[] = {"America/New_York", "Australia/Sydney", "Europe/London", "Asia/Kolkata",
+                           "America/Sao_Paulo", "EST5EDT,M3.2.0,M11.1.0", "<+0530>-5:30"};
+    char expected[128];
+    for (int z = 0; z < (int)(sizeof(zones) / sizeof(zones[0])); z++) {
+        char path[256];
+        snprintf(path, sizeof(path), "/usr/share/zoneinfo/%s", zones[z]);
+        if (strchr(zones[z], '/') && access(path, R_OK) != 0) continue;
+        setenv("TZ", zones[z], 1);
+        tzset();
+        srand(11);
+        for (int i = 0; i < 5000; i++) {
+            // glibc reads bare rules against its posixrules history, so
+            // those compare only from 2008, when the rule above began
+            time_t second = random_second();
+            if (!strchr(zones[z], '/') && second < 1199145600) second = 1199145600 + (second & 0x7fffffff);
+            struct tm tm;
+            localtime_r(&second, &tm);
+            strftime(expected, sizeof(expected), "%F %T %Z %z", &tm);
+            const char* formatted = format(vm, (double)second, "%F %T %Z %z", zones[z]);
+            if (strcmp(formatted, expected) != 0) {
+                fprintf(stderr, "%s at %lld: \"%s\", expected \"%s\"\n", zones[z], (long long)second, formatted,
+                        expected);
+                assert(0);
+            }
+            // Wall clock and back, except in the hour a change repeats
+            ember_value args[2] = {ember_make_number((double)second), text(vm, zones[z])};
+            args[0] = ember_native_datetime_from_utc(vm, 2, args);
+            assert(number(args[0]) == (double)second + (double)tm.tm_gmtoff);
+            double back = number(ember_native_datetime_to_utc(vm, 2, args));
+            assert(back == (double)second || fabs(back - (double)second) <= 3600);
+            vm->stack_top = 0;
+        }
+    }
+    unsetenv("TZ");
+    tzset();
+
+    // Wall-clock fields in a zone, and a wall time read in it
+    if (access("/usr/share/zoneinfo/America/New_York", R_OK) == 0) {
+        ember_value args[7] = {ember_make_number(1719835200), text(vm, "America/New_York")};
+        assert(number(ember_native_datetime_hour(vm, 2, args)) == 8);
+        args[0] = ember_make_number(2024);
+        args[1] = ember_make_number(7);
+        args[2] = ember_make_number(1);
+        args[3] = ember_make_number(8);
+        args[4] = ember_make_number(0);
+        args[5] = ember_make_number(0);
+        args[6] = text(vm, "America/New_York");
+        assert(number(ember_native_datetime_timestamp(vm, 7, args)) == 1719835200);
+    }
+    ember_value bad[2] = {ember_make_number(0), text(vm, "No/Such_Zone")};
+    assert(ember_native_datetime_hour(vm, 2, bad).type == EMBER_VAL_NIL);
+    bad[1] = text(vm, "../../etc/passwd");
+    assert(ember_native_datetime_from_utc(vm, 2, bad).type == EMBER_VAL_NIL);
+    assert(format(vm, 0, "%F", "No/Such_Zone") == NULL);
+    assert(format(vm, 0, "%F", "local") != NULL);
+
+    vm->stack_top = 0;
+    datetime_cache_free(vm);
+    ember_free_vm(vm);
+    printf("  ✓ Zone files, footer rules and POSIX rules\n");
+}
+
+void test_format_cache(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+
+    // Within a second the cached text is reused; %L is formatted each time
+    const char* first = format(vm, 1700000000.1, "%a, %d %b %Y %H:%M:%S GMT", NULL);
+    assert(strcmp(first, "Tue, 14 Nov 2023 22:13:20 GMT") == 0);
+    assert(strcmp(format(vm, 1700000000.9, "%a, %d %b %Y %H:%M:%S GMT", NULL), first) == 0);
+    assert(strcmp(format(vm, 1700000001, "%a, %d %b %Y %H:%M:%S GMT", NULL), "Tue, 14 Nov 2023 22:13:21 GMT") == 0);
+    assert(strcmp(format(vm, 1700000000.125, "%T.%L", NULL), "22:13:20.125") == 0);
+    assert(strcmp(format(vm, 1700000000.5, "%T.%L", NULL), "22:13:20.500") == 0);
+    // The same pattern in another zone is its own entry
+    assert(strcmp(format(vm, 1700000000, "%H %z", "EST5EDT,M3.2.0,M11.1.0"), "17 -0500") == 0);
+    assert(strcmp(format(vm, 1700000000, "%H %z", NULL), "22 +0000") == 0);
+
+    // More patterns than the cache holds
+    char pattern[32], expected[32];
+    for (int i = 0; i < 100; i++) {
+        snprintf(pattern, sizeof(pattern), "%d %%Y", i);
+        snprintf(expected, sizeof(expected), "%d 2023", i);
+        assert(strcmp(format(vm, 1700000000, pattern, NULL), expected) == 0);
+        vm->stack_top = 0;
+    }
+
+    // Malformed patterns and out-of-range times give nil
+    const char* bad[] = {"%", "%Q", "%Y %"};
+    for (int i = 0; i < 3; i++) {
+        assert(format(vm, 0, bad[i], NULL) == NULL);
+    }
+    ember_value args[2] = {ember_make_number(1e20), ember_make_number(1)};
+    assert(ember_native_datetime_format(vm, 1, args).type == EMBER_VAL_NIL);
+    args[0] = ember_make_number(NAN);
+    assert(ember_native_datetime_year(vm, 1, args).type == EMBER_VAL_NIL);
+    args[0] = ember_make_number(0);
+    assert(ember_native_datetime_format(vm, 2, args).type == EMBER_VAL_NIL);
+
+    vm->stack_top = 0;
+    datetime_cache_free(vm);
+    ember_free_vm(vm);
+    printf("  ✓ Compiled patterns and the last-second cache\n");
+}
+
+void test_parse_and_arithmetic(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+
+    struct {
+        const char* text;
+        double expected;
+    } cases[] = {
+        {"1970-01-01", 0},
+        {"2021-01-01T00:00:00Z", 1609459200},
+        {"2021-01-01 01:30", 1609464600},
+        {"2021-01-01T00:00:00.250+01:00", 1609455600.25},
+        {"2021-01-01T00:00:00-0530", 1609479000},
+        {"2024-02-29T23:59:60Z", 1709251200},
+    };
+    for (int i = 0; i < (int)(sizeof(cases) / sizeof(cases[0])); i++) {
+        ember_value arg = text(vm, cases[i].text);
+        assert(number(ember_native_datetime_parse(vm, 1, &arg)) == cases[i].expected);
+    }
+    const char* bad[] = {"", "2021-13-01", "2023-02-29", "2021-01-01T25:00", "2021-01-01T00:00Zjunk", "21-01-01",
+                         "2021-01-01T00:00:00."};
+    for (int i = 0; i < (int)(sizeof(bad) / sizeof(bad[0])); i++) {
+        ember_value arg = text(vm, bad[i]);
+        assert(ember_native_datetime_parse(vm, 1, &arg).type == EMBER_VAL_NIL);
+    }
+    ember_value in_zone[2] = {text(vm, "2021-07-01T12:00:00"), text(vm, "EST5EDT,M3.2.0,M11.1.0")};
+    assert(number(ember_native_datetime_parse(vm, 2, in_zone)) == 1625155200);
+
+    // Round trip through format
+    ember_value round = text(vm, format(vm, 1234567890, NULL, NULL));
+    assert(number(ember_native_datetime_parse(vm, 1, &round)) == 1234567890);
+
+    ember_value args[6] = {ember_make_number(0), ember_make_number(3600)};
+    assert(number(ember_native_datetime_add(vm, 2, args)) == 3600);
+    assert(number(ember_native_datetime_diff(vm, 2, args)) == -3600);
+    args[1] = ember_make_number(1e20);
+    assert(ember_native_datetime_add(vm, 2, args).type == EMBER_VAL_NIL);
+    assert(ember_native_datetime_diff(vm, 2, args).type == EMBER_VAL_NIL);
+
+    args[0] = ember_make_number(2021);
+    args[1] = ember_make_number(1);
+    args[2] = ember_make_number(1);
+    assert(number(ember_native_datetime_timestamp(vm, 3, args)) == 1609459200);
+    args[2] = ember_make_number(32);
+    assert(ember_native_datetime_timestamp(vm, 3, args).type == EMBER_VAL_NIL);
+    assert(fabs(number(ember_native_datetime_timestamp(vm, 0, NULL)) - (double)time(NULL)) < 2);
+    assert(ember_native_datetime_now(vm, 1, args).type == EMBER_VAL_NIL);
+
+    vm->stack_top = 0;
+    datetime_cache_free(vm);
+    ember_free_vm(vm);
+    printf("  ✓ Parsing, timestamps and arithmetic\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running datetime tests...\n");
+    test_fields_and_format();
+    test_zones();
+    test_format_cache();
+    test_parse_and_arithmetic();
+    printf("All datetime tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* source =
+    "fn add(a, b) {\n"
+    "    c = a + b\n"
+    "    return c\n"
+    "}\n"
+    "fn twice(x) {\n"
+    "    y = add(x, x)\n"
+    "    return add(y, 0)\n"
+    "}\n";
+
+typedef struct {
+    const ember_debug_action* actions;  // One per stop
+    int lines[16];
+    ember_chunk* chunks[16];
+    int stops;
+} session;
+
+static ember_debug_action record(ember_vm* vm, ember_chunk* chunk, int offset, void* userdata) {
+    (void)vm;
+    session* s = userdata;
+    assert(s->stops < 16);
+    s->lines[s->stops] = ember_chunk_line_at(chunk, offset);
+    s->chunks[s->stops] = chunk;
+    return s->actions[s->stops++];
+}
+
+static ember_chunk* global_chunk(ember_vm* vm, const char* name) {
+    ember_value value = global_value(vm, name);
+    assert(value.type == EMBER_VAL_FUNCTION);
+    return value.as.func_val.chunk;
+}
+
+void test_patching(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    assert(ember_eval(vm, source) == 0);
+    ember_chunk* add = global_chunk(vm, "add");
+    uint8_t* before = malloc((size_t)add->count);
+    assert(before);
+    memcpy(before, add->code, (size_t)add->count);
+    int blacklisted = add->jit_blacklisted;
+
+    // Nothing to patch without a debugger
+    assert(ember_debug_set_breakpoint(vm, add, 0) == EMBER_ERROR_OPERATION_FAILED);
+    session s = {(const ember_debug_action[]){EMBER_DEBUG_CONTINUE}, {0}, {0}, 0};
+    assert(ember_debug_attach(vm, record, &s) == EMBER_SUCCESS);
+    assert(vm->debug_enabled);
+
+    int offset = ember_debug_set_line_breakpoint(vm, add, 3);
+    assert(offset > 0 && ember_chunk_line_at(add, offset) == 3);
+    assert(add->code[offset] == OP_BREAKPOINT && ember_debug_opcode_at(vm, add, offset) == before[offset]);
+    assert(add->jit_blacklisted);
+    // Only where an instruction starts
+    assert(ember_debug_set_breakpoint(vm, add, add->count) == EMBER_ERROR_INVALID_PARAMETER);
+    assert(ember_debug_set_line_breakpoint(vm, add, 40) == EMBER_ERROR_INVALID_PARAMETER);
+
+    // The handler stops and hands back the opcode to run
+    uint8_t original = 0;
+    assert(vm_handle_breakpoint(vm, add, add->code + offset, &original) == VM_RESULT_OK);
+    assert(original == before[offset] && s.stops == 1 && s.lines[0] == 3);
+    assert(vm_handle_breakpoint(vm, add, add->code + 0, &original) == VM_RESULT_ERROR);
+    ember_vm_clear_error(vm);
+
+    assert(ember_debug_clear_breakpoint(vm, add, offset) == EMBER_SUCCESS);
+    assert(memcmp(add->code, before, (size_t)add->count) == 0 && add->jit_blacklisted == blacklisted);
+    assert(ember_debug_clear_breakpoint(vm, add, offset) == EMBER_ERROR_INVALID_PARAMETER);
+
+    // Detaching restores every byte
+    assert(ember_debug_set_breakpoint(vm, add, 0) == EMBER_SUCCESS);
+    assert(ember_debug_set_line_breakpoint(vm, global_chunk(vm, "twice"), 6) >= 0);
+    ember_debug_detach(vm);
+    assert(memcmp(add->code, before, (size_t)add->count) == 0);
+    assert(vm->debug_hooks == NULL && !vm->debug_enabled);
+
+    free(before);
+    ember_free_vm(vm);
+    printf("  ✓ Breakpoints patch the code and restore it\n");
+}
+
+void test_stepping(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    assert(ember_eval(vm, source) == 0);
+    ember_chunk* add = global_chunk(vm, "add");
+    ember_chunk* twice = global_chunk(vm, "twice");
+    uint8_t* before = malloc((size_t)add->count);
+    assert(before);
+    memcpy(before, add->code, (size_t)add->count);
+
+    // In at the first call, over the sum, out to the caller, then run on
+    const ember_debug_action actions[] = {
+        EMBER_DEBUG_STEP_IN, EMBER_DEBUG_STEP_OVER, EMBER_DEBUG_STEP_OUT, EMBER_DEBUG_CONTINUE,
+    };
+    session s = {actions, {0}, {0}, 0};
+    assert(ember_debug_attach(vm, record, &s) == EMBER_SUCCESS);
+    assert(ember_debug_set_line_breakpoint(vm, twice, 6) >= 0);
+
+    ember_value arg = ember_make_number(2);
+    ember_value result;
+    assert(vm_call_value(vm, global_value(vm, "twice"), 1, &arg, &result) == 0);
+    assert(result.type == EMBER_VAL_NUMBER && result.as.number_val == 4);
+    assert(s.stops == 4);
+    assert(s.chunks[0] == twice && s.lines[0] == 6);
+    assert(s.chunks[1] == add && s.lines[1] == 2);
+    assert(s.chunks[2] == add && s.lines[2] == 3);
+    assert(s.chunks[3] == twice && s.lines[3] == 6);
+    // Step sites are gone once the step ended; the breakpoint stays
+    assert(memcmp(add->code, before, (size_t)add->count) == 0);
+
+    // The breakpoint stops every call, without stepping
+    const ember_debug_action go[] = {EMBER_DEBUG_CONTINUE, EMBER_DEBUG_CONTINUE};
+    session again = {go, {0}, {0}, 0};
+    assert(ember_debug_attach(vm, record, &again) == EMBER_SUCCESS);
+    assert(vm_call_value(vm, global_value(vm, "twice"), 1, &arg, &result) == 0);
+    assert(vm_call_value(vm, global_value(vm, "twice"), 1, &arg, &result) == 0);
+    assert(again.stops == 2 && again.lines[1] == 6);
+
+    ember_debug_detach(vm);
+    free(before);
+    ember_free_vm(vm);
+    printf("  ✓ Steps stop at the next statement in, over and out of calls\n");
+}
+
+int main(void) {
+    printf("Running debugger tests...\n");
+    test_patching();
+    test_stepping();
+    printf("All debugger tests passed!\n");
+    return 0;
+}
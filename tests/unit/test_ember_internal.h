@@ -3,6 +3,14 @@
 
 #include "ember.h"
 #include <stdint.h>
+#include <string.h>
+
+// The tests check with assert(), and the release build (the Makefile's
+// default) passes -DNDEBUG; keep the checks, and the calls inside them, live.
+// <assert.h> is re-read on every inclusion, so this holds even when a test
+// included it first.
+#undef NDEBUG
+#include <assert.h>
 
 // Test helper functions and macros can go here
 // The structs are already defined in ember.h
@@ -10,4 +18,23 @@
 // UNUSED macro to suppress compiler warnings for unused variables
 #define UNUSED(x) ((void)(x))
 
+// Tests that call natives directly root what they build on the VM stack,
+// so a collection triggered by a later allocation cannot free it
+static inline ember_value keep(ember_vm* vm, ember_value value) {
+    vm->stack[vm->stack_top++] = value;
+    return value;
+}
+
+// A GC string, rooted
+static inline ember_value text(ember_vm* vm, const char* chars) {
+    return keep(vm, ember_make_string_gc(vm, chars));
+}
+
+// A global the test's script defined
+static inline ember_value global_value(ember_vm* vm, const char* name) {
+    int slot = ember_global_find(vm, name, (int)strlen(name));
+    assert(slot >= 0);
+    return vm->globals[slot].value;
+}
+
 #endif // TEST_EMBER_INTERNAL_H
\ No newline at end of file
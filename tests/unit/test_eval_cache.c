@@ -0,0 +1,115 @@
+#include "ember.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static double global_number(ember_vm* vm, const char* name) {
+    int slot = ember_global_find(vm, name, (int)strlen(name));
+    assert(slot >= 0);
+    assert(vm->globals[slot].value.type == EMBER_VAL_NUMBER);
+    return vm->globals[slot].value.as.number_val;
+}
+
+void test_compile_once(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    assert(ember_eval(vm, "count = 0\n") == 0);
+
+    ember_script* script = ember_compile(vm, "count = count + 1\n");
+    assert(script != NULL);
+    for (int i = 0; i < 1000; i++) {
+        assert(ember_run_script(script) == 0);
+    }
+    assert(global_number(vm, "count") == 1000);
+
+    // The same text is the same script
+    ember_script* again = ember_compile(vm, "count = count + 1\n");
+    assert(again == script);
+    uint64_t hits, misses;
+    ember_eval_cache_stats(vm, &hits, &misses);
+    assert(hits == 1 && misses == 1);
+
+    // Compile errors come back as NULL and are not cached
+    assert(ember_compile(vm, "count = (\n") == NULL);
+    assert(ember_eval_memoized(vm, "count = (\n") != 0);
+
+    ember_script_release(again);
+    ember_script_release(script);
+    ember_free_vm(vm);
+    printf("  ✓ Scripts compile once and run many times\n");
+}
+
+void test_function_rebinding(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_script* script = ember_compile(vm, "fn rule(x) { return x + 1 }\nresult = rule(1)\n");
+    assert(script != NULL);
+    assert(ember_run_script(script) == 0);
+    assert(global_number(vm, "result") == 2);
+
+    // Each run binds its functions again, as ember_eval does
+    assert(ember_eval(vm, "fn rule(x) { return x * 10 }\n") == 0);
+    assert(ember_run_script(script) == 0);
+    assert(global_number(vm, "result") == 2);
+
+    // Constants survive collections between runs
+    assert(ember_eval(vm, "fn label() { return \"cached\" }\n") == 0);
+    ember_script* text = ember_compile(vm, "name = \"rule\" + \"-\" + label()\n");
+    assert(text != NULL);
+    ember_gc_collect(vm);
+    assert(ember_run_script(text) == 0);
+    int slot = ember_global_find(vm, "name", 4);
+    assert(slot >= 0 && strcmp(AS_CSTRING(vm->globals[slot].value), "rule-cached") == 0);
+
+    ember_script_release(text);
+    ember_script_release(script);
+    ember_free_vm(vm);
+    printf("  ✓ Functions are rebound on every run\n");
+}
+
+void test_memoized_eval(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    assert(ember_eval(vm, "total = 0\n") == 0);
+    ember_script* held = ember_compile(vm, "total = total + 100\n");
+    assert(held != NULL);
+
+    // More distinct sources than the cache keeps
+    char source[64];
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < 1500; i++) {
+            snprintf(source, sizeof(source), "total = total + %d\n", i % 2);
+            assert(ember_eval_memoized(vm, source) == 0);
+        }
+    }
+    assert(global_number(vm, "total") == 1500);
+    uint64_t hits, misses;
+    ember_eval_cache_stats(vm, &hits, &misses);
+    assert(misses == 3);
+    assert(hits == 2998);
+
+    for (int i = 0; i < 1100; i++) {
+        snprintf(source, sizeof(source), "unused_%d = %d\n", i, i);
+        assert(ember_eval_memoized(vm, source) == 0);
+    }
+    // An evicted script still runs while it is held
+    assert(ember_run_script(held) == 0);
+    assert(global_number(vm, "total") == 1600);
+
+    ember_script_release(held);
+    ember_free_vm(vm);
+    printf("  ✓ Memoized eval reuses compiled sources\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running eval cache tests...\n");
+    test_compile_once();
+    test_function_rebinding();
+    test_memoized_eval();
+    printf("All eval cache tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,295 @@
+#define _POSIX_C_SOURCE 200809L
+#include "ember.h"
+#include "../../src/vm.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+static int calls = 0;
+static double last = 0;
+
+static ember_value record(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    calls++;
+    if (argc == 1 && argv[0].type == EMBER_VAL_NUMBER) {
+        last = argv[0].as.number_val;
+    }
+    return ember_make_nil();
+}
+
+static ember_value native_value(ember_native_func func) {
+    ember_value value;
+    value.type = EMBER_VAL_NATIVE;
+    value.as.native_val = func;
+    return value;
+}
+
+// then_callbacks/catch_callbacks of a fresh promise
+static void on_settle(ember_vm* vm, ember_value promise, int rejected) {
+    ember_promise* p = AS_PROMISE(promise);
+    ember_array** list = rejected ? &p->catch_callbacks : &p->then_callbacks;
+    if (!*list) {
+        *list = AS_ARRAY(ember_make_array(vm, 1));
+    }
+    array_push(*list, native_value(record));
+}
+
+void test_callbacks_are_microtasks(void) {
+    ember_vm* vm = ember_new_vm();
+    calls = 0;
+    ember_value promise = ember_make_promise(vm);
+    on_settle(vm, promise, 0);
+    on_settle(vm, promise, 1);
+
+    assert(ember_promise_resolve(vm, promise, ember_make_number(42)) == 0);
+    // Queued, not run synchronously
+    assert(calls == 0 && ember_loop_pending(vm) == 1);
+    assert(ember_loop_run_microtasks(vm) == 1);
+    assert(calls == 1 && last == 42);
+    assert(AS_PROMISE(promise)->state == PROMISE_RESOLVED);
+
+    // Settling twice is refused
+    assert(ember_promise_reject(vm, promise, ember_make_number(1)) == -1);
+    assert(ember_loop_pending(vm) == 0);
+    ember_free_vm(vm);
+    printf("  ✓ Promise callbacks run as microtasks\n");
+}
+
+void test_adopts_pending_promise(void) {
+    ember_vm* vm = ember_new_vm();
+    calls = 0;
+    ember_value inner = ember_make_promise(vm);
+    ember_value outer = ember_make_promise(vm);
+    on_settle(vm, outer, 1);
+
+    // outer follows inner, rejection included
+    assert(ember_promise_resolve(vm, outer, inner) == 0);
+    assert(AS_PROMISE(outer)->state == PROMISE_PENDING);
+    assert(ember_promise_reject(vm, inner, ember_make_number(7)) == 0);
+    assert(AS_PROMISE(outer)->state == PROMISE_REJECTED);
+    ember_loop_run(vm);
+    assert(calls == 1 && last == 7);
+
+    // A promise can't resolve with itself
+    ember_value self = ember_make_promise(vm);
+    assert(ember_promise_resolve(vm, self, self) == 0);
+    assert(AS_PROMISE(self)->state == PROMISE_REJECTED);
+    ember_free_vm(vm);
+    printf("  ✓ Resolving with a promise adopts its outcome\n");
+}
+
+static double elapsed_ms(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000.0 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+void test_timers(void) {
+    ember_vm* vm = ember_new_vm();
+    calls = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ember_value later = ember_loop_delay(vm, 30);
+    ember_value sooner = ember_loop_delay(vm, 10);
+    on_settle(vm, later, 0);
+    on_settle(vm, sooner, 0);
+
+    // Survive a collection while only the loop holds them
+    ember_gc_collect(vm);
+    assert(ember_loop_pending(vm) == 2);
+
+    assert(ember_loop_run_once(vm, -1) >= 0);
+    assert(AS_PROMISE(sooner)->state == PROMISE_RESOLVED);
+    assert(AS_PROMISE(later)->state == PROMISE_PENDING);
+    assert(ember_loop_run(vm) == 0);
+    assert(AS_PROMISE(later)->state == PROMISE_RESOLVED);
+    assert(calls == 2 && elapsed_ms(&start) >= 30);
+    ember_free_vm(vm);
+    printf("  ✓ Timers fire in deadline order\n");
+}
+
+static int ready_fd = -1;
+static int ready_events = 0;
+
+static void on_ready(ember_vm* vm, int fd, int events, void* userdata) {
+    (void)vm;
+    ready_fd = fd;
+    ready_events = events;
+    *(int*)userdata += 1;
+}
+
+void test_fd_watch(void) {
+    ember_vm* vm = ember_new_vm();
+    int fds[2];
+    int rc = pipe(fds);
+    assert(rc == 0);
+    (void)rc;
+    int fired = 0;
+
+    rc = ember_loop_watch_fd(vm, fds[0], EMBER_LOOP_READ, on_ready, &fired);
+    assert(rc == EMBER_SUCCESS);
+    rc = ember_loop_watch_fd(vm, fds[0], EMBER_LOOP_READ, on_ready, &fired);
+    assert(rc == EMBER_ERROR_INVALID_PARAMETER);
+    // Nothing to read yet
+    assert(ember_loop_run_once(vm, 10) == 0 && fired == 0);
+
+    ssize_t written = write(fds[1], "x", 1);
+    assert(written == 1);
+    (void)written;
+    assert(ember_loop_run(vm) == 0);
+    assert(fired == 1 && ready_fd == fds[0] && (ready_events & EMBER_LOOP_READ));
+
+    // One-shot: watching again is allowed, and unwatching drops it
+    rc = ember_loop_watch_fd(vm, fds[0], EMBER_LOOP_READ, on_ready, &fired);
+    assert(rc == EMBER_SUCCESS);
+    assert(ember_loop_unwatch_fd(vm, fds[0]) == EMBER_SUCCESS);
+    assert(ember_loop_pending(vm) == 0);
+
+    close(fds[0]);
+    close(fds[1]);
+    ember_free_vm(vm);
+    printf("  ✓ Watched descriptors run their callback once ready\n");
+}
+
+static int timer_order[4];
+static int timer_fired = 0;
+static int closed = 0;
+
+static void on_timer(ember_vm* vm, void* userdata) {
+    (void)vm;
+    timer_order[timer_fired++] = (int)(intptr_t)userdata;
+}
+
+static void on_close(ember_vm* vm, void* userdata) {
+    (void)vm;
+    *(int*)userdata += 1;
+}
+
+void test_callback_timers(void) {
+    ember_vm* vm = ember_new_vm();
+    timer_fired = 0;
+    int late = ember_loop_add_timer(vm, 20, on_timer, (void*)(intptr_t)3);
+    int cancelled = ember_loop_add_timer(vm, 5, on_timer, (void*)(intptr_t)2);
+    int rc = ember_loop_add_timer(vm, 0, on_timer, (void*)(intptr_t)1);
+    assert(rc > 0);
+    (void)rc;
+    assert(late > 0 && cancelled > 0 && late != cancelled);
+    assert(ember_loop_cancel_timer(vm, cancelled) == EMBER_SUCCESS);
+    assert(ember_loop_cancel_timer(vm, cancelled) == EMBER_ERROR_INVALID_PARAMETER);
+
+    assert(ember_loop_run(vm) == 0);
+    assert(timer_fired == 2 && timer_order[0] == 1 && timer_order[1] == 3);
+
+    // Close hooks run when the loop goes away
+    closed = 0;
+    rc = ember_loop_on_close(vm, on_close, &closed);
+    assert(rc == EMBER_SUCCESS);
+    event_loop_free(vm);
+    assert(closed == 1 && vm->event_loop == NULL);
+    ember_free_vm(vm);
+    printf("  ✓ Callback timers fire in order and can be cancelled\n");
+}
+
+static int ticks = 0;
+static int interval_id = 0;
+
+static ember_value tick(ember_vm* vm, int argc, ember_value* argv) {
+    (void)argc;
+    (void)argv;
+    if (++ticks == 3) {
+        ember_value id = ember_make_number(interval_id);
+        assert(ember_native_clear_timeout(vm, 1, &id).as.bool_val);
+    }
+    return ember_make_nil();
+}
+
+void test_script_timers(void) {
+    ember_vm* vm = ember_new_vm();
+    calls = 0;
+    ticks = 0;
+    ember_value args[2] = {native_value(record), ember_make_number(5)};
+    ember_value once = ember_native_set_timeout(vm, 2, args);
+    assert(once.type == EMBER_VAL_NUMBER);
+    ember_value cancelled = ember_native_set_timeout(vm, 2, args);
+    assert(ember_native_clear_timeout(vm, 1, &cancelled).as.bool_val);
+    assert(ember_native_clear_timeout(vm, 1, &cancelled).as.bool_val == false);
+
+    // An interval keeps firing until its callback clears it
+    args[0] = native_value(tick);
+    args[1] = ember_make_number(2);
+    ember_value interval = ember_native_set_interval(vm, 2, args);
+    interval_id = (int)interval.as.number_val;
+    assert(ember_loop_pending(vm) == 2);
+
+    // Bad arguments
+    args[0] = ember_make_number(1);
+    assert(ember_native_set_timeout(vm, 2, args).type == EMBER_VAL_NIL);
+    assert(ember_native_set_interval(vm, 1, args).type == EMBER_VAL_NIL);
+
+    assert(ember_loop_run(vm) == 0);
+    assert(calls == 1 && ticks == 3);
+    assert(ember_native_clear_timeout(vm, 1, &once).as.bool_val == false);
+    ember_free_vm(vm);
+    printf("  ✓ setTimeout, setInterval and clearTimeout schedule script callbacks\n");
+}
+
+static uint64_t fired_deadlines[4096];
+static int fired_count = 0;
+static struct timespec wheel_start;
+
+static void on_wheel_timer(ember_vm* vm, void* userdata) {
+    (void)vm;
+    // Not before its deadline
+    uint64_t deadline = (uint64_t)(uintptr_t)userdata;
+    assert(elapsed_ms(&wheel_start) + 1 >= (double)deadline);
+    fired_deadlines[fired_count++] = deadline;
+}
+
+void test_many_timers(void) {
+    ember_vm* vm = ember_new_vm();
+    fired_count = 0;
+    clock_gettime(CLOCK_MONOTONIC, &wheel_start);
+    // Spread over the first two wheel levels, half of them cancelled
+    int ids[4096];
+    srand(3);
+    for (int i = 0; i < 4096; i++) {
+        uint64_t delay = (uint64_t)(rand() % 600);
+        uint64_t deadline = (uint64_t)elapsed_ms(&wheel_start) + delay;
+        ids[i] = ember_loop_add_timer(vm, (double)delay, on_wheel_timer, (void*)(uintptr_t)deadline);
+        assert(ids[i] > 0);
+    }
+    for (int i = 0; i < 4096; i += 2) {
+        assert(ember_loop_cancel_timer(vm, ids[i]) == EMBER_SUCCESS);
+    }
+    // One far past the wheel's span still cancels
+    int far = ember_loop_add_timer(vm, 1e13, on_wheel_timer, NULL);
+    assert(ember_loop_pending(vm) == 2049);
+    assert(ember_loop_cancel_timer(vm, far) == EMBER_SUCCESS);
+
+    assert(ember_loop_run(vm) == 0);
+    assert(fired_count == 2048);
+    for (int i = 1; i < fired_count; i++) {
+        // Measured apart from the loop's clock, equal deadlines may differ by one
+        assert(fired_deadlines[i] + 1 >= fired_deadlines[i - 1]);
+    }
+    ember_free_vm(vm);
+    printf("  ✓ Thousands of timers fire in deadline order off the timer wheel\n");
+}
+
+int main(void) {
+    printf("Testing event loop...\n");
+    test_callbacks_are_microtasks();
+    test_adopts_pending_promise();
+    test_timers();
+    test_fd_watch();
+    test_callback_timers();
+    test_script_timers();
+    test_many_timers();
+    printf("✓ Event loop tests passed\n");
+    return 0;
+}
@@ -0,0 +1,127 @@
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/core/numa_topology.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define EXECUTOR_TASKS 1000
+
+static int completed = 0;
+static int failed = 0;
+static double sum = 0;
+static pthread_mutex_t sum_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void count_done(ember_vm* vm, int status, ember_value result, void* userdata) {
+    (void)vm;
+    (void)userdata;
+    if (status != 0) {
+        __atomic_add_fetch(&failed, 1, __ATOMIC_RELAXED);
+    }
+    if (result.type == EMBER_VAL_NUMBER) {
+        pthread_mutex_lock(&sum_lock);
+        sum += result.as.number_val;
+        pthread_mutex_unlock(&sum_lock);
+    }
+    __atomic_add_fetch(&completed, 1, __ATOMIC_RELAXED);
+}
+
+void test_scripts(void) {
+    completed = failed = 0;
+    ember_executor* executor = ember_executor_create(4, NULL);
+    assert(executor != NULL);
+    for (int i = 0; i < EXECUTOR_TASKS; i++) {
+        assert(ember_executor_submit_script(executor, "x = 1 + 2\n", count_done, NULL) == 0);
+    }
+    ember_executor_wait(executor);
+    assert(completed == EXECUTOR_TASKS && failed == 0);
+    ember_executor_destroy(executor);
+    printf("  ✓ Scripts run on worker VMs\n");
+}
+
+void test_calls(void) {
+    completed = failed = 0;
+    sum = 0;
+    ember_executor* executor = ember_executor_create(4,
+        "fn add(a, b) { return a + b }\n"
+        "fn size(s) { return len(s) }\n");
+    assert(executor != NULL);
+    for (int i = 0; i < EXECUTOR_TASKS; i++) {
+        ember_value args[2] = { ember_make_number(i), ember_make_number(1) };
+        assert(ember_executor_submit_call(executor, "add", 2, args, count_done, NULL) == 0);
+    }
+    ember_value text = ember_make_string("hello");
+    assert(ember_executor_submit_call(executor, "size", 1, &text, count_done, NULL) == 0);
+    ember_executor_wait(executor);
+    assert(completed == EXECUTOR_TASKS + 1 && failed == 0);
+    // sum(i + 1) for i < n, plus len("hello")
+    assert(sum == (double)EXECUTOR_TASKS * (EXECUTOR_TASKS + 1) / 2 + 5);
+
+    // Unknown functions fail through the callback
+    assert(ember_executor_submit_call(executor, "missing", 0, NULL, count_done, NULL) == 0);
+    ember_executor_wait(executor);
+    assert(failed == 1);
+    ember_executor_destroy(executor);
+    printf("  ✓ Function calls resolve once per worker\n");
+}
+
+static ember_executor* chained_executor = NULL;
+
+static void chain(ember_vm* vm, int status, ember_value result, void* userdata) {
+    intptr_t remaining = (intptr_t)userdata;
+    count_done(vm, status, result, NULL);
+    if (remaining > 0) {
+        // Lands on this worker's deque; idle workers steal from it
+        ember_executor_submit_script(chained_executor, "y = 2\n", chain, (void*)(remaining - 1));
+    }
+}
+
+void test_submit_from_callback(void) {
+    completed = failed = 0;
+    chained_executor = ember_executor_create(2, NULL);
+    assert(chained_executor != NULL);
+    assert(ember_executor_submit_script(chained_executor, "y = 1\n", chain, (void*)(intptr_t)99) == 0);
+    ember_executor_wait(chained_executor);
+    assert(completed == 100 && failed == 0);
+    ember_executor_destroy(chained_executor);
+    printf("  ✓ Callbacks can submit follow-up tasks\n");
+}
+
+void test_rejects_objects(void) {
+    ember_executor* executor = ember_executor_create(1, NULL);
+    assert(executor != NULL);
+    ember_vm* vm = ember_new_vm();
+    ember_value array = ember_make_array(vm, 1);
+    assert(ember_executor_submit_call(executor, "f", 1, &array, NULL, NULL) == EMBER_ERROR_INVALID_PARAMETER);
+    assert(ember_executor_create(1, "fn (") == NULL);
+    ember_free_vm(vm);
+    ember_executor_destroy(executor);
+    printf("  ✓ VM-bound arguments and bad preludes are refused\n");
+}
+
+void test_numa_topology(void) {
+    ember_numa_topology topology;
+    int nodes = numa_topology_detect(&topology);
+    assert(nodes >= 1 && nodes == topology.node_count);
+    for (int i = 0; i < nodes; i++) {
+        assert(CPU_COUNT(&topology.cpus[i]) > 0);
+    }
+    assert(numa_pin_thread(&topology, nodes) == -1);
+    printf("  ✓ NUMA topology has %d node(s)\n", nodes);
+}
+
+int main(void) {
+    printf("Testing script executor...\n");
+    test_scripts();
+    test_calls();
+    test_submit_from_callback();
+    test_rejects_objects();
+    test_numa_topology();
+    printf("✓ Script executor tests passed\n");
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include "ember.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int releases = 0;
+static const char* released_chars = NULL;
+static size_t released_length = 0;
+
+static void count_release(const char* chars, size_t length, void* userdata) {
+    releases++;
+    released_chars = chars;
+    released_length = length;
+    if (userdata) free((void*)chars);
+}
+
+void test_make_string_len(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+
+    // Embedded NULs are kept
+    ember_value value = ember_make_string_len(vm, "a\0b\0c", 5);
+    assert(value.type == EMBER_VAL_STRING);
+    assert(AS_STRING(value)->length == 5);
+    assert(memcmp(ember_string_flatten(AS_STRING(value)), "a\0b\0c", 6) == 0);
+
+    // Input need not be terminated
+    const char unterminated[4] = {'a', 'b', 'c', 'd'};
+    value = ember_make_string_len(vm, unterminated, 3);
+    assert(strcmp(AS_CSTRING(value), "abc") == 0);
+
+    value = ember_make_string_len(vm, NULL, 0);
+    assert(value.type == EMBER_VAL_STRING && AS_STRING(value)->length == 0);
+    assert(ember_make_string_len(vm, NULL, 3).type == EMBER_VAL_NIL);
+
+    ember_free_vm(vm);
+    printf("  ✓ Binary-safe strings keep every byte\n");
+}
+
+void test_external_string(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+
+    size_t length = 1 << 20;
+    char* payload = malloc(length + 1);
+    assert(payload != NULL);
+    memset(payload, 'x', length);
+    payload[length] = '\0';
+
+    // The string reads the host's bytes in place
+    releases = 0;
+    ember_value value = ember_make_string_external(vm, payload, length, count_release, payload);
+    assert(value.type == EMBER_VAL_STRING);
+    assert(AS_STRING(value)->chars == payload);
+    assert(AS_STRING(value)->length == (int)length);
+    assert(ember_string_flatten(AS_STRING(value)) == payload);
+    assert(releases == 0);
+
+    // It compares and hashes like any string
+    assert(ember_global_define(vm, "payload", value) >= 0);
+    assert(ember_eval(vm, "size = len(payload)\nsame = payload == payload + \"\"\n") == 0);
+    int slot = ember_global_find(vm, "size", 4);
+    assert(slot >= 0 && vm->globals[slot].value.as.number_val == (double)length);
+    slot = ember_global_find(vm, "same", 4);
+    assert(slot >= 0 && vm->globals[slot].value.as.bool_val);
+
+    // Collected with its last reference
+    assert(ember_eval(vm, "payload = nil\n") == 0);
+    ember_gc_collect(vm);
+    assert(releases == 1);
+    assert(released_chars == payload && released_length == length);
+
+    ember_free_vm(vm);
+    printf("  ✓ External strings reference host buffers until collected\n");
+}
+
+void test_external_copies(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+
+    // Short strings are copied and released at once
+    releases = 0;
+    char short_text[] = "short";
+    ember_value value = ember_make_string_external(vm, short_text, 5, count_release, NULL);
+    assert(value.type == EMBER_VAL_STRING && AS_STRING(value)->chars != short_text);
+    assert(strcmp(AS_CSTRING(value), "short") == 0);
+    assert(releases == 1);
+
+    // So is a buffer without the terminator
+    char* buffer = malloc(4096);
+    assert(buffer != NULL);
+    memset(buffer, 'y', 4096);
+    value = ember_make_string_external(vm, buffer, 4000, count_release, buffer);
+    assert(value.type == EMBER_VAL_STRING && AS_STRING(value)->length == 4000);
+    assert(releases == 2);
+    assert(AS_CSTRING(value)[4000] == '\0');
+
+    // Failures still hand the buffer back
+    assert(ember_make_string_external(NULL, short_text, 5, count_release, NULL).type == EMBER_VAL_NIL);
+    assert(releases == 3);
+
+    // Freeing the VM releases what is left
+    char* kept = malloc(1025);
+    assert(kept != NULL);
+    memset(kept, 'z', 1024);
+    kept[1024] = '\0';
+    value = ember_make_string_external(vm, kept, 1024, count_release, kept);
+    assert(AS_STRING(value)->chars == kept);
+    ember_free_vm(vm);
+    assert(releases == 4 && released_chars == kept);
+    printf("  ✓ Short or unterminated buffers are copied\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running external string tests...\n");
+    test_make_string_len();
+    test_external_string();
+    test_external_copies();
+    printf("All external string tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,326 @@
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static char* write_temp(const char* contents, size_t length) {
+    char* path = strdup("/tmp/ember_file_handle_XXXXXX");
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    ssize_t written = write(fd, contents, length);
+    assert(written == (ssize_t)length);
+    (void)written;
+    close(fd);
+    return path;
+}
+
+static ember_value open_path(ember_vm* vm, const char* path) {
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, path);
+    ember_value file = ember_native_file_open(vm, 1, &vm->stack[vm->stack_top - 1]);
+    vm->stack_top--;
+    return file;
+}
+
+// Lines of 0 to 199 digits, some ending in \r\n, the last unterminated
+static char* make_text(int lines, size_t* length) {
+    char* text = malloc((size_t)lines * 202);
+    size_t at = 0;
+    for (int i = 0; i < lines; i++) {
+        for (int j = 0; j < i % 200; j++) text[at++] = (char)('0' + (i + j) % 10);
+        if (i == lines - 1) break;
+        if (i % 7 == 0) text[at++] = '\r';
+        text[at++] = '\n';
+    }
+    *length = at;
+    return text;
+}
+
+static void check_line(ember_value line, int i) {
+    assert(line.type == EMBER_VAL_STRING);
+    ember_string* string = AS_STRING(line);
+    assert(string->length == i % 200);
+    for (int j = 0; j < i % 200; j++) assert(string->chars[j] == (char)('0' + (i + j) % 10));
+}
+
+void test_read_lines(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    // Several buffers' worth, so lines straddle refills
+    enum { LINES = 3000 };
+    size_t length;
+    char* text = make_text(LINES, &length);
+    assert(length > 4 * 64 * 1024);
+    char* path = write_temp(text, length);
+
+    ember_value file = open_path(vm, path);
+    assert(file.type == EMBER_VAL_FILE);
+    vm->stack[vm->stack_top++] = file;
+    for (int i = 0; i < LINES; i++) check_line(ember_native_file_read_line(vm, 1, &file), i);
+    assert(ember_native_file_read_line(vm, 1, &file).type == EMBER_VAL_NIL);
+    // The buffer never grew past its first size
+    assert(AS_FILE(file)->capacity == 64 * 1024);
+    assert(ember_native_file_close(vm, 1, &file).as.bool_val);
+    assert(!ember_native_file_close(vm, 1, &file).as.bool_val);
+    assert(ember_native_file_read_line(vm, 1, &file).type == EMBER_VAL_NIL);
+
+    // Through an iterator, as a for loop drives it
+    file = open_path(vm, path);
+    vm->stack[vm->stack_top - 1] = file;
+    ember_value iterator = ember_native_file_lines(vm, 1, &file);
+    assert(iterator.type == EMBER_VAL_ITERATOR);
+    vm->stack[vm->stack_top++] = iterator;
+    int count = 0;
+    while (!iterator_done(AS_ITERATOR(iterator))) {
+        ember_iterator_result result = iterator_next(AS_ITERATOR(iterator));
+        assert(!result.done);
+        check_line(result.value, count++);
+    }
+    assert(count == LINES && iterator_next(AS_ITERATOR(iterator)).done);
+
+    // Empty files have no lines
+    char* empty = write_temp("", 0);
+    file = open_path(vm, empty);
+    vm->stack[vm->stack_top - 2] = file;
+    iterator = ember_native_file_lines(vm, 1, &file);
+    assert(iterator_done(AS_ITERATOR(iterator)));
+    unlink(empty);
+    free(empty);
+
+    vm->stack_top = 0;
+    unlink(path);
+    free(path);
+    free(text);
+    ember_free_vm(vm);
+    printf("Read lines test passed\n");
+}
+
+void test_long_lines(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    // One line longer than the buffer grows it instead of splitting
+    size_t long_length = 300000;
+    char* text = malloc(long_length + 8);
+    memset(text, 'x', long_length);
+    memcpy(text + long_length, "\nshort\n", 7);
+    char* path = write_temp(text, long_length + 7);
+
+    ember_value file = open_path(vm, path);
+    vm->stack[vm->stack_top++] = file;
+    ember_value line = ember_native_file_read_line(vm, 1, &file);
+    assert(line.type == EMBER_VAL_STRING && AS_STRING(line)->length == (int)long_length);
+    assert(memcmp(AS_STRING(line)->chars, text, long_length) == 0);
+    line = ember_native_file_read_line(vm, 1, &file);
+    assert(strcmp(AS_CSTRING(line), "short") == 0);
+    assert(ember_native_file_read_line(vm, 1, &file).type == EMBER_VAL_NIL);
+
+    vm->stack_top = 0;
+    unlink(path);
+    free(path);
+    free(text);
+    ember_free_vm(vm);
+    printf("Long line test passed\n");
+}
+
+void test_read_chunks(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    size_t length;
+    char* text = make_text(3000, &length);
+    char* path = write_temp(text, length);
+
+    // Small and buffer-sized chunks, mixed with lines, reassemble the file
+    size_t sizes[] = {13, 4096, 65536, 100000, 1000000};
+    for (int s = 0; s < 5; s++) {
+        ember_value file = open_path(vm, path);
+        vm->stack[vm->stack_top++] = file;
+        size_t at = 0;
+        if (s == 1) {
+            check_line(ember_native_file_read_line(vm, 1, &file), 0);
+            at = 2;
+        }
+        for (;;) {
+            ember_value args[2] = {file, ember_make_number((double)sizes[s])};
+            ember_value chunk = ember_native_file_read_chunk(vm, 2, args);
+            if (chunk.type == EMBER_VAL_NIL) break;
+            ember_string* string = AS_STRING(chunk);
+            assert(string->length > 0 && (size_t)string->length <= sizes[s]);
+            // Short only at the end
+            if ((size_t)string->length < sizes[s]) assert(at + (size_t)string->length == length);
+            assert(memcmp(string->chars, text + at, (size_t)string->length) == 0);
+            at += (size_t)string->length;
+        }
+        assert(at == length);
+        ember_native_file_close(vm, 1, &file);
+        vm->stack_top--;
+    }
+
+    // Bad sizes, wrong arguments, and missing files or directories
+    ember_value file = open_path(vm, path);
+    vm->stack[vm->stack_top++] = file;
+    ember_value args[2] = {file, ember_make_number(0)};
+    assert(ember_native_file_read_chunk(vm, 2, args).type == EMBER_VAL_NIL);
+    args[1] = ember_make_number(-5);
+    assert(ember_native_file_read_chunk(vm, 2, args).type == EMBER_VAL_NIL);
+    args[0] = ember_make_number(1);
+    assert(ember_native_file_read_chunk(vm, 2, args).type == EMBER_VAL_NIL);
+    assert(ember_native_file_lines(vm, 1, args).type == EMBER_VAL_NIL);
+    assert(open_path(vm, "/tmp").type == EMBER_VAL_NIL);
+    assert(open_path(vm, "/nonexistent/file").type == EMBER_VAL_NIL);
+    ember_native_file_close(vm, 1, &file);
+
+    // Handles dropped unclosed are closed by the GC
+    int before = dup(0);
+    close(before);
+    for (int i = 0; i < 50; i++) assert(open_path(vm, path).type == EMBER_VAL_FILE);
+    vm->stack_top = 0;
+    gc_collect_full(vm, NULL);
+    int after = dup(0);
+    assert(after == before);
+    close(after);
+
+    unlink(path);
+    free(path);
+    free(text);
+    ember_free_vm(vm);
+    printf("Read chunks test passed\n");
+}
+
+static ember_value open_writer(ember_vm* vm, const char* path, const char* mode, double size, const char* sync) {
+    int base = vm->stack_top;
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, path);
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, mode);
+    vm->stack[vm->stack_top++] = ember_make_number(size);
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, sync);
+    ember_value writer = ember_native_file_writer(vm, 4, &vm->stack[base]);
+    vm->stack_top = base;
+    return writer;
+}
+
+static bool write_text(ember_vm* vm, ember_value writer, const char* text) {
+    vm->stack[vm->stack_top++] = writer;
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, text);
+    ember_value written = ember_native_file_write(vm, 2, &vm->stack[vm->stack_top - 2]);
+    vm->stack_top -= 2;
+    return written.type == EMBER_VAL_BOOL && written.as.bool_val;
+}
+
+static off_t size_of(const char* path) {
+    struct stat st;
+    int rc = stat(path, &st);
+    assert(rc == 0);
+    (void)rc;
+    return st.st_size;
+}
+
+static char* contents_of(const char* path, size_t* length) {
+    FILE* file = fopen(path, "rb");
+    assert(file);
+    char* contents = malloc((size_t)size_of(path) + 1);
+    *length = fread(contents, 1, (size_t)size_of(path), file);
+    fclose(file);
+    return contents;
+}
+
+void test_writers(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    char* path = write_temp("old contents\n", 13);
+
+    // Lines wait in the buffer until it fills, then go out a buffer at a time
+    ember_value writer = open_writer(vm, path, "w", 4096, "none");
+    assert(writer.type == EMBER_VAL_FILE);
+    vm->stack[vm->stack_top++] = writer;
+    assert(size_of(path) == 0);
+    for (int i = 0; i < 200; i++) assert(write_text(vm, writer, "0123456789\n"));
+    assert(size_of(path) == 0);
+    for (int i = 0; i < 200; i++) assert(write_text(vm, writer, "0123456789\n"));
+    assert(size_of(path) == 4096);
+    assert(ember_native_file_flush(vm, 1, &writer).as.bool_val);
+    assert(size_of(path) == 4400);
+    // Reads from a writer find nothing
+    assert(ember_native_file_read_line(vm, 1, &writer).type == EMBER_VAL_NIL);
+    // Writes larger than the buffer bypass it
+    char* large = malloc(10001);
+    memset(large, 'z', 10000);
+    large[10000] = '\0';
+    assert(write_text(vm, writer, "a"));
+    assert(write_text(vm, writer, large));
+    assert(ember_native_file_close(vm, 1, &writer).as.bool_val);
+    assert(size_of(path) == 14401);
+    assert(!write_text(vm, writer, "closed"));
+    assert(!ember_native_file_close(vm, 1, &writer).as.bool_val);
+
+    // Append mode, unbuffered, and with fdatasync
+    const char* syncs[] = {"none", "data"};
+    for (int i = 0; i < 2; i++) {
+        writer = open_writer(vm, path, "a", i == 0 ? 0 : 64, syncs[i]);
+        vm->stack[vm->stack_top - 1] = writer;
+        assert(write_text(vm, writer, "tail\n"));
+        if (i == 0) assert(size_of(path) == 14406);
+        assert(ember_native_file_close(vm, 1, &writer).as.bool_val);
+    }
+    size_t length;
+    char* contents = contents_of(path, &length);
+    assert(length == 14411 && memcmp(contents, "0123456789\n", 11) == 0);
+    assert(contents[4400] == 'a' && contents[4401] == 'z' && memcmp(contents + 14401, "tail\ntail\n", 10) == 0);
+    free(contents);
+
+    // Direct I/O, or the page cache where the filesystem refuses it: whole
+    // blocks on flush, the partial one at close
+    writer = open_writer(vm, path, "w", 5000, "direct");
+    assert(writer.type == EMBER_VAL_FILE);
+    vm->stack[vm->stack_top - 1] = writer;
+    for (int i = 0; i < 1000; i++) assert(write_text(vm, writer, "0123456789\n"));
+    assert(ember_native_file_flush(vm, 1, &writer).as.bool_val);
+    assert(size_of(path) >= 8192);
+    assert(ember_native_file_close(vm, 1, &writer).as.bool_val);
+    contents = contents_of(path, &length);
+    assert(length == 11000);
+    for (int i = 0; i < 1000; i++) assert(memcmp(contents + i * 11, "0123456789\n", 11) == 0);
+    free(contents);
+
+    // Writers dropped unclosed are flushed by the GC
+    writer = open_writer(vm, path, "w", 4096, "none");
+    assert(write_text(vm, writer, "flushed by the collector"));
+    vm->stack_top = 0;
+    gc_collect_full(vm, NULL);
+    assert(size_of(path) == 24);
+
+    // Failed writes, bad options
+    writer = open_writer(vm, "/dev/full", "w", 0, "none");
+    assert(writer.type == EMBER_VAL_FILE);
+    vm->stack[vm->stack_top++] = writer;
+    assert(!write_text(vm, writer, "no space"));
+    assert(!write_text(vm, writer, "still none"));
+    assert(!ember_native_file_close(vm, 1, &writer).as.bool_val);
+    assert(open_writer(vm, path, "r+", 10, "none").type == EMBER_VAL_NIL);
+    assert(open_writer(vm, path, "w", -1, "none").type == EMBER_VAL_NIL);
+    assert(open_writer(vm, path, "w", 10, "always").type == EMBER_VAL_NIL);
+    assert(open_writer(vm, "/nonexistent/file", "w", 10, "none").type == EMBER_VAL_NIL);
+
+    vm->stack_top = 0;
+    unlink(path);
+    free(path);
+    free(large);
+    ember_free_vm(vm);
+    printf("Writer test passed\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running file handle tests...\n");
+    test_read_lines();
+    test_long_lines();
+    test_read_chunks();
+    test_writers();
+    printf("All file handle tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,156 @@
+#define _GNU_SOURCE
+#include "ember.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define TABLE_KEYS 5000
+#define READERS 4
+
+static ember_value table;
+
+static void build_table(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    assert(ember_eval(vm,
+        "table = {}\n"
+        "for (i = 0; i < 5000; i = i + 1) {\n"
+        "    table[\"k\" + i] = [i, \"v\" + i]\n"
+        "}\n") == 0);
+    size_t objects_before, bytes_before;
+    ember_frozen_heap_stats(&objects_before, &bytes_before);
+    assert(ember_freeze(global_value(vm, "table"), &table) == 0);
+    size_t objects, bytes;
+    ember_frozen_heap_stats(&objects, &bytes);
+    assert(objects - objects_before >= 1 + TABLE_KEYS * 3);
+    assert(bytes > bytes_before);
+    // The source VM and its copy part ways
+    ember_free_vm(vm);
+}
+
+void test_freeze(void) {
+    build_table();
+    assert(table.type == EMBER_VAL_HASH_MAP);
+    assert(ember_value_is_frozen(table));
+    assert(AS_HASH_MAP(table)->length == TABLE_KEYS);
+
+    // Freezing a frozen value is free
+    ember_value again;
+    assert(ember_freeze(table, &again) == 0 && again.as.obj_val == table.as.obj_val);
+    assert(ember_value_is_frozen(ember_make_number(1)));
+
+    // Instances belong to their VM's class
+    ember_vm* vm = ember_new_vm();
+    assert(ember_eval(vm, "class Point {\n    fn init() { this.x = 1 }\n}\npoint = new Point()\n") == 0);
+    assert(ember_freeze(global_value(vm, "point"), &again) == -1);
+    assert(!ember_value_is_frozen(global_value(vm, "point")));
+    ember_free_vm(vm);
+    printf("  ✓ Values freeze into the shared heap\n");
+}
+
+void test_shared_reads(void) {
+    ember_vm* first = ember_new_vm();
+    ember_vm* second = ember_new_vm();
+    assert(first != NULL && second != NULL);
+    assert(ember_global_define(first, "table", table) >= 0);
+    assert(ember_global_define(second, "table", table) >= 0);
+
+    // Both VMs read the one copy and their collectors leave it alone
+    assert(ember_eval(first, "hit = table[\"k42\"][1]\n") == 0);
+    ember_gc_collect(first);
+    ember_gc_collect(second);
+    assert(ember_eval(second, "hit = table[\"k4999\"][0] + len(table)\n") == 0);
+    assert(strcmp(AS_CSTRING(global_value(first, "hit")), "v42") == 0);
+    assert(global_value(second, "hit").as.number_val == 4999 + TABLE_KEYS);
+
+    // A VM's own data may point into the frozen heap
+    assert(ember_eval(first, "mine = [table[\"k1\"]]\n") == 0);
+    ember_gc_collect(first);
+    assert(ember_eval(first, "hit = mine[0][1]\n") == 0);
+    assert(strcmp(AS_CSTRING(global_value(first, "hit")), "v1") == 0);
+
+    ember_free_vm(first);
+    ember_free_vm(second);
+    // And it outlives every VM
+    assert(AS_HASH_MAP(table)->length == TABLE_KEYS);
+    printf("  ✓ VMs share frozen values without copying or collecting them\n");
+}
+
+void test_immutable(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_hash_map* map = AS_HASH_MAP(table);
+    hash_map_set(map, text(vm, "new"), ember_make_number(1));
+    assert(map->length == TABLE_KEYS);
+    assert(!hash_map_delete(map, text(vm, "k1")));
+    ember_value row = hash_map_get(map, text(vm, "k7"));
+    array_push(AS_ARRAY(row), ember_make_number(1));
+    assert(AS_ARRAY(row)->length == 2);
+
+    ember_value map_copy, set_copy;
+    ember_value ordered = ember_make_map(vm);
+    assert(map_set(AS_MAP(ordered), text(vm, "a"), ember_make_number(1)));
+    assert(ember_freeze(ordered, &map_copy) == 0);
+    assert(!map_set(AS_MAP(map_copy), text(vm, "b"), ember_make_number(2)));
+    assert(AS_MAP(map_copy)->size == 1);
+    ember_value set = ember_make_set(vm);
+    assert(set_add(AS_SET(set), ember_make_number(1)));
+    assert(ember_freeze(set, &set_copy) == 0);
+    assert(!set_add(AS_SET(set_copy), ember_make_number(2)));
+    assert(AS_SET(set_copy)->size == 1);
+    // Nor through the in-place set operations
+    ember_value others = ember_make_set(vm);
+    assert(set_add(AS_SET(others), ember_make_number(3)));
+    assert(!set_union_with(vm, AS_SET(set_copy), AS_SET(others)));
+    assert(!set_retain_all(vm, AS_SET(set_copy), AS_SET(others)));
+    assert(!set_retain_all(vm, AS_SET(set_copy), AS_SET(set_copy)));
+    assert(AS_SET(set_copy)->size == 1 && set_has(AS_SET(set_copy), ember_make_number(1)));
+    ember_free_vm(vm);
+    printf("  ✓ Frozen values cannot be modified\n");
+}
+
+static void* reader(void* arg) {
+    (void)arg;
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    assert(ember_global_define(vm, "table", table) >= 0);
+    for (int round = 0; round < 20; round++) {
+        assert(ember_eval(vm,
+            "total = 0\n"
+            "for (i = 0; i < 5000; i = i + 1) {\n"
+            "    total = total + table[\"k\" + i][0]\n"
+            "}\n") == 0);
+        assert(global_value(vm, "total").as.number_val == (double)TABLE_KEYS * (TABLE_KEYS - 1) / 2);
+        ember_gc_collect(vm);
+    }
+    ember_free_vm(vm);
+    return NULL;
+}
+
+void test_concurrent_readers(void) {
+    pthread_t threads[READERS];
+    for (int i = 0; i < READERS; i++) {
+        int rc = pthread_create(&threads[i], NULL, reader, NULL);
+        assert(rc == 0);
+        (void)rc;
+    }
+    for (int i = 0; i < READERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    printf("  ✓ Threads read frozen values without locks\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running frozen heap tests...\n");
+    test_freeze();
+    test_shared_reads();
+    test_immutable();
+    test_concurrent_readers();
+    printf("All frozen heap tests passed!\n");
+    return 0;
+}
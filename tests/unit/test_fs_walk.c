@@ -0,0 +1,191 @@
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+static char root[64];
+
+static void make_file(const char* relative) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", root, relative);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    close(fd);
+}
+
+static void make_dir(const char* relative) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", root, relative);
+    assert(mkdir(path, 0755) == 0);
+}
+
+static int compare_strings(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Every path the walk yields, below root, sorted and joined with spaces
+static char* walk(ember_vm* vm, const char* pattern, double depth, bool follow) {
+    int base = vm->stack_top;
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, root);
+    vm->stack[vm->stack_top++] = pattern ? ember_make_string_gc(vm, pattern) : ember_make_nil();
+    vm->stack[vm->stack_top++] = depth > 0 ? ember_make_number(depth) : ember_make_nil();
+    vm->stack[vm->stack_top++] = ember_make_bool(follow);
+    ember_value iterator = ember_native_fs_walk(vm, 4, &vm->stack[base]);
+    assert(iterator.type == EMBER_VAL_ITERATOR);
+    vm->stack[vm->stack_top++] = iterator;
+
+    size_t count = 0, capacity = 16, root_length = strlen(root);
+    char** paths = malloc(capacity * sizeof(char*));
+    while (!iterator_done(AS_ITERATOR(iterator))) {
+        ember_iterator_result result = iterator_next(AS_ITERATOR(iterator));
+        assert(!result.done && result.value.type == EMBER_VAL_STRING);
+        const char* path = AS_CSTRING(result.value);
+        assert(strncmp(path, root, root_length) == 0 && path[root_length] == '/');
+        if (count == capacity) paths = realloc(paths, (capacity *= 2) * sizeof(char*));
+        paths[count++] = strdup(path + root_length + 1);
+    }
+    assert(iterator_next(AS_ITERATOR(iterator)).done);
+    vm->stack_top = base;
+
+    qsort(paths, count, sizeof(char*), compare_strings);
+    size_t length = 1;
+    for (size_t i = 0; i < count; i++) length += strlen(paths[i]) + 1;
+    char* joined = calloc(1, length);
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) strcat(joined, " ");
+        strcat(joined, paths[i]);
+        free(paths[i]);
+    }
+    free(paths);
+    return joined;
+}
+
+static void expect(ember_vm* vm, const char* pattern, double depth, bool follow, const char* expected) {
+    char* got = walk(vm, pattern, depth, follow);
+    if (strcmp(got, expected) != 0) {
+        fprintf(stderr, "pattern %s: got\n  %s\nexpected\n  %s\n", pattern ? pattern : "(none)", got, expected);
+        abort();
+    }
+    free(got);
+}
+
+void test_walk(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    strcpy(root, "/tmp/ember_walk_XXXXXX");
+    assert(mkdtemp(root));
+    make_dir("src");
+    make_dir("src/core");
+    make_dir("src/core/deep");
+    make_dir("docs");
+    make_file("README.md");
+    make_file("src/main.c");
+    make_file("src/main.h");
+    make_file("src/core/vm.c");
+    make_file("src/core/vm.h");
+    make_file("src/core/deep/a1.c");
+    make_file("src/core/deep/b2.c");
+    make_file("docs/guide.md");
+    // A link back up the tree, and one to a directory outside it
+    char link[256], target[256];
+    snprintf(link, sizeof(link), "%s/src/core/up", root);
+    snprintf(target, sizeof(target), "%s/src", root);
+    assert(symlink(target, link) == 0);
+    make_dir("docs/outside");
+    make_file("docs/outside/extra.h");
+    snprintf(link, sizeof(link), "%s/src/ext", root);
+    snprintf(target, sizeof(target), "%s/docs/outside", root);
+    assert(symlink(target, link) == 0);
+
+    expect(vm, NULL, 0, false,
+           "README.md docs docs/guide.md docs/outside docs/outside/extra.h src src/core src/core/deep "
+           "src/core/deep/a1.c src/core/deep/b2.c src/core/up src/core/vm.c src/core/vm.h src/ext src/main.c "
+           "src/main.h");
+    // Names, paths, globstars, classes
+    expect(vm, "*.c", 0, false, "src/core/deep/a1.c src/core/deep/b2.c src/core/vm.c src/main.c");
+    expect(vm, "src/*.h", 0, false, "src/main.h");
+    expect(vm, "src/**/*.h", 0, false, "src/core/vm.h src/main.h");
+    expect(vm, "**/*.h", 0, false, "docs/outside/extra.h src/core/vm.h src/main.h");
+    expect(vm, "**/deep/*", 0, false, "src/core/deep/a1.c src/core/deep/b2.c");
+    expect(vm, "src/**", 0, false,
+           "src/core src/core/deep src/core/deep/a1.c src/core/deep/b2.c src/core/up src/core/vm.c "
+           "src/core/vm.h src/ext src/main.c src/main.h");
+    expect(vm, "[a-b]?.c", 0, false, "src/core/deep/a1.c src/core/deep/b2.c");
+    expect(vm, "[!a]*.c", 0, false, "src/core/deep/b2.c src/core/vm.c src/main.c");
+    expect(vm, "*.[ch]", 1, false, "");
+    expect(vm, "*.md", 1, false, "README.md");
+    expect(vm, "nothing", 0, false, "");
+
+    // Depth limits. Following links walks each directory once: the way
+    // back up is not taken, and outside is reached by one path only
+    expect(vm, NULL, 2, false, "README.md docs docs/guide.md docs/outside src src/core src/ext src/main.c src/main.h");
+    char* followed = walk(vm, "*.h", 0, true);
+    assert(strcmp(followed, "docs/outside/extra.h src/core/vm.h src/main.h") == 0 ||
+           strcmp(followed, "src/core/vm.h src/ext/extra.h src/main.h") == 0);
+    free(followed);
+
+    // Bad arguments
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, "/nonexistent/dir");
+    assert(ember_native_fs_walk(vm, 1, &vm->stack[vm->stack_top - 1]).type == EMBER_VAL_NIL);
+    ember_value args[3] = {ember_make_string_gc(vm, root), ember_make_nil(), ember_make_number(0)};
+    vm->stack[vm->stack_top - 1] = args[0];
+    assert(ember_native_fs_walk(vm, 3, args).type == EMBER_VAL_NIL);
+    vm->stack_top = 0;
+
+    char command[128];
+    snprintf(command, sizeof(command), "rm -rf %s", root);
+    assert(system(command) == 0);
+    ember_free_vm(vm);
+    printf("Walk test passed\n");
+}
+
+void test_abandoned_walk(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    // More entries than the result queue holds, so the threads block on it
+    strcpy(root, "/tmp/ember_walk_XXXXXX");
+    assert(mkdtemp(root));
+    for (int d = 0; d < 10; d++) {
+        char name[64];
+        snprintf(name, sizeof(name), "d%d", d);
+        make_dir(name);
+        for (int f = 0; f < 600; f++) {
+            snprintf(name, sizeof(name), "d%d/f%d", d, f);
+            make_file(name);
+        }
+    }
+
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, root);
+    ember_value iterator = ember_native_fs_walk(vm, 1, &vm->stack[0]);
+    vm->stack[vm->stack_top++] = iterator;
+    for (int i = 0; i < 10; i++) assert(!iterator_next(AS_ITERATOR(iterator)).done);
+    usleep(20000);
+
+    // Collecting the walker stops and joins its threads
+    vm->stack_top = 0;
+    gc_collect_full(vm, NULL);
+    expect(vm, "f599", 0, false, "d0/f599 d1/f599 d2/f599 d3/f599 d4/f599 d5/f599 d6/f599 d7/f599 d8/f599 d9/f599");
+
+    char command[128];
+    snprintf(command, sizeof(command), "rm -rf %s", root);
+    assert(system(command) == 0);
+    ember_free_vm(vm);
+    printf("Abandoned walk test passed\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running fs walk tests...\n");
+    test_walk();
+    test_abandoned_walk();
+    printf("All fs walk tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include "ember.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int native_calls = 0;
+
+static ember_value native_sum(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    native_calls++;
+    double sum = 0;
+    for (int i = 0; i < argc; i++) {
+        sum += argv[i].as.number_val;
+    }
+    return ember_make_number(sum);
+}
+
+void test_native_handle(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_register_func(vm, "sum", native_sum);
+    
+    ember_function_handle* handle = ember_function_resolve(vm, "sum");
+    assert(handle != NULL);
+    
+    // Results come back directly and the stack is untouched
+    int stack_top = vm->stack_top;
+    ember_value args[2] = {ember_make_number(2), ember_make_number(5)};
+    ember_value result;
+    assert(ember_function_call(handle, 2, args, &result) == 0);
+    assert(result.type == EMBER_VAL_NUMBER && result.as.number_val == 7);
+    assert(vm->stack_top == stack_top);
+    
+    // The argument buffer is owned by the handle and reused
+    ember_value* buffer = ember_function_args(handle, 3);
+    assert(buffer != NULL);
+    for (int i = 0; i < 100; i++) {
+        buffer = ember_function_args(handle, 3);
+        buffer[0] = ember_make_number(i);
+        buffer[1] = ember_make_number(1);
+        buffer[2] = ember_make_number(1);
+        assert(ember_function_call(handle, 3, buffer, &result) == 0);
+        assert(result.as.number_val == i + 2);
+    }
+    assert(native_calls == 101);
+    assert(ember_function_args(handle, EMBER_MAX_ARGS + 1) == NULL);
+    
+    ember_function_release(handle);
+    ember_free_vm(vm);
+    printf("Native function handle test passed\n");
+}
+
+void test_script_handle(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    assert(ember_eval(vm, "fn add(a, b) { return a + b }\nlimit = 3\n") == 0);
+    
+    ember_function_handle* handle = ember_function_resolve(vm, "add");
+    assert(handle != NULL);
+    
+    int stack_top = vm->stack_top;
+    ember_value args[2];
+    ember_value result;
+    for (int i = 0; i < 1000; i++) {
+        args[0] = ember_make_number(i);
+        args[1] = ember_make_number(1);
+        assert(ember_function_call(handle, 2, args, &result) == 0);
+        assert(result.type == EMBER_VAL_NUMBER && result.as.number_val == i + 1);
+    }
+    assert(vm->stack_top == stack_top);
+    assert(vm->frame_count == 0);
+    
+    // A NULL result discards the return value
+    assert(ember_function_call(handle, 2, args, NULL) == 0);
+    assert(vm->stack_top == stack_top);
+    
+    // Only functions resolve
+    assert(ember_function_resolve(vm, "limit") == NULL);
+    assert(ember_function_resolve(vm, "missing") == NULL);
+    
+    ember_function_release(handle);
+    ember_free_vm(vm);
+    printf("Script function handle test passed\n");
+}
+
+void test_call_batch(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_register_func(vm, "sum", native_sum);
+    assert(ember_eval(vm, "fn scale(x, k) { return x * k }\n") == 0);
+    
+    enum { ROWS = 256 };
+    ember_value matrix[ROWS * 2];
+    ember_value results[ROWS];
+    for (int i = 0; i < ROWS; i++) {
+        matrix[i * 2] = ember_make_number(i);
+        matrix[i * 2 + 1] = ember_make_number(3);
+    }
+    
+    ember_function_handle* scale = ember_function_resolve(vm, "scale");
+    assert(scale != NULL);
+    int64_t next_gc = vm->next_gc;
+    assert(ember_call_batch(vm, scale, ROWS, 2, matrix, results) == ROWS);
+    for (int i = 0; i < ROWS; i++) {
+        assert(results[i].type == EMBER_VAL_NUMBER && results[i].as.number_val == i * 3);
+    }
+    assert(vm->next_gc == next_gc);
+    assert(vm->frame_count == 0);
+    
+    ember_function_handle* sum = ember_function_resolve(vm, "sum");
+    assert(sum != NULL);
+    assert(ember_call_batch(vm, sum, ROWS, 2, matrix, results) == ROWS);
+    assert(results[10].as.number_val == 13);
+    assert(ember_call_batch(vm, sum, 0, 2, NULL, NULL) == 0);
+    
+    // Handles only run on the VM that resolved them
+    ember_vm* other = ember_new_vm();
+    assert(other != NULL);
+    assert(ember_call_batch(other, sum, ROWS, 2, matrix, results) == -1);
+    ember_free_vm(other);
+    
+    ember_function_release(sum);
+    ember_function_release(scale);
+    ember_free_vm(vm);
+    printf("Batch call test passed\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running function handle tests...\n");
+    test_native_handle();
+    test_script_handle();
+    test_call_batch();
+    printf("All function handle tests passed!\n");
+    return 0;
+}
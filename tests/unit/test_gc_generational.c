@@ -0,0 +1,229 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int object_count(ember_vm* vm) {
+    int count = 0;
+    for (ember_object* object = vm->objects; object; object = object->next) {
+        count++;
+    }
+    return count;
+}
+
+static ember_value make_string(ember_vm* vm, const char* chars) {
+    ember_value value = ember_make_string_gc(vm, chars);
+    assert(value.type == EMBER_VAL_STRING);
+    return value;
+}
+
+void test_minor_collection(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_gc_configure(vm, 1, 0, 1, 0);
+    assert(vm->gc_generational);
+    int baseline = object_count(vm);
+
+    // One rooted array of strings survives, the garbage does not
+    ember_value kept = ember_make_array(vm, 4);
+    array_push(AS_ARRAY(kept), make_string(vm, "kept element"));
+    vm->stack[vm->stack_top++] = kept;
+    for (int i = 0; i < 100; i++) {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "temporary string number %d", i);
+        make_string(vm, buffer);
+    }
+    assert(intern_string(vm, "temporary interned", 18) != NULL);
+
+    int64_t bytes_before = vm->bytes_allocated;
+    gc_collect_minor(vm);
+    assert(vm->gc_minor_collections == 1);
+    assert(object_count(vm) == baseline + 2);
+    assert(vm->bytes_allocated < bytes_before);
+    assert(kept.as.obj_val->is_old);
+    ember_value element = AS_ARRAY(kept)->elements[0];
+    assert(element.as.obj_val->is_old);
+    assert(strcmp(AS_CSTRING(element), "kept element") == 0);
+
+    // Dead interned strings leave the intern table
+    assert(find_interned_string(vm, "temporary interned", 18) == NULL);
+
+    vm->stack_top--;
+    ember_free_vm(vm);
+    printf("Minor collection test passed\n");
+}
+
+void test_write_barrier(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_gc_configure(vm, 1, 0, 1, 0);
+
+    ember_value array = ember_make_array(vm, 4);
+    vm->stack[vm->stack_top++] = array;
+    gc_collect_minor(vm);
+    assert(array.as.obj_val->is_old);
+
+    // A young value reachable only through an old array is remembered
+    array_push_with_vm(vm, AS_ARRAY(array), make_string(vm, "stored after promotion"));
+    assert(array.as.obj_val->is_remembered);
+    assert(vm->gc_remembered_count == 1);
+    gc_collect_minor(vm);
+    assert(vm->gc_remembered_count == 0);
+    assert(!array.as.obj_val->is_remembered);
+    ember_value element = AS_ARRAY(array)->elements[0];
+    assert(element.as.obj_val->is_old);
+    assert(strcmp(AS_CSTRING(element), "stored after promotion") == 0);
+
+    // Old-to-old stores need no entry
+    array_push_with_vm(vm, AS_ARRAY(array), element);
+    assert(vm->gc_remembered_count == 0);
+
+    vm->stack_top--;
+    ember_free_vm(vm);
+    printf("Write barrier test passed\n");
+}
+
+void test_nursery_requests_collection(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_gc_configure(vm, 1, 0, 1, 0);
+    vm->gc_nursery_limit = 1024;
+
+    while (!vm->gc_minor_requested) {
+        make_string(vm, "filling the nursery with garbage");
+    }
+    assert(vm->gc_minor_collections == 0);
+    gc_collect_minor(vm);
+    assert(!vm->gc_minor_requested);
+    assert(vm->gc_nursery_bytes == 0);
+
+    // Turning generational mode off stops the requests
+    ember_gc_configure(vm, 0, 0, 0, 0);
+    for (int i = 0; i < 200; i++) {
+        make_string(vm, "filling the nursery with garbage");
+    }
+    assert(!vm->gc_minor_requested);
+    ember_free_vm(vm);
+    printf("Nursery threshold test passed\n");
+}
+
+void test_request_heap(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_vm_set_request_heap(vm, 1);
+    assert(vm->gc_generational && vm->gc_request_heap);
+    ember_value config = make_string(vm, "loaded before the first request");
+    assert(ember_global_define(vm, "config", config) >= 0);
+
+    for (int request = 0; request < 3; request++) {
+        gc_request_begin(vm);
+        int baseline = object_count(vm);
+
+        // Temporaries on the stack are request-local
+        ember_value scratch = ember_make_array(vm, 4);
+        vm->stack[vm->stack_top++] = scratch;
+        array_push_with_vm(vm, AS_ARRAY(scratch), make_string(vm, "per-request temporary"));
+        // Storing into a global promotes the value past the request
+        char name[32];
+        snprintf(name, sizeof(name), "result%d", request);
+        ember_value result = make_string(vm, name);
+        assert(ember_global_define(vm, name, result) >= 0);
+
+        gc_request_end(vm);
+        assert(vm->stack_top == 0);
+        assert(object_count(vm) == baseline + 1);
+        assert(result.as.obj_val->is_old);
+        assert(strcmp(AS_CSTRING(result), name) == 0);
+    }
+    assert(strcmp(AS_CSTRING(config), "loaded before the first request") == 0);
+    assert(vm->gc_minor_collections == 3);
+
+    // Leaving generational mode turns the request heap off as well
+    ember_gc_configure(vm, 0, 0, 0, 0);
+    assert(!vm->gc_request_heap);
+    ember_free_vm(vm);
+    printf("Request heap test passed\n");
+}
+
+void test_object_pooling(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_gc_configure(vm, 1, 0, 1, 1);
+    assert(vm->gc_object_pooling);
+
+    ember_value array = ember_make_array(vm, 4);
+    vm->stack[vm->stack_top++] = array;
+    gc_collect_minor(vm);
+
+    // Dead iterators and bound methods go to their free lists
+    ember_object* freed_iterator = ember_make_iterator(vm, array, ITERATOR_ARRAY).as.obj_val;
+    ember_object* freed_method = ember_make_bound_method(vm, array, ember_make_nil()).as.obj_val;
+    gc_collect_minor(vm);
+    assert(vm->gc_pool_count[0] == 1);
+    assert(vm->gc_pool_count[1] == 1);
+
+    // ...and are handed out again before malloc
+    ember_value iterator = ember_make_iterator(vm, array, ITERATOR_ARRAY);
+    assert(iterator.as.obj_val == freed_iterator);
+    assert(iterator.as.obj_val->type == OBJ_ITERATOR && !iterator.as.obj_val->is_old);
+    assert(((ember_iterator*)iterator.as.obj_val)->index == 0);
+    ember_value method = ember_make_bound_method(vm, array, ember_make_nil());
+    assert(method.as.obj_val == freed_method);
+    assert(vm->gc_pool_hits == 2);
+    assert(vm->gc_pool_count[0] == 0 && vm->gc_pool_count[1] == 0);
+
+    // Turning pooling off gives the memory back
+    gc_collect_minor(vm);
+    assert(vm->gc_pool_count[0] == 1);
+    ember_gc_configure(vm, 1, 0, 1, 0);
+    assert(vm->gc_pool_count[0] == 0 && vm->gc_pool_free[0] == NULL);
+
+    vm->stack_top--;
+    ember_free_vm(vm);
+    printf("Object pooling test passed\n");
+}
+
+void test_bound_method_local(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_gc_configure(vm, 1, 0, 1, 0);
+
+    // The bound method, held only in a local slot, is all that keeps its
+    // receiver alive
+    ember_value klass = ember_make_class(vm, "Counter");
+    ember_value receiver = ember_make_instance(vm, AS_CLASS(klass));
+    ember_value method;
+    method.type = EMBER_VAL_NATIVE;
+    method.as.native_val = ember_native_print;
+    ember_value bound = ember_make_bound_method(vm, receiver, method);
+    assert(IS_BOUND_METHOD(bound));
+    vm->stack[vm->stack_top++] = bound;
+
+    gc_collect_minor(vm);
+    assert(bound.as.obj_val->is_old);
+    assert(receiver.as.obj_val->is_old);
+    assert(klass.as.obj_val->is_old);
+    assert(AS_BOUND_METHOD(bound)->receiver.as.obj_val == receiver.as.obj_val);
+
+    vm->stack_top--;
+    ember_free_vm(vm);
+    printf("Bound method root test passed\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running generational GC tests...\n");
+    test_minor_collection();
+    test_write_barrier();
+    test_nursery_requests_collection();
+    test_request_heap();
+    test_object_pooling();
+    test_bound_method_local();
+    printf("All generational GC tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,198 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "../../src/core/gc_trace.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int object_count(ember_vm* vm) {
+    int count = 0;
+    for (ember_object* object = vm->objects; object; object = object->next) {
+        count++;
+    }
+    return count;
+}
+
+static ember_value make_string(ember_vm* vm, const char* chars) {
+    ember_value value = ember_make_string_gc(vm, chars);
+    assert(value.type == EMBER_VAL_STRING);
+    return value;
+}
+
+static void make_garbage(ember_vm* vm, int count) {
+    for (int i = 0; i < count; i++) {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "incremental garbage string %d", i);
+        make_string(vm, buffer);
+    }
+}
+
+void test_incremental_cycle(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_gc_configure(vm, 0, 1, 1, 0);
+    ember_gc_set_step_budget(vm, 200);
+    assert(vm->gc_incremental);
+    assert(vm->gc_step_budget_us == 200);
+    int baseline = object_count(vm);
+
+    ember_value kept = ember_make_array(vm, 4);
+    array_push_with_vm(vm, AS_ARRAY(kept), make_string(vm, "kept element"));
+    vm->stack[vm->stack_top++] = kept;
+    make_garbage(vm, 200);
+    assert(vm->gc_phase == GC_PHASE_IDLE);
+
+    // Crossing next_gc starts a cycle instead of collecting on the spot
+    vm->next_gc = vm->bytes_allocated;
+    make_string(vm, "allocated past the threshold");
+    assert(vm->gc_phase == GC_PHASE_MARK);
+    assert(vm->gc_step_requested);
+
+    int steps = 0;
+    while (vm->gc_phase != GC_PHASE_IDLE) {
+        gc_incremental_step(vm);
+        steps++;
+        assert(steps < 100000);
+    }
+    assert(vm->gc_collections == 1);
+    assert(vm->gc_incremental_steps == (uint64_t)steps);
+    assert(object_count(vm) == baseline + 2);
+    assert(strcmp(AS_CSTRING(AS_ARRAY(kept)->elements[0]), "kept element") == 0);
+    assert(!kept.as.obj_val->is_marked);
+
+    vm->stack_top--;
+    ember_free_vm(vm);
+    printf("Incremental cycle test passed\n");
+}
+
+void test_barrier_during_marking(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_gc_configure(vm, 0, 1, 1, 0);
+
+    ember_value array = ember_make_array(vm, 4);
+    vm->stack[vm->stack_top++] = array;
+    // Reachable only from C when the cycle starts
+    ember_value hidden = make_string(vm, "stored while marking");
+    make_string(vm, "unreachable");
+    int baseline = object_count(vm);
+
+    gc_incremental_start(vm);
+    assert(vm->gc_phase == GC_PHASE_MARK);
+    while (vm->gc_gray_count > 0) {
+        gc_trace_object(vm, vm->gc_gray[--vm->gc_gray_count]);
+    }
+    assert(array.as.obj_val->is_marked);
+    assert(!hidden.as.obj_val->is_marked);
+
+    // The barrier grays a white value stored into a traced object
+    array_push_with_vm(vm, AS_ARRAY(array), hidden);
+    assert(hidden.as.obj_val->is_marked);
+    assert(vm->gc_gray_count == 1);
+
+    // Allocation during marking is black
+    ember_value fresh = make_string(vm, "allocated while marking");
+    assert(fresh.as.obj_val->is_marked);
+    vm->stack[vm->stack_top++] = fresh;
+
+    gc_incremental_finish(vm);
+    assert(vm->gc_phase == GC_PHASE_IDLE);
+    assert(object_count(vm) == baseline);
+    assert(strcmp(AS_CSTRING(AS_ARRAY(array)->elements[0]), "stored while marking") == 0);
+    assert(strcmp(AS_CSTRING(fresh), "allocated while marking") == 0);
+
+    vm->stack_top -= 2;
+    ember_free_vm(vm);
+    printf("Marking barrier test passed\n");
+}
+
+void test_generational_interplay(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_gc_configure(vm, 1, 1, 1, 0);
+
+    ember_value kept = ember_make_array(vm, 4);
+    vm->stack[vm->stack_top++] = kept;
+    gc_incremental_start(vm);
+
+    // Minor collections wait for the cycle to finish
+    vm->gc_minor_requested = 1;
+    gc_collect_minor(vm);
+    assert(vm->gc_minor_collections == 0);
+    assert(vm->gc_minor_requested);
+
+    make_garbage(vm, 50);
+    ember_gc_collect(vm);
+    assert(vm->gc_phase == GC_PHASE_IDLE);
+    assert(kept.as.obj_val->is_old);
+    assert(vm->gc_remembered_count == 0);
+
+    // Afterwards the nursery is reclaimed by minor collections again
+    make_garbage(vm, 50);
+    int before = object_count(vm);
+    gc_collect_minor(vm);
+    assert(vm->gc_minor_collections == 1);
+    assert(object_count(vm) == before - 50);
+
+    vm->stack_top--;
+    ember_free_vm(vm);
+    printf("Generational interplay test passed\n");
+}
+
+void test_lazy_sweep(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_gc_set_lazy_sweep(vm, 1);
+    int baseline = object_count(vm);
+
+    ember_value kept = ember_make_array(vm, 4);
+    vm->stack[vm->stack_top++] = kept;
+    array_push_with_vm(vm, AS_ARRAY(kept), make_string(vm, "kept element"));
+    make_garbage(vm, 200);
+
+    // Crossing next_gc marks and returns with the cycle left to sweep
+    vm->next_gc = vm->bytes_allocated;
+    ember_value fresh = make_string(vm, "allocated past the threshold");
+    vm->stack[vm->stack_top++] = fresh;
+    assert(vm->gc_phase == GC_PHASE_SWEEP);
+    assert(vm->gc_sweep_list != NULL);
+    assert(vm->gc_collections == 0);
+
+    // Every allocation sweeps a batch until the list runs out
+    int allocations = 0;
+    while (vm->gc_phase != GC_PHASE_IDLE) {
+        make_string(vm, "allocated while sweeping");
+        allocations++;
+        assert(allocations < 100000);
+    }
+    assert(allocations > 1);
+    assert(vm->gc_collections == 1);
+    assert(object_count(vm) == baseline + 3 + allocations);
+    assert(strcmp(AS_CSTRING(AS_ARRAY(kept)->elements[0]), "kept element") == 0);
+    assert(strcmp(AS_CSTRING(fresh), "allocated past the threshold") == 0);
+    assert(!kept.as.obj_val->is_marked && !fresh.as.obj_val->is_marked);
+
+    // An explicit collection still sweeps before it returns
+    ember_gc_collect(vm);
+    assert(vm->gc_phase == GC_PHASE_IDLE);
+    assert(object_count(vm) == baseline + 3);
+
+    vm->stack_top -= 2;
+    ember_free_vm(vm);
+    printf("Lazy sweep test passed\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running incremental GC tests...\n");
+    test_incremental_cycle();
+    test_barrier_during_marking();
+    test_generational_interplay();
+    test_lazy_sweep();
+    printf("All incremental GC tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "../../src/core/gc_trace.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int object_count(ember_vm* vm) {
+    int count = 0;
+    for (ember_object* object = vm->objects; object; object = object->next) {
+        assert(!object->is_marked);
+        count++;
+    }
+    return count;
+}
+
+static ember_value make_string(ember_vm* vm, int index) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "parallel marking string %d", index);
+    ember_value value = ember_make_string_gc(vm, buffer);
+    assert(value.type == EMBER_VAL_STRING);
+    return value;
+}
+
+void test_parallel_full_collection(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_gc_set_mark_threads(vm, 4);
+    assert(vm->gc_mark_threads == 4);
+    int baseline = object_count(vm);
+
+    // A wide array (stolen from) and a deep chain (grows one deque)
+    ember_value wide = ember_make_array(vm, 16);
+    vm->stack[vm->stack_top++] = wide;
+    for (int i = 0; i < 20000; i++) {
+        ember_value row = ember_make_array(vm, 2);
+        array_push_with_vm(vm, AS_ARRAY(row), make_string(vm, i));
+        array_push_with_vm(vm, AS_ARRAY(wide), row);
+        make_string(vm, -i);
+    }
+    ember_value chain = ember_make_array(vm, 1);
+    vm->stack[vm->stack_top++] = chain;
+    ember_value link = chain;
+    for (int i = 0; i < 5000; i++) {
+        ember_value next = ember_make_array(vm, 1);
+        array_push_with_vm(vm, AS_ARRAY(link), next);
+        link = next;
+    }
+
+    ember_gc_collect(vm);
+    assert(vm->gc_phase == GC_PHASE_IDLE);
+    assert(vm->gc_collections == 1);
+    assert(object_count(vm) == baseline + 1 + 20000 * 2 + 5001);
+    ember_value row = AS_ARRAY(wide)->elements[12345];
+    assert(strcmp(AS_CSTRING(AS_ARRAY(row)->elements[0]), "parallel marking string 12345") == 0);
+
+    // Unrooting the chain frees all of it
+    vm->stack_top--;
+    ember_gc_collect(vm);
+    assert(object_count(vm) == baseline + 1 + 20000 * 2);
+
+    vm->stack_top--;
+    ember_free_vm(vm);
+    printf("Parallel full collection test passed\n");
+}
+
+void test_allocation_triggers_parallel_collection(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_gc_configure(vm, 1, 0, 1, 0);
+    ember_gc_set_mark_threads(vm, 0);
+    assert(vm->gc_mark_threads >= 1);
+    if (vm->gc_mark_threads == 1) {
+        ember_gc_set_mark_threads(vm, 2);
+    }
+
+    ember_value kept = ember_make_array(vm, 4);
+    vm->stack[vm->stack_top++] = kept;
+    for (int i = 0; i < 1000; i++) {
+        make_string(vm, i);
+    }
+    vm->next_gc = vm->bytes_allocated;
+
+    // The object being allocated survives the collection it triggers
+    ember_value fresh = make_string(vm, 1000);
+    assert(vm->gc_collections == 1);
+    assert(strcmp(AS_CSTRING(fresh), "parallel marking string 1000") == 0);
+    assert(kept.as.obj_val->is_old);
+    assert(vm->next_gc > vm->bytes_allocated);
+
+    vm->stack_top--;
+    ember_free_vm(vm);
+    printf("Allocation-triggered parallel collection test passed\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running parallel marking tests...\n");
+    test_parallel_full_collection();
+    test_allocation_triggers_parallel_collection();
+    printf("All parallel marking tests passed!\n");
+    return 0;
+}
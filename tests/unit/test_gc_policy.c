@@ -0,0 +1,133 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "../../src/core/gc_trace.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+static void make_garbage(ember_vm* vm, int count) {
+    for (int i = 0; i < count; i++) {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "policy garbage string %d", i);
+        ember_value value = ember_make_string_gc(vm, buffer);
+        assert(value.type == EMBER_VAL_STRING);
+    }
+}
+
+void test_large_heap_accounting(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    // Multi-GB heaps neither wrap nor collect early
+    vm->bytes_allocated += (int64_t)3 << 30;
+    vm->next_gc = (int64_t)4 << 30;
+    make_garbage(vm, 10);
+    assert(vm->gc_collections == 0);
+    assert(vm->bytes_allocated > ((int64_t)3 << 30));
+    int64_t actual = vm->bytes_allocated - ((int64_t)3 << 30);
+
+    // Thresholds past 4 GB
+    vm->bytes_allocated = (int64_t)5 << 30;
+    gc_policy_collected(vm, (int64_t)6 << 30, 0);
+    assert(vm->next_gc == (int64_t)10 << 30);
+    assert(vm->gc_live_bytes == (int64_t)5 << 30);
+
+    vm->bytes_allocated = actual;
+    ember_free_vm(vm);
+    printf("Large heap accounting test passed\n");
+}
+
+void test_growth_and_floor(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_gc_configure(vm, 0, 1, 1, 0);
+
+    ember_gc_policy policy;
+    ember_gc_get_policy(vm, &policy);
+    assert(policy.heap_growth == 2.0);
+    policy.heap_growth = 1.5;
+    policy.min_heap_bytes = 0;
+    ember_gc_configure_policy(vm, &policy);
+
+    make_garbage(vm, 100);
+    ember_gc_collect(vm);
+    assert(vm->gc_collections == 1);
+    assert(vm->gc_live_bytes == vm->bytes_allocated);
+    assert(vm->next_gc == (int64_t)((double)vm->bytes_allocated * 1.5));
+
+    // Small heaps are not collected below the floor
+    policy.min_heap_bytes = 1024 * 1024;
+    ember_gc_configure_policy(vm, &policy);
+    assert(vm->next_gc == 1024 * 1024);
+
+    // Rejected policies leave the current one in place
+    ember_gc_policy invalid = policy;
+    invalid.heap_growth = 1.0;
+    ember_gc_configure_policy(vm, &invalid);
+    assert(vm->gc_heap_growth == 1.5);
+
+    ember_free_vm(vm);
+    printf("Growth factor test passed\n");
+}
+
+void test_allocation_rate_pacing(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_gc_configure(vm, 0, 1, 1, 0);
+
+    make_garbage(vm, 100);
+    ember_gc_collect(vm);
+    make_garbage(vm, 1000);
+    ember_gc_collect(vm);
+    assert(vm->gc_collections == 2);
+    assert(vm->gc_alloc_rate > 0.0);
+
+    // A fast allocator gets room for min_interval_ms of allocation
+    vm->gc_alloc_rate = 1000000.0;
+    ember_gc_policy policy;
+    ember_gc_get_policy(vm, &policy);
+    policy.min_interval_ms = 100;
+    ember_gc_configure_policy(vm, &policy);
+    assert(vm->next_gc == vm->gc_live_bytes + 100000000);
+
+    ember_free_vm(vm);
+    printf("Allocation rate pacing test passed\n");
+}
+
+void test_pause_target(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_gc_policy policy;
+    ember_gc_get_policy(vm, &policy);
+    policy.max_pause_us = 1000;
+    ember_gc_configure_policy(vm, &policy);
+    assert(!vm->gc_incremental);
+
+    // A stop-the-world collection within the target changes nothing
+    gc_policy_collected(vm, vm->bytes_allocated, 400);
+    assert(!vm->gc_incremental);
+
+    // One that overruns it moves the VM to budgeted steps
+    gc_policy_collected(vm, vm->bytes_allocated, 5000);
+    assert(vm->gc_incremental);
+    assert(vm->gc_step_budget_us == 1000);
+    assert(vm->gc_last_pause_us == 5000);
+
+    ember_free_vm(vm);
+    printf("Pause target test passed\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running GC policy tests...\n");
+    test_large_heap_accounting();
+    test_growth_and_floor();
+    test_allocation_rate_pacing();
+    test_pause_target();
+    printf("All GC policy tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+static void make_garbage(ember_vm* vm, int count) {
+    for (int i = 0; i < count; i++) {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "telemetry garbage string %d", i);
+        ember_value value = ember_make_string_gc(vm, buffer);
+        assert(value.type == EMBER_VAL_STRING);
+    }
+}
+
+void test_minor_collection_stats(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_gc_configure(vm, 1, 0, 1, 0);
+    ember_gc_stats stats;
+    assert(ember_gc_get_stats(NULL, &stats) == EMBER_ERROR_INVALID_PARAMETER);
+    assert(ember_gc_get_stats(vm, &stats) == EMBER_SUCCESS);
+
+    ember_value kept = ember_make_array(vm, 4);
+    vm->stack[vm->stack_top++] = kept;
+    gc_collect_minor(vm);
+    make_garbage(vm, 100);
+    int64_t bytes_before = vm->bytes_allocated;
+    gc_collect_minor(vm);
+
+    assert(ember_gc_get_stats(vm, &stats) == EMBER_SUCCESS);
+    assert(stats.collections == 2 && stats.history_count == 2);
+    assert(stats.pause_count == 2);
+    uint64_t bucketed = 0;
+    for (int i = 0; i < EMBER_GC_PAUSE_BUCKETS; i++) {
+        bucketed += stats.pauses[i];
+    }
+    assert(bucketed == 2);
+    // The first collection promoted the array; the second only saw garbage
+    assert(stats.history[0].kind == EMBER_GC_MINOR);
+    assert(stats.history[0].survivors >= 1);
+    const ember_gc_collection* last = &stats.history[1];
+    assert(last->survivors == 0);
+    assert(last->bytes_freed == bytes_before - vm->bytes_allocated);
+    assert(last->bytes_allocated >= last->bytes_freed);
+    assert(last->bytes_live == vm->bytes_allocated);
+    assert(stats.survivors_kind == EMBER_GC_MINOR && stats.survivors_by_type[OBJ_STRING] == 0);
+    assert(strcmp(ember_gc_object_type_name(OBJ_HASH_MAP), "hash_map") == 0);
+
+    ember_gc_reset_stats(vm);
+    assert(ember_gc_get_stats(vm, &stats) == EMBER_SUCCESS);
+    assert(stats.collections == 0 && stats.history_count == 0 && stats.pause_count == 0);
+
+    vm->stack_top--;
+    ember_free_vm(vm);
+    printf("Minor collection stats test passed\n");
+}
+
+void test_full_collection_survivors(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_gc_configure(vm, 0, 1, 1, 0);
+
+    ember_value kept = ember_make_array(vm, 4);
+    vm->stack[vm->stack_top++] = kept;
+    make_garbage(vm, 100);
+    ember_gc_collect(vm);
+    ember_gc_stats stats;
+    assert(ember_gc_get_stats(vm, &stats) == EMBER_SUCCESS);
+    assert(stats.collections >= 1);
+    const ember_gc_collection* last = &stats.history[stats.history_count - 1];
+    assert(last->kind == EMBER_GC_INCREMENTAL);
+    assert(last->bytes_freed > 0);
+    assert(stats.survivors_kind == EMBER_GC_INCREMENTAL);
+    assert(stats.survivors_by_type[OBJ_ARRAY] >= 1);
+    assert(stats.total_freed >= last->bytes_freed);
+
+    // The history keeps the last EMBER_GC_HISTORY collections, oldest first
+    for (int i = 0; i < EMBER_GC_HISTORY + 5; i++) {
+        ember_gc_collect(vm);
+    }
+    assert(ember_gc_get_stats(vm, &stats) == EMBER_SUCCESS);
+    assert(stats.history_count == EMBER_GC_HISTORY);
+    assert(stats.history[EMBER_GC_HISTORY - 1].bytes_live == vm->bytes_allocated);
+
+    vm->stack_top--;
+    ember_free_vm(vm);
+    printf("Full collection survivors test passed\n");
+}
+
+void test_allocation_sites(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    assert(ember_gc_sample_allocations(vm, -1) == EMBER_ERROR_INVALID_PARAMETER);
+    assert(ember_gc_get_allocation_sites(vm, NULL, 0) == 0);
+
+    // Two allocating instructions in a chunk
+    ember_chunk chunk;
+    init_chunk(&chunk);
+    write_chunk(&chunk, OP_POP);
+    write_chunk(&chunk, OP_POP);
+    ember_chunk* saved_chunk = vm->chunk;
+    uint8_t* saved_ip = vm->ip;
+    vm->chunk = &chunk;
+
+    assert(ember_gc_sample_allocations(vm, 2) == EMBER_SUCCESS);
+    vm->ip = chunk.code + 1;
+    make_garbage(vm, 10);
+    vm->ip = chunk.code + 2;
+    make_garbage(vm, 4);
+    assert(ember_gc_sample_allocations(vm, 0) == EMBER_SUCCESS);
+    make_garbage(vm, 10);
+    vm->chunk = saved_chunk;
+    vm->ip = saved_ip;
+
+    ember_gc_alloc_site sites[4];
+    assert(ember_gc_get_allocation_sites(vm, sites, 4) == 2);
+    assert(sites[0].chunk == &chunk && sites[0].offset == 0);
+    assert(sites[0].type == OBJ_STRING && sites[0].samples == 5 && sites[0].bytes > 0);
+    assert(sites[1].offset == 1 && sites[1].samples == 2);
+    // Fewer slots than sites: the biggest ones
+    assert(ember_gc_get_allocation_sites(vm, sites, 1) == 2 && sites[0].offset == 0);
+
+    ember_gc_reset_stats(vm);
+    assert(ember_gc_get_allocation_sites(vm, sites, 4) == 0);
+    free_chunk(&chunk);
+    ember_free_vm(vm);
+    printf("Allocation site sampling test passed\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running GC telemetry tests...\n");
+    test_minor_collection_stats();
+    test_full_collection_survivors();
+    test_allocation_sites();
+    printf("All GC telemetry tests passed!\n");
+    return 0;
+}
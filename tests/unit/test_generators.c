@@ -0,0 +1,121 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static ember_value call_generator_function(ember_vm* vm, const char* name) {
+    ember_value result;
+    int rc = vm_call_value(vm, global_value(vm, name), 0, NULL, &result);
+    assert(rc == 0);
+    (void)rc;
+    assert(result.type == EMBER_VAL_GENERATOR);
+    return result;
+}
+
+void test_resume_in_place(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(ember_eval(vm,
+        "fn* count() {\n"
+        "    i = 10\n"
+        "    yield i\n"
+        "    i = i + 1\n"
+        "    yield i\n"
+        "    return 99\n"
+        "}\n") == 0);
+
+    ember_value value = call_generator_function(vm, "count");
+    ember_generator* generator = AS_GENERATOR(value);
+    // Calling does not run the body
+    assert(generator->state == GENERATOR_CREATED);
+
+    ember_value result;
+    int rc = vm_generator_resume(vm, generator, ember_make_nil(), &result);
+    assert(rc == 1);
+    assert(result.type == EMBER_VAL_NUMBER && result.as.number_val == 10);
+    assert(generator->state == GENERATOR_SUSPENDED);
+    ember_value* frame = generator->frame;
+    rc = vm_generator_resume(vm, generator, ember_make_nil(), &result);
+    assert(rc == 1);
+    assert(result.as.number_val == 11);
+    // Same heap frame across yields
+    assert(generator->frame == frame);
+
+    rc = vm_generator_resume(vm, generator, ember_make_nil(), &result);
+    assert(rc == 0);
+    assert(result.type == EMBER_VAL_NUMBER && result.as.number_val == 99);
+    assert(generator->state == GENERATOR_COMPLETED && generator->frame == NULL);
+    rc = vm_generator_resume(vm, generator, ember_make_nil(), &result);
+    assert(rc == 0);
+    (void)rc;
+    assert(result.type == EMBER_VAL_NIL);
+    assert(vm->stack_top == 0 && vm->frame_count == 0);
+
+    ember_free_vm(vm);
+    printf("  ✓ Generators resume from their heap frame\n");
+}
+
+void test_iterator_adapter(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(ember_eval(vm,
+        "fn* evens() {\n"
+        "    n = 0\n"
+        "    while (n < 2000) {\n"
+        "        yield n\n"
+        "        n = n + 2\n"
+        "    }\n"
+        "}\n") == 0);
+
+    ember_value iterator_value = ember_make_iterator(vm, call_generator_function(vm, "evens"), ITERATOR_GENERATOR);
+    ember_iterator* iterator = AS_ITERATOR(iterator_value);
+    double sum = 0;
+    int count = 0;
+    while (!iterator_done(iterator)) {
+        ember_iterator_result step = iterator_next(iterator);
+        if (step.done) break;
+        sum += step.value.as.number_val;
+        count++;
+        // Collections between steps keep the suspended frame alive
+        if (count % 250 == 0) ember_gc_collect(vm);
+    }
+    assert(count == 1000);
+    assert(sum == 999000);
+    assert(iterator_done(iterator));
+
+    ember_free_vm(vm);
+    printf("  ✓ Iterators drive generators step by step\n");
+}
+
+void test_generator_errors(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(ember_eval(vm,
+        "fn* broken() {\n"
+        "    yield 1\n"
+        "    throw \"boom\"\n"
+        "}\n") == 0);
+
+    ember_generator* generator = AS_GENERATOR(call_generator_function(vm, "broken"));
+    ember_value result;
+    int rc = vm_generator_resume(vm, generator, ember_make_nil(), &result);
+    assert(rc == 1);
+    rc = vm_generator_resume(vm, generator, ember_make_nil(), &result);
+    assert(rc == -1);
+    (void)rc;
+    assert(generator->state == GENERATOR_COMPLETED);
+    assert(vm->frame_count == 0 && vm->stack_top == 0);
+    ember_vm_clear_error(vm);
+
+    ember_free_vm(vm);
+    printf("  ✓ A throwing generator completes and unwinds\n");
+}
+
+int main(void) {
+    printf("Testing generators...\n");
+    test_resume_in_place();
+    test_iterator_adapter();
+    test_generator_errors();
+    printf("✓ Generator tests passed\n");
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "../../src/runtime/stdlib_working.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+static char* read_all(const char* path) {
+    FILE* file = fopen(path, "rb");
+    assert(file != NULL);
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* text = malloc((size_t)size + 1);
+    assert(text != NULL);
+    assert(fread(text, 1, (size_t)size, file) == (size_t)size);
+    text[size] = '\0';
+    fclose(file);
+    return text;
+}
+
+static ember_value field(ember_vm* vm, ember_value map, const char* key) {
+    assert(map.type == EMBER_VAL_HASH_MAP);
+    return hash_map_get(AS_HASH_MAP(map), ember_make_string_gc(vm, key));
+}
+
+void test_histogram(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_heap_histogram before;
+    assert(ember_vm_heap_histogram(NULL, &before) == EMBER_ERROR_INVALID_PARAMETER);
+    assert(ember_vm_heap_histogram(vm, NULL) == EMBER_ERROR_INVALID_PARAMETER);
+    assert(ember_vm_heap_histogram(vm, &before) == EMBER_SUCCESS);
+
+    ember_value array = ember_make_array(vm, 64);
+    vm->stack[vm->stack_top++] = array;
+    for (int i = 0; i < 20; i++) {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "histogram string number %d", i);
+        array_push_with_vm(vm, AS_ARRAY(array), ember_make_string_gc(vm, buffer));
+    }
+
+    ember_heap_histogram after;
+    assert(ember_vm_heap_histogram(vm, &after) == EMBER_SUCCESS);
+    assert(after.count[OBJ_STRING] >= before.count[OBJ_STRING] + 20);
+    assert(after.count[OBJ_ARRAY] == before.count[OBJ_ARRAY] + 1);
+    // The element buffer counts with the array
+    assert(after.bytes[OBJ_ARRAY] - before.bytes[OBJ_ARRAY] >= sizeof(ember_array) + 64 * sizeof(ember_value));
+    uint64_t count = 0, bytes = 0;
+    for (int type = 0; type < EMBER_GC_OBJECT_TYPES; type++) {
+        count += after.count[type];
+        bytes += after.bytes[type];
+    }
+    assert(count == after.total_count && bytes == after.total_bytes);
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/ember-heap-stats-%d.txt", (int)getpid());
+    assert(ember_vm_write_heap_histogram(vm, path) == EMBER_SUCCESS);
+    char* text = read_all(path);
+    assert(strstr(text, "Ember heap: ") == text);
+    assert(strstr(text, "\nstring ") != NULL && strstr(text, "\narray ") != NULL);
+    free(text);
+    unlink(path);
+    assert(ember_vm_write_heap_histogram(vm, "/nonexistent/dir/stats.txt") == EMBER_ERROR_OPERATION_FAILED);
+
+    vm->stack_top--;
+    ember_free_vm(vm);
+    printf("Heap histogram test passed\n");
+}
+
+void test_snapshot(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value array = ember_make_array(vm, 4);
+    vm->stack[vm->stack_top++] = array;
+    array_push_with_vm(vm, AS_ARRAY(array), ember_make_string_gc(vm, "snapshot \"marker\"\n"));
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/ember-heap-%d.heapsnapshot", (int)getpid());
+    assert(ember_vm_write_heap_snapshot(NULL, path) == EMBER_ERROR_INVALID_PARAMETER);
+    assert(ember_vm_write_heap_snapshot(vm, path) == EMBER_SUCCESS);
+    char* text = read_all(path);
+    unlink(path);
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, text);
+    free(text);
+    int top = vm->stack_top;
+    ember_value doc = ember_json_parse_working(vm, 1, &vm->stack[top - 1]);
+    vm->stack[top - 1] = doc;
+
+    ember_value snapshot = field(vm, doc, "snapshot");
+    ember_array* nodes = AS_ARRAY(field(vm, doc, "nodes"));
+    ember_array* edges = AS_ARRAY(field(vm, doc, "edges"));
+    ember_array* strings = AS_ARRAY(field(vm, doc, "strings"));
+    int node_count = (int)field(vm, snapshot, "node_count").as.number_val;
+    int edge_count = (int)field(vm, snapshot, "edge_count").as.number_val;
+    assert(nodes->length == node_count * 6);
+    assert(edges->length == edge_count * 3);
+
+    // The root comes first and is synthetic
+    assert(nodes->elements[0].as.number_val == 9);
+    assert(strcmp(AS_STRING(strings->elements[(int)nodes->elements[1].as.number_val])->chars, "(GC roots)") == 0);
+    int marker = -1;
+    int edge_total = 0;
+    for (int node = 0; node < node_count; node++) {
+        const ember_value* fields = &nodes->elements[node * 6];
+        const char* name = AS_STRING(strings->elements[(int)fields[1].as.number_val])->chars;
+        if (fields[0].as.number_val == 2 && strcmp(name, "snapshot \"marker\"\n") == 0) marker = node;
+        edge_total += (int)fields[4].as.number_val;
+    }
+    assert(marker > 0);
+    assert(edge_total == edge_count);
+
+    // Something points at the marker, and every edge at a node
+    int referenced = 0;
+    for (int edge = 0; edge < edge_count; edge++) {
+        int to = (int)edges->elements[edge * 3 + 2].as.number_val;
+        assert(to % 6 == 0 && to < nodes->length);
+        if (to == marker * 6) referenced = 1;
+    }
+    assert(referenced);
+
+    vm->stack_top -= 2;
+    ember_free_vm(vm);
+    printf("Heap snapshot test passed\n");
+}
+
+int main(void) {
+    test_histogram();
+    test_snapshot();
+    printf("All heap snapshot tests passed\n");
+    return 0;
+}
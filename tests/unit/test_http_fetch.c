@@ -0,0 +1,379 @@
+#define _POSIX_C_SOURCE 200809L
+#include "ember.h"
+#include "../../src/vm.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#ifdef HAVE_CURL
+
+#define FETCH_REQUESTS 8
+
+// Accepts FETCH_REQUESTS connections before answering any of them, so the
+// test only finishes if every request is in flight at once
+static void* serve(void* arg) {
+    int listener = *(int*)arg;
+    int clients[FETCH_REQUESTS];
+    for (int i = 0; i < FETCH_REQUESTS; i++) {
+        clients[i] = accept(listener, NULL, NULL);
+        assert(clients[i] >= 0);
+        char request[1024];
+        assert(read(clients[i], request, sizeof(request)) > 0);
+    }
+    const char* response = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\nConnection: close\r\n\r\nhello";
+    for (int i = 0; i < FETCH_REQUESTS; i++) {
+        assert(write(clients[i], response, strlen(response)) == (ssize_t)strlen(response));
+        close(clients[i]);
+    }
+    return NULL;
+}
+
+static int listen_local(int* port) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    assert(listener >= 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int rc = bind(listener, (struct sockaddr*)&addr, sizeof(addr));
+    assert(rc == 0);
+    rc = listen(listener, FETCH_REQUESTS);
+    assert(rc == 0);
+    socklen_t length = sizeof(addr);
+    rc = getsockname(listener, (struct sockaddr*)&addr, &length);
+    assert(rc == 0);
+    (void)rc;
+    *port = ntohs(addr.sin_port);
+    return listener;
+}
+
+void test_concurrent_fetches(void) {
+    int port;
+    int listener = listen_local(&port);
+    pthread_t server;
+    int rc = pthread_create(&server, NULL, serve, &listener);
+    assert(rc == 0);
+    (void)rc;
+
+    ember_vm* vm = ember_new_vm();
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/", port);
+    ember_value promises[FETCH_REQUESTS];
+    for (int i = 0; i < FETCH_REQUESTS; i++) {
+        ember_value arg = ember_make_string_gc(vm, url);
+        promises[i] = ember_native_http_fetch(vm, 1, &arg);
+        assert(promises[i].type == EMBER_VAL_PROMISE);
+        assert(AS_PROMISE(promises[i])->state == PROMISE_PENDING);
+    }
+
+    assert(ember_loop_run(vm) == 0);
+    for (int i = 0; i < FETCH_REQUESTS; i++) {
+        ember_promise* promise = AS_PROMISE(promises[i]);
+        assert(promise->state == PROMISE_RESOLVED);
+        assert(strcmp(AS_CSTRING(promise->value), "hello") == 0);
+    }
+    assert(vm->pending_promises->length == 0);
+
+    pthread_join(server, NULL);
+    close(listener);
+    ember_free_vm(vm);
+    printf("  ✓ Fetches run concurrently on one VM thread\n");
+}
+
+// Answers two requests on a single keep-alive connection; a second connect
+// would sit in the backlog unanswered
+static void* serve_keepalive(void* arg) {
+    int listener = *(int*)arg;
+    int client = accept(listener, NULL, NULL);
+    assert(client >= 0);
+    const char* response = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nagain";
+    for (int i = 0; i < 2; i++) {
+        char request[1024];
+        assert(read(client, request, sizeof(request)) > 0);
+        assert(write(client, response, strlen(response)) == (ssize_t)strlen(response));
+    }
+    close(client);
+    return NULL;
+}
+
+void test_connection_reuse(void) {
+    int port;
+    int listener = listen_local(&port);
+    pthread_t server;
+    int rc = pthread_create(&server, NULL, serve_keepalive, &listener);
+    assert(rc == 0);
+    (void)rc;
+
+    ember_vm* vm = ember_new_vm();
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/", port);
+    for (int i = 0; i < 2; i++) {
+        ember_value arg = ember_make_string_gc(vm, url);
+        ember_value promise = ember_native_http_fetch(vm, 1, &arg);
+        assert(ember_loop_run(vm) == 0);
+        assert(AS_PROMISE(promise)->state == PROMISE_RESOLVED);
+        assert(strcmp(AS_CSTRING(AS_PROMISE(promise)->value), "again") == 0);
+    }
+
+    pthread_join(server, NULL);
+    close(listener);
+    ember_free_vm(vm);
+    printf("  ✓ Sequential fetches reuse the connection\n");
+}
+
+#define STREAM_BODY_SIZE (256 * 1024)
+
+static const char* g_response = NULL;
+static size_t g_response_length = 0;
+
+// Answers one request with g_response
+static void* serve_once(void* arg) {
+    int listener = *(int*)arg;
+    int client = accept(listener, NULL, NULL);
+    assert(client >= 0);
+    char request[1024];
+    assert(read(client, request, sizeof(request)) > 0);
+    size_t sent = 0;
+    while (sent < g_response_length) {
+        ssize_t n = write(client, g_response + sent, g_response_length - sent);
+        assert(n > 0);
+        sent += (size_t)n;
+    }
+    close(client);
+    return NULL;
+}
+
+// A response whose body is STREAM_BODY_SIZE bytes of 'x'
+static char* large_response(size_t* length) {
+    char header[128];
+    int header_length = snprintf(header, sizeof(header),
+        "HTTP/1.1 200 OK\r\nContent-Length: %d\r\nConnection: close\r\n\r\n", STREAM_BODY_SIZE);
+    char* response = malloc((size_t)header_length + STREAM_BODY_SIZE);
+    assert(response);
+    memcpy(response, header, (size_t)header_length);
+    memset(response + header_length, 'x', STREAM_BODY_SIZE);
+    *length = (size_t)header_length + STREAM_BODY_SIZE;
+    return response;
+}
+
+static int chunk_calls = 0;
+static size_t chunk_bytes = 0;
+
+static ember_value on_chunk(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    assert(argc == 1 && argv[0].type == EMBER_VAL_STRING);
+    ember_string* chunk = AS_STRING(argv[0]);
+    for (int i = 0; i < chunk->length; i++) {
+        assert(chunk->chars[i] == 'x');
+    }
+    chunk_calls++;
+    chunk_bytes += (size_t)chunk->length;
+    return ember_make_nil();
+}
+
+void test_stream(void) {
+    int port;
+    int listener = listen_local(&port);
+    char* response = large_response(&g_response_length);
+    g_response = response;
+    pthread_t server;
+    int rc = pthread_create(&server, NULL, serve_once, &listener);
+    assert(rc == 0);
+    (void)rc;
+
+    ember_vm* vm = ember_new_vm();
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/", port);
+    ember_value args[2];
+    args[0] = ember_make_string_gc(vm, url);
+    args[1].type = EMBER_VAL_NATIVE;
+    args[1].as.native_val = on_chunk;
+    chunk_calls = 0;
+    chunk_bytes = 0;
+    ember_value promise = ember_native_http_stream(vm, 2, args);
+    assert(promise.type == EMBER_VAL_PROMISE);
+    assert(ember_loop_run(vm) == 0);
+
+    assert(AS_PROMISE(promise)->state == PROMISE_RESOLVED);
+    assert(AS_PROMISE(promise)->value.as.number_val == STREAM_BODY_SIZE);
+    // Delivered piece by piece, not as one buffer
+    assert(chunk_bytes == STREAM_BODY_SIZE && chunk_calls > 1);
+    assert(vm->pending_promises->length == 0);
+
+    pthread_join(server, NULL);
+    close(listener);
+    free(response);
+    ember_free_vm(vm);
+    printf("  ✓ Streamed bodies arrive in chunks\n");
+}
+
+static int json_values = 0;
+
+static ember_value on_json_value(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    assert(argc == 1 && argv[0].type == EMBER_VAL_HASH_MAP);
+    json_values++;
+    return ember_make_nil();
+}
+
+// An NDJSON body of `rows` records
+static char* ndjson_response(int rows, size_t* length) {
+    size_t capacity = (size_t)rows * 64 + 256;
+    char* body = malloc(capacity);
+    assert(body);
+    size_t body_length = 0;
+    for (int i = 0; i < rows; i++) {
+        body_length += (size_t)snprintf(body + body_length, capacity - body_length,
+                                        "{\"id\": %d, \"line\": \"record %d\"}\n", i, i);
+    }
+    char* response = malloc(capacity + 128);
+    assert(response);
+    *length = (size_t)snprintf(response, capacity + 128,
+        "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n%s", body_length, body);
+    free(body);
+    return response;
+}
+
+void test_stream_json(void) {
+    int port;
+    int listener = listen_local(&port);
+    char* response = ndjson_response(5000, &g_response_length);
+    g_response = response;
+    pthread_t server;
+    int rc = pthread_create(&server, NULL, serve_once, &listener);
+    assert(rc == 0);
+
+    ember_vm* vm = ember_new_vm();
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/", port);
+    ember_value args[2];
+    args[0] = ember_make_string_gc(vm, url);
+    args[1].type = EMBER_VAL_NATIVE;
+    args[1].as.native_val = on_json_value;
+    json_values = 0;
+    ember_value promise = ember_native_http_stream_json(vm, 2, args);
+    assert(promise.type == EMBER_VAL_PROMISE);
+    assert(ember_loop_run(vm) == 0);
+    assert(AS_PROMISE(promise)->state == PROMISE_RESOLVED);
+    assert(AS_PROMISE(promise)->value.as.number_val == 5000 && json_values == 5000);
+    pthread_join(server, NULL);
+    free(response);
+
+    // A body cut off mid-value rejects
+    const char* truncated = "HTTP/1.1 200 OK\r\nContent-Length: 14\r\nConnection: close\r\n\r\n{\"id\": 1}\n{\"id";
+    g_response = truncated;
+    g_response_length = strlen(truncated);
+    rc = pthread_create(&server, NULL, serve_once, &listener);
+    assert(rc == 0);
+    (void)rc;
+    promise = ember_native_http_stream_json(vm, 2, args);
+    assert(ember_loop_run(vm) == 0);
+    assert(AS_PROMISE(promise)->state == PROMISE_REJECTED);
+    assert(vm->pending_promises->length == 0);
+    pthread_join(server, NULL);
+
+    close(listener);
+    ember_free_vm(vm);
+    printf("  ✓ JSON bodies are read value by value\n");
+}
+
+void test_download(void) {
+    char directory[] = "/tmp/ember_download_XXXXXX";
+    assert(mkdtemp(directory));
+    char host_path[128];
+    snprintf(host_path, sizeof(host_path), "%s/artifact.bin", directory);
+
+    int port;
+    int listener = listen_local(&port);
+    char* response = large_response(&g_response_length);
+    g_response = response;
+    pthread_t server;
+    int rc = pthread_create(&server, NULL, serve_once, &listener);
+    assert(rc == 0);
+
+    ember_vm* vm = ember_new_vm();
+    assert(ember_vfs_mount(vm, "/downloads", directory, EMBER_MOUNT_RW) == 0);
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/", port);
+    ember_value args[2] = { ember_make_string_gc(vm, url), ember_make_string_gc(vm, "/downloads/artifact.bin") };
+    ember_value promise = ember_native_http_download_async(vm, 2, args);
+    assert(promise.type == EMBER_VAL_PROMISE);
+    assert(ember_loop_run(vm) == 0);
+    assert(AS_PROMISE(promise)->state == PROMISE_RESOLVED);
+    assert(AS_PROMISE(promise)->value.as.number_val == STREAM_BODY_SIZE);
+    pthread_join(server, NULL);
+    free(response);
+
+    FILE* file = fopen(host_path, "rb");
+    assert(file);
+    fseek(file, 0, SEEK_END);
+    assert(ftell(file) == STREAM_BODY_SIZE);
+    fclose(file);
+    remove(host_path);
+
+    // Error statuses reject and leave no file behind
+    const char* not_found = "HTTP/1.1 404 Not Found\r\nContent-Length: 4\r\nConnection: close\r\n\r\nnope";
+    g_response = not_found;
+    g_response_length = strlen(not_found);
+    rc = pthread_create(&server, NULL, serve_once, &listener);
+    assert(rc == 0);
+    (void)rc;
+    promise = ember_native_http_download_async(vm, 2, args);
+    assert(ember_loop_run(vm) == 0);
+    assert(AS_PROMISE(promise)->state == PROMISE_REJECTED);
+    assert(access(host_path, F_OK) != 0);
+    pthread_join(server, NULL);
+
+    // Paths outside the VFS are refused
+    args[1] = ember_make_string_gc(vm, "/elsewhere/artifact.bin");
+    assert(ember_native_http_download_async(vm, 2, args).type == EMBER_VAL_NIL);
+
+    close(listener);
+    ember_free_vm(vm);
+    rmdir(directory);
+    printf("  ✓ Downloads go straight to a VFS file\n");
+}
+
+void test_fetch_failure(void) {
+    // Nothing listens on the port once the socket is closed
+    int port;
+    close(listen_local(&port));
+
+    ember_vm* vm = ember_new_vm();
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/", port);
+    ember_value arg = ember_make_string_gc(vm, url);
+    ember_value promise = ember_native_http_fetch(vm, 1, &arg);
+    assert(promise.type == EMBER_VAL_PROMISE);
+    assert(ember_loop_run(vm) == 0);
+    assert(AS_PROMISE(promise)->state == PROMISE_REJECTED);
+
+    ember_value bad[2] = { arg, ember_make_string_gc(vm, "BREW") };
+    assert(ember_native_http_fetch(vm, 2, bad).type == EMBER_VAL_NIL);
+    ember_free_vm(vm);
+    printf("  ✓ Failed transfers reject their promise\n");
+}
+
+#endif
+
+int main(void) {
+    printf("Testing http.fetch...\n");
+#ifdef HAVE_CURL
+    test_concurrent_fetches();
+    test_connection_reuse();
+    test_stream();
+    test_stream_json();
+    test_download();
+    test_fetch_failure();
+#else
+    printf("  - libcurl not available, skipped\n");
+#endif
+    printf("✓ http.fetch tests passed\n");
+    return 0;
+}
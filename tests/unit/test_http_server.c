@@ -0,0 +1,758 @@
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/compress.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define CLIENT_THREADS 8
+#define CLIENT_REQUESTS 50
+
+static const char* prelude =
+    "fn handle(method, path) {\n"
+    "    if (path == \"/hello\") { return \"hello \" + method }\n"
+    "    if (path == \"/query\") { return request_get_query(\"name\") + \"|\" + request_get_query() }\n"
+    "    if (path == \"/header\") {\n"
+    "        response_set_header(\"X-Echo\", request_get_header(\"x-input\"))\n"
+    "        response_set_header(\"Content-Type\", \"text/html\")\n"
+    "        return \"ok\"\n"
+    "    }\n"
+    "    if (path == \"/body\") {\n"
+    "        response_set_status(201)\n"
+    "        response_write(\"got \", request_get_body())\n"
+    "        response_end()\n"
+    "        return \"ignored\"\n"
+    "    }\n"
+    "    if (path == \"/echo\") {\n"
+    "        body = request_get_body()\n"
+    "        response_write(\"<\", body, \">\", request_get_body())\n"
+    "        return nil\n"
+    "    }\n"
+    "    if (path == \"/png\") {\n"
+    "        response_set_header(\"Content-Type\", \"image/png\")\n"
+    "        return request_get_body()\n"
+    "    }\n"
+    "    if (path == \"/file\") {\n"
+    "        if (response_send_file(request_get_query(\"path\")) == nil) {\n"
+    "            response_set_status(404)\n"
+    "            return \"no file\"\n"
+    "        }\n"
+    "        return nil\n"
+    "    }\n"
+    "    if (path == \"/fail\") { return missing_function() }\n"
+    "    if (path == \"/ws\") {\n"
+    "        if (websocket_upgrade(\"on_message\") == nil) {\n"
+    "            response_set_status(400)\n"
+    "            return \"not a handshake\"\n"
+    "        }\n"
+    "        return nil\n"
+    "    }\n"
+    "    if (path == \"/stop\") {\n"
+    "        http_stop_server()\n"
+    "        return \"bye\"\n"
+    "    }\n"
+    "    response_set_status(404)\n"
+    "    return \"no \" + path\n"
+    "}\n"
+    "fn on_message(id, message) {\n"
+    "    if (message == nil) { return nil }\n"
+    "    if (message == \"all\") { return websocket_broadcast(\"to everyone\") }\n"
+    "    if (message == \"bye\") { return websocket_close(id) }\n"
+    "    return websocket_send(id, \"echo \" + message)\n"
+    "}\n";
+
+static int connect_to(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(fd >= 0);
+    struct sockaddr_in address = {0};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t)port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int rc = connect(fd, (struct sockaddr*)&address, sizeof(address));
+    assert(rc == 0);
+    (void)rc;
+    return fd;
+}
+
+static void send_all(int fd, const char* data) {
+    size_t length = strlen(data);
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        assert(sent > 0);
+        data += sent;
+        length -= (size_t)sent;
+    }
+}
+
+// Complete responses at the start of text (each needs a Content-Length)
+static int count_responses(const char* text, size_t length) {
+    int count = 0;
+    const char* at = text;
+    const char* end = text + length;
+    for (;;) {
+        const char* head_end = memmem(at, (size_t)(end - at), "\r\n\r\n", 4);
+        if (!head_end) return count;
+        if (strncmp(at, "HTTP/1.1 100 ", 13) == 0) {
+            at = head_end + 4;
+            continue;
+        }
+        const char* length_header = strcasestr(at, "Content-Length: ");
+        assert(length_header && length_header < head_end);
+        size_t body = strtoul(length_header + 16, NULL, 10);
+        if ((size_t)(end - head_end - 4) < body) return count;
+        at = head_end + 4 + body;
+        count++;
+    }
+}
+
+// Reads until responses have arrived or the server closes; *closed tells which
+static char* receive(int fd, int responses, int* closed) {
+    size_t capacity = 4096, length = 0;
+    char* text = malloc(capacity);
+    *closed = 0;
+    while (count_responses(text, length) < responses) {
+        if (capacity - length < 1024) text = realloc(text, capacity *= 2);
+        ssize_t received = recv(fd, text + length, capacity - length - 1, 0);
+        if (received <= 0) {
+            *closed = 1;
+            break;
+        }
+        length += (size_t)received;
+        text[length] = '\0';
+    }
+    text[length] = '\0';
+    if (!*closed && responses > 0) {
+        // Nothing should follow
+        struct timeval wait = {0, 20000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &wait, sizeof(wait));
+        char extra;
+        ssize_t more = recv(fd, &extra, 1, 0);
+        assert(more <= 0);
+        if (more == 0) *closed = 1;
+        wait.tv_usec = 0;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &wait, sizeof(wait));
+    }
+    return text;
+}
+
+// One request on a new connection
+static char* request(int port, const char* raw, int* closed) {
+    int fd = connect_to(port);
+    send_all(fd, raw);
+    char* text = receive(fd, 1, closed);
+    close(fd);
+    return text;
+}
+
+static const char* body_of(const char* response) {
+    const char* end = strstr(response, "\r\n\r\n");
+    assert(end);
+    return end + 4;
+}
+
+void test_requests(ember_http_server* server) {
+    int port = ember_http_server_port(server);
+    int closed;
+    char* text = request(port, "GET /hello HTTP/1.1\r\nHost: x\r\n\r\n", &closed);
+    assert(strncmp(text, "HTTP/1.1 200 OK\r\n", 17) == 0);
+    assert(strstr(text, "\r\nContent-Length: 9\r\n") && strstr(text, "\r\nDate: "));
+    assert(strstr(text, "\r\nContent-Type: text/plain; charset=utf-8\r\n"));
+    assert(strcmp(body_of(text), "hello GET") == 0);
+    free(text);
+
+    text = request(port, "GET /query?a=1&name=J%C3%BCrg+en&b HTTP/1.1\r\n\r\n", &closed);
+    assert(strcmp(body_of(text), "J\xc3\xbcrg en|a=1&name=J%C3%BCrg+en&b") == 0);
+    free(text);
+
+    text = request(port, "GET /header HTTP/1.1\r\nX-INPUT:  echoed value \r\n\r\n", &closed);
+    assert(strstr(text, "\r\nX-Echo: echoed value\r\n") && strstr(text, "\r\nContent-Type: text/html\r\n"));
+    assert(!strstr(text, "text/plain"));
+    free(text);
+
+    text = request(port, "POST /body HTTP/1.1\r\nContent-Length: 11\r\n\r\nhello world", &closed);
+    assert(strncmp(text, "HTTP/1.1 201 Created\r\n", 22) == 0);
+    assert(strcmp(body_of(text), "got hello world") == 0);
+    free(text);
+
+    text = request(port, "GET /elsewhere HTTP/1.1\r\n\r\n", &closed);
+    assert(strncmp(text, "HTTP/1.1 404 Not Found\r\n", 24) == 0 && strcmp(body_of(text), "no /elsewhere") == 0);
+    free(text);
+
+    // HEAD gets the head with the GET's length and no body
+    text = request(port, "HEAD /hello HTTP/1.1\r\nConnection: close\r\n\r\n", &closed);
+    assert(closed && strstr(text, "\r\nContent-Length: 10\r\n") && strcmp(body_of(text), "") == 0);
+    free(text);
+
+    // A handler that fails gets a 500 and its connection closed
+    text = request(port, "GET /fail HTTP/1.1\r\n\r\n", &closed);
+    assert(strncmp(text, "HTTP/1.1 500 ", 13) == 0 && strstr(text, "Connection: close") && closed);
+    free(text);
+    printf("  ✓ Requests reach the handler and its response comes back\n");
+}
+
+void test_keep_alive_and_pipelining(ember_http_server* server) {
+    int port = ember_http_server_port(server);
+    int closed;
+    int fd = connect_to(port);
+    // Three requests in one write are answered in order on the same connection
+    send_all(fd, "GET /hello HTTP/1.1\r\n\r\n"
+                 "POST /body HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc"
+                 "\r\nDELETE /hello HTTP/1.1\r\n\r\n");
+    char* text = receive(fd, 3, &closed);
+    assert(!closed);
+    const char* first = strstr(text, "hello GET");
+    const char* second = strstr(text, "got abc");
+    const char* third = strstr(text, "hello DELETE");
+    assert(first && second && third && first < second && second < third);
+    free(text);
+
+    // A request arriving a byte at a time
+    const char* slow = "POST /body HTTP/1.1\r\nContent-Length: 4\r\n\r\nslow";
+    for (const char* at = slow; *at; at++) {
+        assert(send(fd, at, 1, MSG_NOSIGNAL) == 1);
+    }
+    text = receive(fd, 1, &closed);
+    assert(!closed && strcmp(body_of(text), "got slow") == 0);
+    free(text);
+
+    // Connection: close is honoured after the response
+    send_all(fd, "GET /hello HTTP/1.1\r\nConnection: close\r\n\r\nGET /hello HTTP/1.1\r\n\r\n");
+    text = receive(fd, 1, &closed);
+    assert(strstr(text, "\r\nConnection: close\r\n") && count_responses(text, strlen(text)) == 1);
+    free(text);
+    text = receive(fd, 1, &closed);
+    assert(closed && text[0] == '\0');
+    free(text);
+    close(fd);
+
+    // HTTP/1.0 closes unless asked to keep alive
+    text = request(port, "GET /hello HTTP/1.0\r\n\r\n", &closed);
+    assert(closed && strstr(text, "Connection: close"));
+    free(text);
+    fd = connect_to(port);
+    send_all(fd, "GET /hello HTTP/1.0\r\nConnection: keep-alive\r\n\r\n");
+    text = receive(fd, 1, &closed);
+    assert(!closed && !strstr(text, "Connection: close"));
+    free(text);
+    close(fd);
+
+    // Expect: 100-continue is told to go on before the body is sent
+    fd = connect_to(port);
+    send_all(fd, "POST /body HTTP/1.1\r\nContent-Length: 2\r\nExpect: 100-continue\r\n\r\n");
+    char interim[64] = {0};
+    assert(recv(fd, interim, sizeof(interim) - 1, 0) > 0);
+    assert(strcmp(interim, "HTTP/1.1 100 Continue\r\n\r\n") == 0);
+    send_all(fd, "ok");
+    text = receive(fd, 1, &closed);
+    assert(strcmp(body_of(text), "got ok") == 0);
+    free(text);
+    close(fd);
+    printf("  ✓ Keep-alive, pipelining and split requests\n");
+}
+
+void test_bad_requests(ember_http_server* server) {
+    int port = ember_http_server_port(server);
+    const char* bad[] = {"NOT A REQUEST\r\n\r\n", "GET /x HTTP/2.0\r\n\r\n", "GET /x HTTP/1.1\r\nNo colon\r\n\r\n",
+                         "GET /x HTTP/1.1\r\nContent-Length: 1x\r\n\r\n",
+                         "GET /x HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\n"};
+    int closed;
+    for (int i = 0; i < (int)(sizeof(bad) / sizeof(bad[0])); i++) {
+        char* text = request(port, bad[i], &closed);
+        assert(strncmp(text, "HTTP/1.1 400 ", 13) == 0 && closed);
+        free(text);
+    }
+    char* text = request(port, "POST /body HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n", &closed);
+    assert(strncmp(text, "HTTP/1.1 501 ", 13) == 0 && closed);
+    free(text);
+    text = request(port, "POST /body HTTP/1.1\r\nContent-Length: 999999999\r\n\r\n", &closed);
+    assert(strncmp(text, "HTTP/1.1 413 ", 13) == 0 && closed);
+    free(text);
+
+    size_t big = 20000;
+    char* huge = malloc(big + 64);
+    strcpy(huge, "GET /hello HTTP/1.1\r\nX-Big: ");
+    memset(huge + strlen(huge), 'a', big);
+    strcpy(huge + strlen("GET /hello HTTP/1.1\r\nX-Big: ") + big, "\r\n\r\n");
+    text = request(port, huge, &closed);
+    assert(strncmp(text, "HTTP/1.1 431 ", 13) == 0 && closed);
+    free(text);
+    free(huge);
+
+    // The server still answers afterwards
+    text = request(port, "GET /hello HTTP/1.1\r\n\r\n", &closed);
+    assert(strcmp(body_of(text), "hello GET") == 0);
+    free(text);
+    printf("  ✓ Malformed and oversized requests are refused\n");
+}
+
+void test_large_bodies(ember_http_server* server) {
+    int port = ember_http_server_port(server);
+    size_t size = 3 * 1024 * 1024 + 17;
+    char* payload = malloc(size + 1);
+    for (size_t i = 0; i < size; i++) {
+        payload[i] = (char)('a' + (i * 7 + i / 4096) % 26);
+    }
+    payload[size] = '\0';
+
+    // A large upload echoed back twice, with a request pipelined behind it
+    int fd = connect_to(port);
+    char head[128];
+    snprintf(head, sizeof(head), "POST /echo HTTP/1.1\r\nContent-Length: %zu\r\n\r\n", size);
+    send_all(fd, head);
+    send_all(fd, payload);
+    send_all(fd, "GET /hello HTTP/1.1\r\n\r\n");
+    int closed;
+    char* text = receive(fd, 2, &closed);
+    assert(!closed);
+    char length[64];
+    snprintf(length, sizeof(length), "\r\nContent-Length: %zu\r\n", 2 * size + 2);
+    assert(strstr(text, length));
+    const char* body = body_of(text);
+    assert(body[0] == '<' && memcmp(body + 1, payload, size) == 0);
+    assert(body[size + 1] == '>' && memcmp(body + size + 2, payload, size) == 0);
+    assert(strcmp(body_of(body + 2 * size + 2), "hello GET") == 0);
+    free(text);
+
+    // Bodies just either side of the size read into their own buffer
+    size_t sizes[] = {16 * 1024 - 1, 16 * 1024, 16 * 1024 + 1};
+    for (int i = 0; i < 3; i++) {
+        snprintf(head, sizeof(head), "POST /echo HTTP/1.1\r\nContent-Length: %zu\r\n\r\n", sizes[i]);
+        send_all(fd, head);
+        char saved = payload[sizes[i]];
+        payload[sizes[i]] = '\0';
+        send_all(fd, payload);
+        payload[sizes[i]] = saved;
+        text = receive(fd, 1, &closed);
+        body = body_of(text);
+        assert(!closed && memcmp(body + 1, payload, sizes[i]) == 0 && memcmp(body + sizes[i] + 2, payload, sizes[i]) == 0);
+        free(text);
+    }
+    close(fd);
+    free(payload);
+    printf("  ✓ Large bodies in and out without copies\n");
+}
+
+// The value of a response header, in a static buffer; NULL if absent
+static const char* header_of(const char* response, const char* name) {
+    static char value[256];
+    const char* end = strstr(response, "\r\n\r\n");
+    char key[64];
+    snprintf(key, sizeof(key), "\r\n%s: ", name);
+    const char* at = strcasestr(response, key);
+    if (!at || at > end) return NULL;
+    at += strlen(key);
+    size_t length = strcspn(at, "\r");
+    snprintf(value, sizeof(value), "%.*s", (int)length, at);
+    return value;
+}
+
+static size_t length_of(const char* response) {
+    return strtoul(header_of(response, "Content-Length"), NULL, 10);
+}
+
+// The body of response decoded as its Content-Encoding says, which must be
+// coding
+static char* decoded_body(const char* response, compress_encoding coding, size_t* length) {
+    const char* encoding = header_of(response, "Content-Encoding");
+    compress_output out = {0};
+    if (coding == COMPRESS_NONE) {
+        assert(encoding == NULL);
+        *length = length_of(response);
+        out.data = malloc(*length + 1);
+        memcpy(out.data, body_of(response), *length);
+    } else {
+        assert(encoding && strcmp(encoding, compress_encoding_name(coding)) == 0);
+        assert(compress_decompress(coding, body_of(response), length_of(response), 64 << 20, &out));
+        *length = out.length;
+    }
+    return out.data;
+}
+
+static char* post(int port, const char* path, const char* accept, const char* body, size_t size) {
+    int fd = connect_to(port);
+    char head[256];
+    snprintf(head, sizeof(head), "POST %s HTTP/1.1\r\nContent-Length: %zu\r\n%s%s%s\r\n", path, size,
+             accept ? "Accept-Encoding: " : "", accept ? accept : "", accept ? "\r\n" : "");
+    send_all(fd, head);
+    char* sent = strndup(body, size);
+    send_all(fd, sent);
+    free(sent);
+    int closed;
+    char* text = receive(fd, 1, &closed);
+    close(fd);
+    return text;
+}
+
+static void write_file(const char* path, const char* data, size_t length) {
+    FILE* file = fopen(path, "wb");
+    assert(file && fwrite(data, 1, length, file) == length);
+    fclose(file);
+}
+
+void test_compression(ember_http_server* server) {
+    int port = ember_http_server_port(server);
+    compress_encoding codings[] = {COMPRESS_GZIP, COMPRESS_BROTLI, COMPRESS_ZSTD};
+    size_t size = 40000;
+    char* text = malloc(size + 1);
+    for (size_t i = 0; i < size; i++) {
+        text[i] = "the quick brown fox jumps over the lazy dog\n"[i % 44];
+    }
+    text[size] = '\0';
+
+    // A text body, short and long (written as parts), in each coding the
+    // client takes, with Vary either way
+    size_t sizes[] = {3000, size};
+    for (int s = 0; s < 2; s++) {
+        char saved = text[sizes[s]];
+        text[sizes[s]] = '\0';
+        for (int c = 0; c < 3; c++) {
+            const char* name = compress_encoding_name(codings[c]);
+            char* response = post(port, "/echo", name, text, sizes[s]);
+            assert(strncmp(response, "HTTP/1.1 200 OK\r\n", 17) == 0);
+            assert(strcmp(header_of(response, "Vary"), "Accept-Encoding") == 0);
+            compress_encoding coding = compress_available(codings[c]) ? codings[c] : COMPRESS_NONE;
+            size_t length;
+            char* body = decoded_body(response, coding, &length);
+            assert(length == 2 * sizes[s] + 2 && body[0] == '<' && memcmp(body + 1, text, sizes[s]) == 0);
+            if (coding != COMPRESS_NONE) assert(length_of(response) < sizes[s] / 4);
+            free(body);
+            free(response);
+        }
+        text[sizes[s]] = saved;
+    }
+    char* response = post(port, "/echo", "gzip, br, zstd", text, size);
+    compress_encoding best = compress_accept("gzip, br, zstd", 14);
+    size_t length;
+    free(decoded_body(response, best, &length));
+    assert(length == 2 * size + 2);
+    free(response);
+
+    // Nothing asked for, too short to bother, already compressed types, and
+    // an encoding the client refuses
+    response = post(port, "/echo", NULL, text, size);
+    assert(!header_of(response, "Content-Encoding") && header_of(response, "Vary"));
+    assert(length_of(response) == 2 * size + 2);
+    free(response);
+    response = post(port, "/echo", "gzip, br, zstd", text, 100);
+    assert(!header_of(response, "Content-Encoding") && !header_of(response, "Vary"));
+    free(response);
+    response = post(port, "/png", "gzip, br, zstd", text, size);
+    assert(!header_of(response, "Content-Encoding") && !header_of(response, "Vary") && length_of(response) == size);
+    free(response);
+    response = post(port, "/echo", "gzip;q=0, br;q=0, zstd;q=0", text, size);
+    assert(!header_of(response, "Content-Encoding") && length_of(response) == 2 * size + 2);
+    free(response);
+
+    // A static file: each coding made once and sent from the cache, HEAD
+    // with the same length, and the file read again once it changes
+    char path[] = "/tmp/ember-static-XXXXXX.css";
+    int fd = mkstemps(path, 4);
+    assert(fd >= 0);
+    close(fd);
+    write_file(path, text, size);
+    char raw[512];
+    int closed;
+    for (int c = 0; c < 3; c++) {
+        const char* name = compress_encoding_name(codings[c]);
+        compress_encoding coding = compress_available(codings[c]) ? codings[c] : COMPRESS_NONE;
+        char* first = NULL;
+        for (int round = 0; round < 3; round++) {
+            snprintf(raw, sizeof(raw), "GET /file?path=%s HTTP/1.1\r\nAccept-Encoding: %s\r\n\r\n", path, name);
+            response = request(port, raw, &closed);
+            assert(strcmp(header_of(response, "Content-Type"), "text/css; charset=utf-8") == 0);
+            assert(strcmp(header_of(response, "Vary"), "Accept-Encoding") == 0);
+            char* body = decoded_body(response, coding, &length);
+            assert(length == size && memcmp(body, text, size) == 0);
+            free(body);
+            if (first) {
+                assert(length_of(first) == length_of(response));
+                assert(memcmp(body_of(first), body_of(response), length_of(response)) == 0);
+                free(response);
+            } else {
+                first = response;
+            }
+        }
+        snprintf(raw, sizeof(raw), "HEAD /file?path=%s HTTP/1.1\r\nAccept-Encoding: %s\r\nConnection: close\r\n\r\n", path, name);
+        response = request(port, raw, &closed);
+        assert(length_of(response) == length_of(first) && strcmp(body_of(response), "") == 0);
+        free(response);
+        free(first);
+    }
+    write_file(path, text + 1, size - 1);
+    snprintf(raw, sizeof(raw), "GET /file?path=%s HTTP/1.1\r\n\r\n", path);
+    response = request(port, raw, &closed);
+    assert(!header_of(response, "Content-Encoding") && length_of(response) == size - 1);
+    assert(memcmp(body_of(response), text + 1, size - 1) == 0);
+    free(response);
+    unlink(path);
+
+    // Missing files, directories and paths that climb are refused
+    const char* refused[] = {"/tmp/ember-no-such-file.css", "/tmp", "/tmp/../etc/hostname"};
+    for (int i = 0; i < 3; i++) {
+        snprintf(raw, sizeof(raw), "GET /file?path=%s HTTP/1.1\r\n\r\n", refused[i]);
+        response = request(port, raw, &closed);
+        assert(strncmp(response, "HTTP/1.1 404 ", 13) == 0 && strcmp(body_of(response), "no file") == 0);
+        free(response);
+    }
+    free(text);
+    printf("  ✓ Text responses and static files are compressed as Accept-Encoding allows\n");
+}
+
+typedef struct {
+    int fd;
+    const char* data;
+} sender;
+
+static void* send_thread(void* arg) {
+    sender* job = arg;
+    send_all(job->fd, job->data);
+    return NULL;
+}
+
+void test_slow_reader(ember_http_server* server) {
+    // A client that reads slowly backs responses up on the server, which
+    // holds the pipelined requests behind them until they drain
+    int fd = connect_to(ember_http_server_port(server));
+    int small = 64 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+
+    enum { REQUESTS = 3, SIZE = 3 * 1024 * 1024 };
+    char head[128];
+    int head_length = snprintf(head, sizeof(head), "POST /echo HTTP/1.1\r\nContent-Length: %d\r\n\r\n", SIZE);
+    size_t one = (size_t)head_length + SIZE;
+    char* pipelined = malloc(one * REQUESTS + 1);
+    for (int i = 0; i < REQUESTS; i++) {
+        char* at = pipelined + one * (size_t)i;
+        memcpy(at, head, (size_t)head_length);
+        memset(at + head_length, 'a' + i, SIZE);
+    }
+    pipelined[one * REQUESTS] = '\0';
+    sender job = {fd, pipelined};
+    pthread_t thread;
+    int rc = pthread_create(&thread, NULL, send_thread, &job);
+    assert(rc == 0);
+    (void)rc;
+    usleep(200 * 1000);
+
+    int closed;
+    char* text = receive(fd, REQUESTS, &closed);
+    pthread_join(thread, NULL);
+    assert(!closed);
+    const char* at = text;
+    for (int i = 0; i < REQUESTS; i++) {
+        const char* body = body_of(at);
+        assert(body[0] == '<' && body[1] == 'a' + i && body[SIZE] == 'a' + i && body[SIZE + 1] == '>');
+        assert(body[SIZE + 2] == 'a' + i && body[2 * SIZE + 1] == 'a' + i);
+        at = body + 2 * SIZE + 2;
+    }
+    assert(*at == '\0');
+    free(text);
+    free(pipelined);
+    close(fd);
+    printf("  ✓ Pipelined requests wait for a slow reader\n");
+}
+
+// A WebSocket on a new connection, past the handshake
+static int ws_connect(int port) {
+    int fd = connect_to(port);
+    send_all(fd, "GET /ws HTTP/1.1\r\nHost: x\r\nUpgrade: websocket\r\nConnection: keep-alive, Upgrade\r\n"
+                 "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n");
+    char head[512];
+    size_t length = 0;
+    // Byte by byte, so no frame after the head is read with it
+    while (length < 4 || memcmp(head + length - 4, "\r\n\r\n", 4) != 0) {
+        assert(length < sizeof(head) - 1 && recv(fd, head + length, 1, 0) == 1);
+        length++;
+    }
+    head[length] = '\0';
+    assert(strncmp(head, "HTTP/1.1 101 Switching Protocols\r\n", 34) == 0);
+    assert(strstr(head, "\r\nSec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n"));
+    return fd;
+}
+
+// Sends a masked client frame
+static void ws_write(int fd, int final, int opcode, const char* payload) {
+    size_t length = strlen(payload);
+    assert(length < 126);
+    unsigned char frame[256] = {(unsigned char)((final ? 0x80 : 0) | opcode), (unsigned char)(0x80 | length),
+                                1, 2, 3, 4};
+    for (size_t i = 0; i < length; i++) {
+        frame[6 + i] = (unsigned char)payload[i] ^ frame[2 + i % 4];
+    }
+    assert(send(fd, frame, 6 + length, MSG_NOSIGNAL) == (ssize_t)(6 + length));
+}
+
+static void recv_all(int fd, void* into, size_t length) {
+    for (size_t got = 0; got < length;) {
+        ssize_t received = recv(fd, (char*)into + got, length - got, 0);
+        assert(received > 0);
+        got += (size_t)received;
+    }
+}
+
+// Reads one server frame: its opcode, and its payload into text
+static int ws_next(int fd, char* text, size_t capacity) {
+    unsigned char head[2];
+    recv_all(fd, head, 2);
+    assert((head[0] & 0x80) && !(head[1] & 0x80));
+    size_t length = head[1] & 0x7F;
+    if (length == 126) {
+        unsigned char extended[2];
+        recv_all(fd, extended, 2);
+        length = (size_t)extended[0] << 8 | extended[1];
+    }
+    assert(length < capacity);
+    recv_all(fd, text, length);
+    text[length] = '\0';
+    return head[0] & 0x0F;
+}
+
+void test_websockets(ember_http_server* server) {
+    int port = ember_http_server_port(server);
+    char text[256];
+
+    // Messages reach on_message, whole or in fragments; pings are answered
+    int fd = ws_connect(port);
+    ws_write(fd, 1, 0x1, "hi");
+    assert(ws_next(fd, text, sizeof(text)) == 0x1 && strcmp(text, "echo hi") == 0);
+    ws_write(fd, 0, 0x1, "frag");
+    ws_write(fd, 1, 0x9, "ping");
+    ws_write(fd, 1, 0x0, "mented");
+    assert(ws_next(fd, text, sizeof(text)) == 0xA && strcmp(text, "ping") == 0);
+    assert(ws_next(fd, text, sizeof(text)) == 0x1 && strcmp(text, "echo fragmented") == 0);
+
+    // A broadcast reaches every socket, whichever worker holds it
+    enum { SOCKETS = 16 };
+    int others[SOCKETS];
+    for (int i = 0; i < SOCKETS; i++) {
+        others[i] = ws_connect(port);
+    }
+    ws_write(fd, 1, 0x1, "all");
+    assert(ws_next(fd, text, sizeof(text)) == 0x1 && strcmp(text, "to everyone") == 0);
+    for (int i = 0; i < SOCKETS; i++) {
+        assert(ws_next(others[i], text, sizeof(text)) == 0x1 && strcmp(text, "to everyone") == 0);
+    }
+
+    // websocket_close ends with a close frame; a protocol error with 1002
+    ws_write(fd, 1, 0x1, "bye");
+    assert(ws_next(fd, text, sizeof(text)) == 0x8 && (unsigned char)text[0] == 1000 >> 8);
+    assert(recv(fd, text, 1, 0) == 0);
+    close(fd);
+    unsigned char unmasked[] = {0x81, 0x01, 'x'};
+    assert(send(others[0], unmasked, sizeof(unmasked), MSG_NOSIGNAL) == 3);
+    assert(ws_next(others[0], text, 3) == 0x8 && ((unsigned char)text[0] << 8 | (unsigned char)text[1]) == 1002);
+    for (int i = 0; i < SOCKETS; i++) {
+        close(others[i]);
+    }
+
+    // Without the handshake headers there is no upgrade
+    int closed;
+    char* response = request(port, "GET /ws HTTP/1.1\r\nUpgrade: websocket\r\n\r\n", &closed);
+    assert(strncmp(response, "HTTP/1.1 400 ", 13) == 0);
+    free(response);
+    printf("  ✓ WebSockets echo, fragment, broadcast and close\n");
+}
+
+static int client_port = 0;
+
+static void* client_thread(void* arg) {
+    (void)arg;
+    int fd = connect_to(client_port);
+    int closed;
+    for (int i = 0; i < CLIENT_REQUESTS; i++) {
+        send_all(fd, "GET /hello HTTP/1.1\r\n\r\n");
+        char* text = receive(fd, 1, &closed);
+        assert(!closed && strcmp(body_of(text), "hello GET") == 0);
+        free(text);
+    }
+    close(fd);
+    return NULL;
+}
+
+void test_concurrent_clients(ember_http_server* server) {
+    client_port = ember_http_server_port(server);
+    pthread_t threads[CLIENT_THREADS];
+    for (int i = 0; i < CLIENT_THREADS; i++) {
+        int rc = pthread_create(&threads[i], NULL, client_thread, NULL);
+        assert(rc == 0);
+        (void)rc;
+    }
+    for (int i = 0; i < CLIENT_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    printf("  ✓ Concurrent keep-alive clients across workers\n");
+}
+
+static void* stop_request(void* arg) {
+    int closed;
+    free(request(*(int*)arg, "GET /stop HTTP/1.1\r\n\r\n", &closed));
+    return NULL;
+}
+
+void test_stop(ember_http_server* server) {
+    int port = ember_http_server_port(server);
+    // An idle keep-alive connection is closed when the server stops
+    int idle = connect_to(port);
+    send_all(idle, "GET /hello HTTP/1.1\r\n\r\n");
+    int closed;
+    free(receive(idle, 1, &closed));
+    assert(!closed);
+
+    pthread_t thread;
+    int rc = pthread_create(&thread, NULL, stop_request, &port);
+    assert(rc == 0);
+    (void)rc;
+    ember_http_server_wait(server);
+    pthread_join(thread, NULL);
+    ember_http_server_stop(server);
+    char byte;
+    assert(recv(idle, &byte, 1, 0) <= 0);
+    close(idle);
+
+    // Outside a handler the natives give nil
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    assert(ember_native_http_stop_server(vm, 0, NULL).type == EMBER_VAL_NIL);
+    assert(ember_native_request_get_path(vm, 0, NULL).type == EMBER_VAL_NIL);
+    ember_value status = ember_make_number(200);
+    assert(ember_native_response_set_status(vm, 1, &status).type == EMBER_VAL_NIL);
+    ember_free_vm(vm);
+
+    // A prelude without the handler can't start
+    assert(ember_http_server_start("127.0.0.1", 0, 2, "fn other() { return 1 }\n", "handle") == NULL);
+    printf("  ✓ http_stop_server ends the wait\n");
+}
+
+static void run_tests(const char* loop) {
+    printf("Running HTTP server tests (%s)...\n", loop);
+    ember_http_server* server = ember_http_server_start("127.0.0.1", 0, 4, prelude, "handle");
+    assert(server != NULL && ember_http_server_port(server) > 0);
+    test_requests(server);
+    test_keep_alive_and_pipelining(server);
+    test_bad_requests(server);
+    test_large_bodies(server);
+    test_slow_reader(server);
+    test_compression(server);
+    test_websockets(server);
+    test_concurrent_clients(server);
+    test_stop(server);
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    run_tests("io_uring where the kernel has it");
+    // And again on the epoll loop
+    setenv("EMBER_IO_URING", "0", 1);
+    run_tests("epoll");
+    printf("All HTTP server tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,214 @@
+#define _GNU_SOURCE
+#include "../../src/core/io_ring.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+
+// Reaps one completion, returning its result and user_data
+static int reap(io_ring* ring, uint64_t* user_data) {
+    struct io_uring_cqe* cqe;
+    while (!(cqe = io_ring_peek(ring))) {
+        int result = io_ring_submit(ring, 1, -1);
+        assert(result == 0 || result == -EINTR);
+    }
+    int res = cqe->res;
+    *user_data = cqe->user_data;
+    io_ring_seen(ring);
+    return res;
+}
+
+void test_batch(io_ring* ring) {
+    int fds[2];
+    int rc = pipe(fds);
+    assert(rc == 0);
+    (void)rc;
+    ssize_t written = write(fds[1], "hello", 5);
+    assert(written == 5);
+    (void)written;
+
+    // A nop and a read go to the kernel together
+    char buffer[16] = {0};
+    struct io_uring_sqe* sqe = io_ring_sqe(ring);
+    assert(sqe);
+    sqe->opcode = IORING_OP_NOP;
+    sqe->user_data = 1;
+    sqe = io_ring_sqe(ring);
+    assert(sqe);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fds[0];
+    sqe->addr = (uint64_t)(uintptr_t)buffer;
+    sqe->len = sizeof(buffer);
+    sqe->user_data = 2;
+    rc = io_ring_submit(ring, 0, 0);
+    assert(rc == 0);
+
+    int seen = 0;
+    for (int i = 0; i < 2; i++) {
+        uint64_t tag;
+        int res = reap(ring, &tag);
+        if (tag == 1) {
+            assert(res == 0);
+        } else {
+            assert(tag == 2);
+            assert(res == 5);
+            assert(memcmp(buffer, "hello", 5) == 0);
+        }
+        seen |= (int)tag;
+    }
+    assert(seen == 3);
+    assert(io_ring_peek(ring) == NULL);
+
+    // More entries than the queue holds are submitted as it fills
+    for (unsigned i = 0; i < ring->sq_entries * 2; i++) {
+        sqe = io_ring_sqe(ring);
+        assert(sqe);
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = 10;
+        // Keep the completion queue from overflowing
+        if (i % ring->sq_entries == ring->sq_entries - 1) {
+            rc = io_ring_submit(ring, 0, 0);
+            assert(rc == 0);
+            uint64_t tag;
+            for (unsigned j = 0; j < ring->sq_entries; j++) {
+                assert(reap(ring, &tag) == 0 && tag == 10);
+            }
+        }
+    }
+    assert(io_ring_peek(ring) == NULL);
+
+    close(fds[0]);
+    close(fds[1]);
+    printf("  ✓ Batches submit together\n");
+}
+
+void test_timeout(io_ring* ring) {
+    int fds[2];
+    int rc = pipe(fds);
+    assert(rc == 0);
+    (void)rc;
+
+    // Nothing is ready: the wait ends with -ETIME and no completion
+    struct io_uring_sqe* sqe = io_ring_sqe(ring);
+    assert(sqe);
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fds[0];
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = 7;
+    int result = io_ring_submit(ring, 1, 20);
+    assert(result == -ETIME || result == 0);
+    assert(io_ring_peek(ring) == NULL);
+
+    // The poll fires once the pipe has data
+    ssize_t written = write(fds[1], "x", 1);
+    assert(written == 1);
+    (void)written;
+    uint64_t tag;
+    int res = reap(ring, &tag);
+    assert(tag == 7);
+    assert(res & POLLIN);
+
+    close(fds[0]);
+    close(fds[1]);
+    printf("  ✓ Waits time out\n");
+}
+
+void test_fixed(io_ring* ring) {
+    int fds[2];
+    int rc = pipe(fds);
+    assert(rc == 0);
+    (void)rc;
+
+    // A write through a fixed-file slot
+    if (io_ring_register_files(ring, 4) == 0) {
+        rc = io_ring_set_file(ring, 2, fds[1]);
+        assert(rc == 0);
+        struct io_uring_sqe* sqe = io_ring_sqe(ring);
+        assert(sqe);
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = 2;
+        sqe->flags = IOSQE_FIXED_FILE;
+        sqe->addr = (uint64_t)(uintptr_t)"fixed";
+        sqe->len = 5;
+        sqe->user_data = 3;
+        uint64_t tag;
+        assert(reap(ring, &tag) == 5 && tag == 3);
+        char buffer[8] = {0};
+        assert(read(fds[0], buffer, sizeof(buffer)) == 5);
+        assert(memcmp(buffer, "fixed", 5) == 0);
+        rc = io_ring_set_file(ring, 2, -1);
+        assert(rc == 0);
+    }
+
+    // A read into a registered buffer
+    char* pinned = calloc(1, 4096);
+    struct iovec iov = {pinned, 4096};
+    if (io_ring_register_buffers(ring, &iov, 1) == 0) {
+        ssize_t written = write(fds[1], "pinned", 6);
+        assert(written == 6);
+        (void)written;
+        struct io_uring_sqe* sqe = io_ring_sqe(ring);
+        assert(sqe);
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->fd = fds[0];
+        sqe->addr = (uint64_t)(uintptr_t)pinned;
+        sqe->len = 4096;
+        sqe->buf_index = 0;
+        sqe->user_data = 4;
+        uint64_t tag;
+        assert(reap(ring, &tag) == 6 && tag == 4);
+        assert(memcmp(pinned, "pinned", 6) == 0);
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+    printf("  ✓ Fixed files and registered buffers\n");
+    // The buffer stays pinned until the ring goes
+    io_ring_free(ring);
+    free(pinned);
+}
+
+void test_disabled(void) {
+    setenv("EMBER_IO_URING", "0", 1);
+    io_ring ring;
+    int rc = io_ring_init(&ring, 8);
+    assert(rc == -1);
+    (void)rc;
+    assert(ring.fd == -1);
+    io_ring_free(&ring);
+    unsetenv("EMBER_IO_URING");
+    printf("  ✓ EMBER_IO_URING=0 turns the ring off\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running io_uring tests...\n");
+    test_disabled();
+    io_ring ring;
+    if (io_ring_init(&ring, 8) != 0) {
+        printf("io_uring unavailable here, skipping\n");
+        return 0;
+    }
+    test_batch(&ring);
+    test_timeout(&ring);
+    test_fixed(&ring);
+    printf("All io_uring tests passed!\n");
+    return 0;
+}
+
+#else
+
+int main(void) {
+    printf("io_uring is Linux only, skipping\n");
+    return 0;
+}
+
+#endif
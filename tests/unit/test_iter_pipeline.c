@@ -0,0 +1,151 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static ember_value call(ember_vm* vm, ember_native_func func, int argc, ember_value* argv) {
+    int base = vm->stack_top;
+    for (int i = 0; i < argc; i++) {
+        vm->stack[vm->stack_top++] = argv[i];
+    }
+    ember_value result = func(vm, argc, &vm->stack[base]);
+    vm->stack_top = base;
+    return result;
+}
+
+static ember_value native_value(ember_native_func func) {
+    ember_value value;
+    value.type = EMBER_VAL_NATIVE;
+    value.as.native_val = func;
+    return value;
+}
+
+// Stages and sources stay rooted on the stack
+static ember_value stage(ember_vm* vm, ember_native_func func, ember_value source, ember_value arg) {
+    ember_value args[2] = {source, arg};
+    ember_value result = call(vm, func, 2, args);
+    assert(result.type == EMBER_VAL_ITERATOR);
+    return keep(vm, result);
+}
+
+// 0, 1, ..., count - 1
+static ember_value numbers(ember_vm* vm, int count) {
+    ember_value array = keep(vm, ember_make_array(vm, count));
+    for (int i = 0; i < count; i++) {
+        array_push_with_vm(vm, AS_ARRAY(array), ember_make_number(i));
+    }
+    return array;
+}
+
+static int square_calls = 0;
+
+static ember_value square(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    assert(argc == 2 && argv[1].type == EMBER_VAL_NUMBER);
+    square_calls++;
+    return ember_make_number(argv[0].as.number_val * argv[0].as.number_val);
+}
+
+static ember_value is_odd(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    (void)argc;
+    return ember_make_bool((int)argv[0].as.number_val % 2 == 1);
+}
+
+static ember_value add(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    assert(argc == 3);
+    return ember_make_number(argv[0].as.number_val + argv[1].as.number_val);
+}
+
+void test_lazy_stages(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value source = numbers(vm, 1000);
+
+    // Building the pipeline reads nothing; take stops the pull early
+    ember_value squares = stage(vm, ember_native_iter_map, source, native_value(square));
+    ember_value odd = stage(vm, ember_native_iter_filter, squares, native_value(is_odd));
+    ember_value first = stage(vm, ember_native_iter_take, odd, ember_make_number(3));
+    assert(square_calls == 0);
+    ember_value result = call(vm, ember_native_iter_collect, 1, &first);
+    assert(result.type == EMBER_VAL_ARRAY && AS_ARRAY(result)->length == 3);
+    assert(AS_ARRAY(result)->elements[0].as.number_val == 1);
+    assert(AS_ARRAY(result)->elements[2].as.number_val == 25);
+    assert(square_calls == 6);
+
+    // The pipeline goes on where it stopped; done pulls ahead without losing a value
+    ember_value more = stage(vm, ember_native_iter_take, odd, ember_make_number(2));
+    assert(!iterator_done(AS_ITERATOR(more)) && !iterator_done(AS_ITERATOR(more)));
+    assert(iterator_next(AS_ITERATOR(more)).value.as.number_val == 49);
+    assert(iterator_next(AS_ITERATOR(more)).value.as.number_val == 81);
+    assert(iterator_done(AS_ITERATOR(more)) && iterator_next(AS_ITERATOR(more)).done);
+
+    // skip, then count and reduce as terminal ops
+    ember_value rest = stage(vm, ember_native_iter_skip, source, ember_make_number(990));
+    assert(call(vm, ember_native_iter_count, 1, &rest).as.number_val == 10);
+    assert(call(vm, ember_native_iter_count, 1, &rest).as.number_val == 0);
+    ember_value reduce[3] = {source, native_value(add), ember_make_number(0.5)};
+    assert(call(vm, ember_native_iter_reduce, 3, reduce).as.number_val == 499500.5);
+    reduce[0] = stage(vm, ember_native_iter_take, source, ember_make_number(4));
+    assert(call(vm, ember_native_iter_reduce, 2, reduce).as.number_val == 6);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("  ✓ map, filter, take and skip pull only what is asked for\n");
+}
+
+void test_zip_and_chunk(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value left = numbers(vm, 5);
+    ember_value map = keep(vm, ember_make_map(vm));
+    map_set(AS_MAP(map), ember_make_string_gc(vm, "a"), ember_make_number(1));
+    map_set(AS_MAP(map), ember_make_string_gc(vm, "b"), ember_make_number(2));
+
+    // Pairs until the shorter source, a map, runs out
+    ember_value zipped = stage(vm, ember_native_iter_zip, left, map);
+    ember_value pairs = keep(vm, call(vm, ember_native_iter_collect, 1, &zipped));
+    assert(pairs.type == EMBER_VAL_ARRAY && AS_ARRAY(pairs)->length == 2);
+    ember_array* second = AS_ARRAY(AS_ARRAY(pairs)->elements[1]);
+    assert(second->elements[0].as.number_val == 1);
+    ember_array* entry = AS_ARRAY(second->elements[1]);
+    assert(strcmp(AS_CSTRING(entry->elements[0]), "b") == 0 && entry->elements[1].as.number_val == 2);
+
+    ember_value chunks = stage(vm, ember_native_iter_chunk, numbers(vm, 7), ember_make_number(3));
+    ember_value all = call(vm, ember_native_iter_collect, 1, &chunks);
+    assert(AS_ARRAY(all)->length == 3);
+    assert(AS_ARRAY(AS_ARRAY(all)->elements[1])->elements[0].as.number_val == 3);
+    assert(AS_ARRAY(AS_ARRAY(all)->elements[2])->length == 1);
+
+    // Bad arguments
+    ember_value bad[2] = {left, ember_make_number(0)};
+    assert(call(vm, ember_native_iter_chunk, 2, bad).type == EMBER_VAL_NIL);
+    bad[1] = ember_make_number(-1);
+    assert(call(vm, ember_native_iter_take, 2, bad).type == EMBER_VAL_NIL);
+    bad[1] = ember_make_number(1);
+    assert(call(vm, ember_native_iter_map, 2, bad).type == EMBER_VAL_NIL);
+    bad[0] = ember_make_number(1);
+    bad[1] = native_value(square);
+    assert(call(vm, ember_native_iter_map, 2, bad).type == EMBER_VAL_NIL);
+    assert(call(vm, ember_native_iter_count, 1, bad).type == EMBER_VAL_NIL);
+    assert(call(vm, ember_native_iter, 1, &left).type == EMBER_VAL_ITERATOR);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("  ✓ zip and chunk\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running iterator pipeline tests...\n");
+    test_lazy_stages();
+    test_zip_and_chunk();
+    printf("All iterator pipeline tests passed!\n");
+    return 0;
+}
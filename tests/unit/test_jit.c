@@ -0,0 +1,211 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// i = 0; sum = 0; while (i < n) { sum = sum + i * k; i += 1 }; then OP_RETURN
+// with sum on the stack. Returns the chunk; *loop gets the loop header offset
+static ember_chunk* build_sum_loop(double n, ember_value k, int* loop) {
+    ember_chunk* chunk = malloc(sizeof(ember_chunk));
+    assert(chunk);
+    init_chunk(chunk);
+    int zero = add_constant(chunk, ember_make_number(0));
+    int limit = add_constant(chunk, ember_make_number(n));
+    int one = add_constant(chunk, ember_make_number(1));
+    int factor = add_constant(chunk, k);
+
+    for (int slot = 0; slot < 2; slot++) {
+        write_chunk_op(chunk, OP_PUSH_CONST, zero);
+        write_chunk_op(chunk, OP_SET_LOCAL, slot);
+        write_chunk(chunk, OP_POP);
+    }
+    *loop = chunk->count;
+    int exit_jump = write_chunk_fused(chunk, OP_LOCAL_LESS_CONST_JUMP_IF_FALSE, 0, limit);
+    int body = chunk->count;
+    write_chunk_op(chunk, OP_GET_LOCAL, 1);
+    write_chunk_op(chunk, OP_GET_LOCAL, 0);
+    write_chunk_op(chunk, OP_PUSH_CONST, factor);
+    write_chunk(chunk, OP_MUL);
+    write_chunk(chunk, OP_ADD);
+    write_chunk_op(chunk, OP_SET_LOCAL, 1);
+    write_chunk(chunk, OP_POP);
+    write_chunk_fused(chunk, OP_ADD_LOCAL_CONST, 0, one);
+    write_chunk_op(chunk, OP_LOOP, chunk->count + 3 - *loop);
+    patch_chunk_jump(chunk, exit_jump, chunk->count - body);
+    write_chunk_op(chunk, OP_GET_LOCAL, 1);
+    write_chunk(chunk, OP_RETURN);
+    return chunk;
+}
+
+static void free_test_chunk(ember_chunk* chunk) {
+    free_chunk(chunk);
+    free(chunk);
+}
+
+void test_native_loop(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(ember_jit_configure(vm, 1, 1) == EMBER_SUCCESS);
+    int loop;
+    ember_chunk* chunk = build_sum_loop(1000, ember_make_number(2), &loop);
+
+    // Values under the function's stack window are left alone
+    vm->stack[0] = ember_make_number(7);
+    vm->stack_top = 1;
+    vm->local_base = vm->local_count;
+    vm->chunk = chunk;
+    vm->ip = chunk->code;
+    vm_jit_on_call(vm);
+    assert(vm->jit_compilations == 1 && vm->jit_deopts == 0);
+    // Ran to the OP_RETURN without a template
+    assert(*vm->ip == OP_RETURN);
+    assert(vm->stack_top == 2);
+    assert(vm->stack[0].as.number_val == 7);
+    assert(vm->stack[1].type == EMBER_VAL_NUMBER && vm->stack[1].as.number_val == 999000);
+    assert(vm->local_count == vm->local_base + 2);
+    assert(vm->locals[vm->local_base].as.number_val == 1000);
+
+    // Entering again at the loop header picks up the current locals
+    vm->stack_top = 0;
+    vm->locals[vm->local_base] = ember_make_number(995);
+    vm->locals[vm->local_base + 1] = ember_make_number(0);
+    vm->ip = chunk->code + loop;
+    vm_jit_on_loop(vm);
+    assert(*vm->ip == OP_RETURN);
+    assert(vm->stack[0].as.number_val == 2 * (995 + 996 + 997 + 998 + 999));
+
+    vm->chunk = NULL;
+    vm->ip = NULL;
+    vm->stack_top = 0;
+    free_test_chunk(chunk);
+    ember_free_vm(vm);
+    printf("  ✓ Hot loops run natively and exit at the first unsupported opcode\n");
+}
+
+void test_perf_map(void) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+    remove(path);
+    assert(ember_jit_perf_enable(4) == EMBER_ERROR_INVALID_PARAMETER);
+    assert(ember_jit_perf_enable(EMBER_PERF_MAP) == EMBER_SUCCESS);
+
+    ember_vm* vm = ember_new_vm();
+    assert(ember_jit_configure(vm, 1, 1) == EMBER_SUCCESS);
+    int loop;
+    ember_chunk* chunk = build_sum_loop(10, ember_make_number(1), &loop);
+    ember_chunk_set_name(chunk, "sum_loop");
+    ember_chunk_set_name(chunk, "renamed");
+    vm->local_base = vm->local_count;
+    vm->chunk = chunk;
+    vm->ip = chunk->code;
+    vm_jit_on_call(vm);
+    assert(vm->jit_compilations == 1);
+    assert(ember_jit_perf_enable(0) == EMBER_SUCCESS);
+
+    // "start size ember:name", start being the native code
+    FILE* map = fopen(path, "r");
+    assert(map);
+    unsigned long start, size;
+    char symbol[64];
+    assert(fscanf(map, "%lx %lx %63s", &start, &size, symbol) == 3);
+    fclose(map);
+    remove(path);
+    assert(start != 0 && size > 0);
+    assert(strcmp(symbol, "ember:sum_loop") == 0);
+
+    vm->chunk = NULL;
+    vm->ip = NULL;
+    vm->stack_top = 0;
+    free_test_chunk(chunk);
+    ember_free_vm(vm);
+    printf("  ✓ Compiled chunks are listed in the perf map by function name\n");
+}
+
+void test_guard_deopt(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(ember_jit_configure(vm, 1, 1) == EMBER_SUCCESS);
+    int loop;
+    ember_chunk* chunk = build_sum_loop(10, ember_make_nil(), &loop);
+
+    vm->local_base = vm->local_count;
+    vm->chunk = chunk;
+    vm->ip = chunk->code;
+    vm_jit_on_call(vm);
+    // OP_MUL on nil fails its guard: the interpreter resumes at OP_MUL with
+    // both operands (and the running sum under them) on the stack
+    assert(vm->jit_deopts == 1);
+    assert(*vm->ip == OP_MUL);
+    assert(vm->stack_top == 3);
+    assert(vm->stack[0].as.number_val == 0 && vm->stack[1].as.number_val == 0);
+    assert(vm->stack[2].type == EMBER_VAL_NIL);
+
+    vm->chunk = NULL;
+    vm->ip = NULL;
+    vm->stack_top = 0;
+    free_test_chunk(chunk);
+    ember_free_vm(vm);
+    printf("  ✓ Failed type guards fall back to the interpreter\n");
+}
+
+static double run_script(int jit) {
+    ember_vm* vm = ember_new_vm();
+    assert(ember_jit_configure(vm, jit, 10) == EMBER_SUCCESS);
+    assert(ember_eval(vm,
+        "fn sum_to(n, step) {\n"
+        "    total = 0\n"
+        "    i = 0\n"
+        "    while (i < n) {\n"
+        "        total = total + i * step\n"
+        "        i = i + 1\n"
+        "    }\n"
+        "    return total\n"
+        "}\n"
+        "result = 0\n"
+        "round = 0\n"
+        "while (round < 50) {\n"
+        "    result = result + sum_to(200, 0.5)\n"
+        "    round = round + 1\n"
+        "}\n") == 0);
+    ember_value result = global_value(vm, "result");
+    assert(result.type == EMBER_VAL_NUMBER);
+    double value = result.as.number_val;
+    if (jit) assert(vm->jit_compilations > 0);
+
+    // Compiled for numbers, called with a string: the guard hands i * step
+    // to the interpreter, which reports whatever it reports without the JIT
+    if (ember_eval(vm, "label = sum_to(3, \"x\")\n") != 0) {
+        ember_vm_clear_error(vm);
+    }
+    ember_free_vm(vm);
+    return value;
+}
+
+void test_script_results(void) {
+    double interpreted = run_script(0);
+    double compiled = run_script(1);
+    assert(interpreted == 50 * 0.5 * (199 * 200 / 2));
+    assert(compiled == interpreted);
+    printf("  ✓ Compiled functions compute what the interpreter does\n");
+}
+
+int main(void) {
+    printf("Testing baseline JIT...\n");
+    if (!ember_jit_available()) {
+        ember_vm* vm = ember_new_vm();
+        assert(ember_jit_configure(vm, 1, 0) == EMBER_ERROR_INVALID_PARAMETER);
+        assert(ember_jit_configure(vm, 0, 0) == EMBER_SUCCESS);
+        assert(ember_jit_perf_enable(EMBER_PERF_MAP) == EMBER_ERROR_INVALID_PARAMETER);
+        ember_free_vm(vm);
+        printf("  - JIT not built in (make ENABLE_JIT=1), skipping\n");
+        return 0;
+    }
+    test_native_loop();
+    test_guard_deopt();
+    test_perf_map();
+    test_script_results();
+    printf("✓ JIT tests passed\n");
+    return 0;
+}
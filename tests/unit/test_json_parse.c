@@ -0,0 +1,298 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "../../src/runtime/stdlib_working.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// The result stays on the stack, rooted, until the VM is freed
+static ember_value parse(ember_vm* vm, const char* text) {
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, text);
+    int top = vm->stack_top;
+    ember_value result = ember_json_parse_working(vm, 1, &vm->stack[top - 1]);
+    assert(vm->stack_top == top);
+    vm->stack[top - 1] = result;
+    return result;
+}
+
+static ember_value field(ember_vm* vm, ember_value map, const char* key) {
+    assert(map.type == EMBER_VAL_HASH_MAP);
+    return hash_map_get(AS_HASH_MAP(map), ember_make_string_gc(vm, key));
+}
+
+static ember_string* first_key(ember_hash_map* map) {
+    for (int i = 0; i < map->capacity; i++) {
+        if (map->entries[i].is_occupied) return AS_STRING(map->entries[i].key);
+    }
+    return NULL;
+}
+
+void test_nested_document(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value doc = parse(vm, " {\"id\": 7, \"tags\": [\"a\", true, null, -2.5e1],"
+                                " \"owner\": {\"name\": \"caf\\u00e9 \\\"x\\\"\\n\"}, \"empty\": {}} ");
+    assert(doc.type == EMBER_VAL_HASH_MAP && AS_HASH_MAP(doc)->length == 4);
+    assert(field(vm, doc, "id").as.number_val == 7);
+
+    ember_value tags = field(vm, doc, "tags");
+    assert(tags.type == EMBER_VAL_ARRAY);
+    // Sized from the look-ahead count
+    assert(AS_ARRAY(tags)->length == 4 && AS_ARRAY(tags)->capacity == 4);
+    assert(strcmp(AS_CSTRING(AS_ARRAY(tags)->elements[0]), "a") == 0);
+    assert(AS_ARRAY(tags)->elements[1].type == EMBER_VAL_BOOL);
+    assert(AS_ARRAY(tags)->elements[2].type == EMBER_VAL_NIL);
+    assert(AS_ARRAY(tags)->elements[3].as.number_val == -25);
+
+    ember_value name = field(vm, field(vm, doc, "owner"), "name");
+    assert(strcmp(AS_CSTRING(name), "caf\xc3\xa9 \"x\"\n") == 0);
+    assert(AS_HASH_MAP(field(vm, doc, "empty"))->length == 0);
+
+    ember_free_vm(vm);
+    printf("Nested document test passed\n");
+}
+
+void test_escapes_and_numbers(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    // Surrogate pair, and an escaped string past the inline limit
+    ember_value emoji = parse(vm, "\"\\ud83d\\ude00\"");
+    assert(strcmp(AS_CSTRING(emoji), "\xf0\x9f\x98\x80") == 0);
+    ember_value escaped = parse(vm, "\"a long string with an escaped tab\\there and more\"");
+    assert(strcmp(AS_CSTRING(escaped), "a long string with an escaped tab\there and more") == 0);
+
+    assert(parse(vm, "0").as.number_val == 0);
+    assert(parse(vm, "123456789012345").as.number_val == 123456789012345.0);
+    assert(parse(vm, "12345678901234567890").as.number_val == 12345678901234567890.0);
+    assert(parse(vm, "1.5e10").as.number_val == 1.5e10);
+    ember_free_vm(vm);
+    printf("Escapes and numbers test passed\n");
+}
+
+void test_interned_keys(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value rows = parse(vm, "[{\"user_id\": 1}, {\"user_id\": 2}, {\"user_id\": 3}]");
+    assert(rows.type == EMBER_VAL_ARRAY && AS_ARRAY(rows)->length == 3);
+    ember_string* key = first_key(AS_HASH_MAP(AS_ARRAY(rows)->elements[0]));
+    assert(key != NULL && key->is_interned);
+    for (int i = 1; i < 3; i++) {
+        assert(first_key(AS_HASH_MAP(AS_ARRAY(rows)->elements[i])) == key);
+    }
+    ember_free_vm(vm);
+    printf("Interned keys test passed\n");
+}
+
+void test_rejects_malformed(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    const char* malformed[] = {
+        "", "[1,]", "{\"a\" 1}", "{\"a\":}", "{a: 1}", "01", "-", "1.", "1e",
+        "[1] x", "tru", "[", "\"\\x\"", "\"\\ud800\"", "\"line\nbreak\"",
+    };
+    for (size_t i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++) {
+        assert(parse(vm, malformed[i]).type == EMBER_VAL_NIL);
+    }
+
+    // Nesting stops at 128 levels
+    char nested[300];
+    memset(nested, '[', 128);
+    memset(nested + 128, ']', 128);
+    nested[256] = '\0';
+    assert(parse(vm, nested).type == EMBER_VAL_ARRAY);
+    memset(nested, '[', 129);
+    memset(nested + 129, ']', 129);
+    nested[258] = '\0';
+    assert(parse(vm, nested).type == EMBER_VAL_NIL);
+    ember_free_vm(vm);
+    printf("Malformed input test passed\n");
+}
+
+void test_survives_collection(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_gc_configure(vm, 1, 0, 1, 0);
+
+    // Enough strings to run the collector while the document is half built
+    size_t capacity = 160 * 1024;
+    char* text = malloc(capacity);
+    assert(text != NULL);
+    size_t length = (size_t)snprintf(text, capacity, "[");
+    for (int i = 0; i < 2000; i++) {
+        length += (size_t)snprintf(text + length, capacity - length, "%s{\"name\": \"row number %d padded past the inline limit\"}",
+                                   i ? "," : "", i);
+    }
+    snprintf(text + length, capacity - length, "]");
+    ember_value rows = parse(vm, text);
+    free(text);
+
+    assert(rows.type == EMBER_VAL_ARRAY && AS_ARRAY(rows)->length == 2000);
+    ember_value last = field(vm, AS_ARRAY(rows)->elements[1999], "name");
+    assert(strcmp(AS_CSTRING(last), "row number 1999 padded past the inline limit") == 0);
+    ember_free_vm(vm);
+    printf("Collection during parse test passed\n");
+}
+
+static int same_value(ember_value a, ember_value b) {
+    if (a.type != b.type) return 0;
+    switch (a.type) {
+        case EMBER_VAL_NUMBER: return a.as.number_val == b.as.number_val;
+        case EMBER_VAL_BOOL: return a.as.bool_val == b.as.bool_val;
+        case EMBER_VAL_NIL: return 1;
+        case EMBER_VAL_STRING:
+            return AS_STRING(a)->length == AS_STRING(b)->length &&
+                   memcmp(AS_CSTRING(a), AS_CSTRING(b), (size_t)AS_STRING(a)->length) == 0;
+        case EMBER_VAL_ARRAY: {
+            ember_array* x = AS_ARRAY(a);
+            ember_array* y = AS_ARRAY(b);
+            if (x->length != y->length) return 0;
+            for (int i = 0; i < x->length; i++) {
+                if (!same_value(x->elements[i], y->elements[i])) return 0;
+            }
+            return 1;
+        }
+        case EMBER_VAL_HASH_MAP: {
+            ember_hash_map* x = AS_HASH_MAP(a);
+            ember_hash_map* y = AS_HASH_MAP(b);
+            if (x->length != y->length) return 0;
+            for (int i = 0; i < x->capacity; i++) {
+                if (!x->entries[i].is_occupied) continue;
+                if (!same_value(x->entries[i].value, hash_map_get(y, x->entries[i].key))) return 0;
+            }
+            return 1;
+        }
+        default:
+            return 0;
+    }
+}
+
+void test_indexed_large_document(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    // Backslash runs, escaped quotes and structural characters inside
+    // strings, with a growing pad so each lands on every offset of a block
+    const char* records[] = {
+        "{\"a\\\\\": \"q\\\"{[,:]}\\\\\", \"n\": [1, {\"x\": []}, \"\\\\\\\"\"]}",
+        "[\"\\u00e9\\\\\", {}, [[]], \"]\", -0.5e-3, true, null]",
+        "\"plain,{string}\"",
+    };
+    size_t count = sizeof(records) / sizeof(records[0]);
+    size_t capacity = 512 * 1024;
+    char* text = malloc(capacity);
+    assert(text != NULL);
+    size_t length = (size_t)snprintf(text, capacity, "[");
+    int rows = 0;
+    for (; length < 200 * 1024; rows++) {
+        int pad = rows % 67;
+        length += (size_t)snprintf(text + length, capacity - length, "%s%*s%s", rows ? "," : "", pad, "",
+                                   records[rows % count]);
+    }
+    snprintf(text + length, capacity - length, "]");
+
+    ember_value doc = parse(vm, text);
+    assert(doc.type == EMBER_VAL_ARRAY && AS_ARRAY(doc)->length == rows);
+    // Sized exactly from the index
+    assert(AS_ARRAY(doc)->capacity == rows);
+    for (size_t i = 0; i < count; i++) {
+        ember_value small = parse(vm, records[i]);
+        assert(small.type != EMBER_VAL_NIL);
+        for (int row = (int)i; row < rows; row += (int)count) {
+            assert(same_value(AS_ARRAY(doc)->elements[row], small));
+        }
+    }
+
+    // A control character in a string and an unterminated string stop at
+    // the index; a bad literal is left to the descent
+    char* plain = strstr(text + length / 2, "plain");
+    plain[0] = '\t';
+    assert(parse(vm, text).type == EMBER_VAL_NIL);
+    plain[0] = 'p';
+    snprintf(text + length, capacity - length, ",\"open");
+    assert(parse(vm, text).type == EMBER_VAL_NIL);
+    snprintf(text + length, capacity - length, "]");
+    assert(parse(vm, text).type == EMBER_VAL_ARRAY);
+    strstr(text + length / 2, "true")[0] = 'x';
+    assert(parse(vm, text).type == EMBER_VAL_NIL);
+    free(text);
+    ember_free_vm(vm);
+    printf("Indexed large document test passed\n");
+}
+
+// The result stays on the stack, rooted, until the VM is freed
+static ember_value stringify(ember_vm* vm, ember_value value) {
+    vm->stack[vm->stack_top++] = value;
+    ember_value result = ember_json_stringify_working(vm, 1, &vm->stack[vm->stack_top - 1]);
+    vm->stack[vm->stack_top - 1] = result;
+    return result;
+}
+
+void test_stringify(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    const char* text = "{\"tags\":[\"a\\\"b\\\\\",true,null,[]],\"owner\":{\"name\":\"tab\\there\\u0001\"}}";
+    ember_value doc = parse(vm, text);
+    ember_value json = stringify(vm, doc);
+    assert(json.type == EMBER_VAL_STRING);
+    // Key order follows the table, so compare what it parses back to
+    assert(same_value(parse(vm, AS_CSTRING(json)), doc));
+    assert(strstr(AS_CSTRING(json), "\"tab\\there\\u0001\"") != NULL);
+
+    // Shortest text that reads back as the same number
+    double numbers[] = {0, -0.0, 42, -7, 0.1, 1.0 / 3, 1e21, 1e-7, 123456789012345678.0, 0.1 + 0.2};
+    const char* expected[] = {"0", "-0", "42", "-7", "0.1", "0.3333333333333333", "1e+21", "1e-07",
+                              "1.2345678901234568e+17", "0.30000000000000004"};
+    for (size_t i = 0; i < sizeof(numbers) / sizeof(numbers[0]); i++) {
+        json = stringify(vm, ember_make_number(numbers[i]));
+        assert(strcmp(AS_CSTRING(json), expected[i]) == 0);
+        assert(strtod(AS_CSTRING(json), NULL) == numbers[i]);
+    }
+    assert(strcmp(AS_CSTRING(stringify(vm, ember_make_number(NAN))), "null") == 0);
+
+    // Long strings go through the vector scan with escapes on every offset
+    char long_text[300];
+    for (int i = 0; i < 299; i++) long_text[i] = i % 37 == 5 ? '"' : (char)('a' + i % 26);
+    long_text[299] = '\0';
+    json = stringify(vm, ember_make_string_gc(vm, long_text));
+    ember_value back = parse(vm, AS_CSTRING(json));
+    assert(back.type == EMBER_VAL_STRING && strcmp(AS_CSTRING(back), long_text) == 0);
+
+    // The output buffer is kept for the next call
+    assert(vm->json_buffer != NULL);
+    char* buffer = vm->json_buffer;
+    stringify(vm, doc);
+    assert(vm->json_buffer == buffer);
+
+    // A cycle has no JSON form; the same array twice side by side is fine
+    ember_value list = field(vm, doc, "tags");
+    ember_value pair = ember_make_array(vm, 2);
+    vm->stack[vm->stack_top++] = pair;
+    array_push_with_vm(vm, AS_ARRAY(pair), list);
+    array_push_with_vm(vm, AS_ARRAY(pair), list);
+    json = stringify(vm, pair);
+    assert(strcmp(AS_CSTRING(json), "[[\"a\\\"b\\\\\",true,null,[]],[\"a\\\"b\\\\\",true,null,[]]]") == 0);
+    array_push_with_vm(vm, AS_ARRAY(list), doc);
+    assert(stringify(vm, doc).type == EMBER_VAL_NIL);
+
+    json_buffer_free(vm);
+    ember_free_vm(vm);
+    printf("Stringify test passed\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running JSON parser tests...\n");
+    test_nested_document();
+    test_escapes_and_numbers();
+    test_interned_keys();
+    test_rejects_malformed();
+    test_survives_collection();
+    test_indexed_large_document();
+    test_stringify();
+    printf("All JSON parser tests passed!\n");
+    return 0;
+}
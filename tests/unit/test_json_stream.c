@@ -0,0 +1,280 @@
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "../../src/runtime/json_stream.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// What each value was, taken before the next one is parsed
+typedef struct {
+    ember_val_type types[16];
+    int lengths[16];
+    double numbers[16];
+    char strings[16][32];
+    int count;
+    int stop_after;                    // Fails the reader at this value, if set
+} collected;
+
+static int collect(ember_vm* vm, ember_value value, void* context) {
+    (void)vm;
+    collected* out = context;
+    assert(out->count < 16);
+    out->types[out->count] = value.type;
+    if (value.type == EMBER_VAL_ARRAY) out->lengths[out->count] = AS_ARRAY(value)->length;
+    if (value.type == EMBER_VAL_HASH_MAP) out->lengths[out->count] = AS_HASH_MAP(value)->length;
+    if (value.type == EMBER_VAL_NUMBER) out->numbers[out->count] = value.as.number_val;
+    if (value.type == EMBER_VAL_STRING) {
+        snprintf(out->strings[out->count], sizeof(out->strings[0]), "%s", AS_CSTRING(value));
+    }
+    out->count++;
+    return out->stop_after && out->count == out->stop_after ? -1 : 0;
+}
+
+// Feeds text in pieces of step bytes
+static int read_in_steps(ember_vm* vm, const char* text, size_t step, int elements, collected* out) {
+    memset(out, 0, sizeof(*out));
+    json_reader* reader = json_reader_new(vm, elements, collect, out);
+    assert(reader != NULL);
+    size_t length = strlen(text);
+    int status = 0;
+    for (size_t at = 0; at < length && status == 0; at += step) {
+        status = json_reader_feed(reader, text + at, length - at < step ? length - at : step);
+    }
+    if (status == 0) status = json_reader_finish(reader);
+    assert(status != 0 || json_reader_count(reader) == (size_t)out->count);
+    json_reader_free(reader);
+    return status;
+}
+
+void test_values_across_chunks(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    const char* ndjson = "{\"level\": \"info\", \"msg\": \"a \\\"quoted\\\" } brace\"}\n"
+                         "[1, [2, {\"x\": \"]\"}]]\n"
+                         "\"tab\\\\\"\n"
+                         "42 -1.5e2\ntrue null\n";
+    // Every split point, down to one byte at a time
+    for (size_t step = 1; step <= strlen(ndjson); step++) {
+        collected out;
+        int rc = read_in_steps(vm, ndjson, step, 0, &out);
+        assert(rc == 0);
+        (void)rc;
+        assert(out.count == 7);
+        assert(out.types[0] == EMBER_VAL_HASH_MAP && out.lengths[0] == 2);
+        assert(out.types[1] == EMBER_VAL_ARRAY && out.lengths[1] == 2);
+        assert(strcmp(out.strings[2], "tab\\") == 0);
+        assert(out.numbers[3] == 42 && out.numbers[4] == -150);
+        assert(out.types[5] == EMBER_VAL_BOOL && out.types[6] == EMBER_VAL_NIL);
+    }
+    ember_free_vm(vm);
+    printf("Values across chunks test passed\n");
+}
+
+void test_array_elements(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    const char* exported = " [ {\"id\": 1}, 2 , \"three\",[4] ] ";
+    int rc;
+    for (size_t step = 1; step <= strlen(exported); step++) {
+        collected out;
+        rc = read_in_steps(vm, exported, step, 1, &out);
+        assert(rc == 0);
+        assert(out.count == 4);
+        assert(out.types[0] == EMBER_VAL_HASH_MAP && out.lengths[0] == 1);
+        assert(out.numbers[1] == 2 && strcmp(out.strings[2], "three") == 0);
+        assert(out.types[3] == EMBER_VAL_ARRAY && out.lengths[3] == 1);
+    }
+    collected out;
+    rc = read_in_steps(vm, "[]", 1, 1, &out);
+    assert(rc == 0 && out.count == 0);
+
+    // Malformed or cut short, in either mode
+    const char* bad_values[] = {"{\"a\": 1", "\"open", "[1, 2]]", "{\"a\" 1}", "tru"};
+    for (size_t i = 0; i < sizeof(bad_values) / sizeof(bad_values[0]); i++) {
+        rc = read_in_steps(vm, bad_values[i], 3, 0, &out);
+        assert(rc != 0);
+    }
+    const char* bad_elements[] = {"[1, 2", "[1,]", "[1] 2", "{\"a\": 1}", "[1 2]"};
+    for (size_t i = 0; i < sizeof(bad_elements) / sizeof(bad_elements[0]); i++) {
+        rc = read_in_steps(vm, bad_elements[i], 2, 1, &out);
+        assert(rc != 0);
+    }
+
+    // A callback can stop the reader
+    memset(&out, 0, sizeof(out));
+    out.stop_after = 2;
+    json_reader* reader = json_reader_new(vm, 0, collect, &out);
+    rc = json_reader_feed(reader, "1 2 3 4 ", 8);
+    assert(rc != 0);
+    assert(out.count == 2 && json_reader_error(reader) != NULL);
+    rc = json_reader_feed(reader, "5 ", 2);
+    assert(rc != 0);
+    (void)rc;
+    json_reader_free(reader);
+    ember_free_vm(vm);
+    printf("Array elements test passed\n");
+}
+
+static char sink_text[4096];
+static size_t sink_length = 0;
+static int sink_calls = 0;
+
+static ember_value on_chunk(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    assert(argc == 1 && argv[0].type == EMBER_VAL_STRING);
+    ember_string* chunk = AS_STRING(argv[0]);
+    assert(sink_length + (size_t)chunk->length < sizeof(sink_text));
+    memcpy(sink_text + sink_length, chunk->chars, (size_t)chunk->length);
+    sink_length += (size_t)chunk->length;
+    sink_text[sink_length] = '\0';
+    sink_calls++;
+    return ember_make_nil();
+}
+
+static int read_values = 0;
+static int read_maps = 0;
+
+static ember_value on_value(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    assert(argc == 1);
+    read_values++;
+    if (argv[0].type == EMBER_VAL_HASH_MAP) read_maps++;
+    return ember_make_nil();
+}
+
+void test_write_and_read_file(void) {
+    char directory[] = "/tmp/ember_json_stream_XXXXXX";
+    char* made = mkdtemp(directory);
+    assert(made != NULL);
+    (void)made;
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    int rc = ember_vfs_mount(vm, "/data", directory, EMBER_MOUNT_RW);
+    assert(rc == 0);
+    (void)rc;
+
+    // Big enough for several reads and flushes
+    int rows = 20000;
+    ember_value records = ember_make_array(vm, rows);
+    vm->stack[vm->stack_top++] = records;
+    for (int i = 0; i < rows; i++) {
+        ember_value record = ember_make_hash_map(vm, 2);
+        array_push_with_vm(vm, AS_ARRAY(records), record);
+        ember_value key = ember_make_string_gc(vm, "id");
+        hash_map_set_with_vm(vm, AS_HASH_MAP(record), key, ember_make_number(i));
+        char name[32];
+        snprintf(name, sizeof(name), "row \"%d\"\n", i);
+        vm->stack[vm->stack_top++] = ember_make_string_gc(vm, name);
+        key = ember_make_string_gc(vm, "name");
+        hash_map_set_with_vm(vm, AS_HASH_MAP(record), key, vm->stack[--vm->stack_top]);
+    }
+
+    ember_value native;
+    native.type = EMBER_VAL_NATIVE;
+    native.as.native_val = on_value;
+    ember_value args[3] = {ember_make_string_gc(vm, "/data/rows.ndjson"), records, ember_make_bool(1)};
+    ember_value written = ember_json_write_working(vm, 3, args);
+    assert(written.type == EMBER_VAL_NUMBER && written.as.number_val > 64 * 1024);
+
+    ember_value read_args[3] = {args[0], native, ember_make_bool(0)};
+    read_values = 0;
+    read_maps = 0;
+    ember_value count = ember_json_read_working(vm, 2, read_args);
+    assert(count.type == EMBER_VAL_NUMBER && count.as.number_val == rows);
+    assert(read_values == rows && read_maps == rows);
+
+    // The same rows as one array, read back element by element
+    args[0] = ember_make_string_gc(vm, "/data/rows.json");
+    assert(ember_json_write_working(vm, 2, args).type == EMBER_VAL_NUMBER);
+    read_args[0] = args[0];
+    read_args[2] = ember_make_bool(1);
+    read_values = 0;
+    read_maps = 0;
+    count = ember_json_read_working(vm, 3, read_args);
+    assert(count.as.number_val == rows && read_maps == rows);
+    // Read as top-level values, it is the one array
+    read_values = 0;
+    read_maps = 0;
+    ember_value whole = ember_json_read_working(vm, 2, read_args);
+    assert(whole.type == EMBER_VAL_NUMBER && whole.as.number_val == 1);
+    assert(read_values == 1 && read_maps == 0);
+
+    // Outside the VFS, or not an array or generator for lines
+    args[0] = ember_make_string_gc(vm, "/elsewhere/rows.json");
+    assert(ember_json_write_working(vm, 2, args).type == EMBER_VAL_NIL);
+    read_args[0] = args[0];
+    assert(ember_json_read_working(vm, 2, read_args).type == EMBER_VAL_NIL);
+    args[0] = ember_make_string_gc(vm, "/data/rows.json");
+    args[1] = ember_make_number(1);
+    assert(ember_json_write_working(vm, 3, args).type == EMBER_VAL_NIL);
+
+    vm->stack_top--;
+    ember_free_vm(vm);
+    char path[256];
+    snprintf(path, sizeof(path), "%s/rows.ndjson", directory);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/rows.json", directory);
+    unlink(path);
+    rmdir(directory);
+    printf("File write and read test passed\n");
+}
+
+void test_write_to_callback(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value doc = ember_make_hash_map(vm, 2);
+    vm->stack[vm->stack_top++] = doc;
+    ember_value list = ember_make_array(vm, 3);
+    vm->stack[vm->stack_top++] = list;
+    ember_value key = ember_make_string_gc(vm, "list");
+    hash_map_set_with_vm(vm, AS_HASH_MAP(doc), key, list);
+    vm->stack_top--;
+    array_push_with_vm(vm, AS_ARRAY(list), ember_make_number(0.5));
+    array_push_with_vm(vm, AS_ARRAY(list), ember_make_string_gc(vm, "a\tb\x01"));
+    array_push_with_vm(vm, AS_ARRAY(list), ember_make_nil());
+
+    ember_value sink;
+    sink.type = EMBER_VAL_NATIVE;
+    sink.as.native_val = on_chunk;
+    ember_value args[2] = {sink, doc};
+    sink_length = 0;
+    sink_calls = 0;
+    ember_value written = ember_json_write_working(vm, 2, args);
+    assert(written.type == EMBER_VAL_NUMBER && written.as.number_val == (double)sink_length);
+    assert(sink_calls == 1);
+    assert(strcmp(sink_text, "{\"list\":[0.5,\"a\\tb\\u0001\",null]}") == 0);
+
+    // What it wrote parses back to the same values
+    ember_value parsed;
+    bool ok = ember_json_parse_text(vm, sink_text, sink_length, &parsed);
+    assert(ok);
+    (void)ok;
+    vm->stack[vm->stack_top++] = parsed;
+    ember_value back = hash_map_get(AS_HASH_MAP(parsed), ember_make_string_gc(vm, "list"));
+    assert(back.type == EMBER_VAL_ARRAY && strcmp(AS_CSTRING(AS_ARRAY(back)->elements[1]), "a\tb\x01") == 0);
+
+    // A cycle has no JSON form
+    array_push_with_vm(vm, AS_ARRAY(list), doc);
+    assert(ember_json_write_working(vm, 2, args).type == EMBER_VAL_NIL);
+
+    vm->stack_top -= 2;
+    ember_free_vm(vm);
+    printf("Callback sink test passed\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running JSON streaming tests...\n");
+    test_values_across_chunks();
+    test_array_elements();
+    test_write_and_read_file();
+    test_write_to_callback();
+    printf("All JSON streaming tests passed!\n");
+    return 0;
+}
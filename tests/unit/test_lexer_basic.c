@@ -3,6 +3,8 @@
 #include <assert.h>
 #include <string.h>
 #include "../unit/test_ember_internal.h"
+#include "../../src/frontend/lexer/lexer.h"
+#include <pthread.h>
 
 // Test lexer functionality to improve frontend coverage
 
@@ -252,6 +254,108 @@ void test_edge_cases(void) {
     ember_free_vm(vm);
 }
 
+static int count_tokens(lexer* lx, ember_token_type type) {
+    int count = 0;
+    for (;;) {
+        ember_token token = lexer_scan_token(lx);
+        if (token.type == TOKEN_EOF || token.type == TOKEN_ERROR) break;
+        if (token.type == type) count++;
+    }
+    return count;
+}
+
+static void* scan_on_thread(void* arg) {
+    const char* source = (const char*)arg;
+    int numbers = 0;
+    for (int i = 0; i < 200; i++) {
+        init_scanner(source);
+        for (ember_token token = scan_token(); token.type != TOKEN_EOF; token = scan_token()) {
+            if (token.type == TOKEN_NUMBER) numbers++;
+        }
+    }
+    return (void*)(intptr_t)numbers;
+}
+
+void test_independent_lexers(void) {
+    printf("Testing independent lexers...\n");
+    
+    // Interleaved lexers don't disturb each other
+    lexer a;
+    lexer b;
+    lexer_init(&a, "x = 1\ny = 2");
+    lexer_init(&b, "3 + 4 + 5");
+    ember_token first = lexer_scan_token(&a);
+    assert(first.type == TOKEN_IDENTIFIER && first.length == 1 && first.start[0] == 'x');
+    assert(count_tokens(&b, TOKEN_NUMBER) == 3);
+    assert(count_tokens(&a, TOKEN_NUMBER) == 2);
+    assert(a.line == 2 && b.line == 1);
+    
+    // Two threads scan through the old entry points at once
+    pthread_t threads[2];
+    const char* sources[2] = {"1 2 3", "fn f() { return 4 }"};
+    for (int i = 0; i < 2; i++) {
+        int rc = pthread_create(&threads[i], NULL, scan_on_thread, (void*)sources[i]);
+        assert(rc == 0);
+        (void)rc;
+    }
+    void* results[2];
+    for (int i = 0; i < 2; i++) {
+        int rc = pthread_join(threads[i], &results[i]);
+        assert(rc == 0);
+        (void)rc;
+    }
+    assert((intptr_t)results[0] == 600 && (intptr_t)results[1] == 200);
+    
+    printf("Independent lexers test passed\n");
+}
+
+void test_keywords_and_runs(void) {
+    printf("Testing keyword lookup and long runs...\n");
+    
+    static const struct {
+        const char* name;
+        ember_token_type type;
+    } keywords[] = {
+        {"and", TOKEN_AND}, {"as", TOKEN_AS}, {"async", TOKEN_ASYNC}, {"await", TOKEN_AWAIT},
+        {"break", TOKEN_BREAK}, {"case", TOKEN_CASE}, {"catch", TOKEN_CATCH}, {"class", TOKEN_CLASS},
+        {"continue", TOKEN_CONTINUE}, {"default", TOKEN_DEFAULT}, {"do", TOKEN_DO}, {"else", TOKEN_ELSE},
+        {"export", TOKEN_EXPORT}, {"extends", TOKEN_EXTENDS}, {"false", TOKEN_FALSE},
+        {"finally", TOKEN_FINALLY}, {"fn", TOKEN_FN}, {"for", TOKEN_FOR}, {"from", TOKEN_FROM},
+        {"function", TOKEN_FUNCTION}, {"if", TOKEN_IF}, {"import", TOKEN_IMPORT}, {"new", TOKEN_NEW},
+        {"not", TOKEN_NOT}, {"or", TOKEN_OR}, {"require", TOKEN_REQUIRE}, {"return", TOKEN_RETURN},
+        {"super", TOKEN_SUPER}, {"switch", TOKEN_SWITCH}, {"this", TOKEN_THIS}, {"throw", TOKEN_THROW},
+        {"true", TOKEN_TRUE}, {"try", TOKEN_TRY}, {"while", TOKEN_WHILE}, {"yield", TOKEN_YIELD},
+    };
+    for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
+        lexer lx;
+        lexer_init(&lx, keywords[i].name);
+        assert(lexer_scan_token(&lx).type == keywords[i].type);
+    }
+    
+    // Near misses and keyword prefixes are identifiers
+    const char* identifiers[] = {"a", "an", "andy", "classes", "fun", "functions", "tryer", "_if", "If", "ti"};
+    for (size_t i = 0; i < sizeof(identifiers) / sizeof(identifiers[0]); i++) {
+        lexer lx;
+        lexer_init(&lx, identifiers[i]);
+        ember_token token = lexer_scan_token(&lx);
+        assert(token.type == TOKEN_IDENTIFIER && token.length == (int)strlen(identifiers[i]));
+    }
+    
+    // Runs longer than a vector: identifiers, indentation, comments, strings
+    lexer lx;
+    lexer_init(&lx, "                    a_very_long_identifier_name_2 # a comment longer than sixteen bytes\n"
+                    "\"a string body well past sixteen bytes\nwith a newline and ${x} in it\" // done\n");
+    ember_token token = lexer_scan_token(&lx);
+    assert(token.type == TOKEN_IDENTIFIER && token.length == 29);
+    assert(lexer_scan_token(&lx).type == TOKEN_NEWLINE);
+    token = lexer_scan_token(&lx);
+    assert(token.type == TOKEN_INTERPOLATED_STRING && token.line == 3);
+    assert(lexer_scan_token(&lx).type == TOKEN_NEWLINE);
+    assert(lexer_scan_token(&lx).type == TOKEN_EOF);
+    
+    printf("Keyword lookup and long runs test passed\n");
+}
+
 int main(int argc, char* argv[]) {
     (void)argc;
     (void)argv;
@@ -266,6 +370,8 @@ int main(int argc, char* argv[]) {
     test_function_calls();
     test_error_handling();
     test_edge_cases();
+    test_independent_lexers();
+    test_keywords_and_runs();
     
     printf("All lexer basic tests completed!\n");
     return 0;
@@ -0,0 +1,208 @@
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+
+static ember_value get(ember_vm* vm, ember_value cache, ember_value key) {
+    ember_value args[2] = {cache, key};
+    return ember_native_cache_get(vm, 2, args);
+}
+
+static double stat(ember_vm* vm, ember_value cache, const char* name) {
+    ember_value stats = keep(vm, ember_native_cache_stats(vm, 1, &cache));
+    assert(stats.type == EMBER_VAL_HASH_MAP);
+    ember_value value = hash_map_get(AS_HASH_MAP(stats), text(vm, name));
+    assert(value.type == EMBER_VAL_NUMBER);
+    return value.as.number_val;
+}
+
+void test_eviction_order(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value cache = keep(vm, ember_make_cache(vm, 3, 0));
+    ember_cache* c = AS_CACHE(cache);
+    for (int i = 0; i < 3; i++) {
+        assert(lru_cache_put(vm, c, ember_make_number(i), ember_make_number(i * 10), 0));
+    }
+
+    // Reading 0 makes 1 the least recently used, so 3 pushes it out
+    assert(get(vm, cache, ember_make_number(0)).as.number_val == 0);
+    assert(lru_cache_put(vm, c, ember_make_number(3), ember_make_number(30), 0));
+    assert(c->size == 3 && !lru_cache_has(c, ember_make_number(1)));
+    assert(get(vm, cache, ember_make_number(1)).type == EMBER_VAL_NIL);
+
+    // Replacing moves to the front too, without growing the cache
+    assert(lru_cache_put(vm, c, ember_make_number(2), ember_make_number(21), 0));
+    assert(lru_cache_put(vm, c, ember_make_number(4), ember_make_number(40), 0));
+    assert(!lru_cache_has(c, ember_make_number(0)));
+    assert(get(vm, cache, ember_make_number(2)).as.number_val == 21);
+    assert(c->newest->key.as.number_val == 2 && c->oldest->key.as.number_val == 3);
+
+    // has neither counts nor reorders
+    assert(lru_cache_has(c, ember_make_number(3)) && c->oldest->key.as.number_val == 3);
+    assert(stat(vm, cache, "hits") == 2 && stat(vm, cache, "misses") == 1);
+    assert(stat(vm, cache, "evictions") == 2 && stat(vm, cache, "size") == 3);
+
+    assert(lru_cache_delete(c, ember_make_number(3)) && !lru_cache_delete(c, ember_make_number(3)));
+    assert(c->size == 2 && c->oldest->key.as.number_val == 4);
+    lru_cache_clear(c);
+    assert(c->size == 0 && c->bytes == 0 && !c->newest && !c->oldest);
+    ember_free_vm(vm);
+    printf("  ✓ The least recently used entry is evicted first\n");
+}
+
+void test_byte_bound(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    char big[1001];
+    memset(big, 'x', 1000);
+    big[1000] = '\0';
+    ember_value value = text(vm, big);
+    size_t entry = sizeof(ember_cache_entry) + sizeof(ember_string) + 1000;
+    ember_value cache = keep(vm, ember_make_cache(vm, 0, entry * 3));
+    ember_cache* c = AS_CACHE(cache);
+
+    for (int i = 0; i < 10; i++) {
+        assert(lru_cache_put(vm, c, ember_make_number(i), value, 0));
+        assert(c->bytes <= c->max_bytes);
+    }
+    assert(c->size == 3 && c->bytes == entry * 3 && c->evictions == 7);
+    assert(lru_cache_has(c, ember_make_number(9)) && !lru_cache_has(c, ember_make_number(6)));
+
+    // An entry that alone is over the bound is refused, and the value it
+    // would have replaced goes
+    char huge[4000];
+    memset(huge, 'y', sizeof(huge) - 1);
+    huge[sizeof(huge) - 1] = '\0';
+    ember_value args[3] = {cache, ember_make_number(9), text(vm, huge)};
+    ember_value stored = ember_native_cache_put(vm, 3, args);
+    assert(stored.type == EMBER_VAL_BOOL && !stored.as.bool_val);
+    assert(c->size == 2 && !lru_cache_has(c, ember_make_number(9)));
+    ember_free_vm(vm);
+    printf("  ✓ A byte bound evicts until the estimate fits\n");
+}
+
+void test_ttl(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value cache = keep(vm, ember_make_cache(vm, 0, 0));
+    ember_cache* c = AS_CACHE(cache);
+    assert(lru_cache_put(vm, c, text(vm, "short"), ember_make_number(1), 20));
+    assert(lru_cache_put(vm, c, text(vm, "long"), ember_make_number(2), 60000));
+    assert(lru_cache_put(vm, c, text(vm, "forever"), ember_make_number(3), 0));
+    assert(get(vm, cache, text(vm, "short")).as.number_val == 1);
+    usleep(50 * 1000);
+
+    // Expired entries miss and go when read
+    assert(get(vm, cache, text(vm, "short")).type == EMBER_VAL_NIL);
+    assert(c->size == 2 && c->expirations == 1 && c->misses == 1);
+    assert(get(vm, cache, text(vm, "long")).as.number_val == 2);
+
+    // Or from the back as puts come in, or all at once by prune
+    assert(lru_cache_put(vm, c, text(vm, "a"), ember_make_number(4), 20));
+    assert(lru_cache_put(vm, c, text(vm, "b"), ember_make_number(5), 20));
+    usleep(50 * 1000);
+    ember_value args[4] = {cache, text(vm, "c"), ember_make_number(6), ember_make_number(0.02)};
+    assert(ember_native_cache_put(vm, 4, args).as.bool_val);
+    assert(c->size == 5);
+    assert(lru_cache_prune(c) == 2 && c->size == 3 && c->expirations == 3);
+    assert(lru_cache_has(c, text(vm, "c")) && lru_cache_has(c, text(vm, "forever")));
+
+    // An expired entry at the back goes before a live one is evicted
+    ember_value bounded = keep(vm, ember_make_cache(vm, 2, 0));
+    assert(lru_cache_put(vm, AS_CACHE(bounded), ember_make_number(1), ember_make_nil(), 0));
+    assert(lru_cache_put(vm, AS_CACHE(bounded), ember_make_number(2), ember_make_nil(), 1));
+    usleep(5 * 1000);
+    assert(lru_cache_get(AS_CACHE(bounded), ember_make_number(1), &args[0]));
+    assert(lru_cache_put(vm, AS_CACHE(bounded), ember_make_number(3), ember_make_nil(), 0));
+    assert(AS_CACHE(bounded)->evictions == 0 && AS_CACHE(bounded)->expirations == 1);
+    assert(lru_cache_has(AS_CACHE(bounded), ember_make_number(1)));
+    ember_free_vm(vm);
+    printf("  ✓ Entries expire after their TTL\n");
+}
+
+void test_gc(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_gc_configure(vm, 1, 0, 1, 0);
+    ember_value cache = keep(vm, ember_make_cache(vm, 1000, 0));
+    gc_collect_minor(vm);
+    assert(cache.as.obj_val->is_old);
+
+    // Young keys and values put into an old cache are remembered and kept
+    char buffer[64];
+    for (int i = 0; i < 500; i++) {
+        snprintf(buffer, sizeof(buffer), "key %d", i);
+        ember_value key = ember_make_string_gc(vm, buffer);
+        vm->stack[vm->stack_top++] = key;
+        snprintf(buffer, sizeof(buffer), "value %d", i);
+        ember_value value = ember_make_string_gc(vm, buffer);
+        vm->stack[vm->stack_top++] = value;
+        assert(lru_cache_put(vm, AS_CACHE(cache), key, value, 0));
+        vm->stack_top -= 2;
+    }
+    assert(cache.as.obj_val->is_remembered);
+    gc_collect_minor(vm);
+    ember_gc_collect(vm);
+    for (int i = 0; i < 500; i += 7) {
+        snprintf(buffer, sizeof(buffer), "key %d", i);
+        ember_value value = get(vm, cache, text(vm, buffer));
+        snprintf(buffer, sizeof(buffer), "value %d", i);
+        assert(value.type == EMBER_VAL_STRING && strcmp(AS_CSTRING(value), buffer) == 0);
+    }
+    assert(AS_CACHE(cache)->bucket_count >= 500);
+    ember_free_vm(vm);
+    printf("  ✓ Keys and values are traced, through the write barrier too\n");
+}
+
+void test_natives(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value bounds[2] = {ember_make_number(2), ember_make_number(1 << 20)};
+    ember_value cache = keep(vm, ember_native_cache_new(vm, 2, bounds));
+    assert(cache.type == EMBER_VAL_CACHE && AS_CACHE(cache)->max_bytes == 1 << 20);
+    assert(strcmp(value_type_to_string(cache.type), "cache") == 0);
+
+    ember_value args[4] = {cache, text(vm, "k"), text(vm, "v"), ember_make_nil()};
+    assert(ember_native_cache_put(vm, 4, args).as.bool_val);
+    ember_value fallback[3] = {cache, text(vm, "missing"), ember_make_number(7)};
+    assert(ember_native_cache_get(vm, 3, fallback).as.number_val == 7);
+    assert(ember_native_cache_size(vm, 1, &cache).as.number_val == 1);
+    assert(ember_native_cache_has(vm, 2, args).as.bool_val);
+    assert(ember_native_cache_delete(vm, 2, args).as.bool_val);
+    assert(ember_native_cache_prune(vm, 1, &cache).as.number_val == 0);
+    assert(ember_native_cache_clear(vm, 1, &cache).as.obj_val == cache.as.obj_val);
+    assert(stat(vm, cache, "max_entries") == 2 && stat(vm, cache, "misses") == 1);
+
+    // Bad bounds, TTLs and receivers
+    bounds[0] = ember_make_number(-1);
+    assert(ember_native_cache_new(vm, 1, bounds).type == EMBER_VAL_NIL);
+    bounds[0] = ember_make_number(1.5);
+    assert(ember_native_cache_new(vm, 1, bounds).type == EMBER_VAL_NIL);
+    assert(ember_native_cache_new(vm, 0, bounds).type == EMBER_VAL_NIL);
+    args[3] = ember_make_number(0);
+    assert(ember_native_cache_put(vm, 4, args).type == EMBER_VAL_NIL);
+    args[3] = text(vm, "1");
+    assert(ember_native_cache_put(vm, 4, args).type == EMBER_VAL_NIL);
+    args[0] = text(vm, "not a cache");
+    assert(ember_native_cache_get(vm, 2, args).type == EMBER_VAL_NIL);
+    assert(ember_native_cache_stats(vm, 1, args).type == EMBER_VAL_NIL);
+    ember_free_vm(vm);
+    printf("  ✓ cache natives store, read and refuse bad arguments\n");
+}
+
+int main(void) {
+    printf("Running LRU cache tests...\n");
+    test_eviction_order();
+    test_byte_bound();
+    test_ttl();
+    test_gc();
+    test_natives();
+    printf("All LRU cache tests passed!\n");
+    return 0;
+}
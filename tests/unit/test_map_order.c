@@ -0,0 +1,137 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/json_stream.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Enough keys for several rebuilds of the entries and the index
+#define MAP_TEST_KEYS 1000
+
+static ember_value new_map(ember_vm* vm) {
+    ember_value map = ember_make_map(vm);
+    assert(map.type == EMBER_VAL_MAP);
+    vm->stack[vm->stack_top++] = map;
+    return map;
+}
+
+static ember_value key_for(ember_vm* vm, int i) {
+    char text[16];
+    snprintf(text, sizeof(text), "k%d", i);
+    return ember_make_string_gc(vm, text);
+}
+
+void test_insertion_order(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_map* map = AS_MAP(new_map(vm));
+
+    // Numbers in an order that hashing would scramble
+    for (int i = 0; i < MAP_TEST_KEYS; i++) {
+        assert(map_set(map, ember_make_number((i * 7919) % MAP_TEST_KEYS), ember_make_number(i)));
+    }
+    assert(map->size == MAP_TEST_KEYS);
+    ember_value keys = map_keys(vm, map);
+    for (int i = 0; i < MAP_TEST_KEYS; i++) {
+        assert(AS_ARRAY(keys)->elements[i].as.number_val == (i * 7919) % MAP_TEST_KEYS);
+    }
+
+    // Overwriting keeps a key's place; deleting and adding again moves it last
+    assert(map_set(map, ember_make_number(0), ember_make_number(-1)));
+    assert(map_delete(map, ember_make_number(7919 % MAP_TEST_KEYS)));
+    assert(!map_delete(map, ember_make_number(7919 % MAP_TEST_KEYS)));
+    assert(map_set(map, ember_make_number(7919 % MAP_TEST_KEYS), ember_make_number(1)));
+    assert(map->size == MAP_TEST_KEYS);
+    ember_value iterator = map_entries_iterator(vm, map);
+    vm->stack[vm->stack_top++] = iterator;
+    ember_iterator_result first = iterator_next(AS_ITERATOR(iterator));
+    assert(!first.done && AS_ARRAY(first.value)->elements[0].as.number_val == 0);
+    assert(AS_ARRAY(first.value)->elements[1].as.number_val == -1);
+    ember_value values = map_values(vm, map);
+    assert(AS_ARRAY(values)->length == MAP_TEST_KEYS);
+    assert(AS_ARRAY(values)->elements[1].as.number_val == 2);
+    assert(AS_ARRAY(values)->elements[MAP_TEST_KEYS - 1].as.number_val == 1);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("  ✓ Keys come back in insertion order\n");
+}
+
+void test_delete_and_compact(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_map* map = AS_MAP(new_map(vm));
+    for (int i = 0; i < MAP_TEST_KEYS; i++) {
+        assert(map_set(map, key_for(vm, i), ember_make_number(i)));
+    }
+
+    // Churn at the front: holes are squeezed out rather than the table
+    // growing without bound
+    int capacity = map->capacity;
+    for (int round = 0; round < 4; round++) {
+        for (int i = 0; i < MAP_TEST_KEYS; i++) {
+            assert(map_delete(map, key_for(vm, i)));
+            assert(map_set(map, key_for(vm, i), ember_make_number(i)));
+        }
+    }
+    assert(map->size == MAP_TEST_KEYS && map->capacity <= 2 * capacity);
+    for (int i = 0; i < MAP_TEST_KEYS; i++) {
+        assert(map_get(map, key_for(vm, i)).as.number_val == i);
+    }
+
+    // Emptied down to a few keys, the storage shrinks and keeps the order
+    for (int i = 0; i < MAP_TEST_KEYS - 3; i++) {
+        assert(map_delete(map, key_for(vm, i)));
+    }
+    assert(map->size == 3 && map->capacity < capacity);
+    ember_value iterator = map_keys_iterator(vm, map);
+    vm->stack[vm->stack_top++] = iterator;
+    for (int i = MAP_TEST_KEYS - 3; i < MAP_TEST_KEYS; i++) {
+        ember_iterator_result next = iterator_next(AS_ITERATOR(iterator));
+        assert(!next.done && values_equal(next.value, key_for(vm, i)));
+    }
+    assert(iterator_next(AS_ITERATOR(iterator)).done);
+    assert(!map_has(map, key_for(vm, 0)));
+
+    map_clear(map);
+    assert(map->size == 0 && !map_has(map, key_for(vm, MAP_TEST_KEYS - 1)));
+    assert(map_set(map, key_for(vm, 1), ember_make_nil()) && map_has(map, key_for(vm, 1)));
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("  ✓ Deletes leave holes that rebuilds squeeze out\n");
+}
+
+void test_json_order(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value map = new_map(vm);
+    const char* names[] = {"zeta", "alpha", "mid", "beta"};
+    for (int i = 0; i < 4; i++) {
+        map_set(AS_MAP(map), ember_make_string_gc(vm, names[i]), ember_make_number(i));
+    }
+    map_delete(AS_MAP(map), ember_make_string_gc(vm, "mid"));
+
+    json_out out = {0};
+    assert(json_encode_value(&out, map));
+    assert(out.length == strlen("{\"zeta\":0,\"alpha\":1,\"beta\":3}"));
+    assert(memcmp(out.data, "{\"zeta\":0,\"alpha\":1,\"beta\":3}", out.length) == 0);
+    free(out.data);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("  ✓ Maps encode to JSON in insertion order\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running map order tests...\n");
+    test_insertion_order();
+    test_delete_and_compact();
+    test_json_order();
+    printf("All map order tests passed!\n");
+    return 0;
+}
@@ -1,5 +1,7 @@
 #include "ember.h"
 #include "../../src/runtime/package/package.h"
+#include "../../src/runtime/module_system.h"
+#include "test_ember_internal.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -146,8 +148,8 @@ void test_ember_import_module(void) {
 
     UNUSED(found);
     for (int i = 0; i < vm->module_count; i++) {
-        if (strcmp(vm->modules[i].name, "math_utils") == 0) {
-            assert(vm->modules[i].is_loaded == 1);
+        if (strcmp(vm->modules[i]->name, "math_utils") == 0) {
+            assert(vm->modules[i]->is_loaded == 1);
             found = 1;
             break;
         }
@@ -260,8 +262,8 @@ void test_module_integration(void) {
 
     UNUSED(found);
     for (int i = 0; i < vm->module_count; i++) {
-        if (strcmp(vm->modules[i].name, "integration_lib") == 0) {
-            assert(vm->modules[i].is_loaded == 1);
+        if (strcmp(vm->modules[i]->name, "integration_lib") == 0) {
+            assert(vm->modules[i]->is_loaded == 1);
             found = 1;
             break;
         }
@@ -355,6 +357,135 @@ void test_module_security(void) {
     printf("✓ Module security tests passed\n");
 }
 
+// Test 8: Registry and export slots grow past the old fixed limits
+void test_module_registry(void) {
+    printf("Testing module registry...\n");
+    
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    
+    char name[32];
+    ember_module* first = NULL;
+    for (int i = 0; i < 200; i++) {
+        snprintf(name, sizeof(name), "registry_mod_%d", i);
+        ember_module* module = ember_module_add(vm, name);
+        assert(module != NULL);
+        if (i == 0) first = module;
+    }
+    assert(vm->module_count >= 200);
+    // Entries don't move as the registry grows
+    assert(ember_module_find(vm, "registry_mod_0") == first);
+    assert(ember_module_add(vm, "registry_mod_0") == first);
+    assert(strcmp(ember_module_find(vm, "registry_mod_199")->name, "registry_mod_199") == 0);
+    assert(ember_module_find(vm, "registry_mod_200") == NULL);
+    
+    for (int i = 0; i < 1000; i++) {
+        snprintf(name, sizeof(name), "export_%d", i);
+        assert(ember_module_export_define(first, name, ember_make_number(i)) == i);
+    }
+    int slot = ember_module_export_find(first, "export_777", 10);
+    assert(slot == 777);
+    assert(first->exports[slot].value.as.number_val == 777);
+    // Keys are matched by length, not by prefix
+    assert(ember_module_export_find(first, "export_7770", 10) == 777);
+    assert(ember_module_export_find(first, "export_", 7) == -1);
+    assert(ember_module_export_find(first, "export_x", 8) == -1);
+    
+    // Re-exporting a name keeps its slot
+    assert(ember_module_export_define(first, "export_777", ember_make_number(-1)) == slot);
+    assert(first->exports[slot].value.as.number_val == -1);
+    assert(first->export_count == 1000);
+    
+    ember_free_vm(vm);
+    printf("✓ Module registry tests passed\n");
+}
+
+// Test 9: Resolution results, misses included, are cached until cleared
+void test_module_resolution_cache(void) {
+    printf("Testing module resolution cache...\n");
+    
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_add_module_path(vm, "/tmp/ember_test_modules");
+    
+    assert(ember_import_module(vm, "late_module") == -1);
+    create_test_module("late_module", "late_value = 1\n");
+    // Still the cached miss
+    assert(ember_import_module(vm, "late_module") == -1);
+    
+    ember_clear_module_resolution_cache();
+    assert(ember_import_module(vm, "late_module") == 0);
+    
+    ember_free_vm(vm);
+    printf("✓ Module resolution cache tests passed\n");
+}
+
+// Test 10: VMs importing the same file share one compiled image
+void test_module_image_sharing(void) {
+    printf("Testing shared module images...\n");
+    
+    create_test_module("shared_image", "fn shared_answer() { return 42 }\nshared_value = 1\n");
+    ember_vm* first = ember_new_vm();
+    ember_vm* second = ember_new_vm();
+    assert(first != NULL && second != NULL);
+    ember_add_module_path(first, "/tmp/ember_test_modules");
+    ember_add_module_path(second, "/tmp/ember_test_modules");
+    
+    assert(ember_import_module(first, "shared_image") == 0);
+    assert(ember_import_module(second, "shared_image") == 0);
+    ember_module* a = ember_module_find(first, "shared_image");
+    ember_module* b = ember_module_find(second, "shared_image");
+    assert(a && b && a->image && a->image == b->image);
+    assert(a->chunk->code_borrowed && a->chunk->code == b->chunk->code);
+    // Bindings stay per VM
+    assert(ember_global_find(first, "shared_value", 12) >= 0);
+    assert(ember_global_find(second, "shared_answer", 13) >= 0);
+    
+    // Changed on disk: the next import compiles a new image
+    create_test_module("shared_image", "shared_value = 2 + 2\n");
+    ember_vm* third = ember_new_vm();
+    assert(third != NULL);
+    ember_add_module_path(third, "/tmp/ember_test_modules");
+    assert(ember_import_module(third, "shared_image") == 0);
+    assert(ember_module_find(third, "shared_image")->image != a->image);
+    
+    ember_clear_module_images();
+    ember_free_vm(third);
+    ember_free_vm(second);
+    ember_free_vm(first);
+    printf("✓ Shared module image tests passed\n");
+}
+
+// Test 11: Core module exports and builtins are created when first used
+void test_lazy_core_modules(void) {
+    printf("Testing lazy core modules...\n");
+    
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value pi = ember_module_import_named(vm, "math", "PI");
+    assert(pi.type == EMBER_VAL_NUMBER && pi.as.number_val > 3.14);
+    ember_module* math = ember_module_find(vm, "core:math");
+    assert(math != NULL && math->export_count == 1);
+    
+    // The namespace is built once, then every export exists
+    ember_value first = ember_load_module(vm, "math", NULL);
+    ember_value second = ember_load_module(vm, "math", NULL);
+    assert(first.type == EMBER_VAL_HASH_MAP && first.as.obj_val == second.as.obj_val);
+    assert(math->export_count == 8);
+    assert(ember_core_module_export(vm, "os", "nope").type == EMBER_VAL_NIL);
+    ember_free_vm(vm);
+    
+    ember_vm* lazy = ember_new_vm_optimized(1);
+    assert(lazy != NULL);
+    int before = lazy->global_count;
+    int slot = ember_global_find(lazy, "sqrt", 4);
+    assert(slot >= 0 && lazy->global_count == before + 1);
+    assert(ember_global_find(lazy, "sqrt", 4) == slot);
+    assert(ember_global_find(lazy, "no_such_builtin", 15) == -1);
+    ember_free_vm(lazy);
+    printf("✓ Lazy core module tests passed\n");
+}
+
 int main(void) {
     printf("Starting Module API tests...\n\n");
     
@@ -367,6 +498,10 @@ int main(void) {
     test_module_integration();
     test_module_error_handling();
     test_module_security();
+    test_module_registry();
+    test_module_resolution_cache();
+    test_module_image_sharing();
+    test_lazy_core_modules();
     
     cleanup_test_environment();
     
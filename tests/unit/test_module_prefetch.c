@@ -0,0 +1,89 @@
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/module_prefetch.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+
+static void write_module(const char* dir, const char* name, const char* source) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s.ember", dir, name);
+    FILE* file = fopen(path, "w");
+    assert(file != NULL);
+    fputs(source, file);
+    fclose(file);
+}
+
+static void remove_module(const char* dir, const char* name) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s.ember", dir, name);
+    unlink(path);
+}
+
+static double global_number(ember_vm* vm, const char* name) {
+    int slot = ember_global_find(vm, name, (int)strlen(name));
+    assert(slot >= 0 && vm->globals[slot].value.type == EMBER_VAL_NUMBER);
+    return vm->globals[slot].value.as.number_val;
+}
+
+static int module_state(ember_vm* vm, const char* name) {
+    for (int i = 0; i < vm->module_count; i++) {
+        if (strcmp(vm->modules[i]->name, name) == 0) return vm->modules[i]->is_loaded;
+    }
+    return 0;
+}
+
+void test_prefetch_graph(void) {
+    char dir[] = "/tmp/ember_test_prefetch_XXXXXX";
+    assert(mkdtemp(dir) != NULL);
+    write_module(dir, "pf_base", "base_value = 40\n");
+    write_module(dir, "pf_mid", "import pf_base\nmid_value = base_value + 1\n");
+    write_module(dir, "pf_top", "import pf_mid\nimport pf_base\ntop_value = mid_value + 1\n");
+    write_module(dir, "pf_broken", "broken = (\n");
+    
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_add_module_path(vm, dir);
+    
+    // Every reachable module is compiled up front; missing ones are skipped
+    int compiled = ember_prefetch_imports(vm, "import pf_top\nimport pf_broken\nimport pf_missing\n", 2);
+    assert(compiled == 3);
+    assert(vm->module_prefetch != NULL && vm->module_prefetch->count == 4);
+    assert(vm->module_count == 0);
+    
+    // Linking runs dependencies first, each once
+    assert(ember_import_module(vm, "pf_top") == 0);
+    assert(module_state(vm, "pf_top") == 1);
+    assert(module_state(vm, "pf_mid") == 1);
+    assert(module_state(vm, "pf_base") == 1);
+    assert(global_number(vm, "top_value") == 42);
+    for (int i = 0; i < vm->module_prefetch->count; i++) {
+        ember_module_unit* unit = &vm->module_prefetch->units[i];
+        assert(unit->linked == (strcmp(unit->name, "pf_broken") != 0));
+    }
+    
+    // A unit that failed to compile takes the normal path, which reports it
+    assert(ember_import_module(vm, "pf_broken") == -1);
+    
+    ember_free_vm(vm);
+    remove_module(dir, "pf_base");
+    remove_module(dir, "pf_mid");
+    remove_module(dir, "pf_top");
+    remove_module(dir, "pf_broken");
+    rmdir(dir);
+    printf("Prefetch graph test passed\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running module prefetch tests...\n");
+    test_prefetch_graph();
+    printf("All module prefetch tests passed!\n");
+    return 0;
+}
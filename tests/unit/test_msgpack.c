@@ -0,0 +1,151 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Results stay on the stack, rooted, until the VM is freed
+static ember_value call(ember_vm* vm, ember_value (*native)(ember_vm*, int, ember_value*), ember_value arg) {
+    vm->stack[vm->stack_top++] = arg;
+    int top = vm->stack_top;
+    ember_value result = native(vm, 1, &vm->stack[top - 1]);
+    assert(vm->stack_top == top);
+    vm->stack[top - 1] = result;
+    return result;
+}
+
+static ember_value bytes(ember_vm* vm, const char* data, size_t length) {
+    return ember_make_string_len(vm, data, length);
+}
+
+static void assert_packs_to(ember_vm* vm, ember_value value, const char* expected, size_t length) {
+    ember_value packed = call(vm, ember_native_serialize, value);
+    assert(packed.type == EMBER_VAL_STRING);
+    assert((size_t)AS_STRING(packed)->length == length);
+    assert(memcmp(AS_CSTRING(packed), expected, length) == 0);
+}
+
+static ember_value round_trip(ember_vm* vm, ember_value value) {
+    ember_value packed = call(vm, ember_native_serialize, value);
+    assert(packed.type == EMBER_VAL_STRING);
+    return call(vm, ember_native_deserialize, packed);
+}
+
+void test_encodings(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+
+    // The smallest form of each, as other MessagePack libraries write it
+    assert_packs_to(vm, ember_make_nil(), "\xc0", 1);
+    assert_packs_to(vm, ember_make_bool(1), "\xc3", 1);
+    assert_packs_to(vm, ember_make_number(5), "\x05", 1);
+    assert_packs_to(vm, ember_make_number(-3), "\xfd", 1);
+    assert_packs_to(vm, ember_make_number(200), "\xcc\xc8", 2);
+    assert_packs_to(vm, ember_make_number(-200), "\xd1\xff\x38", 3);
+    assert_packs_to(vm, ember_make_number(70000), "\xce\x00\x01\x11\x70", 5);
+    assert_packs_to(vm, ember_make_number(1.5), "\xca\x3f\xc0\x00\x00", 5);
+    assert_packs_to(vm, ember_make_number(0.1), "\xcb\x3f\xb9\x99\x99\x99\x99\x99\x9a", 9);
+    assert_packs_to(vm, bytes(vm, "abc", 3), "\xa3" "abc", 4);
+
+    ember_value array = ember_make_array(vm, 2);
+    vm->stack[vm->stack_top++] = array;
+    array_push_with_vm(vm, AS_ARRAY(array), ember_make_number(1));
+    array_push_with_vm(vm, AS_ARRAY(array), bytes(vm, "x", 1));
+    assert_packs_to(vm, array, "\x92\x01\xa1x", 4);
+
+    ember_value map = ember_make_map(vm);
+    vm->stack[vm->stack_top++] = map;
+    map_set(AS_MAP(map), bytes(vm, "b", 1), ember_make_number(2));
+    map_set(AS_MAP(map), bytes(vm, "a", 1), ember_make_nil());
+    assert_packs_to(vm, map, "\x82\xa1" "b\x02\xa1" "a\xc0", 7);
+
+    ember_free_vm(vm);
+    printf("  ✓ Values pack to standard MessagePack\n");
+}
+
+void test_round_trip(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    assert(ember_eval(vm,
+        "doc = {\"id\": 12345678901, \"score\": -0.25, \"tags\": [\"a\", true, nil],\n"
+        "       \"nested\": {\"deep\": [[1], [2, [3]]]}, \"big\": 18446744073709551616}\n"
+        "long = \"\"\n"
+        "for (i = 0; i < 100; i = i + 1) { long = long + \"0123456789\" }\n") == 0);
+    int slot = ember_global_find(vm, "doc", 3);
+    ember_value doc = round_trip(vm, vm->globals[slot].value);
+    assert(doc.type == EMBER_VAL_HASH_MAP && AS_HASH_MAP(doc)->length == 5);
+    assert(hash_map_get(AS_HASH_MAP(doc), bytes(vm, "id", 2)).as.number_val == 12345678901.0);
+    assert(hash_map_get(AS_HASH_MAP(doc), bytes(vm, "score", 5)).as.number_val == -0.25);
+    assert(hash_map_get(AS_HASH_MAP(doc), bytes(vm, "big", 3)).as.number_val == 18446744073709551616.0);
+    ember_value tags = hash_map_get(AS_HASH_MAP(doc), bytes(vm, "tags", 4));
+    assert(AS_ARRAY(tags)->length == 3 && AS_ARRAY(tags)->elements[2].type == EMBER_VAL_NIL);
+    ember_value deep = hash_map_get(AS_HASH_MAP(hash_map_get(AS_HASH_MAP(doc), bytes(vm, "nested", 6))),
+                                    bytes(vm, "deep", 4));
+    assert(AS_ARRAY(AS_ARRAY(AS_ARRAY(deep)->elements[1])->elements[1])->elements[0].as.number_val == 3);
+
+    // Strings are binary-safe, and str 16 holds the long one
+    slot = ember_global_find(vm, "long", 4);
+    ember_value packed = call(vm, ember_native_serialize, vm->globals[slot].value);
+    assert((uint8_t)AS_CSTRING(packed)[0] == 0xDA && AS_STRING(packed)->length == 1003);
+    ember_value binary = round_trip(vm, bytes(vm, "a\0b", 3));
+    assert(AS_STRING(binary)->length == 3 && memcmp(AS_CSTRING(binary), "a\0b", 3) == 0);
+
+    // Extreme numbers survive
+    double numbers[] = {-0.0, 1e300, -9007199254740993.0, INFINITY, 4294967295.0, -2147483649.0};
+    for (size_t i = 0; i < sizeof(numbers) / sizeof(numbers[0]); i++) {
+        ember_value number = round_trip(vm, ember_make_number(numbers[i]));
+        assert(number.as.number_val == numbers[i] && signbit(number.as.number_val) == signbit(numbers[i]));
+    }
+    assert(isnan(round_trip(vm, ember_make_number(NAN)).as.number_val));
+
+    ember_free_vm(vm);
+    printf("  ✓ Values round-trip through serialize and deserialize\n");
+}
+
+void test_foreign_and_malformed(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+
+    // bin, uint 64 and fixmap from other writers
+    ember_value value = call(vm, ember_native_deserialize, bytes(vm, "\x81\xc4\x02hi\xcf\x00\x00\x00\x01\x00\x00\x00\x00", 14));
+    assert(value.type == EMBER_VAL_HASH_MAP);
+    assert(hash_map_get(AS_HASH_MAP(value), bytes(vm, "hi", 2)).as.number_val == 4294967296.0);
+
+    // Truncated, trailing bytes, never-used and ext tags, huge counts
+    assert(call(vm, ember_native_deserialize, bytes(vm, "\x92\x01", 2)).type == EMBER_VAL_NIL);
+    assert(call(vm, ember_native_deserialize, bytes(vm, "\x01\x02", 2)).type == EMBER_VAL_NIL);
+    assert(call(vm, ember_native_deserialize, bytes(vm, "\xc1", 1)).type == EMBER_VAL_NIL);
+    assert(call(vm, ember_native_deserialize, bytes(vm, "\xd4\x01\x00", 3)).type == EMBER_VAL_NIL);
+    assert(call(vm, ember_native_deserialize, bytes(vm, "\xdd\xff\xff\xff\xff", 5)).type == EMBER_VAL_NIL);
+    assert(call(vm, ember_native_deserialize, bytes(vm, "", 0)).type == EMBER_VAL_NIL);
+
+    // Cycles and code have no serialized form
+    assert(ember_eval(vm, "loop = [1]\nloop[0] = loop\nfn f() { return 1 }\n") == 0);
+    int slot = ember_global_find(vm, "loop", 4);
+    assert(call(vm, ember_native_serialize, vm->globals[slot].value).type == EMBER_VAL_NIL);
+    slot = ember_global_find(vm, "f", 1);
+    assert(call(vm, ember_native_serialize, vm->globals[slot].value).type == EMBER_VAL_NIL);
+
+    // The scripts see the same pair
+    assert(ember_eval(vm, "copy = deserialize(serialize({\"n\": [1, 2, 3]}))\ntotal = copy[\"n\"][2]\n") == 0);
+    slot = ember_global_find(vm, "total", 5);
+    assert(vm->globals[slot].value.as.number_val == 3);
+
+    ember_free_vm(vm);
+    printf("  ✓ Foreign and malformed input is handled\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running MessagePack tests...\n");
+    test_encodings();
+    test_round_trip();
+    test_foreign_and_malformed();
+    printf("All MessagePack tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include "ember.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int native_calls = 0;
+
+static ember_value native_scale(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    native_calls++;
+    double factor = argc > 1 ? argv[1].as.number_val : 2;
+    return ember_make_number(argv[0].as.number_val * factor);
+}
+
+static ember_value native_plain(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    (void)argv;
+    return ember_make_number(argc);
+}
+
+static double global_number(ember_vm* vm, const char* name) {
+    int slot = ember_global_find(vm, name, (int)strlen(name));
+    assert(slot >= 0);
+    return vm->globals[slot].value.as.number_val;
+}
+
+void test_described_native(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_native_info info = {
+        native_scale, 1, 2,
+        {EMBER_TYPE_MASK(EMBER_VAL_NUMBER), EMBER_TYPE_MASK(EMBER_VAL_NUMBER)},
+        EMBER_NATIVE_PURE | EMBER_NATIVE_NO_GC | EMBER_NATIVE_NO_THROW
+    };
+    assert(ember_register_native(vm, "scale", &info) == 0);
+
+    const ember_native_info* described = ember_native_describe(vm, native_scale);
+    assert(described != NULL && described->max_args == 2);
+    assert(described->flags & EMBER_NATIVE_PURE);
+
+    assert(ember_eval(vm, "a = scale(4)\nb = scale(4, 3)\n") == 0);
+    assert(global_number(vm, "a") == 8 && global_number(vm, "b") == 12);
+    assert(native_calls == 2);
+
+    // Wrong counts and types never reach the function
+    assert(ember_eval(vm,
+        "c = scale()\n"
+        "d = scale(1, 2, 3)\n"
+        "e = scale(\"4\")\n"
+        "f = scale(4, [3])\n") == 0);
+    assert(native_calls == 2);
+    const char* refused[] = {"c", "d", "e", "f"};
+    for (int i = 0; i < 4; i++) {
+        int slot = ember_global_find(vm, refused[i], 1);
+        assert(vm->globals[slot].value.type == EMBER_VAL_NIL);
+    }
+
+    // Plain registration is untouched
+    ember_register_func(vm, "plain", native_plain);
+    assert(ember_native_describe(vm, native_plain) == NULL);
+    assert(ember_eval(vm, "g = plain(1, \"x\", [])\n") == 0);
+    assert(global_number(vm, "g") == 3);
+
+    ember_free_vm(vm);
+    printf("  ✓ Described natives have their arguments checked by the VM\n");
+}
+
+void test_invalid_info(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_native_info info = {native_scale, 2, 1, {0}, 0};
+    assert(ember_register_native(vm, "bad", &info) == -1);
+    info.min_args = 0;
+    info.max_args = EMBER_NATIVE_VARIADIC;
+    info.flags = 1u << 20;
+    assert(ember_register_native(vm, "bad", &info) == -1);
+    assert(ember_register_native(vm, "bad", NULL) == -1);
+    assert(ember_global_find(vm, "bad", 3) < 0);
+
+    info.flags = 0;
+    assert(ember_register_native(vm, "any", &info) == 0);
+    ember_free_vm(vm);
+    printf("  ✓ Inconsistent descriptions are refused\n");
+}
+
+void test_builtins_described(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    assert(ember_eval(vm,
+        "x = abs(-3) + floor(2.5) + pow(2, 3) + len(\"abc\") + len([1, 2])\n"
+        "y = abs(\"-3\")\n"
+        "z = len(\"ab\" + \"cd\")\n") == 0);
+    assert(global_number(vm, "x") == 3 + 2 + 8 + 3 + 2);
+    assert(vm->globals[ember_global_find(vm, "y", 1)].value.type == EMBER_VAL_NIL);
+    assert(global_number(vm, "z") == 4);
+
+    const ember_native_info* info = ember_native_describe(vm, ember_native_abs);
+    assert(info != NULL);
+    assert((info->flags & (EMBER_NATIVE_PURE | EMBER_NATIVE_NO_GC)) == (EMBER_NATIVE_PURE | EMBER_NATIVE_NO_GC));
+    assert(ember_native_describe(vm, ember_native_len)->flags & EMBER_NATIVE_ROPES);
+
+    // len counts a GC string's bytes, NULs included
+    ember_value bytes = ember_make_string_len(vm, "a\0b", 3);
+    assert(ember_native_len(vm, 1, &bytes).as.number_val == 3);
+
+    ember_free_vm(vm);
+    printf("  ✓ Math builtins and len are described\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running native info tests...\n");
+    test_described_native();
+    test_invalid_info();
+    test_builtins_described();
+    printf("All native info tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,188 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "../../src/core/object_shape.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static ember_value name_value(ember_vm* vm, const char* name) {
+    ember_value value = ember_make_string_gc(vm, name);
+    assert(value.type == EMBER_VAL_STRING);
+    return value;
+}
+
+static void set_field(ember_vm* vm, ember_value instance, const char* name, double number) {
+    assert(ember_instance_set_field(vm, AS_INSTANCE(instance), name_value(vm, name), ember_make_number(number)));
+}
+
+static double get_field(ember_vm* vm, ember_value instance, const char* name) {
+    ember_value value;
+    assert(ember_instance_get_field(AS_INSTANCE(instance), name_value(vm, name), &value));
+    assert(value.type == EMBER_VAL_NUMBER);
+    return value.as.number_val;
+}
+
+void test_shared_shapes(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value klass = ember_make_class(vm, "Point");
+    vm->stack[vm->stack_top++] = klass;
+
+    // Same fields in the same order share a layout
+    ember_value a = ember_make_instance(vm, AS_CLASS(klass));
+    vm->stack[vm->stack_top++] = a;
+    ember_value b = ember_make_instance(vm, AS_CLASS(klass));
+    vm->stack[vm->stack_top++] = b;
+    set_field(vm, a, "x", 1);
+    set_field(vm, a, "y", 2);
+    set_field(vm, b, "x", 3);
+    set_field(vm, b, "y", 4);
+    assert(AS_INSTANCE(a)->shape == AS_INSTANCE(b)->shape);
+    assert(AS_INSTANCE(a)->shape->field_count == 2);
+    assert(AS_INSTANCE(a)->slots == AS_INSTANCE(a)->inline_slots);
+    assert(get_field(vm, a, "y") == 2 && get_field(vm, b, "x") == 3);
+
+    // Overwriting keeps the layout; another order makes another one
+    set_field(vm, a, "x", 10);
+    assert(AS_INSTANCE(a)->shape == AS_INSTANCE(b)->shape);
+    assert(get_field(vm, a, "x") == 10);
+    ember_value c = ember_make_instance(vm, AS_CLASS(klass));
+    vm->stack[vm->stack_top++] = c;
+    set_field(vm, c, "y", 5);
+    set_field(vm, c, "x", 6);
+    assert(AS_INSTANCE(c)->shape != AS_INSTANCE(a)->shape);
+    assert(AS_INSTANCE(c)->shape->field_count == 2);
+
+    // Outgrowing the inline slots moves them out; later instances are larger
+    int inline_capacity = AS_INSTANCE(a)->inline_capacity;
+    for (int i = 0; i < 10; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "f%d", i);
+        set_field(vm, a, name, i);
+    }
+    assert(AS_INSTANCE(a)->slots != AS_INSTANCE(a)->inline_slots);
+    assert(ember_instance_field_count(AS_INSTANCE(a)) == 12);
+    assert(get_field(vm, a, "f9") == 9 && get_field(vm, a, "y") == 2);
+    ember_value d = ember_make_instance(vm, AS_CLASS(klass));
+    assert(AS_INSTANCE(d)->inline_capacity == 12);
+    assert(AS_INSTANCE(d)->inline_capacity > inline_capacity);
+
+    // Field values are traced
+    ember_gc_configure(vm, 0, 1, 1, 0);
+    ember_gc_collect(vm);
+    assert(get_field(vm, b, "y") == 4 && get_field(vm, a, "f3") == 3);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("Shared shape test passed\n");
+}
+
+void test_dictionary_mode(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value klass = ember_make_class(vm, "Bag");
+    vm->stack[vm->stack_top++] = klass;
+    ember_value bag = ember_make_instance(vm, AS_CLASS(klass));
+    vm->stack[vm->stack_top++] = bag;
+
+    for (int i = 0; i <= EMBER_SHAPE_MAX_FIELDS; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "k%d", i);
+        set_field(vm, bag, name, i);
+    }
+    assert(AS_INSTANCE(bag)->shape == NULL);
+    assert(AS_INSTANCE(bag)->fields != NULL);
+    assert(ember_instance_field_count(AS_INSTANCE(bag)) == EMBER_SHAPE_MAX_FIELDS + 1);
+    assert(get_field(vm, bag, "k0") == 0);
+    assert(get_field(vm, bag, "k64") == 64);
+    set_field(vm, bag, "k1", 100);
+    assert(get_field(vm, bag, "k1") == 100);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("Dictionary mode test passed\n");
+}
+
+void test_property_inline_caches(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value point = ember_make_class(vm, "Point");
+    vm->stack[vm->stack_top++] = point;
+    ember_value other = ember_make_class(vm, "Other");
+    vm->stack[vm->stack_top++] = other;
+    ember_value p = ember_make_instance(vm, AS_CLASS(point));
+    vm->stack[vm->stack_top++] = p;
+    ember_value q = ember_make_instance(vm, AS_CLASS(other));
+    vm->stack[vm->stack_top++] = q;
+    int base = vm->stack_top;
+
+    ember_value constants[1] = {name_value(vm, "x")};
+    ember_chunk chunk;
+    memset(&chunk, 0, sizeof(chunk));
+    chunk.constants = constants;
+    chunk.const_count = 1;
+    chunk.const_capacity = 1;
+
+    // A store that adds the field caches the transition
+    vm->stack[vm->stack_top++] = p;
+    vm->stack[vm->stack_top++] = ember_make_number(7);
+    assert(vm_handle_set_property(vm, &chunk, 0) == VM_RESULT_OK);
+    assert(vm->stack_top == base + 1 && vm->stack[base].as.number_val == 7);
+    vm->stack_top = base;
+    assert(chunk.property_cache_count == 1);
+    assert(chunk.property_cache[0].set[0].target == AS_INSTANCE(p)->shape);
+
+    // A second instance takes the cached transition
+    ember_value p2 = ember_make_instance(vm, AS_CLASS(point));
+    vm->stack[vm->stack_top++] = p2;
+    base = vm->stack_top;
+    vm->stack[vm->stack_top++] = p2;
+    vm->stack[vm->stack_top++] = ember_make_number(8);
+    assert(vm_handle_set_property(vm, &chunk, 0) == VM_RESULT_OK);
+    vm->stack_top = base;
+    assert(AS_INSTANCE(p2)->shape == AS_INSTANCE(p)->shape);
+    assert(chunk.property_cache[0].set[1].shape_id == 0);
+
+    // Reads are monomorphic, then polymorphic across classes
+    vm->stack[vm->stack_top++] = p2;
+    assert(vm_handle_get_property(vm, &chunk, 0) == VM_RESULT_OK);
+    assert(vm->stack[vm->stack_top - 1].as.number_val == 8);
+    vm->stack_top = base;
+    assert(chunk.property_cache[0].get[0].shape_id == AS_INSTANCE(p)->shape->id);
+    set_field(vm, q, "y", 1);
+    set_field(vm, q, "x", 2);
+    vm->stack[vm->stack_top++] = q;
+    assert(vm_handle_get_property(vm, &chunk, 0) == VM_RESULT_OK);
+    assert(vm->stack[vm->stack_top - 1].as.number_val == 2);
+    vm->stack_top = base;
+    assert(chunk.property_cache[0].get[1].shape_id == AS_INSTANCE(q)->shape->id);
+    assert(chunk.property_cache[0].get[1].slot == 1);
+
+    // Missing fields (methods) and non-instances take the general path
+    ember_value empty = ember_make_instance(vm, AS_CLASS(other));
+    vm->stack[vm->stack_top++] = empty;
+    assert(vm_handle_get_property(vm, &chunk, 0) == VM_RESULT_CONTINUE);
+    vm->stack[vm->stack_top - 1] = ember_make_number(1);
+    assert(vm_handle_get_property(vm, &chunk, 0) == VM_RESULT_CONTINUE);
+    vm->stack_top = base;
+
+    ember_chunk_free_global_cache(&chunk);
+    assert(chunk.property_cache == NULL && chunk.property_cache_count == 0);
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("Property inline cache test passed\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running object shape tests...\n");
+    test_shared_shapes();
+    test_dictionary_mode();
+    test_property_inline_caches();
+    printf("All object shape tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,193 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "../../src/core/object_slab.h"
+#include "../../src/core/huge_pages.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+void test_slab_alloc_free(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    int baseline = vm->slab_count;
+
+    // Oversized requests are left to malloc
+    assert(object_slab_alloc(vm, EMBER_SLAB_MAX_OBJECT + 1) == NULL);
+
+    enum { COUNT = 5000 };
+    ember_object** objects = malloc(sizeof(ember_object*) * COUNT);
+    assert(objects != NULL);
+    for (int i = 0; i < COUNT; i++) {
+        objects[i] = object_slab_alloc(vm, sizeof(ember_array));
+        assert(objects[i] != NULL);
+        assert(((uintptr_t)objects[i] % EMBER_SLAB_GRANULE) == 0);
+        objects[i]->in_slab = 1;
+        memset(objects[i] + 1, 0xAB, sizeof(ember_array) - sizeof(ember_object));
+    }
+    // Consecutive allocations are adjacent within a slab
+    uintptr_t stride = (uintptr_t)objects[1] - (uintptr_t)objects[0];
+    assert(stride >= sizeof(ember_array) && stride < sizeof(ember_array) + EMBER_SLAB_GRANULE);
+    int slabs = vm->slab_count - baseline;
+    assert(slabs > 1);
+
+    // Freed slots are reused before a new slab is taken
+    for (int i = 0; i < COUNT; i += 2) {
+        object_slab_free(objects[i]);
+    }
+    for (int i = 0; i < COUNT; i += 2) {
+        objects[i] = object_slab_alloc(vm, sizeof(ember_array));
+        objects[i]->in_slab = 1;
+    }
+    assert(vm->slab_count - baseline == slabs);
+
+    // Empty slabs go back to the system
+    for (int i = 0; i < COUNT; i++) {
+        free_object_storage(objects[i]);
+    }
+    assert(vm->slab_count == baseline);
+    free(objects);
+    ember_free_vm(vm);
+    printf("Slab alloc/free test passed\n");
+}
+
+void test_size_classes(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    int baseline = vm->slab_count;
+
+    ember_object* small = object_slab_alloc(vm, 24);
+    ember_object* large = object_slab_alloc(vm, EMBER_SLAB_MAX_OBJECT);
+    assert(small != NULL && large != NULL);
+    uintptr_t mask = ~(uintptr_t)(EMBER_SLAB_SIZE - 1);
+    assert(((uintptr_t)small & mask) != ((uintptr_t)large & mask));
+    assert(vm->slab_count == baseline + 2);
+    object_slab_free(small);
+    object_slab_free(large);
+    assert(vm->slab_count == baseline);
+    ember_free_vm(vm);
+    printf("Slab size class test passed\n");
+}
+
+void test_rebuild_free_lists(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    int baseline = vm->slab_count;
+
+    // Fill one slab of the largest class
+    enum { MAX = EMBER_SLAB_SIZE / EMBER_SLAB_MAX_OBJECT };
+    ember_object* objects[MAX];
+    int count = 0;
+    for (;;) {
+        ember_object* object = object_slab_alloc(vm, EMBER_SLAB_MAX_OBJECT);
+        assert(object != NULL && count < MAX);
+        if (vm->slab_count > baseline + 1) {
+            object_slab_free(object);
+            break;
+        }
+        objects[count++] = object;
+    }
+    assert(vm->slab_count == baseline + 1 && count > 20);
+
+    // Freed back to front, as a sweep of vm->objects would
+    // Even, so the slot before it stays in use and bounds the tail
+    int tail = (count - 10) & ~1;
+    for (int i = count - 1; i >= 0; i--) {
+        if (i % 2 == 0 || i >= tail) object_slab_free(objects[i]);
+    }
+
+    // The free tail is bumped again first, then the holes go in address order
+    object_slab_rebuild_free_lists(vm);
+    for (int i = tail; i < count; i++) {
+        assert(object_slab_alloc(vm, EMBER_SLAB_MAX_OBJECT) == objects[i]);
+    }
+    for (int i = 0; i < tail; i += 2) {
+        assert(object_slab_alloc(vm, EMBER_SLAB_MAX_OBJECT) == objects[i]);
+    }
+    assert(vm->slab_count == baseline + 1);
+    for (int i = 0; i < count; i++) {
+        object_slab_free(objects[i]);
+    }
+    assert(vm->slab_count == baseline);
+    ember_free_vm(vm);
+    printf("Slab free list rebuild test passed\n");
+}
+
+void test_huge_page_regions(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    int slabs = vm->slab_count;
+    if (!ember_vm_set_huge_pages(vm, 1)) {
+        // Unsupported here: slabs are allocated on their own as before
+        assert(!vm->huge_pages);
+        ember_object* object = object_slab_alloc(vm, 48);
+        assert(object != NULL && vm->slab_region_count == 0);
+        object_slab_free(object);
+        ember_free_vm(vm);
+        printf("Huge page region test skipped (no huge pages)\n");
+        return;
+    }
+
+    // Slabs of different classes share one region until it is full
+    enum { CLASSES = 4 };
+    ember_object* objects[CLASSES];
+    uintptr_t region = 0;
+    for (int i = 0; i < CLASSES; i++) {
+        objects[i] = object_slab_alloc(vm, EMBER_SLAB_MAX_OBJECT - (size_t)i * EMBER_SLAB_GRANULE);
+        assert(objects[i] != NULL);
+        uintptr_t base = (uintptr_t)objects[i] & ~(uintptr_t)(EMBER_HUGE_PAGE_SIZE - 1);
+        assert(!region || base == region);
+        region = base;
+    }
+    assert(vm->slab_region_count == 1);
+    assert(vm->slab_count == slabs + CLASSES);
+
+    // The region is unmapped with its last slab
+    for (int i = 0; i < CLASSES; i++) {
+        object_slab_free(objects[i]);
+    }
+    assert(vm->slab_count == slabs && vm->slab_region_count == 0);
+
+    // Large element buffers are advised as they grow
+    ember_value array = ember_make_array(vm, 0);
+    vm->stack[vm->stack_top++] = array;
+    assert(array_reserve_with_vm(vm, AS_ARRAY(array), EMBER_HUGE_PAGE_SIZE / (int)sizeof(ember_value) * 2));
+    AS_ARRAY(array)->elements[AS_ARRAY(array)->capacity - 1] = ember_make_number(1);
+    assert(ember_vm_set_huge_pages(vm, 0) == 0 && !vm->huge_pages);
+    vm->stack_top--;
+    ember_free_vm(vm);
+    printf("Huge page region test passed\n");
+}
+
+#ifdef EMBER_SLAB_OBJECTS
+void test_allocate_object_uses_slabs(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+
+    ember_value array = ember_make_array(vm, 4);
+    assert(array.as.obj_val->in_slab);
+    ember_value string = ember_make_string_gc(vm, "short string in a slab");
+    assert(string.as.obj_val->in_slab);
+    assert(strcmp(AS_CSTRING(string), "short string in a slab") == 0);
+    ember_free_vm(vm);
+    printf("allocate_object slab test passed\n");
+}
+#endif
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running object slab tests...\n");
+    test_slab_alloc_free();
+    test_size_classes();
+    test_rebuild_free_lists();
+    test_huge_page_regions();
+#ifdef EMBER_SLAB_OBJECTS
+    test_allocate_object_uses_slabs();
+#endif
+    printf("All object slab tests passed!\n");
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "ember.h"
+#include "test_ember_internal.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -51,7 +52,7 @@ void test_instance_creation() {
     UNUSED(instance_val);
     assert(instance_val.type == EMBER_VAL_INSTANCE);
     assert(AS_INSTANCE(instance_val)->klass == klass);
-    assert(AS_INSTANCE(instance_val)->fields != NULL);
+    assert(AS_INSTANCE(instance_val)->shape != NULL);
     
     ember_free_vm(vm);
     printf("✓ Instance creation test passed\n");
@@ -80,8 +81,14 @@ void test_property_access() {
 
     UNUSED(instance);
     
-    // Test that fields hash map is initialized
-    assert(instance->fields != NULL);
+    // Fields start in the class's empty shape and are added on assignment
+    assert(instance->shape != NULL);
+    ember_value name = ember_make_string_gc(vm, "x");
+    ember_value value;
+    assert(!ember_instance_get_field(instance, name, &value));
+    assert(ember_instance_set_field(vm, instance, name, ember_make_number(5)));
+    assert(ember_instance_get_field(instance, name, &value));
+    assert(value.type == EMBER_VAL_NUMBER && value.as.number_val == 5);
     
     ember_free_vm(vm);
     printf("✓ Property access test passed\n");
@@ -210,7 +217,7 @@ void test_garbage_collection() {
         UNUSED(instance);
         
         // Verify instance was created
-        assert(instance->fields != NULL);
+        assert(instance->shape != NULL);
     }
     
     // Trigger garbage collection
@@ -272,14 +272,14 @@ void test_constant_folding_comparison(void) {
     assert(optimizations > 0);
     assert(stats.constant_folded > 0);
     
-    // Should be optimized to single PUSH_CONST 1.0 (true)
+    // Should be optimized to single PUSH_CONST true
     assert(chunk->count == 2);
     assert(chunk->code[0] == OP_PUSH_CONST);
     
     uint8_t result_idx = chunk->code[1];
     assert(result_idx < chunk->const_count);
-    assert(chunk->constants[result_idx].type == EMBER_VAL_NUMBER);
-    assert(chunk->constants[result_idx].as.number_val == 1.0);
+    assert(chunk->constants[result_idx].type == EMBER_VAL_BOOL);
+    assert(chunk->constants[result_idx].as.bool_val);
     
     free_test_chunk(chunk);
     printf("Constant folding comparison test passed\n");
@@ -386,7 +386,7 @@ void test_jump_optimization_conditional_next(void) {
     printf("Jump optimization conditional next test passed\n");
 }
 
-// Test strength reduction - multiplication by power of 2
+// Test strength reduction - division by power of 2 becomes multiplication
 void test_strength_reduction_multiplication(void) {
     ember_chunk* chunk = create_test_chunk();
 
@@ -410,9 +410,9 @@ void test_strength_reduction_multiplication(void) {
     UNUSED(operand_idx);
     add_instruction_with_param(chunk, OP_PUSH_CONST, operand_idx);
     
-    // Add pattern: PUSH_CONST 8, MUL
+    // Add pattern: PUSH_CONST 8, DIV
     add_instruction_with_param(chunk, OP_PUSH_CONST, const_idx);
-    add_instruction(chunk, OP_MUL);
+    add_instruction(chunk, OP_DIV);
     
     ember_optimization_stats stats;
     ember_init_optimization_stats(&stats);
@@ -425,6 +425,12 @@ void test_strength_reduction_multiplication(void) {
     assert(optimizations > 0);
     assert(stats.strength_reduced > 0);
     
+    // Should be rewritten to: PUSH_CONST 5, PUSH_CONST 0.125, MUL
+    assert(chunk->count == 5);
+    assert(chunk->code[2] == OP_PUSH_CONST);
+    assert(chunk->constants[chunk->code[3]].as.number_val == 0.125);
+    assert(chunk->code[4] == OP_MUL);
+    
     free_test_chunk(chunk);
     printf("Strength reduction multiplication test passed\n");
 }
@@ -460,18 +466,18 @@ void test_strength_reduction_multiplication_by_zero(void) {
     ember_optimization_stats stats;
     ember_init_optimization_stats(&stats);
     
+    int original_count = chunk->count;
+    
     int optimizations = ember_optimize_strength_reduction(chunk, &stats);
 
     
     UNUSED(optimizations);
     
-    assert(optimizations > 0);
-    assert(stats.strength_reduced > 0);
-    
-    // Should be optimized to: POP, PUSH_CONST 0
-    assert(chunk->count == 3);
-    assert(chunk->code[0] == OP_POP);
-    assert(chunk->code[1] == OP_PUSH_CONST);
+    // x * 0 is not always 0 (NaN, infinities, -0), so it must be left alone
+    assert(optimizations == 0);
+    assert(stats.strength_reduced == 0);
+    assert(chunk->count == original_count);
+    assert(chunk->code[4] == OP_MUL);
     
     free_test_chunk(chunk);
     printf("Strength reduction multiplication by zero test passed\n");
@@ -509,10 +515,138 @@ void test_instruction_fusion_increment(void) {
     assert(optimizations > 0);
     assert(stats.instruction_fused > 0);
     
+    // The stored value is still used, so it is reloaded after the fused add
+    assert(chunk->count == 7);
+    assert(chunk->code[0] == OP_ADD_LOCAL_CONST);
+    assert(chunk->code[5] == OP_GET_LOCAL);
+    assert(chunk->code[6] == 0);
+    
     free_test_chunk(chunk);
     printf("Instruction fusion increment test passed\n");
 }
 
+// Test instruction fusion - loop condition on a local and a constant
+void test_instruction_fusion_compare_branch(void) {
+    ember_chunk* chunk = create_test_chunk();
+    assert(chunk != NULL);
+    
+    ember_value limit_val = {EMBER_VAL_NUMBER, {.number_val = 10.0}};
+    int limit_idx = add_constant(chunk, limit_val);
+    ember_value one_val = {EMBER_VAL_NUMBER, {.number_val = 1.0}};
+    int one_idx = add_constant(chunk, one_val);
+    
+    // while (i < 10) { i = i + 1 }
+    add_instruction_with_param(chunk, OP_GET_LOCAL, 1);            // 0: loop start
+    add_instruction_with_param(chunk, OP_PUSH_CONST, limit_idx);   // 2
+    add_instruction(chunk, OP_LESS);                                // 4
+    add_instruction_with_param(chunk, OP_JUMP_IF_FALSE, 10);       // 5: exit to HALT at 17
+    add_instruction_with_param(chunk, OP_GET_LOCAL, 1);            // 7
+    add_instruction_with_param(chunk, OP_PUSH_CONST, one_idx);     // 9
+    add_instruction(chunk, OP_ADD);                                 // 11
+    add_instruction_with_param(chunk, OP_SET_LOCAL, 1);            // 12
+    add_instruction(chunk, OP_POP);                                 // 14
+    add_instruction_with_param(chunk, OP_LOOP, 18);                // 15: back to 0
+    add_instruction(chunk, OP_HALT);                                // 17
+    
+    ember_optimization_stats stats;
+    ember_init_optimization_stats(&stats);
+    
+    int optimizations = ember_optimize_instruction_fusion(chunk, &stats);
+    assert(optimizations == 2);
+    assert(stats.instruction_fused == 2);
+    
+    // Loop body reduced to: test-and-branch, fused add, LOOP
+    assert(chunk->count == 15);
+    assert(chunk->code[0] == OP_LOCAL_LESS_CONST_JUMP_IF_FALSE);
+    assert(read_chunk_u16(chunk, 1) == 1);
+    assert(read_chunk_u16(chunk, 3) == limit_idx);
+    assert(7 + read_chunk_u16(chunk, 5) == 14);  // Exit lands on HALT
+    assert(chunk->code[7] == OP_ADD_LOCAL_CONST);
+    assert(chunk->code[12] == OP_LOOP);
+    assert(14 + 1 - chunk->code[13] == 0);      // Back edge lands on the test
+    assert(chunk->code[14] == OP_HALT);
+    
+    free_test_chunk(chunk);
+    printf("Instruction fusion compare and branch test passed\n");
+}
+
+void test_tail_calls(void) {
+    ember_chunk* chunk = create_test_chunk();
+    assert(chunk != NULL);
+    
+    // return f(n); f(n); return nil
+    add_instruction_with_param(chunk, OP_GET_LOCAL, 0);     // 0
+    add_instruction_with_param(chunk, OP_GET_GLOBAL, 0);    // 2
+    add_instruction_with_param(chunk, OP_CALL, 1);          // 4
+    add_instruction(chunk, OP_RETURN);                       // 6
+    add_instruction_with_param(chunk, OP_GET_LOCAL, 0);     // 7
+    add_instruction_with_param(chunk, OP_GET_GLOBAL, 0);    // 9
+    add_instruction_with_param(chunk, OP_CALL, 1);          // 11
+    add_instruction(chunk, OP_POP);                          // 13
+    add_instruction(chunk, OP_RETURN);                       // 14
+    
+    ember_optimization_stats stats;
+    ember_init_optimization_stats(&stats);
+    
+    assert(ember_optimize_tail_calls(chunk, &stats) == 1);
+    assert(stats.tail_calls == 1);
+    assert(chunk->count == 15);
+    assert(chunk->code[4] == OP_TAIL_CALL);
+    assert(chunk->code[5] == 1);
+    assert(chunk->code[6] == OP_RETURN);   // Kept for native callees
+    assert(chunk->code[11] == OP_CALL);
+    
+    // Exception handlers need the frame to outlive the call
+    ember_chunk* guarded = create_test_chunk();
+    assert(guarded != NULL);
+    add_instruction_with_param(guarded, OP_TRY_BEGIN, 0);
+    add_instruction_with_param(guarded, OP_GET_GLOBAL, 0);
+    add_instruction_with_param(guarded, OP_CALL, 0);
+    add_instruction(guarded, OP_RETURN);
+    assert(ember_optimize_tail_calls(guarded, &stats) == 0);
+    assert(guarded->code[4] == OP_CALL);
+    
+    free_test_chunk(guarded);
+    free_test_chunk(chunk);
+    printf("Tail call test passed\n");
+}
+
+// Exception table offsets follow the code they cover
+void test_exception_table_remap(void) {
+    ember_chunk* chunk = create_test_chunk();
+    assert(chunk != NULL);
+    int two = add_constant(chunk, ember_make_number(2));
+    int three = add_constant(chunk, ember_make_number(3));
+    
+    add_instruction_with_param(chunk, OP_PUSH_CONST, (uint8_t)two);    // 0: try block
+    add_instruction_with_param(chunk, OP_PUSH_CONST, (uint8_t)three);  // 2
+    add_instruction(chunk, OP_ADD);                                    // 4
+    add_instruction_with_param(chunk, OP_SET_GLOBAL, 0);               // 5
+    add_instruction_with_param(chunk, OP_JUMP, 3);                     // 7: over the catch block
+    add_instruction_with_param(chunk, OP_CATCH_BEGIN, 0xFF);           // 9
+    add_instruction(chunk, OP_CATCH_END);                              // 11
+    add_instruction(chunk, OP_HALT);                                   // 12
+    ember_handler_entry entry = {0, 7, 9, 0, EMBER_HANDLER_CATCH};
+    assert(ember_chunk_add_handler(chunk, &entry) == 0);
+    
+    ember_optimization_stats stats;
+    ember_init_optimization_stats(&stats);
+    assert(ember_optimize_chunk(chunk, OPT_ALL, &stats) > 0);
+    assert(stats.constant_folded == 1);
+    
+    // The folded try block is shorter; the catch block is still there
+    const ember_handler_entry* remapped = &chunk->handlers[0];
+    assert(remapped->start == 0 && remapped->end == 4);
+    assert(chunk->code[remapped->end] == OP_JUMP);
+    assert(chunk->code[remapped->handler] == OP_CATCH_BEGIN);
+    assert(ember_chunk_find_handler(chunk, 2) == remapped);
+    assert(ember_chunk_find_handler(chunk, remapped->handler) == NULL);
+    
+    ember_chunk_free_handlers(chunk);
+    free_test_chunk(chunk);
+    printf("Exception table remap test passed\n");
+}
+
 // Test pattern matching utility
 void test_pattern_matching(void) {
     ember_chunk* chunk = create_test_chunk();
@@ -589,18 +723,23 @@ void test_loop_optimization(void) {
     UNUSED(chunk);
     assert(chunk != NULL);
     
-    // Create a simple loop pattern with constant inside
+    // Create a while (true) loop with a constant inside
     ember_value val = {EMBER_VAL_NUMBER, {.number_val = 10.0}};
 
     UNUSED(val);
     int const_idx = add_constant(chunk, val);
 
     UNUSED(const_idx);
+    ember_value true_val = {EMBER_VAL_BOOL, {.bool_val = 1}};
+    int true_idx = add_constant(chunk, true_val);
     
-    // Simple loop: some instructions then LOOP back
-    add_instruction_with_param(chunk, OP_PUSH_CONST, const_idx); // Loop invariant
-    add_instruction(chunk, OP_ADD);
-    add_instruction_with_param(chunk, OP_LOOP, 3); // Loop back 3 instructions
+    // Loop header tests a constant condition, the body loops back to it
+    add_instruction_with_param(chunk, OP_PUSH_CONST, true_idx);  // 0: condition
+    add_instruction_with_param(chunk, OP_JUMP_IF_FALSE, 5);      // 2: exit to HALT at 9
+    add_instruction_with_param(chunk, OP_PUSH_CONST, const_idx); // 4: loop body
+    add_instruction(chunk, OP_POP);                              // 6
+    add_instruction_with_param(chunk, OP_LOOP, 10);              // 7: back to 0
+    add_instruction(chunk, OP_HALT);                             // 9
     
     ember_optimization_stats stats;
     ember_init_optimization_stats(&stats);
@@ -613,6 +752,10 @@ void test_loop_optimization(void) {
     assert(optimizations > 0);
     assert(stats.loop_optimized > 0);
     
+    // The back edge now skips the constant test and lands on the body
+    assert(chunk->code[7] == OP_LOOP);
+    assert(7 + 2 + 1 - chunk->code[8] == 4);
+    
     free_test_chunk(chunk);
     printf("Loop optimization test passed\n");
 }
@@ -624,10 +767,10 @@ void test_control_flow_optimization(void) {
     UNUSED(chunk);
     assert(chunk != NULL);
     
-    // Create jump chain: JUMP to JUMP
-    add_instruction_with_param(chunk, OP_JUMP, 2); // Jump to position 4
+    // Create jump chain: JUMP to JUMP, skipping an unreachable HALT
+    add_instruction_with_param(chunk, OP_JUMP, 1); // Jump to position 3
     add_instruction(chunk, OP_HALT);
-    add_instruction_with_param(chunk, OP_JUMP, 2); // Another jump at position 4
+    add_instruction_with_param(chunk, OP_JUMP, 0); // Another jump at position 3
     add_instruction(chunk, OP_HALT);
     
     ember_optimization_stats stats;
@@ -941,6 +1084,9 @@ int main(int argc, char* argv[]) {
     test_strength_reduction_multiplication();
     test_strength_reduction_multiplication_by_zero();
     test_instruction_fusion_increment();
+    test_instruction_fusion_compare_branch();
+    test_tail_calls();
+    test_exception_table_remap();
     test_loop_optimization();
     test_control_flow_optimization();
     test_register_allocation();
@@ -955,7 +1101,7 @@ int main(int argc, char* argv[]) {
     test_empty_chunk_optimization();
     
     printf("\nAll Ember Optimizer tests passed!\n");
-    printf("Total tests run: 20\n");
+    printf("Total tests run: 23\n");
     
     return 0;
 }
\ No newline at end of file
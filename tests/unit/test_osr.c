@@ -0,0 +1,138 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/core/vm_dispatch.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// OP_ADD at 0, OP_POP at 1; the loop header is offset 0
+static ember_chunk* loop_chunk(void) {
+    ember_chunk* chunk = malloc(sizeof(ember_chunk));
+    assert(chunk);
+    init_chunk(chunk);
+    write_chunk(chunk, OP_ADD);
+    write_chunk(chunk, OP_POP);
+    return chunk;
+}
+
+static void enter_loop(ember_vm* vm, ember_chunk* chunk) {
+    vm->chunk = chunk;
+    vm->ip = chunk->code;
+    vm_push_loop_context(vm, chunk->code);
+}
+
+// One iteration: the body's OP_ADD on numbers, then OP_LOOP jumping back
+static void iterate(ember_vm* vm, ember_chunk* chunk) {
+    vm->stack[0] = ember_make_number(1);
+    vm->stack[1] = ember_make_number(2);
+    vm->stack_top = 2;
+    uint8_t op = chunk->code[0];
+    vm_dispatch_feedback(vm, chunk, chunk->code, op, 0);
+    vm->stack_top = 0;
+    vm->ip = chunk->code;
+    vm_osr_back_edge(vm);
+}
+
+static void leave(ember_vm* vm, ember_chunk* chunk) {
+    vm_pop_loop_context(vm);
+    vm->chunk = NULL;
+    vm->ip = NULL;
+    free_chunk(chunk);
+    free(chunk);
+    ember_free_vm(vm);
+}
+
+void test_hot_loop_quickens(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(!vm->type_feedback);
+    assert(ember_vm_configure_osr(vm, 1, 10) == EMBER_SUCCESS);
+    ember_chunk* chunk = loop_chunk();
+    enter_loop(vm, chunk);
+
+    // Nothing is profiled while the loop is cold
+    for (int i = 0; i < 9; i++) iterate(vm, chunk);
+    assert(vm->osr_entries == 0 && chunk->osr_profile_budget == 0);
+    assert(chunk->feedback_count == 0);
+
+    iterate(vm, chunk);
+    assert(vm->osr_entries == 1 && chunk->osr_profile_budget > 0);
+
+    // The running loop picks up the quickened OP_ADD
+    for (int i = 0; i < 16; i++) iterate(vm, chunk);
+    assert(chunk->code[0] == OP_ADD_NUMBER);
+
+    // Profiling stops once the window has passed
+    for (int i = 0; i < 64; i++) iterate(vm, chunk);
+    assert(chunk->osr_profile_budget == 0);
+
+    // A later run of the same loop does not profile the chunk again
+    vm_pop_loop_context(vm);
+    enter_loop(vm, chunk);
+    for (int i = 0; i < 10; i++) iterate(vm, chunk);
+    assert(vm->osr_entries == 2 && chunk->osr_profile_budget == 0);
+
+    leave(vm, chunk);
+    printf("  ✓ Hot loops are profiled and quickened while running\n");
+}
+
+void test_untracked_back_edges(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(ember_vm_configure_osr(vm, 1, 4) == EMBER_SUCCESS);
+    ember_chunk* chunk = loop_chunk();
+    enter_loop(vm, chunk);
+
+    // A jump back to somewhere other than the current loop's start is not
+    // that loop's back edge
+    for (int i = 0; i < 8; i++) {
+        vm->ip = chunk->code + 1;
+        vm_osr_back_edge(vm);
+    }
+    assert(vm->osr_entries == 0);
+
+    assert(ember_vm_configure_osr(vm, 0, 4) == EMBER_SUCCESS);
+    for (int i = 0; i < 8; i++) iterate(vm, chunk);
+    assert(vm->osr_entries == 0 && chunk->code[0] == OP_ADD);
+    assert(ember_vm_configure_osr(vm, 1, -1) == EMBER_ERROR_INVALID_PARAMETER);
+
+    leave(vm, chunk);
+    printf("  ✓ Only tracked loops count, and OSR can be turned off\n");
+}
+
+static double run_script(int osr, int jit) {
+    ember_vm* vm = ember_new_vm();
+    assert(ember_vm_configure_osr(vm, osr, 50) == EMBER_SUCCESS);
+    if (jit) assert(ember_jit_configure(vm, 1, 0) == EMBER_SUCCESS);
+    // One long top-level loop, never inside a function call
+    assert(ember_eval(vm,
+        "total = 0\n"
+        "i = 0\n"
+        "while (i < 5000) {\n"
+        "    total = total + i * 0.5\n"
+        "    i = i + 1\n"
+        "}\n") == 0);
+    if (osr) assert(vm->osr_entries > 0);
+    int slot = ember_global_find(vm, "total", 5);
+    assert(slot >= 0);
+    double value = vm->globals[slot].value.as.number_val;
+    ember_free_vm(vm);
+    return value;
+}
+
+void test_script_results(void) {
+    double plain = run_script(0, 0);
+    assert(plain == 0.5 * (4999.0 * 5000 / 2));
+    assert(run_script(1, 0) == plain);
+    if (ember_jit_available()) assert(run_script(1, 1) == plain);
+    printf("  ✓ Top-level loops compute the same result after OSR\n");
+}
+
+int main(void) {
+    printf("Testing on-stack replacement...\n");
+    test_hot_loop_quickens();
+    test_untracked_back_edges();
+    test_script_results();
+    printf("✓ OSR tests passed\n");
+    return 0;
+}
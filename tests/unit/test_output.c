@@ -0,0 +1,168 @@
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Everything waiting in the pipe, without blocking
+static size_t drain(int fd, char* out, size_t size) {
+    size_t length = 0;
+    ssize_t count;
+    while (length + 1 < size && (count = read(fd, out + length, size - 1 - length)) > 0) {
+        length += (size_t)count;
+    }
+    out[length] = '\0';
+    return length;
+}
+
+static int nonblocking_pipe(int fds[2]) {
+    if (pipe(fds) != 0) return -1;
+    return fcntl(fds[0], F_SETFL, O_NONBLOCK);
+}
+
+void test_print_batching(void) {
+    int fds[2];
+    int rc = nonblocking_pipe(fds);
+    assert(rc == 0);
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    assert(saved >= 0);
+    rc = dup2(fds[1], STDOUT_FILENO);
+    assert(rc >= 0);
+
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    assert(ember_vm_set_output_buffering(vm, 1 << 16, 3) == EMBER_SUCCESS);
+    assert(ember_vm_set_output_buffering(vm, 0, -1) == EMBER_ERROR_INVALID_PARAMETER);
+    char seen[4096];
+
+    ember_value args[3] = {ember_make_number(1.5), text(vm, "two"), ember_make_bool(true)};
+    ember_native_print(vm, 3, args);
+    ember_native_print(vm, 0, NULL);
+    assert(drain(fds[0], seen, sizeof(seen)) == 0);
+
+    // The third line reaches the line limit: all three go out together
+    ember_value array = keep(vm, ember_make_array(vm, 2));
+    array_push(AS_ARRAY(array), ember_make_number(1));
+    array_push(AS_ARRAY(array), text(vm, "x"));
+    ember_native_print(vm, 1, &array);
+    drain(fds[0], seen, sizeof(seen));
+    assert(strcmp(seen, "1.5 two true\n\n[1, x]\n") == 0);
+
+    // flush_output writes what is waiting; freeing the VM does too
+    ember_native_print(vm, 1, args);
+    assert(drain(fds[0], seen, sizeof(seen)) == 0);
+    ember_value flushed = ember_native_flush_output(vm, 0, NULL);
+    assert(flushed.type == EMBER_VAL_BOOL && flushed.as.bool_val);
+    drain(fds[0], seen, sizeof(seen));
+    assert(strcmp(seen, "1.5\n") == 0);
+
+    // The byte limit counts too; 0 writes each print at once
+    assert(ember_vm_set_output_buffering(vm, 8, 0) == EMBER_SUCCESS);
+    ember_native_print(vm, 1, args);
+    assert(drain(fds[0], seen, sizeof(seen)) == 0);
+    ember_native_print(vm, 1, args);
+    drain(fds[0], seen, sizeof(seen));
+    assert(strcmp(seen, "1.5\n1.5\n") == 0);
+    assert(ember_vm_set_output_buffering(vm, 0, 0) == EMBER_SUCCESS);
+    ember_native_print(vm, 1, &args[1]);
+    drain(fds[0], seen, sizeof(seen));
+    assert(strcmp(seen, "two\n") == 0);
+
+    assert(ember_vm_set_output_buffering(vm, 1 << 16, 0) == EMBER_SUCCESS);
+    ember_native_print(vm, 1, &args[1]);
+    ember_free_vm(vm);
+    drain(fds[0], seen, sizeof(seen));
+    assert(strcmp(seen, "two\n") == 0);
+
+    rc = dup2(saved, STDOUT_FILENO);
+    assert(rc >= 0);
+    (void)rc;
+    close(saved);
+    close(fds[0]);
+    close(fds[1]);
+    printf("  ✓ print batches lines and flushes on limits, flush_output and free\n");
+}
+
+void test_logger(void) {
+    int fds[2];
+    int rc = nonblocking_pipe(fds);
+    assert(rc == 0);
+    (void)rc;
+    assert(ember_log_configure(fds[1], EMBER_LOG_INFO) == EMBER_SUCCESS);
+    assert(ember_log_configure(-1, EMBER_LOG_INFO) == EMBER_ERROR_INVALID_PARAMETER);
+
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value fields = keep(vm, ember_make_hash_map(vm, 4));
+    hash_map_set(AS_HASH_MAP(fields), text(vm, "user"), text(vm, "ann"));
+    ember_value empty = keep(vm, ember_make_hash_map(vm, 4));
+
+    // Below the level: skipped without formatting
+    ember_value args[3] = {text(vm, "debug"), text(vm, "hidden"), fields};
+    ember_value result = ember_native_log(vm, 2, args);
+    assert(result.type == EMBER_VAL_BOOL && !result.as.bool_val);
+
+    args[0] = text(vm, "warn");
+    args[1] = text(vm, "disk \"low\"");
+    result = ember_native_log(vm, 3, args);
+    assert(result.type == EMBER_VAL_BOOL && result.as.bool_val);
+    args[0] = text(vm, "error");
+    args[1] = ember_make_number(42);
+    args[2] = empty;
+    assert(ember_native_log(vm, 3, args).as.bool_val);
+
+    // A record longer than a queue cell
+    char long_message[2000];
+    memset(long_message, 'm', sizeof(long_message) - 1);
+    long_message[sizeof(long_message) - 1] = '\0';
+    args[0] = text(vm, "info");
+    args[1] = text(vm, long_message);
+    assert(ember_native_log(vm, 2, args).as.bool_val);
+
+    // Bad arguments
+    args[0] = text(vm, "loud");
+    assert(ember_native_log(vm, 2, args).type == EMBER_VAL_NIL);
+    args[0] = text(vm, "info");
+    args[2] = ember_make_number(1);
+    assert(ember_native_log(vm, 3, args).type == EMBER_VAL_NIL);
+    assert(ember_native_log(vm, 1, args).type == EMBER_VAL_NIL);
+
+    ember_value flushed = ember_native_log_flush(vm, 0, NULL);
+    assert(flushed.type == EMBER_VAL_BOOL && flushed.as.bool_val);
+    static char seen[8192];
+    size_t length = drain(fds[0], seen, sizeof(seen));
+    assert(length > 2000);
+
+    char* first = seen;
+    char* second = strchr(first, '\n') + 1;
+    char* third = strchr(second, '\n') + 1;
+    assert(strncmp(first, "{\"ts\":", 6) == 0);
+    assert(strstr(first, "\"level\":\"warn\",\"msg\":\"disk \\\"low\\\"\",\"user\":\"ann\"}\n") != NULL);
+    char* error = strstr(second, "\"level\":\"error\",\"msg\":42}\n");
+    assert(error != NULL && error < third);
+    assert(strstr(third, "\"level\":\"info\",\"msg\":\"mmm") != NULL);
+    assert(seen[length - 1] == '\n' && strchr(third, '\n') == seen + length - 1);
+    assert(strstr(seen, "hidden") == NULL);
+    assert(ember_log_dropped() == 0);
+
+    assert(ember_log_configure(STDERR_FILENO, EMBER_LOG_INFO) == EMBER_SUCCESS);
+    ember_free_vm(vm);
+    close(fds[0]);
+    close(fds[1]);
+    printf("  ✓ log queues JSON lines that the writer thread writes in batches\n");
+}
+
+int main(void) {
+    printf("Running output tests...\n");
+    test_print_batching();
+    test_logger();
+    printf("All output tests passed!\n");
+    return 0;
+}
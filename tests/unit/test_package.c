@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,15 +6,18 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <time.h>
+#include <utime.h>
 #include "ember.h"
 #include "../../src/runtime/package/package.h"
+#include "../../src/core/bytecode_format.h"
 #include "test_ember_internal.h"
 
 // Macro to mark variables as intentionally unused
 #define UNUSED(x) ((void)(x))
 
 // Test helper to create temporary directory
-static char temp_dir[512];
+static char temp_dir[64];  // "/tmp/ember_test_packages_<pid>", short enough to nest paths under
 static int temp_dir_created = 0;
 
 static void setup_temp_dir(void) {
@@ -730,12 +734,238 @@ static void test_import_scanning(void) {
     printf("Import scanning and dependency installation tests completed successfully!\n\n");
 }
 
+// Writes an installed package with a package.toml under home
+static void write_installed_package(const char* home, const char* name, const char* version, const char* dependencies) {
+    char path[700];
+    snprintf(path, sizeof(path), "%s/.ember/packages/%s", home, name);
+    assert(ember_package_create_directory_recursive(path) == 0);
+    
+    char file_path[800];
+    snprintf(file_path, sizeof(file_path), "%s/package.ember", path);
+    FILE* f = fopen(file_path, "w");
+    assert(f != NULL);
+    fprintf(f, "print(\"%s\")\n", name);
+    fclose(f);
+    
+    snprintf(file_path, sizeof(file_path), "%s/package.toml", path);
+    f = fopen(file_path, "w");
+    assert(f != NULL);
+    fprintf(f, "name = \"%s\"\nversion = \"%s\"\n", name, version);
+    if (dependencies) fprintf(f, "\n[dependencies]\n%s", dependencies);
+    fclose(f);
+}
+
+// Test dependency graph resolution against installed packages
+static void test_dependency_resolution(void) {
+    printf("Testing dependency resolution...\n");
+    
+    setup_temp_dir();
+    char home[600];
+    snprintf(home, sizeof(home), "%s/home", temp_dir);
+    const char* old_home = getenv("HOME");
+    char* saved_home = old_home ? strdup(old_home) : NULL;
+    setenv("HOME", home, 1);
+    
+    // web -> router -> util, web -> util; util is shared
+    write_installed_package(home, "web", "1.4.0", "router = \"^2.0.0\"\nutil = \"~1.1.0\"\n");
+    write_installed_package(home, "router", "2.3.1", "util = \">=1.0.0\"\n");
+    write_installed_package(home, "util", "1.1.5", NULL);
+    
+    EmberProject* project = ember_project_init("resolve_test", "1.0.0");
+    assert(project != NULL);
+    assert(ember_project_add_dependency(project, "web", "^1.2.0"));
+    assert(ember_project_install_dependencies(project) == true);
+    assert(project->dependencies[0].loaded == true);
+    printf("  ✓ Transitive dependencies resolve from installed manifests\n");
+    
+    // A manifest version outside a constraint fails the install; the
+    // registry in main refuses connections, so the refetch fails too
+    EmberProject* conflicting = ember_project_init("conflict_test", "1.0.0");
+    assert(conflicting != NULL);
+    assert(ember_project_add_dependency(conflicting, "web", "^1.2.0"));
+    assert(ember_project_add_dependency(conflicting, "util", "^2.0.0"));
+    assert(ember_project_install_dependencies(conflicting) == false);
+    printf("  ✓ Unsatisfiable constraints are reported\n");
+    
+    ember_project_cleanup(conflicting);
+    ember_project_cleanup(project);
+    ember_package_system_cleanup();
+    if (saved_home) {
+        setenv("HOME", saved_home, 1);
+        free(saved_home);
+    } else {
+        unsetenv("HOME");
+    }
+    
+    printf("Dependency resolution tests completed successfully!\n\n");
+}
+
+// Test the content-addressed package store
+static void test_package_store(void) {
+    printf("Testing package store...\n");
+    
+    setup_temp_dir();
+    char home[600];
+    snprintf(home, sizeof(home), "%s/store_home", temp_dir);
+    const char* old_home = getenv("HOME");
+    char* saved_home = old_home ? strdup(old_home) : NULL;
+    setenv("HOME", home, 1);
+    
+    // An archive with one top-level directory, as the registry serves them
+    char source[700];
+    snprintf(source, sizeof(source), "%s/store_source/kit", temp_dir);
+    assert(ember_package_create_directory_recursive(source) == 0);
+    char file_path[800];
+    snprintf(file_path, sizeof(file_path), "%s/package.ember", source);
+    FILE* f = fopen(file_path, "w");
+    assert(f != NULL);
+    fprintf(f, "print(\"kit\")\n");
+    fclose(f);
+    char archive[700];
+    snprintf(archive, sizeof(archive), "%s/kit.tar.gz", temp_dir);
+    char command[2000];
+    snprintf(command, sizeof(command), "tar -czf \"%s\" -C \"%s/store_source\" kit", archive, temp_dir);
+    assert(system(command) == 0);
+    
+    char hash[EMBER_PACKAGE_HASH_LEN];
+    char again[EMBER_PACKAGE_HASH_LEN];
+    assert(ember_package_store_add(archive, hash));
+    assert(strlen(hash) == EMBER_PACKAGE_HASH_LEN - 1);
+    assert(ember_package_store_add(archive, again));
+    assert(strcmp(hash, again) == 0);
+    printf("  ✓ Archives are stored once by content\n");
+    
+    // Two installs share the stored file
+    char first[700];
+    char second[700];
+    snprintf(first, sizeof(first), "%s/project_a/kit", temp_dir);
+    snprintf(second, sizeof(second), "%s/project_b/kit", temp_dir);
+    assert(ember_package_create_directory_recursive(first) == 0);
+    assert(ember_package_store_install(hash, first));
+    snprintf(command, sizeof(command), "%s/project_b", temp_dir);
+    assert(ember_package_create_directory_recursive(command) == 0);
+    assert(ember_package_store_install(hash, second));
+    struct stat info_a, info_b;
+    snprintf(file_path, sizeof(file_path), "%s/package.ember", first);
+    assert(stat(file_path, &info_a) == 0);
+    snprintf(file_path, sizeof(file_path), "%s/package.ember", second);
+    assert(stat(file_path, &info_b) == 0);
+    assert(info_a.st_ino == info_b.st_ino);
+    assert(info_a.st_nlink >= 3);
+    snprintf(file_path, sizeof(file_path), "%s/.ember-integrity", first);
+    assert(access(file_path, F_OK) != 0);
+    printf("  ✓ Installs hardlink from the store\n");
+    
+    // Exact versions are found again without the archive
+    char found[EMBER_PACKAGE_HASH_LEN];
+    assert(!ember_package_store_lookup("kit", "1.0.0", found));
+    ember_package_store_remember("kit", "1.0.0", hash);
+    assert(ember_package_store_lookup("kit", "1.0.0", found));
+    assert(strcmp(found, hash) == 0);
+    printf("  ✓ Package versions are indexed\n");
+    
+    // A stored file edited through a link no longer matches the entry
+    snprintf(file_path, sizeof(file_path), "%s/package.ember", first);
+    assert(chmod(file_path, 0644) == 0);
+    f = fopen(file_path, "a");
+    assert(f != NULL);
+    fprintf(f, "print(\"changed\")\n");
+    fclose(f);
+    assert(!ember_package_store_lookup("kit", "1.0.0", found));
+    assert(ember_package_store_add(archive, again));
+    assert(ember_package_store_lookup("kit", "1.0.0", found));
+    printf("  ✓ Damaged entries are unpacked again\n");
+    
+    assert(!ember_package_store_install("not-a-hash", first));
+    assert(!ember_package_store_lookup("../kit", "1.0.0", found));
+    printf("  ✓ Package store error handling test passed\n");
+    
+    if (saved_home) {
+        setenv("HOME", saved_home, 1);
+        free(saved_home);
+    } else {
+        unsetenv("HOME");
+    }
+    
+    printf("Package store tests completed successfully!\n\n");
+}
+
+// Test that published chunks are preferred while they match the source
+static void test_precompiled_package(void) {
+    printf("Testing precompiled package modules...\n");
+    
+    setup_temp_dir();
+    EmberPackage package;
+    memset(&package, 0, sizeof(EmberPackage));
+    strncpy(package.name, "precompiled", EMBER_PACKAGE_MAX_NAME_LEN - 1);
+    int written = snprintf(package.local_path, sizeof(package.local_path), "%s/precompiled", temp_dir);
+    assert(written > 0 && written < (int)sizeof(package.local_path));
+    char bytecode_dir[700];
+    written = snprintf(bytecode_dir, sizeof(bytecode_dir), "%s/.bytecode", package.local_path);
+    assert(written > 0 && written < (int)sizeof(bytecode_dir));
+    assert(ember_package_create_directory_recursive(bytecode_dir) == 0);
+    
+    // The source and the chunk define different functions, so the one that
+    // ran can be told apart
+    char source_path[800];
+    snprintf(source_path, sizeof(source_path), "%s/package.ember", package.local_path);
+    FILE* f = fopen(source_path, "w");
+    assert(f != NULL);
+    fprintf(f, "fn from_source() {\n    return 1\n}\n");
+    fclose(f);
+    struct utimbuf old_time = {time(NULL) - 60, time(NULL) - 60};
+    assert(utime(source_path, &old_time) == 0);
+    
+    ember_vm* compiler = ember_new_vm();
+    assert(compiler != NULL);
+    uint8_t* data = NULL;
+    size_t size = 0;
+    assert(ember_bytecode_compile(compiler, "fn from_chunk() {\n    return 2\n}\n", &data, &size));
+    char chunk_path[900];
+    snprintf(chunk_path, sizeof(chunk_path), "%s/package.ember.v%d-%d.emberc",
+             bytecode_dir, EMBER_BYTECODE_VERSION, OP_HALT + 1);
+    assert(ember_bytecode_write_file(chunk_path, data, size));
+    free(data);
+    ember_free_vm(compiler);
+    
+    assert(ember_package_load(&package));
+    assert(ember_global_find(package.handle, "from_chunk", 10) >= 0);
+    assert(ember_global_find(package.handle, "from_source", 11) < 0);
+    assert(ember_package_unload(&package));
+    printf("  ✓ A matching chunk runs instead of the source\n");
+    
+    // Once the source is edited the chunk is stale
+    struct utimbuf new_time = {time(NULL) + 60, time(NULL) + 60};
+    assert(utime(source_path, &new_time) == 0);
+    assert(ember_package_load(&package));
+    assert(ember_global_find(package.handle, "from_source", 11) >= 0);
+    assert(ember_global_find(package.handle, "from_chunk", 10) < 0);
+    assert(ember_package_unload(&package));
+    printf("  ✓ A stale chunk falls back to the source\n");
+    
+    // A damaged chunk does too
+    assert(utime(source_path, &old_time) == 0);
+    f = fopen(chunk_path, "w");
+    assert(f != NULL);
+    fprintf(f, "EMBC not bytecode");
+    fclose(f);
+    assert(ember_package_load(&package));
+    assert(ember_global_find(package.handle, "from_source", 11) >= 0);
+    assert(ember_package_unload(&package));
+    printf("  ✓ A damaged chunk falls back to the source\n");
+    
+    printf("Precompiled package tests completed successfully!\n\n");
+}
+
 int main(int argc, char* argv[]) {
     (void)argc;
     (void)argv;
     
     printf("Running Ember package management tests...\n\n");
     
+    // Nothing listens here: installs never leave the machine
+    setenv("EMBER_REGISTRY_URL", "http://127.0.0.1:1", 1);
+    
     // Run all tests
     test_package_registry();
     test_package_discovery();
@@ -747,6 +977,9 @@ int main(int argc, char* argv[]) {
     test_package_structure_validation();
     test_repository_functions();
     test_import_scanning();
+    test_dependency_resolution();
+    test_package_store();
+    test_precompiled_package();
     
     // Cleanup temporary directory
     cleanup_temp_dir();
@@ -0,0 +1,131 @@
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PARALLEL_TEST_LENGTH 20000
+
+static const char* prelude =
+    "fn square(x, i, a) { return x * x }\n"
+    "fn odd(x, i, a) { return x % 2 == 1 }\n"
+    "fn add(acc, x, i, a) { return acc + x }\n"
+    "fn tag(x, i, a) { return [x, str(i)] }\n"
+    "fn boom(x, i, a) {\n"
+    "    if (x == 12345) { throw \"bad element\" }\n"
+    "    return x\n"
+    "}\n";
+
+// 0 .. length-1, rooted on the stack
+static ember_value numbers(ember_vm* vm, int length) {
+    ember_value array = ember_make_array(vm, length);
+    vm->stack[vm->stack_top++] = array;
+    for (int i = 0; i < length; i++) {
+        array_push_with_vm(vm, AS_ARRAY(array), ember_make_number(i));
+    }
+    return array;
+}
+
+static ember_vm* new_vm(ember_executor* executor) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    assert(ember_eval(vm, prelude) == 0);
+    ember_vm_set_executor(vm, executor);
+    return vm;
+}
+
+void test_parallel_matches_sequential(void) {
+    ember_executor* executor = ember_executor_create(4, prelude);
+    assert(executor != NULL);
+    ember_vm* vm = new_vm(executor);
+    ember_value array = numbers(vm, PARALLEL_TEST_LENGTH);
+
+    ember_value args[3] = {array, global_value(vm, "square"), ember_make_number(0)};
+    ember_value squares = ember_native_parallel_map(vm, 2, args);
+    assert(squares.type == EMBER_VAL_ARRAY && AS_ARRAY(squares)->length == PARALLEL_TEST_LENGTH);
+    for (int i = 0; i < PARALLEL_TEST_LENGTH; i++) {
+        assert(AS_ARRAY(squares)->elements[i].as.number_val == (double)i * i);
+    }
+
+    args[1] = global_value(vm, "odd");
+    ember_value odds = ember_native_parallel_filter(vm, 2, args);
+    assert(odds.type == EMBER_VAL_ARRAY && AS_ARRAY(odds)->length == PARALLEL_TEST_LENGTH / 2);
+    for (int i = 0; i < PARALLEL_TEST_LENGTH / 2; i++) {
+        assert(AS_ARRAY(odds)->elements[i].as.number_val == 2 * i + 1);
+    }
+
+    // Ranges fold from the identity, with or without a separate combine
+    double total = (double)PARALLEL_TEST_LENGTH * (PARALLEL_TEST_LENGTH - 1) / 2;
+    args[1] = global_value(vm, "add");
+    assert(ember_native_parallel_reduce(vm, 3, args).as.number_val == total);
+    assert(ember_native_parallel_reduce(vm, 2, args).as.number_val == total);
+    ember_value with_combine[4] = {array, args[1], ember_make_number(0), args[1]};
+    assert(ember_native_parallel_reduce(vm, 4, with_combine).as.number_val == total);
+
+    // Arrays and strings are cloned both ways
+    args[1] = global_value(vm, "tag");
+    ember_value tagged = ember_native_parallel_map(vm, 2, args);
+    assert(tagged.type == EMBER_VAL_ARRAY && AS_ARRAY(tagged)->length == PARALLEL_TEST_LENGTH);
+    ember_value last = AS_ARRAY(tagged)->elements[PARALLEL_TEST_LENGTH - 1];
+    assert(last.type == EMBER_VAL_ARRAY && AS_ARRAY(last)->length == 2);
+    assert(strcmp(AS_CSTRING(AS_ARRAY(last)->elements[1]), "19999") == 0);
+    assert(vm->stack_top == 1);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    ember_executor_destroy(executor);
+    printf("  ✓ Parallel results match the sequential ones\n");
+}
+
+void test_sequential_fallback(void) {
+    // No executor: the same functions run on the caller's VM
+    ember_vm* vm = new_vm(NULL);
+    ember_value array = numbers(vm, 100);
+    ember_value args[2] = {array, global_value(vm, "square")};
+    ember_value squares = ember_native_parallel_map(vm, 2, args);
+    assert(squares.type == EMBER_VAL_ARRAY && AS_ARRAY(squares)->length == 100);
+    assert(AS_ARRAY(squares)->elements[99].as.number_val == 99 * 99);
+
+    // Anything but an array and a function is refused
+    ember_value bad[2] = {array, ember_make_number(1)};
+    assert(ember_native_parallel_map(vm, 2, bad).type == EMBER_VAL_NIL);
+    assert(ember_native_parallel_filter(vm, 1, args).type == EMBER_VAL_NIL);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("  ✓ Without an executor the work runs sequentially\n");
+}
+
+void test_failing_worker(void) {
+    ember_executor* executor = ember_executor_create(2, prelude);
+    assert(executor != NULL);
+    ember_vm* vm = new_vm(executor);
+    ember_value array = numbers(vm, PARALLEL_TEST_LENGTH);
+
+    // One range throws: the call fails as a whole and the executor carries on
+    ember_value args[2] = {array, global_value(vm, "boom")};
+    assert(ember_native_parallel_map(vm, 2, args).type == EMBER_VAL_NIL);
+    args[1] = global_value(vm, "square");
+    assert(ember_native_parallel_map(vm, 2, args).type == EMBER_VAL_ARRAY);
+    assert(vm->stack_top == 1);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    ember_executor_destroy(executor);
+    printf("  ✓ A failing range fails the call\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running parallel array tests...\n");
+    test_parallel_matches_sequential();
+    test_sequential_fallback();
+    test_failing_worker();
+    printf("All parallel array tests passed!\n");
+    return 0;
+}
@@ -4,6 +4,8 @@
 #include <string.h>
 #include <math.h>
 #include "test_ember_internal.h"
+#include "../../src/vm.h"
+#include "../../src/frontend/parser/parser.h"
 
 // Macro to mark variables as intentionally unused
 #define UNUSED(x) ((void)(x))
@@ -648,6 +650,53 @@ void test_operator_precedence(void) {
     ember_free_vm(vm);
 }
 
+void test_interpolation_compilation(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    
+    printf("Testing interpolated string compilation...\n");
+    
+    // Literal segments and holes are split at compile time into one OP_CONCAT_N
+    ember_chunk chunk;
+    init_chunk(&chunk);
+    int ok = compile(vm, "\"id=${1 + 2}, name=${\"ember\"}!\"", &chunk);
+    assert(ok);
+    
+    // Constant indices here are all far below either opcode's value, so a byte
+    // scan cannot mistake an operand for an instruction
+    int concat_at = -1;
+    for (int i = 0; i < chunk.count; i++) {
+        assert(chunk.code[i] != OP_STRING_INTERPOLATE);
+        if (chunk.code[i] == OP_CONCAT_N && concat_at < 0) {
+            concat_at = i;
+        }
+    }
+    assert(concat_at >= 0 && concat_at + 1 < chunk.count);
+    // "id=", 1 + 2, ", name=", "ember", "!"
+    assert(chunk.code[concat_at + 1] == 5);
+    assert(chunk.code[concat_at - 7] == OP_ADD);
+    printf("  Interpolation compiled to OP_CONCAT_N with %d parts\n", chunk.code[concat_at + 1]);
+    free_chunk(&chunk);
+    
+    const char* interpolation_tests[] = {
+        "\"${1}\"",
+        "\"plain ${\"nested ${2}\"} text\"",
+        "\"a${1}b${2}c${3}\"",
+        NULL
+    };
+    
+    for (int i = 0; interpolation_tests[i] != NULL; i++) {
+        printf("  Testing interpolation: %s\n", interpolation_tests[i]);
+        int result = ember_eval(vm, interpolation_tests[i]);
+
+        UNUSED(result);
+        printf("    Result: %d\n", result);
+    }
+    
+    printf("Interpolated string compilation test completed\n");
+    ember_free_vm(vm);
+}
+
 int main(int argc, char* argv[]) {
     (void)argc;
     (void)argv;
@@ -694,6 +743,9 @@ int main(int argc, char* argv[]) {
     test_expression_error_cases();
     printf("\n");
     
+    test_interpolation_compilation();
+    printf("\n");
+    
     printf("========================================\n");
     printf("All parser expression tests completed!\n");
     return 0;
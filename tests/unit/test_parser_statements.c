@@ -3,6 +3,8 @@
 #include <assert.h>
 #include <string.h>
 #include "test_ember_internal.h"
+#include "../../src/vm.h"
+#include "../../src/frontend/parser/parser.h"
 
 // Macro to mark variables as intentionally unused
 #define UNUSED(x) ((void)(x))
@@ -635,6 +637,353 @@ void test_complex_statement_combinations(void) {
     ember_free_vm(vm);
 }
 
+// Find a compiled function's chunk by its global name
+static ember_chunk* find_function_chunk(ember_vm* vm, const char* name) {
+    for (int i = 0; i < vm->global_count; i++) {
+        if (strcmp(vm->globals[i].key, name) == 0 &&
+            vm->globals[i].value.type == EMBER_VAL_FUNCTION) {
+            return vm->globals[i].value.as.func_val.chunk;
+        }
+    }
+    return NULL;
+}
+
+void test_local_slot_resolution(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    
+    printf("Testing local slot resolution...\n");
+    
+    ember_chunk chunk;
+    init_chunk(&chunk);
+    int ok = compile(vm, "fn add(a, b) {\n    return a + b\n}\n", &chunk);
+    assert(ok);
+    
+    // Parameters compile to slot accesses, with no name constants at all
+    ember_chunk* body = find_function_chunk(vm, "add");
+    assert(body != NULL);
+    assert(body->count >= 5);
+    assert(body->code[0] == OP_GET_LOCAL && body->code[1] == 0);
+    assert(body->code[2] == OP_GET_LOCAL && body->code[3] == 1);
+    assert(body->code[4] == OP_ADD);
+    assert(body->const_count == 0);
+    printf("  Parameters resolved to slots 0 and 1\n");
+    free_chunk(&chunk);
+    
+    // A for-loop initializer inside a function declares a local; names that
+    // are only assigned keep their global meaning
+    init_chunk(&chunk);
+    ok = compile(vm,
+        "fn count(n) {\n"
+        "    total = 0\n"
+        "    for (i = 0; i < n; i++) {\n"
+        "        total += i\n"
+        "    }\n"
+        "    return total\n"
+        "}\n", &chunk);
+    assert(ok);
+    body = find_function_chunk(vm, "count");
+    assert(body != NULL);
+    int local_stores = 0;
+    for (int i = 0; i < body->const_count; i++) {
+        ember_value constant = body->constants[i];
+        if (constant.type == EMBER_VAL_STRING) {
+            assert(strcmp(AS_CSTRING(constant), "i") != 0);
+            assert(strcmp(AS_CSTRING(constant), "n") != 0);
+        }
+    }
+    for (int i = 0; i + 1 < body->count; i++) {
+        if (body->code[i] == OP_SET_LOCAL && body->code[i + 1] == 1) {
+            local_stores++;
+        }
+    }
+    assert(local_stores >= 2); // i = 0 and i++
+    printf("  Loop variable compiled to slot 1 (%d stores)\n", local_stores);
+    free_chunk(&chunk);
+    
+    printf("Local slot resolution test completed\n");
+    ember_free_vm(vm);
+}
+
+void test_wide_operands(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    
+    printf("Testing wide operand encoding...\n");
+    
+    // One distinct number per statement pushes the pool past 256 entries
+    static char source[16384];
+    int length = 0;
+    for (int i = 0; i < 300; i++) {
+        length += snprintf(source + length, sizeof(source) - length, "v = %d\n", 1000 + i);
+    }
+    ember_chunk chunk;
+    init_chunk(&chunk);
+    int ok = compile(vm, source, &chunk);
+    assert(ok);
+    assert(chunk.const_count > 256);
+    
+    // The first constant keeps the compact form, the last needs OP_WIDE
+    assert(chunk.code[0] == OP_PUSH_CONST);
+    assert(chunk.constants[chunk.code[1]].as.number_val == 1000);
+    int last = -1;
+    for (int i = 0; i < chunk.const_count; i++) {
+        if (chunk.constants[i].type == EMBER_VAL_NUMBER && chunk.constants[i].as.number_val == 1299) {
+            last = i;
+        }
+    }
+    assert(last > 0xFF);
+    int found_wide = 0;
+    for (int i = 0; i + 3 < chunk.count; i++) {
+        uint8_t op;
+        int size;
+        if (chunk.code[i] == OP_WIDE && read_chunk_operand(&chunk, i, &op, &size) == last) {
+            assert(op == OP_PUSH_CONST && size == 4);
+            found_wide = 1;
+            break;
+        }
+    }
+    assert(found_wide);
+    printf("  Constant %d encoded with OP_WIDE\n", last);
+    free_chunk(&chunk);
+    
+    // Bodies longer than 255 bytes need 2-byte jump offsets in both directions
+    length = snprintf(source, sizeof(source), "while (v) {\n");
+    for (int i = 0; i < 100; i++) {
+        length += snprintf(source + length, sizeof(source) - length, "    v = v\n");
+    }
+    snprintf(source + length, sizeof(source) - length, "}\n");
+    init_chunk(&chunk);
+    ok = compile(vm, source, &chunk);
+    assert(ok);
+    
+    // while (v): GET_GLOBAL v, then the reserved wide exit jump
+    uint8_t op;
+    int size;
+    int exit_offset = read_chunk_operand(&chunk, 2, &op, &size);
+    assert(op == OP_JUMP_IF_FALSE && size == 4);
+    assert(exit_offset > 0xFF);
+    int after_loop = 2 + 4 + exit_offset;
+    assert(after_loop <= chunk.count);
+    
+    // The loop-back sits just before the exit target and reaches offset 0
+    int loop_at = after_loop - 4;
+    int loop_offset = read_chunk_operand(&chunk, loop_at, &op, &size);
+    assert(op == OP_LOOP && size == 4);
+    assert(loop_at + size + 1 - loop_offset == 0);
+    printf("  Loop of %d bytes uses 2-byte jump offsets\n", chunk.count);
+    free_chunk(&chunk);
+    
+    printf("Wide operand encoding test completed\n");
+    ember_free_vm(vm);
+}
+
+void test_lazy_function_bodies(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    
+    printf("Testing lazy function bodies...\n");
+    
+    const char* source =
+        "fn add(a, b) {\n"
+        "    c = a + b\n"
+        "    return c\n"
+        "}\n"
+        "fn outer() {\n"
+        "    fn inner() { return 1 }\n"
+        "    return inner()\n"
+        "}\n"
+        "fn broken(x) {\n"
+        "    return x +\n"
+        "}\n";
+    
+    // Compiled eagerly for reference
+    ember_chunk chunk;
+    init_chunk(&chunk);
+    assert(compile(vm, "fn add(a, b) {\n    c = a + b\n    return c\n}\n", &chunk));
+    ember_chunk* eager = find_function_chunk(vm, "add");
+    assert(eager != NULL && eager->lazy_body == NULL);
+    free_chunk(&chunk);
+    
+    ember_vm* lazy_vm = ember_new_vm();
+    assert(lazy_vm != NULL);
+    ember_vm_set_lazy_functions(lazy_vm, 1);
+    init_chunk(&chunk);
+    // The syntax error in broken's body waits for its first call
+    assert(compile(lazy_vm, source, &chunk));
+    ember_chunk* add = find_function_chunk(lazy_vm, "add");
+    assert(add != NULL && add->lazy_body != NULL && add->count == 0);
+    // Compiling outer defines inner, so it can't wait
+    ember_chunk* outer = find_function_chunk(lazy_vm, "outer");
+    assert(outer != NULL && outer->lazy_body == NULL && find_function_chunk(lazy_vm, "inner") != NULL);
+    
+    // The body compiles to the same code and positions as it would have
+    assert(ember_chunk_compile_lazy(lazy_vm, add) == EMBER_SUCCESS);
+    assert(add->lazy_body == NULL && add->count == eager->count);
+    assert(memcmp(add->code, eager->code, (size_t)add->count) == 0);
+    int column = 0;
+    assert(ember_chunk_position_at(add, 0, &column) == 2 && column == 5);
+    assert(ember_chunk_compile_lazy(lazy_vm, add) == EMBER_SUCCESS);
+    
+    free_chunk(&chunk);
+    
+    // Calling a function compiles its body first
+    init_chunk(&chunk);
+    assert(compile(lazy_vm, "fn mul(a, b) {\n    return a * b\n}\n", &chunk));
+    ember_chunk* mul = find_function_chunk(lazy_vm, "mul");
+    assert(mul != NULL && mul->lazy_body != NULL);
+    ember_value args[2] = {ember_make_number(2), ember_make_number(3)};
+    ember_value result;
+    int slot = ember_global_find(lazy_vm, "mul", 3);
+    assert(slot >= 0);
+    assert(vm_call_value(lazy_vm, lazy_vm->globals[slot].value, 2, args, &result) == 0);
+    assert(result.type == EMBER_VAL_NUMBER && result.as.number_val == 6);
+    assert(mul->lazy_body == NULL && mul->count > 0);
+    free_chunk(&chunk);
+    
+    // A broken body fails on every attempt and keeps its source
+    ember_chunk* broken = find_function_chunk(lazy_vm, "broken");
+    assert(broken != NULL && broken->lazy_body != NULL);
+    assert(ember_chunk_compile_lazy(lazy_vm, broken) == EMBER_ERROR_OPERATION_FAILED);
+    assert(broken->lazy_body != NULL && broken->count == 0);
+    ember_vm_clear_error(lazy_vm);
+    assert(ember_vm_compile_lazy_functions(lazy_vm) == EMBER_ERROR_OPERATION_FAILED);
+    ember_vm_clear_error(lazy_vm);
+    printf("  Bodies compile on demand to the eager code\n");
+    
+    ember_free_vm(lazy_vm);
+    printf("Lazy function bodies test completed\n");
+    ember_free_vm(vm);
+}
+
+static int count_opcode(const ember_chunk* chunk, uint8_t op) {
+    int found = 0;
+    for (int offset = 0; offset < chunk->count;) {
+        uint8_t code = chunk->code[offset];
+        found += code == op;
+        if (opcode_fused_size(code) > 0) {
+            offset += opcode_fused_size(code);
+        } else if (code == OP_WIDE) {
+            offset += 4;
+        } else {
+            offset += opcode_has_operand(code) ? 2 : 1;
+        }
+    }
+    return found;
+}
+
+static double call_number(ember_vm* vm, const char* name, double x) {
+    int slot = ember_global_find(vm, name, (int)strlen(name));
+    assert(slot >= 0);
+    ember_value arg = ember_make_number(x);
+    ember_value result;
+    assert(vm_call_value(vm, vm->globals[slot].value, 1, &arg, &result) == 0);
+    assert(result.type == EMBER_VAL_NUMBER);
+    return result.as.number_val;
+}
+
+void test_inlined_calls(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    
+    printf("Testing inlined calls...\n");
+    
+    vm_set_optimization_level(2);
+    ember_chunk chunk;
+    init_chunk(&chunk);
+    assert(compile(vm,
+        "fn add(a, b) {\n"
+        "    c = a + b\n"
+        "    return c\n"
+        "}\n"
+        "fn magnitude(x) {\n"
+        "    if (x < 0) { return 0 - x }\n"
+        "    return x\n"
+        "}\n"
+        "fn twice(x) {\n"
+        "    return add(x, x)\n"
+        "}\n"
+        "fn total(x) {\n"
+        "    y = add(x, 1) + magnitude(x)\n"
+        "    return twice(y)\n"
+        "}\n", &chunk));
+    
+    // Small leaf bodies are copied in behind a guard; twice calls add, so
+    // it stays a call
+    ember_chunk* total = find_function_chunk(vm, "total");
+    assert(total != NULL);
+    assert(count_opcode(total, OP_CALL_GUARD) == 2);
+    assert(count_opcode(find_function_chunk(vm, "twice"), OP_CALL_GUARD) == 1);
+    assert(call_number(vm, "total", -3) == 2);
+    assert(call_number(vm, "total", 2) == 10);
+    free_chunk(&chunk);
+    
+    // Redefining add sends the inlined sites through a real call
+    init_chunk(&chunk);
+    assert(compile(vm, "fn add(a, b) {\n    return a * b\n}\n", &chunk));
+    assert(call_number(vm, "twice", 5) == 25);
+    assert(call_number(vm, "total", 2) == 16);
+    free_chunk(&chunk);
+    printf("  Inlined bodies fall back to the call once the global changes\n");
+    
+    vm_set_optimization_level(1);
+    ember_free_vm(vm);
+    printf("Inlined calls test completed\n");
+}
+
+void test_range_loops(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    
+    printf("Testing range loops...\n");
+    
+    // 1..5 is a number, '..' and a number, not 1. and .5
+    lexer lx;
+    lexer_init(&lx, "1..5");
+    assert(lexer_scan_token(&lx).type == TOKEN_NUMBER);
+    assert(lexer_scan_token(&lx).type == TOKEN_DOT_DOT);
+    assert(lexer_scan_token(&lx).type == TOKEN_NUMBER);
+    
+    vm_set_optimization_level(2);
+    ember_chunk chunk;
+    init_chunk(&chunk);
+    assert(compile(vm,
+        "fn sum(n) {\n"
+        "    total = 0\n"
+        "    for i in 0..n {\n"
+        "        if (i == 3) { continue }\n"
+        "        if (i == 8) { break }\n"
+        "        total = total + i\n"
+        "    }\n"
+        "    for (j in 1..4) total = total + j * 100\n"
+        "    return total\n"
+        "}\n", &chunk));
+    
+    // Counters are locals, fused with a literal bound; no array is built
+    ember_chunk* sum = find_function_chunk(vm, "sum");
+    assert(sum != NULL);
+    assert(count_opcode(sum, OP_ARRAY_NEW) == 0);
+    assert(count_opcode(sum, OP_ADD_LOCAL_CONST) == 2);
+    assert(count_opcode(sum, OP_LOCAL_LESS_CONST_JUMP_IF_FALSE) == 1);
+    // 0+1+2+4+5+6+7 (3 skipped, stops at 8), then 100+200+300
+    assert(call_number(vm, "sum", 20) == 625);
+    assert(call_number(vm, "sum", 5) == 607);
+    assert(call_number(vm, "sum", 0) == 600);
+    free_chunk(&chunk);
+    vm_set_optimization_level(1);
+    
+    // At top level the counter is a global
+    assert(ember_eval(vm, "n_end = 6\ncount = 0\nfor k in 2..n_end { count = count + 1 }\n") == 0);
+    int slot = ember_global_find(vm, "count", 5);
+    assert(slot >= 0 && vm->globals[slot].value.as.number_val == 4);
+    slot = ember_global_find(vm, "k", 1);
+    assert(slot >= 0 && vm->globals[slot].value.as.number_val == 6);
+    printf("  Range loops count without allocating\n");
+    
+    ember_free_vm(vm);
+    printf("Range loops test completed\n");
+}
+
 int main(int argc, char* argv[]) {
     (void)argc;
     (void)argv;
@@ -684,6 +1033,21 @@ int main(int argc, char* argv[]) {
     test_statement_error_cases();
     printf("\n");
     
+    test_local_slot_resolution();
+    printf("\n");
+    
+    test_wide_operands();
+    printf("\n");
+    
+    test_lazy_function_bodies();
+    printf("\n");
+    
+    test_inlined_calls();
+    printf("\n");
+    
+    test_range_loops();
+    printf("\n");
+    
     printf("======================================\n");
     printf("All parser statement tests completed!\n");
     return 0;
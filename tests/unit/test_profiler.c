@@ -0,0 +1,236 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/core/optimizer.h"
+#include "../../src/frontend/frontend.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static ember_chunk* new_chunk(void) {
+    ember_chunk* chunk = malloc(sizeof(ember_chunk));
+    assert(chunk);
+    init_chunk(chunk);
+    return chunk;
+}
+
+static void free_test_chunk(ember_chunk* chunk) {
+    free_chunk(chunk);
+    free(chunk);
+}
+
+static const ember_function_profile* find_function(const ember_profile* profile, const ember_chunk* chunk) {
+    for (int i = 0; i < profile->function_count; i++) {
+        if (profile->functions[i].chunk == chunk) return &profile->functions[i];
+    }
+    return NULL;
+}
+
+static uint64_t line_hits(const ember_profile* profile, const ember_chunk* chunk, int line) {
+    for (int i = 0; i < profile->line_count; i++) {
+        if (profile->lines[i].chunk == chunk && profile->lines[i].line == line) return profile->lines[i].hits;
+    }
+    return 0;
+}
+
+void test_line_table(void) {
+    ember_chunk* chunk = new_chunk();
+    ember_chunk_mark_line(chunk, 1);
+    write_chunk_op(chunk, OP_PUSH_CONST, 0);
+    // A statement that emits nothing gives its run to the next one
+    ember_chunk_mark_line(chunk, 2);
+    ember_chunk_mark_line(chunk, 3);
+    write_chunk(chunk, OP_POP);
+    ember_chunk_mark_line(chunk, 3);
+    write_chunk(chunk, OP_HALT);
+
+    assert(chunk->line_count == 2);
+    assert(ember_chunk_line_at(chunk, 0) == 1 && ember_chunk_line_at(chunk, 1) == 1);
+    assert(ember_chunk_line_at(chunk, 2) == 3 && ember_chunk_line_at(chunk, 3) == 3);
+    assert(ember_chunk_line_at(chunk, 4) == 0);
+
+    ember_chunk_free_lines(chunk);
+    assert(chunk->lines == NULL && ember_chunk_line_at(chunk, 0) == 0);
+    free_test_chunk(chunk);
+    printf("  ✓ Line tables map code offsets to statement lines\n");
+}
+
+void test_line_positions(void) {
+    // Statements sharing a line get runs of their own, told apart by column
+    ember_vm* vm = ember_new_vm();
+    ember_chunk chunk;
+    init_chunk(&chunk);
+    assert(compile(vm, "a = 1\nb = 2; c = a + b\n\n\n    d = c\n", &chunk));
+    int column = -1;
+    assert(ember_chunk_position_at(&chunk, 0, &column) == 1 && column == 1);
+    assert(chunk.line_count == 4);
+    assert(chunk.lines[1].line == 2 && chunk.lines[1].column == 1);
+    assert(chunk.lines[2].line == 2 && chunk.lines[2].column == 8);
+    assert(chunk.lines[3].line == 5 && chunk.lines[3].column == 5);
+    assert(ember_chunk_position_at(&chunk, chunk.lines[2].start, &column) == 2 && column == 8);
+    assert(ember_chunk_position_at(&chunk, chunk.count, &column) == 0 && column == 0);
+    free_chunk(&chunk);
+
+    // A long function costs a few bytes per statement, not per instruction
+    ember_chunk* big = new_chunk();
+    for (int line = 1; line <= 1000; line++) {
+        ember_chunk_mark_position(big, line, 5);
+        for (int i = 0; i < 6; i++) write_chunk(big, OP_POP);
+    }
+    assert(big->line_count == 1000 && big->line_table_length == 3000);
+    assert(big->lines == NULL);
+    assert(ember_chunk_line_at(big, 6 * 999 + 3) == 1000);
+    assert(big->lines != NULL);
+
+    // Installed tables are checked against the code
+    ember_chunk* copy = new_chunk();
+    for (int i = 0; i < big->count; i++) write_chunk(copy, OP_POP);
+    assert(ember_chunk_set_line_table(copy, big->line_table, big->line_table_length));
+    assert(copy->line_count == 1000 && ember_chunk_line_at(copy, 6 * 500) == 501);
+    // Appending after an installed table continues its deltas
+    ember_chunk_mark_position(copy, 2000, 1);
+    write_chunk(copy, OP_HALT);
+    assert(ember_chunk_line_at(copy, copy->count - 1) == 2000 && ember_chunk_line_at(copy, 0) == 1);
+    uint8_t truncated[2] = {0x80, 0x80};
+    assert(!ember_chunk_set_line_table(copy, truncated, 2));
+    uint8_t past_code[3] = {0x7F, 0x02, 0x00};
+    ember_chunk* small = new_chunk();
+    write_chunk(small, OP_HALT);
+    assert(!ember_chunk_set_line_table(small, past_code, 3));
+    uint8_t no_line[3] = {0x00, 0x00, 0x00};
+    assert(!ember_chunk_set_line_table(small, no_line, 3));
+    free_test_chunk(small);
+    free_test_chunk(copy);
+    free_test_chunk(big);
+    ember_free_vm(vm);
+    printf("  ✓ Line tables record columns in a few bytes per statement\n");
+}
+
+void test_recording(void) {
+    ember_vm* vm = ember_new_vm();
+    ember_frame frames[1];
+    vm->frames = frames;
+    vm->frame_capacity = 1;
+
+    // main: line 1 PUSH_CONST 0, line 2 CALL 0 (returns to) POP
+    ember_chunk* main = new_chunk();
+    ember_chunk_mark_line(main, 1);
+    write_chunk_op(main, OP_PUSH_CONST, 0);
+    ember_chunk_mark_line(main, 2);
+    write_chunk_op(main, OP_CALL, 0);
+    write_chunk(main, OP_POP);
+    // callee: line 7 ADD, RETURN
+    ember_chunk* callee = new_chunk();
+    ember_chunk_mark_line(callee, 7);
+    write_chunk(callee, OP_ADD);
+    write_chunk(callee, OP_RETURN);
+
+    assert(ember_vm_set_profiling(vm, 1) == EMBER_SUCCESS);
+    vm->chunk = main;
+    for (int round = 0; round < 3; round++) {
+        vm_profile_instruction(vm, main->code);
+        vm_profile_instruction(vm, main->code + 2);
+        // OP_CALL enters the callee
+        frames[0].chunk = main;
+        vm->frame_count = 1;
+        vm->chunk = callee;
+        vm_profile_call(vm, callee, "work");
+        vm_profile_instruction(vm, callee->code);
+        vm_profile_instruction(vm, callee->code + 1);
+        // OP_RETURN resumes main
+        vm->frame_count = 0;
+        vm->chunk = main;
+        vm_profile_instruction(vm, main->code + 4);
+    }
+    vm_profile_pause(vm);
+
+    const ember_profile* profile = ember_vm_get_profile(vm);
+    assert(profile && profile->instructions == 15);
+    assert(profile->opcodes[OP_CALL].count == 3 && profile->opcodes[OP_ADD].count == 3);
+    assert(profile->opcodes[OP_POP].count == 3);
+    assert(profile->opcodes[OP_ADD].cycles > 0);
+
+    const ember_function_profile* work = find_function(profile, callee);
+    const ember_function_profile* script = find_function(profile, main);
+    assert(work && strcmp(work->name, "work") == 0 && work->calls == 3);
+    assert(script && strcmp(script->name, "<script>") == 0);
+    assert(work->inclusive_cycles >= work->exclusive_cycles);
+    assert(script->inclusive_cycles >= script->exclusive_cycles + work->exclusive_cycles);
+
+    // Statements count once per execution, not per instruction
+    assert(line_hits(profile, main, 1) == 3 && line_hits(profile, main, 2) == 3);
+    assert(line_hits(profile, callee, 7) == 3);
+
+    ember_optimization_stats stats;
+    ember_get_optimization_stats(vm, &stats);
+    assert(stats.profile == profile && stats.instructions_executed >= 15);
+
+    const char* path = "/tmp/ember_test_profile.txt";
+    assert(ember_vm_write_profile(vm, path) == EMBER_SUCCESS);
+    FILE* report = fopen(path, "r");
+    assert(report);
+    char text[4096];
+    size_t length = fread(text, 1, sizeof(text) - 1, report);
+    text[length] = '\0';
+    fclose(report);
+    remove(path);
+    assert(strstr(text, "CALL") && strstr(text, "work"));
+
+    // Disabling keeps the results; nothing more is recorded
+    assert(ember_vm_set_profiling(vm, 0) == EMBER_SUCCESS);
+    vm_profile_instruction(vm, main->code);
+    assert(ember_vm_get_profile(vm)->instructions == 15);
+
+    vm_profile_free(vm);
+    assert(vm->profile == NULL);
+    vm->frames = NULL;
+    vm->frame_capacity = 0;
+    vm->chunk = NULL;
+    free_test_chunk(callee);
+    free_test_chunk(main);
+    ember_free_vm(vm);
+    printf("  ✓ Opcodes, functions and lines are counted and timed\n");
+}
+
+void test_script_profile(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(ember_vm_set_profiling(vm, 1) == EMBER_SUCCESS);
+    assert(ember_eval(vm,
+        "fn square(x) {\n"
+        "    return x * x\n"
+        "}\n"
+        "total = 0\n"
+        "i = 0\n"
+        "while (i < 100) {\n"
+        "    total = total + square(i)\n"
+        "    i = i + 1\n"
+        "}\n") == 0);
+    const ember_profile* profile = ember_vm_get_profile(vm);
+    assert(profile && profile->instructions > 0);
+    int found = 0;
+    for (int i = 0; i < profile->function_count; i++) {
+        if (strcmp(profile->functions[i].name, "square") == 0) {
+            assert(profile->functions[i].calls == 100);
+            found = 1;
+        }
+    }
+    assert(found);
+    int line_eight = 0;
+    for (int i = 0; i < profile->line_count; i++) {
+        if (profile->lines[i].line == 8) line_eight = profile->lines[i].hits == 100;
+    }
+    assert(line_eight);
+    ember_free_vm(vm);
+    printf("  ✓ Scripts report calls per function and hits per line\n");
+}
+
+int main(void) {
+    printf("Testing execution profiler...\n");
+    test_line_table();
+    test_line_positions();
+    test_recording();
+    test_script_profile();
+    printf("✓ Profiler tests passed\n");
+    return 0;
+}
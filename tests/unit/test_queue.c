@@ -0,0 +1,265 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+static ember_value native_value(ember_native_func func) {
+    ember_value value;
+    value.type = EMBER_VAL_NATIVE;
+    value.as.native_val = func;
+    return value;
+}
+
+static int compare_calls = 0;
+
+// Largest first
+static ember_value native_descending(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    assert(argc == 2 && argv[0].type == EMBER_VAL_NUMBER && argv[1].type == EMBER_VAL_NUMBER);
+    compare_calls++;
+    return ember_make_number(argv[1].as.number_val - argv[0].as.number_val);
+}
+
+static ember_value native_broken(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    (void)argc;
+    (void)argv;
+    return ember_make_nil();
+}
+
+void test_deque_ends(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value value = keep(vm, ember_make_deque(vm, 0));
+    ember_deque* d = AS_DEQUE(value);
+    ember_value out;
+    assert(!deque_pop_front(d, &out) && !deque_pop_back(d, &out));
+
+    // Pushing at the front wraps the head round before the buffer grows
+    for (int i = 0; i < 5; i++) {
+        assert(deque_push_back(vm, d, ember_make_number(i)));
+        assert(deque_push_front(vm, d, ember_make_number(-1 - i)));
+    }
+    assert(d->length == 10 && d->capacity == 16);
+    for (int i = 0; i < 10; i++) {
+        assert(deque_at(d, i).as.number_val == i - 5);
+    }
+    assert(deque_pop_front(d, &out) && out.as.number_val == -5);
+    assert(deque_pop_back(d, &out) && out.as.number_val == 4);
+
+    // A queue that never holds much keeps a small buffer however far the
+    // head travels
+    for (int i = 0; i < 1000; i++) {
+        assert(deque_push_back(vm, d, ember_make_number(i)));
+        assert(deque_pop_front(d, &out));
+    }
+    assert(d->length == 8 && d->capacity == 16);
+
+    // Bursts grow it and draining gives the memory back
+    for (int i = 0; i < 5000; i++) {
+        assert(deque_push_front(vm, d, ember_make_number(i)));
+    }
+    assert(d->capacity == 8192 && deque_at(d, 0).as.number_val == 4999);
+    while (d->length > 2) {
+        assert(deque_pop_back(d, &out));
+    }
+    assert(d->capacity == 8 && deque_at(d, 0).as.number_val == 4999);
+    assert(deque_at(d, 1).as.number_val == 4998);
+    ember_free_vm(vm);
+    printf("  ✓ Deques push and pop at both ends of a ring buffer that grows and shrinks\n");
+}
+
+void test_deque_natives(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value source = keep(vm, ember_make_array(vm, 4));
+    for (int i = 1; i <= 3; i++) {
+        array_push_with_vm(vm, AS_ARRAY(source), ember_make_number(i));
+    }
+    ember_value deque = keep(vm, ember_native_deque(vm, 1, &source));
+    assert(deque.type == EMBER_VAL_DEQUE && AS_DEQUE(deque)->length == 3);
+    assert(strcmp(value_type_to_string(deque.type), "deque") == 0);
+
+    ember_value args[2] = {deque, text(vm, "front")};
+    assert(ember_native_deque_push_front(vm, 2, args).as.number_val == 4);
+    args[1] = ember_make_number(4);
+    assert(ember_native_deque_push_back(vm, 2, args).as.number_val == 5);
+    assert(strcmp(AS_CSTRING(ember_native_deque_peek_front(vm, 1, &deque)), "front") == 0);
+    assert(ember_native_deque_peek_back(vm, 1, &deque).as.number_val == 4);
+
+    // Negative indexes count from the back
+    args[1] = ember_make_number(-2);
+    assert(ember_native_deque_get(vm, 2, args).as.number_val == 3);
+    args[1] = ember_make_number(1);
+    assert(ember_native_deque_get(vm, 2, args).as.number_val == 1);
+    args[1] = ember_make_number(5);
+    assert(ember_native_deque_get(vm, 2, args).type == EMBER_VAL_NIL);
+    args[1] = ember_make_number(-6);
+    assert(ember_native_deque_get(vm, 2, args).type == EMBER_VAL_NIL);
+    args[1] = ember_make_number(0.5);
+    assert(ember_native_deque_get(vm, 2, args).type == EMBER_VAL_NIL);
+    args[1] = ember_make_number(NAN);
+    assert(ember_native_deque_get(vm, 2, args).type == EMBER_VAL_NIL);
+
+    assert(ember_native_deque_pop_back(vm, 1, &deque).as.number_val == 4);
+    assert(ember_native_deque_pop_front(vm, 1, &deque).type == EMBER_VAL_STRING);
+    ember_value array = keep(vm, ember_native_deque_to_array(vm, 1, &deque));
+    assert(array.type == EMBER_VAL_ARRAY && AS_ARRAY(array)->length == 3);
+    assert(AS_ARRAY(array)->elements[2].as.number_val == 3);
+    assert(ember_native_deque_clear(vm, 1, &deque).as.obj_val == deque.as.obj_val);
+    assert(AS_DEQUE(deque)->length == 0);
+    assert(ember_native_deque_pop_front(vm, 1, &deque).type == EMBER_VAL_NIL);
+    assert(ember_native_deque_peek_back(vm, 1, &deque).type == EMBER_VAL_NIL);
+    assert(ember_native_deque(vm, 0, NULL).type == EMBER_VAL_DEQUE);
+
+    // Bad receivers and sources
+    args[0] = text(vm, "not a deque");
+    assert(ember_native_deque_push_back(vm, 2, args).type == EMBER_VAL_NIL);
+    assert(ember_native_deque_pop_front(vm, 1, args).type == EMBER_VAL_NIL);
+    assert(ember_native_deque(vm, 1, args).type == EMBER_VAL_NIL);
+    assert(ember_native_deque_push_back(vm, 1, &deque).type == EMBER_VAL_NIL);
+    ember_free_vm(vm);
+    printf("  ✓ deque natives push, pop, index and refuse bad arguments\n");
+}
+
+void test_priority_order(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value value = keep(vm, ember_make_priority_queue(vm, ember_make_nil()));
+    ember_priority_queue* q = AS_PRIORITY_QUEUE(value);
+
+    // Priorities from a fixed scramble, each pushed twice so ties come up
+    for (int i = 0; i < 1000; i++) {
+        double priority = (double)((i * 7919) % 500);
+        assert(priority_queue_push(vm, q, ember_make_number(i), ember_make_number(priority)) == 1);
+    }
+    assert(q->length == 1000);
+    double last = -1;
+    int last_value = -1;
+    for (int i = 0; i < 1000; i++) {
+        ember_value out;
+        assert(priority_queue_pop(vm, q, &out) == 1);
+        double priority = (double)(((int)out.as.number_val * 7919) % 500);
+        assert(priority >= last);
+        // Equal priorities come out in the order they went in
+        if (priority == last) assert(out.as.number_val > last_value);
+        last = priority;
+        last_value = (int)out.as.number_val;
+    }
+    ember_value out;
+    assert(q->length == 0 && priority_queue_pop(vm, q, &out) == 0);
+
+    // Without a comparator only numbers, and no NaN, are priorities
+    assert(priority_queue_push(vm, q, ember_make_number(1), ember_make_number(NAN)) == 0);
+    assert(priority_queue_push(vm, q, ember_make_number(1), text(vm, "1")) == 0);
+    assert(priority_queue_push(vm, q, ember_make_number(1), ember_make_number(-INFINITY)) == 1);
+    assert(q->length == 1);
+    ember_free_vm(vm);
+    printf("  ✓ Number priorities come out smallest first, ties first in first out\n");
+}
+
+void test_comparators(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value compare = native_value(native_descending);
+    ember_value queue = keep(vm, ember_native_priority_queue(vm, 1, &compare));
+    assert(queue.type == EMBER_VAL_PRIORITY_QUEUE);
+    assert(strcmp(value_type_to_string(queue.type), "priority_queue") == 0);
+    ember_value args[3] = {queue, ember_make_nil(), ember_make_nil()};
+    for (int i = 0; i < 100; i++) {
+        args[1] = ember_make_number((i * 37) % 100);
+        assert(ember_native_pqueue_push(vm, 2, args).as.number_val == i + 1);
+    }
+    assert(compare_calls > 0);
+    for (int i = 99; i >= 0; i--) {
+        assert(ember_native_pqueue_peek(vm, 1, &queue).as.number_val == i);
+        assert(ember_native_pqueue_pop(vm, 1, &queue).as.number_val == i);
+    }
+
+    // A comparator that gives no number fails the push; the value is
+    // queued all the same and the queue is unlocked again
+    compare = native_value(native_broken);
+    ember_value broken = keep(vm, ember_native_priority_queue(vm, 1, &compare));
+    args[0] = broken;
+    args[1] = ember_make_number(1);
+    assert(ember_native_pqueue_push(vm, 2, args).as.number_val == 1);
+    assert(ember_native_pqueue_push(vm, 2, args).type == EMBER_VAL_NIL);
+    assert(AS_PRIORITY_QUEUE(broken)->length == 2 && !AS_PRIORITY_QUEUE(broken)->busy);
+
+    // A script comparator, on priorities given apart from the values
+    assert(ember_eval(vm,
+        "fn by_length(a, b) { return len(a) - len(b) }\n"
+        "q = priority_queue(by_length)\n"
+        "pqueue_push(q, 1, \"ccc\")\n"
+        "pqueue_push(q, 2, \"a\")\n"
+        "pqueue_push(q, 3, \"bb\")\n"
+        "pqueue_push(q, 4, \"z\")\n"
+        "order = [pqueue_pop(q), pqueue_pop(q), pqueue_pop(q), pqueue_pop(q)]\n"
+        "empty = pqueue_pop(q)\n") == 0);
+    ember_value order = global_value(vm, "order");
+    assert(order.type == EMBER_VAL_ARRAY && AS_ARRAY(order)->length == 4);
+    const double expected[] = {2, 4, 3, 1};
+    for (int i = 0; i < 4; i++) {
+        assert(AS_ARRAY(order)->elements[i].as.number_val == expected[i]);
+    }
+    assert(global_value(vm, "empty").type == EMBER_VAL_NIL);
+
+    // Bad comparators and receivers
+    compare = text(vm, "not callable");
+    assert(ember_native_priority_queue(vm, 1, &compare).type == EMBER_VAL_NIL);
+    args[0] = text(vm, "not a queue");
+    assert(ember_native_pqueue_push(vm, 2, args).type == EMBER_VAL_NIL);
+    assert(ember_native_pqueue_pop(vm, 1, args).type == EMBER_VAL_NIL);
+    assert(ember_native_pqueue_clear(vm, 1, &broken).as.obj_val == broken.as.obj_val);
+    assert(AS_PRIORITY_QUEUE(broken)->length == 0);
+    ember_free_vm(vm);
+    printf("  ✓ Comparators order priorities, and one that fails is reported\n");
+}
+
+void test_gc(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_gc_configure(vm, 1, 0, 1, 0);
+    ember_value deque = keep(vm, ember_make_deque(vm, 0));
+    ember_value queue = keep(vm, ember_make_priority_queue(vm, ember_make_nil()));
+    gc_collect_minor(vm);
+    assert(deque.as.obj_val->is_old && queue.as.obj_val->is_old);
+
+    // Young values put into old containers are remembered and kept
+    char buffer[64];
+    for (int i = 0; i < 500; i++) {
+        snprintf(buffer, sizeof(buffer), "value %d", i);
+        ember_value value = ember_make_string_gc(vm, buffer);
+        vm->stack[vm->stack_top++] = value;
+        assert(deque_push_front(vm, AS_DEQUE(deque), value));
+        assert(priority_queue_push(vm, AS_PRIORITY_QUEUE(queue), value, ember_make_number(i)) == 1);
+        vm->stack_top--;
+    }
+    assert(deque.as.obj_val->is_remembered && queue.as.obj_val->is_remembered);
+    gc_collect_minor(vm);
+    ember_gc_collect(vm);
+    for (int i = 0; i < 500; i++) {
+        ember_value out;
+        snprintf(buffer, sizeof(buffer), "value %d", i);
+        assert(deque_pop_back(AS_DEQUE(deque), &out) && strcmp(AS_CSTRING(out), buffer) == 0);
+        assert(priority_queue_pop(vm, AS_PRIORITY_QUEUE(queue), &out) == 1);
+        assert(strcmp(AS_CSTRING(out), buffer) == 0);
+    }
+    ember_free_vm(vm);
+    printf("  ✓ Elements and priorities are traced, through the write barrier too\n");
+}
+
+int main(void) {
+    printf("Running deque and priority queue tests...\n");
+    test_deque_ends();
+    test_deque_natives();
+    test_priority_order();
+    test_comparators();
+    test_gc();
+    printf("All deque and priority queue tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,252 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static void set_stack(ember_vm* vm, ember_value a, ember_value b) {
+    vm->stack[0] = a;
+    vm->stack[1] = b;
+    vm->stack_top = 2;
+}
+
+// Run the instruction at offset the way the dispatch loop does: feedback
+// first, then the quickened handler if the opcode has been rewritten
+static vm_operation_result step(ember_vm* vm, ember_chunk* chunk, int offset) {
+    uint8_t op = chunk->code[offset];
+    vm_feedback_record(vm, chunk, offset, op, 0);
+    if (opcode_generic(chunk->code[offset]) != chunk->code[offset]) {
+        return vm_handle_quickened(vm, chunk, &chunk->code[offset]);
+    }
+    return VM_RESULT_CONTINUE;
+}
+
+static ember_chunk* new_chunk(void) {
+    ember_chunk* chunk = malloc(sizeof(ember_chunk));
+    assert(chunk);
+    init_chunk(chunk);
+    return chunk;
+}
+
+static void free_test_chunk(ember_chunk* chunk) {
+    free_chunk(chunk);
+    free(chunk);
+}
+
+void test_number_sites(void) {
+    ember_vm* vm = ember_new_vm();
+    ember_chunk* chunk = new_chunk();
+    write_chunk(chunk, OP_ADD);
+    write_chunk(chunk, OP_LESS);
+    write_chunk(chunk, OP_DIV);
+
+    // Generic until the site has run often enough with numbers
+    for (int i = 0; i < 15; i++) {
+        set_stack(vm, ember_make_number(i), ember_make_number(1));
+        assert(step(vm, chunk, 0) == VM_RESULT_CONTINUE);
+        assert(chunk->code[0] == OP_ADD);
+    }
+    set_stack(vm, ember_make_number(15), ember_make_number(1));
+    step(vm, chunk, 0);
+    assert(chunk->code[0] == OP_ADD_NUMBER);
+    assert(opcode_generic(OP_ADD_NUMBER) == OP_ADD);
+
+    set_stack(vm, ember_make_number(40), ember_make_number(2));
+    assert(vm_handle_quickened(vm, chunk, &chunk->code[0]) == VM_RESULT_OK);
+    assert(vm->stack_top == 1 && vm->stack[0].as.number_val == 42);
+
+    for (int i = 0; i < 16; i++) {
+        set_stack(vm, ember_make_number(i), ember_make_number(8));
+        step(vm, chunk, 1);
+    }
+    assert(chunk->code[1] == OP_LESS_NUMBER);
+    set_stack(vm, ember_make_number(1), ember_make_number(8));
+    assert(vm_handle_quickened(vm, chunk, &chunk->code[1]) == VM_RESULT_OK);
+    assert(vm->stack[0].type == EMBER_VAL_BOOL && vm->stack[0].as.bool_val);
+
+    // Dividing by zero is left to OP_DIV without giving up the specialization
+    for (int i = 0; i < 16; i++) {
+        set_stack(vm, ember_make_number(i), ember_make_number(4));
+        step(vm, chunk, 2);
+    }
+    assert(chunk->code[2] == OP_DIV_NUMBER);
+    set_stack(vm, ember_make_number(1), ember_make_number(0));
+    assert(vm_handle_quickened(vm, chunk, &chunk->code[2]) == VM_RESULT_CONTINUE);
+    assert(vm->stack_top == 2 && chunk->code[2] == OP_DIV_NUMBER);
+
+    vm->stack_top = 0;
+    free_test_chunk(chunk);
+    ember_free_vm(vm);
+    printf("  ✓ Monomorphic number sites are quickened\n");
+}
+
+void test_type_miss(void) {
+    ember_vm* vm = ember_new_vm();
+    ember_chunk* chunk = new_chunk();
+    write_chunk(chunk, OP_SUB);
+    for (int i = 0; i < 20; i++) {
+        set_stack(vm, ember_make_number(i), ember_make_number(1));
+        step(vm, chunk, 0);
+    }
+    assert(chunk->code[0] == OP_SUB_NUMBER);
+
+    // A nil operand writes OP_SUB back and leaves the stack for it
+    set_stack(vm, ember_make_nil(), ember_make_number(1));
+    assert(step(vm, chunk, 0) == VM_RESULT_CONTINUE);
+    assert(chunk->code[0] == OP_SUB);
+    assert(vm->stack_top == 2 && vm->stack[0].type == EMBER_VAL_NIL);
+
+    // The generic opcode records the miss: polymorphic sites stay generic
+    step(vm, chunk, 0);
+    assert(ember_chunk_feedback_at(chunk, 0)->state == EMBER_FEEDBACK_POLYMORPHIC);
+    for (int i = 0; i < 20; i++) {
+        set_stack(vm, ember_make_number(i), ember_make_number(1));
+        step(vm, chunk, 0);
+    }
+    assert(chunk->code[0] == OP_SUB);
+
+    // Shared code is never rewritten
+    ember_chunk* shared = new_chunk();
+    write_chunk(shared, OP_MUL);
+    shared->code_borrowed = 1;
+    for (int i = 0; i < 20; i++) {
+        set_stack(vm, ember_make_number(i), ember_make_number(2));
+        step(vm, shared, 0);
+    }
+    assert(shared->code[0] == OP_MUL);
+    shared->code_borrowed = 0;
+
+    vm->stack_top = 0;
+    free_test_chunk(shared);
+    free_test_chunk(chunk);
+    ember_free_vm(vm);
+    printf("  ✓ Type misses fall back to the generic opcode\n");
+}
+
+void test_array_index(void) {
+    ember_vm* vm = ember_new_vm();
+    ember_chunk* chunk = new_chunk();
+    write_chunk(chunk, OP_ARRAY_GET);
+    ember_value array = ember_make_array(vm, 4);
+    ember_array* elements = AS_ARRAY(array);
+    for (int i = 0; i < 4; i++) elements->elements[i] = ember_make_number(i * 10);
+    elements->length = 4;
+
+    for (int i = 0; i < 16; i++) {
+        set_stack(vm, array, ember_make_number(i % 4));
+        step(vm, chunk, 0);
+    }
+    assert(chunk->code[0] == OP_ARRAY_GET_NUMBER_INDEX);
+
+    set_stack(vm, array, ember_make_number(3));
+    assert(vm_handle_quickened(vm, chunk, &chunk->code[0]) == VM_RESULT_OK);
+    assert(vm->stack_top == 1 && vm->stack[0].as.number_val == 30);
+
+    // Out of range and fractional indices take the generic path
+    set_stack(vm, array, ember_make_number(4));
+    assert(vm_handle_quickened(vm, chunk, &chunk->code[0]) == VM_RESULT_CONTINUE);
+    set_stack(vm, array, ember_make_number(1.5));
+    assert(vm_handle_quickened(vm, chunk, &chunk->code[0]) == VM_RESULT_CONTINUE);
+    assert(chunk->code[0] == OP_ARRAY_GET_NUMBER_INDEX);
+
+    vm->stack_top = 0;
+    free_test_chunk(chunk);
+    ember_free_vm(vm);
+    printf("  ✓ Array reads with number indices are quickened\n");
+}
+
+void test_small_ints(void) {
+    ember_vm* vm = ember_new_vm();
+    ember_chunk* chunk = new_chunk();
+    write_chunk(chunk, OP_MUL);
+    write_chunk(chunk, OP_MOD);
+    for (int i = 0; i < 16; i++) {
+        set_stack(vm, ember_make_number(i), ember_make_number(3));
+        assert(IS_SMALL_INT(vm->stack[0]) && AS_SMALL_INT(vm->stack[0]) == i);
+        step(vm, chunk, 0);
+        set_stack(vm, ember_make_number(i), ember_make_number(3));
+        step(vm, chunk, 1);
+    }
+    assert(chunk->code[0] == OP_MUL_NUMBER && chunk->code[1] == OP_MOD_NUMBER);
+    assert(opcode_generic(OP_MOD_NUMBER) == OP_MOD);
+
+    // Integers stay integers while the result fits
+    set_stack(vm, ember_make_int(-7), ember_make_int(6));
+    assert(vm_handle_quickened(vm, chunk, &chunk->code[0]) == VM_RESULT_OK);
+    assert(IS_SMALL_INT(vm->stack[0]) && AS_SMALL_INT(vm->stack[0]) == -42 && vm->stack[0].as.number_val == -42);
+    set_stack(vm, ember_make_int(-7), ember_make_int(3));
+    assert(vm_handle_quickened(vm, chunk, &chunk->code[1]) == VM_RESULT_OK);
+    assert(IS_SMALL_INT(vm->stack[0]) && vm->stack[0].as.number_val == -1);
+
+    // and take the double path, with the same results, when it does not
+    set_stack(vm, ember_make_int(INT32_MAX), ember_make_int(2));
+    assert(vm_handle_quickened(vm, chunk, &chunk->code[0]) == VM_RESULT_OK);
+    assert(!IS_SMALL_INT(vm->stack[0]) && vm->stack[0].as.number_val == 2.0 * INT32_MAX);
+    set_stack(vm, ember_make_int(-3), ember_make_int(0));
+    assert(vm_handle_quickened(vm, chunk, &chunk->code[0]) == VM_RESULT_OK);
+    assert(vm->stack[0].as.number_val == 0 && signbit(vm->stack[0].as.number_val));
+    set_stack(vm, ember_make_int(-4), ember_make_int(2));
+    assert(vm_handle_quickened(vm, chunk, &chunk->code[1]) == VM_RESULT_OK);
+    assert(vm->stack[0].as.number_val == 0 && signbit(vm->stack[0].as.number_val));
+    set_stack(vm, ember_make_number(7.5), ember_make_int(2));
+    assert(vm_handle_quickened(vm, chunk, &chunk->code[1]) == VM_RESULT_OK);
+    assert(vm->stack[0].as.number_val == 1.5);
+    // Modulo by zero is left to OP_MOD
+    set_stack(vm, ember_make_int(1), ember_make_int(0));
+    assert(vm_handle_quickened(vm, chunk, &chunk->code[1]) == VM_RESULT_CONTINUE);
+    assert(vm->stack_top == 2 && chunk->code[1] == OP_MOD_NUMBER);
+
+    // -0 and fractions are plain doubles
+    assert(!IS_SMALL_INT(ember_make_number(-0.0)) && !IS_SMALL_INT(ember_make_number(0.5)));
+    assert(!IS_SMALL_INT(ember_make_number(4294967296.0)) && !IS_SMALL_INT(ember_make_number(NAN)));
+    ember_value index = ember_make_int(2);
+    assert(ember_number_index(&index, 3) == 2 && ember_number_index(&index, 2) == -1);
+    index = ember_make_number(1.5);
+    assert(ember_number_index(&index, 3) == -1);
+
+    vm->stack_top = 0;
+    free_test_chunk(chunk);
+    ember_free_vm(vm);
+    printf("  ✓ Small ints stay on the integer path\n");
+}
+
+static double run_script(int feedback) {
+    ember_vm* vm = ember_new_vm();
+    ember_vm_set_type_feedback(vm, feedback);
+    assert(ember_eval(vm,
+        "fn mix(n, values) {\n"
+        "    total = 0\n"
+        "    i = 0\n"
+        "    while (i < n) {\n"
+        "        total = total + values[i % 4] * i / 2\n"
+        "        i = i + 1\n"
+        "    }\n"
+        "    return total\n"
+        "}\n"
+        "data = [1, 2, 3, 4]\n"
+        "result = mix(100, data) + mix(100, data)\n") == 0);
+    int slot = ember_global_find(vm, "result", 6);
+    assert(slot >= 0);
+    double value = vm->globals[slot].value.as.number_val;
+    ember_free_vm(vm);
+    return value;
+}
+
+void test_script_results(void) {
+    assert(run_script(1) == run_script(0));
+    printf("  ✓ Quickened code computes what generic code does\n");
+}
+
+int main(void) {
+    printf("Testing opcode quickening...\n");
+    test_number_sites();
+    test_type_miss();
+    test_array_index();
+    test_small_ints();
+    test_script_results();
+    printf("✓ Quickening tests passed\n");
+    return 0;
+}
@@ -0,0 +1,126 @@
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static char* write_temp(const char* contents, size_t length) {
+    char* path = strdup("/tmp/ember_read_file_XXXXXX");
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    assert(write(fd, contents, length) == (ssize_t)length);
+    close(fd);
+    return path;
+}
+
+static ember_value read_path(ember_vm* vm, const char* path) {
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, path);
+    ember_value result = ember_native_read_file(vm, 1, &vm->stack[vm->stack_top - 1]);
+    vm->stack_top--;
+    return result;
+}
+
+// Mappings of path in this process
+static int mappings_of(const char* path) {
+    FILE* maps = fopen("/proc/self/maps", "r");
+    assert(maps);
+    char line[4096];
+    int count = 0;
+    while (fgets(line, sizeof(line), maps)) {
+        if (strstr(line, path)) count++;
+    }
+    fclose(maps);
+    return count;
+}
+
+void test_small_files(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    // Copied, and every byte kept, NULs included
+    char* path = write_temp("key=value\n\0tail", 15);
+    ember_value text = read_path(vm, path);
+    assert(text.type == EMBER_VAL_STRING);
+    ember_string* string = AS_STRING(text);
+    assert(string->length == 15 && !string->is_mapped && memcmp(string->chars, "key=value\n\0tail", 15) == 0);
+    unlink(path);
+    free(path);
+
+    // An empty file, a /proc file that stat calls empty, a directory, a missing file
+    path = write_temp("", 0);
+    text = read_path(vm, path);
+    assert(text.type == EMBER_VAL_STRING && AS_STRING(text)->length == 0);
+    unlink(path);
+    free(path);
+    text = read_path(vm, "/proc/self/status");
+    assert(text.type == EMBER_VAL_STRING && strstr(AS_CSTRING(text), "Pid:"));
+    assert(read_path(vm, "/tmp").type == EMBER_VAL_NIL);
+    assert(read_path(vm, "/nonexistent/file").type == EMBER_VAL_NIL);
+
+    ember_free_vm(vm);
+    printf("Small file test passed\n");
+}
+
+void test_mapped_files(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    // One size ending mid-page, one filling its pages exactly
+    size_t sizes[2] = {1000003, 32 * (size_t)sysconf(_SC_PAGESIZE)};
+    for (int i = 0; i < 2; i++) {
+        size_t size = sizes[i];
+        char* contents = malloc(size);
+        for (size_t j = 0; j < size; j++) contents[j] = (char)('a' + j % 26);
+        char* path = write_temp(contents, size);
+
+        ember_value text = read_path(vm, path);
+        assert(text.type == EMBER_VAL_STRING);
+        vm->stack[vm->stack_top++] = text;
+        ember_string* string = AS_STRING(text);
+        assert(string->is_mapped && string->length == (int)size);
+        assert(memcmp(string->chars, contents, size) == 0 && string->chars[size] == '\0');
+        assert(mappings_of(path) == 1);
+
+        // Same hash and equality as the copied string
+        ember_value copy;
+        copy.type = EMBER_VAL_STRING;
+        copy.as.obj_val = (ember_object*)copy_string(vm, contents, (int)size);
+        vm->stack[vm->stack_top++] = copy;
+        assert(values_equal(text, copy) && hash_value(text) == hash_value(copy));
+
+        // A slice keeps the mapping alive after the string is dropped
+        ember_string* slice = ember_string_slice(vm, string, 500, 1000);
+        assert(slice);
+        ember_value slice_value;
+        slice_value.type = EMBER_VAL_STRING;
+        slice_value.as.obj_val = (ember_object*)slice;
+        vm->stack[vm->stack_top - 2] = slice_value;
+        vm->stack_top--;
+        ember_gc_collect(vm);
+        assert(mappings_of(path) == 1);
+        assert(memcmp(ember_string_bytes(slice), contents + 500, 1000) == 0);
+
+        // Unmapped once nothing refers to it, young or old
+        vm->stack_top--;
+        gc_collect_full(vm, NULL);
+        assert(mappings_of(path) == 0);
+        unlink(path);
+        free(path);
+        free(contents);
+    }
+    ember_free_vm(vm);
+    printf("Mapped file test passed\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running read file tests...\n");
+    test_small_files();
+    test_mapped_files();
+    printf("All read file tests passed!\n");
+    return 0;
+}
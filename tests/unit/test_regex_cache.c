@@ -0,0 +1,103 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/core/vm_regex.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+void test_shared_programs(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value first = ember_make_regex(vm, "[a-z]+@example\\.com", REGEX_NONE);
+    vm->stack[vm->stack_top++] = first;
+    ember_value again = ember_make_regex(vm, "[a-z]+@example\\.com", REGEX_GLOBAL);
+    vm->stack[vm->stack_top++] = again;
+    ember_value folded = ember_make_regex(vm, "[a-z]+@example\\.com", REGEX_CASE_INSENSITIVE);
+    vm->stack[vm->stack_top++] = folded;
+
+    // One compile for both; the g flag stays on the object
+    assert(AS_REGEX(first)->compiled_regex == AS_REGEX(again)->compiled_regex);
+    assert(AS_REGEX(again)->flags == REGEX_GLOBAL);
+    assert(AS_REGEX(folded)->compiled_regex != AS_REGEX(first)->compiled_regex);
+    assert(strcmp(AS_REGEX(again)->pattern, "[a-z]+@example\\.com") == 0);
+
+    // Objects die, the cached program stays usable
+    vm->stack_top = 0;
+    ember_gc_collect(vm);
+    ember_value later = ember_make_regex(vm, "[a-z]+@example\\.com", REGEX_NONE);
+    assert(ember_regex_test(vm, AS_REGEX(later), "mail bob@example.com now"));
+    assert(!ember_regex_test(vm, AS_REGEX(later), "mail bob@example.org now"));
+
+    // More patterns than the cache holds evict the oldest, not live ones
+    vm->stack[vm->stack_top++] = later;
+    char pattern[32];
+    for (int i = 0; i < 200; i++) {
+        snprintf(pattern, sizeof(pattern), "id-%d$", i);
+        ember_value regex = ember_make_regex(vm, pattern, REGEX_NONE);
+        assert(ember_regex_test(vm, AS_REGEX(regex), pattern) == false);
+        snprintf(pattern, sizeof(pattern), "x id-%d", i);
+        assert(ember_regex_test(vm, AS_REGEX(regex), pattern));
+    }
+    ember_gc_collect(vm);
+    assert(ember_regex_test(vm, AS_REGEX(later), "amy@example.com"));
+
+    assert(ember_make_regex(vm, "(unclosed", REGEX_NONE).type == EMBER_VAL_NIL);
+    vm->stack_top = 0;
+    ember_gc_collect(vm);
+    regex_cache_free(vm);
+    ember_free_vm(vm);
+    printf("Shared program test passed\n");
+}
+
+// The literal prefilter must never turn a match into a miss
+static void check(ember_vm* vm, const char* pattern, ember_regex_flags flags, const char* text, bool expected) {
+    ember_value regex = ember_make_regex(vm, pattern, flags);
+    assert(regex.type == EMBER_VAL_REGEX);
+    if (ember_regex_test(vm, AS_REGEX(regex), text) != expected) {
+        fprintf(stderr, "/%s/ on \"%s\": expected %d\n", pattern, text, expected);
+        abort();
+    }
+}
+
+void test_prefilter(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    check(vm, "^GET /api/", REGEX_NONE, "GET /api/users", true);
+    check(vm, "^GET /api/", REGEX_NONE, "POST /api/users", false);
+    check(vm, "^GET /api/", REGEX_NONE, "x GET /api/", false);
+    check(vm, "^abc", REGEX_MULTILINE, "x\nabc", true);
+    check(vm, "colou?r", REGEX_NONE, "color", true);
+    check(vm, "colou?r", REGEX_NONE, "colour", true);
+    check(vm, "ab*c", REGEX_NONE, "ac", true);
+    check(vm, "ab+c", REGEX_NONE, "abbbc", true);
+    check(vm, "ab{0,2}c", REGEX_NONE, "ac", true);
+    check(vm, "ab{2}c", REGEX_NONE, "abbc", true);
+    check(vm, "cat|dog", REGEX_NONE, "hotdog", true);
+    check(vm, "(cat|dog)food", REGEX_NONE, "dogfood", true);
+    check(vm, "(cat|dog)food", REGEX_NONE, "dog food", false);
+    check(vm, "x[|]y", REGEX_NONE, "x|y", true);
+    check(vm, "v[0-9]+\\.[0-9]+", REGEX_NONE, "v1.2", true);
+    check(vm, "v[0-9]+\\.[0-9]+", REGEX_NONE, "v12", false);
+    check(vm, "a.c", REGEX_NONE, "abc", true);
+    check(vm, "[[:digit:]]x]", REGEX_NONE, "5x]", true);
+    check(vm, "ERROR", REGEX_CASE_INSENSITIVE, "an error here", true);
+    check(vm, "caf\xc3\xa9?s", REGEX_NONE, "caf\xc3\xa9s", true);
+    check(vm, "end$", REGEX_NONE, "the end", true);
+    check(vm, "end$", REGEX_NONE, "the ends", false);
+    check(vm, "", REGEX_NONE, "", true);
+    regex_cache_free(vm);
+    ember_free_vm(vm);
+    printf("Prefilter test passed\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running regex cache tests...\n");
+    test_shared_programs();
+    test_prefilter();
+    printf("All regex cache tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/core/vm_regex.h"
+#include "../../src/core/regex_linear.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Both engines on one pattern and text: same answer, same overall match
+static void compare(const char* pattern, int cflags, const char* text) {
+    regex_t posix;
+    assert(regcomp(&posix, pattern, REG_EXTENDED | cflags) == 0);
+    regex_linear* linear = regex_linear_compile(pattern, (cflags & REG_ICASE) != 0, (cflags & REG_NEWLINE) != 0);
+    if (!linear) {
+        fprintf(stderr, "/%s/ not compiled\n", pattern);
+        abort();
+    }
+    regmatch_t expected, actual;
+    bool found = regexec(&posix, text, 1, &expected, 0) == 0;
+    bool searched = regex_linear_search(linear, text, strlen(text));
+    bool executed = regex_linear_exec(linear, text, strlen(text), 0, 1, &actual);
+    if (searched != found || executed != found ||
+        (found && (actual.rm_so != expected.rm_so || actual.rm_eo != expected.rm_eo))) {
+        fprintf(stderr, "/%s/ on \"%s\": regexec %d [%d,%d), search %d, exec %d [%d,%d)\n", pattern, text,
+                found, found ? (int)expected.rm_so : -1, found ? (int)expected.rm_eo : -1, searched, executed,
+                executed ? (int)actual.rm_so : -1, executed ? (int)actual.rm_eo : -1);
+        abort();
+    }
+    regex_linear_free(linear);
+    regfree(&posix);
+}
+
+void test_agrees_with_regexec(void) {
+    const char* patterns[] = {
+        "abc", "a|b|c", "ab*c", "ab+c", "ab?c", "a{2,3}", "a{2}b", "a{1,}", "(ab)+", "(a|ab)(c|bcd)",
+        "^abc", "abc$", "^$", "^", "$", "x*", "[a-c]+", "[^a-c]+", "[[:digit:]]+", "[[:alpha:]_][[:alnum:]_]*",
+        "[]a]", "[a-]+", "a.c", ".*", "(a*)*b", "(a|aa)*c", "(foo|foobar)baz", "\\.", "a\\+b",
+        "([0-9]{1,3}\\.){3}[0-9]{1,3}", "^(GET|POST) /[^ ]*", "ERROR|WARN", "(^|,)x(,|$)", "a|^b", "b$|c",
+        "()", "(a|)+b", "[[:space:]]+", "[[:upper:]][[:lower:]]+", NULL};
+    const char* texts[] = {
+        "", "abc", "xabcx", "ac", "abbbc", "aaa", "aab", "abab", "abcd", "abcbcd", "foobarbaz", "foobaz",
+        "a.c", "a+b", "10.0.0.255 ok", "GET /index.html HTTP/1.1", "POST /", "2024 ERROR disk", "x,y,x",
+        "y,x", "b", "cb", "aaaaaaaaaaaaaaaaaaaaaaaac", "aaaaaaaaaaaaaaaaaaaab", "  \t tab", "Hello World",
+        "]a-", "line\nabc\nend", NULL};
+    for (int p = 0; patterns[p]; p++) {
+        for (int t = 0; texts[t]; t++) {
+            compare(patterns[p], 0, texts[t]);
+            compare(patterns[p], REG_NEWLINE, texts[t]);
+        }
+    }
+    compare("hello", REG_ICASE, "Say HELLO");
+    compare("[^a]+", REG_ICASE, "AAxyA");
+    compare("[A-Z]+", REG_ICASE, "abc");
+    compare("^end", REG_NEWLINE, "start\nend");
+    compare("start$", REG_NEWLINE, "start\nend");
+    compare("t.e", REG_NEWLINE, "t\ne");
+    compare("t.e", 0, "t\ne");
+    compare("[^x]", REG_NEWLINE, "\n");
+    printf("Agrees with regexec test passed\n");
+}
+
+void test_groups(void) {
+    regex_linear* regex = regex_linear_compile("([a-z]+)@([a-z]+)\\.(com|org)( x)?", false, false);
+    assert(regex);
+    regmatch_t matches[6];
+    const char* text = "mail bob@example.org now";
+    assert(regex_linear_exec(regex, text, strlen(text), 0, 6, matches));
+    assert(matches[0].rm_so == 5 && matches[0].rm_eo == 20);
+    assert(matches[1].rm_so == 5 && matches[1].rm_eo == 8);
+    assert(matches[2].rm_so == 9 && matches[2].rm_eo == 16);
+    assert(matches[3].rm_so == 17 && matches[3].rm_eo == 20);
+    assert(matches[4].rm_so == -1 && matches[5].rm_so == -1);
+    // Fewer slots than groups
+    assert(regex_linear_exec(regex, text, strlen(text), 0, 2, matches));
+    assert(matches[1].rm_so == 5 && matches[1].rm_eo == 8);
+    regex_linear_free(regex);
+    printf("Groups test passed\n");
+}
+
+void test_unsupported(void) {
+    // Left to regcomp
+    assert(regex_linear_compile("\\bword\\b", false, false) == NULL);
+    assert(regex_linear_compile("\\<word", false, false) == NULL);
+    assert(regex_linear_compile("[[.a.]]", false, false) == NULL);
+    assert(regex_linear_compile("(a)\\1", false, false) == NULL);
+    assert(regex_linear_compile("caf[\xc3\xa9]", false, false) == NULL);
+    assert(regex_linear_compile("(unclosed", false, false) == NULL);
+    assert(regex_linear_compile("a{5000}{5000}", false, false) == NULL);
+    printf("Unsupported syntax test passed\n");
+}
+
+void test_linear_time(void) {
+    // Backtracking matchers take exponential time on these
+    size_t length = 200000;
+    char* text = malloc(length + 1);
+    memset(text, 'a', length);
+    text[length] = '\0';
+    const char* patterns[] = {"(a*)*b", "(a|aa)*b", "(a+)+$x", "(a|a)*b", NULL};
+    clock_t start = clock();
+    for (int i = 0; patterns[i]; i++) {
+        regex_linear* regex = regex_linear_compile(patterns[i], false, false);
+        assert(regex);
+        assert(!regex_linear_search(regex, text, length));
+        assert(!regex_linear_exec(regex, text, length, 0, 0, NULL));
+        regex_linear_free(regex);
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    assert(seconds < 10);
+
+    // The DFA for this has a state per 15-byte suffix, more than its cache
+    // holds; it is flushed along the way and the answers stay right
+    regex_linear* regex = regex_linear_compile("(a|b)*a(a|b){14}$", false, false);
+    assert(regex);
+    srand(7);
+    for (size_t i = 0; i < length; i++) text[i] = (rand() & 1) ? 'a' : 'b';
+    for (size_t end = length; end > length - 40; end--) {
+        char saved = text[end];
+        text[end] = '\0';
+        assert(regex_linear_search(regex, text, end) == (text[end - 15] == 'a'));
+        text[end] = saved;
+    }
+    regex_linear_free(regex);
+    free(text);
+    printf("Linear time test passed (%.2fs)\n", seconds);
+}
+
+void test_through_vm(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value regex = ember_make_regex(vm, "^([0-9]{4})-([0-9]{2})", REGEX_LINEAR);
+    assert(regex.type == EMBER_VAL_REGEX);
+    vm->stack[vm->stack_top++] = regex;
+    assert(ember_regex_test(vm, AS_REGEX(regex), "2024-06-01 up"));
+    assert(!ember_regex_test(vm, AS_REGEX(regex), "x2024-06-01"));
+    ember_value match = ember_regex_match_function(vm, AS_REGEX(regex), "2024-06-01");
+    assert(match.type == EMBER_VAL_HASH_MAP);
+    vm->stack[vm->stack_top++] = match;
+    ember_value split_on = ember_make_regex(vm, "[,;] *", REGEX_LINEAR);
+    vm->stack[vm->stack_top++] = split_on;
+    ember_value parts = ember_regex_split(vm, AS_REGEX(split_on), "a, b;c");
+    assert(AS_ARRAY(parts)->length == 3);
+    // Outside the linear syntax, still compiled
+    assert(ember_make_regex(vm, "\\bword", REGEX_LINEAR).type == EMBER_VAL_REGEX);
+    vm->stack_top -= 3;
+    regex_cache_free(vm);
+    ember_free_vm(vm);
+    printf("Through the VM test passed\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running linear regex tests...\n");
+    test_agrees_with_regexec();
+    test_groups();
+    test_unsupported();
+    test_linear_time();
+    test_through_vm();
+    printf("All linear regex tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/core/vm_regex.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Replaces with a fresh regex and checks the result
+static void check_replace(ember_vm* vm, const char* pattern, ember_regex_flags flags, const char* text,
+                          const char* replacement, const char* expected) {
+    ember_value regex = ember_make_regex(vm, pattern, flags);
+    assert(regex.type == EMBER_VAL_REGEX);
+    vm->stack[vm->stack_top++] = regex;
+    ember_value result = ember_regex_replace(vm, AS_REGEX(regex), text, replacement);
+    if (result.type != EMBER_VAL_STRING || strcmp(AS_CSTRING(result), expected) != 0) {
+        fprintf(stderr, "/%s/ on \"%s\" with \"%s\": \"%s\", expected \"%s\"\n", pattern, text, replacement,
+                result.type == EMBER_VAL_STRING ? AS_CSTRING(result) : "(not a string)", expected);
+        abort();
+    }
+    vm->stack_top--;
+}
+
+void test_replace(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    // First match only, then every match
+    check_replace(vm, "o", REGEX_NONE, "foo boo", "0", "f0o boo");
+    check_replace(vm, "o", REGEX_GLOBAL, "foo boo", "0", "f00 b00");
+    check_replace(vm, "x", REGEX_GLOBAL, "foo", "y", "foo");
+    check_replace(vm, "^", REGEX_GLOBAL, "abc", "> ", "> abc");
+    check_replace(vm, "^", REGEX_GLOBAL | REGEX_MULTILINE, "a\nb\n", "> ", "> a\n> b\n> ");
+
+    // Group references, the whole match, and a literal dollar
+    check_replace(vm, "([a-z]+)@([a-z]+)", REGEX_GLOBAL, "bob@host, amy@site", "$2:$1",
+                  "host:bob, site:amy");
+    check_replace(vm, "[0-9]+", REGEX_GLOBAL, "1 and 22", "<$&|$0>", "<1|1> and <22|22>");
+    check_replace(vm, "[0-9]+", REGEX_NONE, "cost 5", "$$$&", "cost $5");
+    check_replace(vm, "(a)|(b)", REGEX_GLOBAL, "ab", "[$1$2$9]", "[a][b]");
+    check_replace(vm, "a", REGEX_NONE, "a", "$x$", "$x$");
+
+    // Empty matches step over one byte and still see the end
+    check_replace(vm, "x*", REGEX_GLOBAL, "abc", "-", "-a-b-c-");
+    check_replace(vm, "a*", REGEX_GLOBAL, "baaac", "-", "-b--c-");
+
+    // Many matches in a long text, in one pass
+    ember_string_builder text = {0}, expected = {0};
+    for (int i = 0; i < 20000; i++) {
+        assert(string_builder_appendf(&text, "user%d@mail.com;", i));
+        assert(string_builder_appendf(&expected, "user%d@***;", i));
+    }
+    check_replace(vm, "@[a-z.]+", REGEX_GLOBAL, text.chars, "@***", expected.chars);
+    string_builder_reset(&text);
+    string_builder_reset(&expected);
+
+    regex_cache_free(vm);
+    ember_free_vm(vm);
+    printf("Replace test passed\n");
+}
+
+void test_match_all(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value args[2];
+    args[0] = ember_make_regex(vm, "([a-z]+)=([0-9]*)", REGEX_NONE);
+    vm->stack[vm->stack_top++] = args[0];
+    args[1] = ember_make_string_gc(vm, "a=1, bb=22, c=, =3, dd=4");
+    vm->stack[vm->stack_top++] = args[1];
+    ember_value iterator = ember_native_regex_match_all(vm, 2, args);
+    assert(iterator.type == EMBER_VAL_ITERATOR);
+    vm->stack[vm->stack_top++] = iterator;
+
+    // Each step finds the next match and leaves the iterator rooting the rest
+    const char* names[] = {"a", "bb", "c", "dd"};
+    const char* values[] = {"1", "22", "", "4"};
+    const int indexes[] = {0, 5, 12, 20};
+    ember_value match_key = ember_make_string_gc(vm, "match");
+    vm->stack[vm->stack_top++] = match_key;
+    ember_value index_key = ember_make_string_gc(vm, "index");
+    vm->stack[vm->stack_top++] = index_key;
+    ember_value groups_key = ember_make_string_gc(vm, "groups");
+    vm->stack[vm->stack_top++] = groups_key;
+    for (int i = 0; i < 4; i++) {
+        assert(!iterator_done(AS_ITERATOR(iterator)));
+        ember_gc_collect(vm);
+        ember_iterator_result step = iterator_next(AS_ITERATOR(iterator));
+        assert(!step.done && step.value.type == EMBER_VAL_HASH_MAP);
+        ember_hash_map* record = AS_HASH_MAP(step.value);
+        assert(hash_map_get(record, index_key).as.number_val == indexes[i]);
+        ember_array* groups = AS_ARRAY(hash_map_get(record, groups_key));
+        assert(groups->length == 2);
+        assert(strcmp(AS_CSTRING(groups->elements[0]), names[i]) == 0);
+        assert(strcmp(AS_CSTRING(groups->elements[1]), values[i]) == 0);
+        assert(strncmp(AS_CSTRING(hash_map_get(record, match_key)), names[i], strlen(names[i])) == 0);
+    }
+    assert(iterator_done(AS_ITERATOR(iterator)));
+    assert(iterator_next(AS_ITERATOR(iterator)).done);
+    assert(iterator_next(AS_ITERATOR(iterator)).done);
+
+    // Empty matches end at the end of the text
+    args[0] = ember_make_regex(vm, "b*", REGEX_NONE);
+    vm->stack[vm->stack_top++] = args[0];
+    args[1] = ember_make_string_gc(vm, "abb");
+    vm->stack[vm->stack_top++] = args[1];
+    iterator = ember_native_regex_match_all(vm, 2, args);
+    vm->stack[vm->stack_top++] = iterator;
+    int count = 0;
+    while (!iterator_next(AS_ITERATOR(iterator)).done) count++;
+    assert(count == 3);      // "" at 0, "bb" at 1, "" at 3
+
+    // Wrong arguments
+    assert(ember_native_regex_match_all(vm, 2, (ember_value[]){args[1], args[0]}).type == EMBER_VAL_NIL);
+    assert(ember_native_regex_match_all(vm, 1, args).type == EMBER_VAL_NIL);
+
+    vm->stack_top = 0;
+    regex_cache_free(vm);
+    ember_free_vm(vm);
+    printf("Match all test passed\n");
+}
+
+void test_split(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value regex = ember_make_regex(vm, ", *|;", REGEX_NONE);
+    vm->stack[vm->stack_top++] = regex;
+    ember_value parts = ember_regex_split(vm, AS_REGEX(regex), "a, b,c;;d");
+    ember_array* array = AS_ARRAY(parts);
+    assert(array->length == 4);
+    assert(strcmp(AS_CSTRING(array->elements[0]), "a") == 0);
+    assert(strcmp(AS_CSTRING(array->elements[3]), "d") == 0);
+
+    // An empty separator splits between bytes without dropping any
+    ember_value empty = ember_make_regex(vm, "x*", REGEX_NONE);
+    vm->stack[vm->stack_top++] = empty;
+    parts = ember_regex_split(vm, AS_REGEX(empty), "abc");
+    array = AS_ARRAY(parts);
+    assert(array->length == 3 && strcmp(AS_CSTRING(array->elements[1]), "b") == 0);
+
+    vm->stack_top -= 2;
+    regex_cache_free(vm);
+    ember_free_vm(vm);
+    printf("Split test passed\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running regex replace tests...\n");
+    test_replace();
+    test_match_all();
+    test_split();
+    printf("All regex replace tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// [[needle, replacement], ...] from a NULL-terminated list of strings
+static ember_value pairs(ember_vm* vm, const char** strings) {
+    ember_value table = keep(vm, ember_make_array(vm, 4));
+    for (int i = 0; strings[i]; i += 2) {
+        ember_value pair = keep(vm, ember_make_array(vm, 2));
+        array_push_with_vm(vm, AS_ARRAY(pair), text(vm, strings[i]));
+        array_push_with_vm(vm, AS_ARRAY(pair), text(vm, strings[i + 1]));
+        array_push_with_vm(vm, AS_ARRAY(table), pair);
+    }
+    return table;
+}
+
+static void assert_replaced(ember_vm* vm, const char* input, ember_value table, const char* expected) {
+    ember_value args[2] = {text(vm, input), table};
+    ember_value result = ember_replace_all(vm, 2, args);
+    assert(result.type == EMBER_VAL_STRING);
+    if (strcmp(AS_CSTRING(result), expected) != 0) {
+        fprintf(stderr, "got \"%s\", expected \"%s\"\n", AS_CSTRING(result), expected);
+        assert(0);
+    }
+}
+
+// Earliest start, then longest, never matching inside a replacement: the
+// rule the automaton must agree with, applied one position at a time
+static char* reference(const char* input, const char** strings) {
+    char* out = malloc(strlen(input) * 8 + 1);
+    size_t at = 0;
+    for (const char* p = input; *p;) {
+        int best = -1;
+        for (int i = 0; strings[i]; i += 2) {
+            size_t length = strlen(strings[i]);
+            if (strncmp(p, strings[i], length) == 0 && (best < 0 || length > strlen(strings[best]))) best = i;
+        }
+        if (best < 0) {
+            out[at++] = *p++;
+        } else {
+            strcpy(out + at, strings[best + 1]);
+            at += strlen(strings[best + 1]);
+            p += strlen(strings[best]);
+        }
+    }
+    out[at] = '\0';
+    return out;
+}
+
+void test_single_needle(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value args[3] = {text(vm, "a-b--c-"), text(vm, "-"), text(vm, "+-")};
+    assert(strcmp(AS_CSTRING(ember_replace_all(vm, 3, args)), "a+-b+-+-c+-") == 0);
+    args[1] = text(vm, "--");
+    args[2] = text(vm, "");
+    assert(strcmp(AS_CSTRING(ember_replace_all(vm, 3, args)), "a-bc-") == 0);
+    args[0] = text(vm, "aaaa");
+    args[1] = text(vm, "aa");
+    args[2] = text(vm, "b");
+    assert(strcmp(AS_CSTRING(ember_replace_all(vm, 3, args)), "bb") == 0);
+    args[1] = text(vm, "missing");
+    assert(strcmp(AS_CSTRING(ember_replace_all(vm, 3, args)), "aaaa") == 0);
+
+    // Bad arguments
+    args[1] = text(vm, "");
+    assert(ember_replace_all(vm, 3, args).type == EMBER_VAL_NIL);
+    args[1] = ember_make_number(1);
+    assert(ember_replace_all(vm, 3, args).type == EMBER_VAL_NIL);
+    assert(ember_replace_all(vm, 2, args).type == EMBER_VAL_NIL);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("  ✓ One needle\n");
+}
+
+void test_tables(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+
+    // Overlapping needles: the earliest start wins, then the longest
+    const char* overlapping[] = {"he", "1", "she", "2", "his", "3", "hers", "4", "s", "5", NULL};
+    ember_value table = pairs(vm, overlapping);
+    assert_replaced(vm, "ushers", table, "u2r5");
+    assert_replaced(vm, "hishershe", table, "341");
+    assert_replaced(vm, "", table, "");
+    const char* nested[] = {"bc", "X", "abcd", "Y", "b", "Z", NULL};
+    assert_replaced(vm, "abcabcdbc", pairs(vm, nested), "aXYX");
+
+    // Replacements are not matched again
+    const char* swap[] = {"a", "b", "b", "a", NULL};
+    assert_replaced(vm, "abba", pairs(vm, swap), "baab");
+
+    // A map works as the table, and sanitizing a document matches the
+    // one-position-at-a-time reference
+    ember_value map = keep(vm, ember_make_map(vm));
+    map_set(AS_MAP(map), text(vm, "<"), text(vm, "&lt;"));
+    map_set(AS_MAP(map), text(vm, "<script>"), text(vm, ""));
+    map_set(AS_MAP(map), text(vm, "&"), text(vm, "&amp;"));
+    assert_replaced(vm, "a<b & <script>x", map, "a&lt;b &amp; x");
+
+    const char* tokens[] = {"ab", "1", "abc", "22", "bca", "333", "c", "4", "aab", "5", "cc", "", "b", "66", NULL};
+    char input[512];
+    srand(5);
+    for (int round = 0; round < 200; round++) {
+        int length = rand() % (int)(sizeof(input) - 1);
+        for (int i = 0; i < length; i++) input[i] = "abcx"[rand() % 4];
+        input[length] = '\0';
+        char* expected = reference(input, tokens);
+        assert_replaced(vm, input, pairs(vm, tokens), expected);
+        free(expected);
+        vm->stack_top = 0;
+    }
+
+    // Bad tables
+    ember_value bad[2] = {text(vm, "x"), ember_make_number(1)};
+    assert(ember_replace_all(vm, 2, bad).type == EMBER_VAL_NIL);
+    const char* empty_needle[] = {"", "y", NULL};
+    bad[1] = pairs(vm, empty_needle);
+    assert(ember_replace_all(vm, 2, bad).type == EMBER_VAL_NIL);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("  ✓ Tables of needles in one pass\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running replace_all tests...\n");
+    test_single_needle();
+    test_tables();
+    printf("All replace_all tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/core/vm_dispatch.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static ember_chunk* new_chunk(void) {
+    ember_chunk* chunk = malloc(sizeof(ember_chunk));
+    assert(chunk);
+    init_chunk(chunk);
+    write_chunk(chunk, OP_POP);
+    return chunk;
+}
+
+static void free_test_chunk(ember_chunk* chunk) {
+    free_chunk(chunk);
+    free(chunk);
+}
+
+static void read_samples(ember_vm* vm, char* text, size_t size) {
+    const char* path = "/tmp/ember_test_samples.txt";
+    assert(ember_vm_write_samples(vm, path) == EMBER_SUCCESS);
+    FILE* file = fopen(path, "r");
+    assert(file);
+    size_t length = fread(text, 1, size - 1, file);
+    text[length] = '\0';
+    fclose(file);
+    remove(path);
+}
+
+void test_collapsed_stacks(void) {
+    ember_vm* vm = ember_new_vm();
+    ember_frame frames[2];
+    vm->frames = frames;
+    vm->frame_capacity = 2;
+    ember_chunk* main = new_chunk();
+    ember_chunk* serve = new_chunk();
+    ember_chunk* handle = new_chunk();
+
+    assert(ember_vm_start_sampling(vm, 1) == EMBER_SUCCESS);
+    // <script> calls serve, which calls handle
+    frames[0].chunk = main;
+    frames[1].chunk = serve;
+    vm_sampler_call(vm, serve, "serve");
+    vm_sampler_call(vm, handle, "handle");
+    vm->frame_count = 2;
+    vm->chunk = handle;
+    vm->sample_pending = 3;
+    vm_dispatch_profile(vm, handle->code);
+    assert(vm->sample_pending == 0);
+
+    vm->frame_count = 1;
+    vm->chunk = serve;
+    vm->sample_pending = 1;
+    vm_dispatch_profile(vm, serve->code);
+    vm->sample_pending = 1;
+    vm_dispatch_profile(vm, serve->code);
+    assert(ember_vm_stop_sampling(vm) == EMBER_SUCCESS);
+    assert(ember_vm_sample_count(vm) == 5);
+
+    char text[1024];
+    read_samples(vm, text, sizeof(text));
+    assert(strstr(text, "<script>;serve;handle 3\n"));
+    assert(strstr(text, "<script>;serve 2\n"));
+
+    vm_sampler_free(vm);
+    assert(vm->sampler == NULL && ember_vm_sample_count(vm) == 0);
+    vm->frames = NULL;
+    vm->frame_capacity = 0;
+    vm->frame_count = 0;
+    vm->chunk = NULL;
+    free_test_chunk(handle);
+    free_test_chunk(serve);
+    free_test_chunk(main);
+    ember_free_vm(vm);
+    printf("  ✓ Samples fold into collapsed stacks\n");
+}
+
+void test_timer_samples(void) {
+    ember_vm* vm = ember_new_vm();
+    ember_vm* other = ember_new_vm();
+    ember_chunk* main = new_chunk();
+    vm->chunk = main;
+
+    assert(ember_vm_start_sampling(vm, -1) == EMBER_ERROR_INVALID_PARAMETER);
+    assert(ember_vm_start_sampling(vm, 1000) == EMBER_SUCCESS);
+    // The timer is the process's; a second VM cannot sample at the same time
+    assert(ember_vm_start_sampling(other, 0) == EMBER_ERROR_OPERATION_FAILED);
+
+    // Burn CPU time in the "dispatch loop" until ticks have been sampled
+    clock_t start = clock();
+    while (ember_vm_sample_count(vm) < 5 && clock() - start < 5 * CLOCKS_PER_SEC) {
+        vm_dispatch_profile(vm, main->code);
+    }
+    assert(ember_vm_sample_count(vm) >= 5);
+    assert(ember_vm_stop_sampling(vm) == EMBER_SUCCESS);
+
+    // Stopped: ticks no longer arrive, the stacks stay
+    uint64_t samples = ember_vm_sample_count(vm);
+    start = clock();
+    while (clock() - start < CLOCKS_PER_SEC / 20) {
+        vm_dispatch_profile(vm, main->code);
+    }
+    assert(ember_vm_sample_count(vm) == samples && vm->sample_pending == 0);
+
+    assert(ember_vm_start_sampling(other, 0) == EMBER_SUCCESS);
+    vm_sampler_free(other);
+    vm_sampler_free(vm);
+    vm->chunk = NULL;
+    free_test_chunk(main);
+    ember_free_vm(other);
+    ember_free_vm(vm);
+    printf("  ✓ SIGPROF ticks are sampled while the VM runs\n");
+}
+
+void test_script_samples(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(ember_vm_start_sampling(vm, 1000) == EMBER_SUCCESS);
+    assert(ember_eval(vm,
+        "fn spin(n) {\n"
+        "    total = 0\n"
+        "    i = 0\n"
+        "    while (i < n) {\n"
+        "        total = total + i\n"
+        "        i = i + 1\n"
+        "    }\n"
+        "    return total\n"
+        "}\n"
+        "spin(3000000)\n") == 0);
+    assert(ember_vm_stop_sampling(vm) == EMBER_SUCCESS);
+    assert(ember_vm_sample_count(vm) > 0);
+    char text[4096];
+    read_samples(vm, text, sizeof(text));
+    assert(strstr(text, "<script>;spin "));
+    ember_free_vm(vm);
+    printf("  ✓ Script stacks carry function names\n");
+}
+
+int main(void) {
+    printf("Testing sampling profiler...\n");
+    test_collapsed_stacks();
+    test_timer_samples();
+    test_script_samples();
+    printf("✓ Sampler tests passed\n");
+    return 0;
+}
@@ -0,0 +1,165 @@
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/stdlib_working.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+void test_secure_random(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value args[2] = {ember_make_number(16), ember_make_nil()};
+    ember_value hex = ember_native_secure_random_working(vm, 1, args);
+    assert(hex.type == EMBER_VAL_STRING && AS_STRING(hex)->length == 32);
+    for (int i = 0; i < 32; i++) {
+        assert(isxdigit((unsigned char)AS_CSTRING(hex)[i]) && !isupper((unsigned char)AS_CSTRING(hex)[i]));
+    }
+    vm->stack[vm->stack_top++] = hex;
+
+    // Binary output, and more than the old 1 KB cap and the pool
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, "bytes");
+    args[0] = ember_make_number(100000);
+    args[1] = vm->stack[vm->stack_top - 1];
+    ember_value raw = ember_native_secure_random_working(vm, 2, args);
+    assert(raw.type == EMBER_VAL_STRING && AS_STRING(raw)->length == 100000);
+    int counts[256] = {0};
+    const unsigned char* bytes = (const unsigned char*)AS_CSTRING(raw);
+    for (int i = 0; i < 100000; i++) counts[bytes[i]]++;
+    for (int i = 0; i < 256; i++) assert(counts[i] > 250 && counts[i] < 550);
+
+    // Pool-sized draws do not repeat
+    unsigned char a[48], b[48];
+    bool drawn = ember_secure_random_bytes(a, sizeof(a));
+    drawn = drawn && ember_secure_random_bytes(b, sizeof(b));
+    assert(drawn);
+    assert(memcmp(a, b, sizeof(a)) != 0);
+    for (int i = 0; i < 1000; i++) {
+        drawn = ember_secure_random_bytes(a, 13);
+        assert(drawn);
+    }
+    (void)drawn;
+
+    // Bad lengths and encodings
+    args[0] = ember_make_number(0);
+    assert(ember_native_secure_random_working(vm, 1, args).type == EMBER_VAL_NIL);
+    args[0] = ember_make_number(1e9);
+    assert(ember_native_secure_random_working(vm, 1, args).type == EMBER_VAL_NIL);
+    args[0] = ember_make_number(4);
+    args[1] = ember_make_number(1);
+    assert(ember_native_secure_random_working(vm, 2, args).type == EMBER_VAL_NIL);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("Secure random test passed\n");
+}
+
+static int compare_strings(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+void test_uuids(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    enum { COUNT = 20000 };
+    char** v4 = malloc(sizeof(char*) * COUNT);
+    char** v7 = malloc(sizeof(char*) * COUNT);
+    for (int i = 0; i < COUNT; i++) {
+        v4[i] = strdup(AS_CSTRING(ember_native_uuid_v4(vm, 0, NULL)));
+        v7[i] = strdup(AS_CSTRING(ember_native_uuid_v7(vm, 0, NULL)));
+        assert(strlen(v4[i]) == 36 && v4[i][8] == '-' && v4[i][13] == '-' && v4[i][23] == '-');
+        assert(v4[i][14] == '4' && strchr("89ab", v4[i][19]));
+        assert(v7[i][14] == '7' && strchr("89ab", v7[i][19]));
+        // Time-ordered within a thread, even inside one millisecond
+        if (i > 0) assert(strcmp(v7[i - 1], v7[i]) < 0);
+    }
+
+    // The leading 48 bits are the current Unix time in milliseconds
+    char stamp[13];
+    memcpy(stamp, v7[COUNT - 1], 8);
+    memcpy(stamp + 8, v7[COUNT - 1] + 9, 4);
+    stamp[12] = '\0';
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    long long ms = (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    long long drift = ms - strtoll(stamp, NULL, 16);
+    assert(drift > -100 && drift < 5000);
+
+    qsort(v4, COUNT, sizeof(char*), compare_strings);
+    for (int i = 1; i < COUNT; i++) assert(strcmp(v4[i - 1], v4[i]) != 0);
+    for (int i = 0; i < COUNT; i++) {
+        free(v4[i]);
+        free(v7[i]);
+    }
+    free(v4);
+    free(v7);
+    assert(ember_native_uuid_v4(vm, 1, (ember_value[]){ember_make_nil()}).type == EMBER_VAL_NIL);
+    ember_free_vm(vm);
+    printf("UUID test passed\n");
+}
+
+static void* draw_bytes(void* out) {
+    bool drawn = ember_secure_random_bytes(out, 32);
+    assert(drawn);
+    (void)drawn;
+    return NULL;
+}
+
+void test_threads_and_fork(void) {
+    // Each thread has its own pool
+    unsigned char first[32], second[32];
+    pthread_t threads[2];
+    pthread_create(&threads[0], NULL, draw_bytes, first);
+    pthread_create(&threads[1], NULL, draw_bytes, second);
+    pthread_join(threads[0], NULL);
+    pthread_join(threads[1], NULL);
+    assert(memcmp(first, second, 32) != 0);
+
+    // A forked child must not replay the bytes left in its parent's pool
+    unsigned char warm[8];
+    bool drawn = ember_secure_random_bytes(warm, sizeof(warm));
+    assert(drawn);
+    int pipe_fds[2];
+    int rc = pipe(pipe_fds);
+    assert(rc == 0);
+    (void)rc;
+    pid_t child = fork();
+    assert(child >= 0);
+    if (child == 0) {
+        unsigned char drawn[32];
+        ember_secure_random_bytes(drawn, sizeof(drawn));
+        ssize_t written = write(pipe_fds[1], drawn, sizeof(drawn));
+        _exit(written == (ssize_t)sizeof(drawn) ? 0 : 1);
+    }
+    unsigned char parent[32], from_child[32];
+    drawn = ember_secure_random_bytes(parent, sizeof(parent));
+    assert(drawn);
+    (void)drawn;
+    ssize_t got = read(pipe_fds[0], from_child, sizeof(from_child));
+    assert(got == (ssize_t)sizeof(from_child));
+    (void)got;
+    int status;
+    waitpid(child, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    assert(memcmp(parent, from_child, sizeof(parent)) != 0);
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    printf("Threads and fork test passed\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running secure random tests...\n");
+    test_secure_random();
+    test_uuids();
+    test_threads_and_fork();
+    printf("All secure random tests passed!\n");
+    return 0;
+}
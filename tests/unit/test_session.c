@@ -0,0 +1,113 @@
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+
+static ember_value set(ember_vm* vm, const char* id, ember_value value, double ttl) {
+    ember_value args[3] = {text(vm, id), value, ember_make_number(ttl)};
+    return ember_native_session_set(vm, ttl != 0 ? 3 : 2, args);
+}
+
+static ember_value get(ember_vm* vm, const char* id) {
+    ember_value arg = text(vm, id);
+    return ember_native_session_get(vm, 1, &arg);
+}
+
+static double count(ember_vm* vm) {
+    return ember_native_session_count(vm, 0, NULL).as.number_val;
+}
+
+void test_store(void) {
+    ember_session_clear();
+    ember_vm* writer = ember_new_vm();
+    ember_vm* reader = ember_new_vm();
+    assert(writer != NULL && reader != NULL);
+
+    ember_value session = keep(writer, ember_make_hash_map(writer, 4));
+    hash_map_set(AS_HASH_MAP(session), text(writer, "user"), text(writer, "ann"));
+    hash_map_set(AS_HASH_MAP(session), text(writer, "uid"), ember_make_number(42));
+    ember_value result = set(writer, "abc123", session, 0);
+    assert(result.type == EMBER_VAL_BOOL && result.as.bool_val);
+
+    // Another VM reads its own copy of the value
+    ember_value seen = keep(reader, get(reader, "abc123"));
+    assert(seen.type == EMBER_VAL_HASH_MAP && seen.as.obj_val != session.as.obj_val);
+    ember_value user = hash_map_get(AS_HASH_MAP(seen), text(reader, "user"));
+    assert(strcmp(AS_CSTRING(user), "ann") == 0);
+    assert(hash_map_get(AS_HASH_MAP(seen), text(reader, "uid")).as.number_val == 42);
+
+    // Replacing, deleting, and unknown IDs
+    assert(set(writer, "abc123", ember_make_number(7), 60).as.bool_val);
+    assert(get(reader, "abc123").as.number_val == 7);
+    assert(count(reader) == 1);
+    ember_value id = text(reader, "abc123");
+    assert(ember_native_session_delete(reader, 1, &id).as.bool_val);
+    assert(ember_native_session_delete(reader, 1, &id).as.bool_val == false);
+    assert(get(reader, "abc123").type == EMBER_VAL_NIL);
+    assert(get(reader, "nobody").type == EMBER_VAL_NIL);
+
+    // Bad arguments
+    assert(set(writer, "", ember_make_number(1), 0).type == EMBER_VAL_NIL);
+    assert(set(writer, "x", ember_make_number(1), -5).type == EMBER_VAL_NIL);
+    ember_value args[2] = {ember_make_number(1), ember_make_number(1)};
+    assert(ember_native_session_set(writer, 2, args).type == EMBER_VAL_NIL);
+    assert(ember_native_session_get(writer, 0, NULL).type == EMBER_VAL_NIL);
+    assert(ember_session_configure(0) == EMBER_ERROR_INVALID_PARAMETER);
+
+    // Many sessions spread over the shards
+    char name[32];
+    for (int i = 0; i < 5000; i++) {
+        snprintf(name, sizeof(name), "session-%d", i);
+        assert(set(writer, name, ember_make_number(i), 0).as.bool_val);
+        writer->stack_top = 0;
+    }
+    assert(count(writer) == 5000);
+    assert(get(reader, "session-4321").as.number_val == 4321);
+    ember_session_clear();
+    assert(count(writer) == 0);
+
+    ember_free_vm(writer);
+    ember_free_vm(reader);
+    printf("  ✓ Sessions are stored serialized and read back by any VM\n");
+}
+
+void test_expiry(void) {
+    ember_session_clear();
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+
+    assert(set(vm, "short", ember_make_number(1), 0.05).as.bool_val);
+    assert(set(vm, "touched", ember_make_number(2), 0.05).as.bool_val);
+    assert(set(vm, "long", ember_make_number(3), 3600).as.bool_val);
+    ember_value args[2] = {text(vm, "touched"), ember_make_number(60)};
+    assert(ember_native_session_touch(vm, 2, args).as.bool_val);
+
+    // Past the deadline a session is gone, even before the wheel frees it
+    usleep(100 * 1000);
+    assert(get(vm, "short").type == EMBER_VAL_NIL);
+    args[0] = text(vm, "short");
+    assert(ember_native_session_touch(vm, 1, args).as.bool_val == false);
+    assert(get(vm, "touched").as.number_val == 2);
+    assert(get(vm, "long").as.number_val == 3);
+
+    // Once the wheel turns past its second, it is freed
+    usleep(1100 * 1000);
+    assert(count(vm) == 2);
+
+    ember_session_clear();
+    ember_free_vm(vm);
+    printf("  ✓ Sessions expire at their deadline and touch extends it\n");
+}
+
+int main(void) {
+    printf("Running session tests...\n");
+    test_store();
+    test_expiry();
+    printf("All session tests passed!\n");
+    return 0;
+}
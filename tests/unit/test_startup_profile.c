@@ -0,0 +1,108 @@
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../../src/vm.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+
+static void write_module(const char* dir, const char* name, const char* source) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s.ember", dir, name);
+    FILE* file = fopen(path, "w");
+    assert(file != NULL);
+    fputs(source, file);
+    fclose(file);
+}
+
+static void remove_module(const char* dir, const char* name) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s.ember", dir, name);
+    unlink(path);
+}
+
+static const ember_startup_module* find_module(const ember_startup_profile* profile, const char* name) {
+    for (int i = 0; i < profile->module_count && i < EMBER_STARTUP_MODULES; i++) {
+        if (strcmp(profile->modules[i].name, name) == 0) return &profile->modules[i];
+    }
+    return NULL;
+}
+
+void test_vm_phases(void) {
+    ember_startup_profile_begin();
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+
+    ember_startup_profile profile;
+    ember_get_startup_profile(&profile);
+    assert(profile.gc_init_time > 0);
+    assert(profile.vfs_init_time > 0);
+    assert(profile.stdlib_init_time > 0);
+    // VM creation spans its phases; the total runs on until startup ends
+    assert(profile.vm_creation_time >= profile.gc_init_time + profile.stdlib_init_time);
+    assert(profile.total_startup_time >= profile.vm_creation_time);
+    assert(profile.module_count == 0);
+
+    // Later VMs add to the phases but not to vm_creation_time
+    ember_vm* second = ember_new_vm();
+    assert(second != NULL);
+    ember_startup_profile after;
+    ember_get_startup_profile(&after);
+    assert(after.vm_creation_time == profile.vm_creation_time);
+    assert(after.gc_init_time > profile.gc_init_time);
+
+    ember_startup_profile_end();
+    ember_get_startup_profile(&profile);
+    ember_get_startup_profile(&after);
+    assert(after.total_startup_time == profile.total_startup_time);
+
+    ember_free_vm(second);
+    ember_free_vm(vm);
+    printf("VM startup phases test passed\n");
+}
+
+void test_module_phases(void) {
+    char dir[] = "/tmp/ember_test_startup_XXXXXX";
+    assert(mkdtemp(dir) != NULL);
+    write_module(dir, "sp_base", "base_value = 40\n");
+    write_module(dir, "sp_top", "import sp_base\ntop_value = base_value + 2\n");
+
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_add_module_path(vm, dir);
+    ember_startup_profile_begin();
+    assert(ember_import_module(vm, "sp_top") == 0);
+    // Loaded already: not timed again
+    assert(ember_import_module(vm, "sp_base") == 0);
+
+    ember_startup_profile profile;
+    ember_get_startup_profile(&profile);
+    assert(profile.module_count == 2);
+    const ember_startup_module* top = find_module(&profile, "sp_top");
+    const ember_startup_module* base = find_module(&profile, "sp_base");
+    assert(top != NULL && base != NULL);
+    assert(top->resolve_time > 0 && top->compile_time > 0 && top->execute_time > 0);
+    assert(base->resolve_time > 0 && base->compile_time > 0 && base->execute_time > 0);
+    assert(profile.module_resolve_time >= top->resolve_time + base->resolve_time);
+    assert(profile.module_execute_time >= top->execute_time + base->execute_time);
+
+    ember_print_startup_profile();
+    ember_free_vm(vm);
+    remove_module(dir, "sp_base");
+    remove_module(dir, "sp_top");
+    rmdir(dir);
+    printf("Module startup phases test passed\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running startup profile tests...\n");
+    test_vm_phases();
+    test_module_phases();
+    printf("All startup profile tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include "ember.h"
+#include "ember_interfaces.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+static int crypto_inits;
+static int json_inits;
+static int database_inits;
+
+static ember_value answer(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    (void)argc;
+    (void)argv;
+    return ember_make_number(42);
+}
+
+static int init_crypto(ember_vm* vm) {
+    crypto_inits++;
+    ember_register_func(vm, "crypto_answer", answer);
+    return 0;
+}
+
+static int init_json(ember_vm* vm) {
+    json_inits++;
+    ember_register_func(vm, "json_answer", answer);
+    return 0;
+}
+
+static int init_database(ember_vm* vm) {
+    (void)vm;
+    database_inits++;
+    return -1;
+}
+
+static int init_all(ember_vm* vm, const ember_core_interface_t* core) {
+    (void)core;
+    return init_crypto(vm) | init_json(vm) | init_database(vm);
+}
+
+static void cleanup_all(ember_vm* vm) {
+    (void)vm;
+}
+
+static const char* const crypto_globals[] = {"crypto_answer", NULL};
+static const char* const json_globals[] = {"json_answer", NULL};
+
+static const char* const* module_globals(ember_stdlib_module_t module) {
+    switch (module) {
+        case EMBER_STDLIB_CRYPTO: return crypto_globals;
+        case EMBER_STDLIB_JSON:   return json_globals;
+        default:                  return NULL;
+    }
+}
+
+static ember_stdlib_interface_t stdlib = {
+    .version = "test",
+    .init_crypto = init_crypto,
+    .init_json = init_json,
+    .init_database = init_database,
+    .init_all = init_all,
+    .cleanup_all = cleanup_all,
+    .module_globals = module_globals,
+};
+
+void test_require(void) {
+    crypto_inits = json_inits = database_inits = 0;
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    assert(ember_stdlib_init_lazy(vm) == 0);
+    assert(vm->stdlib_pending == (1u << EMBER_STDLIB_CRYPTO | 1u << EMBER_STDLIB_JSON | 1u << EMBER_STDLIB_DATABASE));
+    assert(crypto_inits == 0 && json_inits == 0 && database_inits == 0);
+
+    // Each init runs once, on the first require
+    assert(ember_stdlib_require(vm, "crypto") == 0);
+    assert(ember_stdlib_require(vm, "crypto") == -1);
+    assert(crypto_inits == 1 && json_inits == 0);
+    assert(ember_global_find(vm, "crypto_answer", 13) >= 0);
+    // Not a stdlib module, or one without an init
+    assert(ember_stdlib_require(vm, "vmath") == -1);
+    assert(ember_stdlib_require(vm, "http") == -1);
+    // A failing init is not retried
+    assert(ember_stdlib_require(vm, "database") == -1);
+    assert(ember_stdlib_require(vm, "database") == -1 && database_inits == 1);
+
+    ember_free_vm(vm);
+    printf("  ✓ Modules initialize once, when required\n");
+}
+
+void test_global_lookup(void) {
+    crypto_inits = json_inits = database_inits = 0;
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    assert(ember_stdlib_init_lazy(vm) == 0);
+
+    // Unknown names and prefixes initialize nothing
+    assert(ember_stdlib_resolve_global(vm, "nope", 4) == 0);
+    assert(ember_stdlib_resolve_global(vm, "json_answer", 4) == 0);
+    assert(json_inits == 0);
+
+    // The first use of a module's global runs only that module's init
+    assert(ember_eval(vm, "x = json_answer()") == 0);
+    assert(json_inits == 1 && crypto_inits == 0 && database_inits == 0);
+    int slot = ember_global_find(vm, "x", 1);
+    assert(slot >= 0 && vm->globals[slot].value.as.number_val == 42);
+    assert(ember_eval(vm, "y = json_answer()") == 0);
+    assert(json_inits == 1);
+
+    // Without module_globals, a miss initializes everything still pending
+    stdlib.module_globals = NULL;
+    assert(ember_eval(vm, "z = crypto_answer()") == 0);
+    assert(crypto_inits == 1 && database_inits == 1 && vm->stdlib_pending == 0);
+    stdlib.module_globals = module_globals;
+
+    ember_free_vm(vm);
+    printf("  ✓ A global lookup that misses initializes the module defining it\n");
+}
+
+int main(void) {
+    printf("Running lazy stdlib tests...\n");
+    ember_register_stdlib_interface(&stdlib);
+    test_require();
+    test_global_lookup();
+    printf("All lazy stdlib tests passed!\n");
+    return 0;
+}
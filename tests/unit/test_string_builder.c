@@ -0,0 +1,229 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static ember_value call2(ember_vm* vm, ember_native_func native, ember_value a, ember_value b) {
+    ember_value argv[2] = {a, b};
+    return native(vm, 2, argv);
+}
+
+void test_append_and_take(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value builder = ember_native_string_builder(vm, 0, NULL);
+    assert(builder.type == EMBER_VAL_STRING_BUILDER);
+    vm->stack[vm->stack_top++] = builder;
+
+    ember_value parts[5] = {builder, ember_make_string_gc(vm, "n="), ember_make_number(2.5),
+                            ember_make_bool(1), ember_make_nil()};
+    assert(ember_native_builder_append(vm, 5, parts).as.obj_val == builder.as.obj_val);
+    assert(ember_native_builder_length(vm, 1, &builder).as.number_val == 12);
+    ember_value text = ember_native_builder_to_string(vm, 1, &builder);
+    assert(text.type == EMBER_VAL_STRING && strcmp(AS_CSTRING(text), "n=2.5truenil") == 0);
+    // Taking empties the builder
+    assert(ember_native_builder_length(vm, 1, &builder).as.number_val == 0);
+
+    // Long output: the string takes the builder's buffer
+    ember_value piece = ember_make_string_gc(vm, "0123456789");
+    vm->stack[vm->stack_top++] = piece;
+    for (int i = 0; i < 10000; i++) {
+        call2(vm, ember_native_builder_append, builder, piece);
+    }
+    ember_string_builder* state = AS_STRING_BUILDER(builder);
+    assert(state->length == 100000 && state->capacity >= state->length + 1);
+    text = ember_native_builder_to_string(vm, 1, &builder);
+    ember_string* string = AS_STRING(text);
+    assert(string->length == 100000 && string->chars[99999] == '9' && string->chars[100000] == '\0');
+    assert(state->chars == NULL && state->capacity == 0);
+
+    // Clear keeps the buffer for the next round
+    call2(vm, ember_native_builder_append, builder, piece);
+    char* kept = state->chars;
+    ember_native_builder_clear(vm, 1, &builder);
+    assert(state->length == 0 && state->chars == kept);
+
+    // Wrong receivers
+    assert(ember_native_builder_append(vm, 1, &piece).type == EMBER_VAL_NIL);
+    assert(ember_native_builder_length(vm, 1, &piece).type == EMBER_VAL_NIL);
+
+    vm->stack_top -= 2;
+    ember_free_vm(vm);
+    printf("Append and take test passed\n");
+}
+
+void test_appendf(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value builder = ember_native_string_builder(vm, 0, NULL);
+    vm->stack[vm->stack_top++] = builder;
+
+    // Rooted while the next string allocates
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, "<td>%-4s|%5.2f|%03d|%x|%s</td> 100%%");
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, "ab");
+    ember_value args[6] = {builder, vm->stack[vm->stack_top - 2], vm->stack[vm->stack_top - 1],
+                           ember_make_number(3.14159), ember_make_number(7), ember_make_number(255)};
+    ember_value seven[7] = {args[0], args[1], args[2], args[3], args[4], args[5], ember_make_bool(0)};
+    assert(ember_native_builder_appendf(vm, 7, seven).type == EMBER_VAL_STRING_BUILDER);
+    assert(strcmp(AS_STRING_BUILDER(builder)->chars, "<td>ab  | 3.14|007|ff|false</td> 100%") == 0);
+
+    // Too few values, a number directive given a string, a bad directive
+    ember_native_builder_clear(vm, 1, &builder);
+    assert(ember_native_builder_appendf(vm, 6, args).type == EMBER_VAL_NIL);
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, "x");
+    ember_value bad[3] = {builder, ember_make_string_gc(vm, "%d"), vm->stack[vm->stack_top - 1]};
+    assert(ember_native_builder_appendf(vm, 3, bad).type == EMBER_VAL_NIL);
+    bad[1] = ember_make_string_gc(vm, "%q");
+    assert(ember_native_builder_appendf(vm, 3, bad).type == EMBER_VAL_NIL);
+
+    vm->stack_top -= 4;
+    ember_free_vm(vm);
+    printf("Appendf test passed\n");
+}
+
+void test_c_builder_and_join(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    // On the C stack, as natives use it
+    ember_string_builder builder = {0};
+    for (int i = 0; i < 1000; i++) {
+        assert(string_builder_appendf(&builder, "%d,", i));
+    }
+    assert(builder.length == 3890 && strncmp(builder.chars, "0,1,2,", 6) == 0);
+    ember_string* string = string_builder_take(vm, &builder);
+    assert(string && string->length == 3890 && builder.chars == NULL);
+    string_builder_reset(&builder);
+
+    ember_value words = ember_make_array(vm, 4);
+    vm->stack[vm->stack_top++] = words;
+    const char* names[] = {"alpha", "beta", "gamma"};
+    for (int i = 0; i < 3; i++) {
+        array_push_with_vm(vm, AS_ARRAY(words), ember_make_string_gc(vm, names[i]));
+    }
+    ember_value joined = call2(vm, ember_native_join, words, ember_make_string_gc(vm, ", "));
+    assert(joined.type == EMBER_VAL_STRING && strcmp(AS_CSTRING(joined), "alpha, beta, gamma") == 0);
+
+    vm->stack_top--;
+    ember_free_vm(vm);
+    printf("C builder and join test passed\n");
+}
+
+// Splits text on delimiter and checks the fields, then joins them back
+static void check_split(ember_vm* vm, const char* text, const char* delimiter, int count, const char** fields) {
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, text);
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, delimiter);
+    ember_value parts = ember_native_split(vm, 2, &vm->stack[vm->stack_top - 2]);
+    assert(parts.type == EMBER_VAL_ARRAY && AS_ARRAY(parts)->length == count);
+    for (int i = 0; i < count; i++) {
+        assert(strcmp(AS_CSTRING(AS_ARRAY(parts)->elements[i]), fields[i]) == 0);
+    }
+    if (delimiter[0]) {
+        ember_value join_args[2] = {parts, vm->stack[vm->stack_top - 1]};
+        vm->stack[vm->stack_top - 2] = parts;
+        ember_value joined = ember_native_join(vm, 2, join_args);
+        assert(strcmp(AS_CSTRING(joined), text) == 0);
+    }
+    vm->stack_top -= 2;
+}
+
+void test_split(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    // Empty fields are kept, and the delimiter is a string, not a set
+    check_split(vm, "a,,b,", ",", 4, (const char*[]){"a", "", "b", ""});
+    check_split(vm, "k=>v=x=>", "=>", 3, (const char*[]){"k", "v=x", ""});
+    check_split(vm, "", ",", 1, (const char*[]){""});
+    check_split(vm, "none", ";", 1, (const char*[]){"none"});
+    check_split(vm, "h\xc3\xa9!", "", 3, (const char*[]){"h", "\xc3\xa9", "!"});
+
+    // Far past the old fixed capacity of 8, as a large CSV line would be
+    ember_string_builder line = {0};
+    for (int i = 0; i < 5000; i++) {
+        assert(string_builder_appendf(&line, i ? ",%d" : "%d", i));
+    }
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, line.chars);
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, ",");
+    ember_value parts = ember_native_split(vm, 2, &vm->stack[vm->stack_top - 2]);
+    assert(AS_ARRAY(parts)->length == 5000);
+    assert(strcmp(AS_CSTRING(AS_ARRAY(parts)->elements[4999]), "4999") == 0);
+    vm->stack_top -= 2;
+    string_builder_reset(&line);
+
+    ember_free_vm(vm);
+    printf("Split test passed\n");
+}
+
+void test_substring_slices(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_string_builder text = {0};
+    for (int i = 0; i < 100; i++) {
+        assert(string_builder_appendf(&text, "%02d", i));
+    }
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, text.chars);
+    ember_string* parent = AS_STRING(vm->stack[vm->stack_top - 1]);
+
+    // A long substring shares the parent's bytes
+    ember_value args[3] = {vm->stack[vm->stack_top - 1], ember_make_number(10), ember_make_number(100)};
+    ember_value long_part = ember_native_substr(vm, 3, args);
+    ember_string* slice = AS_STRING(long_part);
+    assert(slice->chars == NULL && slice->left == parent && slice->right == NULL);
+    assert(slice->length == 100 && memcmp(ember_string_bytes(slice), text.chars + 10, 100) == 0);
+    vm->stack[vm->stack_top++] = long_part;
+
+    // A short one is copied, and one of a slice points at the parent
+    args[2] = ember_make_number(4);
+    ember_value short_part = ember_native_substr(vm, 3, args);
+    assert(AS_STRING(short_part)->is_inline && strcmp(AS_CSTRING(short_part), "0506") == 0);
+    ember_value nested_args[3] = {long_part, ember_make_number(20), ember_make_number(70)};
+    ember_value nested = ember_native_substr(vm, 3, nested_args);
+    assert(AS_STRING(nested)->left == parent && AS_STRING(nested)->slice_start == 30);
+    vm->stack[vm->stack_top++] = nested;
+
+    // Equal to, and found under, the flat string with the same bytes
+    ember_value flat;
+    flat.type = EMBER_VAL_STRING;
+    flat.as.obj_val = (ember_object*)copy_string(vm, text.chars + 10, 100);
+    vm->stack[vm->stack_top++] = flat;
+    assert(values_equal(long_part, flat) && hash_value(long_part) == hash_value(flat));
+    ember_value map = ember_make_hash_map(vm, 4);
+    vm->stack[vm->stack_top++] = map;
+    hash_map_set_with_vm(vm, AS_HASH_MAP(map), long_part, ember_make_number(1));
+    assert(hash_map_get(AS_HASH_MAP(map), flat).as.number_val == 1);
+
+    // The slice keeps its parent alive; a rope over it flattens through it
+    vm->stack[vm->stack_top - 4] = ember_make_nil();
+    ember_gc_collect(vm);
+    assert(memcmp(ember_string_bytes(slice), text.chars + 10, 100) == 0);
+    ember_value joined = concatenate_strings(vm, long_part, nested);
+    ember_string* rope = AS_STRING(joined);
+    assert(rope->chars == NULL && rope->length == 170);
+    assert(memcmp(ember_string_flatten(rope), text.chars + 10, 100) == 0);
+    assert(memcmp(rope->chars + 100, text.chars + 30, 70) == 0);
+
+    // Flattening a slice materializes it and lets go of the parent
+    assert(strncmp(ember_string_flatten(slice), text.chars + 10, 100) == 0);
+    assert(slice->chars[100] == '\0' && slice->left == NULL);
+
+    vm->stack_top -= 6;
+    string_builder_reset(&text);
+    ember_free_vm(vm);
+    printf("Substring slice test passed\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running string builder tests...\n");
+    test_append_and_take();
+    test_appendf();
+    test_c_builder_and_join();
+    test_split();
+    test_substring_slices();
+    printf("All string builder tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,226 @@
+#define _GNU_SOURCE
+#include "ember.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define CHANNEL_MESSAGES 20000
+
+static ember_value key(ember_vm* vm, const char* text) {
+    return ember_make_string_len(vm, text, strlen(text));
+}
+
+void test_clone_graph(void) {
+    ember_vm* from = ember_new_vm();
+    ember_vm* to = ember_new_vm();
+    assert(from != NULL && to != NULL);
+    assert(ember_eval(from,
+        "shared = [1, 2]\n"
+        "graph = {\"left\": shared, \"right\": shared, \"label\": \"tree\"}\n"
+        "loop = [0]\n"
+        "loop[0] = loop\n") == 0);
+
+    // Shared parts stay shared, and nothing is the sender's
+    ember_value graph;
+    int rc = ember_clone_value(global_value(from, "graph"), to, &graph);
+    assert(rc == 0);
+    assert(graph.type == EMBER_VAL_HASH_MAP);
+    assert(graph.as.obj_val != global_value(from, "graph").as.obj_val);
+    ember_value left = hash_map_get(AS_HASH_MAP(graph), key(to, "left"));
+    ember_value right = hash_map_get(AS_HASH_MAP(graph), key(to, "right"));
+    assert(left.type == EMBER_VAL_ARRAY && left.as.obj_val == right.as.obj_val);
+    assert(left.as.obj_val != global_value(from, "shared").as.obj_val);
+    assert(AS_ARRAY(left)->length == 2 && AS_ARRAY(left)->elements[1].as.number_val == 2);
+    assert(strcmp(AS_CSTRING(hash_map_get(AS_HASH_MAP(graph), key(to, "label"))), "tree") == 0);
+
+    // Cycles close
+    ember_value loop;
+    rc = ember_clone_value(global_value(from, "loop"), to, &loop);
+    assert(rc == 0);
+    assert(AS_ARRAY(loop)->elements[0].as.obj_val == loop.as.obj_val);
+
+    // Sets, ordered maps and typed arrays
+    ember_value set = ember_make_set(from);
+    set_add(AS_SET(set), ember_make_number(7));
+    set_add(AS_SET(set), key(from, "seven"));
+    ember_value map = ember_make_map(from);
+    for (int i = 9; i >= 0; i--) {
+        assert(map_set(AS_MAP(map), ember_make_number(i), set));
+    }
+    ember_value floats = ember_make_typed_array(from, EMBER_TYPED_FLOAT64, 3);
+    ((double*)AS_TYPED_ARRAY(floats)->data)[2] = 2.5;
+    assert(map_set(AS_MAP(map), key(from, "floats"), floats));
+
+    uint8_t* data;
+    size_t size;
+    rc = ember_clone_encode(map, &data, &size);
+    assert(rc == 0);
+    ember_value copy;
+    rc = ember_clone_decode(to, data, size, &copy);
+    assert(rc == 0);
+    ember_map* copied = AS_MAP(copy);
+    assert(copied->size == 11);
+    assert(copied->entries[0].key.as.number_val == 9);
+    ember_value copied_set = copied->entries[0].value;
+    assert(copied_set.type == EMBER_VAL_SET && AS_SET(copied_set)->size == 2);
+    assert(copied->entries[9].value.as.obj_val == copied_set.as.obj_val);
+    ember_value copied_floats = map_get(copied, key(to, "floats"));
+    assert(AS_TYPED_ARRAY(copied_floats)->kind == EMBER_TYPED_FLOAT64);
+    assert(((double*)AS_TYPED_ARRAY(copied_floats)->data)[2] == 2.5);
+
+    // Damaged messages are refused
+    rc = ember_clone_decode(to, data, size - 1, &copy);
+    assert(rc == -1);
+    data[0] = 0xFF;
+    rc = ember_clone_decode(to, data, size, &copy);
+    assert(rc == -1);
+    (void)rc;
+    free(data);
+
+    ember_free_vm(to);
+    ember_free_vm(from);
+    printf("  ✓ Value graphs clone with sharing and cycles intact\n");
+}
+
+void test_clone_instances(void) {
+    const char* point_class =
+        "class Point {\n"
+        "    fn init(x, y) {\n"
+        "        this.x = x\n"
+        "        this.y = y\n"
+        "    }\n"
+        "    fn sum() { return this.x + this.y }\n"
+        "}\n";
+    ember_vm* from = ember_new_vm();
+    ember_vm* to = ember_new_vm();
+    ember_vm* stranger = ember_new_vm();
+    assert(from != NULL && to != NULL && stranger != NULL);
+    assert(ember_eval(from, point_class) == 0);
+    assert(ember_eval(from, "point = new Point(3, 4)\nfn helper() { return 1 }\n") == 0);
+    assert(ember_eval(to, point_class) == 0);
+
+    // Rebuilt with the receiver's class of the same name
+    ember_value point;
+    int rc = ember_clone_value(global_value(from, "point"), to, &point);
+    assert(rc == 0);
+    assert(point.type == EMBER_VAL_INSTANCE);
+    assert(AS_INSTANCE(point)->klass == AS_CLASS(global_value(to, "Point")));
+    assert(ember_global_define(to, "point", point) >= 0);
+    assert(ember_eval(to, "total = point.sum()\n") == 0);
+    assert(global_value(to, "total").as.number_val == 7);
+
+    // No such class, no instance
+    rc = ember_clone_value(global_value(from, "point"), stranger, &point);
+    assert(rc == -1);
+
+    // Code does not cross
+    uint8_t* data = NULL;
+    size_t size = 0;
+    rc = ember_clone_encode(global_value(from, "helper"), &data, &size);
+    assert(rc == -1);
+    (void)rc;
+    assert(data == NULL);
+
+    ember_free_vm(stranger);
+    ember_free_vm(to);
+    ember_free_vm(from);
+    printf("  ✓ Instances clone into the receiver's class\n");
+}
+
+void test_channel_states(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_channel* channel = ember_channel_create(2);
+    assert(channel != NULL);
+    ember_value out;
+    assert(ember_channel_receive(channel, vm, &out) == 1);
+
+    assert(ember_channel_send(channel, ember_make_number(1)) == 0);
+    assert(ember_channel_send(channel, key(vm, "two")) == 0);
+    assert(ember_channel_send(channel, ember_make_number(3)) == 1);
+
+    // Closing stops senders; receivers drain what was queued
+    ember_channel_close(channel);
+    assert(ember_channel_send(channel, ember_make_number(4)) == -1);
+    assert(ember_channel_receive(channel, vm, &out) == 0 && out.as.number_val == 1);
+    assert(ember_channel_receive(channel, vm, &out) == 0 && strcmp(AS_CSTRING(out), "two") == 0);
+    assert(ember_channel_receive(channel, vm, &out) == -1);
+
+    // Messages left behind go with the last reference
+    ember_channel* leftover = ember_channel_create(4);
+    assert(ember_channel_retain(leftover) == leftover);
+    assert(ember_channel_send(leftover, key(vm, "never read")) == 0);
+    ember_channel_release(leftover);
+    ember_channel_release(leftover);
+
+    ember_channel_release(channel);
+    ember_free_vm(vm);
+    printf("  ✓ Channels report full, empty and closed\n");
+}
+
+static void* producer(void* arg) {
+    ember_channel* channel = arg;
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    for (int i = 0; i < CHANNEL_MESSAGES; i++) {
+        ember_value message = ember_make_array(vm, 2);
+        array_push(AS_ARRAY(message), ember_make_number(i));
+        array_push(AS_ARRAY(message), key(vm, "payload"));
+        int sent;
+        while ((sent = ember_channel_send(channel, message)) == 1) {
+            sched_yield();
+        }
+        assert(sent == 0);
+    }
+    ember_channel_close(channel);
+    ember_free_vm(vm);
+    return NULL;
+}
+
+void test_channel_threads(void) {
+    ember_channel* channel = ember_channel_create(64);
+    assert(channel != NULL);
+    pthread_t thread;
+    int rc = pthread_create(&thread, NULL, producer, channel);
+    assert(rc == 0);
+    (void)rc;
+
+    // Each side has its own VM; messages arrive whole and in order
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    int received = 0;
+    ember_value out;
+    int result;
+    while ((result = ember_channel_receive(channel, vm, &out)) != -1) {
+        if (result == 1) {
+            sched_yield();
+            continue;
+        }
+        assert(out.type == EMBER_VAL_ARRAY && AS_ARRAY(out)->length == 2);
+        assert(AS_ARRAY(out)->elements[0].as.number_val == received);
+        assert(strcmp(AS_CSTRING(AS_ARRAY(out)->elements[1]), "payload") == 0);
+        received++;
+    }
+    assert(received == CHANNEL_MESSAGES);
+
+    pthread_join(thread, NULL);
+    ember_channel_release(channel);
+    ember_free_vm(vm);
+    printf("  ✓ Channels carry values between threads\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running structured clone tests...\n");
+    test_clone_graph();
+    test_clone_instances();
+    test_channel_states();
+    test_channel_threads();
+    printf("All structured clone tests passed!\n");
+    return 0;
+}
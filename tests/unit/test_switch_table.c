@@ -0,0 +1,249 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/core/bytecode_format.h"
+#include "../../src/frontend/frontend.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static int constant(ember_chunk* chunk, ember_value value) {
+    int index = add_constant(chunk, value);
+    assert(index >= 0);
+    return index;
+}
+
+static ember_value string(ember_vm* vm, const char* chars) {
+    return ember_make_string_len(vm, chars, strlen(chars));
+}
+
+// Keys stay on the stack, rooted, until the VM is freed; the test chunk is
+// not a GC root
+static ember_value key(ember_vm* vm, const char* chars) {
+    ember_value value = string(vm, chars);
+    vm->stack[vm->stack_top++] = value;
+    return value;
+}
+
+static int lookup(ember_chunk* chunk, int table, ember_value subject) {
+    return ember_switch_table_target(chunk, &chunk->switch_tables[table], subject);
+}
+
+// Instructions of op in chunk, walking instruction boundaries
+static int count_op(const ember_chunk* chunk, uint8_t wanted) {
+    int found = 0;
+    for (int offset = 0; offset < chunk->count;) {
+        uint8_t op = chunk->code[offset];
+        int size = opcode_fused_size(op);
+        if (size == 0 && (op == OP_WIDE || opcode_has_operand(op))) {
+            read_chunk_operand(chunk, offset, &op, &size);
+        } else if (size == 0) {
+            size = 1;
+        }
+        if (op == wanted) found++;
+        offset += size;
+    }
+    return found;
+}
+
+static double global_number(ember_vm* vm, const char* name) {
+    int slot = ember_global_find(vm, name, (int)strlen(name));
+    assert(slot >= 0 && vm->globals[slot].value.type == EMBER_VAL_NUMBER);
+    return vm->globals[slot].value.as.number_val;
+}
+
+void test_lookup(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_chunk chunk;
+    init_chunk(&chunk);
+
+    // Integers filling their range index slots directly; the repeated 3
+    // keeps its first target
+    int keys[8];
+    int targets[8];
+    for (int i = 0; i < 6; i++) {
+        keys[i] = constant(&chunk, ember_make_number(i - 2));
+        targets[i] = 100 + i;
+    }
+    keys[6] = constant(&chunk, ember_make_number(3));
+    targets[6] = 999;
+    int dense = ember_chunk_add_switch_table(&chunk);
+    assert(dense == 0);
+    assert(ember_chunk_set_switch_table(&chunk, dense, keys, targets, 7, 50));
+    assert(chunk.switch_tables[dense].dense);
+    assert(lookup(&chunk, dense, ember_make_number(-2)) == 100);
+    assert(lookup(&chunk, dense, ember_make_number(3)) == 105);
+    assert(lookup(&chunk, dense, ember_make_number(-0.0)) == 102);
+    assert(lookup(&chunk, dense, ember_make_number(0.5)) == 50);
+    assert(lookup(&chunk, dense, ember_make_number(4)) == 50);
+    assert(lookup(&chunk, dense, ember_make_number(NAN)) == 50);
+    assert(lookup(&chunk, dense, string(vm, "1")) == 50);
+    assert(lookup(&chunk, dense, ember_make_nil()) == 50);
+
+    // Strings, as a protocol decoder's message types, through the perfect hash
+    int names[200];
+    int offsets[200];
+    char name[32];
+    for (int i = 0; i < 200; i++) {
+        snprintf(name, sizeof(name), "msg_%d", i);
+        names[i] = constant(&chunk, key(vm, name));
+        offsets[i] = 1000 + i;
+    }
+    int hashed = ember_chunk_add_switch_table(&chunk);
+    assert(ember_chunk_set_switch_table(&chunk, hashed, names, offsets, 200, 7));
+    assert(!chunk.switch_tables[hashed].dense && chunk.switch_tables[hashed].displacements != NULL);
+    for (int i = 0; i < 200; i++) {
+        snprintf(name, sizeof(name), "msg_%d", i);
+        assert(lookup(&chunk, hashed, string(vm, name)) == 1000 + i);
+    }
+    assert(lookup(&chunk, hashed, string(vm, "msg_200")) == 7);
+    assert(lookup(&chunk, hashed, string(vm, "")) == 7);
+    assert(lookup(&chunk, hashed, ember_make_number(1)) == 7);
+
+    // Sparse numbers and strings together
+    int mixed_keys[3] = {
+        constant(&chunk, ember_make_number(1e9)),
+        constant(&chunk, ember_make_number(-7.5)),
+        constant(&chunk, key(vm, "x")),
+    };
+    int mixed_targets[3] = {1, 2, 3};
+    int mixed = ember_chunk_add_switch_table(&chunk);
+    assert(ember_chunk_set_switch_table(&chunk, mixed, mixed_keys, mixed_targets, 3, 0));
+    assert(lookup(&chunk, mixed, ember_make_number(1e9)) == 1);
+    assert(lookup(&chunk, mixed, ember_make_number(-7.5)) == 2);
+    assert(lookup(&chunk, mixed, string(vm, "x")) == 3);
+    assert(lookup(&chunk, mixed, ember_make_bool(1)) == 0);
+
+    // Only numbers and strings can be keys
+    int bad = constant(&chunk, ember_make_bool(1));
+    int table = ember_chunk_add_switch_table(&chunk);
+    assert(!ember_chunk_set_switch_table(&chunk, table, &bad, mixed_targets, 1, 0));
+
+    // The handler pops the subject and reports where to resume
+    int top = vm->stack_top;
+    vm->stack[vm->stack_top++] = ember_make_number(1);
+    int target = -1;
+    assert(vm_handle_switch_table(vm, &chunk, dense, &target) == VM_RESULT_OK);
+    assert(target == 103 && vm->stack_top == top);
+
+    ember_chunk_free_switch_tables(&chunk);
+    assert(chunk.switch_tables == NULL && chunk.switch_table_count == 0);
+    free_chunk(&chunk);
+    ember_free_vm(vm);
+    printf("  ✓ Switch tables find dense, hashed and mixed keys\n");
+}
+
+static const char* literal_switch =
+    "fn kind(t) {\n"
+    "    r = 0\n"
+    "    switch (t) {\n"
+    "        case 1: r = r + 1\n"
+    "        case 2: r = r + 10\n"
+    "            break\n"
+    "        case -3: r = 300\n"
+    "            break\n"
+    "        case \"ping\": r = 4\n"
+    "            break\n"
+    "        default: r = -1\n"
+    "    }\n"
+    "    return r\n"
+    "}\n"
+    "a = kind(1)\n"
+    "b = kind(2)\n"
+    "c = kind(-3)\n"
+    "d = kind(\"ping\")\n"
+    "e = kind(7)\n";
+
+void test_compiled(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+
+    // Literal cases compile to one dispatch, without comparisons
+    ember_chunk chunk;
+    init_chunk(&chunk);
+    assert(compile(vm, "switch (x) { case 1: y = 1\n case 2: y = 2\n case 3: y = 3\n case \"four\": y = 4\n }\n",
+                   &chunk));
+    assert(count_op(&chunk, OP_SWITCH_TABLE) == 1 && count_op(&chunk, OP_CASE) == 0);
+    assert(chunk.switch_table_count == 1 && chunk.switch_tables[0].count == 4);
+    free_chunk(&chunk);
+
+    // Computed cases, or too few, keep the comparison chain
+    init_chunk(&chunk);
+    assert(compile(vm, "switch (x) { case y: z = 1\n case 2: z = 2\n case 3: z = 3\n case 4: z = 4\n }\n",
+                   &chunk));
+    assert(count_op(&chunk, OP_SWITCH_TABLE) == 0 && chunk.switch_table_count == 0);
+    free_chunk(&chunk);
+    init_chunk(&chunk);
+    assert(compile(vm, "switch (x) { case 1: z = 1\n case 2: z = 2\n }\n", &chunk));
+    assert(count_op(&chunk, OP_SWITCH_TABLE) == 0);
+    free_chunk(&chunk);
+
+    // Fall-through, break and default behave as the chain does
+    assert(ember_eval(vm, literal_switch) == 0);
+    assert(global_number(vm, "a") == 11);
+    assert(global_number(vm, "b") == 10);
+    assert(global_number(vm, "c") == 300);
+    assert(global_number(vm, "d") == 4);
+    assert(global_number(vm, "e") == -1);
+
+    // More cases than the chain allows, each with its own break
+    size_t size = 64 * 1024;
+    char* source = malloc(size);
+    assert(source);
+    size_t length = (size_t)snprintf(source, size, "fn decode(t) {\n    switch (t) {\n");
+    for (int i = 0; i < 150; i++) {
+        length += (size_t)snprintf(source + length, size - length,
+                                   "        case \"type_%d\": return %d\n            break\n", i, i * 2);
+    }
+    snprintf(source + length, size - length,
+             "    }\n    return -1\n}\nhit = decode(\"type_149\")\nmiss = decode(\"type_150\")\n");
+    assert(ember_eval(vm, source) == 0);
+    assert(global_number(vm, "hit") == 298);
+    assert(global_number(vm, "miss") == -1);
+    free(source);
+
+    ember_free_vm(vm);
+    printf("  ✓ Literal switches compile to a jump table\n");
+}
+
+void test_bytecode(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    uint8_t* data = NULL;
+    size_t size = 0;
+    assert(ember_bytecode_compile(vm, literal_switch, &data, &size));
+
+    // Tables are saved as cases and rebuilt on load
+    ember_vm* loaded = ember_new_vm();
+    assert(loaded != NULL);
+    ember_chunk* main = ember_bytecode_load(loaded, data, size);
+    assert(main != NULL);
+    int slot = ember_global_find(loaded, "kind", 4);
+    assert(slot >= 0);
+    ember_chunk* kind = loaded->globals[slot].value.as.func_val.chunk;
+    assert(kind->switch_table_count == 1 && kind->switch_tables[0].count == 4);
+    assert(ember_switch_table_target(kind, &kind->switch_tables[0], ember_make_number(7)) ==
+           kind->switch_tables[0].default_target);
+    assert(ember_switch_table_target(kind, &kind->switch_tables[0], string(loaded, "ping")) ==
+           kind->switch_tables[0].targets[3]);
+
+    ember_bytecode_free_chunk(main);
+    free(data);
+    ember_free_vm(loaded);
+    ember_free_vm(vm);
+    printf("  ✓ Switch tables survive bytecode files\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running switch table tests...\n");
+    test_lookup();
+    test_compiled();
+    test_bytecode();
+    printf("All switch table tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,241 @@
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "../../src/runtime/template_stubs.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+static void put(ember_vm* vm, ember_value map, const char* key, ember_value value) {
+    hash_map_set_with_vm(vm, AS_HASH_MAP(map), ember_make_string_gc(vm, key), value);
+}
+
+// The page the tests render: a title, a user and a list of items
+static ember_value page_data(ember_vm* vm) {
+    ember_value data = keep(vm, ember_make_hash_map(vm, 8));
+    put(vm, data, "title", text(vm, "Tom & Jerry's <list>"));
+    ember_value user = keep(vm, ember_make_hash_map(vm, 4));
+    put(vm, user, "name", text(vm, "ann"));
+    put(vm, user, "admin", ember_make_bool(1));
+    put(vm, data, "user", user);
+    ember_value items = keep(vm, ember_make_array(vm, 3));
+    const char* names[] = {"apple", "pear", "fig"};
+    for (int i = 0; i < 3; i++) {
+        ember_value item = keep(vm, ember_make_hash_map(vm, 4));
+        put(vm, item, "name", text(vm, names[i]));
+        put(vm, item, "price", ember_make_number(i + 0.5));
+        array_push_with_vm(vm, AS_ARRAY(items), item);
+    }
+    put(vm, data, "items", items);
+    put(vm, data, "empty", keep(vm, ember_make_array(vm, 0)));
+    return data;
+}
+
+static void assert_renders(ember_vm* vm, ember_native_func render, const char* source, ember_value data,
+                           const char* expected) {
+    ember_value args[2] = {text(vm, source), data};
+    ember_value result = render(vm, 2, args);
+    assert(result.type == EMBER_VAL_STRING);
+    if (strcmp(AS_CSTRING(result), expected) != 0) {
+        fprintf(stderr, "rendered \"%s\", expected \"%s\"\n", AS_CSTRING(result), expected);
+        assert(0);
+    }
+}
+
+void test_values_and_sections(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value data = page_data(vm);
+
+    assert_renders(vm, ember_template_render, "<h1>{{ title }}</h1>", data, "<h1>Tom & Jerry's <list></h1>");
+    assert_renders(vm, ember_html_render, "<h1>{{ title }}</h1>", data,
+                   "<h1>Tom &amp; Jerry&#39;s &lt;list&gt;</h1>");
+    assert_renders(vm, ember_html_render, "{{{title}}}|{{& title}}", data,
+                   "Tom & Jerry's <list>|Tom & Jerry's <list>");
+    assert_renders(vm, ember_template_render, "{{user.name}} {{items.1.name}} {{items.length}} {{missing.x}}!",
+                   data, "ann pear 3 !");
+    assert_renders(vm, ember_template_render, "{{#if user.admin}}admin{{else}}user{{/if}}", data, "admin");
+    assert_renders(vm, ember_template_render, "{{#unless user.admin}}user{{else}}admin{{/unless}}", data,
+                   "admin");
+    assert_renders(vm, ember_template_render, "{{#if empty}}some{{else}}none{{/if}}{{! not shown }}", data,
+                   "none");
+
+    // Loops see their item first, then the outer data
+    assert_renders(vm, ember_template_render,
+                   "{{#each items}}{{@index}}:{{name}}={{price}} by {{user.name}};{{/each}}", data,
+                   "0:apple=0.5 by ann;1:pear=1.5 by ann;2:fig=2.5 by ann;");
+    assert_renders(vm, ember_template_render, "{{#each empty}}x{{else}}nothing{{/each}}", data, "nothing");
+    assert_renders(vm, ember_template_render, "{{#each items}}{{name}}{{else}}nothing{{/each}}.", data,
+                   "applepearfig.");
+    // Maps loop in insertion order, with @key
+    ember_value prices = keep(vm, ember_make_map(vm));
+    map_set(AS_MAP(prices), text(vm, "b"), ember_make_number(2));
+    map_set(AS_MAP(prices), text(vm, "a"), ember_make_number(1));
+    put(vm, data, "prices", prices);
+    assert_renders(vm, ember_template_render, "{{#each prices}}{{@key}}={{this}} {{/each}}", data, "b=2 a=1 ");
+    assert_renders(vm, ember_template_render, "{{#each items}}{{name}}:{{#each prices}}{{@key}}{{/each}} {{/each}}",
+                   data, "apple:ba pear:ba fig:ba ");
+
+    vm->stack_top = 0;
+    template_cache_free(vm);
+    ember_free_vm(vm);
+    printf("  ✓ Values, sections and loops\n");
+}
+
+static char* write_temp(const char* contents) {
+    char* path = strdup("/tmp/ember_template_XXXXXX");
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    assert(write(fd, contents, strlen(contents)) == (ssize_t)strlen(contents));
+    close(fd);
+    return path;
+}
+
+void test_files_and_errors(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value data = page_data(vm);
+
+    // Cached by path and mtime: an edited file is compiled again
+    char* path = write_temp("<p>{{user.name}}</p>");
+    ember_value args[2] = {text(vm, path), data};
+    for (int i = 0; i < 3; i++) {
+        ember_value page = ember_html_render_file(vm, 2, args);
+        assert(page.type == EMBER_VAL_STRING && strcmp(AS_CSTRING(page), "<p>ann</p>") == 0);
+    }
+    FILE* file = fopen(path, "w");
+    fputs("<b>{{title}}</b>", file);
+    fclose(file);
+    struct timespec times[2] = {{0, UTIME_NOW}, {12345, 0}};
+    assert(utimensat(AT_FDCWD, path, times, 0) == 0);
+    ember_value page = ember_html_render_file(vm, 2, args);
+    assert(strcmp(AS_CSTRING(page), "<b>Tom &amp; Jerry&#39;s &lt;list&gt;</b>") == 0);
+    page = ember_template_render_file(vm, 2, args);
+    assert(strcmp(AS_CSTRING(page), "<b>Tom & Jerry's <list></b>") == 0);
+    unlink(path);
+    assert(ember_template_render_file(vm, 2, args).type == EMBER_VAL_NIL);
+    free(path);
+
+    // More templates than the cache holds still render
+    char source[64];
+    for (int i = 0; i < 100; i++) {
+        snprintf(source, sizeof(source), "%d {{user.name}}", i);
+        char expected[64];
+        snprintf(expected, sizeof(expected), "%d ann", i);
+        assert_renders(vm, ember_template_render, source, data, expected);
+    }
+
+    // Malformed templates and bad arguments give nil
+    const char* bad[] = {"{{#if x}}open", "{{/if}}", "{{#each x}}{{/if}}", "{{ a..b }}", "{{ unclosed",
+                         "{{ a.this }}", "{{#if}}{{/if}}", "{{}}", "{{#each a}}{{else}}{{else}}{{/each}}"};
+    for (int i = 0; i < (int)(sizeof(bad) / sizeof(bad[0])); i++) {
+        args[0] = text(vm, bad[i]);
+        assert(ember_template_render(vm, 2, args).type == EMBER_VAL_NIL);
+    }
+    args[0] = ember_make_number(1);
+    assert(ember_html_render(vm, 2, args).type == EMBER_VAL_NIL);
+    args[0] = text(vm, "no tags {at} all }}");
+    assert(strcmp(AS_CSTRING(ember_template_render(vm, 1, args)), "no tags {at} all }}") == 0);
+
+    args[0] = text(vm, "<a href=\"x\">&</a>");
+    ember_value escaped = ember_html_escape(vm, 1, args);
+    assert(strcmp(AS_CSTRING(escaped), "&lt;a href=&quot;x&quot;&gt;&amp;&lt;/a&gt;") == 0);
+
+    vm->stack_top = 0;
+    template_cache_free(vm);
+    ember_free_vm(vm);
+    printf("  ✓ Cached files, eviction and malformed templates\n");
+}
+
+// The escapes one byte at a time, to check the vector scans against
+static size_t reference_escape(const char* in, size_t length, char* out, int url) {
+    size_t at = 0;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)in[i];
+        const char* entity = NULL;
+        if (url) {
+            if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || strchr("-_.~", c))) {
+                at += (size_t)sprintf(out + at, "%%%02X", c);
+                continue;
+            }
+        } else {
+            switch (c) {
+                case '&': entity = "&amp;"; break;
+                case '<': entity = "&lt;"; break;
+                case '>': entity = "&gt;"; break;
+                case '"': entity = "&quot;"; break;
+                case '\'': entity = "&#39;"; break;
+                default: break;
+            }
+        }
+        if (entity) {
+            at += (size_t)sprintf(out + at, "%s", entity);
+        } else {
+            out[at++] = (char)c;
+        }
+    }
+    out[at] = '\0';
+    return at;
+}
+
+void test_escape_kernels(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+
+    // Escapes at every offset of and across vector lanes, and runs of clean text
+    char input[300];
+    char expected[300 * 6 + 1];
+    srand(11);
+    const char alphabet[] = "abcXYZ019-_.~ &<>\"'/%?=+\x01\x7f\xc3\xa9";
+    for (int round = 0; round < 200; round++) {
+        int length = rand() % (int)sizeof(input);
+        int dirty = rand() % 4;
+        for (int i = 0; i < length; i++) {
+            input[i] = dirty && rand() % 8 == 0 ? alphabet[rand() % (sizeof(alphabet) - 1)] : (char)('a' + i % 26);
+        }
+        input[length] = '\0';
+        for (int url = 0; url < 2; url++) {
+            ember_value arg = keep(vm, ember_make_string_gc(vm, input));
+            ember_value result = (url ? ember_url_encode : ember_html_escape)(vm, 1, &arg);
+            size_t expected_length = reference_escape(input, (size_t)length, expected, url);
+            assert(result.type == EMBER_VAL_STRING && AS_STRING(result)->length == (int)expected_length);
+            assert(memcmp(AS_CSTRING(result), expected, expected_length + 1) == 0);
+            // Text with nothing to escape comes back as it is
+            if (expected_length == (size_t)length) assert(result.as.obj_val == arg.as.obj_val);
+            vm->stack_top--;
+        }
+    }
+
+    // Every byte value
+    char all[256];
+    for (int i = 0; i < 255; i++) all[i] = (char)(i + 1);
+    all[255] = '\0';
+    ember_value arg = keep(vm, ember_make_string_gc(vm, all));
+    reference_escape(all, 255, expected, 1);
+    assert(strcmp(AS_CSTRING(ember_url_encode(vm, 1, &arg)), expected) == 0);
+    reference_escape(all, 255, expected, 0);
+    assert(strcmp(AS_CSTRING(ember_html_escape(vm, 1, &arg)), expected) == 0);
+    arg = ember_make_number(1);
+    assert(ember_url_encode(vm, 1, &arg).type == EMBER_VAL_NIL);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("  ✓ html_escape and url_encode kernels\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running template tests...\n");
+    test_values_and_sections();
+    test_files_and_errors();
+    test_escape_kernels();
+    printf("All template tests passed!\n");
+    return 0;
+}
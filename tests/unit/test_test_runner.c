@@ -0,0 +1,247 @@
+#define _GNU_SOURCE
+#include "../../src/runtime/testing/testing_framework.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void slow_pass(ember_vm* vm) {
+    usleep(50 * 1000);
+    TEST_ASSERT(vm != NULL, "Worker has a VM");
+}
+
+static void quick_fail(ember_vm* vm) {
+    TEST_ASSERT(0, "Fails on purpose");
+}
+
+static void hangs(ember_vm* vm) {
+    (void)vm;
+    // Long enough to outlast the test, short enough not to keep the process
+    sleep(2);
+}
+
+static test_runner* make_runner(int jobs, double timeout_ms, int fail_fast) {
+    test_runner* runner = test_runner_create();
+    assert(runner != NULL);
+    runner->jobs = jobs;
+    runner->timeout_ms = timeout_ms;
+    runner->stop_on_failure = fail_fast;
+    return runner;
+}
+
+void test_sequential(void) {
+    ember_vm* vm = ember_new_vm();
+    test_runner* runner = make_runner(1, 0, 0);
+    test_suite* suite = test_runner_add_suite(runner, "Sequential");
+    assert(!suite->deferred);
+
+    // Tests still run as they are added
+    test_suite_add_test(suite, "fails", quick_fail, vm);
+    assert(suite->failed == 1);
+    assert(suite->tests[0].status == TEST_FAIL);
+    assert(strstr(suite->tests[0].message, "Fails on purpose"));
+    ember_free_vm(vm);
+
+    test_runner_run_all(runner);
+    assert(runner->total_tests == 1 && runner->total_failed == 1);
+    test_runner_free(runner);
+    printf("  ✓ One job runs tests when added\n");
+}
+
+void test_parallel(void) {
+    test_runner* runner = make_runner(4, 0, 0);
+    test_suite* first = test_runner_add_suite(runner, "First");
+    for (int i = 0; i < 6; i++) {
+        test_suite_add_test(first, "slow", slow_pass, NULL);
+    }
+    test_suite* second = test_runner_add_suite(runner, "Second");
+    test_suite_add_test(second, "slow", slow_pass, NULL);
+    test_suite_add_test(second, "fails", quick_fail, NULL);
+    assert(second->deferred && second->test_count == 2 && second->failed == 0);
+
+    double start = now_ms();
+    test_runner_run_all(runner);
+    double elapsed = now_ms() - start;
+    // Eight 50ms tests on four workers
+    assert(elapsed < 350);
+
+    // Results stay with their tests
+    assert(runner->total_tests == 8);
+    assert(runner->total_passed == 7 && runner->total_failed == 1);
+    assert(first->passed == 6);
+    assert(second->tests[0].status == TEST_PASS);
+    assert(second->tests[1].status == TEST_FAIL);
+    assert(strstr(second->tests[1].message, "Fails on purpose"));
+    test_runner_free(runner);
+    printf("  ✓ Tests spread over workers, results in order\n");
+}
+
+void test_fail_fast(void) {
+    test_runner* runner = make_runner(2, 0, 1);
+    test_suite* suite = test_runner_add_suite(runner, "Fail fast");
+    test_suite_add_test(suite, "fails", quick_fail, NULL);
+    for (int i = 0; i < 20; i++) {
+        test_suite_add_test(suite, "slow", slow_pass, NULL);
+    }
+    test_runner_run_all(runner);
+
+    assert(suite->tests[0].status == TEST_FAIL);
+    assert(suite->failed == 1);
+    // Only what had started before the failure ran
+    assert(suite->skipped >= 18);
+    assert(suite->passed + suite->skipped == 20);
+    assert(strstr(suite->tests[20].message, "stopped"));
+    test_runner_free(runner);
+    printf("  ✓ Fail-fast skips what has not started\n");
+}
+
+void test_timeout(void) {
+    test_runner* runner = make_runner(2, 200, 0);
+    test_suite* suite = test_runner_add_suite(runner, "Timeouts");
+    test_suite_add_test(suite, "hangs", hangs, NULL);
+    for (int i = 0; i < 4; i++) {
+        test_suite_add_test(suite, "slow", slow_pass, NULL);
+    }
+
+    double start = now_ms();
+    test_runner_run_all(runner);
+    assert(now_ms() - start < 1500);
+
+    assert(suite->tests[0].status == TEST_ERROR);
+    assert(strstr(suite->tests[0].message, "Timed out"));
+    assert(suite->errors == 1 && suite->passed == 4);
+    test_runner_free(runner);
+
+    // A timeout alone also moves tests onto a worker
+    runner = make_runner(1, 200, 0);
+    suite = test_runner_add_suite(runner, "Timeouts");
+    assert(suite->deferred);
+    test_suite_add_test(suite, "hangs", hangs, NULL);
+    test_suite_add_test(suite, "slow", slow_pass, NULL);
+    test_runner_run_all(runner);
+    assert(suite->tests[0].status == TEST_ERROR);
+    assert(suite->tests[1].status == TEST_PASS);
+    test_runner_free(runner);
+    printf("  ✓ Tests over the timeout are reported and the run goes on\n");
+}
+
+static volatile double sink;
+
+static void cheap_work(ember_vm* vm) {
+    (void)vm;
+    double total = 0;
+    for (int i = 0; i < 100; i++) total += i * 0.5;
+    sink = total;
+}
+
+static void allocates(ember_vm* vm) {
+    ember_make_array(vm, 4);
+}
+
+static const char* baseline_path = "/tmp/ember_test_bench_baseline.txt";
+
+static void benchmark_against_baseline(ember_vm* vm) {
+    test_benchmark_options options;
+    test_benchmark_default_options(&options);
+    options.warmup_ms = 5;
+    options.budget_ms = 30;
+    options.baseline_path = baseline_path;
+    test_benchmark_result result;
+    assert(test_benchmark_run("cheap work", cheap_work, vm, &options, &result) == 0);
+    assert(result.regressed);
+}
+
+void test_benchmark_harness(void) {
+    unsetenv("EMBER_BENCH_BASELINE");
+    unsetenv("EMBER_BENCH_UPDATE");
+    remove(baseline_path);
+    ember_vm* vm = ember_new_vm();
+    test_benchmark_options options;
+    test_benchmark_default_options(&options);
+    assert(options.baseline_path == NULL && options.regression_threshold > 0);
+    options.warmup_ms = 5;
+    options.budget_ms = 30;
+    options.target_samples = 20;
+
+    // Cheap calls are batched and the statistics are per call
+    test_benchmark_result result;
+    assert(test_benchmark_run("cheap work", cheap_work, vm, &options, &result) == 0);
+    assert(result.batch > 1);
+    assert(result.samples >= 10 && result.samples <= 80);
+    assert(result.min_ns > 0 && result.min_ns <= result.median_ns);
+    assert(result.median_ns <= result.p99_ns && result.p99_ns <= result.max_ns);
+    assert(result.min_ns <= result.mean_ns && result.mean_ns <= result.max_ns);
+    assert(result.stddev_ns >= 0 && result.baseline_ns == 0 && !result.regressed);
+    printf("  ✓ Benchmarks calibrate batches and report percentiles\n");
+
+    // VM counters come as per-call deltas
+    assert(result.allocations == 0 && result.bytes_allocated == 0);
+    assert(test_benchmark_run("allocates", allocates, vm, &options, &result) == 0);
+    assert(result.allocations >= 1.0 && result.bytes_allocated > 0);
+    assert(result.allocations < 4.0);
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (result.hardware & (1u << i)) assert(result.hardware_counts[i] >= 0);
+    }
+    printf("  ✓ Benchmarks report allocations per call\n");
+
+    // The first run with a baseline file records the median
+    options.baseline_path = baseline_path;
+    assert(test_benchmark_run("cheap work", cheap_work, vm, &options, &result) == 0);
+    assert(result.baseline_ns == 0 && !result.regressed);
+    FILE* file = fopen(baseline_path, "r");
+    assert(file != NULL);
+    double saved = 0;
+    char name[64] = {0};
+    assert(fscanf(file, "%lf %63[^\n]", &saved, name) == 2);
+    fclose(file);
+    assert(saved > 0 && strcmp(name, "cheap work") == 0);
+
+    // A run far slower than the saved median fails the test it runs in
+    file = fopen(baseline_path, "w");
+    assert(file != NULL);
+    fprintf(file, "1.0 other\n0.001 cheap work\n");
+    fclose(file);
+    test_runner* runner = make_runner(1, 0, 0);
+    test_suite* suite = test_runner_add_suite(runner, "Benchmarks");
+    test_suite_add_test(suite, "guarded", benchmark_against_baseline, vm);
+    assert(suite->tests[0].status == TEST_FAIL);
+    assert(strstr(suite->tests[0].message, "regressed"));
+    test_runner_free(runner);
+
+    // Updating rewrites the entry and keeps the others
+    options.update_baseline = 1;
+    assert(test_benchmark_run("cheap work", cheap_work, vm, &options, &result) == 0);
+    assert(!result.regressed && result.baseline_ns > 0);
+    file = fopen(baseline_path, "r");
+    assert(file != NULL);
+    assert(fscanf(file, "%lf %63[^\n]", &saved, name) == 2);
+    assert(saved == 1.0 && strcmp(name, "other") == 0);
+    assert(fscanf(file, "%lf %63[^\n]", &saved, name) == 2);
+    assert(saved > 0.001 && strcmp(name, "cheap work") == 0);
+    fclose(file);
+    remove(baseline_path);
+    ember_free_vm(vm);
+    printf("  ✓ Baselines are saved, compared and updated\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running test runner tests...\n");
+    test_sequential();
+    test_parallel();
+    test_fail_fast();
+    test_timeout();
+    test_benchmark_harness();
+    printf("All test runner tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static ember_value dummy_native_a(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm; (void)argc; (void)argv;
+    return ember_make_nil();
+}
+
+static ember_value dummy_native_b(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm; (void)argc; (void)argv;
+    return ember_make_bool(1);
+}
+
+static ember_value native_value(ember_native_func function) {
+    ember_value value;
+    memset(&value, 0, sizeof(value));
+    value.type = EMBER_VAL_NATIVE;
+    value.as.native_val = function;
+    return value;
+}
+
+static void set_stack(ember_vm* vm, ember_value a, ember_value b) {
+    vm->stack[0] = a;
+    vm->stack[1] = b;
+    vm->stack_top = 2;
+}
+
+// OP_ADD at 0, OP_LESS at 1, OP_CALL 0 at 2..3, OP_POP at 4
+static ember_chunk* profiled_chunk(void) {
+    ember_chunk* chunk = malloc(sizeof(ember_chunk));
+    assert(chunk);
+    init_chunk(chunk);
+    write_chunk(chunk, OP_ADD);
+    write_chunk(chunk, OP_LESS);
+    write_chunk_op(chunk, OP_CALL, 0);
+    write_chunk(chunk, OP_POP);
+    return chunk;
+}
+
+void test_operand_types(void) {
+    ember_vm* vm = ember_new_vm();
+    ember_chunk* chunk = profiled_chunk();
+
+    for (int i = 0; i < 10; i++) {
+        set_stack(vm, ember_make_number(i), ember_make_number(1));
+        vm_feedback_record(vm, chunk, 0, OP_ADD, 0);
+    }
+    const ember_feedback_slot* add = ember_chunk_feedback_at(chunk, 0);
+    assert(add && add->opcode == OP_ADD && add->hits == 10);
+    assert(add->state == EMBER_FEEDBACK_MONOMORPHIC);
+    assert(add->left_types == 1u << EMBER_VAL_NUMBER && add->right_types == 1u << EMBER_VAL_NUMBER);
+
+    // nil on the left makes the site polymorphic
+    set_stack(vm, ember_make_nil(), ember_make_number(1));
+    vm_feedback_record(vm, chunk, 0, OP_ADD, 0);
+    assert(add->state == EMBER_FEEDBACK_POLYMORPHIC && add->target_count == 2);
+    assert(add->left_types == ((1u << EMBER_VAL_NUMBER) | (1u << EMBER_VAL_NIL)));
+
+    set_stack(vm, ember_make_number(1), ember_make_number(2));
+    vm_feedback_record(vm, chunk, 1, OP_LESS, 0);
+    assert(ember_chunk_feedback_at(chunk, 1)->state == EMBER_FEEDBACK_MONOMORPHIC);
+
+    // Unprofiled opcodes and offsets get no slot
+    vm_feedback_record(vm, chunk, 4, OP_POP, 0);
+    assert(ember_chunk_feedback_at(chunk, 4) == NULL);
+    assert(ember_chunk_feedback_at(chunk, 3) == NULL);
+    assert(chunk->feedback_count == 2);
+
+    ember_chunk_free_global_cache(chunk);
+    assert(chunk->feedback == NULL && ember_chunk_feedback_at(chunk, 0) == NULL);
+    free_chunk(chunk);
+    free(chunk);
+    ember_free_vm(vm);
+    printf("  ✓ Arithmetic and comparison sites record operand types\n");
+}
+
+void test_call_targets(void) {
+    ember_vm* vm = ember_new_vm();
+    ember_chunk* chunk = profiled_chunk();
+    ember_chunk callees[EMBER_FEEDBACK_TARGETS];
+
+    ember_value native = native_value(dummy_native_a);
+    for (int i = 0; i < 3; i++) {
+        vm->stack[0] = native;
+        vm->stack_top = 1;
+        vm_feedback_record(vm, chunk, 2, OP_CALL, 0);
+    }
+    const ember_feedback_slot* call = ember_chunk_feedback_at(chunk, 2);
+    assert(call->state == EMBER_FEEDBACK_MONOMORPHIC && call->hits == 3);
+    assert(call->left_types == 1u << EMBER_VAL_NATIVE);
+
+    vm->stack[0] = native_value(dummy_native_b);
+    vm_feedback_record(vm, chunk, 2, OP_CALL, 0);
+    assert(call->state == EMBER_FEEDBACK_POLYMORPHIC && call->target_count == 2);
+
+    // A site calling more distinct functions than it remembers is megamorphic
+    for (int i = 0; i < EMBER_FEEDBACK_TARGETS; i++) {
+        ember_value function;
+        memset(&function, 0, sizeof(function));
+        function.type = EMBER_VAL_FUNCTION;
+        function.as.func_val.chunk = &callees[i];
+        vm->stack[0] = function;
+        vm_feedback_record(vm, chunk, 2, OP_CALL, 0);
+    }
+    assert(call->state == EMBER_FEEDBACK_MEGAMORPHIC);
+    assert(call->target_count == EMBER_FEEDBACK_TARGETS);
+    assert(call->left_types == ((1u << EMBER_VAL_NATIVE) | (1u << EMBER_VAL_FUNCTION)));
+
+    vm->stack_top = 0;
+    free_chunk(chunk);
+    free(chunk);
+    ember_free_vm(vm);
+    printf("  ✓ Call sites track targets up to megamorphic\n");
+}
+
+int main(void) {
+    printf("Testing type feedback...\n");
+    test_operand_types();
+    test_call_targets();
+    printf("✓ Type feedback tests passed\n");
+    return 0;
+}
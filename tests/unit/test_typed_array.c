@@ -0,0 +1,193 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/core/vm_dispatch.h"
+#include "../../src/runtime/value/value.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static ember_value call(ember_vm* vm, ember_native_func func, int argc, ember_value* argv) {
+    int base = vm->stack_top;
+    for (int i = 0; i < argc; i++) {
+        vm->stack[vm->stack_top++] = argv[i];
+    }
+    ember_value result = func(vm, argc, &vm->stack[base]);
+    vm->stack_top = base;
+    return result;
+}
+
+// Operands above ROOTS slots that keep the test's objects alive
+#define ROOTS 2
+
+static void set_stack(ember_vm* vm, int count, ember_value a, ember_value b, ember_value c) {
+    vm->stack[ROOTS] = a;
+    vm->stack[ROOTS + 1] = b;
+    vm->stack[ROOTS + 2] = c;
+    vm->stack_top = ROOTS + count;
+}
+
+void test_create_and_convert(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+
+    ember_value length = ember_make_number(5);
+    ember_value zeros = call(vm, ember_native_float64_array, 1, &length);
+    assert(zeros.type == EMBER_VAL_TYPED_ARRAY && AS_TYPED_ARRAY(zeros)->length == 5);
+    for (int i = 0; i < 5; i++) {
+        assert(ember_typed_array_load(AS_TYPED_ARRAY(zeros), i) == 0);
+    }
+    vm->stack[vm->stack_top++] = zeros;
+
+    // Stores truncate toward zero and wrap, as in JavaScript
+    ember_value values = ember_make_array(vm, 6);
+    vm->stack[vm->stack_top++] = values;
+    const double inputs[] = {1.9, -1.9, 300, -1, 4294967297.0, 0.0 / 0.0};
+    for (int i = 0; i < 6; i++) {
+        array_push_with_vm(vm, AS_ARRAY(values), ember_make_number(inputs[i]));
+    }
+    ember_value ints = call(vm, ember_native_int32_array, 1, &values);
+    ember_value bytes = call(vm, ember_native_uint8_array, 1, &values);
+    const double int_expected[] = {1, -1, 300, -1, 1, 0};
+    const double byte_expected[] = {1, 255, 44, 255, 1, 0};
+    for (int i = 0; i < 6; i++) {
+        assert(ember_typed_array_load(AS_TYPED_ARRAY(ints), i) == int_expected[i]);
+        assert(ember_typed_array_load(AS_TYPED_ARRAY(bytes), i) == byte_expected[i]);
+    }
+    assert(ember_typed_wrap_int32(2147483648.0) == INT32_MIN);
+    assert(ember_typed_wrap_int32(-2147483649.0) == INT32_MAX);
+
+    // Converting between kinds, and back to an ordinary array
+    vm->stack[vm->stack_top++] = bytes;
+    ember_value doubles = call(vm, ember_native_float64_array, 1, &bytes);
+    assert(ember_typed_array_load(AS_TYPED_ARRAY(doubles), 1) == 255);
+    ember_value back = call(vm, ember_native_typed_to_array, 1, &doubles);
+    assert(back.type == EMBER_VAL_ARRAY && AS_ARRAY(back)->length == 6);
+    assert(AS_ARRAY(back)->elements[2].as.number_val == 44);
+    assert(ember_native_len(vm, 1, &doubles).as.number_val == 6);
+
+    // Bad lengths and non-numbers are refused
+    ember_value bad = ember_make_number(-1);
+    assert(call(vm, ember_native_int32_array, 1, &bad).type == EMBER_VAL_NIL);
+    bad = ember_make_number(1.5);
+    assert(call(vm, ember_native_int32_array, 1, &bad).type == EMBER_VAL_NIL);
+    array_push_with_vm(vm, AS_ARRAY(values), ember_make_bool(1));
+    assert(call(vm, ember_native_int32_array, 1, &values).type == EMBER_VAL_NIL);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("  ✓ Typed arrays are created and convert like JavaScript's\n");
+}
+
+void test_fill_copy_slice(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value length = ember_make_number(8);
+    ember_value array = call(vm, ember_native_int32_array, 1, &length);
+    vm->stack[vm->stack_top++] = array;
+    ember_typed_array* ints = AS_TYPED_ARRAY(array);
+
+    ember_value fill[4] = {array, ember_make_number(7), ember_make_number(2), ember_make_number(-2)};
+    assert(call(vm, ember_native_typed_fill, 4, fill).as.obj_val == array.as.obj_val);
+    const double filled[] = {0, 0, 7, 7, 7, 7, 0, 0};
+    for (int i = 0; i < 8; i++) {
+        assert(ember_typed_array_load(ints, i) == filled[i]);
+    }
+
+    // Overlapping copy within one array, then one from another kind
+    for (int i = 0; i < 8; i++) {
+        ember_typed_array_store(ints, i, i);
+    }
+    ember_value copy[5] = {array, array, ember_make_number(2), ember_make_number(0), ember_make_number(5)};
+    assert(call(vm, ember_native_typed_copy, 5, copy).type == EMBER_VAL_TYPED_ARRAY);
+    const double moved[] = {0, 1, 0, 1, 2, 3, 4, 7};
+    for (int i = 0; i < 8; i++) {
+        assert(ember_typed_array_load(ints, i) == moved[i]);
+    }
+    length = ember_make_number(2);
+    ember_value halves = call(vm, ember_native_float64_array, 1, &length);
+    ember_typed_array_store(AS_TYPED_ARRAY(halves), 0, 9.5);
+    ember_typed_array_store(AS_TYPED_ARRAY(halves), 1, -3.5);
+    ember_value from_doubles[3] = {array, halves, ember_make_number(6)};
+    assert(call(vm, ember_native_typed_copy, 3, from_doubles).type == EMBER_VAL_TYPED_ARRAY);
+    assert(ember_typed_array_load(ints, 6) == 9 && ember_typed_array_load(ints, 7) == -3);
+    // Not enough room
+    from_doubles[2] = ember_make_number(7);
+    assert(call(vm, ember_native_typed_copy, 3, from_doubles).type == EMBER_VAL_NIL);
+
+    ember_value slice[3] = {array, ember_make_number(-3), ember_make_nil()};
+    ember_value tail = call(vm, ember_native_typed_slice, 3, slice);
+    assert(tail.type == EMBER_VAL_TYPED_ARRAY && AS_TYPED_ARRAY(tail)->length == 3);
+    assert(AS_TYPED_ARRAY(tail)->kind == EMBER_TYPED_INT32);
+    assert(ember_typed_array_load(AS_TYPED_ARRAY(tail), 0) == 3);
+    ember_value empty[3] = {array, ember_make_number(5), ember_make_number(2)};
+    assert(AS_TYPED_ARRAY(call(vm, ember_native_typed_slice, 3, empty))->length == 0);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("  ✓ Fill, copy and slice\n");
+}
+
+void test_element_access(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value array = ember_make_typed_array(vm, EMBER_TYPED_UINT8, 4);
+    vm->stack[0] = array;
+    vm->stack_top = 1;
+    ember_value plain = ember_make_array(vm, 1);
+    vm->stack[1] = plain;
+
+    // a[1] = 513 leaves 513 on the stack and stores 1
+    set_stack(vm, 3, array, ember_make_number(1), ember_make_number(513));
+    assert(vm_dispatch_array_set(vm) == VM_RESULT_OK);
+    assert(vm->stack_top == ROOTS + 1 && vm->stack[ROOTS].as.number_val == 513);
+    set_stack(vm, 2, array, ember_make_number(1), ember_make_nil());
+    assert(vm_dispatch_array_get(vm) == VM_RESULT_OK);
+    assert(vm->stack_top == ROOTS + 1 && vm->stack[ROOTS].as.number_val == 1);
+
+    // Out of range, fractional and non-number accesses are errors
+    set_stack(vm, 2, array, ember_make_number(4), ember_make_nil());
+    assert(vm_dispatch_array_get(vm) == VM_RESULT_ERROR);
+    set_stack(vm, 2, array, ember_make_number(0.5), ember_make_nil());
+    assert(vm_handle_typed_array_get(vm) == VM_RESULT_ERROR);
+    set_stack(vm, 3, array, ember_make_number(0), ember_make_bool(1));
+    assert(vm_dispatch_array_set(vm) == VM_RESULT_ERROR);
+    // Ordinary arrays are left to the generic opcode
+    set_stack(vm, 2, plain, ember_make_number(0), ember_make_nil());
+    assert(vm_dispatch_array_get(vm) == VM_RESULT_CONTINUE && vm->stack_top == ROOTS + 2);
+
+    // A site that reads typed arrays quickens like one reading arrays
+    ember_chunk* chunk = malloc(sizeof(ember_chunk));
+    assert(chunk);
+    init_chunk(chunk);
+    write_chunk(chunk, OP_ARRAY_GET);
+    for (int i = 0; i < 16; i++) {
+        set_stack(vm, 2, array, ember_make_number(i % 4), ember_make_nil());
+        vm_feedback_record(vm, chunk, 0, OP_ARRAY_GET, 0);
+    }
+    assert(chunk->code[0] == OP_ARRAY_GET_NUMBER_INDEX);
+    set_stack(vm, 2, array, ember_make_number(1), ember_make_nil());
+    assert(vm_handle_quickened(vm, chunk, &chunk->code[0]) == VM_RESULT_OK);
+    assert(vm->stack_top == ROOTS + 1 && vm->stack[ROOTS].as.number_val == 1);
+    set_stack(vm, 2, array, ember_make_number(9), ember_make_nil());
+    assert(vm_handle_quickened(vm, chunk, &chunk->code[0]) == VM_RESULT_CONTINUE);
+    assert(chunk->code[0] == OP_ARRAY_GET_NUMBER_INDEX);
+    free_chunk(chunk);
+    free(chunk);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("  ✓ Element access unboxed through the array opcodes\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running typed array tests...\n");
+    test_create_and_convert();
+    test_fill_copy_slice();
+    test_element_access();
+    printf("All typed array tests passed!\n");
+    return 0;
+}
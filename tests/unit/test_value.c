@@ -669,6 +669,141 @@ static void test_hash_map_operations(ember_vm* vm) {
     printf("Hash map operations tests completed successfully!\n\n");
 }
 
+// Test Swiss-table probing invariants: power-of-two sizing, cached hashes, deletes
+static void test_hash_map_probing(ember_vm* vm) {
+    printf("Testing hash map probing...\n");
+    
+    ember_hash_map* map = AS_HASH_MAP(ember_make_hash_map(vm, 5));
+    assert((map->capacity & (map->capacity - 1)) == 0);
+    assert(map->capacity >= 5);
+    
+    for (int i = 0; i < 1000; i++) {
+        char key_str[32];
+        snprintf(key_str, sizeof(key_str), "probe_%d", i);
+        hash_map_set(map, ember_make_string_gc(vm, key_str), ember_make_number(i));
+    }
+    assert(map->length == 1000);
+    assert((map->capacity & (map->capacity - 1)) == 0);
+    
+    // Cached hashes must survive every resize
+    for (int i = 0; i < map->capacity; i++) {
+        if (map->entries[i].is_occupied) {
+            assert(map->entries[i].hash == hash_value(map->entries[i].key));
+        }
+    }
+    
+    // Deleting every other key must not hide the survivors further down a probe chain
+    for (int i = 0; i < 1000; i += 2) {
+        char key_str[32];
+        snprintf(key_str, sizeof(key_str), "probe_%d", i);
+        assert(hash_map_delete(map, ember_make_string_gc(vm, key_str)) == 1);
+    }
+    assert(map->length == 500);
+    for (int i = 0; i < 1000; i++) {
+        char key_str[32];
+        snprintf(key_str, sizeof(key_str), "probe_%d", i);
+        ember_value found = hash_map_get(map, ember_make_string_gc(vm, key_str));
+        if (i % 2) {
+            assert(found.type == EMBER_VAL_NUMBER && found.as.number_val == i);
+        } else {
+            assert(found.type == EMBER_VAL_NIL);
+        }
+    }
+    assert(hash_map_delete(map, ember_make_string_gc(vm, "probe_0")) == 0);
+    
+    hash_map_clear(map);
+    assert(map->length == 0);
+    assert(!hash_map_has_key(map, ember_make_string_gc(vm, "probe_1")));
+    printf("  ✓ Hash map probing test passed\n");
+    
+    // Constant insert/delete churn over a small live set keeps memory bounded
+    ember_hash_map* churn = AS_HASH_MAP(ember_make_hash_map(vm, 8));
+    for (int i = 0; i < 100000; i++) {
+        hash_map_set(churn, ember_make_number(i), ember_make_number(i));
+        if (i >= 32) {
+            assert(hash_map_delete(churn, ember_make_number(i - 32)) == 1);
+        }
+    }
+    assert(churn->length == 32);
+    assert(churn->capacity <= 128);
+    assert(churn->tombstones < churn->capacity);
+    for (int i = 100000 - 32; i < 100000; i++) {
+        assert(hash_map_has_key(churn, ember_make_number(i)));
+    }
+    
+    // Draining a large table shrinks it back down
+    ember_hash_map* drained = AS_HASH_MAP(ember_make_hash_map(vm, 8));
+    for (int i = 0; i < 4096; i++) {
+        hash_map_set(drained, ember_make_number(i), ember_make_nil());
+    }
+    int peak_capacity = drained->capacity;
+    for (int i = 0; i < 4090; i++) {
+        hash_map_delete(drained, ember_make_number(i));
+    }
+    assert(drained->capacity < peak_capacity);
+    assert(drained->length == 6);
+    assert(hash_map_has_key(drained, ember_make_number(4095)));
+    printf("  ✓ Hash map tombstone purge and shrink test passed\n");
+    
+    printf("Hash map probing tests completed successfully!\n\n");
+}
+
+static ember_set* numbers_set(ember_vm* vm, int from, int to) {
+    ember_value array = ember_make_array(vm, to - from);
+    vm->stack[vm->stack_top++] = array;
+    for (int i = from; i < to; i++) {
+        array_push_with_vm(vm, AS_ARRAY(array), ember_make_number(i));
+    }
+    ember_value set = set_from_array(vm, AS_ARRAY(array));
+    assert(set.type == EMBER_VAL_SET);
+    vm->stack[vm->stack_top - 1] = set;
+    return AS_SET(set);
+}
+
+// Test set algebra
+static void test_set_algebra(ember_vm* vm) {
+    printf("Testing set algebra...\n");
+    int base = vm->stack_top;
+    
+    // Built from an array in one sizing; duplicates collapse
+    ember_set* big = numbers_set(vm, 0, 1000);
+    int capacity = big->elements->capacity;
+    assert(big->size == 1000);
+    ember_value repeated = ember_make_array(vm, 4);
+    vm->stack[vm->stack_top++] = repeated;
+    array_push_with_vm(vm, AS_ARRAY(repeated), ember_make_number(1));
+    array_push_with_vm(vm, AS_ARRAY(repeated), ember_make_string_gc(vm, "x"));
+    array_push_with_vm(vm, AS_ARRAY(repeated), ember_make_number(1));
+    assert(AS_SET(set_from_array(vm, AS_ARRAY(repeated)))->size == 2);
+    
+    ember_set* small = numbers_set(vm, 990, 1010);
+    ember_value both = set_intersection(vm, big, small);
+    assert(AS_SET(both)->size == 10 && set_has(AS_SET(both), ember_make_number(995)));
+    assert(AS_SET(set_intersection(vm, small, big))->size == 10);
+    ember_value either = set_union(vm, small, big);
+    assert(AS_SET(either)->size == 1010 && set_has(AS_SET(either), ember_make_number(1009)));
+    ember_value only = set_difference(vm, small, big);
+    assert(AS_SET(only)->size == 10 && !set_has(AS_SET(only), ember_make_number(999)));
+    assert(set_is_subset(AS_SET(both), big) && !set_is_subset(small, big));
+    
+    // In place, walking the small side and the large side
+    assert(set_union_with(vm, small, big) && small->size == 1010);
+    assert(set_has(small, ember_make_number(0)));
+    ember_set* few = numbers_set(vm, 500, 505);
+    assert(set_retain_all(vm, big, few) && big->size == 5);
+    assert(big->elements->capacity < capacity);
+    assert(set_has(big, ember_make_number(504)) && !set_has(big, ember_make_number(505)));
+    set_add(big, ember_make_number(7));
+    assert(set_has(big, ember_make_number(7)) && big->size == 6);
+    ember_set* evens = numbers_set(vm, 0, 0);
+    for (int i = 0; i < 1010; i += 2) set_add(evens, ember_make_number(i));
+    assert(set_retain_all(vm, small, evens) && small->size == 505);
+    assert(set_has(small, ember_make_number(1008)) && !set_has(small, ember_make_number(1009)));
+    
+    vm->stack_top = base;
+    printf("  ✓ Set algebra test passed\n");
+}
+
 // Test string operations
 static void test_string_operations(ember_vm* vm) {
     printf("Testing string operations...\n");
@@ -953,6 +1088,44 @@ static void test_hash_value_computation(ember_vm* vm) {
     printf("Hash value computation tests completed successfully!\n\n");
 }
 
+// Every length takes a different path through the word-at-a-time hash
+static void test_string_hash_words(void) {
+    printf("Testing word-at-a-time string hash...\n");
+    char text[256];
+    char shifted[260];
+    for (int i = 0; i < (int)sizeof(text); i++) text[i] = (char)('a' + (i * 7) % 26);
+    uint32_t previous = 0;
+    for (int length = 0; length <= 200; length++) {
+        // Alignment does not matter, and the bytes past the end are not read
+        memcpy(shifted + 3, text, (size_t)length);
+        shifted[3 + length] = '!';
+        uint32_t hash = hash_string_chars(text, length);
+        assert(hash == hash_string_chars(shifted + 3, length));
+        assert(length == 0 || hash != previous);
+        previous = hash;
+        // Any one byte changed changes the hash
+        for (int at = 0; at < length; at += length > 64 ? 13 : 1) {
+            shifted[3 + at] ^= 0x20;
+            assert(hash_string_chars(shifted + 3, length) != hash);
+            shifted[3 + at] ^= 0x20;
+        }
+    }
+    assert(hash_string_chars(NULL, 4) == 0);
+    printf("  ✓ Word-at-a-time string hash test passed\n");
+
+    // Multiples of a large power of two differ only in high bits; the probe
+    // position (bits 7 and up) and h2 (the low 7) must still spread them
+    int low_bits[128] = {0};
+    int distinct = 0;
+    for (int i = 0; i < 1024; i++) {
+        uint32_t hash = hash_small_int(i << 20);
+        if (!low_bits[hash & 0x7F]++) distinct++;
+        assert(hash_number((double)(i << 20)) == hash);
+    }
+    assert(distinct > 100);
+    printf("  ✓ Number hash spread test passed\n\n");
+}
+
 // Test exception creation and handling
 static void test_exception_handling(ember_vm* vm) {
     printf("Testing exception handling...\n");
@@ -1395,6 +1568,250 @@ static void test_performance_characteristics(ember_vm* vm) {
     printf("Performance characteristics tests completed successfully!\n\n");
 }
 
+// Test the weak string intern table and cached string hashes
+static void test_string_interning(ember_vm* vm) {
+    printf("Testing string interning...\n");
+    
+    ember_string* a = intern_string(vm, "request_id", 10);
+    ember_string* b = intern_string(vm, "request_id_suffix", 10);
+    assert(a != NULL && a == b);
+    assert(a->is_interned);
+    assert(find_interned_string(vm, "request_id", 10) == a);
+    assert(find_interned_string(vm, "missing", 7) == NULL);
+    printf("  ✓ Interned strings share one object\n");
+    
+    ember_value interned;
+    interned.type = EMBER_VAL_STRING;
+    interned.as.obj_val = (ember_object*)a;
+    ember_value copy = ember_make_string_gc(vm, "request_id");
+    assert(AS_STRING(copy)->hash == a->hash);
+    assert(hash_value(copy) == hash_value(interned));
+    assert(values_equal(copy, interned));
+    
+    ember_value other;
+    other.type = EMBER_VAL_STRING;
+    other.as.obj_val = (ember_object*)intern_string(vm, "response_id", 11);
+    assert(!values_equal(other, interned));
+    printf("  ✓ Cached hashes and equality passed\n");
+    
+    // Only marked strings survive a sweep
+    for (int i = 0; i < 200; i++) {
+        char buffer[32];
+        int length = snprintf(buffer, sizeof(buffer), "ident_%d", i);
+        intern_string(vm, buffer, length);
+    }
+    a->obj.is_marked = 1;
+    sweep_string_intern_table(vm);
+    a->obj.is_marked = 0;
+    assert(find_interned_string(vm, "request_id", 10) == a);
+    assert(find_interned_string(vm, "ident_7", 7) == NULL);
+    assert(vm->string_intern_table->length == 1);
+    printf("  ✓ Weak sweep passed\n");
+    
+    printf("String interning tests completed successfully!\n\n");
+}
+
+// Test inline storage for short strings
+static void test_small_strings(ember_vm* vm) {
+    printf("Testing small-string storage...\n");
+    
+    ember_value short_val = ember_make_string_gc(vm, "content-type");
+    ember_string* short_str = AS_STRING(short_val);
+    assert(short_str->is_inline);
+    assert(short_str->chars == short_str->inline_chars);
+    assert(strcmp(AS_CSTRING(short_val), "content-type") == 0);
+    assert(short_str->chars[short_str->length] == '\0');
+    printf("  ✓ Short strings stored inline\n");
+    
+    char long_buffer[EMBER_STRING_INLINE_MAX + 9];
+    memset(long_buffer, 'x', sizeof(long_buffer) - 1);
+    long_buffer[sizeof(long_buffer) - 1] = '\0';
+    ember_value long_val = ember_make_string_gc(vm, long_buffer);
+    assert(!AS_STRING(long_val)->is_inline);
+    assert(strcmp(AS_CSTRING(long_val), long_buffer) == 0);
+    printf("  ✓ Long strings use a heap buffer\n");
+    
+    ember_value joined = concatenate_strings(vm, short_val, ember_make_string_gc(vm, "/json"));
+    assert(AS_STRING(joined)->is_inline);
+    assert(strcmp(AS_CSTRING(joined), "content-type/json") == 0);
+    assert(values_equal(joined, ember_make_string_gc(vm, "content-type/json")));
+    
+    ember_value spilled = concatenate_strings(vm, joined, long_val);
+    assert(!AS_STRING(spilled)->is_inline);
+    assert(AS_STRING(spilled)->length == 17 + (int)strlen(long_buffer));
+    printf("  ✓ Concatenation across the inline limit passed\n");
+    
+    printf("Small-string tests completed successfully!\n\n");
+}
+
+// Test lazy rope concatenation and flattening
+static void test_string_ropes(ember_vm* vm) {
+    printf("Testing rope concatenation...\n");
+    
+    // Build a response the way template loops do: repeated left-deep appends
+    ember_value piece = ember_make_string_gc(vm, "<li>item</li>");
+    ember_value html = ember_make_string_gc(vm, "");
+    for (int i = 0; i < 500; i++) {
+        html = concatenate_strings(vm, html, piece);
+    }
+    ember_string* html_str = AS_STRING(html);
+    assert(html_str->length == 500 * 13);
+    assert(html_str->chars == NULL);
+    printf("  ✓ Long concatenations stay lazy\n");
+    
+    const char* flat = AS_CSTRING(html);
+    assert(flat != NULL && html_str->chars == flat);
+    assert(html_str->left == NULL && html_str->right == NULL);
+    assert((int)strlen(flat) == html_str->length);
+    assert(strncmp(flat + 13 * 250, "<li>item</li>", 13) == 0);
+    assert(html_str->hash == hash_string_chars(flat, html_str->length));
+    printf("  ✓ Flattening on first observation passed\n");
+    
+    // Two rope children on one node, plus a right-deep chain
+    ember_value left = ember_make_string_gc(vm, "");
+    ember_value right = ember_make_string_gc(vm, "");
+    for (int i = 0; i < 40; i++) {
+        left = concatenate_strings(vm, left, ember_make_string_gc(vm, "abcd"));
+        right = concatenate_strings(vm, ember_make_string_gc(vm, "wxyz"), right);
+    }
+    ember_value both = concatenate_strings(vm, left, right);
+    char buffer[321];
+    for (int i = 0; i < 40; i++) memcpy(buffer + i * 4, "abcd", 4);
+    for (int i = 0; i < 40; i++) memcpy(buffer + 160 + i * 4, "wxyz", 4);
+    buffer[320] = '\0';
+    ember_value expected = ember_make_string_gc(vm, buffer);
+    assert(AS_STRING(both)->chars == NULL);
+    assert(hash_value(both) == hash_value(expected));
+    assert(values_equal(both, expected));
+    printf("  ✓ Nested ropes flatten in order\n");
+    
+    ember_value args[2];
+    args[0] = concatenate_strings(vm, html, piece);
+    args[1] = ember_make_number(1);
+    ember_flatten_string_args(2, args);
+    assert(AS_STRING(args[0])->chars != NULL);
+    printf("  ✓ Native argument flattening passed\n");
+    
+    printf("Rope tests completed successfully!\n\n");
+}
+
+// Test the presized N-way join behind OP_CONCAT_N
+static void test_concatenate_values(ember_vm* vm) {
+    printf("Testing N-way concatenation...\n");
+    
+    ember_value parts[5];
+    parts[0] = ember_make_string_gc(vm, "id=");
+    parts[1] = ember_make_number(42);
+    parts[2] = ember_make_string_gc(vm, ", ok=");
+    parts[3] = ember_make_bool(1);
+    parts[4] = ember_make_nil();
+    ember_value joined = concatenate_values(vm, 5, parts);
+    assert(joined.type == EMBER_VAL_STRING);
+    assert(strcmp(AS_CSTRING(joined), "id=42, ok=truenil") == 0);
+    printf("  ✓ Mixed parts are stringified in order\n");
+    
+    ember_value empty = concatenate_values(vm, 0, NULL);
+    assert(empty.type == EMBER_VAL_STRING && AS_STRING(empty)->length == 0);
+    
+    ember_value long_parts[3];
+    long_parts[0] = concatenate_strings(vm, ember_make_string_gc(vm, "0123456789012345678901234567890123456789"),
+                                        ember_make_string_gc(vm, "0123456789012345678901234567890123456789"));
+    long_parts[1] = ember_make_number(-1.5);
+    long_parts[2] = long_parts[0];
+    ember_value long_joined = concatenate_values(vm, 3, long_parts);
+    assert(AS_STRING(long_joined)->length == 80 + 4 + 80);
+    assert(!AS_STRING(long_joined)->is_inline);
+    assert(strncmp(AS_CSTRING(long_joined) + 80, "-1.5", 4) == 0);
+    printf("  ✓ Long joins and rope parts passed\n");
+    
+    printf("N-way concatenation tests completed successfully!\n\n");
+}
+
+static ember_value native_double(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    return ember_make_number(argc == 1 ? argv[0].as.number_val * 2 : -1);
+}
+
+// Test function values and the compact NaN-boxed encoding
+static void test_compact_values(ember_vm* vm) {
+    printf("Testing compact value representation...\n");
+    
+    ember_value native = ember_make_function_value(NULL, "native_fn", native_double);
+    assert(native.type == EMBER_VAL_NATIVE);
+    assert(native.as.native_val == native_double);
+    
+    // Callable through the embedding API like any registered native
+    assert(ember_global_define(vm, "native_fn", native) >= 0);
+    ember_value argument = ember_make_number(21);
+    int base = vm->stack_top;
+    assert(ember_call(vm, "native_fn", 1, &argument) == 0);
+    assert(vm->stack_top == base + 1);
+    ember_value doubled = vm->stack[--vm->stack_top];
+    assert(doubled.type == EMBER_VAL_NUMBER && doubled.as.number_val == 42);
+    
+    ember_value function = ember_make_function_value(NULL, "script_fn", NULL);
+    assert(function.type == EMBER_VAL_FUNCTION);
+    assert(function.as.func_val.chunk == NULL && strcmp(function.as.func_val.name, "script_fn") == 0);
+    free(function.as.func_val.name);
+    printf("  ✓ Function value test passed\n");
+    
+#ifdef EMBER_NAN_BOXING
+    assert(sizeof(ember_packed_value) == 8);
+    
+    // Immediates round-trip without allocation
+    ember_packed_value packed;
+    assert(ember_value_to_packed(ember_make_number(-42.25), &packed));
+    assert(EMBER_PACKED_IS_NUMBER(packed));
+    assert(EMBER_PACKED_AS_NUMBER(packed) == -42.25);
+    assert(ember_value_to_packed(ember_make_nil(), &packed) && EMBER_PACKED_IS_NIL(packed));
+    assert(EMBER_PACKED_IS_BOOL(EMBER_PACKED_TRUE) && EMBER_PACKED_AS_BOOL(EMBER_PACKED_TRUE));
+    assert(EMBER_PACKED_IS_BOOL(EMBER_PACKED_FALSE) && !EMBER_PACKED_AS_BOOL(EMBER_PACKED_FALSE));
+    assert(!EMBER_PACKED_IS_NUMBER(EMBER_PACKED_NIL));
+    
+    // NaN stays a number instead of aliasing a tagged value
+    assert(ember_value_to_packed(ember_make_number(0.0 / 0.0), &packed));
+    assert(EMBER_PACKED_IS_NUMBER(packed));
+    ember_value nan_val = ember_value_from_packed(packed);
+    assert(nan_val.type == EMBER_VAL_NUMBER && nan_val.as.number_val != nan_val.as.number_val);
+    
+    // Heap objects keep their identity
+    ember_value str = ember_make_string_gc(vm, "packed");
+    assert(ember_value_to_packed(str, &packed));
+    assert(EMBER_PACKED_IS_OBJ(packed));
+    assert(EMBER_PACKED_AS_OBJ(packed) == str.as.obj_val);
+    ember_value unpacked = ember_value_from_packed(packed);
+    assert(unpacked.type == EMBER_VAL_STRING);
+    assert(values_equal(unpacked, str));
+    
+    // Script and native functions have no packed form, and packing them
+    // allocates nothing
+    ember_object* newest = vm->objects;
+    ember_value func;
+    func.type = EMBER_VAL_FUNCTION;
+    func.as.func_val.chunk = NULL;
+    func.as.func_val.name = "handler";
+    assert(!ember_value_to_packed(func, &packed));
+    assert(!ember_value_to_packed(native, &packed));
+    assert(vm->objects == newest);
+    
+    // Boxed by the caller, they come back as the values they box
+    ember_function* boxed = allocate_function(vm, NULL, "handler", NULL);
+    assert(boxed != NULL);
+    unpacked = ember_value_from_packed(EMBER_PACKED_OBJ(boxed));
+    assert(unpacked.type == EMBER_VAL_FUNCTION);
+    assert(strcmp(unpacked.as.func_val.name, "handler") == 0);
+    
+    boxed = allocate_function(vm, NULL, NULL, ember_native_print);
+    assert(boxed != NULL);
+    unpacked = ember_value_from_packed(EMBER_PACKED_OBJ(boxed));
+    assert(unpacked.type == EMBER_VAL_NATIVE);
+    assert(unpacked.as.native_val == ember_native_print);
+    printf("  ✓ NaN-boxed encoding round-trip test passed\n");
+#endif
+    
+    printf("Compact value representation tests completed successfully!\n\n");
+}
+
 int main(int argc, char* argv[]) {
     (void)argc;
     (void)argv;
@@ -1414,12 +1831,20 @@ int main(int argc, char* argv[]) {
     test_value_manipulation(vm);
     test_array_operations(vm);
     test_hash_map_operations(vm);
+    test_hash_map_probing(vm);
+    test_set_algebra(vm);
     test_string_operations(vm);
     test_hash_value_computation(vm);
+    test_string_hash_words();
     test_exception_handling(vm);
     test_edge_cases(vm);
     test_memory_management(vm);
     test_performance_characteristics(vm);
+    test_compact_values(vm);
+    test_string_interning(vm);
+    test_small_strings(vm);
+    test_string_ropes(vm);
+    test_concatenate_values(vm);
     
     // Cleanup
     ember_free_vm(vm);
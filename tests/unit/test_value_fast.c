@@ -0,0 +1,122 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static ember_value string_value(ember_string* string) {
+    ember_value value;
+    value.type = EMBER_VAL_STRING;
+    value.as.obj_val = (ember_object*)string;
+    return value;
+}
+
+// The fast paths must answer exactly as hash_value and values_equal do
+static void assert_agree(ember_value a, ember_value b) {
+    assert(values_equal_fast(a, b) == values_equal(a, b));
+    assert(values_equal_fast(b, a) == values_equal(b, a));
+    if (values_equal(a, b)) {
+        assert(hash_value_fast(a) == hash_value_fast(b));
+    }
+    assert(hash_value_fast(a) == hash_value(a));
+}
+
+void test_primitives(void) {
+    const double numbers[] = {0.0, -0.0, 1.0, -1.5, 1e300, INFINITY, NAN};
+    for (int i = 0; i < 7; i++) {
+        for (int j = 0; j < 7; j++) {
+            assert_agree(ember_make_number(numbers[i]), ember_make_number(numbers[j]));
+        }
+    }
+    assert(hash_value_fast(ember_make_number(-0.0)) == hash_value_fast(ember_make_number(0.0)));
+    // A small int agrees with the same value as a plain double
+    ember_value plain = {EMBER_VAL_NUMBER, {.number_val = 12.0}};
+    assert(IS_SMALL_INT(ember_make_int(12)) && !IS_SMALL_INT(plain));
+    assert_agree(ember_make_int(12), plain);
+    assert_agree(ember_make_int(0), ember_make_number(-0.0));
+    assert_agree(ember_make_int(-5), ember_make_number(-5.5));
+    assert(!values_equal_fast(ember_make_number(NAN), ember_make_number(NAN)));
+    assert_agree(ember_make_nil(), ember_make_nil());
+    assert_agree(ember_make_bool(1), ember_make_bool(0));
+    assert_agree(ember_make_bool(1), ember_make_number(1));
+    assert_agree(ember_make_nil(), ember_make_bool(0));
+    printf("  ✓ Numbers, nil and booleans\n");
+}
+
+void test_strings(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+
+    // Flat, interned, rope and slice strings with the same bytes
+    char text[EMBER_ROPE_MIN_LENGTH * 2 + 1];
+    memset(text, 'x', sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+    ember_value flat = keep(vm, ember_make_string_gc(vm, text));
+    ember_value interned = keep(vm, string_value(intern_string(vm, text, (int)strlen(text))));
+    ember_value half = keep(vm, ember_make_string_gc(vm, text + EMBER_ROPE_MIN_LENGTH));
+    ember_value rope = keep(vm, concatenate_strings(vm, half, half));
+    ember_value parent = keep(vm, concatenate_strings(vm, flat, half));
+    ember_value slice = keep(vm, string_value(ember_string_slice(vm, AS_STRING(parent), 0, (int)strlen(text))));
+    ember_value other = keep(vm, ember_make_string_gc(vm, "y"));
+    const ember_value strings[] = {flat, interned, rope, slice, half, other};
+    for (int i = 0; i < 6; i++) {
+        for (int j = 0; j < 6; j++) {
+            assert_agree(strings[i], strings[j]);
+        }
+    }
+    assert(values_equal_fast(rope, slice) && values_equal_fast(flat, interned));
+
+    // Same length and different bytes: cached hashes settle it
+    text[0] = 'y';
+    ember_value near = keep(vm, ember_make_string_gc(vm, text));
+    assert(AS_STRING(near)->hash && AS_STRING(near)->hash != AS_STRING(flat)->hash);
+    assert(!values_equal_fast(near, flat) && !values_equal(near, flat));
+
+    // Every kind of string finds the same map entry
+    ember_value map = keep(vm, ember_make_map(vm));
+    map_set(AS_MAP(map), rope, ember_make_number(1));
+    assert(map_get(AS_MAP(map), slice).as.number_val == 1);
+    assert(map_get(AS_MAP(map), interned).as.number_val == 1);
+    assert(map_has(AS_MAP(map), flat) && !map_has(AS_MAP(map), near));
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("  ✓ Flat, interned, rope and slice strings\n");
+}
+
+void test_objects(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+
+    // Arrays still compare structurally; identity-compared objects by pointer
+    ember_value a = keep(vm, ember_make_array(vm, 2));
+    ember_value b = keep(vm, ember_make_array(vm, 2));
+    array_push_with_vm(vm, AS_ARRAY(a), ember_make_number(1));
+    array_push_with_vm(vm, AS_ARRAY(b), ember_make_number(1));
+    assert_agree(a, b);
+    assert(values_equal_fast(a, b));
+    ember_value first = keep(vm, ember_make_string_builder(vm, 8));
+    ember_value second = keep(vm, ember_make_string_builder(vm, 8));
+    assert_agree(first, first);
+    assert_agree(first, second);
+    assert(!values_equal_fast(first, second));
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("  ✓ Arrays and identity-compared objects\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running value fast path tests...\n");
+    test_primitives();
+    test_strings();
+    test_objects();
+    printf("All value fast path tests passed!\n");
+    return 0;
+}
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include "ember.h"
 #include <stdio.h>
 #include <assert.h>
@@ -5,6 +6,7 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 #include "../unit/test_ember_internal.h"
 
 // Test VFS security functions to improve coverage of critical path validation
@@ -179,6 +181,126 @@ void test_vfs_unmount_functionality(void) {
     ember_free_vm(vm);
 }
 
+void test_vfs_resolve_cache(void) {
+    ember_vm* vm = ember_new_vm();
+
+    UNUSED(vm);
+    assert(vm != NULL);
+    
+    printf("Testing VFS resolution cache...\n");
+    
+    char outer[] = "/tmp/ember_vfs_outer_XXXXXX";
+    char inner[] = "/tmp/ember_vfs_inner_XXXXXX";
+    assert(mkdtemp(outer) && mkdtemp(inner));
+    char path[256];
+    snprintf(path, sizeof(path), "%s/file.txt", outer);
+    FILE* file = fopen(path, "w");
+    assert(file);
+    fclose(file);
+    snprintf(path, sizeof(path), "%s/file.txt", inner);
+    file = fopen(path, "w");
+    assert(file);
+    fclose(file);
+    
+    // Resolved twice, the second time from the cache
+    assert(ember_vfs_mount(vm, "/data", outer, EMBER_MOUNT_RW) == 0);
+    for (int i = 0; i < 2; i++) {
+        char* resolved = ember_vfs_resolve(vm, "/data/file.txt");
+        assert(resolved && strncmp(resolved, outer, strlen(outer)) == 0);
+        free(resolved);
+    }
+    
+    // A nested mount wins for the paths below it, for resolution and access
+    assert(ember_vfs_mount(vm, "/data/nested", inner, EMBER_MOUNT_RO) == 0);
+    char* resolved = ember_vfs_resolve(vm, "/data/nested/file.txt");
+    assert(resolved && strncmp(resolved, inner, strlen(inner)) == 0);
+    free(resolved);
+    assert(ember_vfs_check_access(vm, "/data/nested/file.txt", 0) == 1);
+    assert(ember_vfs_check_access(vm, "/data/nested/file.txt", 1) == 0);
+    assert(ember_vfs_check_access(vm, "/data/file.txt", 1) == 1);
+    assert(ember_vfs_check_access(vm, "/data2/file.txt", 0) == 0);
+    
+    // Remounting and unmounting drop what was cached
+    assert(ember_vfs_mount(vm, "/data", inner, EMBER_MOUNT_RW) == 0);
+    resolved = ember_vfs_resolve(vm, "/data/file.txt");
+    assert(resolved && strncmp(resolved, inner, strlen(inner)) == 0);
+    free(resolved);
+    assert(ember_vfs_unmount(vm, "/data") == 0);
+    assert(ember_vfs_resolve(vm, "/data/file.txt") == NULL);
+    resolved = ember_vfs_resolve(vm, "/data/nested/file.txt");
+    assert(resolved != NULL);
+    free(resolved);
+    
+    // A root mount catches everything else
+    assert(ember_vfs_mount(vm, "/", outer, EMBER_MOUNT_RO) == 0);
+    resolved = ember_vfs_resolve(vm, "/file.txt");
+    assert(resolved && strncmp(resolved, outer, strlen(outer)) == 0);
+    free(resolved);
+    
+    snprintf(path, sizeof(path), "rm -rf %s %s", outer, inner);
+    assert(system(path) == 0);
+    printf("VFS resolution cache test passed\n");
+    ember_free_vm(vm);
+}
+
+void test_vfs_open(void) {
+    ember_vm* vm = ember_new_vm();
+
+    UNUSED(vm);
+    assert(vm != NULL);
+    
+    printf("Testing VFS open...\n");
+    
+    char root[] = "/tmp/ember_vfs_open_XXXXXX";
+    assert(mkdtemp(root));
+    char path[256], target[256];
+    snprintf(path, sizeof(path), "%s/sub", root);
+    assert(mkdir(path, 0755) == 0);
+    assert(ember_vfs_mount(vm, "/box", root, EMBER_MOUNT_RW) == 0);
+    assert(ember_vfs_mount(vm, "/box/sub", path, EMBER_MOUNT_RO) == 0);
+    
+    // Created, written and read back below the mount
+    int fd = ember_vfs_open(vm, "/box/note.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    assert(write(fd, "hello", 5) == 5);
+    close(fd);
+    char buffer[8] = {0};
+    fd = ember_vfs_open(vm, "/box/note.txt", O_RDONLY, 0);
+    assert(fd >= 0 && read(fd, buffer, sizeof(buffer)) == 5 && strcmp(buffer, "hello") == 0);
+    close(fd);
+    fd = ember_vfs_open(vm, "/box", O_RDONLY | O_DIRECTORY, 0);
+    assert(fd >= 0);
+    close(fd);
+    
+    // Writes refused on the nested read-only mount, reads allowed
+    assert(ember_vfs_open(vm, "/box/sub/new.txt", O_WRONLY | O_CREAT, 0644) < 0);
+    snprintf(target, sizeof(target), "%s/sub/old.txt", root);
+    FILE* file = fopen(target, "w");
+    assert(file);
+    fclose(file);
+    assert(ember_vfs_open(vm, "/box/sub/old.txt", O_RDWR, 0) < 0);
+    fd = ember_vfs_open(vm, "/box/sub/old.txt", O_RDONLY, 0);
+    assert(fd >= 0);
+    close(fd);
+    
+    // Neither a symlink nor a dotted path leaves the mount
+    snprintf(path, sizeof(path), "%s/escape", root);
+    assert(symlink("/etc/passwd", path) == 0);
+    assert(ember_vfs_open(vm, "/box/escape", O_RDONLY, 0) < 0);
+    assert(ember_vfs_open(vm, "/box/../etc/passwd", O_RDONLY, 0) < 0);
+    assert(ember_vfs_open(vm, "/elsewhere/file", O_RDONLY, 0) < 0);
+    assert(ember_vfs_open(vm, "relative", O_RDONLY, 0) < 0);
+    
+    // The mount's directory is closed when it goes
+    assert(ember_vfs_unmount(vm, "/box") == 0);
+    assert(ember_vfs_open(vm, "/box/note.txt", O_RDONLY, 0) < 0);
+    
+    snprintf(path, sizeof(path), "rm -rf %s", root);
+    assert(system(path) == 0);
+    printf("VFS open test passed\n");
+    ember_free_vm(vm);
+}
+
 int main(int argc, char* argv[]) {
     (void)argc;
     (void)argv;
@@ -190,6 +312,8 @@ int main(int argc, char* argv[]) {
     test_vfs_mount_limits();
     test_vfs_path_sanitization();
     test_vfs_unmount_functionality();
+    test_vfs_resolve_cache();
+    test_vfs_open();
     
     printf("All VFS security tests passed!\n");
     return 0;
@@ -3,7 +3,9 @@
 #include <assert.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include "test_ember_internal.h"
+#include "../../src/core/vm_dispatch.h"
 
 // Macro to mark variables as intentionally unused
 #define UNUSED(x) ((void)(x))
@@ -41,6 +43,586 @@ void test_stack_operations(void) {
     ember_free_vm(vm);
 }
 
+void test_global_table(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    int base_count = vm->global_count;
+    
+    // Well past the old fixed 256-entry array
+    char name[32];
+    for (int i = 0; i < 2000; i++) {
+        snprintf(name, sizeof(name), "global_%d", i);
+        assert(ember_global_define(vm, name, ember_make_number(i)) == base_count + i);
+    }
+    assert(vm->global_count == base_count + 2000);
+    
+    for (int i = 0; i < 2000; i += 97) {
+        snprintf(name, sizeof(name), "global_%d", i);
+        int slot = ember_global_find(vm, name, (int)strlen(name));
+        assert(slot == base_count + i);
+        assert(vm->globals[slot].value.as.number_val == i);
+    }
+    
+    // Redefinition keeps the slot
+    int slot = ember_global_find(vm, "global_5", 8);
+    assert(ember_global_define(vm, "global_5", ember_make_number(-1)) == slot);
+    assert(vm->globals[slot].value.as.number_val == -1);
+    assert(vm->global_count == base_count + 2000);
+    
+    // Lookups are by exact length, not prefix
+    assert(ember_global_find(vm, "global_123", 8) == ember_global_find(vm, "global_1", 8));
+    assert(ember_global_find(vm, "global_5x", 9) == -1);
+    
+    ember_free_vm(vm);
+    printf("Global table test passed\n");
+}
+
+void test_global_inline_cache(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    
+    ember_value constants[2];
+    constants[0] = ember_make_string_gc(vm, "counter");
+    constants[1] = ember_make_string_gc(vm, "missing");
+    ember_chunk chunk;
+    memset(&chunk, 0, sizeof(chunk));
+    chunk.constants = constants;
+    chunk.const_count = 2;
+    chunk.const_capacity = 2;
+    
+    // First assignment defines the global and fills the site's cache
+    vm->stack[vm->stack_top++] = ember_make_number(1);
+    assert(vm_handle_set_global(vm, &chunk, 0) == VM_RESULT_OK);
+    assert(vm->stack[vm->stack_top - 1].as.number_val == 1);
+    vm->stack_top--;
+    int slot = ember_global_find(vm, "counter", 7);
+    assert(slot >= 0);
+    assert(chunk.global_cache[0].epoch == vm->globals_epoch);
+    assert(chunk.global_cache[0].slot == slot);
+    
+    // Redefinition and table growth leave the cached slot valid
+    ember_global_define(vm, "counter", ember_make_number(7));
+    char name[32];
+    for (int i = 0; i < 300; i++) {
+        snprintf(name, sizeof(name), "filler_%d", i);
+        ember_global_define(vm, name, ember_make_number(i));
+    }
+    assert(vm_handle_get_global(vm, &chunk, 0) == VM_RESULT_OK);
+    assert(vm->stack[--vm->stack_top].as.number_val == 7);
+    
+    // Misses are reported and never cached
+    assert(vm_handle_get_global(vm, &chunk, 1) == VM_RESULT_ERROR);
+    assert(chunk.global_cache[1].epoch == 0);
+    ember_vm_clear_error(vm);
+    
+    // A different VM's table invalidates the cache by epoch
+    ember_vm* other = ember_new_vm();
+    assert(other != NULL);
+    assert(other->globals_epoch != vm->globals_epoch || other->globals_epoch == 0);
+    ember_global_define(other, "unrelated", ember_make_number(0));
+    ember_global_define(other, "counter", ember_make_number(99));
+    assert(vm_handle_get_global(other, &chunk, 0) == VM_RESULT_OK);
+    assert(other->stack[--other->stack_top].as.number_val == 99);
+    assert(chunk.global_cache[0].epoch == other->globals_epoch);
+    
+    ember_chunk_free_global_cache(&chunk);
+    ember_free_vm(other);
+    ember_free_vm(vm);
+    printf("Global inline cache test passed\n");
+}
+
+void test_superinstructions(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    
+    ember_value constants[1];
+    constants[0] = ember_make_number(2);
+    ember_chunk chunk;
+    memset(&chunk, 0, sizeof(chunk));
+    chunk.constants = constants;
+    chunk.const_count = 1;
+    chunk.const_capacity = 1;
+    
+    // Slots are relative to the running frame
+    vm->local_base = 4;
+    vm->locals[5] = ember_make_number(7);
+    assert(vm_handle_arith_local_const(vm, &chunk, OP_ADD_LOCAL_CONST, 1, 0) == VM_RESULT_OK);
+    assert(vm->locals[5].as.number_val == 9);
+    assert(vm_handle_arith_local_const(vm, &chunk, OP_SUB_LOCAL_CONST, 1, 0) == VM_RESULT_OK);
+    assert(vm->locals[5].as.number_val == 7);
+    
+    int result = -1;
+    assert(vm_handle_compare_local_const(vm, &chunk, OP_LOCAL_LESS_CONST_JUMP_IF_FALSE, 1, 0, &result) == VM_RESULT_OK);
+    assert(result == 0);
+    assert(vm_handle_compare_local_const(vm, &chunk, OP_LOCAL_GREATER_EQUAL_CONST_JUMP_IF_FALSE, 1, 0, &result) == VM_RESULT_OK);
+    assert(result == 1);
+    
+    // Non-numbers are left for the unfused opcodes, untouched
+    vm->locals[5] = ember_make_bool(1);
+    assert(vm_handle_arith_local_const(vm, &chunk, OP_ADD_LOCAL_CONST, 1, 0) == VM_RESULT_CONTINUE);
+    assert(vm->locals[5].type == EMBER_VAL_BOOL);
+    assert(vm_handle_compare_local_const(vm, &chunk, OP_LOCAL_LESS_CONST_JUMP_IF_FALSE, 1, 0, &result) == VM_RESULT_CONTINUE);
+    
+    // Bad operands are runtime errors
+    assert(vm_handle_arith_local_const(vm, &chunk, OP_ADD_LOCAL_CONST, 1, 5) == VM_RESULT_ERROR);
+    ember_vm_clear_error(vm);
+    assert(vm_handle_arith_local_const(vm, &chunk, OP_ADD_LOCAL_CONST, EMBER_LOCALS_MAX, 0) == VM_RESULT_ERROR);
+    ember_vm_clear_error(vm);
+    
+    ember_free_vm(vm);
+    printf("Superinstruction handler test passed\n");
+}
+
+// Small loop over the superinstructions written with the dispatch macros;
+// returns the number of instructions dispatched, or -1 on an unknown opcode
+static int run_dispatch_loop(ember_vm* vm, ember_chunk* chunk) {
+    const uint8_t* ip = chunk->code;
+    int dispatched = 0;
+    
+    VM_DISPATCH_TABLE_BEGIN
+        VM_DISPATCH_ENTRY(OP_ADD_LOCAL_CONST)
+        VM_DISPATCH_ENTRY(OP_LOCAL_LESS_CONST_JUMP_IF_FALSE)
+        VM_DISPATCH_ENTRY(OP_LOOP)
+        VM_DISPATCH_ENTRY(OP_HALT)
+    VM_DISPATCH_TABLE_END
+    
+    VM_DISPATCH_LOOP_BEGIN(ip)
+        VM_CASE(OP_ADD_LOCAL_CONST): {
+            dispatched++;
+            int slot = (ip[0] << 8) | ip[1];
+            int constant = (ip[2] << 8) | ip[3];
+            ip += 4;
+            if (vm_dispatch_arith_local_const(vm, chunk, OP_ADD_LOCAL_CONST, slot, constant) != VM_RESULT_OK) return -1;
+            VM_NEXT(ip);
+        }
+        VM_CASE(OP_LOCAL_LESS_CONST_JUMP_IF_FALSE): {
+            dispatched++;
+            int slot = (ip[0] << 8) | ip[1];
+            int constant = (ip[2] << 8) | ip[3];
+            int offset = (ip[4] << 8) | ip[5];
+            int result = 0;
+            ip += 6;
+            if (vm_dispatch_compare_local_const(vm, chunk, OP_LOCAL_LESS_CONST_JUMP_IF_FALSE, slot, constant, &result) != VM_RESULT_OK) return -1;
+            if (!result) ip += offset;
+            VM_NEXT(ip);
+        }
+        VM_CASE(OP_LOOP): {
+            dispatched++;
+            int offset = *ip++;
+            ip = ip + 1 - offset;
+            VM_NEXT(ip);
+        }
+        VM_CASE(OP_HALT):
+            return dispatched + 1;
+        VM_DEFAULT:
+            return -1;
+    VM_DISPATCH_LOOP_END
+}
+
+void test_dispatch(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    
+    ember_value constants[2];
+    constants[0] = ember_make_number(10);
+    constants[1] = ember_make_number(1);
+    // while (i < 10) i = i + 1, as the optimizer fuses it
+    uint8_t code[] = {
+        OP_LOCAL_LESS_CONST_JUMP_IF_FALSE, 0, 0, 0, 0, 0, 7,
+        OP_ADD_LOCAL_CONST, 0, 0, 0, 1,
+        OP_LOOP, 15,
+        OP_HALT
+    };
+    ember_chunk chunk;
+    memset(&chunk, 0, sizeof(chunk));
+    chunk.code = code;
+    chunk.count = sizeof(code);
+    chunk.capacity = sizeof(code);
+    chunk.constants = constants;
+    chunk.const_count = 2;
+    chunk.const_capacity = 2;
+    
+    vm->local_base = 0;
+    vm->locals[0] = ember_make_number(0);
+    assert(run_dispatch_loop(vm, &chunk) == 10 * 3 + 2);
+    assert(vm->locals[0].as.number_val == 10);
+    
+    // Opcodes missing from the table reach the default handler
+    code[0] = OP_POP;
+    assert(run_dispatch_loop(vm, &chunk) == -1);
+    
+    // The inline global access takes the cached slot after the first miss
+    ember_global_define(vm, "total", ember_make_number(3));
+    constants[0] = ember_make_string_gc(vm, "total");
+    chunk.const_count = 1;
+    assert(vm_dispatch_get_global(vm, &chunk, 0) == VM_RESULT_OK);
+    assert(chunk.global_cache[0].epoch == vm->globals_epoch);
+    vm->stack[vm->stack_top - 1] = ember_make_number(4);
+    assert(vm_dispatch_set_global(vm, &chunk, 0) == VM_RESULT_OK);
+    vm->stack_top--;
+    assert(vm_dispatch_get_global(vm, &chunk, 0) == VM_RESULT_OK);
+    assert(vm->stack[--vm->stack_top].as.number_val == 4);
+    
+    ember_chunk_free_global_cache(&chunk);
+    ember_free_vm(vm);
+    printf("Dispatch test passed (%s)\n", EMBER_THREADED_DISPATCH ? "threaded" : "switch");
+}
+
+static ember_value native_double(ember_vm* vm, int argc, ember_value* argv) {
+    (void)vm;
+    return argc == 1 ? ember_make_number(argv[0].as.number_val * 2) : ember_make_nil();
+}
+
+void test_call_frames(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    
+    uint8_t caller_code[] = {OP_HALT};
+    uint8_t callee_code[] = {OP_RETURN};
+    ember_chunk caller;
+    ember_chunk callee;
+    memset(&caller, 0, sizeof(caller));
+    memset(&callee, 0, sizeof(callee));
+    caller.code = caller_code;
+    caller.count = 1;
+    callee.code = callee_code;
+    callee.count = 1;
+    ember_value function;
+    function.type = EMBER_VAL_FUNCTION;
+    function.as.func_val.chunk = &callee;
+    function.as.func_val.name = "f";
+    
+    vm->chunk = &caller;
+    vm->ip = caller_code;
+    vm->locals[0] = ember_make_number(-1);
+    vm->local_count = 1;
+    
+    // Arguments move into the new frame's slots 0..argc-1
+    vm->stack[vm->stack_top++] = ember_make_number(7);
+    vm->stack[vm->stack_top++] = ember_make_number(8);
+    vm->stack[vm->stack_top++] = function;
+    assert(vm_handle_call(vm, 2) == VM_RESULT_OK);
+    assert(vm->frame_count == 1);
+    assert(vm->chunk == &callee && vm->ip == callee_code);
+    assert(vm->local_base == 1 && vm->local_count == 3);
+    assert(vm->locals[vm->local_base + 1].as.number_val == 8);
+    assert(vm->stack_top == 0);
+    
+    // Tail calls rebind the same frame
+    vm->stack[vm->stack_top++] = ember_make_number(1);
+    vm->stack[vm->stack_top++] = ember_make_number(9);
+    vm->stack[vm->stack_top++] = function;
+    assert(vm_handle_tail_call(vm, 1) == VM_RESULT_OK);
+    assert(vm->frame_count == 1);
+    assert(vm->local_base == 1 && vm->local_count == 2);
+    assert(vm->locals[1].as.number_val == 9);
+    assert(vm->stack_top == 0);
+    
+    // Returning restores the caller with the result in place of the call
+    vm->stack[vm->stack_top++] = ember_make_number(42);
+    assert(vm_handle_return(vm) == VM_RESULT_OK);
+    assert(vm->frame_count == 0);
+    assert(vm->chunk == &caller && vm->ip == caller_code);
+    assert(vm->local_base == 0 && vm->local_count == 1);
+    assert(vm->stack_top == 1 && vm->stack[0].as.number_val == 42);
+    vm->stack_top = 0;
+    
+    // Deep recursion only costs frames, not C stack
+    for (int depth = 0; depth < 500; depth++) {
+        vm->stack[vm->stack_top++] = ember_make_number(depth);
+        vm->stack[vm->stack_top++] = function;
+        assert(vm_handle_call(vm, 1) == VM_RESULT_OK);
+    }
+    assert(vm->frame_count == 500);
+    assert(vm->locals[vm->local_base].as.number_val == 499);
+    while (vm->frame_count > 0) {
+        assert(vm_handle_return(vm) == VM_RESULT_OK);
+    }
+    assert(vm->stack_top == 1 && vm->stack[0].type == EMBER_VAL_NIL);
+    assert(vm->local_count == 1);
+    vm->stack_top = 0;
+    
+    // Natives run in place, also from a tail call
+    ember_value native;
+    native.type = EMBER_VAL_NATIVE;
+    native.as.native_val = native_double;
+    vm->stack[vm->stack_top++] = ember_make_number(21);
+    vm->stack[vm->stack_top++] = native;
+    assert(vm_handle_tail_call(vm, 1) == VM_RESULT_OK);
+    assert(vm->frame_count == 0);
+    assert(vm->stack_top == 1 && vm->stack[0].as.number_val == 42);
+    vm->stack_top = 0;
+    
+    // Entry frames hand control back to C; unwinding drops stranded frames
+    ember_value argv[1] = {ember_make_number(3)};
+    int depth = vm_push_entry_frame(vm, &callee, 1, argv);
+    assert(depth == 0 && vm->frame_count == 1);
+    vm->stack[vm->stack_top++] = ember_make_number(5);
+    assert(vm_handle_return(vm) == VM_RESULT_CONTINUE);
+    assert(vm->stack_top == 1 && vm->stack[0].as.number_val == 5);
+    vm->stack_top = 0;
+    depth = vm_push_entry_frame(vm, &callee, 1, argv);
+    vm->stack[vm->stack_top++] = function;
+    assert(vm_handle_call(vm, 0) == VM_RESULT_OK);
+    assert(vm->frame_count == 2);
+    vm_unwind_frames(vm, depth);
+    assert(vm->frame_count == 0 && vm->chunk == &caller && vm->local_count == 1);
+    
+    // Non-callables are runtime errors
+    vm->stack[vm->stack_top++] = ember_make_number(1);
+    assert(vm_handle_call(vm, 0) == VM_RESULT_ERROR);
+    ember_vm_clear_error(vm);
+    
+    ember_free_vm(vm);
+    printf("Call frame test passed\n");
+}
+
+static int count_objects(ember_vm* vm, ember_object_type type) {
+    int count = 0;
+    for (ember_object* object = vm->objects; object; object = object->next) {
+        if (object->type == type) count++;
+    }
+    return count;
+}
+
+void test_invoke_fast_path(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    
+    uint8_t caller_code[] = {OP_HALT};
+    uint8_t method_code[] = {OP_RETURN};
+    ember_chunk caller;
+    ember_chunk method_chunk;
+    memset(&caller, 0, sizeof(caller));
+    memset(&method_chunk, 0, sizeof(method_chunk));
+    caller.code = caller_code;
+    caller.count = 1;
+    method_chunk.code = method_code;
+    method_chunk.count = 1;
+    ember_value method;
+    method.type = EMBER_VAL_FUNCTION;
+    method.as.func_val.chunk = &method_chunk;
+    method.as.func_val.name = "move";
+    
+    // The method is inherited from the base class
+    ember_value base = ember_make_class(vm, "Base");
+    ember_value derived = ember_make_class(vm, "Derived");
+    ember_value name = ember_make_string_gc(vm, "move");
+    assert(ember_class_define_method(vm, AS_CLASS(base), name, method));
+    assert(ember_class_inherit(vm, AS_CLASS(derived), AS_CLASS(base)));
+    ember_value instance = ember_make_instance(vm, AS_CLASS(derived));
+    vm->chunk = &caller;
+    vm->ip = caller_code;
+    int bound_before = count_objects(vm, OBJ_METHOD);
+    
+    // Receiver in slot 0, arguments after it, no bound method allocated
+    vm->stack[vm->stack_top++] = instance;
+    vm->stack[vm->stack_top++] = ember_make_number(3);
+    vm->stack[vm->stack_top++] = ember_make_number(4);
+    vm->stack[vm->stack_top++] = name;
+    assert(vm_handle_invoke(vm, 2) == VM_RESULT_OK);
+    assert(vm->frame_count == 1);
+    assert(vm->chunk == &method_chunk && vm->ip == method_code);
+    assert(vm->local_count - vm->local_base == 3);
+    assert(vm->locals[vm->local_base].as.obj_val == instance.as.obj_val);
+    assert(vm->locals[vm->local_base + 2].as.number_val == 4);
+    assert(vm->stack_top == 0);
+    assert(count_objects(vm, OBJ_METHOD) == bound_before);
+    
+    vm->stack[vm->stack_top++] = ember_make_number(7);
+    assert(vm_handle_return(vm) == VM_RESULT_OK);
+    assert(vm->frame_count == 0 && vm->chunk == &caller);
+    assert(vm->stack_top == 1 && vm->stack[0].as.number_val == 7);
+    vm->stack_top = 0;
+    
+    // Fields shadow methods, and other receivers take the general path
+    vm->stack[vm->stack_top++] = instance;
+    vm->stack[vm->stack_top++] = ember_make_string_gc(vm, "missing");
+    assert(vm_handle_invoke(vm, 0) == VM_RESULT_CONTINUE);
+    assert(vm->stack_top == 2);
+    vm->stack_top = 0;
+    assert(ember_instance_set_field(vm, AS_INSTANCE(instance), name, ember_make_number(1)));
+    vm->stack[vm->stack_top++] = instance;
+    vm->stack[vm->stack_top++] = name;
+    assert(vm_handle_invoke(vm, 0) == VM_RESULT_CONTINUE);
+    vm->stack_top = 0;
+    vm->stack[vm->stack_top++] = ember_make_number(1);
+    vm->stack[vm->stack_top++] = name;
+    assert(vm_handle_invoke(vm, 0) == VM_RESULT_CONTINUE);
+    assert(vm->stack_top == 2 && vm->frame_count == 0);
+    vm->stack_top = 0;
+    
+    ember_free_vm(vm);
+    printf("Invoke fast path test passed\n");
+}
+
+void test_method_cache(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    
+    ember_value a = ember_make_class(vm, "A");
+    vm->stack[vm->stack_top++] = a;
+    ember_value b = ember_make_class(vm, "B");
+    vm->stack[vm->stack_top++] = b;
+    ember_value c = ember_make_class(vm, "C");
+    vm->stack[vm->stack_top++] = c;
+    ember_value speak = ember_make_string_gc(vm, "speak");
+    vm->stack[vm->stack_top++] = speak;
+    ember_value walk = ember_make_string_gc(vm, "walk");
+    vm->stack[vm->stack_top++] = walk;
+    assert(ember_class_inherit(vm, AS_CLASS(b), AS_CLASS(a)));
+    assert(ember_class_inherit(vm, AS_CLASS(c), AS_CLASS(b)));
+    assert(ember_class_define_method(vm, AS_CLASS(a), speak, ember_make_number(1)));
+    assert(ember_class_define_method(vm, AS_CLASS(a), walk, ember_make_number(2)));
+    assert(ember_class_define_method(vm, AS_CLASS(b), speak, ember_make_number(3)));
+    
+    // One flattened table: overrides win, inherited methods are copied down
+    ember_class* leaf = AS_CLASS(c);
+    assert(ember_class_find_method(vm, leaf, speak).as.number_val == 3);
+    assert(ember_class_find_method(vm, leaf, walk).as.number_val == 2);
+    assert(leaf->method_cache != NULL && leaf->method_cache->length == 2);
+    assert(leaf->method_cache_epoch == vm->method_epoch);
+    assert(ember_class_find_method(vm, leaf, ember_make_string_gc(vm, "fly")).type == EMBER_VAL_NIL);
+    ember_hash_map* cache = leaf->method_cache;
+    assert(ember_class_find_method(vm, leaf, walk).as.number_val == 2);
+    assert(leaf->method_cache == cache);
+    
+    // Redefining a method on an ancestor reaches every subclass
+    assert(ember_class_define_method(vm, AS_CLASS(a), walk, ember_make_number(4)));
+    assert(ember_class_find_method(vm, leaf, walk).as.number_val == 4);
+    assert(ember_class_define_method(vm, AS_CLASS(c), walk, ember_make_number(5)));
+    assert(ember_class_find_method(vm, leaf, walk).as.number_val == 5);
+    assert(ember_class_find_method(vm, AS_CLASS(b), walk).as.number_val == 4);
+    
+    // So does changing a superclass; cycles are rejected
+    assert(ember_class_inherit(vm, AS_CLASS(c), AS_CLASS(a)));
+    assert(ember_class_find_method(vm, leaf, speak).as.number_val == 1);
+    assert(!ember_class_inherit(vm, AS_CLASS(a), leaf));
+    assert(AS_CLASS(a)->superclass == NULL);
+    
+    // Flattened tables are traced with their class
+    ember_gc_collect(vm);
+    assert(ember_class_find_method(vm, leaf, walk).as.number_val == 5);
+    
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("Method cache test passed\n");
+}
+
+void test_exception_unwind(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    
+    // The call at offset 0 sits in a try block whose catch is at offset 3
+    uint8_t caller_code[] = {OP_CALL, 0, OP_HALT, OP_CATCH_BEGIN, 0xFF, OP_HALT};
+    uint8_t callee_code[] = {OP_THROW, OP_RETURN};
+    ember_chunk caller;
+    ember_chunk callee;
+    memset(&caller, 0, sizeof(caller));
+    memset(&callee, 0, sizeof(callee));
+    caller.code = caller_code;
+    caller.count = (int)sizeof(caller_code);
+    callee.code = callee_code;
+    callee.count = (int)sizeof(callee_code);
+    ember_handler_entry entry = {0, 2, 3, 1, EMBER_HANDLER_CATCH};
+    assert(ember_chunk_add_handler(&caller, &entry) == 0);
+    ember_value function;
+    function.type = EMBER_VAL_FUNCTION;
+    function.as.func_val.chunk = &callee;
+    function.as.func_val.name = "fail";
+    
+    // A throw in the callee unwinds its frame and lands in the caller's catch
+    vm->chunk = &caller;
+    vm->ip = caller_code + 2;
+    vm->stack[vm->stack_top++] = ember_make_number(1);  // Held by an enclosing statement
+    vm->stack[vm->stack_top++] = function;
+    assert(vm_handle_call(vm, 0) == VM_RESULT_OK);
+    vm->stack[vm->stack_top++] = ember_make_number(2);
+    vm->ip = callee_code + 1;
+    vm->current_exception = ember_make_number(42);
+    assert(vm_handle_throw(vm) == VM_RESULT_OK);
+    assert(vm->frame_count == 0 && vm->chunk == &caller);
+    assert(vm->ip == caller_code + 3);
+    assert(vm->stack_top == 1 && vm->stack[0].as.number_val == 1);
+    assert(!vm->exception_pending);
+    
+    // Outside every range the exception is uncaught
+    vm->ip = caller_code + 3;
+    assert(vm_handle_throw(vm) == VM_RESULT_ERROR);
+    assert(vm->exception_pending);
+    
+    // Finally entries resume with the exception still pending
+    caller.handlers[0].kind = EMBER_HANDLER_FINALLY;
+    vm->exception_pending = 0;
+    vm->ip = caller_code + 1;
+    assert(vm_handle_throw(vm) == VM_RESULT_OK);
+    assert(vm->exception_pending && vm->ip == caller_code + 3);
+    
+    // Frames entered from C stop the search
+    int depth = vm_push_entry_frame(vm, &callee, 0, NULL);
+    assert(depth == 0);
+    vm->ip = callee_code + 1;
+    assert(vm_handle_throw(vm) == VM_RESULT_ERROR);
+    assert(vm->frame_count == 1);
+    vm_unwind_frames(vm, depth);
+    assert(vm->frame_count == 0);
+    
+    ember_chunk_free_handlers(&caller);
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("Exception unwind test passed\n");
+}
+
+void test_lazy_stack_trace(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    
+    uint8_t caller_code[] = {OP_CALL, 0, OP_HALT};
+    uint8_t callee_code[] = {OP_THROW, OP_RETURN};
+    ember_chunk caller;
+    ember_chunk callee;
+    memset(&caller, 0, sizeof(caller));
+    memset(&callee, 0, sizeof(callee));
+    caller.code = caller_code;
+    caller.count = (int)sizeof(caller_code);
+    callee.code = callee_code;
+    callee.count = (int)sizeof(callee_code);
+    ember_value function;
+    function.type = EMBER_VAL_FUNCTION;
+    function.as.func_val.chunk = &callee;
+    function.as.func_val.name = "fail";
+    assert(ember_global_define(vm, "fail", function) >= 0);
+    
+    vm->chunk = &caller;
+    vm->ip = caller_code + 2;
+    vm->stack[vm->stack_top++] = function;
+    assert(vm_handle_call(vm, 0) == VM_RESULT_OK);
+    vm->ip = callee_code + 1;
+    vm->current_exception = ember_make_exception(vm, "Error", "boom");
+    assert(vm->current_exception.type == EMBER_VAL_EXCEPTION);
+    ember_exception* exc = AS_EXCEPTION(vm->current_exception);
+    vm->stack[vm->stack_top++] = vm->current_exception;
+    
+    // Throwing records where each frame was, without naming anything yet
+    assert(vm_handle_throw(vm) == VM_RESULT_ERROR);
+    assert(exc->trace_count == 2 && exc->stack_frame_count == 0);
+    assert(exc->trace[0].chunk == &callee && exc->trace[0].offset == 0);
+    assert(exc->trace[1].chunk == &caller && exc->trace[1].offset == 1);
+    
+    // Reading the trace symbolizes it, innermost frame first
+    ember_value text = ember_exception_get_stack_trace_string(vm, exc);
+    assert(text.type == EMBER_VAL_STRING);
+    const char* chars = AS_STRING(text)->chars;
+    assert(strstr(chars, "at fail") != NULL && strstr(chars, "at <script>") != NULL);
+    assert(strstr(chars, "at fail") < strstr(chars, "at <script>"));
+    assert(exc->trace == NULL && exc->stack_frame_count == 2);
+    
+    vm_unwind_frames(vm, 0);
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("Lazy stack trace test passed\n");
+}
+
 int main(int argc, char* argv[]) {
     (void)argc;
     (void)argv;
@@ -48,6 +630,15 @@ int main(int argc, char* argv[]) {
     test_vm_init();
     test_arithmetic();
     test_stack_operations();
+    test_global_table();
+    test_global_inline_cache();
+    test_superinstructions();
+    test_dispatch();
+    test_call_frames();
+    test_invoke_fast_path();
+    test_method_cache();
+    test_exception_unwind();
+    test_lazy_stack_trace();
     printf("All tests passed!\n");
     return 0;
 }
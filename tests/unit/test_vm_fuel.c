@@ -0,0 +1,137 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+static int hook_calls = 0;
+
+static void count_yield(ember_vm* vm, void* userdata) {
+    assert(userdata == &hook_calls);
+    // Code the hook runs starts on a full tank
+    assert(vm->fuel == vm->fuel_slice);
+    hook_calls++;
+}
+
+void test_no_budget(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    for (int i = 0; i < 1000; i++) {
+        assert(vm_fuel_charge(vm) == VM_RESULT_OK);
+    }
+    assert(vm->fuel > INT64_MAX - 1000);
+    assert(vm->fuel_exhausted == 0);
+    assert(ember_vm_set_fuel(vm, -1, EMBER_FUEL_TIMEOUT) == EMBER_ERROR_INVALID_PARAMETER);
+    assert(ember_vm_set_fuel(NULL, 10, EMBER_FUEL_TIMEOUT) == EMBER_ERROR_INVALID_PARAMETER);
+    ember_free_vm(vm);
+    printf("  ✓ Charging without a budget never runs out\n");
+}
+
+void test_timeout(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(ember_vm_set_fuel(vm, 3, EMBER_FUEL_TIMEOUT) == EMBER_SUCCESS);
+    for (int i = 0; i < 3; i++) {
+        assert(vm_fuel_charge(vm) == VM_RESULT_OK);
+    }
+    // No handler anywhere: the error reaches the host
+    assert(vm_osr_back_edge(vm) == VM_RESULT_ERROR);
+    assert(vm->current_exception.type == EMBER_VAL_EXCEPTION);
+    assert(AS_EXCEPTION(vm->current_exception)->exception_type == EMBER_EXCEPTION_TIMEOUT_ERROR);
+    assert(vm->fuel_exhausted == 1);
+
+    // The tank stays empty until the host refuels
+    vm->current_exception = ember_make_nil();
+    assert(vm_fuel_charge(vm) == VM_RESULT_ERROR);
+    ember_vm_refuel(vm);
+    vm->current_exception = ember_make_nil();
+    vm->exception_pending = 0;
+    assert(vm_fuel_charge(vm) == VM_RESULT_OK);
+    ember_free_vm(vm);
+    printf("  ✓ An empty tank throws a TimeoutError\n");
+}
+
+void test_yield(void) {
+    ember_vm* vm = ember_new_vm();
+    hook_calls = 0;
+    assert(ember_vm_set_fuel(vm, 2, EMBER_FUEL_YIELD) == EMBER_SUCCESS);
+    // Without a hook the slice just refills
+    for (int i = 0; i < 3; i++) {
+        assert(vm_fuel_charge(vm) == VM_RESULT_OK);
+    }
+    assert(vm->fuel_exhausted == 1 && vm->fuel == 2);
+
+    ember_vm_set_fuel_hook(vm, count_yield, &hook_calls);
+    ember_vm_refuel(vm);
+    for (int i = 0; i < 6; i++) {
+        assert((i % 2 ? vm_osr_back_edge(vm) : vm_fuel_charge(vm)) == VM_RESULT_OK);
+    }
+    assert(hook_calls == 2);
+    assert(vm->current_exception.type == EMBER_VAL_NIL);
+
+    // Removing the budget stops the hook
+    assert(ember_vm_set_fuel(vm, 0, EMBER_FUEL_YIELD) == EMBER_SUCCESS);
+    for (int i = 0; i < 100; i++) {
+        assert(vm_fuel_charge(vm) == VM_RESULT_OK);
+    }
+    assert(hook_calls == 2);
+    ember_free_vm(vm);
+    printf("  ✓ Yield mode calls the hook once per slice\n");
+}
+
+static int statuses[2];
+static int finished_order[2];
+static int finished = 0;
+
+static void record(ember_vm* vm, int status, ember_value result, void* userdata) {
+    (void)vm;
+    (void)result;
+    int task = (int)(intptr_t)userdata;
+    statuses[task] = status;
+    finished_order[__atomic_fetch_add(&finished, 1, __ATOMIC_ACQ_REL)] = task;
+}
+
+void test_executor_timeout(void) {
+    finished = 0;
+    ember_executor* executor = ember_executor_create(1, NULL);
+    assert(executor != NULL);
+    assert(ember_executor_set_fuel(executor, 10000, EMBER_FUEL_TIMEOUT) == EMBER_SUCCESS);
+    assert(ember_executor_submit_script(executor, "while (true) { }\n", record, (void*)0) == 0);
+    assert(ember_executor_submit_script(executor, "x = 1 + 2\n", record, (void*)1) == 0);
+    ember_executor_wait(executor);
+    assert(finished == 2);
+    assert(statuses[0] != 0 && statuses[1] == 0);
+    ember_executor_destroy(executor);
+    printf("  ✓ A runaway task times out and the worker carries on\n");
+}
+
+void test_executor_yield(void) {
+    finished = 0;
+    ember_executor* executor = ember_executor_create(1, NULL);
+    assert(executor != NULL);
+    assert(ember_executor_set_fuel(executor, 1000, EMBER_FUEL_YIELD) == EMBER_SUCCESS);
+    assert(ember_executor_submit_script(executor,
+        "i = 0\nwhile (i < 5000000) { i = i + 1 }\n", record, (void*)0) == 0);
+    assert(ember_executor_submit_script(executor, "y = 1 + 2\n", record, (void*)1) == 0);
+    ember_executor_wait(executor);
+    assert(finished == 2);
+    assert(statuses[0] == 0 && statuses[1] == 0);
+    // The short task ran while the long one was preempted
+    assert(finished_order[0] == 1 && finished_order[1] == 0);
+    ember_executor_destroy(executor);
+    printf("  ✓ A long task yields to the task queued behind it\n");
+}
+
+int main(void) {
+    printf("Instruction fuel tests\n");
+    test_no_budget();
+    test_timeout();
+    test_yield();
+    test_executor_timeout();
+    test_executor_yield();
+    printf("All instruction fuel tests passed\n");
+    return 0;
+}
@@ -0,0 +1,196 @@
+#define _GNU_SOURCE
+#include "ember.h"
+#include "../../src/vm.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+
+#define POOL_THREADS 4
+#define POOL_ROUNDS 200
+#define GLOBAL_ALLOCS 100
+
+void test_thread_cache_reuse(void) {
+    assert(ember_pool_init(NULL) == 0);
+
+    ember_vm* vm = ember_pool_get_vm();
+    assert(vm != NULL);
+    assert(ember_eval(vm, "x = 1\n") == 0);
+    ember_pool_release_vm(vm);
+    // Served from this thread's cache
+    assert(ember_pool_get_vm() == vm);
+    ember_pool_release_vm(vm);
+
+    ember_pool_cleanup();
+    printf("  ✓ Released VMs are reused from the thread cache\n");
+}
+
+void test_release_scrubs_request(void) {
+    assert(ember_pool_init(NULL) == 0);
+
+    ember_vm* vm = ember_pool_get_vm();
+    assert(vm != NULL);
+    assert(ember_eval(vm,
+        "fn keep(a, b, c) { return [a, b, c] }\n"
+        "x = keep(\"secret\", 2, 3)\n") == 0);
+    assert(vm->locals_high >= 3);
+    ember_pool_release_vm(vm);
+
+    // Nothing the last request left is visible to the next
+    assert(ember_pool_get_vm() == vm);
+    assert(vm->stack_high == 0 && vm->locals_high == 0);
+    assert(vm->stack_top == 0 && vm->local_count == 0 && vm->frame_count == 0);
+    assert(vm->exception_handler_count == 0 && vm->loop_depth == 0);
+    for (int i = 0; i < 3; i++) {
+        assert(vm->locals[i].type == EMBER_VAL_NIL);
+    }
+    ember_pool_release_vm(vm);
+
+    ember_pool_cleanup();
+    printf("  ✓ Release scrubs only what the request touched\n");
+}
+
+void test_per_thread_limit(void) {
+    vm_pool_config_t config = {0};
+    config.max_vms_per_thread = 2;
+    config.rate_limit_max_allocs = 100;
+    assert(ember_pool_init(&config) == 0);
+
+    ember_vm* a = ember_pool_get_vm();
+    ember_vm* b = ember_pool_get_vm();
+    assert(a != NULL && b != NULL && a != b);
+    assert(ember_pool_get_vm() == NULL);
+    ember_pool_release_vm(a);
+    a = ember_pool_get_vm();
+    assert(a != NULL);
+    ember_pool_release_vm(a);
+    ember_pool_release_vm(b);
+
+    ember_pool_cleanup();
+    printf("  ✓ Checked-out VMs are limited per thread\n");
+}
+
+static void* pool_worker(void* arg) {
+    (void)arg;
+    for (int i = 0; i < POOL_ROUNDS; i++) {
+        ember_vm* vm = ember_pool_get_vm();
+        if (!vm) {
+            return (void*)1;
+        }
+        if (ember_eval(vm, "y = 2 + 3\n") != 0) {
+            return (void*)1;
+        }
+        ember_pool_release_vm(vm);
+    }
+    return NULL;
+}
+
+void test_concurrent_get_release(void) {
+    vm_pool_config_t config = {0};
+    config.initial_size = 4;
+    config.thread_cache_size = 1;
+    config.rate_limit_max_allocs = 10000;
+    assert(ember_pool_init(&config) == 0);
+
+    pthread_t threads[POOL_THREADS];
+    for (int i = 0; i < POOL_THREADS; i++) {
+        int rc = pthread_create(&threads[i], NULL, pool_worker, NULL);
+        assert(rc == 0);
+        (void)rc;
+    }
+    for (int i = 0; i < POOL_THREADS; i++) {
+        void* result;
+        pthread_join(threads[i], &result);
+        assert(result == NULL);
+    }
+
+    ember_pool_cleanup();
+    printf("  ✓ Threads share the pool without locking\n");
+}
+
+void test_token_bucket(void) {
+    vm_pool_config_t config = {0};
+    config.rate_limit_window_ms = 100;
+    config.rate_limit_max_allocs = 3;
+    assert(ember_pool_init(&config) == 0);
+
+    for (int i = 0; i < 3; i++) {
+        ember_vm* vm = ember_pool_get_vm();
+        assert(vm != NULL);
+        ember_pool_release_vm(vm);
+    }
+    assert(ember_pool_get_vm() == NULL);
+
+    // The bucket refills with time rather than all at once
+    struct timespec pause = {0, 50 * 1000000};
+    nanosleep(&pause, NULL);
+    ember_vm* vm = ember_pool_get_vm();
+    assert(vm != NULL);
+    ember_pool_release_vm(vm);
+
+    vm_pool_stats_t stats;
+    ember_pool_stats(&stats);
+    assert(stats.acquired == 4 && stats.released == 4);
+    assert(stats.rate_limited == 1);
+    assert(stats.created == 1 && stats.cache_hits == 3);
+
+    ember_pool_cleanup();
+    printf("  ✓ Each thread's gets refill as a token bucket\n");
+}
+
+static void* budget_worker(void* arg) {
+    (void)arg;
+    long granted = 0;
+    ember_vm* vm;
+    while ((vm = ember_pool_get_vm()) != NULL) {
+        granted++;
+        ember_pool_release_vm(vm);
+    }
+    return (void*)granted;
+}
+
+void test_global_budget(void) {
+    vm_pool_config_t config = {0};
+    config.rate_limit_window_ms = 86400000;
+    config.rate_limit_max_allocs = 10000;
+    config.rate_limit_global_allocs = GLOBAL_ALLOCS;
+    assert(ember_pool_init(&config) == 0);
+
+    // Threads lease from one budget and together get exactly all of it
+    pthread_t threads[POOL_THREADS];
+    for (int i = 0; i < POOL_THREADS; i++) {
+        int rc = pthread_create(&threads[i], NULL, budget_worker, NULL);
+        assert(rc == 0);
+        (void)rc;
+    }
+    long granted = 0;
+    for (int i = 0; i < POOL_THREADS; i++) {
+        void* result;
+        pthread_join(threads[i], &result);
+        granted += (long)result;
+    }
+    assert(granted == GLOBAL_ALLOCS);
+
+    vm_pool_stats_t stats;
+    ember_pool_stats(&stats);
+    assert(stats.acquired == GLOBAL_ALLOCS && stats.released == GLOBAL_ALLOCS);
+    assert(stats.rate_limited == POOL_THREADS);
+    assert(stats.cache_hits + stats.shared_hits + stats.created == GLOBAL_ALLOCS);
+
+    ember_pool_cleanup();
+    printf("  ✓ The pool-wide budget is shared by all threads\n");
+}
+
+int main(void) {
+    printf("Testing VM pool...\n");
+    test_thread_cache_reuse();
+    test_release_scrubs_request();
+    test_per_thread_limit();
+    test_concurrent_get_release();
+    test_token_bucket();
+    test_global_budget();
+    printf("✓ VM pool tests passed\n");
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+static ember_vm* warmed_vm(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    assert(ember_eval(vm,
+        "fn greet(name) { return \"hello \" + name }\n"
+        "config = {\"retries\": 3}\n"
+        "names = [\"a\", \"b\"]\n"
+        "class Point {\n"
+        "    fn init(x) {\n"
+        "        this.x = x\n"
+        "    }\n"
+        "}\n"
+        "origin = new Point(0)\n") == 0);
+    return vm;
+}
+
+void test_clone_copies_state(void) {
+    ember_vm* template_vm = warmed_vm();
+    ember_value template_config = global_value(template_vm, "config");
+    ember_chunk* template_greet = global_value(template_vm, "greet").as.func_val.chunk;
+    ember_vm_snapshot* snapshot = ember_vm_snapshot_create(template_vm);
+    assert(snapshot != NULL);
+
+    ember_vm* clone = ember_vm_snapshot_clone(snapshot);
+    assert(clone != NULL);
+    assert(clone->global_count == template_vm->global_count);
+
+    // Same code, private constants and caches
+    ember_value greet = global_value(clone, "greet");
+    assert(greet.type == EMBER_VAL_FUNCTION);
+    assert(greet.as.func_val.chunk != template_greet);
+    assert(greet.as.func_val.chunk->code == template_greet->code);
+    assert(greet.as.func_val.chunk->code_borrowed);
+
+    ember_value config = global_value(clone, "config");
+    assert(config.type == EMBER_VAL_HASH_MAP);
+    assert(config.as.obj_val != template_config.as.obj_val);
+    assert(ember_global_find(clone, "origin", 6) >= 0);
+    assert(ember_eval(clone, "result = greet(\"clone\")\n") == 0);
+    ember_value result = global_value(clone, "result");
+    assert(result.type == EMBER_VAL_STRING && strcmp(AS_CSTRING(result), "hello clone") == 0);
+
+    ember_free_vm(clone);
+    ember_vm_snapshot_free(snapshot);
+    printf("  ✓ Clones copy globals and share bytecode\n");
+}
+
+void test_clones_are_isolated(void) {
+    ember_vm_snapshot* snapshot = ember_vm_snapshot_create(warmed_vm());
+    assert(snapshot != NULL);
+
+    ember_vm* first = ember_vm_snapshot_clone(snapshot);
+    ember_vm* second = ember_vm_snapshot_clone(snapshot);
+    assert(first != NULL && second != NULL);
+    assert(ember_eval(first, "config[\"retries\"] = 10\nleaked = 1\n") == 0);
+    assert(ember_global_find(second, "leaked", 6) == -1);
+    ember_value retries = hash_map_get(AS_HASH_MAP(global_value(second, "config")),
+                                       ember_make_string_gc(second, "retries"));
+    assert(retries.type == EMBER_VAL_NUMBER && retries.as.number_val == 3);
+
+    // Later clones start from the snapshot, not from what earlier ones did
+    ember_vm* third = ember_vm_snapshot_clone(snapshot);
+    assert(third != NULL && ember_global_find(third, "leaked", 6) == -1);
+
+    ember_free_vm(third);
+    ember_free_vm(second);
+    ember_free_vm(first);
+    ember_vm_snapshot_free(snapshot);
+    printf("  ✓ Clones don't share mutable state\n");
+}
+
+static void* clone_worker(void* arg) {
+    ember_vm_snapshot* snapshot = arg;
+    for (int i = 0; i < 50; i++) {
+        ember_vm* vm = ember_vm_snapshot_clone(snapshot);
+        assert(vm != NULL);
+        assert(ember_global_find(vm, "greet", 5) >= 0);
+        ember_free_vm(vm);
+    }
+    return NULL;
+}
+
+void test_concurrent_clones(void) {
+    ember_vm_snapshot* snapshot = ember_vm_snapshot_create(warmed_vm());
+    assert(snapshot != NULL);
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++) {
+        int rc = pthread_create(&threads[i], NULL, clone_worker, snapshot);
+        assert(rc == 0);
+        (void)rc;
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    ember_vm_snapshot_free(snapshot);
+    printf("  ✓ Clones can be made on several threads\n");
+}
+
+void test_uncopyable_state(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_global_define(vm, "pending", ember_make_promise(vm));
+    // The VM stays the caller's
+    assert(ember_vm_snapshot_create(vm) == NULL);
+    ember_free_vm(vm);
+    printf("  ✓ State that can't be copied is refused\n");
+}
+
+void test_pool_clones(void) {
+    ember_vm_snapshot* snapshot = ember_vm_snapshot_create(warmed_vm());
+    assert(snapshot != NULL);
+    assert(ember_pool_init(NULL) == 0);
+    ember_pool_set_snapshot(snapshot);
+
+    ember_vm* vm = ember_pool_get_vm();
+    assert(vm != NULL && ember_global_find(vm, "greet", 5) >= 0);
+    assert(ember_eval(vm, "leaked = 1\n") == 0);
+    ember_pool_release_vm(vm);
+    vm = ember_pool_get_vm();
+    assert(vm != NULL && ember_global_find(vm, "leaked", 6) == -1);
+    ember_pool_release_vm(vm);
+
+    ember_pool_set_snapshot(NULL);
+    ember_pool_cleanup();
+    ember_vm_snapshot_free(snapshot);
+    printf("  ✓ Pool hands out fresh clones\n");
+}
+
+int main(void) {
+    printf("Testing VM snapshots...\n");
+    test_clone_copies_state();
+    test_clones_are_isolated();
+    test_concurrent_clones();
+    test_uncopyable_state();
+    test_pool_clones();
+    printf("✓ VM snapshot tests passed\n");
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Long enough for every vector width, with a tail left over
+#define VMATH_TEST_LENGTH 37
+
+static ember_value call(ember_vm* vm, ember_native_func func, int argc, ember_value* argv) {
+    int base = vm->stack_top;
+    for (int i = 0; i < argc; i++) {
+        vm->stack[vm->stack_top++] = argv[i];
+    }
+    ember_value result = func(vm, argc, &vm->stack[base]);
+    vm->stack_top = base;
+    return result;
+}
+
+// A typed array holding first, first + step, ..., rooted on the stack
+static ember_value ramp(ember_vm* vm, ember_typed_kind kind, int length, double first, double step) {
+    ember_value array = ember_make_typed_array(vm, kind, length);
+    assert(array.type == EMBER_VAL_TYPED_ARRAY);
+    vm->stack[vm->stack_top++] = array;
+    for (int i = 0; i < length; i++) {
+        ember_typed_array_store(AS_TYPED_ARRAY(array), i, first + step * i);
+    }
+    return array;
+}
+
+static double at(ember_value array, int index) {
+    return ember_typed_array_load(AS_TYPED_ARRAY(array), index);
+}
+
+void test_reductions(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    int n = VMATH_TEST_LENGTH;
+    ember_value a = ramp(vm, EMBER_TYPED_FLOAT64, n, -10, 1);
+    ember_value b = ramp(vm, EMBER_TYPED_INT32, n, 3, 2);
+
+    double sum = 0, dot = 0;
+    for (int i = 0; i < n; i++) {
+        sum += at(a, i);
+        dot += at(a, i) * at(b, i);
+    }
+    assert(call(vm, ember_native_vmath_sum, 1, &a).as.number_val == sum);
+    ember_value pair[2] = {a, b};
+    assert(call(vm, ember_native_vmath_dot, 2, pair).as.number_val == dot);
+    assert(call(vm, ember_native_vmath_min, 1, &a).as.number_val == -10);
+    assert(call(vm, ember_native_vmath_max, 1, &b).as.number_val == 3 + 2 * (n - 1));
+
+    // The extreme anywhere, including the tail past the last full vector
+    ember_typed_array_store(AS_TYPED_ARRAY(a), n - 1, -100);
+    ember_typed_array_store(AS_TYPED_ARRAY(a), 5, 100);
+    assert(call(vm, ember_native_vmath_min, 1, &a).as.number_val == -100);
+    assert(call(vm, ember_native_vmath_max, 1, &a).as.number_val == 100);
+    ember_typed_array_store(AS_TYPED_ARRAY(a), 3, NAN);
+    assert(isnan(call(vm, ember_native_vmath_min, 1, &a).as.number_val));
+
+    // Empty arrays, mismatched lengths and other types
+    ember_value empty = ramp(vm, EMBER_TYPED_UINT8, 0, 0, 0);
+    assert(call(vm, ember_native_vmath_sum, 1, &empty).as.number_val == 0);
+    assert(call(vm, ember_native_vmath_max, 1, &empty).type == EMBER_VAL_NIL);
+    pair[1] = empty;
+    assert(call(vm, ember_native_vmath_dot, 2, pair).type == EMBER_VAL_NIL);
+    ember_value number = ember_make_number(1);
+    assert(call(vm, ember_native_vmath_sum, 1, &number).type == EMBER_VAL_NIL);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("  ✓ Sum, dot, min and max\n");
+}
+
+void test_elementwise(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    int n = VMATH_TEST_LENGTH;
+    ember_value a = ramp(vm, EMBER_TYPED_FLOAT64, n, 0, 1);
+    ember_value bytes = ramp(vm, EMBER_TYPED_UINT8, n, 1, 1);
+
+    ember_value args[4] = {a, bytes, ember_make_nil(), ember_make_nil()};
+    ember_value sums = call(vm, ember_native_vmath_add, 2, args);
+    assert(sums.type == EMBER_VAL_TYPED_ARRAY && AS_TYPED_ARRAY(sums)->kind == EMBER_TYPED_FLOAT64);
+    vm->stack[vm->stack_top++] = sums;
+    args[1] = ember_make_number(0.5);
+    ember_value halves = call(vm, ember_native_vmath_mul, 2, args);
+    vm->stack[vm->stack_top++] = halves;
+    for (int i = 0; i < n; i++) {
+        assert(at(sums, i) == 2 * i + 1);
+        assert(at(halves, i) == i * 0.5);
+    }
+
+    // Written in place through out
+    args[1] = ember_make_number(3);
+    args[2] = a;
+    assert(call(vm, ember_native_vmath_scale, 3, args).as.obj_val == a.as.obj_val);
+    assert(at(a, n - 1) == 3 * (n - 1));
+    args[1] = ember_make_number(10);
+    args[2] = ember_make_number(20);
+    args[3] = a;
+    assert(call(vm, ember_native_vmath_clamp, 4, args).as.obj_val == a.as.obj_val);
+    assert(at(a, 0) == 10 && at(a, 5) == 15 && at(a, n - 1) == 20);
+
+    ember_value prefix = call(vm, ember_native_vmath_prefix_sum, 1, &bytes);
+    vm->stack[vm->stack_top++] = prefix;
+    for (int i = 0; i < n; i++) {
+        assert(at(prefix, i) == (double)(i + 1) * (i + 2) / 2);
+    }
+
+    ember_value roots = call(vm, ember_native_vmath_sqrt, 1, &bytes);
+    vm->stack[vm->stack_top++] = roots;
+    ember_value exps = call(vm, ember_native_vmath_exp, 1, &bytes);
+    vm->stack[vm->stack_top++] = exps;
+    ember_value logs = call(vm, ember_native_vmath_log, 1, &exps);
+    for (int i = 0; i < n; i++) {
+        assert(at(roots, i) == sqrt(i + 1));
+        assert(fabs(at(logs, i) - (i + 1)) < 1e-12);
+    }
+
+    // out must be a float64 array of the same length; b must match a
+    args[0] = bytes;
+    args[1] = bytes;
+    args[2] = bytes;
+    assert(call(vm, ember_native_vmath_add, 3, args).type == EMBER_VAL_NIL);
+    args[1] = ember_make_typed_array(vm, EMBER_TYPED_FLOAT64, 2);
+    assert(call(vm, ember_native_vmath_mul, 2, args).type == EMBER_VAL_NIL);
+    args[1] = ember_make_number(5);
+    args[2] = ember_make_number(1);
+    assert(call(vm, ember_native_vmath_clamp, 3, args).type == EMBER_VAL_NIL);
+
+    vm->stack_top = 0;
+    ember_free_vm(vm);
+    printf("  ✓ Elementwise kernels, new arrays and in place\n");
+}
+
+int main(int argc, char* argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("Running vector math tests...\n");
+    test_reductions();
+    test_elementwise();
+    printf("All vector math tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,174 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+static const char source[] = "fn add(a, b) { return a + b }\n";
+
+// add's body as the process that saves the profile and the one that loads
+// it both compile it; the VM frees tracked chunks
+static ember_chunk* compile_add(ember_vm* vm, uint8_t op) {
+    ember_chunk* chunk = malloc(sizeof(ember_chunk));
+    assert(chunk);
+    init_chunk(chunk);
+    write_chunk(chunk, op);
+    write_chunk(chunk, OP_CALL);
+    write_chunk(chunk, 0);
+    write_chunk(chunk, OP_RETURN);
+    ember_chunk_set_name(chunk, "add");
+    track_function_chunk(vm, chunk);
+    return chunk;
+}
+
+static void run_add(ember_vm* vm, ember_chunk* chunk, int times) {
+    for (int i = 0; i < times; i++) {
+        vm->stack[0] = ember_make_number(i);
+        vm->stack[1] = ember_make_number(1);
+        vm->stack_top = 2;
+        vm_feedback_record(vm, chunk, 0, opcode_generic(chunk->code[0]), 0);
+        vm->stack[0].type = EMBER_VAL_FUNCTION;
+        vm->stack[0].as.func_val.chunk = chunk;
+        vm->stack[0].as.func_val.name = "add";
+        vm->stack_top = 1;
+        vm_feedback_record(vm, chunk, 1, OP_CALL, 0);
+    }
+    vm->stack_top = 0;
+}
+
+static void profile_path(char* path, size_t size) {
+    snprintf(path, size, "/tmp/ember-warm-%d.profile", (int)getpid());
+}
+
+// A process that ran add often enough to quicken it
+static void save_hot_profile(const char* path) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_chunk* chunk = compile_add(vm, OP_ADD);
+    run_add(vm, chunk, 20);
+    assert(chunk->code[0] == OP_ADD_NUMBER);
+    chunk->jit_counter = 37;
+    chunk->osr_profiled = 1;
+    assert(ember_vm_save_warm_profile(vm, source, path) == EMBER_SUCCESS);
+    ember_free_vm(vm);
+}
+
+void test_round_trip(void) {
+    char path[64];
+    profile_path(path, sizeof(path));
+    save_hot_profile(path);
+
+    // Compiled before the profile loads: warmed at once
+    ember_vm* vm = ember_new_vm();
+    ember_chunk* chunk = compile_add(vm, OP_ADD);
+    assert(ember_vm_load_warm_profile(vm, source, path) == EMBER_SUCCESS);
+    assert(chunk->code[0] == OP_ADD_NUMBER);
+    const ember_feedback_slot* add = ember_chunk_feedback_at(chunk, 0);
+    assert(add && add->hits == 20 && add->state == EMBER_FEEDBACK_MONOMORPHIC);
+    assert(add->left_types == 1u << EMBER_VAL_NUMBER && add->right_types == 1u << EMBER_VAL_NUMBER);
+    assert(chunk->jit_counter == 37 && chunk->osr_profiled);
+
+    // Call targets are addresses in the old process: counts only
+    const ember_feedback_slot* call = ember_chunk_feedback_at(chunk, 1);
+    assert(call && call->hits == 20 && call->target_count == 0);
+    assert(call->state == EMBER_FEEDBACK_UNINITIALIZED);
+    assert(call->left_types == 1u << EMBER_VAL_FUNCTION);
+
+    // Every function found its chunk
+    assert(vm->warm_profile == NULL);
+    ember_free_vm(vm);
+    unlink(path);
+    printf("  ✓ Saved feedback quickens the same function in a new VM\n");
+}
+
+void test_first_call(void) {
+    char path[64];
+    profile_path(path, sizeof(path));
+    save_hot_profile(path);
+
+    // Loaded before anything is compiled: each chunk waits for its first call
+    ember_vm* vm = ember_new_vm();
+    assert(ember_vm_load_warm_profile(vm, source, path) == EMBER_SUCCESS);
+    assert(vm->warm_profile != NULL);
+
+    // Same name, other code: left cold
+    ember_chunk* edited = compile_add(vm, OP_SUB);
+    vm_warm_profile_apply(vm, edited);
+    assert(edited->warm_checked && edited->feedback_count == 0 && edited->jit_counter == 0);
+    assert(vm->warm_profile != NULL);
+
+    ember_chunk* chunk = compile_add(vm, OP_ADD);
+    assert(!chunk->warm_checked);
+    vm_warm_profile_apply(vm, chunk);
+    assert(chunk->warm_checked && chunk->code[0] == OP_ADD_NUMBER);
+    assert(vm->warm_profile == NULL);
+    ember_free_vm(vm);
+    unlink(path);
+    printf("  ✓ A function is warmed on its first call, if its code matches\n");
+}
+
+void test_jit_due(void) {
+    char path[64];
+    profile_path(path, sizeof(path));
+    ember_vm* vm = ember_new_vm();
+    ember_chunk* chunk = compile_add(vm, OP_ADD);
+    run_add(vm, chunk, 1);
+    // Only whether it had native code is saved
+    static int native_code;
+    chunk->jit_code = (struct ember_jit_code*)&native_code;
+    assert(ember_vm_save_warm_profile(vm, source, path) == EMBER_SUCCESS);
+    chunk->jit_code = NULL;
+    ember_free_vm(vm);
+
+    vm = ember_new_vm();
+    chunk = compile_add(vm, OP_ADD);
+    assert(ember_vm_load_warm_profile(vm, source, path) == EMBER_SUCCESS);
+    // Compiled on its next call whatever the threshold
+    assert(chunk->jit_counter == UINT32_MAX - 1);
+    // One run is not enough to quicken
+    assert(chunk->code[0] == OP_ADD);
+    ember_free_vm(vm);
+    unlink(path);
+    printf("  ✓ A function that had native code is due for the JIT\n");
+}
+
+void test_stale(void) {
+    char path[64];
+    profile_path(path, sizeof(path));
+    save_hot_profile(path);
+
+    ember_vm* vm = ember_new_vm();
+    ember_chunk* chunk = compile_add(vm, OP_ADD);
+    assert(ember_vm_load_warm_profile(vm, "fn add(a, b) { return b + a }\n", path) == EMBER_ERROR_OPERATION_FAILED);
+    assert(vm->warm_profile == NULL && chunk->feedback_count == 0 && chunk->code[0] == OP_ADD);
+
+    // Damaged: nothing of it is used
+    FILE* file = fopen(path, "a");
+    assert(file != NULL);
+    fprintf(file, "function add 4 nonsense\n");
+    fclose(file);
+    assert(ember_vm_load_warm_profile(vm, source, path) == EMBER_ERROR_OPERATION_FAILED);
+    assert(vm->warm_profile == NULL && chunk->feedback_count == 0);
+    unlink(path);
+
+    assert(ember_vm_load_warm_profile(vm, source, path) == EMBER_ERROR_OPERATION_FAILED);
+    assert(ember_vm_load_warm_profile(NULL, source, path) == EMBER_ERROR_INVALID_PARAMETER);
+    assert(ember_vm_save_warm_profile(vm, NULL, path) == EMBER_ERROR_INVALID_PARAMETER);
+    assert(ember_vm_save_warm_profile(vm, source, "/nonexistent/dir/profile") == EMBER_ERROR_OPERATION_FAILED);
+    ember_free_vm(vm);
+    printf("  ✓ Profiles of another script, damaged or missing ones load nothing\n");
+}
+
+int main(void) {
+    printf("Warm-start profile tests\n");
+    test_round_trip();
+    test_first_call();
+    test_jit_due();
+    test_stale();
+    printf("All warm-start profile tests passed\n");
+    return 0;
+}
@@ -0,0 +1,234 @@
+#include "ember.h"
+#include "../../src/vm.h"
+#include "../../src/runtime/value/value.h"
+#include "../../src/core/gc_trace.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+static ember_value pair(ember_vm* vm, ember_value first, ember_value second) {
+    ember_value array = keep(vm, ember_make_array(vm, 2));
+    array_push_with_vm(vm, AS_ARRAY(array), first);
+    array_push_with_vm(vm, AS_ARRAY(array), second);
+    return array;
+}
+
+static int has(ember_value map, ember_value key) {
+    ember_value value;
+    return weak_map_get(AS_WEAK_MAP(map), key, &value);
+}
+
+void test_weak_ref(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value kept = text(vm, "kept");
+    ember_value ref_kept = keep(vm, ember_make_weak_ref(vm, kept));
+    ember_value dropped = pair(vm, ember_make_number(1), ember_make_number(2));
+    ember_value ref_dropped = keep(vm, ember_make_weak_ref(vm, dropped));
+    ember_value ref_self = keep(vm, ember_make_weak_ref(vm, ember_make_nil()));
+    assert(ref_kept.type == EMBER_VAL_WEAK_REF && ref_self.type == EMBER_VAL_WEAK_REF);
+    assert(AS_WEAK_REF(ref_self)->target.type == EMBER_VAL_NIL);
+    assert(ember_make_weak_ref(vm, ember_make_number(1)).type == EMBER_VAL_NIL);
+
+    // The reference itself keeps nothing alive
+    ember_gc_collect(vm);
+    assert(AS_WEAK_REF(ref_dropped)->target.type == EMBER_VAL_ARRAY);
+    vm->stack[2] = ember_make_nil();
+    ember_gc_collect(vm);
+    assert(AS_WEAK_REF(ref_dropped)->target.type == EMBER_VAL_NIL);
+    assert(AS_WEAK_REF(ref_kept)->target.as.obj_val == kept.as.obj_val);
+    ember_free_vm(vm);
+    printf("  ✓ A weak reference reads nil once its target is collected\n");
+}
+
+void test_ephemerons(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value map = keep(vm, ember_make_weak_map(vm));
+    ember_value other = keep(vm, ember_make_weak_map(vm));
+    ember_value live = pair(vm, ember_make_nil(), ember_make_nil());
+
+    // A dead key, one whose value points back at it, and live's value,
+    // reachable only through map and itself a key in other
+    int base = vm->stack_top;
+    ember_value dead = pair(vm, ember_make_nil(), ember_make_nil());
+    ember_value cyclic = pair(vm, ember_make_nil(), ember_make_nil());
+    ember_value chained = pair(vm, ember_make_nil(), ember_make_nil());
+    assert(weak_map_set(vm, AS_WEAK_MAP(map), dead, text(vm, "dead meta")));
+    assert(weak_map_set(vm, AS_WEAK_MAP(map), cyclic, pair(vm, cyclic, ember_make_nil())));
+    assert(weak_map_set(vm, AS_WEAK_MAP(map), live, text(vm, "replaced")));
+    assert(weak_map_set(vm, AS_WEAK_MAP(map), live, chained) && AS_WEAK_MAP(map)->count == 3);
+    assert(weak_map_set(vm, AS_WEAK_MAP(other), chained, text(vm, "chained meta")));
+    vm->stack_top = base;
+    ember_gc_collect(vm);
+
+    // chained lives through live, and keeps its entry in other
+    assert(AS_WEAK_MAP(map)->count == 1 && has(map, live));
+    ember_value value;
+    assert(weak_map_get(AS_WEAK_MAP(map), live, &value) && value.as.obj_val == chained.as.obj_val);
+    ember_value meta;
+    assert(AS_WEAK_MAP(other)->count == 1 && weak_map_get(AS_WEAK_MAP(other), value, &meta));
+    assert(meta.type == EMBER_VAL_STRING && strcmp(AS_CSTRING(meta), "chained meta") == 0);
+
+    vm->stack_top = base - 1;
+    ember_gc_collect(vm);
+    assert(AS_WEAK_MAP(map)->count == 0 && AS_WEAK_MAP(other)->count == 0);
+    ember_free_vm(vm);
+    printf("  ✓ Weak map values live only through their keys, chains and cycles too\n");
+}
+
+void test_generations(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_gc_configure(vm, 1, 0, 1, 0);
+    ember_value map = keep(vm, ember_make_weak_map(vm));
+    ember_value old_key = pair(vm, ember_make_nil(), ember_make_nil());
+    ember_value ref = keep(vm, ember_make_weak_ref(vm, old_key));
+    gc_collect_minor(vm);
+    assert(map.as.obj_val->is_old && old_key.as.obj_val->is_old);
+
+    // Young keys and values in an old map, with no barrier to remember it
+    int base = vm->stack_top;
+    for (int i = 0; i < 100; i++) {
+        ember_value key = pair(vm, ember_make_number(i), ember_make_nil());
+        assert(weak_map_set(vm, AS_WEAK_MAP(map), key, pair(vm, key, ember_make_number(i))));
+        if (i % 2) vm->stack_top--;
+        else vm->stack_top -= 2;
+    }
+    assert(weak_map_set(vm, AS_WEAK_MAP(map), old_key, pair(vm, ember_make_number(-1), ember_make_nil())));
+    vm->stack_top = base + 50;
+    assert(!map.as.obj_val->is_remembered && AS_WEAK_MAP(map)->count == 101);
+
+    // A minor collection drops the young keys only the map held, and keeps
+    // the old key's young value
+    gc_collect_minor(vm);
+    assert(AS_WEAK_MAP(map)->count == 51);
+    ember_value value;
+    assert(weak_map_get(AS_WEAK_MAP(map), old_key, &value));
+    assert(value.as.obj_val->is_old && AS_ARRAY(value)->elements[0].as.number_val == -1);
+    for (int i = 0; i < 50; i++) {
+        ember_value key = vm->stack[base + i];
+        assert(weak_map_get(AS_WEAK_MAP(map), key, &value));
+        assert(AS_ARRAY(value)->elements[1].as.number_val == AS_ARRAY(key)->elements[0].as.number_val);
+    }
+
+    // Old keys wait for a full collection
+    vm->stack_top = base;
+    vm->stack[base - 2] = ember_make_nil();
+    gc_collect_minor(vm);
+    assert(AS_WEAK_MAP(map)->count == 51 && AS_WEAK_REF(ref)->target.type == EMBER_VAL_ARRAY);
+    ember_gc_collect(vm);
+    assert(AS_WEAK_MAP(map)->count == 0 && AS_WEAK_REF(ref)->target.type == EMBER_VAL_NIL);
+    ember_free_vm(vm);
+    printf("  ✓ Minor collections clear young keys without entering old maps\n");
+}
+
+void test_incremental(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_gc_configure(vm, 1, 1, 1, 0);
+    ember_value map = keep(vm, ember_make_weak_map(vm));
+    ember_value key = pair(vm, ember_make_nil(), ember_make_nil());
+    ember_value target = pair(vm, ember_make_nil(), ember_make_nil());
+    ember_value ref = keep(vm, ember_make_weak_ref(vm, target));
+    assert(weak_map_set(vm, AS_WEAK_MAP(map), key, pair(vm, ember_make_number(7), ember_make_nil())));
+    vm->stack[2] = ember_make_nil();
+    vm->stack_top = 4;
+
+    // Marking never enters the map; finishing the cycle finds the value
+    // through its key
+    gc_incremental_start(vm);
+    assert(vm->gc_phase == GC_PHASE_MARK);
+    gc_incremental_finish(vm);
+    assert(vm->gc_phase == GC_PHASE_IDLE);
+    ember_value value;
+    assert(weak_map_get(AS_WEAK_MAP(map), key, &value) && AS_ARRAY(value)->elements[0].as.number_val == 7);
+    assert(AS_WEAK_REF(ref)->target.type == EMBER_VAL_NIL);
+
+    vm->stack[1] = ember_make_nil();
+    ember_gc_collect(vm);
+    assert(AS_WEAK_MAP(map)->count == 0);
+    ember_free_vm(vm);
+    printf("  ✓ Incremental cycles clear weak entries once marking is done\n");
+}
+
+void test_table(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value map = keep(vm, ember_make_weak_map(vm));
+    ember_weak_map* m = AS_WEAK_MAP(map);
+    ember_value keys = keep(vm, ember_make_array(vm, 1000));
+    for (int i = 0; i < 1000; i++) {
+        ember_value key = pair(vm, ember_make_number(i), ember_make_nil());
+        array_push_with_vm(vm, AS_ARRAY(keys), key);
+        vm->stack_top--;
+        assert(weak_map_set(vm, m, key, ember_make_number(i)));
+    }
+    assert(m->count == 1000 && m->capacity == 2048);
+
+    // Deletions shift the probe runs back; every other key still resolves
+    ember_value* key = AS_ARRAY(keys)->elements;
+    for (int i = 0; i < 1000; i += 3) {
+        assert(weak_map_delete(m, key[i]) && !weak_map_delete(m, key[i]));
+    }
+    for (int i = 0; i < 1000; i++) {
+        ember_value value;
+        int found = weak_map_get(m, key[i], &value);
+        assert(found == (i % 3 != 0) && (!found || value.as.number_val == i));
+    }
+    assert(weak_map_set(vm, m, key[1], ember_make_number(-1)) && m->count == 666);
+    ember_free_vm(vm);
+    printf("  ✓ Weak maps resolve keys through growth and deletion\n");
+}
+
+void test_natives(void) {
+    ember_vm* vm = ember_new_vm();
+    assert(vm != NULL);
+    ember_value key = pair(vm, ember_make_nil(), ember_make_nil());
+    ember_value ref = keep(vm, ember_native_weak_ref(vm, 1, &key));
+    assert(ember_native_weak_ref_get(vm, 1, &ref).as.obj_val == key.as.obj_val);
+    assert(strcmp(value_type_to_string(ref.type), "weak_ref") == 0);
+    ember_value map = keep(vm, ember_native_weak_map(vm, 0, NULL));
+    assert(strcmp(value_type_to_string(map.type), "weak_map") == 0);
+
+    ember_value args[3] = {map, key, text(vm, "meta")};
+    assert(ember_native_weak_map_set(vm, 3, args).as.bool_val);
+    assert(ember_native_weak_map_has(vm, 2, args).as.bool_val);
+    assert(strcmp(AS_CSTRING(ember_native_weak_map_get(vm, 2, args)), "meta") == 0);
+    assert(ember_native_weak_map_size(vm, 1, &map).as.number_val == 1);
+    assert(ember_native_weak_map_delete(vm, 2, args).as.bool_val);
+    ember_value fallback[3] = {map, key, ember_make_number(7)};
+    assert(ember_native_weak_map_get(vm, 3, fallback).as.number_val == 7);
+
+    // Strings and immediates are no keys or targets
+    args[1] = text(vm, "key");
+    assert(!ember_native_weak_map_set(vm, 3, args).as.bool_val);
+    args[1] = ember_make_number(1);
+    assert(!ember_native_weak_map_set(vm, 3, args).as.bool_val);
+    assert(!ember_native_weak_map_has(vm, 2, args).as.bool_val);
+    assert(ember_native_weak_ref(vm, 1, &args[1]).type == EMBER_VAL_NIL);
+    ember_value nil = ember_make_nil();
+    assert(ember_native_weak_ref(vm, 1, &nil).type == EMBER_VAL_NIL);
+
+    // Bad receivers
+    args[0] = key;
+    assert(ember_native_weak_map_get(vm, 2, args).type == EMBER_VAL_NIL);
+    assert(ember_native_weak_map_set(vm, 3, args).type == EMBER_VAL_NIL);
+    assert(ember_native_weak_ref_get(vm, 1, &key).type == EMBER_VAL_NIL);
+    assert(ember_native_weak_map(vm, 1, &key).type == EMBER_VAL_NIL);
+    ember_free_vm(vm);
+    printf("  ✓ weak_ref and weak_map natives store, read and refuse bad arguments\n");
+}
+
+int main(void) {
+    printf("Running weak reference tests...\n");
+    test_weak_ref();
+    test_ephemerons();
+    test_generations();
+    test_incremental();
+    test_table();
+    test_natives();
+    printf("All weak reference tests passed!\n");
+    return 0;
+}
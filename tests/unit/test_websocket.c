@@ -0,0 +1,154 @@
+#include "../../src/runtime/websocket.h"
+#include "test_ember_internal.h"
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const uint8_t mask[4] = {0x37, 0xfa, 0x21, 0x3d};
+
+// A masked client frame for payload
+static size_t client_frame(uint8_t* out, int final, int opcode, const void* payload, size_t length) {
+    size_t head = ws_frame_head(out, opcode, length);
+    if (!final) out[0] &= 0x7F;
+    out[1] |= 0x80;
+    memcpy(out + head, mask, 4);
+    memcpy(out + head + 4, payload, length);
+    ws_unmask(out + head + 4, length, mask);
+    return head + 4 + length;
+}
+
+void test_unmask(void) {
+    // Every length around the vector widths, against a bytewise XOR
+    uint8_t data[300], expected[300];
+    for (size_t length = 0; length <= sizeof(data); length++) {
+        for (size_t i = 0; i < length; i++) {
+            data[i] = (uint8_t)(i * 7 + length);
+            expected[i] = data[i] ^ mask[i % 4];
+        }
+        ws_unmask(data, length, mask);
+        assert(memcmp(data, expected, length) == 0);
+    }
+    // Unaligned starts
+    uint8_t* block = malloc(1024 + 3);
+    for (int offset = 1; offset <= 3; offset++) {
+        for (int i = 0; i < 1024; i++) block[offset + i] = (uint8_t)i;
+        ws_unmask(block + offset, 1024, mask);
+        for (int i = 0; i < 1024; i++) assert(block[offset + i] == ((uint8_t)i ^ mask[i % 4]));
+    }
+    free(block);
+    printf("  ✓ Unmasking matches a bytewise XOR at every length\n");
+}
+
+void test_frames(void) {
+    ws_reader reader;
+    ws_reader_init(&reader, 1 << 20);
+    ws_message message;
+    uint8_t buffer[70000];
+
+    // A whole frame is read in place, and only once all of it is there
+    size_t length = client_frame(buffer, 1, WS_TEXT, "hello", 5);
+    for (size_t part = 0; part < length; part++) {
+        assert(ws_read(&reader, buffer, part, &message) == 0);
+    }
+    assert(ws_read(&reader, buffer, length, &message) == (ssize_t)length);
+    assert(message.opcode == WS_TEXT && message.length == 5 && memcmp(message.payload, "hello", 5) == 0);
+    assert(message.payload == buffer + 6);
+
+    // 16- and 64-bit lengths
+    static uint8_t big[66000];
+    for (size_t i = 0; i < sizeof(big); i++) big[i] = (uint8_t)(i * 13);
+    length = client_frame(buffer, 1, WS_BINARY, big, 300);
+    assert(buffer[1] == (0x80 | 126) && ws_read(&reader, buffer, length, &message) == (ssize_t)length);
+    assert(message.opcode == WS_BINARY && message.length == 300 && memcmp(message.payload, big, 300) == 0);
+    length = client_frame(buffer, 1, WS_BINARY, big, sizeof(big));
+    assert(buffer[1] == (0x80 | 127) && ws_read(&reader, buffer, length, &message) == (ssize_t)length);
+    assert(message.length == sizeof(big) && memcmp(message.payload, big, sizeof(big)) == 0);
+
+    // Fragments gather into one message, with a ping between them
+    length = client_frame(buffer, 0, WS_TEXT, "frag", 4);
+    length += client_frame(buffer + length, 1, WS_PING, "p", 1);
+    length += client_frame(buffer + length, 0, WS_CONTINUATION, "men", 3);
+    length += client_frame(buffer + length, 1, WS_CONTINUATION, "ted", 3);
+    size_t at = 0;
+    int opcodes[4];
+    for (int i = 0; i < 4; i++) {
+        ssize_t used = ws_read(&reader, buffer + at, length - at, &message);
+        assert(used > 0);
+        at += (size_t)used;
+        opcodes[i] = message.opcode;
+    }
+    assert(at == length);
+    assert(opcodes[0] == 0 && opcodes[1] == WS_PING && opcodes[2] == 0 && opcodes[3] == WS_TEXT);
+    assert(message.length == 10 && memcmp(message.payload, "fragmented", 10) == 0);
+
+    // The head of a server frame
+    uint8_t head[WS_HEAD_MAX];
+    assert(ws_frame_head(head, WS_TEXT, 5) == 2 && head[0] == 0x81 && head[1] == 5);
+    assert(ws_frame_head(head, WS_BINARY, 65535) == 4 && head[1] == 126 && head[2] == 0xFF && head[3] == 0xFF);
+    assert(ws_frame_head(head, WS_TEXT, 65536) == 10 && head[1] == 127 && head[7] == 1 && head[9] == 0);
+    ws_reader_free(&reader);
+    printf("  ✓ Frames are read in place and fragments reassembled\n");
+}
+
+void test_protocol_errors(void) {
+    ws_reader reader;
+    ws_reader_init(&reader, 1000);
+    ws_message message;
+    uint8_t buffer[2048];
+
+    // Unmasked, reserved bits, unknown opcodes, long or fragmented control frames
+    size_t length = client_frame(buffer, 1, WS_TEXT, "x", 1);
+    buffer[1] &= 0x7F;
+    assert(ws_read(&reader, buffer, length, &message) == -WS_CLOSE_PROTOCOL);
+    client_frame(buffer, 1, WS_TEXT, "x", 1);
+    buffer[0] |= 0x40;
+    assert(ws_read(&reader, buffer, length, &message) == -WS_CLOSE_PROTOCOL);
+    length = client_frame(buffer, 1, 0x3, "x", 1);
+    assert(ws_read(&reader, buffer, length, &message) == -WS_CLOSE_PROTOCOL);
+    length = client_frame(buffer, 0, WS_PING, "x", 1);
+    assert(ws_read(&reader, buffer, length, &message) == -WS_CLOSE_PROTOCOL);
+    char payload[1024] = {0};
+    length = client_frame(buffer, 1, WS_PING, payload, 126);
+    assert(ws_read(&reader, buffer, length, &message) == -WS_CLOSE_PROTOCOL);
+
+    // A continuation with nothing to continue, or a new message mid-way
+    length = client_frame(buffer, 1, WS_CONTINUATION, "x", 1);
+    assert(ws_read(&reader, buffer, length, &message) == -WS_CLOSE_PROTOCOL);
+    length = client_frame(buffer, 0, WS_TEXT, "x", 1);
+    assert(ws_read(&reader, buffer, length, &message) == (ssize_t)length && message.opcode == 0);
+    length = client_frame(buffer, 1, WS_TEXT, "x", 1);
+    assert(ws_read(&reader, buffer, length, &message) == -WS_CLOSE_PROTOCOL);
+
+    // Too big is refused from the head alone, fragments counted together
+    ws_reader_free(&reader);
+    ws_reader_init(&reader, 1000);
+    length = client_frame(buffer, 1, WS_BINARY, payload, 1001);
+    assert(ws_read(&reader, buffer, 4, &message) == -WS_CLOSE_TOO_BIG);
+    length = client_frame(buffer, 0, WS_BINARY, payload, 600);
+    assert(ws_read(&reader, buffer, length, &message) == (ssize_t)length);
+    length = client_frame(buffer, 1, WS_CONTINUATION, payload, 401);
+    assert(ws_read(&reader, buffer, length, &message) == -WS_CLOSE_TOO_BIG);
+    ws_reader_free(&reader);
+    printf("  ✓ Protocol errors give the close code to fail with\n");
+}
+
+void test_accept_key(void) {
+    // The example in RFC 6455 section 1.3
+    char accept[29];
+    assert(ws_accept_key("dGhlIHNhbXBsZSBub25jZQ==", 24, accept) == 0);
+    assert(strcmp(accept, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") == 0);
+    assert(ws_accept_key("dGhlIHNhbXBsZSBub25jZQ", 22, accept) == -1);
+    assert(ws_accept_key("dGhlIHNhbXBsZSBub25j!Q==", 24, accept) == -1);
+    printf("  ✓ Handshake keys are answered as RFC 6455 gives\n");
+}
+
+int main(void) {
+    printf("Running WebSocket tests...\n");
+    test_unmask();
+    test_frames();
+    test_protocol_errors();
+    test_accept_key();
+    printf("All WebSocket tests passed!\n");
+    return 0;
+}
@@ -1,463 +1,676 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
+#include <limits.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <math.h>
+#include <time.h>
+#include <sys/utsname.h>
 #include "../../include/ember.h"
-#include "../../src/core/jit_vm_bridge.h"
-#include "../../src/core/performance_benchmark.h"
+#include "../../src/core/vm_regex.h"
+#include "../../src/runtime/module_system.h"
+#include "../../src/core/perf_counters.h"
 
-static void print_usage(const char* program_name) {
-    printf("Usage: %s [OPTIONS] [COMMAND]\n", program_name);
-    printf("\nCommands:\n");
-    printf("  benchmark           Run performance benchmarks\n");
-    printf("  capabilities        Show optimization capabilities\n");
-    printf("  test-jit            Test JIT compiler functionality\n");
-    printf("  test-memory         Test memory optimization\n");
-    printf("  test-vm-pool        Test VM pool functionality\n");
-    printf("  demo                Run optimization demo\n");
-    printf("\nOptions:\n");
-    printf("  -h, --help          Show this help message\n");
-    printf("  -v, --verbose       Enable verbose output\n");
-    printf("  -j, --jit           Enable JIT compiler\n");
-    printf("  -m, --memory        Enable memory optimization\n");
-    printf("  -p, --pool          Enable VM pool\n");
-    printf("  -t, --threshold N   Set JIT hot threshold (default: 1000)\n");
-    printf("  -i, --iterations N  Set benchmark iterations (default: 10000)\n");
-    printf("  -w, --warmup N      Set warmup iterations (default: 1000)\n");
-    printf("  -o, --output FILE   Save benchmark results to file\n");
-    printf("  --opt-level N       Set optimization level 0-3 (default: 2)\n");
-    printf("  --no-profiling      Disable JIT profiling\n");
-    printf("  --no-deopt          Disable JIT deoptimization\n");
-    printf("  --aggressive        Enable aggressive optimizations\n");
-    printf("\nExamples:\n");
-    printf("  %s benchmark -j -m -i 50000\n", program_name);
-    printf("  %s test-jit --aggressive -t 500\n", program_name);
-    printf("  %s demo --opt-level 3 -v\n", program_name);
+// Benchmark suite. Every workload runs in its own VM: warmup runs first
+// (they also warm the quickening and JIT caches), then the measured runs,
+// each timed on its own so the report can give percentiles rather than a
+// single mean. Inputs are fixed and every run returns a checksum, which has
+// to come out the same each time; comparing checksums between releases
+// shows the same work was measured.
+//
+// Alongside time, every benchmark reports what its measured runs cost in
+// instructions, allocations and collections, and in hardware counters where
+// perf_event_open is allowed. These barely move with load on the host, so
+// they catch small regressions that noisy CI timings hide.
+//
+// Script workloads define fn bench() and are called through a function
+// handle. With --profile-dir each one starts from the warm-start profile
+// its last run saved there (ember_vm_load_warm_profile) and saves a new one
+// at the end; the "first" column, the very first call in the VM, shows
+// what a freshly deployed process pays with and without one. Sets and regexes have no script syntax in this tree and module
+// loading needs files, so those workloads drive the runtime from C.
+
+#define DEFAULT_ITERATIONS 20
+#define DEFAULT_WARMUP 3
+
+typedef struct {
+    ember_vm* vm;
+    char module_dir[64];         // Temporary directory of the module benchmark
+} bench_context;
+
+typedef struct {
+    const char* name;
+    const char* description;
+    const char* source;          // Script defining fn bench(), or NULL
+    int (*setup)(bench_context* ctx);
+    int (*run)(bench_context* ctx, double* checksum);
+    void (*teardown)(bench_context* ctx);
+} benchmark;
+
+typedef struct {
+    const benchmark* bench;
+    const char* error;           // NULL if every run succeeded
+    double checksum;
+    bool unstable;               // Runs disagreed on the checksum
+    int runs;
+    double first_us;             // The first run, warmup or not
+    bool warm_start;             // Started from a saved profile
+    double min_us, mean_us, stddev_us, median_us, p90_us, p99_us, max_us;
+    // Means per measured run
+    double instructions, allocations, bytes_allocated, gc_collections;
+    unsigned hardware;           // Bit per perf_counter in hardware_counts
+    double hardware_counts[PERF_COUNTER_COUNT];
+} bench_result;
+
+typedef struct {
+    int iterations;
+    int warmup;
+    bool jit;
+    int jit_threshold;
+    int opt_level;               // -1: leave the VM default
+    bool verbose;
+    const char* profile_dir;     // Warm-start profiles of script workloads, or NULL
+} bench_options;
+
+// ============================================================================
+// WORKLOADS
+// ============================================================================
+
+static const char fib_source[] =
+    "fn fib(n) {\n"
+    "    if (n < 2) {\n"
+    "        return n\n"
+    "    }\n"
+    "    return fib(n - 1) + fib(n - 2)\n"
+    "}\n"
+    "fn bench() {\n"
+    "    return fib(20)\n"
+    "}\n";
+
+static const char loop_source[] =
+    "fn bench() {\n"
+    "    total = 0\n"
+    "    i = 0\n"
+    "    while (i < 200000) {\n"
+    "        total = total + (i * 3 + 7) % 11 - i / 4\n"
+    "        i = i + 1\n"
+    "    }\n"
+    "    return total\n"
+    "}\n";
+
+static const char string_source[] =
+    "fn bench() {\n"
+    "    s = \"\"\n"
+    "    i = 0\n"
+    "    while (i < 5000) {\n"
+    "        s = s + str(i) + \",\"\n"
+    "        i = i + 1\n"
+    "    }\n"
+    "    parts = split(s, \",\")\n"
+    "    return len(join(parts, \";\")) + len(parts)\n"
+    "}\n";
+
+static const char json_source[] =
+    "fn bench() {\n"
+    "    total = 0\n"
+    "    i = 0\n"
+    "    while (i < 500) {\n"
+    "        record = {\"id\": i, \"name\": \"user\" + str(i), \"score\": i * 1.5, \"tags\": [\"a\", \"b\", \"c\"], \"active\": true}\n"
+    "        text = json_stringify(record)\n"
+    "        parsed = json_parse(text)\n"
+    "        total = total + parsed[\"id\"] + len(text)\n"
+    "        i = i + 1\n"
+    "    }\n"
+    "    return total\n"
+    "}\n";
+
+static const char map_source[] =
+    "fn bench() {\n"
+    "    total = 0\n"
+    "    round = 0\n"
+    "    while (round < 20) {\n"
+    "        m = {}\n"
+    "        i = 0\n"
+    "        while (i < 1000) {\n"
+    "            m[\"k\" + str(i)] = i + round\n"
+    "            i = i + 1\n"
+    "        }\n"
+    "        i = 0\n"
+    "        while (i < 1000) {\n"
+    "            total = total + m[\"k\" + str((i * 7) % 1000)]\n"
+    "            i = i + 1\n"
+    "        }\n"
+    "        round = round + 1\n"
+    "    }\n"
+    "    return total\n"
+    "}\n";
+
+static const char oop_source[] =
+    "class Shape {\n"
+    "    fn init(size) {\n"
+    "        this.size = size\n"
+    "    }\n"
+    "    fn area() {\n"
+    "        return this.size * this.size\n"
+    "    }\n"
+    "}\n"
+    "class Circle extends Shape {\n"
+    "    fn area() {\n"
+    "        return this.size * this.size * 3\n"
+    "    }\n"
+    "}\n"
+    "fn bench() {\n"
+    "    shapes = [new Shape(1), new Circle(2), new Shape(3), new Circle(4)]\n"
+    "    total = 0\n"
+    "    i = 0\n"
+    "    while (i < 50000) {\n"
+    "        total = total + shapes[i % 4].area()\n"
+    "        fresh = new Shape(i % 5)\n"
+    "        total = total + fresh.area()\n"
+    "        i = i + 1\n"
+    "    }\n"
+    "    return total\n"
+    "}\n";
+
+// Insert, probe and remove numbers in a set that keeps about 4096 members
+static int run_sets(bench_context* ctx, double* checksum) {
+    ember_vm* vm = ctx->vm;
+    ember_value set_value = ember_make_set(vm);
+    if (set_value.type != EMBER_VAL_SET) return -1;
+    vm->stack[vm->stack_top++] = set_value;
+    ember_set* set = AS_SET(set_value);
+    double hits = 0;
+    for (int i = 0; i < 50000; i++) {
+        set_add(set, ember_make_number((double)(i % 8192)));
+        hits += set_has(set, ember_make_number((double)((i * 31) % 8192)));
+        if (i % 2) set_delete(set, ember_make_number((double)((i * 17) % 8192)));
+    }
+    vm->stack_top--;
+    *checksum = hits;
+    return 0;
 }
 
-static void print_capabilities(void) {
-    ember_optimization_capabilities_t caps = ember_get_optimization_capabilities();
-    
-    printf("=== Ember Platform Optimization Capabilities ===\n\n");
-    
-    printf("JIT Compiler:\n");
-    printf("  Available: %s\n", caps.jit_compiler_available ? "Yes" : "No");
-    printf("  x86-64 support: %s\n", caps.jit_x86_64_support ? "Yes" : "No");
-    printf("  ARM64 support: %s\n", caps.jit_arm64_support ? "Yes" : "No");
-    printf("  Profiling support: %s\n", caps.jit_profiling_support ? "Yes" : "No");
-    printf("  Deoptimization support: %s\n", caps.jit_deoptimization_support ? "Yes" : "No");
-    
-    printf("\nMemory Optimization:\n");
-    printf("  Arena allocator: %s\n", caps.arena_allocator_available ? "Yes" : "No");
-    printf("  NUMA support: %s\n", caps.numa_support ? "Yes" : "No");
-    printf("  Huge pages support: %s\n", caps.huge_pages_support ? "Yes" : "No");
-    printf("  Memory pools: %s\n", caps.memory_pool_support ? "Yes" : "No");
-    
-    printf("\nVM Pool:\n");
-    printf("  Available: %s\n", caps.vm_pool_available ? "Yes" : "No");
-    printf("  Work stealing: %s\n", caps.work_stealing_support ? "Yes" : "No");
-    printf("  Lock-free support: %s\n", caps.lockfree_support ? "Yes" : "No");
-    printf("  CPU affinity: %s\n", caps.cpu_affinity_support ? "Yes" : "No");
-    
-    printf("\nPlatform Features:\n");
-    printf("  SIMD support: %s\n", caps.simd_support ? "Yes" : "No");
-    printf("  Prefetch support: %s\n", caps.prefetch_support ? "Yes" : "No");
-    printf("  Branch prediction: %s\n", caps.branch_prediction_support ? "Yes" : "No");
-    printf("  Max optimization level: %d\n", caps.max_optimization_level);
-    
-    printf("\n===============================================\n");
+// Match and rewrite generated log lines
+static int run_regex(bench_context* ctx, double* checksum) {
+    ember_vm* vm = ctx->vm;
+    ember_value regex_value = ember_make_regex(vm, "[a-z]+[0-9]*@[a-z]+\\.(com|org)", REGEX_NONE);
+    if (regex_value.type != EMBER_VAL_REGEX) return -1;
+    vm->stack[vm->stack_top++] = regex_value;
+    ember_regex* regex = AS_REGEX(regex_value);
+    double total = 0;
+    char line[128];
+    for (int i = 0; i < 5000; i++) {
+        snprintf(line, sizeof(line), "%d GET /item/%d from user%d@%s.%s status=%d",
+                 i, i * 7 % 1000, i % 97, i % 3 ? "example" : "mail", i % 2 ? "com" : "net", 200 + i % 5);
+        if (ember_regex_test(vm, regex, line)) total += 1;
+        if (i % 10 == 0) {
+            ember_value rewritten = ember_regex_replace(vm, regex, line, "<email>");
+            if (rewritten.type == EMBER_VAL_STRING) total += (double)AS_STRING(rewritten)->length;
+        }
+    }
+    vm->stack_top--;
+    *checksum = total;
+    return 0;
 }
 
-static int test_jit_compiler(ember_optimization_config_t* config) {
-    printf("=== Testing JIT Compiler ===\n");
-    
-    // Initialize optimizations
-    if (ember_initialize_optimizations(config) != 0) {
-        printf("Failed to initialize optimizations\n");
-        return 1;
+#define MODULE_COUNT 8
+
+static void module_path(const bench_context* ctx, int index, char* path, size_t size) {
+    snprintf(path, size, "%s/bench_module_%d.ember", ctx->module_dir, index);
+}
+
+static int setup_modules(bench_context* ctx) {
+    snprintf(ctx->module_dir, sizeof(ctx->module_dir), "/tmp/ember-bench-XXXXXX");
+    if (!mkdtemp(ctx->module_dir)) return -1;
+    for (int m = 0; m < MODULE_COUNT; m++) {
+        char path[128];
+        module_path(ctx, m, path, sizeof(path));
+        FILE* file = fopen(path, "w");
+        if (!file) return -1;
+        for (int f = 0; f < 20; f++) {
+            fprintf(file, "fn module_%d_helper_%d(a, b) {\n", m, f);
+            fprintf(file, "    if (a > b) {\n        return a - b + %d\n    }\n", f);
+            fprintf(file, "    return a * b + %d\n}\n", m);
+        }
+        fprintf(file, "module_%d_table = {\"name\": \"module %d\", \"size\": %d}\n", m, m, 20);
+        fclose(file);
     }
-    
-    // Create optimized VM
-    ember_vm* vm = ember_create_optimized_vm(config);
-    if (!vm) {
-        printf("Failed to create optimized VM\n");
-        ember_shutdown_optimizations();
-        return 1;
+    return 0;
+}
+
+// Each run starts from an empty module registry, so every file is loaded
+// again (resolved paths stay cached, as they would in a long-lived host)
+static int run_modules(bench_context* ctx, double* checksum) {
+    ember_module_system_cleanup();
+    for (int m = 0; m < MODULE_COUNT; m++) {
+        char path[128];
+        module_path(ctx, m, path, sizeof(path));
+        if (ember_load_module(ctx->vm, path, NULL).type == EMBER_VAL_NIL) return -1;
     }
-    
-    printf("JIT compiler initialized successfully\n");
-    
-    // Test basic compilation
-    ember_chunk test_chunk = {0};
-    test_chunk.count = 20;
-    test_chunk.code = malloc(test_chunk.count);
-    
-    // Create simple arithmetic bytecode
-    for (int i = 0; i < test_chunk.count; i++) {
-        if (i % 4 == 0) test_chunk.code[i] = OP_PUSH_CONST;
-        else if (i % 4 == 1) test_chunk.code[i] = OP_ADD;
-        else if (i % 4 == 2) test_chunk.code[i] = OP_MUL;
-        else test_chunk.code[i] = OP_SUB;
+    *checksum = MODULE_COUNT;
+    return 0;
+}
+
+static void teardown_modules(bench_context* ctx) {
+    for (int m = 0; m < MODULE_COUNT; m++) {
+        char path[128];
+        module_path(ctx, m, path, sizeof(path));
+        remove(path);
     }
-    
-    // Trigger hot path detection
-    printf("Triggering hot path detection...\n");
-    for (int i = 0; i < config->jit_hot_threshold + 100; i++) {
-        if (ember_check_and_compile_hot_path(vm, &test_chunk, 0)) {
-            printf("Hot path compiled after %d iterations\n", i + 1);
-            break;
-        }
+    rmdir(ctx->module_dir);
+    ember_module_system_cleanup();
+}
+
+static const benchmark benchmarks[] = {
+    {"fib", "Recursive fib(20): calls and returns", fib_source, NULL, NULL, NULL},
+    {"loop", "200k iterations of integer arithmetic", loop_source, NULL, NULL, NULL},
+    {"string", "Build a 5000-part string, split and join it", string_source, NULL, NULL, NULL},
+    {"json", "500 json_stringify/json_parse round trips", json_source, NULL, NULL, NULL},
+    {"map", "Fill and probe 20 hash maps of 1000 keys", map_source, NULL, NULL, NULL},
+    {"oop", "50k virtual method calls and allocations", oop_source, NULL, NULL, NULL},
+    {"set", "50k set inserts, probes and deletes", NULL, NULL, run_sets, NULL},
+    {"regex", "Match 5000 log lines, rewrite every tenth", NULL, NULL, run_regex, NULL},
+    {"module", "Load 8 modules of 20 functions from disk", NULL, setup_modules, run_modules, teardown_modules},
+};
+
+#define BENCHMARK_COUNT ((int)(sizeof(benchmarks) / sizeof(benchmarks[0])))
+
+// ============================================================================
+// RUNNER
+// ============================================================================
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double left = *(const double*)a;
+    double right = *(const double*)b;
+    return left < right ? -1 : left > right ? 1 : 0;
+}
+
+// Nearest rank on sorted samples
+static double percentile(const double* sorted, int count, double p) {
+    int rank = (int)ceil(p / 100.0 * count);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+static void summarize(bench_result* result, double* samples, int count) {
+    qsort(samples, (size_t)count, sizeof(double), compare_doubles);
+    double sum = 0;
+    for (int i = 0; i < count; i++) sum += samples[i];
+    double mean = sum / count;
+    double variance = 0;
+    for (int i = 0; i < count; i++) variance += (samples[i] - mean) * (samples[i] - mean);
+    result->runs = count;
+    result->min_us = samples[0];
+    result->max_us = samples[count - 1];
+    result->mean_us = mean;
+    result->stddev_us = count > 1 ? sqrt(variance / (count - 1)) : 0;
+    result->median_us = percentile(samples, count, 50);
+    result->p90_us = percentile(samples, count, 90);
+    result->p99_us = percentile(samples, count, 99);
+}
+
+typedef struct {
+    uint64_t instructions, allocations, bytes_allocated, gc_collections;
+    perf_sample hardware;
+} bench_counters;
+
+static void take_counters(const ember_vm* vm, const perf_counters* perf, bench_counters* counters) {
+    counters->instructions = vm->instructions_executed;
+    counters->allocations = vm->memory_allocations;
+    counters->bytes_allocated = vm->memory_allocated_bytes;
+    counters->gc_collections = vm->gc_collections;
+    perf_counters_read(perf, &counters->hardware);
+}
+
+static void record_counters(bench_result* result, const bench_counters* start, const bench_counters* end, int runs) {
+    result->instructions = (double)(end->instructions - start->instructions) / runs;
+    result->allocations = (double)(end->allocations - start->allocations) / runs;
+    result->bytes_allocated = (double)(end->bytes_allocated - start->bytes_allocated) / runs;
+    result->gc_collections = (double)(end->gc_collections - start->gc_collections) / runs;
+    perf_sample delta;
+    perf_sample_delta(&start->hardware, &end->hardware, &delta);
+    result->hardware = delta.available;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        result->hardware_counts[i] = (double)delta.values[i] / runs;
     }
-    
-    // Test JIT execution
-    printf("Testing JIT execution...\n");
-    for (int i = 0; i < 10; i++) {
-        if (ember_try_jit_execute(vm, &test_chunk, 0)) {
-            printf("JIT execution successful (iteration %d)\n", i + 1);
-        }
+}
+
+static int run_once(const benchmark* bench, bench_context* ctx, ember_function_handle* handle, double* checksum) {
+    if (handle) {
+        ember_value value;
+        if (ember_function_call(handle, 0, NULL, &value) != 0) return -1;
+        *checksum = value.type == EMBER_VAL_NUMBER ? value.as.number_val : 0;
+        return 0;
     }
-    
-    // Print statistics
-    ember_print_optimization_stats(vm);
-    
-    // Cleanup
-    free(test_chunk.code);
-    ember_free_vm(vm);
-    ember_shutdown_optimizations();
-    
-    printf("JIT test completed successfully\n");
-    return 0;
+    return bench->run(ctx, checksum);
 }
 
-static int test_memory_optimization(ember_optimization_config_t* config) {
-    printf("=== Testing Memory Optimization ===\n");
-    
-    // Initialize optimizations
-    if (ember_initialize_optimizations(config) != 0) {
-        printf("Failed to initialize optimizations\n");
-        return 1;
+static bench_result run_benchmark(const benchmark* bench, const bench_options* options) {
+    bench_result result;
+    memset(&result, 0, sizeof(result));
+    result.bench = bench;
+
+    bench_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.vm = ember_new_vm();
+    if (!ctx.vm) {
+        result.error = "cannot create a VM";
+        return result;
     }
-    
-    // Create optimized VM
-    ember_vm* vm = ember_create_optimized_vm(config);
-    if (!vm) {
-        printf("Failed to create optimized VM\n");
-        ember_shutdown_optimizations();
-        return 1;
+    if (options->jit) {
+        ember_jit_configure(ctx.vm, 1, options->jit_threshold);
+    }
+
+    ember_function_handle* handle = NULL;
+    if (bench->source) {
+        if (ember_eval(ctx.vm, bench->source) != 0) {
+            result.error = "script failed to compile or run";
+        } else if (!(handle = ember_function_resolve(ctx.vm, "bench"))) {
+            result.error = "script defines no bench()";
+        }
     }
-    
-    printf("Memory optimization initialized successfully\n");
-    
-    // Test various allocation sizes
-    printf("Testing memory allocations...\n");
-    
-    void* ptrs[1000];
-    size_t sizes[] = {16, 32, 64, 128, 256, 512, 1024, 2048};
-    int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
-    
-    // Allocate various sizes
-    for (int i = 0; i < 1000; i++) {
-        size_t size = sizes[i % num_sizes];
-        ptrs[i] = ember_optimized_alloc(vm, size);
-        if (!ptrs[i]) {
-            printf("Allocation failed at iteration %d (size %zu)\n", i, size);
+    char profile_path[PATH_MAX];
+    bool profiled = bench->source && options->profile_dir &&
+                    snprintf(profile_path, sizeof(profile_path), "%s/%s.warm", options->profile_dir,
+                             bench->name) < (int)sizeof(profile_path);
+    if (!result.error && profiled) {
+        result.warm_start = ember_vm_load_warm_profile(ctx.vm, bench->source, profile_path) == EMBER_SUCCESS;
+    } else if (bench->setup && bench->setup(&ctx) != 0) {
+        result.error = "setup failed";
+    }
+
+    double* samples = malloc((size_t)options->iterations * sizeof(double));
+    if (!result.error && !samples) result.error = "out of memory";
+    perf_counters perf;
+    perf_counters_open(&perf);
+    bench_counters start, end;
+    for (int i = 0; !result.error && i < options->warmup + options->iterations; i++) {
+        if (i == options->warmup) take_counters(ctx.vm, &perf, &start);
+        double checksum = 0;
+        double start = now_us();
+        int status = run_once(bench, &ctx, handle, &checksum);
+        double elapsed = now_us() - start;
+        if (status != 0) {
+            result.error = "run failed";
             break;
         }
-        
-        // Write some data to verify allocation
-        memset(ptrs[i], i % 256, size);
+        if (i == 0) {
+            result.checksum = checksum;
+            result.first_us = elapsed;
+        } else if (checksum != result.checksum) {
+            result.unstable = true;
+        }
+        if (i >= options->warmup) {
+            samples[i - options->warmup] = elapsed;
+        }
+        if (options->verbose) {
+            fprintf(stderr, "  %s %s %d: %.1f us\n", bench->name, i < options->warmup ? "warmup" : "run",
+                    i < options->warmup ? i + 1 : i - options->warmup + 1, elapsed);
+        }
     }
-    
-    printf("Allocated 1000 memory blocks successfully\n");
-    
-    // Test calloc
-    void* zero_ptr = ember_optimized_calloc(vm, 100, sizeof(int));
-    if (zero_ptr) {
-        int* int_array = (int*)zero_ptr;
-        bool all_zero = true;
-        for (int i = 0; i < 100; i++) {
-            if (int_array[i] != 0) {
-                all_zero = false;
-                break;
-            }
+    if (!result.error) {
+        take_counters(ctx.vm, &perf, &end);
+        record_counters(&result, &start, &end, options->iterations);
+        summarize(&result, samples, options->iterations);
+        if (profiled && ember_vm_save_warm_profile(ctx.vm, bench->source, profile_path) != EMBER_SUCCESS) {
+            fprintf(stderr, "Warning: cannot save the warm-start profile of %s\n", bench->name);
         }
-        printf("Calloc test: %s\n", all_zero ? "PASSED" : "FAILED");
     }
-    
-    // Print statistics
-    ember_print_optimization_stats(vm);
-    
-    // Cleanup
-    ember_free_vm(vm);
-    ember_shutdown_optimizations();
-    
-    printf("Memory optimization test completed successfully\n");
-    return 0;
+    perf_counters_close(&perf);
+
+    free(samples);
+    if (handle) ember_function_release(handle);
+    if (bench->teardown) bench->teardown(&ctx);
+    ember_free_vm(ctx.vm);
+    return result;
 }
 
-static int run_optimization_demo(ember_optimization_config_t* config) {
-    printf("=== Ember Platform Optimization Demo ===\n");
-    
-    // Initialize optimizations
-    if (ember_initialize_optimizations(config) != 0) {
-        printf("Failed to initialize optimizations\n");
-        return 1;
+// ============================================================================
+// REPORTS
+// ============================================================================
+
+static void print_table(const bench_result* results, int count) {
+    printf("%-8s %10s %10s %10s %10s %10s %8s %10s  %s\n",
+           "name", "median ms", "p90 ms", "p99 ms", "min ms", "mean ms", "stddev", "first ms", "checksum");
+    for (int i = 0; i < count; i++) {
+        const bench_result* r = &results[i];
+        if (r->error) {
+            printf("%-8s %s\n", r->bench->name, r->error);
+            continue;
+        }
+        printf("%-8s %10.3f %10.3f %10.3f %10.3f %10.3f %7.1f%% %10.3f  %.17g%s%s\n", r->bench->name,
+               r->median_us / 1000, r->p90_us / 1000, r->p99_us / 1000, r->min_us / 1000,
+               r->mean_us / 1000, r->mean_us > 0 ? r->stddev_us / r->mean_us * 100 : 0,
+               r->first_us / 1000, r->checksum, r->unstable ? " (unstable)" : "",
+               r->warm_start ? " (warm)" : "");
     }
-    
-    printf("Running comprehensive optimization demo...\n");
-    
-    // Create optimized VM
-    ember_vm* vm = ember_create_optimized_vm(config);
-    if (!vm) {
-        printf("Failed to create optimized VM\n");
-        ember_shutdown_optimizations();
-        return 1;
+
+    // Per measured run; hardware columns show - where perf_event_open is not allowed
+    printf("\n%-8s %14s %12s %12s %8s", "name", "instructions", "allocations", "KB alloc", "GCs");
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        printf(" %14s", perf_counter_name((perf_counter)i));
     }
-    
-    // Demo 1: JIT compilation workflow
-    if (config->enable_jit_compiler) {
-        printf("\n--- JIT Compilation Demo ---\n");
-        
-        ember_chunk demo_chunk = {0};
-        demo_chunk.count = 50;
-        demo_chunk.code = malloc(demo_chunk.count);
-        
-        // Create more complex bytecode
-        for (int i = 0; i < demo_chunk.count; i++) {
-            switch (i % 8) {
-                case 0: demo_chunk.code[i] = OP_PUSH_CONST; break;
-                case 1: demo_chunk.code[i] = OP_PUSH_CONST; break;
-                case 2: demo_chunk.code[i] = OP_ADD; break;
-                case 3: demo_chunk.code[i] = OP_PUSH_CONST; break;
-                case 4: demo_chunk.code[i] = OP_MUL; break;
-                case 5: demo_chunk.code[i] = OP_SUB; break;
-                case 6: demo_chunk.code[i] = OP_LOOP; break;
-                case 7: demo_chunk.code[i] = OP_JUMP_IF_FALSE; break;
-            }
-        }
-        
-        printf("Simulating hot loop execution...\n");
-        int compiled_at = -1;
-        for (int i = 0; i < config->jit_hot_threshold + 200; i++) {
-            if (ember_check_and_compile_hot_path(vm, &demo_chunk, 0)) {
-                compiled_at = i + 1;
-                printf("Hot path compiled after %d iterations\n", compiled_at);
-                break;
-            }
-            
-            if (i % 100 == 0 && i > 0) {
-                printf("  Profiling... (%d iterations)\n", i);
+    printf("\n");
+    for (int i = 0; i < count; i++) {
+        const bench_result* r = &results[i];
+        if (r->error) continue;
+        printf("%-8s %14.0f %12.1f %12.1f %8.2f", r->bench->name, r->instructions, r->allocations,
+               r->bytes_allocated / 1024, r->gc_collections);
+        for (int j = 0; j < PERF_COUNTER_COUNT; j++) {
+            if (r->hardware & (1u << j)) {
+                printf(" %14.0f", r->hardware_counts[j]);
+            } else {
+                printf(" %14s", "-");
             }
         }
-        
-        if (compiled_at > 0) {
-            printf("Testing compiled code execution...\n");
-            int successful_executions = 0;
-            for (int i = 0; i < 100; i++) {
-                if (ember_try_jit_execute(vm, &demo_chunk, 0)) {
-                    successful_executions++;
-                }
-            }
-            printf("JIT executions: %d/100 successful\n", successful_executions);
-        }
-        
-        free(demo_chunk.code);
+        printf("\n");
     }
-    
-    // Demo 2: Memory optimization showcase
-    if (config->enable_memory_optimization) {
-        printf("\n--- Memory Optimization Demo ---\n");
-        
-        printf("Demonstrating arena allocation patterns...\n");
-        
-        // Simulate typical VM allocation patterns
-        void* small_objects[100];
-        void* medium_objects[50];
-        void* large_objects[10];
-        
-        // Small object allocations (typical for values)
-        for (int i = 0; i < 100; i++) {
-            small_objects[i] = ember_optimized_alloc(vm, 16 + (i % 48));
-        }
-        printf("Allocated 100 small objects\n");
-        
-        // Medium object allocations (typical for strings/arrays)
-        for (int i = 0; i < 50; i++) {
-            medium_objects[i] = ember_optimized_alloc(vm, 128 + (i % 896));
+}
+
+static int write_json(const char* path, const bench_result* results, int count, const bench_options* options) {
+    FILE* file = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return -1;
+    }
+    struct utsname host;
+    if (uname(&host) != 0) strcpy(host.machine, "unknown");
+    char date[32];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"suite\": \"ember-optimize\",\n");
+    fprintf(file, "  \"version\": \"%s\",\n", EMBER_VERSION);
+    fprintf(file, "  \"date\": \"%s\",\n", date);
+    fprintf(file, "  \"machine\": \"%s\",\n", host.machine);
+#ifdef __VERSION__
+    fprintf(file, "  \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+    fprintf(file, "  \"config\": {\"iterations\": %d, \"warmup\": %d, \"jit\": %s, \"opt_level\": %d},\n",
+            options->iterations, options->warmup, options->jit ? "true" : "false", options->opt_level);
+    fprintf(file, "  \"unit\": \"us\",\n");
+    fprintf(file, "  \"benchmarks\": [");
+    for (int i = 0; i < count; i++) {
+        const bench_result* r = &results[i];
+        fprintf(file, "%s\n    {\"name\": \"%s\", \"description\": \"%s\", ", i ? "," : "",
+                r->bench->name, r->bench->description);
+        if (r->error) {
+            fprintf(file, "\"error\": \"%s\"}", r->error);
+            continue;
         }
-        printf("Allocated 50 medium objects\n");
-        
-        // Large object allocations (typical for functions/modules)
-        for (int i = 0; i < 10; i++) {
-            large_objects[i] = ember_optimized_alloc(vm, 4096 + (i % 4096));
+        fprintf(file, "\"runs\": %d, \"min\": %.3f, \"median\": %.3f, \"p90\": %.3f, \"p99\": %.3f, "
+                      "\"max\": %.3f, \"mean\": %.3f, \"stddev\": %.3f, \"first\": %.3f, \"warm_start\": %s, "
+                      "\"checksum\": %.17g, \"stable\": %s",
+                r->runs, r->min_us, r->median_us, r->p90_us, r->p99_us, r->max_us, r->mean_us,
+                r->stddev_us, r->first_us, r->warm_start ? "true" : "false", r->checksum,
+                r->unstable ? "false" : "true");
+        fprintf(file, ",\n     \"counters\": {\"instructions\": %.1f, \"allocations\": %.1f, "
+                      "\"bytes_allocated\": %.1f, \"gc_collections\": %.3f",
+                r->instructions, r->allocations, r->bytes_allocated, r->gc_collections);
+        for (int j = 0; j < PERF_COUNTER_COUNT; j++) {
+            if (r->hardware & (1u << j)) {
+                fprintf(file, ", \"%s\": %.1f", perf_counter_name((perf_counter)j), r->hardware_counts[j]);
+            }
         }
-        printf("Allocated 10 large objects\n");
+        fprintf(file, "}}");
     }
-    
-    // Print comprehensive statistics
-    printf("\n--- Final Statistics ---\n");
-    ember_print_optimization_stats(vm);
-    
-    // Cleanup
-    ember_free_vm(vm);
-    ember_shutdown_optimizations();
-    
-    printf("\nOptimization demo completed successfully\n");
+    fprintf(file, "\n  ]\n}\n");
+    if (file != stdout) fclose(file);
     return 0;
 }
 
+static const benchmark* find_benchmark(const char* name) {
+    for (int i = 0; i < BENCHMARK_COUNT; i++) {
+        if (strcmp(benchmarks[i].name, name) == 0) return &benchmarks[i];
+    }
+    return NULL;
+}
+
+static void list_benchmarks(void) {
+    for (int i = 0; i < BENCHMARK_COUNT; i++) {
+        printf("  %-8s %s\n", benchmarks[i].name, benchmarks[i].description);
+    }
+}
+
+static void print_usage(const char* program_name) {
+    printf("Usage: %s [OPTIONS] COMMAND [BENCHMARK...]\n", program_name);
+    printf("\nCommands:\n");
+    printf("  benchmark           Run the named benchmarks, or all of them\n");
+    printf("  list                List the benchmarks\n");
+    printf("\nOptions:\n");
+    printf("  -h, --help          Show this help message\n");
+    printf("  -v, --verbose       Print every run\n");
+    printf("  -j, --jit           Enable the JIT compiler\n");
+    printf("  -t, --threshold N   JIT hot threshold (default: the VM's)\n");
+    printf("  -i, --iterations N  Measured runs per benchmark (default: %d)\n", DEFAULT_ITERATIONS);
+    printf("  -w, --warmup N      Unmeasured runs first (default: %d)\n", DEFAULT_WARMUP);
+    printf("  -o, --output FILE   Also write the results as JSON (- for stdout)\n");
+    printf("  --opt-level N       Bytecode optimization level 0-3\n");
+    printf("  --profile-dir DIR   Start scripts from warm-start profiles in DIR and save new ones\n");
+    printf("\nExamples:\n");
+    printf("  %s benchmark -o release.json\n", program_name);
+    printf("  %s benchmark -j -i 50 fib loop\n", program_name);
+    printf("  %s benchmark -j --profile-dir /tmp/warm oop   (run twice: first ms drops)\n", program_name);
+}
+
 int main(int argc, char* argv[]) {
-    // Default configuration
-    ember_optimization_config_t config = DEFAULT_OPTIMIZATION_CONFIG;
-    benchmark_config_t benchmark_config = DEFAULT_BENCHMARK_CONFIG;
-    
-    // Command line options
-    bool verbose = false;
+    bench_options options = {DEFAULT_ITERATIONS, DEFAULT_WARMUP, false, 0, -1, false, NULL};
     const char* output_file = NULL;
-    const char* command = NULL;
-    
-    // Parse command line options
+
     static struct option long_options[] = {
         {"help", no_argument, 0, 'h'},
         {"verbose", no_argument, 0, 'v'},
         {"jit", no_argument, 0, 'j'},
-        {"memory", no_argument, 0, 'm'},
-        {"pool", no_argument, 0, 'p'},
         {"threshold", required_argument, 0, 't'},
         {"iterations", required_argument, 0, 'i'},
         {"warmup", required_argument, 0, 'w'},
         {"output", required_argument, 0, 'o'},
         {"opt-level", required_argument, 0, 1001},
-        {"no-profiling", no_argument, 0, 1002},
-        {"no-deopt", no_argument, 0, 1003},
-        {"aggressive", no_argument, 0, 1004},
+        {"profile-dir", required_argument, 0, 1002},
         {0, 0, 0, 0}
     };
-    
-    int option_index = 0;
+
     int c;
-    
-    while ((c = getopt_long(argc, argv, "hvjmpt:i:w:o:", long_options, &option_index)) != -1) {
+    while ((c = getopt_long(argc, argv, "hvjt:i:w:o:", long_options, NULL)) != -1) {
         switch (c) {
             case 'h':
                 print_usage(argv[0]);
                 return 0;
-                
             case 'v':
-                verbose = true;
-                config.jit_verbose = true;
-                benchmark_config.verbose_output = true;
+                options.verbose = true;
                 break;
-                
             case 'j':
-                config.enable_jit_compiler = true;
-                benchmark_config.enable_jit = true;
-                break;
-                
-            case 'm':
-                config.enable_memory_optimization = true;
-                benchmark_config.enable_memory_opt = true;
-                break;
-                
-            case 'p':
-                config.enable_vm_pool = true;
-                benchmark_config.enable_vm_pool = true;
+                options.jit = true;
                 break;
-                
             case 't':
-                config.jit_hot_threshold = atoi(optarg);
+                options.jit_threshold = atoi(optarg);
                 break;
-                
             case 'i':
-                benchmark_config.benchmark_iterations = atoi(optarg);
+                options.iterations = atoi(optarg);
                 break;
-                
             case 'w':
-                benchmark_config.warmup_iterations = atoi(optarg);
+                options.warmup = atoi(optarg);
                 break;
-                
             case 'o':
                 output_file = optarg;
                 break;
-                
             case 1001: // --opt-level
-                config.optimization_level = atoi(optarg);
-                if (config.optimization_level > 3) {
-                    config.optimization_level = 3;
-                }
+                options.opt_level = atoi(optarg);
+                if (options.opt_level > 3) options.opt_level = 3;
                 break;
-                
-            case 1002: // --no-profiling
-                config.jit_enable_profiling = false;
+            case 1002: // --profile-dir
+                options.profile_dir = optarg;
                 break;
-                
-            case 1003: // --no-deopt
-                config.jit_enable_deoptimization = false;
-                break;
-                
-            case 1004: // --aggressive
-                config.jit_aggressive_inlining = true;
-                config.optimization_level = 3;
-                break;
-                
-            case '?':
+            default:
                 print_usage(argv[0]);
                 return 1;
-                
-            default:
-                break;
         }
     }
-    
-    // Get command
-    if (optind < argc) {
-        command = argv[optind];
+    if (options.iterations < 1 || options.warmup < 0 || options.jit_threshold < 0) {
+        fprintf(stderr, "Error: iterations must be at least 1, warmup and threshold not negative\n");
+        return 1;
     }
-    
-    if (!command) {
-        printf("Error: No command specified\n");
+
+    if (optind >= argc) {
+        fprintf(stderr, "Error: No command specified\n");
         print_usage(argv[0]);
         return 1;
     }
-    
-    if (verbose) {
-        printf("Ember Platform Optimization Tool\n");
-        printf("Command: %s\n", command);
-        printf("JIT enabled: %s\n", config.enable_jit_compiler ? "Yes" : "No");
-        printf("Memory optimization: %s\n", config.enable_memory_optimization ? "Yes" : "No");
-        printf("VM pool: %s\n", config.enable_vm_pool ? "Yes" : "No");
-        printf("Optimization level: %d\n", config.optimization_level);
-        printf("\n");
-    }
-    
-    // Execute command
-    if (strcmp(command, "benchmark") == 0) {
-        comprehensive_benchmark_result_t result = run_comprehensive_benchmark(&benchmark_config);
-        generate_performance_report(&result, output_file);
-        free_comprehensive_result(&result);
-        return 0;
-        
-    } else if (strcmp(command, "capabilities") == 0) {
-        print_capabilities();
+    const char* command = argv[optind++];
+    if (strcmp(command, "list") == 0) {
+        list_benchmarks();
         return 0;
-        
-    } else if (strcmp(command, "test-jit") == 0) {
-        return test_jit_compiler(&config);
-        
-    } else if (strcmp(command, "test-memory") == 0) {
-        return test_memory_optimization(&config);
-        
-    } else if (strcmp(command, "test-vm-pool") == 0) {
-        printf("VM pool testing not yet implemented\n");
-        return 1;
-        
-    } else if (strcmp(command, "demo") == 0) {
-        return run_optimization_demo(&config);
-        
-    } else {
-        printf("Error: Unknown command '%s'\n", command);
+    }
+    if (strcmp(command, "benchmark") != 0) {
+        fprintf(stderr, "Error: Unknown command '%s'\n", command);
         print_usage(argv[0]);
         return 1;
     }
-}
\ No newline at end of file
+
+    const benchmark* selected[BENCHMARK_COUNT];
+    int count = 0;
+    for (int i = optind; i < argc; i++) {
+        const benchmark* bench = find_benchmark(argv[i]);
+        if (!bench) {
+            fprintf(stderr, "Error: Unknown benchmark '%s'; available:\n", argv[i]);
+            list_benchmarks();
+            return 1;
+        }
+        if (count < BENCHMARK_COUNT) selected[count++] = bench;
+    }
+    if (count == 0) {
+        for (int i = 0; i < BENCHMARK_COUNT; i++) selected[count++] = &benchmarks[i];
+    }
+    if (options.jit && !ember_jit_available()) {
+        fprintf(stderr, "Warning: this build has no JIT; running interpreted\n");
+        options.jit = false;
+    }
+    if (options.opt_level >= 0) {
+        vm_set_optimization_level(options.opt_level);
+    }
+
+    bench_result results[BENCHMARK_COUNT];
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        if (options.verbose) fprintf(stderr, "%s...\n", selected[i]->name);
+        results[i] = run_benchmark(selected[i], &options);
+        if (results[i].error || results[i].unstable) failed++;
+    }
+
+    print_table(results, count);
+    if (output_file && write_json(output_file, results, count, &options) != 0) {
+        return 1;
+    }
+    return failed ? 1 : 0;
+}
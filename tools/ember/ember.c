@@ -8,7 +8,7 @@
 #include <unistd.h>
 #include <math.h>
 #include <ctype.h>
-#include <sys/time.h>
+#include <limits.h>
 
 // Conditionally include readline if available
 #ifdef HAVE_READLINE
@@ -54,7 +54,9 @@ typedef struct {
     int paren_depth;
     int bracket_depth;
     int in_string;
+    int escaped;              // Last character scanned was a backslash inside a string
     int needs_continuation;
+    int packages_ready;       // Package system initialized for this session
 } repl_state;
 
 // Portable strdup implementation
@@ -146,7 +148,9 @@ static void init_repl_state(repl_state* state) {
     state->paren_depth = 0;
     state->bracket_depth = 0;
     state->in_string = 0;
+    state->escaped = 0;
     state->needs_continuation = 0;
+    state->packages_ready = 0;
     if (state->buffer) {
         state->buffer[0] = '\0';
     }
@@ -160,16 +164,29 @@ static void cleanup_repl_state(repl_state* state) {
     }
 }
 
-// Check if input needs continuation (unclosed braces, parens, etc.)
-static int needs_continuation(const char* input, repl_state* state) {
+// Forget the pending entry; depths start over for the next one
+static void reset_repl_entry(repl_state* state) {
+    state->buffer_used = 0;
+    state->buffer[0] = '\0';
     state->brace_depth = 0;
     state->paren_depth = 0;
     state->bracket_depth = 0;
     state->in_string = 0;
-    
-    for (const char* p = input; *p; p++) {
+    state->escaped = 0;
+    state->needs_continuation = 0;
+}
+
+// Check if input needs continuation (unclosed braces, parens, etc.).
+// Only the newest line is scanned; depths carry over from earlier lines
+// of the same entry so a long block is never rescanned.
+static int needs_continuation(const char* line, repl_state* state) {
+    for (const char* p = line; *p; p++) {
         if (state->in_string) {
-            if (*p == '"' && (p == input || *(p-1) != '\\')) {
+            if (state->escaped) {
+                state->escaped = 0;
+            } else if (*p == '\\') {
+                state->escaped = 1;
+            } else if (*p == '"') {
                 state->in_string = 0;
             }
             continue;
@@ -199,6 +216,8 @@ static int needs_continuation(const char* input, repl_state* state) {
                 break;
         }
     }
+    // A line break ends any escape
+    state->escaped = 0;
     
     return state->brace_depth > 0 || state->paren_depth > 0 || 
            state->bracket_depth > 0 || state->in_string;
@@ -247,12 +266,12 @@ static int append_to_buffer(repl_state* state, const char* line) {
         state->buffer_size = new_size;
     }
     
+    // Append at the known end instead of searching for it
     if (state->buffer_used > 0) {
-        strcat(state->buffer, "\n");
-        state->buffer_used++;
+        state->buffer[state->buffer_used++] = '\n';
     }
     
-    strcat(state->buffer, line);
+    memcpy(state->buffer + state->buffer_used, line, line_len + 1);
     state->buffer_used += line_len;
     
     return 0;
@@ -265,13 +284,20 @@ static void print_help(void) {
     printf("  %sember%s                           Start interactive REPL\n", COLOR_CYAN, COLOR_RESET);
     printf("  %sember%s %s<file>%s                   Execute script file\n", COLOR_CYAN, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
     printf("  %sember%s %s--mount <vfs:host> <file>%s Execute with VFS mount\n", COLOR_CYAN, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
+    printf("  %sember%s %s--profile[=out] <file>%s   Execute and write an execution profile (default: stderr)\n", COLOR_CYAN, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
+    printf("  %sember%s %s--sample[=out] <file>%s    Execute and write sampled stacks for flamegraphs (default: stderr)\n", COLOR_CYAN, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
+    printf("  %sember%s %s--startup-profile <file>%s Execute and report VM startup and module load times\n", COLOR_CYAN, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
+    printf("  %sember%s %s--heap-stats[=out] <file>%s Execute and write live objects by type (default: stderr)\n", COLOR_CYAN, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
+    printf("  %sember%s %s--heap-snapshot[=out] <file>%s Execute and write a heap snapshot for DevTools (default: ember.heapsnapshot)\n", COLOR_CYAN, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
+    printf("  %sember%s %s--warm-profile[=file] <file>%s Start from the type feedback of the last run and save it at exit (default: <file>.warm)\n", COLOR_CYAN, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
     printf("  %sember%s %sinstall <name> <path>%s    Install library\n", COLOR_CYAN, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
     printf("  %sember%s %s--help%s                   Show this help message\n", COLOR_CYAN, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
     printf("  %sember%s %s--version%s                Show version information\n", COLOR_CYAN, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
     
     printf("\n%sPERFORMANCE OPTIONS:%s\n", COLOR_BOLD, COLOR_RESET);
-    printf("  %sEMBER_PROFILE_STARTUP=1%s         Enable startup profiling\n", COLOR_YELLOW, COLOR_RESET);
+    printf("  %sEMBER_PROFILE_STARTUP=1%s         Same as --startup-profile\n", COLOR_YELLOW, COLOR_RESET);
     printf("  %sEMBER_LAZY_STDLIB=0%s             Disable lazy stdlib loading\n", COLOR_YELLOW, COLOR_RESET);
+    printf("  %sEMBER_PERF=map,jitdump%s          Name JIT code for Linux perf (perf map, jitdump)\n", COLOR_YELLOW, COLOR_RESET);
     printf("  %sEMBER_BYTECODE_CACHE=dir%s        Set bytecode cache directory\n", COLOR_YELLOW, COLOR_RESET);
     
     printf("\n%sEXAMPLES:%s\n", COLOR_BOLD, COLOR_RESET);
@@ -319,6 +345,45 @@ static void print_help(void) {
     printf("\n%sFor more information, visit:%s https://github.com/exec/ember\n", COLOR_GRAY, COLOR_RESET);
 }
 
+// What --heap-stats and --heap-snapshot ask for at exit
+typedef struct {
+    const char* stats_path;
+    const char* snapshot_path;
+} heap_report;
+
+// Report the profile of a --profile run, the stacks of a --sample run, the
+// startup phases of a --startup-profile run and the heap at exit
+static void write_profile(ember_vm* vm, const char* profile_path, const char* sample_path, int startup_profile,
+                          const heap_report* heap) {
+    if (startup_profile) {
+        ember_print_startup_profile();
+    }
+    if (heap->stats_path && ember_vm_write_heap_histogram(vm, heap->stats_path) != EMBER_SUCCESS) {
+        fprintf(stderr, "%sError:%s Could not write heap statistics to '%s'\n", COLOR_RED, COLOR_RESET, heap->stats_path);
+    }
+    if (heap->snapshot_path && ember_vm_write_heap_snapshot(vm, heap->snapshot_path) != EMBER_SUCCESS) {
+        fprintf(stderr, "%sError:%s Could not write heap snapshot to '%s'\n", COLOR_RED, COLOR_RESET, heap->snapshot_path);
+    }
+    if (profile_path && ember_vm_write_profile(vm, profile_path) != EMBER_SUCCESS) {
+        fprintf(stderr, "%sError:%s Could not write profile to '%s'\n", COLOR_RED, COLOR_RESET, profile_path);
+    }
+    if (sample_path) {
+        ember_vm_stop_sampling(vm);
+        if (ember_vm_write_samples(vm, sample_path) != EMBER_SUCCESS) {
+            fprintf(stderr, "%sError:%s Could not write samples to '%s'\n", COLOR_RED, COLOR_RESET, sample_path);
+        }
+    }
+}
+
+// Value of a leading --name or --name=value flag: "-" without a value, NULL
+// if arg is a different argument
+static const char* output_flag(const char* arg, const char* name) {
+    size_t length = strlen(name);
+    if (strncmp(arg, name, length) != 0) return NULL;
+    if (arg[length] == '\0') return "-";
+    return arg[length] == '=' ? arg + length + 1 : NULL;
+}
+
 static void print_version(void) {
     printf("%sEmber v%s%s\n", COLOR_BOLD COLOR_CYAN, EMBER_VERSION, COLOR_RESET);
     printf("A lightweight embedded scripting language in C\n");
@@ -327,11 +392,40 @@ static void print_version(void) {
 
 
 int main(int argc, char* argv[]) {
-    struct timeval start_time, end_time;
-    gettimeofday(&start_time, NULL);
+    ember_startup_profile_begin();
     
     const char* mount_spec = NULL;
     const char* script_file = NULL;
+    const char* profile_path = NULL;
+    const char* sample_path = NULL;
+    int startup_profile = getenv("EMBER_PROFILE_STARTUP") != NULL;
+    heap_report heap = { NULL, NULL };
+    const char* warm_path = NULL;
+
+    // --profile[=file], --sample[=file], --startup-profile, --heap-stats[=file],
+    // --heap-snapshot[=file] and --warm-profile[=file] come before the other
+    // arguments
+    while (argc > 1) {
+        const char* path;
+        if (strcmp(argv[1], "--startup-profile") == 0) {
+            startup_profile = 1;
+        } else if ((path = output_flag(argv[1], "--profile"))) {
+            profile_path = path;
+        } else if ((path = output_flag(argv[1], "--sample"))) {
+            sample_path = path;
+        } else if ((path = output_flag(argv[1], "--heap-stats"))) {
+            heap.stats_path = path;
+        } else if ((path = output_flag(argv[1], "--heap-snapshot"))) {
+            // Far too long for the terminal
+            heap.snapshot_path = strcmp(path, "-") == 0 ? "ember.heapsnapshot" : path;
+        } else if ((path = output_flag(argv[1], "--warm-profile"))) {
+            warm_path = path;
+        } else {
+            break;
+        }
+        argv++;
+        argc--;
+    }
     
     // Handle help and version flags first
     if (argc > 1) {
@@ -384,16 +478,27 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
-    // Calculate and display startup time
-    gettimeofday(&end_time, NULL);
-    double startup_time = (end_time.tv_sec - start_time.tv_sec) * 1000.0 + 
-                         (end_time.tv_usec - start_time.tv_usec) / 1000.0;
-    
-    // Check for profiling environment variable
-    if (getenv("EMBER_PROFILE_STARTUP")) {
-        printf("%s[STARTUP PROFILE]%s Total startup time: %.2f ms\n", 
-               COLOR_CYAN, COLOR_RESET, startup_time);
-        // Startup profiling not available in this build
+    if (profile_path) {
+        ember_vm_set_profiling(vm, 1);
+    }
+    if (sample_path && ember_vm_start_sampling(vm, 0) != EMBER_SUCCESS) {
+        fprintf(stderr, "%sError:%s Could not start the sampling profiler\n", COLOR_RED, COLOR_RESET);
+        sample_path = NULL;
+    }
+
+    // EMBER_PERF=map, jitdump or map,jitdump: JIT on, compiled code named for perf
+    const char* perf = getenv("EMBER_PERF");
+    if (perf && perf[0]) {
+        int flags = (strstr(perf, "map") ? EMBER_PERF_MAP : 0) | (strstr(perf, "jitdump") ? EMBER_PERF_JITDUMP : 0);
+        if (!flags || ember_jit_configure(vm, 1, 0) != EMBER_SUCCESS || ember_jit_perf_enable(flags) != EMBER_SUCCESS) {
+            fprintf(stderr, "%sWarning:%s EMBER_PERF=%s needs a JIT build on Linux (map, jitdump)\n", COLOR_YELLOW, COLOR_RESET, perf);
+        }
+    }
+
+    // Scripts and the modules they import reuse bytecode from earlier runs
+    const char* cache_dir = getenv("EMBER_BYTECODE_CACHE");
+    if (cache_dir && cache_dir[0]) {
+        ember_set_bytecode_cache_dir(cache_dir);
     }
     
     // Add custom mount if specified
@@ -452,7 +557,26 @@ int main(int argc, char* argv[]) {
     // Native functions are automatically registered by ember_new_vm() via register_builtin_functions()
     // This includes all math, string, file I/O, JSON, crypto, and type conversion functions
 
+    // Startup ends where user code begins; imports are still itemized after
+    ember_startup_profile_end();
+
     // Check if we have a script file to execute
+    // Precompiled bytecode from emberc -o runs without parsing
+    size_t script_length = script_file ? strlen(script_file) : 0;
+    if (script_length > 7 && strcmp(script_file + script_length - 7, ".emberc") == 0) {
+        int result = ember_run_bytecode_file(vm, script_file) == 0 ? 0 : 1;
+        if (result == 0 && vm->stack_top > 0) {
+            ember_value res = ember_peek_stack_top(vm);
+            if (res.type != EMBER_VAL_NIL) {
+                ember_print_value(res);
+                printf("\n");
+            }
+        }
+        write_profile(vm, profile_path, sample_path, startup_profile, &heap);
+        ember_free_vm(vm);
+        return result;
+    }
+
     if (script_file) {
         // File execution mode
         FILE* file = fopen(script_file, "r");
@@ -539,10 +663,19 @@ int main(int argc, char* argv[]) {
         }
         */
         
+        // Beside the script unless named; "-" has no use for a profile
+        char warm_default[PATH_MAX];
+        if (warm_path && strcmp(warm_path, "-") == 0) {
+            snprintf(warm_default, sizeof(warm_default), "%s.warm", script_file);
+            warm_path = warm_default;
+        }
+        // A missing or stale profile just means a cold start
+        if (warm_path) ember_vm_load_warm_profile(vm, exec_source, warm_path);
+
         // Execute the entire file as one unit
         int result = 0;
         if (strlen(exec_source) > 0) {
-            if (ember_eval(vm, exec_source) != 0) {
+            if (ember_eval_cached(vm, exec_source) != 0) {
                 result = 1;
             } else {
                 // Print the result (skip nil values) - only if there's something on the stack
@@ -556,7 +689,11 @@ int main(int argc, char* argv[]) {
             }
         }
         
+        if (warm_path && ember_vm_save_warm_profile(vm, exec_source, warm_path) != EMBER_SUCCESS) {
+            fprintf(stderr, "%sError:%s Could not write warm profile to '%s'\n", COLOR_RED, COLOR_RESET, warm_path);
+        }
         free(source);
+        write_profile(vm, profile_path, sample_path, startup_profile, &heap);
         ember_free_vm(vm);
         return result;
     }
@@ -567,7 +704,7 @@ int main(int argc, char* argv[]) {
     if (is_interactive) {
         // Interactive REPL mode with enhanced features
         printf("Ember v%s REPL\n", EMBER_VERSION);
-        printf("Type 'exit' to quit\n");
+        printf("Type 'exit' to quit, ':heap' for live objects by type, ':heap <file>' for a heap snapshot\n");
         
 #if USE_READLINE
         printf("Features: readline support, tab completion, command history, multi-line editing\n");
@@ -607,6 +744,20 @@ int main(int argc, char* argv[]) {
         }
         
         // Check for special commands
+        if (state.buffer_used == 0 && strncmp(line, ":heap", 5) == 0 && (line[5] == '\0' || line[5] == ' ')) {
+            const char* path = line + 5;
+            while (*path == ' ') path++;
+            if (*path == '\0') {
+                ember_vm_write_heap_histogram(vm, "-");
+            } else if (ember_vm_write_heap_snapshot(vm, path) == EMBER_SUCCESS) {
+                printf("Heap snapshot written to %s\n", path);
+            } else {
+                fprintf(stderr, "%sError:%s Could not write heap snapshot to '%s'\n", COLOR_RED, COLOR_RESET, path);
+            }
+            free(line);
+            continue;
+        }
+
         if (state.buffer_used == 0 && strncmp(line, "clear", 5) == 0) {
             if (is_interactive) {
 #if USE_READLINE
@@ -627,19 +778,19 @@ int main(int argc, char* argv[]) {
         }
         
         // Check if we need continuation
-        if (needs_continuation(state.buffer, &state)) {
+        if (needs_continuation(line, &state)) {
             state.needs_continuation = 1;
             free(line);
             continue;
         }
         
-        // We have a complete expression, execute it
+        // We have a complete expression, execute it. Only this entry is
+        // compiled; globals and loaded modules from earlier entries stay in
+        // the VM and resolve against it.
         char* complete_input = strdup(state.buffer);
         
         // Reset state for next input
-        state.buffer_used = 0;
-        state.buffer[0] = '\0';
-        state.needs_continuation = 0;
+        reset_repl_entry(&state);
         
         // AUTO-RESOLVE IMPORTS: Check if this is an import statement
         if (strncmp(complete_input, "import ", 7) == 0) {
@@ -647,8 +798,11 @@ int main(int argc, char* argv[]) {
                 printf("%s[AUTO-IMPORT]%s Installing package...\n", COLOR_CYAN, COLOR_RESET);
             }
             
-            // Initialize package system for single import
-            if (ember_package_system_init()) {
+            // The package system stays up for the rest of the session
+            if (!state.packages_ready) {
+                state.packages_ready = ember_package_system_init();
+            }
+            if (state.packages_ready) {
                 EmberProject* temp_project = ember_project_init("repl_session", "1.0.0");
                 if (temp_project) {
                     // Create temporary file for this import
@@ -669,7 +823,6 @@ int main(int argc, char* argv[]) {
                     }
                     ember_project_cleanup(temp_project);
                 }
-                ember_package_system_cleanup();
             }
         }
 
@@ -705,6 +858,7 @@ int main(int argc, char* argv[]) {
     }
 #endif
 
+    write_profile(vm, profile_path, sample_path, startup_profile, &heap);
     ember_free_vm(vm);
     ember_package_system_cleanup();
     return 0;
@@ -19,11 +19,13 @@ static void print_help(void) {
     
     printf("%sUSAGE:%s\n", COLOR_BOLD, COLOR_RESET);
     printf("  %semberc%s %s<file>%s           Compile and test source file\n", COLOR_CYAN, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
+    printf("  %semberc%s %s<file> -o <out>%s  Compile to a bytecode file (.emberc) without running\n", COLOR_CYAN, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
     printf("  %semberc%s %s--help%s          Show this help message\n", COLOR_CYAN, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
     printf("  %semberc%s %s--version%s       Show version information\n", COLOR_CYAN, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
     
     printf("\n%sEXAMPLE:%s\n", COLOR_BOLD, COLOR_RESET);
     printf("  ./emberc program.ember\n");
+    printf("  ./emberc program.ember -o program.emberc && ./ember program.emberc\n");
     
     printf("\n%sNote:%s This tool compiles Ember source code and runs basic tests\n", COLOR_YELLOW, COLOR_RESET);
     printf("to validate the compilation was successful.\n");
@@ -52,6 +54,22 @@ int main(int argc, char* argv[]) {
         return 0;
     }
     
+    if (argc >= 4 && strcmp(argv[2], "-o") == 0) {
+        ember_vm* vm = ember_new_vm();
+        if (!vm) {
+            fprintf(stderr, "%sError:%s Could not create VM\n", COLOR_RED, COLOR_RESET);
+            return 1;
+        }
+        int result = ember_compile_file(vm, argv[1], argv[3]);
+        if (result == 0) {
+            printf("%s[SUCCESS]%s Wrote %s%s%s\n", COLOR_GREEN, COLOR_RESET, COLOR_CYAN, argv[3], COLOR_RESET);
+        } else {
+            fprintf(stderr, "%s[ERROR]%s Compilation of '%s' failed\n", COLOR_RED, COLOR_RESET, argv[1]);
+        }
+        ember_free_vm(vm);
+        return result == 0 ? 0 : 1;
+    }
+    
     FILE* file = fopen(argv[1], "r");
     if (!file) {
         fprintf(stderr, "%sError:%s Could not open file '%s%s%s'\n", 